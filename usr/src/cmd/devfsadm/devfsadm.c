@@ -251,6 +251,15 @@ static syseventq_t *syseventq_front;
 static syseventq_t *syseventq_back;
 static void process_syseventq();
 
+/* device add event queue related globals, see addq_t */
+static mutex_t	addq_mutex = DEFAULTMUTEX;
+static cond_t	addq_cv = DEFAULTCV;		/* events queued */
+static cond_t	addq_idle_cv = DEFAULTCV;	/* queue empty and idle */
+static addq_t	*addq_head;
+static addq_t	*addq_tail;
+static int	addq_busy = FALSE;
+static int	addq_snapshot_threads = ADDQ_SNAPSHOT_THREADS;
+
 static di_node_t devi_root_node = DI_NODE_NIL;
 
 int
@@ -982,7 +991,6 @@ static void
 devi_tree_walk(struct dca_impl *dcip, int flags, char *ev_subclass)
 {
 	char *msg, *name;
-	struct mlist	mlist = {0};
 	di_node_t	node;
 
 	vprint(CHATTY_MID, "devi_tree_walk: root=%s, minor=%s, driver=%s,"
@@ -1017,6 +1025,18 @@ devi_tree_walk(struct dca_impl *dcip, int flags, char *ev_subclass)
 		return;
 	}
 
+	devi_walk_snapshot(dcip, node, ev_subclass);
+	di_fini(node);
+}
+
+/*
+ * Build /devices and /dev for the minor nodes of a devinfo snapshot.
+ */
+static void
+devi_walk_snapshot(struct dca_impl *dcip, di_node_t node, char *ev_subclass)
+{
+	struct mlist	mlist = {0};
+
 	if (dcip->dci_flags & DCA_FLUSH_PATHINST)
 		flush_path_to_inst();
 
@@ -1047,7 +1067,6 @@ devi_tree_walk(struct dca_impl *dcip, int flags, char *ev_subclass)
 	}
 
 	devi_root_node = DI_NODE_NIL;	/* protected by lock_dev() */
-	di_fini(node);
 }
 
 static void
@@ -1244,6 +1263,12 @@ daemon_update(void)
 		devfsadm_exit(1);
 		/*NOTREACHED*/
 	}
+	if (thr_create(NULL, NULL, (void *(*)(void *))add_thread,
+	    NULL, THR_DETACHED, NULL) != 0) {
+		err_print(CANT_CREATE_THREAD, "add", strerror(errno));
+		devfsadm_exit(1);
+		/*NOTREACHED*/
+	}
 	if (sysevent_bind_subscriber(sysevent_hp, event_handler) != 0) {
 		err_print(CANT_CREATE_DOOR,
 		    door_file, strerror(errno));
@@ -1385,6 +1410,7 @@ sync_handler(void *cookie, char *ap, size_t asize,
 	dci.dci_flags = dcp->dca_flags | (dci.dci_driver ? DCA_LOAD_DRV : 0);
 	dci.dci_arg = NULL;
 
+	addq_drain();
 	lock_dev();
 	devi_tree_walk(&dci, DINFOCPYALL, NULL);
 	dcp->dca_error = dci.dci_error;
@@ -1683,20 +1709,19 @@ event_handler(sysevent_t *ev)
 		    &minor) != 0)
 			minor = NULL;
 
-		lock_dev();
-
 		if (strcmp(ESC_DEVFS_DEVI_ADD, subclass) == 0) {
-			add_minor_pathname(path, NULL, dev_ev_subclass);
-			if (branch_event) {
-				build_and_enq_event(EC_DEV_BRANCH,
-				    ESC_DEV_BRANCH_ADD, path, DI_NODE_NIL,
-				    NULL);
-			}
-
+			enqueue_add(path, NULL, dev_ev_subclass, branch_event);
+			goto out;
 		} else if (strcmp(ESC_DEVFS_MINOR_CREATE, subclass) == 0) {
-			add_minor_pathname(path, minor, dev_ev_subclass);
+			enqueue_add(path, minor, dev_ev_subclass, 0);
+			goto out;
+		}
+
+		/* removals must not overtake the adds before them */
+		addq_drain();
+		lock_dev();
 
-		} else if (strcmp(ESC_DEVFS_MINOR_REMOVE, subclass) == 0) {
+		if (strcmp(ESC_DEVFS_MINOR_REMOVE, subclass) == 0) {
 			hot_cleanup(path, minor, dev_ev_subclass, driver_name,
 			    instance);
 
@@ -1724,6 +1749,7 @@ event_handler(sysevent_t *ev)
 		else
 			dev_ev_subclass = ESC_DEV_BRANCH_REMOVE;
 
+		addq_drain();
 		lock_dev();
 		build_and_enq_event(EC_DEV_BRANCH, dev_ev_subclass, path,
 		    DI_NODE_NIL, NULL);
@@ -1751,33 +1777,227 @@ dca_impl_init(char *root, char *minor, struct dca_impl *dcip)
 }
 
 /*
- *  Kernel logs a message when a devinfo node is attached.  Try to create
- *  /dev and /devices for each minor node.  minorname can be NULL.
+ *  Kernel logs a message when a devinfo node is attached, or a minor node
+ *  created.  Queue it for add_thread() to create /dev and /devices for the
+ *  minor nodes.  minor can be NULL, for all the minor nodes of the node.
  */
-void
-add_minor_pathname(char *node, char *minor, char *ev_subclass)
+static void
+enqueue_add(char *path, char *minor, char *ev_subclass, int branch_event)
 {
-	struct dca_impl	dci;
+	addq_t *ap;
 
-	vprint(CHATTY_MID, "add_minor_pathname: node_path=%s minor=%s\n",
-	    node, minor ? minor : "NULL");
+	vprint(CHATTY_MID, "enqueue_add: node_path=%s minor=%s\n",
+	    path, minor ? minor : "NULL");
 
-	dca_impl_init(node, minor, &dci);
+	ap = s_zalloc(sizeof (*ap));
+	ap->path = s_strdup(path);
+	ap->minor = minor ? s_strdup(minor) : NULL;
+	ap->ev_subclass = ev_subclass ? s_strdup(ev_subclass) : NULL;
+	ap->branch_event = branch_event;
+	ap->node = DI_NODE_NIL;
 
-	/*
-	 * Restrict hotplug link creation if daemon
-	 * started  with -i option.
-	 */
-	if (single_drv == TRUE) {
-		dci.dci_driver = driver;
+	(void) mutex_lock(&addq_mutex);
+	if (addq_tail != NULL)
+		addq_tail->next = ap;
+	else
+		addq_head = ap;
+	addq_tail = ap;
+	(void) cond_signal(&addq_cv);
+	(void) mutex_unlock(&addq_mutex);
+}
+
+/*
+ * Wait until add_thread() has processed all the events queued so far.
+ */
+static void
+addq_drain(void)
+{
+	(void) mutex_lock(&addq_mutex);
+	while (addq_head != NULL || addq_busy)
+		(void) cond_wait(&addq_idle_cv, &addq_mutex);
+	(void) mutex_unlock(&addq_mutex);
+}
+
+/*
+ * Return TRUE if the walk of the node add "ap" creates the links of "bp":
+ * bp is for the same node, or one below it.
+ */
+static int
+addq_covers(addq_t *ap, addq_t *bp)
+{
+	size_t len = strlen(ap->path);
+
+	if (ap->minor != NULL || strncmp(ap->path, bp->path, len) != 0)
+		return (FALSE);
+	return (len == 1 || bp->path[len] == '\0' || bp->path[len] == '/');
+}
+
+static void *
+addq_snapshot_thread(void *arg)
+{
+	addq_snap_t	*asp = arg;
+	addq_t		*ap;
+	int		i;
+
+	for (;;) {
+		(void) mutex_lock(&asp->as_lock);
+		i = asp->as_next++;
+		(void) mutex_unlock(&asp->as_lock);
+		if (i >= asp->as_nents)
+			break;
+
+		ap = asp->as_ents[i];
+		ap->node = di_init(ap->path, DINFOPROP|DINFOMINOR);
+		if (ap->node == DI_NODE_NIL)
+			ap->error = errno;
 	}
+	return (NULL);
+}
+
+/*
+ * Create /dev and /devices for a batch of add events.  Taking the devinfo
+ * snapshots, one ioctl each that copies out a subtree, is done in parallel
+ * and outside lock_dev(); the walks that create the links are not, as the
+ * link modules are not MT-safe.
+ */
+static void
+process_addq(addq_t *batch)
+{
+	addq_t		*ap, *bp, *next;
+	addq_snap_t	as;
+	thread_t	*tids;
+	struct dca_impl	dci;
+	di_node_t	node;
+	int		i, nthreads, seen;
 
 	/*
-	 * We are being invoked in response to a hotplug event.
+	 * Find each entry's cover.  Of two node adds for the same node,
+	 * the first covers the second.
 	 */
-	dci.dci_flags = DCA_HOT_PLUG | DCA_CHECK_TYPE;
+	as.as_nents = 0;
+	for (ap = batch; ap != NULL; ap = ap->next) {
+		seen = FALSE;
+		for (bp = batch; bp != NULL; bp = bp->next) {
+			if (bp == ap) {
+				seen = TRUE;
+				continue;
+			}
+			if (addq_covers(bp, ap) &&
+			    !(seen && addq_covers(ap, bp))) {
+				ap->cover = bp;
+				break;
+			}
+		}
+		if (ap->cover == NULL)
+			as.as_nents++;
+	}
+	for (ap = batch; ap != NULL; ap = ap->next) {
+		while (ap->cover != NULL && ap->cover->cover != NULL)
+			ap->cover = ap->cover->cover;
+	}
+
+	as.as_ents = s_malloc(as.as_nents * sizeof (addq_t *));
+	for (i = 0, ap = batch; ap != NULL; ap = ap->next) {
+		if (ap->cover == NULL)
+			as.as_ents[i++] = ap;
+	}
+	as.as_next = 0;
+	(void) mutex_init(&as.as_lock, USYNC_THREAD, NULL);
+
+	nthreads = as.as_nents < addq_snapshot_threads ?
+	    as.as_nents : addq_snapshot_threads;
+	tids = s_zalloc(nthreads * sizeof (thread_t));
+	for (i = 1; i < nthreads; i++) {
+		if (thr_create(NULL, 0, addq_snapshot_thread, &as, 0,
+		    &tids[i]) != 0)
+			tids[i] = 0;
+	}
+	(void) addq_snapshot_thread(&as);
+	for (i = 1; i < nthreads; i++) {
+		if (tids[i] != 0)
+			(void) thr_join(tids[i], NULL, NULL);
+	}
+	free(tids);
+	free(as.as_ents);
+	(void) mutex_destroy(&as.as_lock);
+
+	lock_dev();
+	for (ap = batch; ap != NULL; ap = ap->next) {
+		dca_impl_init(ap->path, ap->minor, &dci);
 
-	devi_tree_walk(&dci, DINFOPROP|DINFOMINOR, ev_subclass);
+		/*
+		 * Restrict hotplug link creation if daemon
+		 * started  with -i option.
+		 */
+		if (single_drv == TRUE) {
+			dci.dci_driver = driver;
+		}
+
+		/*
+		 * We are being invoked in response to a hotplug event.
+		 */
+		dci.dci_flags = DCA_HOT_PLUG | DCA_CHECK_TYPE;
+
+		if (ap->cover == NULL && ap->node != DI_NODE_NIL) {
+			devi_walk_snapshot(&dci, ap->node, ap->ev_subclass);
+		} else if (ap->cover == NULL) {
+			/* see devi_tree_walk() */
+			if (ap->error != ENXIO)
+				err_print(DI_INIT_FAILED, ap->path,
+				    strerror(ap->error));
+		} else if (ap->ev_subclass != NULL &&
+		    ap->cover->node != DI_NODE_NIL) {
+			/* the links were made by the cover's walk */
+			node = di_lookup_node(ap->cover->node, ap->path);
+			build_and_enq_event(EC_DEV_ADD, ap->ev_subclass,
+			    ap->path, node, ap->minor);
+		}
+
+		if (ap->branch_event) {
+			build_and_enq_event(EC_DEV_BRANCH,
+			    ESC_DEV_BRANCH_ADD, ap->path, DI_NODE_NIL,
+			    NULL);
+		}
+	}
+	unlock_dev(CACHE_STATE);
+
+	for (ap = batch; ap != NULL; ap = next) {
+		next = ap->next;
+		if (ap->node != DI_NODE_NIL)
+			di_fini(ap->node);
+		free(ap->path);
+		free(ap->minor);
+		free(ap->ev_subclass);
+		free(ap);
+	}
+}
+
+/*
+ * Take the add events queued by event_handler(), a batch at a time.
+ */
+static void
+add_thread(void)
+{
+	addq_t *batch;
+
+	vprint(INITFINI_MID, "add_thread starting\n");
+
+	(void) mutex_lock(&addq_mutex);
+	for (;;) {
+		while (addq_head == NULL) {
+			addq_busy = FALSE;
+			(void) cond_broadcast(&addq_idle_cv);
+			(void) cond_wait(&addq_cv, &addq_mutex);
+		}
+		batch = addq_head;
+		addq_head = addq_tail = NULL;
+		addq_busy = TRUE;
+		(void) mutex_unlock(&addq_mutex);
+
+		process_addq(batch);
+
+		(void) mutex_lock(&addq_mutex);
+	}
 }
 
 static di_node_t
@@ -357,6 +357,34 @@ typedef struct syseventq_s {
 	nvlist_t *nvl;
 } syseventq_t;
 
+/*
+ * Device add events, queued by event_handler() for add_thread().  The
+ * events that arrive while add_thread() is busy are handled as a batch:
+ * the devinfo snapshots they need are taken in parallel, an event whose
+ * node is at or below that of a node add in the batch shares its snapshot
+ * and walk ("cover"), and the links are all built under one lock_dev().
+ */
+typedef struct addq_s {
+	struct addq_s *next;
+	char *path;
+	char *minor;		/* NULL for a node add */
+	char *ev_subclass;
+	int branch_event;
+	struct addq_s *cover;	/* entry whose walk makes our links */
+	di_node_t node;		/* our snapshot, if not covered */
+	int error;		/* errno if the snapshot failed */
+} addq_t;
+
+/* the entries of a batch to take snapshots for, shared by the threads */
+typedef struct addq_snap {
+	mutex_t as_lock;
+	addq_t **as_ents;
+	int as_nents;
+	int as_next;		/* next entry to take */
+} addq_snap_t;
+
+#define	ADDQ_SNAPSHOT_THREADS	8
+
 static int devfsadm_enumerate_int_start(char *devfs_path,
 	int index, char **buf, devfsadm_enumerate_t rules[],
 	int nrules, char *start);
@@ -397,7 +425,10 @@ static void unload_modules(void);
 static void *s_malloc(const size_t size);
 static void *s_zalloc(const size_t size);
 static void devfs_instance_mod(void);
-static void add_minor_pathname(char *, char *, char *);
+static void enqueue_add(char *, char *, char *, int);
+static void add_thread(void);
+static void process_addq(addq_t *);
+static void addq_drain(void);
 static int check_minor_type(di_node_t node, di_minor_t minor, void *arg);
 static void cache_deferred_minor(struct mlist *dep, di_node_t node,
     di_minor_t minor);
@@ -470,6 +501,8 @@ static int zone_pathcheck(char *checkpath);
 static void process_deferred_links(struct dca_impl *dcip, int flag);
 static void event_handler(sysevent_t *ev);
 static void dca_impl_init(char *root, char *minor, struct dca_impl *dcip);
+static void devi_walk_snapshot(struct dca_impl *dcip, di_node_t node,
+    char *ev_subclass);
 static void lock_dev(void);
 static void unlock_dev(int flag);
 static int devlink_cb(di_devlink_t dl, void *arg);
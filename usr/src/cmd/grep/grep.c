@@ -46,9 +46,12 @@
  */
 
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <langinfo.h>
 #include <locale.h>
 #include <memory.h>
 #include <regexpr.h>
@@ -110,8 +113,16 @@ static int	outfn = 0;
 static int	nlflag;
 static char	*ptr, *ptrend;
 static char	*expbuf;
+static char	*reqlit;	/* string every matching line contains */
+static size_t	reqlitlen;
+static int	purelit;	/* pattern is just reqlit */
+static char	*hitbuf;
+static size_t	hitbuflen;
 
 static void	execute(const char *, int);
+static int	execute_mapped(const char *);
+static void	find_literal(const char *);
+static int	match(char *);
 static void	regerr(int);
 static void	prepare(const char *);
 static int	recursive(const char *, const struct stat *, int, struct FTW *);
@@ -220,6 +231,8 @@ main(int argc, char **argv)
 	if (regerrno)
 		regerr(regerrno);
 
+	find_literal(*argv);
+
 	if (--argc == 0)
 		execute(NULL, 0);
 	else
@@ -324,6 +337,16 @@ execute(const char *file, int base)
 		return;
 	}
 
+	/*
+	 * Without -v every matching line contains the required literal, so
+	 * a regular file can be searched for that as a whole, rather than
+	 * line by line.  -i searches a lower case copy of each line, and -b
+	 * reports offsets of the read loop below; both stay on that path.
+	 */
+	if (reqlit != NULL && !vflag && !iflag && !bflag && temp != 0 &&
+	    execute_mapped(file))
+		goto out;
+
 	/* read in first block of bytes */
 	if ((count = read(temp, prntbuf, GBUFSIZ)) <= 0) {
 		(void) close(temp);
@@ -413,7 +436,7 @@ execute(const char *file, int base)
 			lbuf = ptr;
 
 		/* lflag only once */
-		if ((step(lbuf, expbuf) ^ vflag) && succeed(file) == 1)
+		if ((match(lbuf) ^ vflag) && succeed(file) == 1)
 			break;
 
 		if (!nlflag)
@@ -423,6 +446,7 @@ execute(const char *file, int base)
 		count = next_count;
 		offset = 0;
 	}
+out:
 	(void) close(temp);
 
 	if (cflag && !qflag) {
@@ -433,6 +457,180 @@ execute(const char *file, int base)
 	}
 }
 
+/*
+ * Search the open regular file temp by mapping it and scanning the whole of
+ * it for reqlit, only finding the boundaries of and matching the lines that
+ * contain it.  Returns 0, having done nothing, if the file can't be mapped.
+ */
+static int
+execute_mapped(const char *file)
+{
+	struct stat	st;
+	char		*base, *end, *p, *hit, *bol, *eol, *lp;
+	size_t		size, len;
+
+	if (fstat(temp, &st) == -1 || !S_ISREG(st.st_mode) ||
+	    st.st_size == 0 || (off_t)(size_t)st.st_size != st.st_size)
+		return (0);
+
+	size = (size_t)st.st_size;
+	base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, temp, 0);
+	if (base == MAP_FAILED)
+		return (0);
+	(void) madvise(base, size, MADV_SEQUENTIAL);
+
+	end = base + size;
+	lnum = 0;
+	lp = p = base;
+	while (p < end &&
+	    (hit = memmem(p, end - p, reqlit, reqlitlen)) != NULL) {
+		for (bol = hit; bol > p && bol[-1] != '\n'; bol--)
+			;
+		if ((eol = memchr(hit, '\n', end - hit)) == NULL) {
+			eol = end;
+			nlflag = 0;
+		} else {
+			nlflag = 1;
+		}
+
+		if (nflag) {
+			/* count the lines skipped over */
+			while ((lp = memchr(lp, '\n', bol - lp)) != NULL) {
+				lnum++;
+				lp++;
+			}
+			lnum++;
+			lp = eol + nlflag;
+		}
+
+		/*
+		 * Copy the line out so that it can be terminated for step()
+		 * and succeed() without writing to the mapping.
+		 */
+		len = eol - bol;
+		if (len + 1 > hitbuflen) {
+			hitbuflen = len + 1;
+			if ((hitbuf = realloc(hitbuf, hitbuflen)) == NULL)
+				exit(2);
+		}
+		(void) memcpy(hitbuf, bol, len);
+		hitbuf[len] = '\0';
+		ptr = hitbuf;
+		ptrend = hitbuf + len;
+
+		/* lflag only once */
+		if (match(hitbuf) && succeed(file) == 1)
+			break;
+
+		p = eol + nlflag;
+	}
+
+	(void) munmap(base, size);
+	return (1);
+}
+
+/*
+ * Find the longest string of ordinary characters that every line matching the
+ * regular expression re must contain, and set reqlit to it; if re is nothing
+ * but that string, matching it needs no regular expression at all.  Anything
+ * that might match nothing, or isn't a plain character, ends a string; the
+ * search ends at a bracket expression or a subexpression, the contents of
+ * which can't be relied on.  Non-ASCII bytes end a string too, since in a
+ * multibyte locale one may be part of a character a following '*' applies to.
+ */
+static void
+find_literal(const char *re)
+{
+	const char	*p = re;
+	char		*run;
+	size_t		len = 0;
+	int		last = 0;	/* previous character is in run */
+	int		pure = 1;
+	int		c;
+
+	if ((run = malloc(strlen(re) + 1)) == NULL ||
+	    (reqlit = malloc(strlen(re) + 1)) == NULL) {
+		free(run);
+		return;
+	}
+
+	for (;;) {
+		c = (unsigned char)*p;
+
+		if (c == '\\' && p[1] != '\0' &&
+		    strchr(".*[]\\^$/", p[1]) != NULL) {
+			/* escaped special character */
+			c = (unsigned char)p[1];
+			p += 2;
+		} else if (c != '\0' && c != '\\' && c != '[' && c != '.' &&
+		    c != '*' && c != '^' && c != '$' && isascii(c)) {
+			p++;
+		} else {
+			if (c == '*' && last) {
+				/* previous character may be absent */
+				len--;
+			} else if (c == '\\' && p[1] == '{') {
+				/* likewise, for a \{m,n\} interval */
+				if (last)
+					len--;
+				if ((p = strstr(p, "\\}")) == NULL)
+					c = '\0';
+			}
+
+			if (len > reqlitlen) {
+				(void) memcpy(reqlit, run, len);
+				reqlitlen = len;
+			}
+			len = 0;
+			last = 0;
+
+			if (c == '\0' || c == '[' ||
+			    (c == '\\' && p[1] == '('))
+				break;
+
+			pure = 0;
+			p += (c == '\\' && p[1] != '\0') ? 2 : 1;
+			continue;
+		}
+
+		run[len++] = (char)c;
+		last = 1;
+	}
+
+	if (c != '\0')
+		pure = 0;
+
+	free(run);
+	if (reqlitlen == 0) {
+		free(reqlit);
+		reqlit = NULL;
+		return;
+	}
+	reqlit[reqlitlen] = '\0';
+
+	/*
+	 * A string of single byte characters only matches characters in the
+	 * line when no character can contain such a byte, which is true of
+	 * single byte locales and of UTF-8.
+	 */
+	purelit = pure && (MB_CUR_MAX == 1 ||
+	    strcmp(nl_langinfo(CODESET), "UTF-8") == 0);
+}
+
+/*
+ * Match the regular expression against the null terminated line, using the
+ * required literal to reject most lines without calling step().
+ */
+static int
+match(char *line)
+{
+	if (reqlit != NULL && strstr(line, reqlit) == NULL)
+		return (0);
+	if (purelit)
+		return (1);
+	return (step(line, expbuf));
+}
+
 static int
 succeed(const char *f)
 {
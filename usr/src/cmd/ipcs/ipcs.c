@@ -49,6 +49,7 @@
 #include <sys/msg.h>
 #include <sys/sem.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <time.h>
@@ -66,13 +67,13 @@
 #include <zone.h>
 
 #define	USAGE	\
-	"usage: ipcs [-AabciJmopqstZ] [-D mtype] [-z zone]\n"
+	"usage: ipcs [-AabciJLmopqstZ] [-D mtype] [-z zone]\n"
 
 static char chdr[] = "T         ID      KEY        MODE        OWNER    GROUP";
 						/* common header format */
 static char chdr2[] = "  CREATOR   CGROUP";	/* c option header format */
 static char chdr3[] = "         PROJECT";	/* J option header format */
-static char opts[] = "AabciJmopqstD:z:Z";	/* getopt options */
+static char opts[] = "AabciJLmopqstD:z:Z";	/* getopt options */
 
 static long	mtype;		/* -D: user-supplied message type */
 static zoneid_t	zoneid;		/* -z: user-supplied zone id */
@@ -83,6 +84,7 @@ static int	bflg,		/* biggest size: */
 		Dflg,		/* dump contents of message queues */
 		iflg,		/* ISM attaches */
 		Jflg,		/* dump project name */
+		Lflg,		/* shared memory placement advice */
 		mflg,		/* shared memory status */
 		oflg,		/* outstanding data: */
 				/*	nattch on m; cbytes, qnum on q */
@@ -99,6 +101,7 @@ static int	bflg,		/* biggest size: */
 
 static void hp(char, char *, struct ipc_perm64 *, int);
 static void jp(struct ipc_perm64 *);
+static void lp(int);
 static void tp(ipc_time_t);
 static void dumpmsgq(int);
 static void dumpmsg(long, char *, size_t);
@@ -160,6 +163,9 @@ main(int argc, char *argv[])
 		case 'J':
 			Jflg = 1;
 			break;
+		case 'L':
+			Lflg = 1;
+			break;
 		case 'm':
 			mflg = 1;
 			break;
@@ -278,14 +284,15 @@ main(int argc, char *argv[])
 			ids = realloc(ids, (nids = n) * sizeof (int));
 		}
 
-		if (!qflg || oflg || bflg || pflg || tflg || iflg)
-			(void) printf("%s%s%s%s%s%s%s%s%s\n", chdr,
+		if (!qflg || oflg || bflg || pflg || tflg || iflg || Lflg)
+			(void) printf("%s%s%s%s%s%s%s%s%s%s\n", chdr,
 			    cflg ? chdr2 : "",
 			    oflg ? " NATTCH" : "",
 			    bflg ? "      SEGSZ" : "",
 			    pflg ? "  CPID  LPID" : "",
 			    tflg ? "   ATIME    DTIME    CTIME " : "",
 			    iflg ? " ISMATTCH" : "",
+			    Lflg ? " PLACEMENT         " : "",
 			    Jflg ? chdr3 : "",
 			    Zflg ? "     ZONE" : "");
 
@@ -314,6 +321,8 @@ main(int argc, char *argv[])
 			}
 			if (iflg)
 				(void) printf(" %8llu", mds.shmx_cnattch);
+			if (Lflg)
+				lp(id);
 			if (Jflg)
 				jp(&mds.shmx_perm);
 			if (Zflg)
@@ -433,6 +442,42 @@ jp(struct ipc_perm64 *permp)
 		(void) printf("%16.15s", proj.pj_name);
 }
 
+/*
+ * lp - shared memory placement advice print
+ */
+static void
+lp(int id)
+{
+	struct shm_advice	adv;
+	char			buf[32];
+
+	if (shmctl(id, SHM_ADVICE, (struct shmid_ds *)&adv) < 0) {
+		(void) printf(" %-18s", "-");
+		return;
+	}
+
+	switch (adv.shma_advice) {
+	case MADV_ACCESS_LWP:
+		(void) printf(" %-18s", "lwp");
+		break;
+	case MADV_ACCESS_MANY:
+		(void) printf(" %-18s", "many");
+		break;
+	case MADV_ACCESS_INTERLEAVE:
+		if (adv.shma_lgrps == 0) {
+			(void) printf(" %-18s", "interleave");
+		} else {
+			(void) snprintf(buf, sizeof (buf), "interleave:%llx",
+			    (u_longlong_t)adv.shma_lgrps);
+			(void) printf(" %-18s", buf);
+		}
+		break;
+	default:
+		(void) printf(" %-18s", "default");
+		break;
+	}
+}
+
 /*
  * tp - time entry printer
  */
@@ -64,6 +64,8 @@
 #include "utils.h"
 #include <LzmaEnc.h>
 
+extern size_t lz4_compress(void *, void *, size_t, size_t, int);
+
 /* Only need the IV len #defines out of these files, nothing else. */
 #include <aes/aes_impl.h>
 #include <des/des_impl.h>
@@ -79,7 +81,7 @@ static const char USAGE[] =
 	"-k wrapped_key_file -a file [device]\n"
 	"       %s [-r] -c crypto_algorithm -e -a file [device]\n"
 	"       %s -d file | device\n"
-	"       %s -C [gzip|gzip-6|gzip-9|lzma] [-s segment_size] file\n"
+	"       %s -C [gzip|gzip-6|gzip-9|lzma|lz4] [-s segment_size] file\n"
 	"       %s -U file\n"
 	"       %s [ file | device ]\n";
 
@@ -136,12 +138,15 @@ static int gzip_compress(void *src, size_t srclen, void *dst,
 	size_t *destlen, int level);
 static int lzma_compress(void *src, size_t srclen, void *dst,
 	size_t *destlen, int level);
+static int lz4_seg_compress(void *src, size_t srclen, void *dst,
+	size_t *destlen, int level);
 
 lofi_compress_info_t lofi_compress_table[LOFI_COMPRESS_FUNCTIONS] = {
 	{NULL,  		gzip_compress,  6,	"gzip"}, /* default */
 	{NULL,			gzip_compress,	6,	"gzip-6"},
 	{NULL,			gzip_compress,	9, 	"gzip-9"},
-	{NULL,  		lzma_compress, 	0, 	"lzma"}
+	{NULL,  		lzma_compress, 	0, 	"lzma"},
+	{NULL,			lz4_seg_compress, 0,	"lz4"}
 };
 
 /* For displaying lofi mappings */
@@ -274,6 +279,24 @@ lzma_compress(void *src, size_t srclen, void *dst,
 	return (0);
 }
 
+/*
+ * lz4 segments use the zfs lz4 code and format, which prefixes the lz4
+ * stream with its 32-bit big-endian length; lz4_compress() returns
+ * srclen when the data doesn't fit in dstlen.
+ */
+static int
+lz4_seg_compress(void *src, size_t srclen, void *dst, size_t *dstlen,
+    int level)
+{
+	size_t len;
+
+	len = lz4_compress(src, dst, srclen, *dstlen, level);
+	if (len >= srclen)
+		return (-1);
+	*dstlen = len;
+	return (0);
+}
+
 /*
  * Translate a lofi device name to a minor number. We might be asked
  * to do this when there is no association (such as when the user specifies
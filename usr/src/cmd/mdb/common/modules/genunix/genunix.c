@@ -634,7 +634,8 @@ callout_list_walk_fini(mdb_walk_state_t *wsp)
 typedef struct cot_data {
 	callout_table_t *ct0;
 	callout_table_t ct;
-	callout_hash_t cot_idhash[CALLOUT_BUCKETS];
+	callout_hash_t *cot_idhash;	/* the ID hash grows; see callout.c */
+	size_t cot_idsize;
 	callout_hash_t cot_clhash[CALLOUT_BUCKETS];
 	kstat_named_t ct_kstat_data[CALLOUT_NUM_STATS];
 	int cotndx;
@@ -666,6 +667,8 @@ callout_table_walk_init(mdb_walk_state_t *wsp)
 	}
 
 	cot_walk_data->cotndx = 0;
+	cot_walk_data->cot_idhash = NULL;
+	cot_walk_data->cot_idsize = 0;
 	wsp->walk_data = cot_walk_data;
 
 	return (WALK_NEXT);
@@ -687,8 +690,15 @@ callout_table_walk_step(mdb_walk_state_t *wsp)
 		return (WALK_ERR);
 	}
 
-	size = sizeof (callout_hash_t) * CALLOUT_BUCKETS;
 	if (cotwd->ct.ct_idhash != NULL) {
+		size = sizeof (callout_hash_t) *
+		    ((size_t)cotwd->ct.ct_idhash_mask + 1);
+		if (size > cotwd->cot_idsize) {
+			if (cotwd->cot_idhash != NULL)
+				mdb_free(cotwd->cot_idhash, cotwd->cot_idsize);
+			cotwd->cot_idhash = mdb_alloc(size, UM_SLEEP);
+			cotwd->cot_idsize = size;
+		}
 		if (mdb_vread(cotwd->cot_idhash, size,
 		    (uintptr_t)(cotwd->ct.ct_idhash)) != size) {
 			mdb_warn("failed to read id_hash at %p",
@@ -696,6 +706,7 @@ callout_table_walk_step(mdb_walk_state_t *wsp)
 			return (WALK_ERR);
 		}
 	}
+	size = sizeof (callout_hash_t) * CALLOUT_BUCKETS;
 	if (cotwd->ct.ct_clhash != NULL) {
 		if (mdb_vread(&(cotwd->cot_clhash), size,
 		    (uintptr_t)cotwd->ct.ct_clhash) == -1) {
@@ -729,6 +740,10 @@ callout_table_walk_step(mdb_walk_state_t *wsp)
 void
 callout_table_walk_fini(mdb_walk_state_t *wsp)
 {
+	cot_data_t *cotwd = (cot_data_t *)wsp->walk_data;
+
+	if (cotwd->cot_idhash != NULL)
+		mdb_free(cotwd->cot_idhash, cotwd->cot_idsize);
 	mdb_free(wsp->walk_data, sizeof (cot_data_t));
 }
 
@@ -1290,7 +1305,7 @@ callout_t_cb(uintptr_t addr, const void *data, void *priv)
 				return (WALK_ERR);
 			}
 		} else {
-			for (i = 0; i < CALLOUT_BUCKETS; i++) {
+			for (i = 0; i <= ct->ct_idhash_mask; i++) {
 				if (ct->ct_idhash == NULL) {
 					break;
 				}
@@ -1553,7 +1568,7 @@ calloutid(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 	int i, retval;
 	const mdb_arg_t *arg;
 	size_t size;
-	callout_hash_t cot_idhash[CALLOUT_BUCKETS];
+	callout_hash_t *cot_idhash;
 
 	coargs.flags = COF_DEFAULT | COF_BYIDH;
 	i = mdb_getopts(argc, argv,
@@ -1589,7 +1604,6 @@ calloutid(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 #define	callout_table_bits	coargs.ctbits
 #define	nsec_per_tick		coargs.nsec_per_tick
 	tableid = CALLOUT_ID_TO_TABLE(xid);
-	idhash = CALLOUT_IDHASH(xid);
 #undef	callouts_table_bits
 #undef	callout_table_mask
 #undef	nsec_per_tick
@@ -1600,6 +1614,14 @@ calloutid(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		return (DCMD_USAGE);
 	}
 
+	/* get our table. Note this relies on the types being correct */
+	ctptr = coargs.co_table + tableid;
+	if (mdb_vread(&ct, sizeof (callout_table_t), (uintptr_t)ctptr) == -1) {
+		mdb_warn("failed to read callout_table at %p", ctptr);
+		return (DCMD_ERR);
+	}
+	idhash = CALLOUT_IDHASH(&ct, xid);
+
 	if (coargs.flags & COF_DECODE) {
 		if (DCMD_HDRSPEC(flags)) {
 			mdb_printf("%<u>%3s %1s %2s %-?s %-6s %</u>\n",
@@ -1614,15 +1636,11 @@ calloutid(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		return (DCMD_OK);
 	}
 
-	/* get our table. Note this relies on the types being correct */
-	ctptr = coargs.co_table + tableid;
-	if (mdb_vread(&ct, sizeof (callout_table_t), (uintptr_t)ctptr) == -1) {
-		mdb_warn("failed to read callout_table at %p", ctptr);
-		return (DCMD_ERR);
-	}
-	size = sizeof (callout_hash_t) * CALLOUT_BUCKETS;
 	if (ct.ct_idhash != NULL) {
-		if (mdb_vread(&(cot_idhash), size,
+		size = sizeof (callout_hash_t) *
+		    ((size_t)ct.ct_idhash_mask + 1);
+		cot_idhash = mdb_alloc(size, UM_SLEEP | UM_GC);
+		if (mdb_vread(cot_idhash, size,
 		    (uintptr_t)ct.ct_idhash) == -1) {
 			mdb_warn("failed to read id_hash at %p",
 			    ct.ct_idhash);
@@ -983,10 +983,11 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
     void ***maglistp, size_t *magcntp, size_t *magmaxp, int alloc_flags)
 {
 	kmem_magazine_t *kmp, *mp;
+	kmem_maglist_t ml;
 	void **maglist = NULL;
-	int i, cpu;
+	int i, cpu, lgrp, nlgrps = 0;
 	size_t magsize, magmax, magbsize;
-	size_t magcnt = 0;
+	size_t magcnt = 0, lgrp_full = 0;
 
 	/*
 	 * Read the magtype out of the cache, after verifying the pointer's
@@ -1003,16 +1004,32 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 	/*
 	 * There are several places where we need to go buffer hunting:
 	 * the per-CPU loaded magazine, the per-CPU spare full magazine,
-	 * and the full magazine list in the depot.
+	 * and the full magazine lists in the depot.
 	 *
 	 * For an upper bound on the number of buffers in the magazine
 	 * layer, we have the number of magazines on the cache_full
-	 * list plus at most two magazines per CPU (the loaded and the
-	 * spare).  Toss in 100 magazines as a fudge factor in case this
-	 * is live (the number "100" comes from the same fudge factor in
-	 * crash(1M)).
+	 * and per-lgroup lists plus at most two magazines per CPU (the
+	 * loaded and the spare).  Toss in 100 magazines as a fudge factor
+	 * in case this is live (the number "100" comes from the same fudge
+	 * factor in crash(1M)).
 	 */
-	magmax = (cp->cache_full.ml_total + 2 * ncpus + 100) * magsize;
+	if (cp->cache_lgrp_full != NULL &&
+	    mdb_readvar(&nlgrps, "nlgrpsmax") == -1) {
+		mdb_warn("failed to read 'nlgrpsmax'");
+		return (WALK_ERR);
+	}
+	for (lgrp = 0; lgrp < nlgrps; lgrp++) {
+		if (mdb_vread(&ml, sizeof (ml),
+		    (uintptr_t)&cp->cache_lgrp_full[lgrp]) == -1) {
+			mdb_warn("couldn't read lgroup %d magazine list "
+			    "for cache %p", lgrp, addr);
+			return (WALK_ERR);
+		}
+		lgrp_full += ml.ml_total;
+	}
+
+	magmax = (cp->cache_full.ml_total + lgrp_full + 2 * ncpus + 100) *
+	    magsize;
 	magbsize = offsetof(kmem_magazine_t, mag_round[magsize]);
 
 	if (magbsize >= PAGESIZE / 2) {
@@ -1039,6 +1056,24 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 
 	dprintf(("cache_full list done\n"));
 
+	for (lgrp = 0; lgrp < nlgrps; lgrp++) {
+		if (mdb_vread(&ml, sizeof (ml),
+		    (uintptr_t)&cp->cache_lgrp_full[lgrp]) == -1) {
+			mdb_warn("couldn't read lgroup %d magazine list "
+			    "for cache %p", lgrp, addr);
+			goto fail;
+		}
+		for (kmp = ml.ml_list; kmp != NULL; ) {
+			READMAG_ROUNDS(magsize);
+			kmp = mp->mag_next;
+
+			if (kmp == ml.ml_list)
+				break; /* lgroup list loop detected */
+		}
+	}
+
+	dprintf(("lgroup lists done\n"));
+
 	/*
 	 * Now whip through the CPUs, snagging the loaded magazines
 	 * and full spares.
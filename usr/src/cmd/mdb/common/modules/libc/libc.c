@@ -697,11 +697,12 @@ d_ulwp(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 	    prt_addr((void *)(addr + OFFSET(ul_spinlock)), 1),
 	    prt_addr((void *)(addr + OFFSET(ul_fpuenv)), 0));
 
-	HD("tmem.size             &tmem.roots");
-	mdb_printf(OFFSTR "%-21H %s\n",
+	HD("tmem.size             tmem.max              &tmem.roots");
+	mdb_printf(OFFSTR "%-21H %-21H %s\n",
 	    OFFSET(ul_tmem),
 	    ulwp.ul_tmem.tm_size,
-	    prt_addr((void *)(addr + OFFSET(ul_tmem) + sizeof (size_t)), 0));
+	    ulwp.ul_tmem.tm_max,
+	    prt_addr((void *)(addr + OFFSET(ul_tmem.tm_roots)), 0));
 
 	return (DCMD_OK);
 }
@@ -53,7 +53,10 @@ static datafmt_t ptcfmt[] = {
 	{ "   ",	"tid",		"---",		"%3u "		},
 	{ " memory",	" cached",	"-------",	"%7lH "		},
 	{ "  %",	"cap",		"---",		"%3u "		},
-	{ "  %",	NULL,		"---",		"%3u "		},
+	{ " memory",	" budget",	"-------",	"%7lH "		},
+	{ "alloc",	"hit %",	"-----",	"%5s "		},
+	{ " free",	"hit %",	"-----",	"%5s "		},
+	{ "    %",	NULL,		"-----",	"%5u "		},
 	{ NULL,		NULL,		NULL,		NULL		}
 };
 
@@ -137,7 +140,7 @@ umastat_cache_hdr(uintptr_t addr, const umem_cache_t *cp, void *ignored)
 	if (!(cp->cache_flags & UMF_PTC))
 		return (WALK_NEXT);
 
-	mdb_printf("%3d ", cp->cache_bufsize);
+	mdb_printf("%5d ", cp->cache_bufsize);
 	return (WALK_NEXT);
 }
 
@@ -168,28 +171,48 @@ umastat_lwp_cache(uintptr_t addr, const umem_cache_t *cp, ulwp_t *ulwp)
 		return (WALK_ERR);
 	}
 
-	mdb_printf("%3d ", ulwp->ul_tmem.tm_size ?
+	mdb_printf("%5d ", ulwp->ul_tmem.tm_size ?
 	    (nbufs * cp->cache_bufsize * 100) / ulwp->ul_tmem.tm_size : 0);
 
 	return (WALK_NEXT);
 }
 
+/*
+ * Format the percentage of hit in hit + miss, or "-" if there were neither.
+ */
+static const char *
+umastat_hitrate(char *buf, size_t len, uint64_t hit, uint64_t miss)
+{
+	if (hit + miss == 0)
+		return ("-");
+
+	(void) mdb_snprintf(buf, len, "%llu", (hit * 100) / (hit + miss));
+	return (buf);
+}
+
 /*ARGSUSED*/
 static int
 umastat_lwp(uintptr_t addr, const ulwp_t *ulwp, void *ignored)
 {
 	size_t size;
 	datafmt_t *dfp = ptcfmt;
+	const tumem_t *tm = &ulwp->ul_tmem;
+	char buf[8];
 
 	mdb_printf((dfp++)->fmt, ulwp->ul_lwpid);
-	mdb_printf((dfp++)->fmt, ulwp->ul_tmem.tm_size);
+	mdb_printf((dfp++)->fmt, tm->tm_size);
 
 	if (umem_readvar(&size, "umem_ptc_size") == -1) {
 		mdb_warn("unable to read 'umem_ptc_size'");
 		return (WALK_ERR);
 	}
 
-	mdb_printf((dfp++)->fmt, (ulwp->ul_tmem.tm_size * 100) / size);
+	mdb_printf((dfp++)->fmt, (tm->tm_size * 100) / size);
+	mdb_printf((dfp++)->fmt, tm->tm_max);
+	mdb_printf((dfp++)->fmt,
+	    umastat_hitrate(buf, sizeof (buf), tm->tm_ahit, tm->tm_amiss));
+	mdb_printf((dfp++)->fmt,
+	    umastat_hitrate(buf, sizeof (buf), tm->tm_fhit, tm->tm_fmiss));
 
 	if (mdb_walk("umem_cache",
 	    (mdb_walk_cb_t)umastat_lwp_cache, (void *)ulwp) == -1) {
@@ -328,6 +328,67 @@ typedef struct umem_debug_flags {
 	uint_t		udf_clear;	/* if 0, uses udf_flags */
 } umem_debug_flags_t;
 
+typedef struct umem_ptc_stat {
+	uint64_t ups_ahit;
+	uint64_t ups_amiss;
+	uint64_t ups_fhit;
+	uint64_t ups_fmiss;
+} umem_ptc_stat_t;
+
+/*ARGSUSED*/
+static int
+umem_ptc_stat(uintptr_t addr, const ulwp_t *ulwp, umem_ptc_stat_t *ups)
+{
+	ups->ups_ahit += ulwp->ul_tmem.tm_ahit;
+	ups->ups_amiss += ulwp->ul_tmem.tm_amiss;
+	ups->ups_fhit += ulwp->ul_tmem.tm_fhit;
+	ups->ups_fmiss += ulwp->ul_tmem.tm_fmiss;
+	return (WALK_NEXT);
+}
+
+static uint64_t
+umem_ptc_rate(uint64_t hit, uint64_t miss)
+{
+	return (hit + miss == 0 ? 0 : (hit * 100) / (hit + miss));
+}
+
+/*
+ * Report whether per-thread caching is on and how well it is doing across
+ * the threads that are still alive.
+ */
+static void
+umem_ptc_status(void)
+{
+	int umem_ptc_enabled;
+	size_t umem_ptc_size, umem_ptc_limit;
+	umem_ptc_stat_t ups;
+
+	if (UMEM_READVAR(umem_ptc_enabled) || UMEM_READVAR(umem_ptc_size) ||
+	    UMEM_READVAR(umem_ptc_limit))
+		return;
+
+	mdb_printf("Thread caching:\t");
+	if (!umem_ptc_enabled) {
+		mdb_printf("disabled\n");
+		return;
+	}
+
+	bzero(&ups, sizeof (ups));
+	if (mdb_walk("ulwp", (mdb_walk_cb_t)umem_ptc_stat, &ups) == -1) {
+		mdb_warn("can't walk 'ulwp'");
+		return;
+	}
+
+	mdb_printf("%lH per thread, buffers to %lH\n",
+	    umem_ptc_size, umem_ptc_limit);
+	mdb_printf("\t\talloc %llu hit %llu miss (%llu%%), "
+	    "free %llu hit %llu miss (%llu%%)\n",
+	    ups.ups_ahit, ups.ups_amiss,
+	    umem_ptc_rate(ups.ups_ahit, ups.ups_amiss),
+	    ups.ups_fhit, ups.ups_fmiss,
+	    umem_ptc_rate(ups.ups_fhit, ups.ups_fmiss));
+}
+
 umem_debug_flags_t umem_status_flags[] = {
 	{ "random",	UMF_RANDOMIZE,	UMF_RANDOM },
 	{ "default",	UMF_AUDIT | UMF_DEADBEEF | UMF_REDZONE | UMF_CONTENTS },
@@ -384,6 +445,8 @@ umem_status(uintptr_t addr, uint_t flags, int ac, const mdb_arg_t *argv)
 		mdb_printf("(inactive)");
 	mdb_printf("\n");
 
+	umem_ptc_status();
+
 	mdb_printf("Message buffer:\n");
 	return (umem_abort_messages());
 
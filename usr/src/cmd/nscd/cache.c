@@ -47,6 +47,7 @@
 #include <string.h>
 #include <umem.h>
 #include <fcntl.h>
+#include <atomic.h>
 #include "cache.h"
 #include "nscd_door.h"
 #include "nscd_log.h"
@@ -61,6 +62,8 @@
 #define	CONTINUE	-4
 
 static nsc_db_t *nsc_get_db(nsc_ctx_t *, int);
+static nsc_db_t *nsc_get_shard(nsc_db_t *, nss_XbyY_key_t *);
+static void shard_cache_ctx(nsc_ctx_t *);
 static nscd_rc_t lookup_cache(nsc_lookup_args_t *, nscd_cfg_cache_t *,
 		nss_XbyY_args_t *, char *, nsc_entry_t **);
 static uint_t reap_cache(nsc_ctx_t *, uint_t, uint_t);
@@ -279,6 +282,58 @@ nsc_get_db(nsc_ctx_t *ctx, int dbop) {
 	return (NULL);
 }
 
+/*
+ * Returns the shard of a cache that holds the entry for key
+ */
+static nsc_db_t *
+nsc_get_shard(nsc_db_t *nscdb, nss_XbyY_key_t *key) {
+	uint_t	hash;
+
+	if (nscdb->nshards <= 1)
+		return (nscdb);
+
+	hash = nscdb->gethash(key, _NSC_SHARD_HASH_SIZE) * 2654435761U;
+	return (nscdb->shards[(hash >> 16) % nscdb->nshards]);
+}
+
+/*
+ * Split each of the caches the init_ctx routine of a context created into
+ * _NSC_DB_SHARDS shards.  The shards of a cache are kept next to each other
+ * in nsc_db[], so that everything that walks nsc_db[] (reaper, revalidation,
+ * invalidation) walks all of them.  A cache gets fewer shards if memory runs
+ * short, or only itself if it has no hash function.
+ */
+static void
+shard_cache_ctx(nsc_ctx_t *ctx) {
+	nsc_db_t	*db[_NSC_MAX_DB], *nscdb;
+	int		ndb = ctx->db_count;
+	int		i, j, k, first;
+
+	(void) memcpy(db, ctx->nsc_db, sizeof (db));
+
+	for (i = 0, k = 0; i < ndb; i++) {
+		if ((nscdb = db[i]) == NULL)
+			continue;
+		first = k;
+		ctx->nsc_db[k++] = nscdb;
+		for (j = 1; j < _NSC_DB_SHARDS && nscdb->gethash != NULL;
+		    j++) {
+			ctx->nsc_db[k] = make_cache(nscdb->db_type,
+			    nscdb->dbop, nscdb->name, nscdb->compar,
+			    nscdb->getlogstr, nscdb->gethash,
+			    nscdb->hash_type, nscdb->htsize);
+			if (ctx->nsc_db[k] == NULL)
+				break;
+			k++;
+		}
+		for (j = first; j < k; j++) {
+			ctx->nsc_db[j]->shards = &ctx->nsc_db[first];
+			ctx->nsc_db[j]->nshards = k - first;
+		}
+	}
+	ctx->db_count = k;
+}
+
 
 /*
  * integer compare routine for _NSC_DB_INT_KEY
@@ -895,6 +950,35 @@ _nscd_cfg_cache_notify(
 }
 
 
+/*
+ * Collect the statistics of a context: the lookup counters are kept by each
+ * shard under its db_mutex, which is held where they are updated anyway.
+ */
+void
+nsc_get_stats(nsc_ctx_t *ctx, nscd_cfg_stat_cache_t *statsp)
+{
+	nsc_db_t	*nscdb;
+	int		i;
+
+	(void) mutex_lock(&ctx->stats_mutex);
+	*statsp = ctx->stats;
+	(void) mutex_unlock(&ctx->stats_mutex);
+
+	for (i = 0; i < ctx->db_count; i++) {
+		if ((nscdb = ctx->nsc_db[i]) == NULL)
+			continue;
+		(void) mutex_lock(&nscdb->db_mutex);
+		statsp->pos_hits += nscdb->stats.pos_hits;
+		statsp->neg_hits += nscdb->stats.neg_hits;
+		statsp->pos_misses += nscdb->stats.pos_misses;
+		statsp->neg_misses += nscdb->stats.neg_misses;
+		statsp->drop_count += nscdb->stats.drop_count;
+		statsp->wait_count += nscdb->stats.wait_count;
+		(void) mutex_unlock(&nscdb->db_mutex);
+	}
+}
+
+
 /*
  * get stat
  */
@@ -921,12 +1005,8 @@ _nscd_cfg_cache_get_stat(
 		for (i = 0; i < CACHE_CTX_COUNT; i++) {
 			if (cache_ctx_p[i] == NULL)
 				stats = null_stats;
-			else {
-				(void) mutex_lock(&cache_ctx_p[i]->stats_mutex);
-				stats = cache_ctx_p[i]->stats;
-				(void) mutex_unlock(
-				    &cache_ctx_p[i]->stats_mutex);
-			}
+			else
+				nsc_get_stats(cache_ctx_p[i], &stats);
 			statsp->pos_hits += stats.pos_hits;
 			statsp->neg_hits += stats.neg_hits;
 			statsp->pos_misses += stats.pos_misses;
@@ -942,9 +1022,7 @@ _nscd_cfg_cache_get_stat(
 			free(statsp);
 			return (rc);
 		}
-		(void) mutex_lock(&ctx->stats_mutex);
-		*statsp = ctx->stats;
-		(void) mutex_unlock(&ctx->stats_mutex);
+		nsc_get_stats(ctx, statsp);
 	}
 
 	_NSC_GET_HITRATE(statsp);
@@ -1029,9 +1107,7 @@ ctx_info(nsc_ctx_t *ctx) {
 	if (cfg.enable == nscd_false)
 		return;
 
-	(void) mutex_lock(&ctx->stats_mutex);
-	stats = ctx->stats;
-	(void) mutex_unlock(&ctx->stats_mutex);
+	nsc_get_stats(ctx, &stats);
 	(void) print_stats(&stats);
 }
 
@@ -1081,11 +1157,13 @@ nsc_dump(char *dbname, int dbop)
 		return (NSCD_CACHE_NO_CACHE_FOUND);
 	}
 
-	(void) mutex_lock(&nscdb->db_mutex);
-	(void) queue_dump(nscdb, now);
-	(void) hash_dump(nscdb, now);
-	(void) avl_dump(nscdb, now);
-	(void) mutex_unlock(&nscdb->db_mutex);
+	for (i = 0; i < nscdb->nshards; i++) {
+		(void) mutex_lock(&nscdb->shards[i]->db_mutex);
+		(void) queue_dump(nscdb->shards[i], now);
+		(void) hash_dump(nscdb->shards[i], now);
+		(void) avl_dump(nscdb->shards[i], now);
+		(void) mutex_unlock(&nscdb->shards[i]->db_mutex);
+	}
 	return (NSCD_SUCCESS);
 }
 #endif	/* NSCD_DEBUG */
@@ -1400,7 +1478,8 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 		}
 	}
 
-	nscdb = largs->nscdb;
+	/* only the shard that holds the key is locked */
+	nscdb = largs->nscdb = nsc_get_shard(largs->nscdb, &args.key);
 
 	_NSCD_LOG_IF(NSCD_LOG_CACHE, NSCD_LOG_LEVEL_ALL) {
 		(void) nscdb->getlogstr(nscdb->name, whoami,
@@ -1500,9 +1579,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 			/* do we have clearance ? */
 			if (_nscd_get_clearance(&ctx->throttle_sema) != 0) {
 				/* nope. quit */
-				(void) mutex_lock(&ctx->stats_mutex);
-				ctx->stats.drop_count++;
-				(void) mutex_unlock(&ctx->stats_mutex);
+				nscdb->stats.drop_count++;
 				_NSCD_LOG(NSCD_LOG_CACHE,
 				    NSCD_LOG_LEVEL_DEBUG_6)
 				(me, "%s: throttling load\n", whoami);
@@ -1534,9 +1611,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 				delete_entry(nscdb, ctx, this_entry);
 			else
 				this_stats->status = ST_DISCARD;
-			(void) mutex_lock(&ctx->stats_mutex);
-			ctx->stats.drop_count++;
-			(void) mutex_unlock(&ctx->stats_mutex);
+			nscdb->stats.drop_count++;
 			(void) mutex_unlock(&nscdb->db_mutex);
 			NSC_LOOKUP_LOG(WARNING,
 			    "%s: no clearance for lookup\n");
@@ -1595,9 +1670,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 
 			/* update +ve miss count */
 			if (!(UPDATEBIT & flag)) {
-				(void) mutex_lock(&ctx->stats_mutex);
-				ctx->stats.pos_misses++;
-				(void) mutex_unlock(&ctx->stats_mutex);
+				nscdb->stats.pos_misses++;
 			}
 
 			/* update +ve ttl */
@@ -1661,9 +1734,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 
 			/* update -ve miss count */
 			if (!(UPDATEBIT & flag)) {
-				(void) mutex_lock(&ctx->stats_mutex);
-				ctx->stats.neg_misses++;
-				(void) mutex_unlock(&ctx->stats_mutex);
+				nscdb->stats.neg_misses++;
 			}
 
 			/*
@@ -1710,9 +1781,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 		if (NSCD_GET_STATUS((nss_pheader_t *)this_entry->buffer) ==
 		    NSS_SUCCESS) {
 			/* positive hit */
-			(void) mutex_lock(&ctx->stats_mutex);
-			ctx->stats.pos_hits++;
-			(void) mutex_unlock(&ctx->stats_mutex);
+			nscdb->stats.pos_hits++;
 
 			/* update response buffer */
 			if (copy_result(largs->buffer,
@@ -1729,9 +1798,7 @@ lookup_int(nsc_lookup_args_t *largs, int flag)
 			return (SUCCESS);
 		} else {
 			/* negative hit */
-			(void) mutex_lock(&ctx->stats_mutex);
-			ctx->stats.neg_hits++;
-			(void) mutex_unlock(&ctx->stats_mutex);
+			nscdb->stats.neg_hits++;
 
 			NSCD_SET_STATUS((nss_pheader_t *)largs->buffer,
 			    NSCD_GET_STATUS(this_entry->buffer),
@@ -1807,6 +1874,7 @@ init_cache_ctx(int i) {
 	(void) mutex_init(&ctx->stats_mutex, USYNC_THREAD, NULL);
 	(void) _nscd_init_cache_sema(&ctx->throttle_sema, cache_name[i]);
 	cache_init_ctx[i](ctx);
+	shard_cache_ctx(ctx);
 	cache_ctx_p[i] = ctx;
 
 	return (ctx);
@@ -1817,7 +1885,7 @@ static void
 revalidate(nsc_ctx_t *ctx)
 {
 	for (;;) {
-		int 		i, slp, interval, count;
+		int 		i, slp, interval, count, nshards;
 
 		(void) rw_rdlock(&ctx->cfg_rwlp);
 		slp = ctx->cfg.pos_ttl;
@@ -1831,9 +1899,11 @@ revalidate(nsc_ctx_t *ctx)
 			if (interval == 0)
 				interval = 1;
 			(void) sleep(slp*2/3);
+			/* the keep hot entries are shared among the shards */
 			for (i = 0; i < ctx->db_count; i++) {
+				nshards = ctx->nsc_db[i]->nshards;
 				getxy_keepalive(ctx, ctx->nsc_db[i],
-				    count, interval);
+				    (count + nshards - 1) / nshards, interval);
 			}
 		} else {
 			(void) sleep(slp);
@@ -2061,9 +2131,7 @@ delete_entry(nsc_db_t *nscdb, nsc_ctx_t *ctx, nsc_entry_t *entry) {
 		entry->buffer = NULL;
 	}
 	umem_cache_free(nsc_entry_cache, entry);
-	(void) mutex_lock(&ctx->stats_mutex);
-	ctx->stats.entries--;
-	(void) mutex_unlock(&ctx->stats_mutex);
+	atomic_dec_ulong(&ctx->stats.entries);
 }
 
 
@@ -2150,9 +2218,7 @@ lookup_cache(nsc_lookup_args_t *largs, nscd_cfg_cache_t *cfgp,
 		nscdb->htable[hash] = *entry;
 	(*entry)->stats.status = ST_NEW_ENTRY;
 
-	(void) mutex_lock(&ctx->stats_mutex);
-	nentries = ++(ctx->stats.entries);
-	(void) mutex_unlock(&ctx->stats_mutex);
+	nentries = atomic_inc_ulong_nv(&ctx->stats.entries);
 
 	/* Have we exceeded max entries ? */
 	if (cfgp->maxentries > 0 && nentries > cfgp->maxentries) {
@@ -2194,8 +2260,15 @@ reaper(nsc_ctx_t *ctx)
 		nsc_entries = ctx->stats.entries;
 		(void) mutex_unlock(&ctx->stats_mutex);
 
+		/*
+		 * Reap at the pace of the shorter of the two ttls, so that
+		 * expired negative entries don't sit in the cache for up to
+		 * a positive ttl, pushing live entries out of it.
+		 */
 		(void) rw_rdlock(&ctx->cfg_rwlp);
 		ttl = ctx->cfg.pos_ttl;
+		if (ctx->cfg.neg_ttl > 0 && ctx->cfg.neg_ttl < ttl)
+			ttl = ctx->cfg.neg_ttl;
 		(void) rw_unlock(&ctx->cfg_rwlp);
 
 		if (nsc_entries == 0) {
@@ -84,6 +84,16 @@ extern "C" {
 #define	_NSC_PUBLIC_ACCESS	-1
 #define	_NSC_FILE_CHECK_TIME	0	/* check always for backwards compat */
 
+/*
+ * Each cache is split into _NSC_DB_SHARDS independent shards, each with its
+ * own tree, hash table, LRU queue and lock, so that lookups of different keys
+ * don't all serialize on one db_mutex.  Keys are assigned to shards by their
+ * gethash() value modulo _NSC_SHARD_HASH_SIZE, scrambled so that the shard
+ * doesn't determine the hash table slot within the shard.
+ */
+#define	_NSC_DB_SHARDS		8
+#define	_NSC_SHARD_HASH_SIZE	262147
+
 /*
  * Macros used for logging purposes
  */
@@ -271,12 +281,21 @@ typedef struct nsc_db {
 	 */
 	nscd_cfg_cache_t	cfg;
 	time_t			cfg_mtime;
+	/*
+	 * Shards of the same cache, including this one
+	 */
+	struct nsc_db		**shards;
+	int			nshards;
+	/*
+	 * Lookup statistics for this shard, protected by db_mutex
+	 */
+	nscd_cfg_stat_cache_t	stats;
 } nsc_db_t;
 
 
 typedef struct nsc_ctx {
 	char 		*dbname;		/* cache name */
-	nscd_cfg_stat_cache_t	stats;		/* statistics */
+	nscd_cfg_stat_cache_t	stats;		/* see nsc_get_stats() */
 	nscd_cfg_cache_t	cfg;		/* configs */
 	time_t		cfg_mtime;		/* config last modified time */
 	rwlock_t	cfg_rwlp;		/* config rwlock */
@@ -287,8 +306,8 @@ typedef struct nsc_ctx {
 	off_t		file_size;		/* file size at last check */
 	ino_t		file_ino;		/* file inode at last check */
 	const char 	*file_name;		/* filename for check_files */
-	int		db_count;	/* number of caches, max _NSC_MAX_DB */
-	nsc_db_t 	*nsc_db[_NSC_MAX_DB];	/* caches */
+	int		db_count;	/* number of caches, then of shards */
+	nsc_db_t 	*nsc_db[_NSC_MAX_DB * _NSC_DB_SHARDS];	/* shards */
 	sema_t		throttle_sema;		/* throttle lookups */
 	sema_t		revalidate_sema;	/* revalidation threads */
 	nscd_bool_t	revalidate_on;		/* reval. thread started */
@@ -343,6 +362,7 @@ extern void nsc_lookup(nsc_lookup_args_t *, int);
 /* Cache backend info */
 extern void nsc_info(nsc_ctx_t *, char *, nscd_cfg_cache_t cfg[],
 		nscd_cfg_stat_cache_t stats[]);
+extern void nsc_get_stats(nsc_ctx_t *, nscd_cfg_stat_cache_t *);
 #ifdef NSCD_DEBUG
 extern int nsc_dump(char *, int);
 #endif	/* NSCD_DEBUG */
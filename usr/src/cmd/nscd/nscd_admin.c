@@ -65,9 +65,7 @@ _nscd_door_getadmin(void *outbuf)
 			admin_c.cache_cfg[i] = cache_ctx_p[i]->cfg;
 			(void) rw_unlock(&cache_ctx_p[i]->cfg_rwlp);
 
-			(void) mutex_lock(&cache_ctx_p[i]->stats_mutex);
-			admin_c.cache_stats[i] = cache_ctx_p[i]->stats;
-			(void) mutex_unlock(&cache_ctx_p[i]->stats_mutex);
+			nsc_get_stats(cache_ctx_p[i], &admin_c.cache_stats[i]);
 		} else {
 			admin_c.cache_cfg[i] = cfg_default;
 			(void) memset(&admin_c.cache_stats[i], 0,
@@ -31,6 +31,7 @@
  */
 #include "cache.h"
 
+/* ARGSUSED */
 int
 nscd_wait(nsc_ctx_t *ctx, nsc_db_t *nscdb, nsc_entry_t *entry)
 {
@@ -46,9 +47,7 @@ nscd_wait(nsc_ctx_t *ctx, nsc_db_t *nscdb, nsc_entry_t *entry)
 		mywait.w_next->w_prev = &mywait;
 	wchan->w_next = &mywait;
 
-	(void) mutex_lock(&ctx->stats_mutex);
-	ctx->stats.wait_count++;
-	(void) mutex_unlock(&ctx->stats_mutex);
+	nscdb->stats.wait_count++;
 
 	while (!mywait.w_signaled)
 		(void) cond_wait(&(mywait.w_waitcv), &nscdb->db_mutex);
@@ -59,6 +58,7 @@ nscd_wait(nsc_ctx_t *ctx, nsc_db_t *nscdb, nsc_entry_t *entry)
 	return (0);
 }
 
+/* ARGSUSED */
 int
 nscd_signal(nsc_ctx_t *ctx, nsc_db_t *nscdb, nsc_entry_t *entry)
 {
@@ -71,9 +71,7 @@ nscd_signal(nsc_ctx_t *ctx, nsc_db_t *nscdb, nsc_entry_t *entry)
 			(void) cond_signal(&(tmp->w_waitcv));
 			tmp->w_signaled = 1;
 
-			(void) mutex_lock(&ctx->stats_mutex);
-			ctx->stats.wait_count--;
-			(void) mutex_unlock(&ctx->stats_mutex);
+			nscdb->stats.wait_count--;
 			c++;
 		}
 		tmp = tmp->w_next;
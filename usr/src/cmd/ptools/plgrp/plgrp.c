@@ -28,7 +28,8 @@
 
 /*
  * The plgrp utility allows a user to display and modify the home lgroup and
- * lgroup affinities of the specified threads
+ * lgroup affinities of the specified threads, and to see how well the
+ * memory of a process lines up with the home lgroups of its threads
  */
 
 #include <ctype.h>
@@ -43,6 +44,7 @@
 #include <unistd.h>
 #include <libgen.h>
 #include <sys/lgrp_user.h>
+#include <sys/mman.h>
 
 
 /*
@@ -66,6 +68,7 @@
 #define	HDR_PLGRP_AFF_SET	"     PID/LWPID    HOME       AFFINITY\n"
 #define	HDR_PLGRP_HOME_GET	"     PID/LWPID    HOME\n"
 #define	HDR_PLGRP_HOME_SET	"     PID/LWPID    HOME\n"
+#define	HDR_PLGRP_MEM_GET	"     PID    LGRP  THREADS        RSS  LOCAL\n"
 
 /*
  * Part of the HDR_PLGRP_AFF_SET header used to calculate space needed to
@@ -78,6 +81,8 @@
 #define	FMT_HOME		"%-6d"
 #define	FMT_NEWHOME		"%d => %d"
 #define	FMT_THREAD		"%8d/%-8d"
+#define	FMT_MEM			"%8d    %-6d %7d %9lluK\n"
+#define	FMT_MEM_TOTAL		"%8d    %-6s %7d %9lluK %5.1f%%\n"
 
 /*
  * How much to allocate for lgroup bitmap array as it grows
@@ -120,6 +125,7 @@ typedef enum plgrp_ops {
 	PLGRP_AFFINITY_SET,
 	PLGRP_HOME_GET,
 	PLGRP_HOME_SET,
+	PLGRP_MEM_GET,
 	PLGRP_NO_OP
 } plgrp_ops_t;
 
@@ -136,6 +142,8 @@ typedef struct plgrp_args {
 	int			nelements;	/* number of elements */
 	int			index;		/* index */
 	int			nthreads;	/* threads processed */
+	int			*homes;		/* threads homed per lgroup */
+	uint64_t		*rss;		/* resident bytes per lgroup */
 	plgrp_ops_t		op;		/* operation */
 } plgrp_args_t;
 
@@ -199,6 +207,8 @@ usage(int rc)
 	    " <pid>[/lwps] ...\n"), progname);
 	(void) fprintf(stderr,
 	    gettext("\t%s [-F] -H <lgroup list> <pid>[/lwps] ...\n"), progname);
+	(void) fprintf(stderr,
+	    gettext("\t%s [-F] -m <pid>[/lwps] ...\n"), progname);
 	(void) fprintf(stderr,
 	    gettext("\n\twhere <lgroup list> is a comma separated list of\n"
 		"\tone or more of the following:\n\n"
@@ -652,6 +662,10 @@ print_heading(plgrp_ops_t op)
 		(void) printf(HDR_PLGRP_HOME_SET);
 		break;
 
+	case PLGRP_MEM_GET:
+		(void) printf(HDR_PLGRP_MEM_GET);
+		break;
+
 	default:
 		break;
 	}
@@ -1229,6 +1243,16 @@ Plwp_iter_handler(void *arg, const lwpstatus_t *lwpstatus,
 
 	plgrp_args->nthreads++;
 
+	/*
+	 * Memory locality is reported per process, so just count the
+	 * threads homed in each lgroup for now
+	 */
+	if (plgrp_args->op == PLGRP_MEM_GET) {
+		if (lwpsinfo->pr_lgrp >= 0 && lwpsinfo->pr_lgrp < NLGRPS)
+			plgrp_args->homes[lwpsinfo->pr_lgrp]++;
+		return (0);
+	}
+
 	/*
 	 * Do all plgrp(1) operations specified on given thread
 	 */
@@ -1236,6 +1260,97 @@ Plwp_iter_handler(void *arg, const lwpstatus_t *lwpstatus,
 	return (do_op(plgrp_args, pstatus->pr_pid, lwpid, lwpsinfo));
 }
 
+/*
+ * Routine called by Pmapping_iter() to add up the resident memory of a
+ * mapping in each lgroup, using meminfo(2) from the agent LWP
+ */
+/* ARGSUSED */
+static int
+Pmapping_mem_handler(void *arg, const prmap_t *pmp, const char *object_name)
+{
+	uint64_t	addrs[MAX_MEMINFO_CNT];
+	uint64_t	lgrps[MAX_MEMINFO_CNT];
+	uint_t		validity[MAX_MEMINFO_CNT];
+	uint_t		info = MEMINFO_VLGRP;
+	uintptr_t	addr;
+	uintptr_t	end;
+	size_t		pgsz;
+	int		i;
+	int		n;
+	plgrp_args_t	*plgrp_args = arg;
+
+	pgsz = pmp->pr_pagesize;
+	end = pmp->pr_vaddr + pmp->pr_size;
+	for (addr = pmp->pr_vaddr; addr < end; ) {
+		if (interrupt)
+			return (1);
+
+		for (n = 0; n < MAX_MEMINFO_CNT && addr < end; n++) {
+			addrs[n] = addr;
+			addr += pgsz;
+		}
+
+		if (pr_meminfo(plgrp_args->Ph, addrs, n, &info, 1, lgrps,
+		    validity) < 0)
+			return (-1);
+
+		/*
+		 * Bit 0 of validity says the address is mapped to memory,
+		 * bit 1 that its lgroup was returned
+		 */
+		for (i = 0; i < n; i++) {
+			if ((validity[i] & 3) == 3 && lgrps[i] < NLGRPS)
+				plgrp_args->rss[lgrps[i]] += pgsz;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Print how much of the resident memory of a process is in each lgroup,
+ * along with how many of its threads are homed there, and what share of
+ * the memory is in lgroups that are home to at least one of its threads
+ */
+static void
+print_mem(plgrp_args_t *plgrp_args)
+{
+	uint64_t	local;
+	int		nthreads;
+	pid_t		pid;
+	uint64_t	total;
+	int		i;
+
+	pid = Pstatus(plgrp_args->Ph)->pr_pid;
+
+	if (Pmapping_iter(plgrp_args->Ph, Pmapping_mem_handler,
+	    plgrp_args) != 0) {
+		if (!interrupt) {
+			(void) fprintf(stderr,
+			    gettext("%s: cannot get memory information for"
+			    " process %d\n"), progname, (int)pid);
+			nerrors++;
+		}
+		return;
+	}
+
+	local = total = 0;
+	nthreads = 0;
+	for (i = 0; i < NLGRPS; i++) {
+		if (plgrp_args->homes[i] == 0 && plgrp_args->rss[i] == 0)
+			continue;
+		(void) printf(FMT_MEM, (int)pid, i, plgrp_args->homes[i],
+		    (u_longlong_t)plgrp_args->rss[i] / 1024);
+		total += plgrp_args->rss[i];
+		nthreads += plgrp_args->homes[i];
+		if (plgrp_args->homes[i] != 0)
+			local += plgrp_args->rss[i];
+	}
+	(void) printf(FMT_MEM_TOTAL, (int)pid, LGRP_ALL_STR,
+	    nthreads, (u_longlong_t)total / 1024,
+	    total == 0 ? 100.0 : (double)local * 100 / total);
+}
+
 /*
  * Get target process specified in "pidstring" argument to do operation(s)
  * specified in "plgrp_todo" using /proc and agent LWP
@@ -1277,6 +1392,19 @@ do_process(char *pidstring, plgrp_args_t *plgrp_todo, int force)
 	plgrp_todo->Ph = Ph;
 	plgrp_todo->lwps = lwps;
 
+	if (plgrp_todo->op == PLGRP_MEM_GET) {
+		if (Pstate(Ph) == PS_DEAD) {
+			(void) fprintf(stderr,
+			    gettext("%s: -m needs a live process: %s\n"),
+			    progname, pidstring);
+			nerrors++;
+			Prelease(Ph, PRELEASE_RETAIN);
+			return;
+		}
+		bzero(plgrp_todo->homes, NLGRPS * sizeof (int));
+		bzero(plgrp_todo->rss, NLGRPS * sizeof (uint64_t));
+	}
+
 	/*
 	 * Iterate over LWPs in process and do specified
 	 * operation(s) on those specified
@@ -1288,6 +1416,9 @@ do_process(char *pidstring, plgrp_args_t *plgrp_todo, int force)
 		nerrors++;
 	}
 
+	if (plgrp_todo->op == PLGRP_MEM_GET && !interrupt)
+		print_mem(plgrp_todo);
+
 	Prelease(Ph, PRELEASE_RETAIN);
 }
 
@@ -1301,6 +1432,7 @@ do_process(char *pidstring, plgrp_args_t *plgrp_todo, int force)
  *	plgrp [-F] -a <lgroup>,... <pid>[/lwps] ...
  *	plgrp [-F] -H <lgroup>,... <pid>[/lwps] ...
  *	plgrp [-F] -A <lgroup>,... [/none|weak|strong] ... <pid>[/lwps] ...
+ *	plgrp [-F] -m <pid>[/lwps] ...
  *
  *	where <lgroup> is an lgroup ID, "all", "root", "leaves".
  */
@@ -1373,7 +1505,7 @@ main(int argc, char *argv[])
 	 */
 	opterr = 0;
 	Fflag = 0;
-	while (!interrupt && (c = getopt(argc, argv, "a:A:FhH:")) != -1) {
+	while (!interrupt && (c = getopt(argc, argv, "a:A:FhH:m")) != -1) {
 		/*
 		 * Parse option and only allow one option besides -F to be
 		 * specified
@@ -1547,6 +1679,25 @@ main(int argc, char *argv[])
 
 			break;
 
+		case 'm':	/* Get memory locality */
+			/*
+			 * Only allow one option (besides -F) to be specified
+			 */
+			if (opt_seen)
+				usage(EXIT_FAILURE);
+			opt_seen = 1;
+
+			plgrp_todo.op = PLGRP_MEM_GET;
+			plgrp_todo.homes = calloc(NLGRPS, sizeof (int));
+			plgrp_todo.rss = calloc(NLGRPS, sizeof (uint64_t));
+			if (plgrp_todo.homes == NULL ||
+			    plgrp_todo.rss == NULL) {
+				(void) fprintf(stderr,
+				    gettext("%s: out of memory\n"), progname);
+				return (EXIT_FAILURE);
+			}
+			break;
+
 		case 'F':	/* Force */
 
 			/*
@@ -43,7 +43,8 @@
  *      <segaddr>[:<length>]=<advice>
  *     valid <advice> is one of:
  *      normal, random, sequential, willneed, dontneed,
- *      free, access_lwp, access_many, access_default
+ *      free, access_lwp, access_many, access_interleave,
+ *      access_default
  *  -v: verbose output
  *  -F: force grabbing of the target process(es)
  *  -l: show unresolved dynamic linker map names
@@ -155,10 +156,10 @@
 
 /*
  * Advice that can be passed to madvise fit into three groups that each
- * contain 3 mutually exclusive options.  These groups are defined below:
+ * contain mutually exclusive options.  These groups are defined below:
  *   Group 1: normal, random, sequential
  *   Group 2: willneed, dontneed, free, purge
- *   Group 3: default, accesslwp, accessmany
+ *   Group 3: default, accesslwp, accessmany, accessinterleave
  * Thus, advice that includes (at most) one from each group is valid.
  *
  * The following #define's are used as masks to determine which group(s) a
@@ -170,7 +171,7 @@
 #define	GRP2_ADV	(1 << MADV_WILLNEED | 1 << MADV_DONTNEED | \
 			1 << MADV_FREE | 1 << MADV_PURGE)
 #define	GRP3_ADV	(1 << MADV_ACCESS_DEFAULT | 1 << MADV_ACCESS_LWP | \
-			1 << MADV_ACCESS_MANY)
+			1 << MADV_ACCESS_MANY | 1 << MADV_ACCESS_INTERLEAVE)
 
 static	int	create_maplist(void *, const prmap_t *, const char *);
 static	int	pr_madvise(struct ps_prochandle *, caddr_t, size_t, int);
@@ -256,7 +257,9 @@ static char	*advicestr[] = {
 	"free",
 	"access_default",
 	"access_lwp",
-	"access_many"
+	"access_many",
+	"purge",
+	"access_interleave"
 };
 
 /*
@@ -312,7 +315,8 @@ usage()
 	    "        <segaddr>[:<length>]=<advice>\n"
 	    "       valid <advice> is one of:\n"
 	    "        normal, random, sequential, willneed, dontneed,\n"
-	    "        free, access_lwp, access_many, access_default\n"
+	    "        free, access_lwp, access_many, access_interleave,\n"
+	    "        access_default\n"
 	    "    -v: verbose output\n"
 	    "    -F: force grabbing of the target process(es)\n"
 	    "    -l: show unresolved dynamic linker map names\n"
@@ -338,6 +342,8 @@ get_advice(char *optarg)
 		return (1 << MADV_ACCESS_MANY);
 	else if (strcmp(optarg, "access_lwp") == 0)
 		return (1 << MADV_ACCESS_LWP);
+	else if (strcmp(optarg, "access_interleave") == 0)
+		return (1 << MADV_ACCESS_INTERLEAVE);
 	else if (strcmp(optarg, "sequential") == 0)
 		return (1 << MADV_SEQUENTIAL);
 	else if (strcmp(optarg, "willneed") == 0)
@@ -682,7 +688,8 @@ apply_advice(saddr_t **advicelist)
 		 * with the for loop.
 		 */
 		if (psaddr->adv != NO_ADVICE) {
-			for (i = MADV_NORMAL; i <= MADV_PURGE; i++) {
+			for (i = MADV_NORMAL; i <= MADV_ACCESS_INTERLEAVE;
+			    i++) {
 				if ((psaddr->adv & (1 << i)) &&
 				    (pr_madvise(Pr, (caddr_t)psaddr->addr,
 				    psaddr->length, i) < 0)) {
@@ -904,7 +911,7 @@ advtostr(int adv)
 	*buf = '\0';
 
 	if (adv != NO_ADVICE) {
-		for (i = MADV_NORMAL; i <= MADV_PURGE; i++) {
+		for (i = MADV_NORMAL; i <= MADV_ACCESS_INTERLEAVE; i++) {
 			if (adv & (1 << i)) {
 				/*
 				 * check if it's the first advice entry
@@ -1155,6 +1155,7 @@ dump_dynamic(Elf *elf_file, SCNTAB *p_scns, int num_scns, char *filename)
 			case DT_SUNW_CAP:
 			case DT_SUNW_CAPINFO:
 			case DT_SUNW_CAPCHAIN:
+			case DT_SUNW_BLOOM:
 			case DT_SUNW_SYMTAB:
 			case DT_SUNW_SYMSORT:
 			case DT_SUNW_TLSSORT:
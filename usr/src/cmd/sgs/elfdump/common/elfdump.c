@@ -2935,6 +2935,7 @@ dynamic(Cache *cache, Word shnum, Ehdr *ehdr, uchar_t osabi, const char *file)
 		Cache	*preinit_array;
 		Cache	*rel;
 		Cache	*rela;
+		Cache	*sunw_bloom;
 		Cache	*sunw_cap;
 		Cache	*sunw_capinfo;
 		Cache	*sunw_capchain;
@@ -3033,6 +3034,7 @@ dynamic(Cache *cache, Word shnum, Ehdr *ehdr, uchar_t osabi, const char *file)
 		GRAB(SHT_INIT_ARRAY,	init_array);
 		GRAB(SHT_SUNW_move,	sunw_move);
 		GRAB(SHT_PREINIT_ARRAY,	preinit_array);
+		GRAB(SHT_SUNW_bloom,	sunw_bloom);
 		GRAB(SHT_SUNW_cap,	sunw_cap);
 		GRAB(SHT_SUNW_capinfo,	sunw_capinfo);
 		GRAB(SHT_SUNW_capchain,	sunw_capchain);
@@ -3339,6 +3341,11 @@ dynamic(Cache *cache, Word shnum, Ehdr *ehdr, uchar_t osabi, const char *file)
 					    sunw_capchain);
 				break;
 
+			case DT_SUNW_BLOOM:
+				if (osabi_solaris)
+					TEST_ADDR(SHT_SUNW_bloom, sunw_bloom);
+				break;
+
 			case DT_SUNW_SYMTAB:
 				TEST_ADDR(SHT_SUNW_LDYNSYM, sunw_ldynsym);
 				break;
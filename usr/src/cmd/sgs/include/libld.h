@@ -365,6 +365,7 @@ struct ofl_desc {
 	Os_desc		*ofl_osdyntlssort; /* .SUNW_dyntlssort output section */
 	Os_desc		*ofl_osgot;	/* .got output section */
 	Os_desc		*ofl_oshash;	/* .hash output section */
+	Os_desc		*ofl_osbloom;	/* .SUNW_bloom output section */
 	Os_desc		*ofl_osinitarray; /* .init_array output section */
 	Os_desc		*ofl_osfiniarray; /* .fini_array output section */
 	Os_desc		*ofl_ospreinitarray; /* .preinit_array output section */
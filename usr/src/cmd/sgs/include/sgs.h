@@ -90,6 +90,17 @@ extern const char link_ver_string[];
 #define	S_INRANGE(v, n)	(((-(1 << (n)) - 1) < (v)) && ((v) < (1 << (n))))
 
 
+/*
+ * Locate the filter entry, and the bits within it, that a symbol with ELF
+ * hash value h sets in a SHT_SUNW_bloom table.  See sys/elf.h.
+ */
+#define	BLOOM_HDRCNT		2	/* entry count and shift */
+#define	BLOOM_ENTBITS		(sizeof (Bloom) * 8)
+#define	BLOOM_ENT(bloom, h)	\
+	((bloom)[BLOOM_HDRCNT + (((h) / BLOOM_ENTBITS) & ((bloom)[0] - 1))])
+#define	BLOOM_BITS(bloom, h)	(((Bloom)1 << ((h) % BLOOM_ENTBITS)) | \
+	((Bloom)1 << (((h) >> (bloom)[1]) % BLOOM_ENTBITS)))
+
 /*
  * Yet another definition of the OFFSETOF macro, used with the AVL routines.
  */
@@ -106,60 +106,60 @@ sec_type_strings(conv_iter_osabi_t osabi, Half mach, Conv_fmt_flags_t fmt_flags)
 
 
 	static const Msg usecs_def[SHT_HISUNW - SHT_LOSUNW + 1] = {
-		MSG_SHT_SUNW_CAPCHAIN,		MSG_SHT_SUNW_CAPINFO,
-		MSG_SHT_SUNW_SYMSORT,		MSG_SHT_SUNW_TLSSORT,
-		MSG_SHT_SUNW_LDYNSYM,		MSG_SHT_SUNW_DOF,
-		MSG_SHT_SUNW_CAP,		MSG_SHT_SUNW_SIGNATURE,
-		MSG_SHT_SUNW_ANNOTATE,		MSG_SHT_SUNW_DEBUGSTR,
-		MSG_SHT_SUNW_DEBUG,		MSG_SHT_SUNW_MOVE,
-		MSG_SHT_SUNW_COMDAT,		MSG_SHT_SUNW_SYMINFO,
-		MSG_SHT_SUNW_VERDEF,		MSG_SHT_SUNW_VERNEED,
-		MSG_SHT_SUNW_VERSYM
+		MSG_SHT_SUNW_BLOOM,		MSG_SHT_SUNW_CAPCHAIN,
+		MSG_SHT_SUNW_CAPINFO,		MSG_SHT_SUNW_SYMSORT,
+		MSG_SHT_SUNW_TLSSORT,		MSG_SHT_SUNW_LDYNSYM,
+		MSG_SHT_SUNW_DOF,		MSG_SHT_SUNW_CAP,
+		MSG_SHT_SUNW_SIGNATURE,		MSG_SHT_SUNW_ANNOTATE,
+		MSG_SHT_SUNW_DEBUGSTR,		MSG_SHT_SUNW_DEBUG,
+		MSG_SHT_SUNW_MOVE,		MSG_SHT_SUNW_COMDAT,
+		MSG_SHT_SUNW_SYMINFO,		MSG_SHT_SUNW_VERDEF,
+		MSG_SHT_SUNW_VERNEED,		MSG_SHT_SUNW_VERSYM
 	};
 	static const Msg usecs_dmp[SHT_HISUNW - SHT_LOSUNW + 1] = {
-		MSG_SHT_SUNW_CAPCHAIN_DMP,	MSG_SHT_SUNW_CAPINFO_DMP,
-		MSG_SHT_SUNW_SYMSORT_DMP,	MSG_SHT_SUNW_TLSSORT_DMP,
-		MSG_SHT_SUNW_LDYNSYM_DMP,	MSG_SHT_SUNW_DOF_DMP,
-		MSG_SHT_SUNW_CAP_DMP,		MSG_SHT_SUNW_SIGNATURE_DMP,
-		MSG_SHT_SUNW_ANNOTATE_DMP,	MSG_SHT_SUNW_DEBUGSTR_DMP,
-		MSG_SHT_SUNW_DEBUG_DMP,		MSG_SHT_SUNW_MOVE_DMP,
-		MSG_SHT_SUNW_COMDAT_DMP,	MSG_SHT_SUNW_SYMINFO_DMP,
-		MSG_SHT_SUNW_VERDEF_DMP,	MSG_SHT_SUNW_VERNEED_DMP,
-		MSG_SHT_SUNW_VERSYM_DMP
+		MSG_SHT_SUNW_BLOOM_DMP,		MSG_SHT_SUNW_CAPCHAIN_DMP,
+		MSG_SHT_SUNW_CAPINFO_DMP,	MSG_SHT_SUNW_SYMSORT_DMP,
+		MSG_SHT_SUNW_TLSSORT_DMP,	MSG_SHT_SUNW_LDYNSYM_DMP,
+		MSG_SHT_SUNW_DOF_DMP,		MSG_SHT_SUNW_CAP_DMP,
+		MSG_SHT_SUNW_SIGNATURE_DMP,	MSG_SHT_SUNW_ANNOTATE_DMP,
+		MSG_SHT_SUNW_DEBUGSTR_DMP,	MSG_SHT_SUNW_DEBUG_DMP,
+		MSG_SHT_SUNW_MOVE_DMP,		MSG_SHT_SUNW_COMDAT_DMP,
+		MSG_SHT_SUNW_SYMINFO_DMP,	MSG_SHT_SUNW_VERDEF_DMP,
+		MSG_SHT_SUNW_VERNEED_DMP,	MSG_SHT_SUNW_VERSYM_DMP
 	};
 	static const Msg usecs_cf[SHT_HISUNW - SHT_LOSUNW + 1] = {
-		MSG_SHT_SUNW_CAPCHAIN_CF,	MSG_SHT_SUNW_CAPINFO_CF,
-		MSG_SHT_SUNW_SYMSORT_CF,	MSG_SHT_SUNW_TLSSORT_CF,
-		MSG_SHT_SUNW_LDYNSYM_CF,	MSG_SHT_SUNW_DOF_CF,
-		MSG_SHT_SUNW_CAP_CF,		MSG_SHT_SUNW_SIGNATURE_CF,
-		MSG_SHT_SUNW_ANNOTATE_CF,	MSG_SHT_SUNW_DEBUGSTR_CF,
-		MSG_SHT_SUNW_DEBUG_CF,		MSG_SHT_SUNW_MOVE_CF,
-		MSG_SHT_SUNW_COMDAT_CF,		MSG_SHT_SUNW_SYMINFO_CF,
-		MSG_SHT_SUNW_VERDEF_CF,		MSG_SHT_SUNW_VERNEED_CF,
-		MSG_SHT_SUNW_VERSYM_CF
+		MSG_SHT_SUNW_BLOOM_CF,		MSG_SHT_SUNW_CAPCHAIN_CF,
+		MSG_SHT_SUNW_CAPINFO_CF,	MSG_SHT_SUNW_SYMSORT_CF,
+		MSG_SHT_SUNW_TLSSORT_CF,	MSG_SHT_SUNW_LDYNSYM_CF,
+		MSG_SHT_SUNW_DOF_CF,		MSG_SHT_SUNW_CAP_CF,
+		MSG_SHT_SUNW_SIGNATURE_CF,	MSG_SHT_SUNW_ANNOTATE_CF,
+		MSG_SHT_SUNW_DEBUGSTR_CF,	MSG_SHT_SUNW_DEBUG_CF,
+		MSG_SHT_SUNW_MOVE_CF,		MSG_SHT_SUNW_COMDAT_CF,
+		MSG_SHT_SUNW_SYMINFO_CF,	MSG_SHT_SUNW_VERDEF_CF,
+		MSG_SHT_SUNW_VERNEED_CF,	MSG_SHT_SUNW_VERSYM_CF
 	};
 	static const Msg usecs_nf[SHT_HISUNW - SHT_LOSUNW + 1] = {
-		MSG_SHT_SUNW_CAPCHAIN_NF,	MSG_SHT_SUNW_CAPINFO_NF,
-		MSG_SHT_SUNW_SYMSORT_NF,	MSG_SHT_SUNW_TLSSORT_NF,
-		MSG_SHT_SUNW_LDYNSYM_NF,	MSG_SHT_SUNW_DOF_NF,
-		MSG_SHT_SUNW_CAP_NF,		MSG_SHT_SUNW_SIGNATURE_NF,
-		MSG_SHT_SUNW_ANNOTATE_NF,	MSG_SHT_SUNW_DEBUGSTR_NF,
-		MSG_SHT_SUNW_DEBUG_NF,		MSG_SHT_SUNW_MOVE_NF,
-		MSG_SHT_SUNW_COMDAT_NF,		MSG_SHT_SUNW_SYMINFO_NF,
-		MSG_SHT_SUNW_VERDEF_NF,		MSG_SHT_SUNW_VERNEED_NF,
-		MSG_SHT_SUNW_VERSYM_NF
+		MSG_SHT_SUNW_BLOOM_NF,		MSG_SHT_SUNW_CAPCHAIN_NF,
+		MSG_SHT_SUNW_CAPINFO_NF,	MSG_SHT_SUNW_SYMSORT_NF,
+		MSG_SHT_SUNW_TLSSORT_NF,	MSG_SHT_SUNW_LDYNSYM_NF,
+		MSG_SHT_SUNW_DOF_NF,		MSG_SHT_SUNW_CAP_NF,
+		MSG_SHT_SUNW_SIGNATURE_NF,	MSG_SHT_SUNW_ANNOTATE_NF,
+		MSG_SHT_SUNW_DEBUGSTR_NF,	MSG_SHT_SUNW_DEBUG_NF,
+		MSG_SHT_SUNW_MOVE_NF,		MSG_SHT_SUNW_COMDAT_NF,
+		MSG_SHT_SUNW_SYMINFO_NF,	MSG_SHT_SUNW_VERDEF_NF,
+		MSG_SHT_SUNW_VERNEED_NF,	MSG_SHT_SUNW_VERSYM_NF
 	};
-#if	(SHT_LOSUNW != SHT_SUNW_capchain)
+#if	(SHT_LOSUNW != SHT_SUNW_bloom)
 #error	"SHT_LOSUNW has moved"
 #endif
 	static const conv_ds_msg_t ds_usecs_def = {
-	    CONV_DS_MSG_INIT(SHT_SUNW_capchain, usecs_def) };
+	    CONV_DS_MSG_INIT(SHT_SUNW_bloom, usecs_def) };
 	static const conv_ds_msg_t ds_usecs_dmp = {
-	    CONV_DS_MSG_INIT(SHT_SUNW_capchain, usecs_dmp) };
+	    CONV_DS_MSG_INIT(SHT_SUNW_bloom, usecs_dmp) };
 	static const conv_ds_msg_t ds_usecs_cf = {
-	    CONV_DS_MSG_INIT(SHT_SUNW_capchain, usecs_cf) };
+	    CONV_DS_MSG_INIT(SHT_SUNW_bloom, usecs_cf) };
 	static const conv_ds_msg_t ds_usecs_nf = {
-	    CONV_DS_MSG_INIT(SHT_SUNW_capchain, usecs_nf) };
+	    CONV_DS_MSG_INIT(SHT_SUNW_bloom, usecs_nf) };
 
 
 	/* The Linux osabi range has two separate sequences */
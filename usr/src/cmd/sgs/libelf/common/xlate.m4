@@ -721,6 +721,8 @@ _elf32_mtype(Elf * elf, Elf32_Word shtype, unsigned ver)
 		return (ELF_T_CAP);
 	case SHT_SUNW_capchain:
 		return (ELF_T_WORD);
+	case SHT_SUNW_bloom:
+		return (ELF_T_WORD);
 	case SHT_SUNW_capinfo:
 		return (ELF_T_WORD);
 	case SHT_SUNW_SIGNATURE:
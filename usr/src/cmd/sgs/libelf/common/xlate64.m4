@@ -778,6 +778,8 @@ _elf64_mtype(Elf * elf, Elf64_Word shtype, unsigned ver)
 		return (ELF_T_CAP);
 	case SHT_SUNW_capchain:
 		return (ELF_T_WORD);
+	case SHT_SUNW_bloom:
+		return (ELF_T_XWORD);
 	case SHT_SUNW_capinfo:
 		return (ELF_T_XWORD);
 	case SHT_SUNW_SIGNATURE:
@@ -2706,6 +2706,7 @@ process_elf(Ifl_desc *ifl, Elf *elf, Ofl_desc *ofl)
 				    ndx, ident, ofl) == S_ERROR)
 					return (S_ERROR);
 				break;
+			case SHT_SUNW_bloom:
 			case SHT_SUNW_move:
 				if (process_section(name, ifl, shdr, scn, ndx,
 				    ld_targ.t_id.id_null, ofl) == S_ERROR)
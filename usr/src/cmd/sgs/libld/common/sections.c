@@ -576,6 +576,17 @@ new_section(Ofl_desc *ofl, Word shtype, const char *shname, Xword entcnt,
 		    sizeof (Capchain));
 		break;
 
+	case SHT_SUNW_bloom:
+		ofl->ofl_flags |= FLG_OF_OSABI;
+#if	_ELF64
+		SET_SEC_INFO(ELF_T_XWORD, sizeof (Xword), SHF_ALLOC,
+		    sizeof (Bloom));
+#else
+		SET_SEC_INFO(ELF_T_WORD, sizeof (Word), SHF_ALLOC,
+		    sizeof (Bloom));
+#endif
+		break;
+
 	case SHT_SUNW_capinfo:
 		ofl->ofl_flags |= FLG_OF_OSABI;
 #if	_ELF64
@@ -1145,10 +1156,10 @@ make_dynamic(Ofl_desc *ofl)
 		}
 
 		/*
-		 * Reserve entries for the DT_HASH, DT_STRTAB, DT_STRSZ,
-		 * DT_SYMTAB, DT_SYMENT, and DT_CHECKSUM.
+		 * Reserve entries for the DT_HASH, DT_SUNW_BLOOM, DT_STRTAB,
+		 * DT_STRSZ, DT_SYMTAB, DT_SYMENT, and DT_CHECKSUM.
 		 */
-		cnt += 6;
+		cnt += 7;
 
 		/*
 		 * If we are including local functions at the head of
@@ -2006,6 +2017,62 @@ make_hash(Ofl_desc *ofl)
 	return (1);
 }
 
+/*
+ * Make the bloom filter that accompanies the hash table.  The run-time
+ * linker consults it before walking a hash chain, so that lookups of the
+ * many symbols an object doesn't define rarely touch the chains.  Every
+ * symbol entered in the hash table sets two bits, and the filter is sized
+ * to provide at least 8 bits per symbol, which keeps false positives to a
+ * few percent.  The filter itself is filled in as symbols are added to the
+ * hash table, in update_osym().
+ */
+static uintptr_t
+make_bloom(Ofl_desc *ofl)
+{
+	Shdr		*shdr;
+	Elf_Data	*data;
+	Is_desc		*isec;
+	Bloom		*bloom;
+	size_t		size, nent;
+	uint_t		shift, maxshift;
+
+	if (new_section(ofl, SHT_SUNW_bloom, MSG_ORIG(MSG_SCN_SUNWBLOOM), 0,
+	    &isec, &shdr, &data) == S_ERROR)
+		return (S_ERROR);
+
+	ofl->ofl_osbloom =
+	    ld_place_section(ofl, isec, NULL, ld_targ.t_id.id_hash, NULL);
+	if (ofl->ofl_osbloom == (Os_desc *)S_ERROR)
+		return (S_ERROR);
+
+	/*
+	 * The low bits of a hash value select the first bit within an entry,
+	 * and the bits above them the entry, so the second bit is taken from
+	 * the bits above both.  elf_hash() values have 28 significant bits;
+	 * leave enough of them above the shift to select any bit of an entry.
+	 */
+	for (shift = 0; (1 << shift) < BLOOM_ENTBITS; shift++)
+		;
+	maxshift = 28 - shift;
+	for (nent = 1; (nent * BLOOM_ENTBITS) < (ofl->ofl_globcnt * 8);
+	    nent <<= 1)
+		shift++;
+	if (shift > maxshift)
+		shift = maxshift;
+
+	size = (BLOOM_HDRCNT + nent) * shdr->sh_entsize;
+	if ((bloom = libld_calloc(size, 1)) == NULL)
+		return (S_ERROR);
+	bloom[0] = (Bloom)nent;
+	bloom[1] = (Bloom)shift;
+
+	data->d_buf = bloom;
+	data->d_size = size;
+	shdr->sh_size = (Xword)size;
+
+	return (1);
+}
+
 /*
  * Generate the standard symbol table.  Contains all locals and globals,
  * and resides in a non-allocatable section (ie. it can be stripped).
@@ -3311,6 +3378,8 @@ ld_make_sections(Ofl_desc *ofl)
 		if (!(flags & FLG_OF_RELOBJ)) {
 			if (make_hash(ofl) == S_ERROR)
 				return (S_ERROR);
+			if (make_bloom(ofl) == S_ERROR)
+				return (S_ERROR);
 			if (make_dynstr(ofl) == S_ERROR)
 				return (S_ERROR);
 			if (make_dynsym(ofl) == S_ERROR)
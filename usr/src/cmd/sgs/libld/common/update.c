@@ -215,6 +215,7 @@ update_osym(Ofl_desc *ofl)
 	Word		*hashtab;	/* hash table pointer */
 	Word		*hashbkt;	/* hash table bucket pointer */
 	Word		*hashchain;	/* hash table chain pointer */
+	Bloom		*bloom;		/* bloom filter pointer */
 	Wk_desc		*wkp;
 	Alist		*weak = NULL;
 	ofl_flag_t	flags = ofl->ofl_flags;
@@ -282,6 +283,7 @@ update_osym(Ofl_desc *ofl)
 		hashchain = &hashtab[2 + ofl->ofl_hashbkts];
 		hashtab[0] = ofl->ofl_hashbkts;
 		hashtab[1] = DYNSYM_ALL_CNT(ofl);
+		bloom = (Bloom *)(ofl->ofl_osbloom->os_outdata->d_buf);
 		if (ofl->ofl_osdynshndx)
 			dynshndx =
 			    (Word *)ofl->ofl_osdynshndx->os_outdata->d_buf;
@@ -1514,6 +1516,8 @@ update_osym(Ofl_desc *ofl)
 
 					hashval =
 					    sap->sa_hash % ofl->ofl_hashbkts;
+					BLOOM_ENT(bloom, sap->sa_hash) |=
+					    BLOOM_BITS(bloom, sap->sa_hash);
 
 					/* LINTED */
 					if (_hashndx = hashbkt[hashval]) {
@@ -1967,6 +1971,9 @@ update_osym(Ofl_desc *ofl)
 		ofl->ofl_oshash->os_shdr->sh_link =
 		    /* LINTED */
 		    (Word)elf_ndxscn(ofl->ofl_osdynsym->os_scn);
+		ofl->ofl_osbloom->os_shdr->sh_link =
+		    /* LINTED */
+		    (Word)elf_ndxscn(ofl->ofl_osdynsym->os_scn);
 		if (dynshndx) {
 			shdr = ofl->ofl_osdynshndx->os_shdr;
 			shdr->sh_link =
@@ -2224,6 +2231,10 @@ update_odynamic(Ofl_desc *ofl)
 		dyn->d_un.d_ptr = ofl->ofl_oshash->os_shdr->sh_addr;
 		dyn++;
 
+		dyn->d_tag = DT_SUNW_BLOOM;
+		dyn->d_un.d_ptr = ofl->ofl_osbloom->os_shdr->sh_addr;
+		dyn++;
+
 		shdr = strosp->os_shdr;
 		dyn->d_tag = DT_STRTAB;
 		dyn->d_un.d_ptr = shdr->sh_addr;
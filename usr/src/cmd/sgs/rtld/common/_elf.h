@@ -96,6 +96,7 @@ typedef struct _rt_elf_private {
 	void		*e_symtab;	/* symbol table */
 	void		*e_sunwsymtab;	/* symtab augmented with local fcns */
 	uint_t		*e_hash;	/* hash table */
+	Bloom		*e_bloom;	/* hash table bloom filter */
 	char		*e_strtab;	/* string table */
 	void		*e_reloc;	/* relocation table */
 	uint_t		*e_pltgot;	/* addrs for procedure linkage table */
@@ -126,6 +127,8 @@ typedef struct _rt_elf_private {
 	Capinfo		*e_capinfo;	/* symbol capabilities information */
 	uint_t		e_capchainent;	/* size of capabilities chain entry */
 	uint_t		e_capchainsz;	/* size of capabilities chain data */
+	void		*e_bcbind;	/* binding cache table */
+	uint_t		e_bcndx;	/*	and object index + 1 */
 } Rt_elfp;
 
 /*
@@ -135,6 +138,7 @@ typedef struct _rt_elf_private {
 #define	SYMTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_symtab)
 #define	SUNWSYMTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_sunwsymtab)
 #define	HASH(X)			(((Rt_elfp *)(X)->rt_priv)->e_hash)
+#define	BLOOM(X)		(((Rt_elfp *)(X)->rt_priv)->e_bloom)
 #define	STRTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_strtab)
 #define	REL(X)			(((Rt_elfp *)(X)->rt_priv)->e_reloc)
 #define	PLTGOT(X)		(((Rt_elfp *)(X)->rt_priv)->e_pltgot)
@@ -165,6 +169,8 @@ typedef struct _rt_elf_private {
 #define	CAPINFO(X)		(((Rt_elfp *)(X)->rt_priv)->e_capinfo)
 #define	CAPCHAINENT(X)		(((Rt_elfp *)(X)->rt_priv)->e_capchainent)
 #define	CAPCHAINSZ(X)		(((Rt_elfp *)(X)->rt_priv)->e_capchainsz)
+#define	BCBIND(X)		(((Rt_elfp *)(X)->rt_priv)->e_bcbind)
+#define	BCNDX(X)		(((Rt_elfp *)(X)->rt_priv)->e_bcndx)
 
 /*
  * Most of the above macros are used from ELF specific routines, however there
@@ -326,6 +326,7 @@ struct fdesc {
 #define	RT_FL2_NOPLM	0x00001000	/* process has no primary link map */
 #define	RT_FL2_SETUID	0x00002000	/* ld.so.1 is setuid root */
 #define	RT_FL2_ADDR32	0x00004000	/* 32-bit address space requirement */
+#define	RT_FL2_PREFAULT	0x00008000	/* fault ahead data before relocation */
 
 /*
  * Information flags for env_info.
@@ -616,6 +617,8 @@ extern char		**_environ;	/* environ reference for libc */
 
 extern const char	*dbg_file;	/* debugging directed to a file */
 
+extern const char	*bindcache_dir;	/* symbol binding cache directory */
+
 extern Reglist		*reglist;	/* list of register symbols */
 
 extern const Msg	err_reject[];	/* rejection error message tables */
@@ -663,6 +666,10 @@ extern int		append_alias(Rt_map *, const char *, int *);
 extern Rt_map		*analyze_lmc(Lm_list *, Aliste, Rt_map *, Rt_map *,
 			    int *);
 extern void		atexit_fini(void);
+extern void		bc_close(void);
+extern void		bc_enter(Slookup *, Sresult *, uint_t);
+extern int		bc_lookup(Slookup *, Sresult *, uint_t *);
+extern void		bc_open(Lm_list *);
 extern int		bind_one(Rt_map *, Rt_map *, uint_t);
 extern int		bufprint(Prfbuf *, const char *, ...);
 extern void		call_array(Addr *, uint_t, Rt_map *, Word);
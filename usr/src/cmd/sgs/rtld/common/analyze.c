@@ -331,6 +331,39 @@ relocate_so(Lm_list *lml, Rt_map *lmp, int *relocated, int now, int *in_nfavl)
 	return (ret);
 }
 
+/*
+ * Start the system reading in the writable data of each object that is about
+ * to be relocated.  Each object's relocation information is already being
+ * read in from the time the object was mapped (see elf_new_lmp()), but its
+ * data and GOT are otherwise only brought in a page at a time as relocation
+ * processing writes them, one object after another.  Asking for all of the
+ * data up front lets this I/O proceed together, and in the background while
+ * the first objects are being relocated.
+ */
+static void
+prefault_lmc(Rt_map *nlmp)
+{
+	Rt_map	*lmp;
+
+	for (lmp = nlmp; lmp; lmp = NEXT_RT_MAP(lmp)) {
+		mmapobj_result_t	*mpp;
+		uint_t			mnum;
+
+		if (FLAGS(lmp) &
+		    (FLG_RT_RELOCING | FLG_RT_RELOCED | FLG_RT_DELETE))
+			continue;
+
+		for (mnum = 0, mpp = MMAPS(lmp); mnum < MMAPCNT(lmp);
+		    mnum++, mpp++) {
+			if (((mpp->mr_prot & PROT_WRITE) == 0) ||
+			    (mpp->mr_fsize == 0))
+				continue;
+			(void) madvise(mpp->mr_addr + mpp->mr_offset,
+			    mpp->mr_fsize, MADV_WILLNEED);
+		}
+	}
+}
+
 /*
  * Relocate the objects on a link-map control list.
  */
@@ -340,6 +373,9 @@ _relocate_lmc(Lm_list *lml, Aliste lmco, Rt_map *nlmp, int *relocated,
 {
 	Rt_map	*lmp;
 
+	if (rtld_flags2 & RT_FL2_PREFAULT)
+		prefault_lmc(nlmp);
+
 	for (lmp = nlmp; lmp; lmp = NEXT_RT_MAP(lmp)) {
 		/*
 		 * If this object has already been relocated, we're done.  If
@@ -3235,6 +3271,13 @@ lookup_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 			slp->sl_flags |= LKUP_WEAK;
 	}
 
+	/*
+	 * If the binding of this reference has been recorded in the symbol
+	 * binding cache, there's no need to search for it.
+	 */
+	if (bc_lookup(slp, srp, binfo))
+		return (1);
+
 	/*
 	 * Save the callers MODE().
 	 */
@@ -3280,8 +3323,10 @@ lookup_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 	 */
 	if (((mode & (RTLD_GROUP | RTLD_WORLD)) == RTLD_GROUP) &&
 	    (lookup_sym_interpose(slp, srp, binfo, in_nfavl)))
-		return (1);
+		ret = 1;
 
+	if (ret)
+		bc_enter(slp, srp, *binfo);
 	return (ret);
 }
 
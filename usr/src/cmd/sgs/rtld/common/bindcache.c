@@ -0,0 +1,361 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Symbol binding cache.
+ *
+ * For a process that is started again and again from the same objects,
+ * resolving the symbol references of those objects arrives at the same
+ * bindings every time, yet is a large part of the startup cost.  When
+ * LD_BIND_CACHE names a directory, ld.so.1 records the binding of each
+ * relocation symbol reference made by the objects loaded at startup, and as
+ * the process exits writes these bindings to a cache file within the
+ * directory, named after the device and inode of the executable.  Later
+ * processes of the same executable map the cache, and provided they have
+ * loaded the same objects, take the binding of these references from the
+ * cache rather than searching for them.  Lazy bindings made while the
+ * process runs are recorded and satisfied in the same way.
+ *
+ * The cache identifies each object by its device, inode, size and
+ * modification time, and records the link-map list flags that affect symbol
+ * searches.  A difference in any of the objects, in their order or in these
+ * flags invalidates the cache, and a new cache is recorded.  Only bindings
+ * between the objects loaded at startup are recorded.  Copy relocations,
+ * dlsym() requests, and bindings to any object that provides symbol
+ * capabilities, whose selection depends on the system, are always resolved
+ * by a symbol search.
+ */
+
+#include	<sys/mman.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<fcntl.h>
+#include	<limits.h>
+#include	<stdio.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<debug.h>
+#include	<conv.h>
+#include	"_rtld.h"
+#include	"_elf.h"
+#include	"msg.h"
+
+#define	BC_MAGIC	0x424e4443	/* "BNDC" */
+#define	BC_VERSION	1
+
+typedef struct {
+	uint32_t	bh_magic;
+	uint16_t	bh_version;
+	uint16_t	bh_class;	/* ELF class and machine of the */
+	uint32_t	bh_mach;	/*	objects */
+	uint32_t	bh_objcnt;	/* number of objects */
+	uint32_t	bh_tflags;	/* link-map list tflags */
+	uint32_t	bh_pad;
+	uint64_t	bh_size;	/* size of cache file */
+} Bc_hdr;
+
+typedef struct {
+	uint64_t	bo_dev;		/* identity of object */
+	uint64_t	bo_ino;
+	uint64_t	bo_size;
+	int64_t		bo_mtime;
+	int64_t		bo_mtimens;
+	uint64_t	bo_symcnt;	/* number of symbol table entries */
+	uint64_t	bo_off;		/* offset of binding table */
+} Bc_obj;
+
+/*
+ * Each object's binding table holds two entries for each of its symbol table
+ * entries, as a reference that may bind to a procedure linkage table entry
+ * in the executable (LKUP_SPEC) can resolve differently from one that may not.
+ */
+typedef struct {
+	uint32_t	bb_obj;		/* defining object index + 1, or 0 */
+	uint32_t	bb_symndx;	/* definition symbol index */
+	uint32_t	bb_binfo;	/* binding information */
+} Bc_bind;
+
+/*
+ * Lookups that the cache can satisfy carry no flags other than these.
+ */
+#define	BC_LKUP_FLAGS	(LKUP_SPEC | LKUP_STDRELOC | LKUP_WEAK | LKUP_SINGLETON)
+
+static Rt_map	**bc_maps;		/* objects of the cache */
+static Bc_obj	*bc_objs;		/*	and their identities */
+static uint_t	bc_objcnt;
+static Word	bc_tflags;
+static int	bc_record;		/* recording a new cache */
+static pid_t	bc_pid;			/*	for this process */
+static char	bc_path[PATH_MAX];
+
+/*
+ * Locate the binding table entry for a symbol lookup, if the cache can
+ * describe it.
+ */
+static Bc_bind *
+bc_slot(Slookup *slp)
+{
+	Rt_map	*clmp = slp->sl_cmap;
+	Bc_bind	*bbp;
+
+	if ((FCT(clmp) != &elf_fct) || ((bbp = BCBIND(clmp)) == NULL) ||
+	    (slp->sl_rsymndx == 0) ||
+	    (slp->sl_rsymndx >= bc_objs[BCNDX(clmp) - 1].bo_symcnt) ||
+	    (slp->sl_flags & ~BC_LKUP_FLAGS))
+		return (NULL);
+
+	return (&bbp[(slp->sl_rsymndx * 2) +
+	    ((slp->sl_flags & LKUP_SPEC) ? 1 : 0)]);
+}
+
+/*
+ * Establish the identity of each object on the link-map list, and map any
+ * cache that describes them.  Otherwise prepare to record a new cache.
+ */
+void
+bc_open(Lm_list *lml)
+{
+	Rt_map		*lmp;
+	Bc_hdr		*bhp = NULL;
+	Bc_obj		*bop;
+	Bc_bind		*bbp;
+	rtld_stat_t	status;
+	uint_t		ndx;
+	int		fd;
+
+	if ((bindcache_dir == NULL) || (lml->lm_flags & LML_FLG_TRC_ENABLE) ||
+	    (lml->lm_tflags & LML_TFLG_AUD_MASK))
+		return;
+
+	for (ndx = 0, lmp = lml->lm_head; lmp; lmp = NEXT_RT_MAP(lmp), ndx++) {
+		if (FCT(lmp) != &elf_fct)
+			return;
+	}
+	if (((bc_maps = calloc(ndx, sizeof (Rt_map *))) == NULL) ||
+	    ((bc_objs = calloc(ndx, sizeof (Bc_obj))) == NULL))
+		goto fail;
+	bc_objcnt = ndx;
+	bc_tflags = lml->lm_tflags;
+
+	for (ndx = 0, lmp = lml->lm_head; lmp; lmp = NEXT_RT_MAP(lmp), ndx++) {
+		if (rtld_stat(PATHNAME(lmp), &status) == -1)
+			goto fail;
+
+		bop = &bc_objs[ndx];
+		bop->bo_dev = status.st_dev;
+		bop->bo_ino = status.st_ino;
+		bop->bo_size = status.st_size;
+		bop->bo_mtime = status.st_mtim.tv_sec;
+		bop->bo_mtimens = status.st_mtim.tv_nsec;
+		bop->bo_symcnt = HASH(lmp) ? HASH(lmp)[1] : 0;
+
+		bc_maps[ndx] = lmp;
+		BCNDX(lmp) = ndx + 1;
+	}
+
+	(void) snprintf(bc_path, PATH_MAX, MSG_ORIG(MSG_FMT_BINDCACHE),
+	    bindcache_dir, (u_longlong_t)bc_objs[0].bo_dev,
+	    (u_longlong_t)bc_objs[0].bo_ino, M_CLASS);
+
+	/*
+	 * Map any existing cache, and determine whether it describes the
+	 * objects of this process.
+	 */
+	if ((fd = open(bc_path, O_RDONLY)) != -1) {
+		if ((rtld_fstat(fd, &status) == 0) &&
+		    (status.st_size >= sizeof (Bc_hdr)) &&
+		    ((bhp = (Bc_hdr *)mmap(NULL, status.st_size, PROT_READ,
+		    MAP_PRIVATE, fd, 0)) == MAP_FAILED))
+			bhp = NULL;
+		(void) close(fd);
+	}
+	if (bhp) {
+		size_t	size = status.st_size;
+
+		if ((bhp->bh_magic != BC_MAGIC) ||
+		    (bhp->bh_version != BC_VERSION) ||
+		    (bhp->bh_class != M_CLASS) || (bhp->bh_mach != M_MACH) ||
+		    (bhp->bh_objcnt != bc_objcnt) ||
+		    (bhp->bh_tflags != bc_tflags) || (bhp->bh_size != size) ||
+		    (size < (sizeof (Bc_hdr) + (bc_objcnt * sizeof (Bc_obj)))))
+			goto invalid;
+
+		bop = (Bc_obj *)(bhp + 1);
+		for (ndx = 0; ndx < bc_objcnt; ndx++, bop++) {
+			Bc_obj	*obop = &bc_objs[ndx];
+
+			if ((bop->bo_dev != obop->bo_dev) ||
+			    (bop->bo_ino != obop->bo_ino) ||
+			    (bop->bo_size != obop->bo_size) ||
+			    (bop->bo_mtime != obop->bo_mtime) ||
+			    (bop->bo_mtimens != obop->bo_mtimens) ||
+			    (bop->bo_symcnt != obop->bo_symcnt) ||
+			    (bop->bo_off % sizeof (uint32_t)) ||
+			    (bop->bo_off > size) ||
+			    (bop->bo_symcnt * 2 * sizeof (Bc_bind) >
+			    size - bop->bo_off))
+				goto invalid;
+		}
+
+		bop = (Bc_obj *)(bhp + 1);
+		for (ndx = 0; ndx < bc_objcnt; ndx++, bop++) {
+			if (bop->bo_symcnt)
+				BCBIND(bc_maps[ndx]) =
+				    (Bc_bind *)((uintptr_t)bhp + bop->bo_off);
+		}
+		return;
+invalid:
+		(void) munmap((caddr_t)bhp, size);
+	}
+
+	/*
+	 * Record a new cache.
+	 */
+	for (ndx = 0; ndx < bc_objcnt; ndx++) {
+		if (bc_objs[ndx].bo_symcnt == 0)
+			continue;
+		if ((bbp = calloc(bc_objs[ndx].bo_symcnt * 2,
+		    sizeof (Bc_bind))) == NULL)
+			goto fail;
+		BCBIND(bc_maps[ndx]) = bbp;
+	}
+	bc_record = 1;
+	bc_pid = getpid();
+	return;
+
+fail:
+	/*
+	 * Leave the process without a cache.
+	 */
+	if (bc_maps) {
+		for (ndx = 0; ndx < bc_objcnt; ndx++) {
+			if (bc_maps[ndx] == NULL)
+				continue;
+			if (BCBIND(bc_maps[ndx]))
+				free(BCBIND(bc_maps[ndx]));
+			BCBIND(bc_maps[ndx]) = NULL;
+			BCNDX(bc_maps[ndx]) = 0;
+		}
+		free(bc_maps);
+	}
+	if (bc_objs)
+		free(bc_objs);
+	bc_maps = NULL;
+	bc_objs = NULL;
+	bc_objcnt = 0;
+}
+
+/*
+ * Satisfy a symbol lookup from the cache.
+ */
+int
+bc_lookup(Slookup *slp, Sresult *srp, uint_t *binfo)
+{
+	Bc_bind	*bbp;
+	Rt_map	*dlmp;
+
+	if ((bc_maps == NULL) || bc_record || ((bbp = bc_slot(slp)) == NULL) ||
+	    (bbp->bb_obj == 0) || (bbp->bb_obj > bc_objcnt))
+		return (0);
+
+	dlmp = bc_maps[bbp->bb_obj - 1];
+	if (bbp->bb_symndx >= bc_objs[bbp->bb_obj - 1].bo_symcnt)
+		return (0);
+
+	srp->sr_dmap = dlmp;
+	srp->sr_sym = (Sym *)((uintptr_t)SYMTAB(dlmp) +
+	    (bbp->bb_symndx * SYMENT(dlmp)));
+	*binfo = bbp->bb_binfo;
+	return (1);
+}
+
+/*
+ * Record the result of a symbol lookup in a new cache.
+ */
+void
+bc_enter(Slookup *slp, Sresult *srp, uint_t binfo)
+{
+	Bc_bind	*bbp;
+	Rt_map	*dlmp = srp->sr_dmap;
+	ulong_t	off;
+
+	if ((bc_record == 0) || ((bbp = bc_slot(slp)) == NULL))
+		return;
+
+	/*
+	 * The defining object must be one of the objects of the cache, and
+	 * the definition must be found by its name, in its symbol table.
+	 */
+	if ((FCT(dlmp) != &elf_fct) || (BCNDX(dlmp) == 0) ||
+	    CAPINFO(dlmp) || (srp->sr_name != slp->sl_name))
+		return;
+	off = (uintptr_t)srp->sr_sym - (uintptr_t)SYMTAB(dlmp);
+	if ((off % SYMENT(dlmp)) ||
+	    ((off / SYMENT(dlmp)) >= bc_objs[BCNDX(dlmp) - 1].bo_symcnt))
+		return;
+
+	bbp->bb_obj = BCNDX(dlmp);
+	bbp->bb_symndx = off / SYMENT(dlmp);
+	bbp->bb_binfo = binfo;
+}
+
+/*
+ * Write any new cache as the process exits.  The cache is written to a
+ * temporary file and renamed, so that a process only ever maps a complete
+ * cache, and concurrent processes can each write their own.
+ */
+void
+bc_close(void)
+{
+	Bc_hdr	bh;
+	uint64_t off;
+	char	tpath[PATH_MAX];
+	uint_t	ndx;
+	int	fd, ok;
+
+	if ((bc_record == 0) || (bc_pid != getpid()))
+		return;
+	bc_record = 0;
+
+	off = sizeof (Bc_hdr) + (bc_objcnt * sizeof (Bc_obj));
+	for (ndx = 0; ndx < bc_objcnt; ndx++) {
+		bc_objs[ndx].bo_off = off;
+		off += bc_objs[ndx].bo_symcnt * 2 * sizeof (Bc_bind);
+	}
+
+	(void) memset(&bh, 0, sizeof (bh));
+	bh.bh_magic = BC_MAGIC;
+	bh.bh_version = BC_VERSION;
+	bh.bh_class = M_CLASS;
+	bh.bh_mach = M_MACH;
+	bh.bh_objcnt = bc_objcnt;
+	bh.bh_tflags = bc_tflags;
+	bh.bh_size = off;
+
+	(void) snprintf(tpath, PATH_MAX, MSG_ORIG(MSG_FMT_BINDTMP), bc_path,
+	    (int)bc_pid);
+	if ((fd = open(tpath, (O_WRONLY | O_CREAT | O_EXCL), 0644)) == -1)
+		return;
+
+	ok = (write(fd, &bh, sizeof (bh)) == sizeof (bh)) &&
+	    (write(fd, bc_objs, bc_objcnt * sizeof (Bc_obj)) ==
+	    (bc_objcnt * sizeof (Bc_obj)));
+	for (ndx = 0; ok && (ndx < bc_objcnt); ndx++) {
+		size_t	size = bc_objs[ndx].bo_symcnt * 2 * sizeof (Bc_bind);
+
+		if (size)
+			ok = (write(fd, BCBIND(bc_maps[ndx]), size) == size);
+	}
+	(void) close(fd);
+
+	if ((ok == 0) || (rename(tpath, bc_path) == -1))
+		(void) unlink(tpath);
+}
@@ -1349,6 +1349,7 @@ elf_find_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 	Rt_map		*ilmp = slp->sl_imap;
 	ulong_t		hash = slp->sl_hash;
 	uint_t		ndx, hashoff, buckets, *chainptr;
+	Bloom		*bloom, bits;
 	Sym		*sym, *symtabptr;
 	char		*strtabptr, *strtabname;
 	uint_t		flags1;
@@ -1364,6 +1365,17 @@ elf_find_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 	if (HASH(ilmp) == NULL)
 		return (0);
 
+	/*
+	 * Most lookups are for names the object doesn't define.  When the
+	 * object provides a bloom filter, it rejects nearly all of these
+	 * without the hash chain being walked.
+	 */
+	if ((bloom = BLOOM(ilmp)) != NULL) {
+		bits = BLOOM_BITS(bloom, hash);
+		if ((BLOOM_ENT(bloom, hash) & bits) != bits)
+			return (0);
+	}
+
 	buckets = HASH(ilmp)[0];
 	/* LINTED */
 	hashoff = ((uint_t)hash % buckets) + 2;
@@ -2151,6 +2163,9 @@ elf_new_lmp(Lm_list *lml, Aliste lmco, Fdesc *fdp, Addr addr, size_t msize,
 				CAPCHAIN(lmp) = (void *)(dyn->d_un.d_ptr +
 				    base);
 				break;
+			case DT_SUNW_BLOOM:
+				BLOOM(lmp) = (Bloom *)(dyn->d_un.d_ptr + base);
+				break;
 			case DT_SUNW_CAPCHAINENT:
 				CAPCHAINENT(lmp) = dyn->d_un.d_val;
 				break;
@@ -2303,6 +2318,13 @@ elf_new_lmp(Lm_list *lml, Aliste lmco, Fdesc *fdp, Addr addr, size_t msize,
 	if (CAPCHAIN(lmp) && (CAPCHAIN(lmp)[0] > CAPCHAIN_CURRENT))
 		CAPCHAIN(lmp) = NULL;
 
+	/*
+	 * A bloom filter must have a power of 2 entries to be indexed.
+	 */
+	if (BLOOM(lmp) && ((BLOOM(lmp)[0] == 0) ||
+	    (BLOOM(lmp)[0] & (BLOOM(lmp)[0] - 1))))
+		BLOOM(lmp) = NULL;
+
 	/*
 	 * As part of processing dependencies, a file descriptor is populated
 	 * with capabilities information following validation.
@@ -181,6 +181,8 @@ static Dbg_desc	_dbg_desc = {0, 0, 0};
 Dbg_desc	*dbg_desc = &_dbg_desc;	/* debugging descriptor */
 const char	*dbg_file = NULL;	/* debugging directed to file */
 
+const char	*bindcache_dir = NULL;	/* symbol binding cache directory */
+
 #pragma weak	environ = _environ	/* environ for PLT tracing - we */
 char		**_environ = NULL;	/* supply the pair to satisfy any */
 					/* libc requirements (hwmuldiv) */
@@ -1060,6 +1060,12 @@ setup(char **envp, auxv_t *auxv, Word _flags, char *_platform, int _syspagsz,
 
 		DBG_CALL(Dbg_util_nl(&lml_main, DBG_NL_STD));
 
+		/*
+		 * Map any symbol binding cache that describes the objects
+		 * now loaded, so that relocation can bind from it.
+		 */
+		bc_open(&lml_main);
+
 		if (relocate_lmc(&lml_main, ALIST_OFF_DATA, mlmp,
 		    mlmp, NULL) == 0)
 			return (0);
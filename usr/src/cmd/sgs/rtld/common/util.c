@@ -965,6 +965,12 @@ atexit_fini()
 	    (tobj != (Rt_map **)S_ERROR))
 		call_fini(lml, tobj, NULL);
 
+	/*
+	 * All bindings the process is going to make have now been made, so
+	 * write any binding cache being recorded.
+	 */
+	bc_close();
+
 	leave(&lml_main, 0);
 }
 
@@ -1428,6 +1434,8 @@ static	u_longlong_t		cmdisa = 0;	/* command line (-e) ISA */
 #define	ENV_FLG_CAP_FILES	0x0080000000000ULL
 #define	ENV_FLG_DEFERRED	0x0100000000000ULL
 #define	ENV_FLG_NOENVIRON	0x0200000000000ULL
+#define	ENV_FLG_BIND_CACHE	0x0400000000000ULL
+#define	ENV_FLG_PREFAULT	0x0800000000000ULL
 
 #define	SEL_REPLACE		0x0001
 #define	SEL_PERMANT		0x0002
@@ -1526,6 +1534,18 @@ ld_generic_env(const char *s1, size_t len, const char *s2, Word *lmflags,
 			 */
 			select |= SEL_ACT_SPEC_2;
 			variable = ENV_FLG_BINDINGS;
+		} else if ((len == MSG_LD_BIND_CACHE_SIZE) && (strncmp(s1,
+		    MSG_ORIG(MSG_LD_BIND_CACHE),
+		    MSG_LD_BIND_CACHE_SIZE) == 0)) {
+			/*
+			 * Secure applications must not read or write binding
+			 * caches in a directory of the caller's choosing.
+			 */
+			if (rtld_flags & RT_FL_SECURE)
+				return;
+			select |= SEL_ACT_STR;
+			str = &bindcache_dir;
+			variable = ENV_FLG_BIND_CACHE;
 		}
 	}
 	/*
@@ -1756,7 +1776,7 @@ ld_generic_env(const char *s1, size_t len, const char *s2, Word *lmflags,
 		}
 	}
 	/*
-	 * LD_PLATCAP, LD_PRELOAD and LD_PROFILE family.
+	 * LD_PLATCAP, LD_PREFAULT, LD_PRELOAD and LD_PROFILE family.
 	 */
 	else if (*s1 == 'P') {
 		if ((len == MSG_LD_PLATCAP_SIZE) && (strncmp(s1,
@@ -1765,6 +1785,11 @@ ld_generic_env(const char *s1, size_t len, const char *s2, Word *lmflags,
 			str = (select & SEL_REPLACE) ?
 			    &rpl_platcap : &prm_platcap;
 			variable = ENV_FLG_PLATCAP;
+		} else if ((len == MSG_LD_PREFAULT_SIZE) && (strncmp(s1,
+		    MSG_ORIG(MSG_LD_PREFAULT), MSG_LD_PREFAULT_SIZE) == 0)) {
+			select |= SEL_ACT_RT2;
+			val = RT_FL2_PREFAULT;
+			variable = ENV_FLG_PREFAULT;
 		} else if ((len == MSG_LD_PRELOAD_SIZE) && (strncmp(s1,
 		    MSG_ORIG(MSG_LD_PRELOAD), MSG_LD_PRELOAD_SIZE) == 0)) {
 			select |= SEL_ACT_STR;
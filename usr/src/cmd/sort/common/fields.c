@@ -1212,13 +1212,14 @@ field_convert_wide(field_t *F, line_rec_t *L, int flags,
  * full-line comparison required by the sort specification.  Because we do not
  * have a guarantee that l_data is null-terminated, we create an explicitly
  * null-terminated copy suitable for transformation to a collatable form for the
- * current locale.
+ * current locale.  The copy buffers are per-thread, as a parallel internal sort
+ * compares lines from several threads at once.
  */
 static void
 line_convert(line_rec_t *L)
 {
-	static ssize_t bufsize;
-	static char *buffer;
+	static __thread ssize_t bufsize;
+	static __thread char *buffer;
 
 	if (L->l_raw_collate.sp != NULL)
 		return;
@@ -1242,8 +1243,8 @@ line_convert(line_rec_t *L)
 static void
 line_convert_wide(line_rec_t *L)
 {
-	static wchar_t *buffer;
-	static ssize_t bufsize;
+	static __thread wchar_t *buffer;
+	static __thread ssize_t bufsize;
 
 	ssize_t dlength;
 
@@ -294,17 +294,207 @@ rqs_start:
 	}
 }
 
+/*
+ * Parallel internal sort
+ *
+ * With -P, each in-memory run is cut into one slice per thread, the slices are
+ * sorted concurrently by rqs_algorithm(), and the sorted slices are then merged
+ * pairwise by a tree of merge threads, halving the number of slices each pass.
+ * Merging uses the same collation function, without a depth offset, that
+ * rqs_algorithm() and tqs_algorithm() order lines by, so the result is the
+ * ordering the serial sort produces; the run then continues down the ordinary
+ * temporary file and merge path.
+ */
+typedef struct sort_slice {
+	line_rec_t	**ss_src;	/* slice, or two adjacent slices */
+	line_rec_t	**ss_dst;	/* merge destination */
+	ssize_t		ss_n1;		/* lines in first slice */
+	ssize_t		ss_n2;		/* lines in second slice */
+	int		(*ss_collate_fcn)(line_rec_t *, line_rec_t *, ssize_t,
+	    flag_t);
+	flag_t		ss_coll_flags;
+	pthread_t	ss_thread;
+	int		ss_started;
+} sort_slice_t;
+
+/*
+ * Runs of fewer lines than this per thread are sorted serially: the threads
+ * and the merge passes would cost more than they save.
+ */
+#define	PARALLEL_MIN_LINES	16384
+
+/*
+ * rqs_algorithm() recurses on both outer partitions; give the sort threads a
+ * stack comparable to the main thread's.
+ */
+#define	PARALLEL_STACK_SIZE	(8 * MEGABYTE)
+
+static line_rec_t **merge_buf;
+static ssize_t merge_buf_size;
+
+static void *
+slice_sort(void *arg)
+{
+	sort_slice_t *s = arg;
+
+	rqs_algorithm(s->ss_src, s->ss_n1, 0, s->ss_collate_fcn,
+	    s->ss_coll_flags);
+
+	return (NULL);
+}
+
+static void *
+slice_merge(void *arg)
+{
+	sort_slice_t *s = arg;
+	line_rec_t **a = s->ss_src;
+	line_rec_t **a_end = a + s->ss_n1;
+	line_rec_t **b = a_end;
+	line_rec_t **b_end = b + s->ss_n2;
+	line_rec_t **d = s->ss_dst;
+
+	/*
+	 * Lines that collate equally are taken from the first slice first.
+	 */
+	while (a < a_end && b < b_end) {
+		if (s->ss_collate_fcn(*b, *a, 0, s->ss_coll_flags) < 0)
+			*d++ = *b++;
+		else
+			*d++ = *a++;
+	}
+
+	if (a < a_end)
+		(void) memcpy(d, a, (a_end - a) * sizeof (line_rec_t *));
+	else if (b < b_end)
+		(void) memcpy(d, b, (b_end - b) * sizeof (line_rec_t *));
+
+	return (NULL);
+}
+
+/*
+ * Run fcn on each of the n slices, each in a thread of its own; a slice whose
+ * thread can't be created is processed by the calling thread instead.
+ */
 static void
-radix_quicksort(stream_t *C, flag_t coll_flags)
+slice_run(sort_slice_t *slices, int n, void *(*fcn)(void *))
 {
+	pthread_attr_t attr;
+	int i;
+
+	(void) pthread_attr_init(&attr);
+	(void) pthread_attr_setstacksize(&attr, PARALLEL_STACK_SIZE);
+
+	for (i = 1; i < n; i++)
+		slices[i].ss_started = (pthread_create(&slices[i].ss_thread,
+		    &attr, fcn, &slices[i]) == 0);
+
+	(void) pthread_attr_destroy(&attr);
+
+	(void) fcn(&slices[0]);
+
+	for (i = 1; i < n; i++) {
+		if (slices[i].ss_started)
+			(void) pthread_join(slices[i].ss_thread, NULL);
+		else
+			(void) fcn(&slices[i]);
+	}
+}
+
+static void
+parallel_sort(line_rec_t **X, ssize_t n, int nthreads,
+    int (*collate_fcn)(line_rec_t *, line_rec_t *, ssize_t, flag_t),
+    flag_t coll_flags)
+{
+	sort_slice_t *slices;
+	ssize_t *bounds;
+	line_rec_t **src, **dst, **t;
+	int nslices, i, j;
+
+	nslices = MIN(nthreads, n / PARALLEL_MIN_LINES);
+	if (nslices <= 1) {
+		rqs_algorithm(X, n, 0, collate_fcn, coll_flags);
+		return;
+	}
+
+	if (n > merge_buf_size) {
+		merge_buf = safe_realloc(merge_buf,
+		    n * sizeof (line_rec_t *));
+		merge_buf_size = n;
+	}
+
+	slices = safe_realloc(NULL, nslices * sizeof (sort_slice_t));
+	bounds = safe_realloc(NULL, (nslices + 1) * sizeof (ssize_t));
+
+	for (i = 0; i <= nslices; i++)
+		bounds[i] = (ssize_t)(((u_longlong_t)n * i) / nslices);
+
+	for (i = 0; i < nslices; i++) {
+		slices[i].ss_src = &X[bounds[i]];
+		slices[i].ss_n1 = bounds[i + 1] - bounds[i];
+		slices[i].ss_collate_fcn = collate_fcn;
+		slices[i].ss_coll_flags = coll_flags;
+	}
+
+	slice_run(slices, nslices, slice_sort);
+
+	/*
+	 * Merge passes.  Each pass merges slices 2i and 2i + 1 from src into
+	 * dst; an odd slice out at the end is copied across unchanged.
+	 */
+	src = X;
+	dst = merge_buf;
+	while (nslices > 1) {
+		for (i = 0, j = 0; i + 1 < nslices; i += 2, j++) {
+			slices[j].ss_src = &src[bounds[i]];
+			slices[j].ss_dst = &dst[bounds[i]];
+			slices[j].ss_n1 = bounds[i + 1] - bounds[i];
+			slices[j].ss_n2 = bounds[i + 2] - bounds[i + 1];
+			slices[j].ss_collate_fcn = collate_fcn;
+			slices[j].ss_coll_flags = coll_flags;
+		}
+
+		slice_run(slices, j, slice_merge);
+
+		if (i < nslices)
+			(void) memcpy(&dst[bounds[i]], &src[bounds[i]],
+			    (bounds[i + 1] - bounds[i]) *
+			    sizeof (line_rec_t *));
+
+		for (i = 0; i <= nslices; i += 2)
+			bounds[i / 2] = bounds[i];
+		bounds[(nslices + 1) / 2] = n;
+		nslices = (nslices + 1) / 2;
+
+		t = src;
+		src = dst;
+		dst = t;
+	}
+
+	if (src != X)
+		(void) memcpy(X, src, n * sizeof (line_rec_t *));
+
+	safe_free(slices);
+	safe_free(bounds);
+}
+
+static void
+radix_quicksort(stream_t *C, flag_t coll_flags, int nthreads)
+{
+	int (*collate_fcn)(line_rec_t *, line_rec_t *, ssize_t, flag_t);
+
 	ASSERT((C->s_status & STREAM_SOURCE_MASK) == STREAM_ARRAY);
 
 	if (C->s_element_size == sizeof (char))
-		rqs_algorithm(C->s_type.LA.s_array, C->s_type.LA.s_array_size,
-		    0, collated, coll_flags);
+		collate_fcn = collated;
+	else
+		collate_fcn = collated_wide;
+
+	if (nthreads > 1)
+		parallel_sort(C->s_type.LA.s_array, C->s_type.LA.s_array_size,
+		    nthreads, collate_fcn, coll_flags);
 	else
 		rqs_algorithm(C->s_type.LA.s_array, C->s_type.LA.s_array_size,
-		    0, collated_wide, coll_flags);
+		    0, collate_fcn, coll_flags);
 }
 
 void
@@ -406,7 +596,7 @@ internal_sort(sort_t *S)
 			}
 		}
 
-		radix_quicksort(sort_stream, coll_flags);
+		radix_quicksort(sort_stream, coll_flags, S->m_threads);
 
 #ifndef DEBUG_NO_CACHE_TEMP
 		/*
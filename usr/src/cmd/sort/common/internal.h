@@ -35,6 +35,7 @@ extern "C" {
 
 #include <sys/mman.h>
 
+#include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -73,8 +73,9 @@
  * is, before the closing -n is seen), a narrower set of options is permitted.
  * We specify this smaller set of options in OLD_SPEC_OPTIONS_STRING.
  */
-#define	OPTIONS_STRING		"cmuo:T:z:dfiMnrbt:k:S:0123456789"
-#define	OLD_SPEC_OPTIONS_STRING	"bdfiMnrcmuo:T:z:t:k:S:"
+#define	OPTIONS_STRING		\
+	"cmuo:T:z:dfiMnrbt:k:S:P:(parallel)0123456789"
+#define	OLD_SPEC_OPTIONS_STRING	"bdfiMnrcmuo:T:z:t:k:S:P:"
 
 #define	OPTIONS_OLDSPEC		0x1	/* else new-style spec */
 #define	OPTIONS_STARTSPEC	0x2	/* else end spec */
@@ -332,6 +333,7 @@ parse_old_field_spec(sort_t *S, int argc, char *argv[])
 			case 't':
 			case 'k':
 			case 'S':
+			case 'P':
 				/*
 				 * Options with arguments.
 				 */
@@ -512,6 +514,21 @@ options(sort_t *S, int argc, char *argv[])
 #endif /* DEBUG */
 				break;
 
+			case 'P':
+				/*
+				 * Number of threads used for internal sorts; 0
+				 * asks for one per online processor.
+				 */
+				if (!is_number(optarg))
+					usage();
+				S->m_threads = atoi(optarg);
+				if (S->m_threads == 0)
+					S->m_threads =
+					    sysconf(_SC_NPROCESSORS_ONLN);
+				S->m_threads = MIN(MAX(S->m_threads, 1),
+				    SORT_MAX_THREADS);
+				break;
+
 			/*
 			 * We never take a naked -999; these should always be
 			 * associated with a preceding +000.
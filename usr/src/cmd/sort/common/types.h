@@ -278,6 +278,8 @@ typedef struct sort {
 	flag_t		m_input_from_stdin;
 	flag_t		m_output_to_stdout;
 	flag_t		m_verbose;
+
+	int		m_threads;	/* threads for internal sorts */
 } sort_t;
 
 #ifdef	__cplusplus
@@ -434,7 +434,7 @@ usage()
 {
 	(void) fprintf(stderr,
 	    gettext("usage: %s [-cmu] [-o output] [-T directory] [-S mem]"
-	    " [-z recsz]\n\t[-dfiMnr] [-b] [-t char] [-k keydef]"
+	    " [-z recsz]\n\t[-P threads] [-dfiMnr] [-b] [-t char] [-k keydef]"
 	    " [+pos1 [-pos2]] files...\n"), CMDNAME);
 	exit(E_USAGE);
 }
@@ -94,6 +94,8 @@ extern "C" {
 #define	AV_MEM_MULTIPLIER		3
 #define	AV_MEM_DIVISOR			4
 
+#define	SORT_MAX_THREADS		256
+
 #define	OUTPUT_MODE	(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | \
     S_IWOTH)
 
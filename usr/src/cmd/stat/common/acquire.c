@@ -48,18 +48,6 @@ static char *cpu_states[] = {
 	"cpu_ticks_wait"
 };
 
-static kstat_t *
-kstat_lookup_read(kstat_ctl_t *kc, char *module,
-		int instance, char *name)
-{
-	kstat_t *ksp = kstat_lookup(kc, module, instance, name);
-	if (ksp == NULL)
-		return (NULL);
-	if (kstat_read(kc, ksp, NULL) == -1)
-		return (NULL);
-	return (ksp);
-}
-
 /*
  * Note: the following helpers do not clean up on the failure case,
  * because it is left to the free_snapshot() in the acquire_snapshot()
@@ -69,16 +57,24 @@ kstat_lookup_read(kstat_ctl_t *kc, char *module,
 static int
 acquire_cpus(struct snapshot *ss, kstat_ctl_t *kc)
 {
-	size_t i;
+	kstat_t **ksps = NULL;
+	size_t i, j, nksps = 0;
 
 	ss->s_nr_cpus = sysconf(_SC_CPUID_MAX) + 1;
 	ss->s_cpus = calloc(ss->s_nr_cpus, sizeof (struct cpu_snapshot));
 	if (ss->s_cpus == NULL)
 		goto out;
 
-	for (i = 0; i < ss->s_nr_cpus; i++) {
-		kstat_t *ksp;
+	/*
+	 * Find the cpu_info, vm and sys kstats of every CPU first, and then
+	 * read them all with one kstat_read_many(); on a large system, one
+	 * ioctl for each of them is much of the cost of a snapshot.
+	 */
+	ksps = calloc(3 * ss->s_nr_cpus, sizeof (kstat_t *));
+	if (ksps == NULL)
+		goto out;
 
+	for (i = 0; i < ss->s_nr_cpus; i++) {
 		ss->s_cpus[i].cs_id = ID_NO_CPU;
 		ss->s_cpus[i].cs_state = p_online(i, P_STATUS);
 		/* If no valid CPU is present, move on to the next one */
@@ -86,7 +82,8 @@ acquire_cpus(struct snapshot *ss, kstat_ctl_t *kc)
 			continue;
 		ss->s_cpus[i].cs_id = i;
 
-		if ((ksp = kstat_lookup_read(kc, "cpu_info", i, NULL)) == NULL)
+		if ((ksps[nksps++] = kstat_lookup(kc, "cpu_info", i,
+		    NULL)) == NULL)
 			goto out;
 
 		(void) pset_assign(PS_QUERY, i, &ss->s_cpus[i].cs_pset_id);
@@ -96,21 +93,36 @@ acquire_cpus(struct snapshot *ss, kstat_ctl_t *kc)
 		if (!CPU_ACTIVE(&ss->s_cpus[i]))
 			continue;
 
-		if ((ksp = kstat_lookup_read(kc, "cpu", i, "vm")) == NULL)
+		if ((ksps[nksps++] = kstat_lookup(kc, "cpu", i, "vm")) == NULL)
 			goto out;
 
-		if (kstat_copy(ksp, &ss->s_cpus[i].cs_vm))
+		if ((ksps[nksps++] = kstat_lookup(kc, "cpu", i, "sys")) ==
+		    NULL)
 			goto out;
+	}
+
+	if (kstat_read_many(kc, ksps, nksps) == -1)
+		goto out;
+
+	for (i = 0, j = 0; i < ss->s_nr_cpus; i++) {
+		if (ss->s_cpus[i].cs_id == ID_NO_CPU)
+			continue;
 
-		if ((ksp = kstat_lookup_read(kc, "cpu", i, "sys")) == NULL)
+		j++;	/* cpu_info */
+
+		if (!CPU_ACTIVE(&ss->s_cpus[i]))
+			continue;
+
+		if (kstat_copy(ksps[j++], &ss->s_cpus[i].cs_vm))
 			goto out;
 
-		if (kstat_copy(ksp, &ss->s_cpus[i].cs_sys))
+		if (kstat_copy(ksps[j++], &ss->s_cpus[i].cs_sys))
 			goto out;
 	}
 
 	errno = 0;
 out:
+	free(ksps);
 	return (errno);
 }
 
@@ -184,8 +196,8 @@ static int
 acquire_intrs(struct snapshot *ss, kstat_ctl_t *kc)
 {
 	kstat_t *ksp;
-	size_t i = 0;
-	kstat_t *sys_misc;
+	size_t i = 0, nksps = 0;
+	kstat_t *sys_misc, **ksps = NULL;
 	kstat_named_t *clock;
 
 	/* clock interrupt */
@@ -200,8 +212,23 @@ acquire_intrs(struct snapshot *ss, kstat_ctl_t *kc)
 	if (ss->s_intrs == NULL)
 		return (errno);
 
-	sys_misc = kstat_lookup_read(kc, "unix", 0, "system_misc");
-	if (sys_misc == NULL)
+	/*
+	 * Read the system_misc kstat and every interrupt kstat at once.
+	 */
+	if ((ksps = calloc(ss->s_nr_intrs, sizeof (kstat_t *))) == NULL)
+		goto out;
+
+	if ((sys_misc = kstat_lookup(kc, "unix", 0, "system_misc")) == NULL)
+		goto out;
+
+	ksps[nksps++] = sys_misc;
+
+	for (ksp = kc->kc_chain; ksp; ksp = ksp->ks_next) {
+		if (ksp->ks_type == KSTAT_TYPE_INTR)
+			ksps[nksps++] = ksp;
+	}
+
+	if (kstat_read_many(kc, ksps, nksps) == -1)
 		goto out;
 
 	clock = (kstat_named_t *)kstat_data_lookup(sys_misc, "clk_intr");
@@ -219,8 +246,6 @@ acquire_intrs(struct snapshot *ss, kstat_ctl_t *kc)
 
 		if (ksp->ks_type != KSTAT_TYPE_INTR)
 			continue;
-		if (kstat_read(kc, ksp, NULL) == -1)
-			goto out;
 
 		ki = KSTAT_INTR_PTR(ksp);
 
@@ -236,6 +261,7 @@ acquire_intrs(struct snapshot *ss, kstat_ctl_t *kc)
 
 	errno = 0;
 out:
+	free(ksps);
 	return (errno);
 }
 
@@ -58,6 +58,7 @@ static uint_t timestamp_fmt = NODATE;
 static int hz;
 static int display_pset = -1;
 static int show_set = 0;
+static int show_steal = 0;
 static int suppress_state;
 
 static void print_header(int, int);
@@ -86,7 +87,7 @@ main(int argc, char **argv)
 #endif
 	(void) textdomain(TEXT_DOMAIN);
 
-	while ((c = getopt(argc, argv, "apP:qT:")) != (int)EOF)
+	while ((c = getopt(argc, argv, "apP:qsT:")) != (int)EOF)
 		switch (c) {
 			case 'a':
 				/*
@@ -122,6 +123,12 @@ main(int argc, char **argv)
 			case 'q':
 				suppress_state = 1;
 				break;
+			case 's':
+				/*
+				 * Display time stolen by the hypervisor.
+				 */
+				show_steal = 1;
+				break;
 			case 'T':
 				if (optarg) {
 					if (*optarg == 'u')
@@ -211,6 +218,8 @@ print_header(int display_agg, int show_set)
 		if (show_set == 1)
 			(void) printf(" set");
 	}
+	if (show_steal)
+		(void) printf(" stl");
 	(void) printf("\n");
 }
 
@@ -273,6 +282,9 @@ print_cpu(struct cpu_snapshot *c1, struct cpu_snapshot *c2)
 
 	if (show_set)
 		(void) printf(" %3d", c2->cs_pset_id);
+	if (show_steal)
+		(void) printf(" %3.0f", kstat_delta(old_sys, &c2->cs_sys,
+		    "cpu_nsec_steal") * percent * hz / NANOSEC);
 	(void) printf("\n");
 }
 
@@ -355,6 +367,7 @@ agg_sys(struct pset_snapshot *p, kstat_t *ks)
 		agg_stat(ks, &p->ps_cpus[i]->cs_sys, "cpu_ticks_kernel");
 		agg_stat(ks, &p->ps_cpus[i]->cs_sys, "cpu_ticks_wait");
 		agg_stat(ks, &p->ps_cpus[i]->cs_sys, "cpu_ticks_idle");
+		agg_stat(ks, &p->ps_cpus[i]->cs_sys, "cpu_nsec_steal");
 	}
 
 	return (ks);
@@ -437,7 +450,7 @@ print_pset(struct pset_snapshot *p1, struct pset_snapshot *p2)
 
 	(void) printf("%3d %4.0f %3.0f %4.0f %5.0f %4.0f "
 	    "%4.0f %4.0f %4.0f %4.0f %4.0f %5.0f  %3.0f %3.0f "
-	    "%3.0f %3.0f %3d\n",
+	    "%3.0f %3.0f %3d",
 	    p2->ps_id,
 	    (kstat_delta(&old_vm, &new_vm, "hat_fault") +
 	    kstat_delta(&old_vm, &new_vm, "as_fault")) / etime,
@@ -457,6 +470,10 @@ print_pset(struct pset_snapshot *p1, struct pset_snapshot *p2)
 	    kstat_delta(&old_sys, &new_sys, "cpu_ticks_wait") * percent,
 	    kstat_delta(&old_sys, &new_sys, "cpu_ticks_idle") * percent,
 	    p2->ps_nr_cpus);
+	if (show_steal)
+		(void) printf(" %3.0f", kstat_delta(&old_sys, &new_sys,
+		    "cpu_nsec_steal") * percent * hz / NANOSEC);
+	(void) printf("\n");
 
 out:
 	free(old_vm.ks_data);
@@ -516,7 +533,7 @@ static void
 usage(void)
 {
 	(void) fprintf(stderr,
-	    "Usage: mpstat [-aq] [-p | -P processor_set] [-T d|u] "
+	    "Usage: mpstat [-aqs] [-p | -P processor_set] [-T d|u] "
 	    "[interval [count]]\n");
 	exit(1);
 }
@@ -231,6 +231,10 @@ static boolean_t console_login_ready = B_FALSE;
 /* Number of services to come down to complete milestone transition. */
 static uint_t non_subgraph_svcs;
 
+/* protected by dgraph_lock */
+static hrtime_t graph_init_time;
+static boolean_t critical_path_reported = B_FALSE;
+
 /*
  * These variables indicate what should be done when we reach the milestone
  * target milestone, i.e., when non_subgraph_svcs == 0.  They are acted upon in
@@ -348,6 +352,8 @@ graph_init()
 	if (!st->st_initial)
 		current_runlevel = utmpx_get_runlevel();
 
+	graph_init_time = gethrtime();
+
 	log_framework(LOG_DEBUG, "Initialized graph\n");
 }
 
@@ -893,6 +899,7 @@ vertex_send_event(graph_vertex_t *v, restarter_event_type_t e)
 	case RESTARTER_EVENT_TYPE_START:
 		log_framework(LOG_DEBUG, "Starting %s.\n", v->gv_name);
 		assert(v->gv_state == RESTARTER_STATE_OFFLINE);
+		v->gv_start_time = gethrtime();
 		break;
 
 	case RESTARTER_EVENT_TYPE_REMOVE_INSTANCE:
@@ -4944,6 +4951,81 @@ graph_transition_sulogin(restarter_instance_state_t state,
 	}
 }
 
+/*
+ * Return the instance, among those v depends on directly or through
+ * dependency group and service vertices, that came online last but no later
+ * than 'before'.  That is the dependency v was most likely waiting for.
+ */
+static graph_vertex_t *
+vertex_last_online_dep(graph_vertex_t *v, hrtime_t before)
+{
+	graph_edge_t *e;
+	graph_vertex_t *dv, *last = NULL;
+
+	assert(MUTEX_HELD(&dgraph_lock));
+
+	for (e = uu_list_first(v->gv_dependencies); e != NULL;
+	    e = uu_list_next(v->gv_dependencies, e)) {
+		dv = e->ge_vertex;
+
+		if (dv->gv_type == GVT_GROUP &&
+		    dv->gv_depgroup == DEPGRP_EXCLUDE_ALL)
+			continue;
+		if (dv->gv_type != GVT_INST)
+			dv = vertex_last_online_dep(dv, before);
+
+		if (dv == NULL || dv->gv_online_time == 0 ||
+		    dv->gv_online_time > before)
+			continue;
+		if (last == NULL || dv->gv_online_time > last->gv_online_time)
+			last = dv;
+	}
+
+	return (last);
+}
+
+/*
+ * Called as each instance comes online.  When the milestone the system is
+ * booting to comes online for the first time, log the chain of instances
+ * that determined when it did, each with the time it came online (since the
+ * graph engine started) and how long it took to start.  During a boot storm
+ * this shows which services are worth making faster.
+ */
+void
+graph_report_critical_path(graph_vertex_t *v)
+{
+	const char *target;
+	graph_vertex_t *cv;
+	hrtime_t start;
+
+	assert(MUTEX_HELD(&dgraph_lock));
+
+	if (critical_path_reported || !st->st_initial ||
+	    milestone == MILESTONE_NONE)
+		return;
+
+	target = milestone == NULL ? multi_user_svr_fmri : milestone->gv_name;
+	if (strcmp(v->gv_name, target) != 0)
+		return;
+
+	critical_path_reported = B_TRUE;
+
+	log_framework(LOG_INFO, "Boot critical path to %s (%lld ms):\n",
+	    v->gv_name, (v->gv_online_time - graph_init_time) / MICROSEC);
+	log_framework(LOG_INFO, "  %10s %10s  %s\n", "online_ms", "start_ms",
+	    "instance");
+
+	for (cv = v; cv != NULL;
+	    cv = vertex_last_online_dep(cv, cv->gv_online_time)) {
+		start = cv->gv_start_time != 0 &&
+		    cv->gv_start_time <= cv->gv_online_time ?
+		    cv->gv_start_time : cv->gv_online_time;
+		log_framework(LOG_INFO, "  %10lld %10lld  %s\n",
+		    (cv->gv_online_time - graph_init_time) / MICROSEC,
+		    (cv->gv_online_time - start) / MICROSEC, cv->gv_name);
+	}
+}
+
 /*
  * Propagate a start, stop event, or a satisfiability event.
  *
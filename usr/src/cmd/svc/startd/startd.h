@@ -336,6 +336,9 @@ typedef struct graph_vertex {
 
 	int32_t				gv_stn_tset;
 	int32_t				gv_reason;
+
+	hrtime_t			gv_start_time;	/* start requested */
+	hrtime_t			gv_online_time;	/* last came up */
 } graph_vertex_t;
 
 typedef struct graph_edge {
@@ -629,6 +632,7 @@ void graph_transition_sulogin(restarter_instance_state_t,
     restarter_instance_state_t);
 void graph_transition_propagate(graph_vertex_t *, propagate_event_t,
     restarter_error_t);
+void graph_report_critical_path(graph_vertex_t *);
 void graph_offline_subtree_leaves(graph_vertex_t *, void *);
 void offline_vertex(graph_vertex_t *);
 
@@ -297,6 +297,11 @@ gt_internal_online_or_degraded(scf_handle_t *h, graph_vertex_t *v,
 		    v->gv_post_online_f)
 			v->gv_post_online_f();
 
+		if (old_state != RESTARTER_STATE_UNINIT) {
+			v->gv_online_time = gethrtime();
+			graph_report_critical_path(v);
+		}
+
 		r = libscf_snapshots_poststart(h, v->gv_name, B_TRUE);
 		switch (r) {
 		case 0:
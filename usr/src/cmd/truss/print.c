@@ -846,6 +846,9 @@ prt_mad(private_t *pri, int raw, long val)	/* print madvise() argument */
 		case MADV_ACCESS_LWP:	s = "MADV_ACCESS_LWP";	break;
 		case MADV_ACCESS_MANY:	s = "MADV_ACCESS_MANY";	break;
 		case MADV_PURGE:	s = "MADV_PURGE";	break;
+		case MADV_ACCESS_INTERLEAVE:
+			s = "MADV_ACCESS_INTERLEAVE";
+			break;
 		}
 	}
 
@@ -2447,6 +2450,9 @@ prt_zga(private_t *pri, int raw, long val)
 		case ZONE_ATTR_BRAND:	s = "ZONE_ATTR_BRAND"; break;
 		case ZONE_ATTR_FLAGS:	s = "ZONE_ATTR_FLAGS"; break;
 		case ZONE_ATTR_PHYS_MCAP: s = "ZONE_ATTR_PHYS_MCAP"; break;
+		case ZONE_ATTR_LPG_PROMOTE:
+			s = "ZONE_ATTR_LPG_PROMOTE";
+			break;
 		}
 	}
 
@@ -344,7 +344,7 @@ const struct systable systable[] = {
 {"writev",	3, DEC, NOV, DEC, HEX, DEC},			/* 122 */
 {"preadv",	4, DEC, NOV, DEC, HEX, DEC, DEC},		/* 123 */
 {"pwritev",	4, DEC, NOV, DEC, HEX, DEC, DEC},		/* 124 */
-{ NULL,		8, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX},
+{"getdentsattr", 3, DEC, NOV, DEC, HEX, UNS},			/* 125 */
 {"getrandom",	3, DEC, NOV, IOB, UNS, GRF},			/* 126 */
 {"mmapobj",	5, DEC, NOV, DEC, MOB, HEX, HEX, HEX},		/* 127 */
 {"setrlimit",	2, DEC, NOV, RLM, HEX},				/* 128 */
@@ -366,14 +366,14 @@ const struct systable systable[] = {
 {"sigtimedwait", 3, DEC, NOV, HEX, HEX, HEX},			/* 144 */
 {"lwp_info",	1, DEC, NOV, HEX},				/* 145 */
 {"yield",	0, DEC, NOV},					/* 146 */
-{ NULL,		8, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX},
+{"lwp_addr_sys", 5, DEC, NOV, DEC, HEX, HEX, HEX, HEX},		/* 147 */
 {"lwp_sema_post", 1, DEC, NOV, HEX},				/* 148 */
 {"lwp_sema_trywait", 1, DEC, NOV, HEX},				/* 149 */
 {"lwp_detach",	1, DEC, NOV, DEC},				/* 150 */
 {"corectl",	4, DEC, NOV, DEC, HEX, HEX, HEX},		/* 151 */
 {"modctl",	5, DEC, NOV, MOD, HEX, HEX, HEX, HEX},		/* 152 */
 {"fchroot",	1, DEC, NOV, DEC},				/* 153 */
-{ NULL,		8, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX},
+{"sendmmsg",	4, DEC, NOV, DEC, HEX, UNS, DEC},		/* 154 */
 {"vhangup",	0, DEC, NOV},					/* 155 */
 {"gettimeofday", 1, DEC, NOV, HEX},				/* 156 */
 {"getitimer",	2, DEC, NOV, ITM, HEX},				/* 157 */
@@ -388,7 +388,7 @@ const struct systable systable[] = {
 {"lwp_private",	3, HEX, NOV, DEC, DEC, HEX},			/* 166 */
 {"lwp_wait",	2, DEC, NOV, DEC, HEX},				/* 167 */
 {"lwp_mutex_wakeup", 2, DEC, NOV, HEX, DEC},			/* 168 */
-{ NULL,		8, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX, HEX},
+{"recvmmsg",	5, DEC, NOV, DEC, HEX, UNS, DEC, HEX},		/* 169 */
 {"lwp_cond_wait", 4, DEC, NOV, HEX, HEX, HEX, DEC},		/* 170 */
 {"lwp_cond_signal", 1, DEC, NOV, HEX},				/* 171 */
 {"lwp_cond_broadcast", 1, DEC, NOV, HEX},			/* 172 */
@@ -812,6 +812,13 @@ static	const	struct systable lwprwlocktable[] = {
 };
 #define	NLWPRWLOCKCODE	(sizeof (lwprwlocktable) / sizeof (struct systable))
 
+static	const	struct systable lwpaddrtable[] = {
+{"lwp_addr_wait", 5, DEC, NOV, HID, HEX, HEX, HEX, HEX},	/* 0 */
+{"lwp_addr_wait_park", 5, DEC, NOV, HID, HEX, HEX, HEX, HEX},	/* 1 */
+{"lwp_addr_wake", 5, DEC, NOV, HID, HEX, DEC, HID, HEX},	/* 2 */
+};
+#define	NLWPADDRCODE	(sizeof (lwpaddrtable) / sizeof (struct systable))
+
 static	const	struct systable sendfilevsystable[] = {
 {"sendfilev",	5, DEC, NOV, DEC, DEC, HEX, DEC, HEX},		/* 0 */
 {"sendfilev64",	5, DEC, NOV, DEC, DEC, HEX, DEC, HEX},		/* 1 */
@@ -1026,6 +1033,9 @@ const	struct sysalias sysalias[] = {
 	{ "lwp_rwlock_tryrdlock", SYS_lwp_rwlock_sys },
 	{ "lwp_rwlock_trywrlock", SYS_lwp_rwlock_sys },
 	{ "lwp_rwlock_unlock",	SYS_lwp_rwlock_sys },
+	{ "lwp_addr_wait",	SYS_lwp_addr_sys },
+	{ "lwp_addr_wait_park",	SYS_lwp_addr_sys },
+	{ "lwp_addr_wake",	SYS_lwp_addr_sys },
 	{ "lwp_mutex_lock",	SYS_lwp_mutex_timedlock },
 	{ "sendfilev64",	SYS_sendfilev	},
 	{ "creat",		SYS_open	},
@@ -1228,6 +1238,10 @@ subsys(int syscall, int subcode)
 			if ((unsigned)subcode < NLWPRWLOCKCODE)
 				stp = &lwprwlocktable[subcode];
 			break;
+		case SYS_lwp_addr_sys:
+			if ((unsigned)subcode < NLWPADDRCODE)
+				stp = &lwpaddrtable[subcode];
+			break;
 		case SYS_sendfilev:	/* sendfilev */
 			if ((unsigned)subcode < NSENDFILESYSCODE)
 				stp = &sendfilevsystable[subcode];
@@ -1482,6 +1496,7 @@ getsubcode(private_t *pri)
 		case SYS_exacctsys:	/* exacct */
 		case SYS_lwp_park:	/* lwp_park */
 		case SYS_lwp_rwlock_sys: /* lwp_rwlock_*() */
+		case SYS_lwp_addr_sys:	/* lwp_addr_*() */
 		case SYS_sendfilev:	/* sendfilev */
 		case SYS_lgrpsys:	/* lgrpsys */
 		case SYS_rusagesys:	/* rusagesys */
@@ -1649,6 +1664,8 @@ nsubcodes(int syscall)
 		return (NLWPPARKCODE);
 	case SYS_lwp_rwlock_sys:
 		return (NLWPRWLOCKCODE);
+	case SYS_lwp_addr_sys:
+		return (NLWPADDRCODE);
 	case SYS_sendfilev:
 		return (NSENDFILESYSCODE);
 	case SYS_lgrpsys:
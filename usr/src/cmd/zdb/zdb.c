@@ -78,6 +78,7 @@
 extern boolean_t zfs_recover;
 extern uint64_t zfs_arc_max, zfs_arc_meta_limit;
 extern int zfs_vdev_async_read_max_active;
+extern int zfs_traverse_pool_threads;
 #else
 boolean_t zfs_recover;
 uint64_t zfs_arc_max, zfs_arc_meta_limit;
@@ -94,6 +95,7 @@ uint64_t *zopt_object = NULL;
 int zopt_objects = 0;
 libzfs_handle_t *g_zfs;
 uint64_t max_inflight = 1000;
+int traverse_threads = 0;
 
 static void snprintf_blkptr_compact(char *, size_t, const blkptr_t *);
 
@@ -118,7 +120,8 @@ usage(void)
 {
 	(void) fprintf(stderr,
 	    "Usage: %s [-CumMdibcsDvhLXFPAG] [-t txg] [-e [-p path...]] "
-	    "[-U config] [-I inflight I/Os] [-x dumpdir] poolname [object...]\n"
+	    "[-U config] [-I inflight I/Os] [-T threads] [-x dumpdir] "
+	    "poolname [object...]\n"
 	    "       %s [-divPA] [-e -p path...] [-U config] dataset "
 	    "[object...]\n"
 	    "       %s -mM [-LXFPA] [-t txg] [-e [-p path...]] [-U config] "
@@ -178,6 +181,8 @@ usage(void)
 	(void) fprintf(stderr, "        -I <number of inflight I/Os> -- "
 	    "specify the maximum number of "
 	    "checksumming I/Os [default is 200]\n");
+	(void) fprintf(stderr, "        -T <threads> -- traverse datasets "
+	    "in parallel for -b and -c, reading blocks in disk order\n");
 	(void) fprintf(stderr, "        -G dump zfs_dbgmsg buffer before "
 	    "exiting\n");
 	(void) fprintf(stderr, "Specify an option more than once (e.g. -bb) "
@@ -734,13 +739,13 @@ dump_metaslab_stats(metaslab_t *msp)
 {
 	char maxbuf[32];
 	range_tree_t *rt = msp->ms_tree;
-	avl_tree_t *t = &msp->ms_size_tree;
+	zfs_btree_t *t = &msp->ms_size_tree;
 	int free_pct = range_tree_space(rt) * 100 / msp->ms_size;
 
 	zdb_nicenum(metaslab_block_maxsize(msp), maxbuf);
 
 	(void) printf("\t %25s %10lu   %7s  %6s   %4s %4d%%\n",
-	    "segments", avl_numnodes(t), "maxsize", maxbuf,
+	    "segments", zfs_btree_numnodes(t), "maxsize", maxbuf,
 	    "freepct", free_pct);
 	(void) printf("\tIn-memory histogram:\n");
 	dump_histogram(rt->rt_histogram, RANGE_TREE_HISTOGRAM_SIZE, 0);
@@ -754,7 +759,7 @@ dump_metaslab(metaslab_t *msp)
 	space_map_t *sm = msp->ms_sm;
 	char freebuf[32];
 
-	zdb_nicenum(msp->ms_size - space_map_allocated(sm), freebuf);
+	zdb_nicenum(msp->ms_size - metaslab_allocated_space(msp), freebuf);
 
 	(void) printf(
 	    "\tmetaslab %6llu   offset %12llx   spacemap %6llu   free    %5s\n",
@@ -2275,6 +2280,18 @@ static char *zdb_ot_extname[] = {
 
 #define	ZB_TOTAL	DN_MAX_LEVELS
 
+/*
+ * With -T, checksum reads are queued and issued in batches sorted by
+ * location on disk, rather than in the order traversal finds them.
+ */
+#define	ZDB_READ_BATCH	16384
+
+typedef struct zdb_read {
+	blkptr_t	zr_bp;
+	zbookmark_phys_t zr_zb;
+	int		zr_flags;
+} zdb_read_t;
+
 typedef struct zdb_cb {
 	zdb_blkstats_t	zcb_type[ZB_TOTAL + 1][ZDB_OT_TOTAL + 1];
 	uint64_t	zcb_dedup_asize;
@@ -2289,6 +2306,10 @@ typedef struct zdb_cb {
 	int		zcb_readfails;
 	int		zcb_haderrors;
 	spa_t		*zcb_spa;
+	kmutex_t	zcb_lock;	/* stats, with -T */
+	kmutex_t	zcb_read_lock;	/* protects zcb_reads */
+	zdb_read_t	*zcb_reads;
+	int		zcb_nreads;
 } zdb_cb_t;
 
 static void
@@ -2302,6 +2323,7 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 	if (zilog && zil_bp_tree_add(zilog, bp) != 0)
 		return;
 
+	mutex_enter(&zcb->zcb_lock);
 	for (int i = 0; i < 4; i++) {
 		int l = (i < 2) ? BP_GET_LEVEL(bp) : ZB_TOTAL;
 		int t = (i & 1) ? type : ZDB_OT_TOTAL;
@@ -2348,8 +2370,10 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 		zcb->zcb_embedded_blocks[BPE_GET_ETYPE(bp)]++;
 		zcb->zcb_embedded_histogram[BPE_GET_ETYPE(bp)]
 		    [BPE_GET_PSIZE(bp)]++;
+		mutex_exit(&zcb->zcb_lock);
 		return;
 	}
+	mutex_exit(&zcb->zcb_lock);
 
 	if (dump_opt['L'])
 		return;
@@ -2418,6 +2442,77 @@ zdb_blkptr_done(zio_t *zio)
 	mutex_exit(&spa->spa_scrub_lock);
 }
 
+static void
+zdb_issue_read(zdb_cb_t *zcb, const blkptr_t *bp, const zbookmark_phys_t *zb,
+    int flags)
+{
+	spa_t *spa = zcb->zcb_spa;
+	size_t size = BP_GET_PSIZE(bp);
+	void *data = zio_data_buf_alloc(size);
+
+	mutex_enter(&spa->spa_scrub_lock);
+	while (spa->spa_scrub_inflight > max_inflight)
+		cv_wait(&spa->spa_scrub_io_cv, &spa->spa_scrub_lock);
+	spa->spa_scrub_inflight++;
+	mutex_exit(&spa->spa_scrub_lock);
+
+	zio_nowait(zio_read(NULL, spa, bp, data, size,
+	    zdb_blkptr_done, zcb, ZIO_PRIORITY_ASYNC_READ, flags, zb));
+}
+
+static int
+zdb_read_compare(const void *x1, const void *x2)
+{
+	const dva_t *d1 = &((const zdb_read_t *)x1)->zr_bp.blk_dva[0];
+	const dva_t *d2 = &((const zdb_read_t *)x2)->zr_bp.blk_dva[0];
+
+	if (DVA_GET_VDEV(d1) < DVA_GET_VDEV(d2))
+		return (-1);
+	if (DVA_GET_VDEV(d1) > DVA_GET_VDEV(d2))
+		return (1);
+	if (DVA_GET_OFFSET(d1) < DVA_GET_OFFSET(d2))
+		return (-1);
+	if (DVA_GET_OFFSET(d1) > DVA_GET_OFFSET(d2))
+		return (1);
+	return (0);
+}
+
+/*
+ * Issue the queued reads in order of their first DVA, so that each disk
+ * sees a mostly sequential stream instead of seeking back and forth
+ * between the blocks of different objects and datasets.
+ */
+static void
+zdb_flush_reads(zdb_cb_t *zcb)
+{
+	ASSERT(MUTEX_HELD(&zcb->zcb_read_lock));
+
+	qsort(zcb->zcb_reads, zcb->zcb_nreads, sizeof (zdb_read_t),
+	    zdb_read_compare);
+	for (int i = 0; i < zcb->zcb_nreads; i++) {
+		zdb_read_t *zr = &zcb->zcb_reads[i];
+
+		zdb_issue_read(zcb, &zr->zr_bp, &zr->zr_zb, zr->zr_flags);
+	}
+	zcb->zcb_nreads = 0;
+}
+
+static void
+zdb_queue_read(zdb_cb_t *zcb, const blkptr_t *bp, const zbookmark_phys_t *zb,
+    int flags)
+{
+	zdb_read_t *zr;
+
+	mutex_enter(&zcb->zcb_read_lock);
+	zr = &zcb->zcb_reads[zcb->zcb_nreads++];
+	zr->zr_bp = *bp;
+	zr->zr_zb = *zb;
+	zr->zr_flags = flags;
+	if (zcb->zcb_nreads == ZDB_READ_BATCH)
+		zdb_flush_reads(zcb);
+	mutex_exit(&zcb->zcb_read_lock);
+}
+
 static int
 zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
@@ -2453,32 +2548,29 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	if (!BP_IS_EMBEDDED(bp) &&
 	    (dump_opt['c'] > 1 || (dump_opt['c'] && is_metadata))) {
-		size_t size = BP_GET_PSIZE(bp);
-		void *data = zio_data_buf_alloc(size);
 		int flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SCRUB | ZIO_FLAG_RAW;
 
 		/* If it's an intent log block, failure is expected. */
 		if (zb->zb_level == ZB_ZIL_LEVEL)
 			flags |= ZIO_FLAG_SPECULATIVE;
 
-		mutex_enter(&spa->spa_scrub_lock);
-		while (spa->spa_scrub_inflight > max_inflight)
-			cv_wait(&spa->spa_scrub_io_cv, &spa->spa_scrub_lock);
-		spa->spa_scrub_inflight++;
-		mutex_exit(&spa->spa_scrub_lock);
-
-		zio_nowait(zio_read(NULL, spa, bp, data, size,
-		    zdb_blkptr_done, zcb, ZIO_PRIORITY_ASYNC_READ, flags, zb));
+		if (zcb->zcb_reads != NULL)
+			zdb_queue_read(zcb, bp, zb, flags);
+		else
+			zdb_issue_read(zcb, bp, zb, flags);
 	}
 
+	mutex_enter(&zcb->zcb_lock);
 	zcb->zcb_readfails = 0;
 
 	/* only call gethrtime() every 100 blocks */
 	static int iters;
-	if (++iters > 100)
+	if (++iters > 100) {
 		iters = 0;
-	else
+	} else {
+		mutex_exit(&zcb->zcb_lock);
 		return (0);
+	}
 
 	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
 		uint64_t now = gethrtime();
@@ -2500,6 +2592,7 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 		zcb->zcb_lastprint = now;
 	}
+	mutex_exit(&zcb->zcb_lock);
 
 	return (0);
 }
@@ -2578,7 +2671,8 @@ zdb_leak_init(spa_t *spa, zdb_cb_t *zcb)
 				 * we can't use the normal metaslab_load/unload
 				 * interfaces.
 				 */
-				if (msp->ms_sm != NULL) {
+				if (msp->ms_sm != NULL ||
+				    msp->ms_unflushed) {
 					(void) fprintf(stderr,
 					    "\rloading space map for "
 					    "vdev %llu of %llu, "
@@ -2597,8 +2691,22 @@ zdb_leak_init(spa_t *spa, zdb_cb_t *zcb)
 					 * ops.
 					 */
 					msp->ms_tree->rt_ops = NULL;
-					VERIFY0(space_map_load(msp->ms_sm,
-					    msp->ms_tree, SM_ALLOC));
+					if (msp->ms_sm != NULL) {
+						VERIFY0(space_map_load(
+						    msp->ms_sm, msp->ms_tree,
+						    SM_ALLOC));
+					}
+
+					/*
+					 * Add what is only in the log space
+					 * maps so far.
+					 */
+					range_tree_walk(
+					    msp->ms_unflushed_allocs,
+					    range_tree_add, msp->ms_tree);
+					range_tree_walk(
+					    msp->ms_unflushed_frees,
+					    range_tree_remove, msp->ms_tree);
 					msp->ms_loaded = B_TRUE;
 				}
 				mutex_exit(&msp->ms_lock);
@@ -2669,6 +2777,9 @@ dump_block_stats(spa_t *spa)
 	int flags = TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | TRAVERSE_HARD;
 	boolean_t leaks = B_FALSE;
 
+	mutex_init(&zcb.zcb_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&zcb.zcb_read_lock, NULL, MUTEX_DEFAULT, NULL);
+
 	(void) printf("\nTraversing all blocks %s%s%s%s%s...\n\n",
 	    (dump_opt['c'] || !dump_opt['L']) ? "to verify " : "",
 	    (dump_opt['c'] == 1) ? "metadata " : "",
@@ -2701,13 +2812,33 @@ dump_block_stats(spa_t *spa)
 		    &zcb, NULL));
 	}
 
-	if (dump_opt['c'] > 1)
+	if (traverse_threads > 1) {
+		/*
+		 * The sorted batches of checksum reads are their own
+		 * read-ahead; prefetching the data through the ARC as well
+		 * would just read it twice, since those reads bypass it.
+		 */
+		flags |= TRAVERSE_PARALLEL;
+		if (dump_opt['c']) {
+			zcb.zcb_reads = umem_alloc(ZDB_READ_BATCH *
+			    sizeof (zdb_read_t), UMEM_NOFAIL);
+		}
+	} else if (dump_opt['c'] > 1) {
 		flags |= TRAVERSE_PREFETCH_DATA;
+	}
 
 	zcb.zcb_totalasize = metaslab_class_get_alloc(spa_normal_class(spa));
 	zcb.zcb_start = zcb.zcb_lastprint = gethrtime();
 	zcb.zcb_haderrors |= traverse_pool(spa, 0, flags, zdb_blkptr_cb, &zcb);
 
+	if (zcb.zcb_reads != NULL) {
+		mutex_enter(&zcb.zcb_read_lock);
+		zdb_flush_reads(&zcb);
+		mutex_exit(&zcb.zcb_read_lock);
+		umem_free(zcb.zcb_reads, ZDB_READ_BATCH * sizeof (zdb_read_t));
+		zcb.zcb_reads = NULL;
+	}
+
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
 	 * I/Os to complete. We leverage "The Godfather" zio to wait on
@@ -2743,7 +2874,10 @@ dump_block_stats(spa_t *spa)
 	norm_alloc = metaslab_class_get_alloc(spa_normal_class(spa));
 	norm_space = metaslab_class_get_space(spa_normal_class(spa));
 
-	total_alloc = norm_alloc + metaslab_class_get_alloc(spa_log_class(spa));
+	total_alloc = norm_alloc +
+	    metaslab_class_get_alloc(spa_log_class(spa)) +
+	    metaslab_class_get_alloc(spa_dedup_class(spa)) +
+	    metaslab_class_get_alloc(spa_special_class(spa));
 	total_found = tzb->zb_asize - zcb.zcb_dedup_asize;
 
 	if (total_found == total_alloc) {
@@ -3565,7 +3699,7 @@ main(int argc, char **argv)
 		spa_config_path = spa_config_path_env;
 
 	while ((c = getopt(argc, argv,
-	    "bcdhilmMI:suCDRSAFLXx:evp:t:U:PG")) != -1) {
+	    "bcdhilmMI:suCDRSAFLXx:evp:t:T:U:PG")) != -1) {
 		switch (c) {
 		case 'b':
 		case 'c':
@@ -3625,6 +3759,14 @@ main(int argc, char **argv)
 				usage();
 			}
 			break;
+		case 'T':
+			traverse_threads = strtol(optarg, NULL, 0);
+			if (traverse_threads <= 0) {
+				(void) fprintf(stderr, "number of traversal "
+				    "threads must be greater than 0\n");
+				usage();
+			}
+			break;
 		case 'U':
 			spa_config_path = optarg;
 			break;
@@ -3658,6 +3800,19 @@ main(int argc, char **argv)
 	 */
 	zfs_vdev_async_read_max_active = 10;
 
+	/*
+	 * With parallel traversal every thread keeps its own prefetch
+	 * stream of metadata going, so give each of them its share of the
+	 * ARC and of the device queues.
+	 */
+	if (traverse_threads > 1) {
+		zfs_traverse_pool_threads = traverse_threads;
+		zfs_arc_max = zfs_arc_meta_limit =
+		    (uint64_t)traverse_threads * 256 * 1024 * 1024;
+		zfs_vdev_async_read_max_active = MIN(traverse_threads * 10,
+		    1000);
+	}
+
 	kernel_init(FREAD);
 	g_zfs = libzfs_init();
 	ASSERT(g_zfs != NULL);
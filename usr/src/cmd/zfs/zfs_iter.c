@@ -95,6 +95,11 @@ zfs_callback(zfs_handle_t *zhp, void *data)
 	boolean_t should_close = B_TRUE;
 	boolean_t include_snaps = zfs_include_snapshots(zhp, cb);
 	boolean_t include_bmarks = (cb->cb_types & ZFS_TYPE_BOOKMARK);
+	uint8_t *props_table = NULL;
+
+	if (cb->cb_proplist && (*cb->cb_proplist) &&
+	    !(*cb->cb_proplist)->pl_all)
+		props_table = cb->cb_props_table;
 
 	if ((zfs_get_type(zhp) & cb->cb_types) ||
 	    ((zfs_get_type(zhp) == ZFS_TYPE_SNAPSHOT) && include_snaps)) {
@@ -106,10 +111,8 @@ zfs_callback(zfs_handle_t *zhp, void *data)
 		if (uu_avl_find(cb->cb_avl, node, cb->cb_sortcol,
 		    &idx) == NULL) {
 			if (cb->cb_proplist) {
-				if ((*cb->cb_proplist) &&
-				    !(*cb->cb_proplist)->pl_all)
-					zfs_prune_proplist(zhp,
-					    cb->cb_props_table);
+				if (props_table != NULL)
+					zfs_prune_proplist(zhp, props_table);
 
 				if (zfs_expand_proplist(zhp, cb->cb_proplist,
 				    (cb->cb_flags & ZFS_ITER_RECVD_PROPS),
@@ -134,12 +137,13 @@ zfs_callback(zfs_handle_t *zhp, void *data)
 	    cb->cb_depth < cb->cb_depth_limit)) {
 		cb->cb_depth++;
 		if (zfs_get_type(zhp) == ZFS_TYPE_FILESYSTEM)
-			(void) zfs_iter_filesystems(zhp, zfs_callback, data);
+			(void) zfs_iter_filesystems_props(zhp, props_table,
+			    zfs_callback, data);
 		if (((zfs_get_type(zhp) & (ZFS_TYPE_SNAPSHOT |
 		    ZFS_TYPE_BOOKMARK)) == 0) && include_snaps)
-			(void) zfs_iter_snapshots(zhp,
-			    (cb->cb_flags & ZFS_ITER_SIMPLE) != 0, zfs_callback,
-			    data);
+			(void) zfs_iter_snapshots_props(zhp,
+			    (cb->cb_flags & ZFS_ITER_SIMPLE) != 0, props_table,
+			    zfs_callback, data);
 		if (((zfs_get_type(zhp) & (ZFS_TYPE_SNAPSHOT |
 		    ZFS_TYPE_BOOKMARK)) == 0) && include_bmarks)
 			(void) zfs_iter_bookmarks(zhp, zfs_callback, data);
@@ -401,7 +405,8 @@ zfs_for_each(int argc, char **argv, int flags, zfs_type_t types,
 	 * If cb_proplist is NULL then we retain all the properties.  We
 	 * always retain the zoned property, which some other properties
 	 * need (userquota & friends), and the createtxg property, which
-	 * we need to sort snapshots.
+	 * we need to sort snapshots.  Child datasets are fetched with only
+	 * the retained properties in the first place.
 	 */
 	if (cb.cb_proplist && *cb.cb_proplist) {
 		zprop_list_t *p = *cb.cb_proplist;
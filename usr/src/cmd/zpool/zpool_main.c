@@ -33,6 +33,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <kstat.h>
 #include <libgen.h>
 #include <libintl.h>
 #include <libuutil.h>
@@ -66,6 +67,7 @@ static int zpool_do_labelclear(int, char **);
 
 static int zpool_do_list(int, char **);
 static int zpool_do_iostat(int, char **);
+static int zpool_do_iotrace(int, char **);
 static int zpool_do_status(int, char **);
 
 static int zpool_do_online(int, char **);
@@ -81,6 +83,7 @@ static int zpool_do_replace(int, char **);
 static int zpool_do_split(int, char **);
 
 static int zpool_do_scrub(int, char **);
+static int zpool_do_trim(int, char **);
 
 static int zpool_do_import(int, char **);
 static int zpool_do_export(int, char **);
@@ -122,6 +125,7 @@ typedef enum {
 	HELP_HISTORY,
 	HELP_IMPORT,
 	HELP_IOSTAT,
+	HELP_IOTRACE,
 	HELP_LABELCLEAR,
 	HELP_LIST,
 	HELP_OFFLINE,
@@ -129,6 +133,7 @@ typedef enum {
 	HELP_REPLACE,
 	HELP_REMOVE,
 	HELP_SCRUB,
+	HELP_TRIM,
 	HELP_STATUS,
 	HELP_UPGRADE,
 	HELP_GET,
@@ -165,6 +170,7 @@ static zpool_command_t command_table[] = {
 	{ NULL },
 	{ "list",	zpool_do_list,		HELP_LIST		},
 	{ "iostat",	zpool_do_iostat,	HELP_IOSTAT		},
+	{ "iotrace",	zpool_do_iotrace,	HELP_IOTRACE		},
 	{ "status",	zpool_do_status,	HELP_STATUS		},
 	{ NULL },
 	{ "online",	zpool_do_online,	HELP_ONLINE		},
@@ -178,6 +184,7 @@ static zpool_command_t command_table[] = {
 	{ "split",	zpool_do_split,		HELP_SPLIT		},
 	{ NULL },
 	{ "scrub",	zpool_do_scrub,		HELP_SCRUB		},
+	{ "trim",	zpool_do_trim,		HELP_TRIM		},
 	{ NULL },
 	{ "import",	zpool_do_import,	HELP_IMPORT		},
 	{ "export",	zpool_do_export,	HELP_EXPORT		},
@@ -191,6 +198,18 @@ static zpool_command_t command_table[] = {
 
 #define	NCOMMAND	(sizeof (command_table) / sizeof (command_table[0]))
 
+/*
+ * Classes of top-level vdevs that are displayed in their own section,
+ * after the normal vdevs (see vdev_alloc_class()).
+ */
+static const char *vdev_classes[] = {
+	VDEV_TYPE_LOG,
+	VDEV_ALLOC_BIAS_DEDUP,
+	VDEV_ALLOC_BIAS_SPECIAL
+};
+
+#define	NCLASSES	(sizeof (vdev_classes) / sizeof (vdev_classes[0]))
+
 static zpool_command_t *current_command;
 static char history_str[HIS_MAX_RECORD_LEN];
 static boolean_t log_history = B_TRUE;
@@ -230,8 +249,10 @@ get_usage(zpool_help_t idx)
 		    "[-R root] [-F [-n]]\n"
 		    "\t    <pool | id> [newpool]\n"));
 	case HELP_IOSTAT:
-		return (gettext("\tiostat [-v] [-T d|u] [pool] ... [interval "
-		    "[count]]\n"));
+		return (gettext("\tiostat [-Hpv] [-T d|u] [-l | -q | -w] "
+		    "[pool] ... [interval [count]]\n"));
+	case HELP_IOTRACE:
+		return (gettext("\tiotrace [-Hp] [pool] ...\n"));
 	case HELP_LABELCLEAR:
 		return (gettext("\tlabelclear [-f] <vdev>\n"));
 	case HELP_LIST:
@@ -250,6 +271,8 @@ get_usage(zpool_help_t idx)
 		return (gettext("\treopen <pool>\n"));
 	case HELP_SCRUB:
 		return (gettext("\tscrub [-s] <pool> ...\n"));
+	case HELP_TRIM:
+		return (gettext("\ttrim [-s] <pool> ...\n"));
 	case HELP_STATUS:
 		return (gettext("\tstatus [-vx] [-T d|u] [pool] ... [interval "
 		    "[count]]\n"));
@@ -360,9 +383,12 @@ usage(boolean_t requested)
 	exit(requested ? 0 : 2);
 }
 
+/*
+ * Print the vdevs of the given allocation class (NULL for normal vdevs).
+ */
 void
 print_vdev_tree(zpool_handle_t *zhp, const char *name, nvlist_t *nv, int indent,
-    boolean_t print_logs)
+    const char *class)
 {
 	nvlist_t **child;
 	uint_t c, children;
@@ -376,16 +402,14 @@ print_vdev_tree(zpool_handle_t *zhp, const char *name, nvlist_t *nv, int indent,
 		return;
 
 	for (c = 0; c < children; c++) {
-		uint64_t is_log = B_FALSE;
+		const char *vclass = vdev_alloc_class(child[c]);
 
-		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
-		    &is_log);
-		if ((is_log && !print_logs) || (!is_log && print_logs))
+		if (class == NULL ? vclass != NULL :
+		    vclass == NULL || strcmp(vclass, class) != 0)
 			continue;
 
 		vname = zpool_vdev_name(g_zfs, zhp, child[c], B_FALSE);
-		print_vdev_tree(zhp, vname, child[c], indent + 2,
-		    B_FALSE);
+		print_vdev_tree(zhp, vname, child[c], indent + 2, NULL);
 		free(vname);
 	}
 }
@@ -562,15 +586,23 @@ zpool_do_add(int argc, char **argv)
 		    "configuration:\n"), zpool_get_name(zhp));
 
 		/* print original main pool and new tree */
-		print_vdev_tree(zhp, poolname, poolnvroot, 0, B_FALSE);
-		print_vdev_tree(zhp, NULL, nvroot, 0, B_FALSE);
-
-		/* Do the same for the logs */
-		if (num_logs(poolnvroot) > 0) {
-			print_vdev_tree(zhp, "logs", poolnvroot, 0, B_TRUE);
-			print_vdev_tree(zhp, NULL, nvroot, 0, B_TRUE);
-		} else if (num_logs(nvroot) > 0) {
-			print_vdev_tree(zhp, "logs", nvroot, 0, B_TRUE);
+		print_vdev_tree(zhp, poolname, poolnvroot, 0, NULL);
+		print_vdev_tree(zhp, NULL, nvroot, 0, NULL);
+
+		/* Do the same for the logs and the other vdev classes */
+		for (int i = 0; i < NCLASSES; i++) {
+			const char *class = vdev_classes[i];
+			const char *heading = strcmp(class,
+			    VDEV_TYPE_LOG) == 0 ? "logs" : class;
+
+			if (num_class_vdevs(poolnvroot, class) > 0) {
+				print_vdev_tree(zhp, heading, poolnvroot, 0,
+				    class);
+				print_vdev_tree(zhp, NULL, nvroot, 0, class);
+			} else if (num_class_vdevs(nvroot, class) > 0) {
+				print_vdev_tree(zhp, heading, nvroot, 0,
+				    class);
+			}
 		}
 
 		ret = 0;
@@ -1019,9 +1051,16 @@ zpool_do_create(int argc, char **argv)
 		(void) printf(gettext("would create '%s' with the "
 		    "following layout:\n\n"), poolname);
 
-		print_vdev_tree(NULL, poolname, nvroot, 0, B_FALSE);
-		if (num_logs(nvroot) > 0)
-			print_vdev_tree(NULL, "logs", nvroot, 0, B_TRUE);
+		print_vdev_tree(NULL, poolname, nvroot, 0, NULL);
+		for (int i = 0; i < NCLASSES; i++) {
+			const char *class = vdev_classes[i];
+
+			if (num_class_vdevs(nvroot, class) == 0)
+				continue;
+			print_vdev_tree(NULL, strcmp(class,
+			    VDEV_TYPE_LOG) == 0 ? "logs" : class, nvroot, 0,
+			    class);
+		}
 
 		ret = 0;
 	} else {
@@ -1445,14 +1484,12 @@ print_status_config(zpool_handle_t *zhp, const char *name, nvlist_t *nv,
 	(void) printf("\n");
 
 	for (c = 0; c < children; c++) {
-		uint64_t islog = B_FALSE, ishole = B_FALSE;
+		uint64_t ishole = B_FALSE;
 
-		/* Don't print logs or holes here */
-		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
-		    &islog);
+		/* Don't print logs, other classed devices or holes here */
 		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_HOLE,
 		    &ishole);
-		if (islog || ishole)
+		if (vdev_alloc_class(child[c]) != NULL || ishole)
 			continue;
 		vname = zpool_vdev_name(g_zfs, zhp, child[c], B_TRUE);
 		print_status_config(zhp, vname, child[c],
@@ -1525,11 +1562,7 @@ print_import_config(const char *name, nvlist_t *nv, int namewidth, int depth)
 		return;
 
 	for (c = 0; c < children; c++) {
-		uint64_t is_log = B_FALSE;
-
-		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
-		    &is_log);
-		if (is_log)
+		if (vdev_alloc_class(child[c]) != NULL)
 			continue;
 
 		vname = zpool_vdev_name(g_zfs, NULL, child[c], B_TRUE);
@@ -1559,15 +1592,17 @@ print_import_config(const char *name, nvlist_t *nv, int namewidth, int depth)
 }
 
 /*
- * Print log vdevs.
+ * Print log, dedup or special vdevs.
  * Logs are recorded as top level vdevs in the main pool child array
- * but with "is_log" set to 1. We use either print_status_config() or
- * print_import_config() to print the top level logs then any log
+ * but with "is_log" set to 1, and dedup and special devices with
+ * "alloc_bias" set to the class name. We use either print_status_config() or
+ * print_import_config() to print the top level vdevs then any
  * children (eg mirrored slogs) are printed recursively - which
- * works because only the top level vdev is marked "is_log"
+ * works because only the top level vdev is marked.
  */
 static void
-print_logs(zpool_handle_t *zhp, nvlist_t *nv, int namewidth, boolean_t verbose)
+print_class_vdevs(zpool_handle_t *zhp, nvlist_t *nv, int namewidth,
+    boolean_t verbose, const char *class)
 {
 	uint_t c, children;
 	nvlist_t **child;
@@ -1576,15 +1611,14 @@ print_logs(zpool_handle_t *zhp, nvlist_t *nv, int namewidth, boolean_t verbose)
 	    &children) != 0)
 		return;
 
-	(void) printf(gettext("\tlogs\n"));
+	(void) printf("\t%s\n", strcmp(class, VDEV_TYPE_LOG) == 0 ?
+	    gettext("logs") : class);
 
 	for (c = 0; c < children; c++) {
-		uint64_t is_log = B_FALSE;
+		const char *vclass = vdev_alloc_class(child[c]);
 		char *name;
 
-		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
-		    &is_log);
-		if (!is_log)
+		if (vclass == NULL || strcmp(vclass, class) != 0)
 			continue;
 		name = zpool_vdev_name(g_zfs, zhp, child[c], B_TRUE);
 		if (verbose)
@@ -1811,8 +1845,11 @@ show_import(nvlist_t *config)
 		namewidth = 10;
 
 	print_import_config(name, nvroot, namewidth, 0);
-	if (num_logs(nvroot) > 0)
-		print_logs(NULL, nvroot, namewidth, B_FALSE);
+	for (int i = 0; i < NCLASSES; i++) {
+		if (num_class_vdevs(nvroot, vdev_classes[i]) > 0)
+			print_class_vdevs(NULL, nvroot, namewidth, B_FALSE,
+			    vdev_classes[i]);
+	}
 
 	if (reason == ZPOOL_STATUS_BAD_GUID_SUM) {
 		(void) printf(gettext("\n\tAdditional devices are known to "
@@ -2149,9 +2186,11 @@ zpool_do_import(int argc, char **argv)
 		found_config = NULL;
 
 		/*
-		 * User specified a name or guid.  Ensure it's unique.
+		 * User specified a name or guid.  Ensure it's unique, and
+		 * look for it first where the cache file last saw it.
 		 */
 		idata.unique = B_TRUE;
+		idata.scan_hints = B_TRUE;
 	}
 
 
@@ -2296,28 +2335,117 @@ error:
 
 typedef struct iostat_cbdata {
 	boolean_t cb_verbose;
+	boolean_t cb_latency;		/* -l: average latencies */
+	boolean_t cb_queues;		/* -q: queue depths */
+	boolean_t cb_histo;		/* -w: latency and size histograms */
 	int cb_namewidth;
 	int cb_iteration;
 	zpool_list_t *cb_list;
 } iostat_cbdata_t;
 
+/*
+ * Set by -H and -p.  These are globals rather than part of iostat_cbdata_t
+ * because the column printers below don't take one.
+ */
+static boolean_t iostat_scripted;	/* tab-separated, no headings */
+static boolean_t iostat_parsable;	/* exact values */
+
+/*
+ * Column groups shown by -l and -q, in display order.  The latency columns
+ * are averages of the power-of-two histograms in vdev_stat_ex_t.
+ */
+#define	IOSTAT_LATENCY_COLS	9
+#define	IOSTAT_QUEUE_COLS	10
+
+static int
+iostat_ncols(iostat_cbdata_t *cb)
+{
+	int ncols = 6;
+
+	if (cb->cb_latency)
+		ncols += IOSTAT_LATENCY_COLS;
+	if (cb->cb_queues)
+		ncols += IOSTAT_QUEUE_COLS;
+	return (ncols);
+}
+
 static void
 print_iostat_separator(iostat_cbdata_t *cb)
 {
 	int i = 0;
 
+	if (iostat_scripted)
+		return;
+
 	for (i = 0; i < cb->cb_namewidth; i++)
 		(void) printf("-");
-	(void) printf("  -----  -----  -----  -----  -----  -----\n");
+	for (i = 0; i < iostat_ncols(cb); i++)
+		(void) printf("  -----");
+	(void) printf("\n");
+}
+
+/*
+ * Print a line for a section heading ("logs", "cache") with no stats.
+ */
+static void
+print_iostat_dashes(iostat_cbdata_t *cb, const char *label)
+{
+	if (iostat_scripted)
+		return;
+
+	(void) printf("%-*s", cb->cb_namewidth, label);
+	for (int i = 0; i < iostat_ncols(cb); i++)
+		(void) printf("      -");
+	(void) printf("\n");
+}
+
+/*
+ * Print a heading centered over 'ncols' statistic columns.
+ */
+static void
+print_iostat_group(const char *title, int ncols)
+{
+	int width = ncols * 7 - 2;
+	int pad = (width - (int)strlen(title)) / 2;
+
+	(void) printf("  %*s%-*s", pad, "", width - pad, title);
 }
 
 static void
 print_iostat_header(iostat_cbdata_t *cb)
 {
-	(void) printf("%*s     capacity     operations    bandwidth\n",
-	    cb->cb_namewidth, "");
-	(void) printf("%-*s  alloc   free   read  write   read  write\n",
+	(void) printf("%*s", cb->cb_namewidth, "");
+	print_iostat_group("capacity", 2);
+	print_iostat_group("operations", 2);
+	print_iostat_group("bandwidth", 2);
+	if (cb->cb_latency) {
+		print_iostat_group("total_wait", 2);
+		print_iostat_group("disk_wait", 2);
+		print_iostat_group("syncq_wait", 2);
+		print_iostat_group("asyncq_wait", 2);
+		print_iostat_group("scrub", 1);
+	}
+	if (cb->cb_queues) {
+		print_iostat_group("syncq_read", 2);
+		print_iostat_group("syncq_write", 2);
+		print_iostat_group("asyncq_read", 2);
+		print_iostat_group("asyncq_write", 2);
+		print_iostat_group("scrubq_read", 2);
+	}
+	(void) printf("\n");
+
+	(void) printf("%-*s  alloc   free   read  write   read  write",
 	    cb->cb_namewidth, "pool");
+	if (cb->cb_latency) {
+		for (int i = 0; i < 4; i++)
+			(void) printf("   read  write");
+		(void) printf("   wait");
+	}
+	if (cb->cb_queues) {
+		for (int i = 0; i < 5; i++)
+			(void) printf("   pend  activ");
+	}
+	(void) printf("\n");
 	print_iostat_separator(cb);
 }
 
@@ -2329,8 +2457,265 @@ print_one_stat(uint64_t value)
 {
 	char buf[64];
 
-	zfs_nicenum(value, buf, sizeof (buf));
-	(void) printf("  %5s", buf);
+	if (iostat_parsable)
+		(void) snprintf(buf, sizeof (buf), "%llu", (u_longlong_t)value);
+	else
+		zfs_nicenum(value, buf, sizeof (buf));
+	if (iostat_scripted)
+		(void) printf("\t%s", buf);
+	else
+		(void) printf("  %5s", buf);
+}
+
+/*
+ * Display a placeholder for a statistic that isn't available.
+ */
+static void
+print_one_dash(void)
+{
+	if (iostat_scripted)
+		(void) printf("\t-");
+	else
+		(void) printf("      -");
+}
+
+/*
+ * Format a time in nanoseconds, scaled to a unit that fits a column.
+ */
+static void
+format_time(uint64_t ns, char *buf, size_t len)
+{
+	if (iostat_parsable)
+		(void) snprintf(buf, len, "%llu", (u_longlong_t)ns);
+	else if (ns == 0)
+		(void) strlcpy(buf, "-", len);
+	else if (ns < 1000)
+		(void) snprintf(buf, len, "%lluns", (u_longlong_t)ns);
+	else if (ns < 1000000)
+		(void) snprintf(buf, len, "%lluus", (u_longlong_t)(ns / 1000));
+	else if (ns < 1000000000)
+		(void) snprintf(buf, len, "%llums",
+		    (u_longlong_t)(ns / 1000000));
+	else
+		(void) snprintf(buf, len, "%llus",
+		    (u_longlong_t)(ns / 1000000000));
+}
+
+/*
+ * Display a time in nanoseconds, scaled to a unit that fits the column.
+ */
+static void
+print_one_time(uint64_t ns)
+{
+	char buf[64];
+
+	format_time(ns, buf, sizeof (buf));
+	if (iostat_scripted)
+		(void) printf("\t%s", buf);
+	else
+		(void) printf("  %5s", buf);
+}
+
+/*
+ * Return the extended stats for a vdev, or NULL if the kernel doesn't
+ * provide them.
+ */
+static vdev_stat_ex_t *
+get_vdev_stat_ex(nvlist_t *nv)
+{
+	vdev_stat_ex_t *vsx;
+	uint_t c;
+
+	if (nv == NULL || nvlist_lookup_uint64_array(nv,
+	    ZPOOL_CONFIG_VDEV_STATS_EX, (uint64_t **)&vsx, &c) != 0 ||
+	    c * sizeof (uint64_t) < sizeof (vdev_stat_ex_t))
+		return (NULL);
+	return (vsx);
+}
+
+/*
+ * Estimate the average of the difference between two latency histograms,
+ * using the midpoint of each power-of-two bucket.
+ */
+static uint64_t
+histo_delta_average(const uint64_t *oldh, const uint64_t *newh)
+{
+	uint64_t count = 0, sum = 0;
+
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS; i++) {
+		uint64_t n = newh[i] - oldh[i];
+
+		count += n;
+		sum += n * ((3ULL << i) / 2);
+	}
+	return (count == 0 ? 0 : sum / count);
+}
+
+static void
+print_vdev_latency(const vdev_stat_ex_t *oldvsx, const vdev_stat_ex_t *newvsx)
+{
+	if (newvsx == NULL) {
+		for (int i = 0; i < IOSTAT_LATENCY_COLS; i++)
+			print_one_dash();
+		return;
+	}
+
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_total_histo[ZIO_TYPE_READ],
+	    newvsx->vsx_total_histo[ZIO_TYPE_READ]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_total_histo[ZIO_TYPE_WRITE],
+	    newvsx->vsx_total_histo[ZIO_TYPE_WRITE]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_disk_histo[ZIO_TYPE_READ],
+	    newvsx->vsx_disk_histo[ZIO_TYPE_READ]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_disk_histo[ZIO_TYPE_WRITE],
+	    newvsx->vsx_disk_histo[ZIO_TYPE_WRITE]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_READ],
+	    newvsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_READ]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_WRITE],
+	    newvsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_WRITE]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_queue_histo[ZIO_PRIORITY_ASYNC_READ],
+	    newvsx->vsx_queue_histo[ZIO_PRIORITY_ASYNC_READ]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_queue_histo[ZIO_PRIORITY_ASYNC_WRITE],
+	    newvsx->vsx_queue_histo[ZIO_PRIORITY_ASYNC_WRITE]));
+	print_one_time(histo_delta_average(
+	    oldvsx->vsx_queue_histo[ZIO_PRIORITY_SCRUB],
+	    newvsx->vsx_queue_histo[ZIO_PRIORITY_SCRUB]));
+}
+
+static void
+print_vdev_queues(const vdev_stat_ex_t *vsx)
+{
+	static const zio_priority_t prio[] = {
+		ZIO_PRIORITY_SYNC_READ, ZIO_PRIORITY_SYNC_WRITE,
+		ZIO_PRIORITY_ASYNC_READ, ZIO_PRIORITY_ASYNC_WRITE,
+		ZIO_PRIORITY_SCRUB
+	};
+
+	for (int i = 0; i < sizeof (prio) / sizeof (prio[0]); i++) {
+		if (vsx == NULL) {
+			print_one_dash();
+			print_one_dash();
+			continue;
+		}
+		print_one_stat(vsx->vsx_pend_queue[prio[i]]);
+		print_one_stat(vsx->vsx_active_queue[prio[i]]);
+	}
+}
+
+/*
+ * Print the latency and request size histograms for one vdev (-w).  Only
+ * the rows between the first and last non-empty bucket are shown.
+ */
+static void
+print_vdev_histo(const char *name, const vdev_stat_ex_t *oldvsx,
+    const vdev_stat_ex_t *newvsx)
+{
+	int first, last;
+
+	(void) printf("\n%s\n", name);
+	if (newvsx == NULL) {
+		(void) printf(gettext("no histograms available\n"));
+		return;
+	}
+
+#define	HDELTA(field, i)	(newvsx->field[i] - oldvsx->field[i])
+#define	LAT_ROW_EMPTY(b)						\
+	(HDELTA(vsx_total_histo[ZIO_TYPE_READ], b) == 0 &&		\
+	HDELTA(vsx_total_histo[ZIO_TYPE_WRITE], b) == 0 &&		\
+	HDELTA(vsx_disk_histo[ZIO_TYPE_READ], b) == 0 &&		\
+	HDELTA(vsx_disk_histo[ZIO_TYPE_WRITE], b) == 0 &&		\
+	HDELTA(vsx_queue_histo[ZIO_PRIORITY_SYNC_READ], b) == 0 &&	\
+	HDELTA(vsx_queue_histo[ZIO_PRIORITY_SYNC_WRITE], b) == 0 &&	\
+	HDELTA(vsx_queue_histo[ZIO_PRIORITY_ASYNC_READ], b) == 0 &&	\
+	HDELTA(vsx_queue_histo[ZIO_PRIORITY_ASYNC_WRITE], b) == 0 &&	\
+	HDELTA(vsx_queue_histo[ZIO_PRIORITY_SCRUB], b) == 0)
+
+	(void) printf("%-7s", "latency");
+	print_iostat_group("total_wait", 2);
+	print_iostat_group("disk_wait", 2);
+	print_iostat_group("syncq_wait", 2);
+	print_iostat_group("asyncq_wait", 2);
+	print_iostat_group("scrub", 1);
+	(void) printf("\n%-7s", "");
+	for (int i = 0; i < 4; i++)
+		(void) printf("   read  write");
+	(void) printf("   wait\n");
+
+	for (first = 0; first < VDEV_L_HISTO_BUCKETS; first++)
+		if (!LAT_ROW_EMPTY(first))
+			break;
+	for (last = VDEV_L_HISTO_BUCKETS - 1; last > first; last--)
+		if (!LAT_ROW_EMPTY(last))
+			break;
+
+	for (int b = first; b <= last; b++) {
+		char buf[64];
+
+		if (1ULL << b < 1000)
+			(void) snprintf(buf, sizeof (buf), "%lluns",
+			    (u_longlong_t)(1ULL << b));
+		else if (1ULL << b < 1000000)
+			(void) snprintf(buf, sizeof (buf), "%lluus",
+			    (u_longlong_t)((1ULL << b) / 1000));
+		else if (1ULL << b < 1000000000)
+			(void) snprintf(buf, sizeof (buf), "%llums",
+			    (u_longlong_t)((1ULL << b) / 1000000));
+		else
+			(void) snprintf(buf, sizeof (buf), "%llus",
+			    (u_longlong_t)((1ULL << b) / 1000000000));
+		(void) printf("%-7s", buf);
+		print_one_stat(HDELTA(vsx_total_histo[ZIO_TYPE_READ], b));
+		print_one_stat(HDELTA(vsx_total_histo[ZIO_TYPE_WRITE], b));
+		print_one_stat(HDELTA(vsx_disk_histo[ZIO_TYPE_READ], b));
+		print_one_stat(HDELTA(vsx_disk_histo[ZIO_TYPE_WRITE], b));
+		print_one_stat(HDELTA(vsx_queue_histo[ZIO_PRIORITY_SYNC_READ],
+		    b));
+		print_one_stat(HDELTA(vsx_queue_histo[ZIO_PRIORITY_SYNC_WRITE],
+		    b));
+		print_one_stat(HDELTA(vsx_queue_histo[ZIO_PRIORITY_ASYNC_READ],
+		    b));
+		print_one_stat(HDELTA(
+		    vsx_queue_histo[ZIO_PRIORITY_ASYNC_WRITE], b));
+		print_one_stat(HDELTA(vsx_queue_histo[ZIO_PRIORITY_SCRUB], b));
+		(void) printf("\n");
+	}
+
+	(void) printf("\n%-7s", "reqsize");
+	print_iostat_group("individual", 5);
+	print_iostat_group("aggregate", 5);
+	(void) printf("\n%-7s", "");
+	for (int i = 0; i < 2; i++)
+		(void) printf("  syncr  syncw  asyncr asyncw  scrub");
+	(void) printf("\n");
+
+	for (int b = 0; b < VDEV_RQ_HISTO_BUCKETS; b++) {
+		char buf[64];
+		uint64_t total = 0;
+
+		for (int p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+			total += HDELTA(vsx_ind_histo[p], b);
+			total += HDELTA(vsx_agg_histo[p], b);
+		}
+		if (total == 0)
+			continue;
+
+		zfs_nicenum(1ULL << b, buf, sizeof (buf));
+		(void) printf("%-7s", buf);
+		for (int p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+			print_one_stat(HDELTA(vsx_ind_histo[p], b));
+		for (int p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+			print_one_stat(HDELTA(vsx_agg_histo[p], b));
+		(void) printf("\n");
+	}
+#undef	LAT_ROW_EMPTY
+#undef	HDELTA
 }
 
 /*
@@ -2346,6 +2731,8 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 	uint_t c, children;
 	vdev_stat_t *oldvs, *newvs;
 	vdev_stat_t zerovs = { 0 };
+	vdev_stat_ex_t *oldvsx, *newvsx;
+	static vdev_stat_ex_t zerovsx;
 	uint64_t tdelta;
 	double scale;
 	char *vname;
@@ -2360,7 +2747,18 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 	verify(nvlist_lookup_uint64_array(newnv, ZPOOL_CONFIG_VDEV_STATS,
 	    (uint64_t **)&newvs, &c) == 0);
 
-	if (strlen(name) + depth > cb->cb_namewidth)
+	newvsx = get_vdev_stat_ex(newnv);
+	if ((oldvsx = get_vdev_stat_ex(oldnv)) == NULL)
+		oldvsx = &zerovsx;
+
+	if (cb->cb_histo) {
+		print_vdev_histo(name, oldvsx, newvsx);
+		goto descend;
+	}
+
+	if (iostat_scripted)
+		(void) printf("%s", name);
+	else if (strlen(name) + depth > cb->cb_namewidth)
 		(void) printf("%*s%s", depth, "", name);
 	else
 		(void) printf("%*s%s%*s", depth, "", name,
@@ -2375,7 +2773,8 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 
 	/* only toplevel vdevs have capacity stats */
 	if (newvs->vs_space == 0) {
-		(void) printf("      -      -");
+		print_one_dash();
+		print_one_dash();
 	} else {
 		print_one_stat(newvs->vs_alloc);
 		print_one_stat(newvs->vs_space - newvs->vs_alloc);
@@ -2393,8 +2792,15 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 	print_one_stat((uint64_t)(scale * (newvs->vs_bytes[ZIO_TYPE_WRITE] -
 	    oldvs->vs_bytes[ZIO_TYPE_WRITE])));
 
+	if (cb->cb_latency)
+		print_vdev_latency(oldvsx, newvsx);
+
+	if (cb->cb_queues)
+		print_vdev_queues(newvsx);
+
 	(void) printf("\n");
 
+descend:
 	if (!cb->cb_verbose)
 		return;
 
@@ -2407,15 +2813,12 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 		return;
 
 	for (c = 0; c < children; c++) {
-		uint64_t ishole = B_FALSE, islog = B_FALSE;
+		uint64_t ishole = B_FALSE;
 
 		(void) nvlist_lookup_uint64(newchild[c], ZPOOL_CONFIG_IS_HOLE,
 		    &ishole);
 
-		(void) nvlist_lookup_uint64(newchild[c], ZPOOL_CONFIG_IS_LOG,
-		    &islog);
-
-		if (ishole || islog)
+		if (ishole || vdev_alloc_class(newchild[c]) != NULL)
 			continue;
 
 		vname = zpool_vdev_name(g_zfs, zhp, newchild[c], B_FALSE);
@@ -2425,28 +2828,31 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 	}
 
 	/*
-	 * Log device section
+	 * Log, dedup and special device sections
 	 */
+	for (int i = 0; i < NCLASSES; i++) {
+		const char *class = vdev_classes[i];
+
+		if (num_class_vdevs(newnv, class) == 0)
+			continue;
 
-	if (num_logs(newnv) > 0) {
-		(void) printf("%-*s      -      -      -      -      -      "
-		    "-\n", cb->cb_namewidth, "logs");
+		if (!cb->cb_histo)
+			print_iostat_dashes(cb, strcmp(class,
+			    VDEV_TYPE_LOG) == 0 ? "logs" : class);
 
 		for (c = 0; c < children; c++) {
-			uint64_t islog = B_FALSE;
-			(void) nvlist_lookup_uint64(newchild[c],
-			    ZPOOL_CONFIG_IS_LOG, &islog);
-
-			if (islog) {
-				vname = zpool_vdev_name(g_zfs, zhp, newchild[c],
-				    B_FALSE);
-				print_vdev_stats(zhp, vname, oldnv ?
-				    oldchild[c] : NULL, newchild[c],
-				    cb, depth + 2);
-				free(vname);
-			}
-		}
+			const char *vclass = vdev_alloc_class(newchild[c]);
 
+			if (vclass == NULL || strcmp(vclass, class) != 0)
+				continue;
+
+			vname = zpool_vdev_name(g_zfs, zhp, newchild[c],
+			    B_FALSE);
+			print_vdev_stats(zhp, vname, oldnv ?
+			    oldchild[c] : NULL, newchild[c],
+			    cb, depth + 2);
+			free(vname);
+		}
 	}
 
 	/*
@@ -2461,8 +2867,8 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 		return;
 
 	if (children > 0) {
-		(void) printf("%-*s      -      -      -      -      -      "
-		    "-\n", cb->cb_namewidth, "cache");
+		if (!cb->cb_histo)
+			print_iostat_dashes(cb, "cache");
 		for (c = 0; c < children; c++) {
 			vname = zpool_vdev_name(g_zfs, zhp, newchild[c],
 			    B_FALSE);
@@ -2520,7 +2926,7 @@ print_iostat(zpool_handle_t *zhp, void *data)
 	 */
 	print_vdev_stats(zhp, zpool_get_name(zhp), oldnvroot, newnvroot, cb, 0);
 
-	if (cb->cb_verbose)
+	if (cb->cb_verbose && !cb->cb_histo)
 		print_iostat_separator(cb);
 
 	return (0);
@@ -2637,10 +3043,17 @@ get_timestamp_arg(char c)
 }
 
 /*
- * zpool iostat [-v] [-T d|u] [pool] ... [interval [count]]
+ * zpool iostat [-Hpv] [-T d|u] [-l | -q | -w] [pool] ... [interval [count]]
  *
+ *	-H	Scripted mode.  Don't display headers, and separate fields
+ *		by a single tab.
+ *	-p	Display values in parsable (exact) format; times are in
+ *		nanoseconds.
  *	-v	Display statistics for individual vdevs
  *	-T	Display a timestamp in date(1) or Unix format
+ *	-l	Also display average queue and device latencies
+ *	-q	Also display vdev queue depths
+ *	-w	Display latency and request size histograms instead
  *
  * This command can be tricky because we want to be able to deal with pool
  * creation/destruction as well as vdev configuration changes.  The bulk of this
@@ -2657,17 +3070,33 @@ zpool_do_iostat(int argc, char **argv)
 	unsigned long interval = 0, count = 0;
 	zpool_list_t *list;
 	boolean_t verbose = B_FALSE;
+	boolean_t latency = B_FALSE, queues = B_FALSE, histo = B_FALSE;
 	iostat_cbdata_t cb;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "T:v")) != -1) {
+	while ((c = getopt(argc, argv, "HlpqT:vw")) != -1) {
 		switch (c) {
+		case 'H':
+			iostat_scripted = B_TRUE;
+			break;
+		case 'l':
+			latency = B_TRUE;
+			break;
+		case 'p':
+			iostat_parsable = B_TRUE;
+			break;
+		case 'q':
+			queues = B_TRUE;
+			break;
 		case 'T':
 			get_timestamp_arg(*optarg);
 			break;
 		case 'v':
 			verbose = B_TRUE;
 			break;
+		case 'w':
+			histo = B_TRUE;
+			break;
 		case '?':
 			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
 			    optopt);
@@ -2678,6 +3107,18 @@ zpool_do_iostat(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	if (histo && (latency || queues)) {
+		(void) fprintf(stderr, gettext("-w cannot be combined with "
+		    "-l or -q\n"));
+		usage(B_FALSE);
+	}
+
+	if (histo && iostat_scripted) {
+		(void) fprintf(stderr, gettext("-w cannot be combined with "
+		    "-H\n"));
+		usage(B_FALSE);
+	}
+
 	get_interval_count(&argc, argv, &interval, &count);
 
 	/*
@@ -2703,6 +3144,9 @@ zpool_do_iostat(int argc, char **argv)
 	 */
 	cb.cb_list = list;
 	cb.cb_verbose = verbose;
+	cb.cb_latency = latency;
+	cb.cb_queues = queues;
+	cb.cb_histo = histo;
 	cb.cb_iteration = 0;
 	cb.cb_namewidth = 0;
 
@@ -2732,7 +3176,8 @@ zpool_do_iostat(int argc, char **argv)
 		/*
 		 * If it's the first time, or verbose mode, print the header.
 		 */
-		if (++cb.cb_iteration == 1 || verbose)
+		if ((++cb.cb_iteration == 1 || verbose) && !histo &&
+		    !iostat_scripted)
 			print_iostat_header(&cb);
 
 		(void) pool_list_iter(list, B_FALSE, print_iostat, &cb);
@@ -2741,10 +3186,10 @@ zpool_do_iostat(int argc, char **argv)
 		 * If there's more than one pool, and we're not in verbose mode
 		 * (which prints a separator for us), then print a separator.
 		 */
-		if (npools > 1 && !verbose)
+		if (npools > 1 && !verbose && !histo)
 			print_iostat_separator(&cb);
 
-		if (verbose)
+		if (verbose && !iostat_scripted)
 			(void) printf("\n");
 
 		/*
@@ -2767,6 +3212,203 @@ zpool_do_iostat(int argc, char **argv)
 	return (ret);
 }
 
+/*
+ * Names of the zio pipeline stages, in the order of enum zio_stage.
+ */
+static const char *iotrace_stage_name[ZIO_TRACE_STAGES] = {
+	"open", "read_bp_init", "write_bp_init", "free_bp_init",
+	"issue_async", "write_compress", "checksum_generate", "nop_write",
+	"ddt_read_start", "ddt_read_done", "ddt_write", "ddt_free",
+	"gang_assemble", "gang_issue", "dva_throttle", "dva_allocate",
+	"dva_free", "dva_claim", "ready", "vdev_io_start", "vdev_io_done",
+	"vdev_io_assess", "checksum_verify", "done"
+};
+
+static const char *iotrace_type_name[ZIO_TYPES] = {
+	"null", "read", "write", "free", "claim", "ioctl"
+};
+
+static const char *iotrace_priority_name[] = {
+	"sync_read", "sync_write", "async_read", "async_write", "scrub",
+	"trim", "-", "now"
+};
+
+typedef struct iotrace_pool {
+	struct iotrace_pool *ip_next;
+	uint64_t	ip_guid;
+	char		ip_name[ZFS_MAX_DATASET_NAME_LEN];
+} iotrace_pool_t;
+
+static int
+iotrace_pool_cb(zpool_handle_t *zhp, void *data)
+{
+	iotrace_pool_t **pools = data;
+	iotrace_pool_t *ip = safe_malloc(sizeof (iotrace_pool_t));
+
+	ip->ip_guid = zpool_get_prop_int(zhp, ZPOOL_PROP_GUID, NULL);
+	(void) strlcpy(ip->ip_name, zpool_get_name(zhp),
+	    sizeof (ip->ip_name));
+	ip->ip_next = *pools;
+	*pools = ip;
+
+	return (0);
+}
+
+static int
+iotrace_compare(const void *a, const void *b)
+{
+	const zio_trace_rec_t *z1 = a;
+	const zio_trace_rec_t *z2 = b;
+
+	if (z1->zit_start < z2->zit_start)
+		return (-1);
+	return (z1->zit_start > z2->zit_start);
+}
+
+static void
+print_iotrace_rec(const zio_trace_rec_t *zit, const char *pool, hrtime_t now)
+{
+	char buf[64];
+	const char *sep = iostat_scripted ? "\t" : "  ";
+	boolean_t first = B_TRUE;
+	int last = -1;
+
+	(void) printf("%-*s", iostat_scripted ? 0 : 12, pool);
+	(void) printf("%s%-5s", sep, zit->zit_type < ZIO_TYPES ?
+	    iotrace_type_name[zit->zit_type] : "?");
+	(void) printf("%s%-11s", sep, zit->zit_priority <=
+	    ZIO_PRIORITY_NOW ? iotrace_priority_name[zit->zit_priority] : "?");
+	print_one_time(now - zit->zit_start);
+	print_one_time(zit->zit_total);
+	print_one_time(zit->zit_taskq);
+	print_one_time(zit->zit_vqueue);
+	print_one_time(zit->zit_device);
+	print_one_stat(zit->zit_size);
+	(void) printf("%s%llx%s%d", sep, (u_longlong_t)zit->zit_offset, sep,
+	    zit->zit_error);
+	(void) printf("%s%llu/%llu/%lld/%llu", sep,
+	    (u_longlong_t)zit->zit_objset, (u_longlong_t)zit->zit_object,
+	    (longlong_t)zit->zit_level, (u_longlong_t)zit->zit_blkid);
+
+	/*
+	 * Each stage lasted until the next one run was entered, and the
+	 * last until the zio completed.
+	 */
+	(void) printf("%s", sep);
+	for (int s = 1; s <= ZIO_TRACE_STAGES; s++) {
+		uint64_t end;
+
+		if (s < ZIO_TRACE_STAGES && !(zit->zit_stages & (1U << s)))
+			continue;
+		if (last != -1) {
+			end = (s < ZIO_TRACE_STAGES) ?
+			    zit->zit_stage_us[s] * 1000ULL : zit->zit_total;
+			format_time(end - zit->zit_stage_us[last] * 1000ULL,
+			    buf, sizeof (buf));
+			(void) printf("%s%s=%s", first ? "" : ",",
+			    iotrace_stage_name[last], buf);
+			first = B_FALSE;
+		}
+		last = s;
+	}
+	(void) printf("\n");
+}
+
+/*
+ * zpool iotrace [-Hp] [pool] ...
+ *
+ *	-H	Scripted mode.  Don't display headers, and separate fields
+ *		by a single tab.
+ *	-p	Display values in parsable (exact) format; times are in
+ *		nanoseconds.
+ *
+ * Display the slow I/Os the kernel has recorded in its zio trace rings
+ * (see zio_trace_threshold_ms), oldest first, with the time each spent
+ * waiting in the zio taskqs, in the vdev queue and on the device, and in
+ * each stage of the zio pipeline.  The rings are small and overwritten as
+ * slow I/Os complete, so this shows recent history only.
+ */
+int
+zpool_do_iotrace(int argc, char **argv)
+{
+	iotrace_pool_t *pools = NULL, *ip;
+	zio_trace_rec_t *recs;
+	kstat_ctl_t *kc;
+	kstat_t *ksp;
+	uint_t nrecs;
+	hrtime_t now;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "Hp")) != -1) {
+		switch (c) {
+		case 'H':
+			iostat_scripted = B_TRUE;
+			break;
+		case 'p':
+			iostat_parsable = B_TRUE;
+			break;
+		case '?':
+			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
+			    optopt);
+			usage(B_FALSE);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	ret = for_each_pool(argc, argv, B_TRUE, NULL, iotrace_pool_cb, &pools);
+
+	if ((kc = kstat_open()) == NULL ||
+	    (ksp = kstat_lookup(kc, "zfs", 0, "zio_trace")) == NULL ||
+	    kstat_read(kc, ksp, NULL) == -1) {
+		(void) fprintf(stderr, gettext("cannot read zio trace: %s\n"),
+		    strerror(errno));
+		return (1);
+	}
+	now = gethrtime();
+	recs = ksp->ks_data;
+	nrecs = ksp->ks_data_size / sizeof (zio_trace_rec_t);
+	qsort(recs, nrecs, sizeof (zio_trace_rec_t), iotrace_compare);
+
+	if (!iostat_scripted) {
+		(void) printf("%-12s  %-5s  %-11s  %5s  %5s  %5s  %5s  %5s  "
+		    "%5s  %s  %s  %s  %s\n", gettext("pool"), gettext("type"),
+		    gettext("priority"), gettext("age"), gettext("total"),
+		    gettext("taskq"), gettext("queue"), gettext("disk"),
+		    gettext("size"), gettext("offset"), gettext("error"),
+		    gettext("objset/object/level/blkid"), gettext("stages"));
+	}
+
+	for (uint_t i = 0; i < nrecs; i++) {
+		char guid[32];
+		const char *name = NULL;
+
+		for (ip = pools; ip != NULL; ip = ip->ip_next) {
+			if (ip->ip_guid == recs[i].zit_pool_guid) {
+				name = ip->ip_name;
+				break;
+			}
+		}
+		if (name == NULL) {
+			/* an exported pool, or one not asked for */
+			if (argc != 0)
+				continue;
+			(void) snprintf(guid, sizeof (guid), "%llu",
+			    (u_longlong_t)recs[i].zit_pool_guid);
+			name = guid;
+		}
+		print_iotrace_rec(&recs[i], name, now);
+	}
+
+	(void) kstat_close(kc);
+	while ((ip = pools) != NULL) {
+		pools = ip->ip_next;
+		free(ip);
+	}
+
+	return (ret);
+}
+
 typedef struct list_cbdata {
 	boolean_t	cb_verbose;
 	int		cb_namewidth;
@@ -2945,8 +3587,6 @@ print_list_stats(zpool_handle_t *zhp, const char *name, nvlist_t *nv,
 	uint_t c, children;
 	char *vname;
 	boolean_t scripted = cb->cb_scripted;
-	uint64_t islog = B_FALSE;
-	boolean_t haslog = B_FALSE;
 	char *dashes = "%-*s      -      -      -         -      -      -\n";
 
 	verify(nvlist_lookup_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS,
@@ -2998,23 +3638,26 @@ print_list_stats(zpool_handle_t *zhp, const char *name, nvlist_t *nv,
 		    ZPOOL_CONFIG_IS_HOLE, &ishole) == 0 && ishole)
 			continue;
 
-		if (nvlist_lookup_uint64(child[c],
-		    ZPOOL_CONFIG_IS_LOG, &islog) == 0 && islog) {
-			haslog = B_TRUE;
+		if (vdev_alloc_class(child[c]) != NULL)
 			continue;
-		}
 
 		vname = zpool_vdev_name(g_zfs, zhp, child[c], B_FALSE);
 		print_list_stats(zhp, vname, child[c], cb, depth + 2);
 		free(vname);
 	}
 
-	if (haslog == B_TRUE) {
+	for (int i = 0; i < NCLASSES; i++) {
+		const char *class = vdev_classes[i];
+
+		if (num_class_vdevs(nv, class) == 0)
+			continue;
+
 		/* LINTED E_SEC_PRINTF_VAR_FMT */
-		(void) printf(dashes, cb->cb_namewidth, "log");
+		(void) printf(dashes, cb->cb_namewidth, class);
 		for (c = 0; c < children; c++) {
-			if (nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
-			    &islog) != 0 || !islog)
+			const char *vclass = vdev_alloc_class(child[c]);
+
+			if (vclass == NULL || strcmp(vclass, class) != 0)
 				continue;
 			vname = zpool_vdev_name(g_zfs, zhp, child[c], B_FALSE);
 			print_list_stats(zhp, vname, child[c], cb, depth + 2);
@@ -3457,7 +4100,7 @@ zpool_do_split(int argc, char **argv)
 		if (flags.dryrun) {
 			(void) printf(gettext("would create '%s' with the "
 			    "following layout:\n\n"), newpool);
-			print_vdev_tree(NULL, newpool, config, 0, B_FALSE);
+			print_vdev_tree(NULL, newpool, config, 0, NULL);
 		}
 		nvlist_free(config);
 	}
@@ -3861,6 +4504,58 @@ zpool_do_scrub(int argc, char **argv)
 	return (for_each_pool(argc, argv, B_TRUE, NULL, scrub_callback, &cb));
 }
 
+int
+trim_callback(zpool_handle_t *zhp, void *data)
+{
+	boolean_t start = *(boolean_t *)data;
+
+	/*
+	 * Ignore faulted pools.
+	 */
+	if (zpool_get_state(zhp) == POOL_STATE_UNAVAIL) {
+		(void) fprintf(stderr, gettext("cannot trim '%s': pool is "
+		    "currently unavailable\n"), zpool_get_name(zhp));
+		return (1);
+	}
+
+	return (zpool_trim(zhp, start) != 0);
+}
+
+/*
+ * zpool trim [-s] <pool> ...
+ *
+ *	-s	Stop.  Stops any in-progress trim.
+ */
+int
+zpool_do_trim(int argc, char **argv)
+{
+	int c;
+	boolean_t start = B_TRUE;
+
+	/* check options */
+	while ((c = getopt(argc, argv, "s")) != -1) {
+		switch (c) {
+		case 's':
+			start = B_FALSE;
+			break;
+		case '?':
+			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
+			    optopt);
+			usage(B_FALSE);
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1) {
+		(void) fprintf(stderr, gettext("missing pool name argument\n"));
+		usage(B_FALSE);
+	}
+
+	return (for_each_pool(argc, argv, B_TRUE, NULL, trim_callback, &start));
+}
+
 typedef struct status_cbdata {
 	int		cb_count;
 	boolean_t	cb_allpools;
@@ -4370,8 +5065,12 @@ status_callback(zpool_handle_t *zhp, void *data)
 		print_status_config(zhp, zpool_get_name(zhp), nvroot,
 		    namewidth, 0, B_FALSE);
 
-		if (num_logs(nvroot) > 0)
-			print_logs(zhp, nvroot, namewidth, B_TRUE);
+		for (int i = 0; i < NCLASSES; i++) {
+			if (num_class_vdevs(nvroot, vdev_classes[i]) > 0) {
+				print_class_vdevs(zhp, nvroot, namewidth,
+				    B_TRUE, vdev_classes[i]);
+			}
+		}
 		if (nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_L2CACHE,
 		    &l2cache, &nl2cache) == 0)
 			print_l2cache(zhp, l2cache, nl2cache, namewidth);
@@ -84,3 +84,48 @@ num_logs(nvlist_t *nv)
 	}
 	return (nlogs);
 }
+
+/*
+ * Return the allocation class of a top-level vdev: VDEV_TYPE_LOG for a log
+ * device, its allocation bias (e.g. VDEV_ALLOC_BIAS_DEDUP) for a dedicated
+ * class device, or NULL for a normal vdev.
+ */
+const char *
+vdev_alloc_class(nvlist_t *nv)
+{
+	uint64_t is_log = B_FALSE;
+	char *bias;
+
+	(void) nvlist_lookup_uint64(nv, ZPOOL_CONFIG_IS_LOG, &is_log);
+	if (is_log)
+		return (VDEV_TYPE_LOG);
+
+	if (nvlist_lookup_string(nv, ZPOOL_CONFIG_ALLOCATION_BIAS, &bias) == 0)
+		return (bias);
+
+	return (NULL);
+}
+
+/*
+ * Return the number of top-level vdevs of the given allocation class in
+ * the supplied nvlist.
+ */
+uint_t
+num_class_vdevs(nvlist_t *nv, const char *class)
+{
+	uint_t nvdevs = 0;
+	uint_t c, children;
+	nvlist_t **child;
+
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) != 0)
+		return (0);
+
+	for (c = 0; c < children; c++) {
+		const char *vclass = vdev_alloc_class(child[c]);
+
+		if (vclass != NULL && strcmp(vclass, class) == 0)
+			nvdevs++;
+	}
+	return (nvdevs);
+}
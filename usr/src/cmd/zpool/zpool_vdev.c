@@ -559,16 +559,14 @@ get_replication(nvlist_t *nvroot, boolean_t fatal)
 	    &top, &toplevels) == 0);
 
 	for (t = 0; t < toplevels; t++) {
-		uint64_t is_log = B_FALSE;
-
 		nv = top[t];
 
 		/*
-		 * For separate logs we ignore the top level vdev replication
+		 * For separate logs and the other dedicated allocation
+		 * classes we ignore the top level vdev replication
 		 * constraints.
 		 */
-		(void) nvlist_lookup_uint64(nv, ZPOOL_CONFIG_IS_LOG, &is_log);
-		if (is_log)
+		if (vdev_alloc_class(nv) != NULL)
 			continue;
 
 		verify(nvlist_lookup_string(nv, ZPOOL_CONFIG_TYPE,
@@ -1148,6 +1146,18 @@ is_grouping(const char *type, int *mindev, int *maxdev)
 		return (VDEV_TYPE_L2CACHE);
 	}
 
+	if (strcmp(type, "dedup") == 0) {
+		if (mindev != NULL)
+			*mindev = 1;
+		return (VDEV_ALLOC_BIAS_DEDUP);
+	}
+
+	if (strcmp(type, "special") == 0) {
+		if (mindev != NULL)
+			*mindev = 1;
+		return (VDEV_ALLOC_BIAS_SPECIAL);
+	}
+
 	return (NULL);
 }
 
@@ -1162,9 +1172,10 @@ construct_spec(int argc, char **argv)
 {
 	nvlist_t *nvroot, *nv, **top, **spares, **l2cache;
 	int t, toplevels, mindev, maxdev, nspares, nlogs, nl2cache;
-	const char *type;
+	int ndedup, nspecial;
+	const char *type, *bias;
 	uint64_t is_log;
-	boolean_t seen_logs;
+	boolean_t seen_logs, seen_dedup, seen_special;
 
 	top = NULL;
 	toplevels = 0;
@@ -1173,8 +1184,13 @@ construct_spec(int argc, char **argv)
 	nspares = 0;
 	nlogs = 0;
 	nl2cache = 0;
+	ndedup = 0;
+	nspecial = 0;
 	is_log = B_FALSE;
 	seen_logs = B_FALSE;
+	bias = NULL;
+	seen_dedup = B_FALSE;
+	seen_special = B_FALSE;
 
 	while (argc > 0) {
 		nv = NULL;
@@ -1196,6 +1212,7 @@ construct_spec(int argc, char **argv)
 					return (NULL);
 				}
 				is_log = B_FALSE;
+				bias = NULL;
 			}
 
 			if (strcmp(type, VDEV_TYPE_LOG) == 0) {
@@ -1208,6 +1225,7 @@ construct_spec(int argc, char **argv)
 				}
 				seen_logs = B_TRUE;
 				is_log = B_TRUE;
+				bias = NULL;
 				argc--;
 				argv++;
 				/*
@@ -1217,6 +1235,32 @@ construct_spec(int argc, char **argv)
 				continue;
 			}
 
+			if (strcmp(type, VDEV_ALLOC_BIAS_DEDUP) == 0 ||
+			    strcmp(type, VDEV_ALLOC_BIAS_SPECIAL) == 0) {
+				boolean_t *seen = strcmp(type,
+				    VDEV_ALLOC_BIAS_DEDUP) == 0 ?
+				    &seen_dedup : &seen_special;
+
+				if (*seen) {
+					(void) fprintf(stderr,
+					    gettext("invalid vdev "
+					    "specification: '%s' can be "
+					    "specified only once\n"), type);
+					return (NULL);
+				}
+				*seen = B_TRUE;
+				is_log = B_FALSE;
+				bias = type;
+				argc--;
+				argv++;
+				/*
+				 * Like a log, an allocation class is not a
+				 * real grouping device; it applies to the
+				 * vdevs that follow.
+				 */
+				continue;
+			}
+
 			if (strcmp(type, VDEV_TYPE_L2CACHE) == 0) {
 				if (l2cache != NULL) {
 					(void) fprintf(stderr,
@@ -1226,17 +1270,25 @@ construct_spec(int argc, char **argv)
 					return (NULL);
 				}
 				is_log = B_FALSE;
+				bias = NULL;
 			}
 
-			if (is_log) {
+			if (is_log || bias != NULL) {
 				if (strcmp(type, VDEV_TYPE_MIRROR) != 0) {
 					(void) fprintf(stderr,
 					    gettext("invalid vdev "
-					    "specification: unsupported 'log' "
-					    "device: %s\n"), type);
+					    "specification: unsupported '%s' "
+					    "device: %s\n"), is_log ? "log" :
+					    bias, type);
 					return (NULL);
 				}
-				nlogs++;
+				if (is_log)
+					nlogs++;
+				else if (strcmp(bias,
+				    VDEV_ALLOC_BIAS_DEDUP) == 0)
+					ndedup++;
+				else
+					nspecial++;
 			}
 
 			for (c = 1; c < argc; c++) {
@@ -1285,6 +1337,11 @@ construct_spec(int argc, char **argv)
 				    type) == 0);
 				verify(nvlist_add_uint64(nv,
 				    ZPOOL_CONFIG_IS_LOG, is_log) == 0);
+				if (bias != NULL) {
+					verify(nvlist_add_string(nv,
+					    ZPOOL_CONFIG_ALLOCATION_BIAS,
+					    bias) == 0);
+				}
 				if (strcmp(type, VDEV_TYPE_RAIDZ) == 0) {
 					verify(nvlist_add_uint64(nv,
 					    ZPOOL_CONFIG_NPARITY,
@@ -1307,6 +1364,14 @@ construct_spec(int argc, char **argv)
 				return (NULL);
 			if (is_log)
 				nlogs++;
+			if (bias != NULL) {
+				verify(nvlist_add_string(nv,
+				    ZPOOL_CONFIG_ALLOCATION_BIAS, bias) == 0);
+				if (strcmp(bias, VDEV_ALLOC_BIAS_DEDUP) == 0)
+					ndedup++;
+				else
+					nspecial++;
+			}
 			argc--;
 			argv++;
 		}
@@ -1331,6 +1396,18 @@ construct_spec(int argc, char **argv)
 		return (NULL);
 	}
 
+	if (seen_dedup && ndedup == 0) {
+		(void) fprintf(stderr, gettext("invalid vdev specification: "
+		    "dedup requires at least 1 device\n"));
+		return (NULL);
+	}
+
+	if (seen_special && nspecial == 0) {
+		(void) fprintf(stderr, gettext("invalid vdev specification: "
+		    "special requires at least 1 device\n"));
+		return (NULL);
+	}
+
 	/*
 	 * Finally, create nvroot and add all top-level vdevs to it.
 	 */
@@ -224,6 +224,7 @@ main(int argc, char *argv[])
 	 */
 	boolean_t dump = B_FALSE;
 	int err;
+	uint64_t payload_size;
 	zio_cksum_t zc = { 0 };
 	zio_cksum_t pcksum = { 0 };
 
@@ -456,34 +457,40 @@ main(int argc, char *argv[])
 				drrw->drr_toguid = BSWAP_64(drrw->drr_toguid);
 				drrw->drr_key.ddk_prop =
 				    BSWAP_64(drrw->drr_key.ddk_prop);
+				drrw->drr_compressed_size =
+				    BSWAP_64(drrw->drr_compressed_size);
 			}
+			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
 			/*
 			 * If this is verbose and/or dump output,
 			 * print info on the modified block
 			 */
 			if (verbose) {
 				(void) printf("WRITE object = %llu type = %u "
-				    "checksum type = %u\n"
+				    "checksum type = %u compression type = %u\n"
 				    "    offset = %llu length = %llu "
+				    "compressed_size = %llu "
 				    "props = %llx\n",
 				    (u_longlong_t)drrw->drr_object,
 				    drrw->drr_type,
 				    drrw->drr_checksumtype,
+				    drrw->drr_compressiontype,
 				    (u_longlong_t)drrw->drr_offset,
 				    (u_longlong_t)drrw->drr_length,
+				    (u_longlong_t)drrw->drr_compressed_size,
 				    (u_longlong_t)drrw->drr_key.ddk_prop);
 			}
 			/*
 			 * Read the contents of the block in from STDIN to buf
 			 */
-			(void) ssread(buf, drrw->drr_length, &zc);
+			(void) ssread(buf, payload_size, &zc);
 			/*
 			 * If in dump mode
 			 */
 			if (dump) {
-				print_block(buf, drrw->drr_length);
+				print_block(buf, payload_size);
 			}
-			total_write_size += drrw->drr_length;
+			total_write_size += payload_size;
 			break;
 
 		case DRR_WRITE_BYREF:
@@ -108,6 +108,7 @@
 #include <sys/dsl_destroy.h>
 #include <sys/dsl_scan.h>
 #include <sys/zio_checksum.h>
+#include <sys/zfs_ioctl.h>
 #include <sys/refcount.h>
 #include <sys/zfeature.h>
 #include <sys/dsl_userhold.h>
@@ -316,6 +317,7 @@ ztest_func_t ztest_zap;
 ztest_func_t ztest_zap_parallel;
 ztest_func_t ztest_zil_commit;
 ztest_func_t ztest_zil_remount;
+ztest_func_t ztest_zil_commit_fault;
 ztest_func_t ztest_dmu_read_write_zcopy;
 ztest_func_t ztest_dmu_objset_create_destroy;
 ztest_func_t ztest_dmu_prealloc;
@@ -354,6 +356,7 @@ ztest_info_t ztest_info[] = {
 	{ ztest_split_pool,			1,	&zopt_always	},
 	{ ztest_zil_commit,			1,	&zopt_incessant	},
 	{ ztest_zil_remount,			1,	&zopt_sometimes	},
+	{ ztest_zil_commit_fault,		1,	&zopt_sometimes	},
 	{ ztest_dmu_read_write_zcopy,		1,	&zopt_often	},
 	{ ztest_dmu_objset_create_destroy,	1,	&zopt_often	},
 	{ ztest_dsl_prop_get_set,		1,	&zopt_often	},
@@ -2336,6 +2339,71 @@ ztest_zil_remount(ztest_ds_t *zd, uint64_t id)
 	VERIFY(mutex_unlock(&zd->zd_dirobj_lock) == 0);
 }
 
+#define	ZTEST_ZIL_COMMITTERS	4
+
+typedef struct ztest_zil_fault {
+	ztest_ds_t	*zf_zd;
+	uint64_t	zf_object;
+} ztest_zil_fault_t;
+
+static void *
+ztest_zil_commit_fault_thread(void *arg)
+{
+	ztest_zil_fault_t *zf = arg;
+	uint64_t offset;
+
+	for (int i = 0; i < 10; i++) {
+		offset = ztest_random(ZTEST_RANGE_LOCKS) << SPA_MAXBLOCKSHIFT;
+		ztest_io(zf->zf_zd, zf->zf_object, offset);
+		ztest_zil_commit(zf->zf_zd, 0);
+	}
+	return (NULL);
+}
+
+/*
+ * Fail some of this dataset's log block writes while several threads
+ * write and commit at once, so that commit batches overlap with failed
+ * ones.  A batch whose log blocks follow a failed one must wait for a txg
+ * sync; if it doesn't, the sequence number ztest_zil_commit() records is
+ * missing from the log when the dataset is next opened, and that check
+ * in ztest_dataset_open() fails.
+ */
+/* ARGSUSED */
+void
+ztest_zil_commit_fault(ztest_ds_t *zd, uint64_t id)
+{
+	zinject_record_t record = { 0 };
+	ztest_zil_fault_t zf;
+	ztest_od_t od[1];
+	thread_t tid[ZTEST_ZIL_COMMITTERS];
+	int inject_id;
+
+	ztest_od_init(&od[0], ID_PARALLEL, FTAG, 0, DMU_OT_UINT64_OTHER, 0, 0);
+	if (ztest_object_init(zd, od, sizeof (od), B_FALSE) != 0)
+		return;
+
+	record.zi_cmd = ZINJECT_DATA_FAULT;
+	record.zi_objset = dmu_objset_id(zd->zd_os);
+	record.zi_object = ZB_ZIL_OBJECT;
+	record.zi_level = (uint32_t)ZB_ZIL_LEVEL;
+	record.zi_start = 0;
+	record.zi_end = -1ULL;
+	record.zi_error = EIO;
+	record.zi_freq = 25;
+	VERIFY0(zio_inject_fault(ztest_opts.zo_pool, 0, &inject_id, &record));
+
+	zf.zf_zd = zd;
+	zf.zf_object = od[0].od_object;
+	for (int t = 0; t < ZTEST_ZIL_COMMITTERS; t++) {
+		VERIFY0(thr_create(0, 0, ztest_zil_commit_fault_thread, &zf,
+		    THR_BOUND, &tid[t]));
+	}
+	for (int t = 0; t < ZTEST_ZIL_COMMITTERS; t++)
+		VERIFY0(thr_join(tid[t], NULL, NULL));
+
+	VERIFY0(zio_clear_fault(inject_id));
+}
+
 /*
  * Verify that we can't destroy an active pool, create an existing pool,
  * or create a pool with a bad vdev spec.
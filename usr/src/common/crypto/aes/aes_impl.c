@@ -118,6 +118,12 @@ extern void aes_encrypt_intel(const uint32_t rk[], int Nr,
 	const uint32_t pt[4], uint32_t ct[4]);
 extern void aes_decrypt_intel(const uint32_t rk[], int Nr,
 	const uint32_t ct[4], uint32_t pt[4]);
+extern void aes_gcm_encrypt_intel(const uint32_t rk[], int Nr,
+	const uint8_t *in, uint8_t *out, size_t nblocks, uint64_t cb[2],
+	uint64_t ghash[2], const uint64_t htab[8]);
+extern void aes_gcm_decrypt_intel(const uint32_t rk[], int Nr,
+	const uint8_t *in, uint8_t *out, size_t nblocks, uint64_t cb[2],
+	uint64_t ghash[2], const uint64_t htab[8]);
 
 static int intel_aes_instructions_present(void);
 
@@ -1213,6 +1219,49 @@ rijndael_decrypt(const uint32_t rk[], int Nr, const uint32_t ct[4],
 	}
 }
 
+/*
+ * Return B_TRUE if the key schedule can be used with aes_gcm_blocks().
+ */
+boolean_t
+aes_gcm_blocks_capable(const void *ks)
+{
+	return ((((aes_key_t *)ks)->flags & INTEL_AES_NI_CAPABLE) != 0);
+}
+
+/*
+ * Encrypt or decrypt nblocks (a multiple of GCM_MULTI_BLOCKS) blocks of
+ * AES GCM data, updating the counter block cb and the hash ghash.
+ * The AES-NI routine runs four blocks through the cipher together and
+ * hashes them with one reduction using the powers of H in htab.
+ *
+ * Parameters:
+ * ks		AES key schedule, which must be AES-NI capable
+ * cb		GCM counter block
+ * ghash	GHASH accumulator
+ * htab		H^4, H^3, H^2 and H, as in gcm_ctx_t
+ * in		Input blocks
+ * out		Output blocks.  Can be the same as in
+ * nblocks	Number of 16-byte blocks
+ * decrypt	B_TRUE if in is ciphertext
+ */
+void
+aes_gcm_blocks(const void *ks, uint64_t *cb, uint64_t *ghash,
+    const uint64_t *htab, const uint8_t *in, uint8_t *out, size_t nblocks,
+    boolean_t decrypt)
+{
+	aes_key_t *key = (aes_key_t *)ks;
+
+	KPREEMPT_DISABLE;
+	if (decrypt) {
+		aes_gcm_decrypt_intel(&(key->encr_ks.ks32[0]), key->nr,
+		    in, out, nblocks, cb, ghash, htab);
+	} else {
+		aes_gcm_encrypt_intel(&(key->encr_ks.ks32[0]), key->nr,
+		    in, out, nblocks, cb, ghash, htab);
+	}
+	KPREEMPT_ENABLE;
+}
+
 
 #else /* generic C implementation */
 
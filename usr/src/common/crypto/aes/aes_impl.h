@@ -133,6 +133,14 @@ extern void aes_init_keysched(const uint8_t *cipherKey, uint_t keyBits,
 extern int aes_encrypt_block(const void *ks, const uint8_t *pt, uint8_t *ct);
 extern int aes_decrypt_block(const void *ks, const uint8_t *ct, uint8_t *pt);
 
+#ifdef __amd64
+/* Multi-block AES-NI GCM routine, see gcm_set_blocks() */
+extern boolean_t aes_gcm_blocks_capable(const void *ks);
+extern void aes_gcm_blocks(const void *ks, uint64_t *cb, uint64_t *ghash,
+    const uint64_t *htab, const uint8_t *in, uint8_t *out, size_t nblocks,
+    boolean_t decrypt);
+#endif	/* __amd64 */
+
 /*
  * AES mode functions.
  * The first 2 functions operate on 16-byte AES blocks.
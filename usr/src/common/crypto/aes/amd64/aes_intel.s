@@ -175,6 +175,18 @@ rijndael_key_setup_dec_intel(uint32_t rk[], const uint32_t cipherKey[],
    uint64_t keyBits) {
 	return (0);
 }
+/* ARGSUSED */
+void
+aes_gcm_encrypt_intel(const uint32_t rk[], int Nr, const uint8_t *in,
+    uint8_t *out, size_t nblocks, uint64_t cb[2], uint64_t ghash[2],
+    const uint64_t htab[8]) {
+}
+/* ARGSUSED */
+void
+aes_gcm_decrypt_intel(const uint32_t rk[], int Nr, const uint8_t *in,
+    uint8_t *out, size_t nblocks, uint64_t cb[2], uint64_t ghash[2],
+    const uint64_t htab[8]) {
+}
 
 
 #else	/* lint */
@@ -851,4 +863,313 @@ ENTRY_NP(aes_decrypt_intel)
 	ret
 	SET_SIZE(aes_decrypt_intel)
 
+/*
+ * aes_gcm_encrypt_intel(), aes_gcm_decrypt_intel()
+ * Encrypt or decrypt a multiple of four blocks in AES GCM mode, folding
+ * the ciphertext into the GHASH in the same pass (in and out can be the
+ * same buffer).
+ *
+ * Four counter blocks are encrypted side by side with AES-NI, which hides
+ * the aesenc latency, and the four ciphertext blocks are hashed with one
+ * modular reduction by multiplying them with H^4, H^3, H^2 and H
+ * ("aggregated reduction", see Gueron and Kounavis, "Intel Carry-Less
+ * Multiplication Instruction and its Usage for Computing the GCM Mode").
+ * The GHASH of one group does not depend on the AES rounds of the next,
+ * so the two overlap in the pipeline.
+ *
+ * cb is the GCM counter block; its low 32 bits (big-endian) are incremented
+ * before each block is encrypted and the last counter used is written
+ * back.  ghash is updated in place.  htab holds H^4, H^3, H^2 and H, each
+ * in the byte order of gcm_H.  nblocks must be a non-zero multiple of 4.
+ *
+ * For kernel code, caller is responsible for ensuring kpreempt_disable()
+ * has been called.  Clear and set the CR0.TS bit on entry and exit,
+ * respectively, if TS is set on entry.  Otherwise, if TS is not set, save
+ * and restore %xmm registers on the stack.
+ *
+ * Temporary register usage:
+ * %xmm0 - %xmm3	AES state of the four blocks, then the ciphertext
+ * %xmm4		Round key or power of H
+ * %xmm5		Counter block (byte reversed)
+ * %xmm6		Byte reversal mask
+ * %xmm7		GHASH (byte reversed)
+ * %xmm8 - %xmm13	GHASH product and reduction temporaries
+ * %xmm14		Counter increment
+ *
+ * OpenSolaris Interface:
+ * void aes_gcm_encrypt_intel(const uint32_t rk[], int Nr,
+ *	const uint8_t *in, uint8_t *out, size_t nblocks, uint64_t cb[2],
+ *	uint64_t ghash[2], const uint64_t htab[8])
+ * void aes_gcm_decrypt_intel(const uint32_t rk[], int Nr,
+ *	const uint8_t *in, uint8_t *out, size_t nblocks, uint64_t cb[2],
+ *	uint64_t ghash[2], const uint64_t htab[8])
+ */
+
+#ifdef _KERNEL
+	/*
+	 * If CR0_TS is not set, push %xmm0 - %xmm14 on stack,
+	 * otherwise clear CR0_TS.
+	 */
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM14(tmpreg) \
+	push	%rbp; \
+	mov	%rsp, %rbp; \
+	movq	%cr0, tmpreg; \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	and	$-XMM_ALIGN, %rsp; \
+	sub	$[XMM_SIZE * 15], %rsp; \
+	movaps	%xmm0, 224(%rsp); \
+	movaps	%xmm1, 208(%rsp); \
+	movaps	%xmm2, 192(%rsp); \
+	movaps	%xmm3, 176(%rsp); \
+	movaps	%xmm4, 160(%rsp); \
+	movaps	%xmm5, 144(%rsp); \
+	movaps	%xmm6, 128(%rsp); \
+	movaps	%xmm7, 112(%rsp); \
+	movaps	%xmm8, 96(%rsp); \
+	movaps	%xmm9, 80(%rsp); \
+	movaps	%xmm10, 64(%rsp); \
+	movaps	%xmm11, 48(%rsp); \
+	movaps	%xmm12, 32(%rsp); \
+	movaps	%xmm13, 16(%rsp); \
+	movaps	%xmm14, (%rsp); \
+	jmp	2f; \
+1: \
+	PROTECTED_CLTS; \
+2:
+
+	/*
+	 * If CR0_TS was not set above, pop %xmm0 - %xmm14 off stack,
+	 * otherwise set CR0_TS.
+	 */
+#define	SET_TS_OR_POP_XMM0_TO_XMM14(tmpreg) \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	movaps	(%rsp), %xmm14; \
+	movaps	16(%rsp), %xmm13; \
+	movaps	32(%rsp), %xmm12; \
+	movaps	48(%rsp), %xmm11; \
+	movaps	64(%rsp), %xmm10; \
+	movaps	80(%rsp), %xmm9; \
+	movaps	96(%rsp), %xmm8; \
+	movaps	112(%rsp), %xmm7; \
+	movaps	128(%rsp), %xmm6; \
+	movaps	144(%rsp), %xmm5; \
+	movaps	160(%rsp), %xmm4; \
+	movaps	176(%rsp), %xmm3; \
+	movaps	192(%rsp), %xmm2; \
+	movaps	208(%rsp), %xmm1; \
+	movaps	224(%rsp), %xmm0; \
+	jmp	2f; \
+1: \
+	STTS(tmpreg); \
+2: \
+	mov	%rbp, %rsp; \
+	pop	%rbp
+
+#else
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM14(tmpreg)
+#define	SET_TS_OR_POP_XMM0_TO_XMM14(tmpreg)
+#endif	/* _KERNEL */
+
+/*
+ * Accumulate the 256-bit carry-less product of a (destroyed) and %xmm4
+ * into %xmm8 (low), %xmm10 (middle) and %xmm9 (high), using %xmm11.
+ */
+#define	GCM_MUL_ACC(a) \
+	movdqa	a, %xmm11; \
+	pclmulqdq $0x00, %xmm4, %xmm11; \
+	pxor	%xmm11, %xmm8; \
+	movdqa	a, %xmm11; \
+	pclmulqdq $0x11, %xmm4, %xmm11; \
+	pxor	%xmm11, %xmm9; \
+	movdqa	a, %xmm11; \
+	pclmulqdq $0x10, %xmm4, %xmm11; \
+	pxor	%xmm11, %xmm10; \
+	pclmulqdq $0x01, %xmm4, a; \
+	pxor	a, %xmm10
+
+/* Load the next power of H from htab (%rax) into %xmm4 */
+#define	GCM_LOAD_H(off) \
+	movdqu	off(%rax), %xmm4; \
+	pshufb	%xmm6, %xmm4
+
+ENTRY_NP(aes_gcm_encrypt_intel)
+	xor	%r10d, %r10d			/ encrypt
+	jmp	.Lgcm_intel
+	SET_SIZE(aes_gcm_encrypt_intel)
+
+ENTRY_NP(aes_gcm_decrypt_intel)
+	mov	$1, %r10d			/ decrypt
+	/ FALLTHROUGH
+
+.Lgcm_intel:
+	mov	8(%rsp), %r11			/ P7: ghash
+	mov	16(%rsp), %rax			/ P8: htab
+	push	%rbx
+	push	%r12
+	mov	%r10d, %r12d
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM14(%r10)
+
+	/ Byte reversal mask and counter increment
+	mov	$0x08090a0b0c0d0e0f, %rbx
+	movq	%rbx, %xmm6
+	mov	$0x0001020304050607, %rbx
+	movq	%rbx, %xmm14
+	punpcklqdq %xmm14, %xmm6
+	mov	$1, %ebx
+	movd	%ebx, %xmm14
+
+	movdqu	(%r9), %xmm5			/ counter block
+	pshufb	%xmm6, %xmm5
+	movdqu	(%r11), %xmm7			/ GHASH
+	pshufb	%xmm6, %xmm7
+
+	mov	%esi, %esi
+	shl	$4, %rsi			/ %rsi = last round key
+	add	%rdi, %rsi
+
+.align 4
+.Lgcm_intel_loop:
+	/ Increment the low 32 bits of the counter for each block
+	paddd	%xmm14, %xmm5
+	movdqa	%xmm5, %xmm0
+	paddd	%xmm14, %xmm5
+	movdqa	%xmm5, %xmm1
+	paddd	%xmm14, %xmm5
+	movdqa	%xmm5, %xmm2
+	paddd	%xmm14, %xmm5
+	movdqa	%xmm5, %xmm3
+	pshufb	%xmm6, %xmm0
+	pshufb	%xmm6, %xmm1
+	pshufb	%xmm6, %xmm2
+	pshufb	%xmm6, %xmm3
+
+	movaps	(%rdi), %xmm4			/ round 0
+	pxor	%xmm4, %xmm0
+	pxor	%xmm4, %xmm1
+	pxor	%xmm4, %xmm2
+	pxor	%xmm4, %xmm3
+	lea	0x10(%rdi), %rbx
+
+.align 4
+.Lgcm_intel_round:
+	movaps	(%rbx), %xmm4
+	aesenc	%xmm4, %xmm0
+	aesenc	%xmm4, %xmm1
+	aesenc	%xmm4, %xmm2
+	aesenc	%xmm4, %xmm3
+	lea	0x10(%rbx), %rbx
+	cmp	%rsi, %rbx
+	jb	.Lgcm_intel_round
+
+	movaps	(%rbx), %xmm4			/ last round
+	aesenclast %xmm4, %xmm0
+	aesenclast %xmm4, %xmm1
+	aesenclast %xmm4, %xmm2
+	aesenclast %xmm4, %xmm3
+
+	/ XOR the key stream with the input.  Decrypt hashes the input.
+	movdqu	(%rdx), %xmm8
+	movdqu	0x10(%rdx), %xmm9
+	movdqu	0x20(%rdx), %xmm10
+	movdqu	0x30(%rdx), %xmm11
+	pxor	%xmm8, %xmm0
+	pxor	%xmm9, %xmm1
+	pxor	%xmm10, %xmm2
+	pxor	%xmm11, %xmm3
+	movdqu	%xmm0, (%rcx)
+	movdqu	%xmm1, 0x10(%rcx)
+	movdqu	%xmm2, 0x20(%rcx)
+	movdqu	%xmm3, 0x30(%rcx)
+	test	%r12d, %r12d
+	jz	.Lgcm_intel_ghash
+	movdqa	%xmm8, %xmm0
+	movdqa	%xmm9, %xmm1
+	movdqa	%xmm10, %xmm2
+	movdqa	%xmm11, %xmm3
+
+.Lgcm_intel_ghash:
+	/ GHASH = (GHASH ^ C1) * H^4 ^ C2 * H^3 ^ C3 * H^2 ^ C4 * H
+	pshufb	%xmm6, %xmm0
+	pshufb	%xmm6, %xmm1
+	pshufb	%xmm6, %xmm2
+	pshufb	%xmm6, %xmm3
+	pxor	%xmm7, %xmm0
+	pxor	%xmm8, %xmm8
+	pxor	%xmm9, %xmm9
+	pxor	%xmm10, %xmm10
+	GCM_LOAD_H(0)
+	GCM_MUL_ACC(%xmm0)
+	GCM_LOAD_H(0x10)
+	GCM_MUL_ACC(%xmm1)
+	GCM_LOAD_H(0x20)
+	GCM_MUL_ACC(%xmm2)
+	GCM_LOAD_H(0x30)
+	GCM_MUL_ACC(%xmm3)
+
+	/ Fold the middle term into %xmm9:%xmm8
+	movdqa	%xmm10, %xmm11
+	pslldq	$8, %xmm11
+	psrldq	$8, %xmm10
+	pxor	%xmm11, %xmm8
+	pxor	%xmm10, %xmm9
+
+	/ Shift the 256-bit product left by one bit
+	movdqa	%xmm8, %xmm10
+	psrld	$31, %xmm10
+	movdqa	%xmm9, %xmm11
+	psrld	$31, %xmm11
+	pslld	$1, %xmm8
+	pslld	$1, %xmm9
+	movdqa	%xmm10, %xmm12
+	psrldq	$12, %xmm12
+	pslldq	$4, %xmm11
+	pslldq	$4, %xmm10
+	por	%xmm10, %xmm8
+	por	%xmm11, %xmm9
+	por	%xmm12, %xmm9
+
+	/ Reduce modulo x^128 + x^7 + x^2 + x + 1
+	movdqa	%xmm8, %xmm10
+	pslld	$31, %xmm10
+	movdqa	%xmm8, %xmm11
+	pslld	$30, %xmm11
+	movdqa	%xmm8, %xmm12
+	pslld	$25, %xmm12
+	pxor	%xmm11, %xmm10
+	pxor	%xmm12, %xmm10
+	movdqa	%xmm10, %xmm11
+	psrldq	$4, %xmm11
+	pslldq	$12, %xmm10
+	pxor	%xmm10, %xmm8
+	movdqa	%xmm8, %xmm12
+	psrld	$1, %xmm12
+	movdqa	%xmm8, %xmm13
+	psrld	$2, %xmm13
+	movdqa	%xmm8, %xmm10
+	psrld	$7, %xmm10
+	pxor	%xmm13, %xmm12
+	pxor	%xmm10, %xmm12
+	pxor	%xmm11, %xmm12
+	pxor	%xmm12, %xmm8
+	pxor	%xmm8, %xmm9
+	movdqa	%xmm9, %xmm7
+
+	lea	0x40(%rdx), %rdx
+	lea	0x40(%rcx), %rcx
+	sub	$4, %r8
+	ja	.Lgcm_intel_loop
+
+	pshufb	%xmm6, %xmm5			/ store counter and GHASH
+	movdqu	%xmm5, (%r9)
+	pshufb	%xmm6, %xmm7
+	movdqu	%xmm7, (%r11)
+
+	SET_TS_OR_POP_XMM0_TO_XMM14(%r10)
+	pop	%r12
+	pop	%rbx
+	ret
+	SET_SIZE(aes_gcm_decrypt_intel)
+
 #endif	/* lint || __lint */
@@ -123,6 +123,39 @@ gcm_mul(uint64_t *x_in, uint64_t *y, uint64_t *res)
 	(uint64_t *)(void *)(t));
 
 
+/*
+ * Encrypt length bytes (a multiple of GCM_MULTI_BLOCKS blocks) with the
+ * cipher's multi-block routine.  Return the number of bytes processed,
+ * which is 0 if the output for them is not contiguous.
+ */
+static size_t
+gcm_encrypt_multi_blocks(gcm_ctx_t *ctx, uint8_t *datap, size_t length,
+    crypto_data_t *out, void **iov_or_mp, offset_t *offset, size_t block_size)
+{
+	uint8_t *out_data_1 = datap;
+	uint8_t *out_data_2;
+	size_t out_data_1_len = 0;
+	void *mp = *iov_or_mp;
+	offset_t off = *offset;
+
+	if (out != NULL) {
+		crypto_get_ptrs(out, &mp, &off, &out_data_1,
+		    &out_data_1_len, &out_data_2, length);
+		if (out_data_1_len != length)
+			return (0);
+		*iov_or_mp = mp;
+		*offset = off;
+		out->cd_offset += length;
+	}
+
+	ctx->gcm_blocks(ctx->gcm_keysched, ctx->gcm_cb, ctx->gcm_ghash,
+	    ctx->gcm_H_pow[0], datap, out_data_1, length / block_size,
+	    B_FALSE);
+	ctx->gcm_processed_data_len += length;
+
+	return (length);
+}
+
 /*
  * Encrypt multiple blocks of data in GCM mode.  Decrypt for GCM mode
  * is done in another function.
@@ -146,6 +179,7 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 	size_t out_data_1_len;
 	uint64_t counter;
 	uint64_t counter_mask = ntohll(0x00000000ffffffffULL);
+	size_t multi = GCM_MULTI_BLOCKS * block_size;
 
 	if (length + ctx->gcm_remainder_len < block_size) {
 		/* accumulate bytes here and return */
@@ -162,6 +196,22 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 		crypto_init_ptrs(out, &iov_or_mp, &offset);
 
 	do {
+		/*
+		 * Whole groups of blocks go to the cipher's multi-block
+		 * routine, until the output turns out not to be contiguous.
+		 */
+		if (ctx->gcm_blocks != NULL && multi != 0 &&
+		    ctx->gcm_remainder_len == 0 && remainder >= multi) {
+			need = gcm_encrypt_multi_blocks(ctx, datap,
+			    remainder - remainder % multi, out, &iov_or_mp,
+			    &offset, block_size);
+			if (need > 0) {
+				datap += need;
+				goto next;
+			}
+			multi = 0;
+		}
+
 		/* Unprocessed data from last call. */
 		if (ctx->gcm_remainder_len > 0) {
 			need = block_size - ctx->gcm_remainder_len;
@@ -230,7 +280,7 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 		} else {
 			datap += block_size;
 		}
-
+next:
 		remainder = (size_t)&data[length] - (size_t)datap;
 
 		/* Incomplete last block. */
@@ -439,6 +489,20 @@ gcm_decrypt_final(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size,
 			ctx->gcm_remainder_len = 0;
 			goto out;
 		}
+		/* Decrypt whole groups of blocks in place in one pass */
+		if (ctx->gcm_blocks != NULL &&
+		    remainder >= GCM_MULTI_BLOCKS * block_size) {
+			size_t len = remainder -
+			    remainder % (GCM_MULTI_BLOCKS * block_size);
+
+			ctx->gcm_blocks(ctx->gcm_keysched, ctx->gcm_cb,
+			    ctx->gcm_ghash, ctx->gcm_H_pow[0], blockp, blockp,
+			    len / block_size, B_TRUE);
+			processed += len;
+			blockp += len;
+			remainder -= len;
+			continue;
+		}
 		/* add ciphertext to the hash */
 		GHASH(ctx, blockp, ghash);
 
@@ -722,6 +786,30 @@ gcm_set_kmflag(gcm_ctx_t *ctx, int kmflag)
 	ctx->gcm_kmflag = kmflag;
 }
 
+/*
+ * Let the block cipher encrypt and hash GCM_MULTI_BLOCKS blocks at a time
+ * with blocks, once gcm_init() has computed the subkey H.  The routine
+ * gets the powers of H it needs from gcm_H_pow.
+ */
+void
+gcm_set_blocks(gcm_ctx_t *ctx, gcm_blocks_fn_t blocks)
+{
+	int i;
+
+#ifdef __amd64
+	/* The multi-block routines hash with PCLMULQDQ instructions */
+	if (!intel_pclmulqdq_instruction_present())
+		return;
+#endif	/* __amd64 */
+
+	ctx->gcm_H_pow[GCM_MULTI_BLOCKS - 1][0] = ctx->gcm_H[0];
+	ctx->gcm_H_pow[GCM_MULTI_BLOCKS - 1][1] = ctx->gcm_H[1];
+	for (i = GCM_MULTI_BLOCKS - 2; i >= 0; i--) {
+		gcm_mul(ctx->gcm_H_pow[i + 1], ctx->gcm_H, ctx->gcm_H_pow[i]);
+	}
+	ctx->gcm_blocks = blocks;
+}
+
 
 #ifdef __amd64
 /*
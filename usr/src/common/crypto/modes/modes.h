@@ -202,7 +202,20 @@ typedef struct ccm_ctx {
  *
  * gcm_kmflag:		Current value of kmflag. Used only for allocating
  *			the plaintext buffer during decryption.
+ *
+ * gcm_blocks:		Optional cipher routine that encrypts or decrypts
+ *			a multiple of GCM_MULTI_BLOCKS blocks and updates
+ *			gcm_cb and gcm_ghash in one pass, see
+ *			gcm_set_blocks().
+ *
+ * gcm_H_pow:		H^4, H^3, H^2 and H, used by gcm_blocks to hash
+ *			GCM_MULTI_BLOCKS blocks with a single reduction.
  */
+#define	GCM_MULTI_BLOCKS	4
+
+typedef void (*gcm_blocks_fn_t)(const void *, uint64_t *, uint64_t *,
+    const uint64_t *, const uint8_t *, uint8_t *, size_t, boolean_t);
+
 typedef struct gcm_ctx {
 	struct common_ctx gcm_common;
 	size_t gcm_tag_len;
@@ -215,6 +228,8 @@ typedef struct gcm_ctx {
 	uint64_t gcm_len_a_len_c[2];
 	uint8_t *gcm_pt_buf;
 	int gcm_kmflag;
+	gcm_blocks_fn_t gcm_blocks;
+	uint64_t gcm_H_pow[GCM_MULTI_BLOCKS][2];
 } gcm_ctx_t;
 
 #define	gcm_keysched		gcm_common.cc_keysched
@@ -372,6 +387,7 @@ extern void calculate_ccm_mac(ccm_ctx_t *, uint8_t *,
     int (*encrypt_block)(const void *, const uint8_t *, uint8_t *));
 
 extern void gcm_mul(uint64_t *, uint64_t *, uint64_t *);
+extern void gcm_set_blocks(gcm_ctx_t *, gcm_blocks_fn_t);
 
 extern void crypto_init_ptrs(crypto_data_t *, void **, offset_t *);
 extern void crypto_get_ptrs(crypto_data_t *, void **, offset_t *,
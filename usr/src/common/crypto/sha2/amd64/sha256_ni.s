@@ -0,0 +1,254 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * SHA-256 block transform using the Intel SHA extensions (SHA-NI).
+ *
+ * The eight state words are kept as two vectors, ABEF and CDGH, which
+ * is the layout sha256rnds2 works on; each sha256rnds2 does two rounds
+ * and the message schedule is computed four words at a time with
+ * sha256msg1 and sha256msg2.  See Gulley et al., "Intel SHA Extensions:
+ * New Instructions Supporting the Secure Hash Algorithm on Intel
+ * Architecture Processors".
+ *
+ * For kernel code, caller is responsible for ensuring kpreempt_disable()
+ * has been called.  Clear and set the CR0.TS bit on entry and exit,
+ * respectively, if TS is set on entry.  Otherwise, if TS is not set, save
+ * and restore %xmm registers on the stack.
+ *
+ * Register usage:
+ * %xmm0		Message words plus round constants
+ * %xmm1		State ABEF
+ * %xmm2		State CDGH
+ * %xmm3 - %xmm6	Message schedule
+ * %xmm7		Temporary
+ * %xmm8		Byte swap mask
+ * %xmm9, %xmm10	State at the start of the block
+ *
+ * Interface:
+ * void SHA256TransformBlocksNI(uint32_t state[8], const void *in,
+ *	size_t num)
+ */
+
+#if defined(lint) || defined(__lint)
+
+#include <sys/types.h>
+
+/* ARGSUSED */
+void
+SHA256TransformBlocksNI(uint32_t state[8], const void *in, size_t num)
+{
+}
+
+#else	/* lint */
+
+#include <sys/asm_linkage.h>
+#include <sys/controlregs.h>
+#ifdef _KERNEL
+#include <sys/machprivregs.h>
+#endif
+
+#ifdef _KERNEL
+	/*
+	 * Note: the CLTS macro clobbers P2 (%rsi) under i86xpv.  That is,
+	 * it calls HYPERVISOR_fpu_taskswitch() which modifies %rsi when it
+	 * uses it to pass P2 to syscall.
+	 */
+#ifdef __xpv
+#define	PROTECTED_CLTS \
+	push	%rsi; \
+	CLTS; \
+	pop	%rsi
+#else
+#define	PROTECTED_CLTS \
+	CLTS
+#endif	/* __xpv */
+
+	/*
+	 * If CR0_TS is not set, align stack (with push %rbp) and push
+	 * %xmm0 - %xmm10 on stack, otherwise clear CR0_TS
+	 */
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(tmpreg) \
+	push	%rbp; \
+	mov	%rsp, %rbp; \
+	movq	%cr0, tmpreg; \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	and	$-XMM_ALIGN, %rsp; \
+	sub	$[XMM_SIZE * 11], %rsp; \
+	movaps	%xmm0, 160(%rsp); \
+	movaps	%xmm1, 144(%rsp); \
+	movaps	%xmm2, 128(%rsp); \
+	movaps	%xmm3, 112(%rsp); \
+	movaps	%xmm4, 96(%rsp); \
+	movaps	%xmm5, 80(%rsp); \
+	movaps	%xmm6, 64(%rsp); \
+	movaps	%xmm7, 48(%rsp); \
+	movaps	%xmm8, 32(%rsp); \
+	movaps	%xmm9, 16(%rsp); \
+	movaps	%xmm10, (%rsp); \
+	jmp	2f; \
+1: \
+	PROTECTED_CLTS; \
+2:
+
+	/*
+	 * If CR0_TS was not set above, pop %xmm0 - %xmm10 off stack,
+	 * otherwise set CR0_TS.
+	 */
+#define	SET_TS_OR_POP_XMM0_TO_XMM10(tmpreg) \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	movaps	(%rsp), %xmm10; \
+	movaps	16(%rsp), %xmm9; \
+	movaps	32(%rsp), %xmm8; \
+	movaps	48(%rsp), %xmm7; \
+	movaps	64(%rsp), %xmm6; \
+	movaps	80(%rsp), %xmm5; \
+	movaps	96(%rsp), %xmm4; \
+	movaps	112(%rsp), %xmm3; \
+	movaps	128(%rsp), %xmm2; \
+	movaps	144(%rsp), %xmm1; \
+	movaps	160(%rsp), %xmm0; \
+	jmp	2f; \
+1: \
+	STTS(tmpreg); \
+2: \
+	mov	%rbp, %rsp; \
+	pop	%rbp
+
+#else
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(tmpreg)
+#define	SET_TS_OR_POP_XMM0_TO_XMM10(tmpreg)
+#endif	/* _KERNEL */
+
+/* Load and byte swap message words 4i to 4i + 3 into m */
+#define	SHA256_LOAD(m, i) \
+	movdqu	(16 * (i))(%rsi), m; \
+	pshufb	%xmm8, m
+
+/*
+ * Compute message words 4i to 4i + 3 into m, which holds words 4i - 16
+ * to 4i - 13 on entry; m1, m2 and m3 hold the three groups after it.
+ */
+#define	SHA256_SCHED(m, m1, m2, m3) \
+	sha256msg1 m1, m; \
+	movdqa	m3, %xmm7; \
+	palignr	$4, m2, %xmm7; \
+	paddd	%xmm7, m; \
+	sha256msg2 m3, m
+
+/* Rounds 4i to 4i + 3 with the message words in m */
+#define	SHA256_ROUNDS(m, i) \
+	movdqa	m, %xmm0; \
+	paddd	(16 * (i))(%rax), %xmm0; \
+	sha256rnds2 %xmm0, %xmm1, %xmm2; \
+	pshufd	$0x0e, %xmm0, %xmm0; \
+	sha256rnds2 %xmm0, %xmm2, %xmm1
+
+ENTRY_NP(SHA256TransformBlocksNI)
+	test	%rdx, %rdx
+	jz	.Lsha256_ni_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(%r10)
+
+	lea	.Lsha256_ni_k(%rip), %rax
+	movdqa	.Lsha256_ni_bswap(%rip), %xmm8
+
+	/ Rearrange the state into ABEF and CDGH
+	movdqu	(%rdi), %xmm1
+	movdqu	16(%rdi), %xmm2
+	pshufd	$0xb1, %xmm1, %xmm1
+	pshufd	$0x1b, %xmm2, %xmm2
+	movdqa	%xmm1, %xmm7
+	palignr	$8, %xmm2, %xmm1
+	pblendw	$0xf0, %xmm7, %xmm2
+
+.align 16
+.Lsha256_ni_loop:
+	movdqa	%xmm1, %xmm9
+	movdqa	%xmm2, %xmm10
+
+	SHA256_LOAD(%xmm3, 0)
+	SHA256_ROUNDS(%xmm3, 0)
+	SHA256_LOAD(%xmm4, 1)
+	SHA256_ROUNDS(%xmm4, 1)
+	SHA256_LOAD(%xmm5, 2)
+	SHA256_ROUNDS(%xmm5, 2)
+	SHA256_LOAD(%xmm6, 3)
+	SHA256_ROUNDS(%xmm6, 3)
+	SHA256_SCHED(%xmm3, %xmm4, %xmm5, %xmm6)
+	SHA256_ROUNDS(%xmm3, 4)
+	SHA256_SCHED(%xmm4, %xmm5, %xmm6, %xmm3)
+	SHA256_ROUNDS(%xmm4, 5)
+	SHA256_SCHED(%xmm5, %xmm6, %xmm3, %xmm4)
+	SHA256_ROUNDS(%xmm5, 6)
+	SHA256_SCHED(%xmm6, %xmm3, %xmm4, %xmm5)
+	SHA256_ROUNDS(%xmm6, 7)
+	SHA256_SCHED(%xmm3, %xmm4, %xmm5, %xmm6)
+	SHA256_ROUNDS(%xmm3, 8)
+	SHA256_SCHED(%xmm4, %xmm5, %xmm6, %xmm3)
+	SHA256_ROUNDS(%xmm4, 9)
+	SHA256_SCHED(%xmm5, %xmm6, %xmm3, %xmm4)
+	SHA256_ROUNDS(%xmm5, 10)
+	SHA256_SCHED(%xmm6, %xmm3, %xmm4, %xmm5)
+	SHA256_ROUNDS(%xmm6, 11)
+	SHA256_SCHED(%xmm3, %xmm4, %xmm5, %xmm6)
+	SHA256_ROUNDS(%xmm3, 12)
+	SHA256_SCHED(%xmm4, %xmm5, %xmm6, %xmm3)
+	SHA256_ROUNDS(%xmm4, 13)
+	SHA256_SCHED(%xmm5, %xmm6, %xmm3, %xmm4)
+	SHA256_ROUNDS(%xmm5, 14)
+	SHA256_SCHED(%xmm6, %xmm3, %xmm4, %xmm5)
+	SHA256_ROUNDS(%xmm6, 15)
+
+	paddd	%xmm9, %xmm1
+	paddd	%xmm10, %xmm2
+	lea	64(%rsi), %rsi
+	dec	%rdx
+	jnz	.Lsha256_ni_loop
+
+	/ Put the state back in ABCDEFGH order
+	pshufd	$0x1b, %xmm1, %xmm1
+	pshufd	$0xb1, %xmm2, %xmm2
+	movdqa	%xmm1, %xmm7
+	pblendw	$0xf0, %xmm2, %xmm1
+	palignr	$8, %xmm7, %xmm2
+	movdqu	%xmm1, (%rdi)
+	movdqu	%xmm2, 16(%rdi)
+
+	SET_TS_OR_POP_XMM0_TO_XMM10(%r10)
+.Lsha256_ni_done:
+	ret
+	SET_SIZE(SHA256TransformBlocksNI)
+
+	.section .rodata
+	.align	64
+.Lsha256_ni_k:
+	.long	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5
+	.long	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5
+	.long	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3
+	.long	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174
+	.long	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc
+	.long	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da
+	.long	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7
+	.long	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967
+	.long	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13
+	.long	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85
+	.long	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3
+	.long	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070
+	.long	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5
+	.long	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3
+	.long	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208
+	.long	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+.Lsha256_ni_bswap:
+	.quad	0x0405060700010203, 0x0c0d0e0f08090a0b
+
+#endif	/* lint || __lint */
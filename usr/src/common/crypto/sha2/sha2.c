@@ -75,10 +75,28 @@ static void Encode64(uint8_t *, uint64_t *, size_t);
 
 #if	defined(__amd64)
 #define	SHA512Transform(ctx, in) SHA512TransformBlocks((ctx), (in), 1)
-#define	SHA256Transform(ctx, in) SHA256TransformBlocks((ctx), (in), 1)
+#define	SHA256Transform(ctx, in) SHA256Blocks((ctx), (in), 1)
 
 void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
 void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+void SHA256TransformBlocksNI(uint32_t state[8], const void *in, size_t num);
+
+#ifdef _KERNEL
+#include <sys/cpuvar.h>		/* cpu_t, CPU */
+#include <sys/x86_archext.h>	/* x86_featureset, X86FSET_SHA */
+#include <sys/disp.h>		/* kpreempt_disable(), kpreempt_enable */
+/* Workaround for no XMM kernel thread save/restore */
+#define	KPREEMPT_DISABLE	kpreempt_disable()
+#define	KPREEMPT_ENABLE		kpreempt_enable()
+
+#else
+#include <sys/auxv.h>		/* getisax() */
+#include <sys/auxv_386.h>	/* AV_386_2_SHA bit */
+#define	KPREEMPT_DISABLE
+#define	KPREEMPT_ENABLE
+#endif	/* _KERNEL */
+
+static void SHA256Blocks(SHA2_CTX *, const void *, size_t);
 
 #else
 static void SHA256Transform(SHA2_CTX *, const uint8_t *);
@@ -150,6 +168,50 @@ static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 #endif	/* _BIG_ENDIAN */
 
 
+#if	defined(__amd64)
+/*
+ * Return 1 if the CPU has the SHA extensions (SHA-NI), otherwise 0.
+ * Cache the result, as the CPU can't change.
+ *
+ * Note: the userland version uses getisax().  The kernel version uses
+ * is_x86_feature().
+ */
+static int
+sha_ni_instructions_present(void)
+{
+	static int	cached_result = -1;
+
+	if (cached_result == -1) { /* first time */
+#ifdef _KERNEL
+		cached_result = is_x86_feature(x86_featureset, X86FSET_SHA);
+#else
+		uint_t		ui[2] = { 0, 0 };
+
+		(void) getisax(ui, 2);
+		cached_result = (ui[1] & AV_386_2_SHA) != 0;
+#endif	/* _KERNEL */
+	}
+
+	return (cached_result);
+}
+
+/*
+ * Run num SHA256 blocks through the SHA-NI transform when the CPU has it,
+ * otherwise through the integer amd64 transform.
+ */
+static void
+SHA256Blocks(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	if (sha_ni_instructions_present()) {
+		KPREEMPT_DISABLE;
+		SHA256TransformBlocksNI(ctx->state.s32, in, num);
+		KPREEMPT_ENABLE;
+	} else {
+		SHA256TransformBlocks(ctx, in, num);
+	}
+}
+#endif	/* __amd64 */
+
 #if	!defined(__amd64)
 /* SHA256 Transform */
 
@@ -865,8 +927,7 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
 			block_count = (input_len - i) >> 6;
 			if (block_count > 0) {
-				SHA256TransformBlocks(ctx, &input[i],
-				    block_count);
+				SHA256Blocks(ctx, &input[i], block_count);
 				i += block_count << 6;
 			}
 		} else {
@@ -339,6 +339,10 @@ static const elfcap_desc_t hw2_386[ELFCAP_NUM_HW2_386] = {
 	{						/* 0x00000080 */
 		AV_386_2_RDSEED, STRDESC("AV_386_2_RDSEED"),
 		STRDESC("RDSEED"), STRDESC("rdseed"),
+	},
+	{						/* 0x00000100 */
+		AV_386_2_SHA, STRDESC("AV_386_2_SHA"),
+		STRDESC("SHA"), STRDESC("sha"),
 	}
 };
 
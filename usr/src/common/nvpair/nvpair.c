@@ -129,6 +129,9 @@
 static int i_get_value_size(data_type_t type, const void *data, uint_t nelem);
 static int nvlist_add_common(nvlist_t *nvl, const char *name, data_type_t type,
     uint_t nelem, const void *data);
+static int nvlist_copy_embedded(nvlist_t *nvl, nvlist_t *onvl,
+    nvlist_t *emb_nvl);
+static void nvpair_free(nvpair_t *nvp);
 
 #define	NV_STAT_EMBEDDED	0x1
 #define	EMBEDDED_NVL(nvp)	((nvlist_t *)(void *)NVP_VALUE(nvp))
@@ -144,6 +147,15 @@ int nvpair_max_recursion = 20;
 int nvpair_max_recursion = 100;
 #endif
 
+/*
+ * Lists with unique names (NV_UNIQUE_NAME or NV_UNIQUE_NAME_TYPE) get a
+ * hash index of their pairs by name once they hold nvlist_hash_min pairs,
+ * so that lookups, and the removal that precedes every add, don't have
+ * to walk the whole list.  The index is only an accelerator: if it can't
+ * be allocated or grown, lookups just walk the list or longer chains.
+ */
+uint32_t nvlist_hash_min = 16;
+
 int
 nv_alloc_init(nv_alloc_t *nva, const nv_alloc_ops_t *nvo, /* args */ ...)
 {
@@ -341,6 +353,121 @@ nvp_buf_free(nvlist_t *nvl, nvpair_t *nvp)
 	nv_mem_free(priv, NVPAIR2I_NVP(nvp), nvsize);
 }
 
+static uint32_t
+nvt_hash(const char *name, size_t len)
+{
+	uint32_t hval = 0;
+
+	while (len-- != 0)
+		hval = hval * 31 + (uchar_t)*name++;
+
+	return (hval ^ (hval >> 16));
+}
+
+static boolean_t
+nvt_match(nvpair_t *nvp, const char *name, size_t len, data_type_t type)
+{
+	return (nvp->nvp_name_sz == len + 1 &&
+	    bcmp(NVP_NAME(nvp), name, len) == 0 &&
+	    (type == DATA_TYPE_UNKNOWN || NVP_TYPE(nvp) == type));
+}
+
+static void
+nvt_insert(nvpriv_t *priv, i_nvp_t *curr)
+{
+	nvpair_t *nvp = &curr->nvi_nvp;
+	uint32_t idx = nvt_hash(NVP_NAME(nvp), nvp->nvp_name_sz - 1) &
+	    (priv->nvp_nbuckets - 1);
+
+	curr->nvi_hashnext = priv->nvp_hashtable[idx];
+	priv->nvp_hashtable[idx] = curr;
+}
+
+/*
+ * (Re)build the index with nbuckets buckets from the pair list.  On
+ * allocation failure the old index, or none, stays in place.
+ */
+static void
+nvt_resize(nvpriv_t *priv, uint32_t nbuckets)
+{
+	i_nvp_t **otab = priv->nvp_hashtable;
+	uint32_t onbuckets = priv->nvp_nbuckets;
+	i_nvp_t *curr;
+
+	ASSERT((nbuckets & (nbuckets - 1)) == 0);
+
+	if ((priv->nvp_hashtable = nv_mem_zalloc(priv,
+	    nbuckets * sizeof (i_nvp_t *))) == NULL) {
+		priv->nvp_hashtable = otab;
+		return;
+	}
+	priv->nvp_nbuckets = nbuckets;
+
+	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next)
+		nvt_insert(priv, curr);
+
+	if (otab != NULL)
+		nv_mem_free(priv, otab, onbuckets * sizeof (i_nvp_t *));
+}
+
+static void
+nvt_remove(nvpriv_t *priv, i_nvp_t *curr)
+{
+	nvpair_t *nvp = &curr->nvi_nvp;
+	uint32_t idx = nvt_hash(NVP_NAME(nvp), nvp->nvp_name_sz - 1) &
+	    (priv->nvp_nbuckets - 1);
+	i_nvp_t **ep;
+
+	for (ep = &priv->nvp_hashtable[idx]; *ep != NULL;
+	    ep = &(*ep)->nvi_hashnext) {
+		if (*ep == curr) {
+			*ep = curr->nvi_hashnext;
+			curr->nvi_hashnext = NULL;
+			return;
+		}
+	}
+	ASSERT(0);
+}
+
+static void
+nvt_free(nvpriv_t *priv)
+{
+	if (priv->nvp_hashtable != NULL) {
+		nv_mem_free(priv, priv->nvp_hashtable,
+		    priv->nvp_nbuckets * sizeof (i_nvp_t *));
+		priv->nvp_hashtable = NULL;
+		priv->nvp_nbuckets = 0;
+	}
+}
+
+/*
+ * Find a pair whose name is the len bytes at name and, unless type is
+ * DATA_TYPE_UNKNOWN, whose type is type.  Without an index this is the
+ * first such pair in the list; with one, the names of an NV_UNIQUE_NAME
+ * list are unique anyway.
+ */
+static i_nvp_t *
+nvt_lookup(nvpriv_t *priv, const char *name, size_t len, data_type_t type)
+{
+	i_nvp_t *curr;
+
+	if (priv->nvp_hashtable != NULL) {
+		curr = priv->nvp_hashtable[nvt_hash(name, len) &
+		    (priv->nvp_nbuckets - 1)];
+		for (; curr != NULL; curr = curr->nvi_hashnext) {
+			if (nvt_match(&curr->nvi_nvp, name, len, type))
+				return (curr);
+		}
+		return (NULL);
+	}
+
+	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
+		if (nvt_match(&curr->nvi_nvp, name, len, type))
+			return (curr);
+	}
+	return (NULL);
+}
+
 /*
  * nvp_buf_link - link a new nv pair into the nvlist.
  */
@@ -358,6 +485,22 @@ nvp_buf_link(nvlist_t *nvl, nvpair_t *nvp)
 		priv->nvp_last->nvi_next = curr;
 		priv->nvp_last = curr;
 	}
+	priv->nvp_nentries++;
+
+	/* Index it, growing the table to keep chains short */
+	if (priv->nvp_hashtable != NULL) {
+		nvt_insert(priv, curr);
+		if (priv->nvp_nentries > 2 * priv->nvp_nbuckets &&
+		    priv->nvp_nbuckets < (1U << 30))
+			nvt_resize(priv, priv->nvp_nbuckets << 1);
+	} else if ((nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)) &&
+	    priv->nvp_nentries >= nvlist_hash_min) {
+		uint32_t nbuckets = 1;
+
+		while (nbuckets < priv->nvp_nentries)
+			nbuckets <<= 1;
+		nvt_resize(priv, nbuckets);
+	}
 }
 
 /*
@@ -384,6 +527,10 @@ nvp_buf_unlink(nvlist_t *nvl, nvpair_t *nvp)
 		priv->nvp_last = curr->nvi_prev;
 	else
 		curr->nvi_next->nvi_prev = curr->nvi_prev;
+
+	priv->nvp_nentries--;
+	if (priv->nvp_hashtable != NULL)
+		nvt_remove(priv, curr);
 }
 
 /*
@@ -508,6 +655,75 @@ i_validate_nvpair(nvpair_t *nvp)
 	return (0);
 }
 
+/*
+ * nvp_buf_dup - copy an nvpair of another list into a new buffer for nvl,
+ * fixing up the pointers inside its value.  The source pair was
+ * validated when it was added, so there is nothing to check or size.
+ */
+static int
+nvp_buf_dup(nvlist_t *nvl, nvpair_t *onvp, nvpair_t **nvpp)
+{
+	nvpair_t *nvp;
+	uint_t i;
+	int err;
+
+	if ((nvp = nvp_buf_alloc(nvl, onvp->nvp_size)) == NULL)
+		return (ENOMEM);
+
+	bcopy(onvp, nvp, onvp->nvp_size);
+
+	switch (NVP_TYPE(nvp)) {
+	case DATA_TYPE_STRING_ARRAY: {
+		char **cstrs = (void *)NVP_VALUE(nvp);
+		char *buf = NVP_VALUE(nvp) + NVP_NELEM(nvp) * sizeof (uint64_t);
+
+		for (i = 0; i < NVP_NELEM(nvp); i++) {
+			cstrs[i] = buf;
+			buf += strlen(buf) + 1;
+		}
+		break;
+	}
+	case DATA_TYPE_NVLIST:
+		if ((err = nvlist_copy_embedded(nvl, EMBEDDED_NVL(onvp),
+		    EMBEDDED_NVL(nvp))) != 0) {
+			nvp_buf_free(nvl, nvp);
+			return (err);
+		}
+		break;
+	case DATA_TYPE_NVLIST_ARRAY: {
+		nvlist_t **onvlp = EMBEDDED_NVL_ARRAY(onvp);
+		nvlist_t **nvlp = EMBEDDED_NVL_ARRAY(nvp);
+		nvlist_t *embedded = (nvlist_t *)
+		    ((uintptr_t)nvlp + NVP_NELEM(nvp) * sizeof (uint64_t));
+
+		/* so that nvpair_free() only sees the lists we copied */
+		bzero(nvlp, NVP_NELEM(nvp) * sizeof (uint64_t));
+
+		for (i = 0; i < NVP_NELEM(nvp); i++) {
+			if ((err = nvlist_copy_embedded(nvl,
+			    onvlp[i], embedded)) != 0) {
+				nvpair_free(nvp);
+				nvp_buf_free(nvl, nvp);
+				return (err);
+			}
+
+			nvlp[i] = embedded++;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	*nvpp = nvp;
+	return (0);
+}
+
+/*
+ * Copy the pairs of snvl into the empty list dnvl, which has the same
+ * nvflag.  The pairs of snvl already satisfy that nvflag, so there is no
+ * need for the remove-before-add that nvlist_add_common() does.
+ */
 static int
 nvlist_copy_pairs(nvlist_t *snvl, nvlist_t *dnvl)
 {
@@ -517,13 +733,17 @@ nvlist_copy_pairs(nvlist_t *snvl, nvlist_t *dnvl)
 	if ((priv = (nvpriv_t *)(uintptr_t)snvl->nvl_priv) == NULL)
 		return (EINVAL);
 
+	ASSERT(nvlist_empty(dnvl));
+	ASSERT(dnvl->nvl_nvflag == snvl->nvl_nvflag);
+
 	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
-		nvpair_t *nvp = &curr->nvi_nvp;
+		nvpair_t *nvp;
 		int err;
 
-		if ((err = nvlist_add_common(dnvl, NVP_NAME(nvp), NVP_TYPE(nvp),
-		    NVP_NELEM(nvp), NVP_VALUE(nvp))) != 0)
+		if ((err = nvp_buf_dup(dnvl, &curr->nvi_nvp, &nvp)) != 0)
 			return (err);
+
+		nvp_buf_link(dnvl, nvp);
 	}
 
 	return (0);
@@ -577,6 +797,7 @@ nvlist_free(nvlist_t *nvl)
 		nvpair_free(nvp);
 		nvp_buf_free(nvl, nvp);
 	}
+	nvt_free(priv);
 
 	if (!(priv->nvp_stat & NV_STAT_EMBEDDED))
 		nv_mem_free(priv, nvl, NV_ALIGN(sizeof (nvlist_t)));
@@ -651,6 +872,22 @@ nvlist_remove_all(nvlist_t *nvl, const char *name)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
+	if (priv->nvp_hashtable != NULL) {
+		size_t len = strlen(name);
+
+		while ((curr = nvt_lookup(priv, name, len,
+		    DATA_TYPE_UNKNOWN)) != NULL) {
+			nvpair_t *nvp = &curr->nvi_nvp;
+
+			nvp_buf_unlink(nvl, nvp);
+			nvpair_free(nvp);
+			nvp_buf_free(nvl, nvp);
+
+			error = 0;
+		}
+		return (error);
+	}
+
 	curr = priv->nvp_list;
 	while (curr != NULL) {
 		nvpair_t *nvp = &curr->nvi_nvp;
@@ -682,18 +919,15 @@ nvlist_remove(nvlist_t *nvl, const char *name, data_type_t type)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
-	curr = priv->nvp_list;
-	while (curr != NULL) {
+	if (type != DATA_TYPE_UNKNOWN &&
+	    (curr = nvt_lookup(priv, name, strlen(name), type)) != NULL) {
 		nvpair_t *nvp = &curr->nvi_nvp;
 
-		if (strcmp(name, NVP_NAME(nvp)) == 0 && NVP_TYPE(nvp) == type) {
-			nvp_buf_unlink(nvl, nvp);
-			nvpair_free(nvp);
-			nvp_buf_free(nvl, nvp);
+		nvp_buf_unlink(nvl, nvp);
+		nvpair_free(nvp);
+		nvp_buf_free(nvl, nvp);
 
-			return (0);
-		}
-		curr = curr->nvi_next;
+		return (0);
 	}
 
 	return (ENOENT);
@@ -1332,7 +1566,6 @@ nvlist_lookup_common(nvlist_t *nvl, const char *name, data_type_t type,
     uint_t *nelem, void *data)
 {
 	nvpriv_t *priv;
-	nvpair_t *nvp;
 	i_nvp_t *curr;
 
 	if (name == NULL || nvl == NULL ||
@@ -1342,14 +1575,11 @@ nvlist_lookup_common(nvlist_t *nvl, const char *name, data_type_t type,
 	if (!(nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)))
 		return (ENOTSUP);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
-		nvp = &curr->nvi_nvp;
+	if (type == DATA_TYPE_UNKNOWN ||
+	    (curr = nvt_lookup(priv, name, strlen(name), type)) == NULL)
+		return (ENOENT);
 
-		if (strcmp(name, NVP_NAME(nvp)) == 0 && NVP_TYPE(nvp) == type)
-			return (nvpair_value_common(nvp, type, nelem, data));
-	}
-
-	return (ENOENT);
+	return (nvpair_value_common(&curr->nvi_nvp, type, nelem, data));
 }
 
 int
@@ -1616,6 +1846,8 @@ static int
 nvlist_lookup_nvpair_ei_sep(nvlist_t *nvl, const char *name, const char sep,
     nvpair_t **ret, int *ip, char **ep)
 {
+	nvpriv_t	*priv;
+	i_nvp_t		*curr;
 	nvpair_t	*nvp;
 	const char	*np;
 	char		*sepp;
@@ -1721,52 +1953,44 @@ nvlist_lookup_nvpair_ei_sep(nvlist_t *nvl, const char *name, const char sep,
 		 *
 		 * Search for nvpair with matching component name.
 		 */
-		for (nvp = nvlist_next_nvpair(nvl, NULL); nvp != NULL;
-		    nvp = nvlist_next_nvpair(nvl, nvp)) {
-
-			/* continue if no match on name */
-			if (strncmp(np, nvpair_name(nvp), n) ||
-			    (strlen(nvpair_name(nvp)) != n))
-				continue;
-
-			/* if indexed, verify type is array oriented */
-			if (idxp && !nvpair_type_is_array(nvp))
-				goto fail;
+		if ((priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL ||
+		    (curr = nvt_lookup(priv, np, n, DATA_TYPE_UNKNOWN)) == NULL)
+			goto fail;		/* 'name' not found */
+		nvp = &curr->nvi_nvp;
 
-			/*
-			 * Full match found, return nvp and idx if this
-			 * was the last component.
-			 */
-			if (sepp == NULL) {
-				if (ret)
-					*ret = nvp;
-				if (ip && idxp)
-					*ip = (int)idx;	/* return index */
-				return (0);		/* found */
-			}
+		/* if indexed, verify type is array oriented */
+		if (idxp && !nvpair_type_is_array(nvp))
+			goto fail;
 
-			/*
-			 * More components: current match must be
-			 * of DATA_TYPE_NVLIST or DATA_TYPE_NVLIST_ARRAY
-			 * to support going deeper.
-			 */
-			if (nvpair_type(nvp) == DATA_TYPE_NVLIST) {
-				nvl = EMBEDDED_NVL(nvp);
-				break;
-			} else if (nvpair_type(nvp) == DATA_TYPE_NVLIST_ARRAY) {
-				(void) nvpair_value_nvlist_array(nvp,
-				    &nva, (uint_t *)&n);
-				if ((n < 0) || (idx >= n))
-					goto fail;
-				nvl = nva[idx];
-				break;
-			}
+		/*
+		 * Full match found, return nvp and idx if this
+		 * was the last component.
+		 */
+		if (sepp == NULL) {
+			if (ret)
+				*ret = nvp;
+			if (ip && idxp)
+				*ip = (int)idx;	/* return index */
+			return (0);		/* found */
+		}
 
+		/*
+		 * More components: current match must be
+		 * of DATA_TYPE_NVLIST or DATA_TYPE_NVLIST_ARRAY
+		 * to support going deeper.
+		 */
+		if (nvpair_type(nvp) == DATA_TYPE_NVLIST) {
+			nvl = EMBEDDED_NVL(nvp);
+		} else if (nvpair_type(nvp) == DATA_TYPE_NVLIST_ARRAY) {
+			(void) nvpair_value_nvlist_array(nvp,
+			    &nva, (uint_t *)&n);
+			if ((n < 0) || (idx >= n))
+				goto fail;
+			nvl = nva[idx];
+		} else {
 			/* type does not support more levels */
 			goto fail;
 		}
-		if (nvp == NULL)
-			goto fail;		/* 'name' not found */
 
 		/* search for match of next component in embedded 'nvl' list */
 	}
@@ -1800,21 +2024,13 @@ boolean_t
 nvlist_exists(nvlist_t *nvl, const char *name)
 {
 	nvpriv_t *priv;
-	nvpair_t *nvp;
-	i_nvp_t *curr;
 
 	if (name == NULL || nvl == NULL ||
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (B_FALSE);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
-		nvp = &curr->nvi_nvp;
-
-		if (strcmp(name, NVP_NAME(nvp)) == 0)
-			return (B_TRUE);
-	}
-
-	return (B_FALSE);
+	return (nvt_lookup(priv, name, strlen(name), DATA_TYPE_UNKNOWN) !=
+	    NULL);
 }
 
 int
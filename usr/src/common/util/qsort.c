@@ -39,8 +39,13 @@
 
 #include "qsort.h"
 
+typedef void (*swapf_t)(char *, char *, size_t);
+typedef int (*cmpf_t)(const void *, const void *);
+
 static void swapp32(uint32_t *r1, uint32_t *r2, size_t cnt);
 static void swapp64(uint64_t *r1, uint64_t *r2, size_t cnt);
+static void swapp128(uint64_t *r1, uint64_t *r2, size_t cnt);
+static void swapl(uint64_t *r1, uint64_t *r2, size_t cnt);
 static void swapi(uint32_t *r1, uint32_t *r2, size_t cnt);
 static void swapb(char *r1, char *r2, size_t cnt);
 
@@ -54,21 +59,113 @@ static void swapb(char *r1, char *r2, size_t cnt);
 	? ((cmp((b), (c)) < 0) ? (b) : (cmp((a), (c)) < 0) ? (c) : (a)) \
 	: ((cmp((b), (c)) > 0) ? (b) : (cmp((a), (c)) > 0) ? (c) : (a))
 
-#define	THRESH_L	5	/* threshold for insertion sort */
+#define	THRESH_L	8	/* threshold for insertion sort */
 #define	THRESH_M3	20	/* threshold for median of 3 */
 #define	THRESH_M9	50	/* threshold for median of 9 */
+#define	THRESH_PART	8	/* moves allowed in a partial insertion sort */
 
 typedef struct {
 	char	*b_lim;
 	size_t	nrec;
+	int	depth;		/* bad partitions left before heapsort */
 } stk_t;
 
+/*
+ * Heapsort the nrec records at base; used for partitions on which quicksort
+ * has been going badly, to bound the time taken to O(n log n).
+ */
+static void
+sift(char *base, size_t root, size_t nrec, size_t rsiz, cmpf_t cmp,
+    swapf_t swapf, size_t loops)
+{
+	size_t	child;
+
+	while ((child = 2 * root + 1) < nrec) {
+		if (child + 1 < nrec &&
+		    cmp(base + child * rsiz, base + (child + 1) * rsiz) < 0)
+			child++;
+		if (cmp(base + root * rsiz, base + child * rsiz) >= 0)
+			return;
+		(*swapf)(base + root * rsiz, base + child * rsiz, loops);
+		root = child;
+	}
+}
+
+static void
+heapsort(char *base, size_t nrec, size_t rsiz, cmpf_t cmp, swapf_t swapf,
+    size_t loops)
+{
+	size_t	i;
+
+	for (i = nrec / 2; i-- > 0; )
+		sift(base, i, nrec, rsiz, cmp, swapf, loops);
+	for (i = nrec; --i > 0; ) {
+		(*swapf)(base, base + i * rsiz, loops);
+		sift(base, 0, i, rsiz, cmp, swapf, loops);
+	}
+}
+
+/*
+ * Insertion sort the nrec records at b_lim, unless that takes more than
+ * THRESH_PART moves.  Returns 1 if the records are now sorted, or 0 if it
+ * gave up, in which case they are still a permutation of what they were.
+ */
+static int
+partial_insertion(char *b_lim, size_t nrec, size_t rsiz, cmpf_t cmp,
+    swapf_t swapf, size_t loops)
+{
+	char	*b_par, *t_par;
+	size_t	i, moves = 0;
+
+	t_par = b_lim;
+	for (i = 1; i < nrec; i++) {
+		t_par += rsiz;
+		for (b_par = t_par; b_par > b_lim; b_par -= rsiz) {
+			if ((*cmp)(b_par - rsiz, b_par) <= 0)
+				break;
+			(*swapf)(b_par - rsiz, b_par, loops);
+			moves++;
+		}
+		if (moves > THRESH_PART)
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * Move a few records of a partition around, so that an input which has just
+ * produced a badly unbalanced partition is unlikely to do it again.
+ */
+static void
+break_patterns(char *b_lim, size_t nrec, size_t rsiz, swapf_t swapf,
+    size_t loops)
+{
+	char	*t_lim = b_lim + (nrec - 1) * rsiz;
+	size_t	q = (nrec / 4) * rsiz;
+
+	if (nrec < THRESH_M9)
+		return;
+
+	(*swapf)(b_lim, b_lim + q, loops);
+	(*swapf)(t_lim, t_lim - q, loops);
+	(*swapf)(b_lim + (nrec / 2) * rsiz, b_lim + (nrec / 8) * rsiz, loops);
+}
+
 /*
  * qsort() is a general purpose, in-place sorting routine using a
  * user provided call back function for comparisons.  This implementation
  * utilizes a ternary quicksort algorithm, and cuts over to an
  * insertion sort for partitions involving fewer than THRESH_L records.
  *
+ * Two things keep inputs with a pattern from defeating the quicksort.
+ * Each partition is allowed about 2 log2(nrec) badly unbalanced splits (one
+ * side under an eighth of the records); after each of them a few records
+ * are moved to break up the pattern, and once they are used up, the
+ * partition is heapsorted instead, so the sort is always O(n log n).  And
+ * when a split needed no exchanges at all, the input is probably already
+ * sorted, so each side is insertion sorted as long as that needs only a
+ * few moves, which sorts ordered input in linear time.
+ *
  * Potential User Errors
  *   There is no return value from qsort, this function has no method
  *   of alerting the user that a sort did not work or could not work.
@@ -114,7 +211,7 @@ qsort(
 	size_t		i;		/* temporary variable */
 
 	/* variables used by swap */
-	void		(*swapf)(char *, char *, size_t);
+	swapf_t		swapf;
 	size_t		loops;
 
 	/* variables used by sort */
@@ -128,9 +225,11 @@ qsort(
 	char		*t_par;		/* top partition */
 	char		*m1, *m2, *m3;	/* median pointers */
 	uintptr_t	d_bytelength;	/* byte length of duplicate records */
-	int		b_nrec;
-	int		t_nrec;
+	size_t		b_nrec;
+	size_t		t_nrec;
 	int		cv;		/* results of compare (bottom / top) */
+	int		depth;		/* bad partitions allowed */
+	int		swapped;	/* partitioning exchanged records */
 
 	/*
 	 * choose a swap function based on alignment and size
@@ -143,26 +242,36 @@ qsort(
 	 *
 	 * The following decision will choose an optimal swap function
 	 * based on the size and alignment of the data records
+	 *   swapp128	will swap pairs of 64 bit words
 	 *   swapp64	will swap 64 bit pointers
 	 *   swapp32	will swap 32 bit pointers
+	 *   swapl	will swap an array of 64 bit integers
 	 *   swapi	will swap an array of 32 bit integers
 	 *   swapb	will swap an array of 8 bit characters
 	 *
-	 * swapi and swapb will also require the variable loops to be set
-	 * to control the length of the array being swapped
+	 * swapl, swapi and swapb will also require the variable loops to be
+	 * set to control the length of the array being swapped
 	 */
 	if ((((uintptr_t)basep & (sizeof (uint64_t) - 1)) == 0) &&
+	    (rsiz == 2 * sizeof (uint64_t))) {
+		loops = 1;
+		swapf = (swapf_t)swapp128;
+	} else if ((((uintptr_t)basep & (sizeof (uint64_t) - 1)) == 0) &&
 	    (rsiz == sizeof (uint64_t))) {
 		loops = 1;
-		swapf = (void (*)(char *, char *, size_t))swapp64;
+		swapf = (swapf_t)swapp64;
 	} else if ((((uintptr_t)basep & (sizeof (uint32_t) - 1)) == 0) &&
 	    (rsiz == sizeof (uint32_t))) {
 		loops = 1;
-		swapf = (void (*)(char *, char *, size_t))swapp32;
+		swapf = (swapf_t)swapp32;
+	} else if ((((uintptr_t)basep & (sizeof (uint64_t) - 1)) == 0) &&
+	    ((rsiz & (sizeof (uint64_t) - 1)) == 0)) {
+		loops = rsiz / sizeof (uint64_t);
+		swapf = (swapf_t)swapl;
 	} else if ((((uintptr_t)basep & (sizeof (uint32_t) - 1)) == 0) &&
 	    ((rsiz & (sizeof (uint32_t) - 1)) == 0)) {
 		loops = rsiz / sizeof (int);
-		swapf = (void (*)(char *, char *, size_t))swapi;
+		swapf = (swapf_t)swapi;
 	} else {
 		loops = rsiz;
 		swapf = swapb;
@@ -184,11 +293,14 @@ qsort(
 	sp = stack;
 	sp->b_lim = (char *)basep;
 	sp->nrec = nrec;
+	for (sp->depth = 0; nrec > 1; nrec >>= 1)
+		sp->depth += 2;
 	sp++;
 	while (sp > stack) {
 		sp--;
 		b_lim = sp->b_lim;
 		nrec = sp->nrec;
+		depth = sp->depth;
 
 		/*
 		 * a linear insertion sort i faster than a qsort for
@@ -228,6 +340,15 @@ qsort(
 			continue;
 		}
 
+		/*
+		 * if this partition has had too many bad splits, the input
+		 * is defeating our choice of pivot; heapsort it instead.
+		 */
+		if (depth == 0) {
+			heapsort(b_lim, nrec, rsiz, cmp, swapf, loops);
+			continue;
+		}
+
 		/* quicksort */
 
 		/*
@@ -316,6 +437,7 @@ qsort(
 		 */
 		b_dup = b_par		= b_lim;
 		t_dup = t_par = t_lim	= b_lim + rsiz * (nrec - 1);
+		swapped = 0;
 		for (;;) {
 
 			/* move bottom pointer up */
@@ -332,6 +454,7 @@ qsort(
 						m2 = b_par;
 					} else if (b_dup != b_par) {
 						(*swapf)(b_dup, b_par, loops);
+						swapped = 1;
 					}
 					b_dup += rsiz;
 				}
@@ -351,6 +474,7 @@ qsort(
 						m2 = t_par;
 					} else if (t_dup != t_par) {
 						(*swapf)(t_dup, t_par, loops);
+						swapped = 1;
 					}
 					t_dup -= rsiz;
 				}
@@ -363,6 +487,7 @@ qsort(
 
 			/* exchange records at upper and lower break points */
 			(*swapf)(b_par, t_par, loops);
+			swapped = 1;
 			b_par += rsiz;
 			t_par -= rsiz;
 		}
@@ -449,19 +574,45 @@ qsort(
 		 */
 		b_nrec = (b_par - b_lim) / rsiz;
 		t_nrec = (t_lim - t_par) / rsiz;
+
+		/*
+		 * a split which leaves less than an eighth of the records
+		 * on one side is a bad one; count it, and shuffle both sides
+		 * a little so that they do not split the same way again.
+		 * a split which needed no exchanges suggests that the input
+		 * is already sorted; see whether both sides are, or nearly.
+		 */
+		if (b_nrec < nrec / 8 || t_nrec < nrec / 8) {
+			depth--;
+			break_patterns(b_lim, b_nrec, rsiz, swapf, loops);
+			break_patterns(t_par + rsiz, t_nrec, rsiz, swapf,
+			    loops);
+		} else if (!swapped) {
+			if (partial_insertion(b_lim, b_nrec, rsiz, cmp,
+			    swapf, loops))
+				b_nrec = 0;
+			if (partial_insertion(t_par + rsiz, t_nrec, rsiz, cmp,
+			    swapf, loops))
+				t_nrec = 0;
+		}
+
 		if (b_nrec < t_nrec) {
 			sp->b_lim = t_par + rsiz;
 			sp->nrec = t_nrec;
+			sp->depth = depth;
 			sp++;
 			sp->b_lim = b_lim;
 			sp->nrec = b_nrec;
+			sp->depth = depth;
 			sp++;
 		} else {
 			sp->b_lim = b_lim;
 			sp->nrec = b_nrec;
+			sp->depth = depth;
 			sp++;
 			sp->b_lim = t_par + rsiz;
 			sp->nrec = t_nrec;
+			sp->depth = depth;
 			sp++;
 		}
 	}
@@ -497,6 +648,33 @@ swapp64(uint64_t *r1, uint64_t *r2, size_t cnt)
 	*r2++ = temp;
 }
 
+/* ARGSUSED */
+static void
+swapp128(uint64_t *r1, uint64_t *r2, size_t cnt)
+{
+	uint64_t temp0, temp1;
+
+	temp0 = r1[0];
+	temp1 = r1[1];
+	r1[0] = r2[0];
+	r1[1] = r2[1];
+	r2[0] = temp0;
+	r2[1] = temp1;
+}
+
+static void
+swapl(uint64_t *r1, uint64_t *r2, size_t cnt)
+{
+	uint64_t temp;
+
+	/* word by word */
+	while (cnt--) {
+		temp = *r1;
+		*r1++ = *r2;
+		*r2++ = temp;
+	}
+}
+
 static void
 swapi(uint32_t *r1, uint32_t *r2, size_t cnt)
 {
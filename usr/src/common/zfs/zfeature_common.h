@@ -56,6 +56,10 @@ typedef enum spa_feature {
 	SPA_FEATURE_SHA512,
 	SPA_FEATURE_SKEIN,
 	SPA_FEATURE_EDONR,
+	SPA_FEATURE_ALLOCATION_CLASSES,
+	SPA_FEATURE_DDT_LOG,
+	SPA_FEATURE_LOG_SPACEMAP,
+	SPA_FEATURE_LARGE_DNODE,
 	SPA_FEATURES
 } spa_feature_t;
 
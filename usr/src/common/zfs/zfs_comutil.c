@@ -48,6 +48,7 @@ boolean_t
 zfs_allocatable_devs(nvlist_t *nv)
 {
 	uint64_t is_log;
+	char *bias;
 	uint_t c;
 	nvlist_t **child;
 	uint_t children;
@@ -60,7 +61,8 @@ zfs_allocatable_devs(nvlist_t *nv)
 		is_log = 0;
 		(void) nvlist_lookup_uint64(child[c], ZPOOL_CONFIG_IS_LOG,
 		    &is_log);
-		if (!is_log)
+		if (!is_log && nvlist_lookup_string(child[c],
+		    ZPOOL_CONFIG_ALLOCATION_BIAS, &bias) != 0)
 			return (B_TRUE);
 	}
 	return (B_FALSE);
@@ -126,6 +126,42 @@
  *
  * For both cached and uncached data, both fletcher checksums are much faster
  * than sha-256, and slower than 'off', which doesn't touch the data at all.
+ *
+ * -------------------------
+ * Fletcher-4 Implementations
+ * -------------------------
+ *
+ * The straightforward fletcher-4 loop is one long dependency chain: each
+ * accumulator needs the value just computed for the one before it, so the
+ * CPU can retire little more than one input word per few cycles no matter
+ * how wide it is.  The "superscalar4" implementation instead runs four
+ * independent sets of accumulators, each over every fourth word of the
+ * input, and combines them at the end.  If lane j (0 <= j < 4) has seen
+ * N words and holds (a_j, b_j, c_j, d_j), the checksum of all 4N words is
+ *
+ *	a = a_0 + a_1 + a_2 + a_3
+ *	b = 4 * (b_0 + b_1 + b_2 + b_3) - (0*a_0 + 1*a_1 + 2*a_2 + 3*a_3)
+ *	c = 16 * (c_0 + c_1 + c_2 + c_3)
+ *	    - (6*b_0 + 10*b_1 + 14*b_2 + 18*b_3) + (0*a_0 + 0*a_1 + a_2 + 3*a_3)
+ *	d = 64 * (d_0 + d_1 + d_2 + d_3)
+ *	    - (48*c_0 + 64*c_1 + 80*c_2 + 96*c_3)
+ *	    + (4*b_0 + 10*b_1 + 20*b_2 + 34*b_3) - a_3
+ *
+ * all mod 2^64, which follows from the series above.  Any trailing words
+ * that do not fill a set of four are then added with the plain recurrence.
+ *
+ * In the kernel on amd64 there is also an "sse2" implementation, which
+ * keeps the same four lanes in %xmm registers and adds a 16-byte block to
+ * all of them at once (see uts/intel/zfs/fletcher_4_sse2.s).  Like the
+ * kernel's other SIMD code it runs with preemption disabled and saves the
+ * %xmm registers it uses; 256-bit %ymm state is not saved, so there is no
+ * AVX2 version.
+ *
+ * fletcher_4_init() times each implementation on a small buffer and uses
+ * the fastest one for fletcher_4_native() and fletcher_4_byteswap().  The
+ * results are published in the zfs:0:fletcher_4_bench kstat.  The
+ * zfs_fletcher_4_impl tunable may be set to the index of an implementation
+ * in fletcher_4_impls[] to bypass the selection.
  */
 
 #include <sys/types.h>
@@ -133,6 +169,18 @@
 #include <sys/byteorder.h>
 #include <sys/zio.h>
 #include <sys/spa.h>
+#ifdef _KERNEL
+#include <sys/systm.h>
+#include <sys/kmem.h>
+#include <sys/kstat.h>
+#ifdef __amd64
+#include <sys/disp.h>		/* kpreempt_disable(), kpreempt_enable() */
+#endif
+#else
+#include <stdlib.h>
+#include <sys/time.h>
+#endif
+#include <zfs_fletcher.h>
 
 /*ARGSUSED*/
 void
@@ -172,10 +220,8 @@ fletcher_2_byteswap(const void *buf, uint64_t size,
 	ZIO_SET_CHECKSUM(zcp, a0, a1, b0, b1);
 }
 
-/*ARGSUSED*/
-void
-fletcher_4_native(const void *buf, uint64_t size,
-    const void *ctx_template, zio_cksum_t *zcp)
+static void
+fletcher_4_scalar_native(const void *buf, uint64_t size, zio_cksum_t *zcp)
 {
 	const uint32_t *ip = buf;
 	const uint32_t *ipend = ip + (size / sizeof (uint32_t));
@@ -191,10 +237,8 @@ fletcher_4_native(const void *buf, uint64_t size,
 	ZIO_SET_CHECKSUM(zcp, a, b, c, d);
 }
 
-/*ARGSUSED*/
-void
-fletcher_4_byteswap(const void *buf, uint64_t size,
-    const void *ctx_template, zio_cksum_t *zcp)
+static void
+fletcher_4_scalar_byteswap(const void *buf, uint64_t size, zio_cksum_t *zcp)
 {
 	const uint32_t *ip = buf;
 	const uint32_t *ipend = ip + (size / sizeof (uint32_t));
@@ -210,6 +254,192 @@ fletcher_4_byteswap(const void *buf, uint64_t size,
 	ZIO_SET_CHECKSUM(zcp, a, b, c, d);
 }
 
+/*
+ * Combine the four lanes of the superscalar4 implementation; see the
+ * derivation at the top of this file.
+ */
+static void
+fletcher_4_superscalar4_fini(const uint64_t *a, const uint64_t *b,
+    const uint64_t *c, const uint64_t *d, zio_cksum_t *zcp)
+{
+	uint64_t A, B, C, D;
+
+	A = a[0] + a[1] + a[2] + a[3];
+	B = 4 * (b[0] + b[1] + b[2] + b[3]) -
+	    (a[1] + 2 * a[2] + 3 * a[3]);
+	C = 16 * (c[0] + c[1] + c[2] + c[3]) -
+	    (6 * b[0] + 10 * b[1] + 14 * b[2] + 18 * b[3]) +
+	    (a[2] + 3 * a[3]);
+	D = 64 * (d[0] + d[1] + d[2] + d[3]) -
+	    (48 * c[0] + 64 * c[1] + 80 * c[2] + 96 * c[3]) +
+	    (4 * b[0] + 10 * b[1] + 20 * b[2] + 34 * b[3]) - a[3];
+
+	ZIO_SET_CHECKSUM(zcp, A, B, C, D);
+}
+
+static void
+fletcher_4_superscalar4_native(const void *buf, uint64_t size,
+    zio_cksum_t *zcp)
+{
+	const uint32_t *ip = buf;
+	const uint32_t *ipend = ip + (size / sizeof (uint32_t));
+	const uint32_t *ipend4 = ip + P2ALIGN(size / sizeof (uint32_t), 4);
+	uint64_t a[4], b[4], c[4], d[4];
+
+	a[0] = a[1] = a[2] = a[3] = 0;
+	b[0] = b[1] = b[2] = b[3] = 0;
+	c[0] = c[1] = c[2] = c[3] = 0;
+	d[0] = d[1] = d[2] = d[3] = 0;
+
+	for (; ip < ipend4; ip += 4) {
+		a[0] += ip[0];
+		a[1] += ip[1];
+		a[2] += ip[2];
+		a[3] += ip[3];
+		b[0] += a[0];
+		b[1] += a[1];
+		b[2] += a[2];
+		b[3] += a[3];
+		c[0] += b[0];
+		c[1] += b[1];
+		c[2] += b[2];
+		c[3] += b[3];
+		d[0] += c[0];
+		d[1] += c[1];
+		d[2] += c[2];
+		d[3] += c[3];
+	}
+
+	fletcher_4_superscalar4_fini(a, b, c, d, zcp);
+	if (ip < ipend)
+		fletcher_4_incremental_native(ip, (ipend - ip) *
+		    sizeof (uint32_t), zcp);
+}
+
+static void
+fletcher_4_superscalar4_byteswap(const void *buf, uint64_t size,
+    zio_cksum_t *zcp)
+{
+	const uint32_t *ip = buf;
+	const uint32_t *ipend = ip + (size / sizeof (uint32_t));
+	const uint32_t *ipend4 = ip + P2ALIGN(size / sizeof (uint32_t), 4);
+	uint64_t a[4], b[4], c[4], d[4];
+
+	a[0] = a[1] = a[2] = a[3] = 0;
+	b[0] = b[1] = b[2] = b[3] = 0;
+	c[0] = c[1] = c[2] = c[3] = 0;
+	d[0] = d[1] = d[2] = d[3] = 0;
+
+	for (; ip < ipend4; ip += 4) {
+		a[0] += BSWAP_32(ip[0]);
+		a[1] += BSWAP_32(ip[1]);
+		a[2] += BSWAP_32(ip[2]);
+		a[3] += BSWAP_32(ip[3]);
+		b[0] += a[0];
+		b[1] += a[1];
+		b[2] += a[2];
+		b[3] += a[3];
+		c[0] += b[0];
+		c[1] += b[1];
+		c[2] += b[2];
+		c[3] += b[3];
+		d[0] += c[0];
+		d[1] += c[1];
+		d[2] += c[2];
+		d[3] += c[3];
+	}
+
+	fletcher_4_superscalar4_fini(a, b, c, d, zcp);
+	if (ip < ipend)
+		fletcher_4_incremental_byteswap(ip, (ipend - ip) *
+		    sizeof (uint32_t), zcp);
+}
+
+#if defined(_KERNEL) && defined(__amd64)
+extern void fletcher_4_sse2_native(uint64_t *, const void *, size_t);
+extern void fletcher_4_sse2_byteswap(uint64_t *, const void *, size_t);
+
+/*
+ * Run one of the SSE2 loops over the whole 16-byte blocks of the buffer,
+ * then combine the lanes and add the rest as superscalar4 does.
+ */
+static void
+fletcher_4_sse2(void (*blocks)(uint64_t *, const void *, size_t),
+    void (*tail)(const void *, uint64_t, zio_cksum_t *),
+    const void *buf, uint64_t size, zio_cksum_t *zcp)
+{
+	const uint32_t *ip = buf;
+	const uint32_t *ipend = ip + (size / sizeof (uint32_t));
+	uint64_t nblocks = size / (4 * sizeof (uint32_t));
+	uint64_t acc[16];
+
+	bzero(acc, sizeof (acc));
+	if (nblocks != 0) {
+		kpreempt_disable();
+		blocks(acc, ip, nblocks);
+		kpreempt_enable();
+	}
+
+	fletcher_4_superscalar4_fini(&acc[0], &acc[4], &acc[8], &acc[12], zcp);
+	ip += 4 * nblocks;
+	if (ip < ipend)
+		tail(ip, (ipend - ip) * sizeof (uint32_t), zcp);
+}
+
+static void
+fletcher_4_sse2_native_impl(const void *buf, uint64_t size, zio_cksum_t *zcp)
+{
+	fletcher_4_sse2(fletcher_4_sse2_native, fletcher_4_incremental_native,
+	    buf, size, zcp);
+}
+
+static void
+fletcher_4_sse2_byteswap_impl(const void *buf, uint64_t size,
+    zio_cksum_t *zcp)
+{
+	fletcher_4_sse2(fletcher_4_sse2_byteswap,
+	    fletcher_4_incremental_byteswap, buf, size, zcp);
+}
+#endif	/* _KERNEL && __amd64 */
+
+typedef struct fletcher_4_ops {
+	void (*fo_native)(const void *, uint64_t, zio_cksum_t *);
+	void (*fo_byteswap)(const void *, uint64_t, zio_cksum_t *);
+	const char *fo_name;
+} fletcher_4_ops_t;
+
+static const fletcher_4_ops_t fletcher_4_impls[] = {
+	{ fletcher_4_scalar_native, fletcher_4_scalar_byteswap, "scalar" },
+	{ fletcher_4_superscalar4_native, fletcher_4_superscalar4_byteswap,
+	    "superscalar4" },
+#if defined(_KERNEL) && defined(__amd64)
+	{ fletcher_4_sse2_native_impl, fletcher_4_sse2_byteswap_impl, "sse2" },
+#endif
+};
+
+#define	FLETCHER_4_NIMPLS	\
+	((int)(sizeof (fletcher_4_impls) / sizeof (fletcher_4_impls[0])))
+
+int zfs_fletcher_4_impl = -1;	/* -1: use the fastest implementation */
+
+static const fletcher_4_ops_t *fletcher_4_ops = &fletcher_4_impls[0];
+
+/*ARGSUSED*/
+void
+fletcher_4_native(const void *buf, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	fletcher_4_ops->fo_native(buf, size, zcp);
+}
+
+/*ARGSUSED*/
+void
+fletcher_4_byteswap(const void *buf, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	fletcher_4_ops->fo_byteswap(buf, size, zcp);
+}
+
 void
 fletcher_4_incremental_native(const void *buf, uint64_t size,
     zio_cksum_t *zcp)
@@ -255,3 +485,124 @@ fletcher_4_incremental_byteswap(const void *buf, uint64_t size,
 
 	ZIO_SET_CHECKSUM(zcp, a, b, c, d);
 }
+
+/*
+ * Implementation selection
+ */
+
+#define	FLETCHER_4_BENCH_SIZE	(32 * 1024)	/* bytes per iteration */
+#define	FLETCHER_4_BENCH_NS	(NANOSEC / 1000)	/* run each for 1ms */
+
+/* bandwidth of each implementation, in bytes per second */
+static uint64_t fletcher_4_bench_native[FLETCHER_4_NIMPLS];
+static uint64_t fletcher_4_bench_byteswap[FLETCHER_4_NIMPLS];
+
+#ifdef _KERNEL
+static kstat_t *fletcher_4_ksp;
+static kstat_named_t fletcher_4_kstat_data[1 + 2 * FLETCHER_4_NIMPLS];
+#endif
+
+static uint64_t
+fletcher_4_bench_run(void (*func)(const void *, uint64_t, zio_cksum_t *),
+    const void *buf)
+{
+	zio_cksum_t zc;
+	uint64_t run = 0;
+	hrtime_t start, elapsed;
+
+	start = gethrtime();
+	do {
+		func(buf, FLETCHER_4_BENCH_SIZE, &zc);
+		run++;
+		elapsed = gethrtime() - start;
+	} while (elapsed < FLETCHER_4_BENCH_NS);
+
+	return (run * FLETCHER_4_BENCH_SIZE * NANOSEC / elapsed);
+}
+
+static void
+fletcher_4_bench(void)
+{
+	uint32_t *buf;
+	int best = 0;
+
+#ifdef _KERNEL
+	buf = kmem_alloc(FLETCHER_4_BENCH_SIZE, KM_SLEEP);
+#else
+	if ((buf = malloc(FLETCHER_4_BENCH_SIZE)) == NULL)
+		return;
+#endif
+	for (int i = 0; i < FLETCHER_4_BENCH_SIZE / sizeof (uint32_t); i++)
+		buf[i] = (uint32_t)(i * 0x9e3779b9U);
+
+	for (int i = 0; i < FLETCHER_4_NIMPLS; i++) {
+		fletcher_4_bench_native[i] = fletcher_4_bench_run(
+		    fletcher_4_impls[i].fo_native, buf);
+		fletcher_4_bench_byteswap[i] = fletcher_4_bench_run(
+		    fletcher_4_impls[i].fo_byteswap, buf);
+		if (fletcher_4_bench_native[i] >
+		    fletcher_4_bench_native[best])
+			best = i;
+	}
+
+#ifdef _KERNEL
+	kmem_free(buf, FLETCHER_4_BENCH_SIZE);
+#else
+	free(buf);
+#endif
+	fletcher_4_ops = &fletcher_4_impls[best];
+}
+
+void
+fletcher_4_init(void)
+{
+	if (zfs_fletcher_4_impl >= 0 &&
+	    zfs_fletcher_4_impl < FLETCHER_4_NIMPLS) {
+		fletcher_4_ops = &fletcher_4_impls[zfs_fletcher_4_impl];
+	} else {
+		fletcher_4_bench();
+	}
+
+#ifdef _KERNEL
+	kstat_named_t *kn = fletcher_4_kstat_data;
+
+	kstat_named_init(kn, "selected", KSTAT_DATA_CHAR);
+	(void) strncpy(kn->value.c, fletcher_4_ops->fo_name,
+	    sizeof (kn->value.c));
+	kn++;
+	for (int i = 0; i < FLETCHER_4_NIMPLS; i++) {
+		char name[KSTAT_STRLEN];
+
+		(void) snprintf(name, sizeof (name), "%s_native",
+		    fletcher_4_impls[i].fo_name);
+		kstat_named_init(kn, name, KSTAT_DATA_UINT64);
+		kn->value.ui64 = fletcher_4_bench_native[i];
+		kn++;
+		(void) snprintf(name, sizeof (name), "%s_byteswap",
+		    fletcher_4_impls[i].fo_name);
+		kstat_named_init(kn, name, KSTAT_DATA_UINT64);
+		kn->value.ui64 = fletcher_4_bench_byteswap[i];
+		kn++;
+	}
+
+	fletcher_4_ksp = kstat_create("zfs", 0, "fletcher_4_bench", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (fletcher_4_kstat_data) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (fletcher_4_ksp != NULL) {
+		fletcher_4_ksp->ks_data = fletcher_4_kstat_data;
+		kstat_install(fletcher_4_ksp);
+	}
+#endif
+}
+
+void
+fletcher_4_fini(void)
+{
+#ifdef _KERNEL
+	if (fletcher_4_ksp != NULL) {
+		kstat_delete(fletcher_4_ksp);
+		fletcher_4_ksp = NULL;
+	}
+#endif
+	fletcher_4_ops = &fletcher_4_impls[0];
+}
@@ -46,6 +46,8 @@ void fletcher_4_native(const void *, uint64_t, const void *, zio_cksum_t *);
 void fletcher_4_byteswap(const void *, uint64_t, const void *, zio_cksum_t *);
 void fletcher_4_incremental_native(const void *, uint64_t, zio_cksum_t *);
 void fletcher_4_incremental_byteswap(const void *, uint64_t, zio_cksum_t *);
+void fletcher_4_init(void);
+void fletcher_4_fini(void);
 
 #ifdef	__cplusplus
 }
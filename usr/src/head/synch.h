@@ -135,6 +135,12 @@ int	sema_trywait(sema_t *);
 #define	COND_MAGIC	_COND_MAGIC
 #define	RWL_MAGIC	_RWL_MAGIC
 
+/*
+ * rwlock_init() flag, with USYNC_THREAD: spread the work of read locking
+ * over many cache lines, making writers pay for it instead.
+ */
+#define	RWL_SCALABLE	0x100
+
 /*
  * POSIX.1c Note:
  * DEFAULTMUTEX is defined same as PTHREAD_MUTEX_INITIALIZER in <pthread.h>.
@@ -53,6 +53,7 @@
 
 #include "SYS.h"
 #include "cache.h"
+#include "proc64_id.h"
 
 #define LABEL(s) .memcmp/**/s
 
@@ -122,6 +123,10 @@ LABEL(8skip):
         .p2align 4
 
 LABEL(8after):
+        cmp     $128, %rdx
+        jb      LABEL(32try)
+        testl   $USE_AVX2, .memops_method(%rip)
+        jnz     LABEL(avx2)
 
 LABEL(32try):
         cmp     $2048, %rdx
@@ -453,4 +458,49 @@ LABEL(128skip):
         xor     %eax, %eax
         ret
 
+        .p2align 4
+
+LABEL(avx2):                             /* 64-byte AVX2 */
+        mov     %rdx, %rcx
+        shr     $6, %rcx
+
+        .p2align 4
+
+LABEL(avx2loop):
+        vmovdqu   (%rsi), %ymm0
+        vmovdqu 32 (%rsi), %ymm1
+        vpcmpeqb   (%rdi), %ymm0, %ymm0
+        vpcmpeqb 32 (%rdi), %ymm1, %ymm1
+        vpand   %ymm1, %ymm0, %ymm2
+        vpmovmskb %ymm2, %eax
+        inc     %eax                     /* zero if all 64 bytes match */
+        jnz     LABEL(avx2diff)
+
+        lea     64 (%rsi), %rsi
+        lea     64 (%rdi), %rdi
+
+        dec     %rcx
+        jnz     LABEL(avx2loop)
+
+        vzeroupper
+        and     $63, %edx
+        jmp     LABEL(try1)
+
+LABEL(avx2diff):
+        vpmovmskb %ymm0, %eax
+        inc     %eax
+        jnz     LABEL(avx2diff0)         /* in the first 32 bytes */
+        vpmovmskb %ymm1, %eax
+        inc     %eax
+        lea     32 (%rsi), %rsi
+        lea     32 (%rdi), %rdi
+
+LABEL(avx2diff0):
+        vzeroupper
+        bsf     %eax, %ecx               /* first mismatching byte */
+        movzbl  (%rdi, %rcx), %eax
+        movzbl  (%rsi, %rcx), %edx
+        sub     %edx, %eax
+        ret
+
 	SET_SIZE(memcmp)
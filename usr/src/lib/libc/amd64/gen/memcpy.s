@@ -53,9 +53,8 @@
  *
  * Pseudo code:
  *
- * NOTE: On AMD NO_SSE is always set.  Performance on Opteron did not improve
- * using 16-byte stores.  Setting NO_SSE on AMD should be re-evaluated on
- * future AMD processors.
+ * NOTE: On AMD before family 17h NO_SSE is always set.  Performance on
+ * Opteron did not improve using 16-byte stores.
  *
  *
  * If (size <= 128 bytes) {
@@ -64,7 +63,17 @@
  * } else {
  *	Align destination to 16-byte boundary
  *
- *      if (NO_SSE) {
+ *	if (AVX2 or ERMS) {
+ *		If (size > half of the largest level cache) {
+ *			Use 32-byte non-temporal stores (128-bytes per loop)
+ *		} else if (ERMS && size >= 2K) {
+ *			Use rep movsb
+ *		} else {
+ *			Use 32-byte unaligned loads and stores (128 bytes/loop)
+ *		}
+ *		(falling back to SSE below for whatever is not supported)
+ *
+ *	} else if (NO_SSE) {
  *		If (size > half of the largest level cache) {
  *			Use 8-byte non-temporal stores (64-bytes/loop)
  *		} else {
@@ -95,7 +104,8 @@
  *
  * memmove overview:
  *	memmove is the same as memcpy except one case where copy needs to be
- *	done backwards. The copy backwards code is done in a similar manner.
+ *	done backwards. The copy backwards code is done in a similar manner,
+ *	with 32-byte loads and stores if AVX2 is available.
  */
 
 	ENTRY(memmove)
@@ -936,6 +946,10 @@ L(ck_use_sse2):
 	jnz    L(ShrtAlignNew)
 
 L(now_qw_aligned):
+	testl  $(USE_AVX2|USE_ERMS),.memops_method(%rip)
+	jnz    L(ck_use_avx2)
+
+L(ck_use_sse):
 	cmpl   $NO_SSE,.memops_method(%rip) 
 	je     L(Loop8byte_pre)
 
@@ -2363,6 +2377,90 @@ L(byte8_nt_top):
 	sfence
 	jmp    L(byte8_end)        
 
+	/*
+	 * AVX2 and/or ERMS are available.  Destination is 16-byte aligned.
+	 */
+	.balign 16
+L(ck_use_avx2):
+	mov    .largest_level_cache_size(%rip),%r9d
+	shr    %r9		# take half of it
+	cmp    %r9,%r8
+	jg     L(avx2_nt_pre)
+
+	/*
+	 * Fast strings beat the vector loop once the startup cost is paid.
+	 */
+	cmp    $0x800,%r8		# 2K
+	jl     L(avx2_pre)
+	testl  $USE_ERMS,.memops_method(%rip)
+	jz     L(avx2_pre)
+	mov    %rdx,%rsi		# %rsi = source
+	mov    %rcx,%rdi		# %rdi = destination
+	mov    %r8,%rcx			# %rcx = count
+	rep
+	  movsb
+	ret
+
+L(avx2_pre):
+	testl  $USE_AVX2,.memops_method(%rip)
+	jz     L(ck_use_sse)
+	cmp    $0x80,%r8
+	jl     L(fix_16b)
+
+	.balign 16
+L(avx2_loop):
+	vmovdqu (%rdx),%ymm0
+	vmovdqu 0x20(%rdx),%ymm1
+	vmovdqu 0x40(%rdx),%ymm2
+	vmovdqu 0x60(%rdx),%ymm3
+	lea    -0x80(%r8),%r8
+	lea    0x80(%rdx),%rdx
+	vmovdqu %ymm0,(%rcx)
+	vmovdqu %ymm1,0x20(%rcx)
+	vmovdqu %ymm2,0x40(%rcx)
+	vmovdqu %ymm3,0x60(%rcx)
+	lea    0x80(%rcx),%rcx
+	cmp    $0x80,%r8
+	jge    L(avx2_loop)
+	vzeroupper
+	jmp    L(fix_16b)
+
+	.balign 16
+L(avx2_nt_pre):
+	testl  $USE_AVX2,.memops_method(%rip)
+	jz     L(ck_use_sse)
+	# align dest to 32 bytes for the non-temporal stores
+	test   $0x10,%rcx
+	jz     1f
+	movdqu (%rdx),%xmm0
+	movdqa %xmm0,(%rcx)
+	lea    0x10(%rdx),%rdx
+	lea    0x10(%rcx),%rcx
+	lea    -0x10(%r8),%r8
+1:
+	cmp    $0x80,%r8
+	jl     L(fix_16b)
+
+	.balign 16
+L(avx2_nt_loop):
+	prefetchnta 0x200(%rdx)
+	vmovdqu (%rdx),%ymm0
+	vmovdqu 0x20(%rdx),%ymm1
+	vmovdqu 0x40(%rdx),%ymm2
+	vmovdqu 0x60(%rdx),%ymm3
+	lea    -0x80(%r8),%r8
+	lea    0x80(%rdx),%rdx
+	vmovntdq %ymm0,(%rcx)
+	vmovntdq %ymm1,0x20(%rcx)
+	vmovntdq %ymm2,0x40(%rcx)
+	vmovntdq %ymm3,0x60(%rcx)
+	lea    0x80(%rcx),%rcx
+	cmp    $0x80,%r8
+	jge    L(avx2_nt_loop)
+	sfence
+	vzeroupper
+	jmp    L(fix_16b)
+
 	SET_SIZE(memcpy) 
 
 	.balign 16
@@ -2433,7 +2531,7 @@ L(bk_ck_sse2_alignment):
 	je     L(bk_use_rep)
 	# check alignment of last byte
 	test   $0xf,%rcx
-	jz     L(bk_sse2_cpy)
+	jz     L(bk_ck_avx2)
 
 L(bk_sse2_align):
 	# only here if already aligned on at least a qword bndry
@@ -2442,7 +2540,10 @@ L(bk_sse2_align):
 	sub    $0x8,%r8
 	mov    (%rdx),%r9
 	mov    %r9,(%rcx)
-	#jmp   L(bk_sse2_cpy)
+
+L(bk_ck_avx2):
+	testl  $USE_AVX2,.memops_method(%rip)
+	jnz    L(bk_avx2_cpy)
 
 	.balign 16
 L(bk_sse2_cpy):
@@ -2477,6 +2578,28 @@ L(bk_sse2_cpy_end):
 	lea    (%r9,%r10,1),%r10
 	jmpq   *%r10
 
+	/*
+	 * All four loads are done before the stores so that an overlapping
+	 * source is read before it is overwritten.
+	 */
+	.balign 16
+L(bk_avx2_cpy):
+	sub    $0x80,%rcx		# 128
+	sub    $0x80,%rdx
+	vmovdqu 0x60(%rdx),%ymm3
+	vmovdqu 0x40(%rdx),%ymm2
+	vmovdqu 0x20(%rdx),%ymm1
+	vmovdqu (%rdx),%ymm0
+	sub    $0x80,%r8
+	vmovdqu %ymm3,0x60(%rcx)
+	vmovdqu %ymm2,0x40(%rcx)
+	vmovdqu %ymm1,0x20(%rcx)
+	vmovdqu %ymm0,(%rcx)
+	cmp    $0x80,%r8
+	jge    L(bk_avx2_cpy)
+	vzeroupper
+	jmp    L(bk_sse2_cpy_end)
+
 	.balign 16
 L(bk_use_rep):
 	xchg   %rcx,%r9
@@ -51,9 +51,8 @@
  *
  * Pseudo code:
  *
- * NOTE: On AMD NO_SSE is always set.  Performance on Opteron did not improve
- * using 16-byte stores.  Setting NO_SSE on AMD should be re-evaluated on
- * future AMD processors.
+ * NOTE: On AMD before family 17h NO_SSE is always set.  Performance on
+ * Opteron did not improve using 16-byte stores.
  *
  *
  * If (size <= 144 bytes) {
@@ -61,7 +60,16 @@
  * } else {
  *	Align destination to 16-byte boundary
  *
- *      if (NO_SSE) {
+ *	if ((AVX2 or ERMS) && size >= 2K) {
+ *		If (size > largest level cache && AVX2) {
+ *			Use 32-byte non-temporal stores (128-bytes/loop)
+ *		} else if (ERMS) {
+ *			Use rep stosb
+ *		} else {
+ *			Use 32-byte stores (128 bytes per loop)
+ *		}
+ *
+ *	} else if (NO_SSE) {
  *		If (size > largest level cache) {
  *			Use 8-byte non-temporal stores (64-bytes/loop)
  *		} else {
@@ -539,6 +547,12 @@ L(aligned_now):
 		/*
 		 * Check memops method
 		 */
+		testl  $(USE_AVX2|USE_ERMS),.memops_method(%rip)
+		jz     L(ck_use_sse)
+		cmp    $0x800,%r8		# 2K
+		jge    L(ck_use_avx2)
+
+L(ck_use_sse):
 		cmpl   $NO_SSE,.memops_method(%rip)
 		je     L(Loop8byte_pre)
 
@@ -864,6 +878,74 @@ L(sse2_nt_move):
 		lea    (%rcx,%r11,1),%r11
 		jmpq   *%r11
 
+		/*
+		 * AVX2 and/or ERMS, size >= 2K
+		 */
+		.balign 16
+L(ck_use_avx2):
+		mov    .largest_level_cache_size(%rip),%r9d
+		cmp    %r9,%r8
+		jle    L(ck_use_erms)
+		testl  $USE_AVX2,.memops_method(%rip)
+		jz     L(ck_use_sse)
+		jmp    L(avx2_nt_pre)
+
+L(ck_use_erms):
+		testl  $USE_ERMS,.memops_method(%rip)
+		jz     L(avx2_pre)
+		mov    %r8,%rcx			# size in bytes
+		xchg   %rax,%rdx
+		rep
+		  stosb
+		mov    %rdx,%rax
+		ret
+
+L(avx2_pre):
+		vmovq  %rdx,%xmm0
+		vpbroadcastq %xmm0,%ymm0	# fill RegYMM0 with the pattern
+
+		.balign 16
+L(avx2_loop):
+		lea    -0x80(%r8),%r8		# 128
+		vmovdqu %ymm0,(%rdi)
+		vmovdqu %ymm0,0x20(%rdi)
+		vmovdqu %ymm0,0x40(%rdi)
+		vmovdqu %ymm0,0x60(%rdi)
+		lea    0x80(%rdi),%rdi
+		cmp    $0x80,%r8
+		jge    L(avx2_loop)
+
+L(avx2_end):
+		vzeroupper			# keeps the pattern in xmm0
+		lea    L(SSExDx)(%rip),%r11
+		add    %r8,%rdi
+		movslq (%r11,%r8,4),%rcx
+		lea    (%rcx,%r11,1),%r11
+		jmpq   *%r11
+
+		.balign 16
+L(avx2_nt_pre):
+		vmovq  %rdx,%xmm0
+		vpbroadcastq %xmm0,%ymm0
+		test   $0x10,%rdi		# align to 32 bytes
+		jz     L(avx2_nt_move)
+		vmovdqa %xmm0,(%rdi)
+		lea    0x10(%rdi),%rdi
+		lea    -0x10(%r8),%r8
+
+		.balign 16
+L(avx2_nt_move):
+		lea    -0x80(%r8),%r8		# 128
+		vmovntdq %ymm0,(%rdi)
+		vmovntdq %ymm0,0x20(%rdi)
+		vmovntdq %ymm0,0x40(%rdi)
+		vmovntdq %ymm0,0x60(%rdi)
+		lea    0x80(%rdi),%rdi
+		cmp    $0x80,%r8
+		jge    L(avx2_nt_move)
+		sfence
+		jmp    L(avx2_end)
+
 		/*
 		 * Don't use SSE
 		 */
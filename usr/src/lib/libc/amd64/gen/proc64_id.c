@@ -161,6 +161,64 @@ get_amd_cache_info(void)
 		    largest_level_cache);
 }
 
+/*
+ * get_sse_level()
+ *	Translate the cpuid function 1 feature bits into memops flags.
+ */
+static int
+get_sse_level(struct cpuid_values *cpuid_info)
+{
+	int use_sse = NO_SSE;
+
+	if (cpuid_info->ecx & CPUID_INTC_ECX_SSE4_2) {
+		use_sse |= USE_SSE4_2;
+	}
+	if (cpuid_info->ecx & CPUID_INTC_ECX_SSE4_1) {
+		use_sse |= USE_SSE4_1;
+	}
+	if (cpuid_info->ecx & CPUID_INTC_ECX_SSSE3) {
+		use_sse |= USE_SSSE3;
+	}
+	if (cpuid_info->ecx & CPUID_INTC_ECX_SSE3) {
+		use_sse |= USE_SSE3;
+	}
+	if (cpuid_info->edx & CPUID_INTC_EDX_SSE2) {
+		use_sse |= USE_SSE2;
+	}
+	return (use_sse);
+}
+
+/*
+ * get_avx2_erms()
+ *	Check for AVX2 and enhanced rep movsb/stosb in cpuid function 7.
+ *	AVX2 is only usable if the OS saves the ymm state, which is told by
+ *	OSXSAVE and the SSE and AVX bits in XCR0.
+ */
+static int
+get_avx2_erms(uint_t maxeax, struct cpuid_values *cpuid1)
+{
+	int use = 0;
+	struct cpuid_values cpuid_info;
+	uint64_t xcr0;
+
+	if (maxeax < 7)
+		return (0);
+
+	__libc_get_cpuid(7, &cpuid_info, 0);
+	if (cpuid_info.ebx & CPUID_INTC_EBX_7_0_ERMS) {
+		use |= USE_ERMS;
+	}
+	if ((cpuid_info.ebx & CPUID_INTC_EBX_7_0_AVX2) &&
+	    (cpuid1->ecx & CPUID_INTC_ECX_OSXSAVE) &&
+	    (cpuid1->ecx & CPUID_INTC_ECX_AVX)) {
+		xcr0 = __libc_get_xcr0();
+		if ((xcr0 & (XFEATURE_SSE | XFEATURE_AVX)) ==
+		    (XFEATURE_SSE | XFEATURE_AVX))
+			use |= USE_AVX2;
+	}
+	return (use);
+}
+
 /*
  * proc64_id()
  *	Determine cache and SSE level to use for memops and strops specific to
@@ -171,8 +229,10 @@ __proc64id(void)
 {
 	int use_sse = NO_SSE;
 	struct cpuid_values cpuid_info;
+	uint_t maxeax, family;
 
 	__libc_get_cpuid(0, &cpuid_info, 0);
+	maxeax = cpuid_info.eax;
 
 	/*
 	 * Check for AuthenticAMD
@@ -181,6 +241,22 @@ __proc64id(void)
 	    (cpuid_info.edx == 0x69746e65) && /* enti */
 	    (cpuid_info.ecx == 0x444d4163)) { /* cAMD */
 		get_amd_cache_info();
+
+		/*
+		 * The SSE paths were tuned on Intel parts and the defaults
+		 * are kept for older AMD processors.  From family 17h (Zen)
+		 * on the SSE, AVX2 and rep movsb paths are faster, so use
+		 * them there as well.
+		 */
+		__libc_get_cpuid(1, &cpuid_info, 0);
+		family = (cpuid_info.eax >> 8) & 0xf;
+		if (family == 0xf)
+			family += (cpuid_info.eax >> 20) & 0xff;
+		if (family >= 0x17) {
+			use_sse = get_sse_level(&cpuid_info) | USE_BSF;
+			use_sse |= get_avx2_erms(maxeax, &cpuid_info);
+			__intel_set_memops_method(use_sse);
+		}
 		return;
 	}
 
@@ -211,22 +287,8 @@ __proc64id(void)
 		 * Check what SSE versions are supported.
 		 */
 		__libc_get_cpuid(1, &cpuid_info, 0);
-		if (cpuid_info.ecx & CPUID_INTC_ECX_SSE4_2) {
-			use_sse |= USE_SSE4_2;
-		}
-		if (cpuid_info.ecx & CPUID_INTC_ECX_SSE4_1) {
-			use_sse |= USE_SSE4_1;
-		}
-		if (cpuid_info.ecx & CPUID_INTC_ECX_SSSE3) {
-			use_sse |= USE_SSSE3;
-		}
-		if (cpuid_info.ecx & CPUID_INTC_ECX_SSE3) {
-			use_sse |= USE_SSE3;
-		}
-		if (cpuid_info.edx & CPUID_INTC_EDX_SSE2) {
-			use_sse |= USE_SSE2;
-		}
-		use_sse |= USE_BSF;
+		use_sse = get_sse_level(&cpuid_info) | USE_BSF;
+		use_sse |= get_avx2_erms(maxeax, &cpuid_info);
 		__intel_set_memops_method(use_sse);
 	} else {
 		__set_cache_sizes(INTEL_DFLT_L1_CACHE_SIZE,
@@ -47,6 +47,8 @@ extern "C" {
 #define	USE_SSE4_1	0x08	/* SSE 4.1 */
 #define	USE_SSE4_2	0x10	/* SSE 4.2 */
 #define	USE_BSF		0x20	/* USE BSF class of instructions */
+#define	USE_AVX2	0x40	/* AVX2, with the ymm state saved by the OS */
+#define	USE_ERMS	0x80	/* Enhanced rep movsb/stosb */
 
 /*
  * Cache size defaults for Core 2 Duo
@@ -66,6 +68,7 @@ extern "C" {
 #else
 
 void __libc_get_cpuid(int cpuid_function, void *out_reg, int cache_index);
+uint64_t __libc_get_xcr0(void);
 void __intel_set_memops_method(long sse_level);
 void __set_cache_sizes(long l1_cache_size, long l2_cache_size,
     long largest_level_cache);
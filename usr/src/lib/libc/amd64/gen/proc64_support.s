@@ -82,6 +82,19 @@
 	ret
 	SET_SIZE(__libc_get_cpuid)
 
+/*
+ * Get the extended processor states enabled by the OS.
+ * Only to be called if cpuid reports OSXSAVE.
+ * (uint64_t)__libc_get_xcr0(void)
+ */
+	ENTRY(__libc_get_xcr0)
+	xor	%ecx,%ecx		# XCR0
+	xgetbv
+	shl	$32,%rdx
+	or	%rdx,%rax
+	ret
+	SET_SIZE(__libc_get_xcr0)
+
 /*
  * Set memops SSE level to use.
  * void __intel_set_memops_method(long sse_level);
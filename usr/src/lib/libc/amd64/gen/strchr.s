@@ -26,8 +26,11 @@
 	.file	"strchr.s"
 
 #include "SYS.h"
+#include "proc64_id.h"
 
 	ENTRY(strchr)		/* (char *, char) */
+	testl	$USE_AVX2,.memops_method(%rip)	/ 32 bytes at a time?
+	jnz	.avx2
 .loop:
 	movb	(%rdi),%dl	/ %dl = byte of string
 	cmpb	%sil,%dl	/ find it?
@@ -67,4 +70,47 @@
 .found:
 	movq	%rdi,%rax
 	ret
+
+/
+/ Look for c and the null char in 32 aligned bytes at a time, so no load
+/ crosses into a page past the end of the string.
+/
+	.balign	16
+.avx2:
+	movzbl	%sil,%esi	/ %esi = (char)c
+	vmovd	%esi,%xmm1
+	vpbroadcastb %xmm1,%ymm1	/ %ymm1 = 32 copies of c
+	vpxor	%xmm0,%xmm0,%xmm0	/ %ymm0 = 32 null chars
+	movq	%rdi,%rax
+	movl	%edi,%ecx
+	andq	$-32,%rax	/ round down to 32 bytes
+	andl	$31,%ecx
+	vmovdqa	(%rax),%ymm2
+	vpcmpeqb %ymm2,%ymm1,%ymm3	/ find c
+	vpcmpeqb %ymm2,%ymm0,%ymm2	/ or null
+	vpor	%ymm3,%ymm2,%ymm2
+	vpmovmskb %ymm2,%edx
+	shrl	%cl,%edx	/ skip the bytes preceding the string
+	testl	%edx,%edx
+	jz	.avx2loop
+	movq	%rdi,%rax
+	jmp	.avx2found
+
+.avx2loop:
+	addq	$32,%rax
+	vmovdqa	(%rax),%ymm2
+	vpcmpeqb %ymm2,%ymm1,%ymm3	/ find c
+	vpcmpeqb %ymm2,%ymm0,%ymm2	/ or null
+	vpor	%ymm3,%ymm2,%ymm2
+	vpmovmskb %ymm2,%edx
+	testl	%edx,%edx
+	jz	.avx2loop
+
+.avx2found:
+	bsfl	%edx,%edx
+	addq	%rdx,%rax	/ %rax = first c or null
+	vzeroupper
+	cmpb	(%rax),%sil	/ find it?
+	jne	.notfound	/ no, it is the null
+	ret
 	SET_SIZE(strchr)
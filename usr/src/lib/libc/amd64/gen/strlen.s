@@ -35,9 +35,12 @@
 
 	/*
 	 * This implementation uses SSE instructions to compare up to 16 bytes
-	 * at a time looking for the end of string (null char).
+	 * at a time looking for the end of string (null char), or AVX2
+	 * instructions to compare 32 bytes at a time if those are available.
 	 */
 	ENTRY(strlen)			/* (const char *s) */
+	testl	$USE_AVX2, .memops_method(%rip)
+	jnz	LABEL(avx2)
 	mov	%rdi, %rsi		/* keep original %rdi value */
 	mov	%rsi, %rcx
 	pxor	%xmm0, %xmm0		/* 16 null chars */
@@ -196,4 +199,38 @@ LABEL(exit_tail5):
 LABEL(exit_tail6):
 	add	$6, %rax
 	ret
+
+	/*
+	 * AVX2 version. Only aligned 32 byte loads are done, so no load can
+	 * cross into the next page past the null char.
+	 */
+	.p2align 4
+LABEL(avx2):
+	mov	%rdi, %rsi
+	mov	%edi, %ecx
+	and	$0xffffffffffffffe0, %rsi	/* round down to 32 bytes */
+	and	$31, %ecx
+	vpxor	%xmm0, %xmm0, %xmm0	/* 32 null chars */
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %edx
+	shr	%cl, %edx		/* skip bytes preceding the string */
+	test	%edx, %edx
+	jz	LABEL(avx2_loop)
+	bsf	%edx, %eax		/* null is within the first 32 bytes */
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_loop):
+	add	$32, %rsi
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %edx
+	test	%edx, %edx
+	jz	LABEL(avx2_loop)
+
+	bsf	%edx, %edx		/* index of null in this 32 bytes */
+	lea	(%rsi, %rdx), %rax
+	sub	%rdi, %rax
+	vzeroupper
+	ret
 	SET_SIZE(strlen)
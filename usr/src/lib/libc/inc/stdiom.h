@@ -100,8 +100,6 @@
 
 typedef unsigned char	Uchar;
 
-#define	_flockrel(rl)		cancel_safe_mutex_unlock(rl)
-
 #define	MAXVAL	(MAXINT - (MAXINT % BUFSIZ))
 
 /*
@@ -158,6 +156,7 @@ extern rmutex_t	*_reallock(FILE *iop);
 
 extern void	_setbufend(FILE *iop, Uchar *end);
 extern rmutex_t *_flockget(FILE *iop);
+extern void	_flockrel(rmutex_t *rl);
 extern int	_xflsbuf(FILE *iop);
 extern int	_wrtchk(FILE *iop);
 extern void	_bufsync(FILE *iop, Uchar *bufend);
@@ -117,6 +117,7 @@
 #define	LOCKMASK64	0xffffffffff000000ULL
 #define	LOCKBYTE64	0x00000000ff000000ULL
 #define	WAITERMASK64	0x00000000000000ffULL
+#define	WAITER64	0x0000000000000001ULL
 #define	SPINNERMASK64	0x0000000000ff0000ULL
 
 #elif defined(__x86)
@@ -134,6 +135,7 @@
 #define	LOCKMASK64	0xff000000ffffffffULL
 #define	LOCKBYTE64	0x0100000000000000ULL
 #define	WAITERMASK64	0x00ff000000000000ULL
+#define	WAITER64	0x0001000000000000ULL
 #define	SPINNERMASK64	0x0000ff0000000000ULL
 
 #else
@@ -494,25 +496,53 @@ typedef struct {
  * As part of per-thread caching libumem (ptcumem), we add a small amount to the
  * thread's uberdata to facilitate it. The tm_roots are the roots of linked
  * lists which is used by libumem to chain together allocations. tm_size is used
- * to track the total amount of data stored across those linked lists. For more
- * information, see libumem's big theory statement.
+ * to track the total amount of data stored across those linked lists, and
+ * tm_max is the most that libumem will currently let this thread hold. The
+ * remaining members are libumem's statistics and bookkeeping. libumem
+ * generates code that knows this layout; the two must be changed together.
+ * For more information, see libumem's big theory statement.
  */
-#define	NTMEMBASE	16
+#define	NTMEMBASE	48
 
 typedef struct {
 	size_t		tm_size;
+	size_t		tm_max;
+	uint64_t	tm_ahit;
+	uint64_t	tm_fhit;
+	uint64_t	tm_amiss;
+	uint64_t	tm_fmiss;
+	uint32_t	tm_gen;
+	uint32_t	tm_amark;
 	void		*tm_roots[NTMEMBASE];
 } tumem_t;
 
 #ifdef _SYSCALL32
 typedef struct {
 	uint32_t	tm_size;
+	uint32_t	tm_max;
+	uint64_t	tm_ahit;
+	uint64_t	tm_fhit;
+	uint64_t	tm_amiss;
+	uint64_t	tm_fmiss;
+	uint32_t	tm_gen;
+	uint32_t	tm_amark;
 	caddr32_t	tm_roots[NTMEMBASE];
 } tumem32_t;
 #endif
 
 typedef void (*tmem_func_t)(void *, int);
 
+/*
+ * Per-thread cache of small blocks for libc's own malloc().
+ * See the comment in port/gen/malloc.c.
+ */
+#define	NTMALLOC	32
+
+typedef struct {
+	size_t		tm_size;	/* bytes held in tm_roots */
+	void		*tm_roots[NTMALLOC];
+} tmalloc_t;
+
 /*
  * Maximum number of read locks allowed for one thread on one rwlock.
  * This could be as large as INT_MAX, but the SUSV3 test suite would
@@ -681,6 +711,7 @@ typedef struct ulwp {
 #endif
 	tumem_t		ul_tmem;	/* used only by umem */
 	uint_t		ul_ptinherit;	/* pthreads sched inherit value */
+	tmalloc_t	ul_tmalloc;	/* used only by libc's malloc */
 } ulwp_t;
 
 #define	ul_cursig	ul_cp.s.cursig		/* deferred signal number */
@@ -727,6 +758,7 @@ extern	int	thread_queue_spin;
 extern	int	thread_queue_fifo;
 extern	int	thread_queue_dump;
 extern	int	thread_cond_wait_defer;
+extern	int	thread_rwlock_scalable;
 extern	int	thread_async_safe;
 extern	int	thread_queue_verify;
 
@@ -1270,6 +1302,7 @@ extern	void	finish_init(void);
 extern	void	update_sched(ulwp_t *);
 extern	void	queue_alloc(void);
 extern	void	tmem_exit(void);
+extern	void	tmalloc_exit(void);
 extern	void	tsd_exit(void);
 extern	void	tsd_free(ulwp_t *);
 extern	void	tls_setup(void);
@@ -1516,6 +1549,9 @@ extern	int	__lwp_rwlock_wrlock(rwlock_t *, timespec_t *);
 extern	int	__lwp_rwlock_tryrdlock(rwlock_t *);
 extern	int	__lwp_rwlock_trywrlock(rwlock_t *);
 extern	int	__lwp_rwlock_unlock(rwlock_t *);
+extern	int	__lwp_addr_wait(volatile uint32_t *, uint32_t, timespec_t *,
+			int, int);
+extern	int	__lwp_addr_wake(volatile uint32_t *, uint32_t, int);
 extern	int	__lwp_park(timespec_t *, lwpid_t);
 extern	int	__lwp_unpark(lwpid_t);
 extern	int	__lwp_unpark_all(lwpid_t *, int);
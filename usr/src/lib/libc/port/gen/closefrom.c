@@ -138,6 +138,15 @@ void
 closefrom(int lowfd)
 {
 	int low = (lowfd < 0)? 0 : lowfd;
+	int err = errno;
+
+	/*
+	 * The kernel can do it all in one go, without /proc.
+	 */
+	if (fcntl(low, F_CLOSEFROM, 0) == 0) {
+		errno = err;
+		return;
+	}
 
 	/*
 	 * Close lowfd right away as a hedge against failing
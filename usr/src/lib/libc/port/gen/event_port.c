@@ -64,6 +64,39 @@ port_associate(int port, int source, uintptr_t object, int events, void *user)
 	return (r.r_val1);
 }
 
+int
+port_associaten(int port, int source, port_assoc_t list[], uint_t nent,
+    int errors[])
+{
+	rval_t	r;
+	uint_t	offset;
+	uint_t	lnent;
+	uint_t	nassoc;
+	if (nent <= PORT_MAX_LIST) {
+		r.r_vals = _portfs(PORT_ASSOCIATEN, port, source,
+		    (uintptr_t)list, nent, (uintptr_t)errors);
+		return (r.r_val1);
+	}
+
+	/* use chunks of max PORT_MAX_LIST elements per syscall */
+	nassoc = 0;
+	for (offset = 0; offset < nent; offset += lnent) {
+		lnent = nent - offset;
+		if (lnent > PORT_MAX_LIST)
+			lnent = PORT_MAX_LIST;
+		r.r_vals = _portfs(PORT_ASSOCIATEN, port, source,
+		    (uintptr_t)&list[offset],
+		    lnent, errors != NULL ? (uintptr_t)&errors[offset] : NULL);
+		if (r.r_val1 == -1) {
+			/* global error, return no of objects associated */
+			if (nassoc)
+				return (nassoc);
+			return (-1);
+		}
+		nassoc += r.r_val1;
+	}
+	return (nassoc);
+}
 
 int
 port_get(int port, port_event_t *pe, struct timespec *to)
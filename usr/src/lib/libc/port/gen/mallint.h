@@ -41,7 +41,8 @@
 #include <string.h>
 #include <limits.h>
 
-/* debugging macros */
+/* debugging macros, in place of thr_debug.h's */
+#undef	ASSERT
 #ifdef	DEBUG
 #define	ASSERT(p)	((void) ((p) || (abort(), 0)))
 #define	COUNT(n)	((void) n++)
@@ -160,6 +161,12 @@ typedef struct _t_ {
 #define	CLRBITS01(w)	((w) &= ~BITS01) /* Clean bits 0 & 1 */
 #define	SETOLD01(n, o)	((n) |= (BITS01 & (o)))
 
+/* a block of a size class, owned by the per-thread caches, not the tree */
+#define	BIT2		(04)		/* ...100 */
+#define	BITS012		(07)		/* ...111 */
+#define	ISBIT2(w)	((w) & BIT2)
+#define	CLRBITS012(w)	((w) &= ~BITS012)
+
 /* system call to get more core */
 #define	GETCORE		sbrk
 #define	ERRCORE		((void *)(-1))
@@ -169,6 +176,7 @@ typedef struct _t_ {
 #define	MAX_ALIGN	(1 + (size_t)SSIZE_MAX)
 
 extern void	*GETCORE(ssize_t);
+extern void	*_malloc_unlocked(size_t);
 extern void	_free_unlocked(void *);
 
 extern mutex_t libc_malloc_lock;
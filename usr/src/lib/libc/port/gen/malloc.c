@@ -61,6 +61,7 @@
  */
 
 #include "lint.h"
+#include "thr_uberdata.h"
 #include "mallint.h"
 #include "mtlib.h"
 
@@ -89,7 +90,9 @@ static void	t_delete(TREE *);
 static void	t_splay(TREE *);
 static void	realfree(void *);
 static void	cleanfree(void *);
-static void	*_malloc_unlocked(size_t);
+static void	*tmalloc(size_t);
+static void	*trealloc(void *, size_t);
+static void	tfree(void *);
 
 #define	FREESIZE (1<<5) /* size for preserving free blocks until next malloc */
 #define	FREEMASK FREESIZE-1
@@ -97,19 +100,244 @@ static void	*_malloc_unlocked(size_t);
 static void *flist[FREESIZE];	/* list of blocks to be freed on next malloc */
 static int freeidx;		/* index of free blocks in flist % FREESIZE */
 
+/*
+ *	Per-thread caches of small blocks.
+ *
+ *	Once a process has gone multithreaded, requests of up to MALLOC_TMAX
+ *	bytes are served from per-thread caches of size-classed blocks, after
+ *	libumem's ptcumem, so that threads do not serialize on libc_malloc_lock
+ *	for the common case.  Each thread's cache is the ul_tmalloc member of
+ *	its ulwp_t: one list per size class of free blocks linked through their
+ *	first word, and the number of bytes they hold.
+ *
+ *	A thread whose list is empty takes a batch of blocks from one of
+ *	MALLOC_NARENA arenas, chosen by its lwpid.  A thread whose cache grows
+ *	past MALLOC_TCACHE_MAX bytes gives all of it back to its arena under a
+ *	single acquisition of the arena's lock, as it does when it exits.  The
+ *	arenas carve their blocks out of chunks taken from the free tree, so
+ *	the heap is still grown by _morecore().  The blocks keep the usual
+ *	header word, with BIT2 set so that free() and realloc() know they are
+ *	not part of the tree; they are never coalesced back into it, as is
+ *	already the case for the blocks of _smalloc().
+ *
+ *	Larger requests, and all requests of a process that has never gone
+ *	multithreaded, are served from the tree as before.  A single-threaded
+ *	program thus keeps the old behaviour exactly, including that the
+ *	contents of a freed block remain intact until the next malloc().
+ */
+#define	MALLOC_TCLASS	16	/* spacing of the size classes */
+#define	MALLOC_TMAX	(NTMALLOC * MALLOC_TCLASS)
+#define	MALLOC_NARENA	8	/* must be a power of 2 */
+#define	MALLOC_CHUNK	(16 * 1024)	/* taken from the tree at a time */
+#define	MALLOC_TBATCH	(4 * 1024)	/* moved to a thread cache at a time */
+#define	MALLOC_TCACHE_MAX (64 * 1024)	/* bytes held by a thread cache */
+
+#define	TMALLOC_INDEX(s)	((s) == 0 ? 0 : ((s) - 1) / MALLOC_TCLASS)
+#define	TMALLOC_SIZE(ix)	(((ix) + 1) * MALLOC_TCLASS)
+#define	TMALLOC_LINK(b)		(*(void **)(b))
+
+typedef struct marena {
+	mutex_t	ma_lock;
+	void	*ma_free[NTMALLOC];	/* free blocks of each size class */
+} marena_t;
+
+#define	MARENA_INIT	{ DEFAULTMUTEX }
+
+static marena_t marena[MALLOC_NARENA] = {
+	MARENA_INIT, MARENA_INIT, MARENA_INIT, MARENA_INIT,
+	MARENA_INIT, MARENA_INIT, MARENA_INIT, MARENA_INIT
+};
+
+#define	MARENA_SELF()	\
+	(&marena[curthread->ul_lwpid & (MALLOC_NARENA - 1)])
+
 /*
  * Interfaces used only by atfork_init() functions.
+ * The arena locks are taken before libc_malloc_lock, as in tmalloc_refill().
  */
 void
 malloc_locks(void)
 {
+	int	i;
+
+	for (i = 0; i < MALLOC_NARENA; i++)
+		(void) mutex_lock(&marena[i].ma_lock);
 	(void) mutex_lock(&libc_malloc_lock);
 }
 
 void
 malloc_unlocks(void)
 {
+	int	i;
+
 	(void) mutex_unlock(&libc_malloc_lock);
+	for (i = MALLOC_NARENA - 1; i >= 0; i--)
+		(void) mutex_unlock(&marena[i].ma_lock);
+}
+
+/*
+ * Fill the calling thread's list ix from its arena, carving a new chunk
+ * from the tree if the arena has no blocks of that size either.
+ * Returns one block, not yet marked busy, for the caller.
+ */
+static void *
+tmalloc_refill(tmalloc_t *tm, int ix)
+{
+	marena_t	*ma = MARENA_SELF();
+	size_t		csize = TMALLOC_SIZE(ix);
+	size_t		bsize = csize + WORDSIZE;
+	size_t		i, n;
+	char		*cp;
+	TREE		*tp;
+	void		*head, *bp;
+
+	(void) mutex_lock(&ma->ma_lock);
+	if (ma->ma_free[ix] == NULL) {
+		n = MALLOC_CHUNK / bsize;
+		(void) mutex_lock(&libc_malloc_lock);
+		cp = _malloc_unlocked(n * bsize);
+		(void) mutex_unlock(&libc_malloc_lock);
+		if (cp == NULL) {
+			(void) mutex_unlock(&ma->ma_lock);
+			return (NULL);
+		}
+
+		/* make them into a link list */
+		for (i = 0; i < n; i++) {
+			tp = (TREE *)(uintptr_t)(cp + i * bsize);
+			SIZE(tp) = csize | BIT2;
+			TMALLOC_LINK(DATA(tp)) = (i + 1 < n) ?
+			    DATA(cp + (i + 1) * bsize) : NULL;
+		}
+		ma->ma_free[ix] = DATA(cp);
+	}
+
+	/* take up to a batch of them */
+	head = bp = ma->ma_free[ix];
+	for (n = MALLOC_TBATCH / csize; n > 1 && TMALLOC_LINK(bp) != NULL; n--)
+		bp = TMALLOC_LINK(bp);
+	ma->ma_free[ix] = TMALLOC_LINK(bp);
+	(void) mutex_unlock(&ma->ma_lock);
+	TMALLOC_LINK(bp) = NULL;
+
+	/* the first block is the caller's, the others go to the cache */
+	for (bp = TMALLOC_LINK(head); bp != NULL; bp = TMALLOC_LINK(bp))
+		tm->tm_size += csize;
+	tm->tm_roots[ix] = TMALLOC_LINK(head);
+	return (head);
+}
+
+/*
+ * Give all of a thread's cached blocks back to its arena.
+ */
+static void
+tmalloc_flush(tmalloc_t *tm)
+{
+	marena_t	*ma = MARENA_SELF();
+	void		*head, *bp;
+	int		ix;
+
+	(void) mutex_lock(&ma->ma_lock);
+	for (ix = 0; ix < NTMALLOC; ix++) {
+		if ((head = tm->tm_roots[ix]) == NULL)
+			continue;
+		for (bp = head; TMALLOC_LINK(bp) != NULL; bp = TMALLOC_LINK(bp))
+			continue;
+		TMALLOC_LINK(bp) = ma->ma_free[ix];
+		ma->ma_free[ix] = head;
+		tm->tm_roots[ix] = NULL;
+	}
+	(void) mutex_unlock(&ma->ma_lock);
+	tm->tm_size = 0;
+}
+
+/*
+ * This is called by _thrp_exit() so that the cache of an exiting thread
+ * is not lost.
+ */
+void
+tmalloc_exit(void)
+{
+	tmalloc_t	*tm = &curthread->ul_tmalloc;
+
+	if (tm->tm_size != 0)
+		tmalloc_flush(tm);
+}
+
+static void *
+tmalloc(size_t size)
+{
+	tmalloc_t	*tm = &curthread->ul_tmalloc;
+	int		ix = TMALLOC_INDEX(size);
+	void		*buf;
+
+	if ((buf = tm->tm_roots[ix]) != NULL) {
+		tm->tm_roots[ix] = TMALLOC_LINK(buf);
+		tm->tm_size -= TMALLOC_SIZE(ix);
+	} else if ((buf = tmalloc_refill(tm, ix)) == NULL) {
+		return (NULL);
+	}
+	SETBIT0(SIZE(BLOCK(buf)));
+	return (buf);
+}
+
+static void
+tfree(void *old)
+{
+	tmalloc_t	*tm = &curthread->ul_tmalloc;
+	TREE		*tp = BLOCK(old);
+	size_t		csize;
+	int		ix;
+
+	/* make sure the same data block is not freed twice */
+	if (!ISBIT0(SIZE(tp)))
+		return;
+	CLRBIT0(SIZE(tp));
+	csize = SIZE(tp);
+	CLRBITS012(csize);
+	ix = TMALLOC_INDEX(csize);
+
+	TMALLOC_LINK(old) = tm->tm_roots[ix];
+	tm->tm_roots[ix] = old;
+	if ((tm->tm_size += csize) > MALLOC_TCACHE_MAX)
+		tmalloc_flush(tm);
+}
+
+static void *
+trealloc(void *old, size_t size)
+{
+	size_t	ts = SIZE(BLOCK(old));
+	void	*new;
+
+	/* if the block was freed, data has been destroyed. */
+	if (!ISBIT0(ts))
+		return (NULL);
+	CLRBITS012(ts);
+
+	/* free if size is zero */
+	if (size == 0) {
+		tfree(old);
+		return (NULL);
+	}
+
+	/* nothing to do if the size class is the same */
+	if (TMALLOC_INDEX(size) == TMALLOC_INDEX(ts))
+		return (old);
+
+	if (size <= MALLOC_TMAX) {
+		new = tmalloc(size);
+	} else {
+		(void) mutex_lock(&libc_malloc_lock);
+		new = _malloc_unlocked(size);
+		(void) mutex_unlock(&libc_malloc_lock);
+	}
+	if (new != NULL) {
+		if (ts > size)
+			ts = size;
+		MEMCOPY(new, old, ts);
+		tfree(old);
+	}
+	return (new);
 }
 
 /*
@@ -169,13 +397,15 @@ malloc(size_t size)
 		return (NULL);
 	}
 	assert_no_libc_locks_held();
+	if (size <= MALLOC_TMAX && __libc_threaded)
+		return (tmalloc(size));
 	(void) mutex_lock(&libc_malloc_lock);
 	ret = _malloc_unlocked(size);
 	(void) mutex_unlock(&libc_malloc_lock);
 	return (ret);
 }
 
-static void *
+void *
 _malloc_unlocked(size_t size)
 {
 	size_t	n;
@@ -319,6 +549,12 @@ realloc(void *old, size_t size)
 		return (NULL);
 	}
 
+	/* blocks of the per-thread caches */
+	if (old == NULL && size <= MALLOC_TMAX && __libc_threaded)
+		return (tmalloc(size));
+	if (old != NULL && ISBIT2(SIZE(BLOCK(old))))
+		return (trealloc(old, size));
+
 	/* pointer to the block */
 	(void) mutex_lock(&libc_malloc_lock);
 	if (old == NULL) {
@@ -858,6 +1094,10 @@ free(void *old)
 		return;
 	}
 	assert_no_libc_locks_held();
+	if (old != NULL && ISBIT2(SIZE(BLOCK(old)))) {
+		tfree(old);
+		return;
+	}
 	(void) mutex_lock(&libc_malloc_lock);
 	_free_unlocked(old);
 	(void) mutex_unlock(&libc_malloc_lock);
@@ -113,12 +113,18 @@ memalign(size_t align, size_t nbytes)
 		return (NULL);
 	}
 
-	p = (TREE *)malloc(reqsize);
+	/*
+	 * The block is split below, so it must come from the free tree
+	 * even when malloc() would serve this size from a thread's cache.
+	 */
+	assert_no_libc_locks_held();
+	(void) mutex_lock(&libc_malloc_lock);
+	p = (TREE *)_malloc_unlocked(reqsize);
 	if (p == (TREE *)NULL) {
 		/* malloc sets errno */
+		(void) mutex_unlock(&libc_malloc_lock);
 		return (NULL);
 	}
-	(void) mutex_lock(&libc_malloc_lock);
 
 	/*
 	 * get size of the entire block (overhead and all)
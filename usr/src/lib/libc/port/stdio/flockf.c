@@ -30,6 +30,7 @@
 #pragma ident	"%Z%%M%	%I%	%E% SMI"
 
 #include "lint.h"
+#include "thr_uberdata.h"
 #include "mtlib.h"
 #include "file64.h"
 #include <stdio.h>
@@ -38,6 +39,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <stdio_ext.h>
+#include <sys/sdt.h>
 #include "stdiom.h"
 
 #define	_iob	__iob
@@ -49,18 +51,60 @@
 
 /*
  * compute the lock's position, acquire it and return its pointer
+ *
+ * A stream already locked by the calling thread, with flockfile() or by
+ * a stdio function further up the stack, only has its recursion count
+ * bumped.  Nothing else can change the lock while we own it, so this
+ * needs neither an atomic operation nor deferred signals, which makes
+ * getc() and putc() between flockfile() and funlockfile() nearly as
+ * cheap as their _unlocked forms.  The ul_libc_locks accounting done by
+ * cancel_safe_mutex_lock() is kept, so that cancellation is still
+ * deferred while the stream is in use, and _flockrel() undoes both.
  */
 
 rmutex_t *
 _flockget(FILE *iop)
 {
 	rmutex_t *rl = IOB_LCK(iop);
-
-	if (rl != NULL)
-		cancel_safe_mutex_lock(rl);
+	ulwp_t *self;
+
+	if (rl != NULL) {
+		self = curthread;
+		if (MUTEX_OWNED(rl, self) &&
+		    rl->mutex_rcount < RECURSION_MAX) {
+			rl->mutex_rcount++;
+			self->ul_libc_locks++;
+			DTRACE_PROBE3(plockstat, mutex__acquire, rl, 1, 0);
+		} else {
+			cancel_safe_mutex_lock(rl);
+		}
+	}
 	return (rl);
 }
 
+void
+_flockrel(rmutex_t *rl)
+{
+	ulwp_t *self = curthread;
+
+	if (rl->mutex_rcount == 0 || !MUTEX_OWNED(rl, self)) {
+		cancel_safe_mutex_unlock(rl);
+		return;
+	}
+
+	ASSERT(self->ul_libc_locks != 0);
+
+	rl->mutex_rcount--;
+	DTRACE_PROBE2(plockstat, mutex__release, rl, 1);
+
+	/* as in cancel_safe_mutex_unlock() */
+	if (--self->ul_libc_locks == 0 &&
+	    !(self->ul_vfork | self->ul_nocancel |
+	    self->ul_critical | self->ul_sigdefer) &&
+	    cancel_active())
+		pthread_exit(PTHREAD_CANCELED);
+}
+
 int
 ftrylockfile(FILE *iop)
 {
@@ -82,16 +82,31 @@ _fwrite_unlocked(const void *ptr, size_t size, size_t count, FILE *iop)
 		s = size * count;
 
 	if (iop->_flag & _IOLBF) {
+		unsigned char *nl;
+
+		/*
+		 * Copy up to the next newline, or as much as fits, and leave
+		 * the newline (or the byte that didn't fit) to __flsbuf(),
+		 * which stores it and writes the buffer out.
+		 */
 		bufend = _bufend(iop);
-		iop->_cnt = iop->_base - iop->_ptr;
 		while (s > 0) {
-			ssize_t buflen = bufend - iop->_base;
-			if (--iop->_cnt >= (-buflen) && *dptr != '\n')
-				*iop->_ptr++ = *dptr++;
-			else if (__flsbuf(*dptr++, iop) == EOF)
+			n = bufend - iop->_ptr;
+			if (n > s)
+				n = s;
+			if ((nl = memchr(dptr, '\n', n)) != NULL)
+				n = nl - dptr;
+			(void) memcpy(iop->_ptr, (void *)dptr, n);
+			iop->_ptr += n;
+			dptr += n;
+			s -= n;
+			if (s == 0)
+				break;
+			if (__flsbuf(*dptr++, iop) == EOF)
 				break;
 			s--;
 		}
+		iop->_cnt = 0;		/* putc() always goes to __flsbuf() */
 	} else if (iop->_flag & _IONBF) {
 		ssize_t bytes;
 		ssize_t written = 0;
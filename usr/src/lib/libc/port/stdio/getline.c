@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <limits.h>
 #include <malloc.h>
+#include <string.h>
 #include <sys/types.h>
 #include "stdiom.h"
 
@@ -44,9 +45,10 @@ getdelim(char **_RESTRICT_KYWD lineptr, size_t *_RESTRICT_KYWD n,
 {
 	rmutex_t *lk;
 	char *ptr;
+	Uchar *dp;
 	size_t size;
-	int c;
 	size_t cnt;
+	size_t len;
 
 	if (lineptr == NULL || n == NULL ||
 	    delimiter < 0 || delimiter > UCHAR_MAX) {
@@ -61,7 +63,6 @@ getdelim(char **_RESTRICT_KYWD lineptr, size_t *_RESTRICT_KYWD n,
 		}
 		*n = LINESZ;
 	}
-	ptr = *lineptr;
 	size = *n;
 	cnt = 0;
 
@@ -69,26 +70,41 @@ getdelim(char **_RESTRICT_KYWD lineptr, size_t *_RESTRICT_KYWD n,
 
 	_SET_ORIENTATION_BYTE(iop);
 
-	do {
-		c = (--iop->_cnt < 0) ? __filbuf(iop) : *iop->_ptr++;
-		if (c == EOF)
-			break;
-		*ptr++ = c;
-		if (++cnt == size) {	/* must reallocate */
-			if ((ptr = realloc(*lineptr, 2 * size)) == NULL) {
+	/*
+	 * Take what is in the buffer up to and including the delimiter,
+	 * a bufferful at a time.
+	 */
+	for (;;) {
+		if (iop->_cnt <= 0) {
+			if (__filbuf(iop) == EOF)
+				break;
+			iop->_ptr--;	/* put back the character */
+			iop->_cnt++;
+		}
+		len = iop->_cnt;
+		if ((dp = memchr(iop->_ptr, delimiter, len)) != NULL)
+			len = dp - iop->_ptr + 1;
+		if (cnt + len >= size) {	/* must reallocate */
+			while (cnt + len >= size)
+				size *= 2;
+			if ((ptr = realloc(*lineptr, size)) == NULL) {
 				FUNLOCKFILE(lk);
-				ptr = *lineptr + size - 1;
-				*ptr = '\0';
+				(*lineptr)[cnt] = '\0';
 				errno = ENOMEM;
 				return (-1);
 			}
 			*lineptr = ptr;
-			ptr += size;
-			*n = size = 2 * size;
+			*n = size;
 		}
-	} while (c != delimiter);
+		(void) memcpy(*lineptr + cnt, iop->_ptr, len);
+		iop->_ptr += len;
+		iop->_cnt -= len;
+		cnt += len;
+		if (dp != NULL)
+			break;
+	}
 
-	*ptr = '\0';
+	(*lineptr)[cnt] = '\0';
 
 	FUNLOCKFILE(lk);
 	if (cnt > SSIZE_MAX) {
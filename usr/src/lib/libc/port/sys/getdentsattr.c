@@ -0,0 +1,20 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/dirent.h>
+
+int
+getdentsattr(int fd, direntattr_t *buf, size_t nbytes)
+{
+	return (syscall(SYS_getdentsattr, fd, buf, nbytes));
+}
@@ -0,0 +1,48 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#include <sys/ioring.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+int
+ioring_setup(ioring_params_t *params)
+{
+	int fd;
+
+	if ((fd = open("/dev/ioring", O_RDWR | O_CLOEXEC)) < 0)
+		return (-1);
+
+	if (ioctl(fd, IORINGIOC_SETUP, params) != 0) {
+		(void) close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+int
+ioring_enter(int fd, uint_t to_submit, uint_t min_complete, uint_t flags)
+{
+	ioring_enter_t e;
+
+	e.ire_to_submit = to_submit;
+	e.ire_min_complete = min_complete;
+	e.ire_flags = flags;
+	e.ire_submitted = 0;
+
+	if (ioctl(fd, IORINGIOC_ENTER, &e) != 0)
+		return (-1);
+
+	return ((int)e.ire_submitted);
+}
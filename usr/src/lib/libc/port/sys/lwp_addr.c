@@ -0,0 +1,56 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#include "lint.h"
+#include <sys/types.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#define	SUBSYS_lwp_addr_wait		0
+#define	SUBSYS_lwp_addr_wait_park	1
+#define	SUBSYS_lwp_addr_wake		2
+
+/*
+ * Sleep for as long as *addr == val.  If check_park is set, the kernel
+ * returns EINTR at once unless the caller's schedctl parking flag is set;
+ * see set_parking_flag().  Returns EAGAIN if *addr was not equal to val.
+ */
+int
+__lwp_addr_wait(volatile uint32_t *addr, uint32_t val, timespec_t *tsp,
+    int type, int check_park)
+{
+	sysret_t rval;
+	int error;
+
+	error = __systemcall(&rval, SYS_lwp_addr_sys,
+	    check_park ? SUBSYS_lwp_addr_wait_park : SUBSYS_lwp_addr_wait,
+	    addr, val, tsp, type);
+	if (error == ERESTART)
+		error = EINTR;
+
+	return (error);
+}
+
+/*
+ * Wake up at most nwake lwps sleeping in __lwp_addr_wait() on addr.
+ */
+int
+__lwp_addr_wake(volatile uint32_t *addr, uint32_t nwake, int type)
+{
+	sysret_t rval;
+	int error;
+
+	error = __systemcall(&rval, SYS_lwp_addr_sys,
+	    SUBSYS_lwp_addr_wake, addr, nwake, NULL, type);
+
+	return (error);
+}
@@ -35,6 +35,53 @@
 
 #define	NLOCKS	4	/* initial number of readlock_t structs allocated */
 
+/*
+ * Reader-scalable rwlocks.
+ *
+ * Every reader of an ordinary rwlock updates its rwstate word, so on a
+ * read-mostly rwlock that one word bounces between the caches of all of
+ * the processors that use it.  A process-private rwlock initialized with
+ * the RWL_SCALABLE flag (or any process-private rwlock, if the environment
+ * variable _THREAD_RWLOCK_SCALABLE=1 is set) can instead be read-locked
+ * by storing its address in a slot of rw_bias_table chosen by hashing
+ * the rwlock and the thread, leaving rwstate alone.  This is allowed only
+ * while the rwlock is biased towards readers (rwlock_bias is set).
+ *
+ * A writer first acquires the rwlock in the ordinary way, which shuts out
+ * every reader that does not find the bias set, then clears the bias and
+ * waits until no slot of the table refers to the rwlock any more.  That
+ * is expensive, so the bias is not set again (by the next reader to get
+ * the rwlock in the ordinary way) until RW_BIAS_INHIBIT times as long as
+ * the wait took has passed.  This bounds the cost to the writers.
+ *
+ * A thread holding a read lock through the table has RD_BIASED and the
+ * index of its slot recorded in rd_count in its readlock_t for the rwlock.
+ */
+#define	RW_BIAS_SLOTS	4096	/* entries in rw_bias_table */
+#define	RW_BIAS_INHIBIT	9	/* see above */
+
+#define	RD_COUNT_MASK	0x0007ffff	/* count of read locks applied */
+#define	RD_SLOT_SHIFT	19		/* index in rw_bias_table */
+#define	RD_BIASED	0x80000000	/* read lock held through the table */
+
+/* for process-private rwlocks, the embedded mutex is not otherwise used */
+#define	rwlock_bias		mutex.mutex_lockword
+#define	rwlock_bias_inhibit	mutex.mutex_owner
+
+#define	RW_SCALABLE(rwlp)					\
+	(((rwlp)->rwlock_type & RWL_SCALABLE) ||		\
+	((rwlp)->rwlock_type == USYNC_THREAD && thread_rwlock_scalable))
+
+/*
+ * The environment variable:
+ *	_THREAD_RWLOCK_SCALABLE=1
+ * makes all process-private rwlocks reader-scalable.
+ */
+int	thread_rwlock_scalable = 0;
+
+static rwlock_t *volatile *rw_bias_table;
+static int ncpus;
+
 #define	ASSERT_CONSISTENT_STATE(readers)		\
 	ASSERT(!((readers) & URW_WRITE_LOCKED) ||	\
 		((readers) & ~URW_HAS_WAITERS) == URW_WRITE_LOCKED)
@@ -146,11 +193,13 @@ rw_read_held(rwlock_t *rwlp)
 
 	readers = *rwstate;
 	ASSERT_CONSISTENT_STATE(readers);
-	if (!(readers & URW_WRITE_LOCKED) &&
-	    (readers & URW_READERS_MASK) != 0) {
+	if ((!(readers & URW_WRITE_LOCKED) &&
+	    (readers & URW_READERS_MASK) != 0) || RW_SCALABLE(rwlp)) {
 		/*
-		 * The lock is held for reading by some thread.
-		 * Search our array of rwlocks held for reading for a match.
+		 * The lock is held for reading by some thread (or may
+		 * be held through rw_bias_table, which rwstate doesn't
+		 * show).  Search our array of rwlocks held for reading
+		 * for a match.
 		 */
 		if ((nlocks = self->ul_rdlockcnt) != 0)
 			readlockp = self->ul_readlock.array;
@@ -189,13 +238,33 @@ rw_write_held(rwlock_t *rwlp)
 	ASSERT_CONSISTENT_STATE(readers);
 	rval = ((readers & URW_WRITE_LOCKED) &&
 	    rwlp->rwlock_owner == (uintptr_t)self &&
-	    (rwlp->rwlock_type == USYNC_THREAD ||
+	    (!(rwlp->rwlock_type & USYNC_PROCESS) ||
 	    rwlp->rwlock_ownerpid == self->ul_uberdata->pid));
 
 	preempt(self);
 	return (rval);
 }
 
+/*
+ * Forget about any read lock we hold on rwlp, for rwlock_init() and
+ * rwlock_destroy().  If we held it through rw_bias_table, give up the slot,
+ * lest writers wait for it forever.
+ */
+static void
+rwl_forget(rwlock_t *rwlp)
+{
+	ulwp_t *self = curthread;
+	readlock_t *readlockp;
+
+	sigoff(self);
+	readlockp = rwl_entry(rwlp);
+	if (readlockp->rd_count & RD_BIASED)
+		rw_bias_table[(readlockp->rd_count & ~RD_BIASED) >>
+		    RD_SLOT_SHIFT] = NULL;
+	readlockp->rd_count = 0;
+	sigon(self);
+}
+
 #pragma weak _rwlock_init = rwlock_init
 /* ARGSUSED2 */
 int
@@ -203,19 +272,18 @@ rwlock_init(rwlock_t *rwlp, int type, void *arg)
 {
 	ulwp_t *self = curthread;
 
-	if (type != USYNC_THREAD && type != USYNC_PROCESS)
+	if (type != USYNC_THREAD && type != USYNC_PROCESS &&
+	    type != (USYNC_THREAD | RWL_SCALABLE))
 		return (EINVAL);
 	/*
 	 * Once reinitialized, we can no longer be holding a read or write lock.
 	 * We can do nothing about other threads that are holding read locks.
 	 */
-	sigoff(self);
-	rwl_entry(rwlp)->rd_count = 0;
-	sigon(self);
+	rwl_forget(rwlp);
 	(void) memset(rwlp, 0, sizeof (*rwlp));
 	rwlp->rwlock_type = (uint16_t)type;
 	rwlp->rwlock_magic = RWL_MAGIC;
-	rwlp->mutex.mutex_type = (uint8_t)type;
+	rwlp->mutex.mutex_type = (uint8_t)(type & USYNC_PROCESS);
 	rwlp->mutex.mutex_flag = LOCK_INITED;
 	rwlp->mutex.mutex_magic = MUTEX_MAGIC;
 
@@ -238,15 +306,11 @@ rwlock_init(rwlock_t *rwlp, int type, void *arg)
 int
 rwlock_destroy(rwlock_t *rwlp)
 {
-	ulwp_t *self = curthread;
-
 	/*
 	 * Once destroyed, we can no longer be holding a read or write lock.
 	 * We can do nothing about other threads that are holding read locks.
 	 */
-	sigoff(self);
-	rwl_entry(rwlp)->rd_count = 0;
-	sigon(self);
+	rwl_forget(rwlp);
 	rwlp->rwlock_magic = 0;
 	tdb_sync_obj_deregister(rwlp);
 	return (0);
@@ -365,6 +429,201 @@ write_unlock_try(rwlock_t *rwlp)
 	return (0);
 }
 
+/*
+ * Spin for a while trying to acquire the rwlock before going to sleep,
+ * as mutex_trylock_adaptive() does for mutexes, using the same tunables.
+ * A writer holding the rwlock is worth waiting for only while it is
+ * running on a processor; readers cannot be seen, so for them we simply
+ * spin for the limited time.  Give up as soon as there are sleepers,
+ * since from then on the rwlock is handed to them by rw_queue_release().
+ * Return true on success.
+ */
+static int
+rwlock_spin(rwlock_t *rwlp, int rd_wr)
+{
+	volatile uint32_t *rwstate = (volatile uint32_t *)&rwlp->rwlock_readers;
+	ulwp_t *self = curthread;
+	volatile sc_shared_t *scp;
+	ulwp_t *ulwp;
+	uint32_t readers;
+	int count;
+	int max_count;
+
+	if (ncpus == 0)
+		ncpus = (int)_sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus == 1 || self->ul_max_spinners == 0 ||
+	    (max_count = self->ul_adaptive_spin) == 0)
+		return (0);
+
+	for (count = 0; count < max_count; count++) {
+		readers = *rwstate;
+		if (readers & URW_HAS_WAITERS)
+			break;
+		if (readers & URW_WRITE_LOCKED) {
+			/*
+			 * As in mutex_trylock_adaptive(), the owner's ulwp_t
+			 * and schedctl data are never freed, so the worst we
+			 * can do here is look at the wrong thread's state.
+			 * We cannot see a thread in another process.
+			 */
+			if ((ulwp = (ulwp_t *)rwlp->rwlock_owner) != NULL &&
+			    (!(rwlp->rwlock_type & USYNC_PROCESS) ||
+			    rwlp->rwlock_ownerpid == self->ul_uberdata->pid) &&
+			    ((scp = ulwp->ul_schedctl) == NULL ||
+			    scp->sc_state != SC_ONPROC))
+				break;
+		} else if (rd_wr == READ_LOCK) {
+			if (read_lock_try(rwlp, 0))
+				return (1);
+		} else if ((readers & URW_READERS_MASK) == 0) {
+			if (write_lock_try(rwlp, 0))
+				return (1);
+		}
+		SMT_PAUSE();
+	}
+	return (0);
+}
+
+static uint_t
+rw_bias_slot(rwlock_t *rwlp, ulwp_t *self)
+{
+	uintptr_t hash = (uintptr_t)rwlp >> 4;
+
+	/* threads reading the same rwlock use different cache lines */
+	hash ^= hash >> 12;
+	return ((uint_t)(hash + self->ul_lwpid * 17) & (RW_BIAS_SLOTS - 1));
+}
+
+/*
+ * Attempt to acquire a readers lock on a biased reader-scalable rwlock
+ * through rw_bias_table.  Return true on success, with rd_count set up
+ * for the first hold; the caller must not count it again.
+ */
+static int
+read_lock_biased(rwlock_t *rwlp)
+{
+	rwlock_t *volatile *table = rw_bias_table;
+	ulwp_t *self = curthread;
+	uint_t slot;
+
+	if (table == NULL || rwlp->rwlock_bias == 0)
+		return (0);
+	slot = rw_bias_slot(rwlp, self);
+	if (table[slot] != NULL)
+		return (0);
+
+	sigoff(self);
+	if (atomic_cas_ptr(&table[slot], NULL, rwlp) == NULL) {
+		/* publish the slot before checking the bias again */
+		membar_enter();
+		if (rwlp->rwlock_bias != 0) {
+			rwl_entry(rwlp)->rd_count =
+			    RD_BIASED | (slot << RD_SLOT_SHIFT) | 1;
+			sigon(self);
+			return (1);
+		}
+		/* a writer has revoked the bias */
+		table[slot] = NULL;
+	}
+	sigon(self);
+	return (0);
+}
+
+/*
+ * Release a readers lock that we might hold through rw_bias_table.
+ * Return true if we did.
+ */
+static int
+read_unlock_biased(rwlock_t *rwlp)
+{
+	ulwp_t *self = curthread;
+	readlock_t *readlockp;
+	size_t rd_count;
+	int rval = 0;
+
+	sigoff(self);
+	readlockp = rwl_entry(rwlp);
+	if ((rd_count = readlockp->rd_count) & RD_BIASED) {
+		rval = 1;
+		if ((--rd_count & RD_COUNT_MASK) == 0) {
+			readlockp->rd_count = 0;
+			membar_exit();
+			rd_count &= ~RD_BIASED;
+			rw_bias_table[rd_count >> RD_SLOT_SHIFT] = NULL;
+		} else {
+			readlockp->rd_count = rd_count;
+		}
+	}
+	sigon(self);
+	return (rval);
+}
+
+/*
+ * A reader has acquired a reader-scalable rwlock in the ordinary way.
+ * Set the bias towards readers again, unless that is still inhibited.
+ */
+static void
+rw_bias_enable(rwlock_t *rwlp)
+{
+	rwlock_t **table;
+
+	if (rwlp->rwlock_bias != 0 ||
+	    gethrtime() < (hrtime_t)rwlp->rwlock_bias_inhibit)
+		return;
+
+	if (rw_bias_table == NULL) {
+		if ((table = lmalloc(RW_BIAS_SLOTS * sizeof (rwlock_t *))) ==
+		    NULL)
+			return;
+		if (atomic_cas_ptr(&rw_bias_table, NULL, table) != NULL)
+			lfree(table, RW_BIAS_SLOTS * sizeof (rwlock_t *));
+	}
+	rwlp->rwlock_bias = 1;
+}
+
+/*
+ * We have acquired the writer lock on a biased reader-scalable rwlock.
+ * Revoke the bias and wait for the readers holding it through
+ * rw_bias_table to release it.  If 'try' is set, return EBUSY rather than
+ * waiting when there are any such readers.
+ *
+ * The waiting cannot be bounded by a timed wrlock's timeout, but readers
+ * are not allowed back in through the table while we wait.
+ */
+static int
+rw_bias_revoke(rwlock_t *rwlp, int try)
+{
+	rwlock_t *volatile *table = rw_bias_table;
+	ulwp_t *self = curthread;
+	hrtime_t start;
+	hrtime_t end;
+	uint_t slot;
+	int count;
+	int error = 0;
+
+	rwlp->rwlock_bias = 0;
+	/* clear the bias before looking at the slots */
+	membar_enter();
+	start = gethrtime();
+	for (slot = 0; slot < RW_BIAS_SLOTS && error == 0; slot++) {
+		for (count = 0; table[slot] == rwlp; count++) {
+			if (try) {
+				error = EBUSY;
+				break;
+			}
+			if (count < self->ul_adaptive_spin)
+				SMT_PAUSE();
+			else
+				yield();
+		}
+	}
+	/* the readers' critical sections happen before ours */
+	membar_enter();
+	end = gethrtime();
+	rwlp->rwlock_bias_inhibit = end + (end - start) * RW_BIAS_INHIBIT;
+	return (error);
+}
+
 /*
  * Release a process-private rwlock and wake up any thread(s) sleeping on it.
  * This is called when a thread releases a lock that appears to have waiters.
@@ -489,15 +748,52 @@ rw_queue_release(rwlock_t *rwlp)
 		(void) munmap((caddr_t)lwpid, maxlwps * sizeof (lwpid_t));
 }
 
+/*
+ * Release a process-shared rwlock that has waiters.
+ * If it is now free, clear the waiters flag and wake up all of the waiters.
+ */
+static void
+shared_rwlock_release(rwlock_t *rwlp)
+{
+	volatile uint32_t *rwstate = (volatile uint32_t *)&rwlp->rwlock_readers;
+	uint32_t readers;
+	uint32_t new;
+
+	(void) mutex_lock(&rwlp->mutex);
+	do {
+		readers = *rwstate;
+		ASSERT_CONSISTENT_STATE(readers);
+		if (readers & URW_WRITE_LOCKED)
+			new = 0;
+		else if (((new = readers - 1) & URW_READERS_MASK) == 0)
+			new = 0;
+	} while (atomic_cas_32(rwstate, readers, new) != readers);
+	(void) mutex_unlock(&rwlp->mutex);
+
+	if (new == 0)
+		(void) __lwp_addr_wake(rwstate, UINT32_MAX, USYNC_PROCESS);
+}
+
+/*
+ * Process-shared (USYNC_PROCESS) rwlocks are implemented at user level.
+ * The rwlock's mutex stands in for the queue lock of process-private
+ * rwlocks: holding it and having set URW_HAS_WAITERS in the rwstate word
+ * guarantees that no one can release the lock without also acquiring the
+ * mutex.  Waiters sleep on the rwstate word itself with __lwp_addr_wait()
+ * and shared_rwlock_release() wakes them all when the lock becomes free;
+ * they then compete for it anew.
+ */
+static int
+shared_lock_try(rwlock_t *rwlp, int rd_wr)
+{
+	if (rd_wr == READ_LOCK)
+		return (read_lock_try(rwlp, 1));
+	return (write_lock_try(rwlp, 1));
+}
+
 /*
  * Common code for rdlock, timedrdlock, wrlock, timedwrlock, tryrdlock,
  * and trywrlock for process-shared (USYNC_PROCESS) rwlocks.
- *
- * Note: if the lock appears to be contended we call __lwp_rwlock_rdlock()
- * or __lwp_rwlock_wrlock() holding the mutex. These return with the mutex
- * released, and if they need to sleep will release the mutex first. In the
- * event of a spurious wakeup, these will return EAGAIN (because it is much
- * easier for us to re-acquire the mutex here).
  */
 int
 shared_rwlock_lock(rwlock_t *rwlp, timespec_t *tsp, int rd_wr)
@@ -523,43 +819,30 @@ shared_rwlock_lock(rwlock_t *rwlp, timespec_t *tsp, int rd_wr)
 		}
 		if ((error = mutex_lock(mp)) != 0)
 			break;
-		if (rd_wr == READ_LOCK) {
-			if (read_lock_try(rwlp, 0)) {
-				(void) mutex_unlock(mp);
-				break;
-			}
-		} else {
-			if (write_lock_try(rwlp, 0)) {
-				(void) mutex_unlock(mp);
-				break;
-			}
+		if (shared_lock_try(rwlp, rd_wr)) {
+			(void) mutex_unlock(mp);
+			break;
+		}
+		if (try_flag) {
+			(void) mutex_unlock(mp);
+			error = EBUSY;
+			break;
 		}
-		atomic_or_32(rwstate, URW_HAS_WAITERS);
-		readers = *rwstate;
-		ASSERT_CONSISTENT_STATE(readers);
-		/*
-		 * The calls to __lwp_rwlock_*() below will release the mutex,
-		 * so we need a dtrace probe here.  The owner field of the
-		 * mutex is cleared in the kernel when the mutex is released,
-		 * so we should not clear it here.
-		 */
-		DTRACE_PROBE2(plockstat, mutex__release, mp, 0);
 		/*
-		 * The waiters bit may be inaccurate.
-		 * Only the kernel knows for sure.
+		 * Once the waiters flag is set, the lock cannot be released
+		 * without the mutex, so try once more before going to sleep.
 		 */
-		if (rd_wr == READ_LOCK) {
-			if (try_flag)
-				error = __lwp_rwlock_tryrdlock(rwlp);
-			else
-				error = __lwp_rwlock_rdlock(rwlp, tsp);
-		} else {
-			if (try_flag)
-				error = __lwp_rwlock_trywrlock(rwlp);
-			else
-				error = __lwp_rwlock_wrlock(rwlp, tsp);
+		atomic_or_32(rwstate, URW_HAS_WAITERS);
+		if (shared_lock_try(rwlp, rd_wr)) {
+			(void) mutex_unlock(mp);
+			break;
 		}
-	} while (error == EAGAIN || error == EINTR);
+		readers = *rwstate;
+		ASSERT_CONSISTENT_STATE(readers);
+		(void) mutex_unlock(mp);
+		error = __lwp_addr_wait(rwstate, readers, tsp,
+		    USYNC_PROCESS, 0);
+	} while (error == 0 || error == EAGAIN || error == EINTR);
 
 	if (!try_flag) {
 		DTRACE_PROBE3(plockstat, rw__blocked, rwlp, rd_wr, error == 0);
@@ -710,6 +993,7 @@ rw_rdlock_impl(rwlock_t *rwlp, timespec_t *tsp)
 	uberdata_t *udp = self->ul_uberdata;
 	readlock_t *readlockp;
 	tdb_rwlock_stats_t *rwsp = RWLOCK_STATS(rwlp, udp);
+	int scalable = RW_SCALABLE(rwlp);
 	int error;
 
 	/*
@@ -719,7 +1003,7 @@ rw_rdlock_impl(rwlock_t *rwlp, timespec_t *tsp)
 	sigoff(self);
 	readlockp = rwl_entry(rwlp);
 	if (readlockp->rd_count != 0) {
-		if (readlockp->rd_count == READ_LOCK_MAX) {
+		if ((readlockp->rd_count & RD_COUNT_MASK) == READ_LOCK_MAX) {
 			sigon(self);
 			error = EAGAIN;
 			goto out;
@@ -741,18 +1025,28 @@ rw_rdlock_impl(rwlock_t *rwlp, timespec_t *tsp)
 		goto out;
 	}
 
-	if (read_lock_try(rwlp, 0))
+	if (scalable && read_lock_biased(rwlp)) {
+		readlockp = NULL;	/* already counted */
+		error = 0;
+		goto out;
+	}
+
+	if (read_lock_try(rwlp, 0) || rwlock_spin(rwlp, READ_LOCK))
 		error = 0;
 	else if (rwlp->rwlock_type == USYNC_PROCESS)	/* kernel-level */
 		error = shared_rwlock_lock(rwlp, tsp, READ_LOCK);
 	else						/* user-level */
 		error = rwlock_lock(rwlp, tsp, READ_LOCK);
+	if (error == 0 && scalable)
+		rw_bias_enable(rwlp);
 
 out:
 	if (error == 0) {
-		sigoff(self);
-		rwl_entry(rwlp)->rd_count++;
-		sigon(self);
+		if (readlockp != NULL) {
+			sigoff(self);
+			rwl_entry(rwlp)->rd_count++;
+			sigon(self);
+		}
 		if (rwsp)
 			tdb_incr(rwsp->rw_rdlock);
 		DTRACE_PROBE2(plockstat, rw__acquire, rwlp, READ_LOCK);
@@ -838,12 +1132,14 @@ rw_wrlock_impl(rwlock_t *rwlp, timespec_t *tsp)
 		goto out;
 	}
 
-	if (write_lock_try(rwlp, 0))
+	if (write_lock_try(rwlp, 0) || rwlock_spin(rwlp, WRITE_LOCK))
 		error = 0;
 	else if (rwlp->rwlock_type == USYNC_PROCESS)	/* kernel-level */
 		error = shared_rwlock_lock(rwlp, tsp, WRITE_LOCK);
 	else						/* user-level */
 		error = rwlock_lock(rwlp, tsp, WRITE_LOCK);
+	if (error == 0 && RW_SCALABLE(rwlp) && rwlp->rwlock_bias != 0)
+		(void) rw_bias_revoke(rwlp, 0);
 
 out:
 	if (error == 0) {
@@ -927,7 +1223,7 @@ rw_tryrdlock(rwlock_t *rwlp)
 	sigoff(self);
 	readlockp = rwl_entry(rwlp);
 	if (readlockp->rd_count != 0) {
-		if (readlockp->rd_count == READ_LOCK_MAX) {
+		if ((readlockp->rd_count & RD_COUNT_MASK) == READ_LOCK_MAX) {
 			sigon(self);
 			error = EAGAIN;
 			goto out;
@@ -938,7 +1234,10 @@ rw_tryrdlock(rwlock_t *rwlp)
 	}
 	sigon(self);
 
-	if (read_lock_try(rwlp, 0))
+	if (RW_SCALABLE(rwlp) && read_lock_biased(rwlp)) {
+		readlockp = NULL;	/* already counted */
+		error = 0;
+	} else if (read_lock_try(rwlp, 0))
 		error = 0;
 	else if (rwlp->rwlock_type == USYNC_PROCESS)	/* kernel-level */
 		error = shared_rwlock_lock(rwlp, NULL, READ_LOCK_TRY);
@@ -947,9 +1246,11 @@ rw_tryrdlock(rwlock_t *rwlp)
 
 out:
 	if (error == 0) {
-		sigoff(self);
-		rwl_entry(rwlp)->rd_count++;
-		sigon(self);
+		if (readlockp != NULL) {
+			sigoff(self);
+			rwl_entry(rwlp)->rd_count++;
+			sigon(self);
+		}
 		DTRACE_PROBE2(plockstat, rw__acquire, rwlp, READ_LOCK);
 	} else {
 		if (rwsp)
@@ -983,6 +1284,13 @@ rw_trywrlock(rwlock_t *rwlp)
 		error = shared_rwlock_lock(rwlp, NULL, WRITE_LOCK_TRY);
 	else						/* user-level */
 		error = rwlock_lock(rwlp, NULL, WRITE_LOCK_TRY);
+	if (error == 0 && RW_SCALABLE(rwlp) && rwlp->rwlock_bias != 0 &&
+	    rw_bias_revoke(rwlp, 1) != 0) {
+		/* readers hold it through rw_bias_table; let go again */
+		if (!write_unlock_try(rwlp))
+			rw_queue_release(rwlp);
+		error = EBUSY;
+	}
 
 	if (error == 0) {
 		rwlp->rwlock_owner = (uintptr_t)self;
@@ -1014,6 +1322,15 @@ rw_unlock(rwlock_t *rwlp)
 	tdb_rwlock_stats_t *rwsp;
 	int rd_wr;
 
+	/*
+	 * A read lock held through rw_bias_table is not seen in rwstate,
+	 * which may even show a writer waiting in rw_bias_revoke().
+	 */
+	if (RW_SCALABLE(rwlp) && read_unlock_biased(rwlp)) {
+		rd_wr = READ_LOCK;
+		goto out;
+	}
+
 	readers = *rwstate;
 	ASSERT_CONSISTENT_STATE(readers);
 	if (readers & URW_WRITE_LOCKED) {
@@ -1064,7 +1381,7 @@ rw_unlock(rwlock_t *rwlp)
 		 * If we hold more than one readers lock on this rwlock,
 		 * just decrement our reference count and return.
 		 */
-		if (--readlockp->rd_count != 0) {
+		if ((--readlockp->rd_count & RD_COUNT_MASK) != 0) {
 			sigon(self);
 			goto out;
 		}
@@ -1084,9 +1401,7 @@ rw_unlock(rwlock_t *rwlp)
 	} else if (rd_wr == READ_LOCK && read_unlock_try(rwlp)) {
 		/* EMPTY */;
 	} else if (rwlp->rwlock_type == USYNC_PROCESS) {
-		(void) mutex_lock(&rwlp->mutex);
-		(void) __lwp_rwlock_unlock(rwlp);
-		(void) mutex_unlock(&rwlp->mutex);
+		shared_rwlock_release(rwlp);
 	} else {
 		rw_queue_release(rwlp);
 	}
@@ -31,6 +31,34 @@
 
 static uint32_t _semvaluemax;
 
+/*
+ * Semaphores are implemented entirely at user level, for both USYNC_THREAD
+ * and USYNC_PROCESS semaphores.  The count is manipulated with atomic
+ * operations and threads that find it zero sleep on the count word itself
+ * with __lwp_addr_wait().  The number of such threads is kept in the
+ * otherwise unused data word of the semaphore so that sema_post() need
+ * enter the kernel only when someone might be waiting.  The kernel sleep
+ * queue provides the FIFO ordering among waiters of equal priority that
+ * SUSV3 requires.
+ */
+#define	sema_nwaiters(lsp)	(*(volatile uint32_t *)&(lsp)->data)
+
+/*
+ * Decrement the count if it is non-zero.  Return EBUSY if it is zero.
+ */
+static int
+sema_trydec(lwp_sema_t *lsp)
+{
+	volatile uint32_t *countp = &lsp->count;
+	uint32_t count;
+
+	while ((count = *countp) != 0) {
+		if (atomic_cas_32(countp, count, count - 1) == count)
+			return (0);
+	}
+	return (EBUSY);
+}
+
 /*
  * Check to see if anyone is waiting for this semaphore.
  */
@@ -114,68 +142,29 @@ sema_wait_impl(sema_t *sp, timespec_t *tsp)
 			begin_sleep = 0;
 	}
 
-	if (lsp->type == USYNC_PROCESS) {		/* kernel-level */
-		set_parking_flag(self, 1);
-		if (self->ul_cursig != 0 ||
-		    (self->ul_cancelable && self->ul_cancel_pending))
-			set_parking_flag(self, 0);
-		/* the kernel always does FIFO queueing */
-		error = ___lwp_sema_timedwait(lsp, tsp, 1);
-		set_parking_flag(self, 0);
-	} else if (!udp->uberflags.uf_mt &&		/* single threaded */
-	    lsp->count != 0) {				/* and non-blocking */
+	if (sema_trydec(lsp) != 0) {
 		/*
-		 * Since we are single-threaded, we don't need the
-		 * protection of queue_lock().  However, we do need
-		 * to block signals while modifying the count.
+		 * Register as a waiter before looking at the count again,
+		 * so that a sema_post() that we fail to see will see us.
 		 */
-		sigoff(self);
-		lsp->count--;
-		sigon(self);
-	} else {				/* multithreaded or blocking */
-		queue_head_t *qp;
-		ulwp_t *ulwp;
-		lwpid_t lwpid = 0;
-
-		qp = queue_lock(lsp, CV);
-		while (error == 0 && lsp->count == 0) {
-			/*
-			 * SUSV3 requires FIFO queueing for semaphores,
-			 * at least for SCHED_FIFO and SCHED_RR scheduling.
-			 */
-			enqueue(qp, self, 1);
-			lsp->sema_waiters = 1;
+		atomic_inc_32(&sema_nwaiters(lsp));
+		while (error == 0 && sema_trydec(lsp) != 0) {
 			set_parking_flag(self, 1);
-			queue_unlock(qp);
 			/*
-			 * We may have received SIGCANCEL before we
-			 * called queue_lock().  If so and we are
-			 * cancelable we should return EINTR.
+			 * We may have received SIGCANCEL before we set
+			 * the parking flag.  If so and we are cancelable
+			 * we should return EINTR.
 			 */
 			if (self->ul_cursig != 0 ||
 			    (self->ul_cancelable && self->ul_cancel_pending))
 				set_parking_flag(self, 0);
-			error = __lwp_park(tsp, 0);
+			error = __lwp_addr_wait(&lsp->count, 0, tsp,
+			    lsp->type, 1);
 			set_parking_flag(self, 0);
-			qp = queue_lock(lsp, CV);
-			if (self->ul_sleepq)	/* timeout or spurious wakeup */
-				lsp->sema_waiters = dequeue_self(qp);
-		}
-		if (error == 0)
-			lsp->count--;
-		if (lsp->count != 0 && lsp->sema_waiters) {
-			int more;
-			if ((ulwp = dequeue(qp, &more)) != NULL) {
-				no_preempt(self);
-				lwpid = ulwp->ul_lwpid;
-			}
-			lsp->sema_waiters = more;
-		}
-		queue_unlock(qp);
-		if (lwpid) {
-			(void) __lwp_unpark(lwpid);
-			preempt(self);
+			if (error == EAGAIN)	/* the count changed; retry */
+				error = 0;
 		}
+		atomic_dec_32(&sema_nwaiters(lsp));
 	}
 
 	self->ul_wchan = NULL;
@@ -241,37 +230,7 @@ sema_trywait(sema_t *sp)
 	if (ssp)
 		tdb_incr(ssp->sema_trywait);
 
-	if (lsp->type == USYNC_PROCESS) {	/* kernel-level */
-		error = _lwp_sema_trywait(lsp);
-	} else if (!udp->uberflags.uf_mt) {	/* single threaded */
-		sigoff(self);
-		if (lsp->count == 0)
-			error = EBUSY;
-		else
-			lsp->count--;
-		sigon(self);
-	} else {				/* multithreaded */
-		queue_head_t *qp;
-		ulwp_t *ulwp;
-		lwpid_t lwpid = 0;
-
-		qp = queue_lock(lsp, CV);
-		if (lsp->count == 0)
-			error = EBUSY;
-		else if (--lsp->count != 0 && lsp->sema_waiters) {
-			int more;
-			if ((ulwp = dequeue(qp, &more)) != NULL) {
-				no_preempt(self);
-				lwpid = ulwp->ul_lwpid;
-			}
-			lsp->sema_waiters = more;
-		}
-		queue_unlock(qp);
-		if (lwpid) {
-			(void) __lwp_unpark(lwpid);
-			preempt(self);
-		}
-	}
+	error = sema_trydec(lsp);
 
 	if (error == 0) {
 		if (ssp) {
@@ -300,6 +259,7 @@ sema_post(sema_t *sp)
 	ulwp_t *self = curthread;
 	uberdata_t *udp = self->ul_uberdata;
 	tdb_sema_stats_t *ssp = SEMA_STATS(sp, udp);
+	volatile uint32_t *countp = &lsp->count;
 	uint_t count;
 	int error = 0;
 
@@ -308,36 +268,23 @@ sema_post(sema_t *sp)
 	if (_semvaluemax == 0)
 		_semvaluemax = (uint32_t)_sysconf(_SC_SEM_VALUE_MAX);
 
-	if (lsp->type == USYNC_PROCESS) {	/* kernel-level */
-		error = _lwp_sema_post(lsp);
-	} else if (!udp->uberflags.uf_mt) {	/* single threaded */
-		sigoff(self);
-		if (lsp->count >= _semvaluemax)
-			error = EOVERFLOW;
-		else
-			lsp->count++;
-		sigon(self);
-	} else {				/* multithreaded */
-		queue_head_t *qp;
-		ulwp_t *ulwp;
-		lwpid_t lwpid = 0;
-
-		qp = queue_lock(lsp, CV);
-		if (lsp->count >= _semvaluemax)
+	do {
+		if ((count = *countp) >= _semvaluemax) {
 			error = EOVERFLOW;
-		else if (lsp->count++ == 0 && lsp->sema_waiters) {
-			int more;
-			if ((ulwp = dequeue(qp, &more)) != NULL) {
-				no_preempt(self);
-				lwpid = ulwp->ul_lwpid;
-			}
-			lsp->sema_waiters = more;
-		}
-		queue_unlock(qp);
-		if (lwpid) {
-			(void) __lwp_unpark(lwpid);
-			preempt(self);
+			break;
 		}
+	} while (atomic_cas_32(countp, count, count + 1) != count);
+
+	/*
+	 * Every post wakes one waiter, if there is one; a waiter that
+	 * loses the race for the count to another thread simply sleeps
+	 * again.  The atomic_cas_32() above orders our look at the
+	 * waiter count after the store to the semaphore count.
+	 */
+	if (error == 0 && sema_nwaiters(lsp) != 0) {
+		no_preempt(self);	/* ensure a prompt wakeup */
+		(void) __lwp_addr_wake(&lsp->count, 1, lsp->type);
+		preempt(self);
 	}
 
 	if (error == 0) {
@@ -103,6 +103,12 @@ spawn_closefrom(int lowfd, void *buf)
 	if (lowfd <  0)
 		lowfd = 0;
 
+	/*
+	 * The kernel can do it all in one go, without /proc.
+	 */
+	if (__fcntl(lowfd, F_CLOSEFROM, 0) == 0)
+		return (0);
+
 	/*
 	 * Close lowfd right away as a hedge against failing
 	 * to open the /proc file descriptor directory due
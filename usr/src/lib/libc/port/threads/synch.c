@@ -1048,6 +1048,109 @@ mutex_lock_kernel(mutex_t *mp, timespec_t *tsp, tdb_mutex_stats_t *msp)
 	return (error);
 }
 
+/*
+ * Process-shared mutexes that are neither robust nor priority-inheriting
+ * are waited for at user level: contending threads sleep on the lock word
+ * itself with __lwp_addr_wait() instead of calling ___lwp_mutex_timedlock().
+ * The kernel must know the state of the other kinds of process-shared mutex
+ * to implement their semantics.  Everything that blocks on or releases such
+ * a mutex, including cond_wait(), must agree on which kind it is.
+ */
+static int
+mutex_on_lockword(mutex_t *mp)
+{
+	if ((mp->mutex_type & (USYNC_PROCESS | LOCK_ROBUST | LOCK_PRIO_INHERIT))
+	    != USYNC_PROCESS)
+		return (0);
+#if defined(__sparc) && !defined(_LP64)
+	/* horrible hack, necessary only on 32-bit sparc */
+	if (((uintptr_t)mp & (_LONG_LONG_ALIGNMENT - 1)) &&
+	    curthread->ul_misaligned)
+		return (0);
+#endif
+	return (1);
+}
+
+/*
+ * Like mutex_lock_kernel(), but for the mutexes described above.
+ * A thread that has slept always takes the lock with the waiters byte
+ * set, since it cannot know whether others are still asleep; the cost
+ * is at most one unnecessary wakeup call when the lock is released.
+ * Returns with mutex_owner and mutex_ownerpid set correctly.
+ */
+static int
+mutex_lock_lockword(mutex_t *mp, timespec_t *tsp, tdb_mutex_stats_t *msp)
+{
+	ulwp_t *self = curthread;
+	uberdata_t *udp = self->ul_uberdata;
+	volatile uint64_t *lockp = (volatile uint64_t *)&mp->mutex_lockword64;
+	volatile uint32_t *lockwp = (volatile uint32_t *)&mp->mutex_lockword;
+	uint64_t old;
+	uint64_t new;
+	uint32_t lockword;
+	hrtime_t begin_sleep;
+	int error;
+
+	self->ul_sp = stkptr();
+	self->ul_wchan = mp;
+	if (__td_event_report(self, TD_SLEEP, udp)) {
+		self->ul_td_evbuf.eventnum = TD_SLEEP;
+		self->ul_td_evbuf.eventdata = mp;
+		tdb_event(TD_SLEEP, udp);
+	}
+	if (msp) {
+		tdb_incr(msp->mutex_sleep);
+		begin_sleep = gethrtime();
+	}
+
+	DTRACE_PROBE1(plockstat, mutex__block, mp);
+
+	for (;;) {
+		lockword = *lockwp;
+		if ((lockword & LOCKMASK) == 0) {
+			old = *lockp & ~LOCKMASK64;
+			new = old | ((uint64_t)(uint_t)udp->pid << PIDSHIFT) |
+			    LOCKBYTE64 | WAITER64;
+			if (atomic_cas_64(lockp, old, new) == old) {
+				error = 0;
+				break;
+			}
+			continue;
+		}
+		if ((lockword & WAITERMASK) == 0) {
+			if (atomic_cas_32(lockwp, lockword, lockword | WAITER)
+			    != lockword)
+				continue;
+			lockword |= WAITER;
+		}
+		/*
+		 * EAGAIN means that the lock word changed before we could
+		 * go to sleep.  Mutex waits are not interruptible.
+		 */
+		error = __lwp_addr_wait(lockwp, lockword, tsp,
+		    USYNC_PROCESS, 0);
+		if (error != 0 && error != EAGAIN && error != EINTR)
+			break;
+	}
+
+	if (msp)
+		msp->mutex_sleep_time += gethrtime() - begin_sleep;
+	self->ul_wchan = NULL;
+	self->ul_sp = 0;
+
+	if (error == 0) {
+		mp->mutex_owner = (uintptr_t)self;
+		/* mp->mutex_ownerpid was set by the atomic_cas_64() */
+		DTRACE_PROBE2(plockstat, mutex__blocked, mp, 1);
+		DTRACE_PROBE3(plockstat, mutex__acquire, mp, 0, 0);
+	} else {
+		DTRACE_PROBE2(plockstat, mutex__blocked, mp, 0);
+		DTRACE_PROBE2(plockstat, mutex__error, mp, error);
+	}
+
+	return (error);
+}
+
 /*
  * Common code for calling the ___lwp_mutex_trylock() system call.
  * Returns with mutex_owner and mutex_ownerpid set correctly.
@@ -1755,6 +1858,35 @@ mutex_unlock_process(mutex_t *mp, int release_all)
 		return;
 	}
 #endif
+	if (mutex_on_lockword(mp)) {
+		volatile uint64_t *lockp =
+		    (volatile uint64_t *)&mp->mutex_lockword64;
+		uint64_t new_lockword64;
+
+		/*
+		 * Clear the lock byte and the mutex_ownerpid.  If there are
+		 * no spinners, also clear the waiters byte and wake up one
+		 * waiter, which sets it again when it takes the lock.
+		 * If there are spinners, one of them will take the lock
+		 * with the waiters byte intact and do the wakeup later.
+		 */
+		do {
+			old_lockword64 = *lockp;
+			new_lockword64 = old_lockword64 & ~LOCKMASK64;
+			if ((old_lockword64 & SPINNERMASK64) == 0)
+				new_lockword64 &= ~WAITERMASK64;
+		} while (atomic_cas_64(lockp, old_lockword64,
+		    new_lockword64) != old_lockword64);
+		if ((old_lockword64 & WAITERMASK64) &&
+		    (old_lockword64 & SPINNERMASK64) == 0) {
+			no_preempt(self);	/* ensure a prompt wakeup */
+			(void) __lwp_addr_wake(&mp->mutex_lockword, 1,
+			    USYNC_PROCESS);
+			preempt(self);
+		}
+		sigon(self);
+		return;
+	}
 	/* mp->mutex_ownerpid is cleared by clear_lockbyte64() */
 	old_lockword64 = clear_lockbyte64(&mp->mutex_lockword64);
 	if ((old_lockword64 & WAITERMASK64) &&
@@ -2136,8 +2268,12 @@ mutex_lock_internal(mutex_t *mp, timespec_t *tsp, int try)
 		}
 	} else if (mtype & USYNC_PROCESS) {
 		error = mutex_trylock_process(mp, try == MUTEX_LOCK);
-		if (error == EBUSY && try == MUTEX_LOCK)
-			error = mutex_lock_kernel(mp, tsp, msp);
+		if (error == EBUSY && try == MUTEX_LOCK) {
+			if (mutex_on_lockword(mp))
+				error = mutex_lock_lockword(mp, tsp, msp);
+			else
+				error = mutex_lock_kernel(mp, tsp, msp);
+		}
 	} else {	/* USYNC_THREAD */
 		error = mutex_trylock_adaptive(mp, try == MUTEX_LOCK);
 		if (error == EBUSY && try == MUTEX_LOCK)
@@ -2214,6 +2350,8 @@ fast_process_lock(mutex_t *mp, timespec_t *tsp, int mtype, int try)
 	if (try == MUTEX_LOCK) {
 		if (mutex_trylock_process(mp, 1) == 0)
 			return (0);
+		if (mutex_on_lockword(mp))
+			return (mutex_lock_lockword(mp, tsp, NULL));
 		return (mutex_lock_kernel(mp, tsp, NULL));
 	}
 
@@ -3387,6 +3525,60 @@ cond_sleep_kernel(cond_t *cvp, mutex_t *mp, timespec_t *tsp)
 	return (error);
 }
 
+/*
+ * When the mutex is one that is waited for on its lock word (see
+ * mutex_on_lockword()), the kernel must not be the one to release it,
+ * so the condvar is waited for at user level as well.  Its data word
+ * holds a wakeup sequence number and a count of such waiters, and the
+ * waiters sleep on the sequence number with __lwp_addr_wait().
+ * cond_signal() and cond_broadcast() advance the sequence number before
+ * waking anyone, so a waiter that has sampled it and released the mutex
+ * cannot miss a wakeup.
+ */
+#define	cond_seq(cvp)		(((volatile uint32_t *)&(cvp)->data)[0])
+#define	cond_nwaiters(cvp)	(((volatile uint32_t *)&(cvp)->data)[1])
+
+/*
+ * cond_sleep_lockword(): utility function for cond_wait_kernel().
+ * See the comment ahead of cond_sleep_queue(), above.
+ */
+static int
+cond_sleep_lockword(cond_t *cvp, mutex_t *mp, timespec_t *tsp)
+{
+	int mtype = mp->mutex_type;
+	ulwp_t *self = curthread;
+	uint32_t seq;
+	int error;
+
+	if ((mtype & LOCK_PRIO_PROTECT) && _ceil_mylist_del(mp))
+		_ceil_prio_waive();
+
+	self->ul_sp = stkptr();
+	self->ul_wchan = cvp;
+	sigoff(self);
+	atomic_inc_32(&cond_nwaiters(cvp));
+	seq = cond_seq(cvp);
+	mutex_unlock_process(mp, 0);
+	/*
+	 * As with ___lwp_cond_wait(), __lwp_addr_wait() returns
+	 * immediately with EINTR if set_parking_flag(self,0) is
+	 * called on this lwp before it goes to sleep in the kernel.
+	 */
+	set_parking_flag(self, 1);
+	if (self->ul_cursig != 0 ||
+	    (self->ul_cancelable && self->ul_cancel_pending))
+		set_parking_flag(self, 0);
+	error = __lwp_addr_wait(&cond_seq(cvp), seq, tsp, cvp->cond_type, 1);
+	set_parking_flag(self, 0);
+	atomic_dec_32(&cond_nwaiters(cvp));
+	sigon(self);
+	self->ul_sp = 0;
+	self->ul_wchan = NULL;
+	if (error == EAGAIN)	/* we were signalled before we could sleep */
+		error = 0;
+	return (error);
+}
+
 int
 cond_wait_kernel(cond_t *cvp, mutex_t *mp, timespec_t *tsp)
 {
@@ -3403,7 +3595,10 @@ cond_wait_kernel(cond_t *cvp, mutex_t *mp, timespec_t *tsp)
 	if (self->ul_cond_wait_defer)
 		sigoff(self);
 
-	error = cond_sleep_kernel(cvp, mp, tsp);
+	if (mutex_on_lockword(mp))
+		error = cond_sleep_lockword(cvp, mp, tsp);
+	else
+		error = cond_sleep_kernel(cvp, mp, tsp);
 
 	/*
 	 * Override the return code from ___lwp_cond_wait()
@@ -3710,6 +3905,11 @@ cond_signal(cond_t *cvp)
 	if (csp)
 		tdb_incr(csp->cond_signal);
 
+	if (cond_nwaiters(cvp)) {	/* someone in cond_sleep_lockword()? */
+		atomic_inc_32(&cond_seq(cvp));
+		(void) __lwp_addr_wake(&cond_seq(cvp), 1, cvp->cond_type);
+	}
+
 	if (cvp->cond_waiters_kernel)	/* someone sleeping in the kernel? */
 		error = _lwp_cond_signal(cvp);
 
@@ -3843,6 +4043,12 @@ cond_broadcast(cond_t *cvp)
 	if (csp)
 		tdb_incr(csp->cond_broadcast);
 
+	if (cond_nwaiters(cvp)) {	/* someone in cond_sleep_lockword()? */
+		atomic_inc_32(&cond_seq(cvp));
+		(void) __lwp_addr_wake(&cond_seq(cvp), UINT32_MAX,
+		    cvp->cond_type);
+	}
+
 	if (cvp->cond_waiters_kernel)	/* someone sleeping in the kernel? */
 		error = _lwp_cond_broadcast(cvp);
 
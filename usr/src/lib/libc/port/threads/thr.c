@@ -778,6 +778,7 @@ _thrp_exit()
 	tmem_exit();		/* deallocate tmem allocations */
 	tsd_exit();		/* deallocate thread-specific data */
 	tls_exit();		/* deallocate thread-local storage */
+	tmalloc_exit();		/* give back cached malloc() blocks */
 	heldlock_exit();	/* deal with left-over held locks */
 
 	/* block all signals to finish exiting */
@@ -1177,6 +1178,8 @@ etest(const char *ev)
 		thread_door_noreserve = value;
 	if ((value = envvar(ev, "LOCKS_MISALIGNED", 1)) >= 0)
 		thread_locks_misaligned = value;
+	if ((value = envvar(ev, "RWLOCK_SCALABLE", 1)) >= 0)
+		thread_rwlock_scalable = value;
 }
 
 /*
@@ -40,6 +40,12 @@ _tmem_get_base(void)
 	return ((uintptr_t)&curthread->ul_tmem - (uintptr_t)curthread);
 }
 
+void *
+_tmem_get(void)
+{
+	return (&curthread->ul_tmem);
+}
+
 int
 _tmem_get_nentries(void)
 {
@@ -361,6 +361,8 @@ static link_attr_t link_attr[] = {
 
 	{ MAC_PROP_LDECAY,	sizeof (uint32_t),	"learn_decay"},
 
+	{ MAC_PROP_LRO,		sizeof (uint32_t),	"lro"},
+
 	{ MAC_PROP_RESOURCE,	sizeof (mac_resource_props_t),	"resource"},
 
 	{ MAC_PROP_RESOURCE_EFF, sizeof (mac_resource_props_t),
@@ -716,6 +718,12 @@ static prop_desc_t	prop_table[] = {
 	    DATALINK_CLASS_PHYS|DATALINK_CLASS_AGGR|
 	    DATALINK_CLASS_ETHERSTUB|DATALINK_CLASS_SIMNET, DL_ETHER },
 
+	{ "lro", { "0", 0 },
+	    link_01_vals, VALCNT(link_01_vals),
+	    set_public_prop, NULL, get_binary, NULL, 0,
+	    DATALINK_CLASS_PHYS|DATALINK_CLASS_AGGR|
+	    DATALINK_CLASS_ETHERSTUB|DATALINK_CLASS_SIMNET, DL_ETHER },
+
 	{ "stp", { "1", 1 },
 	    link_01_vals, VALCNT(link_01_vals),
 	    set_stp_prop, NULL, get_stp, NULL, PD_AFTER_PERM,
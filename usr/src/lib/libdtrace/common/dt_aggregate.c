@@ -39,6 +39,7 @@
 #include <limits.h>
 
 #define	DTRACE_AHASHSIZE	32779		/* big 'ol prime */
+#define	DTRACE_AHASHLOAD	2		/* chain length to grow at */
 
 /*
  * Because qsort(3C) does not allow an argument to be passed to a comparison
@@ -428,6 +429,37 @@ dt_aggregate_aggvarid(dt_ahashent_t *ent)
 }
 
 
+/*
+ * Grow the aggregate hash table once its chains have become long, and rehash
+ * the entries into it.  High-cardinality aggregations (keyed on addresses,
+ * say) can have millions of entries, and a table of fixed size would leave
+ * every snapshot of every CPU walking chains of hundreds of them.  Failure to
+ * grow is not an error; we just carry on with the table that we have.
+ */
+static void
+dt_aggregate_hash_grow(dt_ahash_t *hash)
+{
+	size_t size = hash->dtah_size * 2 + 1, ndx;
+	dt_ahashent_t **tab, *h;
+
+	if ((tab = calloc(size, sizeof (dt_ahashent_t *))) == NULL)
+		return;
+
+	for (h = hash->dtah_all; h != NULL; h = h->dtahe_nextall) {
+		ndx = h->dtahe_hashval % size;
+		h->dtahe_prev = NULL;
+
+		if ((h->dtahe_next = tab[ndx]) != NULL)
+			tab[ndx]->dtahe_prev = h;
+
+		tab[ndx] = h;
+	}
+
+	free(hash->dtah_hash);
+	hash->dtah_hash = tab;
+	hash->dtah_size = size;
+}
+
 static int
 dt_aggregate_snap_cpu(dtrace_hdl_t *dtp, processorid_t cpu)
 {
@@ -535,10 +567,21 @@ dt_aggregate_snap_cpu(dtrace_hdl_t *dtp, processorid_t cpu)
 				break;
 			}
 
-			for (i = 0; i < rec->dtrd_size; i++)
-				hashval += addr[roffs + i];
+			/*
+			 * This is the same one-at-a-time hash that the kernel
+			 * uses for its aggregation buffers.
+			 */
+			for (i = 0; i < rec->dtrd_size; i++) {
+				hashval += (uchar_t)addr[roffs + i];
+				hashval += (hashval << 10);
+				hashval ^= (hashval >> 6);
+			}
 		}
 
+		hashval += (hashval << 3);
+		hashval ^= (hashval >> 11);
+		hashval += (hashval << 15);
+
 		ndx = hashval % hash->dtah_size;
 
 		for (h = hash->dtah_hash[ndx]; h != NULL; h = h->dtahe_next) {
@@ -689,6 +732,9 @@ hashnext:
 
 		h->dtahe_nextall = hash->dtah_all;
 		hash->dtah_all = h;
+
+		if (++hash->dtah_nelems > hash->dtah_size * DTRACE_AHASHLOAD)
+			dt_aggregate_hash_grow(hash);
 bufnext:
 		offs += agg->dtagd_size;
 	}
@@ -1222,6 +1268,8 @@ dt_aggwalk_rval(dtrace_hdl_t *dtp, dt_ahashent_t *h, int rval)
 		if (h->dtahe_nextall != NULL)
 			h->dtahe_nextall->dtahe_prevall = h->dtahe_prevall;
 
+		agp->dtat_hash.dtah_nelems--;
+
 		/*
 		 * We're unlinked.  We can safely destroy the data.
 		 */
@@ -1594,6 +1642,118 @@ out:
 	return (rval);
 }
 
+/*
+ * Restore the heap property of the first n elements of heap -- ordered such
+ * that the entry that sorts last under cmp is at the root -- after the root
+ * has been replaced.
+ */
+static void
+dt_aggregate_trunc_sift(dt_ahashent_t **heap, size_t n,
+    int (*cmp)(const void *, const void *))
+{
+	size_t i = 0, c;
+	dt_ahashent_t *h;
+
+	while ((c = 2 * i + 1) < n) {
+		if (c + 1 < n && cmp(&heap[c + 1], &heap[c]) > 0)
+			c++;
+
+		if (cmp(&heap[c], &heap[i]) <= 0)
+			break;
+
+		h = heap[i];
+		heap[i] = heap[c];
+		heap[c] = h;
+		i = c;
+	}
+}
+
+/*
+ * Implement trunc():  remove all but the first n entries of the aggregation
+ * id when sorted by value (in decreasing order if rev is set, increasing
+ * order otherwise).  Rather than sorting every entry of every aggregation to
+ * find them, we make one pass over the entries of this aggregation keeping
+ * the best n seen so far in a heap whose root is the worst of them.  This
+ * makes the cost O(m log n) in the m entries of the aggregation, which
+ * matters when a program truncates a large aggregation to its top few
+ * entries at every interval.
+ */
+int
+dt_aggregate_trunc(dtrace_hdl_t *dtp, dtrace_aggvarid_t id, uint64_t n,
+    boolean_t rev)
+{
+	dt_aggregate_t *agp = &dtp->dt_aggregate;
+	dt_ahash_t *hash = &agp->dtat_hash;
+	dt_ahashent_t *h, **heap = NULL, **victims = NULL;
+	int (*cmp)(const void *, const void *);
+	size_t i, nheap = 0, nvictims = 0, nentries = 0;
+	int rval = -1;
+
+	cmp = rev ? dt_aggregate_varvalrevcmp : dt_aggregate_varvalcmp;
+
+	for (h = hash->dtah_all; h != NULL; h = h->dtahe_nextall) {
+		if (h->dtahe_data.dtada_desc->dtagd_nrecs != 0 &&
+		    h->dtahe_data.dtada_desc->dtagd_varid == id)
+			nentries++;
+	}
+
+	if (nentries <= n)
+		return (0);
+
+	if ((n != 0 &&
+	    (heap = dt_alloc(dtp, n * sizeof (dt_ahashent_t *))) == NULL) ||
+	    (victims = dt_alloc(dtp,
+	    (nentries - n) * sizeof (dt_ahashent_t *))) == NULL)
+		goto out;
+
+	(void) pthread_mutex_lock(&dt_qsort_lock);
+
+	for (h = hash->dtah_all; h != NULL; h = h->dtahe_nextall) {
+		if (h->dtahe_data.dtada_desc->dtagd_nrecs == 0 ||
+		    h->dtahe_data.dtada_desc->dtagd_varid != id)
+			continue;
+
+		if (nheap < n) {
+			/*
+			 * Until the heap is full, add each entry at the
+			 * bottom and sift it up.
+			 */
+			for (i = nheap++; i > 0; i = (i - 1) / 2) {
+				if (cmp(&h, &heap[(i - 1) / 2]) <= 0)
+					break;
+				heap[i] = heap[(i - 1) / 2];
+			}
+			heap[i] = h;
+			continue;
+		}
+
+		if (n == 0 || cmp(&h, &heap[0]) >= 0) {
+			victims[nvictims++] = h;
+			continue;
+		}
+
+		victims[nvictims++] = heap[0];
+		heap[0] = h;
+		dt_aggregate_trunc_sift(heap, n, cmp);
+	}
+
+	(void) pthread_mutex_unlock(&dt_qsort_lock);
+
+	assert(nvictims == nentries - n);
+
+	for (i = 0; i < nvictims; i++) {
+		if (dt_aggwalk_rval(dtp, victims[i],
+		    DTRACE_AGGWALK_REMOVE) == -1)
+			goto out;
+	}
+
+	rval = 0;
+out:
+	dt_free(dtp, heap);
+	dt_free(dtp, victims);
+	return (rval);
+}
+
 int
 dtrace_aggregate_walk_sorted(dtrace_hdl_t *dtp,
     dtrace_aggregate_f *func, void *arg)
@@ -2188,6 +2348,7 @@ dt_aggregate_destroy(dtrace_hdl_t *dtp)
 		hash->dtah_hash = NULL;
 		hash->dtah_all = NULL;
 		hash->dtah_size = 0;
+		hash->dtah_nelems = 0;
 	}
 
 	free(agp->dtat_buf.dtbd_data);
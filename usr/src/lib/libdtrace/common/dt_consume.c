@@ -1694,38 +1694,13 @@ dt_clear_agg(const dtrace_aggdata_t *aggdata, void *arg)
 	return (DTRACE_AGGWALK_CLEAR);
 }
 
-typedef struct dt_trunc {
-	dtrace_aggvarid_t dttd_id;
-	uint64_t dttd_remaining;
-} dt_trunc_t;
-
-static int
-dt_trunc_agg(const dtrace_aggdata_t *aggdata, void *arg)
-{
-	dt_trunc_t *trunc = arg;
-	dtrace_aggdesc_t *agg = aggdata->dtada_desc;
-	dtrace_aggvarid_t id = trunc->dttd_id;
-
-	if (agg->dtagd_nrecs == 0)
-		return (DTRACE_AGGWALK_NEXT);
-
-	if (agg->dtagd_varid != id)
-		return (DTRACE_AGGWALK_NEXT);
-
-	if (trunc->dttd_remaining == 0)
-		return (DTRACE_AGGWALK_REMOVE);
-
-	trunc->dttd_remaining--;
-	return (DTRACE_AGGWALK_NEXT);
-}
-
 static int
 dt_trunc(dtrace_hdl_t *dtp, caddr_t base, dtrace_recdesc_t *rec)
 {
-	dt_trunc_t trunc;
+	dtrace_aggvarid_t id;
 	caddr_t addr;
 	int64_t remaining;
-	int (*func)(dtrace_hdl_t *, dtrace_aggregate_f *, void *);
+	boolean_t rev = B_TRUE;
 
 	/*
 	 * We (should) have two records:  the aggregation ID followed by the
@@ -1738,7 +1713,7 @@ dt_trunc(dtrace_hdl_t *dtp, caddr_t base, dtrace_recdesc_t *rec)
 		return (dt_set_errno(dtp, EDT_BADTRUNC));
 
 	/* LINTED - alignment */
-	trunc.dttd_id = *((dtrace_aggvarid_t *)addr);
+	id = *((dtrace_aggvarid_t *)addr);
 	rec++;
 
 	if (rec->dtrd_action != DTRACEACT_LIBACT)
@@ -1770,16 +1745,17 @@ dt_trunc(dtrace_hdl_t *dtp, caddr_t base, dtrace_recdesc_t *rec)
 	}
 
 	if (remaining < 0) {
-		func = dtrace_aggregate_walk_valsorted;
+		rev = B_FALSE;
 		remaining = -remaining;
-	} else {
-		func = dtrace_aggregate_walk_valrevsorted;
 	}
 
 	assert(remaining >= 0);
-	trunc.dttd_remaining = remaining;
 
-	(void) func(dtp, dt_trunc_agg, &trunc);
+	/*
+	 * As with the sorted walk that this replaces, a failure to truncate
+	 * (which can only be a failure to allocate) is not reported.
+	 */
+	(void) dt_aggregate_trunc(dtp, id, remaining, rev);
 
 	return (0);
 }
@@ -163,6 +163,7 @@ typedef struct dt_ahash {
 	dt_ahashent_t	**dtah_hash;		/* hash table */
 	dt_ahashent_t	*dtah_all;		/* list of all elements */
 	size_t		dtah_size;		/* size of hash table */
+	size_t		dtah_nelems;		/* number of elements */
 } dt_ahash_t;
 
 typedef struct dt_aggregate {
@@ -619,6 +620,8 @@ extern void dt_dis(const dtrace_difo_t *, FILE *);
 extern int dt_aggregate_go(dtrace_hdl_t *);
 extern int dt_aggregate_init(dtrace_hdl_t *);
 extern void dt_aggregate_destroy(dtrace_hdl_t *);
+extern int dt_aggregate_trunc(dtrace_hdl_t *, dtrace_aggvarid_t, uint64_t,
+    boolean_t);
 
 extern int dt_epid_lookup(dtrace_hdl_t *, dtrace_epid_t,
     dtrace_eprobedesc_t **, dtrace_probedesc_t **);
@@ -165,6 +165,98 @@ kstat_read(kstat_ctl_t *kc, kstat_t *ksp, void *data)
 	return (kcid);
 }
 
+/*
+ * Read each of nksps kstats, as kstat_read(kc, ksp, NULL) would, in a
+ * single KSTAT_IOC_READV ioctl where possible.  Any kstat that the kernel
+ * could not read in the batch (because it was momentarily invalid, or had
+ * outgrown its buffer) is retried with kstat_read().  If any kstat cannot be
+ * read, -1 is returned with errno set for the first such; the others are
+ * still read.
+ */
+kid_t
+kstat_read_many(kstat_ctl_t *kc, kstat_t **ksps, uint_t nksps)
+{
+	kstat_readv_t krv;
+	kid_t kcid, rval;
+	int *errors, err = 0;
+	uint_t i;
+
+	for (i = 0; i < nksps; i++) {
+		kstat_t *ksp = ksps[i];
+
+		if (ksp->ks_data == NULL && ksp->ks_data_size > 0) {
+			kstat_zalloc(&ksp->ks_data, ksp->ks_data_size, 0);
+			if (ksp->ks_data == NULL)
+				return (-1);
+		}
+	}
+
+	if ((errors = calloc(nksps == 0 ? 1 : nksps, sizeof (int))) == NULL)
+		return (-1);
+
+	krv.kr_ksps = ksps;
+	krv.kr_errors = errors;
+	krv.kr_nksps = nksps;
+
+	if ((kcid = (kid_t)ioctl(kc->kc_kd, KSTAT_IOC_READV, &krv)) == -1) {
+		if (errno != EINVAL) {
+			free(errors);
+			return (-1);
+		}
+
+		/*
+		 * This kernel predates KSTAT_IOC_READV; read them one by one.
+		 */
+		for (i = 0; i < nksps; i++)
+			errors[i] = EINVAL;
+		kcid = 0;
+	}
+
+	for (i = 0; i < nksps; i++) {
+		kstat_t *ksp = ksps[i];
+
+		if (errors[i] == 0)
+			continue;
+
+		/*
+		 * On ENOMEM, the kernel has updated ks_data_size to the size
+		 * it needs; as in kstat_read(), our buffer must grow to match
+		 * before we can try again.
+		 */
+		if (errors[i] == ENOMEM) {
+			if (!(ksp->ks_flags &
+			    (KSTAT_FLAG_VAR_SIZE | KSTAT_FLAG_LONGSTRINGS))) {
+				if (err == 0)
+					err = ENOMEM;
+				continue;
+			}
+
+			kstat_zalloc(&ksp->ks_data, ksp->ks_data_size, 1);
+			if (ksp->ks_data == NULL) {
+				if (err == 0)
+					err = errno;
+				continue;
+			}
+		}
+
+		if ((rval = kstat_read(kc, ksp, NULL)) == -1) {
+			if (err == 0)
+				err = errno;
+		} else {
+			kcid = rval;
+		}
+	}
+
+	free(errors);
+
+	if (err != 0) {
+		errno = err;
+		return (-1);
+	}
+
+	return (kcid);
+}
+
 kid_t
 kstat_write(kstat_ctl_t *kc, kstat_t *ksp, void *data)
 {
@@ -43,6 +43,24 @@
 #include <sys/dumphdr.h>
 #include <sys/sysmacros.h>
 
+/*
+ * Consumers such as mdb's kmem walkers read the same pages of a crash dump
+ * over and over, and each read would otherwise walk a dump map hash chain
+ * (or binary search the pfn table) for every page it touches.  A small
+ * direct-mapped cache of recent translations avoids most of those lookups.
+ */
+#define	KVM_TCACHE_SIZE		4096	/* must be a power of two */
+
+#define	KVM_TCACHE_HASH(kd, as, page)				\
+	((((uintptr_t)(as) >> 4) ^					\
+	((page) >> (kd)->kvm_dump.dump_pageshift)) & (KVM_TCACHE_SIZE - 1))
+
+typedef struct kvm_tcache {
+	struct as	*kt_as;
+	uint64_t	kt_page;
+	offset_t	kt_off;		/* offset of page in core file */
+} kvm_tcache_t;
+
 struct _kvmd {
 	struct dumphdr	kvm_dump;
 	char		*kvm_debug;
@@ -60,6 +78,7 @@ struct _kvmd {
 	char		kvm_namelist[MAXNAMELEN + 1];
 	boolean_t	kvm_namelist_core;
 	proc_t		kvm_proc;
+	kvm_tcache_t	kvm_tcache[KVM_TCACHE_SIZE];
 };
 
 #define	PREAD	(ssize_t (*)(int, void *, size_t, offset_t))pread64
@@ -283,6 +302,10 @@ kvm_lookup(kvm_t *kd, struct as *as, uint64_t addr)
 	uintptr_t pageoff = addr & (kd->kvm_dump.dump_pagesize - 1);
 	uint64_t page = addr - pageoff;
 	offset_t off = 0;
+	kvm_tcache_t *kt = &kd->kvm_tcache[KVM_TCACHE_HASH(kd, as, page)];
+
+	if (kt->kt_off != 0 && kt->kt_page == page && kt->kt_as == as)
+		return (kt->kt_off + pageoff);
 
 	if (kd->kvm_debug)
 		fprintf(stderr, "kvm_lookup(%p, %llx):", (void *)as, addr);
@@ -332,6 +355,11 @@ kvm_lookup(kvm_t *kd, struct as *as, uint64_t addr)
 	}
 	if (kd->kvm_debug)
 		fprintf(stderr, "%s found: %llx\n", off ? "" : " not", off);
+	if (off != 0) {
+		kt->kt_as = as;
+		kt->kt_page = page;
+		kt->kt_off = off - pageoff;
+	}
 	return (off);
 }
 
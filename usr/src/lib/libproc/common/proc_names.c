@@ -260,7 +260,7 @@ static const char *const systable[] = {
 	"sigtimedwait",		/* 144 */
 	"lwp_info",		/* 145 */
 	"yield",		/* 146 */
-	NULL,			/* 147 */
+	"lwp_addr_sys",		/* 147 */
 	"lwp_sema_post",	/* 148 */
 	"lwp_sema_trywait",	/* 149 */
 	"lwp_detatch",		/* 150 */
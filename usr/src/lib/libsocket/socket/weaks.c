@@ -32,6 +32,7 @@
 #include <sys/stream.h>
 #include <sys/socketvar.h>
 #include <sys/sockio.h>
+#include <sys/syscall.h>
 
 #include <errno.h>
 #include <stdlib.h>
@@ -50,8 +51,10 @@
 #pragma weak recv = _recv
 #pragma weak recvfrom = _recvfrom
 #pragma weak recvmsg = _recvmsg
+#pragma weak recvmmsg = _recvmmsg
 #pragma weak send = _send
 #pragma weak sendmsg = _sendmsg
+#pragma weak sendmmsg = _sendmmsg
 #pragma weak sendto = _sendto
 #pragma weak getpeername = _getpeername
 #pragma weak getsockname = _getsockname
@@ -134,6 +137,14 @@ _recvmsg(int sock, struct msghdr *msg, int flags)
 	return (_so_recvmsg(sock, msg, flags & ~MSG_XPG4_2));
 }
 
+int
+_recvmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags,
+	struct timespec *timeout)
+{
+	return (syscall(SYS_recvmmsg, sock, vec, vlen, flags & ~MSG_XPG4_2,
+	    timeout));
+}
+
 int
 _send(int sock, char *buf, int len, int flags)
 {
@@ -146,6 +157,12 @@ _sendmsg(int sock, struct msghdr *msg, int flags)
 	return (_so_sendmsg(sock, msg, flags & ~MSG_XPG4_2));
 }
 
+int
+_sendmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+	return (syscall(SYS_sendmmsg, sock, vec, vlen, flags & ~MSG_XPG4_2));
+}
+
 int
 _sendto(int sock, char *buf, int len, int flags,
 	struct sockaddr *addr, int *addrlen)
@@ -248,6 +265,20 @@ __xnet_sendmsg(int sock, const struct msghdr *msg, int flags)
 	return (_so_sendmsg(sock, msg, flags | MSG_XPG4_2));
 }
 
+int
+__xnet_recvmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags,
+	struct timespec *timeout)
+{
+	return (syscall(SYS_recvmmsg, sock, vec, vlen, flags | MSG_XPG4_2,
+	    timeout));
+}
+
+int
+__xnet_sendmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+	return (syscall(SYS_sendmmsg, sock, vec, vlen, flags | MSG_XPG4_2));
+}
+
 int
 __xnet_sendto(int sock, const void *buf, size_t len, int flags,
 	const struct sockaddr *addr, socklen_t addrlen)
@@ -64,6 +64,7 @@
 
 #include <atomic.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <strings.h>
 #include <umem_impl.h>
@@ -73,9 +74,9 @@
 
 const int umem_genasm_supported = 1;
 static uintptr_t umem_genasm_mptr = (uintptr_t)&_malloc;
-static size_t umem_genasm_msize = 576;
+static size_t umem_genasm_msize = 1536;
 static uintptr_t umem_genasm_fptr = (uintptr_t)&_free;
-static size_t umem_genasm_fsize = 576;
+static size_t umem_genasm_fsize = 1536;
 static uintptr_t umem_genasm_omptr = (uintptr_t)umem_malloc;
 static uintptr_t umem_genasm_ofptr = (uintptr_t)umem_malloc_free;
 
@@ -98,12 +99,18 @@ static uintptr_t umem_genasm_ofptr = (uintptr_t)umem_malloc_free;
  * 	goto tomalloc
  *
  * tmem_t *t = (uintptr_t)curthread() + umem_thr_offset;
+ * if (t->tm_gen != umem_ptc_gen)
+ * 	goto tomalloc;
  * void **roots = t->tm_roots;
  */
 #define	PTC_MALINIT_JOUT	0x13
 #define	PTC_MALINIT_MCS	0x1a
 #define	PTC_MALINIT_JOV	0x20
 #define	PTC_MALINIT_SOFF	0x30
+#define	PTC_MALINIT_GEN	0x37
+#define	PTC_MALINIT_TMGEN	0x3e
+#define	PTC_MALINIT_JGEN	0x44
+#define	PTC_MALINIT_ROOTS	0x4b
 static const uint8_t malinit[] =  {
 	0x48, 0x8d, 0x77, 0x08,		/* leaq 0x8(%rdi),%rsi */
 	0x48, 0x83, 0xfe, 0x10,		/* cmpq $0x10, %rsi */
@@ -118,7 +125,12 @@ static const uint8_t malinit[] =  {
 	0x00, 0x00, 0x00, 0x00,		/* movq %fs:0x0,%rcx */
 	0x48, 0x81, 0xc1,
 	0x00, 0x00, 0x00, 0x00,		/* addq $SOFF, %rcx */
-	0x48, 0x8d, 0x51, 0x08,		/* leaq 0x8(%rcx),%rdx */
+	0x44, 0x8b, 0x0d,
+	0x00, 0x00, 0x00, 0x00,		/* movl umem_ptc_gen(%rip),%r9d */
+	0x44, 0x39, 0x89,
+	0x00, 0x00, 0x00, 0x00,		/* cmpl %r9d,$TMGEN(%rcx) */
+	0x0f, 0x85, 0x00, 0x00, 0x00, 0x00,	/* jne +errout */
+	0x48, 0x8d, 0x51, 0x00,		/* leaq $ROOTS(%rcx),%rdx */
 };
 
 /*
@@ -141,6 +153,8 @@ static const uint8_t malinit[] =  {
  * 	goto tofree;
  *
  * tmem_t *t = (uintptr_t)curthread() + umem_thr_offset;
+ * if (t->tm_gen != umem_ptc_gen)
+ * 	goto tofree;
  * void **roots = t->tm_roots;
  */
 #define	PTC_FRINI_JDONE	0x05
@@ -148,6 +162,10 @@ static const uint8_t malinit[] =  {
 #define	PTC_FRINI_MCS	0x30
 #define	PTC_FRINI_JOV	0x36
 #define	PTC_FRINI_SOFF	0x46
+#define	PTC_FRINI_GEN	0x4d
+#define	PTC_FRINI_TMGEN	0x54
+#define	PTC_FRINI_JGEN	0x5a
+#define	PTC_FRINI_ROOTS	0x61
 static const uint8_t freeinit[] = {
 	0x48, 0x85, 0xff,		/* testq %rdi,%rdi */
 	0x0f, 0x84, 0x00, 0x00, 0x00, 0x00,	/* jmp $JDONE (done) */
@@ -168,7 +186,12 @@ static const uint8_t freeinit[] = {
 	0x00, 0x00, 0x00, 0x00,		/* movq %fs:0x0,%rcx */
 	0x48, 0x81, 0xc1,
 	0x00, 0x00, 0x00, 0x00,		/* addq $SOFF, %rcx */
-	0x48, 0x8d, 0x51, 0x08,		/* leaq 0x8(%rcx),%rdx */
+	0x44, 0x8b, 0x0d,
+	0x00, 0x00, 0x00, 0x00,		/* movl umem_ptc_gen(%rip),%r9d */
+	0x44, 0x39, 0x89,
+	0x00, 0x00, 0x00, 0x00,		/* cmpl %r9d,$TMGEN(%rcx) */
+	0x0f, 0x85, 0x00, 0x00, 0x00, 0x00,	/* jne +errout */
+	0x48, 0x8d, 0x51, 0x00,		/* leaq $ROOTS(%rcx),%rdx */
 };
 
 /*
@@ -238,7 +261,8 @@ static const uint8_t fincache[] = {
  *
  * malloc_data_t *ret = *root;
  * *root = *(void **)ret;
- * t->tm_size += csize;
+ * t->tm_size -= csize;
+ * t->tm_ahit++;
  * ret->malloc_size = size;
  *
  * if (size > UMEM_SECOND_ALIGN) {
@@ -254,15 +278,18 @@ static const uint8_t fincache[] = {
  * 	return (malloc(orig_size));
  */
 #define	PTC_MALFINI_ALLABEL	0x00
-#define	PTC_MALFINI_JMLABEL	0x40
-#define	PTC_MALFINI_JMADDR	0x41
+#define	PTC_MALFINI_AHIT	0x14
+#define	PTC_MALFINI_JMLABEL	0x47
+#define	PTC_MALFINI_JMADDR	0x48
 static const uint8_t malfini[] = {
 	0x48, 0x8b, 0x02,		/* movl (%rdx),%rax */
 	0x48, 0x85, 0xc0,		/* testq %rax,%rax */
-	0x74, 0x38,			/* je +0x38 (errout) */
+	0x74, 0x3f,			/* je +0x3f (errout) */
 	0x4c, 0x8b, 0x08,		/* movq (%rax),%r9 */
 	0x4c, 0x89, 0x0a,		/* movq %r9,(%rdx) */
-	0x4c, 0x29, 0x01,		/* subq %rsi,(%rcx) */
+	0x4c, 0x29, 0x01,		/* subq %r8,(%rcx) */
+	0x48, 0xff, 0x81,
+	0x00, 0x00, 0x00, 0x00,		/* incq $AHIT(%rcx) */
 	0x48, 0x83, 0xfe, 0x10,		/* cmpq $0x10,%rsi */
 	0x76, 0x15,			/* jbe +0x15 */
 	0x41, 0xb9, 0x00, 0x70, 0xba, 0x16, /* movl $MALLOC_MAGIC_2, %r9d */
@@ -281,10 +308,11 @@ static const uint8_t malfini[] = {
 };
 
 /*
- * if (t->tm_size + csize > umem_ptc_size)
+ * if (t->tm_size + csize > t->tm_max)
  * 	goto tofree;
  *
  * t->tm_size += csize
+ * t->tm_fhit++;
  * *(void **)tag = *root;
  * *root = tag;
  * return;
@@ -293,17 +321,20 @@ static const uint8_t malfini[] = {
  * 	return;
  */
 #define	PTC_FRFINI_RBUFLABEL	0x00
-#define	PTC_FRFINI_CACHEMAX	0x09
-#define	PTC_FRFINI_DONELABEL	0x1b
-#define	PTC_FRFINI_JFLABEL	0x1c
-#define	PTC_FRFINI_JFADDR	0x1d
+#define	PTC_FRFINI_TMMAX	0x09
+#define	PTC_FRFINI_FHIT		0x15
+#define	PTC_FRFINI_DONELABEL	0x22
+#define	PTC_FRFINI_JFLABEL	0x23
+#define	PTC_FRFINI_JFADDR	0x24
 static const uint8_t freefini[] = {
 	0x4c, 0x8b, 0x09,		/* movq (%rcx),%r9 */
 	0x4d, 0x01, 0xc1,		/* addq %r8, %r9 */
-	0x49, 0x81, 0xf9,
-	0x00, 0x00, 0x00, 0x00,		/* cmpl $THR_CACHE_MAX, %r9 */
-	0x77, 0x0d,			/* jae +0xd (torfree) */
+	0x4c, 0x3b, 0x89,
+	0x00, 0x00, 0x00, 0x00,		/* cmpq $TMMAX(%rcx), %r9 */
+	0x77, 0x14,			/* ja +0x14 (torfree) */
 	0x4c, 0x01, 0x01,		/* addq %r8,(%rcx) */
+	0x48, 0xff, 0x81,
+	0x00, 0x00, 0x00, 0x00,		/* incq $FHIT(%rcx) */
 	0x4c, 0x8b, 0x0a,		/* movq (%rdx),%r9 */
 	0x4c, 0x89, 0x08,		/* movq %r9,(%rax) */
 	0x48, 0x89, 0x02,		/* movq %rax,(%rdx) */
@@ -311,6 +342,25 @@ static const uint8_t freefini[] = {
 	0xe9, 0x00, 0x00, 0x00, 0x00	/* jmp free */
 };
 
+/*
+ * Fill in the generation check and the roots offset that end both the malloc
+ * and free prologues. gp is the offset of the generation load in the block.
+ */
+static void
+genasm_tmem(uint8_t *bp, uint32_t gp, uint32_t tp, uint32_t rp)
+{
+	uint32_t addr, tmgen;
+	uint8_t roots;
+
+	addr = PTC_JMPADDR((uintptr_t)&umem_ptc_gen, (uintptr_t)bp + gp);
+	bcopy(&addr, bp + gp, sizeof (addr));
+	tmgen = offsetof(umem_tmem_t, tm_gen);
+	bcopy(&tmgen, bp + tp, sizeof (tmgen));
+	ASSERT(offsetof(umem_tmem_t, tm_roots) <= INT8_MAX);
+	roots = offsetof(umem_tmem_t, tm_roots);
+	bcopy(&roots, bp + rp, sizeof (roots));
+}
+
 /*
  * Construct the initial part of malloc. off contains the offset from curthread
  * to the root of the tmem structure. ep is the address of the label to error
@@ -328,6 +378,9 @@ genasm_malinit(uint8_t *bp, uint32_t off, uint32_t ep, uint32_t csize)
 	addr = PTC_JMPADDR(ep, PTC_MALINIT_JOV);
 	bcopy(&addr, bp + PTC_MALINIT_JOV, sizeof (addr));
 	bcopy(&off, bp + PTC_MALINIT_SOFF, sizeof (off));
+	addr = PTC_JMPADDR(ep, PTC_MALINIT_JGEN);
+	bcopy(&addr, bp + PTC_MALINIT_JGEN, sizeof (addr));
+	genasm_tmem(bp, PTC_MALINIT_GEN, PTC_MALINIT_TMGEN, PTC_MALINIT_ROOTS);
 
 	return (sizeof (malinit));
 }
@@ -346,6 +399,9 @@ genasm_frinit(uint8_t *bp, uint32_t off, uint32_t dp, uint32_t ep, uint32_t mcs)
 	addr = PTC_JMPADDR(ep, PTC_FRINI_JOV);
 	bcopy(&addr, bp + PTC_FRINI_JOV, sizeof (addr));
 	bcopy(&off, bp + PTC_FRINI_SOFF, sizeof (off));
+	addr = PTC_JMPADDR(ep, PTC_FRINI_JGEN);
+	bcopy(&addr, bp + PTC_FRINI_JGEN, sizeof (addr));
+	genasm_tmem(bp, PTC_FRINI_GEN, PTC_FRINI_TMGEN, PTC_FRINI_ROOTS);
 	return (sizeof (freeinit));
 }
 
@@ -411,9 +467,11 @@ genasm_lastcache(uint8_t *bp, int num, uint32_t csize, uint32_t ep)
 static int
 genasm_malfini(uint8_t *bp, uintptr_t mptr)
 {
-	uint32_t addr;
+	uint32_t addr, ahit;
 
 	bcopy(malfini, bp, sizeof (malfini));
+	ahit = offsetof(umem_tmem_t, tm_ahit);
+	bcopy(&ahit, bp + PTC_MALFINI_AHIT, sizeof (ahit));
 	addr = PTC_JMPADDR(mptr, ((uintptr_t)bp + PTC_MALFINI_JMADDR));
 	bcopy(&addr, bp + PTC_MALFINI_JMADDR, sizeof (addr));
 
@@ -421,12 +479,15 @@ genasm_malfini(uint8_t *bp, uintptr_t mptr)
 }
 
 static int
-genasm_frfini(uint8_t *bp, uint32_t maxthr, uintptr_t fptr)
+genasm_frfini(uint8_t *bp, uintptr_t fptr)
 {
-	uint32_t addr;
+	uint32_t addr, tmmax, fhit;
 
 	bcopy(freefini, bp, sizeof (freefini));
-	bcopy(&maxthr, bp + PTC_FRFINI_CACHEMAX, sizeof (maxthr));
+	tmmax = offsetof(umem_tmem_t, tm_max);
+	bcopy(&tmmax, bp + PTC_FRFINI_TMMAX, sizeof (tmmax));
+	fhit = offsetof(umem_tmem_t, tm_fhit);
+	bcopy(&fhit, bp + PTC_FRFINI_FHIT, sizeof (fhit));
 	addr = PTC_JMPADDR(fptr, ((uintptr_t)bp + PTC_FRFINI_JFADDR));
 	bcopy(&addr, bp + PTC_FRFINI_JFADDR, sizeof (addr));
 
@@ -539,7 +600,7 @@ genasm_free(void *base, size_t len, int nents, int *umem_alloc_sizes)
 
 	bp += genasm_lastcache(bp, nents - 1, umem_alloc_sizes[nents - 1],
 	    erroff);
-	bp += genasm_frfini(bp, umem_ptc_size, umem_genasm_ofptr);
+	bp += genasm_frfini(bp, umem_genasm_ofptr);
 	ASSERT(((uintptr_t)bp - total) == (uintptr_t)base);
 
 	return (0);
@@ -154,11 +154,23 @@ static umem_env_item_t umem_options_items[] = {
 		"The preferred page size for the sbrk(2) heap.",
 		NULL, 0, NULL,	&vmem_sbrk_pagesize
 	},
+	{ "mmap_pagesize",	"Private",	ITEM_SIZE,
+		"The preferred page size for the mmap(2) heap.",
+		NULL, 0, NULL,	&vmem_mmap_pagesize
+	},
+	{ "lpage_minheap",	"Private",	ITEM_SIZE,
+		"The heap size at which large pages are used by default.",
+		NULL, 0, NULL,	&vmem_lpage_minheap
+	},
 #endif
 	{ "perthread_cache",	"Evolving",	ITEM_SIZE,
 		"Size (in bytes) of per-thread allocation cache",
 		NULL, 0, NULL, &umem_ptc_size
 	},
+	{ "perthread_cache_max",	"Evolving",	ITEM_SIZE,
+		"Largest buffer (in bytes) kept in per-thread caches",
+		NULL, 0, NULL, &umem_ptc_maxbuf
+	},
 	{ NULL, "-- end of UMEM_OPTIONS --",	ITEM_INVALID }
 };
 
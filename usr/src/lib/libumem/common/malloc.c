@@ -78,6 +78,8 @@ umem_malloc(size_t size_arg)
 		errno = ENOMEM;			/* overflow */
 		return (NULL);
 	}
+	if (umem_ptc_enabled && size <= umem_ptc_limit)
+		umem_ptc_miss(0);
 	ret = (malloc_data_t *)_umem_alloc(size, UMEM_DEFAULT);
 	if (ret == NULL) {
 		if (size <= UMEM_MAXBUF)
@@ -381,6 +383,24 @@ umem_malloc_free(void *buf)
 	if (buf == NULL)
 		return;
 
+	/*
+	 * Let the per-thread cache know about any buffer it could have held.
+	 */
+	if (umem_ptc_enabled) {
+		malloc_data_t *tag = (malloc_data_t *)buf - 1;
+		uint32_t size = tag->malloc_size;
+
+		switch (UMEM_MALLOC_DECODE(tag->malloc_stat, size)) {
+		case MALLOC_MAGIC:
+#ifdef _LP64
+		case MALLOC_SECOND_MAGIC:
+#endif
+			if (size <= umem_ptc_limit)
+				umem_ptc_miss(1);
+			break;
+		}
+	}
+
 	/*
 	 * Process buf, freeing it if it is not corrupt.
 	 */
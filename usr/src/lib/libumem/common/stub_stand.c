@@ -142,6 +142,12 @@ _tmem_get_base(void)
 	return (0);
 }
 
+void *
+_tmem_get(void)
+{
+	return (NULL);
+}
+
 /*ARGSUSED*/
 void
 _tmem_set_cleanup(void (*f)(int, void *))
@@ -395,8 +395,11 @@
  * umem_t that looks like:
  *
  * typedef struct {
- * 	size_t	tm_size;
- * 	void	*tm_roots[NTMEMBASE];  (Currently 16)
+ * 	size_t		tm_size;
+ * 	size_t		tm_max;
+ * 	uint64_t	tm_ahit, tm_fhit, tm_amiss, tm_fmiss;
+ * 	uint32_t	tm_gen, tm_amark;
+ * 	void		*tm_roots[NTMEMBASE];  (Currently 48)
  * } tmem_t;
  *
  * Each of the roots is treated as the head of a linked list. Each entry in the
@@ -412,37 +415,39 @@
  * entry in a given root's list will be able to satisfy the same requests as the
  * corresponding cache.
  *
- * The choice of sixteen roots is based on where we believe we get the biggest
- * bang for our buck. The per-thread caches will cache up to 256 byte and 448
- * byte allocations on ILP32 and LP64 respectively. Generally applications plan
- * more carefully how they do larger allocations than smaller ones. Therefore
- * sixteen roots is a reasonable compromise between the amount of additional
- * overhead per thread, and the likelihood of a program to benefit from it.
- *
- * The maximum amount of memory that can be cached in each thread is determined
- * by the perthread_cache UMEM_OPTION. It corresponds to the umem_ptc_size
- * value. The default value for this is currently 1 MB. Once umem_init() has
- * finished this cannot be directly tuned without directly modifying the
- * instruction text. If, upon calling free(3C), the amount cached would exceed
- * this maximum, we instead actually return the buffer to the umem_cache instead
- * of holding onto it in the thread.
+ * Forty-eight roots are enough to cover every default cache up to 64K.
+ * Programs that churn through page-sized and larger buffers gain as much from
+ * skipping the magazine layer as those making small allocations do, and a
+ * linear walk of the caches is still far cheaper than a trip through the
+ * magazines. The caches actually covered are the first ones that fit in the
+ * roots and are no larger than the perthread_cache_max UMEM_OPTION (the
+ * umem_ptc_maxbuf value, 64K by default).
+ *
+ * The amount of memory that a thread may cache is its budget, tm_max. A
+ * thread's budget starts at an eighth of the perthread_cache UMEM_OPTION (the
+ * umem_ptc_size value, which defaults to 1 MB) and can grow to that value; see
+ * section 8.5. If, upon calling free(3C), the amount cached would exceed the
+ * budget, we instead actually return the buffer to the umem_cache instead of
+ * holding onto it in the thread.
  *
  * When a thread calls malloc(3C) it first determines which umem_cache it
  * would be serviced by. If the allocation is not covered by ptcumem it goes to
- * the normal malloc instead.  Next, it checks if the tmem_root's list is empty
- * or not. If it is empty, we instead go and allocate the memory from
- * umem_alloc. If it is not empty, we remove the head of the list, set the
- * appropriate malloc tags, and return that buffer.
+ * the normal malloc instead, as it does if tm_gen does not match umem_ptc_gen
+ * (see section 8.5). Next, it checks if the tmem_root's list is empty or not.
+ * If it is empty, we instead go and allocate the memory from umem_alloc. If it
+ * is not empty, we remove the head of the list, set the appropriate malloc
+ * tags, count the hit in tm_ahit, and return that buffer.
  *
  * When a thread calls free(3C) it first looks at the malloc tag and if it is
  * invalid or the allocation exceeds the largest cache in ptcumem and sends it
  * off to the original free() to handle and clean up appropriately. Next, it
  * checks if the allocation size is covered by one of the per-thread roots and
- * if it isn't, it passes it off to the original free() to be released. Finally,
- * before it inserts this buffer as the head, it checks if adding this buffer
- * would put the thread over its maximum cache size. If it would, it frees the
- * buffer back to the umem_cache. Otherwise it increments the threads total
- * cached amount and makes the buffer the new head of the appropriate tm_root.
+ * if it isn't, it passes it off to the original free() to be released. The
+ * generation is checked as it is for malloc. Finally, before it inserts this
+ * buffer as the head, it checks if adding this buffer would put the thread
+ * over its budget. If it would, it frees the buffer back to the umem_cache.
+ * Otherwise it increments the threads total cached amount, counts the hit in
+ * tm_fhit, and makes the buffer the new head of the appropriate tm_root.
  *
  * When a thread exits, all of the buffers that it has in its per-thread cache
  * will be passed to umem_free() and returned to the appropriate umem_cache.
@@ -554,9 +559,11 @@
  * --------------------------
  *
  * The tmem_t structure as described in the beginning of section 8, is part of a
- * private interface with libc. There are three functions that exist to cover
+ * private interface with libc. There are four functions that exist to cover
  * this. They are not documented in man pages or header files. They are in the
- * SUNWprivate part of libc's mapfile.
+ * SUNWprivate part of libc's mapfile. Besides these, the code generated by
+ * umem_genasm() knows the layout of the tmem_t, which is mirrored by the
+ * umem_tmem_t in umem_base.h.
  *
  *	o. _tmem_get_base(void)
  *
@@ -565,6 +572,11 @@
  * 	::offsetof ulwp_t ul_tmem without having to know the specifics of the
  * 	structure outside of libc.
  *
+ *	o. _tmem_get(void)
+ *
+ *	Returns the calling thread's tmem_t, for the C code that looks after
+ *	the per-thread caches outside of the generated functions.
+ *
  *	o. _tmem_get_nentries(void)
  *
  *	Returns the number of roots that exist in the tmem_t. This is one part
@@ -579,10 +591,34 @@
  * 8.5 Tuning and disabling per-thread caching
  * -------------------------------------------
  *
- * There is only one tunable for per-thread caching:  the amount of memory each
- * thread should be able to cache.  This is specified via the perthread_cache
- * UMEM_OPTION option.  No attempt is made to to sanity check the specified
- * value; the limit is simply the maximum value of a size_t.
+ * There are two tunables for per-thread caching:  the amount of memory each
+ * thread should be able to cache, and the largest buffer that it may cache.
+ * These are specified via the perthread_cache and perthread_cache_max
+ * UMEM_OPTION options.  No attempt is made to to sanity check the specified
+ * values; the limit is simply the maximum value of a size_t.
+ *
+ * Rather than letting every thread cache perthread_cache bytes, each thread
+ * is given a budget that adapts to how it uses its cache. The generated code
+ * never calls out, so this is done by umem_ptc_miss(), which the original
+ * malloc() and free() call when they are handed a request that the per-thread
+ * cache could have held. A thread's budget starts at an eighth of
+ * perthread_cache. When a free finds the budget exhausted and the thread has
+ * also missed on an allocation since its budget last grew, the budget is
+ * doubled, up to perthread_cache. A thread that only frees, such as the
+ * consumer in a producer/consumer pair, keeps the small budget, as anything
+ * it cached would never be used.
+ *
+ * Each update interval, the update thread bumps umem_ptc_gen. The generated
+ * code sends any request from a thread whose tm_gen is out of date to the
+ * original malloc() and free(), so umem_ptc_miss() sees every thread that is
+ * still using its cache once per interval and brings its tm_gen up to date.
+ * If a thread's tm_gen is more than one interval old, the thread has gone a
+ * whole interval without allocating or freeing. Such an idle thread has its
+ * cache returned to the umem_caches and its budget reset, so that memory does
+ * not sit in threads that have stopped using it. As only the owning thread
+ * may touch its cache, this happens when the idle thread next calls malloc()
+ * or free(); the caches of threads that never do so again are returned when
+ * they exit.
  *
  * If the perthread_cache UMEM_OPTION is set to zero, nomagazines was requested,
  * or UMEM_DEBUG has been turned on then we will never call into umem_genasm;
@@ -592,9 +628,11 @@
  * --------------------------------------------
  *
  * To understand the efficacy of per-thread caching, use the ::umastat dcmd
- * to see the percentage of capacity consumed on a per-thread basis, the
- * degree to which each umem cache contributes to per-thread cache consumption,
- * and the number of buffers in per-thread caches on a per-umem cache basis.
+ * to see the percentage of capacity consumed on a per-thread basis, each
+ * thread's budget and the rate at which its allocations and frees hit its
+ * cache, the degree to which each umem cache contributes to per-thread cache
+ * consumption, and the number of buffers in per-thread caches on a per-umem
+ * cache basis. ::umem_status summarizes the hit rates across all threads.
  * If more detail is required, the specific buffers in a per-thread cache can
  * be iterated over with the umem_ptc_* walkers. (These walkers allow an
  * optional ulwp_t to be specified to iterate only over a particular thread's
@@ -708,6 +746,7 @@ size_t umem_lite_maxalign = 1024; /* maximum buffer alignment for UMF_LITE */
 size_t umem_maxverify;		/* maximum bytes to inspect in debug routines */
 size_t umem_minfirewall;	/* hardware-enforced redzone threshold */
 size_t umem_ptc_size = 1048576;	/* size of per-thread cache (in bytes) */
+size_t umem_ptc_maxbuf = 65536;	/* largest buffer cached per-thread */
 
 uint_t umem_flags = 0;
 uintptr_t umem_tmem_off;
@@ -719,6 +758,9 @@ int			umem_init_env_ready;	/* environ pre-initted */
 int			umem_ready = UMEM_READY_STARTUP;
 
 int			umem_ptc_enabled;	/* per-thread caching enabled */
+size_t			umem_ptc_limit;		/* largest per-thread cache */
+volatile uint32_t	umem_ptc_gen = 1;	/* ptc generation */
+static int		umem_ptc_nents;		/* caches cached per-thread */
 
 static umem_nofail_callback_t *nofail_callback;
 static mutex_t		umem_nofail_exit_lock;
@@ -2571,6 +2613,7 @@ umem_st_update(void)
 
 	(void) mutex_unlock(&umem_update_lock);
 
+	umem_ptc_gen++;
 	vmem_update(NULL);
 	umem_cache_applyall(umem_cache_update);
 
@@ -3097,6 +3140,65 @@ umem_cache_tmem_cleanup(void *buf, int entry)
 	_umem_cache_free(cp, buf);
 }
 
+/*
+ * Return everything in the calling thread's per-thread cache to the
+ * umem_caches.
+ */
+static void
+umem_ptc_flush(umem_tmem_t *tm)
+{
+	void *buf;
+	int i;
+
+	for (i = 0; i < umem_ptc_nents && tm->tm_size != 0; i++) {
+		while ((buf = tm->tm_roots[i]) != NULL) {
+			tm->tm_roots[i] = *(void **)buf;
+			tm->tm_size -= umem_alloc_sizes[i];
+			umem_cache_tmem_cleanup(buf, i);
+		}
+	}
+	ASSERT(tm->tm_size == 0);
+}
+
+/*
+ * Called by the original malloc() and free() when they are given a request
+ * that the calling thread's per-thread cache could have held, because the
+ * cache missed or because the thread has not been seen since umem_ptc_gen
+ * last changed.  See section 8.5 of the big theory statement.
+ */
+void
+umem_ptc_miss(int isfree)
+{
+	umem_tmem_t *tm = _tmem_get();
+	uint32_t gen = umem_ptc_gen;
+
+	if (tm->tm_gen != gen || tm->tm_max == 0) {
+		/*
+		 * Give a new thread its initial budget, and take back the
+		 * cache of one that has been idle for an interval or more.
+		 */
+		if (tm->tm_max == 0 || gen - tm->tm_gen > 1) {
+			umem_ptc_flush(tm);
+			tm->tm_max = MAX(umem_ptc_size >> 3, 1);
+			tm->tm_amark = (uint32_t)tm->tm_amiss;
+		}
+		tm->tm_gen = gen;
+		return;
+	}
+
+	if (!isfree) {
+		tm->tm_amiss++;
+		return;
+	}
+
+	tm->tm_fmiss++;
+	if (tm->tm_max < umem_ptc_size &&
+	    (uint32_t)tm->tm_amiss != tm->tm_amark) {
+		tm->tm_max = MIN(tm->tm_max * 2, umem_ptc_size);
+		tm->tm_amark = (uint32_t)tm->tm_amiss;
+	}
+}
+
 static int
 umem_cache_init(void)
 {
@@ -3106,6 +3208,9 @@ umem_cache_init(void)
 	umem_magtype_t *mtp;
 	char name[UMEM_CACHE_NAMELEN + 1];
 	umem_cache_t *umem_alloc_caches[NUM_ALLOC_SIZES];
+	vmem_t *src_arena;
+	vmem_alloc_t *src_alloc;
+	vmem_free_t *src_free;
 
 	for (i = 0; i < sizeof (umem_magtype) / sizeof (*mtp); i++) {
 		mtp = &umem_magtype[i];
@@ -3169,9 +3274,26 @@ umem_cache_init(void)
 	if (umem_va_arena == NULL)
 		return (0);
 
+	src_arena = umem_va_arena;
+	src_alloc = heap_alloc;
+	src_free = heap_free;
+
+#ifndef UMEM_STANDALONE
+	/*
+	 * The mmap backend may want slabs built in whole large pages, so that
+	 * it can back them with large pages and give each one back as a whole.
+	 */
+	if ((vmem_backend & VMEM_BACKEND_MMAP) &&
+	    vmem_mmap_lpage_arena() != NULL) {
+		src_arena = vmem_mmap_lpage_arena();
+		src_alloc = vmem_alloc;
+		src_free = vmem_free;
+	}
+#endif
+
 	umem_default_arena = vmem_create("umem_default",
 	    NULL, 0, pagesize,
-	    heap_alloc, heap_free, umem_va_arena,
+	    src_alloc, src_free, src_arena,
 	    0, VM_NOSLEEP);
 
 	if (umem_default_arena == NULL)
@@ -3218,8 +3340,23 @@ umem_cache_init(void)
 	if (umem_genasm_supported && !(umem_flags & UMF_DEBUG) &&
 	    !(umem_flags & UMF_NOMAGAZINE) &&
 	    umem_ptc_size > 0) {
+		int nptc;
+
+		for (nptc = 0; nptc < i; nptc++) {
+			if (umem_alloc_sizes[nptc] > umem_ptc_maxbuf)
+				break;
+		}
+
 		umem_ptc_enabled = umem_genasm(umem_alloc_sizes,
-		    umem_alloc_caches, i) == 0 ? 1 : 0;
+		    umem_alloc_caches, nptc) == 0 ? 1 : 0;
+
+		while (umem_ptc_nents < nptc &&
+		    (umem_alloc_caches[umem_ptc_nents]->cache_flags & UMF_PTC))
+			umem_ptc_nents++;
+		if (umem_ptc_nents == 0)
+			umem_ptc_enabled = 0;
+		else
+			umem_ptc_limit = umem_alloc_sizes[umem_ptc_nents - 1];
 	}
 
 	/*
@@ -78,6 +78,27 @@ extern volatile uint32_t umem_reaping;
 
 extern uintptr_t umem_tmem_off;
 
+/*
+ * The per-thread cache state that libc keeps for us in each thread; see
+ * section 8 of the big theory statement in umem.c.  This must match libc's
+ * tumem_t, which has _tmem_get_nentries() roots.
+ */
+typedef struct umem_tmem {
+	size_t		tm_size;	/* bytes held in tm_roots */
+	size_t		tm_max;		/* most that tm_roots may hold */
+	uint64_t	tm_ahit;	/* allocations from tm_roots */
+	uint64_t	tm_fhit;	/* frees onto tm_roots */
+	uint64_t	tm_amiss;	/* cacheable allocs not from them */
+	uint64_t	tm_fmiss;	/* cacheable frees not onto them */
+	uint32_t	tm_gen;		/* umem_ptc_gen when last seen */
+	uint32_t	tm_amark;	/* tm_amiss when tm_max last grew */
+	void		*tm_roots[1];
+} umem_tmem_t;
+
+extern volatile uint32_t umem_ptc_gen;
+extern int umem_ptc_enabled;
+extern size_t umem_ptc_limit;
+
 /*
  * umem.c: tunables
  */
@@ -101,6 +122,7 @@ extern size_t umem_lite_maxalign;
 extern size_t umem_maxverify;
 extern size_t umem_minfirewall;
 extern size_t umem_ptc_size;
+extern size_t umem_ptc_maxbuf;
 
 extern uint32_t umem_flags;
 
@@ -118,6 +140,7 @@ extern void _umem_cache_free(umem_cache_t *cache, void *buffer);
  * umem.c: private interfaces
  */
 extern void umem_type_init(caddr_t, size_t, size_t);
+extern void umem_ptc_miss(int);
 extern int umem_get_max_ncpus(void);
 extern void umem_process_updates(void);
 extern void umem_cache_applyall(void (*)(umem_cache_t *));
@@ -83,6 +83,7 @@ umem_update_thread(void *arg)
 			 */
 			(void) mutex_unlock(&umem_update_lock);
 
+			umem_ptc_gen++;
 			vmem_update(NULL);
 			/*
 			 * umem_cache_update can use umem_add_update to
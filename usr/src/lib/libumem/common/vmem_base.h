@@ -52,6 +52,8 @@ extern void vmem_heap_init(void);
 extern vmem_t *vmem_sbrk_arena(vmem_alloc_t **, vmem_free_t **);
 extern vmem_t *vmem_mmap_arena(vmem_alloc_t **, vmem_free_t **);
 extern vmem_t *vmem_stand_arena(vmem_alloc_t **, vmem_free_t **);
+extern vmem_t *vmem_mmap_lpage_arena(void);
+extern size_t vmem_lpagesize(void);
 
 extern void vmem_update(void *);
 extern void vmem_reap(void);		/* vmem_populate()-safe reap */
@@ -59,6 +61,8 @@ extern void vmem_reap(void);		/* vmem_populate()-safe reap */
 extern size_t pagesize;
 extern size_t vmem_sbrk_pagesize;
 extern size_t vmem_sbrk_minalloc;
+extern size_t vmem_mmap_pagesize;
+extern size_t vmem_lpage_minheap;
 
 extern uint_t vmem_backend;
 #define	VMEM_BACKEND_SBRK	0x0000001
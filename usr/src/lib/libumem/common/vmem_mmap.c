@@ -26,12 +26,57 @@
 
 #pragma ident	"%Z%%M%	%I%	%E% SMI"
 
+/*
+ * The structure of the mmap backend:
+ *
+ * +-----------+
+ * | mmap_top  |
+ * +-----------+
+ *      |     \
+ *      |      \ (vmem_mmap_lpage_alloc(), vmem_mmap_lpage_free())
+ *      |       \
+ *      |        +------------+
+ *      |        | mmap_lpage |
+ *      |        +------------+
+ *      |              | (vmem_alloc(), vmem_free())
+ *      |         umem_default
+ *      |
+ *      | (vmem_mmap_top_alloc(), vmem_free())
+ *      |
+ * +-----------+
+ * | mmap_heap |
+ * +-----------+
+ *   | | ... |  (vmem_mmap_alloc(), vmem_mmap_free())
+ * <other arenas>
+ *
+ * mmap_top holds address space which has been reserved, but not mapped.
+ * Memory is mapped as it is imported from mmap_heap, and is unmapped as soon
+ * as it is given back.
+ *
+ * If the system has a page size larger than the base page size, the slabs
+ * of the umem caches are built in mmap_lpage instead.  Its spans are whole,
+ * aligned large pages, mapped as they are imported and unmapped when every
+ * slab in them has been freed, so that a large page is always given back as
+ * a whole.  Once vmem_lpage_minheap bytes have been mapped this way (small
+ * processes would otherwise pay for a whole large page right away), each span
+ * is mapped with MHA_MAPSIZE_VA advice so that it is backed by a large page.
+ * Large imports from mmap_heap (for oversized allocations) get the same advice
+ * for the large pages which they cover.
+ *
+ * mmap_pagesize picks the page size; setting it to the base page size turns
+ * all of this off.
+ */
+
 #include <unistd.h>
 #include <errno.h>
+#include <atomic.h>
 #include <sys/mman.h>
 #include <sys/sysmacros.h>
+#include <sys/vmem_impl_user.h>
 #include "vmem_base.h"
 
+#include "misc.h"
+
 #define	ALLOC_PROT	PROT_READ | PROT_WRITE | PROT_EXEC
 #define	FREE_PROT	PROT_NONE
 
@@ -40,7 +85,55 @@
 
 #define	CHUNKSIZE	(64*1024)	/* 64 kilobytes */
 
+size_t vmem_mmap_pagesize = 0; /* the preferred page size of the heap */
+
+#define	VMEM_LPAGE_MINHEAP	(16 * 1024 * 1024)
+size_t vmem_lpage_minheap = VMEM_LPAGE_MINHEAP; /* heap before large pages */
+
 static vmem_t *mmap_heap;
+static vmem_t *mmap_lpage;
+static size_t mmap_lpsize;	/* the large page size in use, or 0 */
+static ulong_t mmap_mapped;	/* bytes mapped, to compare to minheap */
+
+/*
+ * Return the smallest page size larger than the base page size, or 0 if
+ * there is none.
+ */
+size_t
+vmem_lpagesize(void)
+{
+	size_t pgsz[2];
+
+	if (getpagesizes(pgsz, 2) < 2)
+		return (0);
+	return (pgsz[1]);
+}
+
+/*
+ * Account for size bytes having been mapped at addr, and if the heap is big
+ * enough, ask for the whole large pages in that range to be large pages.
+ * This is only advice, so failure is not an error.
+ */
+static void
+vmem_mmap_advise(void *addr, size_t size)
+{
+	struct memcntl_mha mha;
+	uintptr_t start, end;
+
+	if (atomic_add_long_nv(&mmap_mapped, size) < vmem_lpage_minheap)
+		return;
+
+	start = P2ROUNDUP((uintptr_t)addr, mmap_lpsize);
+	end = P2ALIGN((uintptr_t)addr + size, mmap_lpsize);
+	if (start >= end)
+		return;
+
+	mha.mha_cmd = MHA_MAPSIZE_VA;
+	mha.mha_flags = 0;
+	mha.mha_pagesize = mmap_lpsize;
+	(void) memcntl((caddr_t)start, end - start, MC_HAT_ADVISE,
+	    (caddr_t)&mha, 0, 0);
+}
 
 static void *
 vmem_mmap_alloc(vmem_t *src, size_t size, int vmflags)
@@ -60,6 +153,9 @@ vmem_mmap_alloc(vmem_t *src, size_t size, int vmflags)
 		return (NULL);
 	}
 
+	if (ret != NULL && mmap_lpsize != 0 && size >= mmap_lpsize)
+		vmem_mmap_advise(ret, size);
+
 	errno = old_errno;
 	return (ret);
 }
@@ -69,10 +165,70 @@ vmem_mmap_free(vmem_t *src, void *addr, size_t size)
 {
 	int old_errno = errno;
 	(void) mmap(addr, size, FREE_PROT, FREE_FLAGS | MAP_FIXED, -1, 0);
+	if (mmap_lpsize != 0 && size >= mmap_lpsize)
+		atomic_add_long(&mmap_mapped, -size);
 	vmem_free(src, addr, size);
 	errno = old_errno;
 }
 
+/*
+ * Import whole large pages into mmap_lpage.  They are taken from mmap_top
+ * directly, so that they can be aligned, and mmap_top is grown with aligned
+ * reservations when it has nothing suitable.
+ */
+static void *
+vmem_mmap_lpage_alloc(vmem_t *src, size_t size, int vmflags)
+{
+	void *ret;
+	void *buf;
+	int old_errno = errno;
+
+	ASSERT(P2PHASE(size, mmap_lpsize) == 0);
+
+	ret = vmem_xalloc(src, size, mmap_lpsize, 0, 0, NULL, NULL,
+	    VM_NOSLEEP);
+	if (ret == NULL) {
+		buf = mmap((void *)mmap_lpsize, size, FREE_PROT,
+		    FREE_FLAGS | MAP_ALIGN, -1, 0);
+		if (buf == MAP_FAILED) {
+			ASSERT((vmflags & VM_NOSLEEP) == VM_NOSLEEP);
+			errno = old_errno;
+			return (NULL);
+		}
+		ret = _vmem_extend_alloc(src, buf, size, size, vmflags);
+		if (ret == NULL) {
+			(void) munmap(buf, size);
+			errno = old_errno;
+			return (NULL);
+		}
+	}
+
+	if (mmap(ret, size, ALLOC_PROT, ALLOC_FLAGS | MAP_FIXED, -1, 0) ==
+	    MAP_FAILED) {
+		vmem_xfree(src, ret, size);
+		vmem_reap();
+
+		ASSERT((vmflags & VM_NOSLEEP) == VM_NOSLEEP);
+		errno = old_errno;
+		return (NULL);
+	}
+
+	vmem_mmap_advise(ret, size);
+
+	errno = old_errno;
+	return (ret);
+}
+
+static void
+vmem_mmap_lpage_free(vmem_t *src, void *addr, size_t size)
+{
+	int old_errno = errno;
+	(void) mmap(addr, size, FREE_PROT, FREE_FLAGS | MAP_FIXED, -1, 0);
+	atomic_add_long(&mmap_mapped, -size);
+	vmem_xfree(src, addr, size);
+	errno = old_errno;
+}
+
 static void *
 vmem_mmap_top_alloc(vmem_t *src, size_t size, int vmflags)
 {
@@ -119,6 +275,20 @@ vmem_mmap_arena(vmem_alloc_t **a_out, vmem_free_t **f_out)
 	size_t pagesize = sysconf(_SC_PAGESIZE);
 
 	if (mmap_heap == NULL) {
+		size_t lpsize = vmem_mmap_pagesize;
+
+		if (issetugid()) {
+			lpsize = 0;
+		} else if (lpsize != 0 && !ISP2(lpsize)) {
+			log_message("ignoring bad pagesize: 0x%p\n", lpsize);
+			lpsize = 0;
+		}
+		if (lpsize == 0)
+			lpsize = vmem_lpagesize();
+		if (lpsize > pagesize)
+			mmap_lpsize = lpsize;
+		vmem_mmap_pagesize = MAX(lpsize, pagesize);
+
 		mmap_heap = vmem_init("mmap_top", CHUNKSIZE,
 		    vmem_mmap_top_alloc, vmem_free,
 		    "mmap_heap", NULL, 0, pagesize,
@@ -132,3 +302,20 @@ vmem_mmap_arena(vmem_alloc_t **a_out, vmem_free_t **f_out)
 
 	return (mmap_heap);
 }
+
+/*
+ * Return the arena which umem_default should build its slabs in, or NULL if
+ * large pages are not in use and it should import from the heap as usual.
+ */
+vmem_t *
+vmem_mmap_lpage_arena(void)
+{
+	if (mmap_lpage == NULL && mmap_lpsize != 0) {
+		mmap_lpage = vmem_create("mmap_lpage",
+		    NULL, 0, mmap_lpsize,
+		    vmem_mmap_lpage_alloc, vmem_mmap_lpage_free,
+		    mmap_heap->vm_source, 0, VM_NOSLEEP);
+	}
+
+	return (mmap_lpage);
+}
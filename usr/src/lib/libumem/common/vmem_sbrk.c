@@ -49,6 +49,12 @@
  *
  * Instead, we put it on a doubly-linked list, sbrk_fails, which we search
  * before calling sbrk().
+ *
+ * Unless sbrk_pagesize is set, the heap starts out with the base page size.
+ * Once it has grown to vmem_lpage_minheap, vmem_sbrk_lpage() switches it to
+ * the smallest large page size, so that big heaps get large pages without
+ * small processes paying for them.  Setting sbrk_pagesize to the base page
+ * size keeps it from doing so.
  */
 
 #include <errno.h>
@@ -68,6 +74,8 @@ size_t vmem_sbrk_minalloc = VMEM_SBRK_MINALLOC; /* minimum allocation */
 
 static size_t real_pagesize;
 static vmem_t *sbrk_heap;
+static size_t sbrk_lpsize;	/* large page size to switch to, or 0 */
+static size_t sbrk_grown;	/* bytes the heap has grown by */
 
 typedef struct sbrk_fail {
 	struct sbrk_fail *sf_next;
@@ -148,6 +156,30 @@ vmem_sbrk_tryfail(vmem_t *src, size_t size, int vmflags)
 	return (NULL);
 }
 
+/*
+ * Ask for the rest of the heap to be backed by large pages, and grow it in
+ * whole large pages from now on.  If two threads get here at once, the
+ * second just repeats the advice.
+ */
+static void
+vmem_sbrk_lpage(void)
+{
+	struct memcntl_mha mha;
+	size_t lpsize = sbrk_lpsize;
+
+	sbrk_lpsize = 0;
+
+	mha.mha_cmd = MHA_MAPSIZE_BSSBRK;
+	mha.mha_flags = 0;
+	mha.mha_pagesize = lpsize;
+
+	if (memcntl(NULL, 0, MC_HAT_ADVISE, (char *)&mha, 0, 0) == -1)
+		return;
+
+	vmem_sbrk_minalloc = P2ROUNDUP(vmem_sbrk_minalloc, lpsize);
+	vmem_sbrk_pagesize = lpsize;
+}
+
 static void *
 vmem_sbrk_alloc(vmem_t *src, size_t size, int vmflags)
 {
@@ -184,6 +216,10 @@ vmem_sbrk_alloc(vmem_t *src, size_t size, int vmflags)
 	    &buf_size);
 
 	if (buf != MAP_FAILED) {
+		if (sbrk_lpsize != 0 &&
+		    (sbrk_grown += buf_size) >= vmem_lpage_minheap)
+			vmem_sbrk_lpage();
+
 		ret = vmem_sbrk_extend_alloc(src, buf, buf_size, size, vmflags);
 		if (ret != NULL) {
 			errno = old_errno;
@@ -219,7 +255,7 @@ vmem_t *
 vmem_sbrk_arena(vmem_alloc_t **a_out, vmem_free_t **f_out)
 {
 	if (sbrk_heap == NULL) {
-		size_t heap_size;
+		size_t heap_size, lpsize;
 
 		real_pagesize = sysconf(_SC_PAGESIZE);
 
@@ -231,6 +267,9 @@ vmem_sbrk_arena(vmem_alloc_t **a_out, vmem_free_t **f_out)
 			heap_size = 0;
 			log_message("ignoring bad pagesize: 0x%p\n", heap_size);
 		}
+		lpsize = vmem_lpagesize();
+		if (heap_size == 0 && lpsize > real_pagesize)
+			sbrk_lpsize = lpsize;
 		if (heap_size <= real_pagesize) {
 			heap_size = real_pagesize;
 		} else {
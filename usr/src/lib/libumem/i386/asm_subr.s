@@ -95,18 +95,20 @@ _breakpoint(void)
 	jmp umem_malloc;
 	NOP256
 	NOP256
-#if defined(__amd64)
-	NOP64
-#endif
+	NOP256
+	NOP256
+	NOP256
+	NOP256
 	SET_SIZE(_malloc)
 
 	ENTRY(_free)
 	jmp umem_malloc_free;
 	NOP256
 	NOP256
-#if defined(__amd64)
-	NOP64
-#endif
+	NOP256
+	NOP256
+	NOP256
+	NOP256
 	SET_SIZE(_free)
 
 	ANSI_PRAGMA_WEAK2(malloc,_malloc,function)
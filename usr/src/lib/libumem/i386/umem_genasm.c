@@ -61,6 +61,7 @@
  */
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <strings.h>
 #include <umem_impl.h>
 #include "umem_base.h"
@@ -69,16 +70,16 @@
 
 const int umem_genasm_supported = 1;
 static uintptr_t umem_genasm_mptr = (uintptr_t)&_malloc;
-static size_t umem_genasm_msize = 512;
+static size_t umem_genasm_msize = 1536;
 static uintptr_t umem_genasm_fptr = (uintptr_t)&_free;
-static size_t umem_genasm_fsize = 512;
+static size_t umem_genasm_fsize = 1536;
 static uintptr_t umem_genasm_omptr = (uintptr_t)umem_malloc;
 static uintptr_t umem_genasm_ofptr = (uintptr_t)umem_malloc_free;
 /*
- * The maximum number of caches we can support. We use a single byte addl so
- * this is 255 (UINT8_MAX) / sizeof (uintptr_t). In this case 63
+ * The maximum number of caches we can support. We use a four byte addl so
+ * this is UINT32_MAX / sizeof (uintptr_t).
  */
-#define	UMEM_GENASM_MAX32	63
+#define	UMEM_GENASM_MAX32	(UINT32_MAX / sizeof (uintptr_t))
 
 #define	PTC_JMPADDR(dest, src)	(dest - (src + 4))
 #define	PTC_ROOT_SIZE	sizeof (uintptr_t)
@@ -96,12 +97,18 @@ static uintptr_t umem_genasm_ofptr = (uintptr_t)umem_malloc_free;
  * 	goto tomalloc;
  *
  * tmem_t *t = (uintptr_t)curthread() + umem_thr_offset;
+ * if (t->tm_gen != umem_ptc_gen)
+ * 	goto tomalloc;
  * void **roots = t->tm_roots;
  */
 #define	PTC_MALINIT_JOUT	0x0e
 #define	PTC_MALINIT_MCS	0x14
 #define	PTC_MALINIT_JOV	0x1a
 #define	PTC_MALINIT_SOFF	0x27
+#define	PTC_MALINIT_GEN	0x2d
+#define	PTC_MALINIT_TMGEN	0x33
+#define	PTC_MALINIT_JGEN	0x39
+#define	PTC_MALINIT_ROOTS	0x3f
 static const uint8_t malinit[] = {
 	0x55,					/* pushl %ebp */
 	0x89, 0xe5,				/* movl %esp, %ebp */
@@ -115,7 +122,10 @@ static const uint8_t malinit[] = {
 	0x0f, 0x87, 0x00, 0x00, 0x00, 0x00,	/* ja +$JMP (errout) */
 	0x65, 0x8b, 0x0d, 0x00, 0x00, 0x00, 0x00, 	/* movl %gs:0x0,%ecx */
 	0x81, 0xc1, 0x00, 0x00,	0x00, 0x00, 	/* addl $OFF, %ecx */
-	0x8d, 0x51, 0x04			/* leal 0x4(%ecx), %edx */
+	0x8b, 0x1d, 0x00, 0x00, 0x00, 0x00,	/* movl umem_ptc_gen, %ebx */
+	0x39, 0x99, 0x00, 0x00, 0x00, 0x00,	/* cmpl %ebx, $TMGEN(%ecx) */
+	0x0f, 0x85, 0x00, 0x00, 0x00, 0x00,	/* jne +$JMP (errout) */
+	0x8d, 0x51, 0x00			/* leal $ROOTS(%ecx), %edx */
 };
 
 /*
@@ -136,6 +146,8 @@ static const uint8_t malinit[] = {
  * 	goto tofree;
  *
  * tmem_t *t = (uintptr_t)curthread() + umem_thr_offset;
+ * if (t->tm_gen != umem_ptc_gen)
+ * 	goto tofree;
  * void **roots = t->tm_roots;
  */
 #define	PTC_FRINI_JDONE	0x0d
@@ -143,6 +155,10 @@ static const uint8_t malinit[] = {
 #define	PTC_FRINI_MCS	0x29
 #define	PTC_FRINI_JOV	0x2f
 #define	PTC_FRINI_SOFF	0x3c
+#define	PTC_FRINI_GEN	0x42
+#define	PTC_FRINI_TMGEN	0x48
+#define	PTC_FRINI_JGEN	0x4e
+#define	PTC_FRINI_ROOTS	0x54
 static const uint8_t freeinit[] = {
 	0x55,					/* pushl %ebp */
 	0x89, 0xe5,				/* movl %esp, %ebp */
@@ -163,7 +179,10 @@ static const uint8_t freeinit[] = {
 	0x0f, 0x87, 0x00, 0x00, 0x00, 0x00,	/* ja +$JMP (errout) */
 	0x65, 0x8b, 0x0d, 0x00, 0x0, 0x00, 0x00, /* movl %gs:0x0,%ecx */
 	0x81, 0xc1, 0x00, 0x00,	0x00, 0x00,	/* addl $0xOFF, %ecx */
-	0x8d, 0x51, 0x04			/* leal 0x4(%ecx),%edx */
+	0x8b, 0x1d, 0x00, 0x00, 0x00, 0x00,	/* movl umem_ptc_gen, %ebx */
+	0x39, 0x99, 0x00, 0x00, 0x00, 0x00,	/* cmpl %ebx, $TMGEN(%ecx) */
+	0x0f, 0x85, 0x00, 0x00, 0x00, 0x00,	/* jne +$JMP (errout) */
+	0x8d, 0x51, 0x00			/* leal $ROOTS(%ecx),%edx */
 };
 
 /*
@@ -189,12 +208,12 @@ static const uint8_t inicache[] = {
  */
 #define	PTC_GENCACHE_CMP	0x02
 #define	PTC_GENCACHE_NUM	0x0a
-#define	PTC_GENCACHE_SIZE 0x0c
-#define	PTC_GENCACHE_JMP	0x11
+#define	PTC_GENCACHE_SIZE 0x0f
+#define	PTC_GENCACHE_JMP	0x14
 static const uint8_t gencache[] = {
 	0x81, 0xfe, 0x00, 0x00, 0x00, 0x00, 	/* cmpl sizeof ($CACHE), %esi */
-	0x77, 0x0d,				/* ja +0xd (next cache) */
-	0x83, 0xc2, 0x00,			/* addl $4*$ii, %edx */
+	0x77, 0x10,				/* ja +0x10 (next cache) */
+	0x81, 0xc2, 0x00, 0x00, 0x00, 0x00,	/* addl $4*$ii, %edx */
 	0xbf, 0x00, 0x00, 0x00, 0x00, 		/* movl sizeof ($CACHE), %edi */
 	0xe9, 0x00, 0x00, 0x00, 0x00 		/* jmp +$JMP (allocbuf) */
 };
@@ -210,11 +229,11 @@ static const uint8_t gencache[] = {
 #define	PTC_FINCACHE_CMP 0x02
 #define	PTC_FINCACHE_JMP	0x07
 #define	PTC_FINCACHE_NUM 0x0a
-#define	PTC_FINCACHE_SIZE 0x0c
+#define	PTC_FINCACHE_SIZE 0x0f
 static const uint8_t fincache[] = {
 	0x81, 0xfe, 0xff, 0x00, 0x00, 0x00,	/* cmpl sizeof ($CLAST), %esi */
 	0x77, 0x00,				/* ja +$JMP (to errout) */
-	0x83, 0xc2, 0x00,			/* addl $4*($NCACHES-1), %edx */
+	0x81, 0xc2, 0x00, 0x00, 0x00, 0x00,	/* addl $4*($NCACHES-1), %edx */
 	0xbf, 0x00, 0x00, 0x00, 0x00, 		/* movl sizeof ($CLAST), %edi */
 };
 
@@ -224,7 +243,8 @@ static const uint8_t fincache[] = {
  *
  * malloc_data_t *ret = *root;
  * *root = *(void **)ret;
- * t->tm_size += csize;
+ * t->tm_size -= csize;
+ * t->tm_ahit++;
  * ret->malloc_size = size;
  *
  * ret->malloc_data = UMEM_MALLOC_ENCODE(MALLOC_SECOND_MAGIC, size);
@@ -235,16 +255,20 @@ static const uint8_t fincache[] = {
  * 	return (malloc(orig_size));
  */
 #define	PTC_MALFINI_ALLABEL	0x00
-#define	PTC_MALFINI_JMLABEL	0x20
-#define	PTC_MALFINI_JMADDR	0x25
+#define	PTC_MALFINI_AHIT	0x0e
+#define	PTC_MALFINI_AHITHI	0x15
+#define	PTC_MALFINI_JMLABEL	0x2e
+#define	PTC_MALFINI_JMADDR	0x33
 static const uint8_t malfini[] = {
 	/* allocbuf: */
 	0x8b, 0x02,			/* movl (%edx), %eax */
 	0x85, 0xc0,			/* testl %eax, %eax */
-	0x74, 0x1a,			/* je +0x1a (errout) */
-	0x8b, 0x18,			/* movl (%eax), %esi */
-	0x89, 0x1a,			/* movl %esi, (%edx) */
+	0x74, 0x28,			/* je +0x28 (errout) */
+	0x8b, 0x18,			/* movl (%eax), %ebx */
+	0x89, 0x1a,			/* movl %ebx, (%edx) */
 	0x29, 0x39,			/* subl %edi, (%ecx) */
+	0x83, 0x81, 0x00, 0x00, 0x00, 0x00, 0x01, /* addl $1, $AHIT(%ecx) */
+	0x83, 0x91, 0x00, 0x00, 0x00, 0x00, 0x00, /* adcl $0, $AHIT+4(%ecx) */
 	0x89, 0x30,			/* movl %esi, ($eax) */
 	0xba, 0x00, 0xc0, 0x10, 0x3a,	/* movl $0x3a10c000,%edx */
 	0x29, 0xf2,			/* subl %esi, %edx */
@@ -264,10 +288,11 @@ static const uint8_t malfini[] = {
 };
 
 /*
- * if (t->tm_size + csize > umem_ptc_size)
+ * if (t->tm_size + csize >= t->tm_max)
  * 	goto tofree;
  *
  * t->tm_size += csize
+ * t->tm_fhit++;
  * *(void **)tag = *root;
  * *root = tag;
  * return;
@@ -276,17 +301,21 @@ static const uint8_t malfini[] = {
  * 	return;
  */
 #define	PTC_FRFINI_RBUFLABEL	0x00
-#define	PTC_FRFINI_CACHEMAX	0x06
-#define	PTC_FRFINI_DONELABEL	0x14
-#define	PTC_FRFINI_JFLABEL	0x19
-#define	PTC_FRFINI_JFADDR	0x1e
+#define	PTC_FRFINI_TMMAX	0x06
+#define	PTC_FRFINI_FHIT		0x10
+#define	PTC_FRFINI_FHITHI	0x17
+#define	PTC_FRFINI_DONELABEL	0x22
+#define	PTC_FRFINI_JFLABEL	0x27
+#define	PTC_FRFINI_JFADDR	0x2c
 static const uint8_t freefini[] = {
 	/* freebuf: */
 	0x8b, 0x19,				/* movl (%ecx),%ebx */
 	0x01, 0xfb,				/* addl %edi,%ebx */
-	0x81, 0xfb, 0x00, 0x00, 0x00, 0x00, 	/* cmpl maxsize, %ebx */
-	0x73, 0x0d,				/* jae +0xd <tofree> */
+	0x3b, 0x99, 0x00, 0x00, 0x00, 0x00, 	/* cmpl $TMMAX(%ecx), %ebx */
+	0x73, 0x1b,				/* jae +0x1b <tofree> */
 	0x01, 0x39,				/* addl %edi,(%ecx) */
+	0x83, 0x81, 0x00, 0x00, 0x00, 0x00, 0x01, /* addl $1, $FHIT(%ecx) */
+	0x83, 0x91, 0x00, 0x00, 0x00, 0x00, 0x00, /* adcl $0, $FHIT+4(%ecx) */
 	0x8b, 0x3a,				/* movl (%edx),%edi */
 	0x89, 0x38,				/* movl %edi,(%eax) */
 	0x89, 0x02,				/* movl %eax,(%edx) */
@@ -304,6 +333,25 @@ static const uint8_t freefini[] = {
 	0xe9, 0x00, 0x00, 0x00, 0x00		/* jmp free */
 };
 
+/*
+ * Fill in the generation check and the roots offset that end both the malloc
+ * and free prologues.
+ */
+static void
+genasm_tmem(uint8_t *bp, uint32_t gp, uint32_t tp, uint32_t rp)
+{
+	uint32_t addr, tmgen;
+	uint8_t roots;
+
+	addr = (uintptr_t)&umem_ptc_gen;
+	bcopy(&addr, bp + gp, sizeof (addr));
+	tmgen = offsetof(umem_tmem_t, tm_gen);
+	bcopy(&tmgen, bp + tp, sizeof (tmgen));
+	ASSERT(offsetof(umem_tmem_t, tm_roots) <= INT8_MAX);
+	roots = offsetof(umem_tmem_t, tm_roots);
+	bcopy(&roots, bp + rp, sizeof (roots));
+}
+
 /*
  * Construct the initial part of malloc. off contains the offset from curthread
  * to the root of the tmem structure. ep is the address of the label to error
@@ -321,6 +369,9 @@ genasm_malinit(uint8_t *bp, uint32_t off, uint32_t ep, uint32_t csize)
 	addr = PTC_JMPADDR(ep, PTC_MALINIT_JOV);
 	bcopy(&addr, bp + PTC_MALINIT_JOV, sizeof (addr));
 	bcopy(&off, bp + PTC_MALINIT_SOFF, sizeof (off));
+	addr = PTC_JMPADDR(ep, PTC_MALINIT_JGEN);
+	bcopy(&addr, bp + PTC_MALINIT_JGEN, sizeof (addr));
+	genasm_tmem(bp, PTC_MALINIT_GEN, PTC_MALINIT_TMGEN, PTC_MALINIT_ROOTS);
 
 	return (sizeof (malinit));
 }
@@ -339,6 +390,9 @@ genasm_frinit(uint8_t *bp, uint32_t off, uint32_t dp, uint32_t ep, uint32_t mc)
 	addr = PTC_JMPADDR(ep, PTC_FRINI_JOV);
 	bcopy(&addr, bp + PTC_FRINI_JOV, sizeof (addr));
 	bcopy(&off, bp + PTC_FRINI_SOFF, sizeof (off));
+	addr = PTC_JMPADDR(ep, PTC_FRINI_JGEN);
+	bcopy(&addr, bp + PTC_FRINI_JGEN, sizeof (addr));
+	genasm_tmem(bp, PTC_FRINI_GEN, PTC_FRINI_TMGEN, PTC_FRINI_ROOTS);
 	return (sizeof (freeinit));
 }
 
@@ -366,9 +420,9 @@ static int
 genasm_gencache(uint8_t *bp, int num, uint32_t csize, uint32_t ap)
 {
 	uint32_t addr;
-	uint8_t	coff;
+	uint32_t coff;
 
-	ASSERT(256 / PTC_ROOT_SIZE > num);
+	ASSERT(UINT32_MAX / PTC_ROOT_SIZE > num);
 	ASSERT(num != 0);
 	bcopy(gencache, bp, sizeof (gencache));
 	bcopy(&csize, bp + PTC_GENCACHE_CMP, sizeof (csize));
@@ -385,14 +439,15 @@ static int
 genasm_lastcache(uint8_t *bp, int num, uint32_t csize, uint32_t ep)
 {
 	uint8_t addr;
+	uint32_t coff;
 
 	ASSERT(ep <= 0xff && ep > 7);
-	ASSERT(256 / PTC_ROOT_SIZE > num);
+	ASSERT(UINT32_MAX / PTC_ROOT_SIZE > num);
 	bcopy(fincache, bp, sizeof (fincache));
 	bcopy(&csize, bp + PTC_FINCACHE_CMP, sizeof (csize));
 	bcopy(&csize, bp + PTC_FINCACHE_SIZE, sizeof (csize));
-	addr = num * PTC_ROOT_SIZE;
-	bcopy(&addr, bp + PTC_FINCACHE_NUM, sizeof (addr));
+	coff = num * PTC_ROOT_SIZE;
+	bcopy(&coff, bp + PTC_FINCACHE_NUM, sizeof (coff));
 	addr = ep - PTC_FINCACHE_JMP - 1;
 	bcopy(&addr, bp + PTC_FINCACHE_JMP, sizeof (addr));
 
@@ -402,9 +457,13 @@ genasm_lastcache(uint8_t *bp, int num, uint32_t csize, uint32_t ep)
 static int
 genasm_malfini(uint8_t *bp, uintptr_t mptr)
 {
-	uint32_t addr;
+	uint32_t addr, ahit;
 
 	bcopy(malfini, bp, sizeof (malfini));
+	ahit = offsetof(umem_tmem_t, tm_ahit);
+	bcopy(&ahit, bp + PTC_MALFINI_AHIT, sizeof (ahit));
+	ahit += sizeof (uint32_t);
+	bcopy(&ahit, bp + PTC_MALFINI_AHITHI, sizeof (ahit));
 	addr = PTC_JMPADDR(mptr, ((uintptr_t)bp + PTC_MALFINI_JMADDR));
 	bcopy(&addr, bp + PTC_MALFINI_JMADDR, sizeof (addr));
 
@@ -412,12 +471,17 @@ genasm_malfini(uint8_t *bp, uintptr_t mptr)
 }
 
 static int
-genasm_frfini(uint8_t *bp, uint32_t maxthr, uintptr_t fptr)
+genasm_frfini(uint8_t *bp, uintptr_t fptr)
 {
-	uint32_t addr;
+	uint32_t addr, tmmax, fhit;
 
 	bcopy(freefini, bp, sizeof (freefini));
-	bcopy(&maxthr, bp + PTC_FRFINI_CACHEMAX, sizeof (maxthr));
+	tmmax = offsetof(umem_tmem_t, tm_max);
+	bcopy(&tmmax, bp + PTC_FRFINI_TMMAX, sizeof (tmmax));
+	fhit = offsetof(umem_tmem_t, tm_fhit);
+	bcopy(&fhit, bp + PTC_FRFINI_FHIT, sizeof (fhit));
+	fhit += sizeof (uint32_t);
+	bcopy(&fhit, bp + PTC_FRFINI_FHITHI, sizeof (fhit));
 	addr = PTC_JMPADDR(fptr, ((uintptr_t)bp + PTC_FRFINI_JFADDR));
 	bcopy(&addr, bp + PTC_FRFINI_JFADDR, sizeof (addr));
 
@@ -530,7 +594,7 @@ genasm_free(void *base, size_t len, int nents, int *umem_alloc_sizes)
 
 	bp += genasm_lastcache(bp, nents - 1, umem_alloc_sizes[nents - 1],
 	    erroff);
-	bp += genasm_frfini(bp, umem_ptc_size, umem_genasm_ofptr);
+	bp += genasm_frfini(bp, umem_genasm_ofptr);
 	ASSERT(((uintptr_t)bp - total) == (uintptr_t)base);
 
 	return (0);
@@ -554,8 +618,7 @@ umem_genasm(int *alloc_sizes, umem_cache_t **caches, int ncaches)
 	 * The total number of caches that we can service is the minimum of:
 	 *  o the amount supported by libc
 	 *  o the total number of umem caches
-	 *  o we use a single byte addl, so it's 255 / sizeof (uintptr_t). For
-	 *    32-bit, this is 63.
+	 *  o we use a four byte addl, so it's MAX_UINT32 / sizeof (uintptr_t)
 	 */
 	nents = _tmem_get_nentries();
 
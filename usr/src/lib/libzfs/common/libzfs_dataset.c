@@ -352,16 +352,14 @@ get_recvd_props_ioctl(zfs_handle_t *zhp)
 	return (0);
 }
 
+/*
+ * Make 'allprops' the handle's property list.  The handle takes ownership
+ * of it, even on failure.
+ */
 static int
-put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+put_props_zhdl(zfs_handle_t *zhp, nvlist_t *allprops)
 {
-	nvlist_t *allprops, *userprops;
-
-	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
-
-	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
-		return (-1);
-	}
+	nvlist_t *userprops;
 
 	/*
 	 * XXX Why do we store the user props separately, in addition to
@@ -381,6 +379,20 @@ put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+static int
+put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	nvlist_t *allprops;
+
+	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
+
+	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
+		return (-1);
+	}
+
+	return (put_props_zhdl(zhp, allprops));
+}
+
 static int
 get_stats(zfs_handle_t *zhp)
 {
@@ -407,15 +419,11 @@ zfs_refresh_properties(zfs_handle_t *zhp)
 }
 
 /*
- * Makes a handle from the given dataset name.  Used by zfs_open() and
- * zfs_iter_* to create child handles on the fly.
+ * Finish a handle whose stats and properties have been filled in.
  */
 static int
-make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+make_dataset_handle_finish(zfs_handle_t *zhp)
 {
-	if (put_stats_zhdl(zhp, zc) != 0)
-		return (-1);
-
 	/*
 	 * We've managed to open the dataset and gather statistics.  Determine
 	 * the high-level type.
@@ -442,6 +450,19 @@ make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+/*
+ * Makes a handle from the given dataset name.  Used by zfs_open() to
+ * create handles on the fly.
+ */
+static int
+make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	if (put_stats_zhdl(zhp, zc) != 0)
+		return (-1);
+
+	return (make_dataset_handle_finish(zhp));
+}
+
 zfs_handle_t *
 make_dataset_handle(libzfs_handle_t *hdl, const char *path)
 {
@@ -471,25 +492,64 @@ make_dataset_handle(libzfs_handle_t *hdl, const char *path)
 	return (zhp);
 }
 
+/*
+ * Makes a handle from one entry of the "datasets" nvlist returned by
+ * lzc_list().  Used by zfs_iter_* to create child handles on the fly.  If
+ * 'props_table' is non-NULL, only the properties it selects were asked
+ * for; see zfs_prune_proplist().
+ */
 zfs_handle_t *
-make_dataset_handle_zc(libzfs_handle_t *hdl, zfs_cmd_t *zc)
+make_dataset_handle_nvl(libzfs_handle_t *hdl, const char *name,
+    nvlist_t *entry, uint8_t *props_table)
 {
 	zfs_handle_t *zhp = calloc(sizeof (zfs_handle_t), 1);
+	dmu_objset_stats_t *dds;
+	nvlist_t *stats, *allprops;
+	char *origin;
 
 	if (zhp == NULL)
 		return (NULL);
 
 	zhp->zfs_hdl = hdl;
-	(void) strlcpy(zhp->zfs_name, zc->zc_name, sizeof (zhp->zfs_name));
-	if (make_dataset_handle_common(zhp, zc) == -1) {
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
+	zhp->zfs_props_table = props_table;
+
+	stats = fnvlist_lookup_nvlist(entry, "stats");
+	dds = &zhp->zfs_dmustats;
+	dds->dds_type = fnvlist_lookup_uint64(stats, "type");
+	dds->dds_num_clones = fnvlist_lookup_uint64(stats, "num_clones");
+	dds->dds_creation_txg = fnvlist_lookup_uint64(stats, "creation_txg");
+	dds->dds_guid = fnvlist_lookup_uint64(stats, "guid");
+	dds->dds_is_snapshot = fnvlist_lookup_boolean_value(stats,
+	    "is_snapshot");
+	dds->dds_inconsistent = fnvlist_lookup_boolean_value(stats,
+	    "inconsistent");
+	if (nvlist_lookup_string(stats, "origin", &origin) == 0) {
+		(void) strlcpy(dds->dds_origin, origin,
+		    sizeof (dds->dds_origin));
+	}
+
+	if (nvlist_dup(fnvlist_lookup_nvlist(entry, "props"),
+	    &allprops, 0) != 0) {
+		(void) no_memory(hdl);
+		free(zhp);
+		return (NULL);
+	}
+	if (put_props_zhdl(zhp, allprops) != 0 ||
+	    make_dataset_handle_finish(zhp) != 0) {
+		nvlist_free(zhp->zfs_props);
+		nvlist_free(zhp->zfs_user_props);
 		free(zhp);
 		return (NULL);
 	}
 	return (zhp);
 }
 
+/*
+ * Makes a handle carrying only the name of a snapshot of 'pzhp'.
+ */
 zfs_handle_t *
-make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
+make_dataset_simple_handle(zfs_handle_t *pzhp, const char *name)
 {
 	zfs_handle_t *zhp = calloc(sizeof (zfs_handle_t), 1);
 
@@ -497,7 +557,7 @@ make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
 		return (NULL);
 
 	zhp->zfs_hdl = pzhp->zfs_hdl;
-	(void) strlcpy(zhp->zfs_name, zc->zc_name, sizeof (zhp->zfs_name));
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
 	zhp->zfs_head_type = pzhp->zfs_type;
 	zhp->zfs_type = ZFS_TYPE_SNAPSHOT;
 	zhp->zpool_hdl = zpool_handle(zhp);
@@ -1068,6 +1128,29 @@ zfs_valid_proplist(libzfs_handle_t *hdl, zfs_type_t type, nvlist_t *nvl,
 			}
 			break;
 		}
+
+		case ZFS_PROP_SPECIAL_SMALL_BLOCKS:
+		{
+			int maxbs = SPA_OLD_MAXBLOCKSIZE;
+			if (zpool_hdl != NULL) {
+				maxbs = zpool_get_prop_int(zpool_hdl,
+				    ZPOOL_PROP_MAXBLOCKSIZE, NULL);
+			}
+			/*
+			 * The value must be zero or a power of two between
+			 * SPA_MINBLOCKSIZE and maxbs.
+			 */
+			if (intval != 0 && (intval < SPA_MINBLOCKSIZE ||
+			    intval > maxbs || !ISP2(intval))) {
+				zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+				    "'%s' must be zero or a power of 2 from "
+				    "512B to %uKB"), propname, maxbs >> 10);
+				(void) zfs_error(hdl, EZFS_BADPROP, errbuf);
+				goto error;
+			}
+			break;
+		}
+
 		case ZFS_PROP_MLSLABEL:
 		{
 			/*
@@ -1978,6 +2061,8 @@ get_numeric_property(zfs_handle_t *zhp, zfs_prop_t prop, zprop_source_t *src,
 	case ZFS_PROP_REFQUOTA:
 	case ZFS_PROP_RESERVATION:
 	case ZFS_PROP_REFRESERVATION:
+	case ZFS_PROP_ARCQUOTA:
+	case ZFS_PROP_ARCRESERVATION:
 	case ZFS_PROP_FILESYSTEM_LIMIT:
 	case ZFS_PROP_SNAPSHOT_LIMIT:
 	case ZFS_PROP_FILESYSTEM_COUNT:
@@ -2358,6 +2443,8 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 	case ZFS_PROP_REFQUOTA:
 	case ZFS_PROP_RESERVATION:
 	case ZFS_PROP_REFRESERVATION:
+	case ZFS_PROP_ARCQUOTA:
+	case ZFS_PROP_ARCRESERVATION:
 
 		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
 			return (-1);
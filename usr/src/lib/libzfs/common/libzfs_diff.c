@@ -44,6 +44,7 @@
 #include <stdlib.h>
 #include <stropts.h>
 #include <pthread.h>
+#include <atomic.h>
 #include <sys/zfs_ioctl.h>
 #include <libzfs.h>
 #include "libzfs_impl.h"
@@ -57,6 +58,26 @@
 #define	ZDIFF_REMOVED	'-'
 #define	ZDIFF_RENAMED	'R'
 
+#define	ZDIFF_BATCH	1024	/* objects looked up at once */
+#define	ZDIFF_RESOLVERS	8	/* threads looking them up */
+
+/*
+ * What ZFS_IOC_OBJ_TO_STATS said about an object in one snapshot.
+ */
+typedef struct differ_stat {
+	int ds_err;			/* errno from the ioctl, or 0 */
+	zfs_stat_t ds_sb;
+	uint64_t ds_parent;		/* for ZFS_DIFF_OBJECTS */
+	char ds_name[MAXPATHLEN];	/* path, or name in ds_parent */
+} differ_stat_t;
+
+typedef struct differ_obj {
+	uint64_t dob_obj;
+	boolean_t dob_free;		/* only in the from snapshot */
+	differ_stat_t dob_from;
+	differ_stat_t dob_to;
+} differ_obj_t;
+
 typedef struct differ_info {
 	zfs_handle_t *zhp;
 	char *fromsnap;
@@ -71,37 +92,57 @@ typedef struct differ_info {
 	boolean_t scripted;
 	boolean_t classify;
 	boolean_t timestamped;
+	boolean_t objects;
 	uint64_t shares;
 	int zerr;
 	int cleanupfd;
 	int outputfd;
 	int datafd;
+	differ_obj_t *batch;
+	uint_t nbatch;
+	uint_t nextobj;			/* next in batch to look up */
 } differ_info_t;
 
 /*
- * Given a {dsname, object id}, get the object path
+ * Given a {dsname, object id}, get the object path.  With
+ * ZFS_DIFF_OBJECTS, get just its name and parent instead, leaving it to
+ * the consumer to know the parent's path.
  */
-static int
-get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
-    char *pn, int maxlen, zfs_stat_t *sb)
+static void
+lookup_obj(differ_info_t *di, const char *dsname, uint64_t obj,
+    differ_stat_t *ds)
 {
 	zfs_cmd_t zc = { 0 };
-	int error;
 
 	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
 	zc.zc_obj = obj;
-
-	errno = 0;
-	error = ioctl(di->zhp->zfs_hdl->libzfs_fd, ZFS_IOC_OBJ_TO_STATS, &zc);
-	di->zerr = errno;
+	if (di->objects)
+		zc.zc_flags = ZFS_OBJ_STATS_NAME;
+
+	if (ioctl(di->zhp->zfs_hdl->libzfs_fd, ZFS_IOC_OBJ_TO_STATS,
+	    &zc) == 0) {
+		ds->ds_err = 0;
+		ds->ds_parent = zc.zc_cookie;
+		(void) strlcpy(ds->ds_name, zc.zc_value,
+		    sizeof (ds->ds_name));
+	} else {
+		ds->ds_err = errno;
+	}
 
 	/* we can get stats even if we failed to get a path */
-	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
-	if (error == 0) {
-		ASSERT(di->zerr == 0);
-		(void) strlcpy(pn, zc.zc_value, maxlen);
+	(void) memcpy(&ds->ds_sb, &zc.zc_stat, sizeof (zfs_stat_t));
+}
+
+/*
+ * Report how a lookup_obj() went, in the manner of the ioctl.
+ */
+static int
+get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
+    differ_stat_t *ds)
+{
+	di->zerr = ds->ds_err;
+	if (di->zerr == 0)
 		return (0);
-	}
 
 	if (di->zerr == EPERM) {
 		(void) snprintf(di->errbuf, sizeof (di->errbuf),
@@ -184,15 +225,20 @@ print_what(FILE *fp, mode_t what)
 }
 
 static void
-print_cmn(FILE *fp, differ_info_t *di, const char *file)
+print_cmn(FILE *fp, differ_info_t *di, uint64_t obj, differ_stat_t *ds)
 {
-	stream_bytes(fp, di->dsmnt);
-	stream_bytes(fp, file);
+	if (di->objects) {
+		(void) fprintf(fp, "%llu\t%llu\t", (u_longlong_t)obj,
+		    (u_longlong_t)ds->ds_parent);
+	} else {
+		stream_bytes(fp, di->dsmnt);
+	}
+	stream_bytes(fp, ds->ds_name);
 }
 
 static void
-print_rename(FILE *fp, differ_info_t *di, const char *old, const char *new,
-    zfs_stat_t *isb)
+print_rename(FILE *fp, differ_info_t *di, uint64_t obj, differ_stat_t *old,
+    differ_stat_t *new, zfs_stat_t *isb)
 {
 	if (di->timestamped)
 		(void) fprintf(fp, "%10lld.%09lld\t",
@@ -203,18 +249,18 @@ print_rename(FILE *fp, differ_info_t *di, const char *old, const char *new,
 		print_what(fp, isb->zs_mode);
 		(void) fprintf(fp, "\t");
 	}
-	print_cmn(fp, di, old);
+	print_cmn(fp, di, obj, old);
 	if (di->scripted)
 		(void) fprintf(fp, "\t");
 	else
 		(void) fprintf(fp, " -> ");
-	print_cmn(fp, di, new);
+	print_cmn(fp, di, obj, new);
 	(void) fprintf(fp, "\n");
 }
 
 static void
-print_link_change(FILE *fp, differ_info_t *di, int delta, const char *file,
-    zfs_stat_t *isb)
+print_link_change(FILE *fp, differ_info_t *di, int delta, uint64_t obj,
+    differ_stat_t *ds, zfs_stat_t *isb)
 {
 	if (di->timestamped)
 		(void) fprintf(fp, "%10lld.%09lld\t",
@@ -225,15 +271,17 @@ print_link_change(FILE *fp, differ_info_t *di, int delta, const char *file,
 		print_what(fp, isb->zs_mode);
 		(void) fprintf(fp, "\t");
 	}
-	print_cmn(fp, di, file);
+	print_cmn(fp, di, obj, ds);
 	(void) fprintf(fp, "\t(%+d)", delta);
 	(void) fprintf(fp, "\n");
 }
 
 static void
-print_file(FILE *fp, differ_info_t *di, char type, const char *file,
-    zfs_stat_t *isb)
+print_file(FILE *fp, differ_info_t *di, char type, uint64_t obj,
+    differ_stat_t *ds)
 {
+	zfs_stat_t *isb = &ds->ds_sb;
+
 	if (di->timestamped)
 		(void) fprintf(fp, "%10lld.%09lld\t",
 		    (longlong_t)isb->zs_ctime[0],
@@ -243,35 +291,33 @@ print_file(FILE *fp, differ_info_t *di, char type, const char *file,
 		print_what(fp, isb->zs_mode);
 		(void) fprintf(fp, "\t");
 	}
-	print_cmn(fp, di, file);
+	print_cmn(fp, di, obj, ds);
 	(void) fprintf(fp, "\n");
 }
 
 static int
-write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+write_inuse_diffs_one(FILE *fp, differ_info_t *di, differ_obj_t *dob)
 {
-	struct zfs_stat fsb, tsb;
+	uint64_t dobj = dob->dob_obj;
+	differ_stat_t *fds = &dob->dob_from;
+	differ_stat_t *tds = &dob->dob_to;
+	zfs_stat_t *fsb = &fds->ds_sb;
+	zfs_stat_t *tsb = &tds->ds_sb;
 	mode_t fmode, tmode;
-	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
 	int fobjerr, tobjerr;
 	int change;
 
-	if (dobj == di->shares)
-		return (0);
-
 	/*
 	 * Check the from and to snapshots for info on the object. If
 	 * we get ENOENT, then the object just didn't exist in that
 	 * snapshot.  If we get ENOTSUP, then we tried to get
 	 * info on a non-ZPL object, which we don't care about anyway.
 	 */
-	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
-	    MAXPATHLEN, &fsb);
+	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fds);
 	if (fobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
 		return (-1);
 
-	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
-	    MAXPATHLEN, &tsb);
+	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tds);
 	if (tobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
 		return (-1);
 
@@ -285,86 +331,155 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	}
 
 	di->zerr = 0; /* negate get_stats_for_obj() from side that failed */
-	fmode = fsb.zs_mode & S_IFMT;
-	tmode = tsb.zs_mode & S_IFMT;
-	if (fmode == S_IFDIR || tmode == S_IFDIR || fsb.zs_links == 0 ||
-	    tsb.zs_links == 0)
+	fmode = fsb->zs_mode & S_IFMT;
+	tmode = tsb->zs_mode & S_IFMT;
+	if (fmode == S_IFDIR || tmode == S_IFDIR || fsb->zs_links == 0 ||
+	    tsb->zs_links == 0)
 		change = 0;
 	else
-		change = tsb.zs_links - fsb.zs_links;
+		change = tsb->zs_links - fsb->zs_links;
 
 	if (fobjerr) {
 		if (change) {
-			print_link_change(fp, di, change, tobjname, &tsb);
+			print_link_change(fp, di, change, dobj, tds, tsb);
 			return (0);
 		}
-		print_file(fp, di, ZDIFF_ADDED, tobjname, &tsb);
+		print_file(fp, di, ZDIFF_ADDED, dobj, tds);
 		return (0);
 	} else if (tobjerr) {
 		if (change) {
-			print_link_change(fp, di, change, fobjname, &fsb);
+			print_link_change(fp, di, change, dobj, fds, fsb);
 			return (0);
 		}
-		print_file(fp, di, ZDIFF_REMOVED, fobjname, &fsb);
+		print_file(fp, di, ZDIFF_REMOVED, dobj, fds);
 		return (0);
 	}
 
-	if (fmode != tmode && fsb.zs_gen == tsb.zs_gen)
-		tsb.zs_gen++;	/* Force a generational difference */
+	if (fmode != tmode && fsb->zs_gen == tsb->zs_gen)
+		tsb->zs_gen++;	/* Force a generational difference */
 
 	/* Simple modification or no change */
-	if (fsb.zs_gen == tsb.zs_gen) {
+	if (fsb->zs_gen == tsb->zs_gen) {
 		/* No apparent changes.  Could we assert !this?  */
-		if (fsb.zs_ctime[0] == tsb.zs_ctime[0] &&
-		    fsb.zs_ctime[1] == tsb.zs_ctime[1])
+		if (fsb->zs_ctime[0] == tsb->zs_ctime[0] &&
+		    fsb->zs_ctime[1] == tsb->zs_ctime[1])
 			return (0);
 		if (change) {
-			print_link_change(fp, di, change,
-			    change > 0 ? fobjname : tobjname, &tsb);
-		} else if (strcmp(fobjname, tobjname) == 0) {
-			print_file(fp, di, ZDIFF_MODIFIED, fobjname, &tsb);
+			print_link_change(fp, di, change, dobj,
+			    change > 0 ? fds : tds, tsb);
+		} else if (fds->ds_parent == tds->ds_parent &&
+		    strcmp(fds->ds_name, tds->ds_name) == 0) {
+			print_file(fp, di, ZDIFF_MODIFIED, dobj, tds);
 		} else {
-			print_rename(fp, di, fobjname, tobjname, &tsb);
+			print_rename(fp, di, dobj, fds, tds, tsb);
 		}
 		return (0);
 	} else {
 		/* file re-created or object re-used */
-		print_file(fp, di, ZDIFF_REMOVED, fobjname, &fsb);
-		print_file(fp, di, ZDIFF_ADDED, tobjname, &tsb);
+		print_file(fp, di, ZDIFF_REMOVED, dobj, fds);
+		print_file(fp, di, ZDIFF_ADDED, dobj, tds);
 		return (0);
 	}
 }
 
 static int
-write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+describe_free(FILE *fp, differ_info_t *di, differ_obj_t *dob)
 {
-	uint64_t o;
-	int err;
+	differ_stat_t *ds = &dob->dob_from;
 
-	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
-		if ((err = write_inuse_diffs_one(fp, di, o)) != 0)
-			return (err);
+	if (get_stats_for_obj(di, di->fromsnap, dob->dob_obj, ds) != 0) {
+		/* Let it slide, if in the delete queue on from side */
+		if (di->zerr == ENOENT && ds->ds_sb.zs_links == 0) {
+			di->zerr = 0;
+			return (0);
+		}
+		return (-1);
 	}
+
+	print_file(fp, di, ZDIFF_REMOVED, dob->dob_obj, ds);
 	return (0);
 }
 
+static void *
+resolver(void *arg)
+{
+	differ_info_t *di = arg;
+	uint_t i;
+
+	while ((i = atomic_inc_uint_nv(&di->nextobj) - 1) < di->nbatch) {
+		differ_obj_t *dob = &di->batch[i];
+
+		lookup_obj(di, di->fromsnap, dob->dob_obj, &dob->dob_from);
+		if (!dob->dob_free)
+			lookup_obj(di, di->tosnap, dob->dob_obj, &dob->dob_to);
+	}
+	return (NULL);
+}
+
+/*
+ * Each object costs an ioctl per snapshot, most of it spent walking up
+ * the directory tree; so look up a batch of objects with several
+ * threads, and then report on them in order.
+ */
 static int
-describe_free(FILE *fp, differ_info_t *di, uint64_t object, char *namebuf,
-    int maxlen)
+flush_batch(FILE *fp, differ_info_t *di)
 {
-	struct zfs_stat sb;
+	pthread_t tids[ZDIFF_RESOLVERS - 1];
+	int nthreads, i;
+	int err = 0;
 
-	if (get_stats_for_obj(di, di->fromsnap, object, namebuf,
-	    maxlen, &sb) != 0) {
-		/* Let it slide, if in the delete queue on from side */
-		if (di->zerr == ENOENT && sb.zs_links == 0) {
-			di->zerr = 0;
-			return (0);
-		}
-		return (-1);
+	/* the helpers use di, so must not be left behind by a cancel */
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	di->nextobj = 0;
+	for (nthreads = 0; nthreads < ZDIFF_RESOLVERS - 1 &&
+	    (nthreads + 1) * 16 < di->nbatch; nthreads++) {
+		if (pthread_create(&tids[nthreads], NULL, resolver, di) != 0)
+			break;
+	}
+	(void) resolver(di);
+	for (i = 0; i < nthreads; i++)
+		(void) pthread_join(tids[i], NULL);
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+	for (i = 0; i < di->nbatch && err == 0; i++) {
+		differ_obj_t *dob = &di->batch[i];
+
+		if (dob->dob_free)
+			err = describe_free(fp, di, dob);
+		else
+			err = write_inuse_diffs_one(fp, di, dob);
 	}
+	di->nbatch = 0;
+	return (err);
+}
 
-	print_file(fp, di, ZDIFF_REMOVED, namebuf, &sb);
+static int
+add_obj(FILE *fp, differ_info_t *di, uint64_t obj, boolean_t isfree)
+{
+	differ_obj_t *dob;
+	int err;
+
+	if (di->nbatch == ZDIFF_BATCH && (err = flush_batch(fp, di)) != 0)
+		return (err);
+
+	dob = &di->batch[di->nbatch++];
+	dob->dob_obj = obj;
+	dob->dob_free = isfree;
+	return (0);
+}
+
+static int
+write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+{
+	uint64_t o;
+	int err;
+
+	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
+		if (o == di->shares)
+			continue;
+		if ((err = add_obj(fp, di, o, B_FALSE)) != 0)
+			return (err);
+	}
 	return (0);
 }
 
@@ -373,7 +488,6 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 {
 	zfs_cmd_t zc = { 0 };
 	libzfs_handle_t *lhdl = di->zhp->zfs_hdl;
-	char fobjname[MAXPATHLEN];
 
 	(void) strlcpy(zc.zc_name, di->fromsnap, sizeof (zc.zc_name));
 	zc.zc_obj = dr->ddr_first - 1;
@@ -392,8 +506,7 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 			if (zc.zc_obj > dr->ddr_last) {
 				break;
 			}
-			err = describe_free(fp, di, zc.zc_obj, fobjname,
-			    MAXPATHLEN);
+			err = add_obj(fp, di, zc.zc_obj, B_TRUE);
 			if (err)
 				break;
 		} else if (errno == ESRCH) {
@@ -443,6 +556,8 @@ differ(void *arg)
 			break;
 		} else if (rv == 0) {
 			/* end of file at a natural breaking point */
+			if (di->nbatch != 0)
+				err = flush_batch(ofp, di);
 			break;
 		}
 
@@ -537,6 +652,7 @@ teardown_differ_info(differ_info_t *di)
 	free(di->tosnap);
 	free(di->tmpsnap);
 	free(di->tomnt);
+	free(di->batch);
 	(void) close(di->cleanupfd);
 }
 
@@ -759,6 +875,12 @@ zfs_show_diffs(zfs_handle_t *zhp, int outfd, const char *fromsnap,
 		return (-1);
 	}
 
+	di.batch = zfs_alloc(zhp->zfs_hdl, ZDIFF_BATCH * sizeof (differ_obj_t));
+	if (di.batch == NULL) {
+		teardown_differ_info(&di);
+		return (-1);
+	}
+
 	if (pipe(pipefd)) {
 		zfs_error_aux(zhp->zfs_hdl, strerror(errno));
 		teardown_differ_info(&di);
@@ -768,6 +890,9 @@ zfs_show_diffs(zfs_handle_t *zhp, int outfd, const char *fromsnap,
 	di.scripted = (flags & ZFS_DIFF_PARSEABLE);
 	di.classify = (flags & ZFS_DIFF_CLASSIFY);
 	di.timestamped = (flags & ZFS_DIFF_TIMESTAMP);
+	di.objects = (flags & ZFS_DIFF_OBJECTS);
+	if (di.objects)
+		di.scripted = B_TRUE;
 
 	di.outputfd = outfd;
 	di.datafd = pipefd[0];
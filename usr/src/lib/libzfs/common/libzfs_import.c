@@ -57,6 +57,7 @@
 #include <sys/dktp/fdisk.h>
 #include <sys/efi_partition.h>
 #include <thread_pool.h>
+#include <pthread.h>
 
 #include <sys/vdev_impl.h>
 
@@ -911,6 +912,20 @@ zpool_read_label(int fd, nvlist_t **config)
 	return (0);
 }
 
+/*
+ * The devices whose labels have been read, by devid and minor name, so that
+ * a disk reachable through several paths is read only once.
+ */
+typedef struct devid_cache {
+	pthread_mutex_t dc_lock;
+	avl_tree_t dc_tree;
+} devid_cache_t;
+
+typedef struct devid_node {
+	char *dn_devid;
+	avl_node_t dn_node;
+} devid_node_t;
+
 typedef struct rdsk_node {
 	char *rn_name;
 	int rn_dfd;
@@ -919,8 +934,61 @@ typedef struct rdsk_node {
 	avl_tree_t *rn_avl;
 	avl_node_t rn_node;
 	boolean_t rn_nozpool;
+	boolean_t rn_hint;
+	devid_cache_t *rn_devids;
 } rdsk_node_t;
 
+static int
+devid_cache_compare(const void *arg1, const void *arg2)
+{
+	int rv = strcmp(((devid_node_t *)arg1)->dn_devid,
+	    ((devid_node_t *)arg2)->dn_devid);
+
+	if (rv == 0)
+		return (0);
+	return (rv > 0 ? 1 : -1);
+}
+
+/*
+ * Returns true if a device with the same devid and minor name as 'fd' has
+ * already been seen, and records it if not.
+ */
+static boolean_t
+devid_cache_seen(devid_cache_t *dc, int fd)
+{
+	ddi_devid_t devid;
+	char *minor;
+	devid_node_t search, *dn;
+	avl_index_t where;
+	boolean_t seen = B_TRUE;
+
+	if (devid_get(fd, &devid) != 0)
+		return (B_FALSE);
+	if (devid_get_minor_name(fd, &minor) != 0) {
+		devid_free(devid);
+		return (B_FALSE);
+	}
+	search.dn_devid = devid_str_encode(devid, minor);
+	devid_str_free(minor);
+	devid_free(devid);
+	if (search.dn_devid == NULL)
+		return (B_FALSE);
+
+	(void) pthread_mutex_lock(&dc->dc_lock);
+	if (avl_find(&dc->dc_tree, &search, &where) == NULL &&
+	    (dn = malloc(sizeof (devid_node_t))) != NULL) {
+		dn->dn_devid = search.dn_devid;
+		avl_insert(&dc->dc_tree, dn, where);
+		search.dn_devid = NULL;
+		seen = B_FALSE;
+	}
+	(void) pthread_mutex_unlock(&dc->dc_lock);
+
+	if (search.dn_devid != NULL)
+		devid_str_free(search.dn_devid);
+	return (seen);
+}
+
 static int
 slice_cache_compare(const void *arg1, const void *arg2)
 {
@@ -1066,6 +1134,12 @@ zpool_open_func(void *arg)
 		(void) close(fd);
 		return;
 	} else if (!S_ISREG(statbuf.st_mode)) {
+		/* another path to this device has already been read */
+		if (devid_cache_seen(rn->rn_devids, fd)) {
+			(void) close(fd);
+			return;
+		}
+
 		/*
 		 * Try to read the disk label first so we don't have to
 		 * open a bunch of minor nodes that can't have a zpool.
@@ -1113,6 +1187,234 @@ zpool_clear_label(int fd)
 	return (0);
 }
 
+/*
+ * Add the device paths under the given vdev to 'hints'.
+ */
+static void
+add_hint_paths(nvlist_t *hints, nvlist_t *nv)
+{
+	nvlist_t **child;
+	uint_t c, children;
+	char *path;
+
+	if (nvlist_lookup_string(nv, ZPOOL_CONFIG_PATH, &path) == 0)
+		fnvlist_add_boolean(hints, path);
+
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++)
+			add_hint_paths(hints, child[c]);
+	}
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_SPARES,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++)
+			add_hint_paths(hints, child[c]);
+	}
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_L2CACHE,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++)
+			add_hint_paths(hints, child[c]);
+	}
+}
+
+/*
+ * Return the device paths that the default cache file records for the pool
+ * being searched for, or NULL if it has none.  Problems with the cache file
+ * are not reported; the search simply goes without hints.
+ */
+static nvlist_t *
+get_cache_hints(importargs_t *iarg)
+{
+	struct stat64 statbuf;
+	nvlist_t *raw, *config, *tree, *hints = NULL;
+	nvpair_t *elem;
+	char *buf, *name;
+	uint64_t guid;
+	int fd;
+
+	if ((fd = open(ZPOOL_CACHE, O_RDONLY)) < 0)
+		return (NULL);
+	if (fstat64(fd, &statbuf) != 0 ||
+	    (buf = malloc(statbuf.st_size)) == NULL) {
+		(void) close(fd);
+		return (NULL);
+	}
+	if (read(fd, buf, statbuf.st_size) != statbuf.st_size ||
+	    nvlist_unpack(buf, statbuf.st_size, &raw, 0) != 0) {
+		(void) close(fd);
+		free(buf);
+		return (NULL);
+	}
+	(void) close(fd);
+	free(buf);
+
+	for (elem = nvlist_next_nvpair(raw, NULL); elem != NULL;
+	    elem = nvlist_next_nvpair(raw, elem)) {
+		if (nvpair_value_nvlist(elem, &config) != 0 ||
+		    nvlist_lookup_string(config, ZPOOL_CONFIG_POOL_NAME,
+		    &name) != 0 ||
+		    nvlist_lookup_uint64(config, ZPOOL_CONFIG_POOL_GUID,
+		    &guid) != 0 ||
+		    nvlist_lookup_nvlist(config, ZPOOL_CONFIG_VDEV_TREE,
+		    &tree) != 0)
+			continue;
+		if (iarg->poolname != NULL ?
+		    strcmp(iarg->poolname, name) != 0 : iarg->guid != guid)
+			continue;
+
+		if (hints == NULL)
+			hints = fnvlist_alloc();
+		add_hint_paths(hints, tree);
+	}
+
+	nvlist_free(raw);
+	return (hints);
+}
+
+/*
+ * Returns true if the label of every leaf vdev under 'nv' has been read.
+ */
+static boolean_t
+vdev_leaves_found(nvlist_t *nv, name_entry_t *names)
+{
+	nvlist_t **child;
+	uint_t c, children;
+	uint64_t guid;
+	name_entry_t *ne;
+
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++) {
+			if (!vdev_leaves_found(child[c], names))
+				return (B_FALSE);
+		}
+		return (B_TRUE);
+	}
+
+	if (nvlist_lookup_uint64(nv, ZPOOL_CONFIG_GUID, &guid) != 0)
+		return (B_FALSE);
+	for (ne = names; ne != NULL; ne = ne->ne_next) {
+		if (ne->ne_guid == guid)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+static config_entry_t *
+newest_config(vdev_entry_t *ve)
+{
+	config_entry_t *ce, *best = NULL;
+
+	for (ce = ve->ve_configs; ce != NULL; ce = ce->ce_next) {
+		if (best == NULL || ce->ce_txg > best->ce_txg)
+			best = ce;
+	}
+	return (best);
+}
+
+/*
+ * Returns true if the labels gathered so far describe a single, whole pool:
+ * there is a label for each of its top-level vdevs, and for each leaf vdev
+ * that those labels list.  This is what lets a search guided by the cache
+ * file stop before reading every other device.
+ */
+static boolean_t
+pool_list_complete(pool_list_t *pl)
+{
+	pool_entry_t *pe = pl->pools;
+	vdev_entry_t *ve;
+	config_entry_t *ce, *best = NULL;
+	nvlist_t *tree;
+	uint64_t children, id, *hole_array = NULL;
+	uint_t holes = 0;
+
+	if (pe == NULL || pe->pe_next != NULL)
+		return (B_FALSE);
+
+	for (ve = pe->pe_vdevs; ve != NULL; ve = ve->ve_next) {
+		ce = newest_config(ve);
+		if (best == NULL || ce->ce_txg > best->ce_txg)
+			best = ce;
+	}
+	if (best == NULL || nvlist_lookup_uint64(best->ce_config,
+	    ZPOOL_CONFIG_VDEV_CHILDREN, &children) != 0)
+		return (B_FALSE);
+	(void) nvlist_lookup_uint64_array(best->ce_config,
+	    ZPOOL_CONFIG_HOLE_ARRAY, &hole_array, &holes);
+
+	for (uint_t c = 0; c < children; c++) {
+		if (vdev_is_hole(hole_array, holes, c))
+			continue;
+		for (ve = pe->pe_vdevs; ve != NULL; ve = ve->ve_next) {
+			if (nvlist_lookup_nvlist(newest_config(ve)->ce_config,
+			    ZPOOL_CONFIG_VDEV_TREE, &tree) == 0 &&
+			    nvlist_lookup_uint64(tree, ZPOOL_CONFIG_ID,
+			    &id) == 0 && id == c)
+				break;
+		}
+		if (ve == NULL)
+			return (B_FALSE);
+	}
+
+	for (ve = pe->pe_vdevs; ve != NULL; ve = ve->ve_next) {
+		if (nvlist_lookup_nvlist(newest_config(ve)->ce_config,
+		    ZPOOL_CONFIG_VDEV_TREE, &tree) != 0 ||
+		    !vdev_leaves_found(tree, pl->names))
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Add the labels read from the slices in 'cache' to 'pools', keeping only
+ * those of the pool being searched for, if any.  'end' points into 'path'
+ * just past the directory the slices are in.
+ */
+static int
+add_slice_configs(libzfs_handle_t *hdl, importargs_t *iarg,
+    avl_tree_t *cache, pool_list_t *pools, char *path, char *end,
+    size_t pathleft)
+{
+	rdsk_node_t *slice;
+
+	for (slice = avl_first(cache); slice != NULL;
+	    slice = AVL_NEXT(cache, slice)) {
+		nvlist_t *config = slice->rn_config;
+		boolean_t matched = B_TRUE;
+
+		if (config == NULL)
+			continue;
+		slice->rn_config = NULL;
+
+		if (iarg->poolname != NULL) {
+			char *pname;
+
+			matched = nvlist_lookup_string(config,
+			    ZPOOL_CONFIG_POOL_NAME, &pname) == 0 &&
+			    strcmp(iarg->poolname, pname) == 0;
+		} else if (iarg->guid != 0) {
+			uint64_t this_guid;
+
+			matched = nvlist_lookup_uint64(config,
+			    ZPOOL_CONFIG_POOL_GUID, &this_guid) == 0 &&
+			    iarg->guid == this_guid;
+		}
+		if (!matched) {
+			nvlist_free(config);
+			continue;
+		}
+
+		/*
+		 * use the non-raw path for the config
+		 */
+		(void) strlcpy(end, slice->rn_name, pathleft);
+		if (add_config(hdl, pools, path, config) != 0)
+			return (-1);
+	}
+	return (0);
+}
+
 /*
  * Given a list of directories to search, find all pools stored on disk.  This
  * includes partial pools which are not available to import.  If no args are
@@ -1137,6 +1439,10 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 	name_entry_t *ne, *nenext;
 	avl_tree_t slice_cache;
 	rdsk_node_t *slice;
+	devid_cache_t devids;
+	devid_node_t *dn;
+	nvlist_t *hints = NULL;
+	boolean_t complete = B_FALSE;
 	void *cookie;
 
 	if (dirs == 0) {
@@ -1144,12 +1450,24 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 		dir = &default_dir;
 	}
 
+	/*
+	 * When looking for a particular pool, first read only the devices
+	 * that the cache file says it was last using.  If those turn out to
+	 * hold the whole pool, no other device needs to be read.
+	 */
+	if (iarg->scan_hints && (iarg->poolname != NULL || iarg->guid != 0))
+		hints = get_cache_hints(iarg);
+
+	(void) pthread_mutex_init(&devids.dc_lock, NULL);
+	avl_create(&devids.dc_tree, devid_cache_compare,
+	    sizeof (devid_node_t), offsetof(devid_node_t, dn_node));
+
 	/*
 	 * Go through and read the label configuration information from every
 	 * possible device, organizing the information according to pool GUID
 	 * and toplevel GUID.
 	 */
-	for (i = 0; i < dirs; i++) {
+	for (i = 0; i < dirs && !complete; i++) {
 		tpool_t *t;
 		char rdsk[MAXPATHLEN];
 		int dfd;
@@ -1205,6 +1523,10 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 			slice->rn_dfd = dfd;
 			slice->rn_hdl = hdl;
 			slice->rn_nozpool = B_FALSE;
+			slice->rn_devids = &devids;
+			(void) strlcpy(end, name, pathleft);
+			slice->rn_hint = hints != NULL &&
+			    nvlist_exists(hints, path);
 			avl_add(&slice_cache, slice);
 		}
 		/*
@@ -1218,48 +1540,42 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 		 */
 		t = tpool_create(1, 2 * sysconf(_SC_NPROCESSORS_ONLN),
 		    0, NULL);
-		for (slice = avl_first(&slice_cache); slice;
-		    (slice = avl_walk(&slice_cache, slice,
-		    AVL_AFTER)))
-			(void) tpool_dispatch(t, zpool_open_func, slice);
-		tpool_wait(t);
+		if (hints != NULL) {
+			for (slice = avl_first(&slice_cache); slice;
+			    (slice = avl_walk(&slice_cache, slice,
+			    AVL_AFTER))) {
+				if (slice->rn_hint)
+					(void) tpool_dispatch(t,
+					    zpool_open_func, slice);
+			}
+			tpool_wait(t);
+
+			if (add_slice_configs(hdl, iarg, &slice_cache, &pools,
+			    path, end, pathleft) != 0)
+				config_failed = B_TRUE;
+			else
+				complete = pool_list_complete(&pools);
+		}
+		if (!complete && !config_failed) {
+			for (slice = avl_first(&slice_cache); slice;
+			    (slice = avl_walk(&slice_cache, slice,
+			    AVL_AFTER))) {
+				if (!slice->rn_hint)
+					(void) tpool_dispatch(t,
+					    zpool_open_func, slice);
+			}
+			tpool_wait(t);
+
+			if (add_slice_configs(hdl, iarg, &slice_cache, &pools,
+			    path, end, pathleft) != 0)
+				config_failed = B_TRUE;
+		}
 		tpool_destroy(t);
 
 		cookie = NULL;
 		while ((slice = avl_destroy_nodes(&slice_cache,
 		    &cookie)) != NULL) {
-			if (slice->rn_config != NULL && !config_failed) {
-				nvlist_t *config = slice->rn_config;
-				boolean_t matched = B_TRUE;
-
-				if (iarg->poolname != NULL) {
-					char *pname;
-
-					matched = nvlist_lookup_string(config,
-					    ZPOOL_CONFIG_POOL_NAME,
-					    &pname) == 0 &&
-					    strcmp(iarg->poolname, pname) == 0;
-				} else if (iarg->guid != 0) {
-					uint64_t this_guid;
-
-					matched = nvlist_lookup_uint64(config,
-					    ZPOOL_CONFIG_POOL_GUID,
-					    &this_guid) == 0 &&
-					    iarg->guid == this_guid;
-				}
-				if (!matched) {
-					nvlist_free(config);
-				} else {
-					/*
-					 * use the non-raw path for the config
-					 */
-					(void) strlcpy(end, slice->rn_name,
-					    pathleft);
-					if (add_config(hdl, &pools, path,
-					    config) != 0)
-						config_failed = B_TRUE;
-				}
-			}
+			nvlist_free(slice->rn_config);
 			free(slice->rn_name);
 			free(slice);
 		}
@@ -1274,6 +1590,15 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 	ret = get_configs(hdl, &pools, iarg->can_be_active);
 
 error:
+	nvlist_free(hints);
+	cookie = NULL;
+	while ((dn = avl_destroy_nodes(&devids.dc_tree, &cookie)) != NULL) {
+		devid_str_free(dn->dn_devid);
+		free(dn);
+	}
+	avl_destroy(&devids.dc_tree);
+	(void) pthread_mutex_destroy(&devids.dc_lock);
+
 	for (pe = pools.pools; pe != NULL; pe = penext) {
 		penext = pe->pe_next;
 		for (ve = pe->pe_vdevs; ve != NULL; ve = venext) {
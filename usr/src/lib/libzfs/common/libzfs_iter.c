@@ -58,44 +58,84 @@ zfs_iter_clones(zfs_handle_t *zhp, zfs_iter_f func, void *data)
 	return (0);
 }
 
+/*
+ * Iterate over the child filesystems or the snapshots of a dataset, fetching
+ * them from the kernel many at a time.  If 'props_table' is non-NULL, only
+ * the properties it selects are fetched, and the handles are pruned to
+ * match; see zfs_prune_proplist().
+ */
 static int
-zfs_do_list_ioctl(zfs_handle_t *zhp, int arg, zfs_cmd_t *zc)
+zfs_iter_list(zfs_handle_t *zhp, boolean_t snapshots, boolean_t simple,
+    uint8_t *props_table, zfs_iter_f func, void *data)
 {
-	int rc;
-	uint64_t	orig_cookie;
-
-	orig_cookie = zc->zc_cookie;
-top:
-	(void) strlcpy(zc->zc_name, zhp->zfs_name, sizeof (zc->zc_name));
-	rc = ioctl(zhp->zfs_hdl->libzfs_fd, arg, zc);
-
-	if (rc == -1) {
-		switch (errno) {
-		case ENOMEM:
-			/* expand nvlist memory and try again */
-			if (zcmd_expand_dst_nvlist(zhp->zfs_hdl, zc) != 0) {
-				zcmd_free_nvlists(zc);
-				return (-1);
+	libzfs_handle_t *hdl = zhp->zfs_hdl;
+	nvlist_t *args, *props, *result, *datasets;
+	nvpair_t *pair;
+	zfs_handle_t *nzhp;
+	uint64_t cursor;
+	boolean_t more = B_TRUE;
+	int err, ret = 0;
+
+	args = fnvlist_alloc();
+	if (snapshots)
+		fnvlist_add_boolean(args, "snapshots");
+	if (simple)
+		fnvlist_add_boolean(args, "simple");
+	if (props_table != NULL && !simple) {
+		props = fnvlist_alloc();
+		for (zfs_prop_t prop = 0; prop < ZFS_NUM_PROPS; prop++) {
+			if (props_table[prop])
+				fnvlist_add_boolean(props,
+				    zfs_prop_to_name(prop));
+		}
+		fnvlist_add_nvlist(args, "props", props);
+		fnvlist_free(props);
+	}
+
+	while (more && ret == 0) {
+		if ((err = lzc_list(zhp->zfs_name, args, &result)) != 0) {
+			/*
+			 * If ENOENT is returned, then the underlying dataset
+			 * has been removed since we obtained the handle.
+			 */
+			if (err != ENOENT) {
+				ret = zfs_standard_error(hdl, err,
+				    dgettext(TEXT_DOMAIN,
+				    "cannot iterate filesystems"));
 			}
-			zc->zc_cookie = orig_cookie;
-			goto top;
-		/*
-		 * An errno value of ESRCH indicates normal completion.
-		 * If ENOENT is returned, then the underlying dataset
-		 * has been removed since we obtained the handle.
-		 */
-		case ESRCH:
-		case ENOENT:
-			rc = 1;
-			break;
-		default:
-			rc = zfs_standard_error(zhp->zfs_hdl, errno,
-			    dgettext(TEXT_DOMAIN,
-			    "cannot iterate filesystems"));
 			break;
 		}
+
+		more = (nvlist_lookup_uint64(result, "cursor", &cursor) == 0);
+		if (more)
+			fnvlist_add_uint64(args, "cursor", cursor);
+
+		datasets = fnvlist_lookup_nvlist(result, "datasets");
+		for (pair = nvlist_next_nvpair(datasets, NULL); pair != NULL;
+		    pair = nvlist_next_nvpair(datasets, pair)) {
+			if (simple) {
+				nzhp = make_dataset_simple_handle(zhp,
+				    nvpair_name(pair));
+			} else {
+				nzhp = make_dataset_handle_nvl(hdl,
+				    nvpair_name(pair),
+				    fnvpair_value_nvlist(pair), props_table);
+			}
+			/*
+			 * Silently ignore errors, as the only plausible
+			 * explanation is that the pool has since been removed.
+			 */
+			if (nzhp == NULL)
+				continue;
+
+			if ((ret = func(nzhp, data)) != 0)
+				break;
+		}
+		fnvlist_free(result);
 	}
-	return (rc);
+
+	fnvlist_free(args);
+	return (ret);
 }
 
 /*
@@ -104,34 +144,22 @@ top:
 int
 zfs_iter_filesystems(zfs_handle_t *zhp, zfs_iter_f func, void *data)
 {
-	zfs_cmd_t zc = { 0 };
-	zfs_handle_t *nzhp;
-	int ret;
+	return (zfs_iter_filesystems_props(zhp, NULL, func, data));
+}
 
+/*
+ * Iterate over all child filesystems, fetching only the properties selected
+ * by 'props_table' (all of them if it is NULL).  The table must outlive the
+ * handles passed to 'func'.
+ */
+int
+zfs_iter_filesystems_props(zfs_handle_t *zhp, uint8_t *props_table,
+    zfs_iter_f func, void *data)
+{
 	if (zhp->zfs_type != ZFS_TYPE_FILESYSTEM)
 		return (0);
 
-	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
-		return (-1);
-
-	while ((ret = zfs_do_list_ioctl(zhp, ZFS_IOC_DATASET_LIST_NEXT,
-	    &zc)) == 0) {
-		/*
-		 * Silently ignore errors, as the only plausible explanation is
-		 * that the pool has since been removed.
-		 */
-		if ((nzhp = make_dataset_handle_zc(zhp->zfs_hdl,
-		    &zc)) == NULL) {
-			continue;
-		}
-
-		if ((ret = func(nzhp, data)) != 0) {
-			zcmd_free_nvlists(&zc);
-			return (ret);
-		}
-	}
-	zcmd_free_nvlists(&zc);
-	return ((ret < 0) ? ret : 0);
+	return (zfs_iter_list(zhp, B_FALSE, B_FALSE, props_table, func, data));
 }
 
 /*
@@ -141,35 +169,22 @@ int
 zfs_iter_snapshots(zfs_handle_t *zhp, boolean_t simple, zfs_iter_f func,
     void *data)
 {
-	zfs_cmd_t zc = { 0 };
-	zfs_handle_t *nzhp;
-	int ret;
+	return (zfs_iter_snapshots_props(zhp, simple, NULL, func, data));
+}
 
+/*
+ * Iterate over all snapshots, fetching only the properties selected by
+ * 'props_table', as zfs_iter_filesystems_props() does.
+ */
+int
+zfs_iter_snapshots_props(zfs_handle_t *zhp, boolean_t simple,
+    uint8_t *props_table, zfs_iter_f func, void *data)
+{
 	if (zhp->zfs_type == ZFS_TYPE_SNAPSHOT ||
 	    zhp->zfs_type == ZFS_TYPE_BOOKMARK)
 		return (0);
 
-	zc.zc_simple = simple;
-
-	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
-		return (-1);
-	while ((ret = zfs_do_list_ioctl(zhp, ZFS_IOC_SNAPSHOT_LIST_NEXT,
-	    &zc)) == 0) {
-
-		if (simple)
-			nzhp = make_dataset_simple_handle_zc(zhp, &zc);
-		else
-			nzhp = make_dataset_handle_zc(zhp->zfs_hdl, &zc);
-		if (nzhp == NULL)
-			continue;
-
-		if ((ret = func(nzhp, data)) != 0) {
-			zcmd_free_nvlists(&zc);
-			return (ret);
-		}
-	}
-	zcmd_free_nvlists(&zc);
-	return ((ret < 0) ? ret : 0);
+	return (zfs_iter_list(zhp, B_TRUE, simple, props_table, func, data));
 }
 
 /*
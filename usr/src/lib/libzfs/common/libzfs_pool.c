@@ -1594,15 +1594,19 @@ print_vdev_tree(libzfs_handle_t *hdl, const char *name, nvlist_t *nv,
 {
 	nvlist_t **child;
 	uint_t c, children;
-	char *vname;
+	char *vname, *bias;
 	uint64_t is_log = 0;
 
 	(void) nvlist_lookup_uint64(nv, ZPOOL_CONFIG_IS_LOG,
 	    &is_log);
+	if (nvlist_lookup_string(nv, ZPOOL_CONFIG_ALLOCATION_BIAS,
+	    &bias) != 0)
+		bias = NULL;
 
 	if (name != NULL)
-		(void) printf("\t%*s%s%s\n", indent, "", name,
-		    is_log ? " [log]" : "");
+		(void) printf("\t%*s%s%s%s%s%s\n", indent, "", name,
+		    is_log ? " [log]" : "", bias != NULL ? " [" : "",
+		    bias != NULL ? bias : "", bias != NULL ? "]" : "");
 
 	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
 	    &child, &children) != 0)
@@ -1883,6 +1887,34 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func)
 	}
 }
 
+/*
+ * Start trimming the free space of a pool, or stop a trim in progress.
+ */
+int
+zpool_trim(zpool_handle_t *zhp, boolean_t start)
+{
+	zfs_cmd_t zc = { 0 };
+	char msg[1024];
+	libzfs_handle_t *hdl = zhp->zpool_hdl;
+
+	(void) strlcpy(zc.zc_name, zhp->zpool_name, sizeof (zc.zc_name));
+	zc.zc_cookie = start;
+
+	if (zfs_ioctl(hdl, ZFS_IOC_POOL_TRIM, &zc) == 0)
+		return (0);
+
+	if (start) {
+		(void) snprintf(msg, sizeof (msg),
+		    dgettext(TEXT_DOMAIN, "cannot trim %s"), zc.zc_name);
+	} else {
+		(void) snprintf(msg, sizeof (msg),
+		    dgettext(TEXT_DOMAIN, "cannot cancel trimming %s"),
+		    zc.zc_name);
+	}
+
+	return (zpool_standard_error(hdl, errno, msg));
+}
+
 /*
  * This provides a very minimal check whether a given string is likely a
  * c#t#d# style string.  Users of this are expected to do their own
@@ -348,6 +348,22 @@ cksummer(void *arg)
 			struct drr_write *drrw = &drr->drr_u.drr_write;
 			dataref_t	dataref;
 
+			/*
+			 * A compressed block is written out on the receiving
+			 * side without passing through the ARC, so nothing
+			 * can be received by reference to it for the rest of
+			 * its txg.  Pass such records through untouched.
+			 */
+			if (DRR_WRITE_COMPRESSED(drrw)) {
+				(void) ssread(buf, drrw->drr_compressed_size,
+				    ofp);
+				if (dump_record(drr, buf,
+				    drrw->drr_compressed_size,
+				    &stream_cksum, outfd) != 0)
+					goto out;
+				break;
+			}
+
 			(void) ssread(buf, drrw->drr_length, ofp);
 
 			/*
@@ -917,7 +933,7 @@ typedef struct send_dump_data {
 	uint64_t prevsnap_obj;
 	boolean_t seenfrom, seento, replicate, doall, fromorigin;
 	boolean_t verbose, dryrun, parsable, progress, embed_data, std_out;
-	boolean_t large_block;
+	boolean_t large_block, compress;
 	int outfd;
 	boolean_t err;
 	nvlist_t *fss;
@@ -1288,6 +1304,8 @@ dump_snapshot(zfs_handle_t *zhp, void *arg)
 			flags |= LZC_SEND_FLAG_LARGE_BLOCK;
 		if (sdd->embed_data)
 			flags |= LZC_SEND_FLAG_EMBED_DATA;
+		if (sdd->compress)
+			flags |= LZC_SEND_FLAG_COMPRESS;
 
 		err = dump_ioctl(zhp, sdd->prevsnap, sdd->prevsnap_obj,
 		    fromorigin, sdd->outfd, flags, sdd->debugnv);
@@ -1596,6 +1614,8 @@ zfs_send_resume(libzfs_handle_t *hdl, sendflags_t *flags, int outfd,
 
 	if (flags->embed_data || nvlist_exists(resume_nvl, "embedok"))
 		lzc_flags |= LZC_SEND_FLAG_EMBED_DATA;
+	if (flags->compress || nvlist_exists(resume_nvl, "compressok"))
+		lzc_flags |= LZC_SEND_FLAG_COMPRESS;
 
 	if (guid_to_name(hdl, toname, toguid, B_FALSE, name) != 0) {
 		if (zfs_dataset_exists(hdl, toname, ZFS_TYPE_DATASET)) {
@@ -1856,6 +1876,7 @@ zfs_send(zfs_handle_t *zhp, const char *fromsnap, const char *tosnap,
 	sdd.dryrun = flags->dryrun;
 	sdd.large_block = flags->largeblock;
 	sdd.embed_data = flags->embed_data;
+	sdd.compress = flags->compress;
 	sdd.filter_cb = filter_func;
 	sdd.filter_cb_arg = cb_arg;
 	if (debugnvp)
@@ -2923,9 +2944,13 @@ recv_skip(libzfs_handle_t *hdl, int fd, boolean_t byteswap)
 			if (byteswap) {
 				drr->drr_u.drr_write.drr_length =
 				    BSWAP_64(drr->drr_u.drr_write.drr_length);
+				drr->drr_u.drr_write.drr_compressed_size =
+				    BSWAP_64(drr->drr_u.drr_write.
+				    drr_compressed_size);
 			}
 			(void) recv_read(hdl, fd, buf,
-			    drr->drr_u.drr_write.drr_length, B_FALSE, NULL);
+			    DRR_WRITE_PAYLOAD_SIZE(&drr->drr_u.drr_write),
+			    B_FALSE, NULL);
 			break;
 		case DRR_SPILL:
 			if (byteswap) {
@@ -464,6 +464,10 @@ lzc_get_holds(const char *snapname, nvlist_t **holdsp)
  * to contain DRR_WRITE_EMBEDDED records with drr_etype==BP_EMBEDDED_TYPE_DATA,
  * which the receiving system must support (as indicated by support
  * for the "embedded_data" feature).
+ *
+ * If "flags" contains LZC_SEND_FLAG_COMPRESS, the stream is permitted to
+ * contain DRR_WRITE records that carry compressed blocks exactly as they
+ * are stored on disk, without decompressing them.
  */
 int
 lzc_send(const char *snapname, const char *from, int fd,
@@ -487,6 +491,8 @@ lzc_send_resume(const char *snapname, const char *from, int fd,
 		fnvlist_add_boolean(args, "largeblockok");
 	if (flags & LZC_SEND_FLAG_EMBED_DATA)
 		fnvlist_add_boolean(args, "embedok");
+	if (flags & LZC_SEND_FLAG_COMPRESS)
+		fnvlist_add_boolean(args, "compressok");
 	if (resumeobj != 0 || resumeoff != 0) {
 		fnvlist_add_uint64(args, "resume_object", resumeobj);
 		fnvlist_add_uint64(args, "resume_offset", resumeoff);
@@ -765,6 +771,46 @@ lzc_get_bookmarks(const char *fsname, nvlist_t *props, nvlist_t **bmarks)
 	return (lzc_ioctl(ZFS_IOC_GET_BOOKMARKS, fsname, props, bmarks));
 }
 
+/*
+ * List the child file systems or the snapshots of a dataset, returning
+ * many per call.
+ *
+ * The args nvlist may contain:
+ *
+ * "snapshots" (boolean) - list snapshots rather than child file systems
+ * "simple" (boolean) - with "snapshots", return only the snapshot names
+ * "cursor" (uint64) - continue from where the previous call left off
+ * "props" (nvlist) - names (with no values) of the native properties to
+ *     return; all are returned if absent.  User properties are always
+ *     returned.
+ *
+ * The format of the returned nvlist is as follows:
+ * "datasets" -> {
+ *     <full name of dataset> -> {
+ *         "stats" -> {
+ *             "type", "num_clones", "creation_txg", "guid" -> uint64
+ *             "is_snapshot", "inconsistent" -> boolean_value
+ *             "origin" -> string (clones only)
+ *         }
+ *         "props" -> {
+ *             <name of property> -> {
+ *                 "value" -> uint64 or string
+ *                 "source" -> string (for inheritable properties)
+ *             }
+ *         }
+ *     }
+ * }
+ * "cursor" -> uint64 (absent once the last dataset has been returned)
+ *
+ * With "simple", each dataset maps to a boolean instead.  To list all of
+ * them, call again with the returned cursor until none is returned.
+ */
+int
+lzc_list(const char *fsname, nvlist_t *args, nvlist_t **result)
+{
+	return (lzc_ioctl(ZFS_IOC_LIST, fsname, args, result));
+}
+
 /*
  * Destroys bookmarks.
  *
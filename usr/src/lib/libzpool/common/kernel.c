@@ -1074,6 +1074,29 @@ kmem_asprintf(const char *fmt, ...)
 	return (buf);
 }
 
+/*
+ * libumem has no batch interface, so these just loop.
+ */
+size_t
+kmem_cache_alloc_batch(kmem_cache_t *cp, void **bufs, size_t nbufs,
+    int kmflag)
+{
+	size_t n;
+
+	for (n = 0; n < nbufs; n++) {
+		if ((bufs[n] = umem_cache_alloc(cp, kmflag)) == NULL)
+			break;
+	}
+	return (n);
+}
+
+void
+kmem_cache_free_batch(kmem_cache_t *cp, void **bufs, size_t nbufs)
+{
+	for (size_t n = 0; n < nbufs; n++)
+		umem_cache_free(cp, bufs[n]);
+}
+
 /* ARGSUSED */
 int
 zfs_onexit_fd_hold(int fd, minor_t *minorp)
@@ -339,6 +339,9 @@ extern vmem_t *zio_arena;
 
 typedef umem_cache_t kmem_cache_t;
 
+extern size_t kmem_cache_alloc_batch(kmem_cache_t *, void **, size_t, int);
+extern void kmem_cache_free_batch(kmem_cache_t *, void **, size_t);
+
 typedef enum kmem_cbrc {
 	KMEM_CBRC_YES,
 	KMEM_CBRC_NO,
@@ -369,6 +372,7 @@ typedef struct taskq_ent {
 #define	TASKQ_DYNAMIC		0x0004	/* Use dynamic thread scheduling */
 #define	TASKQ_THREADS_CPU_PCT	0x0008	/* Scale # threads by # cpus */
 #define	TASKQ_DC_BATCH		0x0010	/* Mark threads as batch */
+#define	TASKQ_PERCPU		0x0020	/* Per-CPU run queues (ignored) */
 
 #define	TQ_SLEEP	KM_SLEEP	/* Can block for memory */
 #define	TQ_NOSLEEP	KM_NOSLEEP	/* cannot block for memory; may fail */
@@ -479,6 +483,8 @@ extern int fop_getattr(vnode_t *vp, vattr_t *vap);
 #define	VOP_GETATTR(vp, vap, fl, cr, ct)  fop_getattr((vp), (vap));
 
 #define	VOP_FSYNC(vp, f, cr, ct)	fsync((vp)->v_fd)
+#define	VOP_SPACE(vp, cmd, fl, f, o, cr, ct)	\
+	(fcntl((vp)->v_fd, F_FREESP64, (fl)) == -1 ? errno : 0)
 
 #define	VN_RELE(vp)	vn_close(vp)
 
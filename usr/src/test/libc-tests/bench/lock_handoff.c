@@ -0,0 +1,138 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Report the cost of handing control back and forth between two processes
+ * through a process-shared mutex and condition variable, and through a pair
+ * of process-shared semaphores.  Every handoff requires the other process
+ * to be woken, so this measures the wakeup path of the synchronization
+ * objects rather than their uncontended fast paths.  This is not run as a
+ * test; it is used to compare implementations.
+ *
+ * Usage: lock_handoff [-n handoffs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+typedef struct shared {
+	pthread_mutex_t	s_mutex;
+	pthread_cond_t	s_cond;
+	sem_t		s_sem[2];
+	volatile ulong_t s_turn;
+} shared_t;
+
+static shared_t *sh;
+
+static void
+cond_pingpong(int me, ulong_t n)
+{
+	ulong_t i;
+
+	for (i = me; i < n; i += 2) {
+		(void) pthread_mutex_lock(&sh->s_mutex);
+		while (sh->s_turn != i)
+			(void) pthread_cond_wait(&sh->s_cond, &sh->s_mutex);
+		sh->s_turn++;
+		(void) pthread_cond_signal(&sh->s_cond);
+		(void) pthread_mutex_unlock(&sh->s_mutex);
+	}
+}
+
+static void
+sem_pingpong(int me, ulong_t n)
+{
+	ulong_t i;
+
+	for (i = me; i < n; i += 2) {
+		while (sem_wait(&sh->s_sem[me]) != 0)
+			continue;
+		(void) sem_post(&sh->s_sem[!me]);
+	}
+}
+
+static void
+run(const char *name, void (*func)(int, ulong_t), ulong_t n)
+{
+	hrtime_t start, end;
+	pid_t pid;
+	int status;
+
+	sh->s_turn = 0;
+	if (sem_init(&sh->s_sem[0], 1, 1) != 0 ||
+	    sem_init(&sh->s_sem[1], 1, 0) != 0)
+		err(EXIT_FAILURE, "sem_init");
+
+	start = gethrtime();
+	if ((pid = fork()) == -1)
+		err(EXIT_FAILURE, "fork");
+	if (pid == 0) {
+		func(1, n);
+		_exit(0);
+	}
+	func(0, n);
+	if (waitpid(pid, &status, 0) != pid || status != 0)
+		errx(EXIT_FAILURE, "%s: child failed", name);
+	end = gethrtime();
+
+	(void) sem_destroy(&sh->s_sem[0]);
+	(void) sem_destroy(&sh->s_sem[1]);
+
+	(void) printf("%-12s %8.0f ns/handoff\n", name,
+	    (double)(end - start) / n);
+}
+
+int
+main(int argc, char *argv[])
+{
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+	ulong_t n = 200000;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			n = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			(void) fprintf(stderr, "Usage: %s [-n handoffs]\n",
+			    argv[0]);
+			return (EXIT_FAILURE);
+		}
+	}
+	if (n == 0)
+		n = 1;
+
+	if ((sh = mmap(NULL, sizeof (*sh), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANON, -1, 0)) == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	(void) pthread_mutexattr_init(&mattr);
+	(void) pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	(void) pthread_condattr_init(&cattr);
+	(void) pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	if (pthread_mutex_init(&sh->s_mutex, &mattr) != 0 ||
+	    pthread_cond_init(&sh->s_cond, &cattr) != 0)
+		errx(EXIT_FAILURE, "failed to initialize shared objects");
+
+	run("mutex+cond", cond_pingpong, n);
+	run("semaphore", sem_pingpong, n);
+
+	return (EXIT_SUCCESS);
+}
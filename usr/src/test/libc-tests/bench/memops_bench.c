@@ -0,0 +1,140 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Report the throughput of memcpy(3C), memmove(3C), memset(3C), memcmp(3C),
+ * strlen(3C) and strchr(3C) over a range of sizes, from ones that fit in
+ * the first level cache to ones that are larger than the last level cache.
+ * This is not run as a test; it is used to compare implementations.
+ *
+ * Usage: memops_bench [-m megabytes]
+ *
+ * Every size is run until the given total of data (1024 megabytes by
+ * default) has been processed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/time.h>
+
+#define	MAXSIZE		(64 * 1024 * 1024)
+
+static size_t sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, 65536, 262144, 1024 * 1024,
+	4 * 1024 * 1024, 16 * 1024 * 1024, MAXSIZE
+};
+
+#define	NSIZES	(sizeof (sizes) / sizeof (sizes[0]))
+
+typedef enum {
+	OP_MEMCPY,
+	OP_MEMMOVE,
+	OP_MEMSET,
+	OP_MEMCMP,
+	OP_STRLEN,
+	OP_STRCHR,
+	OP_MAX
+} bench_op_t;
+
+static const char *op_names[OP_MAX] = {
+	"memcpy", "memmove", "memset", "memcmp", "strlen", "strchr"
+};
+
+static char *src, *dst;
+static volatile size_t sink;
+
+static void
+run(bench_op_t op, size_t len, ulong_t iters)
+{
+	ulong_t i;
+
+	for (i = 0; i < iters; i++) {
+		switch (op) {
+		case OP_MEMCPY:
+			(void) memcpy(dst, src + 1, len);
+			break;
+		case OP_MEMMOVE:
+			/* overlapping, so the copy is done backwards */
+			(void) memmove(src + 64, src, len);
+			break;
+		case OP_MEMSET:
+			(void) memset(dst, (int)i, len);
+			break;
+		case OP_MEMCMP:
+			sink += memcmp(src, dst, len);
+			break;
+		case OP_STRLEN:
+			sink += strlen(src);
+			break;
+		case OP_STRCHR:
+			sink += (size_t)strchr(src, 'y');
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	ulong_t total = 1024UL * 1024 * 1024;
+	ulong_t iters;
+	hrtime_t start, end;
+	bench_op_t op;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "m:")) != -1) {
+		switch (c) {
+		case 'm':
+			total = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		default:
+			(void) fprintf(stderr, "Usage: %s [-m megabytes]\n",
+			    argv[0]);
+			return (EXIT_FAILURE);
+		}
+	}
+
+	if ((src = malloc(MAXSIZE + 128)) == NULL ||
+	    (dst = malloc(MAXSIZE + 128)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	(void) printf("%-8s", "size");
+	for (op = 0; op < OP_MAX; op++)
+		(void) printf(" %9s", op_names[op]);
+	(void) printf("    (MB/s)\n");
+
+	for (i = 0; i < NSIZES; i++) {
+		(void) printf("%-8lu", (ulong_t)sizes[i]);
+		iters = total / sizes[i] + 1;
+
+		for (op = 0; op < OP_MAX; op++) {
+			/* memcmp and the string functions run to the end */
+			(void) memset(src, 'x', MAXSIZE + 128);
+			(void) memset(dst, 'x', MAXSIZE + 128);
+			src[sizes[i]] = '\0';
+
+			start = gethrtime();
+			run(op, sizes[i], iters);
+			end = gethrtime();
+
+			(void) printf(" %9.0f", (double)sizes[i] * iters *
+			    NANOSEC / (end - start) / (1024 * 1024));
+		}
+		(void) printf("\n");
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,136 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Report the time qsort(3C) takes, and the number of comparisons it makes,
+ * for a range of input patterns and record sizes.  This is not run as a
+ * test; it is used to compare implementations.
+ *
+ * Usage: qsort_bench [-n records]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/time.h>
+
+typedef enum {
+	PAT_RANDOM,
+	PAT_SORTED,
+	PAT_REVERSE,
+	PAT_ORGAN,
+	PAT_FEW,
+	PAT_NEARLY,
+	PAT_MAX
+} pattern_t;
+
+static const char *pat_names[PAT_MAX] = {
+	"random", "sorted", "reverse", "organ", "few", "nearly"
+};
+
+static size_t rsizes[] = { 4, 8, 16, 24, 64 };
+
+#define	NRSIZES	(sizeof (rsizes) / sizeof (rsizes[0]))
+
+static ulong_t ncmp;
+
+/* every record starts with a 32-bit key */
+static int
+cmp_key(const void *a, const void *b)
+{
+	uint32_t ka = *(const uint32_t *)a, kb = *(const uint32_t *)b;
+
+	ncmp++;
+	return (ka < kb ? -1 : ka > kb);
+}
+
+static void
+generate(char *base, size_t n, size_t rsiz, pattern_t pat)
+{
+	size_t i;
+	uint32_t k;
+
+	for (i = 0; i < n; i++) {
+		switch (pat) {
+		case PAT_RANDOM:
+			k = (uint32_t)lrand48();
+			break;
+		case PAT_SORTED:
+			k = i;
+			break;
+		case PAT_REVERSE:
+			k = n - i;
+			break;
+		case PAT_ORGAN:
+			k = i < n / 2 ? i : n - i;
+			break;
+		case PAT_FEW:
+			k = lrand48() % 16;
+			break;
+		case PAT_NEARLY:
+		default:
+			k = (i % 100 == 0) ? (uint32_t)lrand48() : i;
+			break;
+		}
+		(void) memset(base + i * rsiz, 0, rsiz);
+		(void) memcpy(base + i * rsiz, &k, sizeof (k));
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t n = 1000000;
+	hrtime_t start, end;
+	pattern_t pat;
+	char *buf;
+	int c, r;
+
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			n = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			(void) fprintf(stderr, "Usage: %s [-n records]\n",
+			    argv[0]);
+			return (EXIT_FAILURE);
+		}
+	}
+	if (n == 0)
+		n = 1;
+
+	if ((buf = malloc(n * rsizes[NRSIZES - 1])) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	(void) printf("%-8s %5s %12s %12s\n", "pattern", "size", "ns/record",
+	    "cmps/record");
+
+	for (pat = 0; pat < PAT_MAX; pat++) {
+		for (r = 0; r < NRSIZES; r++) {
+			srand48(1);
+			generate(buf, n, rsizes[r], pat);
+
+			ncmp = 0;
+			start = gethrtime();
+			qsort(buf, n, rsizes[r], cmp_key);
+			end = gethrtime();
+
+			(void) printf("%-8s %5lu %12.1f %12.1f\n",
+			    pat_names[pat], (ulong_t)rsizes[r],
+			    (double)(end - start) / n, (double)ncmp / n);
+		}
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,225 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Time the stdio paths that text-processing programs lean on, in a process
+ * that has more than one thread so that streams are locked: getc() and
+ * putc() with and without flockfile() around the loop, getline(), and
+ * fwrite() of lines to a line-buffered stream.  What is read and written is
+ * checked along the way, so the program fails if any of them gets the
+ * data wrong.
+ *
+ *	stdio_bench [-l lines]
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define	LINELEN		64
+
+static int opt_lines = 200000;
+static char *data;
+static size_t datalen;
+
+static void
+fatal(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+static void
+check(int ok, const char *what)
+{
+	if (!ok) {
+		(void) fprintf(stderr, "stdio_bench: %s: data mismatch\n",
+		    what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* ARGSUSED */
+static void *
+idle(void *arg)
+{
+	for (;;)
+		(void) pause();
+	/* NOTREACHED */
+	return (NULL);
+}
+
+static void
+report(const char *what, hrtime_t start, size_t nops)
+{
+	hrtime_t ns = gethrtime() - start;
+
+	(void) printf("%-24s %8.2f ns/op %10.3f ms\n", what,
+	    (double)ns / nops, (double)ns / 1000000);
+}
+
+static FILE *
+make_input(void)
+{
+	FILE *fp;
+	size_t i;
+
+	datalen = (size_t)opt_lines * LINELEN;
+	if ((data = malloc(datalen)) == NULL)
+		fatal("malloc");
+	for (i = 0; i < datalen; i++) {
+		data[i] = (i % LINELEN == LINELEN - 1) ? '\n' :
+		    'a' + (i * 7 + i / LINELEN) % 26;
+	}
+
+	if ((fp = tmpfile()) == NULL)
+		fatal("tmpfile");
+	if (fwrite(data, 1, datalen, fp) != datalen || fflush(fp) != 0)
+		fatal("fwrite");
+	return (fp);
+}
+
+static void
+bench_getc(FILE *fp, int locked)
+{
+	hrtime_t start;
+	size_t i = 0;
+	int c;
+
+	rewind(fp);
+	start = gethrtime();
+	if (locked)
+		flockfile(fp);
+	while ((c = getc(fp)) != EOF) {
+		if (i >= datalen || c != (uchar_t)data[i])
+			check(0, "getc");
+		i++;
+	}
+	if (locked)
+		funlockfile(fp);
+	report(locked ? "getc, flockfile" : "getc", start, datalen);
+	check(i == datalen, "getc");
+}
+
+static void
+bench_putc(FILE *out, int locked)
+{
+	hrtime_t start;
+	size_t i;
+
+	start = gethrtime();
+	if (locked)
+		flockfile(out);
+	for (i = 0; i < datalen; i++)
+		(void) putc(data[i], out);
+	if (locked)
+		funlockfile(out);
+	(void) fflush(out);
+	report(locked ? "putc, flockfile" : "putc", start, datalen);
+}
+
+static void
+bench_getline(FILE *fp)
+{
+	hrtime_t start;
+	char *line = NULL;
+	size_t cap = 0, off = 0;
+	ssize_t len;
+
+	rewind(fp);
+	start = gethrtime();
+	while ((len = getline(&line, &cap, fp)) > 0) {
+		check(off + len <= datalen &&
+		    memcmp(line, data + off, len) == 0, "getline");
+		off += len;
+	}
+	report("getline", start, opt_lines);
+	check(off == datalen, "getline");
+	free(line);
+}
+
+static void
+bench_fwrite_lbf(void)
+{
+	hrtime_t start;
+	FILE *fp;
+	char *back;
+	size_t i;
+
+	if ((fp = tmpfile()) == NULL)
+		fatal("tmpfile");
+	if (setvbuf(fp, NULL, _IOLBF, BUFSIZ) != 0)
+		fatal("setvbuf");
+
+	/* two lines per call, so that newlines fall inside a write */
+	start = gethrtime();
+	for (i = 0; i + 2 * LINELEN <= datalen; i += 2 * LINELEN) {
+		if (fwrite(data + i, 1, 2 * LINELEN, fp) != 2 * LINELEN)
+			fatal("fwrite");
+	}
+	report("fwrite, line-buffered", start, opt_lines / 2);
+
+	if ((back = malloc(i)) == NULL)
+		fatal("malloc");
+	rewind(fp);
+	check(fread(back, 1, i, fp) == i && memcmp(back, data, i) == 0,
+	    "fwrite");
+	free(back);
+	(void) fclose(fp);
+}
+
+int
+main(int argc, char *argv[])
+{
+	pthread_t tid;
+	FILE *fp, *out;
+	int c;
+
+	while ((c = getopt(argc, argv, "l:")) != -1) {
+		switch (c) {
+		case 'l':
+			opt_lines = atoi(optarg);
+			break;
+		default:
+			(void) fprintf(stderr, "usage: %s [-l lines]\n",
+			    argv[0]);
+			return (2);
+		}
+	}
+	if (opt_lines < 2) {
+		(void) fprintf(stderr, "stdio_bench: too few lines\n");
+		return (2);
+	}
+
+	/* a second thread, so that stdio locks its streams */
+	if ((errno = pthread_create(&tid, NULL, idle, NULL)) != 0)
+		fatal("pthread_create");
+
+	fp = make_input();
+	if ((out = fopen("/dev/null", "w")) == NULL)
+		fatal("/dev/null");
+
+	bench_getc(fp, 0);
+	bench_getc(fp, 1);
+	bench_putc(out, 0);
+	bench_putc(out, 1);
+	bench_getline(fp);
+	bench_fwrite_lbf();
+
+	(void) fclose(out);
+	(void) fclose(fp);
+	return (0);
+}
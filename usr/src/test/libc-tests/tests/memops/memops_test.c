@@ -0,0 +1,263 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check memcpy(3C), memmove(3C), memset(3C), memcmp(3C), strlen(3C) and
+ * strchr(3C) against simple byte at a time versions.  The sizes cross the
+ * thresholds at which the optimized versions change strategy (unrolled
+ * code, vector loops, rep string instructions and non-temporal stores for
+ * copies larger than the cache), and every size is tried at a range of
+ * source and destination alignments.  The string functions are also run
+ * on strings ending right before an unmapped page.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/mman.h>
+
+#define	NALIGN		33
+#define	PAD		128
+#define	MAXSIZE		(64 * 1024 * 1024)
+
+static size_t sizes[] = {
+	0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128,
+	129, 143, 144, 145, 191, 192, 193, 255, 256, 257, 511, 512, 1023,
+	1024, 2047, 2048, 2049, 4095, 4096, 4097, 8192, 65535, 65536, 262147,
+	1024 * 1024 + 5, 8 * 1024 * 1024 + 3, MAXSIZE
+};
+
+#define	NSIZES	(sizeof (sizes) / sizeof (sizes[0]))
+
+static uint8_t *src, *dst, *ref;
+static int failures;
+
+static void
+fail(const char *func, size_t len, int soff, int doff)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s len %lu src +%d dst +%d\n",
+	    func, (ulong_t)len, soff, doff);
+	if (++failures > 20)
+		exit(EXIT_FAILURE);
+}
+
+static void
+fill(uint8_t *p, size_t len, uint_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		p[i] = (uint8_t)(i * 131 + seed);
+}
+
+static void
+ref_copy(uint8_t *d, const uint8_t *s, size_t len)
+{
+	size_t i;
+
+	if (d < s) {
+		for (i = 0; i < len; i++)
+			d[i] = s[i];
+	} else {
+		for (i = len; i > 0; i--)
+			d[i - 1] = s[i - 1];
+	}
+}
+
+/*
+ * Large sizes are only run at a few alignments to keep the run time down.
+ */
+static int
+align_step(size_t len)
+{
+	return (len > 4096 ? 11 : 1);
+}
+
+static void
+test_memcpy(size_t len)
+{
+	int s, d;
+
+	for (s = 0; s < NALIGN; s += align_step(len)) {
+		for (d = 0; d < NALIGN; d += align_step(len)) {
+			fill(src, len + PAD, len + s);
+			(void) memset(dst, 0xa5, len + PAD);
+			(void) memset(ref, 0xa5, len + PAD);
+			ref_copy(ref + d, src + s, len);
+			if (memcpy(dst + d, src + s, len) != dst + d ||
+			    memcmp(dst, ref, len + PAD) != 0)
+				fail("memcpy", len, s, d);
+		}
+	}
+}
+
+static void
+test_memmove(size_t len)
+{
+	static int shifts[] = { 1, 3, 8, 16, 31, 32, 33, 64, 100, 4096 };
+	int i, sh;
+
+	for (i = 0; i < sizeof (shifts) / sizeof (shifts[0]); i++) {
+		sh = shifts[i];
+
+		fill(dst, len + sh, len);
+		fill(ref, len + sh, len);
+		ref_copy(ref + sh, ref, len);
+		if (memmove(dst + sh, dst, len) != dst + sh ||
+		    memcmp(dst, ref, len + sh) != 0)
+			fail("memmove backward", len, 0, sh);
+
+		ref_copy(ref, ref + sh, len);
+		if (memmove(dst, dst + sh, len) != dst ||
+		    memcmp(dst, ref, len + sh) != 0)
+			fail("memmove forward", len, sh, 0);
+	}
+}
+
+static void
+test_memset(size_t len)
+{
+	size_t i;
+	int d, c;
+
+	for (d = 0; d < NALIGN; d += align_step(len)) {
+		c = (len + d) & 0xff;
+		(void) memset(dst, 0x5a, len + PAD);
+		(void) memset(ref, 0x5a, len + PAD);
+		for (i = 0; i < len; i++)
+			ref[d + i] = c;
+		/* Only the low byte of the value is to be used */
+		if (memset(dst + d, c | 0x300, len) != dst + d ||
+		    memcmp(dst, ref, len + PAD) != 0)
+			fail("memset", len, 0, d);
+	}
+}
+
+static int
+sign(int v)
+{
+	return (v < 0 ? -1 : v > 0);
+}
+
+static void
+test_memcmp(size_t len)
+{
+	size_t pos;
+	int s, d;
+
+	if (len == 0) {
+		if (memcmp(src, dst, 0) != 0)
+			fail("memcmp", len, 0, 0);
+		return;
+	}
+
+	for (s = 0; s < NALIGN; s += align_step(len)) {
+		for (d = 0; d < NALIGN; d += align_step(len)) {
+			fill(src + s, len, len);
+			fill(dst + d, len, len);
+			if (memcmp(src + s, dst + d, len) != 0)
+				fail("memcmp equal", len, s, d);
+
+			/* Differences at the start, end and middle */
+			for (pos = 0; pos < len; pos += len / 2 + 1) {
+				dst[d + pos] ^= 0x80;
+				if (sign(memcmp(src + s, dst + d, len)) !=
+				    sign((int)src[s + pos] - (int)dst[d + pos]))
+					fail("memcmp", len, s, d);
+				dst[d + pos] ^= 0x80;
+			}
+			dst[d + len - 1] += 1;
+			if (memcmp(src + s, dst + d, len) >= 0)
+				fail("memcmp last", len, s, d);
+		}
+	}
+}
+
+static void
+test_str(char *s, size_t len, int off)
+{
+	char c = 'a' + (len % 3);
+
+	(void) memset(s, 'x', len);
+	s[len] = '\0';
+	if (strlen(s) != len)
+		fail("strlen", len, off, 0);
+	if (strchr(s, '\0') != s + len)
+		fail("strchr nul", len, off, 0);
+	if (strchr(s, 'y') != NULL)
+		fail("strchr missing", len, off, 0);
+	if (len > 0) {
+		s[len / 2] = c;
+		s[len - 1] = c;
+		if (strchr(s, c) != s + len / 2)
+			fail("strchr", len, off, 0);
+		/* The value is converted to a char */
+		if (strchr(s, c | 0x100) != s + len / 2)
+			fail("strchr char", len, off, 0);
+	}
+}
+
+static void
+test_strings(void)
+{
+	size_t len;
+	long pgsz = sysconf(_SC_PAGESIZE);
+	char *pg;
+	int off;
+
+	for (len = 0; len < 300; len++) {
+		for (off = 0; off < NALIGN; off++)
+			test_str((char *)src + off, len, off);
+	}
+	for (len = 300; len < MAXSIZE / 4; len = len * 3 + 1)
+		test_str((char *)src + 5, len, 5);
+
+	/*
+	 * The string ends right before a page that is not mapped.  This
+	 * catches any read beyond the page the terminating null is on.
+	 */
+	pg = mmap(NULL, 2 * pgsz, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (pg == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+	if (mprotect(pg + pgsz, pgsz, PROT_NONE) != 0)
+		err(EXIT_FAILURE, "mprotect");
+	for (len = 0; len < 256; len++)
+		test_str(pg + pgsz - len - 1, len, 0);
+	(void) munmap(pg, 2 * pgsz);
+}
+
+int
+main(void)
+{
+	int i;
+
+	src = malloc(MAXSIZE + 2 * PAD + 4096);
+	dst = malloc(MAXSIZE + 2 * PAD + 4096);
+	ref = malloc(MAXSIZE + 2 * PAD + 4096);
+	if (src == NULL || dst == NULL || ref == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	for (i = 0; i < NSIZES; i++) {
+		test_memcpy(sizes[i]);
+		test_memmove(sizes[i]);
+		test_memset(sizes[i]);
+		test_memcmp(sizes[i]);
+	}
+	test_strings();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,289 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check that qsort(3C) sorts, and only permutes, arrays of records of the
+ * sizes and alignments that select each of its swap routines, for inputs
+ * with the usual patterns (sorted, reversed, organ pipe, many duplicates and
+ * so on).  Also run it against McIlroy's adversarial comparison function,
+ * which drives a plain quicksort quadratic, and check that the number of
+ * comparisons stays within a small multiple of n log2 n.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <sys/types.h>
+
+#define	MAXREC		100000
+#define	MAXRSIZ		32
+#define	ADVREC		100000
+
+typedef enum {
+	PAT_RANDOM,
+	PAT_SORTED,
+	PAT_REVERSE,
+	PAT_ORGAN,
+	PAT_EQUAL,
+	PAT_FEW,
+	PAT_NEARLY,
+	PAT_PAIRS,
+	PAT_MAX
+} pattern_t;
+
+static const char *pat_names[PAT_MAX] = {
+	"random", "sorted", "reverse", "organ pipe", "equal", "few distinct",
+	"nearly sorted", "swapped pairs"
+};
+
+static size_t nrecs[] = {
+	0, 1, 2, 3, 7, 8, 9, 19, 20, 49, 50, 51, 100, 1000, 10007, MAXREC
+};
+
+#define	NNRECS	(sizeof (nrecs) / sizeof (nrecs[0]))
+
+static size_t rsizes[] = { 1, 3, 4, 8, 12, 16, 24, 32 };
+
+#define	NRSIZES	(sizeof (rsizes) / sizeof (rsizes[0]))
+
+static size_t offsets[] = { 0, 1, 4, 8 };
+
+#define	NOFFSETS	(sizeof (offsets) / sizeof (offsets[0]))
+
+static size_t cur_rsiz;
+static ulong_t ncmp;
+static int failures;
+
+static void
+fail(const char *what, pattern_t pat, size_t n, size_t rsiz, size_t off)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s: %s, %lu records of %lu "
+	    "bytes at +%lu\n", what, pat_names[pat], (ulong_t)n,
+	    (ulong_t)rsiz, (ulong_t)off);
+	if (++failures > 20)
+		exit(EXIT_FAILURE);
+}
+
+/*
+ * The key is the first (up to) four bytes of the record, big-endian, so that
+ * it orders the same way as memcmp().
+ */
+static uint32_t
+key_get(const uchar_t *r)
+{
+	uint32_t k = 0;
+	size_t i;
+
+	for (i = 0; i < 4 && i < cur_rsiz; i++)
+		k = (k << 8) | r[i];
+	return (k);
+}
+
+static void
+key_set(uchar_t *r, uint32_t k)
+{
+	size_t i, n = cur_rsiz < 4 ? cur_rsiz : 4;
+
+	for (i = 0; i < n; i++)
+		r[i] = (uchar_t)(k >> (8 * (n - 1 - i)));
+}
+
+static int
+cmp_key(const void *a, const void *b)
+{
+	uint32_t ka = key_get(a), kb = key_get(b);
+
+	ncmp++;
+	return (ka < kb ? -1 : ka > kb);
+}
+
+/*
+ * An order-independent digest of the records, to check that sorting only
+ * permuted them.
+ */
+static uint64_t
+digest(const uchar_t *base, size_t n, size_t rsiz)
+{
+	uint64_t sum = 0, h;
+	size_t i, j;
+
+	for (i = 0; i < n; i++) {
+		h = 14695981039346656037ULL;
+		for (j = 0; j < rsiz; j++)
+			h = (h ^ base[i * rsiz + j]) * 1099511628211ULL;
+		sum += h;
+	}
+	return (sum);
+}
+
+static void
+generate(uchar_t *base, size_t n, size_t rsiz, pattern_t pat)
+{
+	size_t i, j;
+	uint32_t k;
+
+	for (i = 0; i < n; i++) {
+		switch (pat) {
+		case PAT_RANDOM:
+			k = (uint32_t)lrand48();
+			break;
+		case PAT_SORTED:
+			k = i;
+			break;
+		case PAT_REVERSE:
+			k = n - i;
+			break;
+		case PAT_ORGAN:
+			k = i < n / 2 ? i : n - i;
+			break;
+		case PAT_EQUAL:
+			k = 7;
+			break;
+		case PAT_FEW:
+			k = lrand48() % 4;
+			break;
+		case PAT_NEARLY:
+			k = (i % 100 == 0) ? (uint32_t)lrand48() : i;
+			break;
+		case PAT_PAIRS:
+		default:
+			k = i ^ 1;
+			break;
+		}
+		for (j = 0; j < rsiz; j++)
+			base[i * rsiz + j] = (uchar_t)lrand48();
+		key_set(base + i * rsiz, k);
+	}
+}
+
+static void
+check(uchar_t *buf, pattern_t pat, size_t n, size_t rsiz, size_t off)
+{
+	uchar_t *base = buf + off;
+	uint64_t before;
+	size_t i;
+
+	cur_rsiz = rsiz;
+	generate(base, n, rsiz, pat);
+	before = digest(base, n, rsiz);
+
+	qsort(base, n, rsiz, cmp_key);
+
+	for (i = 1; i < n; i++) {
+		if (key_get(base + (i - 1) * rsiz) > key_get(base + i * rsiz)) {
+			fail("not sorted", pat, n, rsiz, off);
+			break;
+		}
+	}
+	if (digest(base, n, rsiz) != before)
+		fail("records changed", pat, n, rsiz, off);
+}
+
+/*
+ * McIlroy's "A Killer Adversary for Quicksort": the values of the records
+ * are only decided as the sort compares them, in whichever way makes the
+ * current pivot a bad one.
+ */
+static int *adv_val;
+static int adv_gas, adv_nsolid, adv_candidate;
+
+static int
+cmp_adversary(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+
+	ncmp++;
+	if (adv_val[x] == adv_gas && adv_val[y] == adv_gas) {
+		if (x == adv_candidate)
+			adv_val[x] = adv_nsolid++;
+		else
+			adv_val[y] = adv_nsolid++;
+	}
+	if (adv_val[x] == adv_gas)
+		adv_candidate = x;
+	else if (adv_val[y] == adv_gas)
+		adv_candidate = y;
+	return (adv_val[x] - adv_val[y]);
+}
+
+static void
+check_adversary(void)
+{
+	int *ptr;
+	int i, lg;
+
+	if ((ptr = malloc(ADVREC * sizeof (int))) == NULL ||
+	    (adv_val = malloc(ADVREC * sizeof (int))) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	adv_gas = ADVREC - 1;
+	adv_nsolid = 0;
+	adv_candidate = 0;
+	for (i = 0; i < ADVREC; i++) {
+		ptr[i] = i;
+		adv_val[i] = adv_gas;
+	}
+
+	ncmp = 0;
+	qsort(ptr, ADVREC, sizeof (int), cmp_adversary);
+
+	for (i = 1; i < ADVREC; i++) {
+		if (adv_val[ptr[i - 1]] > adv_val[ptr[i]]) {
+			(void) fprintf(stderr, "TEST FAILED: adversary: not "
+			    "sorted\n");
+			failures++;
+			break;
+		}
+	}
+
+	for (lg = 0, i = ADVREC; i > 1; i >>= 1)
+		lg++;
+	if (ncmp > 6UL * ADVREC * lg) {
+		(void) fprintf(stderr, "TEST FAILED: adversary: %lu compares "
+		    "for %d records\n", ncmp, ADVREC);
+		failures++;
+	}
+
+	free(ptr);
+	free(adv_val);
+}
+
+int
+main(void)
+{
+	uchar_t *buf;
+	pattern_t pat;
+	int n, r, o;
+
+	if ((buf = malloc(MAXREC * MAXRSIZ + 16)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	srand48(1);
+	for (r = 0; r < NRSIZES; r++) {
+		for (o = 0; o < NOFFSETS; o++) {
+			for (n = 0; n < NNRECS; n++) {
+				for (pat = 0; pat < PAT_MAX; pat++) {
+					check(buf, pat, nrecs[n], rsizes[r],
+					    offsets[o]);
+				}
+			}
+		}
+	}
+
+	check_adversary();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
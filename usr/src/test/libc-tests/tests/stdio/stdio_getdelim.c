@@ -0,0 +1,258 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check getdelim(3C) and getline(3C) on records from empty to just over
+ * three times the stream's buffer, for a range of buffer sizes, so that
+ * records and delimiters start and end at, just before and just after
+ * buffer boundaries.  Records contain NUL bytes, the last one has no
+ * delimiter, and the caller's buffer starts out NULL, tiny or large.  Also
+ * check that characters pushed back with ungetc(3C) or left behind by
+ * getc(3C) are returned, and that bad arguments fail with EINVAL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <limits.h>
+
+static size_t bufsizes[] = { 1, 2, 7, 16, 64, BUFSIZ };
+
+#define	NBUFSIZES	(sizeof (bufsizes) / sizeof (bufsizes[0]))
+
+static int failures;
+
+static void
+fail(const char *what, int delim, size_t bufsiz, size_t rec)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s: delimiter 0x%x, buffer %lu, "
+	    "record %lu\n", what, delim, (ulong_t)bufsiz, (ulong_t)rec);
+	if (++failures > 20)
+		exit(EXIT_FAILURE);
+}
+
+#define	NSMALL		40
+#define	NREC		(NSMALL + 3 * 5)
+#define	RECMAX(b)	(NSMALL + 4 * (b))
+
+/*
+ * The length of record i for a buffer of bufsiz bytes: every length up to
+ * NSMALL, then lengths within two bytes of one, two and three buffers.
+ */
+static size_t
+reclen(size_t i, size_t bufsiz)
+{
+	size_t len;
+
+	if (i < NSMALL)
+		return (i);
+	i -= NSMALL;
+	len = (i / 5 + 1) * bufsiz + i % 5;
+	return (len < 2 ? 0 : len - 2);
+}
+
+/*
+ * Record i never contains the delimiter, but does contain NUL bytes when
+ * that isn't the delimiter.
+ */
+static void
+record(char *buf, size_t len, size_t i, int delim)
+{
+	size_t j;
+
+	for (j = 0; j < len; j++) {
+		buf[j] = (j % 5 == 3) ? '\0' : 'a' + (i + j) % 26;
+		if (buf[j] == delim)
+			buf[j] = '.';
+	}
+}
+
+/* The last record has no delimiter. */
+static FILE *
+make_file(size_t bufsiz, int delim)
+{
+	FILE *fp;
+	char *buf;
+	size_t i, len;
+
+	if ((fp = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "tmpfile");
+	if ((buf = malloc(RECMAX(bufsiz) + 1)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	for (i = 0; i < NREC; i++) {
+		len = reclen(i, bufsiz);
+		record(buf, len, i, delim);
+		if (i != NREC - 1)
+			buf[len++] = delim;
+		if (fwrite(buf, 1, len, fp) != len)
+			err(EXIT_FAILURE, "fwrite");
+	}
+	if (fflush(fp) != 0)
+		err(EXIT_FAILURE, "fflush");
+	free(buf);
+	return (fp);
+}
+
+typedef enum {
+	START_NULL,
+	START_TINY,
+	START_LARGE
+} start_t;
+
+static void
+check_records(int delim, size_t bufsiz, start_t start)
+{
+	char *line, *exp;
+	size_t cap, i, rlen;
+	ssize_t len;
+	FILE *fp;
+
+	fp = make_file(bufsiz, delim);
+	rewind(fp);
+	if (setvbuf(fp, NULL, _IOFBF, bufsiz) != 0)
+		err(EXIT_FAILURE, "setvbuf");
+	if ((exp = malloc(RECMAX(bufsiz) + 1)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	switch (start) {
+	case START_NULL:
+		line = NULL;
+		cap = 0;
+		break;
+	case START_TINY:
+		cap = 1;
+		break;
+	case START_LARGE:
+		cap = 2 * RECMAX(bufsiz);
+		break;
+	}
+	if (start != START_NULL && (line = malloc(cap)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	for (i = 0; i < NREC; i++) {
+		size_t explen;
+
+		len = (delim == '\n') ? getline(&line, &cap, fp) :
+		    getdelim(&line, &cap, delim, fp);
+		if (len < 0) {
+			fail("early end of file", delim, bufsiz, i);
+			break;
+		}
+		rlen = reclen(i, bufsiz);
+		record(exp, rlen, i, delim);
+		exp[rlen] = delim;
+		explen = rlen + (i != NREC - 1);
+		if ((size_t)len != explen)
+			fail("wrong length", delim, bufsiz, i);
+		else if (memcmp(line, exp, explen) != 0)
+			fail("wrong contents", delim, bufsiz, i);
+		else if (line[len] != '\0')
+			fail("not terminated", delim, bufsiz, i);
+		else if (cap <= (size_t)len)
+			fail("buffer size not updated", delim, bufsiz, i);
+	}
+
+	if (getdelim(&line, &cap, delim, fp) != -1 || !feof(fp) || ferror(fp))
+		fail("no end of file", delim, bufsiz, NREC);
+
+	free(line);
+	free(exp);
+	(void) fclose(fp);
+}
+
+static void
+check_pushback(void)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	FILE *fp;
+
+	if ((fp = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "tmpfile");
+	if (fputs("first line\nsecond\n", fp) == EOF || fflush(fp) != 0)
+		err(EXIT_FAILURE, "fputs");
+	rewind(fp);
+
+	/* a partly read line is returned from where getc() left off */
+	if (getc(fp) != 'f' || getc(fp) != 'i')
+		fail("getc", '\n', BUFSIZ, 0);
+	if (getline(&line, &cap, fp) != 9 || strcmp(line, "rst line\n") != 0)
+		fail("getline after getc", '\n', BUFSIZ, 0);
+
+	/* a pushed back character comes first, even if it differs */
+	if (ungetc('X', fp) != 'X')
+		fail("ungetc", '\n', BUFSIZ, 1);
+	if (getline(&line, &cap, fp) != 8 || strcmp(line, "Xsecond\n") != 0)
+		fail("getline after ungetc", '\n', BUFSIZ, 1);
+
+	/* and at end of file, a pushed back delimiter makes a record */
+	if (ungetc('\n', fp) != '\n')
+		fail("ungetc at end of file", '\n', BUFSIZ, 2);
+	if (getline(&line, &cap, fp) != 1 || strcmp(line, "\n") != 0)
+		fail("getline of pushed back delimiter", '\n', BUFSIZ, 2);
+	if (getline(&line, &cap, fp) != -1)
+		fail("no end of file after pushback", '\n', BUFSIZ, 3);
+
+	free(line);
+	(void) fclose(fp);
+}
+
+static void
+check_einval(void)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/dev/null", "r")) == NULL)
+		err(EXIT_FAILURE, "fopen");
+
+	errno = 0;
+	if (getdelim(&line, &cap, -2, fp) != -1 || errno != EINVAL)
+		fail("negative delimiter", -2, 0, 0);
+	errno = 0;
+	if (getdelim(&line, &cap, UCHAR_MAX + 1, fp) != -1 ||
+	    errno != EINVAL)
+		fail("delimiter out of range", UCHAR_MAX + 1, 0, 0);
+	errno = 0;
+	if (getdelim(NULL, &cap, '\n', fp) != -1 || errno != EINVAL)
+		fail("NULL line pointer", '\n', 0, 0);
+	errno = 0;
+	if (getdelim(&line, NULL, '\n', fp) != -1 || errno != EINVAL)
+		fail("NULL size pointer", '\n', 0, 0);
+
+	(void) fclose(fp);
+}
+
+int
+main(void)
+{
+	static const int delims[] = { '\n', ':', '\0', 0xff };
+	start_t start;
+	size_t b, d;
+
+	for (d = 0; d < sizeof (delims) / sizeof (delims[0]); d++) {
+		for (b = 0; b < NBUFSIZES; b++) {
+			for (start = START_NULL; start <= START_LARGE; start++)
+				check_records(delims[d], bufsizes[b], start);
+		}
+	}
+	check_pushback();
+	check_einval();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
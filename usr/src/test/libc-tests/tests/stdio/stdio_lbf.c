@@ -0,0 +1,146 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check that writes to a line-buffered stream reach the file as soon as a
+ * newline is written, without an fflush(3C), for a range of buffer sizes:
+ * everything up to the last newline is on the other end of a pipe after
+ * each call, a short tail after it is not, and mixing fwrite(3C), fputs(3C)
+ * and putc(3C) keeps the bytes in order.  Lines several times the size of
+ * the buffer and single writes of several lines are included.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+static size_t bufsizes[] = { 8, 64, BUFSIZ };
+
+#define	NBUFSIZES	(sizeof (bufsizes) / sizeof (bufsizes[0]))
+
+static int failures;
+static int rfd;
+static char *rbuf, *exp;
+static size_t rbufsiz;
+
+/*
+ * Check that what can be read from the pipe right now is exactly the
+ * expected string.
+ */
+static void
+expect(const char *what, size_t bufsiz, const char *str, size_t len)
+{
+	size_t got = 0;
+	ssize_t n;
+
+	while ((n = read(rfd, rbuf + got, rbufsiz - got)) > 0)
+		got += n;
+	if (n < 0 && errno != EAGAIN)
+		err(EXIT_FAILURE, "read");
+
+	if (got != len || memcmp(rbuf, str, len) != 0) {
+		(void) fprintf(stderr, "TEST FAILED: %s: buffer %lu: "
+		    "expected %lu bytes, got %lu\n", what, (ulong_t)bufsiz,
+		    (ulong_t)len, (ulong_t)got);
+		failures++;
+	}
+}
+
+#define	EXPECT(what, bufsiz, str)	\
+	expect(what, bufsiz, str, sizeof (str) - 1)
+
+static void
+check_lbf(size_t bufsiz)
+{
+	size_t len = 3 * bufsiz;
+	int fds[2];
+	char *line;
+	FILE *fp;
+
+	if (pipe(fds) != 0)
+		err(EXIT_FAILURE, "pipe");
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0)
+		err(EXIT_FAILURE, "fcntl");
+	rfd = fds[0];
+	if ((fp = fdopen(fds[1], "w")) == NULL)
+		err(EXIT_FAILURE, "fdopen");
+	if (setvbuf(fp, NULL, _IOLBF, bufsiz) != 0)
+		err(EXIT_FAILURE, "setvbuf");
+
+	if (fwrite("abc\ndef", 1, 7, fp) != 7)
+		err(EXIT_FAILURE, "fwrite");
+	EXPECT("fwrite of a line and a tail", bufsiz, "abc\n");
+
+	if (putc('g', fp) == EOF || fputs("h\nij", fp) == EOF)
+		err(EXIT_FAILURE, "putc");
+	EXPECT("putc and fputs after fwrite", bufsiz, "defgh\n");
+
+	/* a line three times the buffer, after the pending "ij" */
+	if ((line = malloc(len + 5)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	(void) memset(line, 'x', len);
+	(void) memcpy(line + len, "\ntail", 5);
+	if (fwrite(line, 1, len + 5, fp) != len + 5)
+		err(EXIT_FAILURE, "fwrite");
+	(void) memcpy(exp, "ij", 2);
+	(void) memcpy(exp + 2, line, len + 1);
+	expect("fwrite of a long line", bufsiz, exp, len + 3);
+	free(line);
+
+	/* several lines in one call, and items of more than one byte */
+	if (fwrite("a\nb\nc", 1, 5, fp) != 5)
+		err(EXIT_FAILURE, "fwrite");
+	EXPECT("fwrite of several lines", bufsiz, "taila\nb\n");
+	if (fwrite("1\n2\n", 2, 2, fp) != 2)
+		err(EXIT_FAILURE, "fwrite");
+	EXPECT("fwrite of two-byte items", bufsiz, "c1\n2\n");
+
+	if (putc('z', fp) == EOF)
+		err(EXIT_FAILURE, "putc");
+	EXPECT("putc of a tail", bufsiz, "");
+	if (putc('\n', fp) == EOF)
+		err(EXIT_FAILURE, "putc");
+	EXPECT("putc of a newline", bufsiz, "z\n");
+
+	if (fwrite("end", 1, 3, fp) != 3)
+		err(EXIT_FAILURE, "fwrite");
+	EXPECT("fwrite of a tail", bufsiz, "");
+	if (fflush(fp) != 0)
+		err(EXIT_FAILURE, "fflush");
+	EXPECT("fflush", bufsiz, "end");
+
+	(void) fclose(fp);
+	(void) close(rfd);
+}
+
+int
+main(void)
+{
+	size_t b;
+
+	rbufsiz = 4 * BUFSIZ;
+	if ((rbuf = malloc(rbufsiz)) == NULL || (exp = malloc(rbufsiz)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	for (b = 0; b < NBUFSIZES; b++)
+		check_lbf(bufsizes[b]);
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,194 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check the locking of streams by a thread that already holds them with
+ * flockfile(3C): the owner can take the lock again with flockfile() and
+ * ftrylockfile(), stdio calls made while it is held neither release nor
+ * leak it, and no other thread gets it until every hold is dropped.  Then
+ * have several threads write whole lines under flockfile() a character or
+ * a chunk at a time, through a small buffer, and check that no line was
+ * broken up by another thread's output.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <pthread.h>
+
+#define	DEPTH		4
+#define	NTHREADS	8
+#define	NLINES		500
+#define	LINELEN		100
+
+static int failures;
+static FILE *wfp;
+
+static void
+fail(const char *what)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s\n", what);
+	failures++;
+}
+
+static void *
+trylock(void *arg)
+{
+	FILE *fp = arg;
+
+	if (ftrylockfile(fp) != 0)
+		return ((void *)0);
+	funlockfile(fp);
+	return ((void *)1);
+}
+
+/*
+ * Whether a thread other than the caller can lock the stream right now.
+ */
+static int
+other_can_lock(FILE *fp)
+{
+	pthread_t tid;
+	void *ret;
+
+	if (pthread_create(&tid, NULL, trylock, fp) != 0)
+		errx(EXIT_FAILURE, "pthread_create failed");
+	if (pthread_join(tid, &ret) != 0)
+		errx(EXIT_FAILURE, "pthread_join failed");
+	return (ret != NULL);
+}
+
+static void
+check_nesting(void)
+{
+	char buf[32];
+	FILE *fp;
+	int i;
+
+	if ((fp = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "tmpfile");
+
+	if (!other_can_lock(fp))
+		fail("unlocked stream can't be locked");
+
+	/* each hold, whichever way it was taken, needs its own release */
+	for (i = 0; i < DEPTH; i++) {
+		if (i % 2 == 0)
+			flockfile(fp);
+		else if (ftrylockfile(fp) != 0)
+			fail("owner's ftrylockfile failed");
+		if (other_can_lock(fp))
+			fail("other thread locked a held stream");
+	}
+
+	/* stdio calls made by the owner leave the hold count alone */
+	for (i = 0; i < 1000; i++) {
+		if (putc('a' + i % 26, fp) == EOF ||
+		    fputs("xyz\n", fp) == EOF ||
+		    fwrite("0123456789", 1, 10, fp) != 10)
+			fail("write while held");
+	}
+	rewind(fp);
+	if (getc(fp) != 'a' || fgets(buf, sizeof (buf), fp) == NULL ||
+	    strcmp(buf, "xyz\n") != 0)
+		fail("read while held");
+
+	for (i = 0; i < DEPTH; i++) {
+		if (other_can_lock(fp))
+			fail("other thread locked a partly released stream");
+		funlockfile(fp);
+	}
+
+	if (!other_can_lock(fp))
+		fail("released stream can't be locked");
+
+	(void) fclose(fp);
+}
+
+static void *
+writer(void *arg)
+{
+	FILE *fp = wfp;
+	char line[LINELEN];
+	int i, j;
+
+	(void) memset(line, 'A' + (int)(uintptr_t)arg, sizeof (line));
+	line[LINELEN - 1] = '\n';
+
+	for (i = 0; i < NLINES; i++) {
+		flockfile(fp);
+		if (i % 2 == 0) {
+			for (j = 0; j < LINELEN; j++)
+				(void) putc(line[j], fp);
+		} else {
+			(void) fwrite(line, 1, LINELEN / 3, fp);
+			(void) fputs("", fp);
+			(void) fwrite(line + LINELEN / 3, 1,
+			    LINELEN - LINELEN / 3, fp);
+		}
+		funlockfile(fp);
+	}
+	return (NULL);
+}
+
+static void
+check_lines(void)
+{
+	pthread_t tids[NTHREADS];
+	char line[LINELEN + 2];
+	FILE *fp;
+	int i, j, nlines;
+
+	if ((wfp = fp = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "tmpfile");
+	if (setvbuf(fp, NULL, _IOFBF, 16) != 0)
+		err(EXIT_FAILURE, "setvbuf");
+
+	for (i = 0; i < NTHREADS; i++) {
+		if (pthread_create(&tids[i], NULL, writer,
+		    (void *)(uintptr_t)i) != 0)
+			errx(EXIT_FAILURE, "pthread_create failed");
+	}
+	for (i = 0; i < NTHREADS; i++)
+		(void) pthread_join(tids[i], NULL);
+
+	if (fflush(fp) != 0 || ferror(fp))
+		err(EXIT_FAILURE, "write failed");
+	rewind(fp);
+
+	for (nlines = 0; fgets(line, sizeof (line), fp) != NULL; nlines++) {
+		for (j = 1; j < LINELEN - 1 && line[j] == line[0]; j++)
+			;
+		if (j != LINELEN - 1 || strcmp(line + j, "\n") != 0) {
+			fail("line broken up by another thread");
+			break;
+		}
+	}
+	if (nlines != NTHREADS * NLINES && failures == 0)
+		fail("wrong number of lines");
+
+	(void) fclose(fp);
+}
+
+int
+main(void)
+{
+	check_nesting();
+	check_lines();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,334 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Exercise process-shared mutexes, condition variables, rwlocks and
+ * semaphores from several processes at once, and verify that none of them
+ * loses a wakeup or fails to exclude.  Semaphores are also exercised by
+ * threads within one process.  Finally, verify that timed waits on each
+ * kind of object time out.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/debug.h>
+
+#define	NPROCS	4
+#define	NITERS	20000
+
+typedef struct shared {
+	pthread_mutex_t	s_mutex;
+	pthread_cond_t	s_cond;
+	pthread_rwlock_t s_rwlock;
+	sem_t		s_sem;
+	sem_t		s_done;
+	volatile uint_t	s_count;
+	volatile uint_t	s_turn;
+	volatile uint_t	s_rwval[2];
+} shared_t;
+
+static shared_t *sh;
+
+static void
+shared_init(void)
+{
+	pthread_mutexattr_t ma;
+	pthread_condattr_t ca;
+	pthread_rwlockattr_t ra;
+
+	sh = mmap(NULL, sizeof (*sh), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANON, -1, 0);
+	VERIFY(sh != MAP_FAILED);
+	(void) memset(sh, 0, sizeof (*sh));
+
+	VERIFY0(pthread_mutexattr_init(&ma));
+	VERIFY0(pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED));
+	VERIFY0(pthread_mutex_init(&sh->s_mutex, &ma));
+	VERIFY0(pthread_condattr_init(&ca));
+	VERIFY0(pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED));
+	VERIFY0(pthread_cond_init(&sh->s_cond, &ca));
+	VERIFY0(pthread_rwlockattr_init(&ra));
+	VERIFY0(pthread_rwlockattr_setpshared(&ra, PTHREAD_PROCESS_SHARED));
+	VERIFY0(pthread_rwlock_init(&sh->s_rwlock, &ra));
+	VERIFY0(sem_init(&sh->s_sem, 1, 0));
+	VERIFY0(sem_init(&sh->s_done, 1, 0));
+}
+
+/*
+ * Run fn in NPROCS child processes.
+ */
+static void
+start_procs(void (*fn)(uint_t), pid_t *pids)
+{
+	uint_t i;
+
+	for (i = 0; i < NPROCS; i++) {
+		VERIFY((pids[i] = fork()) != -1);
+		if (pids[i] == 0) {
+			fn(i);
+			_exit(0);
+		}
+	}
+}
+
+/*
+ * Wait for all of the children to succeed.
+ */
+static void
+wait_procs(pid_t *pids)
+{
+	uint_t i;
+	int status;
+
+	for (i = 0; i < NPROCS; i++) {
+		VERIFY3S(waitpid(pids[i], &status, 0), ==, pids[i]);
+		VERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+}
+
+static void
+run_procs(void (*fn)(uint_t))
+{
+	pid_t pids[NPROCS];
+
+	start_procs(fn, pids);
+	wait_procs(pids);
+}
+
+static void
+mutex_child(uint_t id)
+{
+	uint_t i, c;
+
+	for (i = 0; i < NITERS; i++) {
+		VERIFY0(pthread_mutex_lock(&sh->s_mutex));
+		c = sh->s_count;
+		if ((i & 0xff) == id)
+			(void) sched_yield();
+		sh->s_count = c + 1;
+		VERIFY0(pthread_mutex_unlock(&sh->s_mutex));
+	}
+}
+
+/*
+ * Pass a token around the processes in turn; every handoff requires a
+ * wakeup to get through.
+ */
+static void
+cond_child(uint_t id)
+{
+	uint_t i;
+
+	VERIFY0(pthread_mutex_lock(&sh->s_mutex));
+	for (i = 0; i < NITERS / 10; i++) {
+		while (sh->s_turn != id)
+			VERIFY0(pthread_cond_wait(&sh->s_cond, &sh->s_mutex));
+		sh->s_turn = (id + 1) % NPROCS;
+		sh->s_count++;
+		VERIFY0(pthread_cond_broadcast(&sh->s_cond));
+	}
+	VERIFY0(pthread_mutex_unlock(&sh->s_mutex));
+}
+
+static void
+rwlock_child(uint_t id)
+{
+	uint_t i;
+
+	for (i = 0; i < NITERS; i++) {
+		if (i % NPROCS == id) {
+			VERIFY0(pthread_rwlock_wrlock(&sh->s_rwlock));
+			sh->s_rwval[0]++;
+			(void) sched_yield();
+			sh->s_rwval[1]++;
+			sh->s_count++;
+			VERIFY0(pthread_rwlock_unlock(&sh->s_rwlock));
+		} else {
+			VERIFY0(pthread_rwlock_rdlock(&sh->s_rwlock));
+			VERIFY3U(sh->s_rwval[0], ==, sh->s_rwval[1]);
+			VERIFY0(pthread_rwlock_unlock(&sh->s_rwlock));
+		}
+	}
+}
+
+/*
+ * Each child consumes NITERS of the parent's posts and acknowledges each.
+ */
+/* ARGSUSED */
+static void
+sema_child(uint_t id)
+{
+	uint_t i;
+
+	for (i = 0; i < NITERS; i++) {
+		while (sem_wait(&sh->s_sem) != 0)
+			VERIFY3S(errno, ==, EINTR);
+		VERIFY0(sem_post(&sh->s_done));
+	}
+}
+
+static void *
+sema_thread(void *arg)
+{
+	sem_t *sp = arg;
+	uint_t i;
+
+	for (i = 0; i < NITERS; i++) {
+		while (sem_wait(&sp[0]) != 0)
+			VERIFY3S(errno, ==, EINTR);
+		VERIFY0(sem_post(&sp[1]));
+	}
+	return (NULL);
+}
+
+static void
+sema_procs(void)
+{
+	pid_t pids[NPROCS];
+	uint_t i;
+
+	start_procs(sema_child, pids);
+	for (i = 0; i < NPROCS * NITERS; i++) {
+		VERIFY0(sem_post(&sh->s_sem));
+		if ((i & 0x3ff) == 0)
+			(void) sched_yield();
+	}
+	wait_procs(pids);
+	for (i = 0; i < NPROCS * NITERS; i++)
+		VERIFY0(sem_trywait(&sh->s_done));
+	VERIFY3S(sem_trywait(&sh->s_done), ==, -1);
+	VERIFY3S(errno, ==, EAGAIN);
+}
+
+static void
+sema_threads(void)
+{
+	pthread_t tids[NPROCS];
+	sem_t sems[2];
+	uint_t i;
+
+	VERIFY0(sem_init(&sems[0], 0, 0));
+	VERIFY0(sem_init(&sems[1], 0, 0));
+	for (i = 0; i < NPROCS; i++)
+		VERIFY0(pthread_create(&tids[i], NULL, sema_thread, sems));
+	for (i = 0; i < NPROCS * NITERS; i++) {
+		VERIFY0(sem_post(&sems[0]));
+		while (sem_wait(&sems[1]) != 0)
+			VERIFY3S(errno, ==, EINTR);
+	}
+	for (i = 0; i < NPROCS; i++)
+		VERIFY0(pthread_join(tids[i], NULL));
+	VERIFY0(sem_destroy(&sems[0]));
+	VERIFY0(sem_destroy(&sems[1]));
+}
+
+static void
+abstime(struct timespec *ts, long msec)
+{
+	VERIFY0(clock_gettime(CLOCK_REALTIME, ts));
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (msec % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static void
+timeouts(void)
+{
+	struct timespec ts;
+	pid_t pid;
+	int status;
+	int fds[2];
+	char c;
+
+	abstime(&ts, 50);
+	VERIFY3S(sem_timedwait(&sh->s_sem, &ts), ==, -1);
+	VERIFY3S(errno, ==, ETIMEDOUT);
+
+	VERIFY0(pthread_mutex_lock(&sh->s_mutex));
+	abstime(&ts, 50);
+	VERIFY3S(pthread_cond_timedwait(&sh->s_cond, &sh->s_mutex, &ts), ==,
+	    ETIMEDOUT);
+	VERIFY0(pthread_mutex_unlock(&sh->s_mutex));
+
+	/* hold the mutex and the write lock in another process */
+	VERIFY0(pipe(fds));
+	VERIFY((pid = fork()) != -1);
+	if (pid == 0) {
+		VERIFY0(pthread_mutex_lock(&sh->s_mutex));
+		VERIFY0(pthread_rwlock_wrlock(&sh->s_rwlock));
+		VERIFY3S(write(fds[1], "x", 1), ==, 1);
+		VERIFY3S(read(fds[0], &c, 1), ==, 1);
+		VERIFY0(pthread_rwlock_unlock(&sh->s_rwlock));
+		VERIFY0(pthread_mutex_unlock(&sh->s_mutex));
+		_exit(0);
+	}
+	VERIFY3S(read(fds[0], &c, 1), ==, 1);
+	abstime(&ts, 50);
+	VERIFY3S(pthread_mutex_timedlock(&sh->s_mutex, &ts), ==, ETIMEDOUT);
+	abstime(&ts, 50);
+	VERIFY3S(pthread_rwlock_timedrdlock(&sh->s_rwlock, &ts), ==,
+	    ETIMEDOUT);
+	VERIFY3S(pthread_rwlock_tryrdlock(&sh->s_rwlock), ==, EBUSY);
+	VERIFY3S(write(fds[1], "x", 1), ==, 1);
+
+	/* the release must wake us up */
+	VERIFY0(pthread_mutex_lock(&sh->s_mutex));
+	VERIFY0(pthread_rwlock_rdlock(&sh->s_rwlock));
+	VERIFY0(pthread_rwlock_unlock(&sh->s_rwlock));
+	VERIFY0(pthread_mutex_unlock(&sh->s_mutex));
+	VERIFY3S(waitpid(pid, &status, 0), ==, pid);
+	VERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	(void) close(fds[0]);
+	(void) close(fds[1]);
+}
+
+int
+main(void)
+{
+	shared_init();
+
+	sh->s_count = 0;
+	run_procs(mutex_child);
+	VERIFY3U(sh->s_count, ==, NPROCS * NITERS);
+	(void) printf("TEST PASSED: process-shared mutex\n");
+
+	sh->s_count = 0;
+	run_procs(cond_child);
+	VERIFY3U(sh->s_count, ==, NPROCS * (NITERS / 10));
+	(void) printf("TEST PASSED: process-shared condition variable\n");
+
+	sh->s_count = 0;
+	run_procs(rwlock_child);
+	VERIFY3U(sh->s_count, ==, NITERS);
+	VERIFY3U(sh->s_rwval[0], ==, NITERS);
+	(void) printf("TEST PASSED: process-shared rwlock\n");
+
+	sema_procs();
+	(void) printf("TEST PASSED: process-shared semaphore\n");
+	sema_threads();
+	(void) printf("TEST PASSED: process-private semaphore\n");
+
+	timeouts();
+	(void) printf("TEST PASSED: timed waits\n");
+
+	return (0);
+}
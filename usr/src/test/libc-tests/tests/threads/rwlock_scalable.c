@@ -0,0 +1,116 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Verify that a reader-scalable rwlock (rwlock_init() with RWL_SCALABLE)
+ * still excludes writers from readers and from each other while readers
+ * take it through the bias table, and that the ownership checks and
+ * rw_trywrlock() see read locks held that way.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <synch.h>
+#include <unistd.h>
+#include <sys/debug.h>
+
+#define	NREADERS	8
+#define	NWRITERS	2
+#define	NSECONDS	3
+
+static rwlock_t rwl;
+static volatile uint_t val[2];
+static volatile int stop;
+
+static void *
+reader(void *arg)
+{
+	uint_t a, b;
+
+	while (!stop) {
+		VERIFY0(rw_rdlock(&rwl));
+		/* take it again recursively now and then */
+		if ((val[0] & 0x7) == 0) {
+			VERIFY0(rw_rdlock(&rwl));
+			VERIFY0(rw_unlock(&rwl));
+		}
+		VERIFY(_rw_read_held(&rwl));
+		a = val[0];
+		b = val[1];
+		VERIFY3U(a, ==, b);
+		VERIFY0(rw_unlock(&rwl));
+	}
+	return (arg);
+}
+
+static void *
+writer(void *arg)
+{
+	uint_t i;
+
+	while (!stop) {
+		VERIFY0(rw_wrlock(&rwl));
+		VERIFY(_rw_write_held(&rwl));
+		val[0]++;
+		for (i = 0; i < 100; i++)
+			continue;
+		val[1]++;
+		VERIFY0(rw_unlock(&rwl));
+		(void) usleep(100);
+	}
+	return (arg);
+}
+
+int
+main(void)
+{
+	pthread_t tids[NREADERS + NWRITERS];
+	uint_t i;
+
+	VERIFY3S(rwlock_init(&rwl, USYNC_PROCESS | RWL_SCALABLE, NULL), ==,
+	    EINVAL);
+	VERIFY0(rwlock_init(&rwl, USYNC_THREAD | RWL_SCALABLE, NULL));
+
+	for (i = 0; i < NREADERS; i++)
+		VERIFY0(pthread_create(&tids[i], NULL, reader, NULL));
+	for (; i < NREADERS + NWRITERS; i++)
+		VERIFY0(pthread_create(&tids[i], NULL, writer, NULL));
+	(void) sleep(NSECONDS);
+	stop = 1;
+	for (i = 0; i < NREADERS + NWRITERS; i++)
+		VERIFY0(pthread_join(tids[i], NULL));
+	(void) printf("TEST PASSED: exclusion (%u writes)\n", val[0]);
+
+	/*
+	 * Read-lock it often enough for the bias to return.  Whether or not
+	 * our read lock is then held through the table, a writer must be
+	 * refused and the lock must still be seen to be ours.
+	 */
+	for (i = 0; i < 100; i++) {
+		VERIFY0(rw_rdlock(&rwl));
+		VERIFY0(rw_unlock(&rwl));
+	}
+	VERIFY0(rw_rdlock(&rwl));
+	VERIFY3S(rw_trywrlock(&rwl), ==, EBUSY);
+	VERIFY3S(rw_wrlock(&rwl), ==, EDEADLK);
+	VERIFY(_rw_read_held(&rwl));
+	VERIFY(!_rw_write_held(&rwl));
+	VERIFY0(rw_unlock(&rwl));
+	VERIFY3S(rw_unlock(&rwl), ==, EPERM);
+	VERIFY0(rw_trywrlock(&rwl));
+	VERIFY(_rw_write_held(&rwl));
+	VERIFY0(rw_unlock(&rwl));
+	VERIFY0(rwlock_destroy(&rwl));
+	(void) printf("TEST PASSED: ownership\n");
+
+	return (0);
+}
@@ -0,0 +1,229 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure pathname lookup throughput: a number of threads repeatedly
+ * stat(2) (or open(2) and close(2)) the same file at the bottom of a deep
+ * directory tree, and we report the aggregate rate.  With -r each thread
+ * uses a file of its own in the same tree, so that only the directories
+ * are shared.
+ *
+ *	lookup_bench [-o] [-r] [-d depth] [-t threads] [-s seconds] [dir]
+ *
+ * Compare the dnlcstats path_hits and path_misses kstats before and after a
+ * run to see how many lookups were resolved by the lockless walk.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+static int opt_open = 0;
+static int opt_private = 0;
+static int opt_depth = 8;
+static int opt_threads = 0;
+static int opt_seconds = 5;
+
+static char basedir[PATH_MAX];
+static volatile int running;
+static pthread_barrier_t barrier;
+
+typedef struct worker {
+	pthread_t	w_thread;
+	char		w_path[PATH_MAX];
+	uint64_t	w_ops;
+	uint64_t	w_errors;
+} worker_t;
+
+static void
+fatal(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+static void *
+worker(void *arg)
+{
+	worker_t *w = arg;
+	struct stat st;
+	int fd;
+
+	(void) pthread_barrier_wait(&barrier);
+	while (running) {
+		if (opt_open) {
+			if ((fd = open(w->w_path, O_RDONLY)) < 0)
+				w->w_errors++;
+			else
+				(void) close(fd);
+		} else if (stat(w->w_path, &st) != 0) {
+			w->w_errors++;
+		}
+		w->w_ops++;
+	}
+	return (NULL);
+}
+
+static void
+make_tree(char *dir, size_t len)
+{
+	int i;
+
+	for (i = 0; i < opt_depth; i++) {
+		if (strlcat(dir, "/dir", len) >= len) {
+			errno = ENAMETOOLONG;
+			fatal(dir);
+		}
+		if (mkdir(dir, 0755) != 0)
+			fatal(dir);
+	}
+}
+
+static void
+make_file(const char *path)
+{
+	int fd;
+
+	if ((fd = open(path, O_CREAT | O_WRONLY | O_EXCL, 0644)) < 0)
+		fatal(path);
+	(void) close(fd);
+}
+
+static void
+remove_tree(char *dir)
+{
+	char *p;
+	int i;
+
+	for (i = 0; i < opt_depth; i++) {
+		(void) rmdir(dir);
+		if ((p = strrchr(dir, '/')) != NULL)
+			*p = '\0';
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr, "usage: %s [-o] [-r] [-d depth] "
+	    "[-t threads] [-s seconds] [dir]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char leaf[PATH_MAX];
+	const char *parent = "/var/tmp";
+	worker_t *workers;
+	hrtime_t start, elapsed;
+	uint64_t ops = 0, errors = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "ord:t:s:")) != -1) {
+		switch (c) {
+		case 'o':
+			opt_open = 1;
+			break;
+		case 'r':
+			opt_private = 1;
+			break;
+		case 'd':
+			opt_depth = atoi(optarg);
+			break;
+		case 't':
+			opt_threads = atoi(optarg);
+			break;
+		case 's':
+			opt_seconds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		parent = argv[optind++];
+	if (optind != argc || opt_depth < 1 || opt_seconds < 1 ||
+	    opt_threads < 0)
+		usage(argv[0]);
+	if (opt_threads == 0)
+		opt_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	(void) snprintf(basedir, sizeof (basedir), "%s/lookup_bench.%d",
+	    parent, (int)getpid());
+	if (mkdir(basedir, 0755) != 0)
+		fatal(basedir);
+	(void) strlcpy(leaf, basedir, sizeof (leaf));
+	make_tree(leaf, sizeof (leaf));
+
+	if ((workers = calloc(opt_threads, sizeof (worker_t))) == NULL)
+		fatal("calloc");
+	for (i = 0; i < opt_threads; i++) {
+		if (opt_private || i == 0) {
+			(void) snprintf(workers[i].w_path, PATH_MAX,
+			    "%s/file.%d", leaf, i);
+			make_file(workers[i].w_path);
+		} else {
+			(void) strlcpy(workers[i].w_path, workers[0].w_path,
+			    PATH_MAX);
+		}
+	}
+
+	running = 1;
+	if (pthread_barrier_init(&barrier, NULL, opt_threads + 1) != 0)
+		fatal("pthread_barrier_init");
+	for (i = 0; i < opt_threads; i++) {
+		if ((errno = pthread_create(&workers[i].w_thread, NULL,
+		    worker, &workers[i])) != 0)
+			fatal("pthread_create");
+	}
+
+	(void) pthread_barrier_wait(&barrier);
+	start = gethrtime();
+	(void) sleep(opt_seconds);
+	running = 0;
+	for (i = 0; i < opt_threads; i++) {
+		(void) pthread_join(workers[i].w_thread, NULL);
+		ops += workers[i].w_ops;
+		errors += workers[i].w_errors;
+	}
+	elapsed = gethrtime() - start;
+
+	for (i = 0; i < opt_threads; i++) {
+		if (opt_private || i == 0)
+			(void) unlink(workers[i].w_path);
+	}
+	remove_tree(leaf);
+	(void) rmdir(basedir);
+
+	(void) printf("%s: depth %d, %d threads, %s files: "
+	    "%llu ops in %.2fs, %.0f ops/s\n",
+	    opt_open ? "open" : "stat", opt_depth, opt_threads,
+	    opt_private ? "private" : "shared", (u_longlong_t)ops,
+	    (double)elapsed / NANOSEC,
+	    (double)ops * NANOSEC / (double)elapsed);
+
+	if (errors != 0) {
+		(void) fprintf(stderr, "%llu lookups failed\n",
+		    (u_longlong_t)errors);
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,200 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure how quickly a process can start children, using each of fork(2)
+ * followed by exec, vfork(2) followed by exec, and posix_spawn(3C), and
+ * report the rate for each.  The parent can be made to look like a large
+ * application by giving it some resident memory to carry around (-m) and
+ * a number of open file descriptors (-f); with -c every child is started
+ * with all descriptors above stderr closed, as many applications ask for.
+ *
+ *	spawn_bench [-c] [-f fds] [-m megabytes] [-n count] [program]
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+
+extern char **environ;
+
+static int opt_closefrom = 0;
+static int opt_fds = 0;
+static size_t opt_mbytes = 0;
+static int opt_count = 1000;
+static char *opt_prog = "/bin/true";
+
+static void
+fatal(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+static void
+reap(pid_t pid)
+{
+	int status;
+
+	while (waitpid(pid, &status, 0) != pid) {
+		if (errno != EINTR)
+			fatal("waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		(void) fprintf(stderr, "%s failed\n", opt_prog);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+child_exec(char *argv[])
+{
+	if (opt_closefrom)
+		closefrom(STDERR_FILENO + 1);
+	(void) execve(opt_prog, argv, environ);
+	_exit(127);
+}
+
+static void
+run_fork(char *argv[])
+{
+	pid_t pid;
+
+	if ((pid = fork()) < 0)
+		fatal("fork");
+	if (pid == 0)
+		child_exec(argv);
+	reap(pid);
+}
+
+static void
+run_vfork(char *argv[])
+{
+	pid_t pid;
+
+	if ((pid = vfork()) < 0)
+		fatal("vfork");
+	if (pid == 0)
+		child_exec(argv);
+	reap(pid);
+}
+
+static posix_spawn_file_actions_t actions;
+
+static void
+run_spawn(char *argv[])
+{
+	pid_t pid;
+
+	if ((errno = posix_spawn(&pid, opt_prog,
+	    opt_closefrom ? &actions : NULL, NULL, argv, environ)) != 0)
+		fatal("posix_spawn");
+	reap(pid);
+}
+
+static void
+measure(const char *name, void (*func)(char **), char *argv[])
+{
+	hrtime_t start, elapsed;
+	int i;
+
+	start = gethrtime();
+	for (i = 0; i < opt_count; i++)
+		func(argv);
+	elapsed = gethrtime() - start;
+
+	(void) printf("%-12s %8d children %8.3f s %10.1f/s %8.1f us each\n",
+	    name, opt_count, (double)elapsed / NANOSEC,
+	    (double)opt_count * NANOSEC / elapsed,
+	    (double)elapsed / opt_count / 1000);
+}
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr, "usage: %s [-c] [-f fds] [-m megabytes] "
+	    "[-n count] [program]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char *cargv[2];
+	char *mem;
+	size_t len;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "cf:m:n:")) != -1) {
+		switch (c) {
+		case 'c':
+			opt_closefrom = 1;
+			break;
+		case 'f':
+			opt_fds = atoi(optarg);
+			break;
+		case 'm':
+			opt_mbytes = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt_count = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		opt_prog = argv[optind++];
+	if (optind != argc || opt_fds < 0 || opt_count < 1)
+		usage(argv[0]);
+
+	/*
+	 * Touch every page of the memory, so that fork(2) has to copy the
+	 * mappings to all of it.
+	 */
+	if (opt_mbytes != 0) {
+		len = opt_mbytes * 1024 * 1024;
+		if ((mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANON, -1, 0)) == MAP_FAILED)
+			fatal("mmap");
+		(void) memset(mem, 1, len);
+	}
+
+	for (i = 0; i < opt_fds; i++) {
+		if (open("/dev/null", O_RDONLY) < 0)
+			fatal("/dev/null");
+	}
+
+	if ((errno = posix_spawn_file_actions_init(&actions)) != 0 ||
+	    (errno = posix_spawn_file_actions_addclosefrom_np(&actions,
+	    STDERR_FILENO + 1)) != 0)
+		fatal("posix_spawn_file_actions");
+
+	cargv[0] = opt_prog;
+	cargv[1] = NULL;
+
+	(void) printf("%s, %lu MB resident, %d extra fds%s\n", opt_prog,
+	    (ulong_t)opt_mbytes, opt_fds, opt_closefrom ? ", closefrom" : "");
+	measure("fork+exec", run_fork, cargv);
+	measure("vfork+exec", run_vfork, cargv);
+	measure("posix_spawn", run_spawn, cargv);
+
+	(void) posix_spawn_file_actions_destroy(&actions);
+	return (0);
+}
@@ -0,0 +1,232 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check fcntl(fd, F_CLOSEFROM), closefrom(3C) and the closefrom action of
+ * posix_spawn(3C): with descriptors open here and there up to the top of
+ * the file table, everything from the given descriptor up is closed, open
+ * or not, and everything below it is left alone.  A negative descriptor
+ * fails with EBADF, and one beyond the table is not an error.
+ *
+ * For the posix_spawn check the program runs itself as the child,
+ *
+ *	closefrom_test -c fd open|closed ...
+ *
+ * which exits 0 if each descriptor is open or closed as given.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <err.h>
+#include <spawn.h>
+
+extern char **environ;
+
+static int failures;
+static int maxfd;
+
+static void
+fail(const char *what, int fd)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s: fd %d\n", what, fd);
+	failures++;
+}
+
+static int
+is_open(int fd)
+{
+	return (fcntl(fd, F_GETFD) != -1);
+}
+
+/*
+ * Open descriptors at and around low, with gaps, and at the top of the
+ * table, filling in the array with the ones that were opened.
+ */
+static int
+open_fds(int low, int *fds)
+{
+	int offsets[] = { -3, -1, 0, 2, 3, 17, 100 };
+	int i, n = 0, fd;
+
+	for (i = 0; i < sizeof (offsets) / sizeof (offsets[0]); i++) {
+		fd = low + offsets[i];
+		if (fd > 2 && fd < maxfd)
+			fds[n++] = fd;
+	}
+	fds[n++] = maxfd;
+
+	for (i = 0; i < n; i++) {
+		if (dup2(STDIN_FILENO, fds[i]) != fds[i])
+			err(EXIT_FAILURE, "dup2 to %d", fds[i]);
+	}
+	return (n);
+}
+
+static void
+check_fds(const char *what, int low, int *fds, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (fds[i] < low && !is_open(fds[i]))
+			fail(what, fds[i]);
+		else if (fds[i] >= low && is_open(fds[i]))
+			fail(what, fds[i]);
+	}
+	for (i = 0; i <= 2; i++) {
+		if (!is_open(i))
+			fail(what, i);
+	}
+}
+
+static void
+close_fds(int *fds, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		(void) close(fds[i]);
+}
+
+static void
+check_fcntl(int low)
+{
+	int fds[10], n;
+
+	n = open_fds(low, fds);
+	if (fcntl(low, F_CLOSEFROM, 0) != 0)
+		fail("F_CLOSEFROM failed", low);
+	check_fds("F_CLOSEFROM", low, fds, n);
+	close_fds(fds, n);
+}
+
+static void
+check_closefrom(int low)
+{
+	int fds[10], n;
+
+	n = open_fds(low, fds);
+	closefrom(low);
+	check_fds("closefrom", low, fds, n);
+	close_fds(fds, n);
+}
+
+static void
+check_errors(void)
+{
+	errno = 0;
+	if (fcntl(-1, F_CLOSEFROM, 0) != -1 || errno != EBADF)
+		fail("F_CLOSEFROM of a negative descriptor", -1);
+	if (fcntl(maxfd + 1, F_CLOSEFROM, 0) != 0)
+		fail("F_CLOSEFROM beyond the table", maxfd + 1);
+	if (fcntl(INT_MAX, F_CLOSEFROM, 0) != 0)
+		fail("F_CLOSEFROM beyond the table", INT_MAX);
+	check_fds("F_CLOSEFROM of nothing", maxfd + 1, NULL, 0);
+}
+
+static void
+check_spawn(int low)
+{
+	posix_spawn_file_actions_t fa;
+	char *argv[64];
+	char bufs[10][16];
+	int fds[10], n, i, argc, status;
+	pid_t pid;
+
+	n = open_fds(low, fds);
+	argc = 0;
+	argv[argc++] = (char *)getexecname();
+	argv[argc++] = "-c";
+	for (i = 0; i < n; i++) {
+		(void) snprintf(bufs[i], sizeof (bufs[i]), "%d", fds[i]);
+		argv[argc++] = bufs[i];
+		argv[argc++] = fds[i] < low ? "open" : "closed";
+	}
+	argv[argc] = NULL;
+
+	if ((errno = posix_spawn_file_actions_init(&fa)) != 0 ||
+	    (errno = posix_spawn_file_actions_addclosefrom_np(&fa, low)) != 0)
+		err(EXIT_FAILURE, "posix_spawn_file_actions");
+	if ((errno = posix_spawn(&pid, argv[0], &fa, NULL, argv,
+	    environ)) != 0)
+		err(EXIT_FAILURE, "posix_spawn");
+	(void) posix_spawn_file_actions_destroy(&fa);
+
+	if (waitpid(pid, &status, 0) != pid)
+		err(EXIT_FAILURE, "waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		fail("posix_spawn closefrom", low);
+
+	/* the parent's descriptors are all still open */
+	check_fds("parent after posix_spawn", maxfd + 1, fds, n);
+	close_fds(fds, n);
+}
+
+static int
+child(int argc, char *argv[])
+{
+	int i, fd, ret = 0;
+
+	for (i = 0; i + 1 < argc; i += 2) {
+		fd = atoi(argv[i]);
+		if (is_open(fd) != (strcmp(argv[i + 1], "open") == 0)) {
+			(void) fprintf(stderr, "TEST FAILED: child: fd %d "
+			    "should be %s\n", fd, argv[i + 1]);
+			ret = 1;
+		}
+	}
+	return (ret);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const int lows[] = { 3, 4, 10, 64, 1000 };
+	struct rlimit rl;
+	int i, low;
+
+	if (argc > 1 && strcmp(argv[1], "-c") == 0)
+		return (child(argc - 2, argv + 2));
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+		err(EXIT_FAILURE, "getrlimit");
+	if (rl.rlim_cur < 2048 && rl.rlim_max >= 2048) {
+		rl.rlim_cur = 2048;
+		(void) setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	maxfd = (int)sysconf(_SC_OPEN_MAX) - 1;
+
+	for (i = 0; i < sizeof (lows) / sizeof (lows[0]); i++) {
+		if ((low = lows[i]) >= maxfd)
+			continue;
+		check_fcntl(low);
+		check_closefrom(low);
+		check_spawn(low);
+	}
+	/* just the descriptor at the top of the table */
+	check_fcntl(maxfd);
+	check_closefrom(maxfd);
+	check_errors();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
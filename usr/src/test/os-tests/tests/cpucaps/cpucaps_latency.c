@@ -0,0 +1,167 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure the scheduling latency of a lightly loaded thread in a project
+ * whose CPU cap is kept busy by spinning threads, and fail if the 99th
+ * percentile is above a limit.  The program moves itself into a new task
+ * in the given project (which need not exist in the project database),
+ * caps the project, starts the spinners and then repeatedly sleeps for a
+ * millisecond, timing how late it gets back.  A zone's cap is enforced by
+ * the same code as a project's.
+ *
+ * Must be run as root.
+ *
+ *	cpucaps_latency [-c cap] [-l limit-ms] [-n samples] [-p projid]
+ *	    [-s spinners]
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/task.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <project.h>
+#include <rctl.h>
+
+#define	SLEEP_NS	1000000LL	/* 1ms */
+#define	NS_PER_MS	1000000LL
+
+static int opt_cap = 50;		/* percent of a CPU */
+static int opt_limit = 50;		/* milliseconds */
+static int opt_samples = 2000;
+static projid_t opt_projid = 4242;
+static int opt_spinners = 4;
+
+static void
+fatal(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+/* ARGSUSED */
+static void *
+spin(void *arg)
+{
+	volatile uint64_t n = 0;
+
+	for (;;)
+		n++;
+	/* NOTREACHED */
+	return (NULL);
+}
+
+static void
+set_cap(void)
+{
+	rctlblk_t *rblk;
+
+	if ((rblk = malloc(rctlblk_size())) == NULL)
+		fatal("malloc");
+	rctlblk_set_value(rblk, opt_cap);
+	rctlblk_set_privilege(rblk, RCPRIV_PRIVILEGED);
+	rctlblk_set_local_action(rblk, RCTL_LOCAL_DENY, 0);
+	if (setrctl("project.cpu-cap", NULL, rblk, RCTL_INSERT) != 0)
+		fatal("setrctl project.cpu-cap");
+	free(rblk);
+}
+
+static int
+hrcmp(const void *a, const void *b)
+{
+	hrtime_t x = *(const hrtime_t *)a;
+	hrtime_t y = *(const hrtime_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr, "usage: %s [-c cap] [-l limit-ms] "
+	    "[-n samples] [-p projid] [-s spinners]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct timespec ts = { 0, SLEEP_NS };
+	pthread_t tid;
+	hrtime_t *lat, start, p50, p99;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "c:l:n:p:s:")) != -1) {
+		switch (c) {
+		case 'c':
+			opt_cap = atoi(optarg);
+			break;
+		case 'l':
+			opt_limit = atoi(optarg);
+			break;
+		case 'n':
+			opt_samples = atoi(optarg);
+			break;
+		case 'p':
+			opt_projid = atoi(optarg);
+			break;
+		case 's':
+			opt_spinners = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || opt_cap < 1 || opt_limit < 1 ||
+	    opt_samples < 100 || opt_projid < 0 || opt_spinners < 0)
+		usage(argv[0]);
+
+	if ((lat = calloc(opt_samples, sizeof (hrtime_t))) == NULL)
+		fatal("calloc");
+
+	if (settaskid(opt_projid, TASK_NORMAL) == -1)
+		fatal("settaskid");
+	set_cap();
+
+	for (i = 0; i < opt_spinners; i++) {
+		if ((errno = pthread_create(&tid, NULL, spin, NULL)) != 0)
+			fatal("pthread_create");
+	}
+
+	/* let the cap fill up before measuring */
+	(void) sleep(2);
+
+	for (i = 0; i < opt_samples; i++) {
+		start = gethrtime();
+		(void) nanosleep(&ts, NULL);
+		lat[i] = gethrtime() - start - SLEEP_NS;
+	}
+
+	qsort(lat, opt_samples, sizeof (hrtime_t), hrcmp);
+	p50 = lat[opt_samples / 2];
+	p99 = lat[(opt_samples * 99) / 100];
+
+	(void) printf("cap %d%%, %d spinners: latency p50 %.3fms "
+	    "p99 %.3fms max %.3fms\n", opt_cap, opt_spinners,
+	    (double)p50 / NS_PER_MS, (double)p99 / NS_PER_MS,
+	    (double)lat[opt_samples - 1] / NS_PER_MS);
+
+	if (p99 > opt_limit * NS_PER_MS) {
+		(void) printf("FAIL: p99 latency above %dms\n", opt_limit);
+		return (EXIT_FAILURE);
+	}
+	return (0);
+}
@@ -0,0 +1,398 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check that pathname lookups resolved from the DNLC, including by the
+ * lockless walk of dnlc_lookup_path(), see changes to the tree as soon as
+ * they are made.  Each check looks the path up repeatedly first, so that
+ * every component is cached, then changes the tree and checks what the
+ * next lookups return:
+ *
+ *  - renaming or removing a directory in the middle of a deep path, and
+ *    putting it back;
+ *  - creating a file whose name has been looked up and not found, and
+ *    removing it again;
+ *  - paths going through "..", and through a symbolic link that is then
+ *    pointed somewhere else;
+ *  - taking away search permission on a directory in the middle of the
+ *    path, which has to fail with EACCES for an unprivileged user;
+ *  - renaming a directory back and forth while other threads look up a
+ *    path through it, which may only ever find the right file or nothing.
+ *
+ * Run as root, the permission check is made with the effective uid of
+ * nobody.  The tree is created in /var/tmp, or the directory given.
+ *
+ *	dnlc_lookup [dir]
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define	DEPTH		8
+#define	MIDDLE		3
+#define	WARM		100
+#define	NTHREADS	4
+#define	NRENAMES	2000
+
+static char basedir[PATH_MAX];
+static char dirs[DEPTH][PATH_MAX];
+static char leaf[PATH_MAX];
+static ino_t leaf_ino;
+static int failures;
+static volatile int running;
+
+static void
+fail(const char *what, const char *path)
+{
+	(void) fprintf(stderr, "TEST FAILED: %s: %s\n", what, path);
+	failures++;
+}
+
+/*
+ * Look a path up often enough for all of it to be in the DNLC.
+ */
+static void
+warm(const char *path)
+{
+	struct stat st;
+	int i;
+
+	for (i = 0; i < WARM; i++)
+		(void) stat(path, &st);
+}
+
+/*
+ * Look a path up, expecting it to find the given inode (or, if ino is 0,
+ * to fail with the given errno).
+ */
+static void
+expect(const char *what, const char *path, ino_t ino, int error)
+{
+	struct stat st;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (stat(path, &st) == 0) {
+			if (ino == 0)
+				fail(what, path);
+			else if (st.st_ino != ino)
+				fail(what, path);
+		} else if (ino != 0 || errno != error) {
+			fail(what, path);
+		}
+	}
+}
+
+static ino_t
+inode(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		err(EXIT_FAILURE, "stat %s", path);
+	return (st.st_ino);
+}
+
+static void
+make_file(const char *path)
+{
+	int fd;
+
+	if ((fd = open(path, O_CREAT | O_WRONLY | O_EXCL, 0644)) < 0)
+		err(EXIT_FAILURE, "create %s", path);
+	(void) close(fd);
+}
+
+static void
+make_tree(void)
+{
+	char *dir = basedir;
+	int i;
+
+	for (i = 0; i < DEPTH; i++) {
+		(void) snprintf(dirs[i], PATH_MAX, "%s/d%d", dir, i);
+		if (mkdir(dirs[i], 0755) != 0)
+			err(EXIT_FAILURE, "mkdir %s", dirs[i]);
+		dir = dirs[i];
+	}
+	(void) snprintf(leaf, sizeof (leaf), "%s/file", dir);
+	make_file(leaf);
+	leaf_ino = inode(leaf);
+}
+
+/*
+ * The path of the leaf with the directory at depth MIDDLE renamed.
+ */
+static void
+renamed(char *buf, const char *name)
+{
+	int i;
+
+	(void) snprintf(buf, PATH_MAX, "%s", basedir);
+	for (i = 0; i < DEPTH; i++) {
+		(void) strlcat(buf, "/", PATH_MAX);
+		if (i == MIDDLE) {
+			(void) strlcat(buf, name, PATH_MAX);
+		} else {
+			(void) snprintf(buf + strlen(buf),
+			    PATH_MAX - strlen(buf), "d%d", i);
+		}
+	}
+	(void) strlcat(buf, "/file", PATH_MAX);
+}
+
+static void
+check_rename(void)
+{
+	char moved[PATH_MAX], other[PATH_MAX], name[MAXNAMELEN];
+
+	(void) snprintf(other, sizeof (other), "%s.moved", dirs[MIDDLE]);
+	(void) snprintf(name, sizeof (name), "d%d.moved", MIDDLE);
+	renamed(moved, name);
+
+	warm(leaf);
+	if (rename(dirs[MIDDLE], other) != 0)
+		err(EXIT_FAILURE, "rename %s", dirs[MIDDLE]);
+	expect("old name after rename", leaf, 0, ENOENT);
+	expect("new name after rename", moved, leaf_ino, 0);
+
+	warm(moved);
+	if (rename(other, dirs[MIDDLE]) != 0)
+		err(EXIT_FAILURE, "rename %s", other);
+	expect("renamed name after rename back", moved, 0, ENOENT);
+	expect("name after rename back", leaf, leaf_ino, 0);
+
+	/* a directory that is replaced by an empty one */
+	warm(leaf);
+	if (rename(dirs[MIDDLE], other) != 0 || mkdir(dirs[MIDDLE], 0755) != 0)
+		err(EXIT_FAILURE, "replace %s", dirs[MIDDLE]);
+	expect("name after replacing directory", leaf, 0, ENOENT);
+	if (rmdir(dirs[MIDDLE]) != 0 || rename(other, dirs[MIDDLE]) != 0)
+		err(EXIT_FAILURE, "restore %s", dirs[MIDDLE]);
+	expect("name after restoring directory", leaf, leaf_ino, 0);
+}
+
+static void
+check_negative(void)
+{
+	char path[PATH_MAX];
+
+	(void) snprintf(path, sizeof (path), "%s/new", dirs[DEPTH - 1]);
+
+	warm(path);
+	expect("missing file", path, 0, ENOENT);
+	make_file(path);
+	expect("file created after failed lookups", path, inode(path), 0);
+
+	warm(path);
+	if (unlink(path) != 0)
+		err(EXIT_FAILURE, "unlink %s", path);
+	expect("removed file", path, 0, ENOENT);
+
+	warm(path);
+	make_file(path);
+	expect("file created again", path, inode(path), 0);
+	(void) unlink(path);
+}
+
+static void
+check_dotdot(void)
+{
+	char path[PATH_MAX];
+
+	(void) snprintf(path, sizeof (path), "%s/../d%d/./d%d/../d%d/file",
+	    dirs[DEPTH - 2], DEPTH - 2, DEPTH - 1, DEPTH - 1);
+	warm(path);
+	expect("path through ..", path, leaf_ino, 0);
+
+	(void) snprintf(path, sizeof (path), "%s/d%d/../d%d/../d%d",
+	    dirs[MIDDLE], MIDDLE + 1, MIDDLE + 1, MIDDLE + 1);
+	warm(path);
+	expect("path through repeated ..", path, inode(dirs[MIDDLE + 1]), 0);
+
+	/* ".." in a directory that has moved finds its new parent */
+	(void) snprintf(path, sizeof (path), "%s/..", dirs[DEPTH - 1]);
+	warm(path);
+	if (rename(dirs[DEPTH - 1], "d0/moved") != 0)
+		err(EXIT_FAILURE, "rename %s", dirs[DEPTH - 1]);
+	expect("path through .. after move", "d0/moved/..", inode("d0"), 0);
+	if (rename("d0/moved", dirs[DEPTH - 1]) != 0)
+		err(EXIT_FAILURE, "rename back %s", dirs[DEPTH - 1]);
+	expect("path through .. after move back", path,
+	    inode(dirs[DEPTH - 2]), 0);
+}
+
+static void
+check_symlink(void)
+{
+	char link[PATH_MAX], path[PATH_MAX];
+	char other[PATH_MAX], otherfile[PATH_MAX];
+
+	(void) snprintf(link, sizeof (link), "%s/link", basedir);
+	(void) snprintf(other, sizeof (other), "%s/other", basedir);
+	(void) snprintf(otherfile, sizeof (otherfile), "%s/other/d%d/file",
+	    basedir, DEPTH - 1);
+	if (mkdir(other, 0755) != 0)
+		err(EXIT_FAILURE, "mkdir %s", other);
+	(void) snprintf(path, sizeof (path), "%s/d%d", other, DEPTH - 1);
+	if (mkdir(path, 0755) != 0)
+		err(EXIT_FAILURE, "mkdir %s", path);
+	make_file(otherfile);
+
+	/* a relative link to the parent of the leaf's directory */
+	if (symlink(dirs[DEPTH - 2] + strlen(basedir) + 1, link) != 0)
+		err(EXIT_FAILURE, "symlink %s", link);
+	(void) snprintf(path, sizeof (path), "%s/d%d/file", link, DEPTH - 1);
+	warm(path);
+	expect("path through symlink", path, leaf_ino, 0);
+
+	if (unlink(link) != 0 || symlink("other", link) != 0)
+		err(EXIT_FAILURE, "replace %s", link);
+	expect("path through changed symlink", path, inode(otherfile), 0);
+
+	(void) unlink(link);
+	expect("path through removed symlink", path, 0, ENOENT);
+
+	(void) unlink(otherfile);
+	(void) snprintf(path, sizeof (path), "%s/d%d", other, DEPTH - 1);
+	(void) rmdir(path);
+	(void) rmdir(other);
+}
+
+static void
+check_search(void)
+{
+	uid_t uid = geteuid();
+
+	if (uid == 0 && seteuid(UID_NOBODY) != 0)
+		err(EXIT_FAILURE, "seteuid");
+	warm(leaf);
+	expect("searchable path", leaf, leaf_ino, 0);
+
+	if (uid == 0 && seteuid(0) != 0)
+		err(EXIT_FAILURE, "seteuid");
+	if (chmod(dirs[MIDDLE], uid == 0 ? 0700 : 0600) != 0)
+		err(EXIT_FAILURE, "chmod %s", dirs[MIDDLE]);
+	if (uid == 0 && seteuid(UID_NOBODY) != 0)
+		err(EXIT_FAILURE, "seteuid");
+	expect("path without search permission", leaf, 0, EACCES);
+
+	if (uid == 0 && seteuid(0) != 0)
+		err(EXIT_FAILURE, "seteuid");
+	if (chmod(dirs[MIDDLE], 0755) != 0)
+		err(EXIT_FAILURE, "chmod %s", dirs[MIDDLE]);
+	if (uid == 0 && seteuid(UID_NOBODY) != 0)
+		err(EXIT_FAILURE, "seteuid");
+	expect("path with search permission restored", leaf, leaf_ino, 0);
+
+	if (uid == 0 && seteuid(0) != 0)
+		err(EXIT_FAILURE, "seteuid");
+}
+
+/* ARGSUSED */
+static void *
+looker(void *arg)
+{
+	struct stat st;
+
+	while (running) {
+		if (stat(leaf, &st) == 0) {
+			if (st.st_ino != leaf_ino)
+				fail("wrong file during renames", leaf);
+		} else if (errno != ENOENT) {
+			fail("lookup error during renames", leaf);
+		}
+	}
+	return (NULL);
+}
+
+static void
+check_concurrent(void)
+{
+	pthread_t tids[NTHREADS];
+	char other[PATH_MAX];
+	int i;
+
+	(void) snprintf(other, sizeof (other), "%s.moved", dirs[MIDDLE]);
+
+	running = 1;
+	for (i = 0; i < NTHREADS; i++) {
+		if ((errno = pthread_create(&tids[i], NULL, looker, NULL)) != 0)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	for (i = 0; i < NRENAMES; i++) {
+		if (rename(dirs[MIDDLE], other) != 0 ||
+		    rename(other, dirs[MIDDLE]) != 0)
+			err(EXIT_FAILURE, "rename %s", dirs[MIDDLE]);
+	}
+	running = 0;
+	for (i = 0; i < NTHREADS; i++)
+		(void) pthread_join(tids[i], NULL);
+
+	expect("path after concurrent renames", leaf, leaf_ino, 0);
+}
+
+static void
+remove_tree(void)
+{
+	int i;
+
+	(void) unlink(leaf);
+	for (i = DEPTH - 1; i >= 0; i--)
+		(void) rmdir(dirs[i]);
+	(void) rmdir(basedir);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *parent = "/var/tmp";
+
+	if (argc > 2) {
+		(void) fprintf(stderr, "usage: %s [dir]\n", argv[0]);
+		return (2);
+	}
+	if (argc == 2)
+		parent = argv[1];
+
+	(void) snprintf(basedir, sizeof (basedir), "%s/dnlc_lookup.%d",
+	    parent, (int)getpid());
+	if (mkdir(basedir, 0755) != 0)
+		err(EXIT_FAILURE, "mkdir %s", basedir);
+	if (chdir(basedir) != 0)
+		err(EXIT_FAILURE, "chdir %s", basedir);
+	make_tree();
+
+	check_rename();
+	check_negative();
+	check_dotdot();
+	check_symlink();
+	check_search();
+	check_concurrent();
+
+	remove_tree();
+
+	if (failures != 0)
+		return (EXIT_FAILURE);
+
+	(void) printf("TEST PASSED\n");
+	return (EXIT_SUCCESS);
+}
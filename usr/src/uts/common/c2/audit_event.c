@@ -504,7 +504,7 @@ aui_null,	AUE_NULL,	aus_null,	/* 145 lwp_info */
 		auf_null,	0,
 aui_null,	AUE_NULL,	aus_null,	/* 146 yield */
 		auf_null,	0,
-aui_null,	AUE_NULL,	aus_null,	/* 147 (loadable) */
+aui_null,	AUE_NULL,	aus_null,	/* 147 lwp_addr_sys */
 						/*	was lwp_sema_wait */
 		auf_null,	0,
 aui_null,	AUE_NULL,	aus_null,	/* 148 lwp_sema_post */
@@ -194,10 +194,10 @@ crypto_unbufcall(crypto_bc_t bc)
 }
 
 /*
- * We sample the number of jobs. We do not hold the lock
+ * We sample the number of jobs. We do not hold the locks
  * as it is not necessary to get the exact count.
  */
-#define	KCF_GSWQ_AVAIL	(gswq->gs_maxjobs - gswq->gs_njobs)
+#define	KCF_GSWQ_AVAIL	kcf_swq_avail()
 
 /*
  * One queue space each for init, update, and final.
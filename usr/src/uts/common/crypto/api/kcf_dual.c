@@ -266,6 +266,7 @@ retry:
 			}
 
 			encr_req.cr_flag = crq->cr_flag;
+			encr_req.cr_batch = crq->cr_batch;
 			encr_req.cr_callback_func = kcf_next_req;
 			encr_req.cr_callback_arg = next_req;
 		}
@@ -1219,6 +1220,7 @@ retry:
 
 			mac_req.cr_flag = (crq != NULL) ? crq->cr_flag : 0;
 			mac_req.cr_flag |= CRYPTO_SETDUAL;
+			mac_req.cr_batch = (crq != NULL) ? crq->cr_batch : NULL;
 			mac_req.cr_callback_func = kcf_next_req;
 			mac_req.cr_callback_arg = next_req;
 			mac_reqp = &mac_req;
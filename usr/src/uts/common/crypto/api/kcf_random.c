@@ -726,6 +726,15 @@ punt:
 		nblock--;
 	} while (bytes > 0);
 
+	/*
+	 * Fast key erasure: step the key once more, with an output block
+	 * which is never handed out.  The key which produced the bytes
+	 * above then cannot be recovered from what is left in the
+	 * magazine, should its memory be disclosed later.
+	 */
+	bcopy(rmp->rm_mag.rm_seed, seed, HASHSIZE);
+	fips_random_inner(rmp->rm_mag.rm_key, tempout, seed);
+
 	/* Zero out sensitive information */
 	bzero(seed, HASHSIZE);
 	bzero(tempout, HASHSIZE);
@@ -787,6 +796,8 @@ kcf_rnd_get_pseudo_bytes(uint8_t *ptr, size_t len)
 		if (eptr <= rmp->rm_mag.rm_eptr) {
 			rmp->rm_mag.rm_rptr = eptr;
 			bcopy(cptr, ptr, len);
+			/* Erase what was handed out. */
+			bzero(cptr, len);
 			BUMP_CPU_RND_STATS(rmp, rs_urndOut, len);
 			mutex_exit(&rmp->rm_mag.rm_lock);
 
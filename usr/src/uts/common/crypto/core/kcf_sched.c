@@ -54,7 +54,7 @@
 #include <sys/sunddi.h>
 
 
-kcf_global_swq_t *gswq;	/* Global software queue */
+kcf_global_swq_t *gswq;	/* Software queues */
 
 /* Thread pool related variables */
 static kcf_pool_t *kcfpool;	/* Thread pool of kcfd LWPs */
@@ -65,6 +65,18 @@ static ulong_t	kcf_idlethr_timeout;
 static boolean_t kcf_sched_running = B_FALSE;
 #define	KCF_DEFAULT_THRTIMEOUT	60000000	/* 60 seconds */
 
+/*
+ * A CRYPTO_ALWAYS_QUEUE request from a consumer which also set
+ * CRYPTO_INLINE_OK is run on the caller's thread when queueing it would
+ * only add a context switch: it has no context whose earlier requests
+ * could still be queued, the caller is not an interrupt, and nothing is
+ * waiting on this CPU's software queue.  Once the queue backs up, the
+ * requests are spread over the pool threads as before.
+ */
+#define	KCF_SW_INLINE(crq, ctx)						\
+	(((crq)->cr_flag & CRYPTO_INLINE_OK) && (ctx) == NULL &&	\
+	!servicing_interrupt() && KCF_SWQ_CPU()->sq_njobs == 0)
+
 /* kmem caches used by the scheduler */
 static struct kmem_cache *kcf_sreq_cache;
 static struct kmem_cache *kcf_areq_cache;
@@ -92,9 +104,12 @@ ulong_t kcf_swprov_hndl = 0;
 static kcf_areq_node_t *kcf_areqnode_alloc(kcf_provider_desc_t *,
     kcf_context_t *, crypto_call_req_t *, kcf_req_params_t *, boolean_t);
 static int kcf_disp_sw_request(kcf_areq_node_t *);
+static int kcf_batch_sw_request(kcf_areq_node_t *, crypto_batch_t *);
 static void process_req_hwp(void *);
 static kcf_areq_node_t	*kcf_dequeue(void);
 static int kcf_enqueue(kcf_areq_node_t *);
+static void kcf_wakeup_idle(uint_t);
+static uint_t kcf_swq_njobs(void);
 static void kcfpool_alloc(void);
 static void kcf_reqid_delete(kcf_areq_node_t *areq);
 static crypto_req_id_t kcf_reqid_insert(kcf_areq_node_t *areq);
@@ -160,10 +175,14 @@ kcf_areqnode_alloc(kcf_provider_desc_t *pd, kcf_context_t *ictx,
 
 	arptr->an_state = REQ_ALLOCATED;
 	arptr->an_reqarg = *crq;
+	/* The batch is the consumer's; a resubmission must not use it. */
+	arptr->an_reqarg.cr_flag &= ~CRYPTO_BATCH;
+	arptr->an_reqarg.cr_batch = NULL;
 	arptr->an_params = *req;
 	arptr->an_context = ictx;
 	arptr->an_isdual = isdual;
 
+	arptr->an_swq = KCF_SWQ_CPU();
 	arptr->an_next = arptr->an_prev = NULL;
 	KCF_PROV_REFHOLD(pd);
 	arptr->an_provider = pd;
@@ -200,6 +219,27 @@ kcf_areqnode_alloc(kcf_provider_desc_t *pd, kcf_context_t *ictx,
 	return (arptr);
 }
 
+/*
+ * Wake up to n idle pool threads for requests just queued.  The
+ * barrier orders the queueing before the load of kp_idlethreads, so
+ * that a thread about to go idle either sees the requests or is seen
+ * here; see kcfpool_svc().
+ */
+static void
+kcf_wakeup_idle(uint_t n)
+{
+	membar_enter();
+	if (n == 0 || kcfpool->kp_idlethreads == 0)
+		return;
+
+	mutex_enter(&gswq->gs_lock);
+	if (n == 1)
+		cv_signal(&gswq->gs_cv);
+	else
+		cv_broadcast(&gswq->gs_cv);
+	mutex_exit(&gswq->gs_lock);
+}
+
 /*
  * Queue the request node and do one of the following:
  *	- If there is an idle thread signal it to run.
@@ -213,14 +253,9 @@ kcf_disp_sw_request(kcf_areq_node_t *areq)
 	if ((err = kcf_enqueue(areq)) != 0)
 		return (err);
 
-	if (kcfpool->kp_idlethreads > 0) {
-		/* Signal an idle thread to run */
-		mutex_enter(&gswq->gs_lock);
-		cv_signal(&gswq->gs_cv);
-		mutex_exit(&gswq->gs_lock);
-
+	kcf_wakeup_idle(1);
+	if (kcfpool->kp_idlethreads > 0)
 		return (CRYPTO_QUEUED);
-	}
 
 	/* Signal the creator thread for more threads */
 	mutex_enter(&kcfpool->kp_lock);
@@ -230,6 +265,93 @@ kcf_disp_sw_request(kcf_areq_node_t *areq)
 	return (CRYPTO_QUEUED);
 }
 
+/*
+ * Hold a request for the global software queue in the consumer's batch,
+ * to be queued by crypto_batch_submit().  Only context-less requests
+ * without a request ID can be held; anything else is dispatched right
+ * away, as cancellation and the context request chain assume that a
+ * request is on the queue once it has been accepted.
+ */
+static int
+kcf_batch_sw_request(kcf_areq_node_t *areq, crypto_batch_t *batch)
+{
+	kcf_areq_node_t *last;
+
+	if (batch == NULL || areq->an_context != NULL ||
+	    !(areq->an_reqarg.cr_flag & CRYPTO_SKIP_REQID))
+		return (kcf_disp_sw_request(areq));
+
+	ASSERT(areq->an_next == NULL);
+	if ((last = batch->cb_last) == NULL) {
+		batch->cb_first = areq;
+	} else {
+		last->an_next = areq;
+	}
+	batch->cb_last = areq;
+	batch->cb_count++;
+
+	return (CRYPTO_QUEUED);
+}
+
+/*
+ * Queue all the requests held in a batch on this CPU's software queue,
+ * taking sq_lock and waking up the pool threads once for the lot rather
+ * than once per request.  Requests which do not fit on the queue fail
+ * with CRYPTO_BUSY, as they would have had they been dispatched one by
+ * one; since the consumer was told they were queued, that is reported
+ * through their callbacks.
+ */
+void
+crypto_batch_submit(crypto_batch_t *batch)
+{
+	kcf_areq_node_t *areq, *next;
+	kcf_swq_t *sq;
+	uint_t queued = 0;
+
+	if ((areq = batch->cb_first) == NULL)
+		return;
+	batch->cb_first = batch->cb_last = NULL;
+	batch->cb_count = 0;
+
+	sq = KCF_SWQ_CPU();
+	mutex_enter(&sq->sq_lock);
+	for (; areq != NULL; areq = next) {
+		if (sq->sq_njobs >= gswq->gs_qmaxjobs)
+			break;
+		next = areq->an_next;
+		areq->an_next = NULL;
+
+		areq->an_swq = sq;
+		if (sq->sq_last == NULL) {
+			sq->sq_first = sq->sq_last = areq;
+		} else {
+			ASSERT(sq->sq_last->an_next == NULL);
+			sq->sq_last->an_next = areq;
+			areq->an_prev = sq->sq_last;
+			sq->sq_last = areq;
+		}
+		sq->sq_njobs++;
+		areq->an_state = REQ_WAITING;
+		queued++;
+	}
+	mutex_exit(&sq->sq_lock);
+
+	kcf_wakeup_idle(queued);
+
+	/* Signal the creator thread for more threads */
+	if (queued > kcfpool->kp_idlethreads) {
+		mutex_enter(&kcfpool->kp_lock);
+		cv_signal(&kcfpool->kp_cv);
+		mutex_exit(&kcfpool->kp_lock);
+	}
+
+	for (; areq != NULL; areq = next) {
+		next = areq->an_next;
+		areq->an_next = NULL;
+		kcf_aop_done(areq, CRYPTO_BUSY);
+	}
+}
+
 /*
  * This routine is called by the taskq associated with
  * each hardware provider. We notify the kernel consumer
@@ -701,7 +823,8 @@ kcf_submit_request(kcf_provider_desc_t *pd, crypto_ctx_t *ctx,
 	} else {	/* Asynchronous cases */
 		switch (pd->pd_prov_type) {
 		case CRYPTO_SW_PROVIDER:
-			if (!(crq->cr_flag & CRYPTO_ALWAYS_QUEUE)) {
+			if (!(crq->cr_flag & CRYPTO_ALWAYS_QUEUE) ||
+			    KCF_SW_INLINE(crq, ctx)) {
 				/*
 				 * This case has less overhead since there is
 				 * no switching of context.
@@ -730,7 +853,13 @@ kcf_submit_request(kcf_provider_desc_t *pd, crypto_ctx_t *ctx,
 					crq->cr_reqid = kcf_reqid_insert(areq);
 					}
 
-					error = kcf_disp_sw_request(areq);
+					if (crq->cr_flag & CRYPTO_BATCH) {
+						error = kcf_batch_sw_request(
+						    areq, crq->cr_batch);
+					} else {
+						error =
+						    kcf_disp_sw_request(areq);
+					}
 					/*
 					 * There is an error processing this
 					 * request. Remove the handle and
@@ -907,60 +1036,77 @@ kcf_removereq_in_ctxchain(kcf_context_t *ictx, kcf_areq_node_t *areq)
 }
 
 /*
- * Remove the specified node from the global software queue.
+ * Remove the specified node from its software queue.
  *
  * The caller must hold the queue lock and request lock (an_lock).
  */
 void
 kcf_remove_node(kcf_areq_node_t *node)
 {
+	kcf_swq_t *sq = node->an_swq;
 	kcf_areq_node_t *nextp = node->an_next;
 	kcf_areq_node_t *prevp = node->an_prev;
 
-	ASSERT(mutex_owned(&gswq->gs_lock));
+	ASSERT(mutex_owned(&sq->sq_lock));
 
 	if (nextp != NULL)
 		nextp->an_prev = prevp;
 	else
-		gswq->gs_last = prevp;
+		sq->sq_last = prevp;
 
 	if (prevp != NULL)
 		prevp->an_next = nextp;
 	else
-		gswq->gs_first = nextp;
+		sq->sq_first = nextp;
+	sq->sq_njobs--;
 
 	ASSERT(mutex_owned(&node->an_lock));
 	node->an_state = REQ_CANCELED;
 }
 
 /*
- * Remove and return the first node in the global software queue.
+ * Remove and return the first node in the software queues, looking
+ * at the current CPU's queue first and then at the others in turn.
+ * The queues are peeked at without their locks, so a request queued
+ * concurrently may be missed; kcfpool_svc() copes with that.
  *
- * The caller must hold the queue lock.
+ * The caller must not hold any queue lock.
  */
 static kcf_areq_node_t *
 kcf_dequeue(void)
 {
-	kcf_areq_node_t *tnode = NULL;
+	kcf_areq_node_t *tnode;
+	kcf_swq_t *sq;
+	uint_t i, n = gswq->gs_nqueues;
+	uint_t q = CPU->cpu_seqid;
 
-	ASSERT(mutex_owned(&gswq->gs_lock));
-	if ((tnode = gswq->gs_first) == NULL) {
-		return (NULL);
-	} else {
-		ASSERT(gswq->gs_first->an_prev == NULL);
-		gswq->gs_first = tnode->an_next;
+	for (i = 0; i < n; i++, q = (q + 1 == n) ? 0 : q + 1) {
+		sq = &gswq->gs_queues[q];
+		if (sq->sq_first == NULL)
+			continue;
+
+		mutex_enter(&sq->sq_lock);
+		if ((tnode = sq->sq_first) == NULL) {
+			mutex_exit(&sq->sq_lock);
+			continue;
+		}
+		ASSERT(tnode->an_prev == NULL);
+		sq->sq_first = tnode->an_next;
 		if (tnode->an_next == NULL)
-			gswq->gs_last = NULL;
+			sq->sq_last = NULL;
 		else
 			tnode->an_next->an_prev = NULL;
+		sq->sq_njobs--;
+		mutex_exit(&sq->sq_lock);
+
+		return (tnode);
 	}
 
-	gswq->gs_njobs--;
-	return (tnode);
+	return (NULL);
 }
 
 /*
- * Add the request node to the end of the global software queue.
+ * Add the request node to the end of its software queue.
  *
  * The caller should not hold the queue lock. Returns 0 if the
  * request is successfully queued. Returns CRYPTO_BUSY if the limit
@@ -969,37 +1115,71 @@ kcf_dequeue(void)
 static int
 kcf_enqueue(kcf_areq_node_t *node)
 {
+	kcf_swq_t *sq = node->an_swq;
 	kcf_areq_node_t *tnode;
 
-	mutex_enter(&gswq->gs_lock);
+	mutex_enter(&sq->sq_lock);
 
-	if (gswq->gs_njobs >= gswq->gs_maxjobs) {
-		mutex_exit(&gswq->gs_lock);
+	if (sq->sq_njobs >= gswq->gs_qmaxjobs) {
+		mutex_exit(&sq->sq_lock);
 		return (CRYPTO_BUSY);
 	}
 
-	if (gswq->gs_last == NULL) {
-		gswq->gs_first = gswq->gs_last = node;
+	if (sq->sq_last == NULL) {
+		sq->sq_first = sq->sq_last = node;
 	} else {
-		ASSERT(gswq->gs_last->an_next == NULL);
-		tnode = gswq->gs_last;
+		ASSERT(sq->sq_last->an_next == NULL);
+		tnode = sq->sq_last;
 		tnode->an_next = node;
-		gswq->gs_last = node;
+		sq->sq_last = node;
 		node->an_prev = tnode;
 	}
 
-	gswq->gs_njobs++;
+	sq->sq_njobs++;
 
-	/* an_lock not needed here as we hold gs_lock */
+	/* an_lock not needed here as we hold sq_lock */
 	node->an_state = REQ_WAITING;
 
-	mutex_exit(&gswq->gs_lock);
+	mutex_exit(&sq->sq_lock);
 
 	return (0);
 }
 
 /*
- * Function run by a thread from kcfpool to work on global software queue.
+ * The number of requests on all the software queues, sampled without
+ * the queue locks.
+ */
+static uint_t
+kcf_swq_njobs(void)
+{
+	uint_t i, njobs = 0;
+
+	for (i = 0; i < gswq->gs_nqueues; i++)
+		njobs += gswq->gs_queues[i].sq_njobs;
+
+	return (njobs);
+}
+
+/*
+ * Estimate of the room left on the software queues, for the crypto
+ * bufcalls.
+ */
+uint_t
+kcf_swq_avail(void)
+{
+	uint_t njobs = kcf_swq_njobs();
+
+	return (njobs >= gswq->gs_maxjobs ? 0 : gswq->gs_maxjobs - njobs);
+}
+
+/*
+ * Function run by a thread from kcfpool to work on the software queues.
+ *
+ * A thread with nothing to do counts itself idle under gs_lock before
+ * looking at the queues a last time, and stays under gs_lock until it
+ * sleeps on gs_cv. Submitters queue first and then look at
+ * kp_idlethreads (see kcf_wakeup_idle()), so either the thread finds
+ * the request or the submitter finds the thread and signals it.
  */
 void
 kcfpool_svc(void *arg)
@@ -1015,13 +1195,16 @@ kcfpool_svc(void *arg)
 	KCF_ATOMIC_INCR(kcfpool->kp_threads);
 
 	for (;;) {
+		if ((req = kcf_dequeue()) != NULL)
+			goto run;
+
 		mutex_enter(&gswq->gs_lock);
+		KCF_ATOMIC_INCR(kcfpool->kp_idlethreads);
+		membar_enter();
 
 		while ((req = kcf_dequeue()) == NULL) {
-			KCF_ATOMIC_INCR(kcfpool->kp_idlethreads);
 			rv = cv_reltimedwait(&gswq->gs_cv,
 			    &gswq->gs_lock, timeout_val, TR_CLOCK_TICK);
-			KCF_ATOMIC_DECR(kcfpool->kp_idlethreads);
 
 			switch (rv) {
 			case 0:
@@ -1032,6 +1215,7 @@ kcfpool_svc(void *arg)
 				 * at least kcf_minthreads.
 				 */
 				if (kcfpool->kp_threads > kcf_minthreads) {
+					KCF_ATOMIC_DECR(kcfpool->kp_idlethreads);
 					KCF_ATOMIC_DECR(kcfpool->kp_threads);
 					mutex_exit(&gswq->gs_lock);
 
@@ -1058,8 +1242,9 @@ kcfpool_svc(void *arg)
 			}
 		}
 
+		KCF_ATOMIC_DECR(kcfpool->kp_idlethreads);
 		mutex_exit(&gswq->gs_lock);
-
+run:
 		ictx = req->an_context;
 		if (ictx == NULL) {	/* Context-less operation */
 			pd = req->an_provider;
@@ -1214,9 +1399,16 @@ kcf_sched_init(void)
 
 	mutex_init(&gswq->gs_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&gswq->gs_cv, NULL, CV_DEFAULT, NULL);
-	gswq->gs_njobs = 0;
 	gswq->gs_maxjobs = kcf_maxthreads * crypto_taskq_maxalloc;
-	gswq->gs_first = gswq->gs_last = NULL;
+	gswq->gs_qmaxjobs = gswq->gs_maxjobs / MAX(kcf_minthreads, 1);
+	gswq->gs_nqueues = max_ncpus;
+	/* A multiple of 64 bytes, so each queue gets a cache line. */
+	gswq->gs_queues = kmem_zalloc(max_ncpus * sizeof (kcf_swq_t),
+	    KM_SLEEP);
+	for (i = 0; i < max_ncpus; i++) {
+		mutex_init(&gswq->gs_queues[i].sq_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+	}
 
 	/* Initialize the global reqid table */
 	for (i = 0; i < REQID_TABLES; i++) {
@@ -1493,6 +1685,7 @@ compute_min_max_threads(void)
 	mutex_exit(&cpu_lock);
 	kcf_maxthreads = kcf_thr_multiple * kcf_minthreads;
 	gswq->gs_maxjobs = kcf_maxthreads * crypto_taskq_maxalloc;
+	gswq->gs_qmaxjobs = gswq->gs_maxjobs / kcf_minthreads;
 	mutex_exit(&gswq->gs_lock);
 }
 
@@ -1574,7 +1767,7 @@ kcf_reqid_delete(kcf_areq_node_t *areq)
  *
  * NOTE: We acquire the following locks in this routine (in order):
  *	- rt_lock (kcf_reqid_table_t)
- *	- gswq->gs_lock
+ *	- areq->an_swq->sq_lock
  *	- areq->an_lock
  *	- ictx->kc_in_use_lock (from kcf_removereq_in_ctxchain())
  *
@@ -1604,18 +1797,18 @@ crypto_cancel_req(crypto_req_id_t id)
 
 		switch (pd->pd_prov_type) {
 		case CRYPTO_SW_PROVIDER:
-			mutex_enter(&gswq->gs_lock);
+			mutex_enter(&areq->an_swq->sq_lock);
 			mutex_enter(&areq->an_lock);
 
 			/* This request can be safely canceled. */
 			if (areq->an_state <= REQ_WAITING) {
-				/* Remove from gswq, global software queue. */
+				/* Remove from its software queue. */
 				kcf_remove_node(areq);
 				if ((ictx = areq->an_context) != NULL)
 					kcf_removereq_in_ctxchain(ictx, areq);
 
 				mutex_exit(&areq->an_lock);
-				mutex_exit(&gswq->gs_lock);
+				mutex_exit(&areq->an_swq->sq_lock);
 				mutex_exit(&rt->rt_lock);
 
 				/* Remove areq from hash table and free it. */
@@ -1625,7 +1818,7 @@ crypto_cancel_req(crypto_req_id_t id)
 			}
 
 			mutex_exit(&areq->an_lock);
-			mutex_exit(&gswq->gs_lock);
+			mutex_exit(&areq->an_swq->sq_lock);
 			break;
 
 		case CRYPTO_HW_PROVIDER:
@@ -1715,7 +1908,7 @@ kcf_misc_kstat_update(kstat_t *ksp, int rw)
 	ks_data->ks_idle_thrs.value.ui32 = kcfpool->kp_idlethreads;
 	ks_data->ks_minthrs.value.ui32 = kcf_minthreads;
 	ks_data->ks_maxthrs.value.ui32 = kcf_maxthreads;
-	ks_data->ks_swq_njobs.value.ui32 = gswq->gs_njobs;
+	ks_data->ks_swq_njobs.value.ui32 = kcf_swq_njobs();
 	ks_data->ks_swq_maxjobs.value.ui32 = gswq->gs_maxjobs;
 	ks_data->ks_taskq_threads.value.ui32 = crypto_taskq_threads;
 	ks_data->ks_taskq_minalloc.value.ui32 = crypto_taskq_minalloc;
@@ -1742,10 +1935,13 @@ kcf_alloc_req(crypto_call_req_t *crq)
 		return (NULL);
 
 	/* Copy the whole crypto_call_req struct, as it isn't persistent */
-	if (crq != NULL)
+	if (crq != NULL) {
 		kcr->kr_callreq = *crq;
-	else
+		kcr->kr_callreq.cr_flag &= ~CRYPTO_BATCH;
+		kcr->kr_callreq.cr_batch = NULL;
+	} else {
 		bzero(&(kcr->kr_callreq), sizeof (crypto_call_req_t));
+	}
 	kcr->kr_areq = NULL;
 	kcr->kr_saveoffset = 0;
 	kcr->kr_savelen = 0;
@@ -1372,6 +1372,11 @@ aes_common_init_ctx(aes_ctx_t *aes_ctx, crypto_spi_ctx_template_t *template,
 		rv = gcm_init_ctx((gcm_ctx_t *)aes_ctx, mechanism->cm_param,
 		    AES_BLOCK_LEN, aes_encrypt_block, aes_copy_block,
 		    aes_xor_block);
+#ifdef __amd64
+		if (rv == CRYPTO_SUCCESS &&
+		    aes_gcm_blocks_capable(aes_ctx->ac_keysched))
+			gcm_set_blocks((gcm_ctx_t *)aes_ctx, aes_gcm_blocks);
+#endif
 		break;
 	case AES_GMAC_MECH_INFO_TYPE:
 		if (mechanism->cm_param == NULL ||
@@ -212,6 +212,25 @@ pg_cmt_can_migrate(cpu_t *from, cpu_t *to)
 	return (0);
 }
 
+/*
+ * Return the sharing relationship of the smallest CMT PG in "from"'s lineage
+ * that also contains "to", or PGHW_START if there is none (e.g. they're on
+ * different chips).  The dispatcher uses this as a measure of how costly it
+ * would be to migrate a thread from one to the other.
+ */
+pghw_type_t
+pg_cmt_share_hw(cpu_t *from, cpu_t *to)
+{
+	pg_cmt_t	*pg;
+
+	for (pg = (pg_cmt_t *)from->cpu_pg->cmt_lineage; pg != NULL;
+	    pg = pg->cmt_parent) {
+		if (bitset_in_set(&pg->cmt_cpus_actv_set, to->cpu_seqid))
+			return (((pghw_t *)pg)->pghw_hw);
+	}
+	return (PGHW_START);
+}
+
 /*
  * CMT class specific PG allocation
  */
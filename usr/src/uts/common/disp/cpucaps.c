@@ -83,6 +83,16 @@
  * New times means time since it was last accounted for. On-CPU times greater
  * than 1 tick are truncated to 1 tick.
  *
+ * On-CPU time is charged against a budget that the CPU doing the charging
+ * holds for the cap.  The budget is prepaid: when it runs out, the CPU takes
+ * a new slice of the cap's headroom (the cap value less the current usage),
+ * at most a tick's worth, and adds all of it to the cap usage at once.  So
+ * the usage is only updated, and cap_usagelock only taken, once a slice, not
+ * on every charge, however many threads of the project run on the CPU.  A
+ * project or zone is over its cap when there is no headroom left and the
+ * CPU's own budget is spent.  Budgets left on CPUs that stop running the
+ * project are simply usage counted a little early.
+ *
  * Project CPU usage is aggregated from all threads within the project.
  * Zone CPU usage is the sum of usages for all projects within the zone. Zone
  * CPU usage is calculated on every clock tick by walking list of projects and
@@ -94,7 +104,9 @@
  * CPU usage is decayed by the caps_update() routine which is called once per
  * every clock tick. It walks lists of project caps and decays their usages by
  * one per cent. If CPU usage drops below cap levels, threads on the wait queue
- * are made runnable again, one thread per clock tick.
+ * are made runnable again: one for each slice of headroom, up to
+ * cpucaps_wakeup_max threads per clock tick, so that a cap with many waiting
+ * threads and room for them does not let them out one tick at a time.
  *
  * Interfaces
  * ==========
@@ -191,6 +203,18 @@ static hrtime_t cap_tick_cost;
  */
 #define	CAP_DECAY_FACTOR 100
 
+/*
+ * Most threads made runnable from a cap's wait queue per clock tick.
+ */
+uint_t cpucaps_wakeup_max = 16;
+
+/*
+ * The budget taken by a CPU at a time: a tick's worth of on-CPU time, or the
+ * usage the cap allows per tick if that is less.
+ */
+#define	CAP_SLICE(cap)	\
+	MAX(MIN(cap_tick_cost, (cap)->cap_value / CAP_DECAY_FACTOR), 1)
+
 /*
  * Scale the value and round it to the closest integer value
  */
@@ -208,6 +232,7 @@ struct cap_kstat {
 	kstat_named_t	cap_below;
 	kstat_named_t	cap_above;
 	kstat_named_t	cap_maxusage;
+	kstat_named_t	cap_refill;
 	kstat_named_t	cap_zonename;
 } cap_kstat = {
 	{ "value",	KSTAT_DATA_UINT64 },
@@ -216,6 +241,7 @@ struct cap_kstat {
 	{ "below_sec",	KSTAT_DATA_UINT64 },
 	{ "above_sec",	KSTAT_DATA_UINT64 },
 	{ "maxusage",	KSTAT_DATA_UINT64 },
+	{ "refill",	KSTAT_DATA_UINT64 },
 	{ "zonename",	KSTAT_DATA_STRING },
 };
 
@@ -265,6 +291,8 @@ cap_alloc(void)
 
 	DISP_LOCK_INIT(&cap->cap_usagelock);
 	waitq_init(&cap->cap_waitq);
+	cap->cap_pcpu = kmem_zalloc(max_ncpus * sizeof (cpucap_pcpu_t),
+	    KM_SLEEP);
 
 	return (cap);
 }
@@ -288,6 +316,7 @@ cap_free(cpucap_t *cap)
 	waitq_fini(&cap->cap_waitq);
 	DISP_LOCK_DESTROY(&cap->cap_usagelock);
 
+	kmem_free(cap->cap_pcpu, max_ncpus * sizeof (cpucap_pcpu_t));
 	kmem_free(cap, sizeof (cpucap_t));
 }
 
@@ -310,7 +339,9 @@ cap_enable(list_t *l, cpucap_t *cap, hrtime_t value)
 	list_insert_tail(l, cap);
 	cap->cap_below = cap->cap_above = 0;
 	cap->cap_maxusage = 0;
+	cap->cap_refill = 0;
 	cap->cap_usage = 0;
+	bzero(cap->cap_pcpu, max_ncpus * sizeof (cpucap_pcpu_t));
 	cap->cap_value = value;
 	waitq_unblock(&cap->cap_waitq);
 	if (CPUCAPS_OFF()) {
@@ -483,7 +514,8 @@ cap_walk(list_t *l, void (*cb)(cpucap_t *, int64_t))
 }
 
 /*
- * If cap limit is not reached, make one thread from wait queue runnable.
+ * If cap limit is not reached, make threads from wait queue runnable, one for
+ * each slice of headroom the cap has, and at least one.
  * The waitq_isempty check is performed without the waitq lock. If a new thread
  * is placed on the waitq right after the check, it will be picked up during the
  * next invocation of cap_poke_waitq().
@@ -498,10 +530,13 @@ cap_poke_waitq(cpucap_t *cap, int64_t gen)
 		cap->cap_above++;
 	} else {
 		waitq_t *wq = &cap->cap_waitq;
+		hrtime_t n;
 
 		cap->cap_below++;
 
-		if (!waitq_isempty(wq))
+		n = (cap->cap_value - cap->cap_usage) / CAP_SLICE(cap);
+		n = MAX(MIN(n, cpucaps_wakeup_max), 1);
+		while (n-- > 0 && !waitq_isempty(wq))
 			waitq_runone(wq);
 	}
 }
@@ -985,12 +1020,32 @@ caps_charge_adjust(kthread_id_t t, caps_sc_t *csc)
 	/* Add usage_delta to the project usage value. */
 	if (usage_delta > 0) {
 		cpucap_t *cap = kpj->kpj_cpucap;
+		cpucap_pcpu_t *cpc = &cap->cap_pcpu[CPU->cpu_seqid];
+		hrtime_t slice;
 
 		DTRACE_PROBE2(cpucaps__project__charge,
 		    kthread_id_t, t, hrtime_t, usage_delta);
 
+		/* Charge it to this CPU's budget if that covers it. */
+		if (cpc->cpc_budget >= usage_delta) {
+			cpc->cpc_budget -= usage_delta;
+			return;
+		}
+
+		/*
+		 * Otherwise use up the budget, charge the rest, and take a
+		 * new slice from whatever headroom the cap has left.
+		 */
 		disp_lock_enter_high(&cap->cap_usagelock);
-		cap->cap_usage += usage_delta;
+		cap->cap_usage += usage_delta - cpc->cpc_budget;
+		cpc->cpc_budget = 0;
+		if (cap->cap_usage >= 0 && cap->cap_usage < cap->cap_value) {
+			slice = MIN(CAP_SLICE(cap),
+			    cap->cap_value - cap->cap_usage);
+			cap->cap_usage += slice;
+			cpc->cpc_budget = slice;
+			cap->cap_refill++;
+		}
 
 		/* Check for overflows */
 		if (cap->cap_usage < 0)
@@ -1045,7 +1100,12 @@ cpucaps_charge(kthread_id_t t, caps_sc_t *csc, cpucaps_charge_t charge_type)
 
 	project_cap = kpj->kpj_cpucap;
 
-	if (project_cap->cap_usage >= project_cap->cap_value) {
+	/*
+	 * The project is over its cap once the headroom is gone and this
+	 * CPU has spent its budget.
+	 */
+	if (project_cap->cap_usage >= project_cap->cap_value &&
+	    project_cap->cap_pcpu[CPU->cpu_seqid].cpc_budget == 0) {
 		t->t_schedflag |= TS_PROJWAITQ;
 		rc = B_TRUE;
 	} else if (t->t_schedflag & TS_PROJWAITQ) {
@@ -1140,6 +1200,7 @@ cap_kstat_update(kstat_t *ksp, int rw)
 	capsp->cap_nwait.value.ui64 = cap->cap_waitq.wq_count;
 	capsp->cap_below.value.ui64 = ROUND_SCALE(cap->cap_below, tick_sec);
 	capsp->cap_above.value.ui64 = ROUND_SCALE(cap->cap_above, tick_sec);
+	capsp->cap_refill.value.ui64 = cap->cap_refill;
 	kstat_named_setstr(&capsp->cap_zonename, zonename);
 
 	return (0);
@@ -53,6 +53,7 @@
 #include <sys/bitset.h>
 #include <sys/schedctl.h>
 #include <sys/atomic.h>
+#include <sys/kstat.h>
 #include <sys/dtrace.h>
 #include <sys/sdt.h>
 #include <sys/archsystm.h>
@@ -137,6 +138,51 @@ int	rechoose_interval = RECHOOSE_INTERVAL;
 hrtime_t nosteal_nsec = NOSTEAL_UNINITIALIZED;
 extern void cmp_set_nosteal_interval(void);
 
+/*
+ * Stealing is scaled by distance in the CMT PG hierarchy.  nosteal_scale is
+ * indexed by the hardware sharing relationship of the smallest CMT PG that
+ * contains both the idle CPU and the CPU whose queue it's looking at
+ * (PGHW_START if they share none, e.g. they're on different sockets); a
+ * thread must sit on a run queue for nosteal_nsec times the scale for that
+ * level before it may be stolen.  A scale of zero means steal immediately.
+ * CPUs sharing a cache never wait (see pg_cmt_can_migrate()).
+ *
+ * When disp_cmt_steal is set, an idle CPU also looks for work among the
+ * CPUs of its CMT lineage, nearest PG first, before widening the search to
+ * the rest of its lgroup and beyond.
+ */
+uint_t	nosteal_scale[PGHW_NUM_COMPONENTS] = {
+	4,	/* PGHW_START: no shared PG */
+	0,	/* PGHW_IPIPE */
+	0,	/* PGHW_CACHE */
+	1,	/* PGHW_FPU */
+	1,	/* PGHW_MPIPE */
+	1,	/* PGHW_CHIP */
+	2,	/* PGHW_MEMORY */
+	1,	/* PGHW_POW_ACTIVE */
+	1,	/* PGHW_POW_IDLE */
+};
+int	disp_cmt_steal = 1;
+
+/*
+ * Counts of threads stolen at each level of the CMT PG hierarchy, and of
+ * steals deferred by the nosteal interval.
+ */
+#define	DISP_STEAL_DEFERRED	PGHW_NUM_COMPONENTS
+static kstat_named_t disp_steal_stats[PGHW_NUM_COMPONENTS + 1];
+static char *disp_steal_names[PGHW_NUM_COMPONENTS + 1] = {
+	"steal_remote",
+	"steal_ipipe",
+	"steal_cache",
+	"steal_fpu",
+	"steal_mpipe",
+	"steal_chip",
+	"steal_memory",
+	"steal_pow_active",
+	"steal_pow_idle",
+	"steal_deferred"
+};
+
 id_t	defaultcid;	/* system "default" class; see dispadmin(1M) */
 
 disp_lock_t	transition_lock;	/* lock on transitioning threads */
@@ -208,6 +254,8 @@ dispinit(void)
 	id_t	cid;
 	pri_t	maxglobpri;
 	pri_t	cl_maxglobpri;
+	kstat_t	*ksp;
+	int	i;
 
 	maxglobpri = -1;
 
@@ -267,6 +315,17 @@ dispinit(void)
 	if (nosteal_nsec == NOSTEAL_UNINITIALIZED)
 		cmp_set_nosteal_interval();
 
+	for (i = 0; i <= DISP_STEAL_DEFERRED; i++) {
+		kstat_named_init(&disp_steal_stats[i], disp_steal_names[i],
+		    KSTAT_DATA_UINT64);
+	}
+	ksp = kstat_create("unix", 0, "disp_steal", "misc", KSTAT_TYPE_NAMED,
+	    DISP_STEAL_DEFERRED + 1, KSTAT_FLAG_VIRTUAL);
+	if (ksp != NULL) {
+		ksp->ks_data = disp_steal_stats;
+		kstat_install(ksp);
+	}
+
 	/*
 	 * Get the default class ID; this may be later modified via
 	 * dispadmin(1M).  This will load the class (normally TS) and that will
@@ -1889,6 +1948,77 @@ disp_ratify(kthread_t *tp, disp_t *kpq)
 	return (tp);
 }
 
+/*
+ * Return values for disp_getwork_cpu()
+ */
+#define	GETWORK_NEXT	0	/* keep looking at this level of locality */
+#define	GETWORK_LEVEL	1	/* move on to the next level of locality */
+#define	GETWORK_LOCAL	2	/* work turned up on the local queue */
+
+/*
+ * Consider stealing from the run queue of another CPU, ocp, on behalf of the
+ * idle CPU cp.  If ocp has a stealable thread of higher priority than the
+ * best found so far, ocp becomes the new target.
+ */
+static int
+disp_getwork_cpu(cpu_t *cp, cpu_t *ocp, pri_t *maxpri, cpu_t **tcp,
+    kthread_t **retval)
+{
+	hrtime_t	stealtime;
+	pri_t		pri;
+
+	/*
+	 * End our stroll around this level if:
+	 *
+	 * - Something became runnable on the local queue...which also ends
+	 *   our stroll around the partition.
+	 *
+	 * - We happen across another idle CPU.  Since it is patrolling the
+	 *   next portion of this level (assuming it's not halted, or busy
+	 *   servicing an interrupt), move to the next higher level of
+	 *   locality.
+	 */
+	if (cp->cpu_disp->disp_nrunnable != 0)
+		return (GETWORK_LOCAL);
+	if (ocp->cpu_dispatch_pri == -1) {
+		if (ocp->cpu_disp_flags & CPU_DISP_HALTED ||
+		    ocp->cpu_intr_actv != 0)
+			return (GETWORK_NEXT);
+		else
+			return (GETWORK_LEVEL);
+	}
+
+	/*
+	 * If there's only one thread and the CPU is in the middle of a context
+	 * switch, or it's currently running the idle thread, don't steal it.
+	 */
+	if ((ocp->cpu_disp_flags & CPU_DISP_DONTSTEAL) &&
+	    ocp->cpu_disp->disp_nrunnable == 1)
+		return (GETWORK_NEXT);
+
+	pri = ocp->cpu_disp->disp_max_unbound_pri;
+	if (pri > *maxpri) {
+		/*
+		 * Don't steal threads that we attempted to steal recently
+		 * until they're ready to be stolen again.
+		 */
+		stealtime = ocp->cpu_disp->disp_steal;
+		if (stealtime == 0 || stealtime - gethrtime() <= 0) {
+			*maxpri = pri;
+			*tcp = ocp;
+		} else {
+			/*
+			 * Don't update tcp, just set the retval to
+			 * T_DONTSTEAL, so that if no acceptable CPUs are found
+			 * the return value will be T_DONTSTEAL rather then
+			 * NULL.
+			 */
+			*retval = T_DONTSTEAL;
+		}
+	}
+	return (GETWORK_NEXT);
+}
+
 /*
  * See if there is any work on the dispatcher queue for other CPUs.
  * If there is, dequeue the best thread and return.
@@ -1904,8 +2034,10 @@ disp_getwork(cpu_t *cp)
 	pri_t		maxpri;
 	disp_t		*kpq;		/* kp queue for this partition */
 	lpl_t		*lpl, *lpl_leaf;
+	pg_cmt_t	*pg;
+	group_iter_t	iter;
 	int		leafidx, startidx;
-	hrtime_t	stealtime;
+	int		ret;
 	lgrp_id_t	local_id;
 
 	maxpri = -1;
@@ -1923,6 +2055,34 @@ disp_getwork(cpu_t *cp)
 
 	kpreempt_disable();		/* protect the cpu_active list */
 
+	/*
+	 * First look among the CPUs that share hardware with this one,
+	 * walking the CMT lineage from the nearest PG to the farthest.  The
+	 * first work found is then on the CPU that is cheapest to migrate
+	 * from.
+	 */
+	if (disp_cmt_steal)
+		pg = (pg_cmt_t *)cp->cpu_pg->cmt_lineage;
+	else
+		pg = NULL;
+	for (; pg != NULL && tcp == NULL; pg = pg->cmt_parent) {
+		group_iter_init(&iter);
+		while ((ocp = group_iterate(&pg->cmt_cpus_actv, &iter)) !=
+		    NULL) {
+			if (ocp == cp || ocp->cpu_part != cp->cpu_part ||
+			    !CPU_ACTIVE(ocp))
+				continue;
+			ret = disp_getwork_cpu(cp, ocp, &maxpri, &tcp,
+			    &retval);
+			if (ret == GETWORK_LOCAL) {
+				kpreempt_enable();
+				return (NULL);
+			}
+			if (ret == GETWORK_LEVEL)
+				break;
+		}
+	}
+
 	/*
 	 * Try to find something to do on another CPU's run queue.
 	 * Loop through all other CPUs looking for the one with the highest
@@ -1933,7 +2093,8 @@ disp_getwork(cpu_t *cp)
 	 * work found is also the closest, and will suffer the least
 	 * from being migrated.
 	 */
-	lpl = lpl_leaf = cp->cpu_lpl;
+	lpl = (tcp == NULL) ? cp->cpu_lpl : NULL;
+	lpl_leaf = cp->cpu_lpl;
 	local_id = lpl_leaf->lpl_lgrpid;
 	leafidx = startidx = 0;
 
@@ -1941,7 +2102,7 @@ disp_getwork(cpu_t *cp)
 	 * This loop traverses the lpl hierarchy. Higher level lpls represent
 	 * broader levels of locality
 	 */
-	do {
+	while (lpl != NULL) {
 		/* This loop iterates over the lpl's leaves */
 		do {
 			if (lpl_leaf != cp->cpu_lpl)
@@ -1952,71 +2113,16 @@ disp_getwork(cpu_t *cp)
 			/* This loop iterates over the CPUs in the leaf */
 			ocp_start = ocp;
 			do {
-				pri_t pri;
-
 				ASSERT(CPU_ACTIVE(ocp));
 
-				/*
-				 * End our stroll around this lpl if:
-				 *
-				 * - Something became runnable on the local
-				 *   queue...which also ends our stroll around
-				 *   the partition.
-				 *
-				 * - We happen across another idle CPU.
-				 *   Since it is patrolling the next portion
-				 *   of the lpl's list (assuming it's not
-				 *   halted, or busy servicing an interrupt),
-				 *   move to the next higher level of locality.
-				 */
-				if (cp->cpu_disp->disp_nrunnable != 0) {
+				ret = disp_getwork_cpu(cp, ocp, &maxpri, &tcp,
+				    &retval);
+				if (ret == GETWORK_LOCAL) {
 					kpreempt_enable();
 					return (NULL);
 				}
-				if (ocp->cpu_dispatch_pri == -1) {
-					if (ocp->cpu_disp_flags &
-					    CPU_DISP_HALTED ||
-					    ocp->cpu_intr_actv != 0)
-						continue;
-					else
-						goto next_level;
-				}
-
-				/*
-				 * If there's only one thread and the CPU
-				 * is in the middle of a context switch,
-				 * or it's currently running the idle thread,
-				 * don't steal it.
-				 */
-				if ((ocp->cpu_disp_flags &
-				    CPU_DISP_DONTSTEAL) &&
-				    ocp->cpu_disp->disp_nrunnable == 1)
-					continue;
-
-				pri = ocp->cpu_disp->disp_max_unbound_pri;
-				if (pri > maxpri) {
-					/*
-					 * Don't steal threads that we attempted
-					 * to steal recently until they're ready
-					 * to be stolen again.
-					 */
-					stealtime = ocp->cpu_disp->disp_steal;
-					if (stealtime == 0 ||
-					    stealtime - gethrtime() <= 0) {
-						maxpri = pri;
-						tcp = ocp;
-					} else {
-						/*
-						 * Don't update tcp, just set
-						 * the retval to T_DONTSTEAL, so
-						 * that if no acceptable CPUs
-						 * are found the return value
-						 * will be T_DONTSTEAL rather
-						 * then NULL.
-						 */
-						retval = T_DONTSTEAL;
-					}
-				}
+				if (ret == GETWORK_LEVEL)
+					goto next_level;
 			} while ((ocp = ocp->cpu_next_lpl) != ocp_start);
 
 			/*
@@ -2043,11 +2149,13 @@ next_level:
 		 * more often).
 		 * Begin at this level with the CPUs local leaf lpl.
 		 */
+		if (tcp != NULL)
+			break;
 		if ((lpl = lpl->lpl_parent) != NULL) {
 			leafidx = startidx = lpl->lpl_id2rset[local_id];
 			lpl_leaf = lpl->lpl_rset[leafidx];
 		}
-	} while (!tcp && lpl);
+	}
 
 	kpreempt_enable();
 
@@ -2187,6 +2295,7 @@ disp_getbest(disp_t *dp)
 	pri_t		pri;
 	cpu_t		*cp, *tcp;
 	boolean_t	allbound;
+	pghw_type_t	hw = PGHW_START;
 
 	disp_lock_enter(&dp->disp_lock);
 
@@ -2206,6 +2315,13 @@ disp_getbest(disp_t *dp)
 
 	dq = &dp->disp_q[pri];
 
+	/*
+	 * The distance between the two CPUs in the CMT PG hierarchy governs
+	 * both how long threads are protected from stealing and which steal
+	 * statistic is bumped.
+	 */
+	if (tcp != NULL)
+		hw = pg_cmt_share_hw(cp, tcp);
 
 	/*
 	 * Assume that all threads are bound on this queue, and change it
@@ -2249,8 +2365,9 @@ disp_getbest(disp_t *dp)
 		 *   running before being placed on the run queue
 		 * - it should be the only thread on the run queue (to prevent
 		 *   extra scheduling latency for other threads)
-		 * - it should sit on the run queue for less than per-chip
-		 *   nosteal interval or global nosteal interval
+		 * - it should sit on the run queue for less than the nosteal
+		 *   interval, scaled by nosteal_scale for the level of the CMT
+		 *   PG hierarchy at which the two CPUs meet
 		 * - in case of CPUs with shared cache it should sit in a run
 		 *   queue of a CPU from a different chip
 		 *
@@ -2270,7 +2387,7 @@ disp_getbest(disp_t *dp)
 		if (pg_cmt_can_migrate(cp, tcp))
 			break;
 
-		nosteal = nosteal_nsec;
+		nosteal = nosteal_nsec * nosteal_scale[hw];
 		if (nosteal == 0)
 			break;
 
@@ -2324,7 +2441,11 @@ disp_getbest(disp_t *dp)
 	 */
 	if (tp == NULL) {
 		disp_lock_exit_nopreempt(&dp->disp_lock);
-		return (allbound ? NULL : T_DONTSTEAL);
+		if (allbound)
+			return (NULL);
+		atomic_inc_64(
+		    &disp_steal_stats[DISP_STEAL_DEFERRED].value.ui64);
+		return (T_DONTSTEAL);
 	}
 
 	/*
@@ -2388,6 +2509,8 @@ disp_getbest(disp_t *dp)
 	ASSERT(pri == DISP_PRIO(tp));
 
 	DTRACE_PROBE3(steal, kthread_t *, tp, cpu_t *, tcp, cpu_t *, cp);
+	if (tcp != NULL)
+		atomic_inc_64(&disp_steal_stats[hw].value.ui64);
 
 	thread_onproc(tp, cp);			/* set t_state to TS_ONPROC */
 
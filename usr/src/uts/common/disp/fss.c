@@ -81,7 +81,8 @@
  * The FSS priority calculation consists of several parts.
  *
  * 1) Once per second the fss_update function runs. The first thing it does is
- *    call fss_decay_usage. This function does three things.
+ *    call fss_decay_usage. This function does three things.  (fss_update
+ *    actually spreads its work over the second; see FSS_UPDATE_SLICES.)
  *
  * a) fss_decay_usage first decays the maxfsspri value for the pset.  This
  *    value is used in the per-process priority calculation described in step
@@ -215,7 +216,12 @@
  *    the handling for the quanta_up parameter within fss_newpri.
  *
  *    Also of interest, the fss_tick code increments the project's tick value
- *    using the fss_nice_tick array entry for the thread's nice value. The idea
+ *    using the fss_nice_tick array entry for the thread's nice value.  So
+ *    that the clock doesn't contend for the pset's dispatcher lock on every
+ *    CPU at every tick, the ticks are kept with the thread (fss_pticks and
+ *    fss_ptick_cnt) and charged to the project by fss_charge_proj whenever
+ *    the lock is taken anyway: at the end of a quantum, when the thread
+ *    stops being runnable, and at the latest by fss_update. The idea
  *    behind the fss_nice_tick array is that the cost of a tick is lower at
  *    positive nice values (so that it doesn't increase the project's usage
  *    as much as normal) with a 50% drop at the maximum level and a 50%
@@ -285,8 +291,14 @@ static struct modlinkage modlinkage = {
  * thread should be placed in.  Each list has a dummy "head" which is never
  * removed, so the list is never empty.  fss_update traverses these lists to
  * update the priorities of threads that have been waiting on the run queue.
+ *
+ * Rather than walking every list at once, which with many thousands of
+ * threads holds up the callout thread (and everything waiting on the list
+ * locks) for a noticeable time, fss_update runs FSS_UPDATE_SLICES times a
+ * second and walks FSS_LISTS / FSS_UPDATE_SLICES lists each time.
  */
-#define	FSS_LISTS		16 /* number of lists, must be power of 2 */
+#define	FSS_LISTS		256 /* must be power of 2 */
+#define	FSS_UPDATE_SLICES	16  /* must divide FSS_LISTS */
 #define	FSS_LIST_HASH(t)	(((uintptr_t)(t) >> 9) & (FSS_LISTS - 1))
 #define	FSS_LIST_NEXT(i)	(((i) + 1) & (FSS_LISTS - 1))
 
@@ -783,6 +795,21 @@ fss_remove_fssproj(fsspset_t *fsspset, fssproj_t *fssproj)
 	}
 }
 
+/*
+ * Charge the project for the ticks a thread has run since it was last
+ * charged.
+ */
+static void
+fss_charge_proj(fssproc_t *fssproc, fssproj_t *fssproj)
+{
+	ASSERT(DISP_LOCK_HELD(&FSSPROJ2FSSPSET(fssproj)->fssps_displock));
+
+	fssproj->fssp_ticks += fssproc->fss_pticks;
+	fssproj->fssp_tick_cnt += fssproc->fss_ptick_cnt;
+	fssproc->fss_pticks = 0;
+	fssproc->fss_ptick_cnt = 0;
+}
+
 static void
 fss_inactive(kthread_t *t)
 {
@@ -799,6 +826,7 @@ fss_inactive(kthread_t *t)
 	fsspset = FSSPROJ2FSSPSET(fssproj);
 	fsszone = fssproj->fssp_fsszone;
 	disp_lock_enter_high(&fsspset->fssps_displock);
+	fss_charge_proj(fssproc, fssproj);
 	ASSERT(fssproj->fssp_runnable > 0);
 	if (--fssproj->fssp_runnable == 0) {
 		fsszone->fssz_shares -= fssproj->fssp_shares;
@@ -955,6 +983,7 @@ fss_newpri(fssproc_t *fssproc, boolean_t quanta_up)
 
 	fsspset = FSSPROJ2FSSPSET(fssproj);
 	disp_lock_enter_high(&fsspset->fssps_displock);
+	fss_charge_proj(fssproc, fssproj);
 
 	ticks = fssproc->fss_ticks;
 	fssproc->fss_ticks = 0;
@@ -1291,56 +1320,67 @@ fss_change_priority(kthread_t *t, fssproc_t *fssproc)
 /*
  * Update priorities of all fair-sharing threads that are currently runnable
  * at a user mode priority based on the number of shares and current usage.
- * Called once per second via timeout which we reset here.
+ * Called FSS_UPDATE_SLICES times a second via timeout which we reset here.
  *
  * There are several lists of fair-sharing threads broken up by a hash on the
  * thread pointer.  Each list has its own lock.  This avoids blocking all
  * fss_enterclass, fss_fork, and fss_exitclass operations while fss_update runs.
- * fss_update traverses each list in turn.
+ * Each call to fss_update traverses the next FSS_LISTS / FSS_UPDATE_SLICES
+ * lists in turn, so that all of them have been seen once a second; project
+ * usages are decayed at the start of each such round.
  *
- * Each time we're run (once/second) we may start at the next list and iterate
- * through all of the lists. By starting with a different list, we mitigate any
- * effects we would see updating the fssps_maxfsspri value in fss_newpri.
+ * Each round we may start at the next list and iterate through all of the
+ * lists. By starting with a different list, we mitigate any effects we would
+ * see updating the fssps_maxfsspri value in fss_newpri.
  */
 static void
 fss_update(void *arg)
 {
-	int i;
-	int new_marker = -1;
 	static int fss_update_marker;
+	static int fss_update_new_marker = -1;
+	static int fss_update_slice;
+	int nlists = FSS_LISTS / FSS_UPDATE_SLICES;
+	int i;
 
-	/*
-	 * Decay and update usages for all projects.
-	 */
-	fss_decay_usage();
+	if (fss_update_slice == 0) {
+		/*
+		 * Decay and update usages for all projects.
+		 */
+		fss_decay_usage();
+		fss_update_new_marker = -1;
+	}
 
 	/*
-	 * Start with the fss_update_marker list, then do the rest.
+	 * Carry on from where the last slice of this round left off.
 	 */
-	i = fss_update_marker;
+	i = (fss_update_marker + fss_update_slice * nlists) & (FSS_LISTS - 1);
 
 	/*
-	 * Go around all threads, set new priorities and decay
+	 * Go around this slice's threads, set new priorities and decay
 	 * per-thread CPU usages.
 	 */
-	do {
+	while (nlists-- > 0) {
 		/*
 		 * If this is the first list after the current marker to have
 		 * threads with priority updates, advance the marker to this
-		 * list for the next time fss_update runs.
+		 * list for the next round.
 		 */
-		if (fss_update_list(i) &&
-		    new_marker == -1 && i != fss_update_marker)
-			new_marker = i;
-	} while ((i = FSS_LIST_NEXT(i)) != fss_update_marker);
+		if (fss_update_list(i) && fss_update_new_marker == -1 &&
+		    i != fss_update_marker)
+			fss_update_new_marker = i;
+		i = FSS_LIST_NEXT(i);
+	}
 
 	/*
-	 * Advance marker for the next fss_update call
+	 * Advance marker at the end of the round.
 	 */
-	if (new_marker != -1)
-		fss_update_marker = new_marker;
+	if (++fss_update_slice == FSS_UPDATE_SLICES) {
+		fss_update_slice = 0;
+		if (fss_update_new_marker != -1)
+			fss_update_marker = fss_update_new_marker;
+	}
 
-	(void) timeout(fss_update, arg, hz);
+	(void) timeout(fss_update, arg, MAX(hz / FSS_UPDATE_SLICES, 1));
 }
 
 /*
@@ -1354,6 +1394,7 @@ fss_update_list(int i)
 {
 	fssproc_t *fssproc;
 	fssproj_t *fssproj;
+	fsspset_t *fsspset;
 	fsspri_t fsspri;
 	pri_t fss_umdpri;
 	kthread_t *t;
@@ -1373,13 +1414,26 @@ fss_update_list(int i)
 		 */
 		if (t->t_cid != fss_cid)
 			goto next;
-		if ((fssproc->fss_flags & FSSKPRI) != 0)
-			goto next;
 
 		fssproj = FSSPROC2FSSPROJ(fssproc);
 		if (fssproj == NULL)
 			goto next;
 
+		/*
+		 * Threads running at a kernel priority, or for longer than
+		 * a second without their quantum expiring, haven't been
+		 * charged for their ticks yet.
+		 */
+		if (fssproc->fss_ptick_cnt != 0) {
+			fsspset = FSSPROJ2FSSPSET(fssproj);
+			disp_lock_enter_high(&fsspset->fssps_displock);
+			fss_charge_proj(fssproc, fssproj);
+			disp_lock_exit_high(&fsspset->fssps_displock);
+		}
+
+		if ((fssproc->fss_flags & FSSKPRI) != 0)
+			goto next;
+
 		if (fssproj->fssp_shares != 0) {
 			/*
 			 * Decay fsspri value.
@@ -1757,7 +1811,8 @@ fss_enterclass(kthread_t *t, id_t cid, void *parmsp, cred_t *reqpcredp,
 	 * this will already be done).
 	 */
 	if (fssexists == 0 && atomic_cas_32(&fssexists, 0, 1) == 0)
-		(void) timeout(fss_update, NULL, hz);
+		(void) timeout(fss_update, NULL,
+		    MAX(hz / FSS_UPDATE_SLICES, 1));
 
 	return (0);
 }
@@ -2093,6 +2148,7 @@ fss_exit(kthread_t *t)
 
 	thread_lock(t);
 	disp_lock_enter_high(&fsspset->fssps_displock);
+	fss_charge_proj(fssproc, fssproj);
 	if (t->t_state == TS_ONPROC || t->t_state == TS_RUN) {
 		if (--fssproj->fssp_runnable == 0) {
 			fsszone->fssz_shares -= fssproj->fssp_shares;
@@ -2489,12 +2545,9 @@ fss_tick(kthread_t *t)
 	fssproc = FSSPROC(t);
 	fssproj = FSSPROC2FSSPROJ(fssproc);
 	if (fssproj != NULL) {
-		fsspset_t *fsspset = FSSPROJ2FSSPSET(fssproj);
-		disp_lock_enter_high(&fsspset->fssps_displock);
-		fssproj->fssp_ticks += fss_nice_tick[fssproc->fss_nice];
-		fssproj->fssp_tick_cnt++;
+		fssproc->fss_pticks += fss_nice_tick[fssproc->fss_nice];
+		fssproc->fss_ptick_cnt++;
 		fssproc->fss_ticks++;
-		disp_lock_exit_high(&fsspset->fssps_displock);
 	}
 
 	/*
@@ -5719,6 +5719,24 @@ dtrace_dif_emulate(dtrace_difo_t *difo, dtrace_mstate_t *mstate,
 	 */
 	mstate->dtms_difo = difo;
 
+	if (difo->dtdo_fast != DTRACE_DIFO_FAST_NONE &&
+	    !(*flags & CPU_DTRACE_FAULT)) {
+		if (difo->dtdo_fast == DTRACE_DIFO_FAST_CONST)
+			return (difo->dtdo_fastval);
+
+		ASSERT(difo->dtdo_fast == DTRACE_DIFO_FAST_VAR);
+		rval = dtrace_dif_variable(mstate, state,
+		    difo->dtdo_fastvar, difo->dtdo_fastval);
+
+		if (!(*flags & CPU_DTRACE_FAULT))
+			return (rval);
+
+		mstate->dtms_fltoffs = difo->dtdo_fastpc * sizeof (dif_instr_t);
+		mstate->dtms_present |= DTRACE_MSTATE_FLTOFFS;
+
+		return (0);
+	}
+
 	regs[DIF_REG_R0] = 0; 		/* %r0 is fixed at zero */
 
 	while (pc < textlen && !(*flags & CPU_DTRACE_FAULT)) {
@@ -10019,6 +10037,100 @@ dtrace_difo_chunksize(dtrace_difo_t *dp, dtrace_vstate_t *vstate)
 	}
 }
 
+/*
+ * Determine whether a (validated) DIF object is one that dtrace_dif_emulate()
+ * can evaluate without interpreting it:  one that returns %r0, a constant
+ * from its integer or string table, or a built-in variable (indexed by a
+ * constant, for an array such as args[]).
+ */
+static void
+dtrace_difo_fastpath(dtrace_difo_t *dp)
+{
+	dif_instr_t *text = dp->dtdo_buf, last;
+	uint_t len = dp->dtdo_len, op, rd, id;
+
+	dp->dtdo_fast = DTRACE_DIFO_FAST_NONE;
+
+	if (len == 0 || len > 3)
+		return;
+
+	last = text[len - 1];
+
+	if (DIF_INSTR_OP(last) != DIF_OP_RET)
+		return;
+
+	rd = DIF_INSTR_RD(last);
+
+	if (len == 1) {
+		if (rd == DIF_REG_R0) {
+			dp->dtdo_fast = DTRACE_DIFO_FAST_CONST;
+			dp->dtdo_fastval = 0;
+		}
+		return;
+	}
+
+	if (DIF_INSTR_RD(text[len - 2]) != rd || rd == DIF_REG_R0)
+		return;
+
+	op = DIF_INSTR_OP(text[len - 2]);
+
+	if (len == 2) {
+		switch (op) {
+		case DIF_OP_SETX:
+			dp->dtdo_fastval =
+			    dp->dtdo_inttab[DIF_INSTR_INTEGER(text[0])];
+			dp->dtdo_fast = DTRACE_DIFO_FAST_CONST;
+			break;
+
+		case DIF_OP_SETS:
+			dp->dtdo_fastval = (uint64_t)(uintptr_t)
+			    (dp->dtdo_strtab + DIF_INSTR_STRING(text[0]));
+			dp->dtdo_fast = DTRACE_DIFO_FAST_CONST;
+			break;
+
+		case DIF_OP_LDGS:
+			id = DIF_INSTR_VAR(text[0]);
+
+			if (id >= DIF_VAR_OTHER_UBASE)
+				break;
+
+			dp->dtdo_fastvar = id;
+			dp->dtdo_fastval = 0;
+			dp->dtdo_fastpc = 0;
+			dp->dtdo_fast = DTRACE_DIFO_FAST_VAR;
+			break;
+
+		case DIF_OP_LDGA:
+			if (DIF_INSTR_R2(text[0]) != DIF_REG_R0)
+				break;
+
+			dp->dtdo_fastvar = DIF_INSTR_R1(text[0]);
+			dp->dtdo_fastval = 0;
+			dp->dtdo_fastpc = 0;
+			dp->dtdo_fast = DTRACE_DIFO_FAST_VAR;
+			break;
+
+		default:
+			break;
+		}
+		return;
+	}
+
+	/*
+	 * The only three-instruction form is a constant index into a
+	 * built-in array:  "setx idx, %rN; ldga var, %rN, %rd; ret %rd".
+	 */
+	if (op != DIF_OP_LDGA || DIF_INSTR_OP(text[0]) != DIF_OP_SETX ||
+	    DIF_INSTR_RD(text[0]) != DIF_INSTR_R2(text[1]) ||
+	    DIF_INSTR_RD(text[0]) == DIF_REG_R0)
+		return;
+
+	dp->dtdo_fastvar = DIF_INSTR_R1(text[1]);
+	dp->dtdo_fastval = dp->dtdo_inttab[DIF_INSTR_INTEGER(text[0])];
+	dp->dtdo_fastpc = 1;
+	dp->dtdo_fast = DTRACE_DIFO_FAST_VAR;
+}
+
 static void
 dtrace_difo_init(dtrace_difo_t *dp, dtrace_vstate_t *vstate)
 {
@@ -10129,6 +10241,7 @@ dtrace_difo_init(dtrace_difo_t *dp, dtrace_vstate_t *vstate)
 	}
 
 	dtrace_difo_chunksize(dp, vstate);
+	dtrace_difo_fastpath(dp);
 	dtrace_difo_hold(dp);
 }
 
@@ -40,6 +40,11 @@
 #include <sys/dtrace.h>
 #include <sys/cyclic.h>
 #include <sys/atomic.h>
+#include <sys/kstat.h>
+#include <sys/sysmacros.h>
+#include <sys/proc.h>
+#include <sys/dtrace_impl.h>
+#include <sys/profile_sample.h>
 
 static dev_info_t *profile_devi;
 static dtrace_provider_id_t profile_id;
@@ -432,6 +437,388 @@ profile_mode(void *arg, dtrace_id_t id, void *parg)
 	return (mode);
 }
 
+/*
+ * The continuous sampler.  Unlike the profile probes, this needs no DTrace
+ * consumer:  if the "profile-sample-hz" property is set, an omnipresent
+ * cyclic samples the kernel and user stacks of each CPU at that rate from
+ * the moment the driver attaches.  Each CPU counts the distinct stacks that
+ * it sees in a table of its own, so that sampling takes no locks and shares
+ * no cache lines.  A table is a power-of-two array of buckets, each holding
+ * a stack's hash and the offset of its record, which is allocated from the
+ * remainder of the table and is already in the profile_sample_t form in
+ * which it is exported.  When either is exhausted, samples of new stacks
+ * are counted as drops until the next read.
+ *
+ * Every CPU has two tables, of which the cyclic fills only the active one.
+ * A read of the profile:0:samples kstat switches the tables of all CPUs,
+ * waits (with dtrace_sync()) for any sample in progress in the old ones to
+ * complete, and then copies out the old tables and empties them.  A reader
+ * therefore sees the stacks sampled since the last read, and the cost of
+ * reading falls on the reader rather than on the sampled CPUs.
+ */
+typedef struct profile_sbucket {
+	uint32_t	psbk_hash;		/* hash of stack */
+	uint32_t	psbk_offs;		/* offset of record, plus one */
+} profile_sbucket_t;
+
+typedef struct profile_stable {
+	profile_sbucket_t *pst_buckets;		/* hash buckets */
+	caddr_t		pst_data;		/* records */
+	size_t		pst_used;		/* bytes of records in use */
+	uint64_t	pst_drops;		/* samples dropped */
+} profile_stable_t;
+
+typedef struct profile_scpu {
+	profile_stable_t psc_table[2];		/* tables */
+	volatile uint_t	psc_active;		/* table being filled */
+} profile_scpu_t;
+
+int		profile_sample_hz = 0;			/* 0 => disabled */
+uint_t		profile_sample_nbuckets = 1024;		/* per table */
+size_t		profile_sample_size = 64 * 1024;	/* per table */
+
+static hrtime_t profile_sample_interval;
+static cyclic_id_t profile_sample_cyclic = CYCLIC_NONE;
+static kstat_t *profile_sample_ksp;
+static kmutex_t profile_sample_lock;
+static profile_scpu_t **profile_sample_cpus;		/* NCPU entries */
+
+static uint32_t
+profile_sample_hash(const uint64_t *pcs, int depth, uint32_t pid)
+{
+	uint64_t hash = pid;
+	int i;
+
+	for (i = 0; i < depth; i++) {
+		hash += pcs[i];
+		hash += (hash << 10);
+		hash ^= (hash >> 6);
+	}
+
+	hash += (hash << 3);
+	hash ^= (hash >> 11);
+	hash += (hash << 15);
+
+	return ((uint32_t)(hash ^ (hash >> 32)));
+}
+
+static void
+profile_sample_record(profile_stable_t *pst, const uint64_t *pcs,
+    int kdepth, int udepth, uint32_t pid)
+{
+	int i, depth = kdepth + udepth;
+	uint32_t hash = profile_sample_hash(pcs, depth, pid);
+	uint_t mask = profile_sample_nbuckets - 1, ndx, probes;
+	size_t size = PROFILE_SAMPLE_SIZE(depth);
+	profile_sbucket_t *bk;
+	profile_sample_t *ps;
+
+	for (ndx = hash & mask, probes = 0; probes <= mask;
+	    ndx = (ndx + 1) & mask, probes++) {
+		bk = &pst->pst_buckets[ndx];
+
+		if (bk->psbk_offs == 0)
+			break;
+
+		if (bk->psbk_hash != hash)
+			continue;
+
+		/* LINTED - alignment */
+		ps = (profile_sample_t *)(pst->pst_data + bk->psbk_offs - 1);
+
+		if (ps->ps_pid != pid || ps->ps_kdepth != kdepth ||
+		    ps->ps_udepth != udepth)
+			continue;
+
+		for (i = 0; i < depth; i++) {
+			if (ps->ps_pcs[i] != pcs[i])
+				break;
+		}
+
+		if (i == depth) {
+			ps->ps_count++;
+			return;
+		}
+	}
+
+	if (probes > mask || pst->pst_used + size > profile_sample_size) {
+		pst->pst_drops++;
+		return;
+	}
+
+	/* LINTED - alignment */
+	ps = (profile_sample_t *)(pst->pst_data + pst->pst_used);
+	ps->ps_count = 1;
+	ps->ps_pid = pid;
+	ps->ps_kdepth = (uint16_t)kdepth;
+	ps->ps_udepth = (uint16_t)udepth;
+
+	for (i = 0; i < depth; i++)
+		ps->ps_pcs[i] = pcs[i];
+
+	bk->psbk_hash = hash;
+	bk->psbk_offs = (uint32_t)(pst->pst_used + 1);
+	pst->pst_used += size;
+}
+
+static void
+profile_sample_fire(void *arg)
+{
+	profile_scpu_t *psc = arg;
+	uint64_t pcs[2 * PROFILE_SAMPLE_MAXDEPTH + 1];
+	pc_t kpcs[PROFILE_SAMPLE_MAXDEPTH];
+	volatile uint16_t *flags;
+	dtrace_icookie_t cookie;
+	int kdepth, udepth = 0, aframes, i;
+	uint32_t pid = 0;
+	uint16_t oflags;
+
+	/*
+	 * We disable interrupts so that the dtrace_sync() of a reader cannot
+	 * complete while we are still using the table that it switched out.
+	 */
+	cookie = dtrace_interrupt_disable();
+
+	/*
+	 * We are called directly from the cyclic subsystem, one frame closer
+	 * to the interrupt than profile_fire()'s call to dtrace_probe().
+	 */
+	aframes = (profile_aframes ? profile_aframes :
+	    PROF_ARTIFICIAL_FRAMES) - 1;
+
+	dtrace_getpcstack(kpcs, PROFILE_SAMPLE_MAXDEPTH, aframes, NULL);
+
+	for (kdepth = 0; kdepth < PROFILE_SAMPLE_MAXDEPTH &&
+	    kpcs[kdepth] != NULL; kdepth++)
+		pcs[kdepth] = kpcs[kdepth];
+
+	if (ttolwp(curthread) != NULL && !(curproc->p_flag & SSYS)) {
+		/*
+		 * dtrace_getupcstack() reads the user stack with faults
+		 * suppressed; it may be that we have interrupted code with
+		 * its own DTrace flags, so preserve them around it.  It
+		 * stores the pid in the first element.
+		 */
+		flags = &cpu_core[CPU->cpu_id].cpuc_dtrace_flags;
+		oflags = *flags;
+		*flags = CPU_DTRACE_NOFAULT;
+
+		dtrace_getupcstack(&pcs[kdepth], PROFILE_SAMPLE_MAXDEPTH + 1);
+
+		*flags = oflags;
+
+		pid = (uint32_t)pcs[kdepth];
+
+		for (i = 0; i < PROFILE_SAMPLE_MAXDEPTH &&
+		    pcs[kdepth + 1 + i] != NULL; i++)
+			pcs[kdepth + i] = pcs[kdepth + 1 + i];
+
+		if ((udepth = i) == 0)
+			pid = 0;
+	}
+
+	profile_sample_record(&psc->psc_table[psc->psc_active], pcs,
+	    kdepth, udepth, pid);
+
+	dtrace_interrupt_enable(cookie);
+}
+
+/*ARGSUSED*/
+static void
+profile_sample_online(void *arg, cpu_t *cpu, cyc_handler_t *hdlr,
+    cyc_time_t *when)
+{
+	profile_scpu_t *psc;
+	int i;
+
+	psc = kmem_zalloc(sizeof (profile_scpu_t), KM_SLEEP);
+
+	for (i = 0; i < 2; i++) {
+		psc->psc_table[i].pst_buckets = kmem_zalloc(
+		    profile_sample_nbuckets * sizeof (profile_sbucket_t),
+		    KM_SLEEP);
+		psc->psc_table[i].pst_data = kmem_alloc(profile_sample_size,
+		    KM_SLEEP);
+	}
+
+	mutex_enter(&profile_sample_lock);
+	ASSERT(profile_sample_cpus[cpu->cpu_id] == NULL);
+	profile_sample_cpus[cpu->cpu_id] = psc;
+	mutex_exit(&profile_sample_lock);
+
+	hdlr->cyh_func = profile_sample_fire;
+	hdlr->cyh_arg = psc;
+	hdlr->cyh_level = CY_HIGH_LEVEL;
+
+	when->cyt_interval = profile_sample_interval;
+	when->cyt_when = dtrace_gethrtime() + when->cyt_interval;
+}
+
+/*
+ * The samples of a CPU that goes offline are lost; the cyclic subsystem has
+ * removed its cyclic by the time that we are called.
+ */
+/*ARGSUSED*/
+static void
+profile_sample_offline(void *arg, cpu_t *cpu, void *oarg)
+{
+	profile_scpu_t *psc = oarg;
+	int i;
+
+	mutex_enter(&profile_sample_lock);
+	ASSERT(profile_sample_cpus[cpu->cpu_id] == psc);
+	profile_sample_cpus[cpu->cpu_id] = NULL;
+	mutex_exit(&profile_sample_lock);
+
+	for (i = 0; i < 2; i++) {
+		kmem_free(psc->psc_table[i].pst_buckets,
+		    profile_sample_nbuckets * sizeof (profile_sbucket_t));
+		kmem_free(psc->psc_table[i].pst_data, profile_sample_size);
+	}
+
+	kmem_free(psc, sizeof (profile_scpu_t));
+}
+
+static int
+profile_sample_kstat_update(kstat_t *ksp, int rw)
+{
+	profile_scpu_t *psc;
+	size_t size = sizeof (profile_sample_hdr_t);
+	int i;
+
+	ASSERT(MUTEX_HELD(&profile_sample_lock));
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (i = 0; i < NCPU; i++) {
+		if ((psc = profile_sample_cpus[i]) != NULL)
+			psc->psc_active ^= 1;
+	}
+
+	dtrace_sync();
+
+	for (i = 0; i < NCPU; i++) {
+		if ((psc = profile_sample_cpus[i]) != NULL)
+			size += psc->psc_table[psc->psc_active ^ 1].pst_used;
+	}
+
+	ksp->ks_data_size = size;
+	return (0);
+}
+
+static int
+profile_sample_kstat_snapshot(kstat_t *ksp, void *buf, int rw)
+{
+	profile_sample_hdr_t *psh = buf;
+	caddr_t data = (caddr_t)(psh + 1);
+	profile_scpu_t *psc;
+	profile_stable_t *pst;
+	int i;
+
+	ASSERT(MUTEX_HELD(&profile_sample_lock));
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	ksp->ks_snaptime = gethrtime();
+
+	psh->psh_interval = profile_sample_interval;
+	psh->psh_drops = 0;
+	psh->psh_size = 0;
+
+	for (i = 0; i < NCPU; i++) {
+		if ((psc = profile_sample_cpus[i]) == NULL)
+			continue;
+
+		pst = &psc->psc_table[psc->psc_active ^ 1];
+
+		if (sizeof (*psh) + psh->psh_size + pst->pst_used >
+		    ksp->ks_data_size)
+			break;
+
+		bcopy(pst->pst_data, data + psh->psh_size, pst->pst_used);
+		psh->psh_size += pst->pst_used;
+		psh->psh_drops += pst->pst_drops;
+
+		bzero(pst->pst_buckets,
+		    profile_sample_nbuckets * sizeof (profile_sbucket_t));
+		pst->pst_used = 0;
+		pst->pst_drops = 0;
+	}
+
+	return (0);
+}
+
+static void
+profile_sample_start(dev_info_t *devi)
+{
+	cyc_omni_handler_t omni;
+	kstat_t *ksp;
+
+	profile_sample_hz = ddi_getprop(DDI_DEV_T_ANY, devi,
+	    DDI_PROP_DONTPASS, "profile-sample-hz", profile_sample_hz);
+
+	if (profile_sample_hz <= 0)
+		return;
+
+	if (!ISP2(profile_sample_nbuckets) || profile_sample_nbuckets == 0 ||
+	    profile_sample_size < PROFILE_SAMPLE_SIZE(
+	    2 * PROFILE_SAMPLE_MAXDEPTH) || profile_sample_size > UINT32_MAX) {
+		cmn_err(CE_WARN, "profile: invalid sampler table size; "
+		    "sampling disabled");
+		return;
+	}
+
+	profile_sample_interval = MAX(NANOSEC / profile_sample_hz,
+	    profile_interval_min);
+
+	mutex_init(&profile_sample_lock, NULL, MUTEX_DEFAULT, NULL);
+	profile_sample_cpus = kmem_zalloc(NCPU * sizeof (profile_scpu_t *),
+	    KM_SLEEP);
+
+	mutex_enter(&cpu_lock);
+	omni.cyo_online = profile_sample_online;
+	omni.cyo_offline = profile_sample_offline;
+	omni.cyo_arg = NULL;
+	profile_sample_cyclic = cyclic_add_omni(&omni);
+	mutex_exit(&cpu_lock);
+
+	if ((ksp = kstat_create("profile", 0, PROFILE_SAMPLE_KSTAT, "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL | KSTAT_FLAG_VAR_SIZE)) ==
+	    NULL)
+		return;
+
+	ksp->ks_data = NULL;
+	ksp->ks_data_size = sizeof (profile_sample_hdr_t);
+	ksp->ks_update = profile_sample_kstat_update;
+	ksp->ks_snapshot = profile_sample_kstat_snapshot;
+	ksp->ks_lock = &profile_sample_lock;
+	kstat_install(ksp);
+	profile_sample_ksp = ksp;
+}
+
+static void
+profile_sample_stop(void)
+{
+	if (profile_sample_ksp != NULL) {
+		kstat_delete(profile_sample_ksp);
+		profile_sample_ksp = NULL;
+	}
+
+	if (profile_sample_cyclic == CYCLIC_NONE)
+		return;
+
+	mutex_enter(&cpu_lock);
+	cyclic_remove(profile_sample_cyclic);
+	profile_sample_cyclic = CYCLIC_NONE;
+	mutex_exit(&cpu_lock);
+
+	kmem_free(profile_sample_cpus, NCPU * sizeof (profile_scpu_t *));
+	profile_sample_cpus = NULL;
+	mutex_destroy(&profile_sample_lock);
+}
+
 static dtrace_pattr_t profile_attr = {
 { DTRACE_STABILITY_EVOLVING, DTRACE_STABILITY_EVOLVING, DTRACE_CLASS_COMMON },
 { DTRACE_STABILITY_UNSTABLE, DTRACE_STABILITY_UNSTABLE, DTRACE_CLASS_UNKNOWN },
@@ -477,6 +864,8 @@ profile_attach(dev_info_t *devi, ddi_attach_cmd_t cmd)
 	profile_max = ddi_getprop(DDI_DEV_T_ANY, devi, DDI_PROP_DONTPASS,
 	    "profile-max-probes", PROFILE_MAX_DEFAULT);
 
+	profile_sample_start(devi);
+
 	ddi_report_dev(devi);
 	profile_devi = devi;
 	return (DDI_SUCCESS);
@@ -497,6 +886,7 @@ profile_detach(dev_info_t *devi, ddi_detach_cmd_t cmd)
 	if (dtrace_unregister(profile_id) != 0)
 		return (DDI_FAILURE);
 
+	profile_sample_stop();
 	ddi_remove_minor_node(devi, NULL);
 	return (DDI_SUCCESS);
 }
@@ -52,6 +52,10 @@
 #include <sys/kstat.h>
 #include <sys/atomic.h>
 #include <sys/taskq.h>
+#include <sys/cpuvar.h>
+#include <sys/disp.h>
+#include <sys/cpu.h>
+#include <sys/pathname.h>
 
 /*
  * Directory name lookup cache.
@@ -220,6 +224,11 @@ struct nc_stats ncs = {
 	{ "dir_fini_purge",		KSTAT_DATA_UINT64 },
 	{ "dir_reclaim_last",		KSTAT_DATA_UINT64 },
 	{ "dir_reclaim_any",		KSTAT_DATA_UINT64 },
+
+	/* lockless path walk stats */
+
+	{ "path_hits",			KSTAT_DATA_UINT64 },
+	{ "path_misses",		KSTAT_DATA_UINT64 },
 };
 
 static int doingcache = 1;
@@ -227,25 +236,133 @@ static int doingcache = 1;
 vnode_t negative_cache_vnode;
 
 /*
- * Insert entry at the front of the queue
+ * Lockless path walks.
+ * ====================
+ *
+ * Most lookups resolve every component from the dnlc, yet each one takes
+ * the hash_lock of its chain and a hold on the vnode it finds, only to
+ * drop the hold on the directory above it.  On a large machine, threads
+ * looking up paths with a common prefix all fight over the same few hash
+ * chains and v_count fields.  dnlc_lookup_path() instead walks as many
+ * components as it can straight from the hash chains, without taking any
+ * locks or holds, and only puts a hold on the vnode it ends up at.
+ *
+ * This is made safe in the manner of RCU: a walk runs with preemption
+ * disabled, and marks its CPU as busy by making that CPU's dc_gen odd for
+ * the duration.  An entry removed from its chain is not freed, nor the
+ * holds it carries on its vnodes released, until dnlc_sync() has seen
+ * every CPU that was busy at the time change its dc_gen.  So any entry,
+ * and any vnode, that a walk can reach remains valid until the walk ends.
+ * A walk that races with changes to a chain may miss an entry, in which
+ * case it gives up and the caller takes the slow path.
+ *
+ * Intermediate directories are searched without calling into the file
+ * system, so the walk only passes through directories marked
+ * V_DNLCSEARCH, which the file system sets when anyone may search the
+ * directory; and it stops at anything else a full lookup would treat
+ * specially: mount points, symbolic links, devices, "." and "..".
+ *
+ * To disable lockless walks, set dnlc_path_enable to 0.
+ */
+typedef struct dnlc_cpu {
+	volatile uint_t	dc_gen;		/* odd while a walk is in progress */
+	uint_t		dc_pad0;
+	uint64_t	dc_path_hits;
+	uint64_t	dc_path_misses;
+	char		dc_pad[64 - 3 * sizeof (uint64_t)];
+} dnlc_cpu_t;
+
+int dnlc_path_enable = 1;
+static dnlc_cpu_t *dnlc_cpu;
+
+/*
+ * Bound on the entries a walk examines in one chain, so that it can't be
+ * led around indefinitely by entries being moved to the front.
+ */
+#define	DNLC_PATH_MAXDEPTH	32
+
+static dnlc_cpu_t *
+dnlc_walk_enter(void)
+{
+	dnlc_cpu_t *dcp;
+
+	kpreempt_disable();
+	dcp = &dnlc_cpu[CPU->cpu_seqid];
+	dcp->dc_gen++;
+	membar_enter();
+	return (dcp);
+}
+
+static void
+dnlc_walk_exit(dnlc_cpu_t *dcp)
+{
+	membar_exit();
+	dcp->dc_gen++;
+	kpreempt_enable();
+}
+
+/*
+ * Wait until no walk that started before the call is still in progress;
+ * once this returns, entries unlinked beforehand may be freed and their
+ * vnodes released.  Walks are short and never block, so we just spin.
+ */
+static void
+dnlc_sync(void)
+{
+	uint_t gen;
+	int i;
+
+	membar_enter();
+	for (i = 0; i < max_ncpus; i++) {
+		gen = dnlc_cpu[i].dc_gen;
+		if ((gen & 1) == 0)
+			continue;
+		while (dnlc_cpu[i].dc_gen == gen)
+			SMT_PAUSE();
+	}
+}
+
+static int
+dnlc_kstat_update(kstat_t *ksp, int rw)
+{
+	uint64_t hits = 0, misses = 0;
+	int i;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (i = 0; i < max_ncpus; i++) {
+		hits += dnlc_cpu[i].dc_path_hits;
+		misses += dnlc_cpu[i].dc_path_misses;
+	}
+	ncs.ncs_path_hits.value.ui64 = hits;
+	ncs.ncs_path_misses.value.ui64 = misses;
+	return (0);
+}
+
+/*
+ * Insert entry at the front of the queue.  The entry must be complete
+ * before lockless walkers can find it.
  */
 #define	nc_inshash(ncp, hp) \
 { \
 	(ncp)->hash_next = (hp)->hash_next; \
 	(ncp)->hash_prev = (ncache_t *)(hp); \
+	membar_producer(); \
 	(hp)->hash_next->hash_prev = (ncp); \
 	(hp)->hash_next = (ncp); \
 }
 
 /*
- * Remove entry from hash queue
+ * Remove entry from hash queue.  hash_next is left alone, so that a
+ * lockless walker standing on the entry can carry on down the chain;
+ * the entry must not be freed until after dnlc_sync().
  */
 #define	nc_rmhash(ncp) \
 { \
 	(ncp)->hash_prev->hash_next = (ncp)->hash_next; \
 	(ncp)->hash_next->hash_prev = (ncp)->hash_prev; \
 	(ncp)->hash_prev = NULL; \
-	(ncp)->hash_next = NULL; \
 }
 
 /*
@@ -385,6 +502,13 @@ dnlc_init()
 	 */
 	dnlc_free_rotor = dnlc_purge_fs1_rotor = &nc_hash[0];
 
+	/*
+	 * Per-CPU state for lockless walks, each on its own cache line.
+	 */
+	dnlc_cpu = (dnlc_cpu_t *)P2ROUNDUP((uintptr_t)kmem_zalloc(
+	    (max_ncpus + 1) * sizeof (dnlc_cpu_t), KM_SLEEP),
+	    sizeof (dnlc_cpu_t));
+
 	/*
 	 * Set up the directory caching to use kmem_cache_alloc
 	 * for its free space entries so that we can get a callback
@@ -424,6 +548,7 @@ dnlc_init()
 	    sizeof (ncs) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
 	if (ksp) {
 		ksp->ks_data = (void *) &ncs;
+		ksp->ks_update = dnlc_kstat_update;
 		kstat_install(ksp);
 	}
 }
@@ -542,6 +667,7 @@ dnlc_update(vnode_t *dp, const char *name, vnode_t *vp)
 			tvp = tcp->vp;
 			tcp->vp = vp;
 			mutex_exit(&hp->hash_lock);
+			dnlc_sync();
 			VN_RELE_DNLC(tvp);
 			ncstats.enters++;
 			ncs.ncs_enters.value.ui64++;
@@ -621,6 +747,7 @@ dnlc_lookup(vnode_t *dp, const char *name)
 				next->hash_prev = prev;
 				ncp->hash_next = next = hp->hash_next;
 				ncp->hash_prev = (ncache_t *)hp;
+				membar_producer();
 				next->hash_prev = ncp;
 				hp->hash_next = ncp;
 
@@ -657,6 +784,112 @@ dnlc_lookup(vnode_t *dp, const char *name)
 	return (NULL);
 }
 
+/*
+ * Resolve the relative pathname in pnp, starting from directory dvp,
+ * entirely from the name cache and without locks; see "Lockless path
+ * walks" above.  Return the vnode the path names, held, and advance pnp
+ * to the end of the path; or return NULL and leave pnp untouched if any
+ * component can't be resolved this way, in which case the caller should
+ * do a full lookup.  If follow is set, a symbolic link at the end of the
+ * path also sends the caller down the slow path.
+ *
+ * The caller must hold dvp, and should already have dealt with leading
+ * and trailing slashes.
+ */
+vnode_t *
+dnlc_lookup_path(vnode_t *dvp, struct pathname *pnp, int follow)
+{
+	dnlc_cpu_t *dcp;
+	ncache_t *ncp;
+	nc_hash_t *hp;
+	vnode_t *vp = NULL;
+	char *path, *end, *name;
+	int hash, depth;
+	size_t namlen;
+	char c;
+
+	if (!doingcache || !dnlc_path_enable)
+		return (NULL);
+
+	path = pnp->pn_path;
+	end = path + pnp->pn_pathlen;
+
+	dcp = dnlc_walk_enter();
+	while (path < end) {
+		/*
+		 * Only carry on through directories the file system has
+		 * told us anyone may search, and that aren't covered.
+		 */
+		if (dvp->v_type != VDIR || !(dvp->v_flag & V_DNLCSEARCH) ||
+		    vn_mountedvfs(dvp) != NULL)
+			goto miss;
+
+		name = path;
+		hash = (int)((uintptr_t)dvp) >> 8;
+		while (path < end && (c = *path) != '/') {
+			hash = (hash << 4) + hash + c;
+			path++;
+		}
+		namlen = path - name;
+		if (namlen >= MAXNAMELEN || (name[0] == '.' &&
+		    (namlen == 1 || (namlen == 2 && name[1] == '.'))))
+			goto miss;
+
+		hp = &nc_hash[hash & nc_hashmask];
+		depth = 0;
+		for (ncp = hp->hash_next; ncp != (ncache_t *)hp;
+		    ncp = ncp->hash_next) {
+			if (ncp->hash == hash &&
+			    ncp->dp == dvp &&
+			    ncp->namlen == namlen &&
+			    bcmp(ncp->name, name, namlen) == 0)
+				break;
+			if (++depth > DNLC_PATH_MAXDEPTH)
+				goto miss;
+		}
+		if (ncp == (ncache_t *)hp)
+			goto miss;
+		vp = ncp->vp;
+		if (vp == DNLC_NO_VNODE)
+			goto miss;
+
+		while (path < end && *path == '/')
+			path++;
+		dvp = vp;
+	}
+
+	/*
+	 * Leave anything but plain files, directories and (unless we are
+	 * to follow them) symbolic links to the full lookup, which knows
+	 * about mount points and device special files.
+	 */
+	if (vp == NULL || vn_mountedvfs(vp) != NULL ||
+	    !(vp->v_type == VREG || vp->v_type == VDIR ||
+	    (vp->v_type == VLNK && !follow)))
+		goto miss;
+
+	/*
+	 * The cache's own hold keeps vp from going away while we are here,
+	 * but we mustn't block, so if v_lock is busy we let the slow path
+	 * take its hold instead.
+	 */
+	if (!mutex_tryenter(&vp->v_lock))
+		goto miss;
+	vp->v_count++;
+	mutex_exit(&vp->v_lock);
+
+	dcp->dc_path_hits++;
+	dnlc_walk_exit(dcp);
+	pnp->pn_path = end;
+	pnp->pn_pathlen = 0;
+	return (vp);
+
+miss:
+	dcp->dc_path_misses++;
+	dnlc_walk_exit(dcp);
+	return (NULL);
+}
+
 /*
  * Remove an entry in the directory name cache.
  */
@@ -680,6 +913,7 @@ dnlc_remove(vnode_t *dp, const char *name)
 		 */
 		nc_rmhash(ncp);
 		mutex_exit(&hp->hash_lock);
+		dnlc_sync();
 		VN_RELE_DNLC(ncp->vp);
 		VN_RELE_DNLC(ncp->dp);
 		dnlc_free(ncp);
@@ -699,6 +933,7 @@ dnlc_purge()
 	int index;
 	int i;
 	vnode_t *nc_rele[DNLC_MAX_RELE];
+	ncache_t *nc_free[DNLC_MAX_RELE / 2];
 
 	if (!doingcache)
 		return;
@@ -714,11 +949,11 @@ dnlc_purge()
 			ncache_t *np;
 
 			np = ncp->hash_next;
+			nc_free[index / 2] = ncp;
 			nc_rele[index++] = ncp->vp;
 			nc_rele[index++] = ncp->dp;
 
 			nc_rmhash(ncp);
-			dnlc_free(ncp);
 			ncp = np;
 			ncs.ncs_purge_total.value.ui64++;
 			if (index == DNLC_MAX_RELE)
@@ -727,9 +962,14 @@ dnlc_purge()
 		mutex_exit(&nch->hash_lock);
 
 		/* Release holds on all the vnodes now that we have no locks */
+		if (index != 0)
+			dnlc_sync();
 		for (i = 0; i < index; i++) {
 			VN_RELE_DNLC(nc_rele[i]);
 		}
+		for (i = 0; i < index / 2; i++) {
+			dnlc_free(nc_free[i]);
+		}
 		if (ncp != (ncache_t *)nch) {
 			nch--; /* Do current hash chain again */
 		}
@@ -746,7 +986,9 @@ dnlc_purge_vp(vnode_t *vp)
 	nc_hash_t *nch;
 	ncache_t *ncp;
 	int index;
+	int i;
 	vnode_t *nc_rele[DNLC_MAX_RELE];
+	ncache_t *nc_free[DNLC_MAX_RELE / 2];
 
 	ASSERT(vp->v_count > 0);
 	if (vp->v_count_dnlc == 0) {
@@ -768,10 +1010,10 @@ dnlc_purge_vp(vnode_t *vp)
 
 			np = ncp->hash_next;
 			if (ncp->dp == vp || ncp->vp == vp) {
+				nc_free[index / 2] = ncp;
 				nc_rele[index++] = ncp->vp;
 				nc_rele[index++] = ncp->dp;
 				nc_rmhash(ncp);
-				dnlc_free(ncp);
 				ncs.ncs_purge_total.value.ui64++;
 				if (index == DNLC_MAX_RELE) {
 					ncp = np;
@@ -783,6 +1025,11 @@ dnlc_purge_vp(vnode_t *vp)
 		mutex_exit(&nch->hash_lock);
 
 		/* Release holds on all the vnodes now that we have no locks */
+		if (index != 0)
+			dnlc_sync();
+		for (i = 0; i < index / 2; i++) {
+			dnlc_free(nc_free[i]);
+		}
 		while (index) {
 			VN_RELE_DNLC(nc_rele[--index]);
 		}
@@ -812,6 +1059,7 @@ dnlc_purge_vfsp(vfs_t *vfsp, int count)
 	int index;
 	int i;
 	vnode_t *nc_rele[DNLC_MAX_RELE];
+	ncache_t *nc_free[DNLC_MAX_RELE / 2];
 
 	if (!doingcache)
 		return (0);
@@ -832,10 +1080,10 @@ dnlc_purge_vfsp(vfs_t *vfsp, int count)
 			if ((ncp->dp->v_vfsp == vfsp) ||
 			    (ncp->vp->v_vfsp == vfsp)) {
 				n++;
+				nc_free[index / 2] = ncp;
 				nc_rele[index++] = ncp->vp;
 				nc_rele[index++] = ncp->dp;
 				nc_rmhash(ncp);
-				dnlc_free(ncp);
 				ncs.ncs_purge_total.value.ui64++;
 				if (index == DNLC_MAX_RELE) {
 					ncp = np;
@@ -849,9 +1097,14 @@ dnlc_purge_vfsp(vfs_t *vfsp, int count)
 		}
 		mutex_exit(&nch->hash_lock);
 		/* Release holds on all the vnodes now that we have no locks */
+		if (index != 0)
+			dnlc_sync();
 		for (i = 0; i < index; i++) {
 			VN_RELE_DNLC(nc_rele[i]);
 		}
+		for (i = 0; i < index / 2; i++) {
+			dnlc_free(nc_free[i]);
+		}
 		if (count != 0 && n >= count) {
 			return (n);
 		}
@@ -909,6 +1162,7 @@ dnlc_fs_purge1(vnodeops_t *vop)
 		if (ncp != (ncache_t *)hp) {
 			nc_rmhash(ncp);
 			mutex_exit(&hp->hash_lock);
+			dnlc_sync();
 			VN_RELE_DNLC(ncp->dp);
 			VN_RELE_DNLC(vp)
 			dnlc_free(ncp);
@@ -1122,6 +1376,7 @@ found:
 		 */
 		nc_rmhash(ncp);
 		mutex_exit(&hp->hash_lock);
+		dnlc_sync();
 		VN_RELE_DNLC(vp);
 		VN_RELE_DNLC(ncp->dp);
 		dnlc_free(ncp);
@@ -958,11 +958,16 @@ fifo_write(vnode_t *vp, uio_t *uiop, int ioflag, cred_t *crp,
 		}
 		/*
 		 * If the write will put us over the high water mark,
-		 * then we must break the message up into PIPE_BUF
-		 * chunks to stay compliant with STREAMS
+		 * then we must break the message up to stay compliant
+		 * with STREAMS.  Take as much as fits under the high
+		 * water mark, but never less than PIPE_BUF, so that a
+		 * large write goes out in as few messages (and wakeups
+		 * of the reader) as possible, while still overshooting
+		 * the high water mark by no more than PIPE_BUF.
 		 */
 		if (uiop->uio_resid + fn_dest->fn_count > Fifohiwat)
-			size = MIN(uiop->uio_resid, PIPE_BUF);
+			size = MIN(uiop->uio_resid,
+			    MAX(PIPE_BUF, Fifohiwat - fn_dest->fn_count));
 		else
 			size = uiop->uio_resid;
 
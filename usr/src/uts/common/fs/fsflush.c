@@ -59,6 +59,7 @@
 
 int doiflush = 1;	/* non-zero to turn inode flushing on */
 int dopageflush = 1;	/* non-zero to turn page flushing on */
+int fsflush_page_scan = 0; /* non-zero to always scan memory for pages */
 
 /*
  * To improve boot performance, don't run the inode flushing loop until
@@ -106,6 +107,118 @@ static ulong_t		fsf_npgsz;
 static pgcnt_t		fsf_pgcnt[MAX_PAGESIZES];
 static pgcnt_t		fsf_mask[MAX_PAGESIZES];
 
+/*
+ * File systems that set VFSFT_DIRTYTRACK call fsflush_dirty_vnode() for
+ * each vnode that may come to have modified pages the file system won't
+ * write back by itself, such as one mapped MAP_SHARED and writable.  We
+ * push each such vnode every v_autoup seconds, as the page scan would,
+ * and forget it once ours is the only hold on it.
+ *
+ * Scanning memory for modified pages is then only needed for the other
+ * file systems.  page_do_hashin() sets fsflush_scan_needed when it first
+ * creates a page for one, and from then on we scan as we always have.
+ */
+typedef struct fsf_vnode {
+	struct fsf_vnode *fv_next;
+	vnode_t		*fv_vp;
+	clock_t		fv_time;	/* lbolt when added or last pushed */
+} fsf_vnode_t;
+
+static kmutex_t		fsf_vnode_lock;
+static fsf_vnode_t	*fsf_vnodes;	/* protected by fsf_vnode_lock */
+int			fsflush_scan_needed;
+ulong_t			fsf_vnode_pushes; /* VOP_PUTPAGE()s from the list */
+
+void
+fsflush_dirty_vnode(vnode_t *vp)
+{
+	fsf_vnode_t *fv;
+
+	ASSERT(vfs_has_feature(vp->v_vfsp, VFSFT_DIRTYTRACK));
+
+	if (vp->v_flag & VFSFLUSH)
+		return;
+
+	fv = kmem_alloc(sizeof (fsf_vnode_t), KM_SLEEP);
+
+	mutex_enter(&vp->v_lock);
+	if (vp->v_flag & VFSFLUSH) {
+		mutex_exit(&vp->v_lock);
+		kmem_free(fv, sizeof (fsf_vnode_t));
+		return;
+	}
+	vp->v_flag |= VFSFLUSH;
+	vp->v_count++;
+	mutex_exit(&vp->v_lock);
+
+	fv->fv_vp = vp;
+	fv->fv_time = ddi_get_lbolt();
+
+	mutex_enter(&fsf_vnode_lock);
+	fv->fv_next = fsf_vnodes;
+	fsf_vnodes = fv;
+	mutex_exit(&fsf_vnode_lock);
+}
+
+/*
+ * Push the vnodes on the list that are due.  New vnodes may be added
+ * while we do this, so we work on a private copy of the list and put
+ * what's left back at the end.
+ */
+static void
+fsflush_do_vnodes()
+{
+	fsf_vnode_t	*fv, *next, *list, *keep = NULL, **tailp = &keep;
+	vnode_t		*vp;
+	clock_t		now = ddi_get_lbolt();
+	clock_t		autoup = v.v_autoup * hz;
+
+	mutex_enter(&fsf_vnode_lock);
+	list = fsf_vnodes;
+	fsf_vnodes = NULL;
+	mutex_exit(&fsf_vnode_lock);
+
+	for (fv = list; fv != NULL; fv = next) {
+		next = fv->fv_next;
+		vp = fv->fv_vp;
+
+		if (now - fv->fv_time >= autoup) {
+			fv->fv_time = now;
+			if (vn_has_cached_data(vp)) {
+				++fsf_vnode_pushes;
+				(void) VOP_PUTPAGE(vp, (offset_t)0, 0, B_ASYNC,
+				    kcred, NULL);
+			}
+
+			/*
+			 * If ours is the only hold, the vnode is neither
+			 * open nor mapped, and the file system will tell
+			 * us again before its pages can be modified.
+			 */
+			mutex_enter(&vp->v_lock);
+			if (vp->v_count == 1) {
+				vp->v_flag &= ~VFSFLUSH;
+				mutex_exit(&vp->v_lock);
+				VN_RELE(vp);
+				kmem_free(fv, sizeof (fsf_vnode_t));
+				continue;
+			}
+			mutex_exit(&vp->v_lock);
+		}
+
+		*tailp = fv;
+		tailp = &fv->fv_next;
+	}
+	*tailp = NULL;
+
+	if (keep != NULL) {
+		mutex_enter(&fsf_vnode_lock);
+		*tailp = fsf_vnodes;
+		fsf_vnodes = keep;
+		mutex_exit(&fsf_vnode_lock);
+	}
+}
+
 
 /*
  * Scan page_t's and issue I/O's for modified pages.
@@ -450,8 +563,11 @@ loop:
 	 */
 	bfreelist.b_bcount = bcount;
 
-	if (dopageflush)
-		fsflush_do_pages();
+	if (dopageflush) {
+		fsflush_do_vnodes();
+		if (fsflush_scan_needed || fsflush_page_scan)
+			fsflush_do_pages();
+	}
 
 	if (!doiflush)
 		goto loop;
@@ -256,6 +256,23 @@ lookuppnvp(
 		must_be_directory = 1;
 	}
 
+	/*
+	 * When only the final vnode is wanted, first try to resolve the
+	 * whole path from the name cache, without taking locks or holds on
+	 * the directories along the way.
+	 */
+	if (compvpp != NULL && dirvpp == NULL && rpnp == NULL &&
+	    !auditing && !must_be_directory &&
+	    !(flags & (FIGNORECASE | LOOKUP_CHECKREAD)) &&
+	    (cvp = dnlc_lookup_path(vp, pnp, flags & FOLLOW)) != NULL) {
+		VN_RELE(vp);
+		pn_setlast(pnp);
+		*compvpp = cvp;
+		if (rootvp != rootdir)
+			VN_RELE(rootvp);
+		return (0);
+	}
+
 	startvp = vp;
 next:
 	retry_with_kcred = B_FALSE;
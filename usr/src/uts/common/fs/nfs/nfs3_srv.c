@@ -1128,7 +1128,7 @@ rfs3_read(READ3args *args, READ3res *resp, struct exportinfo *exi,
 	}
 
 	uio.uio_segflg = UIO_SYSSPACE;
-	uio.uio_extflg = UIO_COPY_CACHED;
+	uio.uio_extflg = UIO_COPY_CACHED | UIO_COPY_OFFLOAD;
 	uio.uio_loffset = args->offset;
 	uio.uio_resid = args->count;
 	uiop = &uio;
@@ -1139,6 +1139,8 @@ doio_read:
 	if (error) {
 		if (mp)
 			freemsg(mp);
+		if (loaned_buffers)
+			rfs_free_xuio((void *)uiop);
 		/* check if a monitor detected a delegation conflict */
 		if (error == EAGAIN && (ct.cc_flags & CC_WOULDBLOCK)) {
 			resp->status = NFS3ERR_JUKEBOX;
@@ -1150,7 +1152,17 @@ doio_read:
 	/* make mblk using zc buffers */
 	if (loaned_buffers) {
 		mp = uio_to_mblk(uiop);
-		ASSERT(mp != NULL);
+		if (mp == NULL) {
+			/*
+			 * Nothing was loaned: the file shrank after
+			 * VOP_REQZCBUF().  Reply with no data.
+			 */
+			rfs_free_xuio((void *)uiop);
+			loaned_buffers = 0;
+			mp = rfs_read_alloc(BYTES_PER_XDR_UNIT, &iovp, &iovcnt);
+			uio.uio_resid = args->count;
+			uiop = &uio;
+		}
 	}
 
 	va.va_mask = AT_ALL;
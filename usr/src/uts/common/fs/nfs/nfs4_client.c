@@ -1113,7 +1113,7 @@ nfs4_async_manager(vfs_t *vfsp)
 {
 	callb_cpr_t cprinfo;
 	mntinfo4_t *mi;
-	uint_t max_threads;
+	uint_t max_threads, limit;
 
 	mi = VFTOMI4(vfsp);
 
@@ -1165,9 +1165,14 @@ nfs4_async_manager(vfs_t *vfsp)
 			 * mi->mi_max_threads are ignored for our
 			 * purposes, but who told them they could change
 			 * random values on a live kernel anyhow?
+			 *
+			 * Readahead over a path with a large bandwidth-delay
+			 * product may want more; see nfs4_ra_sample().
 			 */
-			if (mi->mi_threads[NFS4_ASYNC_QUEUE] <
-			    MAX(mi->mi_max_threads, max_threads)) {
+			limit = MAX(mi->mi_max_threads, max_threads);
+			if (mi->mi_max_threads != 0)
+				limit = MAX(limit, mi->mi_ra_threads);
+			if (mi->mi_threads[NFS4_ASYNC_QUEUE] < limit) {
 				mi->mi_threads[NFS4_ASYNC_QUEUE]++;
 				mutex_exit(&mi->mi_async_lock);
 				MI4_HOLD(mi);
@@ -1249,6 +1254,61 @@ nfs4_async_manager_stop(vfs_t *vfsp)
 	mutex_exit(&mi->mi_async_lock);
 }
 
+/*
+ * Readahead is sized to keep about twice the bandwidth-delay product of
+ * the path to the server in flight: enough to fill the pipe, and enough
+ * more that the bandwidth estimate can grow if the pipe turns out to be
+ * wider than anything seen so far.  The async threads are allowed to grow
+ * with it, since each has one READ outstanding.
+ */
+uint_t nfs4_ra_max = 64;		/* most blocks of readahead */
+ushort_t nfs4_ra_max_threads = 32;	/* most async threads for readahead */
+hrtime_t nfs4_ra_interval = MSEC2NSEC(100);	/* sample interval */
+
+/*
+ * Account for a READ of len bytes that took rtt nanoseconds, and once per
+ * nfs4_ra_interval re-estimate the bandwidth to the server (a decaying
+ * maximum of the read throughput) and its unloaded latency (a decaying
+ * minimum of the READ times), and from those the readahead depth.
+ */
+void
+nfs4_ra_sample(mntinfo4_t *mi, size_t len, hrtime_t rtt)
+{
+	hrtime_t now = gethrtime();
+	hrtime_t elapsed;
+	uint64_t bw, depth;
+
+	mutex_enter(&mi->mi_lock);
+	mi->mi_ra_bytes += len;
+	if (mi->mi_ra_minrtt == 0 || rtt < mi->mi_ra_minrtt)
+		mi->mi_ra_minrtt = rtt;
+	if (mi->mi_ra_stamp == 0)
+		mi->mi_ra_stamp = now;
+	elapsed = now - mi->mi_ra_stamp;
+	if (elapsed < nfs4_ra_interval) {
+		mutex_exit(&mi->mi_lock);
+		return;
+	}
+
+	bw = mi->mi_ra_bytes * NANOSEC / elapsed;
+	mi->mi_ra_bw = MAX(bw, mi->mi_ra_bw - (mi->mi_ra_bw >> 3));
+	if (mi->mi_ra_rtt == 0)
+		mi->mi_ra_rtt = mi->mi_ra_minrtt;
+	else
+		mi->mi_ra_rtt = MIN(mi->mi_ra_minrtt,
+		    mi->mi_ra_rtt + (mi->mi_ra_rtt >> 3));
+	mi->mi_ra_stamp = now;
+	mi->mi_ra_bytes = 0;
+	mi->mi_ra_minrtt = 0;
+
+	depth = 2 * (mi->mi_ra_bw / mi->mi_vfsp->vfs_bsize) * mi->mi_ra_rtt /
+	    NANOSEC;
+	depth = MIN(depth, nfs4_ra_max);
+	mi->mi_ra_depth = (uint_t)depth;
+	mi->mi_ra_threads = (ushort_t)MIN(depth, nfs4_ra_max_threads);
+	mutex_exit(&mi->mi_lock);
+}
+
 int
 nfs4_async_readahead(vnode_t *vp, u_offset_t blkoff, caddr_t addr,
     struct seg *seg, cred_t *cr, void (*readahead)(vnode_t *,
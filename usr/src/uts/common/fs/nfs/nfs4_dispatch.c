@@ -58,6 +58,12 @@ uint32_t nfs4_drc_max = 8 * 1024;
  */
 uint32_t nfs4_drc_hash = 541;
 
+/*
+ * The number of independently locked partitions the cache is split
+ * into, and nfs4_drc_max shared between; do not change this on the fly.
+ */
+uint32_t nfs4_drc_parts = 32;
+
 static void rfs4_resource_err(struct svc_req *req, COMPOUND4args *argsp);
 
 /*
@@ -67,18 +73,15 @@ rfs4_drc_t *
 rfs4_init_drc(uint32_t drc_size, uint32_t drc_hash_size)
 {
 	rfs4_drc_t *drc;
+	rfs4_drc_part_t *part;
 	uint32_t   bki;
+	uint32_t   pi;
 
 	ASSERT(drc_size);
 	ASSERT(drc_hash_size);
 
 	drc = kmem_alloc(sizeof (rfs4_drc_t), KM_SLEEP);
 
-	drc->max_size = drc_size;
-	drc->in_use = 0;
-
-	mutex_init(&drc->lock, NULL, MUTEX_DEFAULT, NULL);
-
 	drc->dr_hash = drc_hash_size;
 
 	drc->dr_buckets = kmem_alloc(sizeof (list_t)*drc_hash_size, KM_SLEEP);
@@ -88,8 +91,22 @@ rfs4_init_drc(uint32_t drc_size, uint32_t drc_hash_size)
 		    offsetof(rfs4_dupreq_t, dr_bkt_next));
 	}
 
-	list_create(&(drc->dr_cache), sizeof (rfs4_dupreq_t),
-	    offsetof(rfs4_dupreq_t, dr_next));
+	/*
+	 * Every partition needs at least one bucket and one entry.
+	 */
+	drc->dr_nparts = MAX(1, MIN(nfs4_drc_parts,
+	    MIN(drc_hash_size, drc_size)));
+	drc->dr_parts = kmem_alloc(sizeof (rfs4_drc_part_t) * drc->dr_nparts,
+	    KM_SLEEP);
+
+	for (pi = 0; pi < drc->dr_nparts; pi++) {
+		part = &drc->dr_parts[pi];
+		mutex_init(&part->lock, NULL, MUTEX_DEFAULT, NULL);
+		part->max_size = drc_size / drc->dr_nparts;
+		part->in_use = 0;
+		list_create(&(part->dr_cache), sizeof (rfs4_dupreq_t),
+		    offsetof(rfs4_dupreq_t, dr_next));
+	}
 
 	return (drc);
 }
@@ -101,24 +118,35 @@ void
 rfs4_fini_drc(rfs4_drc_t *drc)
 {
 	rfs4_dupreq_t *drp, *drp_next;
+	rfs4_drc_part_t *part;
+	uint32_t pi;
 
 	ASSERT(drc);
 
-	/* iterate over the dr_cache and free the enties */
-	for (drp = list_head(&(drc->dr_cache)); drp != NULL; drp = drp_next) {
+	for (pi = 0; pi < drc->dr_nparts; pi++) {
+		part = &drc->dr_parts[pi];
 
-		if (drp->dr_state == NFS4_DUP_REPLAY)
-			rfs4_compound_free(&(drp->dr_res));
+		/* iterate over the dr_cache and free the enties */
+		for (drp = list_head(&(part->dr_cache)); drp != NULL;
+		    drp = drp_next) {
 
-		if (drp->dr_addr.buf != NULL)
-			kmem_free(drp->dr_addr.buf, drp->dr_addr.maxlen);
+			if (drp->dr_state == NFS4_DUP_REPLAY)
+				rfs4_compound_free(&(drp->dr_res));
+
+			if (drp->dr_addr.buf != NULL)
+				kmem_free(drp->dr_addr.buf,
+				    drp->dr_addr.maxlen);
 
-		drp_next = list_next(&(drc->dr_cache), drp);
+			drp_next = list_next(&(part->dr_cache), drp);
 
-		kmem_free(drp, sizeof (rfs4_dupreq_t));
+			kmem_free(drp, sizeof (rfs4_dupreq_t));
+		}
+
+		mutex_destroy(&part->lock);
 	}
 
-	mutex_destroy(&drc->lock);
+	kmem_free(drc->dr_parts,
+	    sizeof (rfs4_drc_part_t) * drc->dr_nparts);
 	kmem_free(drc->dr_buckets,
 	    sizeof (list_t)*drc->dr_hash);
 	kmem_free(drc, sizeof (rfs4_drc_t));
@@ -135,55 +163,55 @@ rfs4_fini_drc(rfs4_drc_t *drc)
 void
 rfs4_dr_chstate(rfs4_dupreq_t *drp, int new_state)
 {
-	rfs4_drc_t *drc;
+	rfs4_drc_part_t *part;
 
 	ASSERT(drp);
-	ASSERT(drp->drc);
+	ASSERT(drp->dr_part);
 	ASSERT(drp->dr_bkt);
-	ASSERT(MUTEX_HELD(&drp->drc->lock));
+	ASSERT(MUTEX_HELD(&drp->dr_part->lock));
 
 	drp->dr_state = new_state;
 
 	if (new_state != NFS4_DUP_FREE)
 		return;
 
-	drc = drp->drc;
+	part = drp->dr_part;
 
 	/*
 	 * Remove entry from the bucket and
 	 * dr_cache list, free compound results.
 	 */
 	list_remove(drp->dr_bkt, drp);
-	list_remove(&(drc->dr_cache), drp);
+	list_remove(&(part->dr_cache), drp);
 	rfs4_compound_free(&(drp->dr_res));
 }
 
 /*
  * rfs4_alloc_dr:
  *
- * Malloc a new one if we have not reached our maximum cache
- * limit, otherwise pick an entry off the tail -- Use if it
- * is marked as NFS4_DUP_FREE, or is an entry in the
- * NFS4_DUP_REPLAY state.
+ * Malloc a new one if we have not reached the partition's
+ * share of the cache limit, otherwise pick an entry off the
+ * tail -- Use if it is marked as NFS4_DUP_FREE, or is an entry
+ * in the NFS4_DUP_REPLAY state.
  */
 rfs4_dupreq_t *
-rfs4_alloc_dr(rfs4_drc_t *drc)
+rfs4_alloc_dr(rfs4_drc_part_t *part)
 {
 	rfs4_dupreq_t *drp_tail, *drp = NULL;
 
-	ASSERT(drc);
-	ASSERT(MUTEX_HELD(&drc->lock));
+	ASSERT(part);
+	ASSERT(MUTEX_HELD(&part->lock));
 
 	/*
 	 * Have we hit the cache limit yet ?
 	 */
-	if (drc->in_use < drc->max_size) {
+	if (part->in_use < part->max_size) {
 		/*
 		 * nope, so let's malloc a new one
 		 */
 		drp = kmem_zalloc(sizeof (rfs4_dupreq_t), KM_SLEEP);
-		drp->drc = drc;
-		drc->in_use++;
+		drp->dr_part = part;
+		part->in_use++;
 		DTRACE_PROBE1(nfss__i__drc_new, rfs4_dupreq_t *, drp);
 		return (drp);
 	}
@@ -192,13 +220,13 @@ rfs4_alloc_dr(rfs4_drc_t *drc)
 	 * Cache is all allocated now traverse the list
 	 * backwards to find one we can reuse.
 	 */
-	for (drp_tail = list_tail(&drc->dr_cache); drp_tail != NULL;
-	    drp_tail = list_prev(&drc->dr_cache, drp_tail)) {
+	for (drp_tail = list_tail(&part->dr_cache); drp_tail != NULL;
+	    drp_tail = list_prev(&part->dr_cache, drp_tail)) {
 
 		switch (drp_tail->dr_state) {
 
 		case NFS4_DUP_FREE:
-			list_remove(&(drc->dr_cache), drp_tail);
+			list_remove(&(part->dr_cache), drp_tail);
 			DTRACE_PROBE1(nfss__i__drc_freeclaim,
 			    rfs4_dupreq_t *, drp_tail);
 			return (drp_tail);
@@ -213,7 +241,7 @@ rfs4_alloc_dr(rfs4_drc_t *drc)
 			/* NOTREACHED */
 		}
 	}
-	DTRACE_PROBE1(nfss__i__drc_full, rfs4_drc_t *, drc);
+	DTRACE_PROBE1(nfss__i__drc_full, rfs4_drc_part_t *, part);
 	return (NULL);
 }
 
@@ -224,7 +252,8 @@ rfs4_alloc_dr(rfs4_drc_t *drc)
  * calculating the hash index based on the XID, and examining
  * the entries in the hash bucket. If we find a match, return.
  * Once we have searched the bucket we call rfs4_alloc_dr() to
- * allocate a new entry, or reuse one that is available.
+ * allocate a new entry, or reuse one that is available, from
+ * the bucket's partition.
  */
 int
 rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
@@ -232,6 +261,7 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 
 	uint32_t	the_xid;
 	list_t		*dr_bkt;
+	rfs4_drc_part_t	*part;
 	rfs4_dupreq_t	*drp;
 	int		bktdex;
 
@@ -244,6 +274,7 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 
 	dr_bkt = (list_t *)
 	    &(drc->dr_buckets[(the_xid % drc->dr_hash)]);
+	part = &drc->dr_parts[bktdex % drc->dr_nparts];
 
 	DTRACE_PROBE3(nfss__i__drc_bktdex,
 	    int, bktdex,
@@ -252,7 +283,7 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 
 	*dup = NULL;
 
-	mutex_enter(&drc->lock);
+	mutex_enter(&part->lock);
 	/*
 	 * Search the bucket for a matching xid and address.
 	 */
@@ -270,7 +301,7 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 			 */
 			if (drp->dr_state == NFS4_DUP_REPLAY) {
 				rfs4_dr_chstate(drp, NFS4_DUP_INUSE);
-				mutex_exit(&drc->lock);
+				mutex_exit(&part->lock);
 				*dup = drp;
 				DTRACE_PROBE1(nfss__i__drc_replay,
 				    rfs4_dupreq_t *, drp);
@@ -281,13 +312,13 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 			 * This entry must be in transition, so return
 			 * the 'pending' status.
 			 */
-			mutex_exit(&drc->lock);
+			mutex_exit(&part->lock);
 			return (NFS4_DUP_PENDING);
 		}
 	}
 
-	drp = rfs4_alloc_dr(drc);
-	mutex_exit(&drc->lock);
+	drp = rfs4_alloc_dr(part);
+	mutex_exit(&part->lock);
 
 	/*
 	 * The DRC is full and all entries are in use. Upper function
@@ -319,9 +350,9 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 			 */
 			drp->dr_addr.maxlen = 0;
 			drp->dr_state = NFS4_DUP_FREE;
-			mutex_enter(&drc->lock);
-			list_insert_tail(&(drc->dr_cache), drp);
-			mutex_exit(&drc->lock);
+			mutex_enter(&part->lock);
+			list_insert_tail(&(part->dr_cache), drp);
+			mutex_exit(&part->lock);
 			return (NFS4_DUP_ERROR);
 		}
 	}
@@ -343,10 +374,10 @@ rfs4_find_dr(struct svc_req *req, rfs4_drc_t *drc, rfs4_dupreq_t **dup)
 	 * Insert at the head of the bucket and
 	 * the drc lists..
 	 */
-	mutex_enter(&drc->lock);
-	list_insert_head(&drc->dr_cache, drp);
+	mutex_enter(&part->lock);
+	list_insert_head(&part->dr_cache, drp);
 	list_insert_head(dr_bkt, drp);
-	mutex_exit(&drc->lock);
+	mutex_exit(&part->lock);
 
 	*dup = drp;
 
@@ -472,10 +503,11 @@ rfs4_dispatch(struct rpcdisp *disp, struct svc_req *req,
 				 * mark this entry as FREE and plop
 				 * on the end of the cache list
 				 */
-				mutex_enter(&drp->drc->lock);
+				mutex_enter(&drp->dr_part->lock);
 				rfs4_dr_chstate(drp, NFS4_DUP_FREE);
-				list_insert_tail(&(drp->drc->dr_cache), drp);
-				mutex_exit(&drp->drc->lock);
+				list_insert_tail(&(drp->dr_part->dr_cache),
+				    drp);
+				mutex_exit(&drp->dr_part->lock);
 				return (1);
 			}
 			break;
@@ -534,9 +566,9 @@ rfs4_dispatch(struct rpcdisp *disp, struct svc_req *req,
 	 *
 	 */
 	if (dr_stat == NFS4_DUP_NEW || dr_stat == NFS4_DUP_REPLAY) {
-		mutex_enter(&drp->drc->lock);
+		mutex_enter(&drp->dr_part->lock);
 		rfs4_dr_chstate(drp, NFS4_DUP_REPLAY);
-		mutex_exit(&drp->drc->lock);
+		mutex_exit(&drp->dr_part->lock);
 	} else if (dr_stat == NFS4_NOT_DUP) {
 		rfs4_compound_free(rbp);
 	}
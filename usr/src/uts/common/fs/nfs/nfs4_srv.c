@@ -3347,7 +3347,7 @@ rfs4_op_read(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 	}
 
 	uio.uio_segflg = UIO_SYSSPACE;
-	uio.uio_extflg = UIO_COPY_CACHED;
+	uio.uio_extflg = UIO_COPY_CACHED | UIO_COPY_OFFLOAD;
 	uio.uio_loffset = args->offset;
 	uio.uio_resid = args->count;
 	uiop = &uio;
@@ -3361,6 +3361,8 @@ doio_read:
 	if (error) {
 		if (mp)
 			freemsg(mp);
+		if (loaned_buffers)
+			rfs_free_xuio((void *)uiop);
 		*cs->statusp = resp->status = puterrno4(error);
 		goto out;
 	}
@@ -3368,7 +3370,17 @@ doio_read:
 	/* make mblk using zc buffers */
 	if (loaned_buffers) {
 		mp = uio_to_mblk(uiop);
-		ASSERT(mp != NULL);
+		if (mp == NULL) {
+			/*
+			 * Nothing was loaned: the file shrank after
+			 * VOP_REQZCBUF().  Reply with no data.
+			 */
+			rfs_free_xuio((void *)uiop);
+			loaned_buffers = 0;
+			mp = rfs_read_alloc(BYTES_PER_XDR_UNIT, &iovp, &iovcnt);
+			uio.uio_resid = args->count;
+			uiop = &uio;
+		}
 	}
 
 	*cs->statusp = resp->status = NFS4_OK;
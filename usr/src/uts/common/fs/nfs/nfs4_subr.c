@@ -1054,6 +1054,16 @@ nfs_clget4(mntinfo4_t *mi, servinfo4_t *svp, cred_t *cr, CLIENT **newcl,
 
 	} while (error == ETIMEDOUT || error == ECONNRESET);
 
+	/*
+	 * Client handles are cached per zone and shared between mounts,
+	 * so the connection limit of this mount must be set on every get.
+	 * Transports other than COTS have no connections to spread RPCs
+	 * across, and ignore it.
+	 */
+	if (error == 0)
+		(void) CLNT_CONTROL(*newcl, CLSET_NCONNECT,
+		    (char *)&mi->mi_nconnect);
+
 	return (error);
 }
 
@@ -59,6 +59,7 @@
 #include <sys/list.h>
 #include <sys/mntent.h>
 #include <sys/tsol/label.h>
+#include <sys/sunddi.h>
 
 #include <rpc/types.h>
 #include <rpc/auth.h>
@@ -2284,6 +2285,8 @@ nfs4rootvp(vnode_t **rtvpp, vfs_t *vfsp, struct servinfo4 *svp_head,
 	cred_t *lcr = NULL, *tcr = cr;
 	struct servinfo4 *origsvp;
 	char *resource;
+	char *nconnect;
+	unsigned long nconns;
 
 	nfsstatsp = zone_getspecific(nfsstat_zone_key, nfs_zone());
 	ASSERT(nfsstatsp != NULL);
@@ -2376,6 +2379,17 @@ nfs4rootvp(vnode_t **rtvpp, vfs_t *vfsp, struct servinfo4 *svp_head,
 	mi->mi_async_curr[NFS4_ASYNC_QUEUE] =
 	    mi->mi_async_curr[NFS4_ASYNC_PGOPS_QUEUE] = &mi->mi_async_reqs[0];
 	mi->mi_max_threads = nfs4_max_threads;
+
+	/*
+	 * The number of connections to spread this mount's RPCs across;
+	 * 0, the default, leaves it to clnt_max_conns.  It comes in the
+	 * option string rather than in nfs_args.
+	 */
+	if (vfs_optionisset(vfsp, MNTOPT_NCONNECT, &nconnect) &&
+	    nconnect != NULL &&
+	    ddi_strtoul(nconnect, NULL, 10, &nconns) == 0 && nconns != 0)
+		mi->mi_nconnect = MIN(nconns, CLNT_MAX_NCONNECT);
+
 	mutex_init(&mi->mi_async_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&mi->mi_async_reqs_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&mi->mi_async_work_cv[NFS4_ASYNC_QUEUE], NULL, CV_DEFAULT,
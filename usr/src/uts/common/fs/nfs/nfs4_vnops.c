@@ -373,7 +373,8 @@ static int nfs4_lookup_neg_cache = 1;
 
 /*
  * number of pages to read ahead
- * optimized for 100 base-T.
+ * optimized for 100 base-T; faster or longer paths get more, see
+ * nfs4_ra_sample().
  */
 static int nfs4_nra = 4;
 
@@ -3397,6 +3398,7 @@ nfs4read(vnode_t *vp, caddr_t base, offset_t offset, int count,
 	int doqueue;
 	rnode4_t *rp;
 	int data_len;
+	hrtime_t start;
 	bool_t is_eof;
 	bool_t needrecov = FALSE;
 	nfs4_recov_state_t recov_state;
@@ -3468,6 +3470,7 @@ recov_retry:
 			rargs->res_data_val_alt = base;
 		rargs->res_maxsize = tsize;
 
+		start = gethrtime();
 		rfs4call(mi, &args, &res, cr, &doqueue, 0, &e);
 #ifdef	DEBUG
 		if (nfs4read_error_inject) {
@@ -3602,6 +3605,7 @@ recov_retry:
 			KSTAT_IO_PTR(mi->mi_io_kstats)->nread += data_len;
 			mutex_exit(&mi->mi_lock);
 		}
+		nfs4_ra_sample(mi, data_len, gethrtime() - start);
 		lwp_stat_update(LWP_STAT_INBLK, 1);
 		is_eof = res.array[1].nfs_resop4_u.opread.eof;
 		(void) xdr_free(xdr_COMPOUND4res_clnt, (caddr_t)&res);
@@ -9831,6 +9835,7 @@ nfs4_getapage(vnode_t *vp, u_offset_t off, size_t len, uint_t *protp,
 	int readahead;
 	int readahead_issued = 0;
 	int ra_window; /* readahead window */
+	int nra;
 	page_t *pagefound;
 	page_t *savepp;
 
@@ -9867,22 +9872,23 @@ reread:
 		/*
 		 * Calculate the number of readaheads to do.
 		 * a) No readaheads at offset = 0.
-		 * b) Do maximum(nfs4_nra) readaheads when the readahead
+		 * b) Do maximum(nra) readaheads when the readahead
 		 *    window is closed.
-		 * c) Do readaheads between 1 to (nfs4_nra - 1) depending
+		 * c) Do readaheads between 1 to (nra - 1) depending
 		 *    upon how far the readahead window is open or close.
 		 * d) No readaheads if rp->r_nextr is not within the scope
 		 *    of the readahead window (random i/o).
 		 */
+		nra = MAX(nfs4_nra, VTOMI4(vp)->mi_ra_depth);
 
 		if (off == 0)
 			readahead = 0;
 		else if (blkoff == rp->r_nextr)
-			readahead = nfs4_nra;
+			readahead = nra;
 		else if (rp->r_nextr > blkoff &&
 		    ((ra_window = (rp->r_nextr - blkoff) / bsize)
-		    <= (nfs4_nra - 1)))
-			readahead = nfs4_nra - ra_window;
+		    <= (nra - 1)))
+			readahead = nra - ra_window;
 		else
 			readahead = 0;
 
@@ -2385,6 +2385,8 @@ static char *optlist[] = {
 	MNTOPT_EXEC,
 #define	OPT_NOEXEC	48
 	MNTOPT_NOEXEC,
+#define	OPT_NCONNECT	49
+	MNTOPT_NCONNECT,
 	NULL
 };
 
@@ -2727,6 +2729,12 @@ init_mountopts(struct nfs_args *args, int version, struct knetconfig **dl_cf,
 			args->flags &= ~(NFSMNT_DIRECTIO);
 			break;
 
+		case OPT_NCONNECT:
+			cmn_err(CE_WARN,
+			    "nfs_dlboot: root mounted with one connection, "
+			    "nconnect ignored");
+			break;
+
 		default:
 			cmn_err(CE_WARN,
 			    "nfs_dlboot: ignoring invalid option \"%s\"", val);
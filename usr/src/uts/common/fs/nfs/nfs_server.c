@@ -109,7 +109,11 @@ static struct modlinkage modlinkage = {
 };
 
 kmem_cache_t *nfs_xuio_cache;
-int nfs_loaned_buffers = 0;
+/*
+ * Reply to READ with buffers loaned by the file system (VOP_REQZCBUF(),
+ * the ARC for ZFS) instead of copying the data into fresh mblks.
+ */
+int nfs_loaned_buffers = 1;
 
 int
 _init(void)
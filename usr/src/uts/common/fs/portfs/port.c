@@ -89,6 +89,7 @@
  *		   The standard close(2) function closes a port.
  * port_associate() : associate a file descriptor with a port to be able to
  *		      retrieve events from that file descriptor.
+ * port_associaten(): associate a list of objects with a port.
  * port_dissociate(): remove the association of a file descriptor with a port.
  * port_alert()	 : set/unset a port in alert mode
  * port_send()	 : send an event of type PORT_SOURCE_USER to a port
@@ -162,6 +163,9 @@
  * 	event slot from the port. Anyway, file descriptors deliver events
  * 	only one time and remain deactivated until the application
  * 	reactivates the association of a file descriptor with port_associate().
+ * 	The exception are associations made with PORT_ASSOC_EDGE in events:
+ * 	these are re-armed by the source as their event is retrieved, and
+ * 	then fire again on the next pollwakeup() for the file descriptor.
  * 	If an associated file descriptor is closed then the file descriptor
  * 	will be dissociated automatically from the port.
  *
@@ -447,6 +451,7 @@ struct port_ksource port_ksource_tab[] = {
 static int port_getn(port_t *, port_event_t *, uint_t, uint_t *,
     port_gettimer_t *);
 static int port_sendn(int [], int [], uint_t, int, void *, uint_t *);
+static int port_associaten(port_t *, int, void *, uint_t, int [], uint_t *);
 static int port_alert(port_t *, int, int, void *);
 static int port_dispatch_event(port_t *, int, int, int, uintptr_t, void *);
 static int port_send(port_t *, int, int, void *);
@@ -656,6 +661,20 @@ portfs(int opcode, uintptr_t a0, uintptr_t a1, uintptr_t a2, uintptr_t a3,
 		}
 		break;
 	}
+	case	PORT_ASSOCIATEN:
+	{
+		/*
+		 * As with port_sendn(), EIO means that some of the objects
+		 * could not be associated; the count of those that were is
+		 * still returned and errors[] says which failed.
+		 */
+		error = port_associaten(pp, (int)a1, (void *)a2, (uint_t)a3,
+		    (int *)a4, (uint_t *)&r.r_val1);
+		releasef((int)a0);
+		if (error && error != EIO)
+			return ((int64_t)set_errno(error));
+		return (r.r_vals);
+	}
 	case	PORT_SEND:
 	{
 		/* user-defined events */
@@ -1049,6 +1068,84 @@ port_sendn(int ports[], int errors[], uint_t nent, int events, void *user,
 	return (error);
 }
 
+/*
+ * The port_associaten() function is the kernel implementation of the event
+ * port API function port_associaten(3c).
+ * It associates every object in the list with the port, just as that many
+ * port_associate() calls would, at the cost of a single system call.
+ * If an object can not be associated then the error code will be stored
+ * in the errors[] list with the same list offset as in the objects list.
+ */
+static int
+port_associaten(port_t *pp, int source, void *list, uint_t nent,
+    int errors[], uint_t *nassoc)
+{
+	port_assoc_t	*alist;
+	port_assoc_t	*pa;
+	int		errorcnt = 0;
+	int		error = 0;
+	int		count;
+	int		*elist = NULL;
+
+	if (nent == 0 || nent > port_max_list)
+		return (EINVAL);
+
+	if (source != PORT_SOURCE_FD && source != PORT_SOURCE_FILE)
+		return (EINVAL);
+
+	alist = kmem_alloc(nent * sizeof (port_assoc_t), KM_SLEEP);
+	if (get_udatamodel() == DATAMODEL_NATIVE) {
+		if (copyin(list, alist, nent * sizeof (port_assoc_t))) {
+			kmem_free(alist, nent * sizeof (port_assoc_t));
+			return (EFAULT);
+		}
+#ifdef	_SYSCALL32_IMPL
+	} else {
+		port_assoc32_t	*alist32;
+
+		alist32 = kmem_alloc(nent * sizeof (port_assoc32_t), KM_SLEEP);
+		if (copyin(list, alist32, nent * sizeof (port_assoc32_t))) {
+			kmem_free(alist32, nent * sizeof (port_assoc32_t));
+			kmem_free(alist, nent * sizeof (port_assoc_t));
+			return (EFAULT);
+		}
+		for (count = 0; count < nent; count++) {
+			alist[count].pa_object =
+			    (uintptr_t)alist32[count].pa_object;
+			alist[count].pa_events = alist32[count].pa_events;
+			alist[count].pa_user =
+			    (void *)(uintptr_t)alist32[count].pa_user;
+		}
+		kmem_free(alist32, nent * sizeof (port_assoc32_t));
+#endif	/* _SYSCALL32_IMPL */
+	}
+
+	for (count = 0; count < nent; count++) {
+		pa = &alist[count];
+		if (source == PORT_SOURCE_FD)
+			error = port_associate_fd(pp, source, pa->pa_object,
+			    pa->pa_events, pa->pa_user);
+		else
+			error = port_associate_fop(pp, source, pa->pa_object,
+			    pa->pa_events, pa->pa_user);
+		if (error) {
+			elist = port_errorn(elist, nent, error, count);
+			errorcnt++;
+		}
+	}
+	error = 0;
+	if (errorcnt) {
+		error = EIO;
+		if (errors != NULL &&
+		    copyout(elist, (void *)errors, nent * sizeof (int)))
+			error = EFAULT;
+		kmem_free(elist, nent * sizeof (int));
+	}
+	*nassoc = nent - errorcnt;
+	kmem_free(alist, nent * sizeof (port_assoc_t));
+	return (error);
+}
+
 static int *
 port_errorn(int *elist, int nent, int error, int index)
 {
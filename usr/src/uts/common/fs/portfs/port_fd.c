@@ -53,7 +53,8 @@ static void	port_cache_insert_fd(port_fdcache_t *, polldat_t *);
  * structure. The portfd_t structure is specific for PORT_SOURCE_FD source.
  * The port_fd_callback() function is notified in three cases:
  * - PORT_CALLBACK_DEFAULT
- *	The object (fd) will be delivered to the application.
+ *	The object (fd) will be delivered to the application.  An
+ *	edge-triggered association is re-armed here.
  * - PORT_CALLBACK_DISSOCIATE
  *	The object (fd) will be dissociated from  the port.
  * - PORT_CALLBACK_CLOSE
@@ -81,6 +82,7 @@ port_fd_callback(void *arg, int *events, pid_t pid, int flag, void *evp)
 	portfd_t	*pfd = (portfd_t *)arg;
 	polldat_t	*pdp = PFTOD(pfd);
 	port_fdcache_t	*pcp;
+	port_kevent_t	*pkevp;
 	file_t		*fp;
 	int		error;
 
@@ -104,6 +106,19 @@ port_fd_callback(void *arg, int *events, pid_t pid, int flag, void *evp)
 			}
 		}
 		*events = pdp->pd_portev->portkev_events; /* update events */
+		if (pfd->pfd_flags & PORTFD_EDGE) {
+			/*
+			 * Re-arm before the application sees the event, so
+			 * that nothing after it looks at the fd is missed.
+			 * port_getn() holds the port blocked, so the
+			 * association can't be removed under us.
+			 */
+			pkevp = pdp->pd_portev;
+			mutex_enter(&pkevp->portkev_lock);
+			pkevp->portkev_events = 0;
+			pkevp->portkev_flags |= PORT_KEV_VALID;
+			mutex_exit(&pkevp->portkev_lock);
+		}
 		error = 0;
 		break;
 	case PORT_CALLBACK_DISSOCIATE:
@@ -172,6 +187,9 @@ port_cache_lookup_fp(port_fdcache_t *pcp, int fd, file_t *fp)
  * pollhead_t structure. In such a case the corresponding file system behind
  * VOP_POLL will use the pollwakeup() function to notify about existing
  * events.
+ * With PORT_ASSOC_EDGE in events the association is persistent: it is
+ * re-armed by port_fd_callback() rather than dropped when its event is
+ * delivered.
  */
 int
 port_associate_fd(port_t *pp, int source, uintptr_t object, int events,
@@ -187,12 +205,15 @@ port_associate_fd(port_t *pp, int source, uintptr_t object, int events,
 	short		revents;
 	int		error = 0;
 	int		active;
+	int		flags;
 
 	pcp = pp->port_queue.portq_pcp;
 	if (object > (uintptr_t)INT_MAX)
 		return (EBADFD);
 
 	fd = object;
+	flags = (events & PORT_ASSOC_EDGE) ? PORTFD_EDGE : 0;
+	events &= ~PORT_ASSOC_EDGE;
 
 	if ((fp = getf(fd)) == NULL)
 		return (EBADFD);
@@ -293,6 +314,7 @@ port_associate_fd(port_t *pp, int source, uintptr_t object, int events,
 	}
 
 	pfd->pfd_thread = curthread;
+	pfd->pfd_flags = flags;
 	mutex_enter(&pkevp->portkev_lock);
 	pkevp->portkev_events = 0;	/* no fired events */
 	pdp->pd_events = events;	/* events associated */
@@ -55,6 +55,7 @@ typedef struct smb2_create_ctx {
 	/* Elements we my place in the response */
 	smb2_create_ctx_elem_t cc_out_max_access;
 	smb2_create_ctx_elem_t cc_out_file_id;
+	smb2_create_ctx_elem_t cc_out_req_lease;
 } smb2_create_ctx_t;
 
 static uint32_t smb2_decode_create_ctx(
@@ -84,6 +85,7 @@ smb2_create(smb_request_t *sr)
 	uint16_t NameLength;
 	uint32_t CreateCtxOffset;
 	uint32_t CreateCtxLength;
+	uint32_t LeaseState = 0;
 	smb2fid_t smb2fid;
 	uint32_t status;
 	int skip;
@@ -171,10 +173,12 @@ smb2_create(smb_request_t *sr)
 		op->op_oplock_level = SMB_OPLOCK_BATCH;
 		break;
 	case SMB2_OPLOCK_LEVEL_LEASE:
-		status = NT_STATUS_INVALID_PARAMETER;
-		goto errout;
+		/* Taken from the lease context, if any (below). */
+		op->op_oplock_level = SMB_OPLOCK_NONE;
+		break;
 	}
 	op->op_oplock_levelII = B_TRUE;
+	op->op_lease = B_FALSE;
 
 	/*
 	 * ImpersonationLevel (spec. says ignore)
@@ -265,6 +269,25 @@ smb2_create(smb_request_t *sr)
 			smb_time_nt_to_unix(timewarp, &op->timewarp);
 			op->create_timewarp = B_TRUE;
 		}
+
+		/*
+		 * SMB 2.1 lease request [MS-SMB2] 2.2.13.2.8
+		 * Ignored unless the oplock level says to use it.
+		 */
+		if ((cctx.cc_in_flags & CCTX_REQUEST_LEASE) != 0 &&
+		    OplockLevel == SMB2_OPLOCK_LEVEL_LEASE &&
+		    sr->session->dialect >= SMB_VERS_2_1) {
+			cce = &cctx.cc_in_req_lease;
+			rc = smb_mbc_decodef(&cce->cce_mbc, "#cl",
+			    SMB_LEASE_KEY_SZ, op->op_lease_key, &LeaseState);
+			if (rc) {
+				status = NT_STATUS_INVALID_PARAMETER;
+				goto errout;
+			}
+			op->op_lease = B_TRUE;
+			op->op_oplock_level =
+			    smb2_lease_oplock_level(LeaseState);
+		}
 	}
 
 	/*
@@ -295,6 +318,10 @@ smb2_create(smb_request_t *sr)
 		OplockLevel = SMB2_OPLOCK_LEVEL_BATCH;
 		break;
 	}
+	if (op->op_lease) {
+		OplockLevel = SMB2_OPLOCK_LEVEL_LEASE;
+		LeaseState = smb2_oplock_lease_state(op->op_oplock_level);
+	}
 
 	/*
 	 * NB: after the above smb_common_open() success,
@@ -330,7 +357,6 @@ smb2_create(smb_request_t *sr)
 	 * We don't handle these yet.
 	 *	CCTX_DH_REQUEST
 	 *	CCTX_DH_RECONNECT
-	 *	CCTX_REQUEST_LEASE
 	 */
 	if (cctx.cc_in_flags & CCTX_QUERY_MAX_ACCESS) {
 		cce = &cctx.cc_out_max_access;
@@ -362,6 +388,20 @@ smb2_create(smb_request_t *sr)
 		/* reserved (16 bytes)  .15. */
 		cctx.cc_out_flags |= CCTX_QUERY_ON_DISK_ID;
 	}
+	if (op->op_lease) {
+		cce = &cctx.cc_out_req_lease;
+
+		cce->cce_len = 32;
+		cce->cce_mbc.max_bytes = 32;
+		(void) smb_mbc_encodef(
+		    &cce->cce_mbc, "#cll8.",
+		    SMB_LEASE_KEY_SZ,	/* # */
+		    op->op_lease_key,	/* c */
+		    LeaseState,		/* l */
+		    0);			/* LeaseFlags l */
+		/* LeaseDuration (8 bytes)  8. */
+		cctx.cc_out_flags |= CCTX_REQUEST_LEASE;
+	}
 	if (cctx.cc_out_flags) {
 		sr->raw_data.max_bytes = smb2_max_trans;
 		status = smb2_encode_create_ctx(&sr->raw_data, &cctx);
@@ -598,6 +638,17 @@ smb2_encode_create_ctx(mbuf_chain_t *mbc, smb2_create_ctx_t *cc)
 		    mbc->chain_offset - last_top);
 	}
 
+	if (cc->cc_out_flags & CCTX_REQUEST_LEASE) {
+		cce = &cc->cc_out_req_lease;
+		last_top = mbc->chain_offset;
+		rc = smb2_encode_create_ctx_elem(mbc, cce,
+		    SMB2_CREATE_REQUEST_LEASE);
+		if (rc)
+			return (NT_STATUS_INTERNAL_ERROR);
+		(void) smb_mbc_poke(mbc, last_top, "l",
+		    mbc->chain_offset - last_top);
+	}
+
 	if (last_top >= 0)
 		(void) smb_mbc_poke(mbc, last_top, "l", 0);
 
@@ -665,4 +716,8 @@ smb2_free_create_ctx(smb2_create_ctx_t *cc)
 		cce = &cc->cc_out_file_id;
 		MBC_FLUSH(&cce->cce_mbc);
 	}
+	if (cc->cc_out_flags & CCTX_REQUEST_LEASE) {
+		cce = &cc->cc_out_req_lease;
+		MBC_FLUSH(&cce->cce_mbc);
+	}
 }
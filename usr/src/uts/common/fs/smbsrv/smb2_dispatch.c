@@ -68,6 +68,11 @@ void smb2sr_do_async(smb_request_t *);
 smb_sdrc_t smb2_invalid_cmd(smb_request_t *);
 static void smb2_tq_work(void *);
 
+/*
+ * Grant credits beyond what a busy client asks for; see smb2sr_work.
+ */
+int smb2_credit_autogrow = 1;
+
 static const smb_disp_entry_t const
 smb2_disp_table[SMB2__NCMDS] = {
 
@@ -576,7 +581,8 @@ cmd_start:
 	 * that would take their credit over the maximum, and
 	 * limiting the decrease so they don't run out of credits.
 	 *
-	 * Later, this could do something dynamic based on load.
+	 * After the command, smb2_credit_autogrow may add to that
+	 * grant based on how many requests the client has in progress.
 	 *
 	 * One other non-obvious bit about credits: We keep the
 	 * session s_max_credits low until the 1st authentication,
@@ -671,6 +677,38 @@ cmd_start:
 		mutex_exit(&session->s_credits_mutex);
 	}
 
+	/*
+	 * Grow the credit window with the client's parallelism.
+	 * Clients mostly ask for just the credits they spend, so
+	 * one issuing many large multi-credit READs and WRITEs can
+	 * stall on credits well below s_max_credits.  If the
+	 * requests this session has in progress could consume half
+	 * of its credits, grant this command's charge once more.
+	 * The in-progress count is only a hint, so no list lock.
+	 */
+	if (smb2_credit_autogrow && sr->smb2_status == 0 &&
+	    session->s_max_credits > 1) {
+		uint32_t busy;
+		uint16_t cur, d;
+
+		busy = session->s_req_list.sl_count * sr->smb2_credit_charge;
+		mutex_enter(&session->s_credits_mutex);
+		cur = session->s_cur_credits;
+		if (cur < session->s_max_credits && busy >= cur / 2) {
+			d = MIN(sr->smb2_credit_charge,
+			    session->s_max_credits - cur);
+			cur += d;
+			sr->smb2_credit_response += d;
+
+			DTRACE_PROBE3(smb2__credit__grow,
+			    smb_request_t, sr, int, (int)cur,
+			    int, (int)session->s_cur_credits);
+
+			session->s_cur_credits = cur;
+		}
+		mutex_exit(&session->s_credits_mutex);
+	}
+
 cmd_done:
 	/*
 	 * Pad the reply to align(8) if necessary.
@@ -21,11 +21,17 @@
 #include <smbsrv/smb2.h>
 
 static int smb2_negotiate_common(smb_request_t *, uint16_t);
+static uint32_t smb2srv_caps(smb_session_t *);
 
 uint32_t smb2srv_capabilities =
 	SMB2_CAP_DFS |
 	SMB2_CAP_LARGE_MTU;
 
+/*
+ * Leases (SMB 2.1 and later) are advertised when this is set.
+ */
+int smb2_enable_leases = 1;
+
 /*
  * These are not intended as customer tunables, but dev. & test folks
  * might want to adjust them (with caution).
@@ -306,7 +312,7 @@ smb2_negotiate_common(smb_request_t *sr, uint16_t version)
 	    0, /* reserved */		/* w */
 	    UUID_LEN,			/* # */
 	    &s->s_cfg.skc_machine_uuid, /* c */
-	    smb2srv_capabilities,	/* l */
+	    smb2srv_caps(s),		/* l */
 	    smb2_max_trans,		/* l */
 	    smb2_max_rwsize,		/* l */
 	    smb2_max_rwsize,		/* l */
@@ -330,6 +336,20 @@ smb2_negotiate_common(smb_request_t *sr, uint16_t version)
 	return (rc);
 }
 
+/*
+ * Capabilities for the dialect negotiated on this session.
+ */
+static uint32_t
+smb2srv_caps(smb_session_t *s)
+{
+	uint32_t caps = smb2srv_capabilities;
+
+	if (s->dialect >= SMB_VERS_2_1 && smb2_enable_leases != 0)
+		caps |= SMB2_CAP_LEASING;
+
+	return (caps);
+}
+
 /*
  * SMB2 Dispatch table handler, which will run if we see an
  * SMB2_NEGOTIATE after the initial negotiation is done.
@@ -365,7 +385,7 @@ smb2_fsctl_vneginfo(smb_request_t *sr, smb_fsctl_t *fsctl)
 
 	rc = smb_mbc_encodef(
 	    fsctl->out_mbc, "l#cww",
-	    smb2srv_capabilities,	/* l */
+	    smb2srv_caps(s),		/* l */
 	    UUID_LEN,			/* # */
 	    &s->s_cfg.skc_machine_uuid, /* c */
 	    s->secmode,			/* w */
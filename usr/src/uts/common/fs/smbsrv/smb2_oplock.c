@@ -19,6 +19,44 @@
 
 #include <smbsrv/smb2_kproto.h>
 
+static smb_sdrc_t smb2_lease_break_ack(smb_request_t *);
+static void smb2_lease_break_notification(smb_request_t *, uint8_t);
+
+/*
+ * SMB 2.1 leases are implemented on top of oplocks: the lease state
+ * requested maps to the oplock level giving the same caching rights,
+ * and the state granted is the one that level allows.  Handle caching
+ * is only granted with write caching (as a BATCH oplock), because that
+ * is the only level broken when a handle causes a sharing conflict.
+ */
+uint8_t
+smb2_lease_oplock_level(uint32_t LeaseState)
+{
+	if ((LeaseState & SMB2_LEASE_READ_CACHING) == 0)
+		return (SMB_OPLOCK_NONE);
+	if ((LeaseState & SMB2_LEASE_WRITE_CACHING) == 0)
+		return (SMB_OPLOCK_LEVEL_II);
+	if ((LeaseState & SMB2_LEASE_HANDLE_CACHING) == 0)
+		return (SMB_OPLOCK_EXCLUSIVE);
+	return (SMB_OPLOCK_BATCH);
+}
+
+uint32_t
+smb2_oplock_lease_state(uint8_t level)
+{
+	switch (level) {
+	case SMB_OPLOCK_BATCH:
+		return (SMB2_LEASE_READ_CACHING | SMB2_LEASE_WRITE_CACHING |
+		    SMB2_LEASE_HANDLE_CACHING);
+	case SMB_OPLOCK_EXCLUSIVE:
+		return (SMB2_LEASE_READ_CACHING | SMB2_LEASE_WRITE_CACHING);
+	case SMB_OPLOCK_LEVEL_II:
+		return (SMB2_LEASE_READ_CACHING);
+	default:
+		return (SMB2_LEASE_NONE);
+	}
+}
+
 /*
  * SMB2 Oplock Break Acknowledgement
  * [MS-SMB2 2.2.24]
@@ -34,6 +72,15 @@ smb2_oplock_break_ack(smb_request_t *sr)
 	uint8_t brk;
 	int rc = 0;
 
+	/*
+	 * The Lease Break Acknowledgement shares the command code
+	 * and is told apart by its structure size.
+	 */
+	rc = smb_mbc_peek(&sr->smb_data, sr->smb_data.chain_offset, "w",
+	    &StructSize);
+	if (rc == 0 && StructSize == 36)
+		return (smb2_lease_break_ack(sr));
+
 	/*
 	 * Decode the SMB2 Oplock Break Ack.
 	 */
@@ -100,6 +147,80 @@ errout:
 	return (SDRC_SUCCESS);
 }
 
+/*
+ * SMB2 Lease Break Acknowledgement
+ * [MS-SMB2 2.2.24.2]
+ *
+ * The lease is found by key among the handles of this session.
+ */
+static smb_sdrc_t
+smb2_lease_break_ack(smb_request_t *sr)
+{
+	smb_session_t *session = sr->session;
+	smb_tree_t *tree;
+	smb_ofile_t *of = NULL;
+	uint8_t LeaseKey[SMB_LEASE_KEY_SZ];
+	uint32_t LeaseState;
+	uint32_t status;
+	uint16_t StructSize;
+	uint8_t brk;
+	int rc;
+
+	rc = smb_mbc_decodef(
+	    &sr->smb_data, "w6.#cl8.",
+	    &StructSize,		/* w */
+	    /* reserved, flags		  6. */
+	    SMB_LEASE_KEY_SZ,		/* # */
+	    LeaseKey,			/* c */
+	    &LeaseState);		/* l */
+	    /* duration			  8. */
+	if (rc || StructSize != 36)
+		return (SDRC_ERROR);
+
+	/* We only break to read caching or to none. */
+	if ((LeaseState & ~SMB2_LEASE_READ_CACHING) != 0) {
+		status = NT_STATUS_REQUEST_NOT_ACCEPTED;
+		goto errout;
+	}
+	if (LeaseState == SMB2_LEASE_READ_CACHING)
+		brk = SMB_OPLOCK_BREAK_TO_LEVEL_II;
+	else
+		brk = SMB_OPLOCK_BREAK_TO_NONE;
+
+	smb_llist_enter(&session->s_tree_list, RW_READER);
+	tree = smb_llist_head(&session->s_tree_list);
+	while (tree != NULL && of == NULL) {
+		of = smb_ofile_lookup_by_lease(tree, LeaseKey);
+		tree = smb_llist_next(&session->s_tree_list, tree);
+	}
+	smb_llist_exit(&session->s_tree_list);
+	if (of == NULL) {
+		status = NT_STATUS_OBJECT_NAME_NOT_FOUND;
+		goto errout;
+	}
+
+	smb_oplock_ack(of->f_node, of, brk);
+	smb_ofile_release(of);
+
+	/*
+	 * Generate SMB2 Lease Break response
+	 * [MS-SMB2] 2.2.25.2
+	 */
+	(void) smb_mbc_encodef(
+	    &sr->reply, "w6.#cl8.",
+	    36,				/* w */
+	    /* reserved, flags		  6. */
+	    SMB_LEASE_KEY_SZ,		/* # */
+	    LeaseKey,			/* c */
+	    LeaseState);		/* l */
+	    /* duration			  8. */
+	return (SDRC_SUCCESS);
+
+errout:
+	smb2sr_put_error(sr, status);
+	return (SDRC_SUCCESS);
+}
+
 /*
  * Compose an SMB2 Oplock Break Notification packet, including
  * the SMB2 header and everything, in sr->reply.
@@ -125,6 +246,11 @@ smb2_oplock_break_notification(smb_request_t *sr, uint8_t brk)
 		break;
 	}
 
+	if (ofile->f_lease) {
+		smb2_lease_break_notification(sr, brk);
+		return;
+	}
+
 	/*
 	 * SMB2 Header
 	 */
@@ -150,3 +276,52 @@ smb2_oplock_break_notification(smb_request_t *sr, uint8_t brk)
 	    smb2fid.persistent,	/* q */
 	    smb2fid.temporal);	/* q */
 }
+
+/*
+ * Compose an SMB2 Lease Break Notification [MS-SMB2] 2.2.23.2 for
+ * the lease the ofile in sr was opened under.  Only breaks away from
+ * write or handle caching await an acknowledgement.
+ */
+static void
+smb2_lease_break_notification(smb_request_t *sr, uint8_t brk)
+{
+	smb_ofile_t *ofile = sr->fid_ofile;
+	uint32_t CurState, NewState;
+	uint32_t Flags = 0;
+
+	CurState = smb2_oplock_lease_state(sr->arg.olbrk.og_level);
+	if (brk == SMB_OPLOCK_BREAK_TO_LEVEL_II)
+		NewState = CurState & SMB2_LEASE_READ_CACHING;
+	else
+		NewState = SMB2_LEASE_NONE;
+	if ((CurState & (SMB2_LEASE_WRITE_CACHING |
+	    SMB2_LEASE_HANDLE_CACHING)) != 0)
+		Flags = SMB2_NOTIFY_BREAK_LEASE_FLAG_ACK_REQUIRED;
+
+	/*
+	 * SMB2 Header
+	 */
+	sr->smb2_cmd_code = SMB2_OPLOCK_BREAK;
+	sr->smb2_hdr_flags = SMB2_FLAGS_SERVER_TO_REDIR;
+	sr->smb_tid = 0;
+	sr->smb_pid = 0;
+	sr->smb_uid = 0;
+	sr->smb2_messageid = UINT64_MAX;
+	(void) smb2_encode_header(sr, B_FALSE);
+
+	/*
+	 * SMB2 Lease Break, variable part
+	 */
+	(void) smb_mbc_encodef(
+	    &sr->reply, "w..l#clllll",
+	    44,			/* StructSize	w */
+	    /* new epoch	  .. */
+	    Flags,		/* l */
+	    SMB_LEASE_KEY_SZ,	/* # */
+	    ofile->f_lease_key,	/* c */
+	    CurState,		/* l */
+	    NewState,		/* l */
+	    0,			/* BreakReason	l */
+	    0,			/* AccessMaskHint l */
+	    0);			/* ShareMaskHint l */
+}
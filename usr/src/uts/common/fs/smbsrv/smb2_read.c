@@ -20,12 +20,20 @@
 #include <smbsrv/smb2_kproto.h>
 #include <smbsrv/smb_fsops.h>
 
+/*
+ * Serve disk reads from buffers loaned by the file system where it
+ * can, rather than copying into buffers of our own.
+ */
+int smb2_read_loaned = 1;
+
 smb_sdrc_t
 smb2_read(smb_request_t *sr)
 {
 	smb_ofile_t *of = NULL;
 	smb_vdb_t *vdb = NULL;
 	struct mbuf *m = NULL;
+	struct uio *uio;
+	struct uio *loan = NULL;
 	uint16_t StructSize;
 	uint8_t Padding;
 	uint8_t DataOff;
@@ -85,10 +93,10 @@ smb2_read(smb_request_t *sr)
 	vdb->vdb_uio.uio_resid = Length;
 	vdb->vdb_uio.uio_loffset = (offset_t)Offset;
 	vdb->vdb_uio.uio_segflg = UIO_SYSSPACE;
-	vdb->vdb_uio.uio_extflg = UIO_COPY_DEFAULT;
+	vdb->vdb_uio.uio_extflg = UIO_COPY_DEFAULT | UIO_COPY_OFFLOAD;
 
 	sr->raw_data.max_bytes = Length;
-	m = smb_mbuf_allocate(&vdb->vdb_uio);
+	uio = &vdb->vdb_uio;
 
 	switch (of->f_tree->t_res_type & STYPE_MASK) {
 	case STYPE_DISKTREE:
@@ -100,11 +108,19 @@ smb2_read(smb_request_t *sr)
 				rc = ERANGE;
 				break;
 			}
+			if (smb2_read_loaned && Length != 0)
+				loan = smb_mbuf_loan_get(of->f_node->vp,
+				    (offset_t)Offset, Length);
 		}
-		rc = smb_fsop_read(sr, of->f_cr, of->f_node, &vdb->vdb_uio);
+		if (loan != NULL)
+			uio = loan;
+		else
+			m = smb_mbuf_allocate(uio);
+		rc = smb_fsop_read(sr, of->f_cr, of->f_node, uio);
 		break;
 	case STYPE_IPC:
-		rc = smb_opipe_read(sr, &vdb->vdb_uio);
+		m = smb_mbuf_allocate(uio);
+		rc = smb_opipe_read(sr, uio);
 		break;
 	default:
 	case STYPE_PRINTQ:
@@ -113,10 +129,13 @@ smb2_read(smb_request_t *sr)
 	}
 
 	/* How much data we moved. */
-	XferCount = Length - vdb->vdb_uio.uio_resid;
+	XferCount = Length - uio->uio_resid;
 
 	sr->raw_data.max_bytes = XferCount;
-	smb_mbuf_trim(m, XferCount);
+	if (loan != NULL)
+		m = smb_mbuf_loan_chain(loan, rc ? 0 : XferCount);
+	else
+		smb_mbuf_trim(m, XferCount);
 	MBC_ATTACH_MBUF(&sr->raw_data, m);
 
 	/*
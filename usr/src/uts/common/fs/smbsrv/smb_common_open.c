@@ -930,6 +930,8 @@ smb_open_subr(smb_request_t *sr)
  * If overwriting, break to SMB_OPLOCK_NONE, else
  * If opening for anything other than attribute access,
  * break oplock to LEVEL_II.
+ * Nothing is broken for an open under the lease already holding
+ * the oplock.
  */
 static void
 smb_open_oplock_break(smb_request_t *sr, smb_node_t *node)
@@ -937,6 +939,9 @@ smb_open_oplock_break(smb_request_t *sr, smb_node_t *node)
 	smb_arg_open_t	*op = &sr->sr_open;
 	uint32_t	flags = 0;
 
+	if (smb_oplock_lease_held(sr, node))
+		return;
+
 	if (!smb_node_share_check(node))
 		flags |= SMB_OPLOCK_BREAK_BATCH;
 
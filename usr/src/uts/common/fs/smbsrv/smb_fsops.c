@@ -1439,7 +1439,7 @@ smb_fsop_read(smb_request_t *sr, cred_t *cr, smb_node_t *snode, uio_t *uio)
 	ct = smb_ct;
 	ct.cc_pid = sr->fid_ofile->f_uniqid;
 	rc = nbl_lock_conflict(snode->vp, NBL_READ, uio->uio_loffset,
-	    uio->uio_iov->iov_len, svmand, &ct);
+	    uio->uio_resid, svmand, &ct);
 
 	if (rc) {
 		smb_node_end_crit(snode);
@@ -60,6 +60,9 @@
 
 #include <smbsrv/smb_kproto.h>
 #include <smbsrv/smb_kstat.h>
+#include <sys/atomic.h>
+
+extern caller_context_t smb_ct;
 
 static kmem_cache_t	*smb_mbc_cache = NULL;
 static kmem_cache_t	*smb_mbuf_cache = NULL;
@@ -190,8 +193,11 @@ smb_mbuf_allocate(struct uio *uio)
 
 	MGET(m, M_WAIT, MT_DATA);
 	if (len > MCLBYTES) {
-		/* Like MCLGET(), but bigger buf. */
-		m->m_ext.ext_buf = kmem_zalloc(len, KM_SLEEP);
+		/*
+		 * Like MCLGET(), but bigger buf.  The read overwrites
+		 * what smb_mbuf_trim() keeps, so no need to zero it.
+		 */
+		m->m_ext.ext_buf = kmem_alloc(len, KM_SLEEP);
 		m->m_data = m->m_ext.ext_buf;
 		m->m_flags |= M_EXT;
 		m->m_ext.ext_size = len;
@@ -209,6 +215,113 @@ smb_mbuf_allocate(struct uio *uio)
 	return (m);
 }
 
+/*
+ * Buffers loaned by the file system for one read (see VOP_REQZCBUF),
+ * shared by the mbufs smb_mbuf_loan_chain() builds on them.  For those
+ * mbufs, m_ext.ext_buf points to this rather than to the data, which
+ * only the ext_ref function looks at.
+ */
+typedef struct smb_mbuf_loan {
+	xuio_t		ml_xuio;	/* must be first */
+	vnode_t		*ml_vp;
+	uint32_t	ml_ref;
+} smb_mbuf_loan_t;
+
+static void
+smb_mbuf_loan_rele(smb_mbuf_loan_t *ml)
+{
+	if (atomic_dec_32_nv(&ml->ml_ref) != 0)
+		return;
+	(void) VOP_RETZCBUF(ml->ml_vp, &ml->ml_xuio, NULL, NULL);
+	VN_RELE(ml->ml_vp);
+	kmem_free(ml, sizeof (*ml));
+}
+
+/* ARGSUSED */
+static int
+smb_mbuf_loan_ref(void *p, uint_t sz, int incr)
+{
+	if (incr < 0)
+		smb_mbuf_loan_rele(p);
+	return (0);
+}
+
+/*
+ * Ask the file system to loan its own buffers for a read of len bytes
+ * at off in vp, so the reply can be built on them without a copy.
+ * Returns the uio to read into, or NULL if the file system declines
+ * (not ZFS, a small or mmapped file), in which case the caller reads
+ * into smb_mbuf_allocate() buffers as usual.  The uio must be passed
+ * to smb_mbuf_loan_chain() after the read, whether it failed or not.
+ */
+struct uio *
+smb_mbuf_loan_get(vnode_t *vp, offset_t off, uint32_t len)
+{
+	smb_mbuf_loan_t	*ml;
+	uio_t		*uio;
+
+	ml = kmem_zalloc(sizeof (*ml), KM_SLEEP);
+	ml->ml_xuio.xu_type = UIOTYPE_ZEROCOPY;
+	uio = &ml->ml_xuio.xu_uio;
+	uio->uio_segflg = UIO_SYSSPACE;
+	uio->uio_loffset = off;
+	uio->uio_resid = len;
+
+	if (VOP_REQZCBUF(vp, UIO_READ, &ml->ml_xuio, zone_kcred(),
+	    &smb_ct) != 0) {
+		kmem_free(ml, sizeof (*ml));
+		return (NULL);
+	}
+
+	/* Held until VOP_RETZCBUF() */
+	VN_HOLD(vp);
+	ml->ml_vp = vp;
+	ml->ml_ref = 1;
+	return (uio);
+}
+
+/*
+ * Build an mbuf chain on the first nbytes read into the buffers loaned
+ * for uio, and drop the caller's hold on the loan.  The buffers go back
+ * to the file system once the last of these mbufs is freed, normally
+ * after the reply has been sent.  With nbytes zero this returns NULL
+ * and just gives the buffers back.
+ */
+struct mbuf *
+smb_mbuf_loan_chain(struct uio *uio, int nbytes)
+{
+	smb_mbuf_loan_t	*ml = (smb_mbuf_loan_t *)uio;
+	struct mbuf	*mhead = NULL;
+	struct mbuf	**mpp = &mhead;
+	struct mbuf	*m;
+	iovec_t		*iov;
+	int		i, len;
+
+	for (i = 0, iov = uio->uio_iov;
+	    i < uio->uio_iovcnt && nbytes > 0; i++, iov++) {
+		if (iov->iov_len == 0)
+			continue;
+		len = MIN(iov->iov_len, nbytes);
+
+		MGET(m, M_WAIT, MT_DATA);
+		m->m_ext.ext_buf = (caddr_t)ml;
+		/* No room to append; mbc_marshal_make_room() adds an mbuf */
+		m->m_ext.ext_size = len;
+		m->m_ext.ext_ref = smb_mbuf_loan_ref;
+		m->m_flags |= M_EXT;
+		m->m_data = iov->iov_base;
+		m->m_len = len;
+		atomic_inc_32(&ml->ml_ref);
+
+		*mpp = m;
+		mpp = &m->m_next;
+		nbytes -= len;
+	}
+	smb_mbuf_loan_rele(ml);
+
+	return (mhead);
+}
+
 /*
  * Trim an mbuf chain to nbytes.
  */
@@ -244,6 +244,12 @@ smb_ofile_open(
 		if ((of->f_granted_access & FILE_DATA_ALL) == FILE_EXECUTE)
 			of->f_flags |= SMB_OFLAGS_EXECONLY;
 
+		if (op->op_lease) {
+			of->f_lease = B_TRUE;
+			bcopy(op->op_lease_key, of->f_lease_key,
+			    SMB_LEASE_KEY_SZ);
+		}
+
 		bzero(&attr, sizeof (smb_attr_t));
 		attr.sa_mask = SMB_AT_UID | SMB_AT_DOSATTR;
 		rc = smb_node_getattr(NULL, node, of->f_cr, NULL, &attr);
@@ -709,6 +715,43 @@ smb_ofile_lookup_by_uniqid(smb_tree_t *tree, uint32_t uniqid)
 	return (NULL);
 }
 
+/*
+ * smb_ofile_lookup_by_lease
+ *
+ * Find an open file on the tree that was opened under the lease key
+ * specified.  SMB2 lease break acknowledgements carry only the key.
+ */
+smb_ofile_t *
+smb_ofile_lookup_by_lease(smb_tree_t *tree, const uint8_t *key)
+{
+	smb_llist_t	*of_list;
+	smb_ofile_t	*of;
+
+	ASSERT(tree->t_magic == SMB_TREE_MAGIC);
+
+	of_list = &tree->t_ofile_list;
+	smb_llist_enter(of_list, RW_READER);
+	of = smb_llist_head(of_list);
+
+	while (of) {
+		ASSERT(of->f_magic == SMB_OFILE_MAGIC);
+		ASSERT(of->f_tree == tree);
+
+		if (of->f_lease &&
+		    bcmp(of->f_lease_key, key, SMB_LEASE_KEY_SZ) == 0) {
+			if (smb_ofile_hold(of)) {
+				smb_llist_exit(of_list);
+				return (of);
+			}
+		}
+
+		of = smb_llist_next(of_list, of);
+	}
+
+	smb_llist_exit(of_list);
+	return (NULL);
+}
+
 /*
  * Disallow NetFileClose on certain ofiles to avoid side-effects.
  * Closing a tree root is not allowed: use NetSessionDel or NetShareDel.
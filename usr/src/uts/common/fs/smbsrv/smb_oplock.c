@@ -59,6 +59,11 @@ static int smb_oplock_insert_grant(smb_node_t *, smb_oplock_grant_t *);
 static void smb_oplock_remove_grant(smb_node_t *, smb_oplock_grant_t *);
 static smb_oplock_grant_t *smb_oplock_exclusive_grant(list_t *);
 static smb_oplock_grant_t *smb_oplock_get_grant(smb_oplock_t *, smb_ofile_t *);
+static boolean_t smb_oplock_lease_match(smb_ofile_t *, smb_session_t *,
+    const uint8_t *);
+static smb_ofile_t *smb_oplock_lease_successor(smb_node_t *, smb_ofile_t *);
+static void smb_oplock_move_grant(smb_node_t *, smb_oplock_grant_t *,
+    smb_ofile_t *);
 
 static void smb_oplock_sched_async_break(smb_oplock_grant_t *, uint8_t);
 static void smb_oplock_exec_async_break(void *);
@@ -126,6 +131,10 @@ int smb_oplocks_enabled = 1;
  * - there are any range locks on the node (SMB writers)
  * Otherwise, grant LEVEL_II.
  *
+ * An SMB2 open under the lease key of a handle the same client holds
+ * the exclusive grant on shares that grant: the lease, not the
+ * handle, owns the caching state, so such opens never conflict.
+ *
  * ol->ol_xthread is set to the current thread to lock the oplock against
  * other operations until the acquire response is on the wire. When the
  * acquire response is on the wire, smb_oplock_broadcast() is called to
@@ -165,6 +174,16 @@ smb_oplock_acquire(smb_request_t *sr, smb_node_t *node, smb_ofile_t *ofile)
 	mutex_enter(&ol->ol_mutex);
 	smb_oplock_wait(node);
 
+	if (op->op_lease) {
+		og = smb_oplock_exclusive_grant(grants);
+		if (og != NULL && smb_oplock_lease_match(og->og_ofile,
+		    session, op->op_lease_key)) {
+			op->op_oplock_level = og->og_level;
+			mutex_exit(&ol->ol_mutex);
+			return;
+		}
+	}
+
 	/*
 	 * Even if there are no other opens, we might want to
 	 * grant only a Level II (shared) oplock so we avoid
@@ -537,6 +556,38 @@ smb_oplock_timedout(smb_node_t *node)
 	ol->ol_break = SMB_OPLOCK_NO_BREAK;
 }
 
+/*
+ * smb_oplock_lease_held
+ *
+ * Determine whether the exclusive oplock on the node is held under
+ * the lease the SMB2 open in sr is requested with, in which case the
+ * open must not break it.
+ */
+boolean_t
+smb_oplock_lease_held(smb_request_t *sr, smb_node_t *node)
+{
+	smb_oplock_t		*ol;
+	smb_oplock_grant_t	*og;
+	boolean_t		held = B_FALSE;
+
+	SMB_NODE_VALID(node);
+	ol = &node->n_oplock;
+
+	if (!sr->sr_open.op_lease)
+		return (B_FALSE);
+
+	mutex_enter(&ol->ol_mutex);
+	smb_oplock_wait(node);
+
+	og = smb_oplock_exclusive_grant(&ol->ol_grants);
+	if (og != NULL)
+		held = smb_oplock_lease_match(og->og_ofile, sr->session,
+		    sr->sr_open.op_lease_key);
+
+	mutex_exit(&ol->ol_mutex);
+	return (held);
+}
+
 /*
  * smb_oplock_release
  *
@@ -544,19 +595,28 @@ smb_oplock_timedout(smb_node_t *node)
  * Wake any threads waiting for an oplock break acknowledgement for
  * this oplock.
  * This is called when the ofile is being closed.
+ *
+ * A lease outlives the handle it was granted on while other handles
+ * opened under it remain, so the grant moves to one of those.  A break
+ * in progress then stays pending, as the client acknowledges it by
+ * lease key rather than by handle.
  */
 void
 smb_oplock_release(smb_node_t *node, smb_ofile_t *of)
 {
 	smb_oplock_t		*ol;
 	smb_oplock_grant_t	*og;
+	smb_ofile_t		*nof;
 
 	ol = &node->n_oplock;
 	mutex_enter(&ol->ol_mutex);
 	smb_oplock_wait(node);
 
 	og = smb_oplock_get_grant(ol, of);
-	if (og) {
+	if (og && of->f_lease &&
+	    (nof = smb_oplock_lease_successor(node, of)) != NULL) {
+		smb_oplock_move_grant(node, og, nof);
+	} else if (og) {
 		smb_oplock_remove_grant(node, og);
 		smb_oplock_clear_grant(og);
 
@@ -594,8 +654,16 @@ smb_oplock_ack(smb_node_t *node, smb_ofile_t *of, uint8_t brk)
 	mutex_enter(&ol->ol_mutex);
 	smb_oplock_wait(node);
 
-	if ((ol->ol_break == SMB_OPLOCK_NO_BREAK) ||
-	    ((og = smb_oplock_get_grant(ol, of)) == NULL)) {
+	og = smb_oplock_get_grant(ol, of);
+	if (og == NULL && of->f_lease) {
+		/* Acknowledged through another handle of the lease. */
+		og = smb_oplock_exclusive_grant(&ol->ol_grants);
+		if (og != NULL && !smb_oplock_lease_match(og->og_ofile,
+		    of->f_session, of->f_lease_key))
+			og = NULL;
+	}
+
+	if ((ol->ol_break == SMB_OPLOCK_NO_BREAK) || (og == NULL)) {
 		mutex_exit(&ol->ol_mutex);
 		return;
 	}
@@ -790,3 +858,75 @@ smb_oplock_get_grant(smb_oplock_t *ol, smb_ofile_t *ofile)
 	else
 		return (NULL);
 }
+
+/*
+ * smb_oplock_lease_match
+ *
+ * Determine whether ofile was opened by the client of session under
+ * lease key.  Leases belong to the client, not to the connection.
+ */
+static boolean_t
+smb_oplock_lease_match(smb_ofile_t *ofile, smb_session_t *session,
+    const uint8_t *key)
+{
+	if (!ofile->f_lease)
+		return (B_FALSE);
+	if (bcmp(ofile->f_session->clnt_uuid, session->clnt_uuid,
+	    sizeof (session->clnt_uuid)) != 0)
+		return (B_FALSE);
+	return (bcmp(ofile->f_lease_key, key, SMB_LEASE_KEY_SZ) == 0);
+}
+
+/*
+ * smb_oplock_lease_successor
+ *
+ * Find another open handle on the node, without a grant of its own,
+ * opened under the same lease as ofile.  A handle found here in the
+ * open state will call smb_oplock_release for itself when it closes.
+ */
+static smb_ofile_t *
+smb_oplock_lease_successor(smb_node_t *node, smb_ofile_t *ofile)
+{
+	smb_ofile_t	*of;
+	boolean_t	open;
+
+	ASSERT(MUTEX_HELD(&node->n_oplock.ol_mutex));
+
+	smb_llist_enter(&node->n_ofile_list, RW_READER);
+	of = smb_llist_head(&node->n_ofile_list);
+	while (of != NULL) {
+		if (of != ofile && !SMB_OFILE_OPLOCK_GRANTED(of) &&
+		    smb_oplock_lease_match(of, ofile->f_session,
+		    ofile->f_lease_key)) {
+			mutex_enter(&of->f_mutex);
+			open = (of->f_state == SMB_OFILE_STATE_OPEN);
+			mutex_exit(&of->f_mutex);
+			if (open)
+				break;
+		}
+		of = smb_llist_next(&node->n_ofile_list, of);
+	}
+	smb_llist_exit(&node->n_ofile_list);
+	return (of);
+}
+
+/*
+ * smb_oplock_move_grant
+ *
+ * Move the grant og to ofile, keeping its place in the grant list
+ * (an exclusive grant is always the list head).
+ */
+static void
+smb_oplock_move_grant(smb_node_t *node, smb_oplock_grant_t *og,
+    smb_ofile_t *ofile)
+{
+	smb_oplock_t		*ol = &node->n_oplock;
+	smb_oplock_grant_t	*nog;
+
+	ASSERT(MUTEX_HELD(&ol->ol_mutex));
+
+	nog = smb_oplock_set_grant(ofile, og->og_level);
+	list_insert_after(&ol->ol_grants, og, nog);
+	list_remove(&ol->ol_grants, og);
+	smb_oplock_clear_grant(og);
+}
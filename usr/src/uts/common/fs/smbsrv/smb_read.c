@@ -381,7 +381,7 @@ smb_common_read(smb_request_t *sr, smb_rw_param_t *param)
 	vdb->vdb_uio.uio_resid = param->rw_count;
 	vdb->vdb_uio.uio_loffset = (offset_t)param->rw_offset;
 	vdb->vdb_uio.uio_segflg = UIO_SYSSPACE;
-	vdb->vdb_uio.uio_extflg = UIO_COPY_DEFAULT;
+	vdb->vdb_uio.uio_extflg = UIO_COPY_DEFAULT | UIO_COPY_OFFLOAD;
 
 	switch (sr->tid_tree->t_res_type & STYPE_MASK) {
 	case STYPE_DISKTREE:
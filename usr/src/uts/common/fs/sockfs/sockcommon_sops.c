@@ -33,6 +33,7 @@
 #include <sys/sysmacros.h>
 #include <sys/debug.h>
 #include <sys/cmn_err.h>
+#include <sys/cpuvar.h>
 
 #include <sys/stropts.h>
 #include <sys/socket.h>
@@ -586,7 +587,10 @@ so_sendmblk(struct sonode *so, struct nmsghdr *msg, int fflag,
 
 	SO_BLOCK_FALLBACK(so, SOP_SENDMBLK(so, msg, fflag, cr, mpp));
 
-	if ((so->so_mode & SM_SENDFILESUPP) == 0) {
+	/* kernel sockets may also hand down whole datagrams */
+	if ((so->so_mode & SM_SENDFILESUPP) == 0 &&
+	    (so->so_mode & (SM_KERNEL | SM_ATOMIC)) !=
+	    (SM_KERNEL | SM_ATOMIC)) {
 		SO_UNBLOCK_FALLBACK(so);
 		return (EOPNOTSUPP);
 	}
@@ -1354,6 +1358,20 @@ so_queue_msg_impl(struct sonode *so, mblk_t *mp,
 		return (0);
 	}
 
+	/*
+	 * A kernel consumer that asked for the data as it arrives gets it
+	 * here, in the protocol's receive context, and nothing is queued.
+	 */
+	if (so->so_krecv_cb != NULL) {
+		ksocket_krecv_f func = so->so_krecv_cb;
+		void *arg = so->so_krecv_arg;
+
+		mutex_exit(&so->so_lock);
+		func((ksocket_t)(uintptr_t)so, mp, msg_size, flags, arg);
+		mutex_enter(&so->so_lock);
+		goto space_check;
+	}
+
 	/* process the mblk via I/OAT if capable */
 	if (sodp != NULL && sodp->sod_enabled) {
 		if (DB_TYPE(mp) == M_DATA) {
@@ -1663,6 +1681,11 @@ so_recvmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 		return (error);
 	}
 
+	/* Let the protocol steer its input towards the reader. */
+	if (so->so_downcalls->sd_recv_cpu != NULL)
+		(*so->so_downcalls->sd_recv_cpu)(so->so_proto_handle,
+		    CPU->cpu_id);
+
 	suiop = sod_rcv_init(so, flags, &uiop);
 retry:
 	saved_resid = uiop->uio_resid;
@@ -64,6 +64,7 @@
 #include <sys/cpuvar.h>
 #include <sys/filio.h>
 #include <sys/sendfile.h>
+#include <sys/timer.h>
 #include <sys/ddi.h>
 #include <vm/seg.h>
 #include <vm/seg_map.h>
@@ -91,6 +92,12 @@ extern int	sockfs_defer_nl7c_init;
  */
 #define	MSG_MAXIOVLEN	16
 
+/*
+ * The most messages sendmmsg() and recvmmsg() will handle in one call;
+ * larger vectors are truncated, as the caller is told by the count.
+ */
+#define	MSG_MAXMMSGLEN	1024
+
 /*
  * Kernel component of socket creation.
  *
@@ -827,19 +834,21 @@ shutdown(int sock, int how, int version)
 }
 
 /*
- * Common receive routine.
+ * Receive one message on a socket the caller holds, and copy its name,
+ * control and flags out.  Returns an errno, and the number of bytes
+ * received in *lenp.
  */
-static ssize_t
-recvit(int sock,
+static int
+recvit_so(struct sonode *so,
+	file_t *fp,
 	struct nmsghdr *msg,
 	struct uio *uiop,
 	int flags,
 	socklen_t *namelenp,
 	socklen_t *controllenp,
-	int *flagsp)
+	int *flagsp,
+	ssize_t *lenp)
 {
-	struct sonode *so;
-	file_t *fp;
 	void *name;
 	socklen_t namelen;
 	void *control;
@@ -847,9 +856,6 @@ recvit(int sock,
 	ssize_t len;
 	int error;
 
-	if ((so = getsonode(sock, &error, &fp)) == NULL)
-		return (set_errno(error));
-
 	len = uiop->uio_resid;
 	uiop->uio_fmode = fp->f_flag;
 	uiop->uio_extflg = UIO_COPY_CACHED;
@@ -863,12 +869,9 @@ recvit(int sock,
 	    MSG_DONTWAIT | MSG_XPG4_2);
 
 	error = socket_recvmsg(so, msg, uiop, CRED());
-	if (error) {
-		releasef(sock);
-		return (set_errno(error));
-	}
+	if (error)
+		return (error);
 	lwp_stat_update(LWP_STAT_MSGRCV, 1);
-	releasef(sock);
 
 	error = copyout_name(name, namelen, namelenp,
 	    msg->msg_name, msg->msg_namelen);
@@ -928,7 +931,8 @@ recvit(int sock,
 		kmem_free(msg->msg_name, (size_t)msg->msg_namelen);
 	if (msg->msg_controllen != 0)
 		kmem_free(msg->msg_control, (size_t)msg->msg_controllen);
-	return (len - uiop->uio_resid);
+	*lenp = len - uiop->uio_resid;
+	return (0);
 
 err:
 	/*
@@ -942,7 +946,35 @@ err:
 		kmem_free(msg->msg_name, (size_t)msg->msg_namelen);
 	if (msg->msg_controllen != 0)
 		kmem_free(msg->msg_control, (size_t)msg->msg_controllen);
-	return (set_errno(error));
+	return (error);
+}
+
+/*
+ * Common receive routine.
+ */
+static ssize_t
+recvit(int sock,
+	struct nmsghdr *msg,
+	struct uio *uiop,
+	int flags,
+	socklen_t *namelenp,
+	socklen_t *controllenp,
+	int *flagsp)
+{
+	struct sonode *so;
+	file_t *fp;
+	ssize_t len;
+	int error;
+
+	if ((so = getsonode(sock, &error, &fp)) == NULL)
+		return (set_errno(error));
+
+	error = recvit_so(so, fp, msg, uiop, flags, namelenp, controllenp,
+	    flagsp, &len);
+	releasef(sock);
+	if (error != 0)
+		return (set_errno(error));
+	return (len);
 }
 
 /*
@@ -1016,34 +1048,29 @@ recvfrom(int sock, void *buffer, size_t len, int flags,
 }
 
 /*
- * Uses the MSG_XPG4_2 flag to determine if the caller is using
- * struct omsghdr or struct nmsghdr.
+ * Copy in the user's message header and iovecs for recvmsg() and
+ * recvmmsg(), and return in *namelenpp, *controllenpp and *flagspp where
+ * recvit() is to copy the results out to.  Uses the MSG_XPG4_2 flag to
+ * determine if the caller is using struct omsghdr or struct nmsghdr.
  */
-ssize_t
-recvmsg(int sock, struct nmsghdr *msg, int flags)
+static int
+recvmsg_copyin(struct nmsghdr *msg, int flags, model_t model,
+    struct nmsghdr *lmsgp, struct uio *auiop, struct iovec *aiov,
+    socklen_t **namelenpp, socklen_t **controllenpp, int **flagspp)
 {
 	STRUCT_DECL(nmsghdr, u_lmsg);
 	STRUCT_HANDLE(nmsghdr, umsgptr);
-	struct nmsghdr lmsg;
-	struct uio auio;
-	struct iovec aiov[MSG_MAXIOVLEN];
 	int iovcnt;
 	ssize_t len;
 	int i;
-	int *flagsp;
-	model_t	model;
-
-	dprint(1, ("recvmsg(%d, %p, %d)\n",
-	    sock, (void *)msg, flags));
 
-	model = get_udatamodel();
 	STRUCT_INIT(u_lmsg, model);
 	STRUCT_SET_HANDLE(umsgptr, model, msg);
 
 	if (flags & MSG_XPG4_2) {
 		if (copyin(msg, STRUCT_BUF(u_lmsg), STRUCT_SIZE(u_lmsg)))
-			return (set_errno(EFAULT));
-		flagsp = STRUCT_FADDR(umsgptr, msg_flags);
+			return (EFAULT);
+		*flagspp = STRUCT_FADDR(umsgptr, msg_flags);
 	} else {
 		/*
 		 * Assumes that nmsghdr and omsghdr are identically shaped
@@ -1051,9 +1078,9 @@ recvmsg(int sock, struct nmsghdr *msg, int flags)
 		 */
 		if (copyin(msg, STRUCT_BUF(u_lmsg),
 		    SIZEOF_STRUCT(omsghdr, model)))
-			return (set_errno(EFAULT));
+			return (EFAULT);
 		STRUCT_FSET(u_lmsg, msg_flags, 0);
-		flagsp = NULL;
+		*flagspp = NULL;
 	}
 
 	/*
@@ -1061,18 +1088,18 @@ recvmsg(int sock, struct nmsghdr *msg, int flags)
 	 * off msg_control and msg_name fields. This forces
 	 * us to copy the structure to its native form.
 	 */
-	lmsg.msg_name = STRUCT_FGETP(u_lmsg, msg_name);
-	lmsg.msg_namelen = STRUCT_FGET(u_lmsg, msg_namelen);
-	lmsg.msg_iov = STRUCT_FGETP(u_lmsg, msg_iov);
-	lmsg.msg_iovlen = STRUCT_FGET(u_lmsg, msg_iovlen);
-	lmsg.msg_control = STRUCT_FGETP(u_lmsg, msg_control);
-	lmsg.msg_controllen = STRUCT_FGET(u_lmsg, msg_controllen);
-	lmsg.msg_flags = STRUCT_FGET(u_lmsg, msg_flags);
+	lmsgp->msg_name = STRUCT_FGETP(u_lmsg, msg_name);
+	lmsgp->msg_namelen = STRUCT_FGET(u_lmsg, msg_namelen);
+	lmsgp->msg_iov = STRUCT_FGETP(u_lmsg, msg_iov);
+	lmsgp->msg_iovlen = STRUCT_FGET(u_lmsg, msg_iovlen);
+	lmsgp->msg_control = STRUCT_FGETP(u_lmsg, msg_control);
+	lmsgp->msg_controllen = STRUCT_FGET(u_lmsg, msg_controllen);
+	lmsgp->msg_flags = STRUCT_FGET(u_lmsg, msg_flags);
 
-	iovcnt = lmsg.msg_iovlen;
+	iovcnt = lmsgp->msg_iovlen;
 
 	if (iovcnt <= 0 || iovcnt > MSG_MAXIOVLEN) {
-		return (set_errno(EMSGSIZE));
+		return (EMSGSIZE);
 	}
 
 #ifdef _SYSCALL32_IMPL
@@ -1084,9 +1111,9 @@ recvmsg(int sock, struct nmsghdr *msg, int flags)
 		struct iovec32 aiov32[MSG_MAXIOVLEN];
 		ssize32_t count32;
 
-		if (copyin((struct iovec32 *)lmsg.msg_iov, aiov32,
+		if (copyin((struct iovec32 *)lmsgp->msg_iov, aiov32,
 		    iovcnt * sizeof (struct iovec32)))
-			return (set_errno(EFAULT));
+			return (EFAULT);
 
 		count32 = 0;
 		for (i = 0; i < iovcnt; i++) {
@@ -1095,51 +1122,74 @@ recvmsg(int sock, struct nmsghdr *msg, int flags)
 			iovlen32 = aiov32[i].iov_len;
 			count32 += iovlen32;
 			if (iovlen32 < 0 || count32 < 0)
-				return (set_errno(EINVAL));
+				return (EINVAL);
 			aiov[i].iov_len = iovlen32;
 			aiov[i].iov_base =
 			    (caddr_t)(uintptr_t)aiov32[i].iov_base;
 		}
 	} else
 #endif /* _SYSCALL32_IMPL */
-	if (copyin(lmsg.msg_iov, aiov, iovcnt * sizeof (struct iovec))) {
-		return (set_errno(EFAULT));
+	if (copyin(lmsgp->msg_iov, aiov, iovcnt * sizeof (struct iovec))) {
+		return (EFAULT);
 	}
 	len = 0;
 	for (i = 0; i < iovcnt; i++) {
 		ssize_t iovlen = aiov[i].iov_len;
 		len += iovlen;
 		if (iovlen < 0 || len < 0) {
-			return (set_errno(EINVAL));
+			return (EINVAL);
 		}
 	}
-	auio.uio_loffset = 0;
-	auio.uio_iov = aiov;
-	auio.uio_iovcnt = iovcnt;
-	auio.uio_resid = len;
-	auio.uio_segflg = UIO_USERSPACE;
-	auio.uio_limit = 0;
+	auiop->uio_loffset = 0;
+	auiop->uio_iov = aiov;
+	auiop->uio_iovcnt = iovcnt;
+	auiop->uio_resid = len;
+	auiop->uio_segflg = UIO_USERSPACE;
+	auiop->uio_limit = 0;
 
-	if (lmsg.msg_control != NULL &&
+	if (lmsgp->msg_control != NULL &&
 	    (do_useracc == 0 ||
-	    useracc(lmsg.msg_control, lmsg.msg_controllen,
+	    useracc(lmsgp->msg_control, lmsgp->msg_controllen,
 	    B_WRITE) != 0)) {
-		return (set_errno(EFAULT));
+		return (EFAULT);
 	}
 
-	return (recvit(sock, &lmsg, &auio, flags,
-	    STRUCT_FADDR(umsgptr, msg_namelen),
-	    STRUCT_FADDR(umsgptr, msg_controllen), flagsp));
+	*namelenpp = STRUCT_FADDR(umsgptr, msg_namelen);
+	*controllenpp = STRUCT_FADDR(umsgptr, msg_controllen);
+	return (0);
+}
+
+ssize_t
+recvmsg(int sock, struct nmsghdr *msg, int flags)
+{
+	struct nmsghdr lmsg;
+	struct uio auio;
+	struct iovec aiov[MSG_MAXIOVLEN];
+	socklen_t *namelenp, *controllenp;
+	int *flagsp;
+	int error;
+
+	dprint(1, ("recvmsg(%d, %p, %d)\n",
+	    sock, (void *)msg, flags));
+
+	error = recvmsg_copyin(msg, flags, get_udatamodel(), &lmsg, &auio,
+	    aiov, &namelenp, &controllenp, &flagsp);
+	if (error != 0)
+		return (set_errno(error));
+
+	return (recvit(sock, &lmsg, &auio, flags, namelenp, controllenp,
+	    flagsp));
 }
 
+
 /*
- * Common send function.
+ * Send one message on a socket the caller holds.  Returns an errno, and
+ * the number of bytes sent in *lenp.
  */
-static ssize_t
-sendit(int sock, struct nmsghdr *msg, struct uio *uiop, int flags)
+static int
+sendit_so(struct sonode *so, file_t *fp, struct nmsghdr *msg,
+    struct uio *uiop, int flags, ssize_t *lenp)
 {
-	struct sonode *so;
-	file_t *fp;
 	void *name;
 	socklen_t namelen;
 	void *control;
@@ -1147,9 +1197,6 @@ sendit(int sock, struct nmsghdr *msg, struct uio *uiop, int flags)
 	ssize_t len;
 	int error;
 
-	if ((so = getsonode(sock, &error, &fp)) == NULL)
-		return (set_errno(error));
-
 	uiop->uio_fmode = fp->f_flag;
 
 	if (so->so_family == AF_UNIX)
@@ -1210,13 +1257,32 @@ done2:
 	if (name != NULL)
 		kmem_free(name, namelen);
 done3:
-	if (error != 0) {
-		releasef(sock);
-		return (set_errno(error));
-	}
+	if (error != 0)
+		return (error);
 	lwp_stat_update(LWP_STAT_MSGSND, 1);
+	*lenp = len - uiop->uio_resid;
+	return (0);
+}
+
+/*
+ * Common send function.
+ */
+static ssize_t
+sendit(int sock, struct nmsghdr *msg, struct uio *uiop, int flags)
+{
+	struct sonode *so;
+	file_t *fp;
+	ssize_t len;
+	int error;
+
+	if ((so = getsonode(sock, &error, &fp)) == NULL)
+		return (set_errno(error));
+
+	error = sendit_so(so, fp, msg, uiop, flags, &len);
 	releasef(sock);
-	return (len - uiop->uio_resid);
+	if (error != 0)
+		return (set_errno(error));
+	return (len);
 }
 
 /*
@@ -1258,30 +1324,26 @@ send(int sock, void *buffer, size_t len, int flags)
 }
 
 /*
- * Uses the MSG_XPG4_2 flag to determine if the caller is using
- * struct omsghdr or struct nmsghdr.
+ * Copy in the user's message header and iovecs for sendmsg() and
+ * sendmmsg().  Uses the MSG_XPG4_2 flag to determine if the caller is
+ * using struct omsghdr or struct nmsghdr.
  */
-ssize_t
-sendmsg(int sock, struct nmsghdr *msg, int flags)
+static int
+sendmsg_copyin(struct nmsghdr *msg, int *flagsp, model_t model,
+    struct nmsghdr *lmsgp, struct uio *auiop, struct iovec *aiov)
 {
-	struct nmsghdr lmsg;
 	STRUCT_DECL(nmsghdr, u_lmsg);
-	struct uio auio;
-	struct iovec aiov[MSG_MAXIOVLEN];
+	int flags = *flagsp;
 	int iovcnt;
 	ssize_t len;
 	int i;
-	model_t	model;
-
-	dprint(1, ("sendmsg(%d, %p, %d)\n", sock, (void *)msg, flags));
 
-	model = get_udatamodel();
 	STRUCT_INIT(u_lmsg, model);
 
 	if (flags & MSG_XPG4_2) {
 		if (copyin(msg, (char *)STRUCT_BUF(u_lmsg),
 		    STRUCT_SIZE(u_lmsg)))
-			return (set_errno(EFAULT));
+			return (EFAULT);
 	} else {
 		/*
 		 * Assumes that nmsghdr and omsghdr are identically shaped
@@ -1289,7 +1351,7 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 		 */
 		if (copyin(msg, (char *)STRUCT_BUF(u_lmsg),
 		    SIZEOF_STRUCT(omsghdr, model)))
-			return (set_errno(EFAULT));
+			return (EFAULT);
 		/*
 		 * In order to be compatible with the libsocket/sockmod
 		 * implementation we set EOR for all send* calls.
@@ -1302,15 +1364,15 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 	 * off msg_control and msg_name fields. This forces
 	 * us to copy the structure to its native form.
 	 */
-	lmsg.msg_name = STRUCT_FGETP(u_lmsg, msg_name);
-	lmsg.msg_namelen = STRUCT_FGET(u_lmsg, msg_namelen);
-	lmsg.msg_iov = STRUCT_FGETP(u_lmsg, msg_iov);
-	lmsg.msg_iovlen = STRUCT_FGET(u_lmsg, msg_iovlen);
-	lmsg.msg_control = STRUCT_FGETP(u_lmsg, msg_control);
-	lmsg.msg_controllen = STRUCT_FGET(u_lmsg, msg_controllen);
-	lmsg.msg_flags = STRUCT_FGET(u_lmsg, msg_flags);
+	lmsgp->msg_name = STRUCT_FGETP(u_lmsg, msg_name);
+	lmsgp->msg_namelen = STRUCT_FGET(u_lmsg, msg_namelen);
+	lmsgp->msg_iov = STRUCT_FGETP(u_lmsg, msg_iov);
+	lmsgp->msg_iovlen = STRUCT_FGET(u_lmsg, msg_iovlen);
+	lmsgp->msg_control = STRUCT_FGETP(u_lmsg, msg_control);
+	lmsgp->msg_controllen = STRUCT_FGET(u_lmsg, msg_controllen);
+	lmsgp->msg_flags = STRUCT_FGET(u_lmsg, msg_flags);
 
-	iovcnt = lmsg.msg_iovlen;
+	iovcnt = lmsgp->msg_iovlen;
 
 	if (iovcnt <= 0 || iovcnt > MSG_MAXIOVLEN) {
 		/*
@@ -1318,7 +1380,7 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 		 * be compatible with SunOS 4.X and 4.4BSD.
 		 */
 		if (iovcnt != 0 || (flags & MSG_XPG4_2))
-			return (set_errno(EMSGSIZE));
+			return (EMSGSIZE);
 	}
 
 #ifdef _SYSCALL32_IMPL
@@ -1331,9 +1393,9 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 		ssize32_t count32;
 
 		if (iovcnt != 0 &&
-		    copyin((struct iovec32 *)lmsg.msg_iov, aiov32,
+		    copyin((struct iovec32 *)lmsgp->msg_iov, aiov32,
 		    iovcnt * sizeof (struct iovec32)))
-			return (set_errno(EFAULT));
+			return (EFAULT);
 
 		count32 = 0;
 		for (i = 0; i < iovcnt; i++) {
@@ -1342,7 +1404,7 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 			iovlen32 = aiov32[i].iov_len;
 			count32 += iovlen32;
 			if (iovlen32 < 0 || count32 < 0)
-				return (set_errno(EINVAL));
+				return (EINVAL);
 			aiov[i].iov_len = iovlen32;
 			aiov[i].iov_base =
 			    (caddr_t)(uintptr_t)aiov32[i].iov_base;
@@ -1350,28 +1412,208 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 	} else
 #endif /* _SYSCALL32_IMPL */
 	if (iovcnt != 0 &&
-	    copyin(lmsg.msg_iov, aiov,
+	    copyin(lmsgp->msg_iov, aiov,
 	    (unsigned)iovcnt * sizeof (struct iovec))) {
-		return (set_errno(EFAULT));
+		return (EFAULT);
 	}
 	len = 0;
 	for (i = 0; i < iovcnt; i++) {
 		ssize_t iovlen = aiov[i].iov_len;
 		len += iovlen;
 		if (iovlen < 0 || len < 0) {
-			return (set_errno(EINVAL));
+			return (EINVAL);
 		}
 	}
-	auio.uio_loffset = 0;
-	auio.uio_iov = aiov;
-	auio.uio_iovcnt = iovcnt;
-	auio.uio_resid = len;
-	auio.uio_segflg = UIO_USERSPACE;
-	auio.uio_limit = 0;
+	auiop->uio_loffset = 0;
+	auiop->uio_iov = aiov;
+	auiop->uio_iovcnt = iovcnt;
+	auiop->uio_resid = len;
+	auiop->uio_segflg = UIO_USERSPACE;
+	auiop->uio_limit = 0;
+
+	*flagsp = flags;
+	return (0);
+}
+
+ssize_t
+sendmsg(int sock, struct nmsghdr *msg, int flags)
+{
+	struct nmsghdr lmsg;
+	struct uio auio;
+	struct iovec aiov[MSG_MAXIOVLEN];
+	int error;
+
+	dprint(1, ("sendmsg(%d, %p, %d)\n", sock, (void *)msg, flags));
+
+	error = sendmsg_copyin(msg, &flags, get_udatamodel(), &lmsg, &auio,
+	    aiov);
+	if (error != 0)
+		return (set_errno(error));
 
 	return (sendit(sock, &lmsg, &auio, flags));
 }
 
+/*
+ * A struct mmsghdr is the caller's message header, a struct nmsghdr or
+ * (without MSG_XPG4_2) a struct omsghdr, followed by msg_len and padded
+ * to the alignment of a pointer.  Return its size, and in *lenoffp the
+ * offset of msg_len.
+ */
+static size_t
+mmsghdr_size(int flags, model_t model, size_t *lenoffp)
+{
+	size_t hdrsize;
+
+	if (flags & MSG_XPG4_2)
+		hdrsize = SIZEOF_STRUCT(nmsghdr, model);
+	else
+		hdrsize = SIZEOF_STRUCT(omsghdr, model);
+	*lenoffp = hdrsize;
+	return (P2ROUNDUP(hdrsize + sizeof (uint_t),
+	    model == DATAMODEL_LP64 ? sizeof (uint64_t) : sizeof (uint32_t)));
+}
+
+/*
+ * Send up to vlen messages with one system call, looking the socket up
+ * only once.  The length of each message sent is stored in its msg_len.
+ * Returns the number of messages sent; an error is only returned if the
+ * first message could not be sent.
+ */
+int
+sendmmsg(int sock, struct mmsghdr *vec, uint_t vlen, int flags)
+{
+	struct sonode *so;
+	file_t *fp;
+	struct nmsghdr lmsg;
+	struct uio auio;
+	struct iovec aiov[MSG_MAXIOVLEN];
+	model_t model;
+	caddr_t umsg;
+	size_t stride, lenoff;
+	ssize_t len;
+	uint_t count, mlen;
+	int mflags;
+	int error;
+
+	dprint(1, ("sendmmsg(%d, %p, %u, %d)\n",
+	    sock, (void *)vec, vlen, flags));
+
+	model = get_udatamodel();
+	stride = mmsghdr_size(flags, model, &lenoff);
+	vlen = MIN(vlen, MSG_MAXMMSGLEN);
+
+	if ((so = getsonode(sock, &error, &fp)) == NULL)
+		return (set_errno(error));
+
+	for (count = 0; count < vlen; count++) {
+		umsg = (caddr_t)vec + count * stride;
+		mflags = flags;
+		error = sendmsg_copyin((struct nmsghdr *)umsg, &mflags, model,
+		    &lmsg, &auio, aiov);
+		if (error == 0)
+			error = sendit_so(so, fp, &lmsg, &auio, mflags, &len);
+		if (error != 0)
+			break;
+		mlen = (uint_t)len;
+		if (copyout(&mlen, umsg + lenoff, sizeof (mlen)) != 0) {
+			error = EFAULT;
+			break;
+		}
+	}
+	releasef(sock);
+
+	if (count == 0 && error != 0)
+		return (set_errno(error));
+	return (count);
+}
+
+/*
+ * Receive up to vlen messages with one system call, looking the socket up
+ * only once.  The length of each message received is stored in its
+ * msg_len.  With MSG_WAITFORONE only the first message is waited for.  The
+ * timeout, if any, is checked after each message, so it bounds the time
+ * spent collecting a batch rather than the wait for the first message.
+ * Returns the number of messages received; an error is only returned if
+ * no message was received.
+ */
+int
+recvmmsg(int sock, struct mmsghdr *vec, uint_t vlen, int flags,
+    timespec_t *timeout)
+{
+	struct sonode *so;
+	file_t *fp;
+	struct nmsghdr lmsg;
+	struct uio auio;
+	struct iovec aiov[MSG_MAXIOVLEN];
+	socklen_t *namelenp, *controllenp;
+	int *flagsp;
+	model_t model;
+	caddr_t umsg;
+	size_t stride, lenoff;
+	ssize_t len;
+	uint_t count, mlen;
+	hrtime_t deadline = 0;
+	timespec_t ts;
+	boolean_t waitforone;
+	int error;
+
+	dprint(1, ("recvmmsg(%d, %p, %u, %d, %p)\n",
+	    sock, (void *)vec, vlen, flags, (void *)timeout));
+
+	model = get_udatamodel();
+	if (timeout != NULL) {
+		if (model == DATAMODEL_NATIVE) {
+			if (copyin(timeout, &ts, sizeof (ts)))
+				return (set_errno(EFAULT));
+		} else {
+			timespec32_t ts32;
+
+			if (copyin(timeout, &ts32, sizeof (ts32)))
+				return (set_errno(EFAULT));
+			TIMESPEC32_TO_TIMESPEC(&ts, &ts32)
+		}
+		if (itimerspecfix(&ts))
+			return (set_errno(EINVAL));
+		deadline = gethrtime() + ts2hrt(&ts);
+	}
+
+	waitforone = (flags & MSG_WAITFORONE) != 0;
+	flags &= ~MSG_WAITFORONE;
+	stride = mmsghdr_size(flags, model, &lenoff);
+	vlen = MIN(vlen, MSG_MAXMMSGLEN);
+
+	if ((so = getsonode(sock, &error, &fp)) == NULL)
+		return (set_errno(error));
+
+	for (count = 0; count < vlen; ) {
+		umsg = (caddr_t)vec + count * stride;
+		error = recvmsg_copyin((struct nmsghdr *)umsg, flags, model,
+		    &lmsg, &auio, aiov, &namelenp, &controllenp, &flagsp);
+		if (error == 0) {
+			error = recvit_so(so, fp, &lmsg, &auio, flags,
+			    namelenp, controllenp, flagsp, &len);
+		}
+		if (error != 0)
+			break;
+		mlen = (uint_t)len;
+		if (copyout(&mlen, umsg + lenoff, sizeof (mlen)) != 0) {
+			error = EFAULT;
+			break;
+		}
+		count++;
+
+		if (waitforone)
+			flags |= MSG_DONTWAIT;
+		if (timeout != NULL && gethrtime() >= deadline)
+			break;
+	}
+	releasef(sock);
+
+	if (count == 0 && error != 0)
+		return (set_errno(error));
+	return (count);
+}
+
 ssize_t
 sendto(int sock, void *buffer, size_t len, int flags,
     struct sockaddr *name, socklen_t namelen)
@@ -1999,12 +2241,30 @@ sockconfig(int cmd, void *arg1, void *arg2, void *arg3, void *arg4)
  * to copy the data from the filesystem into our temporary network buffer.
  *
  * To disable caching, set sendfile_max_size to 0.
+ *
+ * Sendfile with loaned buffers (No copy, no page cache).
+ * ------------------------------------------------------
+ *
+ * File systems that keep their own cache, such as ZFS, have to copy the
+ * data into the page cache before segmap or vpm can map it, and then hold
+ * both copies.  If the file system supports zero-copy reads
+ * (VFSFT_ZEROCOPY_SUPPORTED), we instead ask it to loan us its own buffers
+ * through VOP_REQZCBUF() and VOP_READ() on an xuio, wrap each of them in a
+ * desballoca'ed mblk, and hand them back with VOP_RETZCBUF() from the
+ * call-back routine once the transport is done with the last one.  This is
+ * the same mechanism the NFS server uses for READ replies.  The loaned
+ * buffers are private to us, so unlike segmap we don't have to wait for
+ * the transport before returning.  If the file system declines to loan
+ * (e.g. because the file is also mapped), we fall back to segmap.
+ *
+ * To disable loaning, set sendfile_loan_enable to 0.
  */
 
 uint_t sendfile_read_size = 1024 * 1024;
 #define	SENDFILE_REQ_LOWAT	3 * 1024 * 1024
 uint_t sendfile_req_lowat = SENDFILE_REQ_LOWAT;
 uint_t sendfile_req_hiwat = 10 * SENDFILE_REQ_LOWAT;
+int sendfile_loan_enable = 1;
 struct sendfile_stats sf_stats;
 struct sendfile_queue *snfq;
 clock_t snfq_timeout;
@@ -2708,6 +2968,161 @@ done:
 	return (error);
 }
 
+typedef struct {
+	xuio_t		snfl_xuio;	/* must be first */
+	unsigned int	snfl_ref;
+	frtn_t		snfl_frtn;
+	vnode_t		*snfl_vp;
+} snf_loan_desbinfo;
+
+/*
+ * The callback function used for mblks wrapping loaned buffers.  The buffers
+ * are returned to the file system when the last of them is freed; snf_loan()
+ * holds one extra reference of its own while it builds the chain.
+ */
+void
+snf_loan_desbfree(snf_loan_desbinfo *snfl)
+{
+	ASSERT(snfl->snfl_ref != 0);
+	if (atomic_dec_32_nv(&snfl->snfl_ref) == 0) {
+		(void) VOP_RETZCBUF(snfl->snfl_vp, &snfl->snfl_xuio, NULL,
+		    NULL);
+		VN_RELE(snfl->snfl_vp);
+		kmem_free(snfl, sizeof (snf_loan_desbinfo));
+	}
+}
+
+/*
+ * Send the file using buffers loaned by the file system, up to
+ * sendfile_read_size at a time.  Called, and returns, like snf_segmap(),
+ * to which we hand the rest of the file if the file system will not loan a
+ * buffer.
+ */
+int
+snf_loan(file_t *fp, vnode_t *fvp, u_offset_t fileoff, u_offset_t total_size,
+    ssize_t *count, boolean_t nowait)
+{
+	vnode_t *vp;
+	mblk_t *mp, *nmp;
+	snf_loan_desbinfo *snfl;
+	xuio_t *xuiop;
+	uio_t *uiop;
+	int chain_size;
+	int error;
+	short fflag;
+	ssize_t ksize, cnt;
+	struct vattr va;
+	struct nmsghdr msg;
+	int i;
+
+	vp = fp->f_vnode;
+	fflag = fp->f_flag;
+	ksize = 0;
+	bzero(&msg, sizeof (msg));
+
+	for (;;) {
+		if (ISSIG(curthread, JUSTLOOKING)) {
+			error = EINTR;
+			break;
+		}
+
+		snfl = kmem_zalloc(sizeof (snf_loan_desbinfo), KM_SLEEP);
+		xuiop = &snfl->snfl_xuio;
+		xuiop->xu_type = UIOTYPE_ZEROCOPY;
+		uiop = &xuiop->xu_uio;
+		uiop->uio_segflg = UIO_SYSSPACE;
+		uiop->uio_loffset = fileoff;
+		uiop->uio_resid = MIN(total_size, sendfile_read_size);
+
+		if (VOP_REQZCBUF(fvp, UIO_READ, xuiop, CRED(), NULL) != 0) {
+			kmem_free(snfl, sizeof (snf_loan_desbinfo));
+			sf_stats.ss_file_segmap++;
+			error = snf_segmap(fp, fvp, fileoff, total_size, &cnt,
+			    nowait);
+			*count = ksize + cnt;
+			return (error);
+		}
+
+		chain_size = uiop->uio_resid;
+		error = VOP_READ(fvp, uiop, 0, CRED(), NULL);
+		chain_size -= uiop->uio_resid;
+		if (error != 0 || chain_size == 0) {
+			/*
+			 * The file system may not have set up the xuio at all
+			 * if there was nothing to read.
+			 */
+			if (XUIO_XUZC_PRIV(xuiop) != NULL)
+				(void) VOP_RETZCBUF(fvp, xuiop, NULL, NULL);
+			kmem_free(snfl, sizeof (snf_loan_desbinfo));
+			break;
+		}
+
+		VN_HOLD(fvp);
+		snfl->snfl_vp = fvp;
+		snfl->snfl_ref = 1;
+		snfl->snfl_frtn.free_func = snf_loan_desbfree;
+		snfl->snfl_frtn.free_arg = (caddr_t)snfl;
+
+		/* Construct the mblk chain from the loaned buffers */
+		mp = NULL;
+		for (i = 0; i < uiop->uio_iovcnt; i++) {
+			nmp = esballoca((uchar_t *)uiop->uio_iov[i].iov_base,
+			    uiop->uio_iov[i].iov_len, BPRI_HI,
+			    &snfl->snfl_frtn);
+			if (nmp == NULL) {
+				freemsg(mp);
+				snf_loan_desbfree(snfl);
+				error = EAGAIN;
+				goto out;
+			}
+			snfl->snfl_ref++;
+			/* Mark this dblk with the zero-copy flag */
+			nmp->b_datap->db_struioflag |= STRUIO_ZC;
+			nmp->b_wptr += uiop->uio_iov[i].iov_len;
+			if (mp != NULL)
+				linkb(mp, nmp);
+			else
+				mp = nmp;
+		}
+		/* Drop our own reference; the mblks hold the buffers now */
+		snf_loan_desbfree(snfl);
+		fileoff += chain_size;
+		total_size -= chain_size;
+
+		VOP_RWUNLOCK(fvp, V_WRITELOCK_FALSE, NULL);
+		error = socket_sendmblk(VTOSO(vp), &msg, fflag, CRED(), &mp);
+		if (error != 0) {
+			/*
+			 * mp contains the mblks that were not sent by
+			 * socket_sendmblk. Use its size to update *count
+			 */
+			*count = ksize + (chain_size - msgdsize(mp));
+			if (mp != NULL)
+				freemsg(mp);
+			return (error);
+		}
+		ksize += chain_size;
+		if (total_size == 0)
+			goto done;
+
+		(void) VOP_RWLOCK(fvp, V_WRITELOCK_FALSE, NULL);
+		va.va_mask = AT_SIZE;
+		error = VOP_GETATTR(fvp, &va, 0, kcred, NULL);
+		if (error)
+			break;
+		/* Read as much as possible. */
+		if (fileoff >= va.va_size)
+			break;
+		if (total_size + fileoff > va.va_size)
+			total_size = va.va_size - fileoff;
+	}
+out:
+	VOP_RWUNLOCK(fvp, V_WRITELOCK_FALSE, NULL);
+done:
+	*count = ksize;
+	return (error);
+}
+
 int
 snf_cache(file_t *fp, vnode_t *fvp, u_offset_t fileoff, u_offset_t size,
     uint_t maxpsz, ssize_t *count)
@@ -2930,7 +3345,12 @@ sosendfile64(file_t *fp, file_t *rfp, const struct ksendfilevec64 *sfv,
 			dozcopy = copyflag & STZCVMSAFE;
 		}
 	}
-	if (dozcopy) {
+	if (dozcopy && sendfile_loan_enable &&
+	    vfs_has_feature(fvp->v_vfsp, VFSFT_ZEROCOPY_SUPPORTED)) {
+		sf_stats.ss_file_loaned++;
+		error = snf_loan(fp, fvp, sfv_off, (u_offset_t)sfv_len,
+		    &count, ((sfv->sfv_flag & SFV_NOWAIT) != 0));
+	} else if (dozcopy) {
 		sf_stats.ss_file_segmap++;
 		error = snf_segmap(fp, fvp, sfv_off, (u_offset_t)sfv_len,
 		    &count, ((sfv->sfv_flag & SFV_NOWAIT) != 0));
@@ -5650,6 +5650,17 @@ done:
 			break;
 		case SO_RCVBUF:
 			so->so_rcvbuf = intvalue;
+			/*
+			 * tl has no receive buffer of its own: an AF_UNIX
+			 * socket's received data waits on the stream head
+			 * read queue, so that's what we size.
+			 */
+			if (so->so_family == AF_UNIX && intvalue > 0) {
+				mutex_exit(&so->so_lock);
+				(void) strqset(RD(strvp2wq(SOTOV(so))),
+				    QHIWAT, 0, intvalue);
+				mutex_enter(&so->so_lock);
+			}
 			break;
 		case SO_RCVPSH:
 			so->so_rcv_timer_interval = intvalue;
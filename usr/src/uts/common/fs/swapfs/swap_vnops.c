@@ -211,8 +211,13 @@ again:
 			page_unlock(pp);
 		}
 	} else {
+		/*
+		 * Pages created for new anon slots are mostly about to be
+		 * zero filled by anon_zero(), so ask for a pre-zeroed one.
+		 */
 		pp = page_create_va(vp, off, PAGESIZE,
-		    PG_WAIT | PG_EXCL | flag_noreloc,
+		    PG_WAIT | PG_EXCL | flag_noreloc |
+		    (rw == S_CREATE ? PG_ZERO : 0),
 		    seg, addr);
 		/*
 		 * Someone raced in and created the page after we did the
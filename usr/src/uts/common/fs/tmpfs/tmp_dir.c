@@ -29,6 +29,8 @@
 #include <sys/param.h>
 #include <sys/sysmacros.h>
 #include <sys/systm.h>
+#include <sys/kmem.h>
+#include <sys/bitmap.h>
 #include <sys/time.h>
 #include <sys/vfs.h>
 #include <sys/vnode.h>
@@ -52,13 +54,25 @@ static int tdiraddentry(struct tmpnode *, struct tmpnode *, char *,
 	enum de_op, struct tmpnode *);
 
 
-#define	T_HASH_SIZE	8192		/* must be power of 2 */
-#define	T_MUTEX_SIZE	64
+/*
+ * Directory entries of all tmpfs file systems are kept in a single hash
+ * table, keyed on the parent directory and the name.  The table is sized
+ * when tmpfs is loaded, at one bucket for every T_HASH_PAGES pages of
+ * physical memory, so that chains stay short even with very large
+ * directories; tmpfs_hashsize can be set in /etc/system to override this.
+ */
+#define	T_HASH_MINSIZE	8192		/* must be power of 2 */
+#define	T_HASH_MAXSIZE	(1 << 20)	/* must be power of 2 */
+#define	T_HASH_PAGES	16
+#define	T_MUTEX_SIZE	256
 
-static struct tdirent	*t_hashtable[T_HASH_SIZE];
+uint_t tmpfs_hashsize;
+
+static struct tdirent	**t_hashtable;
+static uint_t		 t_hashmask;
 static kmutex_t		 t_hashmutex[T_MUTEX_SIZE];
 
-#define	T_HASH_INDEX(a)		((a) & (T_HASH_SIZE-1))
+#define	T_HASH_INDEX(a)		((a) & t_hashmask)
 #define	T_MUTEX_INDEX(a)	((a) & (T_MUTEX_SIZE-1))
 
 #define	TMPFS_HASH(tp, name, hash)				\
@@ -74,10 +88,33 @@ tmpfs_hash_init(void)
 {
 	int	ix;
 
+	if (tmpfs_hashsize == 0)
+		tmpfs_hashsize = physmem / T_HASH_PAGES;
+	if (!ISP2(tmpfs_hashsize))
+		tmpfs_hashsize = 1 << highbit(tmpfs_hashsize);
+	tmpfs_hashsize = MAX(tmpfs_hashsize, T_HASH_MINSIZE);
+	tmpfs_hashsize = MIN(tmpfs_hashsize, T_HASH_MAXSIZE);
+
+	t_hashtable = kmem_zalloc(tmpfs_hashsize * sizeof (struct tdirent *),
+	    KM_SLEEP);
+	t_hashmask = tmpfs_hashsize - 1;
+
 	for (ix = 0; ix < T_MUTEX_SIZE; ix++)
 		mutex_init(&t_hashmutex[ix], NULL, MUTEX_DEFAULT, NULL);
 }
 
+void
+tmpfs_hash_fini(void)
+{
+	int	ix;
+
+	for (ix = 0; ix < T_MUTEX_SIZE; ix++)
+		mutex_destroy(&t_hashmutex[ix]);
+
+	kmem_free(t_hashtable, tmpfs_hashsize * sizeof (struct tdirent *));
+	t_hashtable = NULL;
+}
+
 /*
  * This routine is where the rubber meets the road for identities.
  */
@@ -508,6 +545,13 @@ tdirdelete(
 	if (dir->tn_dir->td_prev == tpdp) {
 		dir->tn_dir->td_prev = tpdp->td_prev;
 	}
+
+	/*
+	 * Likewise for the readdir cursor; entries before the one
+	 * it names have lower offsets, so it is safe to back it up.
+	 */
+	if (dir->tn_dircursor == tpdp)
+		dir->tn_dircursor = tpdp->td_prev;
 	ASSERT(tpdp->td_next != tpdp);
 	ASSERT(tpdp->td_prev != tpdp);
 
@@ -598,6 +642,7 @@ tdirinit(
 	}
 
 	dir->tn_dir = dot;
+	dir->tn_dircursor = NULL;
 	dir->tn_size = 2 * sizeof (struct tdirent) + 5;	/* dot and dotdot */
 	dir->tn_dirents = 2;
 	dir->tn_nlink = 2;
@@ -620,6 +665,7 @@ tdirtrunc(struct tmpnode *dir)
 	ASSERT(dir->tn_type == VDIR);
 
 	isvattrdir = (dir->tn_vnode->v_flag & V_XATTRDIR) ? 1 : 0;
+	dir->tn_dircursor = NULL;
 	for (tdp = dir->tn_dir; tdp; tdp = dir->tn_dir) {
 		ASSERT(tdp->td_next != tdp);
 		ASSERT(tdp->td_prev != tdp);
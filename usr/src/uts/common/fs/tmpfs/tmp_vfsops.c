@@ -121,6 +121,7 @@ int
 _fini()
 {
 	int error;
+	extern	void	tmpfs_hash_fini();
 
 	error = mod_remove(&modlinkage);
 	if (error)
@@ -130,6 +131,7 @@ _fini()
 	 */
 	(void) vfs_freevfsops_by_type(tmpfsfstype);
 	vn_freevnodeops(tmp_vnodeops);
+	tmpfs_hash_fini();
 	return (0);
 }
 
@@ -384,8 +386,14 @@ tmp_mount(
 	error = 0;
 
 out:
-	if (error == 0)
+	/*
+	 * tmpfs pages are only written out to swap by pageout, so fsflush
+	 * has nothing to do for them; see tmp_putpage().
+	 */
+	if (error == 0) {
 		vfs_set_feature(vfsp, VFSFT_SYSATTR_VIEWS);
+		vfs_set_feature(vfsp, VFSFT_DIRTYTRACK);
+	}
 
 	return (error);
 }
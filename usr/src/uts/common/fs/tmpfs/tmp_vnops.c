@@ -76,6 +76,13 @@ static int	tmp_getapage(struct vnode *, u_offset_t, size_t, uint_t *,
 static int 	tmp_putapage(struct vnode *, page_t *, u_offset_t *, size_t *,
 	int, struct cred *);
 
+/*
+ * Maximum number of pages rdtmp() maps with vpm at a time, and the size of
+ * the scatter/gather list that needs, including the terminating entry.
+ */
+#define	TMP_VPMMAXPGS	(VPMMAXPGS/2)
+#define	TMP_MAXVMAPS	(TMP_VPMMAXPGS + 1)
+
 /* ARGSUSED1 */
 static int
 tmp_open(struct vnode **vpp, int flag, struct cred *cred, caller_context_t *ct)
@@ -455,6 +462,7 @@ rdtmp(
 	ulong_t segmap_offset;	/* pagesize byte offset into segmap */
 	caddr_t base;		/* base of segmap */
 	ssize_t bytes;		/* bytes to uiomove */
+	struct vmap vml[TMP_MAXVMAPS];
 	struct vnode *vp;
 	int error;
 	long oresid = uio->uio_resid;
@@ -506,7 +514,19 @@ rdtmp(
 
 		offset = uio->uio_offset;
 		pageoffset = offset & PAGEOFFSET;
-		bytes = MIN(PAGESIZE - pageoffset, uio->uio_resid);
+
+		/*
+		 * With vpm, the pages are mapped through segkpm and there
+		 * is no segmap window to stay within, so copy out up to
+		 * TMP_VPMMAXPGS pages per pass.  The pages are looked up
+		 * (and any missing ones brought in by a single call to
+		 * tmp_getpage()) in one go, rather than a page at a time.
+		 */
+		if (vpm_enable)
+			bytes = MIN(ptob(TMP_VPMMAXPGS) - pageoffset,
+			    uio->uio_resid);
+		else
+			bytes = MIN(PAGESIZE - pageoffset, uio->uio_resid);
 
 		diff = tp->tn_size - offset;
 
@@ -525,11 +545,23 @@ rdtmp(
 		rw_exit(&tp->tn_contents);
 
 		if (vpm_enable) {
+			int i;
+			ssize_t n;
+
 			/*
-			 * Copy data.
+			 * Map the pages and copy data.
 			 */
-			error = vpm_data_copy(vp, offset, bytes, uio, 1, NULL,
-			    0, S_READ);
+			error = vpm_map_pages(vp, offset, bytes, VPM_FETCHPAGE,
+			    vml, TMP_MAXVMAPS, NULL, S_READ);
+			for (i = 0; error == 0 && bytes > 0 &&
+			    vml[i].vs_addr != NULL; i++) {
+				n = MIN(bytes, PAGESIZE - pageoffset);
+				error = uiomove(vml[i].vs_addr + pageoffset,
+				    n, UIO_READ, uio);
+				bytes -= n;
+				pageoffset = 0;
+			}
+			vpm_unmap_pages(vml, S_READ);
 		} else {
 			segmap_offset = (offset & PAGEMASK) & MAXBOFFSET;
 			base = segmap_getmapflt(segkmap, vp, offset & MAXBMASK,
@@ -537,21 +569,11 @@ rdtmp(
 
 			error = uiomove(base + segmap_offset + pageoffset,
 			    (long)bytes, UIO_READ, uio);
-		}
 
-		if (error) {
-			if (vpm_enable) {
-				(void) vpm_sync_pages(vp, offset, PAGESIZE, 0);
-			} else {
+			if (error)
 				(void) segmap_release(segkmap, base, 0);
-			}
-		} else {
-			if (vpm_enable) {
-				error = vpm_sync_pages(vp, offset, PAGESIZE,
-				    0);
-			} else {
+			else
 				error = segmap_release(segkmap, base, 0);
-			}
 		}
 
 		/*
@@ -1515,8 +1537,17 @@ tmp_readdir(
 	dp = (struct dirent64 *)outbuf;
 
 
+	/*
+	 * The list is kept sorted by offset, so if the last readdir of
+	 * this directory stopped at or before the requested offset, pick
+	 * up from there rather than walking the list from the start.
+	 * This keeps reading a large directory from being quadratic in
+	 * the number of entries.
+	 */
 	offset = 0;
-	tdp = tp->tn_dir;
+	tdp = tp->tn_dircursor;
+	if (tdp == NULL || tdp->td_offset > uiop->uio_offset)
+		tdp = tp->tn_dir;
 	while (tdp) {
 		namelen = strlen(tdp->td_name);	/* no +1 needed */
 		offset = tdp->td_offset;
@@ -1557,8 +1588,11 @@ tmp_readdir(
 			offset += 1;
 			if (eofp)
 				*eofp = 1;
-		} else if (eofp)
-			*eofp = 0;
+		} else {
+			tp->tn_dircursor = tdp;
+			if (eofp)
+				*eofp = 0;
+		}
 		uiop->uio_offset = offset;
 	}
 	gethrestime(&tp->tn_atime);
@@ -70,6 +70,7 @@ uint32_t	ldl_divisor	= LDL_DIVISOR;
 uint32_t	ldl_mintransfer	= LDL_MINTRANSFER;
 uint32_t	ldl_maxtransfer	= LDL_MAXTRANSFER;
 uint32_t	ldl_minbufsize	= LDL_MINBUFSIZE;
+uint32_t	ldl_maxbufsize	= LDL_MAXBUFSIZE;
 uint32_t	ldl_cgsizereq	= 0;
 
 /* Generation of header ids */
@@ -388,7 +389,8 @@ lufs_snarf(ufsvfs_t *ufsvfsp, struct fs *fs, int ronly)
 	ul->un_nbeb = nb;
 	ul->un_maxresv = btodb(ul->un_logsize) * LDL_USABLE_BSIZE;
 	ul->un_deltamap = map_get(ul, deltamaptype, DELTAMAP_NHASH);
-	ul->un_logmap = map_get(ul, logmaptype, LOGMAP_NHASH);
+	ul->un_logmap = map_get(ul, logmaptype,
+	    ISP2(logmap_nhash) ? logmap_nhash : LOGMAP_NHASH);
 	if (ul->un_debug & MT_MATAMAP)
 		ul->un_matamap = map_get(ul, matamaptype, DELTAMAP_NHASH);
 	mutex_init(&ul->un_log_mutex, NULL, MUTEX_DEFAULT, NULL);
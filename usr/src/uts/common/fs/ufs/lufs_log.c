@@ -186,6 +186,8 @@ ldl_strategy(ml_unit_t *ul, buf_t *pb)
 
 	do {
 		error = map_frag(ul, lblkno, nb_left, &pblkno, &pbcount);
+		if (pbcount > dbtob(btodb(maxphys)))
+			pbcount = dbtob(btodb(maxphys));
 
 		lbp = kmem_cache_alloc(lufs_bp, KM_SLEEP);
 		bioinit(&lbp->lb_buf);
@@ -1607,18 +1609,19 @@ ldl_bufsize(ml_unit_t *ul)
 {
 	size_t		bufsize;
 	extern uint32_t	ldl_minbufsize;
+	extern uint32_t	ldl_maxbufsize;
 
 	/*
 	 * initial guess is the maxtransfer value for this log device
 	 * 	increase if too small
 	 * 	decrease if too large
+	 * ldl_strategy() breaks the I/O up at maxphys, so that no longer
+	 * bounds the buffer.
 	 */
 	bufsize = dbtob(btod(ul->un_maxtransfer));
 	if (bufsize < ldl_minbufsize)
 		bufsize = ldl_minbufsize;
-	if (bufsize > maxphys)
-		bufsize = maxphys;
-	if (bufsize > ul->un_maxtransfer)
-		bufsize = ul->un_maxtransfer;
+	if (bufsize > ldl_maxbufsize)
+		bufsize = dbtob(btodb(ldl_maxbufsize));
 	return (bufsize);
 }
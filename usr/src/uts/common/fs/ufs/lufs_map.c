@@ -60,6 +60,7 @@ long	logmap_maxnme_commit	= 2048;
 long	logmap_maxnme_async	= 4096;
 long	logmap_maxnme_sync	= 6144;
 long	logmap_maxcfrag_commit	= 4;	/* Max canceled fragments per moby */
+ulong_t	logmap_nhash		= LOGMAP_NHASH;	/* power of 2 */
 
 
 uint64_t ufs_crb_size = 0;		/* current size of all crb buffers */
@@ -47,6 +47,18 @@
 
 uint_t topkey; /* tsd transaction key */
 
+/*
+ * Group commit: the last synchronous op in a moby transaction commits
+ * it, and so the log write, for every op in it.  When the previous
+ * transaction had more than one synchronous op, that thread first waits
+ * up to top_group_commit_usec for others (fsyncs, typically) to join,
+ * so that a single commit covers them too.  0 disables the wait.
+ */
+uint_t top_group_commit_usec = 200;
+
+#define	TOP_IS_COMMIT(topid)	\
+	((topid) >= TOP_COMMIT_ASYNC && (topid) <= TOP_COMMIT_UNMOUNT)
+
 /*
  * declare a delta
  */
@@ -327,6 +339,7 @@ retry:
 		 */
 		mtm->mtm_active++;
 		mtm->mtm_activesync++;
+		mtm->mtm_nsync++;
 		ul->un_resv += size;
 	}
 
@@ -459,6 +472,28 @@ top_end_sync(ufsvfs_t *ufsvfsp, int *ep, top_t topid, ulong_t size)
 
 	mtm->mtm_ref = 1;
 
+	/*
+	 * Group commit.  Linger as an active syncop, so that syncops
+	 * joining meanwhile leave the commit to us; the first of them
+	 * to finish closes the transaction to further syncops, and the
+	 * last wakes us early.  Not worth it if nothing joined last
+	 * time, or if syncops are already queued for the next
+	 * transaction behind this commit.  The commit ops that
+	 * top_issue_sync() and friends generate never wait.
+	 */
+	if (mtm->mtm_activesync == 0 && top_group_commit_usec != 0 &&
+	    mtm->mtm_lastnsync > 1 && mtm->mtm_wantin == 0 &&
+	    mtm->mtm_closed == 0 && !TOP_IS_COMMIT(topid) && !panicstr) {
+		mtm->mtm_activesync++;
+		mtm->mtm_active++;
+		mtm->mtm_gclinger = 1;
+		(void) cv_timedwait_hires(&mtm->mtm_cv_eot, &mtm->mtm_lock,
+		    USEC2NSEC(top_group_commit_usec), USEC2NSEC(10), 0);
+		mtm->mtm_gclinger = 0;
+		mtm->mtm_activesync--;
+		mtm->mtm_active--;
+	}
+
 	/*
 	 * wait for last syncop to complete
 	 */
@@ -467,6 +502,10 @@ top_end_sync(ufsvfs_t *ufsvfsp, int *ep, top_t topid, ulong_t size)
 
 		mtm->mtm_closed = TOP_SYNC;
 
+		/* only the lingering committer is left; wake it */
+		if (mtm->mtm_gclinger && mtm->mtm_activesync == 1)
+			cv_broadcast(&mtm->mtm_cv_eot);
+
 		do {
 			cv_wait(&mtm->mtm_cv_commit, &mtm->mtm_lock);
 		} while (seq == mtm->mtm_seq);
@@ -546,6 +585,8 @@ top_end_sync(ufsvfs_t *ufsvfsp, int *ep, top_t topid, ulong_t size)
 	mtm->mtm_active += mtm->mtm_wantin;
 	ul->un_resv += ul->un_resv_wantin;
 	mtm->mtm_activesync = mtm->mtm_wantin;
+	mtm->mtm_lastnsync = mtm->mtm_nsync;
+	mtm->mtm_nsync = mtm->mtm_wantin;
 	mtm->mtm_wantin = 0;
 	mtm->mtm_closed = 0;
 	ul->un_resv_wantin = 0;
@@ -65,6 +65,7 @@
 #include <sys/fcntl.h>
 #include <fs/fs_subr.h>
 #include <sys/taskq.h>
+#include <sys/zone.h>
 #include <fs/fs_reparse.h>
 
 /* Determine if this vnode is a file that is read-only */
@@ -3263,10 +3264,22 @@ fop_read(
 {
 	int	err;
 	ssize_t	resid_start = uiop->uio_resid;
+	hrtime_t start;
 
 	VOPXID_MAP_CR(vp, cr);
 
-	err = (*(vp)->v_op->vop_read)(vp, uiop, ioflag, cr, ct);
+	/*
+	 * Only regular files are timed: reads of devices, pipes and the
+	 * like may block for as long as there is nothing to read.
+	 */
+	if (vp->v_type == VREG) {
+		start = gethrtime_unscaled();
+		err = (*(vp)->v_op->vop_read)(vp, uiop, ioflag, cr, ct);
+		zone_lat_record(&curzone->zone_read_lat,
+		    gethrtime_unscaled() - start);
+	} else {
+		err = (*(vp)->v_op->vop_read)(vp, uiop, ioflag, cr, ct);
+	}
 	VOPSTATS_UPDATE_IO(vp, read,
 	    read_bytes, (resid_start - uiop->uio_resid));
 	return (err);
@@ -3282,10 +3295,18 @@ fop_write(
 {
 	int	err;
 	ssize_t	resid_start = uiop->uio_resid;
+	hrtime_t start;
 
 	VOPXID_MAP_CR(vp, cr);
 
-	err = (*(vp)->v_op->vop_write)(vp, uiop, ioflag, cr, ct);
+	if (vp->v_type == VREG) {
+		start = gethrtime_unscaled();
+		err = (*(vp)->v_op->vop_write)(vp, uiop, ioflag, cr, ct);
+		zone_lat_record(&curzone->zone_write_lat,
+		    gethrtime_unscaled() - start);
+	} else {
+		err = (*(vp)->v_op->vop_write)(vp, uiop, ioflag, cr, ct);
+	}
 	VOPSTATS_UPDATE_IO(vp, write,
 	    write_bytes, (resid_start - uiop->uio_resid));
 	return (err);
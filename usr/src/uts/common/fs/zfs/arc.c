@@ -88,7 +88,11 @@
  *
  * buf_hash_find() returns the appropriate mutex (held) when it
  * locates the requested buffer in the hash table.  It returns
- * NULL for the mutex if the buffer was not in the table.
+ * NULL for the mutex if the buffer was not in the table.  It
+ * searches the hash chain without the mutex, taking it only to return
+ * a hit; a miss takes no lock at all (see buf_hash_find()).  Headers
+ * that have been in the table are therefore freed only once no such
+ * lockless search can still be looking at them (see arc_hdr_free()).
  *
  * buf_hash_remove() expects the appropriate hash mutex to be
  * already held before it is invoked.
@@ -287,6 +291,22 @@ uint_t arc_reduce_dnlc_percent = 3;
  */
 int zfs_arc_evict_batch_limit = 10;
 
+/*
+ * Large evictions are spread over several threads, each working through
+ * its own share of the sublists, since a single thread can't free memory
+ * quickly enough when the ARC has to shrink by many gigabytes at once.
+ * A request to evict N bytes is split into N / zfs_arc_evict_task_min
+ * tasks, capped by the number of eviction threads and sublists, so the
+ * eviction rate grows with how far the ARC is over its target.
+ * zfs_arc_evict_threads sizes the eviction taskq; 0 picks one thread per
+ * eight CPUs.  Set it to 1 to evict from a single thread only.
+ */
+int zfs_arc_evict_threads = 0;
+uint64_t zfs_arc_evict_task_min = 16 << 20;
+
+static taskq_t		*arc_evict_taskq;
+static int		arc_evict_nthreads;
+
 /*
  * The number of sublists used for each of the arc state lists. If this
  * is not set to a suitable value by the user, it will be configured to
@@ -355,6 +375,13 @@ int zfs_arc_average_blocksize = 8 * 1024; /* 8KB */
 
 boolean_t zfs_compressed_arc_enabled = B_TRUE;
 
+/*
+ * Charge each cached block to the dataset that read or wrote it, so that
+ * per-dataset ARC usage is visible and the arcquota and arcreservation
+ * properties can be enforced (see arc_ds_t below).
+ */
+boolean_t zfs_arc_ds_accounting = B_TRUE;
+
 /*
  * Note that buffers can be in one of 6 states:
  *	ARC_anon	- anonymous (discussed below)
@@ -440,11 +467,28 @@ typedef struct arc_stats {
 	 * not from the spa we're trying to evict from.
 	 */
 	kstat_named_t arcstat_evict_skip;
+	/*
+	 * Number of buffers not evicted because their dataset is within
+	 * its arcreservation.
+	 */
+	kstat_named_t arcstat_evict_reserved;
 	/*
 	 * Number of times arc_evict_state() was unable to evict enough
 	 * buffers to reach it's target amount.
 	 */
 	kstat_named_t arcstat_evict_not_enough;
+	/*
+	 * Bytes evicted by arc_evict_state(), and the time spent doing so;
+	 * together they give the eviction throughput.
+	 */
+	kstat_named_t arcstat_evict_bytes;
+	kstat_named_t arcstat_evict_time_ns;
+	/*
+	 * Number of evictions that were spread over several threads, and
+	 * the total number of tasks they were split into.
+	 */
+	kstat_named_t arcstat_evict_parallel;
+	kstat_named_t arcstat_evict_tasks;
 	kstat_named_t arcstat_evict_l2_cached;
 	kstat_named_t arcstat_evict_l2_eligible;
 	kstat_named_t arcstat_evict_l2_ineligible;
@@ -630,6 +674,16 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_size;
 	kstat_named_t arcstat_l2_asize;
 	kstat_named_t arcstat_l2_hdr_size;
+	kstat_named_t arcstat_l2_log_blk_writes;
+	kstat_named_t arcstat_l2_log_blk_asize;
+	kstat_named_t arcstat_l2_rebuild_success;
+	kstat_named_t arcstat_l2_rebuild_unsupported;
+	kstat_named_t arcstat_l2_rebuild_io_errors;
+	kstat_named_t arcstat_l2_rebuild_cksum_lb_errors;
+	kstat_named_t arcstat_l2_rebuild_lowmem;
+	kstat_named_t arcstat_l2_rebuild_log_blks;
+	kstat_named_t arcstat_l2_rebuild_bufs;
+	kstat_named_t arcstat_l2_rebuild_bufs_precached;
 	kstat_named_t arcstat_memory_throttle_count;
 	kstat_named_t arcstat_meta_used;
 	kstat_named_t arcstat_meta_limit;
@@ -637,6 +691,11 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_meta_min;
 	kstat_named_t arcstat_sync_wait_for_async;
 	kstat_named_t arcstat_demand_hit_predictive_prefetch;
+	/*
+	 * Bytes of predictive prefetch evicted without ever being read
+	 * on demand.
+	 */
+	kstat_named_t arcstat_prefetch_wasted_bytes;
 } arc_stats_t;
 
 static arc_stats_t arc_stats = {
@@ -657,7 +716,12 @@ static arc_stats_t arc_stats = {
 	{ "deleted",			KSTAT_DATA_UINT64 },
 	{ "mutex_miss",			KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
+	{ "evict_reserved",		KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
+	{ "evict_bytes",		KSTAT_DATA_UINT64 },
+	{ "evict_time_ns",		KSTAT_DATA_UINT64 },
+	{ "evict_parallel",		KSTAT_DATA_UINT64 },
+	{ "evict_tasks",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_ineligible",	KSTAT_DATA_UINT64 },
@@ -714,6 +778,16 @@ static arc_stats_t arc_stats = {
 	{ "l2_size",			KSTAT_DATA_UINT64 },
 	{ "l2_asize",			KSTAT_DATA_UINT64 },
 	{ "l2_hdr_size",		KSTAT_DATA_UINT64 },
+	{ "l2_log_blk_writes",		KSTAT_DATA_UINT64 },
+	{ "l2_log_blk_asize",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_success",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_unsupported",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_io_errors",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_cksum_lb_errors",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_lowmem",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_log_blks",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_bufs",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_bufs_precached",	KSTAT_DATA_UINT64 },
 	{ "memory_throttle_count",	KSTAT_DATA_UINT64 },
 	{ "arc_meta_used",		KSTAT_DATA_UINT64 },
 	{ "arc_meta_limit",		KSTAT_DATA_UINT64 },
@@ -721,6 +795,7 @@ static arc_stats_t arc_stats = {
 	{ "arc_meta_min",		KSTAT_DATA_UINT64 },
 	{ "sync_wait_for_async",	KSTAT_DATA_UINT64 },
 	{ "demand_hit_predictive_prefetch", KSTAT_DATA_UINT64 },
+	{ "prefetch_wasted_bytes",	KSTAT_DATA_UINT64 },
 };
 
 #define	ARCSTAT(stat)	(arc_stats.stat.value.ui64)
@@ -880,6 +955,9 @@ typedef struct l1arc_buf_hdr {
 
 	arc_callback_t		*b_acb;
 	void			*b_pdata;
+
+	/* dataset charged for b_pdata, protected by hash lock */
+	arc_ds_t		*b_ds;
 } l1arc_buf_hdr_t;
 
 typedef struct l2arc_dev l2arc_dev_t;
@@ -892,6 +970,71 @@ typedef struct l2arc_buf_hdr {
 	list_node_t		b_l2node;
 } l2arc_buf_hdr_t;
 
+/*
+ * Per-dataset ARC usage.
+ *
+ * Every L1 header records the dataset (objset) whose arc_read() or
+ * arc_write() brought its block into the cache, and the size of its
+ * b_pdata is charged to that dataset's arc_ds_t while the header holds
+ * the data.  Decompressed copies handed out to consumers are not charged.
+ * Each arc_ds_t is published as a "zfs:0:arcds_<guid>_<objset>" kstat.
+ *
+ * An open objset also holds its arc_ds_t, and passes it the values of the
+ * dataset's arcquota and arcreservation properties.  arc_adjust() evicts
+ * the buffers of datasets that are over their quota, and
+ * arc_evict_state() leaves alone the buffers of datasets that are within
+ * their reservation, unless it has been asked to evict everything or the
+ * system is short of memory (arc_no_grow).
+ *
+ * The arc_ds_t's are kept in a small hash of AVL trees, keyed by pool
+ * load guid and objset id.  ads_refs and ads_size are updated atomically;
+ * the bucket lock only protects the tree, and entries whose last hold has
+ * been dropped are freed from within arc_adjust_ds().
+ */
+typedef struct arc_ds_stats {
+	kstat_named_t ads_pool;
+	kstat_named_t ads_objset;
+	kstat_named_t ads_size;
+	kstat_named_t ads_quota;
+	kstat_named_t ads_reservation;
+	kstat_named_t ads_evicted;
+} arc_ds_stats_t;
+
+static const arc_ds_stats_t arc_ds_stats_template = {
+	{ "pool",			KSTAT_DATA_STRING },
+	{ "objset",			KSTAT_DATA_UINT64 },
+	{ "size",			KSTAT_DATA_UINT64 },
+	{ "quota",			KSTAT_DATA_UINT64 },
+	{ "reservation",		KSTAT_DATA_UINT64 },
+	{ "evicted",			KSTAT_DATA_UINT64 }
+};
+
+struct arc_ds {
+	avl_node_t	ads_node;
+	uint64_t	ads_spa;	/* spa load guid */
+	uint64_t	ads_objset;	/* objset id */
+	uint64_t	ads_refs;	/* holds by objsets and headers */
+	uint64_t	ads_size;	/* bytes of cached data charged */
+	uint64_t	ads_quota;	/* arcquota, zero if none */
+	uint64_t	ads_reserve;	/* arcreservation, zero if none */
+	uint64_t	ads_evicted;	/* bytes evicted */
+	char		ads_pool[ZFS_MAX_DATASET_NAME_LEN];
+	kstat_t		*ads_ksp;
+	arc_ds_stats_t	ads_stats;
+};
+
+#define	ARC_DS_BUCKETS	64
+
+typedef struct arc_ds_bucket {
+	kmutex_t	adb_lock;
+	avl_tree_t	adb_tree;
+} arc_ds_bucket_t;
+
+static arc_ds_bucket_t arc_ds_table[ARC_DS_BUCKETS];
+
+#define	ARC_DS_BUCKET(spa, objset) \
+	(&arc_ds_table[((spa) + (objset)) & (ARC_DS_BUCKETS - 1)])
+
 struct arc_buf_hdr {
 	/* protected by hash lock */
 	dva_t			b_dva;
@@ -986,12 +1129,18 @@ struct arc_buf_hdr {
 
 struct ht_lock {
 	kmutex_t	ht_lock;
+	volatile uint64_t ht_seq;	/* odd while a chain is changing */
 #ifdef _KERNEL
-	unsigned char	pad[(HT_LOCK_PAD - sizeof (kmutex_t))];
+	unsigned char	pad[(HT_LOCK_PAD - sizeof (kmutex_t) -
+	    sizeof (uint64_t))];
 #endif
 };
 
-#define	BUF_LOCKS 256
+/*
+ * Every hash table hit takes one of these locks, so keep enough of them
+ * that busy readers rarely share a stripe.
+ */
+#define	BUF_LOCKS 2048
 typedef struct buf_hash_table {
 	uint64_t ht_mask;
 	arc_buf_hdr_t **ht_table;
@@ -1007,7 +1156,21 @@ static buf_hash_table_t buf_hash_table;
 #define	HDR_LOCK(hdr) \
 	(BUF_HASH_LOCK(BUF_HASH_INDEX(hdr->b_spa, &hdr->b_dva, hdr->b_birth)))
 
+/*
+ * Lockless hash table searches are counted per CPU, split by the parity
+ * of arc_hash_epoch when they began, so that arc_hdr_free_deferred() can
+ * wait for those that might still see a header that has left the table.
+ */
+typedef struct arc_hash_reader {
+	uint64_t	ahr_count[2];
+	char		ahr_pad[64 - 2 * sizeof (uint64_t)];
+} arc_hash_reader_t;
+
+static arc_hash_reader_t *arc_hash_readers;
+static volatile uint_t arc_hash_epoch;
+
 uint64_t zfs_crc64_table[256];
+uint64_t zfs_crc64_slice[ZFS_CRC64_SLICES][256];
 
 /*
  * Level 2 ARC
@@ -1036,6 +1199,94 @@ uint64_t l2arc_feed_min_ms = L2ARC_FEED_MIN_MS;	/* min interval milliseconds */
 boolean_t l2arc_noprefetch = B_TRUE;		/* don't cache prefetch bufs */
 boolean_t l2arc_feed_again = B_TRUE;		/* turbo warmup */
 boolean_t l2arc_norw = B_TRUE;			/* no reads during writes */
+boolean_t l2arc_rebuild_enabled = B_TRUE;	/* rebuild on device add */
+
+/*
+ * Persistent L2ARC on-disk structures.  See the "L2ARC persistence"
+ * section of the big L2ARC comment below for how these fit together.
+ */
+#define	L2ARC_DEV_HDR_MAGIC	0x5045524c32415243ULL	/* "PERL2ARC" */
+#define	L2ARC_LOG_BLK_MAGIC	0x4c4f47424c4b4844ULL	/* "LOGBLKHD" */
+#define	L2ARC_PERSIST_VERSION	1
+
+/*
+ * Number of buffers described by a single log block.  This is chosen so
+ * that a log block is a whole number of SPA_MINBLOCKSIZE sectors just under
+ * 64k in size.
+ */
+#define	L2ARC_LOG_BLK_ENTRIES	1352
+
+/* dh_flags */
+#define	L2ARC_DEV_HDR_FIRST	(1ULL << 0)	/* device not yet wrapped */
+
+/*
+ * Pointer to a log block on the device.  lbp_payload_start is the lowest
+ * device address used by any of the buffers described by the log block;
+ * those buffers always lie between it and the log block itself.
+ */
+typedef struct l2arc_log_blkptr {
+	uint64_t	lbp_daddr;		/* device address of log blk */
+	uint64_t	lbp_payload_start;	/* start of described bufs */
+	uint64_t	lbp_asize;		/* allocated size of log blk */
+	zio_cksum_t	lbp_cksum;		/* fletcher4 of log blk */
+} l2arc_log_blkptr_t;
+
+/*
+ * The device header lives in the first block following the front vdev
+ * labels and is rewritten after every L2ARC feed that wrote any buffers.
+ */
+typedef struct l2arc_dev_hdr_phys {
+	uint64_t		dh_magic;	/* L2ARC_DEV_HDR_MAGIC */
+	uint64_t		dh_version;	/* L2ARC_PERSIST_VERSION */
+	uint64_t		dh_spa_guid;	/* pool this device belongs to */
+	uint64_t		dh_vdev_guid;	/* guid of the cache vdev */
+	uint64_t		dh_start;	/* l2ad_start when written */
+	uint64_t		dh_end;		/* l2ad_end when written */
+	uint64_t		dh_hand;	/* l2ad_hand when written */
+	uint64_t		dh_flags;	/* L2ARC_DEV_HDR_* */
+	l2arc_log_blkptr_t	dh_start_lbp;	/* most recent log blk */
+	uint64_t		dh_pad[45];	/* pad to SPA_MINBLOCKSIZE */
+	zio_cksum_t		dh_self_cksum;	/* fletcher4 of fields above */
+} l2arc_dev_hdr_phys_t;
+
+/*
+ * A single buffer as recorded in a log block.  le_prop packs the logical
+ * and physical sizes, compression and buffer type, see L2BLK_* below.
+ */
+typedef struct l2arc_log_ent_phys {
+	dva_t			le_dva;		/* dva of buffer */
+	uint64_t		le_birth;	/* birth txg of buffer */
+	uint64_t		le_prop;	/* sizes, compression, type */
+	uint64_t		le_daddr;	/* buf location on l2dev */
+	uint64_t		le_pad;		/* reserved for future use */
+} l2arc_log_ent_phys_t;
+
+typedef struct l2arc_log_blk_phys {
+	uint64_t		lb_magic;	/* L2ARC_LOG_BLK_MAGIC */
+	uint64_t		lb_nentries;	/* entries in use */
+	l2arc_log_blkptr_t	lb_prev_lbp;	/* previous log blk, if any */
+	uint64_t		lb_pad[7];	/* pad header to 128 bytes */
+	l2arc_log_ent_phys_t	lb_entries[L2ARC_LOG_BLK_ENTRIES];
+} l2arc_log_blk_phys_t;
+
+CTASSERT(sizeof (l2arc_dev_hdr_phys_t) == SPA_MINBLOCKSIZE);
+CTASSERT(IS_P2ALIGNED(sizeof (l2arc_log_blk_phys_t), SPA_MINBLOCKSIZE));
+
+#define	L2BLK_GET_LSIZE(field)	\
+	BF64_GET_SB((field), 0, SPA_LSIZEBITS, SPA_MINBLOCKSHIFT, 1)
+#define	L2BLK_SET_LSIZE(field, x)	\
+	BF64_SET_SB((field), 0, SPA_LSIZEBITS, SPA_MINBLOCKSHIFT, 1, x)
+#define	L2BLK_GET_PSIZE(field)	\
+	BF64_GET_SB((field), 16, SPA_PSIZEBITS, SPA_MINBLOCKSHIFT, 1)
+#define	L2BLK_SET_PSIZE(field, x)	\
+	BF64_SET_SB((field), 16, SPA_PSIZEBITS, SPA_MINBLOCKSHIFT, 1, x)
+#define	L2BLK_GET_COMPRESS(field)	BF64_GET((field), 32, SPA_COMPRESSBITS)
+#define	L2BLK_SET_COMPRESS(field, x)	\
+	BF64_SET((field), 32, SPA_COMPRESSBITS, x)
+#define	L2BLK_GET_TYPE(field)		BF64_GET((field), 48, 8)
+#define	L2BLK_SET_TYPE(field, x)	BF64_SET((field), 48, 8, x)
+#define	L2BLK_GET_COMPRESSED_ARC(field)	BF64_GET((field), 62, 1)
+#define	L2BLK_SET_COMPRESSED_ARC(field, x)	BF64_SET((field), 62, 1, x)
 
 /*
  * L2ARC Internals
@@ -1052,6 +1303,18 @@ struct l2arc_dev {
 	list_t			l2ad_buflist;	/* buffer list */
 	list_node_t		l2ad_node;	/* device list node */
 	refcount_t		l2ad_alloc;	/* allocated bytes */
+
+	/* persistent L2ARC state, protected by the feed/rebuild thread */
+	l2arc_dev_hdr_phys_t	*l2ad_dev_hdr;	/* in-core device header */
+	uint64_t		l2ad_dev_hdr_asize; /* aligned dev hdr size */
+	l2arc_log_blk_phys_t	*l2ad_log_blk;	/* log blk being filled */
+	uint64_t		l2ad_log_blk_asize; /* aligned log blk size */
+	uint64_t		l2ad_log_payload_start; /* of l2ad_log_blk */
+	boolean_t		l2ad_log_dirty;	/* dev hdr needs rewriting */
+
+	/* protected by l2arc_rebuild_thr_lock */
+	boolean_t		l2ad_rebuild;	/* rebuild in progress */
+	boolean_t		l2ad_rebuild_cancel; /* stop rebuilding */
 };
 
 static list_t L2ARC_dev_list;			/* device list */
@@ -1083,10 +1346,24 @@ typedef struct l2arc_data_free {
 	list_node_t	l2df_list_node;
 } l2arc_data_free_t;
 
+/*
+ * A filled log block waiting to be written out once the buffers it
+ * describes have reached the device.
+ */
+typedef struct l2arc_log_blk_pending {
+	void		*lbpd_data;
+	uint64_t	lbpd_daddr;
+	uint64_t	lbpd_asize;
+	list_node_t	lbpd_node;
+} l2arc_log_blk_pending_t;
+
 static kmutex_t l2arc_feed_thr_lock;
 static kcondvar_t l2arc_feed_thr_cv;
 static uint8_t l2arc_thread_exit;
 
+static kmutex_t l2arc_rebuild_thr_lock;
+static kcondvar_t l2arc_rebuild_thr_cv;
+
 static void *arc_get_data_buf(arc_buf_hdr_t *, uint64_t, void *);
 static void arc_free_data_buf(arc_buf_hdr_t *, void *, uint64_t, void *);
 static void arc_hdr_free_pdata(arc_buf_hdr_t *hdr);
@@ -1102,6 +1379,7 @@ static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
 static void l2arc_read_done(zio_t *);
+static void l2arc_dev_rebuild_thread(l2arc_dev_t *);
 
 static uint64_t
 buf_hash(uint64_t spa, const dva_t *dva, uint64_t birth)
@@ -1143,10 +1421,61 @@ buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 	const dva_t *dva = BP_IDENTITY(bp);
 	uint64_t birth = BP_PHYSICAL_BIRTH(bp);
 	uint64_t idx = BUF_HASH_INDEX(spa, dva, birth);
-	kmutex_t *hash_lock = BUF_HASH_LOCK(idx);
-	arc_buf_hdr_t *hdr;
+	struct ht_lock *htl = &BUF_HASH_LOCK_NTRY(idx);
+	kmutex_t *hash_lock = &htl->ht_lock;
+	arc_hash_reader_t *ahr;
+	arc_buf_hdr_t *hdr = NULL;
+	boolean_t valid;
+	uint64_t seq;
+	uint_t e;
+
+	/*
+	 * Search the chain without the hash lock first.  ht_seq is odd
+	 * while any chain in the stripe is being changed, and has moved on
+	 * once it has been, so if it is even and the same before and after
+	 * the search, the search saw a consistent chain.  Being counted in
+	 * arc_hash_readers keeps the headers we pass from being freed under
+	 * us (see arc_hdr_free()).  A miss then needs no lock.  A hit takes
+	 * the lock only to return it held: if the stripe is still unchanged
+	 * once we have it, the header is still in the table, and we check
+	 * its identity again under the lock.  Otherwise, or if a writer got
+	 * in the way, we search again under the lock.  Callers that go on
+	 * to insert a header after a miss already cope with losing that
+	 * race in buf_hash_insert().
+	 */
+	ahr = &arc_hash_readers[CPU_SEQID];
+	e = arc_hash_epoch & 1;
+	atomic_inc_64(&ahr->ahr_count[e]);
+	membar_enter();
+
+	seq = htl->ht_seq;
+	membar_consumer();
+	valid = ((seq & 1) == 0);
+	if (valid) {
+		for (hdr = *(arc_buf_hdr_t * volatile *)
+		    &buf_hash_table.ht_table[idx]; hdr != NULL;
+		    hdr = *(arc_buf_hdr_t * volatile *)&hdr->b_hash_next) {
+			if (HDR_EQUAL(spa, dva, birth, hdr))
+				break;
+		}
+		membar_consumer();
+		valid = (htl->ht_seq == seq);
+	}
+
+	membar_exit();
+	atomic_dec_64(&ahr->ahr_count[e]);
+
+	if (valid && hdr == NULL) {
+		*lockp = NULL;
+		return (NULL);
+	}
 
 	mutex_enter(hash_lock);
+	if (valid && htl->ht_seq == seq && HDR_EQUAL(spa, dva, birth, hdr)) {
+		*lockp = hash_lock;
+		return (hdr);
+	}
+
 	for (hdr = buf_hash_table.ht_table[idx]; hdr != NULL;
 	    hdr = hdr->b_hash_next) {
 		if (HDR_EQUAL(spa, dva, birth, hdr)) {
@@ -1192,7 +1521,11 @@ buf_hash_insert(arc_buf_hdr_t *hdr, kmutex_t **lockp)
 	}
 
 	hdr->b_hash_next = buf_hash_table.ht_table[idx];
+	BUF_HASH_LOCK_NTRY(idx).ht_seq++;
+	membar_producer();
 	buf_hash_table.ht_table[idx] = hdr;
+	membar_producer();
+	BUF_HASH_LOCK_NTRY(idx).ht_seq++;
 	arc_hdr_set_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
 	/* collect some hash table performance data */
@@ -1224,8 +1557,12 @@ buf_hash_remove(arc_buf_hdr_t *hdr)
 		ASSERT3P(fhdr, !=, NULL);
 		hdrp = &fhdr->b_hash_next;
 	}
+	BUF_HASH_LOCK_NTRY(idx).ht_seq++;
+	membar_producer();
 	*hdrp = hdr->b_hash_next;
 	hdr->b_hash_next = NULL;
+	membar_producer();
+	BUF_HASH_LOCK_NTRY(idx).ht_seq++;
 	arc_hdr_clear_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
 	/* collect some hash table performance data */
@@ -1243,11 +1580,127 @@ static kmem_cache_t *hdr_full_cache;
 static kmem_cache_t *hdr_l2only_cache;
 static kmem_cache_t *buf_cache;
 
+/*
+ * Headers waiting for lockless hash table searches to finish before they
+ * go back to their caches, linked through b_hash_next: [0] came from
+ * hdr_full_cache, [1] from hdr_l2only_cache.  Once there are
+ * arc_hdr_deferred_max of them a flush is dispatched; the reclaim thread
+ * also flushes them every time around.
+ */
+static kmutex_t arc_hdr_deferred_lock;
+static kcondvar_t arc_hdr_deferred_cv;
+static kmutex_t arc_hdr_epoch_lock;		/* one flush at a time */
+static arc_buf_hdr_t *arc_hdr_deferred[2];
+static uint64_t arc_hdr_deferred_count;
+static boolean_t arc_hdr_deferred_dispatched;
+uint64_t arc_hdr_deferred_max = 1024;
+
+static void
+arc_hdr_free_deferred(void)
+{
+	arc_buf_hdr_t *list[2], *hdr;
+	uint_t e;
+
+	mutex_enter(&arc_hdr_deferred_lock);
+	list[0] = arc_hdr_deferred[0];
+	list[1] = arc_hdr_deferred[1];
+	arc_hdr_deferred[0] = arc_hdr_deferred[1] = NULL;
+	arc_hdr_deferred_count = 0;
+	mutex_exit(&arc_hdr_deferred_lock);
+
+	if (list[0] == NULL && list[1] == NULL)
+		return;
+
+	/*
+	 * The headers are all out of the table, so searches that begin
+	 * after this point can't reach them.  Move new searches over to the
+	 * other counters, and wait for those counted under the old parity.
+	 */
+	mutex_enter(&arc_hdr_epoch_lock);
+	e = arc_hash_epoch & 1;
+	atomic_inc_uint(&arc_hash_epoch);
+	membar_enter();
+	for (int c = 0; c < max_ncpus; c++) {
+		while (arc_hash_readers[c].ahr_count[e] != 0)
+			delay(1);
+	}
+	mutex_exit(&arc_hdr_epoch_lock);
+
+	while ((hdr = list[0]) != NULL) {
+		list[0] = hdr->b_hash_next;
+		hdr->b_hash_next = NULL;
+		kmem_cache_free(hdr_full_cache, hdr);
+	}
+	while ((hdr = list[1]) != NULL) {
+		list[1] = hdr->b_hash_next;
+		hdr->b_hash_next = NULL;
+		kmem_cache_free(hdr_l2only_cache, hdr);
+	}
+}
+
+/* ARGSUSED */
+static void
+arc_hdr_free_deferred_task(void *arg)
+{
+	arc_hdr_free_deferred();
+
+	mutex_enter(&arc_hdr_deferred_lock);
+	arc_hdr_deferred_dispatched = B_FALSE;
+	cv_broadcast(&arc_hdr_deferred_cv);
+	mutex_exit(&arc_hdr_deferred_lock);
+}
+
+/*
+ * Free a header that may have been in the hash table.  buf_hash_find()
+ * searches chains without the hash lock, so a header that has just been
+ * removed may still be looked at; it goes back to its cache only once
+ * every search that might see it is done.
+ */
+static void
+arc_hdr_free(arc_buf_hdr_t *hdr, kmem_cache_t *cache)
+{
+	int i = (cache == hdr_full_cache) ? 0 : 1;
+	boolean_t dispatch = B_FALSE;
+
+	ASSERT(cache == hdr_full_cache || cache == hdr_l2only_cache);
+	ASSERT(!HDR_IN_HASH_TABLE(hdr));
+	ASSERT3P(hdr->b_hash_next, ==, NULL);
+
+	mutex_enter(&arc_hdr_deferred_lock);
+	hdr->b_hash_next = arc_hdr_deferred[i];
+	arc_hdr_deferred[i] = hdr;
+	if (++arc_hdr_deferred_count >= arc_hdr_deferred_max &&
+	    !arc_hdr_deferred_dispatched) {
+		arc_hdr_deferred_dispatched = B_TRUE;
+		dispatch = B_TRUE;
+	}
+	mutex_exit(&arc_hdr_deferred_lock);
+
+	if (dispatch && taskq_dispatch(system_taskq,
+	    arc_hdr_free_deferred_task, NULL, TQ_NOSLEEP) == NULL) {
+		/* the reclaim thread will get to them */
+		mutex_enter(&arc_hdr_deferred_lock);
+		arc_hdr_deferred_dispatched = B_FALSE;
+		mutex_exit(&arc_hdr_deferred_lock);
+	}
+}
+
 static void
 buf_fini(void)
 {
 	int i;
 
+	mutex_enter(&arc_hdr_deferred_lock);
+	while (arc_hdr_deferred_dispatched)
+		cv_wait(&arc_hdr_deferred_cv, &arc_hdr_deferred_lock);
+	mutex_exit(&arc_hdr_deferred_lock);
+	arc_hdr_free_deferred();
+	kmem_free(arc_hash_readers, max_ncpus * sizeof (arc_hash_reader_t));
+	arc_hash_readers = NULL;
+	mutex_destroy(&arc_hdr_deferred_lock);
+	cv_destroy(&arc_hdr_deferred_cv);
+	mutex_destroy(&arc_hdr_epoch_lock);
+
 	kmem_free(buf_hash_table.ht_table,
 	    (buf_hash_table.ht_mask + 1) * sizeof (void *));
 	for (i = 0; i < BUF_LOCKS; i++)
@@ -1393,10 +1846,26 @@ retry:
 		for (ct = zfs_crc64_table + i, *ct = i, j = 8; j > 0; j--)
 			*ct = (*ct >> 1) ^ (-(*ct & 1) & ZFS_CRC64_POLY);
 
+	for (i = 0; i < 256; i++) {
+		uint64_t crc = zfs_crc64_table[i];
+
+		zfs_crc64_slice[0][i] = crc;
+		for (j = 1; j < ZFS_CRC64_SLICES; j++) {
+			crc = (crc >> 8) ^ zfs_crc64_table[crc & 0xFF];
+			zfs_crc64_slice[j][i] = crc;
+		}
+	}
+
 	for (i = 0; i < BUF_LOCKS; i++) {
 		mutex_init(&buf_hash_table.ht_locks[i].ht_lock,
 		    NULL, MUTEX_DEFAULT, NULL);
 	}
+
+	arc_hash_readers = kmem_zalloc(max_ncpus * sizeof (arc_hash_reader_t),
+	    KM_SLEEP);
+	mutex_init(&arc_hdr_deferred_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&arc_hdr_deferred_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&arc_hdr_epoch_lock, NULL, MUTEX_DEFAULT, NULL);
 }
 
 #define	ARC_MINTIME	(hz>>4) /* 62 ms */
@@ -1769,6 +2238,224 @@ arc_hdr_size(arc_buf_hdr_t *hdr)
 	return (size);
 }
 
+static int
+arc_ds_compare(const void *x1, const void *x2)
+{
+	const arc_ds_t *ads1 = x1;
+	const arc_ds_t *ads2 = x2;
+
+	if (ads1->ads_spa < ads2->ads_spa)
+		return (-1);
+	if (ads1->ads_spa > ads2->ads_spa)
+		return (1);
+	if (ads1->ads_objset < ads2->ads_objset)
+		return (-1);
+	if (ads1->ads_objset > ads2->ads_objset)
+		return (1);
+	return (0);
+}
+
+static int
+arc_ds_kstat_update(kstat_t *ksp, int rw)
+{
+	arc_ds_t *ads = ksp->ks_private;
+	arc_ds_stats_t *ads_stats = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	ads_stats->ads_objset.value.ui64 = ads->ads_objset;
+	ads_stats->ads_size.value.ui64 = ads->ads_size;
+	ads_stats->ads_quota.value.ui64 = ads->ads_quota;
+	ads_stats->ads_reservation.value.ui64 = ads->ads_reserve;
+	ads_stats->ads_evicted.value.ui64 = ads->ads_evicted;
+
+	return (0);
+}
+
+static void
+arc_ds_kstat_create(arc_ds_t *ads)
+{
+	arc_ds_stats_t *ads_stats = &ads->ads_stats;
+	char name[KSTAT_STRLEN];
+
+	(void) snprintf(name, sizeof (name), "arcds_%llx_%llu",
+	    (u_longlong_t)ads->ads_spa, (u_longlong_t)ads->ads_objset);
+
+	*ads_stats = arc_ds_stats_template;
+	KSTAT_NAMED_STR_PTR(&ads_stats->ads_pool) = ads->ads_pool;
+	KSTAT_NAMED_STR_BUFLEN(&ads_stats->ads_pool) =
+	    strlen(ads->ads_pool) + 1;
+
+	ads->ads_ksp = kstat_create("zfs", 0, name, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (arc_ds_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ads->ads_ksp != NULL) {
+		ads->ads_ksp->ks_data = ads_stats;
+		ads->ads_ksp->ks_data_size +=
+		    KSTAT_NAMED_STR_BUFLEN(&ads_stats->ads_pool);
+		ads->ads_ksp->ks_private = ads;
+		ads->ads_ksp->ks_update = arc_ds_kstat_update;
+		kstat_install(ads->ads_ksp);
+	}
+}
+
+/*
+ * Look up (creating it if need be) and hold the usage accounting of the
+ * given objset of the given pool.
+ */
+arc_ds_t *
+arc_ds_hold(spa_t *spa, uint64_t objset)
+{
+	uint64_t guid = spa_load_guid(spa);
+	arc_ds_bucket_t *adb = ARC_DS_BUCKET(guid, objset);
+	arc_ds_t search, *ads;
+	avl_index_t where;
+
+	search.ads_spa = guid;
+	search.ads_objset = objset;
+
+	mutex_enter(&adb->adb_lock);
+	ads = avl_find(&adb->adb_tree, &search, &where);
+	if (ads == NULL) {
+		ads = kmem_zalloc(sizeof (arc_ds_t), KM_PUSHPAGE);
+		ads->ads_spa = guid;
+		ads->ads_objset = objset;
+		(void) strlcpy(ads->ads_pool, spa_name(spa),
+		    sizeof (ads->ads_pool));
+		arc_ds_kstat_create(ads);
+		avl_insert(&adb->adb_tree, ads, where);
+	}
+	atomic_inc_64(&ads->ads_refs);
+	mutex_exit(&adb->adb_lock);
+
+	return (ads);
+}
+
+/*
+ * Drop a hold. This may be called with hash and sublist locks held, so
+ * an unreferenced arc_ds_t is left for arc_adjust_ds() to free.
+ */
+void
+arc_ds_rele(arc_ds_t *ads)
+{
+	ASSERT3U(ads->ads_refs, >, 0);
+	atomic_dec_64(&ads->ads_refs);
+}
+
+void
+arc_ds_set_quota(arc_ds_t *ads, uint64_t quota)
+{
+	ads->ads_quota = quota;
+}
+
+void
+arc_ds_set_reservation(arc_ds_t *ads, uint64_t reserve)
+{
+	ads->ads_reserve = reserve;
+}
+
+static void
+arc_ds_free(arc_ds_t *ads)
+{
+	ASSERT0(ads->ads_refs);
+	ASSERT0(ads->ads_size);
+
+	if (ads->ads_ksp != NULL)
+		kstat_delete(ads->ads_ksp);
+	kmem_free(ads, sizeof (arc_ds_t));
+}
+
+static void
+arc_hdr_clear_ds(arc_buf_hdr_t *hdr)
+{
+	arc_ds_t *ads = hdr->b_l1hdr.b_ds;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+
+	if (ads == NULL)
+		return;
+
+	if (hdr->b_l1hdr.b_pdata != NULL)
+		atomic_add_64(&ads->ads_size, -arc_hdr_size(hdr));
+	hdr->b_l1hdr.b_ds = NULL;
+	arc_ds_rele(ads);
+}
+
+/*
+ * Charge the header's data to the dataset the bookmark belongs to.
+ */
+static void
+arc_hdr_set_ds(arc_buf_hdr_t *hdr, spa_t *spa, const zbookmark_phys_t *zb)
+{
+	arc_ds_t *ads = hdr->b_l1hdr.b_ds;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+
+	if (!zfs_arc_ds_accounting || zb == NULL)
+		return;
+	if (ads != NULL && ads->ads_objset == zb->zb_objset)
+		return;
+
+	arc_hdr_clear_ds(hdr);
+	ads = arc_ds_hold(spa, zb->zb_objset);
+	hdr->b_l1hdr.b_ds = ads;
+	if (hdr->b_l1hdr.b_pdata != NULL)
+		atomic_add_64(&ads->ads_size, arc_hdr_size(hdr));
+}
+
+/*
+ * Adjust the charge for the header's data as b_pdata comes and goes.
+ */
+static void
+arc_hdr_ds_space(arc_buf_hdr_t *hdr, int64_t space)
+{
+	if (hdr->b_l1hdr.b_ds != NULL)
+		atomic_add_64(&hdr->b_l1hdr.b_ds->ads_size, space);
+}
+
+/*
+ * Returns true if the header's data should be kept in the cache because its
+ * dataset is within its arcreservation.
+ */
+static boolean_t
+arc_hdr_ds_reserved(arc_buf_hdr_t *hdr)
+{
+	arc_ds_t *ads = hdr->b_l1hdr.b_ds;
+
+	return (ads != NULL && ads->ads_reserve != 0 &&
+	    !GHOST_STATE(hdr->b_l1hdr.b_state) &&
+	    ads->ads_size <= ads->ads_reserve);
+}
+
+static void
+arc_ds_init(void)
+{
+	for (int i = 0; i < ARC_DS_BUCKETS; i++) {
+		arc_ds_bucket_t *adb = &arc_ds_table[i];
+
+		mutex_init(&adb->adb_lock, NULL, MUTEX_DEFAULT, NULL);
+		avl_create(&adb->adb_tree, arc_ds_compare, sizeof (arc_ds_t),
+		    offsetof(arc_ds_t, ads_node));
+	}
+}
+
+static void
+arc_ds_fini(void)
+{
+	for (int i = 0; i < ARC_DS_BUCKETS; i++) {
+		arc_ds_bucket_t *adb = &arc_ds_table[i];
+		arc_ds_t *ads;
+		void *cookie = NULL;
+
+		while ((ads = avl_destroy_nodes(&adb->adb_tree,
+		    &cookie)) != NULL)
+			arc_ds_free(ads);
+		avl_destroy(&adb->adb_tree);
+		mutex_destroy(&adb->adb_lock);
+	}
+}
+
 /*
  * Increment the amount of evictable space in the arc_state_t's refcount.
  * We account for the space used by the hdr and the arc buf individually
@@ -2350,6 +3037,7 @@ arc_share_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	refcount_transfer_ownership(&state->arcs_size, buf, hdr);
 	hdr->b_l1hdr.b_pdata = buf->b_data;
 	arc_hdr_set_flags(hdr, ARC_FLAG_SHARED_DATA);
+	arc_hdr_ds_space(hdr, arc_hdr_size(hdr));
 
 	/*
 	 * Since we've transferred ownership to the hdr we need
@@ -2378,6 +3066,7 @@ arc_unshare_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	refcount_transfer_ownership(&state->arcs_size, hdr, buf);
 	arc_hdr_clear_flags(hdr, ARC_FLAG_SHARED_DATA);
 	hdr->b_l1hdr.b_pdata = NULL;
+	arc_hdr_ds_space(hdr, -arc_hdr_size(hdr));
 
 	/*
 	 * Since the buffer is no longer shared between
@@ -2499,6 +3188,7 @@ arc_hdr_alloc_pdata(arc_buf_hdr_t *hdr)
 	hdr->b_l1hdr.b_pdata = arc_get_data_buf(hdr, arc_hdr_size(hdr), hdr);
 	hdr->b_l1hdr.b_byteswap = DMU_BSWAP_NUMFUNCS;
 	ASSERT3P(hdr->b_l1hdr.b_pdata, !=, NULL);
+	arc_hdr_ds_space(hdr, arc_hdr_size(hdr));
 
 	ARCSTAT_INCR(arcstat_compressed_size, arc_hdr_size(hdr));
 	ARCSTAT_INCR(arcstat_uncompressed_size, HDR_GET_LSIZE(hdr));
@@ -2525,6 +3215,7 @@ arc_hdr_free_pdata(arc_buf_hdr_t *hdr)
 	}
 	hdr->b_l1hdr.b_pdata = NULL;
 	hdr->b_l1hdr.b_byteswap = DMU_BSWAP_NUMFUNCS;
+	arc_hdr_ds_space(hdr, -arc_hdr_size(hdr));
 
 	ARCSTAT_INCR(arcstat_compressed_size, -arc_hdr_size(hdr));
 	ARCSTAT_INCR(arcstat_uncompressed_size, -HDR_GET_LSIZE(hdr));
@@ -2543,6 +3234,7 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 	ASSERT(HDR_EMPTY(hdr));
 	ASSERT3P(hdr->b_l1hdr.b_freeze_cksum, ==, NULL);
 	ASSERT3P(hdr->b_l1hdr.b_thawed, ==, NULL);
+	ASSERT3P(hdr->b_l1hdr.b_ds, ==, NULL);
 	HDR_SET_PSIZE(hdr, psize);
 	HDR_SET_LSIZE(hdr, lsize);
 	hdr->b_spa = spa;
@@ -2626,6 +3318,9 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		VERIFY(!HDR_L2_WRITING(hdr));
 		VERIFY3P(hdr->b_l1hdr.b_pdata, ==, NULL);
 
+		/* an L2-only header isn't charged to any dataset */
+		arc_hdr_clear_ds(hdr);
+
 #ifdef ZFS_DEBUG
 		if (hdr->b_l1hdr.b_thawed != NULL) {
 			kmem_free(hdr->b_l1hdr.b_thawed, 1);
@@ -2668,7 +3363,7 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 	(void) refcount_add_many(&dev->l2ad_alloc, arc_hdr_size(nhdr), nhdr);
 
 	buf_discard_identity(hdr);
-	kmem_cache_free(old, hdr);
+	arc_hdr_free(hdr, old);
 
 	return (nhdr);
 }
@@ -2763,15 +3458,16 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 		if (hdr->b_l1hdr.b_pdata != NULL) {
 			arc_hdr_free_pdata(hdr);
 		}
+		arc_hdr_clear_ds(hdr);
 	}
 
 	ASSERT3P(hdr->b_hash_next, ==, NULL);
 	if (HDR_HAS_L1HDR(hdr)) {
 		ASSERT(!multilist_link_active(&hdr->b_l1hdr.b_arc_node));
 		ASSERT3P(hdr->b_l1hdr.b_acb, ==, NULL);
-		kmem_cache_free(hdr_full_cache, hdr);
+		arc_hdr_free(hdr, hdr_full_cache);
 	} else {
-		kmem_cache_free(hdr_l2only_cache, hdr);
+		arc_hdr_free(hdr, hdr_l2only_cache);
 	}
 }
 
@@ -2914,6 +3610,15 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 
 		bytes_evicted += arc_hdr_size(hdr);
 
+		/*
+		 * A demand read clears ARC_FLAG_PREDICTIVE_PREFETCH, so if
+		 * it is still set the prefetch was never used.
+		 */
+		if (hdr->b_flags & ARC_FLAG_PREDICTIVE_PREFETCH) {
+			ARCSTAT_INCR(arcstat_prefetch_wasted_bytes,
+			    HDR_GET_LSIZE(hdr));
+		}
+
 		/*
 		 * If this hdr is being evicted and has a compressed
 		 * buffer then we discard it here before we change states.
@@ -2933,7 +3638,7 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 
 static uint64_t
 arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
-    uint64_t spa, int64_t bytes)
+    uint64_t spa, arc_ds_t *ds, int64_t bytes)
 {
 	multilist_sublist_t *mls;
 	uint64_t bytes_evicted = 0;
@@ -2983,6 +3688,12 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 			continue;
 		}
 
+		/* or of a certain dataset */
+		if (ds != NULL && hdr->b_l1hdr.b_ds != ds) {
+			ARCSTAT_BUMP(arcstat_evict_skip);
+			continue;
+		}
+
 		hash_lock = HDR_LOCK(hdr);
 
 		/*
@@ -2997,9 +3708,32 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 		ASSERT(!MUTEX_HELD(hash_lock));
 
 		if (mutex_tryenter(hash_lock)) {
-			uint64_t evicted = arc_evict_hdr(hdr, hash_lock);
+			arc_ds_t *ads = hdr->b_l1hdr.b_ds;
+			uint64_t evicted;
+
+			/*
+			 * Unless we've been told to evict everything, or the
+			 * system is short of memory, keep the buffers of
+			 * datasets within their reservation.
+			 */
+			if (bytes != ARC_EVICT_ALL && ds == NULL &&
+			    !arc_no_grow && arc_hdr_ds_reserved(hdr)) {
+				mutex_exit(hash_lock);
+				ARCSTAT_BUMP(arcstat_evict_reserved);
+				continue;
+			}
+
+			/* the header may take its hold with it */
+			if (ads != NULL)
+				atomic_inc_64(&ads->ads_refs);
+			evicted = arc_evict_hdr(hdr, hash_lock);
 			mutex_exit(hash_lock);
 
+			if (ads != NULL) {
+				atomic_add_64(&ads->ads_evicted, evicted);
+				arc_ds_rele(ads);
+			}
+
 			bytes_evicted += evicted;
 
 			/*
@@ -3042,6 +3776,86 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 	return (bytes_evicted);
 }
 
+/*
+ * One share of a parallel eviction: the sublists idx, idx + stride, ...
+ * of the multilist, and the number of bytes to evict from them.
+ */
+typedef struct arc_evict_arg {
+	multilist_t	*eva_ml;
+	arc_buf_hdr_t	**eva_markers;
+	int		eva_idx;
+	int		eva_stride;
+	uint64_t	eva_spa;
+	arc_ds_t	*eva_ds;
+	uint64_t	eva_bytes;
+	uint64_t	eva_evicted;
+} arc_evict_arg_t;
+
+static void
+arc_evict_task(void *arg)
+{
+	arc_evict_arg_t *eva = arg;
+	int num_sublists = multilist_get_num_sublists(eva->eva_ml);
+
+	while (eva->eva_evicted < eva->eva_bytes) {
+		uint64_t scan_evicted = 0;
+
+		for (int i = eva->eva_idx; i < num_sublists &&
+		    eva->eva_evicted < eva->eva_bytes; i += eva->eva_stride) {
+			uint64_t evicted = arc_evict_state_impl(eva->eva_ml,
+			    i, eva->eva_markers[i], eva->eva_spa, eva->eva_ds,
+			    eva->eva_bytes - eva->eva_evicted);
+
+			scan_evicted += evicted;
+			eva->eva_evicted += evicted;
+		}
+
+		if (scan_evicted == 0)
+			break;
+	}
+}
+
+/*
+ * Split a large eviction over the eviction taskq, with the calling thread
+ * taking the first share.  Returns the number of bytes evicted.
+ */
+static uint64_t
+arc_evict_parallel(multilist_t *ml, arc_buf_hdr_t **markers, int ntasks,
+    uint64_t spa, arc_ds_t *ds, uint64_t bytes)
+{
+	arc_evict_arg_t *eva;
+	uint64_t evicted = 0;
+
+	eva = kmem_zalloc(sizeof (*eva) * ntasks, KM_SLEEP);
+	for (int t = 0; t < ntasks; t++) {
+		eva[t].eva_ml = ml;
+		eva[t].eva_markers = markers;
+		eva[t].eva_idx = t;
+		eva[t].eva_stride = ntasks;
+		eva[t].eva_spa = spa;
+		eva[t].eva_ds = ds;
+		eva[t].eva_bytes = bytes / ntasks;
+	}
+	eva[0].eva_bytes += bytes % ntasks;
+
+	for (int t = 1; t < ntasks; t++) {
+		if (taskq_dispatch(arc_evict_taskq, arc_evict_task, &eva[t],
+		    TQ_NOSLEEP) == NULL)
+			arc_evict_task(&eva[t]);
+	}
+	arc_evict_task(&eva[0]);
+	taskq_wait(arc_evict_taskq);
+
+	for (int t = 0; t < ntasks; t++)
+		evicted += eva[t].eva_evicted;
+	kmem_free(eva, sizeof (*eva) * ntasks);
+
+	ARCSTAT_BUMP(arcstat_evict_parallel);
+	ARCSTAT_INCR(arcstat_evict_tasks, ntasks);
+
+	return (evicted);
+}
+
 /*
  * Evict buffers from the given arc state, until we've removed the
  * specified number of bytes. Move the removed buffers to the
@@ -3054,15 +3868,19 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
  * If bytes is specified using the special value ARC_EVICT_ALL, this
  * will evict all available (i.e. unlocked and evictable) buffers from
  * the given arc state; which is used by arc_flush().
+ *
+ * A non-zero spa, or a non-NULL ds, restricts eviction to the buffers of
+ * that pool or dataset.
  */
 static uint64_t
-arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
-    arc_buf_contents_t type)
+arc_evict_state(arc_state_t *state, uint64_t spa, arc_ds_t *ds,
+    int64_t bytes, arc_buf_contents_t type)
 {
 	uint64_t total_evicted = 0;
 	multilist_t *ml = &state->arcs_list[type];
 	int num_sublists;
 	arc_buf_hdr_t **markers;
+	hrtime_t start = gethrtime();
 
 	IMPLY(bytes < 0, bytes == ARC_EVICT_ALL);
 
@@ -3091,6 +3909,22 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 		multilist_sublist_unlock(mls);
 	}
 
+	/*
+	 * Hand big requests to the eviction threads first; whatever they
+	 * leave, because their sublists ran dry, the loop below picks up
+	 * from the rest.
+	 */
+	if (bytes != ARC_EVICT_ALL && arc_evict_taskq != NULL) {
+		uint64_t ntasks = bytes / MAX(zfs_arc_evict_task_min, 1);
+
+		ntasks = MIN(ntasks, arc_evict_nthreads + 1);
+		ntasks = MIN(ntasks, num_sublists);
+		if (ntasks > 1) {
+			total_evicted = arc_evict_parallel(ml, markers,
+			    (int)ntasks, spa, ds, bytes);
+		}
+	}
+
 	/*
 	 * While we haven't hit our target number of bytes to evict, or
 	 * we're evicting all available buffers.
@@ -3118,7 +3952,7 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 				break;
 
 			bytes_evicted = arc_evict_state_impl(ml, sublist_idx,
-			    markers[sublist_idx], spa, bytes_remaining);
+			    markers[sublist_idx], spa, ds, bytes_remaining);
 
 			scan_evicted += bytes_evicted;
 			total_evicted += bytes_evicted;
@@ -3161,6 +3995,9 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 	}
 	kmem_free(markers, sizeof (*markers) * num_sublists);
 
+	ARCSTAT_INCR(arcstat_evict_bytes, total_evicted);
+	ARCSTAT_INCR(arcstat_evict_time_ns, gethrtime() - start);
+
 	return (total_evicted);
 }
 
@@ -3186,7 +4023,8 @@ arc_flush_state(arc_state_t *state, uint64_t spa, arc_buf_contents_t type,
 	uint64_t evicted = 0;
 
 	while (refcount_count(&state->arcs_esize[type]) != 0) {
-		evicted += arc_evict_state(state, spa, ARC_EVICT_ALL, type);
+		evicted += arc_evict_state(state, spa, NULL, ARC_EVICT_ALL,
+		    type);
 
 		if (!retry)
 			break;
@@ -3209,12 +4047,73 @@ arc_adjust_impl(arc_state_t *state, uint64_t spa, int64_t bytes,
 {
 	int64_t delta;
 
-	if (bytes > 0 && refcount_count(&state->arcs_esize[type]) > 0) {
-		delta = MIN(refcount_count(&state->arcs_esize[type]), bytes);
-		return (arc_evict_state(state, spa, delta, type));
+	if (bytes > 0 && refcount_count(&state->arcs_esize[type]) > 0) {
+		delta = MIN(refcount_count(&state->arcs_esize[type]), bytes);
+		return (arc_evict_state(state, spa, NULL, delta, type));
+	}
+
+	return (0);
+}
+
+/*
+ * Evict the buffers of datasets that are over their arcquota, and free the
+ * arc_ds_t's that nothing holds any more.  Finding a dataset's buffers means
+ * scanning the MRU and MFU lists, so quotas are meant for a limited number
+ * of datasets; this is called once per arc_adjust().
+ */
+static uint64_t
+arc_adjust_ds(void)
+{
+	uint64_t total_evicted = 0;
+
+	for (int i = 0; i < ARC_DS_BUCKETS; i++) {
+		arc_ds_bucket_t *adb = &arc_ds_table[i];
+		arc_ds_t *ads, *next;
+
+		mutex_enter(&adb->adb_lock);
+		for (ads = avl_first(&adb->adb_tree); ads != NULL; ads = next) {
+			arc_state_t *states[] = { arc_mru, arc_mfu };
+
+			if (ads->ads_refs == 0) {
+				next = AVL_NEXT(&adb->adb_tree, ads);
+				avl_remove(&adb->adb_tree, ads);
+				arc_ds_free(ads);
+				continue;
+			}
+
+			if (ads->ads_quota == 0 ||
+			    ads->ads_size <= ads->ads_quota) {
+				next = AVL_NEXT(&adb->adb_tree, ads);
+				continue;
+			}
+
+			/*
+			 * Our hold keeps ads in the tree while we evict
+			 * with the bucket lock dropped.
+			 */
+			atomic_inc_64(&ads->ads_refs);
+			mutex_exit(&adb->adb_lock);
+
+			for (int s = 0; s < 2; s++) {
+				for (int t = 0; t < ARC_BUFC_NUMTYPES; t++) {
+					int64_t over = ads->ads_size -
+					    ads->ads_quota;
+
+					if (over <= 0)
+						break;
+					total_evicted += arc_evict_state(
+					    states[s], 0, ads, over, t);
+				}
+			}
+
+			mutex_enter(&adb->adb_lock);
+			next = AVL_NEXT(&adb->adb_tree, ads);
+			arc_ds_rele(ads);
+		}
+		mutex_exit(&adb->adb_lock);
 	}
 
-	return (0);
+	return (total_evicted);
 }
 
 /*
@@ -3338,6 +4237,12 @@ arc_adjust(void)
 	uint64_t bytes;
 	int64_t target;
 
+	/*
+	 * Datasets over their arcquota give up their buffers first, whether
+	 * or not the cache as a whole needs to shrink.
+	 */
+	total_evicted += arc_adjust_ds();
+
 	/*
 	 * If we're over arc_meta_limit, we want to correct that before
 	 * potentially evicting data buffers below.
@@ -3532,6 +4437,7 @@ typedef enum free_memory_reason_t {
 	FMR_PAGES_PP_MAXIMUM,
 	FMR_HEAP_ARENA,
 	FMR_ZIO_ARENA,
+	FMR_PAGEOUT,
 } free_memory_reason_t;
 
 int64_t last_free_memory;
@@ -3547,6 +4453,35 @@ int64_t arc_pages_pp_reserve = 64;
  */
 int64_t arc_swapfs_reserve = 64;
 
+#ifdef _KERNEL
+/*
+ * Pages the pageout daemon has asked the ARC to give back, as one of its
+ * reclaimers (see pageout_reclaim_register()); cleared once the reclaim
+ * thread has shrunk the ARC to suit.
+ */
+static pgcnt_t arc_pageout_request;
+static void *arc_pageout_hdl;
+
+/* ARGSUSED */
+static pgcnt_t
+arc_pageout_size(void *arg)
+{
+	int64_t n = (int64_t)arc_size - (int64_t)arc_c_min;
+
+	return (n > 0 ? btop(n) : 0);
+}
+
+/* ARGSUSED */
+static void
+arc_pageout_reclaim(void *arg, pgcnt_t npages)
+{
+	arc_pageout_request = npages;
+	mutex_enter(&arc_reclaim_lock);
+	cv_signal(&arc_reclaim_thread_cv);
+	mutex_exit(&arc_reclaim_lock);
+}
+#endif
+
 /*
  * Return the amount of memory that can be consumed before reclaim will be
  * needed.  Positive if there is sufficient free memory, negative indicates
@@ -3568,6 +4503,14 @@ arc_available_memory(void)
 		}
 	}
 
+	if (arc_pageout_request > 0) {
+		n = -(int64_t)ptob(arc_pageout_request);
+		if (n < lowest) {
+			lowest = n;
+			r = FMR_PAGEOUT;
+		}
+	}
+
 	/*
 	 * check that we're out of range of the pageout scanner.  It starts to
 	 * schedule paging if freemem is less than lotsfree and needfree.
@@ -3680,7 +4623,7 @@ arc_kmem_reap_now(void)
 	kmem_cache_t		*prev_data_cache = NULL;
 	extern kmem_cache_t	*zio_buf_cache[];
 	extern kmem_cache_t	*zio_data_buf_cache[];
-	extern kmem_cache_t	*range_seg_cache;
+	extern kmem_cache_t	*zfs_btree_leaf_cache;
 
 #ifdef _KERNEL
 	if (arc_meta_used >= arc_meta_limit) {
@@ -3711,7 +4654,7 @@ arc_kmem_reap_now(void)
 	kmem_cache_reap_now(buf_cache);
 	kmem_cache_reap_now(hdr_full_cache);
 	kmem_cache_reap_now(hdr_l2only_cache);
-	kmem_cache_reap_now(range_seg_cache);
+	kmem_cache_reap_now(zfs_btree_leaf_cache);
 
 	if (zio_arena != NULL) {
 		/*
@@ -3767,6 +4710,8 @@ arc_reclaim_thread(void)
 
 		mutex_exit(&arc_reclaim_lock);
 
+		arc_hdr_free_deferred();
+
 		if (free_memory < 0) {
 
 			arc_no_grow = B_TRUE;
@@ -3794,6 +4739,9 @@ arc_reclaim_thread(void)
 #endif
 				arc_shrink(to_free);
 			}
+#ifdef _KERNEL
+			arc_pageout_request = 0;
+#endif
 		} else if (free_memory < arc_c >> arc_no_grow_shift) {
 			arc_no_grow = B_TRUE;
 		} else if (gethrtime() >= growtime) {
@@ -4380,6 +5328,43 @@ arc_read_done(zio_t *zio)
 		arc_hdr_destroy(hdr);
 }
 
+/*
+ * If the block is cached in its on-disk form (i.e. compressed ARC has kept
+ * the b_pdata compressed exactly as described by bp), copy BP_GET_PSIZE(bp)
+ * bytes of physical data into buf and return B_TRUE.  Otherwise return
+ * B_FALSE; the caller must then read the block itself (e.g. with a
+ * ZIO_FLAG_RAW zio_read()).  This lets zfs send put compressed blocks on
+ * the wire without decompressing and recompressing them.
+ */
+boolean_t
+arc_copy_pdata(spa_t *spa, const blkptr_t *bp, void *buf)
+{
+	arc_buf_hdr_t *hdr;
+	kmutex_t *hash_lock;
+	boolean_t copied = B_FALSE;
+
+	if (BP_IS_EMBEDDED(bp) || BP_IS_HOLE(bp))
+		return (B_FALSE);
+
+	hdr = buf_hash_find(spa_load_guid(spa), bp, &hash_lock);
+	if (hdr == NULL)
+		return (B_FALSE);
+
+	if (HDR_HAS_L1HDR(hdr) && hdr->b_l1hdr.b_pdata != NULL &&
+	    !HDR_IO_IN_PROGRESS(hdr) &&
+	    HDR_GET_COMPRESS(hdr) == BP_GET_COMPRESS(bp) &&
+	    HDR_GET_PSIZE(hdr) == BP_GET_PSIZE(bp)) {
+		ASSERT(hdr->b_l1hdr.b_state == arc_mru ||
+		    hdr->b_l1hdr.b_state == arc_mfu);
+		bcopy(hdr->b_l1hdr.b_pdata, buf, BP_GET_PSIZE(bp));
+		arc_access(hdr, hash_lock);
+		copied = B_TRUE;
+	}
+	mutex_exit(hash_lock);
+
+	return (copied);
+}
+
 /*
  * "Read" the block at the specified DVA (in bp) via the
  * cache.  If the block is found in the cache, invoke the provided
@@ -4553,6 +5538,7 @@ top:
 			arc_buf_contents_t type = BP_GET_BUFC_TYPE(bp);
 			hdr = arc_hdr_alloc(spa_load_guid(spa), psize, lsize,
 			    BP_GET_COMPRESS(bp), type);
+			arc_hdr_set_ds(hdr, spa, zb);
 
 			if (!BP_IS_EMBEDDED(bp)) {
 				hdr->b_dva = *BP_IDENTITY(bp);
@@ -4576,6 +5562,7 @@ top:
 				hdr = arc_hdr_realloc(hdr, hdr_l2only_cache,
 				    hdr_full_cache);
 			}
+			arc_hdr_set_ds(hdr, spa, zb);
 			ASSERT3P(hdr->b_l1hdr.b_pdata, ==, NULL);
 			ASSERT(GHOST_STATE(hdr->b_l1hdr.b_state));
 			ASSERT(!HDR_IO_IN_PROGRESS(hdr));
@@ -5264,9 +6251,10 @@ arc_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp, arc_buf_t *buf,
 	}
 	ASSERT(!arc_buf_is_shared(buf));
 	ASSERT3P(hdr->b_l1hdr.b_pdata, ==, NULL);
+	arc_hdr_set_ds(hdr, spa, zb);
 
-	zio = zio_write(pio, spa, txg, bp, buf->b_data, HDR_GET_LSIZE(hdr), zp,
-	    arc_write_ready,
+	zio = zio_write(pio, spa, txg, bp, buf->b_data, HDR_GET_LSIZE(hdr),
+	    HDR_GET_LSIZE(hdr), zp, arc_write_ready,
 	    (children_ready != NULL) ? arc_write_children_ready : NULL,
 	    arc_write_physdone, arc_write_done, callback,
 	    priority, zio_flags, zb);
@@ -5658,6 +6646,17 @@ arc_init(void)
 	if (zfs_arc_num_sublists_per_state < 1)
 		zfs_arc_num_sublists_per_state = MAX(boot_ncpus, 1);
 
+	arc_evict_nthreads = zfs_arc_evict_threads;
+	if (arc_evict_nthreads < 1)
+		arc_evict_nthreads = MAX(boot_ncpus / 8, 1);
+	if (arc_evict_nthreads > 1) {
+		/* the thread calling arc_evict_state() does one share */
+		arc_evict_nthreads--;
+		arc_evict_taskq = taskq_create("arc_evict", arc_evict_nthreads,
+		    minclsyspri, arc_evict_nthreads, INT_MAX,
+		    TASKQ_PREPOPULATE);
+	}
+
 	/* if kmem_flags are set, lets try to use less memory */
 	if (kmem_debugging())
 		arc_c = arc_c / 2;
@@ -5665,6 +6664,7 @@ arc_init(void)
 		arc_c = arc_c_min;
 
 	arc_state_init();
+	arc_ds_init();
 	buf_init();
 
 	arc_reclaim_thread_exit = B_FALSE;
@@ -5681,6 +6681,11 @@ arc_init(void)
 	(void) thread_create(NULL, 0, arc_reclaim_thread, NULL, 0, &p0,
 	    TS_RUN, minclsyspri);
 
+#ifdef _KERNEL
+	arc_pageout_hdl = pageout_reclaim_register(arc_pageout_size,
+	    arc_pageout_reclaim, NULL);
+#endif
+
 	arc_dead = B_FALSE;
 	arc_warm = B_FALSE;
 
@@ -5703,6 +6708,11 @@ arc_init(void)
 void
 arc_fini(void)
 {
+#ifdef _KERNEL
+	pageout_reclaim_unregister(arc_pageout_hdl);
+	arc_pageout_hdl = NULL;
+#endif
+
 	mutex_enter(&arc_reclaim_lock);
 	arc_reclaim_thread_exit = B_TRUE;
 	/*
@@ -5718,6 +6728,11 @@ arc_fini(void)
 	/* Use B_TRUE to ensure *all* buffers are evicted */
 	arc_flush(NULL, B_TRUE);
 
+	if (arc_evict_taskq != NULL) {
+		taskq_destroy(arc_evict_taskq);
+		arc_evict_taskq = NULL;
+	}
+
 	arc_dead = B_TRUE;
 
 	if (arc_ksp != NULL) {
@@ -5731,6 +6746,7 @@ arc_fini(void)
 
 	arc_state_fini();
 	buf_fini();
+	arc_ds_fini();
 
 	ASSERT0(arc_loaned_bytes);
 }
@@ -5878,6 +6894,47 @@ arc_fini(void)
  *
  * These three functions determine what to write, how much, and how quickly
  * to send writes.
+ *
+ * L2ARC persistence:
+ *
+ * The headers describing the contents of a cache device only live in
+ * memory, so without further help every export or reboot would leave us
+ * with a cold L2ARC that takes hours to refill.  To avoid that, the feed
+ * thread also records every buffer it writes (its DVA, birth txg, sizes,
+ * compression and device address) in an in-core log block.  When the log
+ * block fills up, or when the write hand is about to wrap around to the
+ * start of the device, it is written to the device at the write hand,
+ * right behind the buffers it describes.  Each log block points back at the
+ * log block written before it, and a small device header following the
+ * front vdev labels points at the newest one:
+ *
+ *	+--------+-------------+-----+-------------+-----+------
+ *	| dev    | ARC buffers | LB1 | ARC buffers | LB2 | ...
+ *	| header |             |     |             |     |
+ *	+--------+-------------+-----+-------------+-----+------
+ *	    |                     ^                 |  ^
+ *	    |                     +- lb_prev_lbp ---+  |
+ *	    +-------------- dh_start_lbp --------------+
+ *
+ * The log blocks are only issued once the buffers they describe have been
+ * written, and the device header is rewritten after the log blocks, at the
+ * end of every feed that wrote anything.
+ *
+ * When a cache device is added to the L2ARC (on pool import, or when the
+ * device comes back online), l2arc_add_vdev() starts a rebuild thread.  It
+ * reads the device header and walks the chain of log blocks from the newest
+ * to the oldest, recreating l2c_only headers for every buffer that isn't in
+ * the ARC already.  Pool import doesn't wait for this, and the device isn't
+ * fed while its rebuild is in progress.  The walk stops at the first log
+ * block that fails its checksum, or that lies in a region of the device
+ * which has been overwritten since the log block was written.  Restored
+ * buffers are not trusted blindly: every L2ARC read is still verified
+ * against the block pointer's checksum, so a stale entry merely results in
+ * a read from the main pool.
+ *
+ * Buffers recorded in a partially filled log block are not persisted, so at
+ * most L2ARC_LOG_BLK_ENTRIES buffers per device are lost on export.
+ * Rebuilding can be disabled by setting l2arc_rebuild_enabled to B_FALSE.
  */
 
 static boolean_t
@@ -5982,10 +7039,10 @@ l2arc_dev_get_next(void)
 		else if (next == first)
 			break;
 
-	} while (vdev_is_dead(next->l2ad_vdev));
+	} while (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild);
 
 	/* if we were unable to find any usable vdevs, return NULL */
-	if (vdev_is_dead(next->l2ad_vdev))
+	if (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild)
 		next = NULL;
 
 	l2arc_dev_last = next;
@@ -6378,6 +7435,171 @@ top:
 	mutex_exit(&dev->l2ad_mtx);
 }
 
+/*
+ * Upper bound on the device space taken up by log blocks while writing
+ * 'size' bytes worth of buffers.  l2arc_evict() must clear this much extra
+ * room ahead of the write hand.
+ */
+static uint64_t
+l2arc_log_blk_overhead(l2arc_dev_t *dev, uint64_t size)
+{
+	uint64_t nblks = howmany(size >> SPA_MINBLOCKSHIFT,
+	    L2ARC_LOG_BLK_ENTRIES) + 1;
+
+	return (nblks * dev->l2ad_log_blk_asize);
+}
+
+/*
+ * Record a buffer which is about to be written to the device in the
+ * in-core log block.  The caller must hold the hdr's hash lock.
+ */
+static void
+l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
+{
+	l2arc_log_blk_phys_t *lb = dev->l2ad_log_blk;
+	l2arc_log_ent_phys_t *le;
+
+	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
+	ASSERT3U(lb->lb_nentries, <, L2ARC_LOG_BLK_ENTRIES);
+
+	if (lb->lb_nentries == 0)
+		dev->l2ad_log_payload_start = hdr->b_l2hdr.b_daddr;
+
+	le = &lb->lb_entries[lb->lb_nentries++];
+	le->le_dva = hdr->b_dva;
+	le->le_birth = hdr->b_birth;
+	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	le->le_prop = 0;
+	L2BLK_SET_LSIZE(le->le_prop, HDR_GET_LSIZE(hdr));
+	L2BLK_SET_PSIZE(le->le_prop, HDR_GET_PSIZE(hdr));
+	L2BLK_SET_COMPRESS(le->le_prop, HDR_GET_COMPRESS(hdr));
+	L2BLK_SET_TYPE(le->le_prop, hdr->b_type);
+	L2BLK_SET_COMPRESSED_ARC(le->le_prop,
+	    HDR_COMPRESSION_ENABLED(hdr) ? 1 : 0);
+	le->le_pad = 0;
+}
+
+/*
+ * Seal the in-core log block and claim space for it at the write hand.  The
+ * sealed copy is queued on 'pending' and is only written out by
+ * l2arc_log_blk_write_pending() once the buffers it describes have reached
+ * the device.
+ */
+static void
+l2arc_log_blk_commit(l2arc_dev_t *dev, list_t *pending)
+{
+	l2arc_log_blk_phys_t *lb = dev->l2ad_log_blk;
+	l2arc_dev_hdr_phys_t *dh = dev->l2ad_dev_hdr;
+	l2arc_log_blkptr_t *lbp = &dh->dh_start_lbp;
+	l2arc_log_blk_pending_t *lbpd;
+	uint64_t asize = dev->l2ad_log_blk_asize;
+
+	if (lb->lb_nentries == 0)
+		return;
+
+	/*
+	 * This can only happen if l2arc_write_max was raised while we were
+	 * close to the end of the device.  Just forget about these buffers;
+	 * they remain cached, they simply won't survive a rebuild.
+	 */
+	if (dev->l2ad_hand + asize > dev->l2ad_end) {
+		bzero(lb, sizeof (l2arc_log_blk_phys_t));
+		return;
+	}
+
+	lb->lb_magic = L2ARC_LOG_BLK_MAGIC;
+	lb->lb_prev_lbp = *lbp;
+
+	lbpd = kmem_alloc(sizeof (l2arc_log_blk_pending_t), KM_SLEEP);
+	lbpd->lbpd_data = zio_buf_alloc(asize);
+	lbpd->lbpd_daddr = dev->l2ad_hand;
+	lbpd->lbpd_asize = asize;
+	bzero(lbpd->lbpd_data, asize);
+	bcopy(lb, lbpd->lbpd_data, sizeof (l2arc_log_blk_phys_t));
+	list_insert_tail(pending, lbpd);
+
+	lbp->lbp_daddr = dev->l2ad_hand;
+	lbp->lbp_payload_start = dev->l2ad_log_payload_start;
+	lbp->lbp_asize = asize;
+	fletcher_4_native(lbpd->lbpd_data, asize, NULL, &lbp->lbp_cksum);
+
+	dev->l2ad_hand += asize;
+	bzero(lb, sizeof (l2arc_log_blk_phys_t));
+}
+
+/*
+ * Write the persistent device header, pointing at the most recently
+ * committed log block and recording the current write hand.
+ */
+static void
+l2arc_dev_hdr_update(l2arc_dev_t *dev)
+{
+	l2arc_dev_hdr_phys_t *dh = dev->l2ad_dev_hdr;
+	uint64_t asize = dev->l2ad_dev_hdr_asize;
+	void *buf;
+	int err;
+
+	dh->dh_magic = L2ARC_DEV_HDR_MAGIC;
+	dh->dh_version = L2ARC_PERSIST_VERSION;
+	dh->dh_spa_guid = spa_guid(dev->l2ad_spa);
+	dh->dh_vdev_guid = dev->l2ad_vdev->vdev_guid;
+	dh->dh_start = dev->l2ad_start;
+	dh->dh_end = dev->l2ad_end;
+	dh->dh_hand = dev->l2ad_hand;
+	dh->dh_flags = dev->l2ad_first ? L2ARC_DEV_HDR_FIRST : 0;
+	fletcher_4_native(dh, offsetof(l2arc_dev_hdr_phys_t, dh_self_cksum),
+	    NULL, &dh->dh_self_cksum);
+
+	buf = zio_buf_alloc(asize);
+	bzero(buf, asize);
+	bcopy(dh, buf, sizeof (l2arc_dev_hdr_phys_t));
+	err = zio_wait(zio_write_phys(NULL, dev->l2ad_vdev,
+	    VDEV_LABEL_START_SIZE, asize, buf, ZIO_CHECKSUM_OFF, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_WRITE, ZIO_FLAG_CANFAIL, B_FALSE));
+	zio_buf_free(buf, asize);
+
+	if (err != 0) {
+		zfs_dbgmsg("L2ARC: failed to update device header on "
+		    "vdev %llu: error %d",
+		    (u_longlong_t)dev->l2ad_vdev->vdev_guid, err);
+	}
+}
+
+/*
+ * Write out the log blocks committed during this feed, and then the device
+ * header pointing at the newest of them.  Called from the feed thread after
+ * the buffers written during this feed have completed.
+ */
+static void
+l2arc_log_blk_write_pending(l2arc_dev_t *dev, list_t *pending)
+{
+	l2arc_log_blk_pending_t *lbpd;
+	zio_t *pio;
+
+	if (!list_is_empty(pending)) {
+		pio = zio_root(dev->l2ad_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+		for (lbpd = list_head(pending); lbpd != NULL;
+		    lbpd = list_next(pending, lbpd)) {
+			(void) zio_nowait(zio_write_phys(pio, dev->l2ad_vdev,
+			    lbpd->lbpd_daddr, lbpd->lbpd_asize,
+			    lbpd->lbpd_data, ZIO_CHECKSUM_OFF, NULL, NULL,
+			    ZIO_PRIORITY_ASYNC_WRITE, ZIO_FLAG_CANFAIL,
+			    B_FALSE));
+			ARCSTAT_BUMP(arcstat_l2_log_blk_writes);
+			ARCSTAT_INCR(arcstat_l2_log_blk_asize,
+			    lbpd->lbpd_asize);
+		}
+		(void) zio_wait(pio);
+
+		while ((lbpd = list_remove_head(pending)) != NULL) {
+			zio_buf_free(lbpd->lbpd_data, lbpd->lbpd_asize);
+			kmem_free(lbpd, sizeof (l2arc_log_blk_pending_t));
+		}
+	}
+
+	l2arc_dev_hdr_update(dev);
+}
+
 /*
  * Find and write ARC buffers to the L2ARC device.
  *
@@ -6398,12 +7620,15 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	l2arc_write_callback_t *cb;
 	zio_t *pio, *wzio;
 	uint64_t guid = spa_load_guid(spa);
+	list_t pending;
 
 	ASSERT3P(dev->l2ad_vdev, !=, NULL);
 
 	pio = NULL;
 	write_sz = write_asize = write_psize = 0;
 	full = B_FALSE;
+	list_create(&pending, sizeof (l2arc_log_blk_pending_t),
+	    offsetof(l2arc_log_blk_pending_t, lbpd_node));
 	head = kmem_cache_alloc(hdr_l2only_cache, KM_PUSHPAGE);
 	arc_hdr_set_flags(head, ARC_FLAG_L2_WRITE_HEAD | ARC_FLAG_HAS_L2HDR);
 
@@ -6550,9 +7775,15 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 			write_psize += asize;
 			dev->l2ad_hand += asize;
 
+			l2arc_log_blk_insert(dev, hdr);
+
 			mutex_exit(hash_lock);
 
 			(void) zio_nowait(wzio);
+
+			if (dev->l2ad_log_blk->lb_nentries ==
+			    L2ARC_LOG_BLK_ENTRIES)
+				l2arc_log_blk_commit(dev, &pending);
 		}
 
 		multilist_sublist_unlock(mls);
@@ -6565,6 +7796,8 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	if (pio == NULL) {
 		ASSERT0(write_sz);
 		ASSERT(!HDR_HAS_L1HDR(head));
+		ASSERT(list_is_empty(&pending));
+		list_destroy(&pending);
 		kmem_cache_free(hdr_l2only_cache, head);
 		return (0);
 	}
@@ -6578,9 +7811,13 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 
 	/*
 	 * Bump device hand to the device start if it is approaching the end.
-	 * l2arc_evict() will already have evicted ahead for this case.
+	 * l2arc_evict() will already have evicted ahead for this case.  The
+	 * log block being filled must not describe buffers on both sides of
+	 * the wrap, so commit it first.
 	 */
-	if (dev->l2ad_hand >= (dev->l2ad_end - target_sz)) {
+	if (dev->l2ad_hand >= (dev->l2ad_end - target_sz -
+	    l2arc_log_blk_overhead(dev, target_sz))) {
+		l2arc_log_blk_commit(dev, &pending);
 		dev->l2ad_hand = dev->l2ad_start;
 		dev->l2ad_first = B_FALSE;
 	}
@@ -6589,6 +7826,9 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	(void) zio_wait(pio);
 	dev->l2ad_writing = B_FALSE;
 
+	l2arc_log_blk_write_pending(dev, &pending);
+	list_destroy(&pending);
+
 	return (write_asize);
 }
 
@@ -6667,9 +7907,11 @@ l2arc_feed_thread(void)
 		size = l2arc_write_size();
 
 		/*
-		 * Evict L2ARC buffers that will be overwritten.
+		 * Evict L2ARC buffers that will be overwritten, including
+		 * the space needed for any log blocks written in between.
 		 */
-		l2arc_evict(dev, size, B_FALSE);
+		l2arc_evict(dev, size + l2arc_log_blk_overhead(dev, size),
+		    B_FALSE);
 
 		/*
 		 * Write ARC buffers.
@@ -6689,6 +7931,310 @@ l2arc_feed_thread(void)
 	thread_exit();
 }
 
+/*
+ * Persistent L2ARC rebuild.  See the "L2ARC persistence" comment above.
+ */
+
+static boolean_t
+l2arc_rebuild_cancelled(l2arc_dev_t *dev)
+{
+	boolean_t cancel;
+
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	cancel = dev->l2ad_rebuild_cancel;
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
+	return (cancel);
+}
+
+/*
+ * Grab the config lock which keeps the device from being removed while we
+ * issue I/O to it.  l2arc_remove_vdev() may be waiting for the rebuild to
+ * stop while holding the config lock as writer, so never block on it.
+ */
+static boolean_t
+l2arc_rebuild_enter(l2arc_dev_t *dev)
+{
+	while (!spa_config_tryenter(dev->l2ad_spa, SCL_L2ARC, dev,
+	    RW_READER)) {
+		if (l2arc_rebuild_cancelled(dev))
+			return (B_FALSE);
+		delay(1);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Read and validate the persistent device header into l2ad_dev_hdr.
+ */
+static int
+l2arc_dev_hdr_read(l2arc_dev_t *dev)
+{
+	l2arc_dev_hdr_phys_t *dh = dev->l2ad_dev_hdr;
+	uint64_t asize = dev->l2ad_dev_hdr_asize;
+	zio_cksum_t cksum;
+	void *buf;
+	int err;
+
+	buf = zio_buf_alloc(asize);
+	err = zio_wait(zio_read_phys(NULL, dev->l2ad_vdev,
+	    VDEV_LABEL_START_SIZE, asize, buf, ZIO_CHECKSUM_OFF, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_DONT_CACHE | ZIO_FLAG_CANFAIL |
+	    ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_DONT_RETRY, B_FALSE));
+	if (err == 0)
+		bcopy(buf, dh, sizeof (l2arc_dev_hdr_phys_t));
+	zio_buf_free(buf, asize);
+
+	if (err != 0) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_io_errors);
+		return (err);
+	}
+
+	/* A new device, or one which has never been fed. */
+	if (dh->dh_magic != L2ARC_DEV_HDR_MAGIC)
+		return (SET_ERROR(ENOENT));
+
+	fletcher_4_native(dh, offsetof(l2arc_dev_hdr_phys_t, dh_self_cksum),
+	    NULL, &cksum);
+	if (!ZIO_CHECKSUM_EQUAL(cksum, dh->dh_self_cksum) ||
+	    dh->dh_version != L2ARC_PERSIST_VERSION ||
+	    dh->dh_spa_guid != spa_guid(dev->l2ad_spa) ||
+	    dh->dh_vdev_guid != dev->l2ad_vdev->vdev_guid ||
+	    dh->dh_start != dev->l2ad_start ||
+	    dh->dh_end != dev->l2ad_end ||
+	    dh->dh_hand < dev->l2ad_start ||
+	    dh->dh_hand > dev->l2ad_end) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_unsupported);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	return (0);
+}
+
+/*
+ * Decide whether the log block pointed to by 'lbp' may still be intact.
+ * 'hand' is the persisted write hand: the space from the start of the device
+ * up to it has been written during the current sweep, while the space after
+ * it still holds whatever the previous sweep left there.  Walking backwards,
+ * the chain of log blocks runs down towards the start of the device, may
+ * then jump once to the region above the hand, and ends when it would cross
+ * the hand again.  '*limit' is the lowest address of the log block we came
+ * from (anything older must lie below it) and '*wrapped' records the jump.
+ */
+static boolean_t
+l2arc_log_blkptr_valid(l2arc_dev_t *dev, const l2arc_log_blkptr_t *lbp,
+    uint64_t hand, boolean_t first, uint64_t *limit, boolean_t *wrapped)
+{
+	uint64_t start = lbp->lbp_payload_start;
+	uint64_t end = lbp->lbp_daddr + lbp->lbp_asize;
+
+	if (lbp->lbp_asize != dev->l2ad_log_blk_asize ||
+	    start < dev->l2ad_start || start > lbp->lbp_daddr ||
+	    end > dev->l2ad_end)
+		return (B_FALSE);
+
+	if (end <= *limit) {
+		if (*wrapped && start < hand)
+			return (B_FALSE);
+	} else if (!*wrapped && !first && start >= hand) {
+		*wrapped = B_TRUE;
+	} else {
+		return (B_FALSE);
+	}
+
+	*limit = start;
+	return (B_TRUE);
+}
+
+static int
+l2arc_log_blk_read(l2arc_dev_t *dev, const l2arc_log_blkptr_t *lbp,
+    l2arc_log_blk_phys_t *lb)
+{
+	zio_cksum_t cksum;
+	int err;
+
+	err = zio_wait(zio_read_phys(NULL, dev->l2ad_vdev, lbp->lbp_daddr,
+	    lbp->lbp_asize, lb, ZIO_CHECKSUM_OFF, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_DONT_CACHE | ZIO_FLAG_CANFAIL |
+	    ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_DONT_RETRY, B_FALSE));
+	if (err != 0) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_io_errors);
+		return (err);
+	}
+
+	fletcher_4_native(lb, lbp->lbp_asize, NULL, &cksum);
+	if (!ZIO_CHECKSUM_EQUAL(cksum, lbp->lbp_cksum) ||
+	    lb->lb_magic != L2ARC_LOG_BLK_MAGIC ||
+	    lb->lb_nentries > L2ARC_LOG_BLK_ENTRIES) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_cksum_lb_errors);
+		return (SET_ERROR(ECKSUM));
+	}
+
+	return (0);
+}
+
+/*
+ * Recreate an l2c_only header for a buffer described by a log entry, unless
+ * the ARC already knows about the buffer.
+ */
+static void
+l2arc_hdr_restore(l2arc_dev_t *dev, const l2arc_log_ent_phys_t *le)
+{
+	arc_buf_contents_t type = L2BLK_GET_TYPE(le->le_prop);
+	arc_buf_hdr_t *hdr, *exists;
+	kmutex_t *hash_lock;
+	uint64_t asize;
+
+	hdr = kmem_cache_alloc(hdr_l2only_cache, KM_SLEEP);
+	ASSERT(HDR_EMPTY(hdr));
+
+	HDR_SET_LSIZE(hdr, L2BLK_GET_LSIZE(le->le_prop));
+	HDR_SET_PSIZE(hdr, L2BLK_GET_PSIZE(le->le_prop));
+	hdr->b_spa = spa_load_guid(dev->l2ad_spa);
+	hdr->b_type = type;
+	hdr->b_flags = 0;
+	arc_hdr_set_flags(hdr, arc_bufc_to_flags(type) | ARC_FLAG_HAS_L2HDR);
+	HDR_SET_COMPRESS(hdr, L2BLK_GET_COMPRESS(le->le_prop));
+	if (L2BLK_GET_COMPRESSED_ARC(le->le_prop))
+		arc_hdr_set_flags(hdr, ARC_FLAG_COMPRESSED_ARC);
+	hdr->b_dva = le->le_dva;
+	hdr->b_birth = le->le_birth;
+	hdr->b_l2hdr.b_dev = dev;
+	hdr->b_l2hdr.b_daddr = le->le_daddr;
+
+	exists = buf_hash_insert(hdr, &hash_lock);
+	if (exists != NULL) {
+		/* The buffer was read back in before we got to it. */
+		mutex_exit(hash_lock);
+		buf_discard_identity(hdr);
+		kmem_cache_free(hdr_l2only_cache, hdr);
+		ARCSTAT_BUMP(arcstat_l2_rebuild_bufs_precached);
+		return;
+	}
+
+	asize = arc_hdr_size(hdr);
+
+	/*
+	 * l2arc_evict() expects the oldest buffers at the tail of the list,
+	 * and we are restoring from the newest buffer to the oldest.
+	 */
+	mutex_enter(&dev->l2ad_mtx);
+	list_insert_tail(&dev->l2ad_buflist, hdr);
+	(void) refcount_add_many(&dev->l2ad_alloc, asize, hdr);
+	mutex_exit(&dev->l2ad_mtx);
+
+	mutex_exit(hash_lock);
+
+	ARCSTAT_INCR(arcstat_l2_size, HDR_GET_LSIZE(hdr));
+	ARCSTAT_INCR(arcstat_l2_asize, asize);
+	ARCSTAT_BUMP(arcstat_l2_rebuild_bufs);
+	vdev_space_update(dev->l2ad_vdev, asize, 0, 0);
+}
+
+static void
+l2arc_log_blk_restore(l2arc_dev_t *dev, const l2arc_log_blkptr_t *lbp,
+    const l2arc_log_blk_phys_t *lb)
+{
+	/* Entries are in write order, restore them newest first. */
+	for (int i = lb->lb_nentries - 1; i >= 0; i--) {
+		const l2arc_log_ent_phys_t *le = &lb->lb_entries[i];
+
+		if (le->le_daddr < lbp->lbp_payload_start ||
+		    le->le_daddr >= lbp->lbp_daddr ||
+		    DVA_IS_EMPTY(&le->le_dva) || le->le_birth == 0 ||
+		    L2BLK_GET_COMPRESS(le->le_prop) >= ZIO_COMPRESS_FUNCTIONS ||
+		    (L2BLK_GET_TYPE(le->le_prop) != ARC_BUFC_DATA &&
+		    L2BLK_GET_TYPE(le->le_prop) != ARC_BUFC_METADATA))
+			continue;
+
+		l2arc_hdr_restore(dev, le);
+	}
+
+	ARCSTAT_BUMP(arcstat_l2_rebuild_log_blks);
+}
+
+/*
+ * Rebuild the L2ARC headers of a cache device from its log blocks.  If the
+ * device header is valid, the write hand is restored so that feeding picks
+ * up where it left off, even if the walk itself ends early.
+ */
+static int
+l2arc_rebuild(l2arc_dev_t *dev)
+{
+	l2arc_dev_hdr_phys_t *dh = dev->l2ad_dev_hdr;
+	l2arc_log_blk_phys_t *lb;
+	l2arc_log_blkptr_t lbp;
+	uint64_t hand, limit;
+	boolean_t first, wrapped = B_FALSE;
+	int err;
+
+	if (!l2arc_rebuild_enter(dev))
+		return (SET_ERROR(EINTR));
+	err = l2arc_dev_hdr_read(dev);
+	spa_config_exit(dev->l2ad_spa, SCL_L2ARC, dev);
+
+	if (err != 0) {
+		bzero(dh, sizeof (l2arc_dev_hdr_phys_t));
+		return (err);
+	}
+
+	hand = limit = dh->dh_hand;
+	first = (dh->dh_flags & L2ARC_DEV_HDR_FIRST) != 0;
+	lbp = dh->dh_start_lbp;
+	lb = zio_buf_alloc(dev->l2ad_log_blk_asize);
+
+	while (lbp.lbp_daddr != 0 &&
+	    l2arc_log_blkptr_valid(dev, &lbp, hand, first, &limit, &wrapped)) {
+		/*
+		 * Restored headers take up ARC memory, don't make things
+		 * worse if we're already short on it.
+		 */
+		if (arc_reclaim_needed()) {
+			ARCSTAT_BUMP(arcstat_l2_rebuild_lowmem);
+			err = SET_ERROR(ENOMEM);
+			break;
+		}
+
+		if (!l2arc_rebuild_enter(dev)) {
+			err = SET_ERROR(EINTR);
+			break;
+		}
+		err = l2arc_log_blk_read(dev, &lbp, lb);
+		if (err == 0)
+			l2arc_log_blk_restore(dev, &lbp, lb);
+		spa_config_exit(dev->l2ad_spa, SCL_L2ARC, dev);
+
+		if (err != 0)
+			break;
+
+		lbp = lb->lb_prev_lbp;
+	}
+
+	zio_buf_free(lb, dev->l2ad_log_blk_asize);
+
+	dev->l2ad_hand = hand;
+	dev->l2ad_first = first;
+
+	return (err);
+}
+
+static void
+l2arc_dev_rebuild_thread(l2arc_dev_t *dev)
+{
+	int err;
+
+	err = l2arc_rebuild(dev);
+	if (err == 0)
+		ARCSTAT_BUMP(arcstat_l2_rebuild_success);
+
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	dev->l2ad_rebuild = B_FALSE;
+	cv_broadcast(&l2arc_rebuild_thr_cv);
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
+	thread_exit();
+}
+
 boolean_t
 l2arc_vdev_present(vdev_t *vd)
 {
@@ -6722,7 +8268,19 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev = kmem_zalloc(sizeof (l2arc_dev_t), KM_SLEEP);
 	adddev->l2ad_spa = spa;
 	adddev->l2ad_vdev = vd;
-	adddev->l2ad_start = VDEV_LABEL_START_SIZE;
+	/*
+	 * The first block after the front labels holds the persistent
+	 * device header.
+	 */
+	adddev->l2ad_dev_hdr_asize = vdev_psize_to_asize(vd,
+	    sizeof (l2arc_dev_hdr_phys_t));
+	adddev->l2ad_log_blk_asize = vdev_psize_to_asize(vd,
+	    sizeof (l2arc_log_blk_phys_t));
+	adddev->l2ad_dev_hdr = kmem_zalloc(sizeof (l2arc_dev_hdr_phys_t),
+	    KM_SLEEP);
+	adddev->l2ad_log_blk = kmem_zalloc(sizeof (l2arc_log_blk_phys_t),
+	    KM_SLEEP);
+	adddev->l2ad_start = VDEV_LABEL_START_SIZE + adddev->l2ad_dev_hdr_asize;
 	adddev->l2ad_end = VDEV_LABEL_START_SIZE + vdev_get_min_asize(vd);
 	adddev->l2ad_hand = adddev->l2ad_start;
 	adddev->l2ad_first = B_TRUE;
@@ -6740,12 +8298,24 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	refcount_create(&adddev->l2ad_alloc);
 
 	/*
-	 * Add device to global list
+	 * Add device to global list.  A device that is to be rebuilt is
+	 * marked so before the feed thread can see it, so that nothing is
+	 * written over its log blocks before they have been read.
 	 */
 	mutex_enter(&l2arc_dev_mtx);
+	adddev->l2ad_rebuild = l2arc_rebuild_enabled;
 	list_insert_head(l2arc_dev_list, adddev);
 	atomic_inc_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
+
+	/*
+	 * Recover the device's contents from its log blocks in the
+	 * background; the feed thread leaves the device alone until then.
+	 */
+	if (adddev->l2ad_rebuild) {
+		(void) thread_create(NULL, 0, l2arc_dev_rebuild_thread, adddev,
+		    0, &p0, TS_RUN, minclsyspri);
+	}
 }
 
 /*
@@ -6777,6 +8347,15 @@ l2arc_remove_vdev(vdev_t *vd)
 	atomic_dec_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
 
+	/*
+	 * Stop a rebuild that may still be running on this device.
+	 */
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	remdev->l2ad_rebuild_cancel = B_TRUE;
+	while (remdev->l2ad_rebuild)
+		cv_wait(&l2arc_rebuild_thr_cv, &l2arc_rebuild_thr_lock);
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
 	/*
 	 * Clear all buflists and ARC references.  L2ARC device flush.
 	 */
@@ -6784,6 +8363,8 @@ l2arc_remove_vdev(vdev_t *vd)
 	list_destroy(&remdev->l2ad_buflist);
 	mutex_destroy(&remdev->l2ad_mtx);
 	refcount_destroy(&remdev->l2ad_alloc);
+	kmem_free(remdev->l2ad_dev_hdr, sizeof (l2arc_dev_hdr_phys_t));
+	kmem_free(remdev->l2ad_log_blk, sizeof (l2arc_log_blk_phys_t));
 	kmem_free(remdev, sizeof (l2arc_dev_t));
 }
 
@@ -6797,6 +8378,8 @@ l2arc_init(void)
 
 	mutex_init(&l2arc_feed_thr_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&l2arc_feed_thr_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&l2arc_rebuild_thr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&l2arc_rebuild_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_dev_mtx, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&l2arc_free_on_write_mtx, NULL, MUTEX_DEFAULT, NULL);
 
@@ -6821,6 +8404,8 @@ l2arc_fini(void)
 
 	mutex_destroy(&l2arc_feed_thr_lock);
 	cv_destroy(&l2arc_feed_thr_cv);
+	mutex_destroy(&l2arc_rebuild_thr_lock);
+	cv_destroy(&l2arc_rebuild_thr_cv);
 	mutex_destroy(&l2arc_dev_mtx);
 	mutex_destroy(&l2arc_free_on_write_mtx);
 
@@ -0,0 +1,831 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#include	<sys/btree.h>
+#include	<sys/zfs_context.h>
+
+kmem_cache_t *zfs_btree_leaf_cache;
+
+/*
+ * If non-zero, the whole tree is checked after every insertion and
+ * removal.  This is very expensive, and is only meant for debugging.
+ */
+int zfs_btree_verify_intensity = 0;
+
+/*
+ * ==========================================================================
+ * Node helpers
+ * ==========================================================================
+ */
+
+static inline uint8_t *
+bt_elems(zfs_btree_hdr_t *hdr)
+{
+	if (hdr->bth_core)
+		return (((zfs_btree_core_t *)hdr)->btc_elems);
+	return (((zfs_btree_leaf_t *)hdr)->btl_elems);
+}
+
+static inline void *
+bt_elem(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, uint32_t idx)
+{
+	return (bt_elems(hdr) + idx * tree->bt_elem_size);
+}
+
+static inline zfs_btree_hdr_t *
+bt_child(zfs_btree_hdr_t *hdr, uint32_t idx)
+{
+	ASSERT(hdr->bth_core);
+	ASSERT3U(idx, <=, hdr->bth_count);
+	return (((zfs_btree_core_t *)hdr)->btc_children[idx]);
+}
+
+static inline uint32_t
+bt_capacity(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	return (hdr->bth_core ? BTREE_CORE_ELEMS : tree->bt_leaf_cap);
+}
+
+/*
+ * Every node other than the root holds at least this many elements.
+ */
+static inline uint32_t
+bt_min(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	return (bt_capacity(tree, hdr) / 2);
+}
+
+static inline size_t
+bt_core_size(zfs_btree_t *tree)
+{
+	return (sizeof (zfs_btree_core_t) +
+	    BTREE_CORE_ELEMS * tree->bt_elem_size);
+}
+
+static zfs_btree_hdr_t *
+bt_alloc_node(zfs_btree_t *tree, boolean_t core)
+{
+	zfs_btree_hdr_t *hdr;
+
+	if (core)
+		hdr = kmem_alloc(bt_core_size(tree), KM_SLEEP);
+	else
+		hdr = kmem_cache_alloc(zfs_btree_leaf_cache, KM_SLEEP);
+	hdr->bth_parent = NULL;
+	hdr->bth_core = core;
+	hdr->bth_count = 0;
+	tree->bt_num_nodes++;
+	return (hdr);
+}
+
+static void
+bt_free_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	ASSERT3U(tree->bt_num_nodes, >, 0);
+	tree->bt_num_nodes--;
+	if (hdr->bth_core)
+		kmem_free(hdr, bt_core_size(tree));
+	else
+		kmem_cache_free(zfs_btree_leaf_cache, hdr);
+}
+
+/*
+ * Binary search for value in the node.  Returns B_TRUE if it's found, and
+ * sets *idxp to its position, or to the position it would be inserted at.
+ */
+static boolean_t
+bt_search_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, const void *value,
+    uint32_t *idxp)
+{
+	uint32_t min = 0;
+	uint32_t max = hdr->bth_count;
+
+	while (min < max) {
+		uint32_t idx = (min + max) / 2;
+		int comp = tree->bt_compar(bt_elem(tree, hdr, idx), value);
+
+		if (comp < 0) {
+			min = idx + 1;
+		} else if (comp > 0) {
+			max = idx;
+		} else {
+			*idxp = idx;
+			return (B_TRUE);
+		}
+	}
+	*idxp = min;
+	return (B_FALSE);
+}
+
+/*
+ * Return the index of the given (non-empty, non-root) node in its parent.
+ */
+static uint32_t
+bt_child_index(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	zfs_btree_hdr_t *parent = &hdr->bth_parent->btc_hdr;
+	uint32_t idx;
+
+	ASSERT3U(hdr->bth_count, >, 0);
+	VERIFY(!bt_search_node(tree, parent, bt_elem(tree, hdr, 0), &idx));
+	ASSERT3P(bt_child(parent, idx), ==, hdr);
+	return (idx);
+}
+
+static inline void
+bt_set_index(zfs_btree_index_t *where, zfs_btree_hdr_t *hdr, uint32_t idx,
+    boolean_t before)
+{
+	if (where != NULL) {
+		where->bti_node = hdr;
+		where->bti_offset = idx;
+		where->bti_before = before;
+	}
+}
+
+/*
+ * ==========================================================================
+ * Lookup and iteration
+ * ==========================================================================
+ */
+
+void *
+zfs_btree_find(zfs_btree_t *tree, const void *value, zfs_btree_index_t *where)
+{
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+	uint32_t idx = 0;
+
+	if (hdr == NULL) {
+		bt_set_index(where, NULL, 0, B_TRUE);
+		return (NULL);
+	}
+
+	for (;;) {
+		if (bt_search_node(tree, hdr, value, &idx)) {
+			bt_set_index(where, hdr, idx, B_FALSE);
+			return (bt_elem(tree, hdr, idx));
+		}
+		if (!hdr->bth_core)
+			break;
+		hdr = bt_child(hdr, idx);
+	}
+	bt_set_index(where, hdr, idx, B_TRUE);
+	return (NULL);
+}
+
+void *
+zfs_btree_first(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+
+	if (hdr == NULL)
+		return (NULL);
+	while (hdr->bth_core)
+		hdr = bt_child(hdr, 0);
+	bt_set_index(where, hdr, 0, B_FALSE);
+	return (bt_elem(tree, hdr, 0));
+}
+
+void *
+zfs_btree_last(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+
+	if (hdr == NULL)
+		return (NULL);
+	while (hdr->bth_core)
+		hdr = bt_child(hdr, hdr->bth_count);
+	bt_set_index(where, hdr, hdr->bth_count - 1, B_FALSE);
+	return (bt_elem(tree, hdr, hdr->bth_count - 1));
+}
+
+/*
+ * We've run off the end of the given node; the next element is the
+ * separator to the right of the nearest ancestor we're not the last child
+ * of.
+ */
+static void *
+bt_next_up(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, zfs_btree_index_t *out)
+{
+	while (hdr->bth_parent != NULL) {
+		zfs_btree_hdr_t *parent = &hdr->bth_parent->btc_hdr;
+		uint32_t idx = bt_child_index(tree, hdr);
+
+		if (idx < parent->bth_count) {
+			bt_set_index(out, parent, idx, B_FALSE);
+			return (bt_elem(tree, parent, idx));
+		}
+		hdr = parent;
+	}
+	return (NULL);
+}
+
+static void *
+bt_prev_up(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, zfs_btree_index_t *out)
+{
+	while (hdr->bth_parent != NULL) {
+		zfs_btree_hdr_t *parent = &hdr->bth_parent->btc_hdr;
+		uint32_t idx = bt_child_index(tree, hdr);
+
+		if (idx > 0) {
+			bt_set_index(out, parent, idx - 1, B_FALSE);
+			return (bt_elem(tree, parent, idx - 1));
+		}
+		hdr = parent;
+	}
+	return (NULL);
+}
+
+void *
+zfs_btree_next(zfs_btree_t *tree, const zfs_btree_index_t *idx,
+    zfs_btree_index_t *out)
+{
+	zfs_btree_hdr_t *hdr = idx->bti_node;
+	uint32_t off = idx->bti_offset;
+
+	if (hdr == NULL)
+		return (NULL);
+
+	if (idx->bti_before) {
+		ASSERT(!hdr->bth_core);
+		if (off < hdr->bth_count) {
+			bt_set_index(out, hdr, off, B_FALSE);
+			return (bt_elem(tree, hdr, off));
+		}
+		return (bt_next_up(tree, hdr, out));
+	}
+
+	if (!hdr->bth_core) {
+		if (off + 1 < hdr->bth_count) {
+			bt_set_index(out, hdr, off + 1, B_FALSE);
+			return (bt_elem(tree, hdr, off + 1));
+		}
+		return (bt_next_up(tree, hdr, out));
+	}
+
+	/* The next element is the first one in the subtree to our right. */
+	hdr = bt_child(hdr, off + 1);
+	while (hdr->bth_core)
+		hdr = bt_child(hdr, 0);
+	bt_set_index(out, hdr, 0, B_FALSE);
+	return (bt_elem(tree, hdr, 0));
+}
+
+void *
+zfs_btree_prev(zfs_btree_t *tree, const zfs_btree_index_t *idx,
+    zfs_btree_index_t *out)
+{
+	zfs_btree_hdr_t *hdr = idx->bti_node;
+	uint32_t off = idx->bti_offset;
+
+	if (hdr == NULL)
+		return (NULL);
+
+	if (!hdr->bth_core) {
+		if (off > 0) {
+			bt_set_index(out, hdr, off - 1, B_FALSE);
+			return (bt_elem(tree, hdr, off - 1));
+		}
+		return (bt_prev_up(tree, hdr, out));
+	}
+
+	/* The previous element is the last one in the subtree to our left. */
+	ASSERT(!idx->bti_before);
+	hdr = bt_child(hdr, off);
+	while (hdr->bth_core)
+		hdr = bt_child(hdr, hdr->bth_count);
+	bt_set_index(out, hdr, hdr->bth_count - 1, B_FALSE);
+	return (bt_elem(tree, hdr, hdr->bth_count - 1));
+}
+
+void *
+zfs_btree_get(zfs_btree_t *tree, zfs_btree_index_t *idx)
+{
+	ASSERT(!idx->bti_before);
+	ASSERT3U(idx->bti_offset, <, idx->bti_node->bth_count);
+	return (bt_elem(tree, idx->bti_node, idx->bti_offset));
+}
+
+/*
+ * ==========================================================================
+ * Insertion
+ * ==========================================================================
+ */
+
+static void bt_insert_into_node(zfs_btree_t *, zfs_btree_hdr_t *, uint32_t,
+    const void *, zfs_btree_hdr_t *);
+
+/*
+ * Split a full node while inserting value at idx (and, for a core node,
+ * rchild to its right).  Conceptually the count + 1 elements are laid out
+ * in order; the first half stay in this node, the median moves up into
+ * the parent and the rest go to a new node to the right of this one.
+ */
+static void
+bt_split_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, uint32_t idx,
+    const void *value, zfs_btree_hdr_t *rchild)
+{
+	size_t size = tree->bt_elem_size;
+	uint32_t count = hdr->bth_count;
+	uint32_t mid = (count + 1) / 2;
+	uint32_t pidx = 0;
+	zfs_btree_hdr_t *right = bt_alloc_node(tree, hdr->bth_core);
+	uint8_t *elems = bt_elems(hdr);
+	uint8_t *relems = bt_elems(right);
+	const void *sep;
+
+	if (hdr->bth_parent != NULL)
+		pidx = bt_child_index(tree, hdr);
+
+	/*
+	 * Fill in the new node.  The separator is left where it is until it
+	 * has been copied into the parent.
+	 */
+	if (idx < mid) {
+		bcopy(elems + mid * size, relems, (count - mid) * size);
+		sep = elems + (mid - 1) * size;
+	} else if (idx == mid) {
+		bcopy(elems + mid * size, relems, (count - mid) * size);
+		sep = value;
+	} else {
+		uint32_t before = idx - (mid + 1);
+
+		bcopy(elems + (mid + 1) * size, relems, before * size);
+		bcopy(value, relems + before * size, size);
+		bcopy(elems + idx * size, relems + (before + 1) * size,
+		    (count - idx) * size);
+		sep = elems + mid * size;
+	}
+	right->bth_count = count - mid;
+
+	if (hdr->bth_core) {
+		zfs_btree_hdr_t **children =
+		    ((zfs_btree_core_t *)hdr)->btc_children;
+		zfs_btree_hdr_t **rchildren =
+		    ((zfs_btree_core_t *)right)->btc_children;
+		size_t psize = sizeof (zfs_btree_hdr_t *);
+
+		if (idx < mid) {
+			bcopy(&children[mid], rchildren,
+			    (count - mid + 1) * psize);
+		} else if (idx == mid) {
+			rchildren[0] = rchild;
+			bcopy(&children[mid + 1], &rchildren[1],
+			    (count - mid) * psize);
+		} else {
+			uint32_t before = idx - mid;
+
+			bcopy(&children[mid + 1], rchildren, before * psize);
+			rchildren[before] = rchild;
+			bcopy(&children[idx + 1], &rchildren[before + 1],
+			    (count - idx) * psize);
+		}
+		for (uint32_t i = 0; i <= right->bth_count; i++)
+			rchildren[i]->bth_parent = (zfs_btree_core_t *)right;
+	}
+
+	if (hdr->bth_parent == NULL) {
+		zfs_btree_hdr_t *root = bt_alloc_node(tree, B_TRUE);
+		zfs_btree_core_t *rcore = (zfs_btree_core_t *)root;
+
+		bcopy(sep, bt_elems(root), size);
+		root->bth_count = 1;
+		rcore->btc_children[0] = hdr;
+		rcore->btc_children[1] = right;
+		hdr->bth_parent = rcore;
+		right->bth_parent = rcore;
+		tree->bt_root = root;
+		tree->bt_height++;
+	} else {
+		bt_insert_into_node(tree, &hdr->bth_parent->btc_hdr, pidx,
+		    sep, right);
+	}
+
+	/* Now the separator has been copied out, finish this node. */
+	if (idx < mid) {
+		memmove(elems + (idx + 1) * size, elems + idx * size,
+		    (mid - 1 - idx) * size);
+		bcopy(value, elems + idx * size, size);
+		if (hdr->bth_core) {
+			zfs_btree_core_t *core = (zfs_btree_core_t *)hdr;
+
+			memmove(&core->btc_children[idx + 2],
+			    &core->btc_children[idx + 1],
+			    (mid - 1 - idx) * sizeof (zfs_btree_hdr_t *));
+			core->btc_children[idx + 1] = rchild;
+			rchild->bth_parent = core;
+		}
+	}
+	hdr->bth_count = mid;
+}
+
+/*
+ * Insert value at idx in the node, and for a core node, make rchild the
+ * child to its right.
+ */
+static void
+bt_insert_into_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, uint32_t idx,
+    const void *value, zfs_btree_hdr_t *rchild)
+{
+	size_t size = tree->bt_elem_size;
+	uint32_t count = hdr->bth_count;
+	uint8_t *elems = bt_elems(hdr);
+
+	ASSERT3U(idx, <=, count);
+	ASSERT3S(hdr->bth_core, ==, (rchild != NULL));
+
+	if (count == bt_capacity(tree, hdr)) {
+		bt_split_node(tree, hdr, idx, value, rchild);
+		return;
+	}
+
+	memmove(elems + (idx + 1) * size, elems + idx * size,
+	    (count - idx) * size);
+	bcopy(value, elems + idx * size, size);
+	if (hdr->bth_core) {
+		zfs_btree_core_t *core = (zfs_btree_core_t *)hdr;
+
+		memmove(&core->btc_children[idx + 2],
+		    &core->btc_children[idx + 1],
+		    (count - idx) * sizeof (zfs_btree_hdr_t *));
+		core->btc_children[idx + 1] = rchild;
+		rchild->bth_parent = core;
+	}
+	hdr->bth_count++;
+}
+
+void
+zfs_btree_add_idx(zfs_btree_t *tree, const void *value,
+    const zfs_btree_index_t *where)
+{
+	if (tree->bt_root == NULL) {
+		zfs_btree_hdr_t *leaf = bt_alloc_node(tree, B_FALSE);
+
+		ASSERT0(tree->bt_height);
+		bcopy(value, bt_elems(leaf), tree->bt_elem_size);
+		leaf->bth_count = 1;
+		tree->bt_root = leaf;
+	} else {
+		ASSERT(where->bti_before);
+		ASSERT(!where->bti_node->bth_core);
+		bt_insert_into_node(tree, where->bti_node, where->bti_offset,
+		    value, NULL);
+	}
+	tree->bt_num_elems++;
+
+	if (zfs_btree_verify_intensity > 0)
+		zfs_btree_verify(tree);
+}
+
+void
+zfs_btree_add(zfs_btree_t *tree, const void *value)
+{
+	zfs_btree_index_t where;
+
+	VERIFY3P(zfs_btree_find(tree, value, &where), ==, NULL);
+	zfs_btree_add_idx(tree, value, &where);
+}
+
+/*
+ * ==========================================================================
+ * Removal
+ * ==========================================================================
+ */
+
+/*
+ * Move the separator at sidx of parent down into its right child, and the
+ * last element of its left child up to replace it.
+ */
+static void
+bt_rotate_right(zfs_btree_t *tree, zfs_btree_hdr_t *parent, uint32_t sidx)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_hdr_t *left = bt_child(parent, sidx);
+	zfs_btree_hdr_t *right = bt_child(parent, sidx + 1);
+	uint8_t *relems = bt_elems(right);
+
+	memmove(relems + size, relems, right->bth_count * size);
+	bcopy(bt_elem(tree, parent, sidx), relems, size);
+	bcopy(bt_elem(tree, left, left->bth_count - 1),
+	    bt_elem(tree, parent, sidx), size);
+
+	if (right->bth_core) {
+		zfs_btree_core_t *lcore = (zfs_btree_core_t *)left;
+		zfs_btree_core_t *rcore = (zfs_btree_core_t *)right;
+
+		memmove(&rcore->btc_children[1], &rcore->btc_children[0],
+		    (right->bth_count + 1) * sizeof (zfs_btree_hdr_t *));
+		rcore->btc_children[0] = lcore->btc_children[left->bth_count];
+		rcore->btc_children[0]->bth_parent = rcore;
+	}
+	left->bth_count--;
+	right->bth_count++;
+}
+
+/*
+ * Move the separator at sidx of parent down into its left child, and the
+ * first element of its right child up to replace it.
+ */
+static void
+bt_rotate_left(zfs_btree_t *tree, zfs_btree_hdr_t *parent, uint32_t sidx)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_hdr_t *left = bt_child(parent, sidx);
+	zfs_btree_hdr_t *right = bt_child(parent, sidx + 1);
+	uint8_t *relems = bt_elems(right);
+
+	bcopy(bt_elem(tree, parent, sidx), bt_elem(tree, left, left->bth_count),
+	    size);
+	bcopy(relems, bt_elem(tree, parent, sidx), size);
+	memmove(relems, relems + size, (right->bth_count - 1) * size);
+
+	if (right->bth_core) {
+		zfs_btree_core_t *lcore = (zfs_btree_core_t *)left;
+		zfs_btree_core_t *rcore = (zfs_btree_core_t *)right;
+
+		lcore->btc_children[left->bth_count + 1] =
+		    rcore->btc_children[0];
+		lcore->btc_children[left->bth_count + 1]->bth_parent = lcore;
+		memmove(&rcore->btc_children[0], &rcore->btc_children[1],
+		    right->bth_count * sizeof (zfs_btree_hdr_t *));
+	}
+	left->bth_count++;
+	right->bth_count--;
+}
+
+/*
+ * Merge the right child of the separator at sidx, and the separator
+ * itself, into its left child.
+ */
+static void
+bt_merge(zfs_btree_t *tree, zfs_btree_hdr_t *parent, uint32_t sidx)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_core_t *pcore = (zfs_btree_core_t *)parent;
+	zfs_btree_hdr_t *left = bt_child(parent, sidx);
+	zfs_btree_hdr_t *right = bt_child(parent, sidx + 1);
+	uint32_t lcount = left->bth_count;
+
+	ASSERT3U(lcount + 1 + right->bth_count, <=, bt_capacity(tree, left));
+
+	bcopy(bt_elem(tree, parent, sidx), bt_elem(tree, left, lcount), size);
+	bcopy(bt_elems(right), bt_elem(tree, left, lcount + 1),
+	    right->bth_count * size);
+	if (left->bth_core) {
+		zfs_btree_core_t *lcore = (zfs_btree_core_t *)left;
+		zfs_btree_core_t *rcore = (zfs_btree_core_t *)right;
+
+		for (uint32_t i = 0; i <= right->bth_count; i++) {
+			lcore->btc_children[lcount + 1 + i] =
+			    rcore->btc_children[i];
+			rcore->btc_children[i]->bth_parent = lcore;
+		}
+	}
+	left->bth_count += 1 + right->bth_count;
+	bt_free_node(tree, right);
+
+	memmove(bt_elem(tree, parent, sidx), bt_elem(tree, parent, sidx + 1),
+	    (parent->bth_count - sidx - 1) * size);
+	memmove(&pcore->btc_children[sidx + 1], &pcore->btc_children[sidx + 2],
+	    (parent->bth_count - sidx - 1) * sizeof (zfs_btree_hdr_t *));
+	parent->bth_count--;
+}
+
+/*
+ * An element has been removed from the node; restore the minimum fill of
+ * it and its ancestors, by borrowing from a sibling or merging with one.
+ */
+static void
+bt_rebalance(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	for (;;) {
+		zfs_btree_hdr_t *parent;
+		uint32_t pidx, min;
+
+		if (hdr->bth_parent == NULL) {
+			/* The root may be as small as it likes, but not empty */
+			if (hdr->bth_count > 0)
+				return;
+			if (hdr->bth_core) {
+				tree->bt_root = bt_child(hdr, 0);
+				tree->bt_root->bth_parent = NULL;
+				tree->bt_height--;
+			} else {
+				tree->bt_root = NULL;
+			}
+			bt_free_node(tree, hdr);
+			return;
+		}
+
+		min = bt_min(tree, hdr);
+		if (hdr->bth_count >= min)
+			return;
+
+		parent = &hdr->bth_parent->btc_hdr;
+		pidx = bt_child_index(tree, hdr);
+		if (pidx > 0 && bt_child(parent, pidx - 1)->bth_count > min) {
+			bt_rotate_right(tree, parent, pidx - 1);
+			return;
+		}
+		if (pidx < parent->bth_count &&
+		    bt_child(parent, pidx + 1)->bth_count > min) {
+			bt_rotate_left(tree, parent, pidx);
+			return;
+		}
+		bt_merge(tree, parent, pidx > 0 ? pidx - 1 : pidx);
+		hdr = parent;
+	}
+}
+
+void
+zfs_btree_remove_idx(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_hdr_t *hdr = where->bti_node;
+	uint32_t idx = where->bti_offset;
+	uint8_t *elems;
+
+	ASSERT(!where->bti_before);
+	ASSERT3U(idx, <, hdr->bth_count);
+
+	/*
+	 * Elements are only ever removed from leaves; to remove one from a
+	 * core node, replace it with its predecessor and remove that from
+	 * its leaf instead.
+	 */
+	if (hdr->bth_core) {
+		zfs_btree_hdr_t *leaf = bt_child(hdr, idx);
+
+		while (leaf->bth_core)
+			leaf = bt_child(leaf, leaf->bth_count);
+		bcopy(bt_elem(tree, leaf, leaf->bth_count - 1),
+		    bt_elem(tree, hdr, idx), size);
+		hdr = leaf;
+		idx = leaf->bth_count - 1;
+	}
+
+	elems = bt_elems(hdr);
+	memmove(elems + idx * size, elems + (idx + 1) * size,
+	    (hdr->bth_count - idx - 1) * size);
+	hdr->bth_count--;
+	tree->bt_num_elems--;
+	bt_rebalance(tree, hdr);
+
+	if (zfs_btree_verify_intensity > 0)
+		zfs_btree_verify(tree);
+}
+
+void
+zfs_btree_remove(zfs_btree_t *tree, const void *value)
+{
+	zfs_btree_index_t where;
+
+	VERIFY3P(zfs_btree_find(tree, value, &where), !=, NULL);
+	zfs_btree_remove_idx(tree, &where);
+}
+
+/*
+ * ==========================================================================
+ * Creation and destruction
+ * ==========================================================================
+ */
+
+void
+zfs_btree_init(void)
+{
+	ASSERT(zfs_btree_leaf_cache == NULL);
+	zfs_btree_leaf_cache = kmem_cache_create("zfs_btree_leaf_cache",
+	    BTREE_LEAF_SIZE, 0, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+void
+zfs_btree_fini(void)
+{
+	kmem_cache_destroy(zfs_btree_leaf_cache);
+	zfs_btree_leaf_cache = NULL;
+}
+
+void
+zfs_btree_create(zfs_btree_t *tree, int (*compar) (const void *, const void *),
+    size_t size)
+{
+	bzero(tree, sizeof (*tree));
+	tree->bt_compar = compar;
+	tree->bt_elem_size = size;
+	tree->bt_leaf_cap = (BTREE_LEAF_SIZE - sizeof (zfs_btree_leaf_t)) / size;
+
+	/* Nodes must be able to hold a few elements to rebalance. */
+	VERIFY3U(tree->bt_leaf_cap, >=, 4);
+}
+
+ulong_t
+zfs_btree_numnodes(zfs_btree_t *tree)
+{
+	return (tree->bt_num_elems);
+}
+
+static void
+bt_clear_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	if (hdr->bth_core) {
+		for (uint32_t i = 0; i <= hdr->bth_count; i++)
+			bt_clear_node(tree, bt_child(hdr, i));
+	}
+	bt_free_node(tree, hdr);
+}
+
+void
+zfs_btree_clear(zfs_btree_t *tree)
+{
+	if (tree->bt_root != NULL)
+		bt_clear_node(tree, tree->bt_root);
+	ASSERT0(tree->bt_num_nodes);
+	tree->bt_root = NULL;
+	tree->bt_height = 0;
+	tree->bt_num_elems = 0;
+}
+
+void
+zfs_btree_destroy(zfs_btree_t *tree)
+{
+	VERIFY0(tree->bt_num_elems);
+	ASSERT3P(tree->bt_root, ==, NULL);
+	ASSERT0(tree->bt_num_nodes);
+}
+
+/*
+ * ==========================================================================
+ * Verification
+ * ==========================================================================
+ */
+
+/*
+ * Check the node and its subtree, and return the number of elements and
+ * nodes in it.
+ */
+static void
+bt_verify_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, int64_t depth,
+    uint64_t *elemsp, uint64_t *nodesp)
+{
+	uint32_t count = hdr->bth_count;
+
+	VERIFY3U(count, <=, bt_capacity(tree, hdr));
+	if (hdr != tree->bt_root)
+		VERIFY3U(count, >=, bt_min(tree, hdr));
+	else
+		VERIFY3U(count, >, 0);
+	for (uint32_t i = 1; i < count; i++) {
+		VERIFY3S(tree->bt_compar(bt_elem(tree, hdr, i - 1),
+		    bt_elem(tree, hdr, i)), <, 0);
+	}
+	*elemsp += count;
+	*nodesp += 1;
+
+	if (!hdr->bth_core) {
+		VERIFY3S(depth, ==, tree->bt_height);
+		return;
+	}
+
+	for (uint32_t i = 0; i <= count; i++) {
+		zfs_btree_hdr_t *child = bt_child(hdr, i);
+
+		VERIFY3P(child->bth_parent, ==, hdr);
+		if (i > 0) {
+			VERIFY3S(tree->bt_compar(bt_elem(tree, hdr, i - 1),
+			    bt_elem(tree, child, 0)), <, 0);
+		}
+		if (i < count) {
+			VERIFY3S(tree->bt_compar(bt_elem(tree, child,
+			    child->bth_count - 1), bt_elem(tree, hdr, i)), <, 0);
+		}
+		bt_verify_node(tree, child, depth + 1, elemsp, nodesp);
+	}
+}
+
+void
+zfs_btree_verify(zfs_btree_t *tree)
+{
+	uint64_t elems = 0, nodes = 0;
+
+	if (tree->bt_root == NULL) {
+		VERIFY0(tree->bt_num_elems);
+		VERIFY0(tree->bt_height);
+		return;
+	}
+	VERIFY3P(tree->bt_root->bth_parent, ==, NULL);
+	bt_verify_node(tree, tree->bt_root, 0, &elems, &nodes);
+	VERIFY3U(elems, ==, tree->bt_num_elems);
+	VERIFY3U(nodes, ==, tree->bt_num_nodes);
+}
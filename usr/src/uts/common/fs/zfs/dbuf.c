@@ -69,11 +69,6 @@ extern inline void dmu_buf_init_user(dmu_buf_user_t *dbu,
 static kmem_cache_t *dbuf_kmem_cache;
 static taskq_t *dbu_evict_taskq;
 
-static kthread_t *dbuf_cache_evict_thread;
-static kmutex_t dbuf_evict_lock;
-static kcondvar_t dbuf_evict_cv;
-static boolean_t dbuf_evict_thread_exit;
-
 /*
  * LRU cache of dbufs. The dbuf cache maintains a list of dbufs that
  * are not currently held but have been recently released. These dbufs
@@ -83,11 +78,59 @@ static boolean_t dbuf_evict_thread_exit;
  * be removed from the cache and later re-added to the head of the cache.
  * Dbufs that are aged out of the cache will be immediately destroyed and
  * become eligible for arc eviction.
+ *
+ * The cache is split into shards, each with its own lists, size and
+ * eviction thread, so that releasing and evicting dbufs on large systems
+ * doesn't serialize on one lock and one thread.  A dbuf's shard is chosen
+ * from its hash, so it can be recalculated on removal; each shard is
+ * allowed an equal part of dbuf_cache_max_bytes.
  */
-static multilist_t dbuf_cache;
-static refcount_t dbuf_cache_size;
+typedef struct dbuf_cache_stats {
+	kstat_named_t dcs_hits;
+	kstat_named_t dcs_misses;
+	kstat_named_t dcs_evicts;
+	kstat_named_t dcs_count;
+	kstat_named_t dcs_size;
+	kstat_named_t dcs_max_size;
+} dbuf_cache_stats_t;
+
+static const dbuf_cache_stats_t dbuf_cache_stats_template = {
+	{ "hits",			KSTAT_DATA_UINT64 },
+	{ "misses",			KSTAT_DATA_UINT64 },
+	{ "evicts",			KSTAT_DATA_UINT64 },
+	{ "count",			KSTAT_DATA_UINT64 },
+	{ "size",			KSTAT_DATA_UINT64 },
+	{ "max_size",			KSTAT_DATA_UINT64 },
+};
+
+typedef struct dbuf_cache {
+	multilist_t	dc_list;
+	refcount_t	dc_size;
+	kmutex_t	dc_evict_lock;
+	kcondvar_t	dc_evict_cv;
+	boolean_t	dc_evict_thread_exit;
+	kthread_t	*dc_evict_thread;
+	kstat_t		*dc_ksp;
+	dbuf_cache_stats_t dc_stats;
+} dbuf_cache_t;
+
+#define	DBUFCACHE_BUMP(dc, stat) \
+	atomic_inc_64(&(dc)->dc_stats.stat.value.ui64)
+#define	DBUFCACHE_DECR(dc, stat) \
+	atomic_dec_64(&(dc)->dc_stats.stat.value.ui64)
+
+static dbuf_cache_t *dbuf_caches;
+static int dbuf_cache_nshards;
 uint64_t dbuf_cache_max_bytes = 100 * 1024 * 1024;
 
+/*
+ * Number of dbuf cache shards; if zero, one is used for every
+ * dbuf_cache_cpus_per_shard CPUs, up to DBUF_CACHE_MAX_SHARDS.
+ */
+int dbuf_cache_shards = 0;
+int dbuf_cache_cpus_per_shard = 16;
+#define	DBUF_CACHE_MAX_SHARDS	16
+
 /* Cap the size of the dbuf cache to log2 fraction of arc size. */
 int dbuf_cache_max_shift = 5;
 
@@ -397,6 +440,19 @@ dbuf_is_metadata(dmu_buf_impl_t *db)
  * distributed between all sublists and uses this assumption when
  * deciding which sublist to evict from and how much to evict from it.
  */
+/*
+ * The multilist index below uses the low order bits of the hash, so the
+ * shard is chosen from the high order bits to keep the two independent.
+ */
+static dbuf_cache_t *
+dbuf_cache_shard(dmu_buf_impl_t *db)
+{
+	uint64_t hv = dbuf_hash(db->db_objset, db->db.db_object,
+	    db->db_level, db->db_blkid);
+
+	return (&dbuf_caches[(hv >> 32) % dbuf_cache_nshards]);
+}
+
 unsigned int
 dbuf_cache_multilist_index_func(multilist_t *ml, void *obj)
 {
@@ -419,36 +475,77 @@ dbuf_cache_multilist_index_func(multilist_t *ml, void *obj)
 	    multilist_get_num_sublists(ml));
 }
 
+/*
+ * The maximum size of each shard of the dbuf cache.
+ */
+static inline uint64_t
+dbuf_cache_shard_max_bytes(void)
+{
+	return (dbuf_cache_max_bytes / dbuf_cache_nshards);
+}
+
 static inline boolean_t
-dbuf_cache_above_hiwater(void)
+dbuf_cache_above_hiwater(dbuf_cache_t *dc)
 {
+	uint64_t max_bytes = dbuf_cache_shard_max_bytes();
 	uint64_t dbuf_cache_hiwater_bytes =
-	    (dbuf_cache_max_bytes * dbuf_cache_hiwater_pct) / 100;
+	    (max_bytes * dbuf_cache_hiwater_pct) / 100;
 
-	return (refcount_count(&dbuf_cache_size) >
-	    dbuf_cache_max_bytes + dbuf_cache_hiwater_bytes);
+	return (refcount_count(&dc->dc_size) >
+	    max_bytes + dbuf_cache_hiwater_bytes);
 }
 
 static inline boolean_t
-dbuf_cache_above_lowater(void)
+dbuf_cache_above_lowater(dbuf_cache_t *dc)
 {
+	uint64_t max_bytes = dbuf_cache_shard_max_bytes();
 	uint64_t dbuf_cache_lowater_bytes =
-	    (dbuf_cache_max_bytes * dbuf_cache_lowater_pct) / 100;
+	    (max_bytes * dbuf_cache_lowater_pct) / 100;
 
-	return (refcount_count(&dbuf_cache_size) >
-	    dbuf_cache_max_bytes - dbuf_cache_lowater_bytes);
+	return (refcount_count(&dc->dc_size) >
+	    max_bytes - dbuf_cache_lowater_bytes);
 }
 
 /*
- * Evict the oldest eligible dbuf from the dbuf cache.
+ * Add a dbuf that has just lost its last hold to its shard of the cache.
+ */
+static dbuf_cache_t *
+dbuf_cache_insert(dmu_buf_impl_t *db)
+{
+	dbuf_cache_t *dc = dbuf_cache_shard(db);
+
+	multilist_insert(&dc->dc_list, db);
+	(void) refcount_add_many(&dc->dc_size, db->db.db_size, db);
+	DBUFCACHE_BUMP(dc, dcs_count);
+	return (dc);
+}
+
+/*
+ * Take a dbuf out of the cache, either because it has been held again
+ * (a cache hit) or because it's being destroyed.
  */
 static void
-dbuf_evict_one(void)
+dbuf_cache_remove(dmu_buf_impl_t *db, boolean_t hit)
 {
-	int idx = multilist_get_random_index(&dbuf_cache);
-	multilist_sublist_t *mls = multilist_sublist_lock(&dbuf_cache, idx);
+	dbuf_cache_t *dc = dbuf_cache_shard(db);
+
+	multilist_remove(&dc->dc_list, db);
+	(void) refcount_remove_many(&dc->dc_size, db->db.db_size, db);
+	DBUFCACHE_DECR(dc, dcs_count);
+	if (hit)
+		DBUFCACHE_BUMP(dc, dcs_hits);
+}
 
-	ASSERT(!MUTEX_HELD(&dbuf_evict_lock));
+/*
+ * Evict the oldest eligible dbuf from the given shard of the dbuf cache.
+ */
+static void
+dbuf_evict_one(dbuf_cache_t *dc)
+{
+	int idx = multilist_get_random_index(&dc->dc_list);
+	multilist_sublist_t *mls = multilist_sublist_lock(&dc->dc_list, idx);
+
+	ASSERT(!MUTEX_HELD(&dc->dc_evict_lock));
 
 	/*
 	 * Set the thread's tsd to indicate that it's processing evictions.
@@ -469,8 +566,10 @@ dbuf_evict_one(void)
 	if (db != NULL) {
 		multilist_sublist_remove(mls, db);
 		multilist_sublist_unlock(mls);
-		(void) refcount_remove_many(&dbuf_cache_size,
+		(void) refcount_remove_many(&dc->dc_size,
 		    db->db.db_size, db);
+		DBUFCACHE_DECR(dc, dcs_count);
+		DBUFCACHE_BUMP(dc, dcs_evicts);
 		dbuf_destroy(db);
 	} else {
 		multilist_sublist_unlock(mls);
@@ -484,49 +583,53 @@ dbuf_evict_one(void)
  * and destroyed. The eviction thread will continue running until the size
  * of the dbuf cache is at or below the maximum size. Once the dbuf is aged
  * out of the cache it is destroyed and becomes eligible for arc eviction.
+ * There is one of these threads for each shard of the cache.
  */
 static void
-dbuf_evict_thread(void)
+dbuf_evict_thread(void *arg)
 {
+	dbuf_cache_t *dc = arg;
 	callb_cpr_t cpr;
 
-	CALLB_CPR_INIT(&cpr, &dbuf_evict_lock, callb_generic_cpr, FTAG);
+	CALLB_CPR_INIT(&cpr, &dc->dc_evict_lock, callb_generic_cpr, FTAG);
 
-	mutex_enter(&dbuf_evict_lock);
-	while (!dbuf_evict_thread_exit) {
-		while (!dbuf_cache_above_lowater() && !dbuf_evict_thread_exit) {
+	mutex_enter(&dc->dc_evict_lock);
+	while (!dc->dc_evict_thread_exit) {
+		while (!dbuf_cache_above_lowater(dc) &&
+		    !dc->dc_evict_thread_exit) {
 			CALLB_CPR_SAFE_BEGIN(&cpr);
-			(void) cv_timedwait_hires(&dbuf_evict_cv,
-			    &dbuf_evict_lock, SEC2NSEC(1), MSEC2NSEC(1), 0);
-			CALLB_CPR_SAFE_END(&cpr, &dbuf_evict_lock);
+			(void) cv_timedwait_hires(&dc->dc_evict_cv,
+			    &dc->dc_evict_lock, SEC2NSEC(1), MSEC2NSEC(1), 0);
+			CALLB_CPR_SAFE_END(&cpr, &dc->dc_evict_lock);
 		}
-		mutex_exit(&dbuf_evict_lock);
+		mutex_exit(&dc->dc_evict_lock);
 
 		/*
 		 * Keep evicting as long as we're above the low water mark
 		 * for the cache. We do this without holding the locks to
 		 * minimize lock contention.
 		 */
-		while (dbuf_cache_above_lowater() && !dbuf_evict_thread_exit) {
-			dbuf_evict_one();
+		while (dbuf_cache_above_lowater(dc) &&
+		    !dc->dc_evict_thread_exit) {
+			dbuf_evict_one(dc);
 		}
 
-		mutex_enter(&dbuf_evict_lock);
+		mutex_enter(&dc->dc_evict_lock);
 	}
 
-	dbuf_evict_thread_exit = B_FALSE;
-	cv_broadcast(&dbuf_evict_cv);
-	CALLB_CPR_EXIT(&cpr);	/* drops dbuf_evict_lock */
+	dc->dc_evict_thread_exit = B_FALSE;
+	cv_broadcast(&dc->dc_evict_cv);
+	CALLB_CPR_EXIT(&cpr);	/* drops dc_evict_lock */
 	thread_exit();
 }
 
 /*
- * Wake up the dbuf eviction thread if the dbuf cache is at its max size.
- * If the dbuf cache is at its high water mark, then evict a dbuf from the
- * dbuf cache using the callers context.
+ * Wake up the shard's eviction thread if the shard is at its max size.
+ * If the shard is at its high water mark, then evict a dbuf from it
+ * using the callers context.
  */
 static void
-dbuf_evict_notify(void)
+dbuf_evict_notify(dbuf_cache_t *dc)
 {
 
 	/*
@@ -551,22 +654,86 @@ dbuf_evict_notify(void)
 	if (tsd_get(zfs_dbuf_evict_key) != NULL)
 		return;
 
-	if (refcount_count(&dbuf_cache_size) > dbuf_cache_max_bytes) {
+	if (refcount_count(&dc->dc_size) > dbuf_cache_shard_max_bytes()) {
 		boolean_t evict_now = B_FALSE;
 
-		mutex_enter(&dbuf_evict_lock);
-		if (refcount_count(&dbuf_cache_size) > dbuf_cache_max_bytes) {
-			evict_now = dbuf_cache_above_hiwater();
-			cv_signal(&dbuf_evict_cv);
+		mutex_enter(&dc->dc_evict_lock);
+		if (refcount_count(&dc->dc_size) >
+		    dbuf_cache_shard_max_bytes()) {
+			evict_now = dbuf_cache_above_hiwater(dc);
+			cv_signal(&dc->dc_evict_cv);
 		}
-		mutex_exit(&dbuf_evict_lock);
+		mutex_exit(&dc->dc_evict_lock);
 
 		if (evict_now) {
-			dbuf_evict_one();
+			dbuf_evict_one(dc);
 		}
 	}
 }
 
+static int
+dbuf_cache_kstat_update(kstat_t *ksp, int rw)
+{
+	dbuf_cache_t *dc = ksp->ks_private;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	dc->dc_stats.dcs_size.value.ui64 = refcount_count(&dc->dc_size);
+	dc->dc_stats.dcs_max_size.value.ui64 = dbuf_cache_shard_max_bytes();
+	return (0);
+}
+
+static void
+dbuf_cache_init(dbuf_cache_t *dc, int idx)
+{
+	multilist_create(&dc->dc_list, sizeof (dmu_buf_impl_t),
+	    offsetof(dmu_buf_impl_t, db_cache_link),
+	    zfs_arc_num_sublists_per_state,
+	    dbuf_cache_multilist_index_func);
+	refcount_create(&dc->dc_size);
+	dc->dc_stats = dbuf_cache_stats_template;
+
+	dc->dc_ksp = kstat_create("zfs", idx, "dbufcachestats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (dbuf_cache_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (dc->dc_ksp != NULL) {
+		dc->dc_ksp->ks_data = &dc->dc_stats;
+		dc->dc_ksp->ks_private = dc;
+		dc->dc_ksp->ks_update = dbuf_cache_kstat_update;
+		kstat_install(dc->dc_ksp);
+	}
+
+	dc->dc_evict_thread_exit = B_FALSE;
+	mutex_init(&dc->dc_evict_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&dc->dc_evict_cv, NULL, CV_DEFAULT, NULL);
+	dc->dc_evict_thread = thread_create(NULL, 0, dbuf_evict_thread,
+	    dc, 0, &p0, TS_RUN, minclsyspri);
+}
+
+static void
+dbuf_cache_fini(dbuf_cache_t *dc)
+{
+	mutex_enter(&dc->dc_evict_lock);
+	dc->dc_evict_thread_exit = B_TRUE;
+	while (dc->dc_evict_thread_exit) {
+		cv_signal(&dc->dc_evict_cv);
+		cv_wait(&dc->dc_evict_cv, &dc->dc_evict_lock);
+	}
+	mutex_exit(&dc->dc_evict_lock);
+
+	mutex_destroy(&dc->dc_evict_lock);
+	cv_destroy(&dc->dc_evict_cv);
+
+	if (dc->dc_ksp != NULL) {
+		kstat_delete(dc->dc_ksp);
+		dc->dc_ksp = NULL;
+	}
+
+	refcount_destroy(&dc->dc_size);
+	multilist_destroy(&dc->dc_list);
+}
+
 void
 dbuf_init(void)
 {
@@ -612,18 +779,19 @@ retry:
 	 */
 	dbu_evict_taskq = taskq_create("dbu_evict", 1, minclsyspri, 0, 0, 0);
 
-	multilist_create(&dbuf_cache, sizeof (dmu_buf_impl_t),
-	    offsetof(dmu_buf_impl_t, db_cache_link),
-	    zfs_arc_num_sublists_per_state,
-	    dbuf_cache_multilist_index_func);
-	refcount_create(&dbuf_cache_size);
-
 	tsd_create(&zfs_dbuf_evict_key, NULL);
-	dbuf_evict_thread_exit = B_FALSE;
-	mutex_init(&dbuf_evict_lock, NULL, MUTEX_DEFAULT, NULL);
-	cv_init(&dbuf_evict_cv, NULL, CV_DEFAULT, NULL);
-	dbuf_cache_evict_thread = thread_create(NULL, 0, dbuf_evict_thread,
-	    NULL, 0, &p0, TS_RUN, minclsyspri);
+
+	dbuf_cache_nshards = dbuf_cache_shards;
+	if (dbuf_cache_nshards <= 0) {
+		dbuf_cache_nshards = boot_ncpus /
+		    MAX(dbuf_cache_cpus_per_shard, 1);
+	}
+	dbuf_cache_nshards = MAX(MIN(dbuf_cache_nshards,
+	    DBUF_CACHE_MAX_SHARDS), 1);
+	dbuf_caches = kmem_zalloc(dbuf_cache_nshards * sizeof (dbuf_cache_t),
+	    KM_SLEEP);
+	for (i = 0; i < dbuf_cache_nshards; i++)
+		dbuf_cache_init(&dbuf_caches[i], i);
 }
 
 void
@@ -638,20 +806,11 @@ dbuf_fini(void)
 	kmem_cache_destroy(dbuf_kmem_cache);
 	taskq_destroy(dbu_evict_taskq);
 
-	mutex_enter(&dbuf_evict_lock);
-	dbuf_evict_thread_exit = B_TRUE;
-	while (dbuf_evict_thread_exit) {
-		cv_signal(&dbuf_evict_cv);
-		cv_wait(&dbuf_evict_cv, &dbuf_evict_lock);
-	}
-	mutex_exit(&dbuf_evict_lock);
+	for (i = 0; i < dbuf_cache_nshards; i++)
+		dbuf_cache_fini(&dbuf_caches[i]);
+	kmem_free(dbuf_caches, dbuf_cache_nshards * sizeof (dbuf_cache_t));
+	dbuf_caches = NULL;
 	tsd_destroy(&zfs_dbuf_evict_key);
-
-	mutex_destroy(&dbuf_evict_lock);
-	cv_destroy(&dbuf_evict_cv);
-
-	refcount_destroy(&dbuf_cache_size);
-	multilist_destroy(&dbuf_cache);
 }
 
 /*
@@ -940,12 +1099,13 @@ dbuf_read_impl(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 
 	if (db->db_blkid == DMU_BONUS_BLKID) {
 		int bonuslen = MIN(dn->dn_bonuslen, dn->dn_phys->dn_bonuslen);
+		int max_bonuslen = DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots);
 
 		ASSERT3U(bonuslen, <=, db->db.db_size);
-		db->db.db_data = zio_buf_alloc(DN_MAX_BONUSLEN);
-		arc_space_consume(DN_MAX_BONUSLEN, ARC_SPACE_OTHER);
-		if (bonuslen < DN_MAX_BONUSLEN)
-			bzero(db->db.db_data, DN_MAX_BONUSLEN);
+		db->db.db_data = zio_buf_alloc(max_bonuslen);
+		arc_space_consume(max_bonuslen, ARC_SPACE_OTHER);
+		if (bonuslen < max_bonuslen)
+			bzero(db->db.db_data, max_bonuslen);
 		if (bonuslen)
 			bcopy(DN_BONUS(dn->dn_phys), db->db.db_data, bonuslen);
 		DB_DNODE_EXIT(db);
@@ -1043,8 +1203,10 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 	mutex_enter(&db->db_mtx);
 	if (db->db_state == DB_CACHED) {
 		mutex_exit(&db->db_mtx);
-		if (prefetch)
-			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE);
+		if (prefetch) {
+			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE,
+			    B_FALSE);
+		}
 		if ((flags & DB_RF_HAVESTRUCT) == 0)
 			rw_exit(&dn->dn_struct_rwlock);
 		DB_DNODE_EXIT(db);
@@ -1057,8 +1219,15 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 
 		/* dbuf_read_impl has dropped db_mtx for us */
 
-		if (prefetch)
-			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE);
+		/*
+		 * If the block was in the ARC, the read completed inline and
+		 * the dbuf is already cached; otherwise we'll wait for it.
+		 * This is only a hint for the prefetcher, so no lock needed.
+		 */
+		if (prefetch) {
+			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE,
+			    db->db_state != DB_CACHED);
+		}
 
 		if ((flags & DB_RF_HAVESTRUCT) == 0)
 			rw_exit(&dn->dn_struct_rwlock);
@@ -1076,8 +1245,10 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 		 * occurred and the dbuf went to UNCACHED.
 		 */
 		mutex_exit(&db->db_mtx);
-		if (prefetch)
-			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE);
+		if (prefetch) {
+			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1, B_TRUE,
+			    B_TRUE);
+		}
 		if ((flags & DB_RF_HAVESTRUCT) == 0)
 			rw_exit(&dn->dn_struct_rwlock);
 		DB_DNODE_EXIT(db);
@@ -1164,10 +1335,18 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	 */
 	ASSERT(dr->dr_txg >= txg - 2);
 	if (db->db_blkid == DMU_BONUS_BLKID) {
+		dnode_t *dn;
+		int max_bonuslen;
+
+		DB_DNODE_ENTER(db);
+		dn = DB_DNODE(db);
+		max_bonuslen = DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots);
+		DB_DNODE_EXIT(db);
+
 		/* Note that the data bufs here are zio_bufs */
-		dr->dt.dl.dr_data = zio_buf_alloc(DN_MAX_BONUSLEN);
-		arc_space_consume(DN_MAX_BONUSLEN, ARC_SPACE_OTHER);
-		bcopy(db->db.db_data, dr->dt.dl.dr_data, DN_MAX_BONUSLEN);
+		dr->dt.dl.dr_data = zio_buf_alloc(max_bonuslen);
+		arc_space_consume(max_bonuslen, ARC_SPACE_OTHER);
+		bcopy(db->db.db_data, dr->dt.dl.dr_data, max_bonuslen);
 	} else if (refcount_count(&db->db_holds) > db->db_dirtycnt) {
 		int size = db->db.db_size;
 		arc_buf_contents_t type = DBUF_GET_BUFC_TYPE(db);
@@ -1181,6 +1360,17 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	}
 }
 
+static void
+dbuf_free_raw(dbuf_dirty_record_t *dr)
+{
+	if (dr->dt.dl.dr_raw_data != NULL) {
+		zio_data_buf_free(dr->dt.dl.dr_raw_data,
+		    dr->dt.dl.dr_raw_psize);
+		dr->dt.dl.dr_raw_data = NULL;
+		dr->dt.dl.dr_raw_psize = 0;
+	}
+}
+
 void
 dbuf_unoverride(dbuf_dirty_record_t *dr)
 {
@@ -1192,8 +1382,12 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	ASSERT(dr->dt.dl.dr_override_state != DR_IN_DMU_SYNC);
 	ASSERT(db->db_level == 0);
 
-	if (db->db_blkid == DMU_BONUS_BLKID ||
-	    dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN)
+	if (db->db_blkid == DMU_BONUS_BLKID)
+		return;
+
+	dbuf_free_raw(dr);
+
+	if (dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN)
 		return;
 
 	ASSERT(db->db_data_pending != dr);
@@ -1793,6 +1987,8 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	ASSERT(db->db.db_size != 0);
 
 	dsl_pool_undirty_space(dmu_objset_pool(dn->dn_objset),
+	    dn->dn_objset->os_dsl_dataset != NULL ?
+	    dn->dn_objset->os_dsl_dataset->ds_dir : NULL,
 	    dr->dr_accounted, txg);
 
 	*drp = dr->dr_next;
@@ -1823,6 +2019,8 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 		ASSERT(dr->dt.dl.dr_data != NULL);
 		if (dr->dt.dl.dr_data != db->db_buf)
 			arc_buf_destroy(dr->dt.dl.dr_data, db);
+	} else {
+		dbuf_free_raw(dr);
 	}
 
 	kmem_free(dr, sizeof (dbuf_dirty_record_t));
@@ -1966,6 +2164,35 @@ dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
 	dl->dr_overridden_by.blk_birth = db->db_last_dirty->dr_txg;
 }
 
+/*
+ * Dirty a level-0 block with psize bytes of data that is already compressed
+ * with comp, e.g. a block from a compressed send stream.  The data is
+ * written out as is in syncing context without passing through the ARC.
+ * The buffer must come from zio_data_buf_alloc(psize); it is consumed.
+ */
+void
+dmu_buf_write_compressed(dmu_buf_t *dbuf, void *data, enum zio_compress comp,
+    uint64_t psize, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbuf;
+	struct dirty_leaf *dl;
+
+	ASSERT0(db->db_level);
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT3U(comp, !=, ZIO_COMPRESS_OFF);
+	ASSERT3U(comp, <, ZIO_COMPRESS_FUNCTIONS);
+	ASSERT3U(psize, <=, db->db.db_size);
+
+	dmu_buf_will_not_fill(dbuf, tx);
+
+	ASSERT3U(db->db_last_dirty->dr_txg, ==, tx->tx_txg);
+	dl = &db->db_last_dirty->dt.dl;
+	ASSERT3P(dl->dr_raw_data, ==, NULL);
+	dl->dr_raw_data = data;
+	dl->dr_raw_psize = psize;
+	dl->dr_raw_compress = comp;
+}
+
 /*
  * Directly assign a provided arc buf to a given dbuf if it's not referenced
  * by anybody except our caller. Otherwise copy arcbuf's contents to dbuf.
@@ -2045,19 +2272,21 @@ dbuf_destroy(dmu_buf_impl_t *db)
 	}
 
 	if (db->db_blkid == DMU_BONUS_BLKID) {
+		int max_bonuslen;
+
 		ASSERT(db->db.db_data != NULL);
-		zio_buf_free(db->db.db_data, DN_MAX_BONUSLEN);
-		arc_space_return(DN_MAX_BONUSLEN, ARC_SPACE_OTHER);
+		DB_DNODE_ENTER(db);
+		max_bonuslen = DN_SLOTS_TO_BONUSLEN(DB_DNODE(db)->dn_num_slots);
+		DB_DNODE_EXIT(db);
+		zio_buf_free(db->db.db_data, max_bonuslen);
+		arc_space_return(max_bonuslen, ARC_SPACE_OTHER);
 		db->db_state = DB_UNCACHED;
 	}
 
 	dbuf_clear_data(db);
 
-	if (multilist_link_active(&db->db_cache_link)) {
-		multilist_remove(&dbuf_cache, db);
-		(void) refcount_remove_many(&dbuf_cache_size,
-		    db->db.db_size, db);
-	}
+	if (multilist_link_active(&db->db_cache_link))
+		dbuf_cache_remove(db, B_FALSE);
 
 	ASSERT(db->db_state == DB_UNCACHED || db->db_state == DB_NOFILL);
 	ASSERT(db->db_data_pending == NULL);
@@ -2144,7 +2373,7 @@ dbuf_findbp(dnode_t *dn, int level, uint64_t blkid, int fail_sparse,
 		mutex_enter(&dn->dn_mtx);
 		if (dn->dn_have_spill &&
 		    (dn->dn_phys->dn_flags & DNODE_FLAG_SPILL_BLKPTR))
-			*bpp = &dn->dn_phys->dn_spill;
+			*bpp = DN_SPILL_BLKPTR(dn->dn_phys);
 		else
 			*bpp = NULL;
 		dbuf_add_ref(dn->dn_dbuf, NULL);
@@ -2225,7 +2454,7 @@ dbuf_create(dnode_t *dn, uint8_t level, uint64_t blkid,
 
 	if (blkid == DMU_BONUS_BLKID) {
 		ASSERT3P(parent, ==, dn->dn_dbuf);
-		db->db.db_size = DN_MAX_BONUSLEN -
+		db->db.db_size = DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots) -
 		    (dn->dn_nblkptr-1) * sizeof (blkptr_t);
 		ASSERT3U(db->db.db_size, >=, dn->dn_bonuslen);
 		db->db.db_offset = DMU_BONUS_BLKID;
@@ -2551,6 +2780,7 @@ top:
 		if (err && err != ENOENT)
 			return (err);
 		db = dbuf_create(dn, level, blkid, parent, bp);
+		DBUFCACHE_BUMP(dbuf_cache_shard(db), dcs_misses);
 	}
 
 	if (fail_uncached && db->db_state != DB_CACHED) {
@@ -2586,9 +2816,7 @@ top:
 
 	if (multilist_link_active(&db->db_cache_link)) {
 		ASSERT(refcount_is_zero(&db->db_holds));
-		multilist_remove(&dbuf_cache, db);
-		(void) refcount_remove_many(&dbuf_cache_size,
-		    db->db.db_size, db);
+		dbuf_cache_remove(db, B_TRUE);
 	}
 	(void) refcount_add(&db->db_holds, tag);
 	DBUF_VERIFY(db);
@@ -2805,12 +3033,10 @@ dbuf_rele_and_unlock(dmu_buf_impl_t *db, void *tag)
 			    db->db_pending_evict) {
 				dbuf_destroy(db);
 			} else if (!multilist_link_active(&db->db_cache_link)) {
-				multilist_insert(&dbuf_cache, db);
-				(void) refcount_add_many(&dbuf_cache_size,
-				    db->db.db_size, db);
+				dbuf_cache_t *dc = dbuf_cache_insert(db);
 				mutex_exit(&db->db_mtx);
 
-				dbuf_evict_notify();
+				dbuf_evict_notify(dc);
 			}
 
 			if (do_arc_evict)
@@ -2913,7 +3139,7 @@ dbuf_check_blkptr(dnode_t *dn, dmu_buf_impl_t *db)
 		return;
 
 	if (db->db_blkid == DMU_SPILL_BLKID) {
-		db->db_blkptr = &dn->dn_phys->dn_spill;
+		db->db_blkptr = DN_SPILL_BLKPTR(dn->dn_phys);
 		BP_ZERO(db->db_blkptr);
 		return;
 	}
@@ -3040,16 +3266,17 @@ dbuf_sync_leaf(dbuf_dirty_record_t *dr, dmu_tx_t *tx)
 	 */
 	if (db->db_blkid == DMU_BONUS_BLKID) {
 		dbuf_dirty_record_t **drp;
+		int max_bonuslen = DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots);
 
 		ASSERT(*datap != NULL);
 		ASSERT0(db->db_level);
-		ASSERT3U(dn->dn_phys->dn_bonuslen, <=, DN_MAX_BONUSLEN);
+		ASSERT3U(dn->dn_phys->dn_bonuslen, <=, max_bonuslen);
 		bcopy(*datap, DN_BONUS(dn->dn_phys), dn->dn_phys->dn_bonuslen);
 		DB_DNODE_EXIT(db);
 
 		if (*datap != db->db.db_data) {
-			zio_buf_free(*datap, DN_MAX_BONUSLEN);
-			arc_space_return(DN_MAX_BONUSLEN, ARC_SPACE_OTHER);
+			zio_buf_free(*datap, max_bonuslen);
+			arc_space_return(max_bonuslen, ARC_SPACE_OTHER);
 		}
 		db->db_data_pending = NULL;
 		drp = &db->db_last_dirty;
@@ -3196,7 +3423,7 @@ dbuf_write_ready(zio_t *zio, arc_buf_t *buf, void *vdb)
 	if (db->db_blkid == DMU_SPILL_BLKID) {
 		ASSERT(dn->dn_phys->dn_flags & DNODE_FLAG_SPILL_BLKPTR);
 		ASSERT(!(BP_IS_HOLE(bp)) &&
-		    db->db_blkptr == &dn->dn_phys->dn_spill);
+		    db->db_blkptr == DN_SPILL_BLKPTR(dn->dn_phys));
 	}
 #endif
 
@@ -3209,10 +3436,16 @@ dbuf_write_ready(zio_t *zio, arc_buf_t *buf, void *vdb)
 
 		if (dn->dn_type == DMU_OT_DNODE) {
 			dnode_phys_t *dnp = db->db.db_data;
+			int slots;
+
+			/* The fill of a dnode block counts dnodes, not slots. */
 			for (i = db->db.db_size >> DNODE_SHIFT; i > 0;
-			    i--, dnp++) {
-				if (dnp->dn_type != DMU_OT_NONE)
+			    i -= slots, dnp += slots) {
+				slots = 1;
+				if (dnp->dn_type != DMU_OT_NONE) {
+					slots += dnp->dn_extra_slots;
 					fill++;
+				}
 			}
 		} else {
 			if (BP_IS_HOLE(bp)) {
@@ -3310,7 +3543,8 @@ dbuf_write_physdone(zio_t *zio, arc_buf_t *buf, void *arg)
 	 * dsl_pool_undirty_space().
 	 */
 	delta = dr->dr_accounted / zio->io_phys_children;
-	dsl_pool_undirty_space(dp, delta, zio->io_txg);
+	dsl_pool_undirty_space(dp, os->os_dsl_dataset != NULL ?
+	    os->os_dsl_dataset->ds_dir : NULL, delta, zio->io_txg);
 }
 
 /* ARGSUSED */
@@ -3359,7 +3593,7 @@ dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 		dn = DB_DNODE(db);
 		ASSERT(dn->dn_phys->dn_flags & DNODE_FLAG_SPILL_BLKPTR);
 		ASSERT(!(BP_IS_HOLE(db->db_blkptr)) &&
-		    db->db_blkptr == &dn->dn_phys->dn_spill);
+		    db->db_blkptr == DN_SPILL_BLKPTR(dn->dn_phys));
 		DB_DNODE_EXIT(db);
 	}
 #endif
@@ -3370,6 +3604,8 @@ dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 		if (db->db_state != DB_NOFILL) {
 			if (dr->dt.dl.dr_data != db->db_buf)
 				arc_buf_destroy(dr->dt.dl.dr_data, db);
+		} else {
+			dbuf_free_raw(dr);
 		}
 	} else {
 		dnode_t *dn;
@@ -3507,7 +3743,8 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 
 	if (db->db_blkid == DMU_SPILL_BLKID)
 		wp_flag = WP_SPILL;
-	wp_flag |= (db->db_state == DB_NOFILL) ? WP_NOFILL : 0;
+	if (db->db_state == DB_NOFILL && dr->dt.dl.dr_raw_data == NULL)
+		wp_flag |= WP_NOFILL;
 
 	dmu_write_policy(os, dn, db->db_level, wp_flag, &zp);
 	DB_DNODE_EXIT(db);
@@ -3529,8 +3766,8 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 		void *contents = (data != NULL) ? data->b_data : NULL;
 
 		dr->dr_zio = zio_write(zio, os->os_spa, txg,
-		    &dr->dr_bp_copy, contents, db->db.db_size, &zp,
-		    dbuf_write_override_ready, NULL, NULL,
+		    &dr->dr_bp_copy, contents, db->db.db_size,
+		    db->db.db_size, &zp, dbuf_write_override_ready, NULL, NULL,
 		    dbuf_write_override_done,
 		    dr, ZIO_PRIORITY_ASYNC_WRITE, ZIO_FLAG_MUSTSUCCEED, &zb);
 		mutex_enter(&db->db_mtx);
@@ -3538,12 +3775,26 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 		zio_write_override(dr->dr_zio, &dr->dt.dl.dr_overridden_by,
 		    dr->dt.dl.dr_copies, dr->dt.dl.dr_nopwrite);
 		mutex_exit(&db->db_mtx);
+	} else if (db->db_state == DB_NOFILL && dr->dt.dl.dr_raw_data != NULL) {
+		/*
+		 * The data was handed to us already compressed (by
+		 * dmu_buf_write_compressed()); write it out as is.
+		 */
+		zp.zp_compress = dr->dt.dl.dr_raw_compress;
+		zp.zp_dedup = zp.zp_dedup_verify = B_FALSE;
+		zp.zp_nopwrite = B_FALSE;
+		dr->dr_zio = zio_write(zio, os->os_spa, txg,
+		    &dr->dr_bp_copy, dr->dt.dl.dr_raw_data, db->db.db_size,
+		    dr->dt.dl.dr_raw_psize, &zp, dbuf_write_nofill_ready,
+		    NULL, NULL, dbuf_write_nofill_done, db,
+		    ZIO_PRIORITY_ASYNC_WRITE,
+		    ZIO_FLAG_MUSTSUCCEED | ZIO_FLAG_RAW, &zb);
 	} else if (db->db_state == DB_NOFILL) {
 		ASSERT(zp.zp_checksum == ZIO_CHECKSUM_OFF ||
 		    zp.zp_checksum == ZIO_CHECKSUM_NOPARITY);
 		dr->dr_zio = zio_write(zio, os->os_spa, txg,
-		    &dr->dr_bp_copy, NULL, db->db.db_size, &zp,
-		    dbuf_write_nofill_ready, NULL, NULL,
+		    &dr->dr_bp_copy, NULL, db->db.db_size,
+		    db->db.db_size, &zp, dbuf_write_nofill_ready, NULL, NULL,
 		    dbuf_write_nofill_done, db,
 		    ZIO_PRIORITY_ASYNC_WRITE,
 		    ZIO_FLAG_MUSTSUCCEED | ZIO_FLAG_NODATA, &zb);
@@ -36,12 +36,41 @@
 #include <sys/zio_checksum.h>
 #include <sys/zio_compress.h>
 #include <sys/dsl_scan.h>
+#include <sys/zfeature.h>
 
 /*
  * Enable/disable prefetching of dedup-ed blocks which are going to be freed.
  */
 int zfs_dedup_prefetch = 1;
 
+/*
+ * Enable/disable the dedup log.  When enabled (and the dedup_log feature
+ * is enabled), dedup table updates are appended to a log object and
+ * written back to the ZAP objects in large key-ordered batches, rather
+ * than every dirty entry rewriting its ZAP leaf in every txg.  Disabling
+ * this only keeps new logs from being created; existing logs are drained
+ * and used until the dedup table is empty.
+ */
+int zfs_dedup_log_enabled = 1;
+
+/*
+ * The active log is handed over for flushing once it is this many txgs
+ * old and the previous log has drained.
+ */
+int zfs_dedup_log_txg_max = 100;
+
+/*
+ * A log being flushed is written back at zfs_dedup_log_flush_entries_min
+ * entries per txg, or fast enough to drain within zfs_dedup_log_flush_txgs
+ * txgs, whichever is faster.
+ */
+int zfs_dedup_log_flush_entries_min = 1000;
+int zfs_dedup_log_flush_txgs = 100;
+
+#define	DDT_LOG_BUF_RECORDS	512
+#define	DDT_LOG_BUFSIZE		\
+	(DDT_LOG_BUF_RECORDS * sizeof (ddt_log_record_t))
+
 static const ddt_ops_t *ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
 };
@@ -150,7 +179,8 @@ ddt_object_sync(ddt_t *ddt, enum ddt_type type, enum ddt_class class,
 	 */
 	VERIFY(ddt_object_info(ddt, type, class, &doi) == 0);
 
-	ddo->ddo_count = ddt_object_count(ddt, type, class);
+	ddo->ddo_count = ddt_object_count(ddt, type, class) +
+	    ddt->ddt_log_count[type][class];
 	ddo->ddo_dspace = doi.doi_physical_blocks_512 << 9;
 	ddo->ddo_mspace = doi.doi_fill_count * doi.doi_data_block_size;
 }
@@ -668,10 +698,550 @@ ddt_remove(ddt_t *ddt, ddt_entry_t *dde)
 	ddt_free(dde);
 }
 
+static int
+ddt_key_compare(const ddt_key_t *k1, const ddt_key_t *k2)
+{
+	const uint64_t *u1 = (const uint64_t *)k1;
+	const uint64_t *u2 = (const uint64_t *)k2;
+
+	for (int i = 0; i < DDT_KEY_WORDS; i++) {
+		if (u1[i] < u2[i])
+			return (-1);
+		if (u1[i] > u2[i])
+			return (1);
+	}
+
+	return (0);
+}
+
+static int
+ddt_log_entry_compare(const void *x1, const void *x2)
+{
+	const ddt_log_entry_t *ddle1 = x1;
+	const ddt_log_entry_t *ddle2 = x2;
+
+	return (ddt_key_compare(&ddle1->ddle_key, &ddle2->ddle_key));
+}
+
+/*
+ * Dedup log.
+ *
+ * Once the dedup table no longer fits in memory, updating it in place
+ * costs a random ZAP leaf read and rewrite for every dirty entry in every
+ * txg.  Instead, each txg's dirty entries are appended to the active log
+ * object (a sequential write) and kept in an in-core tree, which lookups
+ * consult before the ZAP objects.  After zfs_dedup_log_txg_max txgs the
+ * active log becomes the flushing log, whose entries are written back to
+ * the ZAP objects a batch at a time in key order; since the DDT ZAPs are
+ * prehashed on the first checksum word, consecutive keys land in the same
+ * leaves.  Repeated updates of a key while it is logged collapse into a
+ * single ZAP update.  Once the flushing log has drained it is truncated
+ * and becomes the active log again.
+ *
+ * Each log entry records both the class it logically belongs to, which is
+ * what lookups, walks and the histograms see, and the ZAP object that
+ * currently holds the key, so the flush knows where to remove it from.
+ */
+static boolean_t
+ddt_log_exists(ddt_t *ddt)
+{
+	return (ddt->ddt_log[0].ddl_object != 0);
+}
+
+static boolean_t
+ddt_log_empty(ddt_t *ddt)
+{
+	return (avl_numnodes(&ddt->ddt_log_active->ddl_tree) == 0 &&
+	    avl_numnodes(&ddt->ddt_log_flushing->ddl_tree) == 0);
+}
+
+static void
+ddt_log_name(ddt_t *ddt, char *name)
+{
+	(void) sprintf(name, DMU_POOL_DDT_LOG,
+	    zio_checksum_table[ddt->ddt_checksum].ci_name);
+}
+
+/*
+ * Return the latest logged state of a key, or NULL if it isn't logged.
+ */
+static ddt_log_entry_t *
+ddt_log_find(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	ddt_log_entry_t search, *ddle;
+
+	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
+
+	search.ddle_key = *ddk;
+	ddle = avl_find(&ddt->ddt_log_active->ddl_tree, &search, NULL);
+	if (ddle == NULL)
+		ddle = avl_find(&ddt->ddt_log_flushing->ddl_tree, &search,
+		    NULL);
+
+	return (ddle);
+}
+
+static boolean_t
+ddt_log_contains(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	boolean_t found;
+
+	if (!ddt_log_exists(ddt))
+		return (B_FALSE);
+
+	ddt_enter(ddt);
+	found = (ddt_log_find(ddt, ddk) != NULL);
+	ddt_exit(ddt);
+
+	return (found);
+}
+
+/*
+ * Add (sign == 1) or remove (sign == -1) a log entry's effect on the entry
+ * counts of the ZAP objects it will move between when flushed.
+ */
+static void
+ddt_log_count_update(ddt_t *ddt, const ddt_log_entry_t *ddle, int64_t sign)
+{
+	if (ddle->ddle_type != DDT_TYPES)
+		ddt->ddt_log_count[ddle->ddle_type][ddle->ddle_class] += sign;
+	if (ddle->ddle_zap_type != DDT_TYPES) {
+		ddt->ddt_log_count[ddle->ddle_zap_type]
+		    [ddle->ddle_zap_class] -= sign;
+	}
+}
+
+static void
+ddt_log_sync_phys(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_phys_t ddlp;
+	char name[DDT_NAMELEN];
+
+	bzero(&ddlp, sizeof (ddlp));
+	for (int i = 0; i < 2; i++) {
+		ddlp.ddlp_object[i] = ddt->ddt_log[i].ddl_object;
+		ddlp.ddlp_length[i] = ddt->ddt_log[i].ddl_length;
+		ddlp.ddlp_first_txg[i] = ddt->ddt_log[i].ddl_first_txg;
+	}
+	ddlp.ddlp_active = ddt->ddt_log_active - ddt->ddt_log;
+	ddlp.ddlp_flushed = ddt->ddt_log_flushed;
+	ddlp.ddlp_cursor = ddt->ddt_log_cursor;
+
+	ddt_log_name(ddt, name);
+	VERIFY0(zap_update(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), sizeof (ddlp) / sizeof (uint64_t), &ddlp, tx));
+}
+
+static void
+ddt_log_create(ddt_t *ddt, dmu_tx_t *tx)
+{
+	for (int i = 0; i < 2; i++) {
+		ddt_log_t *ddl = &ddt->ddt_log[i];
+
+		ASSERT0(ddl->ddl_object);
+		ASSERT0(avl_numnodes(&ddl->ddl_tree));
+		ddl->ddl_object = dmu_object_alloc(ddt->ddt_os,
+		    DMU_OTN_UINT64_METADATA, SPA_OLD_MAXBLOCKSIZE,
+		    DMU_OT_NONE, 0, tx);
+		ddl->ddl_length = 0;
+	}
+	ddt->ddt_log_active = &ddt->ddt_log[0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[1];
+	ddt->ddt_log_flushed = B_FALSE;
+
+	spa_feature_incr(ddt->ddt_spa, SPA_FEATURE_DDT_LOG, tx);
+}
+
+static void
+ddt_log_destroy(ddt_t *ddt, dmu_tx_t *tx)
+{
+	char name[DDT_NAMELEN];
+
+	ASSERT(ddt_log_empty(ddt));
+
+	for (int i = 0; i < 2; i++) {
+		ddt_log_t *ddl = &ddt->ddt_log[i];
+
+		VERIFY0(dmu_object_free(ddt->ddt_os, ddl->ddl_object, tx));
+		ddl->ddl_object = 0;
+		ddl->ddl_length = 0;
+	}
+
+	ddt_log_name(ddt, name);
+	VERIFY0(zap_remove(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT, name, tx));
+
+	spa_feature_decr(ddt->ddt_spa, SPA_FEATURE_DDT_LOG, tx);
+}
+
+/*
+ * Write out the records buffered by ddt_log_append().
+ */
+static void
+ddt_log_write(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_active;
+	uint64_t size = ddt->ddt_log_buf_count * sizeof (ddt_log_record_t);
+
+	if (size == 0)
+		return;
+
+	dmu_write(ddt->ddt_os, ddl->ddl_object, ddl->ddl_length, size,
+	    ddt->ddt_log_buf, tx);
+	ddl->ddl_length += size;
+	ddt->ddt_log_buf_count = 0;
+}
+
+/*
+ * Log the new state of a dirty entry.  ntype and nclass are where the
+ * entry now belongs, or DDT_TYPES and DDT_CLASSES if it has been freed.
+ */
+static void
+ddt_log_append(ddt_t *ddt, ddt_entry_t *dde, enum ddt_type ntype,
+    enum ddt_class nclass, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_active;
+	ddt_log_entry_t search, *ddle, *oddle;
+	ddt_log_record_t *ddlr;
+	enum ddt_type zap_type = dde->dde_type;
+	enum ddt_class zap_class = dde->dde_class;
+	avl_index_t where;
+	boolean_t insert = B_FALSE;
+
+	search.ddle_key = dde->dde_key;
+	ddle = avl_find(&ddl->ddl_tree, &search, &where);
+	oddle = ddle;
+	if (oddle == NULL) {
+		oddle = avl_find(&ddt->ddt_log_flushing->ddl_tree,
+		    &search, NULL);
+	}
+
+	/*
+	 * If the key is already logged, the ZAP location is the one the
+	 * log recorded; otherwise the lookup found it in the ZAP (or
+	 * nowhere), which dde_type and dde_class reflect.
+	 */
+	if (oddle != NULL) {
+		zap_type = oddle->ddle_zap_type;
+		zap_class = oddle->ddle_zap_class;
+		ddt_log_count_update(ddt, oddle, -1);
+	} else if (zap_type == DDT_TYPES && ntype == DDT_TYPES) {
+		return;
+	}
+
+	if (ddle == NULL) {
+		ddle = kmem_zalloc(sizeof (*ddle), KM_SLEEP);
+		ddle->ddle_key = dde->dde_key;
+		if (avl_numnodes(&ddl->ddl_tree) == 0)
+			ddl->ddl_first_txg = dmu_tx_get_txg(tx);
+		insert = B_TRUE;
+	}
+
+	ddt_enter(ddt);
+	bcopy(dde->dde_phys, ddle->ddle_phys, sizeof (ddle->ddle_phys));
+	ddle->ddle_type = ntype;
+	ddle->ddle_class = nclass;
+	ddle->ddle_zap_type = zap_type;
+	ddle->ddle_zap_class = zap_class;
+	if (insert)
+		avl_insert(&ddl->ddl_tree, ddle, where);
+	ddt_exit(ddt);
+
+	ddt_log_count_update(ddt, ddle, 1);
+
+	ddlr = &ddt->ddt_log_buf[ddt->ddt_log_buf_count++];
+	ddlr->ddlr_key = ddle->ddle_key;
+	bcopy(ddle->ddle_phys, ddlr->ddlr_phys, sizeof (ddlr->ddlr_phys));
+	ddlr->ddlr_info = 0;
+	DDLR_SET_TYPE(ddlr, ntype);
+	DDLR_SET_CLASS(ddlr, nclass);
+	DDLR_SET_ZAP_TYPE(ddlr, zap_type);
+	DDLR_SET_ZAP_CLASS(ddlr, zap_class);
+
+	if (ddt->ddt_log_buf_count == DDT_LOG_BUF_RECORDS)
+		ddt_log_write(ddt, tx);
+}
+
+/*
+ * Move one flushing log entry to the ZAP object it belongs in.
+ */
+static void
+ddt_log_flush_entry(ddt_t *ddt, ddt_log_entry_t *ddle, dmu_tx_t *tx)
+{
+	dsl_scan_t *scn = ddt->ddt_spa->spa_dsl_pool->dp_scan;
+	enum ddt_type type = ddle->ddle_type;
+	enum ddt_class class = ddle->ddle_class;
+	ddt_entry_t dde;
+
+	bzero(&dde, sizeof (dde));
+	dde.dde_key = ddle->ddle_key;
+	bcopy(ddle->ddle_phys, dde.dde_phys, sizeof (dde.dde_phys));
+
+	if (ddle->ddle_zap_type != DDT_TYPES &&
+	    (ddle->ddle_zap_type != type || ddle->ddle_zap_class != class)) {
+		VERIFY0(ddt_object_remove(ddt, ddle->ddle_zap_type,
+		    ddle->ddle_zap_class, &dde, tx));
+	}
+
+	if (type == DDT_TYPES)
+		return;
+
+	VERIFY0(ddt_object_update(ddt, type, class, &dde, tx));
+
+	/*
+	 * A DDT walk in this class may already be past the key's place in
+	 * the ZAP object, and won't find it in the log any more, so have an
+	 * in-progress scan visit it now.
+	 */
+	if (scn->scn_phys.scn_ddt_bookmark.ddb_class == class &&
+	    class <= scn->scn_phys.scn_ddt_class_max)
+		dsl_scan_ddt_entry(scn, ddt->ddt_checksum, &dde, tx);
+}
+
+static boolean_t
+ddt_log_want_flush(ddt_t *ddt, uint64_t txg)
+{
+	ddt_log_t *active = ddt->ddt_log_active;
+	ddt_log_t *flushing = ddt->ddt_log_flushing;
+
+	if (!ddt_log_exists(ddt) || spa_sync_pass(ddt->ddt_spa) > 1)
+		return (B_FALSE);
+
+	return (avl_numnodes(&flushing->ddl_tree) != 0 ||
+	    flushing->ddl_length != 0 ||
+	    (avl_numnodes(&active->ddl_tree) != 0 &&
+	    txg >= active->ddl_first_txg + zfs_dedup_log_txg_max));
+}
+
+static void
+ddt_log_flush(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_flushing;
+	avl_tree_t *t = &ddl->ddl_tree;
+	ddt_log_entry_t *ddle;
+	uint64_t n;
+
+	for (n = 0; n < ddt->ddt_log_flush_rate &&
+	    (ddle = avl_first(t)) != NULL; n++) {
+		/*
+		 * An entry that has been logged again since is superseded
+		 * by its state in the active log, and is flushed from there.
+		 */
+		if (avl_find(&ddt->ddt_log_active->ddl_tree, ddle,
+		    NULL) == NULL) {
+			ddt_log_flush_entry(ddt, ddle, tx);
+			ddt_log_count_update(ddt, ddle, -1);
+		}
+		ddt->ddt_log_cursor = ddle->ddle_key;
+		ddt->ddt_log_flushed = B_TRUE;
+
+		ddt_enter(ddt);
+		avl_remove(t, ddle);
+		ddt_exit(ddt);
+		kmem_free(ddle, sizeof (*ddle));
+	}
+
+	if (avl_numnodes(t) != 0)
+		return;
+
+	if (ddl->ddl_length != 0) {
+		VERIFY0(dmu_free_range(ddt->ddt_os, ddl->ddl_object, 0,
+		    DMU_OBJECT_END, tx));
+		ddl->ddl_length = 0;
+	}
+	ddt->ddt_log_flushed = B_FALSE;
+	bzero(&ddt->ddt_log_cursor, sizeof (ddt->ddt_log_cursor));
+
+	/*
+	 * The flushing log has drained; start on the active one if it is
+	 * old enough.
+	 */
+	ddl = ddt->ddt_log_active;
+	n = avl_numnodes(&ddl->ddl_tree);
+	if (n == 0 ||
+	    dmu_tx_get_txg(tx) < ddl->ddl_first_txg + zfs_dedup_log_txg_max)
+		return;
+
+	ddt->ddt_log_active = ddt->ddt_log_flushing;
+	ddt->ddt_log_flushing = ddl;
+	ddt->ddt_log_flush_rate = MAX(zfs_dedup_log_flush_entries_min,
+	    n / MAX(zfs_dedup_log_flush_txgs, 1));
+}
+
+/*
+ * Walk the logged entries that belong to the given class, in key order.
+ * The walk cursor is the first checksum word of the next key to visit.
+ */
+static int
+ddt_log_walk(ddt_t *ddt, enum ddt_class class, uint64_t *walk,
+    ddt_entry_t *dde)
+{
+	avl_tree_t *at = &ddt->ddt_log_active->ddl_tree;
+	avl_tree_t *ft = &ddt->ddt_log_flushing->ddl_tree;
+	ddt_log_entry_t search, *a, *f, *ddle;
+	avl_index_t where;
+	int error = ENOENT;
+
+	if (!ddt_log_exists(ddt))
+		return (SET_ERROR(ENOENT));
+
+	bzero(&search, sizeof (search));
+	search.ddle_key.ddk_cksum.zc_word[0] = *walk;
+
+	ddt_enter(ddt);
+
+	if ((a = avl_find(at, &search, &where)) == NULL)
+		a = avl_nearest(at, where, AVL_AFTER);
+	if ((f = avl_find(ft, &search, &where)) == NULL)
+		f = avl_nearest(ft, where, AVL_AFTER);
+
+	while (a != NULL || f != NULL) {
+		int cmp = (a == NULL) ? 1 : (f == NULL) ? -1 :
+		    ddt_log_entry_compare(a, f);
+
+		if (cmp <= 0) {
+			ddle = a;
+			a = AVL_NEXT(at, a);
+			if (cmp == 0)
+				f = AVL_NEXT(ft, f);	/* superseded */
+		} else {
+			ddle = f;
+			f = AVL_NEXT(ft, f);
+		}
+
+		if (ddle->ddle_type == DDT_TYPES || ddle->ddle_class != class)
+			continue;
+
+		dde->dde_key = ddle->ddle_key;
+		bcopy(ddle->ddle_phys, dde->dde_phys, sizeof (dde->dde_phys));
+		dde->dde_type = ddle->ddle_type;
+		dde->dde_class = ddle->ddle_class;
+		*walk = ddle->ddle_key.ddk_cksum.zc_word[0] + 1;
+		error = 0;
+		break;
+	}
+
+	ddt_exit(ddt);
+
+	return (error);
+}
+
+static void
+ddt_log_replay_record(ddt_log_t *ddl, const ddt_log_record_t *ddlr)
+{
+	ddt_log_entry_t search, *ddle;
+	avl_index_t where;
+
+	search.ddle_key = ddlr->ddlr_key;
+	ddle = avl_find(&ddl->ddl_tree, &search, &where);
+	if (ddle == NULL) {
+		ddle = kmem_zalloc(sizeof (*ddle), KM_SLEEP);
+		ddle->ddle_key = ddlr->ddlr_key;
+		avl_insert(&ddl->ddl_tree, ddle, where);
+	}
+
+	bcopy(ddlr->ddlr_phys, ddle->ddle_phys, sizeof (ddle->ddle_phys));
+	ddle->ddle_type = DDLR_GET_TYPE(ddlr);
+	ddle->ddle_class = DDLR_GET_CLASS(ddlr);
+	ddle->ddle_zap_type = DDLR_GET_ZAP_TYPE(ddlr);
+	ddle->ddle_zap_class = DDLR_GET_ZAP_CLASS(ddlr);
+}
+
+/*
+ * Rebuild a log's tree from its records, skipping those at or before
+ * the cursor, which have already been flushed.
+ */
+static int
+ddt_log_replay(ddt_t *ddt, ddt_log_t *ddl, const ddt_key_t *cursor)
+{
+	ddt_log_record_t *buf;
+	int error = 0;
+
+	buf = kmem_alloc(DDT_LOG_BUFSIZE, KM_SLEEP);
+
+	for (uint64_t off = 0; off < ddl->ddl_length; off += DDT_LOG_BUFSIZE) {
+		uint64_t size = MIN(DDT_LOG_BUFSIZE, ddl->ddl_length - off);
+
+		error = dmu_read(ddt->ddt_os, ddl->ddl_object, off, size,
+		    buf, DMU_READ_PREFETCH);
+		if (error != 0)
+			break;
+
+		for (int i = 0; i < size / sizeof (ddt_log_record_t); i++) {
+			if (cursor != NULL &&
+			    ddt_key_compare(&buf[i].ddlr_key, cursor) <= 0)
+				continue;
+			ddt_log_replay_record(ddl, &buf[i]);
+		}
+	}
+
+	kmem_free(buf, DDT_LOG_BUFSIZE);
+
+	return (error);
+}
+
+static int
+ddt_log_load(ddt_t *ddt)
+{
+	ddt_log_phys_t ddlp;
+	ddt_log_entry_t *ddle;
+	avl_tree_t *at, *ft;
+	char name[DDT_NAMELEN];
+	int error;
+
+	ddt_log_name(ddt, name);
+	error = zap_lookup(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), sizeof (ddlp) / sizeof (uint64_t), &ddlp);
+	if (error != 0)
+		return (error);
+
+	for (int i = 0; i < 2; i++) {
+		ddt->ddt_log[i].ddl_object = ddlp.ddlp_object[i];
+		ddt->ddt_log[i].ddl_length = ddlp.ddlp_length[i];
+		ddt->ddt_log[i].ddl_first_txg = ddlp.ddlp_first_txg[i];
+	}
+	ddt->ddt_log_active = &ddt->ddt_log[ddlp.ddlp_active != 0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[ddlp.ddlp_active == 0];
+	ddt->ddt_log_flushed = (ddlp.ddlp_flushed != 0);
+	ddt->ddt_log_cursor = ddlp.ddlp_cursor;
+
+	error = ddt_log_replay(ddt, ddt->ddt_log_flushing,
+	    ddt->ddt_log_flushed ? &ddt->ddt_log_cursor : NULL);
+	if (error == 0)
+		error = ddt_log_replay(ddt, ddt->ddt_log_active, NULL);
+	if (error != 0)
+		return (error);
+
+	at = &ddt->ddt_log_active->ddl_tree;
+	ft = &ddt->ddt_log_flushing->ddl_tree;
+	for (ddle = avl_first(at); ddle != NULL; ddle = AVL_NEXT(at, ddle))
+		ddt_log_count_update(ddt, ddle, 1);
+	for (ddle = avl_first(ft); ddle != NULL; ddle = AVL_NEXT(ft, ddle)) {
+		if (avl_find(at, ddle, NULL) == NULL)
+			ddt_log_count_update(ddt, ddle, 1);
+	}
+
+	ddt->ddt_log_flush_rate = MAX(zfs_dedup_log_flush_entries_min,
+	    avl_numnodes(ft) / MAX(zfs_dedup_log_flush_txgs, 1));
+
+	return (0);
+}
+
+static void
+ddt_log_free(ddt_log_t *ddl)
+{
+	ddt_log_entry_t *ddle;
+	void *cookie = NULL;
+
+	while ((ddle = avl_destroy_nodes(&ddl->ddl_tree, &cookie)) != NULL)
+		kmem_free(ddle, sizeof (*ddle));
+	avl_destroy(&ddl->ddl_tree);
+}
+
 ddt_entry_t *
 ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 {
 	ddt_entry_t *dde, dde_search;
+	ddt_log_entry_t *ddle;
 	enum ddt_type type;
 	enum ddt_class class;
 	avl_index_t where;
@@ -695,6 +1265,21 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 	if (dde->dde_loaded)
 		return (dde);
 
+	/*
+	 * A logged entry is newer than anything in the ZAP objects.
+	 */
+	if ((ddle = ddt_log_find(ddt, &dde->dde_key)) != NULL) {
+		dde->dde_type = ddle->ddle_type;
+		dde->dde_class = ddle->ddle_class;
+		dde->dde_loaded = B_TRUE;
+		if (dde->dde_type != DDT_TYPES) {
+			bcopy(ddle->ddle_phys, dde->dde_phys,
+			    sizeof (dde->dde_phys));
+			ddt_stat_update(ddt, dde, -1ULL);
+		}
+		return (dde);
+	}
+
 	dde->dde_loading = B_TRUE;
 
 	ddt_exit(ddt);
@@ -760,17 +1345,8 @@ ddt_entry_compare(const void *x1, const void *x2)
 {
 	const ddt_entry_t *dde1 = x1;
 	const ddt_entry_t *dde2 = x2;
-	const uint64_t *u1 = (const uint64_t *)&dde1->dde_key;
-	const uint64_t *u2 = (const uint64_t *)&dde2->dde_key;
-
-	for (int i = 0; i < DDT_KEY_WORDS; i++) {
-		if (u1[i] < u2[i])
-			return (-1);
-		if (u1[i] > u2[i])
-			return (1);
-	}
 
-	return (0);
+	return (ddt_key_compare(&dde1->dde_key, &dde2->dde_key));
 }
 
 static ddt_t *
@@ -785,6 +1361,13 @@ ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 	    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
 	avl_create(&ddt->ddt_repair_tree, ddt_entry_compare,
 	    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
+	for (int i = 0; i < 2; i++) {
+		avl_create(&ddt->ddt_log[i].ddl_tree, ddt_log_entry_compare,
+		    sizeof (ddt_log_entry_t),
+		    offsetof(ddt_log_entry_t, ddle_node));
+	}
+	ddt->ddt_log_active = &ddt->ddt_log[0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[1];
 	ddt->ddt_checksum = c;
 	ddt->ddt_spa = spa;
 	ddt->ddt_os = spa->spa_meta_objset;
@@ -799,6 +1382,8 @@ ddt_table_free(ddt_t *ddt)
 	ASSERT(avl_numnodes(&ddt->ddt_repair_tree) == 0);
 	avl_destroy(&ddt->ddt_tree);
 	avl_destroy(&ddt->ddt_repair_tree);
+	for (int i = 0; i < 2; i++)
+		ddt_log_free(&ddt->ddt_log[i]);
 	mutex_destroy(&ddt->ddt_lock);
 	kmem_free(ddt, sizeof (*ddt));
 }
@@ -837,6 +1422,18 @@ ddt_load(spa_t *spa)
 			}
 		}
 
+		error = ddt_log_load(ddt);
+		if (error != 0 && error != ENOENT)
+			return (error);
+
+		for (enum ddt_type type = 0; type < DDT_TYPES; type++) {
+			for (enum ddt_class class = 0; class < DDT_CLASSES;
+			    class++) {
+				ddt->ddt_object_stats[type][class].ddo_count +=
+				    ddt->ddt_log_count[type][class];
+			}
+		}
+
 		/*
 		 * Seed the cached histograms.
 		 */
@@ -863,6 +1460,7 @@ ddt_class_contains(spa_t *spa, enum ddt_class max_class, const blkptr_t *bp)
 {
 	ddt_t *ddt;
 	ddt_entry_t dde;
+	ddt_log_entry_t *ddle;
 
 	if (!BP_GET_DEDUP(bp))
 		return (B_FALSE);
@@ -874,6 +1472,17 @@ ddt_class_contains(spa_t *spa, enum ddt_class max_class, const blkptr_t *bp)
 
 	ddt_key_fill(&dde.dde_key, bp);
 
+	if (ddt_log_exists(ddt)) {
+		ddt_enter(ddt);
+		if ((ddle = ddt_log_find(ddt, &dde.dde_key)) != NULL) {
+			boolean_t found = (ddle->ddle_type != DDT_TYPES &&
+			    ddle->ddle_class <= max_class);
+			ddt_exit(ddt);
+			return (found);
+		}
+		ddt_exit(ddt);
+	}
+
 	for (enum ddt_type type = 0; type < DDT_TYPES; type++)
 		for (enum ddt_class class = 0; class <= max_class; class++)
 			if (ddt_object_lookup(ddt, type, class, &dde) == 0)
@@ -887,11 +1496,26 @@ ddt_repair_start(ddt_t *ddt, const blkptr_t *bp)
 {
 	ddt_key_t ddk;
 	ddt_entry_t *dde;
+	ddt_log_entry_t *ddle;
 
 	ddt_key_fill(&ddk, bp);
 
 	dde = ddt_alloc(&ddk);
 
+	if (ddt_log_exists(ddt)) {
+		ddt_enter(ddt);
+		if ((ddle = ddt_log_find(ddt, &ddk)) != NULL) {
+			if (ddle->ddle_type != DDT_TYPES &&
+			    ddle->ddle_class != DDT_CLASS_UNIQUE) {
+				bcopy(ddle->ddle_phys, dde->dde_phys,
+				    sizeof (dde->dde_phys));
+			}
+			ddt_exit(ddt);
+			return (dde);
+		}
+		ddt_exit(ddt);
+	}
+
 	for (enum ddt_type type = 0; type < DDT_TYPES; type++) {
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
 			/*
@@ -1025,7 +1649,10 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 	else
 		nclass = DDT_CLASS_UNIQUE;
 
-	if (otype != DDT_TYPES &&
+	if (ddt_log_exists(ddt)) {
+		ddt_log_append(ddt, dde, total_refcnt != 0 ? ntype : DDT_TYPES,
+		    total_refcnt != 0 ? nclass : DDT_CLASSES, tx);
+	} else if (otype != DDT_TYPES &&
 	    (otype != ntype || oclass != nclass || total_refcnt == 0)) {
 		VERIFY(ddt_object_remove(ddt, otype, oclass, dde, tx) == 0);
 		ASSERT(ddt_object_lookup(ddt, otype, oclass, dde) == ENOENT);
@@ -1035,9 +1662,16 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 		dde->dde_type = ntype;
 		dde->dde_class = nclass;
 		ddt_stat_update(ddt, dde, 0);
+		/*
+		 * The object is created even if the entry is only logged
+		 * for now, since it holds the class's histogram.
+		 */
 		if (!ddt_object_exists(ddt, ntype, nclass))
 			ddt_object_create(ddt, ntype, nclass, tx);
-		VERIFY(ddt_object_update(ddt, ntype, nclass, dde, tx) == 0);
+		if (!ddt_log_exists(ddt)) {
+			VERIFY(ddt_object_update(ddt, ntype, nclass,
+			    dde, tx) == 0);
+		}
 
 		/*
 		 * If the class changes, the order that we scan this bp
@@ -1059,8 +1693,10 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 	spa_t *spa = ddt->ddt_spa;
 	ddt_entry_t *dde;
 	void *cookie = NULL;
+	boolean_t flush = ddt_log_want_flush(ddt, txg);
+	boolean_t empty = B_TRUE;
 
-	if (avl_numnodes(&ddt->ddt_tree) == 0)
+	if (avl_numnodes(&ddt->ddt_tree) == 0 && !flush)
 		return;
 
 	ASSERT(spa->spa_uberblock.ub_version >= SPA_VERSION_DEDUP);
@@ -1071,11 +1707,27 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 		    DMU_POOL_DDT_STATS, tx);
 	}
 
+	if (!ddt_log_exists(ddt) && zfs_dedup_log_enabled &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_DDT_LOG))
+		ddt_log_create(ddt, tx);
+
+	if (ddt_log_exists(ddt))
+		ddt->ddt_log_buf = kmem_alloc(DDT_LOG_BUFSIZE, KM_SLEEP);
+
 	while ((dde = avl_destroy_nodes(&ddt->ddt_tree, &cookie)) != NULL) {
 		ddt_sync_entry(ddt, dde, tx, txg);
 		ddt_free(dde);
 	}
 
+	if (ddt_log_exists(ddt)) {
+		ddt_log_write(ddt, tx);
+		kmem_free(ddt->ddt_log_buf, DDT_LOG_BUFSIZE);
+		ddt->ddt_log_buf = NULL;
+		if (flush)
+			ddt_log_flush(ddt, tx);
+		ddt_log_sync_phys(ddt, tx);
+	}
+
 	for (enum ddt_type type = 0; type < DDT_TYPES; type++) {
 		uint64_t count = 0;
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
@@ -1084,12 +1736,23 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 				count += ddt_object_count(ddt, type, class);
 			}
 		}
+		/*
+		 * Objects holding logged entries' histograms must stay
+		 * until the logs have been flushed.
+		 */
+		if (count != 0 || !ddt_log_empty(ddt)) {
+			empty = B_FALSE;
+			continue;
+		}
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
-			if (count == 0 && ddt_object_exists(ddt, type, class))
+			if (ddt_object_exists(ddt, type, class))
 				ddt_object_destroy(ddt, type, class, tx);
 		}
 	}
 
+	if (empty && ddt_log_exists(ddt))
+		ddt_log_destroy(ddt, tx);
+
 	bcopy(ddt->ddt_histogram, &ddt->ddt_histogram_cache,
 	    sizeof (ddt->ddt_histogram));
 }
@@ -1126,14 +1789,28 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 			do {
 				ddt_t *ddt = spa->spa_ddt[ddb->ddb_checksum];
 				int error = ENOENT;
-				if (ddt_object_exists(ddt, ddb->ddb_type,
-				    ddb->ddb_class)) {
-					error = ddt_object_walk(ddt,
-					    ddb->ddb_type, ddb->ddb_class,
-					    &ddb->ddb_cursor, dde);
+				if (ddb->ddb_type == DDT_TYPES) {
+					/*
+					 * After the ZAP objects of a class,
+					 * walk the logged entries of that
+					 * class; the ZAP walk skips them.
+					 */
+					error = ddt_log_walk(ddt,
+					    ddb->ddb_class, &ddb->ddb_cursor,
+					    dde);
+				} else if (ddt_object_exists(ddt,
+				    ddb->ddb_type, ddb->ddb_class)) {
+					do {
+						error = ddt_object_walk(ddt,
+						    ddb->ddb_type,
+						    ddb->ddb_class,
+						    &ddb->ddb_cursor, dde);
+					} while (error == 0 &&
+					    ddt_log_contains(ddt,
+					    &dde->dde_key));
+					dde->dde_type = ddb->ddb_type;
+					dde->dde_class = ddb->ddb_class;
 				}
-				dde->dde_type = ddb->ddb_type;
-				dde->dde_class = ddb->ddb_class;
 				if (error == 0)
 					return (0);
 				if (error != ENOENT)
@@ -1141,7 +1818,7 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 				ddb->ddb_cursor = 0;
 			} while (++ddb->ddb_checksum < ZIO_CHECKSUM_FUNCTIONS);
 			ddb->ddb_checksum = 0;
-		} while (++ddb->ddb_type < DDT_TYPES);
+		} while (++ddb->ddb_type <= DDT_TYPES);
 		ddb->ddb_type = 0;
 	} while (++ddb->ddb_class < DDT_CLASSES);
 
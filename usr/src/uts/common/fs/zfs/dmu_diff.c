@@ -40,27 +40,78 @@
 #include <sys/zio_checksum.h>
 #include <sys/zfs_znode.h>
 
+/*
+ * The meta-dnode of the "to" snapshot is split into up to zfs_diff_ranges
+ * object ranges, each traversed by its own thread.  Records must still
+ * reach the pipe in object order and from the ioctl's own thread, so
+ * that thread does the first range itself and then drains the others in
+ * turn; each of those buffers up to zfs_diff_range_buffer bytes of
+ * records and waits for the buffer to be drained when it fills.
+ */
+int zfs_diff_ranges = 8;
+int zfs_diff_range_buffer = 256 * 1024;
+
+struct diffstate {
+	kmutex_t dst_lock;
+	kcondvar_t dst_cv;
+	struct vnode *dst_vp;		/* file to which we are reporting */
+	offset_t *dst_offp;
+	dsl_dataset_t *dst_tosnap;
+	uint64_t dst_fromtxg;
+	int dst_flags;			/* for traverse_dataset() */
+	int dst_err;			/* error that stopped diff search */
+};
+
 struct diffarg {
-	struct vnode *da_vp;		/* file to which we are reporting */
-	offset_t *da_offp;
-	int da_err;			/* error that stopped diff search */
+	struct diffstate *da_state;
+	uint64_t da_first;		/* objects in this range */
+	uint64_t da_last;
+	int da_err;
 	dmu_diff_record_t da_ddr;
+	dmu_diff_record_t *da_buf;	/* NULL for the ioctl's own range */
+	int da_nbuf;
+	int da_maxbuf;
+	boolean_t da_done;
 };
 
 static int
-write_record(struct diffarg *da)
+write_records(struct diffstate *dst, dmu_diff_record_t *ddr, int n)
 {
 	ssize_t resid; /* have to get resid to get detailed errno */
+	int err;
+
+	err = vn_rdwr(UIO_WRITE, dst->dst_vp, (caddr_t)ddr,
+	    n * sizeof (*ddr), 0, UIO_SYSSPACE, FAPPEND,
+	    RLIM64_INFINITY, CRED(), &resid);
+	*dst->dst_offp += n * sizeof (*ddr);
+	return (err);
+}
+
+static int
+write_record(struct diffarg *da)
+{
+	struct diffstate *dst = da->da_state;
 
 	if (da->da_ddr.ddr_type == DDR_NONE) {
 		da->da_err = 0;
 		return (0);
 	}
 
-	da->da_err = vn_rdwr(UIO_WRITE, da->da_vp, (caddr_t)&da->da_ddr,
-	    sizeof (da->da_ddr), 0, UIO_SYSSPACE, FAPPEND,
-	    RLIM64_INFINITY, CRED(), &resid);
-	*da->da_offp += sizeof (da->da_ddr);
+	if (da->da_buf == NULL) {
+		da->da_err = write_records(dst, &da->da_ddr, 1);
+		return (da->da_err);
+	}
+
+	mutex_enter(&dst->dst_lock);
+	while (da->da_nbuf == da->da_maxbuf && dst->dst_err == 0)
+		cv_wait(&dst->dst_cv, &dst->dst_lock);
+	da->da_err = dst->dst_err;
+	if (da->da_err == 0) {
+		da->da_buf[da->da_nbuf++] = da->da_ddr;
+		if (da->da_nbuf == da->da_maxbuf)
+			cv_broadcast(&dst->dst_cv);
+	}
+	mutex_exit(&dst->dst_lock);
 	return (da->da_err);
 }
 
@@ -100,30 +151,44 @@ report_dnode(struct diffarg *da, uint64_t object, dnode_phys_t *dnp)
 	return (0);
 }
 
-#define	DBP_SPAN(dnp, level)				  \
-	(((uint64_t)dnp->dn_datablkszsec) << (SPA_MINBLOCKSHIFT + \
-	(level) * (dnp->dn_indblkshift - SPA_BLKPTRSHIFT)))
-
 /* ARGSUSED */
 static int
 diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
 {
 	struct diffarg *da = arg;
+	uint64_t first, last;
+	int shift;
 	int err = 0;
 
-	if (issig(JUSTLOOKING) && issig(FORREAL))
+	/* Only the ioctl's own thread can see its signals. */
+	if (da->da_buf == NULL && issig(JUSTLOOKING) && issig(FORREAL))
 		return (SET_ERROR(EINTR));
+	if (da->da_state->dst_err != 0)
+		return (da->da_state->dst_err);
 
 	if (bp == NULL || zb->zb_object != DMU_META_DNODE_OBJECT)
 		return (0);
 
-	if (BP_IS_HOLE(bp)) {
-		uint64_t span = DBP_SPAN(dnp, zb->zb_level);
-		uint64_t dnobj = (zb->zb_blkid * span) >> DNODE_SHIFT;
+	/*
+	 * Work out which objects this block covers, and skip it if none
+	 * of them are in our range.
+	 */
+	shift = DNODE_BLOCK_SHIFT - DNODE_SHIFT +
+	    zb->zb_level * (dnp->dn_indblkshift - SPA_BLKPTRSHIFT);
+	if (shift < 64) {
+		first = zb->zb_blkid << shift;
+		last = first + (1ULL << shift) - 1;
+		if (last < da->da_first || first > da->da_last)
+			return (TRAVERSE_VISIT_NO_CHILDREN);
+	} else {
+		first = 0;
+		last = UINT64_MAX;
+	}
 
-		err = report_free_dnode_range(da, dnobj,
-		    dnobj + (span >> DNODE_SHIFT) - 1);
+	if (BP_IS_HOLE(bp)) {
+		err = report_free_dnode_range(da, MAX(first, da->da_first),
+		    MIN(last, da->da_last));
 		if (err)
 			return (err);
 	} else if (zb->zb_level == 0) {
@@ -139,7 +204,8 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 			return (SET_ERROR(EIO));
 
 		blk = abuf->b_data;
-		for (i = 0; i < blksz >> DNODE_SHIFT; i++) {
+		for (i = 0; i < blksz >> DNODE_SHIFT;
+		    i += blk[i].dn_extra_slots + 1) {
 			uint64_t dnobj = (zb->zb_blkid <<
 			    (DNODE_BLOCK_SHIFT - DNODE_SHIFT)) + i;
 			err = report_dnode(da, dnobj, blk+i);
@@ -155,11 +221,81 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	return (0);
 }
 
+static int
+diff_range(struct diffarg *da)
+{
+	struct diffstate *dst = da->da_state;
+	int err;
+
+	err = traverse_dataset(dst->dst_tosnap, dst->dst_fromtxg,
+	    dst->dst_flags, diff_cb, da);
+	if (err == 0)
+		err = write_record(da);
+	return (err);
+}
+
+static void
+diff_range_task(void *arg)
+{
+	struct diffarg *da = arg;
+	struct diffstate *dst = da->da_state;
+	int err;
+
+	err = diff_range(da);
+
+	mutex_enter(&dst->dst_lock);
+	if (dst->dst_err == 0)
+		dst->dst_err = err;
+	da->da_done = B_TRUE;
+	cv_broadcast(&dst->dst_cv);
+	mutex_exit(&dst->dst_lock);
+}
+
+/*
+ * Write out a range's records as its buffer fills, until it is done.
+ */
+static int
+diff_drain(struct diffarg *da)
+{
+	struct diffstate *dst = da->da_state;
+	boolean_t done;
+	int err;
+
+	do {
+		mutex_enter(&dst->dst_lock);
+		while (da->da_nbuf < da->da_maxbuf && !da->da_done &&
+		    dst->dst_err == 0) {
+			if (cv_wait_sig(&dst->dst_cv, &dst->dst_lock) == 0)
+				dst->dst_err = SET_ERROR(EINTR);
+		}
+		err = dst->dst_err;
+		done = da->da_done;
+		mutex_exit(&dst->dst_lock);
+		if (err != 0)
+			return (err);
+
+		/* the range is blocked or finished; the buffer is ours */
+		err = write_records(dst, da->da_buf, da->da_nbuf);
+
+		mutex_enter(&dst->dst_lock);
+		da->da_nbuf = 0;
+		cv_broadcast(&dst->dst_cv);
+		mutex_exit(&dst->dst_lock);
+	} while (err == 0 && !done);
+
+	return (err);
+}
+
 int
 dmu_diff(const char *tosnap_name, const char *fromsnap_name,
     struct vnode *vp, offset_t *offp)
 {
-	struct diffarg da;
+	struct diffstate dst;
+	struct diffarg *das;
+	taskq_t *tq = NULL;
+	objset_t *os;
+	uint64_t nblks;
+	int nranges;
 	dsl_dataset_t *fromsnap;
 	dsl_dataset_t *tosnap;
 	dsl_pool_t *dp;
@@ -200,24 +336,91 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	dsl_dataset_long_hold(tosnap, FTAG);
 	dsl_pool_rele(dp, FTAG);
 
-	da.da_vp = vp;
-	da.da_offp = offp;
-	da.da_ddr.ddr_type = DDR_NONE;
-	da.da_ddr.ddr_first = da.da_ddr.ddr_last = 0;
-	da.da_err = 0;
+	error = dmu_objset_from_ds(tosnap, &os);
+	if (error != 0) {
+		dsl_dataset_long_rele(tosnap, FTAG);
+		dsl_dataset_rele(tosnap, FTAG);
+		return (error);
+	}
 
-	error = traverse_dataset(tosnap, fromtxg,
-	    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA, diff_cb, &da);
+	/*
+	 * Ranges are whole meta-dnode blocks; the last one runs to the end
+	 * of the object space so that it picks up any trailing holes.
+	 */
+	nblks = DMU_META_DNODE(os)->dn_maxblkid + 1;
+	nranges = (int)MIN(MAX(zfs_diff_ranges, 1), nblks);
 
-	if (error != 0) {
-		da.da_err = error;
-	} else {
-		/* we set the da.da_err we return as side-effect */
-		(void) write_record(&da);
+	mutex_init(&dst.dst_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&dst.dst_cv, NULL, CV_DEFAULT, NULL);
+	dst.dst_vp = vp;
+	dst.dst_offp = offp;
+	dst.dst_tosnap = tosnap;
+	dst.dst_fromtxg = fromtxg;
+	dst.dst_flags = TRAVERSE_PRE;
+	dst.dst_err = 0;
+
+	/*
+	 * A single range gets the prefetch thread; with several, the range
+	 * threads keep enough reads in flight, and each prefetcher would
+	 * walk the whole dataset.
+	 */
+	if (nranges == 1)
+		dst.dst_flags |= TRAVERSE_PREFETCH_METADATA;
+
+	das = kmem_zalloc(nranges * sizeof (struct diffarg), KM_SLEEP);
+	for (int i = 0; i < nranges; i++) {
+		struct diffarg *da = &das[i];
+
+		da->da_state = &dst;
+		da->da_first = (nblks * i / nranges) <<
+		    (DNODE_BLOCK_SHIFT - DNODE_SHIFT);
+		if (i == nranges - 1) {
+			da->da_last = UINT64_MAX;
+		} else {
+			da->da_last = ((nblks * (i + 1) / nranges) <<
+			    (DNODE_BLOCK_SHIFT - DNODE_SHIFT)) - 1;
+		}
+		da->da_ddr.ddr_type = DDR_NONE;
+		if (i != 0) {
+			da->da_maxbuf = MAX(zfs_diff_range_buffer /
+			    (int)sizeof (dmu_diff_record_t), 1);
+			da->da_buf = kmem_alloc(da->da_maxbuf *
+			    sizeof (dmu_diff_record_t), KM_SLEEP);
+		}
+	}
+
+	if (nranges > 1) {
+		tq = taskq_create("dmu_diff", nranges - 1, minclsyspri,
+		    nranges - 1, nranges - 1, TASKQ_PREPOPULATE);
+		for (int i = 1; i < nranges; i++) {
+			(void) taskq_dispatch(tq, diff_range_task, &das[i],
+			    TQ_SLEEP);
+		}
+	}
+
+	error = diff_range(&das[0]);
+	for (int i = 1; i < nranges && error == 0; i++)
+		error = diff_drain(&das[i]);
+
+	if (tq != NULL) {
+		/* stop any ranges still running, and wait for them */
+		mutex_enter(&dst.dst_lock);
+		if (dst.dst_err == 0)
+			dst.dst_err = error;
+		cv_broadcast(&dst.dst_cv);
+		mutex_exit(&dst.dst_lock);
+		taskq_destroy(tq);
+	}
+	for (int i = 1; i < nranges; i++) {
+		kmem_free(das[i].da_buf,
+		    das[i].da_maxbuf * sizeof (dmu_diff_record_t));
 	}
+	kmem_free(das, nranges * sizeof (struct diffarg));
+	cv_destroy(&dst.dst_cv);
+	mutex_destroy(&dst.dst_lock);
 
 	dsl_dataset_long_rele(tosnap, FTAG);
 	dsl_dataset_rele(tosnap, FTAG);
 
-	return (da.da_err);
+	return (error);
 }
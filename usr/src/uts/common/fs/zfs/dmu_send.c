@@ -44,6 +44,7 @@
 #include <sys/zfs_ioctl.h>
 #include <sys/zap.h>
 #include <sys/zio_checksum.h>
+#include <sys/zio_compress.h>
 #include <sys/zfs_znode.h>
 #include <zfs_fletcher.h>
 #include <sys/avl.h>
@@ -60,6 +61,14 @@
 int zfs_send_corrupt_data = B_FALSE;
 int zfs_send_queue_length = 16 * 1024 * 1024;
 int zfs_recv_queue_length = 16 * 1024 * 1024;
+/*
+ * Number of threads that apply the records of a non-resumable receive.
+ * Records that affect a single object are spread across these threads by
+ * object number, so each object's records are still applied in stream
+ * order; records that span objects wait for all of them to drain.  Set to
+ * 1 to apply every record in the writer thread.
+ */
+int zfs_recv_writer_threads = 4;
 /* Set this tunable to FALSE to disable setting of DRR_FLAG_FREERECORDS */
 int zfs_send_set_freerecords_bit = B_TRUE;
 
@@ -248,8 +257,8 @@ dump_free(dmu_sendarg_t *dsp, uint64_t object, uint64_t offset,
 }
 
 static int
-dump_write(dmu_sendarg_t *dsp, dmu_object_type_t type,
-    uint64_t object, uint64_t offset, int blksz, const blkptr_t *bp, void *data)
+dump_write(dmu_sendarg_t *dsp, dmu_object_type_t type, uint64_t object,
+    uint64_t offset, int blksz, uint64_t psize, const blkptr_t *bp, void *data)
 {
 	struct drr_write *drrw = &(dsp->dsa_drr->drr_u.drr_write);
 
@@ -301,7 +310,19 @@ dump_write(dmu_sendarg_t *dsp, dmu_object_type_t type,
 		drrw->drr_key.ddk_cksum = bp->blk_cksum;
 	}
 
-	if (dump_record(dsp, data, blksz) != 0)
+	/*
+	 * If psize differs from the logical size, data is the block as it
+	 * is stored on disk; see backup_do_compressed().
+	 */
+	if (psize != blksz) {
+		ASSERT(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_COMPRESSED);
+		ASSERT(bp != NULL && !BP_IS_EMBEDDED(bp));
+		ASSERT3U(psize, ==, BP_GET_PSIZE(bp));
+		drrw->drr_compressiontype = BP_GET_COMPRESS(bp);
+		drrw->drr_compressed_size = psize;
+	}
+
+	if (dump_record(dsp, data, psize) != 0)
 		return (SET_ERROR(EINTR));
 	return (0);
 }
@@ -446,6 +467,7 @@ dump_dnode(dmu_sendarg_t *dsp, uint64_t object, dnode_phys_t *dnp)
 	drro->drr_bonuslen = dnp->dn_bonuslen;
 	drro->drr_checksumtype = dnp->dn_checksum;
 	drro->drr_compress = dnp->dn_compress;
+	drro->drr_dn_slots = dnp->dn_extra_slots + 1;
 	drro->drr_toguid = dsp->dsa_toguid;
 
 	if (!(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_LARGE_BLOCKS) &&
@@ -493,6 +515,42 @@ backup_do_embed(dmu_sendarg_t *dsp, const blkptr_t *bp)
 	return (B_FALSE);
 }
 
+/*
+ * Can this level-0 block be sent exactly as it is stored on disk?
+ */
+static boolean_t
+backup_do_compressed(dmu_sendarg_t *dsp, const blkptr_t *bp, int blksz)
+{
+	if (!(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_COMPRESSED) ||
+	    BP_IS_EMBEDDED(bp) || BP_GET_COMPRESS(bp) == ZIO_COMPRESS_OFF)
+		return (B_FALSE);
+
+	/*
+	 * The receiver byteswaps data that came from a foreign-endian
+	 * machine, which it can't do without decompressing it; so only
+	 * send byte arrays (i.e. file and zvol contents) compressed.
+	 */
+	if (DMU_OT_BYTESWAP(BP_GET_TYPE(bp)) != DMU_BSWAP_UINT8)
+		return (B_FALSE);
+
+	/*
+	 * Large blocks must be split up if the stream doesn't permit them,
+	 * which requires their uncompressed contents.
+	 */
+	if (BP_GET_LSIZE(bp) != blksz || (blksz > SPA_OLD_MAXBLOCKSIZE &&
+	    !(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_LARGE_BLOCKS)))
+		return (B_FALSE);
+
+	/*
+	 * Compression function must be legacy, or explicitly enabled.
+	 */
+	if (BP_GET_COMPRESS(bp) >= ZIO_COMPRESS_LEGACY_FUNCTIONS &&
+	    !(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_LZ4))
+		return (B_FALSE);
+
+	return (B_TRUE);
+}
+
 /*
  * This is the callback function to traverse_dataset that acts as the worker
  * thread for dmu_send_impl.
@@ -608,7 +666,8 @@ do_dump(dmu_sendarg_t *dsa, struct send_block_record *data)
 
 		dnode_phys_t *blk = abuf->b_data;
 		uint64_t dnobj = zb->zb_blkid * (blksz >> DNODE_SHIFT);
-		for (int i = 0; i < blksz >> DNODE_SHIFT; i++) {
+		for (int i = 0; i < blksz >> DNODE_SHIFT;
+		    i += blk[i].dn_extra_slots + 1) {
 			err = dump_dnode(dsa, dnobj + i, blk + i);
 			if (err != 0)
 				break;
@@ -644,6 +703,31 @@ do_dump(dmu_sendarg_t *dsa, struct send_block_record *data)
 		    (zb->zb_object == dsa->dsa_resume_object &&
 		    zb->zb_blkid * blksz >= dsa->dsa_resume_offset));
 
+		offset = zb->zb_blkid * blksz;
+
+		if (backup_do_compressed(dsa, bp, blksz)) {
+			uint64_t psize = BP_GET_PSIZE(bp);
+			void *buf = zio_data_buf_alloc(psize);
+
+			/*
+			 * Use the compressed copy in the ARC if there is one,
+			 * else read the block from disk without decompressing
+			 * it.  If that fails, fall back to the regular path
+			 * below, which knows how to deal with damaged blocks.
+			 */
+			if (arc_copy_pdata(spa, bp, buf) ||
+			    zio_wait(zio_read(NULL, spa, bp, buf, psize,
+			    NULL, NULL, ZIO_PRIORITY_ASYNC_READ,
+			    ZIO_FLAG_CANFAIL | ZIO_FLAG_RAW, zb)) == 0) {
+				err = dump_write(dsa, type, zb->zb_object,
+				    offset, blksz, psize, bp, buf);
+				zio_data_buf_free(buf, psize);
+				ASSERT(err == 0 || err == EINTR);
+				return (err);
+			}
+			zio_data_buf_free(buf, psize);
+		}
+
 		if (arc_read(NULL, spa, bp, arc_getbuf_func, &abuf,
 		    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_CANFAIL,
 		    &aflags, zb) != 0) {
@@ -661,8 +745,6 @@ do_dump(dmu_sendarg_t *dsa, struct send_block_record *data)
 			}
 		}
 
-		offset = zb->zb_blkid * blksz;
-
 		if (!(dsa->dsa_featureflags &
 		    DMU_BACKUP_FEATURE_LARGE_BLOCKS) &&
 		    blksz > SPA_OLD_MAXBLOCKSIZE) {
@@ -670,14 +752,14 @@ do_dump(dmu_sendarg_t *dsa, struct send_block_record *data)
 			while (blksz > 0 && err == 0) {
 				int n = MIN(blksz, SPA_OLD_MAXBLOCKSIZE);
 				err = dump_write(dsa, type, zb->zb_object,
-				    offset, n, NULL, buf);
+				    offset, n, n, NULL, buf);
 				offset += n;
 				buf += n;
 				blksz -= n;
 			}
 		} else {
 			err = dump_write(dsa, type, zb->zb_object,
-			    offset, blksz, bp, abuf->b_data);
+			    offset, blksz, blksz, bp, abuf->b_data);
 		}
 		arc_buf_destroy(abuf, &abuf);
 	}
@@ -705,8 +787,8 @@ get_next_record(bqueue_t *bq, struct send_block_record *data)
 static int
 dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
     zfs_bookmark_phys_t *ancestor_zb,
-    boolean_t is_clone, boolean_t embedok, boolean_t large_block_ok, int outfd,
-    uint64_t resumeobj, uint64_t resumeoff,
+    boolean_t is_clone, boolean_t embedok, boolean_t large_block_ok,
+    boolean_t compressok, int outfd, uint64_t resumeobj, uint64_t resumeoff,
     vnode_t *vp, offset_t *off)
 {
 	objset_t *os;
@@ -745,12 +827,19 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 
 	if (large_block_ok && to_ds->ds_feature_inuse[SPA_FEATURE_LARGE_BLOCKS])
 		featureflags |= DMU_BACKUP_FEATURE_LARGE_BLOCKS;
+	if (to_ds->ds_feature_inuse[SPA_FEATURE_LARGE_DNODE])
+		featureflags |= DMU_BACKUP_FEATURE_LARGE_DNODE;
 	if (embedok &&
 	    spa_feature_is_active(dp->dp_spa, SPA_FEATURE_EMBEDDED_DATA)) {
 		featureflags |= DMU_BACKUP_FEATURE_EMBED_DATA;
 		if (spa_feature_is_active(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
 			featureflags |= DMU_BACKUP_FEATURE_EMBED_DATA_LZ4;
 	}
+	if (compressok) {
+		featureflags |= DMU_BACKUP_FEATURE_COMPRESSED;
+		if (spa_feature_is_active(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
+			featureflags |= DMU_BACKUP_FEATURE_LZ4;
+	}
 
 	if (resumeobj != 0 || resumeoff != 0) {
 		featureflags |= DMU_BACKUP_FEATURE_RESUMING;
@@ -898,7 +987,7 @@ out:
 
 int
 dmu_send_obj(const char *pool, uint64_t tosnap, uint64_t fromsnap,
-    boolean_t embedok, boolean_t large_block_ok,
+    boolean_t embedok, boolean_t large_block_ok, boolean_t compressok,
     int outfd, vnode_t *vp, offset_t *off)
 {
 	dsl_pool_t *dp;
@@ -935,10 +1024,10 @@ dmu_send_obj(const char *pool, uint64_t tosnap, uint64_t fromsnap,
 		is_clone = (fromds->ds_dir != ds->ds_dir);
 		dsl_dataset_rele(fromds, FTAG);
 		err = dmu_send_impl(FTAG, dp, ds, &zb, is_clone,
-		    embedok, large_block_ok, outfd, 0, 0, vp, off);
+		    embedok, large_block_ok, compressok, outfd, 0, 0, vp, off);
 	} else {
 		err = dmu_send_impl(FTAG, dp, ds, NULL, B_FALSE,
-		    embedok, large_block_ok, outfd, 0, 0, vp, off);
+		    embedok, large_block_ok, compressok, outfd, 0, 0, vp, off);
 	}
 	dsl_dataset_rele(ds, FTAG);
 	return (err);
@@ -946,8 +1035,8 @@ dmu_send_obj(const char *pool, uint64_t tosnap, uint64_t fromsnap,
 
 int
 dmu_send(const char *tosnap, const char *fromsnap, boolean_t embedok,
-    boolean_t large_block_ok, int outfd, uint64_t resumeobj, uint64_t resumeoff,
-    vnode_t *vp, offset_t *off)
+    boolean_t large_block_ok, boolean_t compressok, int outfd,
+    uint64_t resumeobj, uint64_t resumeoff, vnode_t *vp, offset_t *off)
 {
 	dsl_pool_t *dp;
 	dsl_dataset_t *ds;
@@ -1014,11 +1103,11 @@ dmu_send(const char *tosnap, const char *fromsnap, boolean_t embedok,
 			return (err);
 		}
 		err = dmu_send_impl(FTAG, dp, ds, &zb, is_clone,
-		    embedok, large_block_ok,
+		    embedok, large_block_ok, compressok,
 		    outfd, resumeobj, resumeoff, vp, off);
 	} else {
 		err = dmu_send_impl(FTAG, dp, ds, NULL, B_FALSE,
-		    embedok, large_block_ok,
+		    embedok, large_block_ok, compressok,
 		    outfd, resumeobj, resumeoff, vp, off);
 	}
 	if (owned)
@@ -1292,6 +1381,14 @@ dmu_recv_begin_check(void *arg, dmu_tx_t *tx)
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
 		return (SET_ERROR(ENOTSUP));
 
+	/*
+	 * Compressed WRITE records are written to disk as they are, so the
+	 * pool must support the compression functions that the stream uses.
+	 */
+	if ((featureflags & DMU_BACKUP_FEATURE_LZ4) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
+		return (SET_ERROR(ENOTSUP));
+
 	/*
 	 * The receiving code doesn't know how to translate large blocks
 	 * to smaller ones, so the pool must have the LARGE_BLOCKS
@@ -1300,6 +1397,9 @@ dmu_recv_begin_check(void *arg, dmu_tx_t *tx)
 	if ((featureflags & DMU_BACKUP_FEATURE_LARGE_BLOCKS) &&
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LARGE_BLOCKS))
 		return (SET_ERROR(ENOTSUP));
+	if ((featureflags & DMU_BACKUP_FEATURE_LARGE_DNODE) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LARGE_DNODE))
+		return (SET_ERROR(ENOTSUP));
 
 	error = dsl_dataset_hold(dp, tofs, FTAG, &ds);
 	if (error == 0) {
@@ -1462,6 +1562,11 @@ dmu_recv_begin_sync(void *arg, dmu_tx_t *tx)
 			VERIFY0(zap_add(mos, dsobj, DS_FIELD_RESUME_EMBEDOK,
 			    8, 1, &one, tx));
 		}
+		if (DMU_GET_FEATUREFLAGS(drrb->drr_versioninfo) &
+		    DMU_BACKUP_FEATURE_COMPRESSED) {
+			VERIFY0(zap_add(mos, dsobj, DS_FIELD_RESUME_COMPRESSOK,
+			    8, 1, &one, tx));
+		}
 	}
 
 	dmu_buf_will_dirty(newds->ds_dbuf, tx);
@@ -1519,6 +1624,17 @@ dmu_recv_resume_begin_check(void *arg, dmu_tx_t *tx)
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
 		return (SET_ERROR(ENOTSUP));
 
+	/*
+	 * Compressed WRITE records are written to disk as they are, so the
+	 * pool must support the compression functions that the stream uses.
+	 */
+	if ((featureflags & DMU_BACKUP_FEATURE_LZ4) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
+		return (SET_ERROR(ENOTSUP));
+	if ((featureflags & DMU_BACKUP_FEATURE_LARGE_DNODE) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LARGE_DNODE))
+		return (SET_ERROR(ENOTSUP));
+
 	/* 6 extra bytes for /%recv */
 	char recvname[ZFS_MAX_DATASET_NAME_LEN + 6];
 
@@ -1704,6 +1820,15 @@ struct receive_writer_arg {
 	boolean_t resumable;
 	uint64_t last_object, last_offset;
 	uint64_t bytes_read; /* bytes read when current record created */
+
+	/*
+	 * Per-object records are handed off to these, if there are any; see
+	 * zfs_recv_writer_threads.  Each worker has its own writer arg, with
+	 * "pending" (protected by its mutex) counting its queued records.
+	 */
+	struct receive_writer_arg *workers;
+	int nworkers;
+	uint64_t pending;
 };
 
 struct objlist {
@@ -1852,6 +1977,7 @@ byteswap_record(dmu_replay_record_t *drr)
 		DO64(drr_write.drr_toguid);
 		ZIO_CHECKSUM_BSWAP(&drr->drr_u.drr_write.drr_key.ddk_cksum);
 		DO64(drr_write.drr_key.ddk_prop);
+		DO64(drr_write.drr_compressed_size);
 		break;
 	case DRR_WRITE_BYREF:
 		DO64(drr_write_byref.drr_object);
@@ -1899,13 +2025,15 @@ byteswap_record(dmu_replay_record_t *drr)
 }
 
 static inline uint8_t
-deduce_nblkptr(dmu_object_type_t bonus_type, uint64_t bonus_size)
+deduce_nblkptr(dmu_object_type_t bonus_type, uint64_t bonus_size,
+    int dn_slots)
 {
 	if (bonus_type == DMU_OT_SA) {
 		return (1);
 	} else {
-		return (1 +
-		    ((DN_MAX_BONUSLEN - bonus_size) >> SPA_BLKPTRSHIFT));
+		return (MIN(DN_MAX_NBLKPTR, 1 +
+		    ((DN_SLOTS_TO_BONUSLEN(dn_slots) - bonus_size) >>
+		    SPA_BLKPTRSHIFT)));
 	}
 }
 
@@ -1953,6 +2081,9 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 	dmu_object_info_t doi;
 	dmu_tx_t *tx;
 	uint64_t object;
+	int dn_slots = drro->drr_dn_slots != 0 ?
+	    drro->drr_dn_slots : DNODE_MIN_SLOTS;
+	boolean_t waited = B_FALSE;
 	int err;
 
 	if (drro->drr_type == DMU_OT_NONE ||
@@ -1963,7 +2094,8 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 	    P2PHASE(drro->drr_blksz, SPA_MINBLOCKSIZE) ||
 	    drro->drr_blksz < SPA_MINBLOCKSIZE ||
 	    drro->drr_blksz > spa_maxblocksize(dmu_objset_spa(rwa->os)) ||
-	    drro->drr_bonuslen > DN_MAX_BONUSLEN) {
+	    dn_slots > DNODE_MAX_SLOTS ||
+	    drro->drr_bonuslen > DN_SLOTS_TO_BONUSLEN(dn_slots)) {
 		return (SET_ERROR(EINVAL));
 	}
 
@@ -1973,6 +2105,36 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 		return (SET_ERROR(EINVAL));
 	object = err == 0 ? drro->drr_object : DMU_NEW_OBJECT;
 
+	/*
+	 * A dnode can't change its size in place.  If this one is now a
+	 * different size, or would now run over objects in the following
+	 * slots, free whatever is in the way and wait for the frees to sync
+	 * so that the slots can be claimed.
+	 */
+	if (err == 0 && doi.doi_dnodesize != (dn_slots << DNODE_SHIFT)) {
+		err = dmu_free_long_object(rwa->os, drro->drr_object);
+		if (err != 0)
+			return (SET_ERROR(EINVAL));
+		txg_wait_synced(dmu_objset_pool(rwa->os), 0);
+		object = DMU_NEW_OBJECT;
+	}
+	if (object == DMU_NEW_OBJECT && dn_slots > DNODE_MIN_SLOTS) {
+		boolean_t freed = B_FALSE;
+
+		for (uint64_t slot = drro->drr_object + 1;
+		    slot < drro->drr_object + dn_slots; slot++) {
+			if (dmu_object_info(rwa->os, slot, NULL) != 0)
+				continue;
+			err = dmu_free_long_object(rwa->os, slot);
+			if (err != 0)
+				return (SET_ERROR(EINVAL));
+			freed = B_TRUE;
+		}
+		if (freed)
+			txg_wait_synced(dmu_objset_pool(rwa->os), 0);
+	}
+	err = (object == DMU_NEW_OBJECT) ? ENOENT : 0;
+
 	/*
 	 * If we are losing blkptrs or changing the block size this must
 	 * be a new file instance.  We must clear out the previous file
@@ -1982,7 +2144,7 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 		int nblkptr;
 
 		nblkptr = deduce_nblkptr(drro->drr_bonustype,
-		    drro->drr_bonuslen);
+		    drro->drr_bonuslen, dn_slots);
 
 		if (drro->drr_blksz != doi.doi_data_block_size ||
 		    nblkptr < doi.doi_nblkptr) {
@@ -1993,6 +2155,7 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 		}
 	}
 
+again:
 	tx = dmu_tx_create(rwa->os);
 	dmu_tx_hold_bonus(tx, object);
 	err = dmu_tx_assign(tx, TXG_WAIT);
@@ -2003,9 +2166,20 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 
 	if (object == DMU_NEW_OBJECT) {
 		/* currently free, want to be allocated */
-		err = dmu_object_claim(rwa->os, drro->drr_object,
+		err = dmu_object_claim_dnsize(rwa->os, drro->drr_object,
 		    drro->drr_type, drro->drr_blksz,
-		    drro->drr_bonustype, drro->drr_bonuslen, tx);
+		    drro->drr_bonustype, drro->drr_bonuslen,
+		    dn_slots << DNODE_SHIFT, tx);
+		/*
+		 * The slot may still be inside a large dnode whose free,
+		 * earlier in the stream, has not synced yet.
+		 */
+		if (err == EEXIST && !waited) {
+			dmu_tx_commit(tx);
+			txg_wait_synced(dmu_objset_pool(rwa->os), 0);
+			waited = B_TRUE;
+			goto again;
+		}
 	} else if (drro->drr_type != doi.doi_type ||
 	    drro->drr_blksz != doi.doi_data_block_size ||
 	    drro->drr_bonustype != doi.doi_bonus_type ||
@@ -2074,17 +2248,44 @@ receive_freeobjects(struct receive_writer_arg *rwa,
 	return (0);
 }
 
+/*
+ * Handle a DRR_WRITE record.  The payload is either an uncompressed arc_buf
+ * (abuf) or, for compressed records, the block as it was stored on the
+ * sending pool (cbuf, from zio_data_buf_alloc()).  On success the payload
+ * is consumed.
+ */
 static int
 receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
-    arc_buf_t *abuf)
+    arc_buf_t *abuf, void *cbuf)
 {
 	dmu_tx_t *tx;
+	dmu_object_info_t doi;
 	int err;
 
 	if (drrw->drr_offset + drrw->drr_length < drrw->drr_offset ||
 	    !DMU_OT_IS_VALID(drrw->drr_type))
 		return (SET_ERROR(EINVAL));
 
+	if (DRR_WRITE_COMPRESSED(drrw)) {
+		ASSERT3P(cbuf, !=, NULL);
+		ASSERT3P(abuf, ==, NULL);
+		/*
+		 * We can't byteswap a block without decompressing it, so the
+		 * sender only compresses byte arrays.
+		 */
+		if (drrw->drr_compressiontype >= ZIO_COMPRESS_FUNCTIONS ||
+		    zio_compress_table[drrw->drr_compressiontype].ci_compress ==
+		    NULL || drrw->drr_compressed_size > drrw->drr_length ||
+		    P2PHASE(drrw->drr_compressed_size, SPA_MINBLOCKSIZE) != 0 ||
+		    DMU_OT_BYTESWAP(drrw->drr_type) != DMU_BSWAP_UINT8)
+			return (SET_ERROR(EINVAL));
+		if (drrw->drr_compressiontype >=
+		    ZIO_COMPRESS_LEGACY_FUNCTIONS &&
+		    !spa_feature_is_enabled(dmu_objset_spa(rwa->os),
+		    SPA_FEATURE_LZ4_COMPRESS))
+			return (SET_ERROR(ENOTSUP));
+	}
+
 	/*
 	 * For resuming to work, records must be in increasing order
 	 * by (object, offset).
@@ -2097,7 +2298,16 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 	rwa->last_object = drrw->drr_object;
 	rwa->last_offset = drrw->drr_offset;
 
-	if (dmu_object_info(rwa->os, drrw->drr_object, NULL) != 0)
+	if (dmu_object_info(rwa->os, drrw->drr_object, &doi) != 0)
+		return (SET_ERROR(EINVAL));
+
+	/*
+	 * A compressed record must describe exactly one whole block, since
+	 * it is written to disk without being reassembled.
+	 */
+	if (DRR_WRITE_COMPRESSED(drrw) &&
+	    (drrw->drr_length != doi.doi_data_block_size ||
+	    drrw->drr_offset % doi.doi_data_block_size != 0))
 		return (SET_ERROR(EINVAL));
 
 	tx = dmu_tx_create(rwa->os);
@@ -2109,6 +2319,16 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 		dmu_tx_abort(tx);
 		return (err);
 	}
+
+	if (DRR_WRITE_COMPRESSED(drrw)) {
+		dmu_write_compressed(rwa->os, drrw->drr_object,
+		    drrw->drr_offset, cbuf, drrw->drr_compressiontype,
+		    drrw->drr_compressed_size, tx);
+		save_resume_state(rwa, drrw->drr_object, drrw->drr_offset, tx);
+		dmu_tx_commit(tx);
+		return (0);
+	}
+
 	if (rwa->byteswap) {
 		dmu_object_byteswap_t byteswap =
 		    DMU_OT_BYTESWAP(drrw->drr_type);
@@ -2528,7 +2748,27 @@ receive_read_record(struct receive_arg *ra)
 	case DRR_WRITE:
 	{
 		struct drr_write *drrw = &ra->rrd->header.drr_u.drr_write;
-		arc_buf_t *abuf = arc_loan_buf(dmu_objset_spa(ra->os),
+		arc_buf_t *abuf;
+
+		if (DRR_WRITE_COMPRESSED(drrw)) {
+			uint64_t psize = drrw->drr_compressed_size;
+			void *cbuf;
+
+			if (psize == 0 || psize > SPA_MAXBLOCKSIZE)
+				return (SET_ERROR(EINVAL));
+			cbuf = zio_data_buf_alloc(psize);
+			err = receive_read_payload_and_next_header(ra,
+			    psize, cbuf);
+			if (err != 0) {
+				zio_data_buf_free(cbuf, psize);
+				return (err);
+			}
+			receive_read_prefetch(ra, drrw->drr_object,
+			    drrw->drr_offset, drrw->drr_length);
+			return (err);
+		}
+
+		abuf = arc_loan_buf(dmu_objset_spa(ra->os),
 		    drrw->drr_length);
 
 		err = receive_read_payload_and_next_header(ra,
@@ -2630,7 +2870,16 @@ receive_process_record(struct receive_writer_arg *rwa,
 	case DRR_WRITE:
 	{
 		struct drr_write *drrw = &rrd->header.drr_u.drr_write;
-		err = receive_write(rwa, drrw, rrd->write_buf);
+		if (DRR_WRITE_COMPRESSED(drrw)) {
+			err = receive_write(rwa, drrw, NULL, rrd->payload);
+			/* if successful, receive_write() consumes the buffer */
+			if (err != 0)
+				zio_data_buf_free(rrd->payload,
+				    rrd->payload_size);
+			rrd->payload = NULL;
+			return (err);
+		}
+		err = receive_write(rwa, drrw, rrd->write_buf, NULL);
 		/* if receive_write() is successful, it consumes the arc_buf */
 		if (err != 0)
 			dmu_return_arcbuf(rrd->write_buf);
@@ -2672,8 +2921,214 @@ receive_process_record(struct receive_writer_arg *rwa,
 }
 
 /*
- * dmu_recv_stream's worker thread; pull records off the queue, and then call
- * receive_process_record  When we're done, signal the main thread and exit.
+ * Apply a record, and free it.
+ */
+static void
+receive_consume_record(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	/*
+	 * If there's an error, the main thread will stop putting things
+	 * on the queue, but we need to clear everything in it before we
+	 * can exit.
+	 */
+	if (rwa->err == 0) {
+		rwa->err = receive_process_record(rwa, rrd);
+	} else if (rrd->write_buf != NULL) {
+		dmu_return_arcbuf(rrd->write_buf);
+		rrd->write_buf = NULL;
+		rrd->payload = NULL;
+	} else if (rrd->header.drr_type == DRR_WRITE &&
+	    rrd->payload != NULL) {
+		/* a compressed write; see receive_read_record() */
+		zio_data_buf_free(rrd->payload, rrd->payload_size);
+		rrd->payload = NULL;
+	} else if (rrd->payload != NULL) {
+		kmem_free(rrd->payload, rrd->payload_size);
+		rrd->payload = NULL;
+	}
+	kmem_free(rrd, sizeof (*rrd));
+}
+
+/*
+ * If this record only affects one object, return B_TRUE and set *objp.
+ * Such records may be applied concurrently with those of other objects.
+ */
+static boolean_t
+receive_record_object(struct receive_record_arg *rrd, uint64_t *objp)
+{
+	dmu_replay_record_t *drr = &rrd->header;
+
+	switch (drr->drr_type) {
+	case DRR_OBJECT:
+		*objp = drr->drr_u.drr_object.drr_object;
+		break;
+	case DRR_WRITE:
+		*objp = drr->drr_u.drr_write.drr_object;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		*objp = drr->drr_u.drr_write_embedded.drr_object;
+		break;
+	case DRR_FREE:
+		*objp = drr->drr_u.drr_free.drr_object;
+		break;
+	case DRR_SPILL:
+		*objp = drr->drr_u.drr_spill.drr_object;
+		break;
+	default:
+		/*
+		 * FREEOBJECTS spans objects, and WRITE_BYREF reads data that
+		 * was written by an earlier record of another object.
+		 */
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Wait until the workers have applied all of the records handed to them so
+ * far, and return the first error that any of them hit.
+ */
+static int
+receive_workers_wait(struct receive_writer_arg *rwa)
+{
+	int err = 0;
+
+	for (int i = 0; i < rwa->nworkers; i++) {
+		struct receive_writer_arg *worker = &rwa->workers[i];
+
+		mutex_enter(&worker->mutex);
+		while (worker->pending != 0)
+			cv_wait(&worker->cv, &worker->mutex);
+		mutex_exit(&worker->mutex);
+		if (err == 0)
+			err = worker->err;
+	}
+	return (err);
+}
+
+/*
+ * Hand a record of the given object to the worker that owns that object.
+ */
+static void
+receive_dispatch_record(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd, uint64_t object)
+{
+	struct receive_writer_arg *worker =
+	    &rwa->workers[object % rwa->nworkers];
+
+	mutex_enter(&worker->mutex);
+	worker->pending++;
+	mutex_exit(&worker->mutex);
+	bqueue_enqueue(&worker->q, rrd,
+	    sizeof (struct receive_record_arg) + rrd->payload_size);
+
+	/*
+	 * We're reading the workers' errors without locks; it's ok if we
+	 * miss one for a record or two, since they keep freeing the records
+	 * we send them.
+	 */
+	for (int i = 0; i < rwa->nworkers && rwa->err == 0; i++)
+		rwa->err = rwa->workers[i].err;
+}
+
+/*
+ * A worker of the writer thread; apply the records it hands us, in order.
+ */
+static void
+receive_worker_thread(void *arg)
+{
+	struct receive_writer_arg *rwa = arg;
+	struct receive_record_arg *rrd;
+
+	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
+	    rrd = bqueue_dequeue(&rwa->q)) {
+		receive_consume_record(rwa, rrd);
+		mutex_enter(&rwa->mutex);
+		if (--rwa->pending == 0)
+			cv_broadcast(&rwa->cv);
+		mutex_exit(&rwa->mutex);
+	}
+	kmem_free(rrd, sizeof (*rrd));
+	mutex_enter(&rwa->mutex);
+	rwa->done = B_TRUE;
+	cv_broadcast(&rwa->cv);
+	mutex_exit(&rwa->mutex);
+}
+
+static void
+receive_workers_create(struct receive_writer_arg *rwa, int nworkers)
+{
+	rwa->nworkers = nworkers;
+	rwa->workers = kmem_zalloc(nworkers *
+	    sizeof (struct receive_writer_arg), KM_SLEEP);
+	for (int i = 0; i < nworkers; i++) {
+		struct receive_writer_arg *worker = &rwa->workers[i];
+
+		(void) bqueue_init(&worker->q, zfs_recv_queue_length,
+		    offsetof(struct receive_record_arg, node));
+		cv_init(&worker->cv, NULL, CV_DEFAULT, NULL);
+		mutex_init(&worker->mutex, NULL, MUTEX_DEFAULT, NULL);
+		worker->os = rwa->os;
+		worker->byteswap = rwa->byteswap;
+		worker->guid_to_ds_map = rwa->guid_to_ds_map;
+		ASSERT(!rwa->resumable);
+
+		(void) thread_create(NULL, 0, receive_worker_thread, worker,
+		    0, curproc, TS_RUN, minclsyspri);
+	}
+}
+
+/*
+ * Tell the workers to exit once they have drained their queues, and wait
+ * for them to do so.  Returns the first error that any of them hit.
+ */
+static int
+receive_workers_stop(struct receive_writer_arg *rwa)
+{
+	int err = 0;
+
+	for (int i = 0; i < rwa->nworkers; i++) {
+		struct receive_record_arg *eos =
+		    kmem_zalloc(sizeof (*eos), KM_SLEEP);
+
+		eos->eos_marker = B_TRUE;
+		bqueue_enqueue(&rwa->workers[i].q, eos, 1);
+	}
+	for (int i = 0; i < rwa->nworkers; i++) {
+		struct receive_writer_arg *worker = &rwa->workers[i];
+
+		mutex_enter(&worker->mutex);
+		while (!worker->done)
+			cv_wait(&worker->cv, &worker->mutex);
+		mutex_exit(&worker->mutex);
+		if (err == 0)
+			err = worker->err;
+	}
+	return (err);
+}
+
+static void
+receive_workers_destroy(struct receive_writer_arg *rwa)
+{
+	for (int i = 0; i < rwa->nworkers; i++) {
+		struct receive_writer_arg *worker = &rwa->workers[i];
+
+		ASSERT(worker->done);
+		cv_destroy(&worker->cv);
+		mutex_destroy(&worker->mutex);
+		bqueue_destroy(&worker->q);
+	}
+	kmem_free(rwa->workers, rwa->nworkers *
+	    sizeof (struct receive_writer_arg));
+	rwa->workers = NULL;
+	rwa->nworkers = 0;
+}
+
+/*
+ * dmu_recv_stream's writer thread; pull records off the queue, and then call
+ * receive_process_record, or hand them to a worker if there are any.  When
+ * we're done, signal the main thread and exit.
  */
 static void
 receive_writer_thread(void *arg)
@@ -2682,24 +3137,28 @@ receive_writer_thread(void *arg)
 	struct receive_record_arg *rrd;
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
-		/*
-		 * If there's an error, the main thread will stop putting things
-		 * on the queue, but we need to clear everything in it before we
-		 * can exit.
-		 */
-		if (rwa->err == 0) {
-			rwa->err = receive_process_record(rwa, rrd);
-		} else if (rrd->write_buf != NULL) {
-			dmu_return_arcbuf(rrd->write_buf);
-			rrd->write_buf = NULL;
-			rrd->payload = NULL;
-		} else if (rrd->payload != NULL) {
-			kmem_free(rrd->payload, rrd->payload_size);
-			rrd->payload = NULL;
+		uint64_t object;
+		int err;
+
+		if (rwa->nworkers != 0) {
+			if (rwa->err == 0 &&
+			    receive_record_object(rrd, &object)) {
+				receive_dispatch_record(rwa, rrd, object);
+				continue;
+			}
+			/* this record must wait for everything before it */
+			err = receive_workers_wait(rwa);
+			if (rwa->err == 0)
+				rwa->err = err;
 		}
-		kmem_free(rrd, sizeof (*rrd));
+		receive_consume_record(rwa, rrd);
 	}
 	kmem_free(rrd, sizeof (*rrd));
+	if (rwa->nworkers != 0) {
+		int err = receive_workers_stop(rwa);
+		if (rwa->err == 0)
+			rwa->err = err;
+	}
 	mutex_enter(&rwa->mutex);
 	rwa->done = B_TRUE;
 	cv_signal(&rwa->cv);
@@ -2848,6 +3307,13 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	rwa.byteswap = drc->drc_byteswap;
 	rwa.resumable = drc->drc_resumable;
 
+	/*
+	 * A resumable receive must record how far it got in stream order,
+	 * so it applies every record in the writer thread.
+	 */
+	if (!rwa.resumable && zfs_recv_writer_threads > 1)
+		receive_workers_create(&rwa, zfs_recv_writer_threads);
+
 	(void) thread_create(NULL, 0, receive_writer_thread, &rwa, 0, curproc,
 	    TS_RUN, minclsyspri);
 	/*
@@ -2898,6 +3364,8 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	}
 	mutex_exit(&rwa.mutex);
 
+	if (rwa.nworkers != 0)
+		receive_workers_destroy(&rwa);
 	cv_destroy(&rwa.cv);
 	mutex_destroy(&rwa.mutex);
 	bqueue_destroy(&rwa.q);
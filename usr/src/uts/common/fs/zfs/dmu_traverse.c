@@ -39,6 +39,7 @@
 #include <sys/zfeature.h>
 
 int32_t zfs_pd_bytes_max = 50 * 1024 * 1024;	/* 50MB */
+int zfs_traverse_pool_threads = 8;	/* datasets walked at once */
 
 typedef struct prefetch_data {
 	kmutex_t pd_mtx;
@@ -327,13 +328,13 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 			goto post;
 		dnode_phys_t *child_dnp = buf->b_data;
 
-		for (i = 0; i < epb; i++) {
+		for (i = 0; i < epb; i += child_dnp[i].dn_extra_slots + 1) {
 			prefetch_dnode_metadata(td, &child_dnp[i],
 			    zb->zb_objset, zb->zb_blkid * epb + i);
 		}
 
 		/* recursively visitbp() blocks below this */
-		for (i = 0; i < epb; i++) {
+		for (i = 0; i < epb; i += child_dnp[i].dn_extra_slots + 1) {
 			err = traverse_dnode(td, &child_dnp[i],
 			    zb->zb_objset, zb->zb_blkid * epb + i);
 			if (err != 0)
@@ -435,7 +436,7 @@ prefetch_dnode_metadata(traverse_data_t *td, const dnode_phys_t *dnp,
 
 	if (dnp->dn_flags & DNODE_FLAG_SPILL_BLKPTR) {
 		SET_BOOKMARK(&czb, objset, object, 0, DMU_SPILL_BLKID);
-		traverse_prefetch_metadata(td, &dnp->dn_spill, &czb);
+		traverse_prefetch_metadata(td, DN_SPILL_BLKPTR(dnp), &czb);
 	}
 }
 
@@ -470,7 +471,7 @@ traverse_dnode(traverse_data_t *td, const dnode_phys_t *dnp,
 
 	if (err == 0 && (dnp->dn_flags & DNODE_FLAG_SPILL_BLKPTR)) {
 		SET_BOOKMARK(&czb, objset, object, 0, DMU_SPILL_BLKID);
-		err = traverse_visitbp(td, dnp, &dnp->dn_spill, &czb);
+		err = traverse_visitbp(td, dnp, DN_SPILL_BLKPTR(dnp), &czb);
 	}
 
 	if (err == 0 && (td->td_flags & TRAVERSE_POST)) {
@@ -648,8 +649,54 @@ traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
 	    blkptr, txg_start, resume, flags, func, arg));
 }
 
+typedef struct traverse_pool_data {
+	kmutex_t tpd_lock;
+	int tpd_err;
+	blkptr_cb_t *tpd_func;
+	void *tpd_arg;
+	int tpd_flags;
+} traverse_pool_data_t;
+
+typedef struct traverse_pool_ds {
+	traverse_pool_data_t *tpds_tpd;
+	dsl_dataset_t *tpds_ds;
+	uint64_t tpds_txg;
+} traverse_pool_ds_t;
+
+static void
+traverse_pool_ds_task(void *arg)
+{
+	traverse_pool_ds_t *tpds = arg;
+	traverse_pool_data_t *tpd = tpds->tpds_tpd;
+	int err = 0;
+
+	/* once one dataset has failed, don't bother starting the rest */
+	mutex_enter(&tpd->tpd_lock);
+	if (!(tpd->tpd_flags & TRAVERSE_HARD))
+		err = tpd->tpd_err;
+	mutex_exit(&tpd->tpd_lock);
+
+	if (err == 0) {
+		err = traverse_dataset(tpds->tpds_ds, tpds->tpds_txg,
+		    tpd->tpd_flags, tpd->tpd_func, tpd->tpd_arg);
+	}
+
+	mutex_enter(&tpd->tpd_lock);
+	if (tpd->tpd_err == 0)
+		tpd->tpd_err = err;
+	mutex_exit(&tpd->tpd_lock);
+
+	dsl_dataset_rele(tpds->tpds_ds, tpds);
+	kmem_free(tpds, sizeof (*tpds));
+}
+
 /*
  * NB: pool must not be changing on-disk (eg, from zdb or sync context).
+ *
+ * With TRAVERSE_PARALLEL, up to zfs_traverse_pool_threads datasets are
+ * traversed at once after the MOS, so func may be called concurrently
+ * from several threads and must do its own locking.  Blocks are still
+ * visited in order within each dataset.
  */
 int
 traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
@@ -659,6 +706,8 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	dsl_pool_t *dp = spa_get_dsl(spa);
 	objset_t *mos = dp->dp_meta_objset;
 	boolean_t hard = (flags & TRAVERSE_HARD);
+	traverse_pool_data_t tpd;
+	taskq_t *tq = NULL;
 
 	/* visit the MOS */
 	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
@@ -666,6 +715,23 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	if (err != 0)
 		return (err);
 
+	if ((flags & TRAVERSE_PARALLEL) && zfs_traverse_pool_threads > 1) {
+		int nthreads = zfs_traverse_pool_threads;
+
+		mutex_init(&tpd.tpd_lock, NULL, MUTEX_DEFAULT, NULL);
+		tpd.tpd_err = 0;
+		tpd.tpd_func = func;
+		tpd.tpd_arg = arg;
+		tpd.tpd_flags = flags & ~TRAVERSE_PARALLEL;
+
+		/*
+		 * Bound the queue so that we hold only a few datasets per
+		 * thread rather than every dataset in the pool.
+		 */
+		tq = taskq_create("traverse_pool", nthreads, minclsyspri,
+		    nthreads, nthreads * 4, TASKQ_PREPOPULATE);
+	}
+
 	/* visit each dataset */
 	for (uint64_t obj = 1; err == 0;
 	    err = dmu_object_next(mos, &obj, B_FALSE, txg_start)) {
@@ -679,19 +745,43 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 		}
 
 		if (doi.doi_bonus_type == DMU_OT_DSL_DATASET) {
+			traverse_pool_ds_t *tpds = NULL;
+			void *tag = FTAG;
 			dsl_dataset_t *ds;
 			uint64_t txg = txg_start;
 
+			if (tq != NULL) {
+				mutex_enter(&tpd.tpd_lock);
+				err = hard ? 0 : tpd.tpd_err;
+				mutex_exit(&tpd.tpd_lock);
+				if (err != 0)
+					break;
+				tpds = kmem_alloc(sizeof (*tpds), KM_SLEEP);
+				tag = tpds;
+			}
+
 			dsl_pool_config_enter(dp, FTAG);
-			err = dsl_dataset_hold_obj(dp, obj, FTAG, &ds);
+			err = dsl_dataset_hold_obj(dp, obj, tag, &ds);
 			dsl_pool_config_exit(dp, FTAG);
 			if (err != 0) {
+				if (tpds != NULL)
+					kmem_free(tpds, sizeof (*tpds));
 				if (hard)
 					continue;
 				break;
 			}
 			if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
 				txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
+
+			if (tpds != NULL) {
+				tpds->tpds_tpd = &tpd;
+				tpds->tpds_ds = ds;
+				tpds->tpds_txg = txg;
+				(void) taskq_dispatch(tq, traverse_pool_ds_task,
+				    tpds, TQ_SLEEP);
+				continue;
+			}
+
 			err = traverse_dataset(ds, txg, flags, func, arg);
 			dsl_dataset_rele(ds, FTAG);
 			if (err != 0)
@@ -700,5 +790,13 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	}
 	if (err == ESRCH)
 		err = 0;
+
+	if (tq != NULL) {
+		taskq_wait(tq);
+		taskq_destroy(tq);
+		if (err == 0)
+			err = tpd.tpd_err;
+		mutex_destroy(&tpd.tpd_lock);
+	}
 	return (err);
 }
@@ -1184,7 +1184,7 @@ dmu_tx_try_assign(dmu_tx_t *tx, txg_how_t txg_how)
 	}
 
 	if (!tx->tx_waited &&
-	    dsl_pool_need_dirty_delay(tx->tx_pool)) {
+	    dsl_pool_need_dirty_delay(tx->tx_pool, tx->tx_dir)) {
 		tx->tx_wait_dirty = B_TRUE;
 		return (SET_ERROR(ERESTART));
 	}
@@ -1616,7 +1616,7 @@ dmu_tx_hold_spill(dmu_tx_t *tx, uint64_t object)
 	} else {
 		blkptr_t *bp;
 
-		bp = &dn->dn_phys->dn_spill;
+		bp = DN_SPILL_BLKPTR(dn->dn_phys);
 		if (dsl_dataset_block_freeable(dn->dn_objset->os_dsl_dataset,
 		    bp, bp->blk_birth)) {
 			(void) refcount_add_many(&txh->txh_space_tooverwrite,
@@ -1653,7 +1653,8 @@ dmu_tx_hold_sa_create(dmu_tx_t *tx, int attrsize)
 
 	dmu_tx_sa_registration_hold(sa, tx);
 
-	if (attrsize <= DN_MAX_BONUSLEN && !sa->sa_force_spill)
+	if (attrsize <= DN_BONUS_SIZE(dmu_objset_dnodesize(tx->tx_objset)) &&
+	    !sa->sa_force_spill)
 		return;
 
 	(void) dmu_tx_hold_object_impl(tx, tx->tx_objset, DMU_NEW_OBJECT,
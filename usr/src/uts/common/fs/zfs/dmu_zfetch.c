@@ -47,8 +47,10 @@ boolean_t zfs_prefetch_disable = B_FALSE;
 uint32_t	zfetch_max_streams = 8;
 /* min time before stream reclaim */
 uint32_t	zfetch_min_sec_reap = 2;
-/* max bytes to prefetch per stream (default 8MB) */
-uint32_t	zfetch_max_distance = 8 * 1024 * 1024;
+/* initial bytes to prefetch per stream (default 4MB) */
+uint32_t	zfetch_min_distance = 4 * 1024 * 1024;
+/* max bytes to prefetch per stream (default 64MB) */
+uint32_t	zfetch_max_distance = 64 * 1024 * 1024;
 /* max bytes to prefetch indirects for per stream (default 64MB) */
 uint32_t	zfetch_max_idistance = 64 * 1024 * 1024;
 /* max number of bytes in an array_read in which we allow prefetching (1MB) */
@@ -58,16 +60,28 @@ typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
 	kstat_named_t zfetchstat_misses;
 	kstat_named_t zfetchstat_max_streams;
+	kstat_named_t zfetchstat_waits;
+	kstat_named_t zfetchstat_grows;
+	kstat_named_t zfetchstat_shrinks;
+	kstat_named_t zfetchstat_io_issued;
+	kstat_named_t zfetchstat_io_issued_bytes;
 } zfetch_stats_t;
 
 static zfetch_stats_t zfetch_stats = {
 	{ "hits",			KSTAT_DATA_UINT64 },
 	{ "misses",			KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
+	{ "waits",			KSTAT_DATA_UINT64 },
+	{ "distance_grows",		KSTAT_DATA_UINT64 },
+	{ "distance_shrinks",		KSTAT_DATA_UINT64 },
+	{ "io_issued",			KSTAT_DATA_UINT64 },
+	{ "io_issued_bytes",		KSTAT_DATA_UINT64 },
 };
 
 #define	ZFETCHSTAT_BUMP(stat) \
 	atomic_inc_64(&zfetch_stats.stat.value.ui64);
+#define	ZFETCHSTAT_INCR(stat, val) \
+	atomic_add_64(&zfetch_stats.stat.value.ui64, (val));
 
 kstat_t		*zfetch_ksp;
 
@@ -179,7 +193,7 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	 */
 	uint32_t max_streams = MAX(1, MIN(zfetch_max_streams,
 	    zf->zf_dnode->dn_maxblkid * zf->zf_dnode->dn_datablksz /
-	    zfetch_max_distance));
+	    zfetch_min_distance));
 	if (numstreams >= max_streams) {
 		ZFETCHSTAT_BUMP(zfetchstat_max_streams);
 		return;
@@ -189,6 +203,7 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	zs->zs_blkid = blkid;
 	zs->zs_pf_blkid = blkid;
 	zs->zs_ipf_blkid = blkid;
+	zs->zs_pf_dist = MIN(zfetch_min_distance, zfetch_max_distance);
 	zs->zs_atime = gethrtime();
 	mutex_init(&zs->zs_lock, NULL, MUTEX_DEFAULT, NULL);
 
@@ -202,15 +217,19 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
  * fetch_data argument specifies whether actual data blocks should be fetched:
  *   FALSE -- prefetch only indirect blocks for predicted data blocks;
  *   TRUE -- prefetch predicted data blocks plus following indirect blocks.
+ * missed argument tells whether the caller's access found any of its blocks
+ * not yet read in, i.e. whether the reader is going to wait on I/O.
  */
 void
-dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
+dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
+    boolean_t missed)
 {
 	zstream_t *zs;
 	int64_t pf_start, ipf_start, ipf_istart, ipf_iend;
 	int64_t pf_ahead_blks, max_blks;
 	int epbs, max_dist_blks, pf_nblks, ipf_nblks;
 	uint64_t end_of_access_blkid = blkid + nblks;
+	int datablkshift = zf->zf_dnode->dn_datablkshift;
 
 	if (zfs_prefetch_disable)
 		return;
@@ -264,13 +283,48 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 	 */
 	pf_start = MAX(zs->zs_pf_blkid, end_of_access_blkid);
 
+	/*
+	 * Adapt this stream's prefetch distance to what the reader actually
+	 * sees.  If the reader hit the stream but still had to wait for its
+	 * blocks, the prefetched I/O hasn't completed far enough ahead of it,
+	 * so double the distance (up to zfetch_max_distance).  If the reader
+	 * has consumed a full distance's worth of blocks without waiting,
+	 * the prefetch is further ahead than it needs to be and is just
+	 * occupying the ARC, so back off by an eighth (down to
+	 * zfetch_min_distance).  While the stream is still ramping up, i.e.
+	 * hasn't yet reached its distance, waits are expected and ignored.
+	 */
+	if (fetch_data) {
+		uint64_t ahead = (zs->zs_pf_blkid - blkid) << datablkshift;
+
+		if (missed) {
+			ZFETCHSTAT_BUMP(zfetchstat_waits);
+			zs->zs_nowait_blks = 0;
+			if (ahead >= zs->zs_pf_dist &&
+			    zs->zs_pf_dist < zfetch_max_distance) {
+				zs->zs_pf_dist = MIN(zs->zs_pf_dist * 2,
+				    zfetch_max_distance);
+				ZFETCHSTAT_BUMP(zfetchstat_grows);
+			}
+		} else {
+			zs->zs_nowait_blks += nblks;
+			if ((zs->zs_nowait_blks << datablkshift) >=
+			    zs->zs_pf_dist &&
+			    zs->zs_pf_dist > zfetch_min_distance) {
+				zs->zs_pf_dist = MAX(zs->zs_pf_dist -
+				    zs->zs_pf_dist / 8, zfetch_min_distance);
+				zs->zs_nowait_blks = 0;
+				ZFETCHSTAT_BUMP(zfetchstat_shrinks);
+			}
+		}
+	}
+
 	/*
 	 * Double our amount of prefetched data, but don't let the
-	 * prefetch get further ahead than zfetch_max_distance.
+	 * prefetch get further ahead than the stream's distance.
 	 */
 	if (fetch_data) {
-		max_dist_blks =
-		    zfetch_max_distance >> zf->zf_dnode->dn_datablkshift;
+		max_dist_blks = MAX(1, zs->zs_pf_dist >> datablkshift);
 		/*
 		 * Previously, we were (zs_pf_blkid - blkid) ahead.  We
 		 * want to now be double that, so read that amount again,
@@ -279,7 +333,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 		 */
 		pf_ahead_blks = zs->zs_pf_blkid - blkid + nblks;
 		max_blks = max_dist_blks - (pf_start - end_of_access_blkid);
-		pf_nblks = MIN(pf_ahead_blks, max_blks);
+		pf_nblks = MAX(0, MIN(pf_ahead_blks, max_blks));
 	} else {
 		pf_nblks = 0;
 	}
@@ -292,7 +346,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 	 * that point to them).
 	 */
 	ipf_start = MAX(zs->zs_ipf_blkid, zs->zs_pf_blkid);
-	max_dist_blks = zfetch_max_idistance >> zf->zf_dnode->dn_datablkshift;
+	max_dist_blks = zfetch_max_idistance >> datablkshift;
 	/*
 	 * We want to double our distance ahead of the data prefetch
 	 * (or reader, if we are not prefetching data).  Previously, we
@@ -302,7 +356,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 	 */
 	pf_ahead_blks = zs->zs_ipf_blkid - blkid + nblks + pf_nblks;
 	max_blks = max_dist_blks - (ipf_start - end_of_access_blkid);
-	ipf_nblks = MIN(pf_ahead_blks, max_blks);
+	ipf_nblks = MAX(0, MIN(pf_ahead_blks, max_blks));
 	zs->zs_ipf_blkid = ipf_start + ipf_nblks;
 
 	epbs = zf->zf_dnode->dn_indblkshift - SPA_BLKPTRSHIFT;
@@ -328,5 +382,10 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 		dbuf_prefetch(zf->zf_dnode, 1, iblk,
 		    ZIO_PRIORITY_ASYNC_READ, ARC_FLAG_PREDICTIVE_PREFETCH);
 	}
+	if (pf_nblks > 0) {
+		ZFETCHSTAT_INCR(zfetchstat_io_issued, pf_nblks);
+		ZFETCHSTAT_INCR(zfetchstat_io_issued_bytes,
+		    (uint64_t)pf_nblks << datablkshift);
+	}
 	ZFETCHSTAT_BUMP(zfetchstat_hits);
 }
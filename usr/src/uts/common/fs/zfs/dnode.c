@@ -258,12 +258,15 @@ dnode_verify(dnode_t *dn)
 		ASSERT(DMU_OT_IS_VALID(dn->dn_type));
 		ASSERT3U(dn->dn_nblkptr, >=, 1);
 		ASSERT3U(dn->dn_nblkptr, <=, DN_MAX_NBLKPTR);
-		ASSERT3U(dn->dn_bonuslen, <=, DN_MAX_BONUSLEN);
+		ASSERT3U(dn->dn_num_slots, >=, DNODE_MIN_SLOTS);
+		ASSERT3U(dn->dn_num_slots, <=, DNODE_MAX_SLOTS);
+		ASSERT3U(dn->dn_bonuslen, <=,
+		    DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots));
 		ASSERT3U(dn->dn_datablksz, ==,
 		    dn->dn_datablkszsec << SPA_MINBLOCKSHIFT);
 		ASSERT3U(ISP2(dn->dn_datablksz), ==, dn->dn_datablkshift != 0);
 		ASSERT3U((dn->dn_nblkptr - 1) * sizeof (blkptr_t) +
-		    dn->dn_bonuslen, <=, DN_MAX_BONUSLEN);
+		    dn->dn_bonuslen, <=, DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots));
 		for (i = 0; i < TXG_SIZE; i++) {
 			ASSERT3U(dn->dn_next_nlevels[i], <=, dn->dn_nlevels);
 		}
@@ -320,7 +323,7 @@ dnode_byteswap(dnode_phys_t *dnp)
 		 * dnode buffer).
 		 */
 		int off = (dnp->dn_nblkptr-1) * sizeof (blkptr_t);
-		size_t len = DN_MAX_BONUSLEN - off;
+		size_t len = DN_SLOTS_TO_BONUSLEN(dnp->dn_extra_slots + 1) - off;
 		ASSERT(DMU_OT_IS_VALID(dnp->dn_bonustype));
 		dmu_object_byteswap_t byteswap =
 		    DMU_OT_BYTESWAP(dnp->dn_bonustype);
@@ -329,7 +332,7 @@ dnode_byteswap(dnode_phys_t *dnp)
 
 	/* Swap SPILL block if we have one */
 	if (dnp->dn_flags & DNODE_FLAG_SPILL_BLKPTR)
-		byteswap_uint64_array(&dnp->dn_spill, sizeof (blkptr_t));
+		byteswap_uint64_array(DN_SPILL_BLKPTR(dnp), sizeof (blkptr_t));
 
 }
 
@@ -337,15 +340,23 @@ void
 dnode_buf_byteswap(void *vbuf, size_t size)
 {
 	dnode_phys_t *buf = vbuf;
-	int i;
+	int i, slots;
 
 	ASSERT3U(sizeof (dnode_phys_t), ==, (1<<DNODE_SHIFT));
 	ASSERT((size & (sizeof (dnode_phys_t)-1)) == 0);
 
+	/*
+	 * dn_type and dn_extra_slots are single bytes, so they can be read
+	 * before the swap; the interior slots of a large dnode are swapped
+	 * as part of it.
+	 */
 	size >>= DNODE_SHIFT;
-	for (i = 0; i < size; i++) {
-		dnode_byteswap(buf);
-		buf++;
+	for (i = 0; i < size; i += slots) {
+		slots = 1;
+		if (buf[i].dn_type != DMU_OT_NONE)
+			slots += buf[i].dn_extra_slots;
+		ASSERT3U(i + slots, <=, size);
+		dnode_byteswap(&buf[i]);
 	}
 }
 
@@ -356,7 +367,7 @@ dnode_setbonuslen(dnode_t *dn, int newsize, dmu_tx_t *tx)
 
 	dnode_setdirty(dn, tx);
 	rw_enter(&dn->dn_struct_rwlock, RW_WRITER);
-	ASSERT3U(newsize, <=, DN_MAX_BONUSLEN -
+	ASSERT3U(newsize, <=, DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots) -
 	    (dn->dn_nblkptr-1) * sizeof (blkptr_t));
 	dn->dn_bonuslen = newsize;
 	if (newsize == 0)
@@ -366,6 +377,21 @@ dnode_setbonuslen(dnode_t *dn, int newsize, dmu_tx_t *tx)
 	rw_exit(&dn->dn_struct_rwlock);
 }
 
+/*
+ * The largest bonus buffer the dnode behind bonus dbuf "db" can hold.
+ */
+int
+sa_bonus_max(dmu_buf_t *db)
+{
+	dmu_buf_impl_t *dbi = (dmu_buf_impl_t *)db;
+	int maxlen;
+
+	DB_DNODE_ENTER(dbi);
+	maxlen = DN_SLOTS_TO_BONUSLEN(DB_DNODE(dbi)->dn_num_slots);
+	DB_DNODE_EXIT(dbi);
+	return (maxlen);
+}
+
 void
 dnode_setbonus_type(dnode_t *dn, dmu_object_type_t newtype, dmu_tx_t *tx)
 {
@@ -435,6 +461,7 @@ dnode_create(objset_t *os, dnode_phys_t *dnp, dmu_buf_impl_t *db,
 	dn->dn_bonustype = dnp->dn_bonustype;
 	dn->dn_bonuslen = dnp->dn_bonuslen;
 	dn->dn_maxblkid = dnp->dn_maxblkid;
+	dn->dn_num_slots = dnp->dn_extra_slots + 1;
 	dn->dn_have_spill = ((dnp->dn_flags & DNODE_FLAG_SPILL_BLKPTR) != 0);
 	dn->dn_id_flags = 0;
 
@@ -534,10 +561,14 @@ dnode_destroy(dnode_t *dn)
 
 void
 dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
-    dmu_object_type_t bonustype, int bonuslen, dmu_tx_t *tx)
+    dmu_object_type_t bonustype, int bonuslen, int dn_slots, dmu_tx_t *tx)
 {
 	int i;
 
+	ASSERT3S(dn_slots, >=, DNODE_MIN_SLOTS);
+	ASSERT3S(dn_slots, <=, DNODE_MAX_SLOTS);
+	ASSERT(dn->dn_bonus == NULL || dn->dn_num_slots == dn_slots);
+
 	ASSERT3U(blocksize, <=,
 	    spa_maxblocksize(dmu_objset_spa(dn->dn_objset)));
 	if (blocksize == 0)
@@ -550,8 +581,8 @@ dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
 
 	ibs = MIN(MAX(ibs, DN_MIN_INDBLKSHIFT), DN_MAX_INDBLKSHIFT);
 
-	dprintf("os=%p obj=%llu txg=%llu blocksize=%d ibs=%d\n", dn->dn_objset,
-	    dn->dn_object, tx->tx_txg, blocksize, ibs);
+	dprintf("os=%p obj=%llu txg=%llu blocksize=%d ibs=%d dn_slots=%d\n",
+	    dn->dn_objset, dn->dn_object, tx->tx_txg, blocksize, ibs, dn_slots);
 
 	ASSERT(dn->dn_type == DMU_OT_NONE);
 	ASSERT(bcmp(dn->dn_phys, &dnode_phys_zero, sizeof (dnode_phys_t)) == 0);
@@ -562,13 +593,16 @@ dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
 	    (bonustype == DMU_OT_SA && bonuslen == 0) ||
 	    (bonustype != DMU_OT_NONE && bonuslen != 0));
 	ASSERT(DMU_OT_IS_VALID(bonustype));
-	ASSERT3U(bonuslen, <=, DN_MAX_BONUSLEN);
+	ASSERT3U(bonuslen, <=, DN_SLOTS_TO_BONUSLEN(dn_slots));
 	ASSERT(dn->dn_type == DMU_OT_NONE);
 	ASSERT0(dn->dn_maxblkid);
 	ASSERT0(dn->dn_allocated_txg);
 	ASSERT0(dn->dn_assigned_txg);
 	ASSERT(refcount_is_zero(&dn->dn_tx_holds));
-	ASSERT3U(refcount_count(&dn->dn_holds), <=, 1);
+	/*
+	 * dmu_object_alloc() callers racing for the same object may each
+	 * hold the dnode, so dn_holds can be more than one here.
+	 */
 	ASSERT(avl_is_empty(&dn->dn_dbufs));
 
 	for (i = 0; i < TXG_SIZE; i++) {
@@ -588,11 +622,13 @@ dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
 	dnode_setdblksz(dn, blocksize);
 	dn->dn_indblkshift = ibs;
 	dn->dn_nlevels = 1;
+	dn->dn_num_slots = dn_slots;
 	if (bonustype == DMU_OT_SA) /* Maximize bonus space for SA */
 		dn->dn_nblkptr = 1;
 	else
-		dn->dn_nblkptr = 1 +
-		    ((DN_MAX_BONUSLEN - bonuslen) >> SPA_BLKPTRSHIFT);
+		dn->dn_nblkptr = MIN(DN_MAX_NBLKPTR, 1 +
+		    ((DN_SLOTS_TO_BONUSLEN(dn_slots) - bonuslen) >>
+		    SPA_BLKPTRSHIFT));
 	dn->dn_bonustype = bonustype;
 	dn->dn_bonuslen = bonuslen;
 	dn->dn_checksum = ZIO_CHECKSUM_INHERIT;
@@ -608,6 +644,15 @@ dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
 	dn->dn_allocated_txg = tx->tx_txg;
 	dn->dn_id_flags = 0;
 
+	if (dn_slots > DNODE_MIN_SLOTS) {
+		dsl_dataset_t *ds = dn->dn_objset->os_dsl_dataset;
+
+		mutex_enter(&ds->ds_lock);
+		ds->ds_feature_activation_needed[SPA_FEATURE_LARGE_DNODE] =
+		    B_TRUE;
+		mutex_exit(&ds->ds_lock);
+	}
+
 	dnode_setdirty(dn, tx);
 	dn->dn_next_indblkshift[tx->tx_txg & TXG_MASK] = ibs;
 	dn->dn_next_bonuslen[tx->tx_txg & TXG_MASK] = dn->dn_bonuslen;
@@ -631,7 +676,7 @@ dnode_reallocate(dnode_t *dn, dmu_object_type_t ot, int blocksize,
 	    (bonustype != DMU_OT_NONE && bonuslen != 0) ||
 	    (bonustype == DMU_OT_SA && bonuslen == 0));
 	ASSERT(DMU_OT_IS_VALID(bonustype));
-	ASSERT3U(bonuslen, <=, DN_MAX_BONUSLEN);
+	ASSERT3U(bonuslen, <=, DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots));
 
 	/* clean up any unreferenced dbufs */
 	dnode_evict_dbufs(dn);
@@ -654,7 +699,9 @@ dnode_reallocate(dnode_t *dn, dmu_object_type_t ot, int blocksize,
 	if (bonustype == DMU_OT_SA) /* Maximize bonus space for SA */
 		nblkptr = 1;
 	else
-		nblkptr = 1 + ((DN_MAX_BONUSLEN - bonuslen) >> SPA_BLKPTRSHIFT);
+		nblkptr = MIN(DN_MAX_NBLKPTR, 1 +
+		    ((DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots) - bonuslen) >>
+		    SPA_BLKPTRSHIFT));
 	if (dn->dn_bonustype != bonustype)
 		dn->dn_next_bonustype[tx->tx_txg&TXG_MASK] = bonustype;
 	if (dn->dn_nblkptr != nblkptr)
@@ -680,7 +727,8 @@ dnode_reallocate(dnode_t *dn, dmu_object_type_t ot, int blocksize,
 	/* fix up the bonus db_size */
 	if (dn->dn_bonus) {
 		dn->dn_bonus->db.db_size =
-		    DN_MAX_BONUSLEN - (dn->dn_nblkptr-1) * sizeof (blkptr_t);
+		    DN_SLOTS_TO_BONUSLEN(dn->dn_num_slots) -
+		    (dn->dn_nblkptr-1) * sizeof (blkptr_t);
 		ASSERT(dn->dn_bonuslen <= dn->dn_bonus->db.db_size);
 	}
 
@@ -728,6 +776,7 @@ dnode_move_impl(dnode_t *odn, dnode_t *ndn)
 	ndn->dn_datablkszsec = odn->dn_datablkszsec;
 	ndn->dn_datablksz = odn->dn_datablksz;
 	ndn->dn_maxblkid = odn->dn_maxblkid;
+	ndn->dn_num_slots = odn->dn_num_slots;
 	bcopy(&odn->dn_next_nblkptr[0], &ndn->dn_next_nblkptr[0],
 	    sizeof (odn->dn_next_nblkptr));
 	bcopy(&odn->dn_next_nlevels[0], &ndn->dn_next_nlevels[0],
@@ -1048,18 +1097,124 @@ dnode_buf_pageout(void *dbu)
 		zrl_destroy(&dnh->dnh_zrlock);
 		dnh->dnh_dnode = NULL;
 	}
+	mutex_destroy(&children_dnodes->dnc_slot_lock);
 	kmem_free(children_dnodes, sizeof (dnode_children_t) +
 	    children_dnodes->dnc_count * sizeof (dnode_handle_t));
 }
 
+/*
+ * Mark the interior slots of the large dnodes in a newly read dnode block.
+ * Nothing in the block is instantiated yet, so its contents are current.
+ */
+static void
+dnode_init_slots(dnode_children_t *children_dnodes, dnode_phys_t *dnp)
+{
+	int i, j, slots;
+
+	for (i = 0; i < children_dnodes->dnc_count; i += slots) {
+		slots = 1;
+		if (dnp[i].dn_type != DMU_OT_NONE)
+			slots += dnp[i].dn_extra_slots;
+		for (j = i + 1; j < i + slots && j < children_dnodes->dnc_count;
+		    j++)
+			children_dnodes->dnc_children[j].dnh_interior = B_TRUE;
+	}
+}
+
+/*
+ * Can the "count" slots starting at "idx" become the interior of a new
+ * large dnode?  Each must be free, and any dnode instantiated in it must
+ * be idle and not awaiting the sync of its free.
+ */
+static boolean_t
+dnode_slots_free(dnode_children_t *children_dnodes, dmu_buf_impl_t *db,
+    int idx, int count)
+{
+	int i;
+
+	ASSERT(MUTEX_HELD(&children_dnodes->dnc_slot_lock));
+
+	for (i = idx; i < idx + count; i++) {
+		dnode_handle_t *dnh = &children_dnodes->dnc_children[i];
+		dnode_phys_t *dnp = (dnode_phys_t *)db->db.db_data + i;
+		boolean_t isfree;
+		dnode_t *dn;
+
+		if (dnh->dnh_interior)
+			return (B_FALSE);
+
+		zrl_add(&dnh->dnh_zrlock);
+		dn = dnh->dnh_dnode;
+		if (dn == NULL) {
+			isfree = (dnp->dn_type == DMU_OT_NONE);
+		} else {
+			mutex_enter(&dn->dn_mtx);
+			isfree = (dn->dn_type == DMU_OT_NONE &&
+			    dn->dn_free_txg == 0 &&
+			    refcount_is_zero(&dn->dn_holds));
+			mutex_exit(&dn->dn_mtx);
+		}
+		zrl_remove(&dnh->dnh_zrlock);
+		if (!isfree)
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static void
+dnode_set_interior(dnode_children_t *children_dnodes, int idx, int count,
+    boolean_t interior)
+{
+	int i;
+
+	ASSERT(MUTEX_HELD(&children_dnodes->dnc_slot_lock));
+
+	for (i = idx; i < idx + count; i++) {
+		ASSERT(children_dnodes->dnc_children[i].dnh_interior !=
+		    interior);
+		children_dnodes->dnc_children[i].dnh_interior = interior;
+	}
+}
+
+/*
+ * Called in syncing context once the free of a large dnode has zeroed its
+ * slots, to make its interior slots available again.
+ */
+void
+dnode_free_interior_slots(dnode_t *dn)
+{
+	dnode_children_t *children_dnodes;
+	int idx;
+
+	if (dn->dn_num_slots <= DNODE_MIN_SLOTS)
+		return;
+
+	children_dnodes = dmu_buf_get_user(&dn->dn_dbuf->db);
+	ASSERT(children_dnodes != NULL);
+	idx = dn->dn_handle - &children_dnodes->dnc_children[0];
+	ASSERT3S(idx + dn->dn_num_slots, <=, children_dnodes->dnc_count);
+
+	mutex_enter(&children_dnodes->dnc_slot_lock);
+	dnode_set_interior(children_dnodes, idx + 1, dn->dn_num_slots - 1,
+	    B_FALSE);
+	mutex_exit(&children_dnodes->dnc_slot_lock);
+}
+
 /*
  * errors:
  * EINVAL - invalid object number.
+ * ENOSPC - DNODE_MUST_BE_FREE and "slots" would run past the end of
+ *          the dnode block.
  * EIO - i/o error.
  * succeeds even for free dnodes.
+ *
+ * A successful DNODE_MUST_BE_FREE hold also reserves the slots-1 slots
+ * after the object as the interior of a large dnode, so the caller must
+ * go on to dnode_allocate() it with that many slots.  Other holds pass
+ * zero for "slots".
  */
 int
-dnode_hold_impl(objset_t *os, uint64_t object, int flag,
+dnode_hold_impl(objset_t *os, uint64_t object, int flag, int slots,
     void *tag, dnode_t **dnp)
 {
 	int epb, idx, err;
@@ -1080,6 +1235,8 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 	ASSERT(spa_config_held(os->os_spa, SCL_ALL, RW_WRITER) == 0 ||
 	    (spa_is_root(os->os_spa) &&
 	    spa_config_held(os->os_spa, SCL_STATE, RW_WRITER)));
+	ASSERT(!(flag & DNODE_MUST_BE_FREE) ||
+	    (slots >= DNODE_MIN_SLOTS && slots <= DNODE_MAX_SLOTS));
 
 	if (object == DMU_USERUSED_OBJECT || object == DMU_GROUPUSED_OBJECT) {
 		dn = (object == DMU_USERUSED_OBJECT) ?
@@ -1136,10 +1293,13 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 		children_dnodes = kmem_zalloc(sizeof (dnode_children_t) +
 		    epb * sizeof (dnode_handle_t), KM_SLEEP);
 		children_dnodes->dnc_count = epb;
+		mutex_init(&children_dnodes->dnc_slot_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
 		dnh = &children_dnodes->dnc_children[0];
 		for (i = 0; i < epb; i++) {
 			zrl_init(&dnh[i].dnh_zrlock);
 		}
+		dnode_init_slots(children_dnodes, db->db.db_data);
 		dmu_buf_init_user(&children_dnodes->dnc_dbu,
 		    dnode_buf_pageout, NULL);
 		winner = dmu_buf_set_user(&db->db, &children_dnodes->dnc_dbu);
@@ -1148,6 +1308,7 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 			for (i = 0; i < epb; i++) {
 				zrl_destroy(&dnh[i].dnh_zrlock);
 			}
+			mutex_destroy(&children_dnodes->dnc_slot_lock);
 
 			kmem_free(children_dnodes, sizeof (dnode_children_t) +
 			    epb * sizeof (dnode_handle_t));
@@ -1156,7 +1317,34 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 	}
 	ASSERT(children_dnodes->dnc_count == epb);
 
+	/*
+	 * Allocations are serialized on the slot lock, so that two of them
+	 * cannot both claim a slot, one as a dnode and one as the interior
+	 * of a large dnode.
+	 */
+	if (flag & DNODE_MUST_BE_FREE) {
+		if (idx + slots > epb) {
+			dbuf_rele(db, FTAG);
+			return (SET_ERROR(ENOSPC));
+		}
+		mutex_enter(&children_dnodes->dnc_slot_lock);
+		if (!dnode_slots_free(children_dnodes, db, idx + 1,
+		    slots - 1)) {
+			mutex_exit(&children_dnodes->dnc_slot_lock);
+			dbuf_rele(db, FTAG);
+			return (SET_ERROR(EEXIST));
+		}
+	}
+
 	dnh = &children_dnodes->dnc_children[idx];
+	if (dnh->dnh_interior) {
+		if (flag & DNODE_MUST_BE_FREE)
+			mutex_exit(&children_dnodes->dnc_slot_lock);
+		dbuf_rele(db, FTAG);
+		return ((flag & DNODE_MUST_BE_FREE) ?
+		    SET_ERROR(EEXIST) : SET_ERROR(ENOENT));
+	}
+
 	zrl_add(&dnh->dnh_zrlock);
 	dn = dnh->dnh_dnode;
 	if (dn == NULL) {
@@ -1173,6 +1361,8 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 	    (type != DMU_OT_NONE || !refcount_is_zero(&dn->dn_holds)))) {
 		mutex_exit(&dn->dn_mtx);
 		zrl_remove(&dnh->dnh_zrlock);
+		if (flag & DNODE_MUST_BE_FREE)
+			mutex_exit(&children_dnodes->dnc_slot_lock);
 		dbuf_rele(db, FTAG);
 		return (type == DMU_OT_NONE ? ENOENT : EEXIST);
 	}
@@ -1180,6 +1370,23 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 		dbuf_add_ref(db, dnh);
 	mutex_exit(&dn->dn_mtx);
 
+	if (flag & DNODE_MUST_BE_FREE) {
+		dnode_set_interior(children_dnodes, idx + 1, slots - 1,
+		    B_TRUE);
+		mutex_exit(&children_dnodes->dnc_slot_lock);
+
+		/*
+		 * A bonus dbuf left over from the object's previous life is
+		 * sized for its slot count, so it must go before the count
+		 * changes.  Nothing can hold it without holding the dnode.
+		 */
+		if (dn->dn_num_slots != slots) {
+			dnode_evict_bonus(dn);
+			ASSERT3P(dn->dn_bonus, ==, NULL);
+			dn->dn_num_slots = slots;
+		}
+	}
+
 	/* Now we can rely on the hold to prevent the dnode from moving. */
 	zrl_remove(&dnh->dnh_zrlock);
 
@@ -1198,7 +1405,8 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag,
 int
 dnode_hold(objset_t *os, uint64_t object, void *tag, dnode_t **dnp)
 {
-	return (dnode_hold_impl(os, object, DNODE_MUST_BE_ALLOCATED, tag, dnp));
+	return (dnode_hold_impl(os, object, DNODE_MUST_BE_ALLOCATED, 0,
+	    tag, dnp));
 }
 
 /*
@@ -1822,7 +2030,7 @@ dnode_willuse_space(dnode_t *dn, int64_t space, dmu_tx_t *tx)
 
 	if (ds != NULL) {
 		dsl_dir_willuse_space(ds->ds_dir, aspace, tx);
-		dsl_pool_dirty_space(dmu_tx_pool(tx), space, tx);
+		dsl_pool_dirty_space(dmu_tx_pool(tx), ds->ds_dir, space, tx);
 	}
 
 	dmu_tx_willuse_space(tx, aspace);
@@ -1905,17 +2113,40 @@ dnode_next_offset_level(dnode_t *dn, int flags, uint64_t *offset,
 		error = SET_ERROR(ESRCH);
 	} else if (lvl == 0) {
 		dnode_phys_t *dnp = data;
+		int start, match, slots;
+
 		span = DNODE_SHIFT;
 		ASSERT(dn->dn_type == DMU_OT_DNODE);
 
-		for (i = (*offset >> span) & (blkfill - 1);
-		    i >= 0 && i < blkfill; i += inc) {
-			if ((dnp[i].dn_type == DMU_OT_NONE) == hole)
+		/*
+		 * Only the first slot of a large dnode says anything about
+		 * it; the rest hold its block pointers and bonus buffer.  So
+		 * walk the block a dnode at a time from its start, and
+		 * neither stop at nor report an interior slot.
+		 */
+		start = (*offset >> span) & (blkfill - 1);
+		match = -1;
+		for (i = 0; i < blkfill; i += slots) {
+			slots = 1;
+			if (dnp[i].dn_type != DMU_OT_NONE)
+				slots += dnp[i].dn_extra_slots;
+			if (inc > 0 && i < start)
+				continue;
+			if (inc < 0 && i > start)
 				break;
-			*offset += (1ULL << span) * inc;
+			if ((dnp[i].dn_type == DMU_OT_NONE) == hole) {
+				match = i;
+				if (inc > 0)
+					break;
+			}
 		}
-		if (i < 0 || i == blkfill)
+		if (match >= 0) {
+			*offset += (1ULL << span) * (match - start);
+		} else {
+			*offset += (1ULL << span) *
+			    (inc > 0 ? blkfill - start : -(start + 1));
 			error = SET_ERROR(ESRCH);
+		}
 	} else {
 		blkptr_t *bp = data;
 		uint64_t start = *offset;
@@ -1604,7 +1604,27 @@ dsl_dataset_snapshot_tmp(const char *fsname, const char *snapname,
 	return (error);
 }
 
+typedef struct dsl_dataset_sync_arg {
+	objset_t	*dssa_os;
+	zio_t		*dssa_zio;
+	dmu_tx_t	*dssa_tx;
+} dsl_dataset_sync_arg_t;
 
+static void
+dsl_dataset_sync_objset_task(void *arg)
+{
+	dsl_dataset_sync_arg_t *dssa = arg;
+
+	dmu_objset_sync(dssa->dssa_os, dssa->dssa_zio, dssa->dssa_tx);
+	kmem_free(dssa, sizeof (*dssa));
+}
+
+/*
+ * Sync out the dataset's dirty state.  The objset itself, which holds most
+ * of the work, is synced on the pool's dp_sync_taskq, so that independent
+ * datasets sync in parallel; the caller must taskq_wait() for it before
+ * waiting on the zio.
+ */
 void
 dsl_dataset_sync(dsl_dataset_t *ds, zio_t *zio, dmu_tx_t *tx)
 {
@@ -1634,7 +1654,12 @@ dsl_dataset_sync(dsl_dataset_t *ds, zio_t *zio, dmu_tx_t *tx)
 		ds->ds_resume_bytes[tx->tx_txg & TXG_MASK] = 0;
 	}
 
-	dmu_objset_sync(ds->ds_objset, zio, tx);
+	dsl_dataset_sync_arg_t *dssa = kmem_alloc(sizeof (*dssa), KM_SLEEP);
+	dssa->dssa_os = ds->ds_objset;
+	dssa->dssa_zio = zio;
+	dssa->dssa_tx = tx;
+	(void) taskq_dispatch(tx->tx_pool->dp_sync_taskq,
+	    dsl_dataset_sync_objset_task, dssa, TQ_SLEEP);
 
 	for (spa_feature_t f = 0; f < SPA_FEATURES; f++) {
 		if (ds->ds_feature_activation_needed[f]) {
@@ -1731,6 +1756,10 @@ get_receive_resume_stats(dsl_dataset_t *ds, nvlist_t *nv)
 		    DS_FIELD_RESUME_EMBEDOK) == 0) {
 			fnvlist_add_boolean(token_nv, "embedok");
 		}
+		if (zap_contains(dp->dp_meta_objset, ds->ds_object,
+		    DS_FIELD_RESUME_COMPRESSOK) == 0) {
+			fnvlist_add_boolean(token_nv, "compressok");
+		}
 		packed = fnvlist_pack(token_nv, &packed_size);
 		fnvlist_free(token_nv);
 		compressed = kmem_alloc(packed_size, KM_SLEEP);
@@ -42,6 +42,15 @@
 #include <sys/dsl_deleg.h>
 #include <sys/dmu_impl.h>
 
+/*
+ * Destroying a snapshot merges its deadlist into the next snapshot's, which
+ * takes time in proportion to the number of snapshots that came before it.
+ * Once a "zfs destroy" of many snapshots has spent this long in a txg, the
+ * rest of them are queued and destroyed in later txgs, up to this long in
+ * each.
+ */
+int zfs_destroy_snapshot_max_time_ms = 500;
+
 typedef struct dmu_snapshots_destroy_arg {
 	nvlist_t *dsda_snaps;
 	nvlist_t *dsda_successful_snaps;
@@ -261,6 +270,12 @@ dsl_destroy_snapshot_sync_impl(dsl_dataset_t *ds, boolean_t defer, dmu_tx_t *tx)
 
 	ASSERT3U(dsl_dataset_phys(ds)->ds_num_children, <=, 1);
 
+	if (dp->dp_destroy_queue_obj != 0) {
+		err = zap_remove_int(mos, dp->dp_destroy_queue_obj,
+		    ds->ds_object, tx);
+		VERIFY(err == 0 || err == ENOENT);
+	}
+
 	/* We need to log before removing it from the namespace. */
 	spa_history_log_internal_ds(ds, "destroy", tx, "");
 
@@ -471,13 +486,45 @@ dsl_destroy_snapshot_sync_impl(dsl_dataset_t *ds, boolean_t defer, dmu_tx_t *tx)
 	dmu_object_free_zapified(mos, obj, tx);
 }
 
+/*
+ * Queue a snapshot to be destroyed by dsl_destroy_queue_sync().  Until then
+ * it is marked for deferred destruction, so that if it gains a hold or a
+ * clone in the meantime, it will be destroyed when that goes away instead.
+ */
+static void
+dsl_destroy_snapshot_enqueue(dsl_dataset_t *ds, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = ds->ds_dir->dd_pool;
+	objset_t *mos = dp->dp_meta_objset;
+	int err;
+
+	if (dp->dp_destroy_queue_obj == 0) {
+		dp->dp_destroy_queue_obj = zap_create(mos,
+		    DMU_OTN_ZAP_METADATA, DMU_OT_NONE, 0, tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DESTROY_QUEUE, sizeof (uint64_t), 1,
+		    &dp->dp_destroy_queue_obj, tx));
+	}
+	err = zap_add_int(mos, dp->dp_destroy_queue_obj, ds->ds_object, tx);
+	VERIFY(err == 0 || err == EEXIST);
+	dp->dp_destroy_queue_stalled = B_FALSE;
+
+	dmu_buf_will_dirty(ds->ds_dbuf, tx);
+	dsl_dataset_phys(ds)->ds_flags |= DS_FLAG_DEFER_DESTROY;
+	spa_history_log_internal_ds(ds, "queue_destroy", tx, "");
+}
+
 static void
 dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
 {
 	dmu_snapshots_destroy_arg_t *dsda = arg;
 	dsl_pool_t *dp = dmu_tx_pool(tx);
+	hrtime_t start = gethrtime();
+	boolean_t queue;
 	nvpair_t *pair;
 
+	queue = (spa_version(dp->dp_spa) >= SPA_VERSION_FEATURES);
+
 	for (pair = nvlist_next_nvpair(dsda->dsda_successful_snaps, NULL);
 	    pair != NULL;
 	    pair = nvlist_next_nvpair(dsda->dsda_successful_snaps, pair)) {
@@ -485,9 +532,116 @@ dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
 
 		VERIFY0(dsl_dataset_hold(dp, nvpair_name(pair), FTAG, &ds));
 
-		dsl_destroy_snapshot_sync_impl(ds, dsda->dsda_defer, tx);
+		if (queue && NSEC2MSEC(gethrtime() - start) >
+		    zfs_destroy_snapshot_max_time_ms)
+			dsl_destroy_snapshot_enqueue(ds, tx);
+		else
+			dsl_destroy_snapshot_sync_impl(ds, dsda->dsda_defer, tx);
+		dsl_dataset_rele(ds, FTAG);
+	}
+}
+
+/*
+ * Destroy the snapshots queued by dsl_destroy_snapshot_enqueue(), until
+ * zfs_destroy_snapshot_max_time_ms has passed.  Called in syncing context,
+ * in the first pass of each txg, so the queue is picked up again after the
+ * pool is exported or the system reboots.
+ */
+void
+dsl_destroy_queue_sync(dsl_pool_t *dp, dmu_tx_t *tx)
+{
+	objset_t *mos = dp->dp_meta_objset;
+	hrtime_t start = gethrtime();
+	uint64_t destroyed = 0, skipped = 0, count;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT3U(dp->dp_destroy_queue_obj, !=, 0);
+
+	rrw_enter(&dp->dp_config_rwlock, RW_WRITER, FTAG);
+	for (zap_cursor_init(&zc, mos, dp->dp_destroy_queue_obj);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		dsl_dataset_t *ds;
+		int err;
+
+		if (destroyed != 0 && NSEC2MSEC(gethrtime() - start) >
+		    zfs_destroy_snapshot_max_time_ms)
+			break;
+		if (spa_shutting_down(dp->dp_spa))
+			break;
+
+		err = dsl_dataset_hold_obj(dp, za.za_first_integer,
+		    FTAG, &ds);
+		if (err == 0 && dsl_dataset_long_held(ds)) {
+			/* Being sent or mounted; try again next txg. */
+			dsl_dataset_rele(ds, FTAG);
+			skipped++;
+			continue;
+		}
+		VERIFY0(zap_remove_int(mos, dp->dp_destroy_queue_obj,
+		    za.za_first_integer, tx));
+		if (err != 0)
+			continue;
+
+		/*
+		 * If the snapshot has gained a hold or a clone since it was
+		 * queued, this leaves it marked for deferred destruction.
+		 */
+		dsl_destroy_snapshot_sync_impl(ds, B_TRUE, tx);
 		dsl_dataset_rele(ds, FTAG);
+		destroyed++;
+	}
+	zap_cursor_fini(&zc);
+
+	VERIFY0(zap_count(mos, dp->dp_destroy_queue_obj, &count));
+	if (count == 0) {
+		VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DESTROY_QUEUE, tx));
+		VERIFY0(zap_destroy(mos, dp->dp_destroy_queue_obj, tx));
+		dp->dp_destroy_queue_obj = 0;
 	}
+	rrw_exit(&dp->dp_config_rwlock, FTAG);
+
+	/*
+	 * Don't keep syncing txgs on behalf of the queue if nothing in it
+	 * could be destroyed; it will be retried with the next txg anyway.
+	 */
+	dp->dp_destroy_queue_stalled = (destroyed == 0 && skipped != 0);
+
+	if (destroyed != 0) {
+		zfs_dbgmsg("destroyed %llu queued snapshots in %llums "
+		    "txg %llu; %llu left", (longlong_t)destroyed,
+		    (longlong_t)NSEC2MSEC(gethrtime() - start),
+		    (longlong_t)tx->tx_txg, (longlong_t)count);
+	}
+}
+
+/*
+ * Returns true if there are queued snapshots that dsl_destroy_queue_sync()
+ * can make progress on.
+ */
+boolean_t
+dsl_destroy_queue_active(dsl_pool_t *dp)
+{
+	return (dp->dp_destroy_queue_obj != 0 &&
+	    !dp->dp_destroy_queue_stalled);
+}
+
+/*
+ * Number of snapshots waiting in the destroy queue, for the "destroying"
+ * pool property.
+ */
+uint64_t
+dsl_destroy_queue_count(dsl_pool_t *dp)
+{
+	uint64_t obj = dp->dp_destroy_queue_obj;
+	uint64_t count;
+
+	if (obj == 0 || zap_count(dp->dp_meta_objset, obj, &count) != 0)
+		return (0);
+	return (count);
 }
 
 /*
@@ -79,6 +79,13 @@
  * zfs_dirty_data_max determines the dirty space limit. Once that value is
  * exceeded, new writes are halted until space frees up.
  *
+ * Dirty space is also accounted to the dsl_dir being written to
+ * (dd_dirty_pertxg[] and dd_dirty_total), and dp_dirty_ndirs counts the
+ * dsl_dirs that have any.  Once the pool is above the delay threshold,
+ * only transactions for dsl_dirs holding at least their fair share of the
+ * pool's dirty data (see zfs_dirty_data_fair) are delayed, so that one
+ * heavy writer doesn't delay every other consumer of the pool.
+ *
  * The zfs_dirty_data_sync tunable dictates the threshold at which we
  * ensure that there is a txg syncing (see the comment in txg.c for a full
  * description of transaction group stages).
@@ -111,6 +118,19 @@ uint64_t zfs_dirty_data_sync = 64 * 1024 * 1024;
  */
 int zfs_delay_min_dirty_percent = 60;
 
+/*
+ * If set, a transaction is only delayed (below zfs_dirty_data_max) if its
+ * dsl_dir has at least an equal share of the dirty data of all dsl_dirs
+ * with dirty data.
+ */
+boolean_t zfs_dirty_data_fair = B_TRUE;
+
+/*
+ * Number of threads, as a percentage of CPUs, that sync the objsets of
+ * dirty datasets in parallel (see dsl_dataset_sync()).
+ */
+int zfs_sync_taskq_batch_pct = 75;
+
 /*
  * This controls how quickly the delay approaches infinity.
  * Larger values cause it to delay more for a given amount of dirty data.
@@ -154,7 +174,7 @@ dsl_pool_open_impl(spa_t *spa, uint64_t txg)
 	dp = kmem_zalloc(sizeof (dsl_pool_t), KM_SLEEP);
 	dp->dp_spa = spa;
 	dp->dp_meta_rootbp = *bp;
-	rrw_init(&dp->dp_config_rwlock, B_TRUE);
+	rrw_init_percpu(&dp->dp_config_rwlock);
 	txg_init(dp, txg);
 
 	txg_list_create(&dp->dp_dirty_datasets,
@@ -171,6 +191,9 @@ dsl_pool_open_impl(spa_t *spa, uint64_t txg)
 
 	dp->dp_vnrele_taskq = taskq_create("zfs_vn_rele_taskq", 1, minclsyspri,
 	    1, 4, 0);
+	dp->dp_sync_taskq = taskq_create("dp_sync_taskq",
+	    zfs_sync_taskq_batch_pct, minclsyspri, 1, INT_MAX,
+	    TASKQ_THREADS_CPU_PCT);
 
 	return (dp);
 }
@@ -277,6 +300,14 @@ dsl_pool_open(dsl_pool_t *dp)
 	if (err)
 		goto out;
 
+	err = zap_lookup(dp->dp_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
+	    DMU_POOL_DESTROY_QUEUE, sizeof (uint64_t), 1,
+	    &dp->dp_destroy_queue_obj);
+	if (err == ENOENT)
+		err = 0;
+	if (err)
+		goto out;
+
 	err = dsl_scan_init(dp, dp->dp_tx.tx_open_txg);
 
 out:
@@ -331,6 +362,7 @@ dsl_pool_close(dsl_pool_t *dp)
 	rrw_destroy(&dp->dp_config_rwlock);
 	mutex_destroy(&dp->dp_lock);
 	taskq_destroy(dp->dp_vnrele_taskq);
+	taskq_destroy(dp->dp_sync_taskq);
 	if (dp->dp_blkstats)
 		kmem_free(dp->dp_blkstats, sizeof (zfs_all_blkstats_t));
 	kmem_free(dp, sizeof (dsl_pool_t));
@@ -458,6 +490,32 @@ dsl_pool_dirty_delta(dsl_pool_t *dp, int64_t delta)
 		cv_signal(&dp->dp_spaceavail_cv);
 }
 
+/*
+ * Account dirty space to (or, if delta is negative, retire it from) the
+ * given txg of a dsl_dir.
+ */
+static void
+dsl_pool_dir_dirty_delta(dsl_pool_t *dp, dsl_dir_t *dd, int64_t delta,
+    uint64_t txg)
+{
+	ASSERT(MUTEX_HELD(&dp->dp_lock));
+
+	/* as for the pool, don't retire space that we didn't dirty */
+	if (delta < 0 && -delta > dd->dd_dirty_pertxg[txg & TXG_MASK])
+		delta = -(int64_t)dd->dd_dirty_pertxg[txg & TXG_MASK];
+	if (delta == 0)
+		return;
+
+	if (dd->dd_dirty_total == 0)
+		dp->dp_dirty_ndirs++;
+	dd->dd_dirty_pertxg[txg & TXG_MASK] += delta;
+	dd->dd_dirty_total += delta;
+	if (dd->dd_dirty_total == 0) {
+		ASSERT3U(dp->dp_dirty_ndirs, >, 0);
+		dp->dp_dirty_ndirs--;
+	}
+}
+
 void
 dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 {
@@ -487,6 +545,8 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 		list_insert_tail(&synced_datasets, ds);
 		dsl_dataset_sync(ds, zio, tx);
 	}
+	/* wait for the objsets to be synced before waiting on their zios */
+	taskq_wait(dp->dp_sync_taskq);
 	VERIFY0(zio_wait(zio));
 
 	/*
@@ -496,7 +556,16 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 	 * rounding error in dbuf_write_physdone).
 	 * Shore up the accounting of any dirtied space now.
 	 */
-	dsl_pool_undirty_space(dp, dp->dp_dirty_pertxg[txg & TXG_MASK], txg);
+	dsl_pool_undirty_space(dp, NULL, dp->dp_dirty_pertxg[txg & TXG_MASK],
+	    txg);
+	mutex_enter(&dp->dp_lock);
+	for (ds = list_head(&synced_datasets); ds != NULL;
+	    ds = list_next(&synced_datasets, ds)) {
+		dd = ds->ds_dir;
+		dsl_pool_dir_dirty_delta(dp, dd,
+		    -(int64_t)dd->dd_dirty_pertxg[txg & TXG_MASK], txg);
+	}
+	mutex_exit(&dp->dp_lock);
 
 	/*
 	 * After the data blocks have been written (ensured by the zio_wait()
@@ -520,6 +589,7 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 		dmu_buf_rele(ds->ds_dbuf, ds);
 		dsl_dataset_sync(ds, zio, tx);
 	}
+	taskq_wait(dp->dp_sync_taskq);
 	VERIFY0(zio_wait(zio));
 
 	/*
@@ -629,8 +699,12 @@ dsl_pool_adjustedsize(dsl_pool_t *dp, boolean_t netfree)
 	return (space - resv);
 }
 
+/*
+ * Returns B_TRUE if a transaction writing to the given dsl_dir (which may
+ * be NULL) should be delayed.
+ */
 boolean_t
-dsl_pool_need_dirty_delay(dsl_pool_t *dp)
+dsl_pool_need_dirty_delay(dsl_pool_t *dp, dsl_dir_t *dd)
 {
 	uint64_t delay_min_bytes =
 	    zfs_dirty_data_max * zfs_delay_min_dirty_percent / 100;
@@ -640,23 +714,33 @@ dsl_pool_need_dirty_delay(dsl_pool_t *dp)
 	if (dp->dp_dirty_total > zfs_dirty_data_sync)
 		txg_kick(dp);
 	rv = (dp->dp_dirty_total > delay_min_bytes);
+	if (rv && zfs_dirty_data_fair && dd != NULL &&
+	    dp->dp_dirty_total < zfs_dirty_data_max) {
+		uint64_t fair_share =
+		    dp->dp_dirty_total / MAX(dp->dp_dirty_ndirs, 1);
+		rv = (dd->dd_dirty_total >= fair_share);
+	}
 	mutex_exit(&dp->dp_lock);
 	return (rv);
 }
 
 void
-dsl_pool_dirty_space(dsl_pool_t *dp, int64_t space, dmu_tx_t *tx)
+dsl_pool_dirty_space(dsl_pool_t *dp, dsl_dir_t *dd, int64_t space,
+    dmu_tx_t *tx)
 {
 	if (space > 0) {
 		mutex_enter(&dp->dp_lock);
 		dp->dp_dirty_pertxg[tx->tx_txg & TXG_MASK] += space;
+		if (dd != NULL)
+			dsl_pool_dir_dirty_delta(dp, dd, space, tx->tx_txg);
 		dsl_pool_dirty_delta(dp, space);
 		mutex_exit(&dp->dp_lock);
 	}
 }
 
 void
-dsl_pool_undirty_space(dsl_pool_t *dp, int64_t space, uint64_t txg)
+dsl_pool_undirty_space(dsl_pool_t *dp, dsl_dir_t *dd, int64_t space,
+    uint64_t txg)
 {
 	ASSERT3S(space, >=, 0);
 	if (space == 0)
@@ -668,6 +752,8 @@ dsl_pool_undirty_space(dsl_pool_t *dp, int64_t space, uint64_t txg)
 	}
 	ASSERT3U(dp->dp_dirty_pertxg[txg & TXG_MASK], >=, space);
 	dp->dp_dirty_pertxg[txg & TXG_MASK] -= space;
+	if (dd != NULL)
+		dsl_pool_dir_dirty_delta(dp, dd, -space, txg);
 	ASSERT3U(dp->dp_dirty_total, >=, space);
 	dsl_pool_dirty_delta(dp, -space);
 	mutex_exit(&dp->dp_lock);
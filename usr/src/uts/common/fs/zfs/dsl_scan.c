@@ -30,6 +30,7 @@
 #include <sys/dsl_prop.h>
 #include <sys/dsl_dir.h>
 #include <sys/dsl_synctask.h>
+#include <sys/dsl_destroy.h>
 #include <sys/dnode.h>
 #include <sys/dmu_tx.h>
 #include <sys/dmu_objset.h>
@@ -58,6 +59,10 @@ static scan_cb_t dsl_scan_scrub_cb;
 static void dsl_scan_cancel_sync(void *, dmu_tx_t *);
 static void dsl_scan_sync_state(dsl_scan_t *, dmu_tx_t *);
 static boolean_t dsl_scan_restarting(dsl_scan_t *, dmu_tx_t *);
+static void dsl_scan_queues_create(dsl_scan_t *);
+static void dsl_scan_queues_destroy(dsl_scan_t *);
+static void dsl_scan_issue(dsl_scan_t *);
+static uint64_t dsl_scan_issue_time(dsl_scan_t *);
 
 int zfs_top_maxinflight = 32;		/* maximum I/Os per top-level */
 int zfs_resilver_delay = 2;		/* number of ticks to delay resilver */
@@ -74,6 +79,18 @@ int dsl_scan_delay_completion = B_FALSE; /* set to delay scan completion */
 /* max number of blocks to free in a single TXG */
 uint64_t zfs_free_max_blocks = UINT64_MAX;
 
+/*
+ * Scrub and resilver I/Os are sorted by on-disk offset before being issued
+ * (see dsl_scan_issue()).  zfs_scan_queue_max_bytes bounds the memory used
+ * to hold the queued block pointers; when it is exceeded the queues are
+ * issued early.  The time the queued I/O will take to issue counts against
+ * the same per-txg budget as the traversal (see dsl_scan_check_pause()).
+ * Setting zfs_scan_legacy reverts to issuing each I/O as soon as the
+ * traversal finds it.
+ */
+uint64_t zfs_scan_queue_max_bytes = 16 << 20;
+boolean_t zfs_scan_legacy = B_FALSE;
+
 #define	DSL_SCAN_IS_SCRUB_RESILVER(scn) \
 	((scn)->scn_phys.scn_func == POOL_SCAN_SCRUB || \
 	(scn)->scn_phys.scn_func == POOL_SCAN_RESILVER)
@@ -435,10 +452,15 @@ dsl_scan_check_pause(dsl_scan_t *scn, const zbookmark_phys_t *zb)
 	 *  or
 	 *  - the spa is shutting down because this pool is being exported
 	 *    or the machine is rebooting.
+	 *
+	 * The I/O waiting on the sorted queues must be issued before this
+	 * txg's scan is over, so the time that will take is counted as
+	 * already spent.
 	 */
 	int mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
 	    zfs_resilver_min_time_ms : zfs_scan_min_time_ms;
-	uint64_t elapsed_nanosecs = gethrtime() - scn->scn_sync_start_time;
+	uint64_t elapsed_nanosecs = gethrtime() - scn->scn_sync_start_time +
+	    dsl_scan_issue_time(scn);
 	int dirty_pct = scn->scn_dp->dp_dirty_total * 100 / zfs_dirty_data_max;
 	if (elapsed_nanosecs / NANOSEC >= zfs_txg_timeout ||
 	    (NSEC2MSEC(elapsed_nanosecs) > mintime &&
@@ -665,14 +687,18 @@ dsl_scan_recurse(dsl_scan_t *scn, dsl_dataset_t *ds, dmu_objset_type_t ostype,
 			scn->scn_phys.scn_errors++;
 			return (err);
 		}
-		for (i = 0, cdnp = buf->b_data; i < epb; i++, cdnp++) {
+		for (i = 0, cdnp = buf->b_data; i < epb;
+		    i += cdnp->dn_extra_slots + 1,
+		    cdnp += cdnp->dn_extra_slots + 1) {
 			for (j = 0; j < cdnp->dn_nblkptr; j++) {
 				blkptr_t *cbp = &cdnp->dn_blkptr[j];
 				dsl_scan_prefetch(scn, buf, cbp,
 				    zb->zb_objset, zb->zb_blkid * epb + i, j);
 			}
 		}
-		for (i = 0, cdnp = buf->b_data; i < epb; i++, cdnp++) {
+		for (i = 0, cdnp = buf->b_data; i < epb;
+		    i += cdnp->dn_extra_slots + 1,
+		    cdnp += cdnp->dn_extra_slots + 1) {
 			dsl_scan_visitdnode(scn, ds, ostype,
 			    cdnp, zb->zb_blkid * epb + i, tx);
 		}
@@ -735,7 +761,7 @@ dsl_scan_visitdnode(dsl_scan_t *scn, dsl_dataset_t *ds,
 		zbookmark_phys_t czb;
 		SET_BOOKMARK(&czb, ds ? ds->ds_object : 0, object,
 		    0, DMU_SPILL_BLKID);
-		dsl_scan_visitbp(&dnp->dn_spill,
+		dsl_scan_visitbp(DN_SPILL_BLKPTR(dnp),
 		    &czb, dnp, ds, scn, ostype, tx);
 	}
 }
@@ -1434,7 +1460,8 @@ dsl_scan_active(dsl_scan_t *scn)
 	if (spa_shutting_down(spa))
 		return (B_FALSE);
 	if (scn->scn_phys.scn_state == DSS_SCANNING ||
-	    (scn->scn_async_destroying && !scn->scn_async_stalled))
+	    (scn->scn_async_destroying && !scn->scn_async_stalled) ||
+	    dsl_destroy_queue_active(scn->scn_dp))
 		return (B_TRUE);
 
 	if (spa_version(scn->scn_dp->dp_spa) >= SPA_VERSION_DEADLISTS) {
@@ -1480,6 +1507,14 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 	if (spa_shutting_down(spa))
 		return;
 
+	/*
+	 * Destroy any snapshots that "zfs destroy" queued.  This comes first
+	 * so that the blocks they free can be freed in this txg.
+	 */
+	if (dp->dp_destroy_queue_obj != 0 &&
+	    spa->spa_load_state == SPA_LOAD_NONE)
+		dsl_destroy_queue_sync(dp, tx);
+
 	/*
 	 * If the scan is inactive due to a stalled async destroy, try again.
 	 */
@@ -1640,16 +1675,21 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 		    (longlong_t)scn->scn_phys.scn_bookmark.zb_blkid);
 	}
 
+	scn->scn_issued_this_txg = 0;
 	scn->scn_zio_root = zio_root(dp->dp_spa, NULL,
 	    NULL, ZIO_FLAG_CANFAIL);
+	if (DSL_SCAN_IS_SCRUB_RESILVER(scn))
+		dsl_scan_queues_create(scn);
 	dsl_pool_config_enter(dp, FTAG);
 	dsl_scan_visit(scn, tx);
+	dsl_scan_queues_destroy(scn);
 	dsl_pool_config_exit(dp, FTAG);
 	(void) zio_wait(scn->scn_zio_root);
 	scn->scn_zio_root = NULL;
 
-	zfs_dbgmsg("visited %llu blocks in %llums",
+	zfs_dbgmsg("visited %llu blocks, issued %llu in %llums",
 	    (longlong_t)scn->scn_visited_this_txg,
+	    (longlong_t)scn->scn_issued_this_txg,
 	    (longlong_t)NSEC2MSEC(gethrtime() - scn->scn_sync_start_time));
 
 	if (!scn->scn_pausing) {
@@ -1767,17 +1807,230 @@ dsl_scan_scrub_done(zio_t *zio)
 	mutex_exit(&spa->spa_scrub_lock);
 }
 
+/*
+ * Sorted scrub and resilver
+ *
+ * The traversal in dsl_scan_visit() visits blocks in logical (bookmark)
+ * order, which on a fragmented pool bears little relation to where the
+ * blocks actually live on disk.  Issuing each read as soon as it is found
+ * therefore produces an essentially random workload.  Instead, while a
+ * scrub or resilver traversal is running, dsl_scan_scrub_cb() only queues
+ * the block pointer on a per-top-level-vdev AVL tree sorted by the offset
+ * of its first DVA.  Once the traversal pauses for this txg (or the queues
+ * exceed zfs_scan_queue_max_bytes), dsl_scan_issue() drains the trees in
+ * offset order, rotating between top-level vdevs so that they are all kept
+ * busy.  Neighbouring blocks then reach the vdev queue together and can be
+ * aggregated by vdev_queue_aggregate() into large sequential reads.
+ *
+ * Issuing the queues takes sync-context time after the traversal pauses,
+ * so it is paid for out of the traversal's budget: dsl_scan_issue() keeps
+ * a running estimate of the time to issue one queued I/O (scn_issue_ns),
+ * and dsl_scan_check_pause() pauses once the time spent plus the time the
+ * queues will take reaches the limit.  Until there is an estimate the
+ * queues are issued in small steps (SCAN_IO_PROBE) to get one.
+ *
+ * The queues never outlive a call to dsl_scan_sync(): every queued block
+ * is issued, and its I/O completes, before the scan bookmark that covers it
+ * is written out.  A scan resumed after a reboot therefore never skips a
+ * block that was queued but not yet read.
+ */
+typedef struct scan_io {
+	avl_node_t		sio_node;
+	blkptr_t		sio_bp;
+	zbookmark_phys_t	sio_zb;
+	int			sio_flags;
+} scan_io_t;
+
+static int
+scan_io_compare(const void *x1, const void *x2)
+{
+	const scan_io_t *s1 = x1;
+	const scan_io_t *s2 = x2;
+	uint64_t o1 = DVA_GET_OFFSET(&s1->sio_bp.blk_dva[0]);
+	uint64_t o2 = DVA_GET_OFFSET(&s2->sio_bp.blk_dva[0]);
+
+	if (o1 < o2)
+		return (-1);
+	if (o1 > o2)
+		return (1);
+
+	/*
+	 * The same block may be reached more than once (e.g. through the
+	 * DDT and through a dataset); keep both, as would happen if they
+	 * were issued directly.
+	 */
+	if ((uintptr_t)s1 < (uintptr_t)s2)
+		return (-1);
+	if ((uintptr_t)s1 > (uintptr_t)s2)
+		return (1);
+	return (0);
+}
+
+/*
+ * Number of queued I/Os to issue, before there is an estimate of the time
+ * each takes.
+ */
+#define	SCAN_IO_PROBE	256
+
+static void
+dsl_scan_queues_create(dsl_scan_t *scn)
+{
+	vdev_t *rvd = scn->scn_dp->dp_spa->spa_root_vdev;
+
+	ASSERT3P(scn->scn_queues, ==, NULL);
+
+	if (zfs_scan_legacy || rvd->vdev_children == 0)
+		return;
+
+	scn->scn_queues_count = rvd->vdev_children;
+	scn->scn_queues = kmem_alloc(scn->scn_queues_count *
+	    sizeof (avl_tree_t), KM_SLEEP);
+	for (uint64_t c = 0; c < scn->scn_queues_count; c++) {
+		avl_create(&scn->scn_queues[c], scan_io_compare,
+		    sizeof (scan_io_t), offsetof(scan_io_t, sio_node));
+	}
+	scn->scn_queued_bytes = 0;
+}
+
+static void
+dsl_scan_queues_destroy(dsl_scan_t *scn)
+{
+	if (scn->scn_queues == NULL)
+		return;
+
+	dsl_scan_issue(scn);
+	for (uint64_t c = 0; c < scn->scn_queues_count; c++)
+		avl_destroy(&scn->scn_queues[c]);
+	kmem_free(scn->scn_queues, scn->scn_queues_count *
+	    sizeof (avl_tree_t));
+	scn->scn_queues = NULL;
+	scn->scn_queues_count = 0;
+	ASSERT0(scn->scn_queued_bytes);
+}
+
+static void
+dsl_scan_scrub_issue(dsl_scan_t *scn, const blkptr_t *bp,
+    const zbookmark_phys_t *zb, int zio_flags)
+{
+	spa_t *spa = scn->scn_dp->dp_spa;
+	vdev_t *rvd = spa->spa_root_vdev;
+	uint64_t maxinflight = rvd->vdev_children * zfs_top_maxinflight;
+	size_t size = BP_GET_PSIZE(bp);
+	int scan_delay = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
+	    zfs_resilver_delay : zfs_scrub_delay;
+	void *data = zio_data_buf_alloc(size);
+
+	mutex_enter(&spa->spa_scrub_lock);
+	while (spa->spa_scrub_inflight >= maxinflight)
+		cv_wait(&spa->spa_scrub_io_cv, &spa->spa_scrub_lock);
+	spa->spa_scrub_inflight++;
+	mutex_exit(&spa->spa_scrub_lock);
+
+	/*
+	 * If we're seeing recent (zfs_scan_idle) "important" I/Os
+	 * then throttle our workload to limit the impact of a scan.
+	 */
+	if (ddi_get_lbolt64() - spa->spa_last_io <= zfs_scan_idle)
+		delay(scan_delay);
+
+	scn->scn_issued_this_txg++;
+	zio_nowait(zio_read(NULL, spa, bp, data, size,
+	    dsl_scan_scrub_done, NULL, ZIO_PRIORITY_SCRUB,
+	    zio_flags, zb));
+}
+
+static void
+dsl_scan_enqueue(dsl_scan_t *scn, const blkptr_t *bp,
+    const zbookmark_phys_t *zb, int zio_flags)
+{
+	uint64_t vdev = DVA_GET_VDEV(&bp->blk_dva[0]);
+	scan_io_t *sio;
+
+	/*
+	 * A top-level vdev added since the queues were created has no
+	 * queue; there is nothing to sort it against anyway.
+	 */
+	if (vdev >= scn->scn_queues_count) {
+		dsl_scan_scrub_issue(scn, bp, zb, zio_flags);
+		return;
+	}
+
+	sio = kmem_alloc(sizeof (scan_io_t), KM_SLEEP);
+	sio->sio_bp = *bp;
+	sio->sio_zb = *zb;
+	sio->sio_flags = zio_flags;
+	avl_add(&scn->scn_queues[vdev], sio);
+	scn->scn_queued_bytes += sizeof (scan_io_t);
+
+	if (scn->scn_queued_bytes >= zfs_scan_queue_max_bytes ||
+	    (scn->scn_issue_ns == 0 &&
+	    scn->scn_queued_bytes >= SCAN_IO_PROBE * sizeof (scan_io_t)))
+		dsl_scan_issue(scn);
+}
+
+/*
+ * Estimated time, in nanoseconds, to issue what is on the sorted queues.
+ */
+static uint64_t
+dsl_scan_issue_time(dsl_scan_t *scn)
+{
+	return (scn->scn_queued_bytes / sizeof (scan_io_t) *
+	    scn->scn_issue_ns);
+}
+
+/*
+ * Issue everything on the sorted queues, lowest offset first, taking one
+ * block from each top-level vdev in turn, and update the estimate of the
+ * time each I/O takes to issue.  That includes waiting for a slot under
+ * zfs_top_maxinflight and the scan delay, so it follows the pool's load.
+ */
+static void
+dsl_scan_issue(dsl_scan_t *scn)
+{
+	uint64_t count = scn->scn_queued_bytes / sizeof (scan_io_t);
+	hrtime_t start;
+	uint64_t ns;
+	boolean_t more;
+
+	if (scn->scn_queues == NULL || count == 0)
+		return;
+
+	start = gethrtime();
+	do {
+		more = B_FALSE;
+		for (uint64_t c = 0; c < scn->scn_queues_count; c++) {
+			avl_tree_t *t = &scn->scn_queues[c];
+			scan_io_t *sio = avl_first(t);
+
+			if (sio == NULL)
+				continue;
+			avl_remove(t, sio);
+			scn->scn_queued_bytes -= sizeof (scan_io_t);
+			dsl_scan_scrub_issue(scn, &sio->sio_bp, &sio->sio_zb,
+			    sio->sio_flags);
+			kmem_free(sio, sizeof (scan_io_t));
+			more |= (avl_numnodes(t) != 0);
+		}
+	} while (more);
+
+	ASSERT0(scn->scn_queued_bytes);
+
+	ns = MAX((gethrtime() - start) / count, 1);
+	if (scn->scn_issue_ns == 0)
+		scn->scn_issue_ns = ns;
+	else
+		scn->scn_issue_ns = (3 * scn->scn_issue_ns + ns) / 4;
+}
+
 static int
 dsl_scan_scrub_cb(dsl_pool_t *dp,
     const blkptr_t *bp, const zbookmark_phys_t *zb)
 {
 	dsl_scan_t *scn = dp->dp_scan;
-	size_t size = BP_GET_PSIZE(bp);
 	spa_t *spa = dp->dp_spa;
 	uint64_t phys_birth = BP_PHYSICAL_BIRTH(bp);
 	boolean_t needs_io;
 	int zio_flags = ZIO_FLAG_SCAN_THREAD | ZIO_FLAG_RAW | ZIO_FLAG_CANFAIL;
-	int scan_delay = 0;
 
 	if (phys_birth <= scn->scn_phys.scn_min_txg ||
 	    phys_birth >= scn->scn_phys.scn_max_txg)
@@ -1792,12 +2045,10 @@ dsl_scan_scrub_cb(dsl_pool_t *dp,
 	if (scn->scn_phys.scn_func == POOL_SCAN_SCRUB) {
 		zio_flags |= ZIO_FLAG_SCRUB;
 		needs_io = B_TRUE;
-		scan_delay = zfs_scrub_delay;
 	} else {
 		ASSERT3U(scn->scn_phys.scn_func, ==, POOL_SCAN_RESILVER);
 		zio_flags |= ZIO_FLAG_RESILVER;
 		needs_io = B_FALSE;
-		scan_delay = zfs_resilver_delay;
 	}
 
 	/* If it's an intent log block, failure is expected. */
@@ -1835,26 +2086,10 @@ dsl_scan_scrub_cb(dsl_pool_t *dp,
 	}
 
 	if (needs_io && !zfs_no_scrub_io) {
-		vdev_t *rvd = spa->spa_root_vdev;
-		uint64_t maxinflight = rvd->vdev_children * zfs_top_maxinflight;
-		void *data = zio_data_buf_alloc(size);
-
-		mutex_enter(&spa->spa_scrub_lock);
-		while (spa->spa_scrub_inflight >= maxinflight)
-			cv_wait(&spa->spa_scrub_io_cv, &spa->spa_scrub_lock);
-		spa->spa_scrub_inflight++;
-		mutex_exit(&spa->spa_scrub_lock);
-
-		/*
-		 * If we're seeing recent (zfs_scan_idle) "important" I/Os
-		 * then throttle our workload to limit the impact of a scan.
-		 */
-		if (ddi_get_lbolt64() - spa->spa_last_io <= zfs_scan_idle)
-			delay(scan_delay);
-
-		zio_nowait(zio_read(NULL, spa, bp, data, size,
-		    dsl_scan_scrub_done, NULL, ZIO_PRIORITY_SCRUB,
-		    zio_flags, zb));
+		if (scn->scn_queues != NULL)
+			dsl_scan_enqueue(scn, bp, zb, zio_flags);
+		else
+			dsl_scan_scrub_issue(scn, bp, zb, zio_flags);
 	}
 
 	/* do not relocate this block */
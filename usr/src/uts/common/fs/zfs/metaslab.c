@@ -34,14 +34,58 @@
 #include <sys/zio.h>
 #include <sys/spa_impl.h>
 #include <sys/zfeature.h>
+#include <sys/zap.h>
 
 #define	GANG_ALLOCATION(flags) \
 	((flags) & (METASLAB_GANG_CHILD | METASLAB_GANG_HEADER))
 
 #define	METASLAB_WEIGHT_PRIMARY		(1ULL << 63)
 #define	METASLAB_WEIGHT_SECONDARY	(1ULL << 62)
+#define	METASLAB_WEIGHT_TYPE		(1ULL << 61)
 #define	METASLAB_ACTIVE_MASK		\
 	(METASLAB_WEIGHT_PRIMARY | METASLAB_WEIGHT_SECONDARY)
+#define	METASLAB_WEIGHT_MASK		\
+	(METASLAB_ACTIVE_MASK | METASLAB_WEIGHT_TYPE)
+
+/*
+ * The metaslab weight encodes the free space in a metaslab such that the
+ * "best" metaslab sorts first.  It is computed in one of two ways: as a
+ * fragmentation-scaled sum of all the free space (space-based), or from
+ * the free segments in the largest size class only (segment-based).  The
+ * segment-based weight is preferred because it describes how the free
+ * space is laid out, but it needs the space map histogram, which legacy
+ * pools lack.  The histogram counts the free segments whose size is in
+ * [2^i, 2^(i+1)); we encode the highest non-empty i and its count.
+ *
+ * Space-based weight:
+ *
+ *	64      56      48      40      32      24      16      8       0
+ *	+-------+-------+-------+-------+-------+-------+-------+-------+
+ *	|PS1|                   weighted-free space                     |
+ *	+-------+-------+-------+-------+-------+-------+-------+-------+
+ *
+ * Segment-based weight:
+ *
+ *	64      56      48      40      32      24      16      8       0
+ *	+-------+-------+-------+-------+-------+-------+-------+-------+
+ *	|PS0| idx|             count of segments in region              |
+ *	+-------+-------+-------+-------+-------+-------+-------+-------+
+ *
+ *	PS - primary and secondary activation bits
+ *	idx - highest non-empty histogram bucket
+ *	count - number of free segments in that bucket
+ */
+#define	WEIGHT_GET_ACTIVE(weight)	BF64_GET((weight), 62, 2)
+#define	WEIGHT_SET_ACTIVE(weight, x)	BF64_SET((weight), 62, 2, x)
+
+#define	WEIGHT_IS_SPACEBASED(weight)	\
+	((weight) == 0 || BF64_GET((weight), 61, 1))
+#define	WEIGHT_SET_SPACEBASED(weight)	BF64_SET((weight), 61, 1, 1)
+
+#define	WEIGHT_GET_INDEX(weight)	BF64_GET((weight), 55, 6)
+#define	WEIGHT_SET_INDEX(weight, x)	BF64_SET((weight), 55, 6, x)
+#define	WEIGHT_GET_COUNT(weight)	BF64_GET((weight), 0, 55)
+#define	WEIGHT_SET_COUNT(weight, x)	BF64_SET((weight), 0, 55, x)
 
 uint64_t metaslab_aliquot = 512ULL << 10;
 uint64_t metaslab_gang_bang = SPA_MAXBLOCKSIZE + 1;	/* force gang blocks */
@@ -170,7 +214,45 @@ boolean_t metaslab_lba_weighting_enabled = B_TRUE;
  */
 boolean_t metaslab_bias_enabled = B_TRUE;
 
+/*
+ * Enable the segment-based metaslab weight (see the comment above
+ * WEIGHT_GET_ACTIVE) on pools with the spacemap_histogram feature.
+ */
+boolean_t zfs_metaslab_segment_weight_enabled = B_TRUE;
+
+/*
+ * When using the segment-based weight, passivate the active metaslab once
+ * its largest free segment has dropped this many size classes below what
+ * it was at activation, so that a metaslab with larger free regions can
+ * be chosen instead.
+ */
+int zfs_metaslab_switch_threshold = 2;
+
+/*
+ * With autotrim on, freed space is trimmed between zfs_txgs_per_trim and
+ * twice that many txgs after it is freed (see metaslab_impl.h).  Free
+ * extents smaller than zfs_trim_min_ext_sz aren't worth a command to the
+ * device and are left alone, by both autotrim and "zpool trim".
+ */
+int zfs_txgs_per_trim = 32;
+uint64_t zfs_trim_min_ext_sz = 128 << 10;
+
+/*
+ * Batch metaslab space map updates in per-vdev log space maps on pools
+ * with the log_spacemap feature (see "Log space maps" below).  Metaslabs
+ * are flushed often enough that each vdev keeps roughly
+ * zfs_log_sm_max_logs logs.
+ */
+int zfs_log_sm_enabled = 1;
+int zfs_log_sm_max_logs = 64;
+
 static uint64_t metaslab_fragmentation(metaslab_t *);
+static zio_t *metaslab_trim(metaslab_t *, range_tree_t *);
+static void metaslab_sm_create(metaslab_t *, dmu_tx_t *);
+static space_map_t *metaslab_log_sm_get(vdev_t *, dmu_tx_t *);
+static void metaslab_set_unflushed(metaslab_t *);
+static void metaslab_set_flushed(metaslab_t *, uint64_t);
+static void metaslab_passivate(metaslab_t *, uint64_t);
 
 /*
  * ==========================================================================
@@ -188,7 +270,15 @@ metaslab_class_create(spa_t *spa, metaslab_ops_t *ops)
 	mc->mc_rotor = NULL;
 	mc->mc_ops = ops;
 	mutex_init(&mc->mc_lock, NULL, MUTEX_DEFAULT, NULL);
-	refcount_create_tracked(&mc->mc_alloc_slots);
+	mc->mc_allocators = spa->spa_alloc_count;
+	mc->mc_allocator = kmem_zalloc(mc->mc_allocators *
+	    sizeof (metaslab_class_allocator_t), KM_SLEEP);
+	for (int i = 0; i < mc->mc_allocators; i++) {
+		metaslab_class_allocator_t *mca = &mc->mc_allocator[i];
+
+		mutex_init(&mca->mca_lock, NULL, MUTEX_DEFAULT, NULL);
+		refcount_create_tracked(&mca->mca_alloc_slots);
+	}
 
 	return (mc);
 }
@@ -202,7 +292,15 @@ metaslab_class_destroy(metaslab_class_t *mc)
 	ASSERT(mc->mc_space == 0);
 	ASSERT(mc->mc_dspace == 0);
 
-	refcount_destroy(&mc->mc_alloc_slots);
+	for (int i = 0; i < mc->mc_allocators; i++) {
+		metaslab_class_allocator_t *mca = &mc->mc_allocator[i];
+
+		ASSERT(mca->mca_rotor == NULL);
+		refcount_destroy(&mca->mca_alloc_slots);
+		mutex_destroy(&mca->mca_lock);
+	}
+	kmem_free(mc->mc_allocator, mc->mc_allocators *
+	    sizeof (metaslab_class_allocator_t));
 	mutex_destroy(&mc->mc_lock);
 	kmem_free(mc, sizeof (metaslab_class_t));
 }
@@ -512,7 +610,13 @@ metaslab_group_create(metaslab_class_t *mc, vdev_t *vd)
 	mg->mg_activation_count = 0;
 	mg->mg_initialized = B_FALSE;
 	mg->mg_no_free_space = B_TRUE;
-	refcount_create_tracked(&mg->mg_alloc_queue_depth);
+	mg->mg_allocators = mc->mc_allocators;
+	mg->mg_allocator = kmem_zalloc(mg->mg_allocators *
+	    sizeof (metaslab_group_allocator_t), KM_SLEEP);
+	for (int i = 0; i < mg->mg_allocators; i++) {
+		refcount_create_tracked(
+		    &mg->mg_allocator[i].mga_alloc_queue_depth);
+	}
 
 	mg->mg_taskq = taskq_create("metaslab_group_taskq", metaslab_load_pct,
 	    minclsyspri, 10, INT_MAX, TASKQ_THREADS_CPU_PCT);
@@ -535,7 +639,15 @@ metaslab_group_destroy(metaslab_group_t *mg)
 	taskq_destroy(mg->mg_taskq);
 	avl_destroy(&mg->mg_metaslab_tree);
 	mutex_destroy(&mg->mg_lock);
-	refcount_destroy(&mg->mg_alloc_queue_depth);
+	for (int i = 0; i < mg->mg_allocators; i++) {
+		metaslab_group_allocator_t *mga = &mg->mg_allocator[i];
+
+		ASSERT3P(mga->mga_primary, ==, NULL);
+		ASSERT3P(mga->mga_secondary, ==, NULL);
+		refcount_destroy(&mga->mga_alloc_queue_depth);
+	}
+	kmem_free(mg->mg_allocator, mg->mg_allocators *
+	    sizeof (metaslab_group_allocator_t));
 	kmem_free(mg, sizeof (metaslab_group_t));
 }
 
@@ -569,6 +681,16 @@ metaslab_group_activate(metaslab_group_t *mg)
 		mgnext->mg_prev = mg;
 	}
 	mc->mc_rotor = mg;
+
+	/*
+	 * Start each allocator at a different group, so that they don't all
+	 * pile onto the same vdev after a configuration change.
+	 */
+	for (int i = 0; i < mc->mc_allocators; i++) {
+		mc->mc_allocator[i].mca_rotor = mg;
+		mc->mc_allocator[i].mca_aliquot = 0;
+		mg = mg->mg_next;
+	}
 }
 
 void
@@ -590,6 +712,28 @@ metaslab_group_passivate(metaslab_group_t *mg)
 	taskq_wait(mg->mg_taskq);
 	metaslab_group_alloc_update(mg);
 
+	/*
+	 * Give up the metaslabs the allocators have active in this group.
+	 * No allocations can be in progress, as we hold SCL_ALLOC as writer.
+	 */
+	for (int i = 0; i < mg->mg_allocators; i++) {
+		metaslab_group_allocator_t *mga = &mg->mg_allocator[i];
+		metaslab_t *msp;
+
+		if ((msp = mga->mga_primary) != NULL) {
+			mutex_enter(&msp->ms_lock);
+			metaslab_passivate(msp,
+			    msp->ms_weight & ~METASLAB_ACTIVE_MASK);
+			mutex_exit(&msp->ms_lock);
+		}
+		if ((msp = mga->mga_secondary) != NULL) {
+			mutex_enter(&msp->ms_lock);
+			metaslab_passivate(msp,
+			    msp->ms_weight & ~METASLAB_ACTIVE_MASK);
+			mutex_exit(&msp->ms_lock);
+		}
+	}
+
 	mgprev = mg->mg_prev;
 	mgnext = mg->mg_next;
 
@@ -600,6 +744,14 @@ metaslab_group_passivate(metaslab_group_t *mg)
 		mgprev->mg_next = mgnext;
 		mgnext->mg_prev = mgprev;
 	}
+	for (int i = 0; i < mc->mc_allocators; i++) {
+		metaslab_class_allocator_t *mca = &mc->mc_allocator[i];
+
+		if (mca->mca_rotor == mg) {
+			mca->mca_rotor = mc->mc_rotor;
+			mca->mca_aliquot = 0;
+		}
+	}
 
 	mg->mg_prev = NULL;
 	mg->mg_next = NULL;
@@ -665,12 +817,14 @@ metaslab_group_histogram_add(metaslab_group_t *mg, metaslab_t *msp)
 		return;
 
 	mutex_enter(&mg->mg_lock);
+	mutex_enter(&mc->mc_lock);
 	for (int i = 0; i < SPACE_MAP_HISTOGRAM_SIZE; i++) {
 		mg->mg_histogram[i + ashift] +=
 		    msp->ms_sm->sm_phys->smp_histogram[i];
 		mc->mc_histogram[i + ashift] +=
 		    msp->ms_sm->sm_phys->smp_histogram[i];
 	}
+	mutex_exit(&mc->mc_lock);
 	mutex_exit(&mg->mg_lock);
 }
 
@@ -685,6 +839,7 @@ metaslab_group_histogram_remove(metaslab_group_t *mg, metaslab_t *msp)
 		return;
 
 	mutex_enter(&mg->mg_lock);
+	mutex_enter(&mc->mc_lock);
 	for (int i = 0; i < SPACE_MAP_HISTOGRAM_SIZE; i++) {
 		ASSERT3U(mg->mg_histogram[i + ashift], >=,
 		    msp->ms_sm->sm_phys->smp_histogram[i]);
@@ -696,6 +851,7 @@ metaslab_group_histogram_remove(metaslab_group_t *mg, metaslab_t *msp)
 		mc->mc_histogram[i + ashift] -=
 		    msp->ms_sm->sm_phys->smp_histogram[i];
 	}
+	mutex_exit(&mc->mc_lock);
 	mutex_exit(&mg->mg_lock);
 }
 
@@ -723,13 +879,24 @@ metaslab_group_remove(metaslab_group_t *mg, metaslab_t *msp)
 
 	mutex_enter(&mg->mg_lock);
 	ASSERT(msp->ms_group == mg);
+	if (msp->ms_allocator != -1) {
+		metaslab_group_allocator_t *mga =
+		    &mg->mg_allocator[msp->ms_allocator];
+
+		if (msp->ms_primary)
+			mga->mga_primary = NULL;
+		else
+			mga->mga_secondary = NULL;
+		msp->ms_allocator = -1;
+	}
 	avl_remove(&mg->mg_metaslab_tree, msp);
 	msp->ms_group = NULL;
 	mutex_exit(&mg->mg_lock);
 }
 
 static void
-metaslab_group_sort(metaslab_group_t *mg, metaslab_t *msp, uint64_t weight)
+metaslab_group_sort_impl(metaslab_group_t *mg, metaslab_t *msp,
+    uint64_t weight)
 {
 	/*
 	 * Although in principle the weight can be any value, in
@@ -737,12 +904,19 @@ metaslab_group_sort(metaslab_group_t *mg, metaslab_t *msp, uint64_t weight)
 	 */
 	ASSERT(weight >= SPA_MINBLOCKSIZE || weight == 0);
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
-
-	mutex_enter(&mg->mg_lock);
+	ASSERT(MUTEX_HELD(&mg->mg_lock));
 	ASSERT(msp->ms_group == mg);
+
 	avl_remove(&mg->mg_metaslab_tree, msp);
 	msp->ms_weight = weight;
 	avl_add(&mg->mg_metaslab_tree, msp);
+}
+
+static void
+metaslab_group_sort(metaslab_group_t *mg, metaslab_t *msp, uint64_t weight)
+{
+	mutex_enter(&mg->mg_lock);
+	metaslab_group_sort_impl(mg, msp, weight);
 	mutex_exit(&mg->mg_lock);
 }
 
@@ -790,7 +964,7 @@ metaslab_group_fragmentation(metaslab_group_t *mg)
  */
 static boolean_t
 metaslab_group_allocatable(metaslab_group_t *mg, metaslab_group_t *rotor,
-    uint64_t psize)
+    uint64_t psize, int allocator)
 {
 	spa_t *spa = mg->mg_vd->vdev_spa;
 	metaslab_class_t *mc = mg->mg_class;
@@ -809,8 +983,9 @@ metaslab_group_allocatable(metaslab_group_t *mg, metaslab_group_t *rotor,
 	 * in metaslab_group_alloc_update() for more information) and
 	 * the allocation throttle is disabled then allow allocations to this
 	 * device. However, if the allocation throttle is enabled then
-	 * check if we have reached our allocation limit (mg_alloc_queue_depth)
-	 * to determine if we should allow allocations to this metaslab group.
+	 * check if this allocator has reached its allocation limit
+	 * (mga_alloc_queue_depth) to determine if we should allow allocations
+	 * to this metaslab group.
 	 * If all metaslab groups are no longer considered allocatable
 	 * (mc_alloc_groups == 0) or we're trying to allocate the smallest
 	 * gang block size then we allow allocations on this metaslab group
@@ -831,7 +1006,8 @@ metaslab_group_allocatable(metaslab_group_t *mg, metaslab_group_t *rotor,
 		if (mg->mg_no_free_space)
 			return (B_FALSE);
 
-		qdepth = refcount_count(&mg->mg_alloc_queue_depth);
+		qdepth = refcount_count(
+		    &mg->mg_allocator[allocator].mga_alloc_queue_depth);
 
 		/*
 		 * If this metaslab group is below its qmax or it's
@@ -852,7 +1028,8 @@ metaslab_group_allocatable(metaslab_group_t *mg, metaslab_group_t *rotor,
 		for (mgp = mg->mg_next; mgp != rotor; mgp = mgp->mg_next) {
 			qmax = mgp->mg_max_alloc_queue_depth;
 
-			qdepth = refcount_count(&mgp->mg_alloc_queue_depth);
+			qdepth = refcount_count(
+			    &mgp->mg_allocator[allocator].mga_alloc_queue_depth);
 
 			/*
 			 * If there is another metaslab group that
@@ -920,8 +1097,8 @@ metaslab_rt_create(range_tree_t *rt, void *arg)
 	ASSERT3P(rt->rt_arg, ==, msp);
 	ASSERT(msp->ms_tree == NULL);
 
-	avl_create(&msp->ms_size_tree, metaslab_rangesize_compare,
-	    sizeof (range_seg_t), offsetof(range_seg_t, rs_pp_node));
+	zfs_btree_create(&msp->ms_size_tree, metaslab_rangesize_compare,
+	    sizeof (range_seg_t));
 }
 
 /*
@@ -934,9 +1111,9 @@ metaslab_rt_destroy(range_tree_t *rt, void *arg)
 
 	ASSERT3P(rt->rt_arg, ==, msp);
 	ASSERT3P(msp->ms_tree, ==, rt);
-	ASSERT0(avl_numnodes(&msp->ms_size_tree));
+	ASSERT0(zfs_btree_numnodes(&msp->ms_size_tree));
 
-	avl_destroy(&msp->ms_size_tree);
+	zfs_btree_destroy(&msp->ms_size_tree);
 }
 
 static void
@@ -947,7 +1124,7 @@ metaslab_rt_add(range_tree_t *rt, range_seg_t *rs, void *arg)
 	ASSERT3P(rt->rt_arg, ==, msp);
 	ASSERT3P(msp->ms_tree, ==, rt);
 	VERIFY(!msp->ms_condensing);
-	avl_add(&msp->ms_size_tree, rs);
+	zfs_btree_add(&msp->ms_size_tree, rs);
 }
 
 static void
@@ -958,7 +1135,7 @@ metaslab_rt_remove(range_tree_t *rt, range_seg_t *rs, void *arg)
 	ASSERT3P(rt->rt_arg, ==, msp);
 	ASSERT3P(msp->ms_tree, ==, rt);
 	VERIFY(!msp->ms_condensing);
-	avl_remove(&msp->ms_size_tree, rs);
+	zfs_btree_remove(&msp->ms_size_tree, rs);
 }
 
 static void
@@ -970,13 +1147,10 @@ metaslab_rt_vacate(range_tree_t *rt, void *arg)
 	ASSERT3P(msp->ms_tree, ==, rt);
 
 	/*
-	 * Normally one would walk the tree freeing nodes along the way.
-	 * Since the nodes are shared with the range trees we can avoid
-	 * walking all nodes and just reinitialize the avl tree. The nodes
-	 * will be freed by the range tree, so we don't want to free them here.
+	 * The size tree holds its own copies of the segments, so there is
+	 * nothing to walk; just free all of its nodes.
 	 */
-	avl_create(&msp->ms_size_tree, metaslab_rangesize_compare,
-	    sizeof (range_seg_t), offsetof(range_seg_t, rs_pp_node));
+	zfs_btree_clear(&msp->ms_size_tree);
 }
 
 static range_tree_ops_t metaslab_rt_ops = {
@@ -999,10 +1173,10 @@ static range_tree_ops_t metaslab_rt_ops = {
 uint64_t
 metaslab_block_maxsize(metaslab_t *msp)
 {
-	avl_tree_t *t = &msp->ms_size_tree;
+	zfs_btree_t *t = &msp->ms_size_tree;
 	range_seg_t *rs;
 
-	if (t == NULL || (rs = avl_last(t)) == NULL)
+	if (t == NULL || (rs = zfs_btree_last(t, NULL)) == NULL)
 		return (0ULL);
 
 	return (rs->rs_end - rs->rs_start);
@@ -1024,7 +1198,15 @@ metaslab_block_alloc(metaslab_t *msp, uint64_t size)
 		VERIFY0(P2PHASE(size, 1ULL << vd->vdev_ashift));
 		VERIFY3U(range_tree_space(rt) - size, <=, msp->ms_size);
 		range_tree_remove(rt, start, size);
+		range_tree_clear(msp->ms_cur_trimset, start, size);
+		range_tree_clear(msp->ms_prev_trimset, start, size);
 	}
+
+	/*
+	 * The largest free segment may have been carved up, so refresh it.
+	 */
+	msp->ms_max_size = metaslab_block_maxsize(msp);
+
 	return (start);
 }
 
@@ -1036,22 +1218,22 @@ metaslab_block_alloc(metaslab_t *msp, uint64_t size)
 
 /*
  * This is a helper function that can be used by the allocator to find
- * a suitable block to allocate. This will search the specified AVL
- * tree looking for a block that matches the specified criteria.
+ * a suitable block to allocate. This will search the specified B-tree
+ * looking for a block that matches the specified criteria.
  */
 static uint64_t
-metaslab_block_picker(avl_tree_t *t, uint64_t *cursor, uint64_t size,
+metaslab_block_picker(zfs_btree_t *t, uint64_t *cursor, uint64_t size,
     uint64_t align)
 {
 	range_seg_t *rs, rsearch;
-	avl_index_t where;
+	zfs_btree_index_t where;
 
 	rsearch.rs_start = *cursor;
 	rsearch.rs_end = *cursor + size;
 
-	rs = avl_find(t, &rsearch, &where);
+	rs = zfs_btree_find(t, &rsearch, &where);
 	if (rs == NULL)
-		rs = avl_nearest(t, where, AVL_AFTER);
+		rs = zfs_btree_next(t, &where, &where);
 
 	while (rs != NULL) {
 		uint64_t offset = P2ROUNDUP(rs->rs_start, align);
@@ -1060,7 +1242,7 @@ metaslab_block_picker(avl_tree_t *t, uint64_t *cursor, uint64_t size,
 			*cursor = offset + size;
 			return (offset);
 		}
-		rs = AVL_NEXT(t, rs);
+		rs = zfs_btree_next(t, &where, &where);
 	}
 
 	/*
@@ -1091,7 +1273,7 @@ metaslab_ff_alloc(metaslab_t *msp, uint64_t size)
 	 */
 	uint64_t align = size & -size;
 	uint64_t *cursor = &msp->ms_lbas[highbit64(align) - 1];
-	avl_tree_t *t = &msp->ms_tree->rt_root;
+	zfs_btree_t *t = &msp->ms_tree->rt_root;
 
 	return (metaslab_block_picker(t, cursor, size, align));
 }
@@ -1121,19 +1303,20 @@ metaslab_df_alloc(metaslab_t *msp, uint64_t size)
 	uint64_t align = size & -size;
 	uint64_t *cursor = &msp->ms_lbas[highbit64(align) - 1];
 	range_tree_t *rt = msp->ms_tree;
-	avl_tree_t *t = &rt->rt_root;
+	zfs_btree_t *t = &rt->rt_root;
 	uint64_t max_size = metaslab_block_maxsize(msp);
 	int free_pct = range_tree_space(rt) * 100 / msp->ms_size;
 
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
-	ASSERT3U(avl_numnodes(t), ==, avl_numnodes(&msp->ms_size_tree));
+	ASSERT3U(zfs_btree_numnodes(t), ==,
+	    zfs_btree_numnodes(&msp->ms_size_tree));
 
 	if (max_size < size)
 		return (-1ULL);
 
 	/*
 	 * If we're running low on space switch to using the size
-	 * sorted AVL tree (best-fit).
+	 * sorted B-tree (best-fit).
 	 */
 	if (max_size < metaslab_df_alloc_threshold ||
 	    free_pct < metaslab_df_free_pct) {
@@ -1161,20 +1344,20 @@ static uint64_t
 metaslab_cf_alloc(metaslab_t *msp, uint64_t size)
 {
 	range_tree_t *rt = msp->ms_tree;
-	avl_tree_t *t = &msp->ms_size_tree;
+	zfs_btree_t *t = &msp->ms_size_tree;
 	uint64_t *cursor = &msp->ms_lbas[0];
 	uint64_t *cursor_end = &msp->ms_lbas[1];
 	uint64_t offset = 0;
 
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
-	ASSERT3U(avl_numnodes(t), ==, avl_numnodes(&rt->rt_root));
+	ASSERT3U(zfs_btree_numnodes(t), ==, zfs_btree_numnodes(&rt->rt_root));
 
 	ASSERT3U(*cursor_end, >=, *cursor);
 
 	if ((*cursor + size) > *cursor_end) {
 		range_seg_t *rs;
 
-		rs = avl_last(&msp->ms_size_tree);
+		rs = zfs_btree_last(t, NULL);
 		if (rs == NULL || (rs->rs_end - rs->rs_start) < size)
 			return (-1ULL);
 
@@ -1210,15 +1393,16 @@ uint64_t metaslab_ndf_clump_shift = 4;
 static uint64_t
 metaslab_ndf_alloc(metaslab_t *msp, uint64_t size)
 {
-	avl_tree_t *t = &msp->ms_tree->rt_root;
-	avl_index_t where;
+	zfs_btree_t *t = &msp->ms_tree->rt_root;
+	zfs_btree_index_t where;
 	range_seg_t *rs, rsearch;
 	uint64_t hbit = highbit64(size);
 	uint64_t *cursor = &msp->ms_lbas[hbit - 1];
 	uint64_t max_size = metaslab_block_maxsize(msp);
 
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
-	ASSERT3U(avl_numnodes(t), ==, avl_numnodes(&msp->ms_size_tree));
+	ASSERT3U(zfs_btree_numnodes(t), ==,
+	    zfs_btree_numnodes(&msp->ms_size_tree));
 
 	if (max_size < size)
 		return (-1ULL);
@@ -1226,16 +1410,16 @@ metaslab_ndf_alloc(metaslab_t *msp, uint64_t size)
 	rsearch.rs_start = *cursor;
 	rsearch.rs_end = *cursor + size;
 
-	rs = avl_find(t, &rsearch, &where);
+	rs = zfs_btree_find(t, &rsearch, &where);
 	if (rs == NULL || (rs->rs_end - rs->rs_start) < size) {
 		t = &msp->ms_size_tree;
 
 		rsearch.rs_start = 0;
 		rsearch.rs_end = MIN(max_size,
 		    1ULL << (hbit + metaslab_ndf_clump_shift));
-		rs = avl_find(t, &rsearch, &where);
+		rs = zfs_btree_find(t, &rsearch, &where);
 		if (rs == NULL)
-			rs = avl_nearest(t, where, AVL_AFTER);
+			rs = zfs_btree_next(t, &where, &where);
 		ASSERT(rs != NULL);
 	}
 
@@ -1258,6 +1442,18 @@ metaslab_ops_t *zfs_metaslab_ops = &metaslab_df_ops;
  * ==========================================================================
  */
 
+/*
+ * Return the metaslab's allocated space as of the last synced txg: what
+ * its space map says, adjusted by what has only been logged so far.
+ */
+uint64_t
+metaslab_allocated_space(metaslab_t *msp)
+{
+	return (space_map_allocated(msp->ms_sm) +
+	    range_tree_space(msp->ms_unflushed_allocs) -
+	    range_tree_space(msp->ms_unflushed_frees));
+}
+
 /*
  * Wait for any in-progress metaslab loads to complete.
  */
@@ -1297,10 +1493,22 @@ metaslab_load(metaslab_t *msp)
 	msp->ms_loading = B_FALSE;
 
 	if (msp->ms_loaded) {
+		/*
+		 * Apply what has been logged but not yet flushed to the
+		 * space map.
+		 */
+		range_tree_walk(msp->ms_unflushed_allocs, range_tree_remove,
+		    msp->ms_tree);
+		range_tree_walk(msp->ms_unflushed_frees, range_tree_add,
+		    msp->ms_tree);
+
 		for (int t = 0; t < TXG_DEFER_SIZE; t++) {
 			range_tree_walk(msp->ms_defertree[t],
 			    range_tree_remove, msp->ms_tree);
 		}
+		range_tree_walk(msp->ms_trimming, range_tree_remove,
+		    msp->ms_tree);
+		msp->ms_max_size = metaslab_block_maxsize(msp);
 	}
 	cv_broadcast(&msp->ms_load_cv);
 	return (error);
@@ -1313,6 +1521,7 @@ metaslab_unload(metaslab_t *msp)
 	range_tree_vacate(msp->ms_tree, NULL, NULL);
 	msp->ms_loaded = B_FALSE;
 	msp->ms_weight &= ~METASLAB_ACTIVE_MASK;
+	msp->ms_max_size = 0;
 }
 
 int
@@ -1327,9 +1536,11 @@ metaslab_init(metaslab_group_t *mg, uint64_t id, uint64_t object, uint64_t txg,
 	ms = kmem_zalloc(sizeof (metaslab_t), KM_SLEEP);
 	mutex_init(&ms->ms_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&ms->ms_load_cv, NULL, CV_DEFAULT, NULL);
+	cv_init(&ms->ms_trim_cv, NULL, CV_DEFAULT, NULL);
 	ms->ms_id = id;
 	ms->ms_start = id << vd->vdev_ms_shift;
 	ms->ms_size = 1ULL << vd->vdev_ms_shift;
+	ms->ms_allocator = -1;
 
 	/*
 	 * We only open space map objects that already exist. All others
@@ -1355,6 +1566,12 @@ metaslab_init(metaslab_group_t *mg, uint64_t id, uint64_t object, uint64_t txg,
 	 * data fault on any attempt to use this metaslab before it's ready.
 	 */
 	ms->ms_tree = range_tree_create(&metaslab_rt_ops, ms, &ms->ms_lock);
+	ms->ms_cur_trimset = range_tree_create(NULL, ms, &ms->ms_lock);
+	ms->ms_prev_trimset = range_tree_create(NULL, ms, &ms->ms_lock);
+	ms->ms_trimming = range_tree_create(NULL, ms, &ms->ms_lock);
+	ms->ms_unflushed_allocs = range_tree_create(NULL, ms, &ms->ms_lock);
+	ms->ms_unflushed_frees = range_tree_create(NULL, ms, &ms->ms_lock);
+	ms->ms_logged_allocs = range_tree_create(NULL, ms, &ms->ms_lock);
 	metaslab_group_add(mg, ms);
 
 	ms->ms_fragmentation = metaslab_fragmentation(ms);
@@ -1399,13 +1616,37 @@ metaslab_fini(metaslab_t *msp)
 
 	mutex_enter(&msp->ms_lock);
 
+	/* The trim's completion still refers to the metaslab. */
+	while (range_tree_space(msp->ms_trimming) != 0)
+		cv_wait(&msp->ms_trim_cv, &msp->ms_lock);
+
 	VERIFY(msp->ms_group == NULL);
-	vdev_space_update(mg->mg_vd, -space_map_allocated(msp->ms_sm),
+	vdev_space_update(mg->mg_vd, -metaslab_allocated_space(msp),
 	    0, -msp->ms_size);
 	space_map_close(msp->ms_sm);
 
+	if (msp->ms_unflushed) {
+		vdev_t *vd = mg->mg_vd;
+
+		mutex_enter(&vd->vdev_log_lock);
+		avl_remove(&vd->vdev_unflushed_ms, msp);
+		mutex_exit(&vd->vdev_log_lock);
+		msp->ms_unflushed = B_FALSE;
+	}
+
 	metaslab_unload(msp);
 	range_tree_destroy(msp->ms_tree);
+	range_tree_vacate(msp->ms_cur_trimset, NULL, NULL);
+	range_tree_destroy(msp->ms_cur_trimset);
+	range_tree_vacate(msp->ms_prev_trimset, NULL, NULL);
+	range_tree_destroy(msp->ms_prev_trimset);
+	range_tree_destroy(msp->ms_trimming);
+	range_tree_vacate(msp->ms_unflushed_allocs, NULL, NULL);
+	range_tree_destroy(msp->ms_unflushed_allocs);
+	range_tree_vacate(msp->ms_unflushed_frees, NULL, NULL);
+	range_tree_destroy(msp->ms_unflushed_frees);
+	range_tree_vacate(msp->ms_logged_allocs, NULL, NULL);
+	range_tree_destroy(msp->ms_logged_allocs);
 
 	for (int t = 0; t < TXG_SIZE; t++) {
 		range_tree_destroy(msp->ms_alloctree[t]);
@@ -1420,6 +1661,7 @@ metaslab_fini(metaslab_t *msp)
 
 	mutex_exit(&msp->ms_lock);
 	cv_destroy(&msp->ms_load_cv);
+	cv_destroy(&msp->ms_trim_cv);
 	mutex_destroy(&msp->ms_lock);
 
 	kmem_free(msp, sizeof (metaslab_t));
@@ -1530,12 +1772,12 @@ metaslab_fragmentation(metaslab_t *msp)
 }
 
 /*
- * Compute a weight -- a selection preference value -- for the given metaslab.
- * This is based on the amount of free space, the level of fragmentation,
- * the LBA range, and whether the metaslab is loaded.
+ * Compute a space-based weight for the given metaslab.  This is based on
+ * the amount of free space, the level of fragmentation, the LBA range,
+ * and whether the metaslab is loaded.
  */
 static uint64_t
-metaslab_weight(metaslab_t *msp)
+metaslab_space_weight(metaslab_t *msp)
 {
 	metaslab_group_t *mg = msp->ms_group;
 	vdev_t *vd = mg->mg_vd;
@@ -1543,22 +1785,11 @@ metaslab_weight(metaslab_t *msp)
 
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
 
-	/*
-	 * This vdev is in the process of being removed so there is nothing
-	 * for us to do here.
-	 */
-	if (vd->vdev_removing) {
-		ASSERT0(space_map_allocated(msp->ms_sm));
-		ASSERT0(vd->vdev_ms_shift);
-		return (0);
-	}
-
 	/*
 	 * The baseline weight is the metaslab's free space.
 	 */
-	space = msp->ms_size - space_map_allocated(msp->ms_sm);
+	space = msp->ms_size - metaslab_allocated_space(msp);
 
-	msp->ms_fragmentation = metaslab_fragmentation(msp);
 	if (metaslab_fragmentation_factor_enabled &&
 	    msp->ms_fragmentation != ZFS_FRAG_INVALID) {
 		/*
@@ -1607,12 +1838,203 @@ metaslab_weight(metaslab_t *msp)
 		weight |= (msp->ms_weight & METASLAB_ACTIVE_MASK);
 	}
 
+	WEIGHT_SET_SPACEBASED(weight);
+	return (weight);
+}
+
+/*
+ * Determine a segment-based weight from the in-core range tree.  The range
+ * tree histogram is more precise than the space map's, so buckets above the
+ * space map's range are folded down into its top bucket; this keeps loaded
+ * and unloaded metaslabs comparable.
+ */
+static uint64_t
+metaslab_weight_from_range_tree(metaslab_t *msp)
+{
+	uint64_t weight = 0;
+	uint64_t segments = 0;
+	uint8_t shift = msp->ms_group->mg_vd->vdev_ashift;
+	int max_idx = SPACE_MAP_HISTOGRAM_SIZE + shift - 1;
+
+	ASSERT(msp->ms_loaded);
+
+	for (int i = RANGE_TREE_HISTOGRAM_SIZE - 1; i >= SPA_MINBLOCKSHIFT;
+	    i--) {
+		segments <<= 1;
+		segments += msp->ms_tree->rt_histogram[i];
+
+		if (i > max_idx)
+			continue;
+
+		if (segments != 0) {
+			WEIGHT_SET_COUNT(weight, segments);
+			WEIGHT_SET_INDEX(weight, i);
+			WEIGHT_SET_ACTIVE(weight, 0);
+			break;
+		}
+	}
+	return (weight);
+}
+
+/*
+ * Determine a segment-based weight from the on-disk space map histogram.
+ * The histogram is only updated in metaslab_sync(), so this reflects the
+ * free space as of the end of the last sync.
+ */
+static uint64_t
+metaslab_weight_from_spacemap(metaslab_t *msp)
+{
+	uint64_t weight = 0;
+
+	for (int i = SPACE_MAP_HISTOGRAM_SIZE - 1; i >= 0; i--) {
+		if (msp->ms_sm->sm_phys->smp_histogram[i] != 0) {
+			WEIGHT_SET_COUNT(weight,
+			    msp->ms_sm->sm_phys->smp_histogram[i]);
+			WEIGHT_SET_INDEX(weight, i + msp->ms_sm->sm_shift);
+			WEIGHT_SET_ACTIVE(weight, 0);
+			break;
+		}
+	}
+	return (weight);
+}
+
+/*
+ * Compute a segment-based weight for the given metaslab: the size class
+ * and count of its largest free segments.  This doesn't require the
+ * metaslab to be loaded.
+ */
+static uint64_t
+metaslab_segment_weight(metaslab_t *msp)
+{
+	metaslab_group_t *mg = msp->ms_group;
+	uint64_t weight = 0;
+	uint8_t shift = mg->mg_vd->vdev_ashift;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	/*
+	 * The metaslab is completely free.
+	 */
+	if (metaslab_allocated_space(msp) == 0) {
+		int idx = highbit64(msp->ms_size) - 1;
+		int max_idx = SPACE_MAP_HISTOGRAM_SIZE + shift - 1;
+
+		if (idx < max_idx) {
+			WEIGHT_SET_COUNT(weight, 1ULL);
+			WEIGHT_SET_INDEX(weight, idx);
+		} else {
+			WEIGHT_SET_COUNT(weight, 1ULL << (idx - max_idx));
+			WEIGHT_SET_INDEX(weight, max_idx);
+		}
+		WEIGHT_SET_ACTIVE(weight, 0);
+		ASSERT(!WEIGHT_IS_SPACEBASED(weight));
+		return (weight);
+	}
+
+	ASSERT3U(msp->ms_sm->sm_dbuf->db_size, ==, sizeof (space_map_phys_t));
+
+	/*
+	 * If the metaslab is fully allocated then just make the weight 0.
+	 */
+	if (metaslab_allocated_space(msp) == msp->ms_size)
+		return (0);
+
+	if (msp->ms_loaded)
+		weight = metaslab_weight_from_range_tree(msp);
+	else
+		weight = metaslab_weight_from_spacemap(msp);
+
+	/*
+	 * If the metaslab was active the last time we calculated its weight
+	 * then keep it active; we want to consume the whole region that the
+	 * weight describes.
+	 */
+	if (msp->ms_activation_weight != 0 && weight != 0)
+		WEIGHT_SET_ACTIVE(weight, WEIGHT_GET_ACTIVE(msp->ms_weight));
 	return (weight);
 }
 
+/*
+ * Determine whether an allocation of 'asize' should be attempted from this
+ * metaslab.  When the metaslab is loaded we know its largest free segment
+ * exactly; otherwise we go by what the weight promises.
+ */
+static boolean_t
+metaslab_should_allocate(metaslab_t *msp, uint64_t asize)
+{
+	if (msp->ms_max_size != 0)
+		return (msp->ms_max_size >= asize);
+
+	if (!WEIGHT_IS_SPACEBASED(msp->ms_weight)) {
+		/*
+		 * A segment weight describes segments in [2^i, 2^(i+1)).
+		 * asize may fall inside that range, so try as long as
+		 * asize < 2^(i+1).
+		 */
+		return (asize < 1ULL << (WEIGHT_GET_INDEX(msp->ms_weight) + 1));
+	}
+
+	return (asize <= (msp->ms_weight & ~METASLAB_WEIGHT_MASK));
+}
+
+/*
+ * Compute a weight -- a selection preference value -- for the given
+ * metaslab, using the segment-based weight where the space map supports it.
+ */
+static uint64_t
+metaslab_weight(metaslab_t *msp)
+{
+	vdev_t *vd = msp->ms_group->mg_vd;
+	spa_t *spa = vd->vdev_spa;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	/*
+	 * This vdev is in the process of being removed so there is nothing
+	 * for us to do here.
+	 */
+	if (vd->vdev_removing) {
+		ASSERT0(metaslab_allocated_space(msp));
+		ASSERT0(vd->vdev_ms_shift);
+		return (0);
+	}
+
+	/*
+	 * Refresh the maximum size if the metaslab is loaded, since freed
+	 * space may have been added back into the free tree.
+	 */
+	if (msp->ms_loaded)
+		msp->ms_max_size = metaslab_block_maxsize(msp);
+
+	msp->ms_fragmentation = metaslab_fragmentation(msp);
+
+	/*
+	 * A metaslab that has only logged allocations has no histogram to
+	 * take a segment-based weight from until it is first flushed.
+	 */
+	if (zfs_metaslab_segment_weight_enabled &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_SPACEMAP_HISTOGRAM) &&
+	    (msp->ms_sm == NULL ? metaslab_allocated_space(msp) == 0 :
+	    msp->ms_sm->sm_dbuf->db_size == sizeof (space_map_phys_t)))
+		return (metaslab_segment_weight(msp));
+
+	return (metaslab_space_weight(msp));
+}
+
+/*
+ * Activate a metaslab for the given allocator, as its primary or secondary
+ * metaslab in this group.  An allocator of -1 activates the metaslab
+ * without tying it to an allocator; metaslab_claim_dva() uses that, as
+ * claims don't go through the allocators.  Returns EBUSY if the allocator
+ * already has a metaslab of this kind active in the group, or if another
+ * thread activated this one while we waited for it to load; the caller
+ * should then pick again.
+ */
 static int
-metaslab_activate(metaslab_t *msp, uint64_t activation_weight)
+metaslab_activate(metaslab_t *msp, int allocator, uint64_t activation_weight)
 {
+	metaslab_group_t *mg = msp->ms_group;
+
 	ASSERT(MUTEX_HELD(&msp->ms_lock));
 
 	if ((msp->ms_weight & METASLAB_ACTIVE_MASK) == 0) {
@@ -1620,13 +2042,35 @@ metaslab_activate(metaslab_t *msp, uint64_t activation_weight)
 		if (!msp->ms_loaded) {
 			int error = metaslab_load(msp);
 			if (error) {
-				metaslab_group_sort(msp->ms_group, msp, 0);
+				metaslab_group_sort(mg, msp, 0);
 				return (error);
 			}
 		}
+		if ((msp->ms_weight & METASLAB_ACTIVE_MASK) != 0)
+			return (SET_ERROR(EBUSY));
 
-		metaslab_group_sort(msp->ms_group, msp,
+		mutex_enter(&mg->mg_lock);
+		if (allocator != -1) {
+			metaslab_group_allocator_t *mga =
+			    &mg->mg_allocator[allocator];
+			metaslab_t **slot =
+			    (activation_weight == METASLAB_WEIGHT_PRIMARY) ?
+			    &mga->mga_primary : &mga->mga_secondary;
+
+			if (*slot != NULL) {
+				mutex_exit(&mg->mg_lock);
+				return (SET_ERROR(EBUSY));
+			}
+			*slot = msp;
+			ASSERT3S(msp->ms_allocator, ==, -1);
+			msp->ms_allocator = allocator;
+			msp->ms_primary =
+			    (activation_weight == METASLAB_WEIGHT_PRIMARY);
+		}
+		msp->ms_activation_weight = msp->ms_weight;
+		metaslab_group_sort_impl(mg, msp,
 		    msp->ms_weight | activation_weight);
+		mutex_exit(&mg->mg_lock);
 	}
 	ASSERT(msp->ms_loaded);
 	ASSERT(msp->ms_weight & METASLAB_ACTIVE_MASK);
@@ -1635,18 +2079,69 @@ metaslab_activate(metaslab_t *msp, uint64_t activation_weight)
 }
 
 static void
-metaslab_passivate(metaslab_t *msp, uint64_t size)
+metaslab_passivate(metaslab_t *msp, uint64_t weight)
 {
+	metaslab_group_t *mg = msp->ms_group;
+	uint64_t size = weight & ~METASLAB_WEIGHT_MASK;
+
 	/*
 	 * If size < SPA_MINBLOCKSIZE, then we will not allocate from
 	 * this metaslab again.  In that case, it had better be empty,
 	 * or we would be leaving space on the table.
 	 */
-	ASSERT(size >= SPA_MINBLOCKSIZE || range_tree_space(msp->ms_tree) == 0);
-	metaslab_group_sort(msp->ms_group, msp, MIN(msp->ms_weight, size));
+	ASSERT(!WEIGHT_IS_SPACEBASED(weight) || size >= SPA_MINBLOCKSIZE ||
+	    range_tree_space(msp->ms_tree) == 0);
+	ASSERT0(weight & METASLAB_ACTIVE_MASK);
+
+	msp->ms_activation_weight = 0;
+	mutex_enter(&mg->mg_lock);
+	if (msp->ms_allocator != -1) {
+		metaslab_group_allocator_t *mga =
+		    &mg->mg_allocator[msp->ms_allocator];
+
+		if (msp->ms_primary) {
+			ASSERT3P(mga->mga_primary, ==, msp);
+			mga->mga_primary = NULL;
+		} else {
+			ASSERT3P(mga->mga_secondary, ==, msp);
+			mga->mga_secondary = NULL;
+		}
+		msp->ms_allocator = -1;
+	}
+	metaslab_group_sort_impl(mg, msp, weight);
+	mutex_exit(&mg->mg_lock);
 	ASSERT((msp->ms_weight & METASLAB_ACTIVE_MASK) == 0);
 }
 
+/*
+ * A segment-weighted metaslab stays active until an allocation fails or
+ * until its largest free segments have dropped zfs_metaslab_switch_threshold
+ * size classes since activation.  In the latter case passivate it so that a
+ * metaslab with larger free regions can be selected.  In sync passes after
+ * the first we keep using it, to avoid dirtying more metaslabs.
+ */
+static void
+metaslab_segment_may_passivate(metaslab_t *msp)
+{
+	spa_t *spa = msp->ms_group->mg_vd->vdev_spa;
+	uint64_t weight;
+	int activation_idx, current_idx;
+
+	if (WEIGHT_IS_SPACEBASED(msp->ms_weight) || spa_sync_pass(spa) > 1)
+		return;
+
+	/*
+	 * The in-core range tree is the only up to date view of the free
+	 * space in the middle of a sync pass.
+	 */
+	weight = metaslab_weight_from_range_tree(msp);
+	activation_idx = WEIGHT_GET_INDEX(msp->ms_activation_weight);
+	current_idx = WEIGHT_GET_INDEX(weight);
+
+	if (current_idx <= activation_idx - zfs_metaslab_switch_threshold)
+		metaslab_passivate(msp, weight);
+}
+
 static void
 metaslab_preload(void *arg)
 {
@@ -1769,7 +2264,7 @@ metaslab_should_condense(metaslab_t *msp)
 	 * metaslabs that are empty and metaslabs for which a condense
 	 * request has been made.
 	 */
-	rs = avl_last(&msp->ms_size_tree);
+	rs = zfs_btree_last(&msp->ms_size_tree, NULL);
 	if (rs == NULL || msp->ms_condense_wanted)
 		return (B_TRUE);
 
@@ -1783,7 +2278,8 @@ metaslab_should_condense(metaslab_t *msp)
 	entries = size / (MIN(size, SM_RUN_MAX));
 	segsz = entries * sizeof (uint64_t);
 
-	optimal_size = sizeof (uint64_t) * avl_numnodes(&msp->ms_tree->rt_root);
+	optimal_size = sizeof (uint64_t) *
+	    zfs_btree_numnodes(&msp->ms_tree->rt_root);
 	object_size = space_map_length(msp->ms_sm);
 
 	dmu_object_info_from_db(sm->sm_dbuf, &doi);
@@ -1816,7 +2312,8 @@ metaslab_condense(metaslab_t *msp, uint64_t txg, dmu_tx_t *tx)
 	    "spa %s, smp size %llu, segments %lu, forcing condense=%s", txg,
 	    msp->ms_id, msp, msp->ms_group->mg_vd->vdev_id,
 	    msp->ms_group->mg_vd->vdev_spa->spa_name,
-	    space_map_length(msp->ms_sm), avl_numnodes(&msp->ms_tree->rt_root),
+	    space_map_length(msp->ms_sm),
+	    zfs_btree_numnodes(&msp->ms_tree->rt_root),
 	    msp->ms_condense_wanted ? "TRUE" : "FALSE");
 
 	msp->ms_condense_wanted = B_FALSE;
@@ -1878,6 +2375,9 @@ metaslab_condense(metaslab_t *msp, uint64_t txg, dmu_tx_t *tx)
 	range_tree_destroy(condense_tree);
 
 	space_map_write(sm, msp->ms_tree, SM_FREE, tx);
+
+	/* Space being trimmed is just as free, it's only held back. */
+	space_map_write(sm, msp->ms_trimming, SM_FREE, tx);
 	msp->ms_condensing = B_FALSE;
 }
 
@@ -1897,6 +2397,8 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 	    &msp->ms_freetree[TXG_CLEAN(txg) & TXG_MASK];
 	dmu_tx_t *tx;
 	uint64_t object = space_map_object(msp->ms_sm);
+	space_map_t *log_sm = NULL;
+	boolean_t condense;
 
 	ASSERT(!vd->vdev_ishole);
 
@@ -1934,20 +2436,39 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 
 	tx = dmu_tx_create_assigned(spa_get_dsl(spa), txg);
 
-	if (msp->ms_sm == NULL) {
-		uint64_t new_object;
-
-		new_object = space_map_alloc(mos, tx);
-		VERIFY3U(new_object, !=, 0);
+	/*
+	 * Unless it is condensing, or has already been flushed in this
+	 * txg, a metaslab on a vdev with log space maps appends to the log
+	 * rather than to its own space map.  Once it has logged changes,
+	 * it must not write to its space map again until they have been
+	 * flushed, which a condense also does.
+	 */
+	mutex_enter(&msp->ms_lock);
+	condense = (msp->ms_loaded && spa_sync_pass(spa) == 1 &&
+	    msp->ms_sm != NULL && metaslab_should_condense(msp));
+	mutex_exit(&msp->ms_lock);
 
-		VERIFY0(space_map_open(&msp->ms_sm, mos, new_object,
-		    msp->ms_start, msp->ms_size, vd->vdev_ashift,
-		    &msp->ms_lock));
-		ASSERT(msp->ms_sm != NULL);
-	}
+	if (vd->vdev_log_zap != 0 && msp->ms_flushed_txg != txg && !condense)
+		log_sm = metaslab_log_sm_get(vd, tx);
+	else if (msp->ms_sm == NULL)
+		metaslab_sm_create(msp, tx);
 
 	mutex_enter(&msp->ms_lock);
 
+	if (log_sm != NULL) {
+		/*
+		 * The space map and its histogram are left as they are
+		 * until the metaslab is flushed.
+		 */
+		space_map_write(log_sm, alloctree, SM_ALLOC, tx);
+		space_map_write(log_sm, *freetree, SM_FREE, tx);
+		range_tree_walk(alloctree, range_tree_add,
+		    msp->ms_logged_allocs);
+		msp->ms_logged_txg = txg;
+		metaslab_set_unflushed(msp);
+		goto done;
+	}
+
 	/*
 	 * Note: metaslab_condense() clears the space_map's histogram.
 	 * Therefore we must verify and remove this histogram before
@@ -1957,9 +2478,10 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 	metaslab_class_histogram_verify(mg->mg_class);
 	metaslab_group_histogram_remove(mg, msp);
 
-	if (msp->ms_loaded && spa_sync_pass(spa) == 1 &&
-	    metaslab_should_condense(msp)) {
+	if (condense) {
 		metaslab_condense(msp, txg, tx);
+		if (vd->vdev_log_zap != 0)
+			metaslab_set_flushed(msp, txg);
 	} else {
 		space_map_write(msp->ms_sm, alloctree, SM_ALLOC, tx);
 		space_map_write(msp->ms_sm, *freetree, SM_FREE, tx);
@@ -1988,6 +2510,7 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 	metaslab_group_histogram_verify(mg);
 	metaslab_class_histogram_verify(mg->mg_class);
 
+done:
 	/*
 	 * For sync pass 1, we avoid traversing this txg's free range tree
 	 * and instead will just swap the pointers for freetree and
@@ -2011,6 +2534,10 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 		dmu_write(mos, vd->vdev_ms_array, sizeof (uint64_t) *
 		    msp->ms_id, sizeof (uint64_t), &object, tx);
 	}
+	if (condense && vd->vdev_log_zap != 0) {
+		dmu_write(mos, vd->vdev_ms_flushed_array, sizeof (uint64_t) *
+		    msp->ms_id, sizeof (uint64_t), &txg, tx);
+	}
 	dmu_tx_commit(tx);
 }
 
@@ -2023,9 +2550,11 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 {
 	metaslab_group_t *mg = msp->ms_group;
 	vdev_t *vd = mg->mg_vd;
+	spa_t *spa = vd->vdev_spa;
 	range_tree_t **freed_tree;
 	range_tree_t **defer_tree;
-	int64_t alloc_delta, defer_delta;
+	int64_t alloc_delta, defer_delta, unflushed_delta;
+	zio_t *trim_zio = NULL;
 
 	ASSERT(!vd->vdev_ishole);
 
@@ -2060,7 +2589,32 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 	freed_tree = &msp->ms_freetree[TXG_CLEAN(txg) & TXG_MASK];
 	defer_tree = &msp->ms_defertree[txg % TXG_DEFER_SIZE];
 
-	alloc_delta = space_map_alloc_delta(msp->ms_sm);
+	/*
+	 * If there's a metaslab_load() in progress, wait for it to complete
+	 * so that we have a consistent view of the in-core space map.
+	 */
+	metaslab_load_wait(msp);
+
+	/*
+	 * Fold what this txg logged into the unflushed trees, or drop them
+	 * if the metaslab's space map has just caught up with the log.
+	 */
+	unflushed_delta = range_tree_space(msp->ms_unflushed_frees) -
+	    range_tree_space(msp->ms_unflushed_allocs);
+	if (msp->ms_flushed_txg == txg) {
+		range_tree_vacate(msp->ms_unflushed_allocs, NULL, NULL);
+		range_tree_vacate(msp->ms_unflushed_frees, NULL, NULL);
+	} else if (msp->ms_logged_txg == txg) {
+		range_tree_remove_xor_add(msp->ms_logged_allocs,
+		    msp->ms_unflushed_frees, msp->ms_unflushed_allocs);
+		range_tree_remove_xor_add(*freed_tree,
+		    msp->ms_unflushed_allocs, msp->ms_unflushed_frees);
+	}
+	range_tree_vacate(msp->ms_logged_allocs, NULL, NULL);
+	unflushed_delta += range_tree_space(msp->ms_unflushed_allocs) -
+	    range_tree_space(msp->ms_unflushed_frees);
+
+	alloc_delta = space_map_alloc_delta(msp->ms_sm) + unflushed_delta;
 	defer_delta = range_tree_space(*freed_tree) -
 	    range_tree_space(*defer_tree);
 
@@ -2070,10 +2624,16 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 	ASSERT0(range_tree_space(msp->ms_freetree[txg & TXG_MASK]));
 
 	/*
-	 * If there's a metaslab_load() in progress, wait for it to complete
-	 * so that we have a consistent view of the in-core space map.
+	 * Space leaving the defer_tree is now safe to reuse, and so is also
+	 * safe to trim; remember it in the current trimset.
 	 */
-	metaslab_load_wait(msp);
+	if (spa->spa_autotrim) {
+		range_tree_walk(*defer_tree, range_tree_add,
+		    msp->ms_cur_trimset);
+	} else {
+		range_tree_vacate(msp->ms_cur_trimset, NULL, NULL);
+		range_tree_vacate(msp->ms_prev_trimset, NULL, NULL);
+	}
 
 	/*
 	 * Move the frees from the defer_tree back to the free
@@ -2098,18 +2658,49 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 		vdev_dirty(vd, VDD_METASLAB, msp, txg + 1);
 	}
 
+	/*
+	 * Every zfs_txgs_per_trim txgs, trim what's left of the previous
+	 * trimset (anything reallocated since has been cleared from it) and
+	 * start a new one.  If a trim is still outstanding, or the config
+	 * lock is contended, we'll try again next txg.
+	 */
+	if (txg != 0 && spa_writeable(spa) &&
+	    txg >= msp->ms_trim_txg + zfs_txgs_per_trim &&
+	    range_tree_space(msp->ms_trimming) == 0 &&
+	    spa_config_tryenter(spa, SCL_ZIO, msp, RW_READER)) {
+		trim_zio = metaslab_trim(msp, msp->ms_prev_trimset);
+		range_tree_swap(&msp->ms_cur_trimset, &msp->ms_prev_trimset);
+		msp->ms_trim_txg = txg;
+	}
+	if (range_tree_space(msp->ms_cur_trimset) != 0 ||
+	    range_tree_space(msp->ms_prev_trimset) != 0)
+		vdev_dirty(vd, VDD_METASLAB, msp, txg + 1);
+
 	if (msp->ms_loaded && msp->ms_access_txg < txg) {
 		for (int t = 1; t < TXG_CONCURRENT_STATES; t++) {
 			VERIFY0(range_tree_space(
 			    msp->ms_alloctree[(txg + t) & TXG_MASK]));
 		}
 
-		if (!metaslab_debug_unload)
+		/*
+		 * Unloading drops the active bits; hand the metaslab back
+		 * to its allocator first so the group doesn't keep
+		 * pointing at it.
+		 */
+		if (!metaslab_debug_unload) {
+			if (msp->ms_weight & METASLAB_ACTIVE_MASK) {
+				metaslab_passivate(msp,
+				    msp->ms_weight & ~METASLAB_ACTIVE_MASK);
+			}
 			metaslab_unload(msp);
+		}
 	}
 
 	metaslab_group_sort(mg, msp, metaslab_weight(msp));
 	mutex_exit(&msp->ms_lock);
+
+	if (trim_zio != NULL)
+		zio_nowait(trim_zio);
 }
 
 void
@@ -2143,12 +2734,679 @@ metaslab_distance(metaslab_t *msp, dva_t *dva)
 
 /*
  * ==========================================================================
- * Metaslab block operations
+ * Log space maps
  * ==========================================================================
- */
+ *
+ * Appending each txg's allocs and frees to the space map of every dirty
+ * metaslab costs at least one block write per metaslab per txg, which
+ * adds up when writes are spread over many metaslabs.  On pools with the
+ * log_spacemap feature, each top-level vdev instead gets one space map per
+ * txg, covering the whole vdev, that all its metaslabs append to.  The
+ * metaslabs' own space maps are brought up to date ("flushed") lazily:
+ * each txg, the metaslabs that have gone longest without a flush are
+ * written out, enough of them that every metaslab is flushed within about
+ * zfs_log_sm_max_logs txgs of logging, and the logs that no unflushed
+ * metaslab needs any more are freed.
+ *
+ * In core, ms_unflushed_allocs holds space that is allocated but not in
+ * the metaslab's space map, and ms_unflushed_frees space that the space
+ * map shows as allocated but has since been freed.  They are applied on
+ * top of the space map when the metaslab is loaded, and are counted in its
+ * allocated space.  The space map's histogram is only updated by flushes,
+ * so unloaded metaslabs are weighed by a histogram that can lag behind.
+ *
+ * On disk, the vdev's ZAP has a ZAP of txg -> log space map object, and an
+ * array of the txg each metaslab was last flushed in.  At import the logs
+ * are replayed in txg order, applying from each log only the entries of
+ * metaslabs that were last flushed before it.
+ */
+
+int
+metaslab_log_sm_compare(const void *x1, const void *x2)
+{
+	const vdev_log_sm_t *l1 = x1;
+	const vdev_log_sm_t *l2 = x2;
+
+	if (l1->vls_txg < l2->vls_txg)
+		return (-1);
+	if (l1->vls_txg > l2->vls_txg)
+		return (1);
+	return (0);
+}
+
+int
+metaslab_unflushed_compare(const void *x1, const void *x2)
+{
+	const metaslab_t *m1 = x1;
+	const metaslab_t *m2 = x2;
+
+	if (m1->ms_flushed_txg < m2->ms_flushed_txg)
+		return (-1);
+	if (m1->ms_flushed_txg > m2->ms_flushed_txg)
+		return (1);
+	if (m1->ms_id < m2->ms_id)
+		return (-1);
+	if (m1->ms_id > m2->ms_id)
+		return (1);
+	return (0);
+}
+
+/*
+ * Allocate the metaslab's space map object.  The caller records it in
+ * the vdev's metaslab array.
+ */
+static void
+metaslab_sm_create(metaslab_t *msp, dmu_tx_t *tx)
+{
+	vdev_t *vd = msp->ms_group->mg_vd;
+	objset_t *mos = spa_meta_objset(vd->vdev_spa);
+	uint64_t object;
+
+	ASSERT3P(msp->ms_sm, ==, NULL);
+
+	object = space_map_alloc(mos, tx);
+	VERIFY3U(object, !=, 0);
+
+	VERIFY0(space_map_open(&msp->ms_sm, mos, object, msp->ms_start,
+	    msp->ms_size, vd->vdev_ashift, &msp->ms_lock));
+	ASSERT(msp->ms_sm != NULL);
+}
+
+/*
+ * Note that the metaslab has logged changes that aren't in its space map.
+ */
+static void
+metaslab_set_unflushed(metaslab_t *msp)
+{
+	vdev_t *vd = msp->ms_group->mg_vd;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	if (msp->ms_unflushed)
+		return;
+
+	mutex_enter(&vd->vdev_log_lock);
+	avl_add(&vd->vdev_unflushed_ms, msp);
+	mutex_exit(&vd->vdev_log_lock);
+	msp->ms_unflushed = B_TRUE;
+}
+
+/*
+ * Note that the metaslab's space map includes everything logged before
+ * txg.  The unflushed trees are emptied in metaslab_sync_done(), once the
+ * space map writes have synced.
+ */
+static void
+metaslab_set_flushed(metaslab_t *msp, uint64_t txg)
+{
+	vdev_t *vd = msp->ms_group->mg_vd;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	mutex_enter(&vd->vdev_log_lock);
+	if (msp->ms_unflushed)
+		avl_remove(&vd->vdev_unflushed_ms, msp);
+	msp->ms_unflushed = B_FALSE;
+	msp->ms_flushed_txg = txg;
+	mutex_exit(&vd->vdev_log_lock);
+}
+
+/*
+ * Return the vdev's log space map for the syncing txg, creating it on
+ * first use.
+ */
+static space_map_t *
+metaslab_log_sm_get(vdev_t *vd, dmu_tx_t *tx)
+{
+	objset_t *mos = spa_meta_objset(vd->vdev_spa);
+	uint64_t txg = dmu_tx_get_txg(tx);
+	vdev_log_sm_t *vls;
+	uint64_t object;
+
+	if (vd->vdev_log_sm != NULL) {
+		ASSERT3U(vd->vdev_log_sm_txg, ==, txg);
+		return (vd->vdev_log_sm);
+	}
+
+	object = space_map_alloc(mos, tx);
+	VERIFY0(zap_add_int_key(mos, vd->vdev_log_zap, txg, object, tx));
+	VERIFY0(space_map_open(&vd->vdev_log_sm, mos, object, 0,
+	    vd->vdev_ms_count << vd->vdev_ms_shift, vd->vdev_ashift,
+	    &vd->vdev_log_lock));
+	vd->vdev_log_sm_txg = txg;
+
+	vls = kmem_zalloc(sizeof (vdev_log_sm_t), KM_SLEEP);
+	vls->vls_txg = txg;
+	vls->vls_object = object;
+	mutex_enter(&vd->vdev_log_lock);
+	avl_add(&vd->vdev_log_sms, vls);
+	mutex_exit(&vd->vdev_log_lock);
+
+	return (vd->vdev_log_sm);
+}
+
+static void
+metaslab_log_sm_free(vdev_t *vd, vdev_log_sm_t *vls, dmu_tx_t *tx)
+{
+	objset_t *mos = spa_meta_objset(vd->vdev_spa);
+	space_map_t *sm = NULL;
+
+	VERIFY0(space_map_open(&sm, mos, vls->vls_object, 0,
+	    vd->vdev_ms_count << vd->vdev_ms_shift, vd->vdev_ashift,
+	    &vd->vdev_log_lock));
+	space_map_free(sm, tx);
+	space_map_close(sm);
+
+	kmem_free(vls, sizeof (vdev_log_sm_t));
+}
+
+/*
+ * Write the metaslab's logged changes to its space map.
+ */
+static void
+metaslab_flush(metaslab_t *msp, dmu_tx_t *tx)
+{
+	metaslab_group_t *mg = msp->ms_group;
+	vdev_t *vd = mg->mg_vd;
+	objset_t *mos = spa_meta_objset(vd->vdev_spa);
+	uint64_t txg = dmu_tx_get_txg(tx);
+	uint64_t object = space_map_object(msp->ms_sm);
+
+	if (msp->ms_sm == NULL)
+		metaslab_sm_create(msp, tx);
+
+	mutex_enter(&msp->ms_lock);
+
+	metaslab_group_histogram_verify(mg);
+	metaslab_group_histogram_remove(mg, msp);
+
+	space_map_write(msp->ms_sm, msp->ms_unflushed_allocs, SM_ALLOC, tx);
+	space_map_write(msp->ms_sm, msp->ms_unflushed_frees, SM_FREE, tx);
+
+	/*
+	 * As in metaslab_sync(), the histogram is rebuilt if the metaslab
+	 * is loaded, and otherwise only gains what was freed.
+	 */
+	if (msp->ms_loaded) {
+		space_map_histogram_clear(msp->ms_sm);
+		space_map_histogram_add(msp->ms_sm, msp->ms_tree, tx);
+	} else {
+		space_map_histogram_add(msp->ms_sm, msp->ms_unflushed_frees,
+		    tx);
+	}
+	metaslab_group_histogram_add(mg, msp);
+	metaslab_group_histogram_verify(mg);
+
+	metaslab_set_flushed(msp, txg);
+
+	mutex_exit(&msp->ms_lock);
+
+	if (object != space_map_object(msp->ms_sm)) {
+		object = space_map_object(msp->ms_sm);
+		dmu_write(mos, vd->vdev_ms_array, sizeof (uint64_t) *
+		    msp->ms_id, sizeof (uint64_t), &object, tx);
+	}
+	dmu_write(mos, vd->vdev_ms_flushed_array, sizeof (uint64_t) *
+	    msp->ms_id, sizeof (uint64_t), &txg, tx);
+
+	/*
+	 * Make sure metaslab_sync_done() runs for the metaslab even if it
+	 * has nothing else to sync.
+	 */
+	(void) txg_list_add(&vd->vdev_ms_list, msp, TXG_CLEAN(txg));
+}
+
+/*
+ * Flush the metaslabs that have gone longest without a flush, and free
+ * the logs that no unflushed metaslab needs any more.
+ */
+static void
+metaslab_log_flush(vdev_t *vd, dmu_tx_t *tx)
+{
+	uint64_t txg = dmu_tx_get_txg(tx);
+	metaslab_t **flush = NULL;
+	metaslab_t *msp;
+	vdev_log_sm_t *vls;
+	uint64_t nflush, min_txg;
+
+	mutex_enter(&vd->vdev_log_lock);
+	nflush = howmany(avl_numnodes(&vd->vdev_unflushed_ms),
+	    MAX(zfs_log_sm_max_logs, 1));
+	if (nflush != 0) {
+		flush = kmem_alloc(nflush * sizeof (metaslab_t *), KM_SLEEP);
+		msp = avl_first(&vd->vdev_unflushed_ms);
+		for (uint64_t i = 0; i < nflush; i++) {
+			flush[i] = msp;
+			msp = AVL_NEXT(&vd->vdev_unflushed_ms, msp);
+		}
+	}
+	mutex_exit(&vd->vdev_log_lock);
+
+	for (uint64_t i = 0; i < nflush; i++)
+		metaslab_flush(flush[i], tx);
+	if (flush != NULL)
+		kmem_free(flush, nflush * sizeof (metaslab_t *));
+
+	/*
+	 * A log is no longer needed once every metaslab with unflushed
+	 * changes was flushed in or after its txg.
+	 */
+	mutex_enter(&vd->vdev_log_lock);
+	msp = avl_first(&vd->vdev_unflushed_ms);
+	min_txg = (msp != NULL) ? msp->ms_flushed_txg : txg;
+	while ((vls = avl_first(&vd->vdev_log_sms)) != NULL &&
+	    vls->vls_txg <= min_txg) {
+		avl_remove(&vd->vdev_log_sms, vls);
+		mutex_exit(&vd->vdev_log_lock);
+
+		VERIFY0(zap_remove_int(spa_meta_objset(vd->vdev_spa),
+		    vd->vdev_log_zap, vls->vls_txg, tx));
+		metaslab_log_sm_free(vd, vls, tx);
+
+		mutex_enter(&vd->vdev_log_lock);
+	}
+	mutex_exit(&vd->vdev_log_lock);
+}
+
+/*
+ * Called from vdev_sync() ahead of the metaslabs: create the vdev's log
+ * objects once the feature is enabled, and do this txg's flushing.
+ */
+void
+metaslab_log_sync(vdev_t *vd, uint64_t txg)
+{
+	spa_t *spa = vd->vdev_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	dmu_tx_t *tx;
+
+	ASSERT(vd == vd->vdev_top);
+
+	if (vd->vdev_ms_shift == 0 || vd->vdev_log_flush_txg == txg)
+		return;
+	vd->vdev_log_flush_txg = txg;
+
+	tx = dmu_tx_create_assigned(spa_get_dsl(spa), txg);
+
+	if (vd->vdev_log_zap == 0 && zfs_log_sm_enabled &&
+	    vd->vdev_top_zap != 0 && !vd->vdev_removing &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_LOG_SPACEMAP)) {
+		vd->vdev_log_zap = zap_create(mos, DMU_OTN_ZAP_METADATA,
+		    DMU_OT_NONE, 0, tx);
+		vd->vdev_ms_flushed_array = dmu_object_alloc(mos,
+		    DMU_OTN_UINT64_METADATA, 0, DMU_OT_NONE, 0, tx);
+		VERIFY0(zap_add(mos, vd->vdev_top_zap,
+		    VDEV_TOP_ZAP_LOG_SPACEMAP, sizeof (uint64_t), 1,
+		    &vd->vdev_log_zap, tx));
+		VERIFY0(zap_add(mos, vd->vdev_top_zap,
+		    VDEV_TOP_ZAP_MS_FLUSHED_TXGS, sizeof (uint64_t), 1,
+		    &vd->vdev_ms_flushed_array, tx));
+		spa_feature_incr(spa, SPA_FEATURE_LOG_SPACEMAP, tx);
+	}
+
+	if (vd->vdev_log_zap != 0)
+		metaslab_log_flush(vd, tx);
+
+	dmu_tx_commit(tx);
+}
+
+/*
+ * Called from vdev_sync_done(): this txg's log is complete.
+ */
+void
+metaslab_log_sync_done(vdev_t *vd, uint64_t txg)
+{
+	if (vd->vdev_log_sm != NULL) {
+		ASSERT3U(vd->vdev_log_sm_txg, ==, txg);
+		space_map_close(vd->vdev_log_sm);
+		vd->vdev_log_sm = NULL;
+	}
+}
+
+typedef struct metaslab_log_replay {
+	vdev_t		*mlr_vd;
+	uint64_t	mlr_txg;
+} metaslab_log_replay_t;
+
+static int
+metaslab_log_replay_cb(maptype_t type, uint64_t offset, uint64_t size,
+    void *arg)
+{
+	metaslab_log_replay_t *mlr = arg;
+	vdev_t *vd = mlr->mlr_vd;
+	metaslab_t *msp = vd->vdev_ms[offset >> vd->vdev_ms_shift];
+
+	if (offset + size > msp->ms_start + msp->ms_size)
+		return (SET_ERROR(EIO));
+
+	if (mlr->mlr_txg <= msp->ms_flushed_txg)
+		return (0);
+
+	mutex_enter(&msp->ms_lock);
+	if (type == SM_ALLOC) {
+		range_tree_remove_xor_add_segment(offset, offset + size,
+		    msp->ms_unflushed_frees, msp->ms_unflushed_allocs);
+		if (msp->ms_loaded)
+			range_tree_remove(msp->ms_tree, offset, size);
+	} else {
+		range_tree_remove_xor_add_segment(offset, offset + size,
+		    msp->ms_unflushed_allocs, msp->ms_unflushed_frees);
+		if (msp->ms_loaded)
+			range_tree_add(msp->ms_tree, offset, size);
+	}
+	metaslab_set_unflushed(msp);
+	mutex_exit(&msp->ms_lock);
+
+	return (0);
+}
+
+/*
+ * Called from vdev_metaslab_init() when opening the pool: find the vdev's
+ * logs and replay them into its metaslabs.
+ */
+int
+metaslab_log_load(vdev_t *vd)
+{
+	objset_t *mos = spa_meta_objset(vd->vdev_spa);
+	metaslab_log_replay_t mlr;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	vdev_log_sm_t *vls;
+	int error;
+
+	ASSERT(vd == vd->vdev_top);
+
+	if (vd->vdev_top_zap == 0)
+		return (0);
+
+	error = zap_lookup(mos, vd->vdev_top_zap, VDEV_TOP_ZAP_LOG_SPACEMAP,
+	    sizeof (uint64_t), 1, &vd->vdev_log_zap);
+	if (error == ENOENT)
+		return (0);
+	if (error == 0) {
+		error = zap_lookup(mos, vd->vdev_top_zap,
+		    VDEV_TOP_ZAP_MS_FLUSHED_TXGS, sizeof (uint64_t), 1,
+		    &vd->vdev_ms_flushed_array);
+	}
+	if (error != 0)
+		return (error);
+
+	for (uint64_t m = 0; m < vd->vdev_ms_count; m++) {
+		metaslab_t *msp = vd->vdev_ms[m];
+
+		error = dmu_read(mos, vd->vdev_ms_flushed_array,
+		    m * sizeof (uint64_t), sizeof (uint64_t),
+		    &msp->ms_flushed_txg, DMU_READ_PREFETCH);
+		if (error != 0)
+			return (error);
+	}
+
+	for (zap_cursor_init(&zc, mos, vd->vdev_log_zap);
+	    (error = zap_cursor_retrieve(&zc, &za)) == 0;
+	    zap_cursor_advance(&zc)) {
+		vls = kmem_zalloc(sizeof (vdev_log_sm_t), KM_SLEEP);
+		vls->vls_txg = strtonum(za.za_name, NULL);
+		vls->vls_object = za.za_first_integer;
+		mutex_enter(&vd->vdev_log_lock);
+		avl_add(&vd->vdev_log_sms, vls);
+		mutex_exit(&vd->vdev_log_lock);
+	}
+	zap_cursor_fini(&zc);
+	if (error != ENOENT)
+		return (error);
+
+	mlr.mlr_vd = vd;
+	for (vls = avl_first(&vd->vdev_log_sms); vls != NULL;
+	    vls = AVL_NEXT(&vd->vdev_log_sms, vls)) {
+		space_map_t *sm = NULL;
+
+		error = space_map_open(&sm, mos, vls->vls_object, 0,
+		    vd->vdev_ms_count << vd->vdev_ms_shift, vd->vdev_ashift,
+		    &vd->vdev_log_lock);
+		if (error == 0) {
+			mlr.mlr_txg = vls->vls_txg;
+			error = space_map_iterate(sm, metaslab_log_replay_cb,
+			    &mlr);
+			space_map_close(sm);
+		}
+		if (error != 0)
+			return (error);
+	}
+
+	/*
+	 * metaslab_init() only accounted for what is in the space maps.
+	 */
+	for (uint64_t m = 0; m < vd->vdev_ms_count; m++) {
+		metaslab_t *msp = vd->vdev_ms[m];
+
+		if (!msp->ms_unflushed)
+			continue;
+
+		mutex_enter(&msp->ms_lock);
+		vdev_space_update(vd,
+		    range_tree_space(msp->ms_unflushed_allocs) -
+		    range_tree_space(msp->ms_unflushed_frees), 0, 0);
+		metaslab_group_sort(msp->ms_group, msp, metaslab_weight(msp));
+		mutex_exit(&msp->ms_lock);
+	}
+
+	return (0);
+}
+
+/*
+ * Called from vdev_remove(), once the metaslabs' space maps are gone:
+ * free the vdev's log objects.  Whatever the metaslabs logged cancels
+ * out, since the vdev is empty.
+ */
+void
+metaslab_log_destroy(vdev_t *vd, dmu_tx_t *tx)
+{
+	spa_t *spa = vd->vdev_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	vdev_log_sm_t *vls;
+
+	if (vd->vdev_log_zap == 0)
+		return;
+
+	space_map_close(vd->vdev_log_sm);
+	vd->vdev_log_sm = NULL;
+
+	mutex_enter(&vd->vdev_log_lock);
+	while ((vls = avl_first(&vd->vdev_log_sms)) != NULL) {
+		avl_remove(&vd->vdev_log_sms, vls);
+		mutex_exit(&vd->vdev_log_lock);
+		metaslab_log_sm_free(vd, vls, tx);
+		mutex_enter(&vd->vdev_log_lock);
+	}
+	mutex_exit(&vd->vdev_log_lock);
+
+	for (uint64_t m = 0; m < vd->vdev_ms_count; m++) {
+		metaslab_t *msp = vd->vdev_ms[m];
+
+		mutex_enter(&msp->ms_lock);
+		range_tree_vacate(msp->ms_unflushed_allocs, NULL, NULL);
+		range_tree_vacate(msp->ms_unflushed_frees, NULL, NULL);
+		range_tree_vacate(msp->ms_logged_allocs, NULL, NULL);
+		metaslab_set_flushed(msp, 0);
+		msp->ms_logged_txg = 0;
+		mutex_exit(&msp->ms_lock);
+	}
+
+	VERIFY0(zap_destroy(mos, vd->vdev_log_zap, tx));
+	VERIFY0(dmu_object_free(mos, vd->vdev_ms_flushed_array, tx));
+	VERIFY0(zap_remove(mos, vd->vdev_top_zap, VDEV_TOP_ZAP_LOG_SPACEMAP,
+	    tx));
+	VERIFY0(zap_remove(mos, vd->vdev_top_zap,
+	    VDEV_TOP_ZAP_MS_FLUSHED_TXGS, tx));
+	vd->vdev_log_zap = 0;
+	vd->vdev_ms_flushed_array = 0;
+
+	spa_feature_decr(spa, SPA_FEATURE_LOG_SPACEMAP, tx);
+}
+
+/*
+ * Called from vdev_metaslab_fini(), after the metaslabs are gone.
+ */
+void
+metaslab_log_fini(vdev_t *vd)
+{
+	vdev_log_sm_t *vls;
+	void *cookie = NULL;
+
+	ASSERT3P(vd->vdev_log_sm, ==, NULL);
+	ASSERT0(avl_numnodes(&vd->vdev_unflushed_ms));
+
+	mutex_enter(&vd->vdev_log_lock);
+	while ((vls = avl_destroy_nodes(&vd->vdev_log_sms, &cookie)) != NULL)
+		kmem_free(vls, sizeof (vdev_log_sm_t));
+	mutex_exit(&vd->vdev_log_lock);
+
+	vd->vdev_log_zap = 0;
+	vd->vdev_ms_flushed_array = 0;
+}
+
+/*
+ * ==========================================================================
+ * Metaslab trimming
+ * ==========================================================================
+ */
 
 static void
-metaslab_group_alloc_increment(spa_t *spa, uint64_t vdev, void *tag, int flags)
+metaslab_trim_add(void *arg, uint64_t start, uint64_t size)
+{
+	metaslab_t *msp = arg;
+
+	if (size < zfs_trim_min_ext_sz)
+		return;
+
+	range_tree_add(msp->ms_trimming, start, size);
+	if (msp->ms_loaded)
+		range_tree_remove(msp->ms_tree, start, size);
+}
+
+static void
+metaslab_trim_issue(void *arg, uint64_t start, uint64_t size)
+{
+	zio_t *pio = arg;
+	metaslab_t *msp = pio->io_private;
+
+	zio_nowait(zio_trim(pio, pio->io_spa, msp->ms_group->mg_vd,
+	    start, size));
+}
+
+static void
+metaslab_trim_done(zio_t *zio)
+{
+	metaslab_t *msp = zio->io_private;
+	spa_t *spa = zio->io_spa;
+
+	mutex_enter(&msp->ms_lock);
+	range_tree_vacate(msp->ms_trimming,
+	    msp->ms_loaded ? range_tree_add : NULL, msp->ms_tree);
+	if (msp->ms_loaded)
+		msp->ms_max_size = metaslab_block_maxsize(msp);
+	cv_broadcast(&msp->ms_trim_cv);
+	mutex_exit(&msp->ms_lock);
+
+	spa_config_exit(spa, SCL_ZIO, msp);
+}
+
+/*
+ * Trim the ranges in ts, emptying it.  Extents being trimmed are moved to
+ * ms_trimming, and held out of ms_tree so that they can't be allocated and
+ * written to before the trim completes.  The caller must hold SCL_ZIO (with
+ * msp as the tag), which is dropped when the trim completes, or here if
+ * there turns out to be nothing to do.
+ *
+ * Returns the root zio of the trim, or NULL.  The caller must issue it only
+ * after dropping ms_lock, since its completion takes the lock.
+ */
+static zio_t *
+metaslab_trim(metaslab_t *msp, range_tree_t *ts)
+{
+	spa_t *spa = msp->ms_group->mg_vd->vdev_spa;
+	zio_t *zio;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+	ASSERT(spa_config_held(spa, SCL_ZIO, RW_READER));
+	ASSERT0(range_tree_space(msp->ms_trimming));
+
+	range_tree_vacate(ts, metaslab_trim_add, msp);
+	if (range_tree_space(msp->ms_trimming) == 0) {
+		spa_config_exit(spa, SCL_ZIO, msp);
+		return (NULL);
+	}
+	if (msp->ms_loaded)
+		msp->ms_max_size = metaslab_block_maxsize(msp);
+
+	zio = zio_root(spa, metaslab_trim_done, msp, ZIO_FLAG_CANFAIL);
+	range_tree_walk(msp->ms_trimming, metaslab_trim_issue, zio);
+
+	return (zio);
+}
+
+/*
+ * Trim all of the metaslab's free space, for "zpool trim".  Waits for the
+ * trim to complete.
+ */
+int
+metaslab_trim_all(metaslab_t *msp)
+{
+	spa_t *spa = msp->ms_group->mg_vd->vdev_spa;
+	range_tree_t *ts;
+	zio_t *zio;
+	int error = 0;
+
+	/* Not yet synced for the first time, so there's nothing to trim. */
+	if (msp->ms_defertree[0] == NULL)
+		return (0);
+
+	spa_config_enter(spa, SCL_ZIO, msp, RW_READER);
+	mutex_enter(&msp->ms_lock);
+
+	for (;;) {
+		metaslab_load_wait(msp);
+		if (range_tree_space(msp->ms_trimming) != 0) {
+			cv_wait(&msp->ms_trim_cv, &msp->ms_lock);
+			continue;
+		}
+		if (!msp->ms_loaded)
+			error = metaslab_load(msp);
+		break;
+	}
+
+	if (error != 0) {
+		mutex_exit(&msp->ms_lock);
+		spa_config_exit(spa, SCL_ZIO, msp);
+		return (error);
+	}
+
+	/*
+	 * Everything free is about to be trimmed, so autotrim has nothing
+	 * left to do here.
+	 */
+	ts = range_tree_create(NULL, msp, &msp->ms_lock);
+	range_tree_walk(msp->ms_tree, range_tree_add, ts);
+	range_tree_vacate(msp->ms_cur_trimset, NULL, NULL);
+	range_tree_vacate(msp->ms_prev_trimset, NULL, NULL);
+	zio = metaslab_trim(msp, ts);
+	range_tree_destroy(ts);
+	mutex_exit(&msp->ms_lock);
+
+	if (zio != NULL)
+		error = zio_wait(zio);
+
+	return (error);
+}
+
+/*
+ * ==========================================================================
+ * Metaslab block operations
+ * ==========================================================================
+ */
+
+static void
+metaslab_group_alloc_increment(spa_t *spa, uint64_t vdev, void *tag, int flags,
+    int allocator)
 {
 	if (!(flags & METASLAB_ASYNC_ALLOC) ||
 	    flags & METASLAB_DONT_THROTTLE)
@@ -2158,11 +3416,13 @@ metaslab_group_alloc_increment(spa_t *spa, uint64_t vdev, void *tag, int flags)
 	if (!mg->mg_class->mc_alloc_throttle_enabled)
 		return;
 
-	(void) refcount_add(&mg->mg_alloc_queue_depth, tag);
+	(void) refcount_add(&mg->mg_allocator[allocator].mga_alloc_queue_depth,
+	    tag);
 }
 
 void
-metaslab_group_alloc_decrement(spa_t *spa, uint64_t vdev, void *tag, int flags)
+metaslab_group_alloc_decrement(spa_t *spa, uint64_t vdev, void *tag, int flags,
+    int allocator)
 {
 	if (!(flags & METASLAB_ASYNC_ALLOC) ||
 	    flags & METASLAB_DONT_THROTTLE)
@@ -2172,11 +3432,13 @@ metaslab_group_alloc_decrement(spa_t *spa, uint64_t vdev, void *tag, int flags)
 	if (!mg->mg_class->mc_alloc_throttle_enabled)
 		return;
 
-	(void) refcount_remove(&mg->mg_alloc_queue_depth, tag);
+	(void) refcount_remove(
+	    &mg->mg_allocator[allocator].mga_alloc_queue_depth, tag);
 }
 
 void
-metaslab_group_alloc_verify(spa_t *spa, const blkptr_t *bp, void *tag)
+metaslab_group_alloc_verify(spa_t *spa, const blkptr_t *bp, void *tag,
+    int allocator)
 {
 #ifdef ZFS_DEBUG
 	const dva_t *dva = bp->blk_dva;
@@ -2185,19 +3447,21 @@ metaslab_group_alloc_verify(spa_t *spa, const blkptr_t *bp, void *tag)
 	for (int d = 0; d < ndvas; d++) {
 		uint64_t vdev = DVA_GET_VDEV(&dva[d]);
 		metaslab_group_t *mg = vdev_lookup_top(spa, vdev)->vdev_mg;
-		VERIFY(refcount_not_held(&mg->mg_alloc_queue_depth, tag));
+		VERIFY(refcount_not_held(
+		    &mg->mg_allocator[allocator].mga_alloc_queue_depth, tag));
 	}
 #endif
 }
 
 static uint64_t
 metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
-    uint64_t txg, uint64_t min_distance, dva_t *dva, int d)
+    uint64_t txg, uint64_t min_distance, dva_t *dva, int d, int allocator)
 {
 	spa_t *spa = mg->mg_vd->vdev_spa;
 	metaslab_t *msp = NULL;
 	uint64_t offset = -1ULL;
 	avl_tree_t *t = &mg->mg_metaslab_tree;
+	metaslab_group_allocator_t *mga;
 	uint64_t activation_weight;
 	uint64_t target_distance;
 	int i;
@@ -2210,46 +3474,80 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
 		}
 	}
 
+	/*
+	 * A small vdev doesn't have enough metaslabs to give every allocator
+	 * its own without fragmenting the free space; share the first one.
+	 */
+	if (mg->mg_vd->vdev_ms_count < mg->mg_allocators * 3)
+		allocator = 0;
+	mga = &mg->mg_allocator[allocator];
+
 	for (;;) {
 		boolean_t was_active;
 
+		/*
+		 * Go straight to the allocator's own active metaslab if it
+		 * has one.  Otherwise take the best metaslab in the group
+		 * that isn't active for another allocator, or, failing that,
+		 * share one that is.
+		 */
 		mutex_enter(&mg->mg_lock);
-		for (msp = avl_first(t); msp; msp = AVL_NEXT(t, msp)) {
-			if (msp->ms_weight < asize) {
-				spa_dbgmsg(spa, "%s: failed to meet weight "
-				    "requirement: vdev %llu, txg %llu, mg %p, "
-				    "msp %p, asize %llu, "
-				    "weight %llu", spa_name(spa),
-				    mg->mg_vd->vdev_id, txg,
-				    mg, msp, asize, msp->ms_weight);
-				mutex_exit(&mg->mg_lock);
-				return (-1ULL);
-			}
+		msp = (activation_weight == METASLAB_WEIGHT_PRIMARY) ?
+		    mga->mga_primary : mga->mga_secondary;
+		was_active = (msp != NULL);
+		for (metaslab_t *m = msp == NULL ? avl_first(t) : NULL;
+		    m != NULL; m = AVL_NEXT(t, m)) {
+			/*
+			 * Space-based and segment-based weights order
+			 * metaslabs differently, so a metaslab that is too
+			 * small doesn't mean the rest are too; keep looking.
+			 */
+			if (!metaslab_should_allocate(m, asize))
+				continue;
 
 			/*
 			 * If the selected metaslab is condensing, skip it.
 			 */
-			if (msp->ms_condensing)
+			if (m->ms_condensing)
 				continue;
 
-			was_active = msp->ms_weight & METASLAB_ACTIVE_MASK;
-			if (activation_weight == METASLAB_WEIGHT_PRIMARY)
-				break;
-
-			target_distance = min_distance +
-			    (space_map_allocated(msp->ms_sm) != 0 ? 0 :
-			    min_distance >> 1);
+			/*
+			 * Remember the first metaslab another allocator has
+			 * active, in case there is nothing better.
+			 */
+			if (m->ms_allocator != -1 && m->ms_allocator !=
+			    allocator) {
+				if (msp == NULL) {
+					msp = m;
+					was_active = B_TRUE;
+				}
+				continue;
+			}
 
-			for (i = 0; i < d; i++)
-				if (metaslab_distance(msp, &dva[i]) <
-				    target_distance)
-					break;
-			if (i == d)
-				break;
+			if (activation_weight == METASLAB_WEIGHT_SECONDARY) {
+				target_distance = min_distance +
+				    (metaslab_allocated_space(m) != 0 ? 0 :
+				    min_distance >> 1);
+
+				for (i = 0; i < d; i++)
+					if (metaslab_distance(m, &dva[i]) <
+					    target_distance)
+						break;
+				if (i != d)
+					continue;
+			}
+			msp = m;
+			was_active = m->ms_weight & METASLAB_ACTIVE_MASK;
+			break;
 		}
 		mutex_exit(&mg->mg_lock);
-		if (msp == NULL)
+		if (msp == NULL) {
+			spa_dbgmsg(spa, "%s: no metaslab can satisfy "
+			    "allocation: vdev %llu, txg %llu, mg %p, "
+			    "asize %llu", spa_name(spa),
+			    mg->mg_vd->vdev_id, txg, mg, asize);
 			return (-1ULL);
+		}
 
 		mutex_enter(&msp->ms_lock);
 
@@ -2257,11 +3555,23 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
 		 * Ensure that the metaslab we have selected is still
 		 * capable of handling our request. It's possible that
 		 * another thread may have changed the weight while we
-		 * were blocked on the metaslab lock.
+		 * were blocked on the metaslab lock.  If it is our own
+		 * active metaslab that can't take the allocation, or that
+		 * is condensing, give it up; otherwise we would keep
+		 * coming back to it.
 		 */
-		if (msp->ms_weight < asize || (was_active &&
-		    !(msp->ms_weight & METASLAB_ACTIVE_MASK) &&
-		    activation_weight == METASLAB_WEIGHT_PRIMARY)) {
+		if (was_active && !(msp->ms_weight & METASLAB_ACTIVE_MASK) &&
+		    activation_weight == METASLAB_WEIGHT_PRIMARY) {
+			mutex_exit(&msp->ms_lock);
+			continue;
+		}
+		if (!metaslab_should_allocate(msp, asize) ||
+		    msp->ms_condensing) {
+			if (msp->ms_allocator == allocator &&
+			    (msp->ms_weight & METASLAB_ACTIVE_MASK)) {
+				metaslab_passivate(msp,
+				    msp->ms_weight & ~METASLAB_ACTIVE_MASK);
+			}
 			mutex_exit(&msp->ms_lock);
 			continue;
 		}
@@ -2274,7 +3584,7 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
 			continue;
 		}
 
-		if (metaslab_activate(msp, activation_weight) != 0) {
+		if (metaslab_activate(msp, allocator, activation_weight) != 0) {
 			mutex_exit(&msp->ms_lock);
 			continue;
 		}
@@ -2285,14 +3595,37 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
 		 * to disk.
 		 */
 		if (msp->ms_condensing) {
+			if (msp->ms_allocator == allocator) {
+				metaslab_passivate(msp,
+				    msp->ms_weight & ~METASLAB_ACTIVE_MASK);
+			}
 			mutex_exit(&msp->ms_lock);
 			continue;
 		}
 
-		if ((offset = metaslab_block_alloc(msp, asize)) != -1ULL)
+		/*
+		 * Now that the metaslab is loaded its largest free segment
+		 * is known exactly; recheck before trying the allocation.
+		 */
+		if (metaslab_should_allocate(msp, asize) &&
+		    (offset = metaslab_block_alloc(msp, asize)) != -1ULL)
 			break;
 
-		metaslab_passivate(msp, metaslab_block_maxsize(msp));
+		/*
+		 * We couldn't allocate from this metaslab, so give it a
+		 * better-informed weight now that it's loaded.  A space-based
+		 * metaslab gets its largest free segment; a segment-based one
+		 * gets the top bucket of its range tree, which is accurate
+		 * even within a sync pass.
+		 */
+		if (WEIGHT_IS_SPACEBASED(msp->ms_weight)) {
+			uint64_t weight = metaslab_block_maxsize(msp);
+			WEIGHT_SET_SPACEBASED(weight);
+			metaslab_passivate(msp, weight);
+		} else {
+			metaslab_passivate(msp,
+			    metaslab_weight_from_range_tree(msp));
+		}
 		mutex_exit(&msp->ms_lock);
 	}
 
@@ -2302,6 +3635,8 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
 	range_tree_add(msp->ms_alloctree[txg & TXG_MASK], offset, asize);
 	msp->ms_access_txg = txg + metaslab_unload_delay;
 
+	metaslab_segment_may_passivate(msp);
+
 	mutex_exit(&msp->ms_lock);
 	return (offset);
 }
@@ -2311,8 +3646,9 @@ metaslab_group_alloc(metaslab_group_t *mg, uint64_t asize,
  */
 static int
 metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
-    dva_t *dva, int d, dva_t *hintdva, uint64_t txg, int flags)
+    dva_t *dva, int d, dva_t *hintdva, uint64_t txg, int flags, int allocator)
 {
+	metaslab_class_allocator_t *mca = &mc->mc_allocator[allocator];
 	metaslab_group_t *mg, *rotor;
 	vdev_t *vd;
 	int dshift = 3;
@@ -2331,8 +3667,9 @@ metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 		return (SET_ERROR(ENOSPC));
 
 	/*
-	 * Start at the rotor and loop through all mgs until we find something.
-	 * Note that there's no locking on mc_rotor or mc_aliquot because
+	 * Start at the allocator's rotor and loop through all mgs until we find
+	 * something.
+	 * Note that there's no locking on mca_rotor or mca_aliquot because
 	 * nothing actually breaks if we miss a few updates -- we just won't
 	 * allocate quite as evenly.  It all balances out over time.
 	 *
@@ -2367,13 +3704,13 @@ metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 			    mg->mg_next != NULL)
 				mg = mg->mg_next;
 		} else {
-			mg = mc->mc_rotor;
+			mg = mca->mca_rotor;
 		}
 	} else if (d != 0) {
 		vd = vdev_lookup_top(spa, DVA_GET_VDEV(&dva[d - 1]));
 		mg = vd->vdev_mg->mg_next;
 	} else {
-		mg = mc->mc_rotor;
+		mg = mca->mca_rotor;
 	}
 
 	/*
@@ -2381,7 +3718,7 @@ metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 	 * metaslab group that has been passivated, just follow the rotor.
 	 */
 	if (mg->mg_class != mc || mg->mg_activation_count <= 0)
-		mg = mc->mc_rotor;
+		mg = mca->mca_rotor;
 
 	rotor = mg;
 top:
@@ -2410,7 +3747,7 @@ top:
 		 */
 		if (allocatable && !GANG_ALLOCATION(flags) && !zio_lock) {
 			allocatable = metaslab_group_allocatable(mg, rotor,
-			    psize);
+			    psize, allocator);
 		}
 
 		if (!allocatable)
@@ -2440,7 +3777,7 @@ top:
 		ASSERT(P2PHASE(asize, 1ULL << vd->vdev_ashift) == 0);
 
 		uint64_t offset = metaslab_group_alloc(mg, asize, txg,
-		    distance, dva, d);
+		    distance, dva, d, allocator);
 
 		mutex_enter(&mg->mg_lock);
 		if (offset == -1ULL) {
@@ -2472,7 +3809,7 @@ top:
 			 * over- or under-used relative to the pool,
 			 * and set an allocation bias to even it out.
 			 */
-			if (mc->mc_aliquot == 0 && metaslab_bias_enabled) {
+			if (mca->mca_aliquot == 0 && metaslab_bias_enabled) {
 				vdev_stat_t *vs = &vd->vdev_stat;
 				int64_t vu, cu;
 
@@ -2498,10 +3835,10 @@ top:
 				mg->mg_bias = 0;
 			}
 
-			if (atomic_add_64_nv(&mc->mc_aliquot, asize) >=
+			if (atomic_add_64_nv(&mca->mca_aliquot, asize) >=
 			    mg->mg_aliquot + mg->mg_bias) {
-				mc->mc_rotor = mg->mg_next;
-				mc->mc_aliquot = 0;
+				mca->mca_rotor = mg->mg_next;
+				mca->mca_aliquot = 0;
 			}
 
 			DVA_SET_VDEV(&dva[d], vd->vdev_id);
@@ -2512,8 +3849,8 @@ top:
 			return (0);
 		}
 next:
-		mc->mc_rotor = mg->mg_next;
-		mc->mc_aliquot = 0;
+		mca->mca_rotor = mg->mg_next;
+		mca->mca_aliquot = 0;
 	} while ((mg = mg->mg_next) != rotor);
 
 	if (!all_zero) {
@@ -2617,8 +3954,13 @@ metaslab_claim_dva(spa_t *spa, const dva_t *dva, uint64_t txg)
 
 	mutex_enter(&msp->ms_lock);
 
-	if ((txg != 0 && spa_writeable(spa)) || !msp->ms_loaded)
-		error = metaslab_activate(msp, METASLAB_WEIGHT_SECONDARY);
+	if ((txg != 0 && spa_writeable(spa)) || !msp->ms_loaded) {
+		error = metaslab_activate(msp, -1, METASLAB_WEIGHT_SECONDARY);
+		if (error == EBUSY) {
+			ASSERT(msp->ms_loaded);
+			error = 0;
+		}
+	}
 
 	if (error == 0 && !range_tree_contains(msp->ms_tree, offset, size))
 		error = SET_ERROR(ENOENT);
@@ -2633,6 +3975,8 @@ metaslab_claim_dva(spa_t *spa, const dva_t *dva, uint64_t txg)
 	VERIFY0(P2PHASE(size, 1ULL << vd->vdev_ashift));
 	VERIFY3U(range_tree_space(msp->ms_tree) - size, <=, msp->ms_size);
 	range_tree_remove(msp->ms_tree, offset, size);
+	range_tree_clear(msp->ms_cur_trimset, offset, size);
+	range_tree_clear(msp->ms_prev_trimset, offset, size);
 
 	if (spa_writeable(spa)) {	/* don't dirty if we're zdb(1M) */
 		if (range_tree_space(msp->ms_alloctree[txg & TXG_MASK]) == 0)
@@ -2653,18 +3997,19 @@ metaslab_claim_dva(spa_t *spa, const dva_t *dva, uint64_t txg)
  * the reservation.
  */
 boolean_t
-metaslab_class_throttle_reserve(metaslab_class_t *mc, int slots, zio_t *zio,
-    int flags)
+metaslab_class_throttle_reserve(metaslab_class_t *mc, int slots, int allocator,
+    zio_t *zio, int flags)
 {
+	metaslab_class_allocator_t *mca = &mc->mc_allocator[allocator];
 	uint64_t available_slots = 0;
 	boolean_t slot_reserved = B_FALSE;
 
 	ASSERT(mc->mc_alloc_throttle_enabled);
-	mutex_enter(&mc->mc_lock);
+	mutex_enter(&mca->mca_lock);
 
-	uint64_t reserved_slots = refcount_count(&mc->mc_alloc_slots);
-	if (reserved_slots < mc->mc_alloc_max_slots)
-		available_slots = mc->mc_alloc_max_slots - reserved_slots;
+	uint64_t reserved_slots = refcount_count(&mca->mca_alloc_slots);
+	if (reserved_slots < mca->mca_alloc_max_slots)
+		available_slots = mca->mca_alloc_max_slots - reserved_slots;
 
 	if (slots <= available_slots || GANG_ALLOCATION(flags)) {
 		/*
@@ -2672,30 +4017,35 @@ metaslab_class_throttle_reserve(metaslab_class_t *mc, int slots, zio_t *zio,
 		 * them individually when an I/O completes.
 		 */
 		for (int d = 0; d < slots; d++) {
-			reserved_slots = refcount_add(&mc->mc_alloc_slots, zio);
+			reserved_slots = refcount_add(&mca->mca_alloc_slots,
+			    zio);
 		}
 		zio->io_flags |= ZIO_FLAG_IO_ALLOCATING;
 		slot_reserved = B_TRUE;
 	}
 
-	mutex_exit(&mc->mc_lock);
+	mutex_exit(&mca->mca_lock);
 	return (slot_reserved);
 }
 
 void
-metaslab_class_throttle_unreserve(metaslab_class_t *mc, int slots, zio_t *zio)
+metaslab_class_throttle_unreserve(metaslab_class_t *mc, int slots,
+    int allocator, zio_t *zio)
 {
+	metaslab_class_allocator_t *mca = &mc->mc_allocator[allocator];
+
 	ASSERT(mc->mc_alloc_throttle_enabled);
-	mutex_enter(&mc->mc_lock);
+	mutex_enter(&mca->mca_lock);
 	for (int d = 0; d < slots; d++) {
-		(void) refcount_remove(&mc->mc_alloc_slots, zio);
+		(void) refcount_remove(&mca->mca_alloc_slots, zio);
 	}
-	mutex_exit(&mc->mc_lock);
+	mutex_exit(&mca->mca_lock);
 }
 
 int
 metaslab_alloc(spa_t *spa, metaslab_class_t *mc, uint64_t psize, blkptr_t *bp,
-    int ndvas, uint64_t txg, blkptr_t *hintbp, int flags, zio_t *zio)
+    int ndvas, uint64_t txg, blkptr_t *hintbp, int flags, zio_t *zio,
+    int allocator)
 {
 	dva_t *dva = bp->blk_dva;
 	dva_t *hintdva = hintbp->blk_dva;
@@ -2717,12 +4067,13 @@ metaslab_alloc(spa_t *spa, metaslab_class_t *mc, uint64_t psize, blkptr_t *bp,
 
 	for (int d = 0; d < ndvas; d++) {
 		error = metaslab_alloc_dva(spa, mc, psize, dva, d, hintdva,
-		    txg, flags);
+		    txg, flags, allocator);
 		if (error != 0) {
 			for (d--; d >= 0; d--) {
 				metaslab_free_dva(spa, &dva[d], txg, B_TRUE);
 				metaslab_group_alloc_decrement(spa,
-				    DVA_GET_VDEV(&dva[d]), zio, flags);
+				    DVA_GET_VDEV(&dva[d]), zio, flags,
+				    allocator);
 				bzero(&dva[d], sizeof (dva_t));
 			}
 			spa_config_exit(spa, SCL_ALLOC, FTAG);
@@ -2733,7 +4084,7 @@ metaslab_alloc(spa_t *spa, metaslab_class_t *mc, uint64_t psize, blkptr_t *bp,
 			 * based on the newly allocated dva.
 			 */
 			metaslab_group_alloc_increment(spa,
-			    DVA_GET_VDEV(&dva[d]), zio, flags);
+			    DVA_GET_VDEV(&dva[d]), zio, flags, allocator);
 		}
 
 	}
@@ -2811,6 +4162,8 @@ metaslab_check_free(spa_t *spa, const blkptr_t *bp)
 
 		if (msp->ms_loaded)
 			range_tree_verify(msp->ms_tree, offset, size);
+		range_tree_verify(msp->ms_trimming, offset, size);
+		range_tree_verify(msp->ms_unflushed_frees, offset, size);
 
 		for (int j = 0; j < TXG_SIZE; j++)
 			range_tree_verify(msp->ms_freetree[j], offset, size);
@@ -33,32 +33,16 @@
 #include <sys/zio.h>
 #include <sys/range_tree.h>
 
-kmem_cache_t *range_seg_cache;
-
-void
-range_tree_init(void)
-{
-	ASSERT(range_seg_cache == NULL);
-	range_seg_cache = kmem_cache_create("range_seg_cache",
-	    sizeof (range_seg_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
-}
-
-void
-range_tree_fini(void)
-{
-	kmem_cache_destroy(range_seg_cache);
-	range_seg_cache = NULL;
-}
-
 void
 range_tree_stat_verify(range_tree_t *rt)
 {
 	range_seg_t *rs;
+	zfs_btree_index_t where;
 	uint64_t hist[RANGE_TREE_HISTOGRAM_SIZE] = { 0 };
 	int i;
 
-	for (rs = avl_first(&rt->rt_root); rs != NULL;
-	    rs = AVL_NEXT(&rt->rt_root, rs)) {
+	for (rs = zfs_btree_first(&rt->rt_root, &where); rs != NULL;
+	    rs = zfs_btree_next(&rt->rt_root, &where, &where)) {
 		uint64_t size = rs->rs_end - rs->rs_start;
 		int idx	= highbit64(size) - 1;
 
@@ -134,8 +118,8 @@ range_tree_create(range_tree_ops_t *ops, void *arg, kmutex_t *lp)
 
 	rt = kmem_zalloc(sizeof (range_tree_t), KM_SLEEP);
 
-	avl_create(&rt->rt_root, range_tree_seg_compare,
-	    sizeof (range_seg_t), offsetof(range_seg_t, rs_node));
+	zfs_btree_create(&rt->rt_root, range_tree_seg_compare,
+	    sizeof (range_seg_t));
 
 	rt->rt_lock = lp;
 	rt->rt_ops = ops;
@@ -155,7 +139,7 @@ range_tree_destroy(range_tree_t *rt)
 	if (rt->rt_ops != NULL)
 		rt->rt_ops->rtop_destroy(rt, rt->rt_arg);
 
-	avl_destroy(&rt->rt_root);
+	zfs_btree_destroy(&rt->rt_root);
 	kmem_free(rt, sizeof (*rt));
 }
 
@@ -163,7 +147,7 @@ void
 range_tree_add(void *arg, uint64_t start, uint64_t size)
 {
 	range_tree_t *rt = arg;
-	avl_index_t where;
+	zfs_btree_index_t where, where_before, where_after;
 	range_seg_t rsearch, *rs_before, *rs_after, *rs;
 	uint64_t end = start + size;
 	boolean_t merge_before, merge_after;
@@ -173,7 +157,7 @@ range_tree_add(void *arg, uint64_t start, uint64_t size)
 
 	rsearch.rs_start = start;
 	rsearch.rs_end = end;
-	rs = avl_find(&rt->rt_root, &rsearch, &where);
+	rs = zfs_btree_find(&rt->rt_root, &rsearch, &where);
 
 	if (rs != NULL && rs->rs_start <= start && rs->rs_end >= end) {
 		zfs_panic_recover("zfs: allocating allocated segment"
@@ -185,14 +169,15 @@ range_tree_add(void *arg, uint64_t start, uint64_t size)
 	/* Make sure we don't overlap with either of our neighbors */
 	VERIFY(rs == NULL);
 
-	rs_before = avl_nearest(&rt->rt_root, where, AVL_BEFORE);
-	rs_after = avl_nearest(&rt->rt_root, where, AVL_AFTER);
+	rs_before = zfs_btree_prev(&rt->rt_root, &where, &where_before);
+	rs_after = zfs_btree_next(&rt->rt_root, &where, &where_after);
 
 	merge_before = (rs_before != NULL && rs_before->rs_end == start);
 	merge_after = (rs_after != NULL && rs_after->rs_start == end);
 
 	if (merge_before && merge_after) {
-		avl_remove(&rt->rt_root, rs_before);
+		uint64_t before_start = rs_before->rs_start;
+
 		if (rt->rt_ops != NULL) {
 			rt->rt_ops->rtop_remove(rt, rs_before, rt->rt_arg);
 			rt->rt_ops->rtop_remove(rt, rs_after, rt->rt_arg);
@@ -201,8 +186,16 @@ range_tree_add(void *arg, uint64_t start, uint64_t size)
 		range_tree_stat_decr(rt, rs_before);
 		range_tree_stat_decr(rt, rs_after);
 
-		rs_after->rs_start = rs_before->rs_start;
-		kmem_cache_free(range_seg_cache, rs_before);
+		/*
+		 * Removing rs_before may move rs_after within the tree, so
+		 * look it up again before extending it.
+		 */
+		zfs_btree_remove_idx(&rt->rt_root, &where_before);
+		rsearch.rs_start = end;
+		rsearch.rs_end = end + 1;
+		rs_after = zfs_btree_find(&rt->rt_root, &rsearch, NULL);
+		ASSERT3P(rs_after, !=, NULL);
+		rs_after->rs_start = before_start;
 		rs = rs_after;
 	} else if (merge_before) {
 		if (rt->rt_ops != NULL)
@@ -221,10 +214,8 @@ range_tree_add(void *arg, uint64_t start, uint64_t size)
 		rs_after->rs_start = start;
 		rs = rs_after;
 	} else {
-		rs = kmem_cache_alloc(range_seg_cache, KM_SLEEP);
-		rs->rs_start = start;
-		rs->rs_end = end;
-		avl_insert(&rt->rt_root, rs, where);
+		zfs_btree_add_idx(&rt->rt_root, &rsearch, &where);
+		rs = &rsearch;
 	}
 
 	if (rt->rt_ops != NULL)
@@ -238,8 +229,8 @@ void
 range_tree_remove(void *arg, uint64_t start, uint64_t size)
 {
 	range_tree_t *rt = arg;
-	avl_index_t where;
-	range_seg_t rsearch, *rs, *newseg;
+	zfs_btree_index_t where;
+	range_seg_t rsearch, *rs, newseg;
 	uint64_t end = start + size;
 	boolean_t left_over, right_over;
 
@@ -249,7 +240,7 @@ range_tree_remove(void *arg, uint64_t start, uint64_t size)
 
 	rsearch.rs_start = start;
 	rsearch.rs_end = end;
-	rs = avl_find(&rt->rt_root, &rsearch, &where);
+	rs = zfs_btree_find(&rt->rt_root, &rsearch, &where);
 
 	/* Make sure we completely overlap with someone */
 	if (rs == NULL) {
@@ -270,23 +261,24 @@ range_tree_remove(void *arg, uint64_t start, uint64_t size)
 		rt->rt_ops->rtop_remove(rt, rs, rt->rt_arg);
 
 	if (left_over && right_over) {
-		newseg = kmem_cache_alloc(range_seg_cache, KM_SLEEP);
-		newseg->rs_start = end;
-		newseg->rs_end = rs->rs_end;
-		range_tree_stat_incr(rt, newseg);
+		newseg.rs_start = end;
+		newseg.rs_end = rs->rs_end;
+		range_tree_stat_incr(rt, &newseg);
 
 		rs->rs_end = start;
 
-		avl_insert_here(&rt->rt_root, newseg, rs, AVL_AFTER);
+		/* inserting newseg may move rs, so keep a copy of it */
+		rsearch = *rs;
+		zfs_btree_add(&rt->rt_root, &newseg);
+		rs = &rsearch;
 		if (rt->rt_ops != NULL)
-			rt->rt_ops->rtop_add(rt, newseg, rt->rt_arg);
+			rt->rt_ops->rtop_add(rt, &newseg, rt->rt_arg);
 	} else if (left_over) {
 		rs->rs_end = start;
 	} else if (right_over) {
 		rs->rs_start = end;
 	} else {
-		avl_remove(&rt->rt_root, rs);
-		kmem_cache_free(range_seg_cache, rs);
+		zfs_btree_remove_idx(&rt->rt_root, &where);
 		rs = NULL;
 	}
 
@@ -303,7 +295,6 @@ range_tree_remove(void *arg, uint64_t start, uint64_t size)
 static range_seg_t *
 range_tree_find_impl(range_tree_t *rt, uint64_t start, uint64_t size)
 {
-	avl_index_t where;
 	range_seg_t rsearch;
 	uint64_t end = start + size;
 
@@ -312,7 +303,7 @@ range_tree_find_impl(range_tree_t *rt, uint64_t start, uint64_t size)
 
 	rsearch.rs_start = start;
 	rsearch.rs_end = end;
-	return (avl_find(&rt->rt_root, &rsearch, &where));
+	return (zfs_btree_find(&rt->rt_root, &rsearch, NULL));
 }
 
 static range_seg_t *
@@ -358,6 +349,63 @@ range_tree_clear(range_tree_t *rt, uint64_t start, uint64_t size)
 	}
 }
 
+/*
+ * Remove the parts of [start, end) that are in removefrom, and add the
+ * rest to addto.  With a pair of trees holding changes relative to
+ * some base state, this applies one more change: e.g. freeing a segment
+ * cancels whatever part of it was allocated since, and records the rest
+ * as a free.  The two trees must share a lock.
+ */
+void
+range_tree_remove_xor_add_segment(uint64_t start, uint64_t end,
+    range_tree_t *removefrom, range_tree_t *addto)
+{
+	zfs_btree_index_t where;
+	range_seg_t rsearch, *rs, *next;
+
+	ASSERT3U(start, <, end);
+	ASSERT3P(removefrom->rt_lock, ==, addto->rt_lock);
+	ASSERT(MUTEX_HELD(removefrom->rt_lock));
+
+	while (start < end) {
+		uint64_t seg_end;
+
+		rsearch.rs_start = start;
+		rsearch.rs_end = start + 1;
+		rs = zfs_btree_find(&removefrom->rt_root, &rsearch, &where);
+		if (rs != NULL) {
+			seg_end = MIN(rs->rs_end, end);
+			range_tree_remove(removefrom, start, seg_end - start);
+		} else {
+			next = zfs_btree_next(&removefrom->rt_root, &where,
+			    &where);
+			seg_end = (next == NULL) ? end :
+			    MIN(next->rs_start, end);
+			range_tree_add(addto, start, seg_end - start);
+		}
+		start = seg_end;
+	}
+}
+
+/*
+ * Apply range_tree_remove_xor_add_segment() to each segment of rt.
+ */
+void
+range_tree_remove_xor_add(range_tree_t *rt, range_tree_t *removefrom,
+    range_tree_t *addto)
+{
+	range_seg_t *rs;
+	zfs_btree_index_t where;
+
+	ASSERT(MUTEX_HELD(rt->rt_lock));
+
+	for (rs = zfs_btree_first(&rt->rt_root, &where); rs != NULL;
+	    rs = zfs_btree_next(&rt->rt_root, &where, &where)) {
+		range_tree_remove_xor_add_segment(rs->rs_start, rs->rs_end,
+		    removefrom, addto);
+	}
+}
+
 void
 range_tree_swap(range_tree_t **rtsrc, range_tree_t **rtdst)
 {
@@ -365,7 +413,7 @@ range_tree_swap(range_tree_t **rtsrc, range_tree_t **rtdst)
 
 	ASSERT(MUTEX_HELD((*rtsrc)->rt_lock));
 	ASSERT0(range_tree_space(*rtdst));
-	ASSERT0(avl_numnodes(&(*rtdst)->rt_root));
+	ASSERT0(zfs_btree_numnodes(&(*rtdst)->rt_root));
 
 	rt = *rtsrc;
 	*rtsrc = *rtdst;
@@ -375,19 +423,18 @@ range_tree_swap(range_tree_t **rtsrc, range_tree_t **rtdst)
 void
 range_tree_vacate(range_tree_t *rt, range_tree_func_t *func, void *arg)
 {
-	range_seg_t *rs;
-	void *cookie = NULL;
-
 	ASSERT(MUTEX_HELD(rt->rt_lock));
 
 	if (rt->rt_ops != NULL)
 		rt->rt_ops->rtop_vacate(rt, rt->rt_arg);
 
-	while ((rs = avl_destroy_nodes(&rt->rt_root, &cookie)) != NULL) {
-		if (func != NULL)
-			func(arg, rs->rs_start, rs->rs_end - rs->rs_start);
-		kmem_cache_free(range_seg_cache, rs);
-	}
+	/*
+	 * The segments live in the tree's own nodes, so once the walk is
+	 * done they can all be freed a node at a time.
+	 */
+	if (func != NULL)
+		range_tree_walk(rt, func, arg);
+	zfs_btree_clear(&rt->rt_root);
 
 	bzero(rt->rt_histogram, sizeof (rt->rt_histogram));
 	rt->rt_space = 0;
@@ -397,10 +444,12 @@ void
 range_tree_walk(range_tree_t *rt, range_tree_func_t *func, void *arg)
 {
 	range_seg_t *rs;
+	zfs_btree_index_t where;
 
 	ASSERT(MUTEX_HELD(rt->rt_lock));
 
-	for (rs = avl_first(&rt->rt_root); rs; rs = AVL_NEXT(&rt->rt_root, rs))
+	for (rs = zfs_btree_first(&rt->rt_root, &where); rs != NULL;
+	    rs = zfs_btree_next(&rt->rt_root, &where, &where))
 		func(arg, rs->rs_start, rs->rs_end - rs->rs_start);
 }
 
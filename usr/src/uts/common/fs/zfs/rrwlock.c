@@ -69,6 +69,21 @@
  * rrw_node_t entry for the lock) or not. If they are a re-entrant lock, then
  * we must let the proceed.  If they are not, then the reader blocks for the
  * waiting writers.  Hence, we do not starve writers.
+ *
+ * For read-mostly locks that are taken by many CPUs at once, such as the
+ * pool config lock, even the anonymous fast path bounces rr_lock between
+ * CPUs.  A lock initialized with rrw_init_percpu() instead counts readers
+ * in per-CPU counters (rr_pcpu), each in its own cache line, and tracks
+ * every reader in tsd as if track_all were set.  A reader bumps the counter
+ * of the CPU it's running on and, if no writer holds or wants the lock,
+ * is done without touching rr_lock.  The counter may be dropped on another
+ * CPU; only the sum over all CPUs is meaningful.  A writer sets
+ * rr_writer_wanted and then waits, under rr_lock, for the sum to drop to
+ * zero; a reader that finds a writer after bumping its counter backs out
+ * and takes the regular path, where re-entrant and "prio" readers are
+ * still let through as described above.  Both sides issue a memory barrier
+ * between their store and their load, so either the reader sees
+ * rr_writer_wanted or the writer sees the reader's count.
  */
 
 /* global key for TSD */
@@ -85,7 +100,8 @@ rrn_find(rrwlock_t *rrl)
 {
 	rrw_node_t *rn;
 
-	if (refcount_count(&rrl->rr_linked_rcount) == 0)
+	if (rrl->rr_pcpu == NULL &&
+	    refcount_count(&rrl->rr_linked_rcount) == 0)
 		return (NULL);
 
 	for (rn = tsd_get(rrw_tsd_key); rn != NULL; rn = rn->rn_next) {
@@ -120,7 +136,8 @@ rrn_find_and_remove(rrwlock_t *rrl, void *tag)
 	rrw_node_t *rn;
 	rrw_node_t *prev = NULL;
 
-	if (refcount_count(&rrl->rr_linked_rcount) == 0)
+	if (rrl->rr_pcpu == NULL &&
+	    refcount_count(&rrl->rr_linked_rcount) == 0)
 		return (B_FALSE);
 
 	for (rn = tsd_get(rrw_tsd_key); rn != NULL; rn = rn->rn_next) {
@@ -147,6 +164,45 @@ rrw_init(rrwlock_t *rrl, boolean_t track_all)
 	refcount_create(&rrl->rr_linked_rcount);
 	rrl->rr_writer_wanted = B_FALSE;
 	rrl->rr_track_all = track_all;
+	rrl->rr_pcpu = NULL;
+}
+
+/*
+ * Initialize a lock whose readers are counted per CPU; see the comment at the
+ * top of the file.  Readers are always tracked, as with track_all.
+ */
+void
+rrw_init_percpu(rrwlock_t *rrl)
+{
+	rrw_init(rrl, B_TRUE);
+	rrl->rr_pcpu = kmem_zalloc(max_ncpus * sizeof (rrw_pcpu_t), KM_SLEEP);
+}
+
+static uint64_t
+rrw_pcpu_sum(rrwlock_t *rrl)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < max_ncpus; i++)
+		sum += rrl->rr_pcpu[i].rp_count;
+	return (sum);
+}
+
+/*
+ * Drop a per-CPU read count, waking a writer waiting for readers to drain.
+ */
+static void
+rrw_pcpu_rele(rrwlock_t *rrl)
+{
+	membar_exit();
+	atomic_dec_64(&rrl->rr_pcpu[CPU_SEQID].rp_count);
+	membar_enter();
+	if (rrl->rr_writer_wanted) {
+		mutex_enter(&rrl->rr_lock);
+		cv_broadcast(&rrl->rr_cv);
+		mutex_exit(&rrl->rr_lock);
+	}
 }
 
 void
@@ -157,11 +213,46 @@ rrw_destroy(rrwlock_t *rrl)
 	ASSERT(rrl->rr_writer == NULL);
 	refcount_destroy(&rrl->rr_anon_rcount);
 	refcount_destroy(&rrl->rr_linked_rcount);
+	if (rrl->rr_pcpu != NULL) {
+		ASSERT0(rrw_pcpu_sum(rrl));
+		kmem_free(rrl->rr_pcpu, max_ncpus * sizeof (rrw_pcpu_t));
+		rrl->rr_pcpu = NULL;
+	}
+}
+
+static void
+rrw_enter_read_pcpu(rrwlock_t *rrl, boolean_t prio, void *tag)
+{
+	atomic_inc_64(&rrl->rr_pcpu[CPU_SEQID].rp_count);
+	membar_enter();
+	if (rrl->rr_writer == NULL && !rrl->rr_writer_wanted) {
+		rrn_add(rrl, tag);
+		return;
+	}
+
+	/* A writer got in first; back out and wait for it like anyone else */
+	DTRACE_PROBE(zfs__rrwfastpath__rdmiss);
+	rrw_pcpu_rele(rrl);
+
+	mutex_enter(&rrl->rr_lock);
+	ASSERT(rrl->rr_writer != curthread);
+	while (rrl->rr_writer != NULL || (rrl->rr_writer_wanted && !prio &&
+	    rrn_find(rrl) == NULL))
+		cv_wait(&rrl->rr_cv, &rrl->rr_lock);
+	atomic_inc_64(&rrl->rr_pcpu[CPU_SEQID].rp_count);
+	mutex_exit(&rrl->rr_lock);
+
+	rrn_add(rrl, tag);
 }
 
 static void
 rrw_enter_read_impl(rrwlock_t *rrl, boolean_t prio, void *tag)
 {
+	if (rrl->rr_pcpu != NULL) {
+		rrw_enter_read_pcpu(rrl, prio, tag);
+		return;
+	}
+
 	mutex_enter(&rrl->rr_lock);
 #if !defined(DEBUG) && defined(_KERNEL)
 	if (rrl->rr_writer == NULL && !rrl->rr_writer_wanted &&
@@ -216,6 +307,22 @@ rrw_enter_write(rrwlock_t *rrl)
 	mutex_enter(&rrl->rr_lock);
 	ASSERT(rrl->rr_writer != curthread);
 
+	if (rrl->rr_pcpu != NULL) {
+		for (;;) {
+			if (rrl->rr_writer == NULL) {
+				rrl->rr_writer_wanted = B_TRUE;
+				membar_enter();
+				if (rrw_pcpu_sum(rrl) == 0)
+					break;
+			}
+			cv_wait(&rrl->rr_cv, &rrl->rr_lock);
+		}
+		rrl->rr_writer_wanted = B_FALSE;
+		rrl->rr_writer = curthread;
+		mutex_exit(&rrl->rr_lock);
+		return;
+	}
+
 	while (refcount_count(&rrl->rr_anon_rcount) > 0 ||
 	    refcount_count(&rrl->rr_linked_rcount) > 0 ||
 	    rrl->rr_writer != NULL) {
@@ -239,6 +346,12 @@ rrw_enter(rrwlock_t *rrl, krw_t rw, void *tag)
 void
 rrw_exit(rrwlock_t *rrl, void *tag)
 {
+	if (rrl->rr_pcpu != NULL && rrl->rr_writer != curthread) {
+		VERIFY(rrn_find_and_remove(rrl, tag));
+		rrw_pcpu_rele(rrl);
+		return;
+	}
+
 	mutex_enter(&rrl->rr_lock);
 #if !defined(DEBUG) && defined(_KERNEL)
 	if (!rrl->rr_writer && rrl->rr_linked_rcount.rc_count == 0) {
@@ -284,6 +397,13 @@ rrw_held(rrwlock_t *rrl, krw_t rw)
 {
 	boolean_t held;
 
+	/* Everything we need to look at is private to this thread */
+	if (rrl->rr_pcpu != NULL) {
+		if (rw == RW_WRITER)
+			return (rrl->rr_writer == curthread);
+		return (rrn_find(rrl) != NULL);
+	}
+
 	mutex_enter(&rrl->rr_lock);
 	if (rw == RW_WRITER) {
 		held = (rrl->rr_writer == curthread);
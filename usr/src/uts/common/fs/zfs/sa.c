@@ -567,7 +567,7 @@ sa_find_sizes(sa_os_t *sa, sa_bulk_attr_t *attr_desc, int attr_count,
 	hdrsize = (SA_BONUSTYPE_FROM_DB(db) == DMU_OT_ZNODE) ? 0 :
 	    sizeof (sa_hdr_phys_t);
 
-	full_space = (buftype == SA_BONUS) ? DN_MAX_BONUSLEN : db->db_size;
+	full_space = (buftype == SA_BONUS) ? sa_bonus_max(db) : db->db_size;
 	ASSERT(IS_P2ALIGNED(full_space, 8));
 
 	for (i = 0; i != attr_count; i++) {
@@ -660,9 +660,11 @@ sa_build_layouts(sa_handle_t *hdl, sa_bulk_attr_t *attr_desc, int attr_count,
 	sa_lot_t *lot;
 	int len_idx;
 	int spill_used;
+	int bonuslen;
 	boolean_t spilling;
 
 	dmu_buf_will_dirty(hdl->sa_bonus, tx);
+	bonuslen = sa_bonus_max(hdl->sa_bonus);
 	bonustype = SA_BONUSTYPE_FROM_DB(hdl->sa_bonus);
 
 	/* first determine bonus header size and sum of all attributes */
@@ -673,7 +675,7 @@ sa_build_layouts(sa_handle_t *hdl, sa_bulk_attr_t *attr_desc, int attr_count,
 		return (SET_ERROR(EFBIG));
 
 	VERIFY(0 == dmu_set_bonus(hdl->sa_bonus, spilling ?
-	    MIN(DN_MAX_BONUSLEN - sizeof (blkptr_t), used + hdrsize) :
+	    MIN(SA_BLKPTR_SPACE(bonuslen), used + hdrsize) :
 	    used + hdrsize, tx));
 
 	ASSERT((bonustype == DMU_OT_ZNODE && spilling == 0) ||
@@ -710,7 +712,7 @@ sa_build_layouts(sa_handle_t *hdl, sa_bulk_attr_t *attr_desc, int attr_count,
 
 	if (spilling)
 		buf_space = (sa->sa_force_spill) ?
-		    0 : SA_BLKPTR_SPACE - hdrsize;
+		    0 : SA_BLKPTR_SPACE(bonuslen) - hdrsize;
 	else
 		buf_space = hdl->sa_bonus->db_size - hdrsize;
 
@@ -1325,6 +1327,39 @@ sa_idx_tab_rele(objset_t *os, void *arg)
 	mutex_exit(&sa->sa_lock);
 }
 
+/*
+ * Work out whether the snapshot attributes sit back to back, in
+ * registration order, in buffers described by this index table.  They
+ * will whenever the layout was built from a template listing them in
+ * that order, as every layout the ZPL creates is, and then
+ * sa_lookup_snapshot() can copy the lot out in one go.
+ */
+static void
+sa_snap_compile(sa_os_t *sa, sa_idx_tab_t *idx_tab)
+{
+	uint32_t off = 0;
+	uint32_t next = 0;
+	int i;
+
+	ASSERT(MUTEX_HELD(&sa->sa_lock));
+
+	idx_tab->sa_snap_valid = B_FALSE;
+	for (i = 0; i != sa->sa_snap_count; i++) {
+		sa_attr_type_t attr = sa->sa_snap_attrs[i];
+		uint32_t toc = idx_tab->sa_idx_tab[attr];
+
+		if (!TOC_ATTR_PRESENT(toc))
+			return;
+		if (i == 0)
+			off = TOC_OFF(toc);
+		else if (TOC_OFF(toc) != next)
+			return;
+		next = TOC_OFF(toc) + sa->sa_attr_table[attr].sa_length;
+	}
+	idx_tab->sa_snap_off = off;
+	idx_tab->sa_snap_valid = (sa->sa_snap_count != 0);
+}
+
 static void
 sa_idx_tab_hold(objset_t *os, sa_idx_tab_t *idx_tab)
 {
@@ -1546,6 +1581,7 @@ sa_find_idx_tab(objset_t *os, dmu_object_type_t bonustype, void *data)
 
 	sa_attr_iter(os, hdr, bonustype, sa_build_idx_tab,
 	    tb, idx_tab);
+	sa_snap_compile(sa, idx_tab);
 	sa_idx_tab_hold(os, idx_tab);   /* one hold for consumer */
 	sa_idx_tab_hold(os, idx_tab);	/* one for layout */
 	list_insert_tail(&tb->lot_idx_tab, idx_tab);
@@ -1891,6 +1927,49 @@ sa_bulk_lookup(sa_handle_t *hdl, sa_bulk_attr_t *attrs, int count)
 	return (error);
 }
 
+/*
+ * Copy the attributes registered with sa_register_snapshot() into buf,
+ * back to back in the order they were registered.  When the bonus
+ * buffer holds them as a single run this is one bcopy; otherwise it
+ * falls back to an ordinary bulk lookup.
+ */
+int
+sa_lookup_snapshot(sa_handle_t *hdl, void *buf, uint32_t buflen)
+{
+	sa_os_t *sa = hdl->sa_os->os_sa;
+	sa_bulk_attr_t bulk[SA_SNAP_MAX];
+	sa_idx_tab_t *idx_tab;
+	uintptr_t addr = (uintptr_t)buf;
+	int count = 0;
+	int error, i;
+
+	ASSERT(hdl);
+	ASSERT(sa->sa_snap_count != 0);
+
+	if (buflen < sa->sa_snap_len)
+		return (SET_ERROR(EOVERFLOW));
+
+	mutex_enter(&hdl->sa_lock);
+	idx_tab = hdl->sa_bonus_tab;
+	if (idx_tab != NULL && idx_tab->sa_snap_valid) {
+		bcopy((void *)((uintptr_t)SA_GET_HDR(hdl, SA_BONUS) +
+		    idx_tab->sa_snap_off), buf, sa->sa_snap_len);
+		mutex_exit(&hdl->sa_lock);
+		return (0);
+	}
+
+	for (i = 0; i != sa->sa_snap_count; i++) {
+		sa_attr_type_t attr = sa->sa_snap_attrs[i];
+		uint32_t len = sa->sa_attr_table[attr].sa_length;
+
+		SA_ADD_BULK_ATTR(bulk, count, attr, NULL, (void *)addr, len);
+		addr += len;
+	}
+	error = sa_lookup_impl(hdl, bulk, count);
+	mutex_exit(&hdl->sa_lock);
+	return (error);
+}
+
 int
 sa_bulk_update(sa_handle_t *hdl, sa_bulk_attr_t *attrs, int count, dmu_tx_t *tx)
 {
@@ -1962,6 +2041,42 @@ sa_register_update_callback(objset_t *os, sa_update_cb_t *func)
 	mutex_exit(&os->os_sa->sa_lock);
 }
 
+/*
+ * Register a set of fixed length attributes that a consumer reads
+ * together on a hot path (the ZPL's stat(2) timestamps, say), so that
+ * sa_lookup_snapshot() can fetch them with one copy out of the bonus
+ * buffer.  Each index table records whether the set is laid out as a
+ * single run when it is built, and existing ones are recompiled here.
+ */
+void
+sa_register_snapshot(objset_t *os, const sa_attr_type_t *attrs, int count)
+{
+	sa_os_t *sa = os->os_sa;
+	sa_idx_tab_t *idx_tab;
+	sa_lot_t *tb;
+	int i;
+
+	ASSERT(count > 0 && count <= SA_SNAP_MAX);
+
+	mutex_enter(&sa->sa_lock);
+	sa->sa_snap_len = 0;
+	for (i = 0; i != count; i++) {
+		ASSERT(attrs[i] < sa->sa_num_attrs);
+		ASSERT(sa->sa_attr_table[attrs[i]].sa_length != 0);
+		sa->sa_snap_attrs[i] = attrs[i];
+		sa->sa_snap_len += sa->sa_attr_table[attrs[i]].sa_length;
+	}
+	sa->sa_snap_count = count;
+
+	for (tb = avl_first(&sa->sa_layout_num_tree); tb != NULL;
+	    tb = AVL_NEXT(&sa->sa_layout_num_tree, tb)) {
+		for (idx_tab = list_head(&tb->lot_idx_tab); idx_tab != NULL;
+		    idx_tab = list_next(&tb->lot_idx_tab, idx_tab))
+			sa_snap_compile(sa, idx_tab);
+	}
+	mutex_exit(&sa->sa_lock);
+}
+
 uint64_t
 sa_handle_object(sa_handle_t *hdl)
 {
@@ -153,6 +153,7 @@ uint_t		zio_taskq_batch_pct = 75;	/* 1 thread per cpu in pset */
 id_t		zio_taskq_psrset_bind = PS_NONE;
 boolean_t	zio_taskq_sysdc = B_TRUE;	/* use SDC scheduling class */
 uint_t		zio_taskq_basedc = 80;		/* base duty cycle */
+boolean_t	zio_taskq_percpu = B_TRUE;	/* per-CPU run queues */
 
 boolean_t	spa_create_process = B_TRUE;	/* no process ==> no sysdc */
 extern int	zfs_sync_pass_deferred_free;
@@ -207,8 +208,12 @@ spa_prop_get_config(spa_t *spa, nvlist_t **nvp)
 	ASSERT(MUTEX_HELD(&spa->spa_props_lock));
 
 	if (rvd != NULL) {
-		alloc = metaslab_class_get_alloc(spa_normal_class(spa));
-		size = metaslab_class_get_space(spa_normal_class(spa));
+		alloc = metaslab_class_get_alloc(spa_normal_class(spa)) +
+		    metaslab_class_get_alloc(spa_dedup_class(spa)) +
+		    metaslab_class_get_alloc(spa_special_class(spa));
+		size = metaslab_class_get_space(spa_normal_class(spa)) +
+		    metaslab_class_get_space(spa_dedup_class(spa)) +
+		    metaslab_class_get_space(spa_special_class(spa));
 		spa_prop_add_list(*nvp, ZPOOL_PROP_NAME, spa_name(spa), 0, src);
 		spa_prop_add_list(*nvp, ZPOOL_PROP_SIZE, NULL, size, src);
 		spa_prop_add_list(*nvp, ZPOOL_PROP_ALLOCATED, NULL, alloc, src);
@@ -261,6 +266,9 @@ spa_prop_get_config(spa_t *spa, nvlist_t **nvp)
 			spa_prop_add_list(*nvp, ZPOOL_PROP_LEAKED,
 			    NULL, 0, src);
 		}
+
+		spa_prop_add_list(*nvp, ZPOOL_PROP_DESTROYING, NULL,
+		    dsl_destroy_queue_count(pool), src);
 	}
 
 	spa_prop_add_list(*nvp, ZPOOL_PROP_GUID, NULL, spa_guid(spa), src);
@@ -464,6 +472,7 @@ spa_prop_validate(spa_t *spa, nvlist_t *props)
 		case ZPOOL_PROP_AUTOREPLACE:
 		case ZPOOL_PROP_LISTSNAPS:
 		case ZPOOL_PROP_AUTOEXPAND:
+		case ZPOOL_PROP_AUTOTRIM:
 			error = nvpair_value_uint64(elem, &intval);
 			if (!error && intval > 1)
 				error = SET_ERROR(EINVAL);
@@ -873,6 +882,12 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		batch = B_TRUE;
 		flags |= TASKQ_THREADS_CPU_PCT;
 		value = zio_taskq_batch_pct;
+		/*
+		 * The batch taskqs are dispatched to from every CPU at I/O
+		 * completion rates, so spread them over per-CPU run queues.
+		 */
+		if (zio_taskq_percpu)
+			flags |= TASKQ_PERCPU;
 		break;
 
 	default:
@@ -1054,6 +1069,8 @@ spa_activate(spa_t *spa, int mode)
 
 	spa->spa_normal_class = metaslab_class_create(spa, zfs_metaslab_ops);
 	spa->spa_log_class = metaslab_class_create(spa, zfs_metaslab_ops);
+	spa->spa_dedup_class = metaslab_class_create(spa, zfs_metaslab_ops);
+	spa->spa_special_class = metaslab_class_create(spa, zfs_metaslab_ops);
 
 	/* Try to create a covering process */
 	mutex_enter(&spa->spa_proc_lock);
@@ -1138,6 +1155,12 @@ spa_deactivate(spa_t *spa)
 	metaslab_class_destroy(spa->spa_log_class);
 	spa->spa_log_class = NULL;
 
+	metaslab_class_destroy(spa->spa_dedup_class);
+	spa->spa_dedup_class = NULL;
+
+	metaslab_class_destroy(spa->spa_special_class);
+	spa->spa_special_class = NULL;
+
 	/*
 	 * If this was part of an import or the open otherwise failed, we may
 	 * still have errors left in the queues.  Empty them just in case.
@@ -1232,6 +1255,11 @@ spa_unload(spa_t *spa)
 
 	ASSERT(MUTEX_HELD(&spa_namespace_lock));
 
+	/*
+	 * Stop any manual trim.
+	 */
+	spa_trim_stop(spa);
+
 	/*
 	 * Stop async tasks.
 	 */
@@ -2726,6 +2754,7 @@ spa_load_impl(spa_t *spa, uint64_t pool_guid, nvlist_t *config,
 		spa_prop_find(spa, ZPOOL_PROP_DELEGATION, &spa->spa_delegation);
 		spa_prop_find(spa, ZPOOL_PROP_FAILUREMODE, &spa->spa_failmode);
 		spa_prop_find(spa, ZPOOL_PROP_AUTOEXPAND, &spa->spa_autoexpand);
+		spa_prop_find(spa, ZPOOL_PROP_AUTOTRIM, &spa->spa_autotrim);
 		spa_prop_find(spa, ZPOOL_PROP_DEDUPDITTO,
 		    &spa->spa_dedup_ditto);
 
@@ -3593,6 +3622,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	uint_t nspares, nl2cache;
 	uint64_t version, obj;
 	boolean_t has_features;
+	boolean_t has_allocclass;
 
 	/*
 	 * If this pool already exists, return failure.
@@ -3619,10 +3649,18 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	}
 
 	has_features = B_FALSE;
+	has_allocclass = B_FALSE;
 	for (nvpair_t *elem = nvlist_next_nvpair(props, NULL);
 	    elem != NULL; elem = nvlist_next_nvpair(props, elem)) {
-		if (zpool_prop_feature(nvpair_name(elem)))
+		const char *propname = nvpair_name(elem);
+		spa_feature_t fid;
+
+		if (zpool_prop_feature(propname)) {
 			has_features = B_TRUE;
+			if (zfeature_lookup_name(strchr(propname, '@') + 1,
+			    &fid) == 0 && fid == SPA_FEATURE_ALLOCATION_CLASSES)
+				has_allocclass = B_TRUE;
+		}
 	}
 
 	if (has_features || nvlist_lookup_uint64(props,
@@ -3661,6 +3699,16 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	if (error == 0 && !zfs_allocatable_devs(nvroot))
 		error = SET_ERROR(EINVAL);
 
+	/*
+	 * Dedicated allocation class vdevs require the allocation_classes
+	 * feature, which has to be enabled as part of the create.
+	 */
+	for (int c = 0; error == 0 && !has_allocclass &&
+	    c < rvd->vdev_children; c++) {
+		if (rvd->vdev_child[c]->vdev_alloc_bias != VDEV_BIAS_NONE)
+			error = SET_ERROR(ENOTSUP);
+	}
+
 	if (error == 0 &&
 	    (error = vdev_create(rvd, txg, B_FALSE)) == 0 &&
 	    (error = spa_validate_aux(spa, nvroot, txg,
@@ -3792,6 +3840,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_delegation = zpool_prop_default_numeric(ZPOOL_PROP_DELEGATION);
 	spa->spa_failmode = zpool_prop_default_numeric(ZPOOL_PROP_FAILUREMODE);
 	spa->spa_autoexpand = zpool_prop_default_numeric(ZPOOL_PROP_AUTOEXPAND);
+	spa->spa_autotrim = zpool_prop_default_numeric(ZPOOL_PROP_AUTOTRIM);
 
 	if (props != NULL) {
 		spa_configfile_set(spa, props, B_FALSE);
@@ -5761,6 +5810,86 @@ spa_scan(spa_t *spa, pool_scan_func_t func)
 	return (dsl_scan(spa->spa_dsl_pool, func));
 }
 
+/*
+ * ==========================================================================
+ * SPA manual trim
+ * ==========================================================================
+ */
+
+static void
+spa_trim_thread(void *arg)
+{
+	spa_t *spa = arg;
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	/*
+	 * The config lock is dropped between metaslabs, so the set of
+	 * top-level vdevs may change under us; recheck it each time.
+	 */
+	for (uint64_t c = 0; !spa->spa_trim_exit; c++) {
+		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+		if (c >= rvd->vdev_children) {
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+			break;
+		}
+		spa_config_exit(spa, SCL_CONFIG, FTAG);
+
+		for (uint64_t m = 0; !spa->spa_trim_exit; m++) {
+			vdev_t *vd;
+
+			spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+			vd = rvd->vdev_child[c];
+			if (m >= vd->vdev_ms_count || !vdev_writeable(vd)) {
+				spa_config_exit(spa, SCL_CONFIG, FTAG);
+				break;
+			}
+			(void) metaslab_trim_all(vd->vdev_ms[m]);
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+		}
+	}
+
+	mutex_enter(&spa->spa_trim_lock);
+	spa->spa_trim_thread = NULL;
+	cv_broadcast(&spa->spa_trim_cv);
+	mutex_exit(&spa->spa_trim_lock);
+	thread_exit();
+}
+
+/*
+ * Start trimming all free space in the pool, in the background.
+ */
+int
+spa_trim(spa_t *spa)
+{
+	if (!spa_writeable(spa))
+		return (SET_ERROR(EROFS));
+
+	mutex_enter(&spa->spa_trim_lock);
+	if (spa->spa_trim_thread != NULL) {
+		mutex_exit(&spa->spa_trim_lock);
+		return (SET_ERROR(EBUSY));
+	}
+	spa->spa_trim_exit = B_FALSE;
+	spa->spa_trim_thread = thread_create(NULL, 0, spa_trim_thread, spa,
+	    0, &p0, TS_RUN, minclsyspri);
+	mutex_exit(&spa->spa_trim_lock);
+
+	return (0);
+}
+
+/*
+ * Stop a manual trim, waiting for the metaslab being trimmed to finish.
+ */
+void
+spa_trim_stop(spa_t *spa)
+{
+	mutex_enter(&spa->spa_trim_lock);
+	spa->spa_trim_exit = B_TRUE;
+	while (spa->spa_trim_thread != NULL)
+		cv_wait(&spa->spa_trim_cv, &spa->spa_trim_lock);
+	mutex_exit(&spa->spa_trim_lock);
+}
+
 /*
  * ==========================================================================
  * SPA async task processing
@@ -6392,6 +6521,9 @@ spa_sync_props(void *arg, dmu_tx_t *tx)
 					spa_async_request(spa,
 					    SPA_ASYNC_AUTOEXPAND);
 				break;
+			case ZPOOL_PROP_AUTOTRIM:
+				spa->spa_autotrim = intval;
+				break;
 			case ZPOOL_PROP_DEDUPDITTO:
 				spa->spa_dedup_ditto = intval;
 				break;
@@ -6506,9 +6638,11 @@ spa_sync(spa_t *spa, uint64_t txg)
 	spa->spa_syncing_txg = txg;
 	spa->spa_sync_pass = 0;
 
-	mutex_enter(&spa->spa_alloc_lock);
-	VERIFY0(avl_numnodes(&spa->spa_alloc_tree));
-	mutex_exit(&spa->spa_alloc_lock);
+	for (int i = 0; i < spa->spa_alloc_count; i++) {
+		mutex_enter(&spa->spa_alloc_locks[i]);
+		VERIFY0(avl_numnodes(&spa->spa_alloc_trees[i]));
+		mutex_exit(&spa->spa_alloc_locks[i]);
+	}
 
 	/*
 	 * If there are any pending vdev state changes, convert them
@@ -6581,17 +6715,23 @@ spa_sync(spa_t *spa, uint64_t txg)
 		 * allocations look at mg_max_alloc_queue_depth, and async
 		 * allocations all happen from spa_sync().
 		 */
-		ASSERT0(refcount_count(&mg->mg_alloc_queue_depth));
+		for (int i = 0; i < spa->spa_alloc_count; i++) {
+			ASSERT0(refcount_count(
+			    &mg->mg_allocator[i].mga_alloc_queue_depth));
+		}
 		mg->mg_max_alloc_queue_depth = max_queue_depth;
 		queue_depth_total += mg->mg_max_alloc_queue_depth;
 	}
 	metaslab_class_t *mc = spa_normal_class(spa);
-	ASSERT0(refcount_count(&mc->mc_alloc_slots));
-	mc->mc_alloc_max_slots = queue_depth_total;
-	mc->mc_alloc_throttle_enabled = zio_dva_throttle_enabled;
+	for (int i = 0; i < spa->spa_alloc_count; i++) {
+		metaslab_class_allocator_t *mca = &mc->mc_allocator[i];
 
-	ASSERT3U(mc->mc_alloc_max_slots, <=,
-	    max_queue_depth * rvd->vdev_children);
+		ASSERT0(refcount_count(&mca->mca_alloc_slots));
+		mca->mca_alloc_max_slots = queue_depth_total;
+		ASSERT3U(mca->mca_alloc_max_slots, <=,
+		    max_queue_depth * rvd->vdev_children);
+	}
+	mc->mc_alloc_throttle_enabled = zio_dva_throttle_enabled;
 
 	/*
 	 * Iterate to convergence.
@@ -6744,9 +6884,11 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	dsl_pool_sync_done(dp, txg);
 
-	mutex_enter(&spa->spa_alloc_lock);
-	VERIFY0(avl_numnodes(&spa->spa_alloc_tree));
-	mutex_exit(&spa->spa_alloc_lock);
+	for (int i = 0; i < spa->spa_alloc_count; i++) {
+		mutex_enter(&spa->spa_alloc_locks[i]);
+		VERIFY0(avl_numnodes(&spa->spa_alloc_trees[i]));
+		mutex_exit(&spa->spa_alloc_locks[i]);
+	}
 
 	/*
 	 * Update usable space statistics.
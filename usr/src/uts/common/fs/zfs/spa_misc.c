@@ -50,8 +50,10 @@
 #include <sys/fs/zfs.h>
 #include <sys/metaslab_impl.h>
 #include <sys/arc.h>
+#include <sys/btree.h>
 #include <sys/ddt.h>
 #include "zfs_prop.h"
+#include <zfs_fletcher.h>
 #include <sys/zfeature.h>
 
 /*
@@ -350,6 +352,26 @@ int spa_asize_inflation = 24;
 int spa_slop_shift = 5;
 uint64_t spa_min_slop = 128 * 1024 * 1024;
 
+/*
+ * Small file and volume blocks are only placed in the special allocation
+ * class while it has more than this percentage of its space free, so that
+ * there is always room left for metadata.  Dedup table blocks also go to
+ * the special class when the pool has no dedup vdevs, unless
+ * zfs_ddt_data_is_special is cleared.
+ */
+int zfs_special_class_metadata_reserve_pct = 25;
+boolean_t zfs_ddt_data_is_special = B_TRUE;
+
+/*
+ * Number of independent allocators per pool.  Each allocator has its own
+ * throttle queue and, in every metaslab group, its own active metaslabs, so
+ * concurrent writers don't all serialize on the same ms_lock.  Async writes
+ * are spread over the allocators by a hash of their object and offset
+ * region, which keeps each region of a file together on disk.  Read when a
+ * pool is opened or created.
+ */
+int spa_allocators = 4;
+
 /*
  * ==========================================================================
  * SPA config locking
@@ -570,13 +592,14 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	mutex_init(&spa->spa_suspend_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_vdev_top_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_iokstat_lock, NULL, MUTEX_DEFAULT, NULL);
-	mutex_init(&spa->spa_alloc_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&spa->spa_trim_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	cv_init(&spa->spa_async_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_evicting_os_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_proc_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_scrub_io_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_suspend_cv, NULL, CV_DEFAULT, NULL);
+	cv_init(&spa->spa_trim_cv, NULL, CV_DEFAULT, NULL);
 
 	for (int t = 0; t < TXG_SIZE; t++)
 		bplist_create(&spa->spa_free_bplist[t]);
@@ -620,8 +643,17 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 		spa_active_count++;
 	}
 
-	avl_create(&spa->spa_alloc_tree, zio_timestamp_compare,
-	    sizeof (zio_t), offsetof(zio_t, io_alloc_node));
+	spa->spa_alloc_count = MAX(spa_allocators, 1);
+	spa->spa_alloc_locks = kmem_zalloc(spa->spa_alloc_count *
+	    sizeof (kmutex_t), KM_SLEEP);
+	spa->spa_alloc_trees = kmem_zalloc(spa->spa_alloc_count *
+	    sizeof (avl_tree_t), KM_SLEEP);
+	for (int i = 0; i < spa->spa_alloc_count; i++) {
+		mutex_init(&spa->spa_alloc_locks[i], NULL, MUTEX_DEFAULT,
+		    NULL);
+		avl_create(&spa->spa_alloc_trees[i], zio_timestamp_compare,
+		    sizeof (zio_t), offsetof(zio_t, io_alloc_node));
+	}
 
 	/*
 	 * Every pool starts with the default cachefile
@@ -708,7 +740,14 @@ spa_remove(spa_t *spa)
 		kmem_free(dp, sizeof (spa_config_dirent_t));
 	}
 
-	avl_destroy(&spa->spa_alloc_tree);
+	for (int i = 0; i < spa->spa_alloc_count; i++) {
+		avl_destroy(&spa->spa_alloc_trees[i]);
+		mutex_destroy(&spa->spa_alloc_locks[i]);
+	}
+	kmem_free(spa->spa_alloc_locks, spa->spa_alloc_count *
+	    sizeof (kmutex_t));
+	kmem_free(spa->spa_alloc_trees, spa->spa_alloc_count *
+	    sizeof (avl_tree_t));
 	list_destroy(&spa->spa_config_list);
 
 	nvlist_free(spa->spa_label_features);
@@ -738,8 +777,8 @@ spa_remove(spa_t *spa)
 	cv_destroy(&spa->spa_proc_cv);
 	cv_destroy(&spa->spa_scrub_io_cv);
 	cv_destroy(&spa->spa_suspend_cv);
+	cv_destroy(&spa->spa_trim_cv);
 
-	mutex_destroy(&spa->spa_alloc_lock);
 	mutex_destroy(&spa->spa_async_lock);
 	mutex_destroy(&spa->spa_errlist_lock);
 	mutex_destroy(&spa->spa_errlog_lock);
@@ -752,6 +791,7 @@ spa_remove(spa_t *spa)
 	mutex_destroy(&spa->spa_suspend_lock);
 	mutex_destroy(&spa->spa_vdev_top_lock);
 	mutex_destroy(&spa->spa_iokstat_lock);
+	mutex_destroy(&spa->spa_trim_lock);
 
 	kmem_free(spa, sizeof (spa_t));
 }
@@ -1123,6 +1163,8 @@ spa_vdev_config_exit(spa_t *spa, vdev_t *vd, uint64_t txg, int error, char *tag)
 	 */
 	ASSERT(metaslab_class_validate(spa_normal_class(spa)) == 0);
 	ASSERT(metaslab_class_validate(spa_log_class(spa)) == 0);
+	ASSERT(metaslab_class_validate(spa_dedup_class(spa)) == 0);
+	ASSERT(metaslab_class_validate(spa_special_class(spa)) == 0);
 
 	spa_config_exit(spa, SCL_ALL, spa);
 
@@ -1670,6 +1712,8 @@ void
 spa_update_dspace(spa_t *spa)
 {
 	spa->spa_dspace = metaslab_class_get_dspace(spa_normal_class(spa)) +
+	    metaslab_class_get_dspace(spa_dedup_class(spa)) +
+	    metaslab_class_get_dspace(spa_special_class(spa)) +
 	    ddt_get_dedup_dspace(spa);
 }
 
@@ -1713,6 +1757,62 @@ spa_log_class(spa_t *spa)
 	return (spa->spa_log_class);
 }
 
+metaslab_class_t *
+spa_dedup_class(spa_t *spa)
+{
+	return (spa->spa_dedup_class);
+}
+
+metaslab_class_t *
+spa_special_class(spa_t *spa)
+{
+	return (spa->spa_special_class);
+}
+
+/*
+ * Return the metaslab class a block of the given object type should be
+ * allocated from.  Dedup table blocks go to the dedup class when the pool
+ * has dedup vdevs, and to the special class otherwise.  Metadata and
+ * indirect blocks go to the special class, as do file and volume data
+ * blocks no larger than the dataset's special_small_blocks while the
+ * class has space to spare (see zfs_special_class_metadata_reserve_pct).
+ * Everything else goes to the normal class.
+ * Callers fall back to the normal class if the preferred class is full.
+ */
+metaslab_class_t *
+spa_preferred_class(spa_t *spa, uint64_t size, dmu_object_type_t objtype,
+    uint_t level, uint_t special_smallblk)
+{
+	metaslab_class_t *special = spa_special_class(spa);
+	boolean_t has_special = (special->mc_rotor != NULL);
+
+	if (objtype == DMU_OT_DDT_ZAP) {
+		if (spa->spa_dedup_class->mc_rotor != NULL)
+			return (spa_dedup_class(spa));
+		if (has_special && zfs_ddt_data_is_special)
+			return (special);
+		return (spa_normal_class(spa));
+	}
+
+	if (!has_special)
+		return (spa_normal_class(spa));
+
+	if (level > 0 || DMU_OT_IS_METADATA(objtype))
+		return (special);
+
+	if ((objtype == DMU_OT_PLAIN_FILE_CONTENTS ||
+	    objtype == DMU_OT_ZVOL) && size <= special_smallblk) {
+		uint64_t space = metaslab_class_get_space(special);
+		uint64_t limit = space *
+		    (100 - zfs_special_class_metadata_reserve_pct) / 100;
+
+		if (metaslab_class_get_alloc(special) < limit)
+			return (special);
+	}
+
+	return (spa_normal_class(spa));
+}
+
 void
 spa_evicting_os_register(spa_t *spa, objset_t *os)
 {
@@ -1876,11 +1976,13 @@ spa_init(int mode)
 
 	refcount_init();
 	unique_init();
-	range_tree_init();
+	zfs_btree_init();
+	fletcher_4_init();
 	zio_init();
 	dmu_init();
 	zil_init();
 	vdev_cache_stat_init();
+	vdev_queue_stat_init();
 	zfs_prop_init();
 	zpool_prop_init();
 	zpool_feature_init();
@@ -1895,11 +1997,13 @@ spa_fini(void)
 
 	spa_evict_all();
 
+	vdev_queue_stat_fini();
 	vdev_cache_stat_fini();
 	zil_fini();
 	dmu_fini();
 	zio_fini();
-	range_tree_fini();
+	fletcher_4_fini();
+	zfs_btree_fini();
 	unique_fini();
 	refcount_fini();
 
@@ -132,6 +132,65 @@ space_map_load(space_map_t *sm, range_tree_t *rt, maptype_t maptype)
 	return (error);
 }
 
+/*
+ * Call the callback for each alloc and free entry in the space map, in
+ * the order they were written.  Unlike space_map_load(), this covers
+ * everything on disk, including what was appended in the txg that is
+ * currently syncing.  Iteration stops at the first callback that returns
+ * non-zero, and that value is returned.
+ */
+int
+space_map_iterate(space_map_t *sm, sm_cb_t callback, void *arg)
+{
+	uint64_t *entry, *entry_map, *entry_map_end;
+	uint64_t bufsize, size, offset, end;
+	int error = 0;
+
+	end = sm->sm_phys->smp_objsize;
+	bufsize = MAX(sm->sm_blksz, SPA_MINBLOCKSIZE);
+	entry_map = zio_buf_alloc(bufsize);
+
+	if (end > bufsize) {
+		dmu_prefetch(sm->sm_os, space_map_object(sm), 0, bufsize,
+		    end - bufsize, ZIO_PRIORITY_SYNC_READ);
+	}
+
+	for (offset = 0; offset < end && error == 0; offset += bufsize) {
+		size = MIN(end - offset, bufsize);
+		VERIFY(P2PHASE(size, sizeof (uint64_t)) == 0);
+		VERIFY(size != 0);
+
+		error = dmu_read(sm->sm_os, space_map_object(sm), offset, size,
+		    entry_map, DMU_READ_PREFETCH);
+		if (error != 0)
+			break;
+
+		entry_map_end = entry_map + (size / sizeof (uint64_t));
+		for (entry = entry_map; entry < entry_map_end; entry++) {
+			uint64_t e = *entry;
+			uint64_t e_offset, e_size;
+
+			if (SM_DEBUG_DECODE(e))		/* Skip debug entries */
+				continue;
+
+			e_offset = (SM_OFFSET_DECODE(e) << sm->sm_shift) +
+			    sm->sm_start;
+			e_size = SM_RUN_DECODE(e) << sm->sm_shift;
+
+			VERIFY3U(e_offset, >=, sm->sm_start);
+			VERIFY3U(e_offset + e_size, <=,
+			    sm->sm_start + sm->sm_size);
+			error = callback(SM_TYPE_DECODE(e), e_offset, e_size,
+			    arg);
+			if (error != 0)
+				break;
+		}
+	}
+
+	zio_buf_free(entry_map, bufsize);
+	return (error);
+}
+
 void
 space_map_histogram_clear(space_map_t *sm)
 {
@@ -210,7 +269,8 @@ space_map_histogram_add(space_map_t *sm, range_tree_t *rt, dmu_tx_t *tx)
 uint64_t
 space_map_entries(space_map_t *sm, range_tree_t *rt)
 {
-	avl_tree_t *t = &rt->rt_root;
+	zfs_btree_t *t = &rt->rt_root;
+	zfs_btree_index_t where;
 	range_seg_t *rs;
 	uint64_t size, entries;
 
@@ -223,7 +283,8 @@ space_map_entries(space_map_t *sm, range_tree_t *rt)
 	 * Traverse the range tree and calculate the number of space map
 	 * entries that would be required to write out the range tree.
 	 */
-	for (rs = avl_first(t); rs != NULL; rs = AVL_NEXT(t, rs)) {
+	for (rs = zfs_btree_first(t, &where); rs != NULL;
+	    rs = zfs_btree_next(t, &where, &where)) {
 		size = (rs->rs_end - rs->rs_start) >> sm->sm_shift;
 		entries += howmany(size, SM_RUN_MAX);
 	}
@@ -239,7 +300,8 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 {
 	objset_t *os = sm->sm_os;
 	spa_t *spa = dmu_objset_spa(os);
-	avl_tree_t *t = &rt->rt_root;
+	zfs_btree_t *t = &rt->rt_root;
+	zfs_btree_index_t where;
 	range_seg_t *rs;
 	uint64_t size, total, rt_space, nodes;
 	uint64_t *entry, *entry_map, *entry_map_end;
@@ -279,9 +341,10 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 	    SM_DEBUG_TXG_ENCODE(dmu_tx_get_txg(tx));
 
 	total = 0;
-	nodes = avl_numnodes(&rt->rt_root);
+	nodes = zfs_btree_numnodes(&rt->rt_root);
 	rt_space = range_tree_space(rt);
-	for (rs = avl_first(t); rs != NULL; rs = AVL_NEXT(t, rs)) {
+	for (rs = zfs_btree_first(t, &where); rs != NULL;
+	    rs = zfs_btree_next(t, &where, &where)) {
 		uint64_t start;
 
 		size = (rs->rs_end - rs->rs_start) >> sm->sm_shift;
@@ -328,7 +391,7 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 	 * Ensure that the space_map's accounting wasn't changed
 	 * while we were in the middle of writing it out.
 	 */
-	VERIFY3U(nodes, ==, avl_numnodes(&rt->rt_root));
+	VERIFY3U(nodes, ==, zfs_btree_numnodes(&rt->rt_root));
 	VERIFY3U(range_tree_space(rt), ==, rt_space);
 	VERIFY3U(range_tree_space(rt), ==, total);
 
@@ -58,6 +58,7 @@ _NOTE(CONSTCOND) } while (0)
 
 typedef struct arc_buf_hdr arc_buf_hdr_t;
 typedef struct arc_buf arc_buf_t;
+typedef struct arc_ds arc_ds_t;
 typedef void arc_done_func_t(zio_t *zio, arc_buf_t *buf, void *private);
 
 /* generic arc_done_func_t's which you can use */
@@ -168,6 +169,7 @@ int arc_referenced(arc_buf_t *buf);
 int arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
     arc_done_func_t *done, void *private, zio_priority_t priority, int flags,
     arc_flags_t *arc_flags, const zbookmark_phys_t *zb);
+boolean_t arc_copy_pdata(spa_t *spa, const blkptr_t *bp, void *buf);
 zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
     blkptr_t *bp, arc_buf_t *buf, boolean_t l2arc, const zio_prop_t *zp,
     arc_done_func_t *ready, arc_done_func_t *child_ready,
@@ -177,6 +179,11 @@ zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
 void arc_freed(spa_t *spa, const blkptr_t *bp);
 
 void arc_flush(spa_t *spa, boolean_t retry);
+
+arc_ds_t *arc_ds_hold(spa_t *spa, uint64_t objset);
+void arc_ds_rele(arc_ds_t *ads);
+void arc_ds_set_quota(arc_ds_t *ads, uint64_t quota);
+void arc_ds_set_reservation(arc_ds_t *ads, uint64_t reserve);
 void arc_tempreserve_clear(uint64_t reserve);
 int arc_tempreserve_space(uint64_t reserve, uint64_t txg);
 
@@ -0,0 +1,191 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_BTREE_H
+#define	_BTREE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include	<sys/zfs_context.h>
+
+/*
+ * This file defines the interface for a B-Tree implementation for ZFS. The
+ * tree can be used to store arbitrary sortable data types with low overhead
+ * and good operation performance.
+ *
+ * Unlike an AVL tree, the B-tree stores copies of its elements, packed into
+ * arrays in its nodes, rather than linking in caller-allocated structures.
+ * This saves the space of the tree linkage in each element and keeps
+ * neighbouring elements in the same cache lines, at the cost that a pointer
+ * to an element is only valid until the tree is next modified.  Elements can
+ * be modified in place as long as their position in the ordering doesn't
+ * change.
+ *
+ * Every node holds between half-full and full arrays of elements (except
+ * the root). Core nodes also hold pointers to their children, with the
+ * elements of child i sorting between elements i - 1 and i of the core
+ * node.
+ */
+
+/*
+ * The size of all leaf nodes, and the number of elements in a core node.
+ */
+#define	BTREE_LEAF_SIZE		4096
+#define	BTREE_CORE_ELEMS	126
+
+typedef struct zfs_btree_hdr {
+	struct zfs_btree_core	*bth_parent;
+	boolean_t		bth_core;
+	uint32_t		bth_count;	/* number of elements */
+} zfs_btree_hdr_t;
+
+typedef struct zfs_btree_core {
+	zfs_btree_hdr_t	btc_hdr;
+	zfs_btree_hdr_t	*btc_children[BTREE_CORE_ELEMS + 1];
+	uint8_t		btc_elems[];
+} zfs_btree_core_t;
+
+typedef struct zfs_btree_leaf {
+	zfs_btree_hdr_t	btl_hdr;
+	uint8_t		btl_elems[];
+} zfs_btree_leaf_t;
+
+/*
+ * A position in the tree. If bti_before is set, it refers to the gap just
+ * before element bti_offset in the (leaf) node, rather than to the element
+ * itself; this is what zfs_btree_find() returns when the value isn't found,
+ * and it can be passed to zfs_btree_add_idx() to insert the value there, or
+ * to zfs_btree_next() or zfs_btree_prev() to find its nearest neighbours.
+ */
+typedef struct zfs_btree_index {
+	zfs_btree_hdr_t	*bti_node;
+	uint32_t	bti_offset;
+	boolean_t	bti_before;
+} zfs_btree_index_t;
+
+typedef struct zfs_btree {
+	zfs_btree_hdr_t	*bt_root;
+	int64_t		bt_height;	/* number of core levels */
+	size_t		bt_elem_size;
+	uint32_t	bt_leaf_cap;	/* elements per leaf */
+	uint64_t	bt_num_elems;
+	uint64_t	bt_num_nodes;
+	int		(*bt_compar) (const void *, const void *);
+} zfs_btree_t;
+
+/*
+ * Allocate and deallocate caches for btree nodes.
+ */
+void zfs_btree_init(void);
+void zfs_btree_fini(void);
+
+/*
+ * Initialize a B-Tree. Arguments are:
+ *
+ * tree - the tree to be initialized
+ * compar - function to compare two nodes, it must return exactly: -1, 0, or +1
+ *          -1 for <, 0 for ==, and +1 for >
+ * size - the value of sizeof(struct my_type)
+ */
+void zfs_btree_create(zfs_btree_t *, int (*) (const void *, const void *),
+    size_t);
+
+/*
+ * Find a node with a matching value in the tree. Returns the matching node
+ * found. If not found, it returns NULL, and if "where" is not NULL it sets
+ * "where" to the gap where the value would go.
+ *
+ * node   - node that has the value being looked for
+ * where  - position for use with zfs_btree_next(), zfs_btree_prev() or
+ *          zfs_btree_add_idx(), may be NULL
+ */
+void *zfs_btree_find(zfs_btree_t *, const void *, zfs_btree_index_t *);
+
+/*
+ * Insert a node into the tree, at a position found by zfs_btree_find().
+ */
+void zfs_btree_add_idx(zfs_btree_t *, const void *,
+    const zfs_btree_index_t *);
+
+/*
+ * Return the first or last valued node in the tree. Will return NULL if the
+ * tree is empty. The index can be NULL if the location of the first or last
+ * element isn't required.
+ */
+void *zfs_btree_first(zfs_btree_t *, zfs_btree_index_t *);
+void *zfs_btree_last(zfs_btree_t *, zfs_btree_index_t *);
+
+/*
+ * Return the next or previous valued node in the tree, and set the second
+ * index (which may be the same as the first) to its position. Given a gap,
+ * these return the element just after or before the gap.
+ */
+void *zfs_btree_next(zfs_btree_t *, const zfs_btree_index_t *,
+    zfs_btree_index_t *);
+void *zfs_btree_prev(zfs_btree_t *, const zfs_btree_index_t *,
+    zfs_btree_index_t *);
+
+/*
+ * Return the element at the given position, which must not be a gap.
+ */
+void *zfs_btree_get(zfs_btree_t *, zfs_btree_index_t *);
+
+/*
+ * Add a single value to the tree. The value must not compare equal to any
+ * other node already in the tree.
+ */
+void zfs_btree_add(zfs_btree_t *, const void *);
+
+/*
+ * Remove a single value from the tree. The value must be in the tree. The
+ * pointer passed in may be a pointer into a tree-controlled buffer, but it
+ * need not be.
+ */
+void zfs_btree_remove(zfs_btree_t *, const void *);
+
+/*
+ * Remove the value at the given location from the tree.
+ */
+void zfs_btree_remove_idx(zfs_btree_t *, zfs_btree_index_t *);
+
+/*
+ * Returns the number of nodes in the tree.
+ */
+ulong_t zfs_btree_numnodes(zfs_btree_t *);
+
+/*
+ * Destroys all nodes in the tree quickly. Since the elements live in the
+ * tree's own buffers, there is nothing for the caller to free; any cleanup
+ * they need can be done by walking the tree first.
+ */
+void zfs_btree_clear(zfs_btree_t *);
+
+/*
+ * Final destroy of a B-Tree. Arguments are:
+ *
+ * tree   - the empty tree to destroy
+ */
+void zfs_btree_destroy(zfs_btree_t *tree);
+
+/* Runs a variety of self-checks on the btree to verify integrity. */
+void zfs_btree_verify(zfs_btree_t *tree);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _BTREE_H */
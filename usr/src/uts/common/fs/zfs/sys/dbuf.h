@@ -146,6 +146,15 @@ typedef struct dbuf_dirty_record {
 			override_states_t dr_override_state;
 			uint8_t dr_copies;
 			boolean_t dr_nopwrite;
+
+			/*
+			 * dr_raw_data is set by dmu_buf_write_compressed()
+			 * to psize bytes of already-compressed data that
+			 * are written out as is in syncing context.
+			 */
+			void *dr_raw_data;
+			uint64_t dr_raw_psize;
+			enum zio_compress dr_raw_compress;
 		} dl;
 	} dt;
 } dbuf_dirty_record_t;
@@ -262,7 +271,7 @@ typedef struct dmu_buf_impl {
 } dmu_buf_impl_t;
 
 /* Note: the dbuf hash table is exposed only for the mdb module */
-#define	DBUF_MUTEXES 256
+#define	DBUF_MUTEXES 2048
 #define	DBUF_HASH_MUTEX(h, idx) (&(h)->hash_mutexes[(idx) & (DBUF_MUTEXES-1)])
 typedef struct dbuf_hash_table {
 	uint64_t hash_table_mask;
@@ -310,6 +319,8 @@ arc_buf_t *dbuf_loan_arcbuf(dmu_buf_impl_t *db);
 void dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
     bp_embedded_type_t etype, enum zio_compress comp,
     int uncompressed_size, int compressed_size, int byteorder, dmu_tx_t *tx);
+void dmu_buf_write_compressed(dmu_buf_t *dbuf, void *data,
+    enum zio_compress comp, uint64_t psize, dmu_tx_t *tx);
 
 void dbuf_destroy(dmu_buf_impl_t *db);
 
@@ -117,6 +117,65 @@ struct ddt_entry {
 	avl_node_t	dde_node;
 };
 
+/*
+ * On-disk dedup log record.  Records are appended to the active log
+ * object in syncing context and replayed in order at pool load, so the
+ * last record for a key wins.  ddlr_info encodes the class the entry
+ * logically belongs to and the ZAP object currently holding it; a type
+ * of DDT_TYPES means "none" (the entry was freed, or is not in a ZAP).
+ */
+typedef struct ddt_log_record {
+	ddt_key_t	ddlr_key;
+	ddt_phys_t	ddlr_phys[DDT_PHYS_TYPES];
+	uint64_t	ddlr_info;
+} ddt_log_record_t;
+
+#define	DDLR_GET_TYPE(ddlr)		BF64_GET((ddlr)->ddlr_info, 0, 8)
+#define	DDLR_SET_TYPE(ddlr, x)		BF64_SET((ddlr)->ddlr_info, 0, 8, x)
+#define	DDLR_GET_CLASS(ddlr)		BF64_GET((ddlr)->ddlr_info, 8, 8)
+#define	DDLR_SET_CLASS(ddlr, x)		BF64_SET((ddlr)->ddlr_info, 8, 8, x)
+#define	DDLR_GET_ZAP_TYPE(ddlr)		BF64_GET((ddlr)->ddlr_info, 16, 8)
+#define	DDLR_SET_ZAP_TYPE(ddlr, x)	BF64_SET((ddlr)->ddlr_info, 16, 8, x)
+#define	DDLR_GET_ZAP_CLASS(ddlr)	BF64_GET((ddlr)->ddlr_info, 24, 8)
+#define	DDLR_SET_ZAP_CLASS(ddlr, x)	BF64_SET((ddlr)->ddlr_info, 24, 8, x)
+
+/*
+ * On-disk dedup log header, stored in the MOS directory under
+ * DMU_POOL_DDT_LOG.  Records in the flushing log whose keys sort at or
+ * before ddlp_cursor have already been written to the ZAP objects.
+ */
+typedef struct ddt_log_phys {
+	uint64_t	ddlp_object[2];
+	uint64_t	ddlp_length[2];
+	uint64_t	ddlp_first_txg[2];	/* txg of each first record */
+	uint64_t	ddlp_active;	/* index of the active log */
+	uint64_t	ddlp_flushed;	/* ddlp_cursor is valid */
+	ddt_key_t	ddlp_cursor;
+} ddt_log_phys_t;
+
+/*
+ * In-core dedup log entry: the latest logged state of a key.
+ */
+typedef struct ddt_log_entry {
+	ddt_key_t	ddle_key;
+	ddt_phys_t	ddle_phys[DDT_PHYS_TYPES];
+	uint8_t		ddle_type;	/* logical type, DDT_TYPES if freed */
+	uint8_t		ddle_class;	/* logical class */
+	uint8_t		ddle_zap_type;	/* ZAP holding the key, if any */
+	uint8_t		ddle_zap_class;
+	avl_node_t	ddle_node;
+} ddt_log_entry_t;
+
+/*
+ * In-core dedup log
+ */
+typedef struct ddt_log {
+	uint64_t	ddl_object;
+	uint64_t	ddl_length;	/* bytes of records on disk */
+	uint64_t	ddl_first_txg;	/* txg of the first record */
+	avl_tree_t	ddl_tree;	/* ddt_log_entry_t, by key */
+} ddt_log_t;
+
 /*
  * In-core ddt
  */
@@ -133,6 +192,23 @@ struct ddt {
 	ddt_histogram_t	ddt_histogram_cache[DDT_TYPES][DDT_CLASSES];
 	ddt_object_t	ddt_object_stats[DDT_TYPES][DDT_CLASSES];
 	avl_node_t	ddt_node;
+
+	/*
+	 * Dedup log.  Updates are appended to the active log; the flushing
+	 * log is written back to the ZAP objects a batch at a time, and the
+	 * two are swapped once the flushing log has drained.  The trees are
+	 * modified in syncing context and protected by ddt_lock for readers.
+	 */
+	ddt_log_t	ddt_log[2];
+	ddt_log_t	*ddt_log_active;
+	ddt_log_t	*ddt_log_flushing;
+	boolean_t	ddt_log_flushed;	/* ddt_log_cursor is valid */
+	ddt_key_t	ddt_log_cursor;		/* last key flushed */
+	uint64_t	ddt_log_flush_rate;	/* entries flushed per txg */
+	ddt_log_record_t *ddt_log_buf;		/* records not yet written */
+	uint64_t	ddt_log_buf_count;
+	/* entries the logs add to (or remove from) each ZAP object */
+	int64_t		ddt_log_count[DDT_TYPES][DDT_CLASSES];
 };
 
 /*
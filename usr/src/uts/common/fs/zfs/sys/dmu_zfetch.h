@@ -50,6 +50,9 @@ typedef struct zstream {
 	 */
 	uint64_t	zs_ipf_blkid;
 
+	uint64_t	zs_pf_dist;	/* data prefetch distance, in bytes */
+	uint64_t	zs_nowait_blks;	/* blocks read without waiting */
+
 	kmutex_t	zs_lock;	/* protects stream */
 	hrtime_t	zs_atime;	/* time last prefetch issued */
 	list_node_t	zs_node;	/* link for zf_stream */
@@ -66,7 +69,8 @@ void		zfetch_fini(void);
 
 void		dmu_zfetch_init(zfetch_t *, struct dnode *);
 void		dmu_zfetch_fini(zfetch_t *);
-void		dmu_zfetch(zfetch_t *, uint64_t, uint64_t, boolean_t);
+void		dmu_zfetch(zfetch_t *, uint64_t, uint64_t, boolean_t,
+    boolean_t);
 
 
 #ifdef	__cplusplus
@@ -83,7 +83,24 @@ extern "C" {
 #define	DN_MAX_NBLKPTR	((DNODE_SIZE - DNODE_CORE_SIZE) >> SPA_BLKPTRSHIFT)
 #define	DN_MAX_BONUSLEN	(DNODE_SIZE - DNODE_CORE_SIZE - (1 << SPA_BLKPTRSHIFT))
 #define	DN_MAX_OBJECT	(1ULL << DN_MAX_OBJECT_SHIFT)
-#define	DN_ZERO_BONUSLEN	(DN_MAX_BONUSLEN + 1)
+
+/*
+ * With the large_dnode feature a dnode may span several consecutive
+ * DNODE_SIZE slots of its dnode block (dn_extra_slots says how many
+ * beyond the first).  The extra space goes to the bonus buffer, and the
+ * spill block pointer moves to the end of the last slot.  DN_MAX_BONUSLEN
+ * remains the bonus space of a legacy single-slot dnode.
+ */
+#define	DNODE_MIN_SIZE		DNODE_SIZE
+#define	DNODE_MAX_SIZE		(1 << DNODE_BLOCK_SHIFT)
+#define	DNODE_MIN_SLOTS		(DNODE_MIN_SIZE >> DNODE_SHIFT)
+#define	DNODE_MAX_SLOTS		(DNODE_MAX_SIZE >> DNODE_SHIFT)
+#define	DN_BONUS_SIZE(dnsize)	\
+	((dnsize) - DNODE_CORE_SIZE - (1 << SPA_BLKPTRSHIFT))
+#define	DN_SLOTS_TO_BONUSLEN(slots)	\
+	DN_BONUS_SIZE((slots) << DNODE_SHIFT)
+#define	DN_MAX_BONUS_SIZE	DN_BONUS_SIZE(DNODE_MAX_SIZE)
+#define	DN_ZERO_BONUSLEN	(DN_MAX_BONUS_SIZE + 1)
 #define	DN_KILL_SPILLBLK (1)
 
 #define	DNODES_PER_BLOCK_SHIFT	(DNODE_BLOCK_SHIFT - DNODE_SHIFT)
@@ -103,6 +120,10 @@ extern "C" {
 #define	DN_BONUS(dnp)	((void*)((dnp)->dn_bonus + \
 	(((dnp)->dn_nblkptr - 1) * sizeof (blkptr_t))))
 
+#define	DN_SPILL_BLKPTR(dnp)	((blkptr_t *)((char *)(dnp) + \
+	(((dnp)->dn_extra_slots + 1) << DNODE_SHIFT) - \
+	(1 << SPA_BLKPTRSHIFT)))
+
 #define	DN_USED_BYTES(dnp) (((dnp)->dn_flags & DNODE_FLAG_USED_BYTES) ? \
 	(dnp)->dn_used : (dnp)->dn_used << SPA_MINBLOCKSHIFT)
 
@@ -136,7 +157,8 @@ typedef struct dnode_phys {
 	uint8_t dn_flags;		/* DNODE_FLAG_* */
 	uint16_t dn_datablkszsec;	/* data block size in 512b sectors */
 	uint16_t dn_bonuslen;		/* length of dn_bonus */
-	uint8_t dn_pad2[4];
+	uint8_t dn_extra_slots;		/* # of subsequent slots consumed */
+	uint8_t dn_pad2[3];
 
 	/* accounting is protected by dn_dirty_mtx */
 	uint64_t dn_maxblkid;		/* largest allocated block ID */
@@ -144,6 +166,11 @@ typedef struct dnode_phys {
 
 	uint64_t dn_pad3[4];
 
+	/*
+	 * In a dnode of more than one slot, dn_blkptr[] and dn_bonus[] run
+	 * on into the following slots; use DN_SPILL_BLKPTR() rather than
+	 * dn_spill to find the spill block pointer.
+	 */
 	blkptr_t dn_blkptr[1];
 	uint8_t dn_bonus[DN_MAX_BONUSLEN - sizeof (blkptr_t)];
 	blkptr_t dn_spill;
@@ -181,6 +208,7 @@ typedef struct dnode {
 	uint8_t dn_indblkshift;
 	uint8_t dn_datablkshift;	/* zero if blksz not power of 2! */
 	uint8_t dn_moved;		/* Has this dnode been moved? */
+	uint8_t dn_num_slots;		/* metadnode slots consumed */
 	uint16_t dn_datablkszsec;	/* in 512b sectors */
 	uint32_t dn_datablksz;		/* in bytes */
 	uint64_t dn_maxblkid;
@@ -258,10 +286,17 @@ typedef struct dnode_handle {
 	/* Protects dnh_dnode from modification by dnode_move(). */
 	zrlock_t dnh_zrlock;
 	dnode_t *dnh_dnode;
+	/*
+	 * The slot belongs to a large dnode in an earlier slot, and has no
+	 * dnode of its own.  Set under dnc_slot_lock when the large dnode is
+	 * allocated, cleared when its free is synced.
+	 */
+	boolean_t dnh_interior;
 } dnode_handle_t;
 
 typedef struct dnode_children {
 	dmu_buf_user_t dnc_dbu;		/* User evict data */
+	kmutex_t dnc_slot_lock;		/* serializes slot allocation */
 	size_t dnc_count;		/* number of children */
 	dnode_handle_t dnc_children[];	/* sized dynamically */
 } dnode_children_t;
@@ -278,11 +313,12 @@ void dnode_special_close(dnode_handle_t *dnh);
 
 void dnode_setbonuslen(dnode_t *dn, int newsize, dmu_tx_t *tx);
 void dnode_setbonus_type(dnode_t *dn, dmu_object_type_t, dmu_tx_t *tx);
+int sa_bonus_max(dmu_buf_t *db);
 void dnode_rm_spill(dnode_t *dn, dmu_tx_t *tx);
 
 int dnode_hold(struct objset *dd, uint64_t object,
     void *ref, dnode_t **dnp);
-int dnode_hold_impl(struct objset *dd, uint64_t object, int flag,
+int dnode_hold_impl(struct objset *dd, uint64_t object, int flag, int slots,
     void *ref, dnode_t **dnp);
 boolean_t dnode_add_ref(dnode_t *dn, void *ref);
 void dnode_rele(dnode_t *dn, void *ref);
@@ -290,10 +326,11 @@ void dnode_rele_and_unlock(dnode_t *dn, void *tag);
 void dnode_setdirty(dnode_t *dn, dmu_tx_t *tx);
 void dnode_sync(dnode_t *dn, dmu_tx_t *tx);
 void dnode_allocate(dnode_t *dn, dmu_object_type_t ot, int blocksize, int ibs,
-    dmu_object_type_t bonustype, int bonuslen, dmu_tx_t *tx);
+    dmu_object_type_t bonustype, int bonuslen, int dn_slots, dmu_tx_t *tx);
 void dnode_reallocate(dnode_t *dn, dmu_object_type_t ot, int blocksize,
     dmu_object_type_t bonustype, int bonuslen, dmu_tx_t *tx);
 void dnode_free(dnode_t *dn, dmu_tx_t *tx);
+void dnode_free_interior_slots(dnode_t *dn);
 void dnode_byteswap(dnode_phys_t *dnp);
 void dnode_buf_byteswap(void *buf, size_t size);
 void dnode_verify(dnode_t *dn);
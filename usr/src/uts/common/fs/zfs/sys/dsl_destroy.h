@@ -33,6 +33,7 @@ extern "C" {
 
 struct nvlist;
 struct dsl_dataset;
+struct dsl_pool;
 struct dmu_tx;
 
 int dsl_destroy_snapshots_nvl(struct nvlist *, boolean_t,
@@ -45,6 +46,9 @@ int dsl_destroy_inconsistent(const char *, void *);
 int dsl_destroy_snapshot_check_impl(struct dsl_dataset *, boolean_t);
 void dsl_destroy_snapshot_sync_impl(struct dsl_dataset *,
     boolean_t, struct dmu_tx *);
+void dsl_destroy_queue_sync(struct dsl_pool *, struct dmu_tx *);
+boolean_t dsl_destroy_queue_active(struct dsl_pool *);
+uint64_t dsl_destroy_queue_count(struct dsl_pool *);
 
 #ifdef	__cplusplus
 }
@@ -111,6 +111,10 @@ struct dsl_dir {
 	/* amount of space we expect to write; == amount of dirty data */
 	int64_t dd_space_towrite[TXG_SIZE];
 
+	/* dirty data accounted to this dir; protected by dp_lock */
+	uint64_t dd_dirty_pertxg[TXG_SIZE];
+	uint64_t dd_dirty_total;
+
 	/* protected by dd_lock; keep at end of struct for better locality */
 	char dd_myname[ZFS_MAX_DATASET_NAME_LEN];
 };
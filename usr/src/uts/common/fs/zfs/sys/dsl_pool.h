@@ -54,6 +54,7 @@ extern uint64_t zfs_dirty_data_max_max;
 extern uint64_t zfs_dirty_data_sync;
 extern int zfs_dirty_data_max_percent;
 extern int zfs_delay_min_dirty_percent;
+extern boolean_t zfs_dirty_data_fair;
 extern uint64_t zfs_delay_scale;
 
 /* These macros are for indexing into the zfs_all_blkstats_t. */
@@ -88,6 +89,7 @@ typedef struct dsl_pool {
 	struct dsl_dataset *dp_origin_snap;
 	uint64_t dp_root_dir_obj;
 	struct taskq *dp_vnrele_taskq;
+	struct taskq *dp_sync_taskq;
 
 	/* No lock needed - sync context only */
 	blkptr_t dp_meta_rootbp;
@@ -95,6 +97,8 @@ typedef struct dsl_pool {
 	bpobj_t dp_free_bpobj;
 	uint64_t dp_bptree_obj;
 	uint64_t dp_empty_bpobj;
+	uint64_t dp_destroy_queue_obj;
+	boolean_t dp_destroy_queue_stalled;
 
 	struct dsl_scan *dp_scan;
 
@@ -103,6 +107,7 @@ typedef struct dsl_pool {
 	kcondvar_t dp_spaceavail_cv;
 	uint64_t dp_dirty_pertxg[TXG_SIZE];
 	uint64_t dp_dirty_total;
+	uint64_t dp_dirty_ndirs;	/* dsl_dirs with dd_dirty_total != 0 */
 	uint64_t dp_mos_used_delta;
 	uint64_t dp_mos_compressed_delta;
 	uint64_t dp_mos_uncompressed_delta;
@@ -141,8 +146,10 @@ void dsl_pool_sync_done(dsl_pool_t *dp, uint64_t txg);
 int dsl_pool_sync_context(dsl_pool_t *dp);
 uint64_t dsl_pool_adjustedsize(dsl_pool_t *dp, boolean_t netfree);
 uint64_t dsl_pool_adjustedfree(dsl_pool_t *dp, boolean_t netfree);
-void dsl_pool_dirty_space(dsl_pool_t *dp, int64_t space, dmu_tx_t *tx);
-void dsl_pool_undirty_space(dsl_pool_t *dp, int64_t space, uint64_t txg);
+void dsl_pool_dirty_space(dsl_pool_t *dp, struct dsl_dir *dd, int64_t space,
+    dmu_tx_t *tx);
+void dsl_pool_undirty_space(dsl_pool_t *dp, struct dsl_dir *dd,
+    int64_t space, uint64_t txg);
 void dsl_free(dsl_pool_t *dp, uint64_t txg, const blkptr_t *bpp);
 void dsl_free_sync(zio_t *pio, dsl_pool_t *dp, uint64_t txg,
     const blkptr_t *bpp);
@@ -156,7 +163,7 @@ void dsl_pool_config_enter_prio(dsl_pool_t *dp, void *tag);
 void dsl_pool_config_exit(dsl_pool_t *dp, void *tag);
 boolean_t dsl_pool_config_held(dsl_pool_t *dp);
 boolean_t dsl_pool_config_held_writer(dsl_pool_t *dp);
-boolean_t dsl_pool_need_dirty_delay(dsl_pool_t *dp);
+boolean_t dsl_pool_need_dirty_delay(dsl_pool_t *dp, struct dsl_dir *dd);
 
 taskq_t *dsl_pool_vnrele_taskq(dsl_pool_t *dp);
 
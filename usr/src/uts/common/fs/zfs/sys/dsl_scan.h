@@ -30,6 +30,7 @@
 #include <sys/zio.h>
 #include <sys/ddt.h>
 #include <sys/bplist.h>
+#include <sys/avl.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -96,6 +97,13 @@ typedef enum dsl_scan_flags {
  *			the scan but have not yet been processed (i.e deferred
  *			frees) are accounted for.
  *
+ * scn_queues -		while a scrub or resilver traversal is running, the
+ *			I/Os it generates are not issued immediately but are
+ *			collected here, one AVL tree per top-level vdev
+ *			sorted by on-disk offset, and are then issued in
+ *			offset order (see dsl_scan_issue()).  The time this
+ *			takes is charged to the txg's scan budget.
+ *
  * This structure also maintains information about deferred frees which are
  * a special kind of traversal. Deferred free can exist in either a bptree or
  * a bpobj structure. The scn_is_bptree flag will indicate the type of
@@ -116,8 +124,15 @@ typedef struct dsl_scan {
 	boolean_t scn_async_destroying;
 	boolean_t scn_async_stalled;
 
+	/* for sorting scrub/resilver I/Os by offset before issuing them */
+	avl_tree_t *scn_queues;
+	uint64_t scn_queues_count;
+	uint64_t scn_queued_bytes;
+	uint64_t scn_issue_ns;		/* estimated ns to issue one I/O */
+
 	/* for debugging / information */
 	uint64_t scn_visited_this_txg;
+	uint64_t scn_issued_this_txg;
 
 	dsl_scan_phys_t scn_phys;
 } dsl_scan_t;
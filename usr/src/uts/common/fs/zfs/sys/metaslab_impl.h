@@ -50,20 +50,41 @@ extern "C" {
  * When a block allocation is requested from the SPA it is associated with a
  * metaslab_class_t, and only top-level vdevs (i.e. metaslab groups) belonging
  * to the class can be used to satisfy that request. Allocations are done
- * by traversing the metaslab groups that are linked off of the mc_rotor field.
- * This rotor points to the next metaslab group where allocations will be
- * attempted. Allocating a block is a 3 step process -- select the metaslab
- * group, select the metaslab, and then allocate the block. The metaslab
- * class defines the low-level block allocator that will be used as the
- * final step in allocation. These allocators are pluggable allowing each class
- * to use a block allocator that best suits that class.
+ * by traversing the ring of metaslab groups that mc_rotor is linked into.
+ * Each of the pool's allocators (see spa_allocators) has its own rotor,
+ * which points to the next metaslab group where that allocator will
+ * attempt allocations. Allocating a block is a 3 step process -- select the
+ * metaslab group, select the metaslab, and then allocate the block. The
+ * metaslab class defines the low-level block allocator that will be used as
+ * the final step in allocation. These allocators are pluggable allowing each
+ * class to use a block allocator that best suits that class.
  */
+typedef struct metaslab_class_allocator {
+	kmutex_t		mca_lock;
+	metaslab_group_t	*mca_rotor;
+	uint64_t		mca_aliquot;
+
+	/*
+	 * The allocation throttle works on a reservation system. Whenever
+	 * an asynchronous zio wants to perform an allocation it must
+	 * first reserve the number of blocks that it wants to allocate.
+	 * If there aren't sufficient slots available for the pending zio
+	 * then that I/O is throttled until more slots free up. The current
+	 * number of reserved allocations is maintained by the mca_alloc_slots
+	 * refcount. The mca_alloc_max_slots value determines the maximum
+	 * number of allocations that the allocator allows. Gang blocks are
+	 * allowed to reserve slots even if we've reached the maximum
+	 * number of allocations allowed.
+	 */
+	uint64_t		mca_alloc_max_slots;
+	refcount_t		mca_alloc_slots;
+} metaslab_class_allocator_t;
+
 struct metaslab_class {
 	kmutex_t		mc_lock;
 	spa_t			*mc_spa;
-	metaslab_group_t	*mc_rotor;
+	metaslab_group_t	*mc_rotor;	/* any group in the ring */
 	metaslab_ops_t		*mc_ops;
-	uint64_t		mc_aliquot;
 
 	/*
 	 * Track the number of metaslab groups that have been initialized
@@ -78,20 +99,8 @@ struct metaslab_class {
 	 */
 	boolean_t		mc_alloc_throttle_enabled;
 
-	/*
-	 * The allocation throttle works on a reservation system. Whenever
-	 * an asynchronous zio wants to perform an allocation it must
-	 * first reserve the number of blocks that it wants to allocate.
-	 * If there aren't sufficient slots available for the pending zio
-	 * then that I/O is throttled until more slots free up. The current
-	 * number of reserved allocations is maintained by the mc_alloc_slots
-	 * refcount. The mc_alloc_max_slots value determines the maximum
-	 * number of allocations that the system allows. Gang blocks are
-	 * allowed to reserve slots even if we've reached the maximum
-	 * number of allocations allowed.
-	 */
-	uint64_t		mc_alloc_max_slots;
-	refcount_t		mc_alloc_slots;
+	int			mc_allocators;
+	metaslab_class_allocator_t *mc_allocator;
 
 	uint64_t		mc_alloc_groups; /* # of allocatable groups */
 
@@ -102,6 +111,16 @@ struct metaslab_class {
 	uint64_t		mc_histogram[RANGE_TREE_HISTOGRAM_SIZE];
 };
 
+/*
+ * Per-allocator state of a metaslab group: the metaslabs the allocator is
+ * currently allocating from, and its share of the group's queue depth.
+ */
+typedef struct metaslab_group_allocator {
+	metaslab_t		*mga_primary;
+	metaslab_t		*mga_secondary;
+	refcount_t		mga_alloc_queue_depth;
+} metaslab_group_allocator_t;
+
 /*
  * Metaslab groups encapsulate all the allocatable regions (i.e. metaslabs)
  * of a top-level vdev. They are linked togther to form a circular linked
@@ -135,14 +154,16 @@ struct metaslab_group {
 	metaslab_group_t	*mg_next;
 
 	/*
-	 * Each metaslab group can handle mg_max_alloc_queue_depth allocations
-	 * which are tracked by mg_alloc_queue_depth. It's possible for a
-	 * metaslab group to handle more allocations than its max. This
-	 * can occur when gang blocks are required or when other groups
-	 * are unable to handle their share of allocations.
+	 * Each allocator can have mg_max_alloc_queue_depth allocations
+	 * outstanding against a metaslab group, which are tracked by its
+	 * mga_alloc_queue_depth. It's possible for a metaslab group to
+	 * handle more allocations than its max. This can occur when gang
+	 * blocks are required or when other groups are unable to handle
+	 * their share of allocations.
 	 */
 	uint64_t		mg_max_alloc_queue_depth;
-	refcount_t		mg_alloc_queue_depth;
+	int			mg_allocators;
+	metaslab_group_allocator_t *mg_allocator;
 
 	/*
 	 * A metalab group that can no longer allocate the minimum block
@@ -215,6 +236,20 @@ struct metaslab_group {
  * representation, we rewrite it in its minimized form. If a metaslab
  * needs to condense then we must set the ms_condensing flag to ensure
  * that allocations are not performed on the metaslab that is being written.
+ *
+ * When the pool's autotrim property is on, space coming back out of the
+ * ms_defertree is also added to ms_cur_trimset.  Every zfs_txgs_per_trim
+ * txgs the ms_prev_trimset is trimmed and ms_cur_trimset takes its place,
+ * so that freed space is left alone for a while before it is trimmed, in
+ * case the pool has to be rewound.  Allocations clear their range out of
+ * both trimsets.  While a trim is in flight its segments are moved from
+ * the ms_tree to ms_trimming, so they can't be allocated until the device
+ * is done with them.
+ *
+ * Where the vdev has log space maps, a txg's allocs and frees are
+ * normally appended to the log for that txg instead of to ms_sm, and the
+ * difference is kept in ms_unflushed_allocs and ms_unflushed_frees until
+ * the metaslab is next flushed (see "Log space maps" in metaslab.c).
  */
 struct metaslab {
 	kmutex_t	ms_lock;
@@ -231,6 +266,20 @@ struct metaslab {
 	range_tree_t	*ms_defertree[TXG_DEFER_SIZE];
 	range_tree_t	*ms_tree;
 
+	range_tree_t	*ms_cur_trimset;	/* freed, to trim later */
+	range_tree_t	*ms_prev_trimset;	/* freed, to trim next */
+	range_tree_t	*ms_trimming;		/* trim in flight */
+	kcondvar_t	ms_trim_cv;		/* ms_trimming drained */
+	uint64_t	ms_trim_txg;		/* last trimset rotation */
+
+	range_tree_t	*ms_unflushed_allocs;	/* logged, not in ms_sm */
+	range_tree_t	*ms_unflushed_frees;	/* logged, not in ms_sm */
+	range_tree_t	*ms_logged_allocs;	/* logged this txg */
+	uint64_t	ms_flushed_txg;		/* ms_sm is current as of */
+	uint64_t	ms_logged_txg;		/* last txg we logged in */
+	boolean_t	ms_unflushed;		/* in vdev_unflushed_ms? */
+	avl_node_t	ms_unflushed_node;
+
 	boolean_t	ms_condensing;	/* condensing? */
 	boolean_t	ms_condense_wanted;
 	boolean_t	ms_loaded;
@@ -238,8 +287,17 @@ struct metaslab {
 
 	int64_t		ms_deferspace;	/* sum of ms_defermap[] space	*/
 	uint64_t	ms_weight;	/* weight vs. others in group	*/
+	uint64_t	ms_activation_weight;	/* weight when activated */
+	int		ms_allocator;	/* active for allocator, or -1	*/
+	boolean_t	ms_primary;	/* active as primary?		*/
 	uint64_t	ms_access_txg;
 
+	/*
+	 * The largest contiguous free segment, valid only while the
+	 * metaslab is loaded (zero otherwise).
+	 */
+	uint64_t	ms_max_size;
+
 	/*
 	 * The metaslab block allocators can optionally use a size-ordered
 	 * range tree and/or an array of LBAs. Not all allocators use
@@ -247,7 +305,7 @@ struct metaslab {
 	 * same number of segments as the ms_tree. The only difference
 	 * is that the ms_size_tree is ordered by segment sizes.
 	 */
-	avl_tree_t	ms_size_tree;
+	zfs_btree_t	ms_size_tree;
 	uint64_t	ms_lbas[MAX_LBAS];
 
 	metaslab_group_t *ms_group;	/* metaslab group		*/
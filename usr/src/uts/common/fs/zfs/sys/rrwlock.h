@@ -50,7 +50,14 @@ extern "C" {
  * - rr_anon_rount: number of active anonymous readers
  * - rr_linked_rcount: total number of non-anonymous active readers
  * - rr_writer_wanted: a writer wants the lock
+ * - rr_pcpu: per-CPU reader counts (rrw_init_percpu() locks only), used
+ *   instead of rr_anon_rcount and rr_linked_rcount
  */
+typedef struct rrw_pcpu {
+	uint64_t	rp_count;
+	char		rp_pad[64 - sizeof (uint64_t)];
+} rrw_pcpu_t;
+
 typedef struct rrwlock {
 	kmutex_t	rr_lock;
 	kcondvar_t	rr_cv;
@@ -59,6 +66,7 @@ typedef struct rrwlock {
 	refcount_t	rr_linked_rcount;
 	boolean_t	rr_writer_wanted;
 	boolean_t	rr_track_all;
+	rrw_pcpu_t	*rr_pcpu;
 } rrwlock_t;
 
 /*
@@ -67,6 +75,7 @@ typedef struct rrwlock {
  * corresponding rrw_exit().
  */
 void rrw_init(rrwlock_t *rrl, boolean_t track_all);
+void rrw_init_percpu(rrwlock_t *rrl);
 void rrw_destroy(rrwlock_t *rrl);
 void rrw_enter(rrwlock_t *rrl, krw_t rw, void *tag);
 void rrw_enter_read(rrwlock_t *rrl, void *tag);
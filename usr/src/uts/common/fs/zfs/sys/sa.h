@@ -103,6 +103,11 @@ typedef struct sa_bulk_attr {
 
 typedef struct sa_os sa_os_t;
 
+/*
+ * Most attributes sa_register_snapshot() will accept.
+ */
+#define	SA_SNAP_MAX	8
+
 typedef enum sa_handle_type {
 	SA_HDL_SHARED,
 	SA_HDL_PRIVATE
@@ -139,6 +144,8 @@ dmu_buf_t *sa_get_db(sa_handle_t *);
 uint64_t sa_handle_object(sa_handle_t *);
 boolean_t sa_attr_would_spill(sa_handle_t *, sa_attr_type_t, int size);
 void sa_register_update_callback(objset_t *, sa_update_cb_t *);
+void sa_register_snapshot(objset_t *, const sa_attr_type_t *, int count);
+int sa_lookup_snapshot(sa_handle_t *, void *buf, uint32_t buflen);
 int sa_setup(objset_t *, uint64_t, sa_attr_reg_t *, int, sa_attr_type_t **);
 void sa_tear_down(objset_t *);
 int sa_replace_all_by_template(sa_handle_t *, sa_bulk_attr_t *,
@@ -112,6 +112,8 @@ typedef struct sa_idx_tab {
 	uint16_t	*sa_variable_lengths;
 	refcount_t	sa_refcount;
 	uint32_t	*sa_idx_tab;	/* array of offsets */
+	boolean_t	sa_snap_valid;	/* snapshot attrs are one run */
+	uint32_t	sa_snap_off;	/* offset of that run */
 } sa_idx_tab_t;
 
 /*
@@ -147,6 +149,9 @@ struct sa_os {
 	avl_tree_t	sa_layout_hash_tree; /* keyed by layout hash value */
 	int		sa_user_table_sz;
 	sa_attr_type_t	*sa_user_table; /* user name->attr mapping table */
+	int		sa_snap_count;	/* see sa_register_snapshot() */
+	uint32_t	sa_snap_len;
+	sa_attr_type_t	sa_snap_attrs[SA_SNAP_MAX];
 };
 
 /*
@@ -237,7 +242,7 @@ struct sa_handle {
 #define	SA_BONUSTYPE_FROM_DB(db) \
 	(dmu_get_bonustype((dmu_buf_t *)db))
 
-#define	SA_BLKPTR_SPACE	(DN_MAX_BONUSLEN - sizeof (blkptr_t))
+#define	SA_BLKPTR_SPACE(bonuslen)	((bonuslen) - sizeof (blkptr_t))
 
 #define	SA_LAYOUT_NUM(x, type) \
 	((!IS_SA_BONUSTYPE(type) ? 0 : (((IS_SA_BONUSTYPE(type)) && \
@@ -102,6 +102,16 @@ struct vdev_cache {
 	kmutex_t	vc_lock;
 };
 
+/*
+ * Which metaslab class a top-level vdev allocates from, other than the
+ * normal and log classes (see ZPOOL_CONFIG_ALLOCATION_BIAS).
+ */
+typedef enum vdev_alloc_bias {
+	VDEV_BIAS_NONE,
+	VDEV_BIAS_DEDUP,	/* dedicated to dedup table blocks */
+	VDEV_BIAS_SPECIAL	/* dedicated to metadata and small blocks */
+} vdev_alloc_bias_t;
+
 typedef struct vdev_queue_class {
 	uint32_t	vqc_active;
 
@@ -120,9 +130,24 @@ struct vdev_queue {
 	avl_tree_t	vq_write_offset_tree;
 	uint64_t	vq_last_offset;
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
+	hrtime_t	vq_read_lat;	/* decaying average read latency */
+	hrtime_t	vq_sync_read_lat; /* same, for sync reads only */
+	hrtime_t	vq_sync_read_ts; /* time last sync read completed */
+	hrtime_t	vq_scrub_adjust_ts; /* time scrub limit last changed */
+	uint32_t	vq_scrub_max_active; /* adaptive scrub max_active */
 	kmutex_t	vq_lock;
 };
 
+/*
+ * A log space map of a top-level vdev, holding the metaslab allocs and
+ * frees of one txg.
+ */
+typedef struct vdev_log_sm {
+	uint64_t	vls_txg;
+	uint64_t	vls_object;
+	avl_node_t	vls_node;
+} vdev_log_sm_t;
+
 /*
  * Virtual device descriptor
  */
@@ -150,10 +175,12 @@ struct vdev {
 	vdev_t		**vdev_child;	/* array of children		*/
 	uint64_t	vdev_children;	/* number of children		*/
 	vdev_stat_t	vdev_stat;	/* virtual device statistics	*/
+	vdev_stat_ex_t	vdev_stat_ex;	/* leaf latency/size histograms	*/
 	boolean_t	vdev_expanding;	/* expand the vdev?		*/
 	boolean_t	vdev_reopening;	/* reopen in progress?		*/
 	int		vdev_open_error; /* error on last open		*/
 	kthread_t	*vdev_open_thread; /* thread opening children	*/
+	boolean_t	vdev_load_failed; /* vdev_load() failed	*/
 	uint64_t	vdev_crtxg;	/* txg when top-level was added */
 
 	/*
@@ -173,11 +200,25 @@ struct vdev {
 	list_node_t	vdev_state_dirty_node; /* state dirty list	*/
 	uint64_t	vdev_deflate_ratio; /* deflation ratio (x512)	*/
 	uint64_t	vdev_islog;	/* is an intent log device	*/
+	vdev_alloc_bias_t vdev_alloc_bias; /* metaslab class bias	*/
 	uint64_t	vdev_removing;	/* device is being removed?	*/
 	boolean_t	vdev_ishole;	/* is a hole in the namespace	*/
 	kmutex_t	vdev_queue_lock; /* protects vdev_queue_depth	*/
 	uint64_t	vdev_top_zap;
 
+	/*
+	 * Log space map state (see "Log space maps" in metaslab.c).
+	 * vdev_log_sms and vdev_unflushed_ms are protected by vdev_log_lock;
+	 * the rest is only used in syncing context.
+	 */
+	uint64_t	vdev_log_zap;	/* txg -> log space map object	*/
+	uint64_t	vdev_ms_flushed_array; /* per-metaslab flushed txg */
+	avl_tree_t	vdev_log_sms;	/* vdev_log_sm_t, by txg	*/
+	avl_tree_t	vdev_unflushed_ms; /* metaslabs, by flushed txg	*/
+	space_map_t	*vdev_log_sm;	/* log for the syncing txg	*/
+	uint64_t	vdev_log_sm_txg; /* txg of vdev_log_sm		*/
+	uint64_t	vdev_log_flush_txg; /* last txg we flushed in	*/
+
 	/*
 	 * The queue depth parameters determine how many async writes are
 	 * still pending (i.e. allocated by net yet issued to disk) per
@@ -210,6 +251,7 @@ struct vdev {
 	uint64_t	vdev_not_present; /* not present during import	*/
 	uint64_t	vdev_unspare;	/* unspare when resilvering done */
 	boolean_t	vdev_nowritecache; /* true if flushwritecache failed */
+	boolean_t	vdev_notrim;	/* true if DKIOCFREE isn't supported */
 	boolean_t	vdev_checkremove; /* temporary online test	*/
 	boolean_t	vdev_forcefault; /* force online fault		*/
 	boolean_t	vdev_splitting;	/* split or repair in progress  */
@@ -220,12 +262,16 @@ struct vdev {
 	boolean_t	vdev_cant_write; /* vdev is failing all writes	*/
 	boolean_t	vdev_isspare;	/* was a hot spare		*/
 	boolean_t	vdev_isl2cache;	/* was a l2cache device		*/
+	boolean_t	vdev_nonrot;	/* non-rotational (solid state)	*/
 	vdev_queue_t	vdev_queue;	/* I/O deadline schedule queue	*/
 	vdev_cache_t	vdev_cache;	/* physical block cache		*/
 	spa_aux_vdev_t	*vdev_aux;	/* for l2cache and spares vdevs	*/
 	zio_t		*vdev_probe_zio; /* root of current probe	*/
 	vdev_aux_t	vdev_label_aux;	/* on-disk aux state		*/
 	uint64_t	vdev_leaf_zap;
+	hrtime_t	vdev_ereport_start; /* start of ereport interval */
+	uint32_t	vdev_ereport_count; /* ereports posted in interval */
+	uint64_t	vdev_ereport_suppressed; /* ereports not posted */
 
 	/*
 	 * For DTrace to work in userland (libzpool) context, these fields must
@@ -235,8 +281,9 @@ struct vdev {
 	 * incorrect.
 	 */
 	kmutex_t	vdev_dtl_lock;	/* vdev_dtl_{map,resilver}	*/
-	kmutex_t	vdev_stat_lock;	/* vdev_stat			*/
+	kmutex_t	vdev_stat_lock;	/* vdev_stat, vdev_stat_ex	*/
 	kmutex_t	vdev_probe_lock; /* protects vdev_probe_zio	*/
+	kmutex_t	vdev_log_lock;	/* vdev_log_sms, unflushed_ms	*/
 };
 
 #define	VDEV_RAIDZ_MAXPARITY	3
@@ -276,6 +323,12 @@ typedef struct vdev_label {
 #define	VDD_METASLAB	0x01
 #define	VDD_DTL		0x02
 
+/*
+ * Entries of a top-level vdev's ZAP.
+ */
+#define	VDEV_TOP_ZAP_LOG_SPACEMAP	"org.illumos:log_spacemap_zap"
+#define	VDEV_TOP_ZAP_MS_FLUSHED_TXGS	"org.illumos:ms_flushed_txgs"
+
 /* Offset of embedded boot loader region on each label */
 #define	VDEV_BOOT_OFFSET	(2 * sizeof (vdev_label_t))
 /*
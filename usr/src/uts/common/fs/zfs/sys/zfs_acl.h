@@ -157,6 +157,21 @@ typedef struct zfs_acl_node {
 	int		z_ace_idx;	/* ace iterator positioned on */
 } zfs_acl_node_t;
 
+/*
+ * What an ACL grants one credential: the bits the first matching ACE
+ * for each of them allows or denies, worked out against the file owner
+ * and group recorded alongside.  See zfs_zaccess_aces_check().
+ */
+typedef struct zfs_acl_access {
+	struct cred	*za_cred;	/* private copy of the credential */
+	uint64_t	za_fowner;	/* z_uid it was evaluated against */
+	uint64_t	za_gowner;	/* z_gid it was evaluated against */
+	uint32_t	za_allow;	/* bits allowed */
+	uint32_t	za_deny;	/* bits denied */
+} zfs_acl_access_t;
+
+#define	ZFS_ACL_ACCESS_SLOTS	4
+
 typedef struct zfs_acl {
 	uint64_t	z_acl_count;	/* Number of ACEs */
 	size_t		z_acl_bytes;	/* Number of bytes in ACL */
@@ -166,6 +181,8 @@ typedef struct zfs_acl {
 	zfs_acl_node_t	*z_curr_node;	/* current node iterator is handling */
 	list_t		z_acl;		/* chunks of ACE data */
 	acl_ops_t	z_ops;		/* ACL operations */
+	zfs_acl_access_t z_access[ZFS_ACL_ACCESS_SLOTS]; /* evaluations */
+	int		z_access_next;	/* slot to replace next */
 } zfs_acl_t;
 
 typedef struct acl_locator_cb {
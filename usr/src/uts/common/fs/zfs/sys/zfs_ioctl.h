@@ -91,6 +91,9 @@ typedef enum drr_headertype {
 /* flag #18 is reserved for a Delphix feature */
 #define	DMU_BACKUP_FEATURE_LARGE_BLOCKS		(1 << 19)
 #define	DMU_BACKUP_FEATURE_RESUMING		(1 << 20)
+#define	DMU_BACKUP_FEATURE_COMPRESSED		(1 << 21)
+#define	DMU_BACKUP_FEATURE_LZ4			(1 << 22)
+#define	DMU_BACKUP_FEATURE_LARGE_DNODE		(1 << 24)
 
 /*
  * Mask of all supported backup features
@@ -99,7 +102,9 @@ typedef enum drr_headertype {
     DMU_BACKUP_FEATURE_DEDUPPROPS | DMU_BACKUP_FEATURE_SA_SPILL | \
     DMU_BACKUP_FEATURE_EMBED_DATA | DMU_BACKUP_FEATURE_EMBED_DATA_LZ4 | \
     DMU_BACKUP_FEATURE_RESUMING | \
-    DMU_BACKUP_FEATURE_LARGE_BLOCKS)
+    DMU_BACKUP_FEATURE_LARGE_BLOCKS | \
+    DMU_BACKUP_FEATURE_COMPRESSED | DMU_BACKUP_FEATURE_LZ4 | \
+    DMU_BACKUP_FEATURE_LARGE_DNODE)
 
 /* Are all features in the given flag word currently supported? */
 #define	DMU_STREAM_SUPPORTED(x)	(!((x) & ~DMU_BACKUP_FEATURE_MASK))
@@ -152,6 +157,15 @@ typedef enum dmu_send_resume_token_version {
 
 #define	DRR_IS_DEDUP_CAPABLE(flags)	((flags) & DRR_CHECKSUM_DEDUP)
 
+/*
+ * A DRR_WRITE record of a compressed stream may carry the block exactly as
+ * it is stored on disk, i.e. compressed with drr_compressiontype.
+ */
+#define	DRR_WRITE_COMPRESSED(drrw)	((drrw)->drr_compressiontype != 0)
+#define	DRR_WRITE_PAYLOAD_SIZE(drrw) \
+	(DRR_WRITE_COMPRESSED(drrw) ? (drrw)->drr_compressed_size : \
+	(drrw)->drr_length)
+
 /*
  * zfs ioctl command structure
  */
@@ -185,7 +199,8 @@ typedef struct dmu_replay_record {
 			uint32_t drr_bonuslen;
 			uint8_t drr_checksumtype;
 			uint8_t drr_compress;
-			uint8_t drr_pad[6];
+			uint8_t drr_dn_slots;	/* 0 for a minimum size dnode */
+			uint8_t drr_pad[5];
 			uint64_t drr_toguid;
 			/* bonus content follows */
 		} drr_object;
@@ -199,13 +214,16 @@ typedef struct dmu_replay_record {
 			dmu_object_type_t drr_type;
 			uint32_t drr_pad;
 			uint64_t drr_offset;
-			uint64_t drr_length;
+			uint64_t drr_length;	/* logical length */
 			uint64_t drr_toguid;
 			uint8_t drr_checksumtype;
 			uint8_t drr_checksumflags;
-			uint8_t drr_pad2[6];
+			uint8_t drr_compressiontype;
+			uint8_t drr_pad2[5];
 			ddt_key_t drr_key; /* deduplication key */
-			/* content follows */
+			/* size of payload if drr_compressiontype is set */
+			uint64_t drr_compressed_size;
+			/* (possibly compressed) content follows */
 		} drr_write;
 		struct drr_free {
 			uint64_t drr_object;
@@ -284,6 +302,13 @@ typedef struct dmu_diff_record {
 	uint64_t ddr_last;
 } dmu_diff_record_t;
 
+/*
+ * zc_flags for ZFS_IOC_OBJ_TO_STATS: return only the object's name in
+ * its parent directory, and the parent's object number in zc_cookie,
+ * rather than its whole path.
+ */
+#define	ZFS_OBJ_STATS_NAME	0x1
+
 typedef struct zinject_record {
 	uint64_t	zi_objset;
 	uint64_t	zi_object;
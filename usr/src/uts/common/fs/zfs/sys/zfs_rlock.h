@@ -52,8 +52,29 @@ typedef struct rl {
 	uint8_t r_proxy;	/* acting for original range */
 	uint8_t r_write_wanted;	/* writer wants to lock this range */
 	uint8_t r_read_wanted;	/* reader wants to lock this range */
+	uint8_t r_shard;	/* shard whose tree this lock is in */
+	uint8_t r_multi;	/* handle for the parts in r_next */
+	struct rl *r_next;	/* next shard's part of a multi-shard lock */
 } rl_t;
 
+/*
+ * The range lock shards of a large file beyond the znode's own
+ * z_range_lock and z_range_avl, which are shard 0.
+ */
+typedef struct rl_shard {
+	kmutex_t rs_lock;	/* protects changes to rs_avl */
+	avl_tree_t rs_avl;	/* avl tree of file range locks */
+} rl_shard_t;
+
+typedef struct rl_shards {
+	uint_t rls_count;	/* shards, including the znode's own */
+	uint_t rls_shift;	/* log2 of bytes per region */
+	rl_shard_t rls_shard[1];	/* shards 1 .. rls_count - 1 */
+} rl_shards_t;
+
+#define	RL_SHARDS_SIZE(count)	\
+	(sizeof (rl_shards_t) + ((count) - 2) * sizeof (rl_shard_t))
+
 /*
  * Lock a range (offset, length) as either shared (RL_READER)
  * or exclusive (RL_WRITER or RL_APPEND).  RL_APPEND is a special type that
@@ -77,6 +98,9 @@ void zfs_range_reduce(rl_t *rl, uint64_t off, uint64_t len);
  */
 int zfs_range_compare(const void *arg1, const void *arg2);
 
+/* Free the range lock shards of a znode with no ranges locked. */
+void zfs_range_free_shards(znode_t *zp);
+
 #endif /* _KERNEL */
 
 #ifdef	__cplusplus
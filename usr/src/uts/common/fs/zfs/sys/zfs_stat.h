@@ -48,6 +48,8 @@ typedef struct zfs_stat {
 
 extern int zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
     char *buf, int len);
+extern int zfs_obj_to_name(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
+    uint64_t *pobjp, char *buf, int len);
 
 #ifdef	__cplusplus
 }
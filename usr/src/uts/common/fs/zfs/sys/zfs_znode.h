@@ -177,6 +177,7 @@ typedef struct znode {
 	zfs_dirlock_t	*z_dirlocks;	/* directory entry lock list */
 	kmutex_t	z_range_lock;	/* protects changes to z_range_avl */
 	avl_tree_t	z_range_avl;	/* avl tree of file range locks */
+	struct rl_shards *z_range_shards; /* more range locks, large files */
 	uint8_t		z_unlinked;	/* file has been unlinked */
 	uint8_t		z_atime_dirty;	/* atime needs to be synced */
 	uint8_t		z_zn_prefetch;	/* Prefetch znodes? */
@@ -200,6 +201,15 @@ typedef struct znode {
 	boolean_t	z_is_sa;	/* are we native sa? */
 } znode_t;
 
+/*
+ * The on-disk attributes stat(2) needs that the znode doesn't cache,
+ * read together by zfs_stat_snapshot().
+ */
+typedef struct zfs_stat_snap {
+	uint64_t	zss_mtime[2];
+	uint64_t	zss_ctime[2];
+} zfs_stat_snap_t;
+
 
 /*
  * Range locking rules
@@ -303,6 +313,9 @@ extern dev_t	zfs_cmpldev(uint64_t);
 extern int	zfs_get_zplprop(objset_t *os, zfs_prop_t prop, uint64_t *value);
 extern int	zfs_get_stats(objset_t *os, nvlist_t *nv);
 extern void	zfs_znode_dmu_fini(znode_t *);
+extern void	zfs_znode_dnlcsearch(znode_t *);
+extern void	zfs_stat_snapshot_init(zfsvfs_t *);
+extern int	zfs_stat_snapshot(znode_t *, zfs_stat_snap_t *);
 
 extern void zfs_log_create(zilog_t *zilog, dmu_tx_t *tx, uint64_t txtype,
     znode_t *dzp, znode_t *zp, char *name, vsecattr_t *, zfs_fuid_info_t *,
@@ -107,7 +107,7 @@ struct zilog {
 	uint8_t		zl_keep_first;	/* keep first log block in destroy */
 	uint8_t		zl_replay;	/* replaying records while set */
 	uint8_t		zl_stop_sync;	/* for debugging */
-	uint8_t		zl_writer;	/* boolean: write setup in progress */
+	uint8_t		zl_writer;	/* boolean: lwb issue in progress */
 	uint8_t		zl_logbias;	/* latency or throughput */
 	uint8_t		zl_sync;	/* synchronous or asynchronous */
 	int		zl_parse_error;	/* last zil_parse() error */
@@ -117,6 +117,7 @@ struct zilog {
 	uint64_t	zl_parse_lr_count; /* number of log records parsed */
 	uint64_t	zl_next_batch;	/* next batch number */
 	uint64_t	zl_com_batch;	/* committed batch number */
+	uint64_t	zl_sync_batch;	/* batches below this must txg sync */
 	kcondvar_t	zl_cv_batch[2];	/* batch condition variables */
 	itxg_t		zl_itxg[TXG_SIZE]; /* intent log txg chains */
 	list_t		zl_itx_commit_list; /* itx list to be committed */
@@ -18,23 +18,10 @@
 #ifndef	_ZIO_PRIORITY_H
 #define	_ZIO_PRIORITY_H
 
-#ifdef	__cplusplus
-extern "C" {
-#endif
-
-typedef enum zio_priority {
-	ZIO_PRIORITY_SYNC_READ,
-	ZIO_PRIORITY_SYNC_WRITE,	/* ZIL */
-	ZIO_PRIORITY_ASYNC_READ,	/* prefetch */
-	ZIO_PRIORITY_ASYNC_WRITE,	/* spa_sync() */
-	ZIO_PRIORITY_SCRUB,		/* asynchronous scrub/resilver reads */
-	ZIO_PRIORITY_NUM_QUEUEABLE,
-
-	ZIO_PRIORITY_NOW		/* non-queued i/os (e.g. free) */
-} zio_priority_t;
-
-#ifdef	__cplusplus
-}
-#endif
+/*
+ * zio_priority_t is shared with userland, which needs it to interpret the
+ * extended vdev statistics, so it is defined in <sys/fs/zfs.h>.
+ */
+#include <sys/fs/zfs.h>
 
 #endif	/* _ZIO_PRIORITY_H */
@@ -66,6 +66,8 @@ extern uint64_t zvol_get_volume_size(void *minor_hdl);
 extern int zvol_get_volume_wce(void *minor_hdl);
 extern void zvol_log_write_minor(void *minor_hdl, dmu_tx_t *tx, offset_t off,
     ssize_t resid, boolean_t sync);
+extern int zvol_free_minor(void *minor_hdl, uint64_t off, uint64_t len);
+extern void zvol_free_sync_minor(void *minor_hdl, boolean_t wait_sync);
 
 #endif
 
@@ -44,6 +44,7 @@
 #include <sys/arc.h>
 #include <sys/zil.h>
 #include <sys/dsl_scan.h>
+#include <sys/zfeature.h>
 
 /*
  * Virtual device management.
@@ -71,6 +72,12 @@ int zfs_scrub_limit = 10;
  */
 int metaslabs_per_vdev = 200;
 
+/*
+ * Load the metaslabs and DTLs of each top-level vdev on its own thread
+ * when opening a pool.
+ */
+boolean_t vdev_load_parallel = B_TRUE;
+
 /*
  * Given a vdev type, return the appropriate ops vector.
  */
@@ -348,6 +355,11 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	mutex_init(&vd->vdev_stat_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_probe_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_queue_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&vd->vdev_log_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&vd->vdev_log_sms, metaslab_log_sm_compare,
+	    sizeof (vdev_log_sm_t), offsetof(vdev_log_sm_t, vls_node));
+	avl_create(&vd->vdev_unflushed_ms, metaslab_unflushed_compare,
+	    sizeof (metaslab_t), offsetof(metaslab_t, ms_unflushed_node));
 	for (int t = 0; t < DTL_TYPES; t++) {
 		vd->vdev_dtl[t] = range_tree_create(NULL, NULL,
 		    &vd->vdev_dtl_lock);
@@ -374,7 +386,9 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 {
 	vdev_ops_t *ops;
 	char *type;
+	char *bias_str;
 	uint64_t guid = 0, islog, nparity;
+	vdev_alloc_bias_t bias;
 	vdev_t *vd;
 
 	ASSERT(spa_config_held(spa, SCL_ALL, RW_WRITER) == SCL_ALL);
@@ -426,6 +440,31 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 	if (ops == &vdev_hole_ops && spa_version(spa) < SPA_VERSION_HOLES)
 		return (SET_ERROR(ENOTSUP));
 
+	/*
+	 * Determine whether a top-level vdev is dedicated to a particular
+	 * allocation class.  Outside of pool creation (where the feature is
+	 * checked by spa_create()) and pool load, adding such a vdev requires
+	 * the allocation_classes feature.
+	 */
+	bias = VDEV_BIAS_NONE;
+	if (!islog && parent != NULL && parent->vdev_parent == NULL &&
+	    nvlist_lookup_string(nv, ZPOOL_CONFIG_ALLOCATION_BIAS,
+	    &bias_str) == 0) {
+		if (strcmp(bias_str, VDEV_ALLOC_BIAS_DEDUP) == 0)
+			bias = VDEV_BIAS_DEDUP;
+		else if (strcmp(bias_str, VDEV_ALLOC_BIAS_SPECIAL) == 0)
+			bias = VDEV_BIAS_SPECIAL;
+		else
+			return (SET_ERROR(EINVAL));
+
+		if (alloctype != VDEV_ALLOC_LOAD &&
+		    alloctype != VDEV_ALLOC_SPLIT &&
+		    spa->spa_load_state != SPA_LOAD_CREATE &&
+		    !spa_feature_is_enabled(spa,
+		    SPA_FEATURE_ALLOCATION_CLASSES))
+			return (SET_ERROR(ENOTSUP));
+	}
+
 	/*
 	 * Set the nparity property for RAID-Z vdevs.
 	 */
@@ -465,6 +504,7 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 	vd = vdev_alloc_common(spa, id, guid, ops);
 
 	vd->vdev_islog = islog;
+	vd->vdev_alloc_bias = bias;
 	vd->vdev_nparity = nparity;
 
 	if (nvlist_lookup_string(nv, ZPOOL_CONFIG_PATH, &vd->vdev_path) == 0)
@@ -527,8 +567,18 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 		    alloctype == VDEV_ALLOC_ADD ||
 		    alloctype == VDEV_ALLOC_SPLIT ||
 		    alloctype == VDEV_ALLOC_ROOTPOOL);
-		vd->vdev_mg = metaslab_group_create(islog ?
-		    spa_log_class(spa) : spa_normal_class(spa), vd);
+		metaslab_class_t *mc;
+
+		if (islog)
+			mc = spa_log_class(spa);
+		else if (bias == VDEV_BIAS_DEDUP)
+			mc = spa_dedup_class(spa);
+		else if (bias == VDEV_BIAS_SPECIAL)
+			mc = spa_special_class(spa);
+		else
+			mc = spa_normal_class(spa);
+
+		vd->vdev_mg = metaslab_group_create(mc, vd);
 	}
 
 	if (vd->vdev_ops->vdev_op_leaf &&
@@ -681,6 +731,9 @@ vdev_free(vdev_t *vd)
 	mutex_destroy(&vd->vdev_dtl_lock);
 	mutex_destroy(&vd->vdev_stat_lock);
 	mutex_destroy(&vd->vdev_probe_lock);
+	avl_destroy(&vd->vdev_log_sms);
+	avl_destroy(&vd->vdev_unflushed_ms);
+	mutex_destroy(&vd->vdev_log_lock);
 
 	if (vd == spa->spa_root_vdev)
 		spa->spa_root_vdev = NULL;
@@ -705,11 +758,25 @@ vdev_top_transfer(vdev_t *svd, vdev_t *tvd)
 	tvd->vdev_ms_shift = svd->vdev_ms_shift;
 	tvd->vdev_ms_count = svd->vdev_ms_count;
 	tvd->vdev_top_zap = svd->vdev_top_zap;
+	tvd->vdev_log_zap = svd->vdev_log_zap;
+	tvd->vdev_ms_flushed_array = svd->vdev_ms_flushed_array;
+	tvd->vdev_log_flush_txg = svd->vdev_log_flush_txg;
 
 	svd->vdev_ms_array = 0;
 	svd->vdev_ms_shift = 0;
 	svd->vdev_ms_count = 0;
 	svd->vdev_top_zap = 0;
+	svd->vdev_log_zap = 0;
+	svd->vdev_ms_flushed_array = 0;
+	svd->vdev_log_flush_txg = 0;
+
+	ASSERT3P(svd->vdev_log_sm, ==, NULL);
+	mutex_enter(&svd->vdev_log_lock);
+	mutex_enter(&tvd->vdev_log_lock);
+	avl_swap(&tvd->vdev_log_sms, &svd->vdev_log_sms);
+	avl_swap(&tvd->vdev_unflushed_ms, &svd->vdev_unflushed_ms);
+	mutex_exit(&tvd->vdev_log_lock);
+	mutex_exit(&svd->vdev_log_lock);
 
 	if (tvd->vdev_mg)
 		ASSERT3P(tvd->vdev_mg, ==, svd->vdev_mg);
@@ -754,6 +821,9 @@ vdev_top_transfer(vdev_t *svd, vdev_t *tvd)
 
 	tvd->vdev_islog = svd->vdev_islog;
 	svd->vdev_islog = 0;
+
+	tvd->vdev_alloc_bias = svd->vdev_alloc_bias;
+	svd->vdev_alloc_bias = VDEV_BIAS_NONE;
 }
 
 static void
@@ -852,8 +922,9 @@ vdev_metaslab_init(vdev_t *vd, uint64_t txg)
 	uint64_t m;
 	uint64_t oldc = vd->vdev_ms_count;
 	uint64_t newc = vd->vdev_asize >> vd->vdev_ms_shift;
+	uint64_t *objects;
 	metaslab_t **mspp;
-	int error;
+	int error = 0;
 
 	ASSERT(txg == 0 || spa_config_held(spa, SCL_ALLOC, RW_WRITER));
 
@@ -886,19 +957,38 @@ vdev_metaslab_init(vdev_t *vd, uint64_t txg)
 	vd->vdev_ms = mspp;
 	vd->vdev_ms_count = newc;
 
-	for (m = oldc; m < newc; m++) {
-		uint64_t object = 0;
-
-		if (txg == 0) {
-			error = dmu_read(mos, vd->vdev_ms_array,
-			    m * sizeof (uint64_t), sizeof (uint64_t), &object,
-			    DMU_READ_PREFETCH);
-			if (error)
-				return (error);
+	/*
+	 * When opening an existing pool, read the whole metaslab array at
+	 * once and prefetch the dnodes of the space maps it names, so that
+	 * metaslab_init() doesn't wait on each of them in turn.
+	 */
+	objects = kmem_zalloc((newc - oldc) * sizeof (uint64_t), KM_SLEEP);
+	if (txg == 0) {
+		error = dmu_read(mos, vd->vdev_ms_array,
+		    oldc * sizeof (uint64_t), (newc - oldc) * sizeof (uint64_t),
+		    objects, DMU_READ_PREFETCH);
+		if (error) {
+			kmem_free(objects, (newc - oldc) * sizeof (uint64_t));
+			return (error);
+		}
+		for (m = oldc; m < newc; m++) {
+			dmu_prefetch(mos, objects[m - oldc], 0, 0, 0,
+			    ZIO_PRIORITY_SYNC_READ);
 		}
+	}
 
-		error = metaslab_init(vd->vdev_mg, m, object, txg,
+	for (m = oldc; m < newc; m++) {
+		error = metaslab_init(vd->vdev_mg, m, objects[m - oldc], txg,
 		    &(vd->vdev_ms[m]));
+		if (error)
+			break;
+	}
+	kmem_free(objects, (newc - oldc) * sizeof (uint64_t));
+	if (error)
+		return (error);
+
+	if (txg == 0 && oldc == 0) {
+		error = metaslab_log_load(vd);
 		if (error)
 			return (error);
 	}
@@ -936,6 +1026,7 @@ vdev_metaslab_fini(vdev_t *vd)
 		}
 		kmem_free(vd->vdev_ms, count * sizeof (metaslab_t *));
 		vd->vdev_ms = NULL;
+		metaslab_log_fini(vd);
 	}
 }
 
@@ -1740,7 +1831,7 @@ vdev_dtl_min(vdev_t *vd)
 	ASSERT3U(range_tree_space(vd->vdev_dtl[DTL_MISSING]), !=, 0);
 	ASSERT0(vd->vdev_children);
 
-	rs = avl_first(&vd->vdev_dtl[DTL_MISSING]->rt_root);
+	rs = zfs_btree_first(&vd->vdev_dtl[DTL_MISSING]->rt_root, NULL);
 	return (rs->rs_start - 1);
 }
 
@@ -1756,7 +1847,7 @@ vdev_dtl_max(vdev_t *vd)
 	ASSERT3U(range_tree_space(vd->vdev_dtl[DTL_MISSING]), !=, 0);
 	ASSERT0(vd->vdev_children);
 
-	rs = avl_last(&vd->vdev_dtl[DTL_MISSING]->rt_root);
+	rs = zfs_btree_last(&vd->vdev_dtl[DTL_MISSING]->rt_root, NULL);
 	return (rs->rs_end);
 }
 
@@ -1987,6 +2078,10 @@ vdev_construct_zaps(vdev_t *vd, dmu_tx_t *tx)
 		}
 		if (vd == vd->vdev_top && vd->vdev_top_zap == 0) {
 			vd->vdev_top_zap = vdev_create_link_zap(vd, tx);
+			if (vd->vdev_alloc_bias != VDEV_BIAS_NONE) {
+				spa_feature_incr(vd->vdev_spa,
+				    SPA_FEATURE_ALLOCATION_CLASSES, tx);
+			}
 		}
 	}
 	for (uint64_t i = 0; i < vd->vdev_children; i++) {
@@ -2154,14 +2249,19 @@ vdev_resilver_needed(vdev_t *vd, uint64_t *minp, uint64_t *maxp)
 	return (needed);
 }
 
-void
-vdev_load(vdev_t *vd)
+/*
+ * Initialize the metaslabs of any top-level vdev, and load the DTL of any
+ * leaf vdev, under 'vd'.  Failures are noted in vdev_load_failed for
+ * vdev_load() to act on, as this may run in parallel with the same work on
+ * other top-level vdevs.
+ */
+static void
+vdev_load_subtree(vdev_t *vd)
 {
-	/*
-	 * Recursively load all children.
-	 */
+	vd->vdev_load_failed = B_FALSE;
+
 	for (int c = 0; c < vd->vdev_children; c++)
-		vdev_load(vd->vdev_child[c]);
+		vdev_load_subtree(vd->vdev_child[c]);
 
 	/*
 	 * If this is a top-level vdev, initialize its metaslabs.
@@ -2169,17 +2269,64 @@ vdev_load(vdev_t *vd)
 	if (vd == vd->vdev_top && !vd->vdev_ishole &&
 	    (vd->vdev_ashift == 0 || vd->vdev_asize == 0 ||
 	    vdev_metaslab_init(vd, 0) != 0))
-		vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
-		    VDEV_AUX_CORRUPT_DATA);
+		vd->vdev_load_failed = B_TRUE;
 
 	/*
 	 * If this is a leaf vdev, load its DTL.
 	 */
 	if (vd->vdev_ops->vdev_op_leaf && vdev_dtl_load(vd) != 0)
+		vd->vdev_load_failed = B_TRUE;
+}
+
+static void
+vdev_load_child(void *arg)
+{
+	vdev_load_subtree(arg);
+}
+
+static void
+vdev_load_set_state(vdev_t *vd)
+{
+	for (int c = 0; c < vd->vdev_children; c++)
+		vdev_load_set_state(vd->vdev_child[c]);
+
+	if (vd->vdev_load_failed)
 		vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
 		    VDEV_AUX_CORRUPT_DATA);
 }
 
+void
+vdev_load(vdev_t *vd)
+{
+	int children = vd->vdev_children;
+	taskq_t *tq;
+
+	/*
+	 * The only state that loading top-level vdevs shares is the metaslab
+	 * class histogram, which is protected by mc_lock, so load them in
+	 * parallel; on a large pool this is most of the time an import takes.  As in vdev_open_children(), pools on top
+	 * of zvols are done in a single thread.
+	 */
+	if (vd != vd->vdev_spa->spa_root_vdev || children < 2 ||
+	    !vdev_load_parallel || vdev_uses_zvols(vd)) {
+		vdev_load_subtree(vd);
+	} else {
+		vd->vdev_load_failed = B_FALSE;
+		tq = taskq_create("vdev_load", children, minclsyspri,
+		    children, children, TASKQ_PREPOPULATE);
+		for (int c = 0; c < children; c++)
+			VERIFY(taskq_dispatch(tq, vdev_load_child,
+			    vd->vdev_child[c], TQ_SLEEP) != NULL);
+		taskq_destroy(tq);
+	}
+
+	/*
+	 * Changing a vdev's state updates its parents', so that is done
+	 * here, in one thread.
+	 */
+	vdev_load_set_state(vd);
+}
+
 /*
  * The special vdev case is used for hot spares and l2cache devices.  Its
  * sole purpose it to set the vdev state for the associated vdev.  To do this,
@@ -2255,7 +2402,7 @@ vdev_remove(vdev_t *vd, uint64_t txg)
 			 */
 			metaslab_group_histogram_remove(mg, msp);
 
-			VERIFY0(space_map_allocated(msp->ms_sm));
+			VERIFY0(metaslab_allocated_space(msp));
 			space_map_free(msp->ms_sm, tx);
 			space_map_close(msp->ms_sm);
 			msp->ms_sm = NULL;
@@ -2267,6 +2414,7 @@ vdev_remove(vdev_t *vd, uint64_t txg)
 		for (int i = 0; i < RANGE_TREE_HISTOGRAM_SIZE; i++)
 			ASSERT0(mg->mg_histogram[i]);
 
+		metaslab_log_destroy(vd, tx);
 	}
 
 	if (vd->vdev_ms_array) {
@@ -2294,6 +2442,8 @@ vdev_sync_done(vdev_t *vd, uint64_t txg)
 
 	if (reassess)
 		metaslab_sync_reassess(vd->vdev_mg);
+
+	metaslab_log_sync_done(vd, txg);
 }
 
 void
@@ -2322,6 +2472,11 @@ vdev_sync(vdev_t *vd, uint64_t txg)
 	if (vd->vdev_stat.vs_alloc == 0 && vd->vdev_removing)
 		vdev_remove(vd, txg);
 
+	/*
+	 * Flush metaslabs from the log space maps before any of them sync.
+	 */
+	metaslab_log_sync(vd, txg);
+
 	while ((msp = txg_list_remove(&vd->vdev_ms_list, txg)) != NULL) {
 		metaslab_sync(msp, txg);
 		(void) txg_list_add(&vd->vdev_ms_list, msp, TXG_CLEAN(txg));
@@ -2727,6 +2882,61 @@ vdev_accessible(vdev_t *vd, zio_t *zio)
 	return (B_TRUE);
 }
 
+/*
+ * Map a latency (in nanoseconds) or a request size (in bytes) to its
+ * power-of-two histogram bucket; see vdev_stat_ex_t.
+ */
+static int
+vdev_histo_bucket(uint64_t value, int nbuckets)
+{
+	int b = (value == 0) ? 0 : highbit64(value) - 1;
+
+	return (MIN(b, nbuckets - 1));
+}
+
+/*
+ * Add the extended statistics of all leaf vdevs under vd to vsx.  Leaves
+ * keep only the histograms; the queue depths are sampled here.
+ */
+static void
+vdev_get_stats_ex_impl(vdev_t *vd, vdev_stat_ex_t *vsx)
+{
+	if (!vd->vdev_ops->vdev_op_leaf) {
+		for (int c = 0; c < vd->vdev_children; c++)
+			vdev_get_stats_ex_impl(vd->vdev_child[c], vsx);
+		return;
+	}
+
+	uint64_t *src = (uint64_t *)&vd->vdev_stat_ex;
+	uint64_t *dst = (uint64_t *)vsx;
+
+	mutex_enter(&vd->vdev_stat_lock);
+	for (int i = 0; i < sizeof (vdev_stat_ex_t) / sizeof (uint64_t); i++)
+		dst[i] += src[i];
+	mutex_exit(&vd->vdev_stat_lock);
+
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	mutex_enter(&vq->vq_lock);
+	for (int p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		vsx->vsx_active_queue[p] += vq->vq_class[p].vqc_active;
+		vsx->vsx_pend_queue[p] +=
+		    avl_numnodes(&vq->vq_class[p].vqc_queued_tree);
+	}
+	mutex_exit(&vq->vq_lock);
+}
+
+void
+vdev_get_stats_ex(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
+{
+	vdev_get_stats(vd, vs);
+
+	if (vsx != NULL) {
+		bzero(vsx, sizeof (*vsx));
+		vdev_get_stats_ex_impl(vd, vsx);
+	}
+}
+
 /*
  * Get statistics for the given vdev.
  */
@@ -2863,6 +3073,35 @@ vdev_stat_update(zio_t *zio, uint64_t psize)
 		vs->vs_ops[type]++;
 		vs->vs_bytes[type] += psize;
 
+		/*
+		 * Leaf vdevs also keep request size and latency histograms.
+		 * I/Os that were aggregated into a larger one were bypassed
+		 * above; the aggregate is counted here as a delegated I/O.
+		 */
+		if (vd->vdev_ops->vdev_op_leaf &&
+		    (type == ZIO_TYPE_READ || type == ZIO_TYPE_WRITE) &&
+		    zio->io_priority < ZIO_PRIORITY_NUM_QUEUEABLE) {
+			vdev_stat_ex_t *vsx = &vd->vdev_stat_ex;
+			zio_priority_t p = zio->io_priority;
+			int rq = vdev_histo_bucket(zio->io_size,
+			    VDEV_RQ_HISTO_BUCKETS);
+
+			if (flags & ZIO_FLAG_DELEGATED)
+				vsx->vsx_agg_histo[p][rq]++;
+			else
+				vsx->vsx_ind_histo[p][rq]++;
+
+			if (zio->io_delay != 0) {
+				vsx->vsx_queue_histo[p][vdev_histo_bucket(
+				    zio->io_delta, VDEV_L_HISTO_BUCKETS)]++;
+				vsx->vsx_disk_histo[type][vdev_histo_bucket(
+				    zio->io_delay, VDEV_L_HISTO_BUCKETS)]++;
+				vsx->vsx_total_histo[type][vdev_histo_bucket(
+				    zio->io_delta + zio->io_delay,
+				    VDEV_L_HISTO_BUCKETS)]++;
+			}
+		}
+
 		mutex_exit(&vd->vdev_stat_lock);
 		return;
 	}
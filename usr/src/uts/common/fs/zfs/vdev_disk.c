@@ -521,6 +521,16 @@ skip_open:
 
 	*ashift = highbit64(MAX(pbsize, SPA_MINBLOCKSIZE)) - 1;
 
+	/*
+	 * Find out whether the device is solid state, for the mirror read
+	 * selection logic.  If the ioctl isn't supported, assume it spins.
+	 */
+	int nonrot = 0;
+	if (ldi_ioctl(dvd->vd_lh, DKIOCSOLIDSTATE, (intptr_t)&nonrot,
+	    FKIOCTL, kcred, NULL) != 0)
+		nonrot = 0;
+	vd->vdev_nonrot = (nonrot != 0);
+
 	if (vd->vdev_wholedisk == 1) {
 		int wce = 1;
 
@@ -543,10 +553,11 @@ skip_open:
 	}
 
 	/*
-	 * Clear the nowritecache bit, so that on a vdev_reopen() we will
-	 * try again.
+	 * Clear the nowritecache and notrim bits, so that on a vdev_reopen()
+	 * we will try again.
 	 */
 	vd->vdev_nowritecache = B_FALSE;
+	vd->vdev_notrim = B_FALSE;
 
 	return (0);
 }
@@ -684,6 +695,35 @@ vdev_disk_ioctl_done(void *zio_arg, int error)
 	zio_interrupt(zio);
 }
 
+/*
+ * DKIOCFREE has no asynchronous form, and it can take a while (a zvol
+ * frees the range in a transaction), so it's issued from a taskq.
+ */
+static void
+vdev_disk_io_trim(void *arg)
+{
+	zio_t *zio = arg;
+	vdev_t *vd = zio->io_vd;
+	vdev_disk_t *dvd = vd->vdev_tsd;
+	dkioc_free_t df;
+	int error;
+
+	df.df_flags = 0;
+	df.df_reserved = 0;
+	df.df_start = zio->io_offset;
+	df.df_length = zio->io_size;
+
+	error = ldi_ioctl(dvd->vd_lh, DKIOCFREE, (intptr_t)&df, FKIOCTL,
+	    kcred, NULL);
+
+	/* As with cache flushes, don't keep asking a device that can't. */
+	if (error == ENOTSUP || error == ENOTTY)
+		vd->vdev_notrim = B_TRUE;
+	zio->io_error = error;
+
+	zio_interrupt(zio);
+}
+
 static void
 vdev_disk_io_start(zio_t *zio)
 {
@@ -757,6 +797,17 @@ vdev_disk_io_start(zio_t *zio)
 
 			break;
 
+		case DKIOCFREE:
+
+			if (vd->vdev_notrim) {
+				zio->io_error = SET_ERROR(ENOTSUP);
+				break;
+			}
+
+			VERIFY3U(taskq_dispatch(system_taskq,
+			    vdev_disk_io_trim, zio, TQ_SLEEP), !=, 0);
+			return;
+
 		default:
 			zio->io_error = SET_ERROR(ENOTSUP);
 		}
@@ -30,6 +30,7 @@
 #include <sys/vdev_impl.h>
 #include <sys/zio.h>
 #include <sys/fs/zfs.h>
+#include <sys/fcntl.h>
 #include <sys/fm/fs/zfs.h>
 
 /*
@@ -118,6 +119,9 @@ skip_open:
 	*max_psize = *psize = vattr.va_size;
 	*ashift = SPA_MINBLOCKSHIFT;
 
+	/* Give hole punching another try after a reopen. */
+	vd->vdev_notrim = B_FALSE;
+
 	return (0);
 }
 
@@ -182,6 +186,33 @@ vdev_file_io_strategy(void *arg)
 	}
 }
 
+/*
+ * Trims are passed on to the file system as hole punches, which gives the
+ * space back to it (or to the storage under it, for a file on a zvol).
+ */
+static void
+vdev_file_io_trim(void *arg)
+{
+	zio_t *zio = arg;
+	vdev_t *vd = zio->io_vd;
+	vdev_file_t *vf = vd->vdev_tsd;
+	struct flock64 fl;
+	int error;
+
+	bzero(&fl, sizeof (fl));
+	fl.l_whence = 0;
+	fl.l_start = zio->io_offset;
+	fl.l_len = zio->io_size;
+
+	error = VOP_SPACE(vf->vf_vnode, F_FREESP, &fl, FWRITE | FOFFMAX,
+	    0, kcred, NULL);
+	if (error == ENOTSUP || error == EINVAL)
+		vd->vdev_notrim = B_TRUE;
+	zio->io_error = error;
+
+	zio_interrupt(zio);
+}
+
 static void
 vdev_file_io_start(zio_t *zio)
 {
@@ -203,6 +234,14 @@ vdev_file_io_start(zio_t *zio)
 			zio->io_error = VOP_FSYNC(vf->vf_vnode, FSYNC | FDSYNC,
 			    kcred, NULL);
 			break;
+		case DKIOCFREE:
+			if (vd->vdev_notrim) {
+				zio->io_error = SET_ERROR(ENOTSUP);
+				break;
+			}
+			VERIFY3U(taskq_dispatch(system_taskq,
+			    vdev_file_io_trim, zio, TQ_SLEEP), !=, 0);
+			return;
 		default:
 			zio->io_error = SET_ERROR(ENOTSUP);
 		}
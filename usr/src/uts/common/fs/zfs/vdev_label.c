@@ -278,6 +278,12 @@ vdev_config_generate(spa_t *spa, vdev_t *vd, boolean_t getstats,
 		fnvlist_add_uint64(nv, ZPOOL_CONFIG_ASIZE,
 		    vd->vdev_asize);
 		fnvlist_add_uint64(nv, ZPOOL_CONFIG_IS_LOG, vd->vdev_islog);
+		if (vd->vdev_alloc_bias == VDEV_BIAS_DEDUP)
+			fnvlist_add_string(nv, ZPOOL_CONFIG_ALLOCATION_BIAS,
+			    VDEV_ALLOC_BIAS_DEDUP);
+		else if (vd->vdev_alloc_bias == VDEV_BIAS_SPECIAL)
+			fnvlist_add_string(nv, ZPOOL_CONFIG_ALLOCATION_BIAS,
+			    VDEV_ALLOC_BIAS_SPECIAL);
 		if (vd->vdev_removing)
 			fnvlist_add_uint64(nv, ZPOOL_CONFIG_REMOVING,
 			    vd->vdev_removing);
@@ -307,11 +313,16 @@ vdev_config_generate(spa_t *spa, vdev_t *vd, boolean_t getstats,
 
 	if (getstats) {
 		vdev_stat_t vs;
+		vdev_stat_ex_t *vsx;
 		pool_scan_stat_t ps;
 
-		vdev_get_stats(vd, &vs);
+		vsx = kmem_alloc(sizeof (*vsx), KM_SLEEP);
+		vdev_get_stats_ex(vd, &vs, vsx);
 		fnvlist_add_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS,
 		    (uint64_t *)&vs, sizeof (vs) / sizeof (uint64_t));
+		fnvlist_add_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS_EX,
+		    (uint64_t *)vsx, sizeof (*vsx) / sizeof (uint64_t));
+		kmem_free(vsx, sizeof (*vsx));
 
 		/* provide either current or previous scan information */
 		if (spa_scan_get_stats(spa, &ps) == 0) {
@@ -56,6 +56,20 @@ typedef struct mirror_map {
 
 int vdev_mirror_shift = 21;
 
+/*
+ * Reads from a mirror go to the child with the lowest expected service
+ * time: its decaying average read latency, times the number of i/os it
+ * already has queued or in flight plus one.  Until a child has completed a
+ * read we assume the latency below for its kind of device.  A rotational
+ * child whose last i/o was within vdev_mirror_seek_distance of this one is
+ * charged only half its latency for this i/o, since the head won't have to
+ * travel far.
+ */
+boolean_t vdev_mirror_load_balance = B_TRUE;
+hrtime_t vdev_mirror_rotating_lat = MSEC2NSEC(8);
+hrtime_t vdev_mirror_nonrot_lat = 200 * (NANOSEC / MICROSEC);
+uint64_t vdev_mirror_seek_distance = 1ULL << 20;
+
 static void
 vdev_mirror_map_free(zio_t *zio)
 {
@@ -136,6 +150,7 @@ vdev_mirror_open(vdev_t *vd, uint64_t *asize, uint64_t *max_asize,
 {
 	int numerrors = 0;
 	int lasterror = 0;
+	boolean_t nonrot = B_TRUE;
 
 	if (vd->vdev_children == 0) {
 		vd->vdev_stat.vs_aux = VDEV_AUX_BAD_LABEL;
@@ -156,8 +171,11 @@ vdev_mirror_open(vdev_t *vd, uint64_t *asize, uint64_t *max_asize,
 		*asize = MIN(*asize - 1, cvd->vdev_asize - 1) + 1;
 		*max_asize = MIN(*max_asize - 1, cvd->vdev_max_asize - 1) + 1;
 		*ashift = MAX(*ashift, cvd->vdev_ashift);
+		nonrot &= cvd->vdev_nonrot;
 	}
 
+	vd->vdev_nonrot = nonrot;
+
 	if (numerrors == vd->vdev_children) {
 		vd->vdev_stat.vs_aux = VDEV_AUX_NO_REPLICAS;
 		return (lasterror);
@@ -210,8 +228,36 @@ vdev_mirror_scrub_done(zio_t *zio)
 }
 
 /*
- * Try to find a child whose DTL doesn't contain the block we want to read.
- * If we can't, try the read on any vdev we haven't already tried.
+ * Estimate how long a read of this child would take to complete.
+ */
+static hrtime_t
+vdev_mirror_child_cost(mirror_child_t *mc)
+{
+	vdev_t *vd = mc->mc_vd;
+	vdev_queue_t *vq = &vd->vdev_queue;
+	uint64_t last = vq->vq_last_offset;
+	hrtime_t lat = vq->vq_read_lat;
+	hrtime_t cost;
+
+	if (lat == 0) {
+		lat = vd->vdev_nonrot ? vdev_mirror_nonrot_lat :
+		    vdev_mirror_rotating_lat;
+	}
+
+	cost = lat * vdev_queue_length(vd);
+	if (!vd->vdev_nonrot && MAX(mc->mc_offset, last) -
+	    MIN(mc->mc_offset, last) <= vdev_mirror_seek_distance)
+		cost += lat / 2;
+	else
+		cost += lat;
+
+	return (cost);
+}
+
+/*
+ * Try to find a child whose DTL doesn't contain the block we want to read,
+ * preferring the one we expect to return it soonest.  If we can't, try the
+ * read on any vdev we haven't already tried.
  */
 static int
 vdev_mirror_child_select(zio_t *zio)
@@ -219,7 +265,8 @@ vdev_mirror_child_select(zio_t *zio)
 	mirror_map_t *mm = zio->io_vsd;
 	mirror_child_t *mc;
 	uint64_t txg = zio->io_txg;
-	int i, c;
+	hrtime_t cost, best_cost = 0;
+	int i, c, best = -1;
 
 	ASSERT(zio->io_bp == NULL || BP_PHYSICAL_BIRTH(zio->io_bp) == txg);
 
@@ -240,13 +287,33 @@ vdev_mirror_child_select(zio_t *zio)
 			mc->mc_skipped = 1;
 			continue;
 		}
-		if (!vdev_dtl_contains(mc->mc_vd, DTL_MISSING, txg, 1))
+		if (vdev_dtl_contains(mc->mc_vd, DTL_MISSING, txg, 1)) {
+			mc->mc_error = SET_ERROR(ESTALE);
+			mc->mc_skipped = 1;
+			mc->mc_speculative = 1;
+			continue;
+		}
+
+		/*
+		 * Only the children of a plain mirror have queues worth
+		 * comparing: the children of a top-level "mirror" of DVAs
+		 * are whole vdevs, and while replacing we want to read from
+		 * the old device.
+		 */
+		if (!vdev_mirror_load_balance || mm->mm_root ||
+		    mm->mm_replacing)
 			return (c);
-		mc->mc_error = SET_ERROR(ESTALE);
-		mc->mc_skipped = 1;
-		mc->mc_speculative = 1;
+
+		cost = vdev_mirror_child_cost(mc);
+		if (best == -1 || cost < best_cost) {
+			best = c;
+			best_cost = cost;
+		}
 	}
 
+	if (best != -1)
+		return (best);
+
 	/*
 	 * Every device is either missing or has this txg in its DTL.
 	 * Look for any child we haven't already tried before giving up.
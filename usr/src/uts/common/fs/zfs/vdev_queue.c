@@ -35,6 +35,7 @@
 #include <sys/avl.h>
 #include <sys/dsl_pool.h>
 #include <sys/metaslab_impl.h>
+#include <sys/kstat.h>
 
 /*
  * ZFS I/O Scheduler
@@ -42,9 +43,9 @@
  *
  * ZFS issues I/O operations to leaf vdevs to satisfy and complete zios.  The
  * I/O scheduler determines when and in what order those operations are
- * issued.  The I/O scheduler divides operations into five I/O classes
+ * issued.  The I/O scheduler divides operations into six I/O classes
  * prioritized in the following order: sync read, sync write, async read,
- * async write, and scrub/resilver.  Each queue defines the minimum and
+ * async write, scrub/resilver, and trim.  Each queue defines the minimum and
  * maximum number of concurrent operations that may be issued to the device.
  * In addition, the device has an aggregate maximum. Note that the sum of the
  * per-queue minimums must not exceed the aggregate maximum, and if the
@@ -112,6 +113,22 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Adaptive Scrub Throttle
+ *
+ * A fixed zfs_vdev_scrub_max_active is either too low for an idle pool or
+ * too high for a busy one.  When zfs_vdev_scrub_adaptive is set, each leaf
+ * instead chooses its own scrub limit, between zfs_vdev_scrub_min_active and
+ * zfs_vdev_scrub_adaptive_max_active, from the latency of the synchronous
+ * reads it completes.  At most every zfs_vdev_scrub_adjust_ms, the limit is
+ * halved if the (decaying average) sync read latency is above
+ * zfs_vdev_scrub_target_latency_us, and raised by one if it is below the
+ * target or there have been no sync reads at all.  This backs scrubs and
+ * resilvers off quickly when they start to hurt foreground reads, and lets
+ * them take the whole device when nothing else wants it.  Only latency at
+ * the device is measured, so the target should be set from what the device
+ * does under load, not what the application sees.  The vdev_queue_stats
+ * kstat counts the adjustments.
  */
 
 /*
@@ -147,6 +164,16 @@ uint32_t zfs_vdev_async_write_min_active = 1;
 uint32_t zfs_vdev_async_write_max_active = 10;
 uint32_t zfs_vdev_scrub_min_active = 1;
 uint32_t zfs_vdev_scrub_max_active = 2;
+uint32_t zfs_vdev_trim_min_active = 1;
+uint32_t zfs_vdev_trim_max_active = 2;
+
+/*
+ * See "Adaptive Scrub Throttle" above.
+ */
+int zfs_vdev_scrub_adaptive = 0;
+uint32_t zfs_vdev_scrub_adaptive_max_active = 8;
+uint64_t zfs_vdev_scrub_target_latency_us = 20000;
+uint64_t zfs_vdev_scrub_adjust_ms = 100;
 
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
@@ -184,6 +211,29 @@ int zfs_vdev_queue_depth_pct = 1000;
 int zfs_vdev_queue_depth_pct = 300;
 #endif
 
+/*
+ * Each leaf keeps a decaying average of its read latency (time from issue
+ * to completion), for use in choosing which side of a mirror to read from.
+ * Each completed read moves the average 1 / 2^zfs_vdev_read_lat_shift of
+ * the way towards its own latency.
+ */
+int zfs_vdev_read_lat_shift = 3;
+
+static kstat_t *vdev_queue_ksp;
+
+typedef struct vdev_queue_stats {
+	kstat_named_t vqs_scrub_increases;
+	kstat_named_t vqs_scrub_decreases;
+	kstat_named_t vqs_scrub_at_min;
+} vdev_queue_stats_t;
+
+static vdev_queue_stats_t vdev_queue_stats = {
+	{ "scrub_increases",	KSTAT_DATA_UINT64 },
+	{ "scrub_decreases",	KSTAT_DATA_UINT64 },
+	{ "scrub_at_min",	KSTAT_DATA_UINT64 }
+};
+
+#define	VQSTAT_BUMP(stat)	atomic_inc_64(&vdev_queue_stats.stat.value.ui64)
 
 int
 vdev_queue_offset_compare(const void *x1, const void *x2)
@@ -246,6 +296,7 @@ vdev_queue_init(vdev_t *vd)
 
 	mutex_init(&vq->vq_lock, NULL, MUTEX_DEFAULT, NULL);
 	vq->vq_vdev = vd;
+	vq->vq_scrub_max_active = zfs_vdev_scrub_max_active;
 
 	avl_create(&vq->vq_active_tree, vdev_queue_offset_compare,
 	    sizeof (zio_t), offsetof(struct zio, io_queue_node));
@@ -288,6 +339,37 @@ vdev_queue_fini(vdev_t *vd)
 	mutex_destroy(&vq->vq_lock);
 }
 
+void
+vdev_queue_stat_init(void)
+{
+	vdev_queue_ksp = kstat_create("zfs", 0, "vdev_queue_stats", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (vdev_queue_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (vdev_queue_ksp != NULL) {
+		vdev_queue_ksp->ks_data = &vdev_queue_stats;
+		kstat_install(vdev_queue_ksp);
+	}
+}
+
+void
+vdev_queue_stat_fini(void)
+{
+	if (vdev_queue_ksp != NULL) {
+		kstat_delete(vdev_queue_ksp);
+		vdev_queue_ksp = NULL;
+	}
+}
+
+/*
+ * Trims can't be aggregated, so they're kept only in their class tree.
+ */
+static inline boolean_t
+vdev_queue_is_trim(zio_t *zio)
+{
+	return (zio->io_type == ZIO_TYPE_IOCTL);
+}
+
 static void
 vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 {
@@ -295,7 +377,8 @@ vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
 	avl_add(vdev_queue_class_tree(vq, zio->io_priority), zio);
-	avl_add(vdev_queue_type_tree(vq, zio->io_type), zio);
+	if (!vdev_queue_is_trim(zio))
+		avl_add(vdev_queue_type_tree(vq, zio->io_type), zio);
 
 	mutex_enter(&spa->spa_iokstat_lock);
 	spa->spa_queue_stats[zio->io_priority].spa_queued++;
@@ -311,7 +394,8 @@ vdev_queue_io_remove(vdev_queue_t *vq, zio_t *zio)
 
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
 	avl_remove(vdev_queue_class_tree(vq, zio->io_priority), zio);
-	avl_remove(vdev_queue_type_tree(vq, zio->io_type), zio);
+	if (!vdev_queue_is_trim(zio))
+		avl_remove(vdev_queue_type_tree(vq, zio->io_type), zio);
 
 	mutex_enter(&spa->spa_iokstat_lock);
 	ASSERT3U(spa->spa_queue_stats[zio->io_priority].spa_queued, >, 0);
@@ -329,6 +413,7 @@ vdev_queue_pending_add(vdev_queue_t *vq, zio_t *zio)
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
 	vq->vq_class[zio->io_priority].vqc_active++;
 	avl_add(&vq->vq_active_tree, zio);
+	zio->io_delta = gethrtime() - zio->io_timestamp;
 
 	mutex_enter(&spa->spa_iokstat_lock);
 	spa->spa_queue_stats[zio->io_priority].spa_active++;
@@ -345,6 +430,16 @@ vdev_queue_pending_remove(vdev_queue_t *vq, zio_t *zio)
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
 	vq->vq_class[zio->io_priority].vqc_active--;
 	avl_remove(&vq->vq_active_tree, zio);
+	zio->io_delay = gethrtime() - zio->io_timestamp - zio->io_delta;
+
+	if (zio->io_type == ZIO_TYPE_READ) {
+		if (vq->vq_read_lat == 0) {
+			vq->vq_read_lat = zio->io_delay;
+		} else {
+			vq->vq_read_lat += (zio->io_delay - vq->vq_read_lat) >>
+			    zfs_vdev_read_lat_shift;
+		}
+	}
 
 	mutex_enter(&spa->spa_iokstat_lock);
 	ASSERT3U(spa->spa_queue_stats[zio->io_priority].spa_active, >, 0);
@@ -393,6 +488,8 @@ vdev_queue_class_min_active(zio_priority_t p)
 		return (zfs_vdev_async_write_min_active);
 	case ZIO_PRIORITY_SCRUB:
 		return (zfs_vdev_scrub_min_active);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_min_active);
 	default:
 		panic("invalid priority %u", p);
 		return (0);
@@ -439,8 +536,10 @@ vdev_queue_max_async_writes(spa_t *spa)
 }
 
 static int
-vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
+vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 {
+	spa_t *spa = vq->vq_vdev->vdev_spa;
+
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
 		return (zfs_vdev_sync_read_max_active);
@@ -451,13 +550,72 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 	case ZIO_PRIORITY_ASYNC_WRITE:
 		return (vdev_queue_max_async_writes(spa));
 	case ZIO_PRIORITY_SCRUB:
+		if (zfs_vdev_scrub_adaptive)
+			return (vq->vq_scrub_max_active);
 		return (zfs_vdev_scrub_max_active);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_max_active);
 	default:
 		panic("invalid priority %u", p);
 		return (0);
 	}
 }
 
+/*
+ * Move this leaf's scrub limit towards the point where sync reads take
+ * zfs_vdev_scrub_target_latency_us.  Called as sync and scrub i/os
+ * complete.
+ */
+static void
+vdev_queue_scrub_adjust(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	hrtime_t interval = zfs_vdev_scrub_adjust_ms * (NANOSEC / MILLISEC);
+	hrtime_t target = zfs_vdev_scrub_target_latency_us *
+	    (NANOSEC / MICROSEC);
+	uint32_t min_active = zfs_vdev_scrub_min_active;
+	uint32_t max_active = MAX(zfs_vdev_scrub_adaptive_max_active,
+	    min_active);
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (zio->io_priority == ZIO_PRIORITY_SYNC_READ) {
+		if (vq->vq_sync_read_lat == 0) {
+			vq->vq_sync_read_lat = zio->io_delay;
+		} else {
+			vq->vq_sync_read_lat += (zio->io_delay -
+			    vq->vq_sync_read_lat) >> zfs_vdev_read_lat_shift;
+		}
+		vq->vq_sync_read_ts = now;
+	} else if (zio->io_priority != ZIO_PRIORITY_SCRUB) {
+		return;
+	}
+
+	if (!zfs_vdev_scrub_adaptive || now - vq->vq_scrub_adjust_ts < interval)
+		return;
+	vq->vq_scrub_adjust_ts = now;
+
+	if (now - vq->vq_sync_read_ts > interval ||
+	    vq->vq_sync_read_lat <= target) {
+		/* Nothing has been read lately, or reads are fast enough. */
+		if (vq->vq_scrub_max_active < max_active &&
+		    avl_numnodes(vdev_queue_class_tree(vq,
+		    ZIO_PRIORITY_SCRUB)) > 0) {
+			vq->vq_scrub_max_active++;
+			VQSTAT_BUMP(vqs_scrub_increases);
+		}
+	} else if (vq->vq_scrub_max_active > min_active) {
+		vq->vq_scrub_max_active = MAX(vq->vq_scrub_max_active / 2,
+		    min_active);
+		VQSTAT_BUMP(vqs_scrub_decreases);
+	} else {
+		VQSTAT_BUMP(vqs_scrub_at_min);
+	}
+
+	/* The tunables may have moved under us. */
+	vq->vq_scrub_max_active = MIN(MAX(vq->vq_scrub_max_active, min_active),
+	    max_active);
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_MAX_QUEUEABLE if
  * there is no eligible class.
@@ -465,7 +623,6 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 static zio_priority_t
 vdev_queue_class_to_issue(vdev_queue_t *vq)
 {
-	spa_t *spa = vq->vq_vdev->vdev_spa;
 	zio_priority_t p;
 
 	if (avl_numnodes(&vq->vq_active_tree) >= zfs_vdev_max_active)
@@ -486,7 +643,7 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
 		if (avl_numnodes(vdev_queue_class_tree(vq, p)) > 0 &&
 		    vq->vq_class[p].vqc_active <
-		    vdev_queue_class_max_active(spa, p))
+		    vdev_queue_class_max_active(vq, p))
 			return (p);
 	}
 
@@ -510,12 +667,14 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	uint64_t maxgap = 0;
 	uint64_t size;
 	boolean_t stretch = B_FALSE;
-	avl_tree_t *t = vdev_queue_type_tree(vq, zio->io_type);
+	avl_tree_t *t;
 	enum zio_flag flags = zio->io_flags & ZIO_FLAG_AGG_INHERIT;
 
-	if (zio->io_flags & ZIO_FLAG_DONT_AGGREGATE)
+	if ((zio->io_flags & ZIO_FLAG_DONT_AGGREGATE) ||
+	    vdev_queue_is_trim(zio))
 		return (NULL);
 
+	t = vdev_queue_type_tree(vq, zio->io_type);
 	first = last = zio;
 
 	if (zio->io_type == ZIO_TYPE_READ)
@@ -696,7 +855,8 @@ again:
 	}
 
 	vdev_queue_pending_add(vq, zio);
-	vq->vq_last_offset = zio->io_offset;
+	if (!vdev_queue_is_trim(zio))
+		vq->vq_last_offset = zio->io_offset;
 
 	return (zio);
 }
@@ -719,6 +879,9 @@ vdev_queue_io(zio_t *zio)
 		    zio->io_priority != ZIO_PRIORITY_ASYNC_READ &&
 		    zio->io_priority != ZIO_PRIORITY_SCRUB)
 			zio->io_priority = ZIO_PRIORITY_ASYNC_READ;
+	} else if (vdev_queue_is_trim(zio)) {
+		ASSERT3U(zio->io_cmd, ==, DKIOCFREE);
+		zio->io_priority = ZIO_PRIORITY_TRIM;
 	} else {
 		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
 		if (zio->io_priority != ZIO_PRIORITY_SYNC_WRITE &&
@@ -745,6 +908,20 @@ vdev_queue_io(zio_t *zio)
 	return (nio);
 }
 
+/*
+ * Return the number of i/os queued or in flight on this leaf.  This is
+ * read without the queue lock, so it's only an estimate.
+ */
+uint64_t
+vdev_queue_length(vdev_t *vd)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	return (avl_numnodes(&vq->vq_active_tree) +
+	    avl_numnodes(vdev_queue_type_tree(vq, ZIO_TYPE_READ)) +
+	    avl_numnodes(vdev_queue_type_tree(vq, ZIO_TYPE_WRITE)));
+}
+
 void
 vdev_queue_io_done(zio_t *zio)
 {
@@ -756,6 +933,7 @@ vdev_queue_io_done(zio_t *zio)
 	vdev_queue_pending_remove(vq, zio);
 
 	vq->vq_io_complete_ts = gethrtime();
+	vdev_queue_scrub_adjust(vq, zio, vq->vq_io_complete_ts);
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
@@ -36,6 +36,11 @@
 #include <sys/zio_checksum.h>
 #include <sys/fs/zfs.h>
 #include <sys/fm/fs/zfs.h>
+#if defined(_KERNEL) && defined(__amd64)
+#include <sys/disp.h>		/* kpreempt_disable(), kpreempt_enable() */
+#include <sys/x86_archext.h>
+#define	VDEV_RAIDZ_SIMD
+#endif
 
 /*
  * Virtual device vector for RAID-Z.
@@ -153,10 +158,20 @@ typedef struct raidz_map {
 	    ((mask) & 0x1d1d1d1d1d1d1d1d); \
 }
 
+/*
+ * Multiplying by 4 is done in one step rather than as two multiplications by
+ * 2: the top two bits of each byte shift out, and are folded back in as
+ * 0x3a (bit 7, i.e. 2 * 0x1d) and 0x1d (bit 6).
+ */
 #define	VDEV_RAIDZ_64MUL_4(x, mask) \
 { \
-	VDEV_RAIDZ_64MUL_2((x), mask); \
-	VDEV_RAIDZ_64MUL_2((x), mask); \
+	uint64_t __m6 = (x) & 0x4040404040404040ULL; \
+	(mask) = (x) & 0x8080808080808080ULL; \
+	(mask) = ((mask) << 1) - ((mask) >> 7); \
+	__m6 = (__m6 << 2) - (__m6 >> 6); \
+	(x) = (((x) << 2) & 0xfcfcfcfcfcfcfcfcULL) ^ \
+	    ((mask) & 0x3a3a3a3a3a3a3a3aULL) ^ \
+	    (__m6 & 0x1d1d1d1d1d1d1d1dULL); \
 }
 
 #define	VDEV_LABEL_OFFSET(x)	(x + VDEV_LABEL_START_SIZE)
@@ -166,6 +181,25 @@ typedef struct raidz_map {
  */
 int vdev_raidz_default_to_general;
 
+#ifdef VDEV_RAIDZ_SIMD
+/*
+ * In the kernel on amd64, parity generation adds each data column into P, Q
+ * and R 16 bytes at a time with SSE2, and reconstruction applies each
+ * coefficient with SSSE3 pshufb lookups of the low and high nibbles when the
+ * processor has SSSE3 (see uts/intel/zfs/vdev_raidz_simd.s).  The integer
+ * code below handles whatever is left over.  Set to 0 to use only the
+ * integer code.
+ */
+int vdev_raidz_simd = 1;
+
+extern void vdev_raidz_sse2_pq(uint64_t *, uint64_t *, const uint64_t *,
+    size_t);
+extern void vdev_raidz_sse2_pqr(uint64_t *, uint64_t *, uint64_t *,
+    const uint64_t *, size_t);
+extern void vdev_raidz_ssse3_mul_add(uint8_t *, const uint8_t *,
+    const uint8_t *, size_t);
+#endif
+
 /* Powers of 2 in the Galois field defined above. */
 static const uint8_t vdev_raidz_pow2[256] = {
 	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
@@ -645,7 +679,19 @@ vdev_raidz_generate_parity_pq(raidz_map_t *rm)
 			 * Apply the algorithm described above by multiplying
 			 * the previous result and adding in the new value.
 			 */
-			for (i = 0; i < ccnt; i++, src++, p++, q++) {
+			i = 0;
+#ifdef VDEV_RAIDZ_SIMD
+			if (vdev_raidz_simd && ccnt >= 2) {
+				kpreempt_disable();
+				vdev_raidz_sse2_pq(p, q, src, ccnt / 2);
+				kpreempt_enable();
+				i = ccnt & ~1ULL;
+				src += i;
+				p += i;
+				q += i;
+			}
+#endif
+			for (; i < ccnt; i++, src++, p++, q++) {
 				*p ^= *src;
 
 				VDEV_RAIDZ_64MUL_2(*q, mask);
@@ -702,7 +748,20 @@ vdev_raidz_generate_parity_pqr(raidz_map_t *rm)
 			 * Apply the algorithm described above by multiplying
 			 * the previous result and adding in the new value.
 			 */
-			for (i = 0; i < ccnt; i++, src++, p++, q++, r++) {
+			i = 0;
+#ifdef VDEV_RAIDZ_SIMD
+			if (vdev_raidz_simd && ccnt >= 2) {
+				kpreempt_disable();
+				vdev_raidz_sse2_pqr(p, q, r, src, ccnt / 2);
+				kpreempt_enable();
+				i = ccnt & ~1ULL;
+				src += i;
+				p += i;
+				q += i;
+				r += i;
+			}
+#endif
+			for (; i < ccnt; i++, src++, p++, q++, r++) {
 				*p ^= *src;
 
 				VDEV_RAIDZ_64MUL_2(*q, mask);
@@ -1209,6 +1268,33 @@ vdev_raidz_matrix_invert(raidz_map_t *rm, int n, int nmissing, int *missing,
 	}
 }
 
+/*
+ * Reconstruction multiplies every byte of every surviving data column by a
+ * coefficient from the inverted matrix.  Rather than doing a log/exp table
+ * lookup (and a modular reduction) for each byte, we build a 256-entry
+ * multiplication table for each (source column, target column) coefficient
+ * and then apply it with a single, branch-free lookup per byte.  Building the
+ * table costs 255 lookups, so for very small columns it is cheaper to fall
+ * back to the per-byte computation.
+ */
+#define	VDEV_RAIDZ_MULTAB_MIN	512
+
+static void
+vdev_raidz_multab_init(uint8_t *tab, uint8_t coeff)
+{
+	int log = vdev_raidz_log2[coeff];
+	int ll;
+
+	ASSERT3U(coeff, !=, 0);
+
+	tab[0] = 0;
+	for (int v = 1; v < 256; v++) {
+		if ((ll = vdev_raidz_log2[v] + log) >= 255)
+			ll -= 255;
+		tab[v] = vdev_raidz_pow2[ll];
+	}
+}
+
 static void
 vdev_raidz_matrix_reconstruct(raidz_map_t *rm, int n, int nmissing,
     int *missing, uint8_t **invrows, const uint8_t *used)
@@ -1223,7 +1309,13 @@ vdev_raidz_matrix_reconstruct(raidz_map_t *rm, int n, int nmissing,
 	int ll;
 	uint8_t *invlog[VDEV_RAIDZ_MAXPARITY];
 	uint8_t *p, *pp;
+	uint8_t multab[256];
 	size_t psize;
+#ifdef VDEV_RAIDZ_SIMD
+	uint8_t nibtab[32];
+	boolean_t ssse3 = vdev_raidz_simd &&
+	    is_x86_feature(x86_featureset, X86FSET_SSSE3);
+#endif
 
 	psize = sizeof (invlog[0][0]) * n * nmissing;
 	p = kmem_alloc(psize, KM_SLEEP);
@@ -1258,6 +1350,41 @@ vdev_raidz_matrix_reconstruct(raidz_map_t *rm, int n, int nmissing,
 
 		ASSERT(ccount >= rm->rm_col[missing[0]].rc_size || i > 0);
 
+		if (ccount >= VDEV_RAIDZ_MULTAB_MIN) {
+			for (cc = 0; cc < nmissing; cc++) {
+				uint64_t count = MIN(ccount, dcount[cc]);
+				uint8_t *d = dst[cc];
+
+				vdev_raidz_multab_init(multab,
+				    invrows[cc][i]);
+				x = 0;
+
+#ifdef VDEV_RAIDZ_SIMD
+				if (ssse3) {
+					for (j = 0; j < 16; j++) {
+						nibtab[j] = multab[j];
+						nibtab[16 + j] = multab[j << 4];
+					}
+					x = count & ~15ULL;
+					if (i == 0)
+						bzero(d, x);
+					kpreempt_disable();
+					vdev_raidz_ssse3_mul_add(d, src, nibtab,
+					    count / 16);
+					kpreempt_enable();
+				}
+#endif
+				if (i == 0) {
+					for (; x < count; x++)
+						d[x] = multab[src[x]];
+				} else {
+					for (; x < count; x++)
+						d[x] ^= multab[src[x]];
+				}
+			}
+			continue;
+		}
+
 		for (x = 0; x < ccount; x++, src++) {
 			if (*src != 0)
 				log = vdev_raidz_log2[*src];
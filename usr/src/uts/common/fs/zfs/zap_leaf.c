@@ -464,6 +464,18 @@ zap_leaf_lookup_closest(zap_leaf_t *l,
 	ASSERT3U(zap_leaf_phys(l)->l_hdr.lh_magic, ==, ZAP_LEAF_MAGIC);
 
 	for (lh = LEAF_HASH(l, h); lh <= bestlh; lh++) {
+		/*
+		 * Most buckets are empty, so when we're on an aligned group
+		 * of four, check them all with one load and skip them
+		 * together.  The hash table follows the 48-byte header, so
+		 * it is 8-byte aligned.  CHAIN_END is all ones.
+		 */
+		if (P2PHASE(lh, 4) == 0 && lh + 3 <= bestlh &&
+		    *(uint64_t *)&zap_leaf_phys(l)->l_hash[lh] == -1ULL) {
+			lh += 3;
+			continue;
+		}
+
 		for (chunk = zap_leaf_phys(l)->l_hash[lh];
 		    chunk != CHAIN_END; chunk = le->le_next) {
 			le = ZAP_LEAF_ENTRY(l, chunk);
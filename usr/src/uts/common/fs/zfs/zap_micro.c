@@ -71,6 +71,26 @@ zap_maxcd(zap_t *zap)
 		return (-1U);
 }
 
+/*
+ * Fold eight bytes into the CRC at once, the first byte being the least
+ * significant byte of "word".  This gives the same result as feeding them
+ * one at a time through zfs_crc64_table, with a quarter of the dependent
+ * table lookups.
+ */
+static inline uint64_t
+zap_crc64_word(uint64_t h, uint64_t word)
+{
+	h ^= word;
+	return (zfs_crc64_slice[7][h & 0xFF] ^
+	    zfs_crc64_slice[6][(h >> 8) & 0xFF] ^
+	    zfs_crc64_slice[5][(h >> 16) & 0xFF] ^
+	    zfs_crc64_slice[4][(h >> 24) & 0xFF] ^
+	    zfs_crc64_slice[3][(h >> 32) & 0xFF] ^
+	    zfs_crc64_slice[2][(h >> 40) & 0xFF] ^
+	    zfs_crc64_slice[1][(h >> 48) & 0xFF] ^
+	    zfs_crc64_slice[0][h >> 56]);
+}
+
 static uint64_t
 zap_hash(zap_name_t *zn)
 {
@@ -90,16 +110,8 @@ zap_hash(zap_name_t *zn)
 			const uint64_t *wp = zn->zn_key_norm;
 
 			ASSERT(zn->zn_key_intlen == 8);
-			for (i = 0; i < zn->zn_key_norm_numints; wp++, i++) {
-				int j;
-				uint64_t word = *wp;
-
-				for (j = 0; j < zn->zn_key_intlen; j++) {
-					h = (h >> 8) ^
-					    zfs_crc64_table[(h ^ word) & 0xFF];
-					word >>= NBBY;
-				}
-			}
+			for (i = 0; i < zn->zn_key_norm_numints; wp++, i++)
+				h = zap_crc64_word(h, *wp);
 		} else {
 			int i, len;
 			const uint8_t *cp = zn->zn_key_norm;
@@ -114,7 +126,13 @@ zap_hash(zap_name_t *zn)
 			len = zn->zn_key_norm_numints - 1;
 
 			ASSERT(zn->zn_key_intlen == 1);
-			for (i = 0; i < len; cp++, i++) {
+			for (i = 0; i + 8 <= len; cp += 8, i += 8) {
+				uint64_t word;
+
+				bcopy(cp, &word, sizeof (word));
+				h = zap_crc64_word(h, LE_64(word));
+			}
+			for (; i < len; cp++, i++) {
 				h = (h >> 8) ^
 				    zfs_crc64_table[(h ^ *cp) & 0xFF];
 			}
@@ -663,7 +681,16 @@ uint64_t
 zap_create_norm(objset_t *os, int normflags, dmu_object_type_t ot,
     dmu_object_type_t bonustype, int bonuslen, dmu_tx_t *tx)
 {
-	uint64_t obj = dmu_object_alloc(os, ot, 0, bonustype, bonuslen, tx);
+	return (zap_create_norm_dnsize(os, normflags, ot, bonustype,
+	    bonuslen, 0, tx));
+}
+
+uint64_t
+zap_create_norm_dnsize(objset_t *os, int normflags, dmu_object_type_t ot,
+    dmu_object_type_t bonustype, int bonuslen, int dnodesize, dmu_tx_t *tx)
+{
+	uint64_t obj = dmu_object_alloc_dnsize(os, ot, 0, bonustype, bonuslen,
+	    dnodesize, tx);
 
 	mzap_create_impl(os, obj, normflags, 0, tx);
 	return (obj);
@@ -505,6 +505,12 @@ zfs_acl_release_nodes(zfs_acl_t *aclp)
 void
 zfs_acl_free(zfs_acl_t *aclp)
 {
+	int i;
+
+	for (i = 0; i != ZFS_ACL_ACCESS_SLOTS; i++) {
+		if (aclp->z_access[i].za_cred != NULL)
+			crfree(aclp->z_access[i].za_cred);
+	}
 	zfs_acl_release_nodes(aclp);
 	list_destroy(&aclp->z_acl);
 	kmem_free(aclp, sizeof (zfs_acl_t));
@@ -1164,9 +1170,11 @@ zfs_acl_chown_setattr(znode_t *zp)
 	ASSERT(MUTEX_HELD(&zp->z_lock));
 	ASSERT(MUTEX_HELD(&zp->z_acl_lock));
 
-	if ((error = zfs_acl_node_read(zp, B_TRUE, &aclp, B_FALSE)) == 0)
+	if ((error = zfs_acl_node_read(zp, B_TRUE, &aclp, B_FALSE)) == 0) {
 		zp->z_mode = zfs_mode_compute(zp->z_mode, aclp,
 		    &zp->z_pflags, zp->z_uid, zp->z_gid);
+		zfs_znode_dnlcsearch(zp);
+	}
 	return (error);
 }
 
@@ -1195,6 +1203,7 @@ zfs_aclset_common(znode_t *zp, zfs_acl_t *aclp, cred_t *cr, dmu_tx_t *tx)
 	    zp->z_uid, zp->z_gid);
 
 	zp->z_mode = mode;
+	zfs_znode_dnlcsearch(zp);
 	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MODE(zfsvfs), NULL,
 	    &mode, sizeof (mode));
 	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_FLAGS(zfsvfs), NULL,
@@ -1257,12 +1266,16 @@ zfs_aclset_common(znode_t *zp, zfs_acl_t *aclp, cred_t *cr, dmu_tx_t *tx)
 				aoid = 0;
 			}
 			if (aoid == 0) {
-				aoid = dmu_object_alloc(zfsvfs->z_os,
+				int dnodesize =
+				    dmu_objset_dnodesize(zfsvfs->z_os);
+
+				aoid = dmu_object_alloc_dnsize(zfsvfs->z_os,
 				    otype, aclp->z_acl_bytes,
 				    otype == DMU_OT_ACL ?
 				    DMU_OT_SYSACL : DMU_OT_NONE,
 				    otype == DMU_OT_ACL ?
-				    DN_MAX_BONUSLEN : 0, tx);
+				    DN_BONUS_SIZE(dnodesize) : 0,
+				    dnodesize, tx);
 			} else {
 				(void) dmu_object_set_blocksize(zfsvfs->z_os,
 				    aoid, aclp->z_acl_bytes, 0, tx);
@@ -2059,59 +2072,121 @@ zfs_zaccess_dataset_check(znode_t *zp, uint32_t v4_mode)
 }
 
 /*
- * The primary usage of this function is to loop through all of the
- * ACEs in the znode, determining what accesses of interest (AoI) to
- * the caller are allowed or denied.  The AoI are expressed as bits in
- * the working_mode parameter.  As each ACE is processed, bits covered
- * by that ACE are removed from the working_mode.  This removal
- * facilitates two things.  The first is that when the working mode is
- * empty (= 0), we know we've looked at all the AoI. The second is
- * that the ACE interpretation rules don't allow a later ACE to undo
- * something granted or denied by an earlier ACE.  Removing the
- * discovered access or denial enforces this rule.  At the end of
- * processing the ACEs, all AoI that were found to be denied are
- * placed into the working_mode, giving the caller a mask of denied
- * accesses.  Returns:
- *	0		if all AoI granted
- *	EACCES		if the denied mask is non-zero
- *	other error	if abnormal failure (e.g., IO error)
- *
- * A secondary usage of the function is to determine if any of the
- * AoI are granted.  If an ACE grants any access in
- * the working_mode, we immediately short circuit out of the function.
- * This mode is chosen by setting anyaccess to B_TRUE.  The
- * working_mode is not a denied access mask upon exit if the function
- * is used in this manner.
+ * Evaluations of the cached ACL are remembered per credential in the
+ * zfs_acl_t, so they go away with it whenever the ACL changes.
+ * Setting this to 0 makes every check walk the ACEs.
+ */
+int zfs_acl_access_cache = 1;
+
+static boolean_t
+zfs_ksid_equal(const ksid_t *ks1, const ksid_t *ks2)
+{
+	if (ks1 == NULL || ks2 == NULL)
+		return (ks1 == ks2);
+	return (ks1->ks_id == ks2->ks_id && ks1->ks_rid == ks2->ks_rid &&
+	    ks1->ks_domain == ks2->ks_domain);
+}
+
+/*
+ * Would the two credentials match the same ACEs?  On top of what crcmp()
+ * compares, that takes the same SIDs, which is what SMB identities are
+ * mapped through.  SID domains are interned, and both credentials hold
+ * theirs, so comparing domain pointers is enough.
+ */
+static boolean_t
+zfs_acl_access_match(const cred_t *cr1, const cred_t *cr2)
+{
+	ksidlist_t *ksl1, *ksl2;
+	int i;
+
+	if (crcmp(cr1, cr2) != 0)
+		return (B_FALSE);
+
+	for (i = 0; i != KSID_COUNT; i++) {
+		if (!zfs_ksid_equal(crgetsid(cr1, i), crgetsid(cr2, i)))
+			return (B_FALSE);
+	}
+
+	ksl1 = crgetsidlist(cr1);
+	ksl2 = crgetsidlist(cr2);
+	if (ksl1 == ksl2)
+		return (B_TRUE);
+	if (ksl1 == NULL || ksl2 == NULL || ksl1->ksl_nsid != ksl2->ksl_nsid)
+		return (B_FALSE);
+	for (i = 0; i != ksl1->ksl_nsid; i++) {
+		if (!zfs_ksid_equal(&ksl1->ksl_sids[i], &ksl2->ksl_sids[i]))
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static zfs_acl_access_t *
+zfs_acl_access_find(znode_t *zp, zfs_acl_t *aclp, cred_t *cr)
+{
+	zfs_acl_access_t *zap;
+	int i;
+
+	ASSERT(MUTEX_HELD(&zp->z_acl_lock));
+
+	for (i = 0; i != ZFS_ACL_ACCESS_SLOTS; i++) {
+		zap = &aclp->z_access[i];
+		if (zap->za_cred != NULL && zap->za_fowner == zp->z_uid &&
+		    zap->za_gowner == zp->z_gid &&
+		    zfs_acl_access_match(cr, zap->za_cred))
+			return (zap);
+	}
+	return (NULL);
+}
+
+static void
+zfs_acl_access_enter(znode_t *zp, zfs_acl_t *aclp, cred_t *cr,
+    uint32_t allow, uint32_t deny)
+{
+	zfs_acl_access_t *zap;
+
+	ASSERT(MUTEX_HELD(&zp->z_acl_lock));
+
+	zap = &aclp->z_access[aclp->z_access_next];
+	aclp->z_access_next = (aclp->z_access_next + 1) % ZFS_ACL_ACCESS_SLOTS;
+	if (zap->za_cred != NULL)
+		crfree(zap->za_cred);
+
+	/*
+	 * The caller's credential may be changed in place after we return
+	 * (the NFS server does so), so keep a copy of our own.
+	 */
+	zap->za_cred = crdup(cr);
+	zap->za_fowner = zp->z_uid;
+	zap->za_gowner = zp->z_gid;
+	zap->za_allow = allow;
+	zap->za_deny = deny;
+}
+
+/*
+ * Walk the ACEs of aclp to find out which bits of working_mode are
+ * allowed or denied to cr, as decided by the first ACE that matches cr
+ * and covers each bit.  Bits no ACE decides are left in working_mode,
+ * allowed bits are added to *allowp and denied bits to *denyp.  With
+ * anyaccess the walk stops at the first ACE allowing anything.
  */
 static int
-zfs_zaccess_aces_check(znode_t *zp, uint32_t *working_mode,
-    boolean_t anyaccess, cred_t *cr)
+zfs_zaccess_aces_walk(znode_t *zp, zfs_acl_t *aclp, uint32_t *working_mode,
+    uint32_t *allowp, uint32_t *denyp, boolean_t anyaccess, cred_t *cr)
 {
 	zfsvfs_t	*zfsvfs = zp->z_zfsvfs;
-	zfs_acl_t	*aclp;
-	int		error;
 	uid_t		uid = crgetuid(cr);
 	uint64_t 	who;
 	uint16_t	type, iflags;
 	uint16_t	entry_type;
 	uint32_t	access_mask;
-	uint32_t	deny_mask = 0;
 	zfs_ace_hdr_t	*acep = NULL;
 	boolean_t	checkit;
 	uid_t		gowner;
 	uid_t		fowner;
 
-	zfs_fuid_map_ids(zp, cr, &fowner, &gowner);
-
-	mutex_enter(&zp->z_acl_lock);
-
-	error = zfs_acl_node_read(zp, B_FALSE, &aclp, B_FALSE);
-	if (error != 0) {
-		mutex_exit(&zp->z_acl_lock);
-		return (error);
-	}
+	ASSERT(MUTEX_HELD(&zp->z_acl_lock));
 
-	ASSERT(zp->z_acl_cached);
+	zfs_fuid_map_ids(zp, cr, &fowner, &gowner);
 
 	while (acep = zfs_acl_next_ace(aclp, acep, &who, &access_mask,
 	    &iflags, &type)) {
@@ -2159,7 +2234,6 @@ zfs_zaccess_aces_check(znode_t *zp, uint32_t *working_mode,
 					checkit = B_TRUE;
 				break;
 			} else {
-				mutex_exit(&zp->z_acl_lock);
 				return (SET_ERROR(EIO));
 			}
 		}
@@ -2170,16 +2244,15 @@ zfs_zaccess_aces_check(znode_t *zp, uint32_t *working_mode,
 				    znode_t *, zp,
 				    zfs_ace_hdr_t *, acep,
 				    uint32_t, mask_matched);
-				deny_mask |= mask_matched;
+				*denyp |= mask_matched;
 			} else {
 				DTRACE_PROBE3(zfs__ace__allows,
 				    znode_t *, zp,
 				    zfs_ace_hdr_t *, acep,
 				    uint32_t, mask_matched);
-				if (anyaccess) {
-					mutex_exit(&zp->z_acl_lock);
+				*allowp |= mask_matched;
+				if (anyaccess)
 					return (0);
-				}
 			}
 			*working_mode &= ~mask_matched;
 		}
@@ -2189,11 +2262,92 @@ zfs_zaccess_aces_check(znode_t *zp, uint32_t *working_mode,
 			break;
 	}
 
-	mutex_exit(&zp->z_acl_lock);
+	return (0);
+}
+
+/*
+ * The primary usage of this function is to loop through all of the
+ * ACEs in the znode, determining what accesses of interest (AoI) to
+ * the caller are allowed or denied.  The AoI are expressed as bits in
+ * the working_mode parameter.  As each ACE is processed, bits covered
+ * by that ACE are removed from the working_mode.  This removal
+ * facilitates two things.  The first is that when the working mode is
+ * empty (= 0), we know we've looked at all the AoI. The second is
+ * that the ACE interpretation rules don't allow a later ACE to undo
+ * something granted or denied by an earlier ACE.  Removing the
+ * discovered access or denial enforces this rule.  At the end of
+ * processing the ACEs, all AoI that were found to be denied are
+ * placed into the working_mode, giving the caller a mask of denied
+ * accesses.  Returns:
+ *	0		if all AoI granted
+ *	EACCES		if the denied mask is non-zero
+ *	other error	if abnormal failure (e.g., IO error)
+ *
+ * A secondary usage of the function is to determine if any of the
+ * AoI are granted.  If an ACE grants any access in
+ * the working_mode, we immediately short circuit out of the function.
+ * This mode is chosen by setting anyaccess to B_TRUE.  The
+ * working_mode is not a denied access mask upon exit if the function
+ * is used in this manner.
+ *
+ * Since each bit is decided on its own by the first ACE covering it,
+ * the ACL is walked once per credential for every bit at once, and the
+ * answer for any AoI read from the result after that.
+ */
+static int
+zfs_zaccess_aces_check(znode_t *zp, uint32_t *working_mode,
+    boolean_t anyaccess, cred_t *cr)
+{
+	zfs_acl_t	*aclp;
+	zfs_acl_access_t *zap;
+	uint32_t	allow = 0;
+	uint32_t	deny = 0;
+	uint32_t	undecided;
+	int		error;
+
+	mutex_enter(&zp->z_acl_lock);
+
+	error = zfs_acl_node_read(zp, B_FALSE, &aclp, B_FALSE);
+	if (error != 0) {
+		mutex_exit(&zp->z_acl_lock);
+		return (error);
+	}
+
+	ASSERT(zp->z_acl_cached);
+
+	if (!zfs_acl_access_cache) {
+		error = zfs_zaccess_aces_walk(zp, aclp, working_mode,
+		    &allow, &deny, anyaccess, cr);
+		mutex_exit(&zp->z_acl_lock);
+		if (error != 0)
+			return (error);
+		if (anyaccess && allow != 0)
+			return (0);
+	} else {
+		if ((zap = zfs_acl_access_find(zp, aclp, cr)) != NULL) {
+			allow = zap->za_allow;
+			deny = zap->za_deny;
+		} else {
+			undecided = ~0U;
+			error = zfs_zaccess_aces_walk(zp, aclp, &undecided,
+			    &allow, &deny, B_FALSE, cr);
+			if (error != 0) {
+				mutex_exit(&zp->z_acl_lock);
+				return (error);
+			}
+			zfs_acl_access_enter(zp, aclp, cr, allow, deny);
+		}
+		mutex_exit(&zp->z_acl_lock);
+
+		if (anyaccess && (allow & *working_mode) != 0)
+			return (0);
+		deny &= *working_mode;
+		*working_mode &= ~(allow | deny);
+	}
 
 	/* Put the found 'denies' back on the working mode */
-	if (deny_mask) {
-		*working_mode |= deny_mask;
+	if (deny) {
+		*working_mode |= deny;
 		return (SET_ERROR(EACCES));
 	} else if (*working_mode) {
 		return (-1);
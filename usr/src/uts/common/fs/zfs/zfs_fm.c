@@ -102,6 +102,48 @@
  * ereport with information about the differences.
  */
 #ifdef _KERNEL
+/*
+ * A failing device can report thousands of I/O and checksum errors a second,
+ * far more than fmd needs to diagnose it and enough to make it fall behind.
+ * At most zfs_ereport_rate_max such ereports are posted per vdev per second;
+ * the number suppressed is carried in the "suppressed" member of the next one
+ * that is posted.  Setting this to zero disables the limit.
+ */
+uint_t zfs_ereport_rate_max = 20;
+
+static boolean_t
+zfs_ereport_ratelimit(spa_t *spa, vdev_t *vd, const char *subclass,
+    uint64_t *suppressedp)
+{
+	hrtime_t now;
+	boolean_t drop = B_FALSE;
+
+	*suppressedp = 0;
+
+	if (zfs_ereport_rate_max == 0 ||
+	    (strcmp(subclass, FM_EREPORT_ZFS_IO) != 0 &&
+	    strcmp(subclass, FM_EREPORT_ZFS_CHECKSUM) != 0))
+		return (B_FALSE);
+
+	now = gethrtime();
+	mutex_enter(&spa->spa_errlist_lock);
+	if (now - vd->vdev_ereport_start >= NANOSEC) {
+		vd->vdev_ereport_start = now;
+		vd->vdev_ereport_count = 0;
+	}
+	if (vd->vdev_ereport_count >= zfs_ereport_rate_max) {
+		vd->vdev_ereport_suppressed++;
+		drop = B_TRUE;
+	} else {
+		vd->vdev_ereport_count++;
+		*suppressedp = vd->vdev_ereport_suppressed;
+		vd->vdev_ereport_suppressed = 0;
+	}
+	mutex_exit(&spa->spa_errlist_lock);
+
+	return (drop);
+}
+
 static void
 zfs_ereport_start(nvlist_t **ereport_out, nvlist_t **detector_out,
     const char *subclass, spa_t *spa, vdev_t *vd, zio_t *zio,
@@ -109,7 +151,7 @@ zfs_ereport_start(nvlist_t **ereport_out, nvlist_t **detector_out,
 {
 	nvlist_t *ereport, *detector;
 
-	uint64_t ena;
+	uint64_t ena, suppressed = 0;
 	char class[64];
 
 	/*
@@ -188,6 +230,9 @@ zfs_ereport_start(nvlist_t **ereport_out, nvlist_t **detector_out,
 	    (vd->vdev_remove_wanted || vd->vdev_state == VDEV_STATE_REMOVED))
 		return;
 
+	if (vd != NULL && zfs_ereport_ratelimit(spa, vd, subclass, &suppressed))
+		return;
+
 	if ((ereport = fm_nvlist_create(NULL)) == NULL)
 		return;
 
@@ -254,6 +299,11 @@ zfs_ereport_start(nvlist_t **ereport_out, nvlist_t **detector_out,
 		    NULL);
 	}
 
+	if (suppressed != 0) {
+		fm_payload_set(ereport, FM_EREPORT_PAYLOAD_ZFS_SUPPRESSED,
+		    DATA_TYPE_UINT64, suppressed, NULL);
+	}
+
 	if (vd != NULL) {
 		vdev_t *pvd = vd->vdev_parent;
 
@@ -1689,6 +1689,30 @@ zfs_ioc_pool_scan(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * inputs:
+ * zc_name              name of the pool
+ * zc_cookie            B_TRUE to start a trim, B_FALSE to stop one
+ */
+static int
+zfs_ioc_pool_trim(zfs_cmd_t *zc)
+{
+	spa_t *spa;
+	int error;
+
+	if ((error = spa_open(zc->zc_name, &spa, FTAG)) != 0)
+		return (error);
+
+	if (zc->zc_cookie)
+		error = spa_trim(spa);
+	else
+		spa_trim_stop(spa);
+
+	spa_close(spa, FTAG);
+
+	return (error);
+}
+
 static int
 zfs_ioc_pool_freeze(zfs_cmd_t *zc)
 {
@@ -1808,10 +1832,12 @@ zfs_ioc_obj_to_path(zfs_cmd_t *zc)
  * inputs:
  * zc_name		name of filesystem
  * zc_obj		object to find
+ * zc_flags		ZFS_OBJ_STATS_NAME for the name alone
  *
  * outputs:
  * zc_stat		stats on object
- * zc_value		path to object
+ * zc_value		path to object, or with ZFS_OBJ_STATS_NAME its name
+ * zc_cookie		with ZFS_OBJ_STATS_NAME, object number of its parent
  */
 static int
 zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
@@ -1826,8 +1852,13 @@ zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
 		dmu_objset_rele(os, FTAG);
 		return (SET_ERROR(EINVAL));
 	}
-	error = zfs_obj_to_stats(os, zc->zc_obj, &zc->zc_stat, zc->zc_value,
-	    sizeof (zc->zc_value));
+	if (zc->zc_flags & ZFS_OBJ_STATS_NAME) {
+		error = zfs_obj_to_name(os, zc->zc_obj, &zc->zc_stat,
+		    &zc->zc_cookie, zc->zc_value, sizeof (zc->zc_value));
+	} else {
+		error = zfs_obj_to_stats(os, zc->zc_obj, &zc->zc_stat,
+		    zc->zc_value, sizeof (zc->zc_value));
+	}
 	dmu_objset_rele(os, FTAG);
 
 	return (error);
@@ -2335,6 +2366,209 @@ zfs_ioc_snapshot_list_next(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Limits on a single ZFS_IOC_LIST batch.  The pool's config lock is held
+ * while a batch is gathered, so zfs_list_max_count bounds how long a
+ * listing holds off other config changes.  zfs_list_max_bytes keeps the
+ * packed batch within the buffer lzc_ioctl() starts with, so a batch is
+ * rarely gathered twice.
+ */
+int zfs_list_max_count = 1000;
+size_t zfs_list_max_bytes = 96 * 1024;
+
+/*
+ * Gather the objset stats and properties of one dataset for zfs_ioc_list().
+ * If 'props' is non-NULL, native properties not named in it are left out;
+ * user properties are always returned, as zfs_prune_proplist() keeps them.
+ */
+static int
+zfs_list_dataset(dsl_dataset_t *ds, nvlist_t *props, nvlist_t **entryp)
+{
+	dmu_objset_stats_t stat;
+	objset_t *os;
+	nvlist_t *nv, *stats, *entry;
+	nvpair_t *pair, *next;
+	int error;
+
+	if ((error = dmu_objset_from_ds(ds, &os)) != 0)
+		return (error);
+
+	dmu_objset_fast_stat(os, &stat);
+
+	if ((error = dsl_prop_get_all(os, &nv)) != 0)
+		return (error);
+	dmu_objset_stats(os, nv);
+	/* See the comment in zfs_ioc_objset_stats_impl(). */
+	if (!stat.dds_inconsistent && dmu_objset_type(os) == DMU_OST_ZVOL) {
+		error = zvol_get_stats(os, nv);
+		if (error == EIO) {
+			nvlist_free(nv);
+			return (error);
+		}
+		VERIFY0(error);
+	}
+
+	if (props != NULL) {
+		for (pair = nvlist_next_nvpair(nv, NULL); pair != NULL;
+		    pair = next) {
+			next = nvlist_next_nvpair(nv, pair);
+			if (zfs_name_to_prop(nvpair_name(pair)) != ZPROP_INVAL &&
+			    !nvlist_exists(props, nvpair_name(pair)))
+				fnvlist_remove_nvpair(nv, pair);
+		}
+	}
+
+	stats = fnvlist_alloc();
+	fnvlist_add_uint64(stats, "type", stat.dds_type);
+	fnvlist_add_uint64(stats, "num_clones", stat.dds_num_clones);
+	fnvlist_add_uint64(stats, "creation_txg", stat.dds_creation_txg);
+	fnvlist_add_uint64(stats, "guid", stat.dds_guid);
+	fnvlist_add_boolean_value(stats, "is_snapshot", stat.dds_is_snapshot);
+	fnvlist_add_boolean_value(stats, "inconsistent",
+	    stat.dds_inconsistent);
+	if (stat.dds_origin[0] != '\0')
+		fnvlist_add_string(stats, "origin", stat.dds_origin);
+
+	entry = fnvlist_alloc();
+	fnvlist_add_nvlist(entry, "stats", stats);
+	fnvlist_add_nvlist(entry, "props", nv);
+	fnvlist_free(stats);
+	nvlist_free(nv);
+
+	*entryp = entry;
+	return (0);
+}
+
+/*
+ * List the child filesystems or the snapshots of a dataset, many per call.
+ * Unlike ZFS_IOC_DATASET_LIST_NEXT and ZFS_IOC_SNAPSHOT_LIST_NEXT, the pool
+ * and parent are held once for the whole batch, and only the requested
+ * properties are returned.
+ *
+ * innvl: {
+ *     "snapshots" (optional) -> list snapshots instead of child filesystems
+ *     "simple" (optional) -> return only the names of snapshots, each
+ *         as a boolean
+ *     "cursor" -> uint64 (optional) returned by the previous call
+ *     "props" -> { prop 1, prop 2, ... } (optional) native properties to
+ *         return; all of them if absent
+ * }
+ *
+ * outnvl: {
+ *     "datasets" -> {
+ *         name 1 -> {
+ *             "stats" -> { "type", "guid", ... } (see zfs_list_dataset())
+ *             "props" -> { property 1, property 2, ... }
+ *         },
+ *         ...
+ *     }
+ *     "cursor" -> uint64, present if there are more datasets to list
+ * }
+ */
+static int
+zfs_ioc_list(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	boolean_t snapshots = nvlist_exists(innvl, "snapshots");
+	boolean_t simple = nvlist_exists(innvl, "simple");
+	boolean_t done;
+	uint64_t cursor = 0, id;
+	nvlist_t *props = NULL, *datasets, *entry;
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+	size_t prefixlen, bytes = 0;
+	dsl_pool_t *dp;
+	dsl_dataset_t *ds, *cds;
+	objset_t *os;
+	int count = 0;
+	int error;
+
+	(void) nvlist_lookup_uint64(innvl, "cursor", &cursor);
+	(void) nvlist_lookup_nvlist(innvl, "props", &props);
+
+	if (simple && !snapshots)
+		return (SET_ERROR(EINVAL));
+
+	if ((error = dsl_pool_hold(fsname, FTAG, &dp)) != 0)
+		return (error);
+	if ((error = dsl_dataset_hold(dp, fsname, FTAG, &ds)) != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+	if ((error = dmu_objset_from_ds(ds, &os)) != 0) {
+		dsl_dataset_rele(ds, FTAG);
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+
+	/* A name of maximum length cannot have any children. */
+	(void) strlcpy(name, fsname, sizeof (name));
+	prefixlen = strlcat(name, snapshots ? "@" : "/", sizeof (name));
+	done = (prefixlen >= sizeof (name));
+
+	/* The names are unique, so don't pay to check as each is added. */
+	VERIFY0(nvlist_alloc(&datasets, 0, KM_SLEEP));
+
+	while (!done && count < zfs_list_max_count &&
+	    bytes < zfs_list_max_bytes) {
+		if (snapshots) {
+			error = dmu_snapshot_list_next(os,
+			    sizeof (name) - prefixlen, name + prefixlen, &id,
+			    &cursor, NULL);
+		} else {
+			error = dmu_dir_list_next(os,
+			    sizeof (name) - prefixlen, name + prefixlen, NULL,
+			    &cursor);
+		}
+		if (error == ENOENT) {
+			error = 0;
+			done = B_TRUE;
+			break;
+		}
+		if (error != 0)
+			break;
+
+		if (!snapshots && dataset_name_hidden(name))
+			continue;
+
+		if (simple) {
+			fnvlist_add_boolean(datasets, name);
+			bytes += strlen(name) + 16;
+			count++;
+			continue;
+		}
+
+		if (snapshots)
+			error = dsl_dataset_hold_obj(dp, id, FTAG, &cds);
+		else
+			error = dsl_dataset_hold(dp, name, FTAG, &cds);
+		if (error == 0) {
+			error = zfs_list_dataset(cds, props, &entry);
+			dsl_dataset_rele(cds, FTAG);
+		}
+		if (error == ENOENT) {
+			error = 0;
+			continue;
+		}
+		if (error != 0)
+			break;
+
+		bytes += fnvlist_size(entry) + strlen(name);
+		fnvlist_add_nvlist(datasets, name, entry);
+		fnvlist_free(entry);
+		count++;
+	}
+
+	dsl_dataset_rele(ds, FTAG);
+	dsl_pool_rele(dp, FTAG);
+
+	if (error == 0) {
+		fnvlist_add_nvlist(outnvl, "datasets", datasets);
+		if (!done)
+			fnvlist_add_uint64(outnvl, "cursor", cursor);
+	}
+	nvlist_free(datasets);
+	return (error);
+}
+
 static int
 zfs_prop_set_userquota(const char *dsname, nvpair_t *pair)
 {
@@ -3866,6 +4100,48 @@ zfs_check_settable(const char *dsname, nvpair_t *pair, cred_t *cr)
 		}
 		break;
 
+	case ZFS_PROP_DNODESIZE:
+		/* Dnodes larger than 512 bytes need the large_dnode feature. */
+		if (nvpair_value_uint64(pair, &intval) == 0 &&
+		    intval != ZFS_DNSIZE_LEGACY) {
+			spa_t *spa;
+
+			if ((err = spa_open(dsname, &spa, FTAG)) != 0)
+				return (err);
+
+			if (!spa_feature_is_enabled(spa,
+			    SPA_FEATURE_LARGE_DNODE)) {
+				spa_close(spa, FTAG);
+				return (SET_ERROR(ENOTSUP));
+			}
+			spa_close(spa, FTAG);
+		}
+		break;
+
+	case ZFS_PROP_SPECIAL_SMALL_BLOCKS:
+		/*
+		 * Placing small blocks in the special class requires the
+		 * allocation_classes feature to be enabled.
+		 */
+		if (nvpair_value_uint64(pair, &intval) == 0 && intval != 0) {
+			spa_t *spa;
+
+			if (intval < SPA_MINBLOCKSIZE ||
+			    intval > SPA_MAXBLOCKSIZE || !ISP2(intval))
+				return (SET_ERROR(ERANGE));
+
+			if ((err = spa_open(dsname, &spa, FTAG)) != 0)
+				return (err);
+
+			if (!spa_feature_is_enabled(spa,
+			    SPA_FEATURE_ALLOCATION_CLASSES)) {
+				spa_close(spa, FTAG);
+				return (SET_ERROR(ENOTSUP));
+			}
+			spa_close(spa, FTAG);
+		}
+		break;
+
 	case ZFS_PROP_SHARESMB:
 		if (zpl_earlier_version(dsname, ZPL_VERSION_FUID))
 			return (SET_ERROR(ENOTSUP));
@@ -4416,6 +4692,7 @@ zfs_ioc_send(zfs_cmd_t *zc)
 	boolean_t estimate = (zc->zc_guid != 0);
 	boolean_t embedok = (zc->zc_flags & 0x1);
 	boolean_t large_block_ok = (zc->zc_flags & 0x2);
+	boolean_t compressok = (zc->zc_flags & 0x4);
 
 	if (zc->zc_obj != 0) {
 		dsl_pool_t *dp;
@@ -4477,7 +4754,7 @@ zfs_ioc_send(zfs_cmd_t *zc)
 
 		off = fp->f_offset;
 		error = dmu_send_obj(zc->zc_name, zc->zc_sendobj,
-		    zc->zc_fromobj, embedok, large_block_ok,
+		    zc->zc_fromobj, embedok, large_block_ok, compressok,
 		    zc->zc_cookie, fp->f_vnode, &off);
 
 		if (VOP_SEEK(fp->f_vnode, fp->f_offset, &off, NULL) == 0)
@@ -5407,6 +5684,8 @@ zfs_ioc_space_snaps(const char *lastsnap, nvlist_t *innvl, nvlist_t *outnvl)
  *         indicates that blocks > 128KB are permitted
  *     (optional) "embedok" -> (value ignored)
  *         presence indicates DRR_WRITE_EMBEDDED records are permitted
+ *     (optional) "compressok" -> (value ignored)
+ *         presence indicates compressed DRR_WRITE records are permitted
  *     (optional) "resume_object" and "resume_offset" -> (uint64)
  *         if present, resume send stream from specified object and offset.
  * }
@@ -5423,6 +5702,7 @@ zfs_ioc_send_new(const char *snapname, nvlist_t *innvl, nvlist_t *outnvl)
 	int fd;
 	boolean_t largeblockok;
 	boolean_t embedok;
+	boolean_t compressok;
 	uint64_t resumeobj = 0;
 	uint64_t resumeoff = 0;
 
@@ -5434,6 +5714,7 @@ zfs_ioc_send_new(const char *snapname, nvlist_t *innvl, nvlist_t *outnvl)
 
 	largeblockok = nvlist_exists(innvl, "largeblockok");
 	embedok = nvlist_exists(innvl, "embedok");
+	compressok = nvlist_exists(innvl, "compressok");
 
 	(void) nvlist_lookup_uint64(innvl, "resume_object", &resumeobj);
 	(void) nvlist_lookup_uint64(innvl, "resume_offset", &resumeoff);
@@ -5443,8 +5724,8 @@ zfs_ioc_send_new(const char *snapname, nvlist_t *innvl, nvlist_t *outnvl)
 		return (SET_ERROR(EBADF));
 
 	off = fp->f_offset;
-	error = dmu_send(snapname, fromname, embedok, largeblockok, fd,
-	    resumeobj, resumeoff, fp->f_vnode, &off);
+	error = dmu_send(snapname, fromname, embedok, largeblockok, compressok,
+	    fd, resumeobj, resumeoff, fp->f_vnode, &off);
 
 	if (VOP_SEEK(fp->f_vnode, fp->f_offset, &off, NULL) == 0)
 		fp->f_offset = off;
@@ -5696,6 +5977,10 @@ zfs_ioctl_init(void)
 	    zfs_ioc_get_bookmarks, zfs_secpolicy_read, DATASET_NAME,
 	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE);
 
+	zfs_ioctl_register("list", ZFS_IOC_LIST,
+	    zfs_ioc_list, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE);
+
 	zfs_ioctl_register("destroy_bookmarks", ZFS_IOC_DESTROY_BOOKMARKS,
 	    zfs_ioc_destroy_bookmarks, zfs_secpolicy_destroy_bookmarks,
 	    POOL_NAME,
@@ -5710,6 +5995,8 @@ zfs_ioctl_init(void)
 	    zfs_secpolicy_config, B_TRUE, POOL_CHECK_NONE);
 	zfs_ioctl_register_pool_modify(ZFS_IOC_POOL_SCAN,
 	    zfs_ioc_pool_scan);
+	zfs_ioctl_register_pool_modify(ZFS_IOC_POOL_TRIM,
+	    zfs_ioc_pool_trim);
 	zfs_ioctl_register_pool_modify(ZFS_IOC_POOL_UPGRADE,
 	    zfs_ioc_pool_upgrade);
 	zfs_ioctl_register_pool_modify(ZFS_IOC_VDEV_ADD,
@@ -93,63 +93,177 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using zfs_reduce_range.
+ * The end of file and block size are sampled before the range is locked
+ * and checked again once it is; if they changed, the lock is retried.
+ *
+ * Shards
+ * ------
+ * Random I/O to a large file (a VM image or a database) would serialize
+ * on the one z_range_lock even when none of the ranges overlap. So the
+ * file is divided into regions of 2^zfs_range_lock_shard_shift bytes, and
+ * region r belongs to shard (r % zfs_range_lock_shards). Each shard has
+ * its own mutex and AVL tree; shard 0 is z_range_lock and z_range_avl,
+ * the rest are in z_range_shards. A range that lies within one region is
+ * locked in that region's shard only, so disjoint I/O in different shards
+ * never touches the same mutex. A range that spans regions is locked as
+ * a chain of parts, one per shard it touches (every shard, for a whole
+ * file lock), each part covering the full range; the parts are locked in
+ * shard order so that two such locks can't deadlock. Any two overlapping
+ * ranges share the shard of a region they both cover, which is where the
+ * conflict is seen.
+ *
+ * Small files, which are most of them, never get the extra shards: a
+ * znode starts out with shard 0 only and is switched over the first time
+ * a range starting beyond its first region is locked while no other range
+ * is, so nothing already locked needs to move. The switch is one way;
+ * the shards are freed with the znode.
  */
 
 #include <sys/zfs_rlock.h>
 
 /*
- * Check if a write lock can be grabbed, or wait and recheck until available.
+ * Number of range lock shards, at most 64, for a large file; 1 disables
+ * sharding. See "Shards" above.
+ */
+uint_t zfs_range_lock_shards = 8;
+
+/* log2 of the bytes per region, each of which maps to one shard. */
+uint_t zfs_range_lock_shard_shift = 20;
+
+#define	RL_SHARD_LOCK(zp, s)	((s) == 0 ? &(zp)->z_range_lock : \
+	&(zp)->z_range_shards->rls_shard[(s) - 1].rs_lock)
+#define	RL_SHARD_AVL(zp, s)	((s) == 0 ? &(zp)->z_range_avl : \
+	&(zp)->z_range_shards->rls_shard[(s) - 1].rs_avl)
+
+/*
+ * Switch zp to sharded range locking. Called with z_range_lock held and
+ * no ranges locked; if memory is short we just carry on with one shard.
  */
 static void
-zfs_range_lock_writer(znode_t *zp, rl_t *new)
+zfs_range_shards_alloc(znode_t *zp)
+{
+	rl_shards_t *rls;
+	uint_t count = MIN(zfs_range_lock_shards, 64);
+	uint_t s;
+
+	ASSERT(MUTEX_HELD(&zp->z_range_lock));
+	ASSERT0(avl_numnodes(&zp->z_range_avl));
+	ASSERT3P(zp->z_range_shards, ==, NULL);
+
+	rls = kmem_alloc(RL_SHARDS_SIZE(count), KM_NOSLEEP);
+	if (rls == NULL)
+		return;
+	rls->rls_count = count;
+	rls->rls_shift = zfs_range_lock_shard_shift;
+	for (s = 0; s < count - 1; s++) {
+		mutex_init(&rls->rls_shard[s].rs_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+		avl_create(&rls->rls_shard[s].rs_avl, zfs_range_compare,
+		    sizeof (rl_t), offsetof(rl_t, r_node));
+	}
+	membar_producer();
+	zp->z_range_shards = rls;
+}
+
+/*
+ * Free the extra shards of an idle znode, if it has any.
+ */
+void
+zfs_range_free_shards(znode_t *zp)
+{
+	rl_shards_t *rls = zp->z_range_shards;
+	uint_t s;
+
+	if (rls == NULL)
+		return;
+
+	ASSERT0(avl_numnodes(&zp->z_range_avl));
+	for (s = 0; s < rls->rls_count - 1; s++) {
+		avl_destroy(&rls->rls_shard[s].rs_avl);
+		mutex_destroy(&rls->rls_shard[s].rs_lock);
+	}
+	kmem_free(rls, RL_SHARDS_SIZE(rls->rls_count));
+	zp->z_range_shards = NULL;
+}
+
+/*
+ * Return the set of shards, as a bit mask, covering [off, off + len).
+ */
+static uint64_t
+zfs_range_shard_mask(rl_shards_t *rls, uint64_t off, uint64_t len)
+{
+	uint64_t first = off >> rls->rls_shift;
+	uint64_t last = (len == 0) ? first : (off + len - 1) >> rls->rls_shift;
+	uint64_t mask = 0;
+
+	if (last - first >= rls->rls_count - 1) {
+		return (rls->rls_count == 64 ? UINT64_MAX :
+		    (1ULL << rls->rls_count) - 1);
+	}
+	for (; first <= last; first++)
+		mask |= 1ULL << (first % rls->rls_count);
+	return (mask);
+}
+
+/*
+ * Work out the range a writer needs to lock.
+ */
+static void
+zfs_range_writer_extent(znode_t *zp, rl_type_t type, uint64_t *offp,
+    uint64_t *lenp)
 {
-	avl_tree_t *tree = &zp->z_range_avl;
-	rl_t *rl;
-	avl_index_t where;
 	uint64_t end_size;
-	uint64_t off = new->r_off;
-	uint64_t len = new->r_len;
 
-	for (;;) {
-		/*
-		 * Range locking is also used by zvol and uses a
-		 * dummied up znode. However, for zvol, we don't need to
-		 * append or grow blocksize, and besides we don't have
-		 * a "sa" data or z_zfsvfs - so skip that processing.
-		 *
-		 * Yes, this is ugly, and would be solved by not handling
-		 * grow or append in range lock code. If that was done then
-		 * we could make the range locking code generically available
-		 * to other non-zfs consumers.
-		 */
-		if (zp->z_vnode) { /* caller is ZPL */
-			/*
-			 * If in append mode pick up the current end of file.
-			 * This is done under z_range_lock to avoid races.
-			 */
-			if (new->r_type == RL_APPEND)
-				new->r_off = zp->z_size;
+	/*
+	 * Range locking is also used by zvol and uses a
+	 * dummied up znode. However, for zvol, we don't need to
+	 * append or grow blocksize, and besides we don't have
+	 * a "sa" data or z_zfsvfs - so skip that processing.
+	 *
+	 * Yes, this is ugly, and would be solved by not handling
+	 * grow or append in range lock code. If that was done then
+	 * we could make the range locking code generically available
+	 * to other non-zfs consumers.
+	 */
+	if (zp->z_vnode == NULL)
+		return;
 
-			/*
-			 * If we need to grow the block size then grab the whole
-			 * file range. This is also done under z_range_lock to
-			 * avoid races.
-			 */
-			end_size = MAX(zp->z_size, new->r_off + len);
-			if (end_size > zp->z_blksz && (!ISP2(zp->z_blksz) ||
-			    zp->z_blksz < zp->z_zfsvfs->z_max_blksz)) {
-				new->r_off = 0;
-				new->r_len = UINT64_MAX;
-			}
-		}
+	/*
+	 * If in append mode pick up the current end of file.
+	 */
+	if (type == RL_APPEND)
+		*offp = zp->z_size;
+
+	/*
+	 * If we need to grow the block size then grab the whole
+	 * file range.
+	 */
+	end_size = MAX(zp->z_size, *offp + *lenp);
+	if (end_size > zp->z_blksz && (!ISP2(zp->z_blksz) ||
+	    zp->z_blksz < zp->z_zfsvfs->z_max_blksz)) {
+		*offp = 0;
+		*lenp = UINT64_MAX;
+	}
+}
 
+/*
+ * Check if a write lock can be grabbed, or wait and recheck until available.
+ * Returns B_FALSE if the znode's shards changed from rls while we waited.
+ */
+static boolean_t
+zfs_range_lock_writer(znode_t *zp, rl_t *new, rl_shards_t *rls)
+{
+	avl_tree_t *tree = RL_SHARD_AVL(zp, new->r_shard);
+	rl_t *rl;
+	avl_index_t where;
+
+	for (;;) {
 		/*
 		 * First check for the usual case of no locks
 		 */
 		if (avl_numnodes(tree) == 0) {
-			new->r_type = RL_WRITER; /* convert to writer */
 			avl_add(tree, new);
-			return;
+			return (B_TRUE);
 		}
 
 		/*
@@ -167,19 +281,16 @@ zfs_range_lock_writer(znode_t *zp, rl_t *new)
 		if (rl && rl->r_off + rl->r_len > new->r_off)
 			goto wait;
 
-		new->r_type = RL_WRITER; /* convert possible RL_APPEND */
 		avl_insert(tree, new, where);
-		return;
+		return (B_TRUE);
 wait:
 		if (!rl->r_write_wanted) {
 			cv_init(&rl->r_wr_cv, NULL, CV_DEFAULT, NULL);
 			rl->r_write_wanted = B_TRUE;
 		}
-		cv_wait(&rl->r_wr_cv, &zp->z_range_lock);
-
-		/* reset to original */
-		new->r_off = off;
-		new->r_len = len;
+		cv_wait(&rl->r_wr_cv, RL_SHARD_LOCK(zp, new->r_shard));
+		if (zp->z_range_shards != rls)
+			return (B_FALSE);
 	}
 }
 
@@ -351,20 +462,32 @@ zfs_range_add_reader(avl_tree_t *tree, rl_t *new, rl_t *prev, avl_index_t where)
 
 /*
  * Check if a reader lock can be grabbed, or wait and recheck until available.
+ * Returns B_FALSE if the znode's shards changed from rls while we waited.
  */
-static void
-zfs_range_lock_reader(znode_t *zp, rl_t *new)
+static boolean_t
+zfs_range_lock_reader(znode_t *zp, rl_t *new, rl_shards_t *rls)
 {
-	avl_tree_t *tree = &zp->z_range_avl;
+	avl_tree_t *tree = RL_SHARD_AVL(zp, new->r_shard);
+	kmutex_t *lock = RL_SHARD_LOCK(zp, new->r_shard);
 	rl_t *prev, *next;
 	avl_index_t where;
 	uint64_t off = new->r_off;
 	uint64_t len = new->r_len;
 
+	/*
+	 * First check for the usual case of no locks
+	 */
+	if (avl_numnodes(tree) == 0) {
+		avl_add(tree, new);
+		return (B_TRUE);
+	}
+
 	/*
 	 * Look for any writer locks in the range.
 	 */
 retry:
+	if (zp->z_range_shards != rls)
+		return (B_FALSE);
 	prev = avl_find(tree, new, &where);
 	if (prev == NULL)
 		prev = (rl_t *)avl_nearest(tree, where, AVL_BEFORE);
@@ -378,7 +501,7 @@ retry:
 				cv_init(&prev->r_rd_cv, NULL, CV_DEFAULT, NULL);
 				prev->r_read_wanted = B_TRUE;
 			}
-			cv_wait(&prev->r_rd_cv, &zp->z_range_lock);
+			cv_wait(&prev->r_rd_cv, lock);
 			goto retry;
 		}
 		if (off + len < prev->r_off + prev->r_len)
@@ -401,7 +524,7 @@ retry:
 				cv_init(&next->r_rd_cv, NULL, CV_DEFAULT, NULL);
 				next->r_read_wanted = B_TRUE;
 			}
-			cv_wait(&next->r_rd_cv, &zp->z_range_lock);
+			cv_wait(&next->r_rd_cv, lock);
 			goto retry;
 		}
 		if (off + len <= next->r_off + next->r_len)
@@ -414,8 +537,100 @@ got_lock:
 	 * locks and bumping ref counts (r_cnt).
 	 */
 	zfs_range_add_reader(tree, new, prev, where);
+	return (B_TRUE);
 }
 
+/*
+ * Lock rl, whose r_off, r_len, r_type and r_shard are set, in its shard.
+ * Called with the shard's mutex held.
+ */
+static boolean_t
+zfs_range_lock_one(znode_t *zp, rl_t *rl, rl_shards_t *rls)
+{
+	ASSERT(MUTEX_HELD(RL_SHARD_LOCK(zp, rl->r_shard)));
+
+	rl->r_cnt = 1; /* assume it's going to be in the tree */
+	rl->r_proxy = B_FALSE;
+	rl->r_write_wanted = B_FALSE;
+	rl->r_read_wanted = B_FALSE;
+
+	if (rl->r_type == RL_READER)
+		return (zfs_range_lock_reader(zp, rl, rls));
+	return (zfs_range_lock_writer(zp, rl, rls));
+}
+
+/*
+ * Lock [off, off + len) for the handle new, in as many shards as the range
+ * covers. Returns B_FALSE, with nothing locked, if the znode switched to
+ * sharded locking before we were done.
+ */
+static boolean_t
+zfs_range_lock_sharded(znode_t *zp, rl_t *new, uint64_t off, uint64_t len)
+{
+	rl_shards_t *rls = zp->z_range_shards;
+	rl_t *rl, **rlp;
+	uint64_t mask;
+	uint_t s;
+	boolean_t locked;
+
+	new->r_off = off;
+	new->r_len = len;
+	new->r_next = NULL;
+	new->r_multi = B_FALSE;
+
+	if (rls == NULL) {
+		new->r_shard = 0;
+		mutex_enter(&zp->z_range_lock);
+		if (zp->z_range_shards == NULL && zfs_range_lock_shards > 1 &&
+		    (off >> zfs_range_lock_shard_shift) != 0 &&
+		    avl_numnodes(&zp->z_range_avl) == 0)
+			zfs_range_shards_alloc(zp);
+		if (zp->z_range_shards != NULL)
+			locked = B_FALSE;
+		else
+			locked = zfs_range_lock_one(zp, new, NULL);
+		mutex_exit(&zp->z_range_lock);
+		return (locked);
+	}
+
+	mask = zfs_range_shard_mask(rls, off, len);
+	if (ISP2(mask)) {
+		/* The usual case: the range lies in a single shard */
+		new->r_shard = highbit64(mask) - 1;
+		mutex_enter(RL_SHARD_LOCK(zp, new->r_shard));
+		VERIFY(zfs_range_lock_one(zp, new, rls));
+		mutex_exit(RL_SHARD_LOCK(zp, new->r_shard));
+		return (B_TRUE);
+	}
+
+	/*
+	 * The handle stays out of the trees; lock a part in each shard, in
+	 * ascending order.
+	 */
+	new->r_multi = B_TRUE;
+	rlp = &new->r_next;
+	for (s = 0; mask != 0; s++, mask >>= 1) {
+		if ((mask & 1) == 0)
+			continue;
+		rl = kmem_alloc(sizeof (rl_t), KM_SLEEP);
+		rl->r_zp = zp;
+		rl->r_off = off;
+		rl->r_len = len;
+		rl->r_type = new->r_type;
+		rl->r_next = NULL;
+		rl->r_shard = s;
+		rl->r_multi = B_FALSE;
+		mutex_enter(RL_SHARD_LOCK(zp, s));
+		VERIFY(zfs_range_lock_one(zp, rl, rls));
+		mutex_exit(RL_SHARD_LOCK(zp, s));
+		*rlp = rl;
+		rlp = &rl->r_next;
+	}
+	return (B_TRUE);
+}
+
+static void zfs_range_release(rl_t *rl);
+
 /*
  * Lock a range (offset, length) as either shared (RL_READER)
  * or exclusive (RL_WRITER). Returns the range lock structure
@@ -426,33 +641,39 @@ rl_t *
 zfs_range_lock(znode_t *zp, uint64_t off, uint64_t len, rl_type_t type)
 {
 	rl_t *new;
+	uint64_t loff, llen, woff, wlen;
 
 	ASSERT(type == RL_READER || type == RL_WRITER || type == RL_APPEND);
 
-	new = kmem_alloc(sizeof (rl_t), KM_SLEEP);
-	new->r_zp = zp;
-	new->r_off = off;
 	if (len + off < off)	/* overflow */
 		len = UINT64_MAX - off;
-	new->r_len = len;
-	new->r_cnt = 1; /* assume it's going to be in the tree */
-	new->r_type = type;
-	new->r_proxy = B_FALSE;
-	new->r_write_wanted = B_FALSE;
-	new->r_read_wanted = B_FALSE;
-
-	mutex_enter(&zp->z_range_lock);
-	if (type == RL_READER) {
+
+	new = kmem_alloc(sizeof (rl_t), KM_SLEEP);
+	new->r_zp = zp;
+	/* RL_APPEND is converted to RL_WRITER */
+	new->r_type = (type == RL_READER) ? RL_READER : RL_WRITER;
+
+	for (;;) {
+		loff = off;
+		llen = len;
+		if (type != RL_READER)
+			zfs_range_writer_extent(zp, type, &loff, &llen);
+		if (!zfs_range_lock_sharded(zp, new, loff, llen))
+			continue;
+		if (type == RL_READER)
+			break;
+
 		/*
-		 * First check for the usual case of no locks
+		 * The end of file and block size might have changed before
+		 * we got the range; if so, lock the range they now call for.
 		 */
-		if (avl_numnodes(&zp->z_range_avl) == 0)
-			avl_add(&zp->z_range_avl, new);
-		else
-			zfs_range_lock_reader(zp, new);
-	} else
-		zfs_range_lock_writer(zp, new); /* RL_WRITER or RL_APPEND */
-	mutex_exit(&zp->z_range_lock);
+		woff = off;
+		wlen = len;
+		zfs_range_writer_extent(zp, type, &woff, &wlen);
+		if (woff == loff && wlen == llen)
+			break;
+		zfs_range_release(new);
+	}
 	return (new);
 }
 
@@ -460,9 +681,8 @@ zfs_range_lock(znode_t *zp, uint64_t off, uint64_t len, rl_type_t type)
  * Unlock a reader lock
  */
 static void
-zfs_range_unlock_reader(znode_t *zp, rl_t *remove)
+zfs_range_unlock_reader(avl_tree_t *tree, rl_t *remove)
 {
-	avl_tree_t *tree = &zp->z_range_avl;
 	rl_t *rl, *next = NULL;
 	uint64_t len;
 
@@ -520,26 +740,27 @@ zfs_range_unlock_reader(znode_t *zp, rl_t *remove)
 			}
 		}
 	}
-	kmem_free(remove, sizeof (rl_t));
 }
 
 /*
- * Unlock range and destroy range lock structure.
+ * Unlock rl in its shard; the caller frees it.
  */
-void
-zfs_range_unlock(rl_t *rl)
+static void
+zfs_range_unlock_one(rl_t *rl)
 {
 	znode_t *zp = rl->r_zp;
+	kmutex_t *lock = RL_SHARD_LOCK(zp, rl->r_shard);
 
 	ASSERT(rl->r_type == RL_WRITER || rl->r_type == RL_READER);
 	ASSERT(rl->r_cnt == 1 || rl->r_cnt == 0);
 	ASSERT(!rl->r_proxy);
+	ASSERT(!rl->r_multi);
 
-	mutex_enter(&zp->z_range_lock);
+	mutex_enter(lock);
 	if (rl->r_type == RL_WRITER) {
 		/* writer locks can't be shared or split */
-		avl_remove(&zp->z_range_avl, rl);
-		mutex_exit(&zp->z_range_lock);
+		avl_remove(RL_SHARD_AVL(zp, rl->r_shard), rl);
+		mutex_exit(lock);
 		if (rl->r_write_wanted) {
 			cv_broadcast(&rl->r_wr_cv);
 			cv_destroy(&rl->r_wr_cv);
@@ -548,45 +769,108 @@ zfs_range_unlock(rl_t *rl)
 			cv_broadcast(&rl->r_rd_cv);
 			cv_destroy(&rl->r_rd_cv);
 		}
-		kmem_free(rl, sizeof (rl_t));
 	} else {
 		/*
 		 * lock may be shared, let zfs_range_unlock_reader()
-		 * release the lock and free the rl_t
+		 * release the lock
 		 */
-		zfs_range_unlock_reader(zp, rl);
-		mutex_exit(&zp->z_range_lock);
+		zfs_range_unlock_reader(RL_SHARD_AVL(zp, rl->r_shard), rl);
+		mutex_exit(lock);
 	}
 }
 
 /*
- * Reduce range locked as RL_WRITER from whole file to specified range.
- * Asserts the whole file is exclusivly locked and so there's only one
- * entry in the tree.
+ * Unlock everything held through the handle rl, but keep the handle.
+ */
+static void
+zfs_range_release(rl_t *rl)
+{
+	rl_t *part, *next;
+
+	if (!rl->r_multi) {
+		zfs_range_unlock_one(rl);
+		return;
+	}
+	for (part = rl->r_next; part != NULL; part = next) {
+		next = part->r_next;
+		zfs_range_unlock_one(part);
+		kmem_free(part, sizeof (rl_t));
+	}
+	rl->r_next = NULL;
+}
+
+/*
+ * Unlock range and destroy range lock structure.
  */
 void
-zfs_range_reduce(rl_t *rl, uint64_t off, uint64_t len)
+zfs_range_unlock(rl_t *rl)
+{
+	zfs_range_release(rl);
+	kmem_free(rl, sizeof (rl_t));
+}
+
+/*
+ * Reduce a whole file RL_WRITER lock held in one shard.
+ */
+static void
+zfs_range_reduce_one(rl_t *rl, uint64_t off, uint64_t len)
 {
 	znode_t *zp = rl->r_zp;
+	kmutex_t *lock = RL_SHARD_LOCK(zp, rl->r_shard);
 
 	/* Ensure there are no other locks */
-	ASSERT(avl_numnodes(&zp->z_range_avl) == 1);
+	ASSERT(avl_numnodes(RL_SHARD_AVL(zp, rl->r_shard)) == 1);
 	ASSERT(rl->r_off == 0);
 	ASSERT(rl->r_type == RL_WRITER);
 	ASSERT(!rl->r_proxy);
 	ASSERT3U(rl->r_len, ==, UINT64_MAX);
 	ASSERT3U(rl->r_cnt, ==, 1);
 
-	mutex_enter(&zp->z_range_lock);
+	mutex_enter(lock);
 	rl->r_off = off;
 	rl->r_len = len;
-	mutex_exit(&zp->z_range_lock);
+	mutex_exit(lock);
 	if (rl->r_write_wanted)
 		cv_broadcast(&rl->r_wr_cv);
 	if (rl->r_read_wanted)
 		cv_broadcast(&rl->r_rd_cv);
 }
 
+/*
+ * Reduce range locked as RL_WRITER from whole file to specified range.
+ * Asserts the whole file is exclusivly locked and so there's only one
+ * entry in each shard's tree. Parts of the lock in shards the new range
+ * doesn't cover are dropped.
+ */
+void
+zfs_range_reduce(rl_t *rl, uint64_t off, uint64_t len)
+{
+	rl_t *part, **partp;
+	uint64_t mask;
+
+	if (!rl->r_multi) {
+		zfs_range_reduce_one(rl, off, len);
+		return;
+	}
+
+	ASSERT(rl->r_off == 0);
+	ASSERT3U(rl->r_len, ==, UINT64_MAX);
+	rl->r_off = off;
+	rl->r_len = len;
+
+	mask = zfs_range_shard_mask(rl->r_zp->z_range_shards, off, len);
+	for (partp = &rl->r_next; (part = *partp) != NULL; ) {
+		if (mask & (1ULL << part->r_shard)) {
+			zfs_range_reduce_one(part, off, len);
+			partp = &part->r_next;
+		} else {
+			*partp = part->r_next;
+			zfs_range_unlock_one(part);
+			kmem_free(part, sizeof (rl_t));
+		}
+	}
+}
+
 /*
  * AVL comparison function used to order range locks
  * Locks are ordered on the start offset of the range.
@@ -2502,22 +2502,17 @@ zfs_getattr(vnode_t *vp, vattr_t *vap, int flags, cred_t *cr,
 	zfsvfs_t *zfsvfs = zp->z_zfsvfs;
 	int	error = 0;
 	uint64_t links;
-	uint64_t mtime[2], ctime[2];
+	zfs_stat_snap_t zss;
 	xvattr_t *xvap = (xvattr_t *)vap;	/* vap may be an xvattr_t * */
 	xoptattr_t *xoap = NULL;
 	boolean_t skipaclchk = (flags & ATTR_NOACLCHECK) ? B_TRUE : B_FALSE;
-	sa_bulk_attr_t bulk[2];
-	int count = 0;
 
 	ZFS_ENTER(zfsvfs);
 	ZFS_VERIFY_ZP(zp);
 
 	zfs_fuid_map_ids(zp, cr, &vap->va_uid, &vap->va_gid);
 
-	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL, &mtime, 16);
-	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL, &ctime, 16);
-
-	if ((error = sa_bulk_lookup(zp->z_sa_hdl, bulk, count)) != 0) {
+	if ((error = zfs_stat_snapshot(zp, &zss)) != 0) {
 		ZFS_EXIT(zfsvfs);
 		return (error);
 	}
@@ -2663,8 +2658,8 @@ zfs_getattr(vnode_t *vp, vattr_t *vap, int flags, cred_t *cr,
 	}
 
 	ZFS_TIME_DECODE(&vap->va_atime, zp->z_atime);
-	ZFS_TIME_DECODE(&vap->va_mtime, mtime);
-	ZFS_TIME_DECODE(&vap->va_ctime, ctime);
+	ZFS_TIME_DECODE(&vap->va_mtime, zss.zss_mtime);
+	ZFS_TIME_DECODE(&vap->va_ctime, zss.zss_ctime);
 
 	mutex_exit(&zp->z_lock);
 
@@ -4669,7 +4664,8 @@ out:
  * - this calls VOP_MAP(), which takes you into (say) zfs
  * - zfs_map() calls as_map(), passing segvn_create() as the callback
  * - segvn_create() creates the new segment and calls VOP_ADDMAP()
- * - zfs_addmap() updates z_mapcnt
+ * - zfs_addmap() updates z_mapcnt, and tells fsflush about vnodes that may
+ *   now be modified through a (MAP_SHARED, PROT_WRITE) mapping
  */
 /*ARGSUSED*/
 static int
@@ -4755,6 +4751,10 @@ zfs_addmap(vnode_t *vp, offset_t off, struct as *as, caddr_t addr,
 	uint64_t pages = btopr(len);
 
 	atomic_add_64(&VTOZ(vp)->z_mapcnt, pages);
+
+	if ((flags & MAP_SHARED) && (maxprot & PROT_WRITE))
+		fsflush_dirty_vnode(vp);
+
 	return (0);
 }
 
@@ -5181,6 +5181,13 @@ zfs_retzcbuf(vnode_t *vp, xuio_t *xuio, cred_t *cr, caller_context_t *ct)
 
 	ASSERT(xuio->xu_type == UIOTYPE_ZEROCOPY);
 
+	/*
+	 * A read that failed or found nothing to read before zfs_read()
+	 * set up the xuio has no buffers on loan.
+	 */
+	if (XUIO_XUZC_PRIV(xuio) == NULL)
+		return (0);
+
 	i = dmu_xuio_cnt(xuio);
 	while (i-- > 0) {
 		abuf = dmu_xuio_arcbuf(xuio, i);
@@ -134,6 +134,7 @@ zfs_znode_cache_constructor(void *buf, void *arg, int kmflags)
 	mutex_init(&zp->z_range_lock, NULL, MUTEX_DEFAULT, NULL);
 	avl_create(&zp->z_range_avl, zfs_range_compare,
 	    sizeof (rl_t), offsetof(rl_t, r_node));
+	zp->z_range_shards = NULL;
 
 	zp->z_dirlocks = NULL;
 	zp->z_acl_cached = NULL;
@@ -155,6 +156,7 @@ zfs_znode_cache_destructor(void *buf, void *arg)
 	rw_destroy(&zp->z_parent_lock);
 	rw_destroy(&zp->z_name_lock);
 	mutex_destroy(&zp->z_acl_lock);
+	ASSERT(zp->z_range_shards == NULL);
 	avl_destroy(&zp->z_range_avl);
 	mutex_destroy(&zp->z_range_lock);
 
@@ -192,6 +194,8 @@ zfs_znode_move_impl(znode_t *ozp, znode_t *nzp)
 	nzp->z_id = ozp->z_id;
 	ASSERT(ozp->z_dirlocks == NULL); /* znode not in use */
 	ASSERT(avl_numnodes(&ozp->z_range_avl) == 0);
+	nzp->z_range_shards = ozp->z_range_shards;
+	ozp->z_range_shards = NULL;
 	nzp->z_unlinked = ozp->z_unlinked;
 	nzp->z_atime_dirty = ozp->z_atime_dirty;
 	nzp->z_zn_prefetch = ozp->z_zn_prefetch;
@@ -613,6 +617,27 @@ zfs_znode_dmu_fini(znode_t *zp)
 	zp->z_sa_hdl = NULL;
 }
 
+/*
+ * Register the attributes in a zfs_stat_snap_t with the SA layer, in
+ * the order they appear there; every layout zfs_mknode() builds keeps
+ * them adjacent, so zfs_stat_snapshot() is normally a single copy.
+ */
+void
+zfs_stat_snapshot_init(zfsvfs_t *zfsvfs)
+{
+	sa_attr_type_t attrs[2];
+
+	attrs[0] = SA_ZPL_MTIME(zfsvfs);
+	attrs[1] = SA_ZPL_CTIME(zfsvfs);
+	sa_register_snapshot(zfsvfs->z_os, attrs, 2);
+}
+
+int
+zfs_stat_snapshot(znode_t *zp, zfs_stat_snap_t *zss)
+{
+	return (sa_lookup_snapshot(zp->z_sa_hdl, zss, sizeof (*zss)));
+}
+
 /*
  * Construct a new znode/vnode and intialize.
  *
@@ -692,6 +717,7 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 			vn_setops(vp, zfs_dvnodeops);
 		}
 		zp->z_zn_prefetch = B_TRUE; /* z_prefetch default is enabled */
+		zfs_znode_dnlcsearch(zp);
 		break;
 	case VBLK:
 	case VCHR:
@@ -776,6 +802,7 @@ zfs_mknode(znode_t *dzp, vattr_t *vap, dmu_tx_t *tx, cred_t *cr,
 	dmu_object_type_t obj_type;
 	sa_bulk_attr_t	sa_attrs[ZPL_END];
 	int		cnt = 0;
+	int		dnodesize;
 	zfs_acl_locator_cb_t locate = { 0 };
 
 	ASSERT(vap && (vap->va_mask & (AT_TYPE|AT_MODE)) == (AT_TYPE|AT_MODE));
@@ -790,9 +817,19 @@ zfs_mknode(znode_t *dzp, vattr_t *vap, dmu_tx_t *tx, cred_t *cr,
 		gen = dmu_tx_get_txg(tx);
 	}
 
+	/*
+	 * SA znodes get the dataset's dnode size, so that the bonus buffer
+	 * has room for xattrs and large ACLs.  Objects claimed during
+	 * replay stay legacy-sized: the log record does not say how large
+	 * the original dnode was, and a single slot is always free.
+	 */
 	obj_type = zfsvfs->z_use_sa ? DMU_OT_SA : DMU_OT_ZNODE;
+	if (obj_type == DMU_OT_SA && !zfsvfs->z_replay)
+		dnodesize = dmu_objset_dnodesize(zfsvfs->z_os);
+	else
+		dnodesize = DNODE_MIN_SIZE;
 	bonuslen = (obj_type == DMU_OT_SA) ?
-	    DN_MAX_BONUSLEN : ZFS_OLD_ZNODE_PHYS_SIZE;
+	    DN_BONUS_SIZE(dnodesize) : ZFS_OLD_ZNODE_PHYS_SIZE;
 
 	/*
 	 * Create a new DMU object.
@@ -809,9 +846,9 @@ zfs_mknode(znode_t *dzp, vattr_t *vap, dmu_tx_t *tx, cred_t *cr,
 			    zfsvfs->z_norm, DMU_OT_DIRECTORY_CONTENTS,
 			    obj_type, bonuslen, tx));
 		} else {
-			obj = zap_create_norm(zfsvfs->z_os,
+			obj = zap_create_norm_dnsize(zfsvfs->z_os,
 			    zfsvfs->z_norm, DMU_OT_DIRECTORY_CONTENTS,
-			    obj_type, bonuslen, tx);
+			    obj_type, bonuslen, dnodesize, tx);
 		}
 	} else {
 		if (zfsvfs->z_replay) {
@@ -819,9 +856,9 @@ zfs_mknode(znode_t *dzp, vattr_t *vap, dmu_tx_t *tx, cred_t *cr,
 			    DMU_OT_PLAIN_FILE_CONTENTS, 0,
 			    obj_type, bonuslen, tx));
 		} else {
-			obj = dmu_object_alloc(zfsvfs->z_os,
+			obj = dmu_object_alloc_dnsize(zfsvfs->z_os,
 			    DMU_OT_PLAIN_FILE_CONTENTS, 0,
-			    obj_type, bonuslen, tx);
+			    obj_type, bonuslen, dnodesize, tx);
 		}
 	}
 
@@ -1000,6 +1037,7 @@ zfs_mknode(znode_t *dzp, vattr_t *vap, dmu_tx_t *tx, cred_t *cr,
 	    acl_ids->z_aclp->z_version < ZFS_ACL_VERSION_FUID) {
 		VERIFY0(zfs_aclset_common(*zpp, acl_ids->z_aclp, cr, tx));
 	}
+	zfs_znode_dnlcsearch(*zpp);
 	ZFS_OBJ_HOLD_EXIT(zfsvfs, obj);
 }
 
@@ -1096,6 +1134,29 @@ zfs_xvattr_set(znode_t *zp, xvattr_t *xvap, dmu_tx_t *tx)
 		    zp->z_pflags, tx);
 		XVA_SET_RTN(xvap, XAT_SPARSE);
 	}
+	zfs_znode_dnlcsearch(zp);
+}
+
+/*
+ * Let the lockless DNLC path walk (see dnlc_lookup_path()) pass through
+ * this directory if zfs_fastaccesschk_execute() would let anyone search it.
+ * Must be called whenever z_pflags may have changed.
+ */
+void
+zfs_znode_dnlcsearch(znode_t *zp)
+{
+	vnode_t *vp = ZTOV(zp);
+
+	if (vp->v_type != VDIR)
+		return;
+
+	mutex_enter(&vp->v_lock);
+	if ((zp->z_pflags & (ZFS_NO_EXECS_DENIED | ZFS_AV_QUARANTINED |
+	    ZFS_XATTR)) == ZFS_NO_EXECS_DENIED)
+		vp->v_flag |= V_DNLCSEARCH;
+	else
+		vp->v_flag &= ~V_DNLCSEARCH;
+	mutex_exit(&vp->v_lock);
 }
 
 int
@@ -1252,6 +1313,7 @@ zfs_rezget(znode_t *zp)
 
 	zp->z_unlinked = (zp->z_links == 0);
 	zp->z_blksz = doi.doi_data_block_size;
+	zfs_znode_dnlcsearch(zp);
 
 	ZFS_OBJ_HOLD_EXIT(zfsvfs, obj_num);
 
@@ -1349,6 +1411,8 @@ zfs_znode_free(znode_t *zp)
 		zp->z_acl_cached = NULL;
 	}
 
+	zfs_range_free_shards(zp);
+
 	kmem_cache_free(znode_cache, zp);
 
 	VFS_RELE(zfsvfs->z_vfs);
@@ -2128,3 +2192,47 @@ zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
 	zfs_release_sa_handle(hdl, db, FTAG);
 	return (error);
 }
+
+/*
+ * As zfs_obj_to_stats(), but only look up the object's name in its parent
+ * directory, which is returned in *pobjp, rather than its whole path.
+ * The root directory is its own parent, and has an empty name.
+ */
+int
+zfs_obj_to_name(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
+    uint64_t *pobjp, char *buf, int len)
+{
+	sa_attr_type_t *sa_table;
+	sa_handle_t *hdl;
+	dmu_buf_t *db;
+	int is_xattrdir;
+	int error;
+
+	ASSERT3S(len, >=, MAXNAMELEN);
+	*buf = '\0';
+
+	error = zfs_sa_setup(osp, &sa_table);
+	if (error != 0)
+		return (error);
+
+	error = zfs_grab_sa_handle(osp, obj, &hdl, &db, FTAG);
+	if (error != 0)
+		return (error);
+
+	error = zfs_obj_to_stats_impl(hdl, sa_table, sb);
+	if (error == 0) {
+		error = zfs_obj_to_pobj(osp, hdl, sa_table, pobjp,
+		    &is_xattrdir);
+	}
+	if (error == 0 && *pobjp != obj) {
+		if (is_xattrdir) {
+			(void) strlcpy(buf, "<xattrdir>", len);
+		} else {
+			error = zap_value_search(osp, *pobjp, obj,
+			    ZFS_DIRENT_OBJ(-1ULL), buf);
+		}
+	}
+
+	zfs_release_sa_handle(hdl, db, FTAG);
+	return (error);
+}
@@ -774,12 +774,10 @@ zil_add_block(zilog_t *zilog, const blkptr_t *bp)
 	if (zfs_nocacheflush)
 		return;
 
-	ASSERT(zilog->zl_writer);
-
 	/*
-	 * Even though we're zl_writer, we still need a lock because the
-	 * zl_get_data() callbacks may have dmu_sync() done callbacks
-	 * that will run concurrently.
+	 * We need a lock here: the zl_get_data() callbacks may have
+	 * dmu_sync() done callbacks that run concurrently with the writer,
+	 * and possibly after it has handed zl_writer to the next batch.
 	 */
 	mutex_enter(&zilog->zl_vdev_lock);
 	for (i = 0; i < ndvas; i++) {
@@ -793,21 +791,45 @@ zil_add_block(zilog_t *zilog, const blkptr_t *bp)
 	mutex_exit(&zilog->zl_vdev_lock);
 }
 
+/*
+ * Collect the vdevs that must be flushed to make the given commit batch
+ * stable.  Since the next batch may already be issuing log writes (and
+ * adding to zl_vdev_tree) while this one completes, we can only empty
+ * zl_vdev_tree when no later batch has started; otherwise its entries are
+ * left in place for that batch to flush as well.
+ */
 static void
-zil_flush_vdevs(zilog_t *zilog)
+zil_get_flush_vdevs(zilog_t *zilog, uint64_t batch, avl_tree_t *t)
+{
+	avl_tree_t *zt = &zilog->zl_vdev_tree;
+	boolean_t last = (zilog->zl_next_batch == batch + 1);
+	void *cookie = NULL;
+	zil_vdev_node_t *zv, *nzv;
+
+	ASSERT(MUTEX_HELD(&zilog->zl_lock));
+
+	mutex_enter(&zilog->zl_vdev_lock);
+	if (last) {
+		while ((zv = avl_destroy_nodes(zt, &cookie)) != NULL)
+			avl_add(t, zv);
+	} else {
+		for (zv = avl_first(zt); zv != NULL; zv = AVL_NEXT(zt, zv)) {
+			nzv = kmem_alloc(sizeof (*nzv), KM_SLEEP);
+			nzv->zv_vdev = zv->zv_vdev;
+			avl_add(t, nzv);
+		}
+	}
+	mutex_exit(&zilog->zl_vdev_lock);
+}
+
+static void
+zil_flush_vdevs(zilog_t *zilog, avl_tree_t *t)
 {
 	spa_t *spa = zilog->zl_spa;
-	avl_tree_t *t = &zilog->zl_vdev_tree;
 	void *cookie = NULL;
 	zil_vdev_node_t *zv;
 	zio_t *zio;
 
-	ASSERT(zilog->zl_writer);
-
-	/*
-	 * We don't need zl_vdev_lock here because we're the zl_writer,
-	 * and all zl_get_data() callbacks are done.
-	 */
 	if (avl_numnodes(t) == 0)
 		return;
 
@@ -1452,15 +1474,33 @@ zil_async_to_sync(zilog_t *zilog, uint64_t foid)
 	}
 }
 
+/*
+ * Write out the itxs on the commit list for batch "mybatch".  Called with
+ * zl_lock held and zl_writer set; returns with zl_lock held, zl_writer
+ * clear and the batch marked committed.
+ *
+ * zl_writer only covers building and issuing the log blocks.  As soon as
+ * the last lwb of this batch has been issued it is handed to the next
+ * batch, so that batch's log blocks are written while ours are still in
+ * flight.  Batches still complete in order, though: a batch is not
+ * reported as committed until the batch before it is, because its log
+ * blocks are only reachable through the earlier ones.
+ */
 static void
-zil_commit_writer(zilog_t *zilog)
+zil_commit_writer(zilog_t *zilog, uint64_t mybatch)
 {
 	uint64_t txg;
+	uint64_t lr_seq;
 	itx_t *itx;
 	lwb_t *lwb;
+	zio_t *root_zio;
+	avl_tree_t flush_tree;
 	spa_t *spa = zilog->zl_spa;
+	boolean_t need_sync, handoff;
 	int error = 0;
 
+	ASSERT(MUTEX_HELD(&zilog->zl_lock));
+	ASSERT(zilog->zl_writer);
 	ASSERT(zilog->zl_root_zio == NULL);
 
 	mutex_exit(&zilog->zl_lock);
@@ -1468,12 +1508,14 @@ zil_commit_writer(zilog_t *zilog)
 	zil_get_commit_list(zilog);
 
 	/*
-	 * Return if there's nothing to commit before we dirty the fs by
-	 * calling zil_create().
+	 * If there's nothing to commit, don't dirty the fs by calling
+	 * zil_create().  We must still wait for the earlier batches,
+	 * which may be carrying our itxs.
 	 */
 	if (list_head(&zilog->zl_itx_commit_list) == NULL) {
-		mutex_enter(&zilog->zl_lock);
-		return;
+		lwb = NULL;
+		need_sync = B_FALSE;
+		goto out;
 	}
 
 	if (zilog->zl_suspend) {
@@ -1501,18 +1543,58 @@ zil_commit_writer(zilog_t *zilog)
 	if (lwb != NULL && lwb->lwb_zio != NULL)
 		lwb = zil_lwb_write_start(zilog, lwb);
 
+	/*
+	 * If there was an allocation failure (lwb == NULL) we must fall
+	 * back to txg_wait_synced() below.
+	 */
+	need_sync = (lwb == NULL);
+
+out:
 	zilog->zl_cur_used = 0;
+	root_zio = zilog->zl_root_zio;
+	zilog->zl_root_zio = NULL;
+	lr_seq = zilog->zl_lr_seq;
 
 	/*
-	 * Wait if necessary for the log blocks to be on stable storage.
+	 * Let the next batch start writing while we wait for our log
+	 * blocks to reach stable storage.  If we failed to allocate a log
+	 * block, the lwb list has no open block for it to continue from
+	 * until the txg syncs, so in that case we hold on to zl_writer.
 	 */
-	if (zilog->zl_root_zio) {
-		error = zio_wait(zilog->zl_root_zio);
-		zilog->zl_root_zio = NULL;
-		zil_flush_vdevs(zilog);
+	handoff = !need_sync;
+	if (handoff) {
+		mutex_enter(&zilog->zl_lock);
+		zilog->zl_writer = B_FALSE;
+		cv_broadcast(&zilog->zl_cv_batch[(mybatch + 1) & 1]);
+		mutex_exit(&zilog->zl_lock);
 	}
 
-	if (error || lwb == NULL)
+	if (root_zio != NULL)
+		error = zio_wait(root_zio);
+
+	mutex_enter(&zilog->zl_lock);
+	while (zilog->zl_com_batch + 1 < mybatch) {
+		cv_wait(&zilog->zl_cv_batch[(mybatch - 1) & 1],
+		    &zilog->zl_lock);
+	}
+
+	/*
+	 * If an earlier batch could not write its log blocks while ours
+	 * were being issued, ours follow a hole in the log chain and can't
+	 * be replayed, so we must also wait for the txg to sync.
+	 */
+	if (error != 0 || mybatch < zilog->zl_sync_batch)
+		need_sync = B_TRUE;
+
+	avl_create(&flush_tree, zil_vdev_compare,
+	    sizeof (zil_vdev_node_t), offsetof(zil_vdev_node_t, zv_node));
+	zil_get_flush_vdevs(zilog, mybatch, &flush_tree);
+	mutex_exit(&zilog->zl_lock);
+
+	zil_flush_vdevs(zilog, &flush_tree);
+	avl_destroy(&flush_tree);
+
+	if (need_sync)
 		txg_wait_synced(zilog->zl_dmu_pool, 0);
 
 	mutex_enter(&zilog->zl_lock);
@@ -1522,8 +1604,32 @@ zil_commit_writer(zilog_t *zilog)
 	 * We only update this value when all the log writes succeeded,
 	 * because ztest wants to ASSERT that it got the whole log chain.
 	 */
-	if (error == 0 && lwb != NULL)
-		zilog->zl_commit_lr_seq = zilog->zl_lr_seq;
+	if (root_zio != NULL && error == 0 && lwb != NULL)
+		zilog->zl_commit_lr_seq = lr_seq;
+
+	/*
+	 * If our log writes failed, every batch that may have started
+	 * issuing log blocks behind them before our txg sync finished must
+	 * wait for a txg sync too.  The sync freed the failed blocks and
+	 * moved the log header past them, so the log blocks of batches
+	 * started after it are reachable.  zl_sync_batch only grows, so a
+	 * later batch that commits cleanly doesn't excuse the batches
+	 * still in flight behind the hole.
+	 */
+	if (error != 0) {
+		ASSERT(need_sync);
+		zilog->zl_sync_batch = MAX(zilog->zl_sync_batch,
+		    zilog->zl_next_batch);
+	}
+	zilog->zl_com_batch = mybatch;
+
+	if (!handoff) {
+		zilog->zl_writer = B_FALSE;
+		cv_broadcast(&zilog->zl_cv_batch[(mybatch + 1) & 1]);
+	}
+
+	/* wake up all threads waiting for this batch to be committed */
+	cv_broadcast(&zilog->zl_cv_batch[mybatch & 1]);
 }
 
 /*
@@ -1537,17 +1643,15 @@ zil_commit_writer(zilog_t *zilog)
  * Those cthreads are all waiting on the same cv for that batch.
  *
  * There will also be a different and growing batch of threads that are
- * waiting to commit (qthreads). When the committing batch completes
- * a transition occurs such that the cthreads exit and the qthreads become
- * cthreads. One of the new cthreads becomes the writer thread for the
- * batch. Any new threads arriving become new qthreads.
- *
- * Only 2 condition variables are needed and there's no transition
- * between the two cvs needed. They just flip-flop between qthreads
- * and cthreads.
+ * waiting to commit (qthreads). Once the writer has issued all the log
+ * blocks for its batch, one of the qthreads becomes the writer for the
+ * next batch and starts issuing its log blocks, while the first batch's
+ * writes are still in progress.  Batches are committed strictly in order,
+ * and every thread is woken when the batch it belongs to is committed.
  *
- * Using this scheme we can efficiently wakeup up only those threads
- * that have been committed.
+ * Only 2 condition variables are needed: a batch and its successor wait on
+ * different cvs, and a thread always re-checks zl_com_batch on wakeup, so
+ * it doesn't matter that batches two apart share one.
  */
 void
 zil_commit(zilog_t *zilog, uint64_t foid)
@@ -1562,26 +1666,26 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 
 	mutex_enter(&zilog->zl_lock);
 	mybatch = zilog->zl_next_batch;
-	while (zilog->zl_writer) {
-		cv_wait(&zilog->zl_cv_batch[mybatch & 1], &zilog->zl_lock);
+	for (;;) {
 		if (mybatch <= zilog->zl_com_batch) {
 			mutex_exit(&zilog->zl_lock);
 			return;
 		}
+		/*
+		 * If a writer has already been chosen for our batch
+		 * (zl_next_batch has moved on), it carries our itxs and we
+		 * just wait for it; otherwise we become its writer as soon
+		 * as the previous one has issued its writes.
+		 */
+		if (!zilog->zl_writer && mybatch == zilog->zl_next_batch)
+			break;
+		cv_wait(&zilog->zl_cv_batch[mybatch & 1], &zilog->zl_lock);
 	}
 
 	zilog->zl_next_batch++;
 	zilog->zl_writer = B_TRUE;
-	zil_commit_writer(zilog);
-	zilog->zl_com_batch = mybatch;
-	zilog->zl_writer = B_FALSE;
+	zil_commit_writer(zilog, mybatch);
 	mutex_exit(&zilog->zl_lock);
-
-	/* wake up one thread to become the next writer */
-	cv_signal(&zilog->zl_cv_batch[(mybatch+1) & 1]);
-
-	/* wake up all threads waiting for this batch to be committed */
-	cv_broadcast(&zilog->zl_cv_batch[mybatch & 1]);
 }
 
 /*
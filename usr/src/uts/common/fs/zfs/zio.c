@@ -105,6 +105,8 @@ int zio_buf_debug_limit = 0;
 #endif
 
 static void zio_taskq_dispatch(zio_t *, zio_taskq_type_t, boolean_t);
+static void zio_trace_init(void);
+static void zio_trace_fini(void);
 
 void
 zio_init(void)
@@ -178,7 +180,9 @@ zio_init(void)
 			zio_data_buf_cache[c - 1] = zio_data_buf_cache[c];
 	}
 
+	zio_compress_init();
 	zio_inject_init();
+	zio_trace_init();
 }
 
 void
@@ -205,7 +209,9 @@ zio_fini(void)
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
+	zio_compress_fini();
 	zio_inject_fini();
+	zio_trace_fini();
 }
 
 /*
@@ -576,6 +582,7 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 	zio->io_offset = offset;
 	zio->io_orig_data = zio->io_data = data;
 	zio->io_orig_size = zio->io_size = size;
+	zio->io_lsize = size;
 	zio->io_orig_flags = zio->io_flags = flags;
 	zio->io_orig_stage = zio->io_stage = stage;
 	zio->io_orig_pipeline = zio->io_pipeline = pipeline;
@@ -727,9 +734,15 @@ zio_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
 	return (zio);
 }
 
+/*
+ * Normally lsize == psize and the data is compressed (if requested) by the
+ * write pipeline.  A ZIO_FLAG_RAW write instead supplies psize bytes of
+ * data that are already compressed with zp_compress, and lsize is the
+ * logical size recorded in the block pointer.
+ */
 zio_t *
 zio_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
-    void *data, uint64_t size, const zio_prop_t *zp,
+    void *data, uint64_t lsize, uint64_t psize, const zio_prop_t *zp,
     zio_done_func_t *ready, zio_done_func_t *children_ready,
     zio_done_func_t *physdone, zio_done_func_t *done,
     void *private, zio_priority_t priority, enum zio_flag flags,
@@ -745,12 +758,16 @@ zio_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
 	    zp->zp_level < 32 &&
 	    zp->zp_copies > 0 &&
 	    zp->zp_copies <= spa_max_replication(spa));
+	ASSERT(lsize == psize || (flags & ZIO_FLAG_RAW));
+	ASSERT(!(flags & ZIO_FLAG_RAW) ||
+	    (!zp->zp_dedup && !zp->zp_nopwrite));
 
-	zio = zio_create(pio, spa, txg, bp, data, size, done, private,
+	zio = zio_create(pio, spa, txg, bp, data, psize, done, private,
 	    ZIO_TYPE_WRITE, priority, flags, NULL, 0, zb,
 	    ZIO_STAGE_OPEN, (flags & ZIO_FLAG_DDT_CHILD) ?
 	    ZIO_DDT_CHILD_WRITE_PIPELINE : ZIO_WRITE_PIPELINE);
 
+	zio->io_lsize = lsize;
 	zio->io_ready = ready;
 	zio->io_children_ready = children_ready;
 	zio->io_physdone = physdone;
@@ -921,6 +938,65 @@ zio_ioctl(zio_t *pio, spa_t *spa, vdev_t *vd, int cmd,
 	return (zio);
 }
 
+/*
+ * Tell the devices under vd that [offset, offset + size) of vd's space is
+ * no longer in use (DKIOCFREE).  Trims are advisory, so they never fail
+ * their parent, and leaves that have shown they don't support them are
+ * skipped.
+ */
+zio_t *
+zio_trim(zio_t *pio, spa_t *spa, vdev_t *vd, uint64_t offset, uint64_t size)
+{
+	enum zio_flag flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE |
+	    ZIO_FLAG_DONT_RETRY;
+	zio_t *zio;
+
+	if (vd->vdev_ops->vdev_op_leaf) {
+		if (vd->vdev_notrim || !vdev_writeable(vd))
+			return (zio_null(pio, spa, NULL, NULL, NULL, flags));
+
+		zio = zio_create(pio, spa, 0, NULL, NULL, 0, NULL, NULL,
+		    ZIO_TYPE_IOCTL, ZIO_PRIORITY_TRIM, flags, vd,
+		    offset + VDEV_LABEL_START_SIZE, NULL, ZIO_STAGE_OPEN,
+		    ZIO_TRIM_PIPELINE);
+		zio->io_cmd = DKIOCFREE;
+
+		/*
+		 * io_size is the extent being freed, not a buffer size, so
+		 * it isn't bounded by SPA_MAXBLOCKSIZE.
+		 */
+		zio->io_size = zio->io_orig_size = size;
+		return (zio);
+	}
+
+	zio = zio_null(pio, spa, NULL, NULL, NULL, flags);
+
+	if (vd->vdev_ops == &vdev_raidz_ops) {
+		/*
+		 * RAID-Z lays its sectors out across the children a row at
+		 * a time, so only rows that lie entirely within the extent
+		 * are free on every child.  The partial rows at either end
+		 * may still hold parts of other blocks.
+		 */
+		uint64_t ashift = vd->vdev_top->vdev_ashift;
+		uint64_t cols = vd->vdev_children;
+		uint64_t srow = ((offset >> ashift) + cols - 1) / cols;
+		uint64_t erow = ((offset + size) >> ashift) / cols;
+
+		if (erow <= srow)
+			return (zio);
+		offset = srow << ashift;
+		size = (erow - srow) << ashift;
+	}
+
+	for (int c = 0; c < vd->vdev_children; c++) {
+		zio_nowait(zio_trim(zio, spa, vd->vdev_child[c],
+		    offset, size));
+	}
+
+	return (zio);
+}
+
 zio_t *
 zio_read_phys(zio_t *pio, vdev_t *vd, uint64_t offset, uint64_t size,
     void *data, int checksum, zio_done_func_t *done, void *private,
@@ -1193,8 +1269,8 @@ zio_write_compress(zio_t *zio)
 	zio_prop_t *zp = &zio->io_prop;
 	enum zio_compress compress = zp->zp_compress;
 	blkptr_t *bp = zio->io_bp;
-	uint64_t lsize = zio->io_size;
-	uint64_t psize = lsize;
+	uint64_t lsize = zio->io_lsize;
+	uint64_t psize = zio->io_size;
 	int pass = 1;
 
 	/*
@@ -1237,7 +1313,8 @@ zio_write_compress(zio_t *zio)
 		ASSERT(zio->io_child_type == ZIO_CHILD_LOGICAL);
 		ASSERT(!BP_GET_DEDUP(bp));
 
-		if (pass >= zfs_sync_pass_dont_compress)
+		if (pass >= zfs_sync_pass_dont_compress &&
+		    !(zio->io_flags & ZIO_FLAG_RAW))
 			compress = ZIO_COMPRESS_OFF;
 
 		/* Make sure someone doesn't change their mind on overwrites */
@@ -1245,7 +1322,14 @@ zio_write_compress(zio_t *zio)
 		    spa_max_replication(spa)) == BP_GET_NDVAS(bp));
 	}
 
-	if (compress != ZIO_COMPRESS_OFF) {
+	if (zio->io_flags & ZIO_FLAG_RAW) {
+		/*
+		 * The data was compressed by whoever gave it to us (e.g. it
+		 * came from a compressed send stream); record it as is.
+		 */
+		ASSERT3U(psize, <=, lsize);
+		ASSERT(compress != ZIO_COMPRESS_OFF || psize == lsize);
+	} else if (compress != ZIO_COMPRESS_OFF) {
 		void *cbuf = zio_buf_alloc(lsize);
 		psize = zio_compress_data(compress, zio->io_data, cbuf, lsize);
 		if (psize == 0 || psize == lsize) {
@@ -1364,6 +1448,178 @@ zio_free_bp_init(zio_t *zio)
 	return (ZIO_PIPELINE_CONTINUE);
 }
 
+/*
+ * ==========================================================================
+ * Slow I/O tracing
+ * ==========================================================================
+ */
+
+/*
+ * Each zio notes when it first enters each pipeline stage and how long it
+ * waits in the zio taskqs.  One that takes longer than
+ * zio_trace_threshold_ms to complete is copied, along with the vdev queue
+ * and device times kept by vdev_queue.c, into a ring kept by the CPU that
+ * completes it.  The rings are read through the zfs:0:zio_trace kstat (and
+ * "zpool iotrace"), and are lossy: a CPU overwrites its oldest records when
+ * it has more than zio_trace_ring_size of them.  Null zios, which only
+ * wait for their children, are left out.  Setting zio_trace_threshold_ms
+ * to 0 turns tracing off.
+ */
+int zio_trace_threshold_ms = 50;
+int zio_trace_ring_size = 64;		/* records per CPU, at zio_init() */
+
+typedef struct zio_trace_ring {
+	kmutex_t	ztr_lock;
+	uint64_t	ztr_count;	/* records ever added */
+	zio_trace_rec_t	*ztr_recs;
+} zio_trace_ring_t;
+
+static zio_trace_ring_t *zio_trace_rings;	/* one per CPU */
+static uint_t zio_trace_nrecs;
+static kmutex_t zio_trace_kstat_lock;
+static kstat_t *zio_trace_ksp;
+
+CTASSERT(ZIO_STAGE_DONE == 1 << (ZIO_TRACE_STAGES - 1));
+
+static int
+zio_trace_kstat_update(kstat_t *ksp, int rw)
+{
+	uint64_t n = 0;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (int c = 0; c < max_ncpus; c++)
+		n += MIN(zio_trace_rings[c].ztr_count, zio_trace_nrecs);
+	ksp->ks_ndata = n;
+	ksp->ks_data_size = n * sizeof (zio_trace_rec_t);
+
+	return (0);
+}
+
+/*
+ * The rings only fill up, so there are at least as many records as
+ * zio_trace_kstat_update() counted.
+ */
+static int
+zio_trace_kstat_snapshot(kstat_t *ksp, void *buf, int rw)
+{
+	zio_trace_rec_t *zit = buf;
+	uint64_t n = 0;
+	uint64_t max = ksp->ks_data_size / sizeof (zio_trace_rec_t);
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	ksp->ks_snaptime = gethrtime();
+
+	for (int c = 0; c < max_ncpus && n < max; c++) {
+		zio_trace_ring_t *ztr = &zio_trace_rings[c];
+		uint64_t i;
+
+		mutex_enter(&ztr->ztr_lock);
+		i = ztr->ztr_count - MIN(ztr->ztr_count, zio_trace_nrecs);
+		for (; i < ztr->ztr_count && n < max; i++)
+			zit[n++] = ztr->ztr_recs[i % zio_trace_nrecs];
+		mutex_exit(&ztr->ztr_lock);
+	}
+
+	return (0);
+}
+
+static void
+zio_trace_init(void)
+{
+	zio_trace_nrecs = MAX(zio_trace_ring_size, 1);
+	zio_trace_rings = kmem_zalloc(max_ncpus * sizeof (zio_trace_ring_t),
+	    KM_SLEEP);
+	for (int c = 0; c < max_ncpus; c++) {
+		zio_trace_ring_t *ztr = &zio_trace_rings[c];
+
+		mutex_init(&ztr->ztr_lock, NULL, MUTEX_DEFAULT, NULL);
+		ztr->ztr_recs = kmem_zalloc(zio_trace_nrecs *
+		    sizeof (zio_trace_rec_t), KM_SLEEP);
+	}
+	mutex_init(&zio_trace_kstat_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	zio_trace_ksp = kstat_create("zfs", 0, "zio_trace", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL | KSTAT_FLAG_VAR_SIZE);
+	if (zio_trace_ksp != NULL) {
+		zio_trace_ksp->ks_lock = &zio_trace_kstat_lock;
+		zio_trace_ksp->ks_update = zio_trace_kstat_update;
+		zio_trace_ksp->ks_snapshot = zio_trace_kstat_snapshot;
+		kstat_install(zio_trace_ksp);
+	}
+}
+
+static void
+zio_trace_fini(void)
+{
+	if (zio_trace_ksp != NULL) {
+		kstat_delete(zio_trace_ksp);
+		zio_trace_ksp = NULL;
+	}
+	mutex_destroy(&zio_trace_kstat_lock);
+
+	for (int c = 0; c < max_ncpus; c++) {
+		zio_trace_ring_t *ztr = &zio_trace_rings[c];
+
+		kmem_free(ztr->ztr_recs,
+		    zio_trace_nrecs * sizeof (zio_trace_rec_t));
+		mutex_destroy(&ztr->ztr_lock);
+	}
+	kmem_free(zio_trace_rings, max_ncpus * sizeof (zio_trace_ring_t));
+	zio_trace_rings = NULL;
+}
+
+static void
+zio_trace_stage(zio_t *zio, enum zio_stage stage)
+{
+	hrtime_t us = (gethrtime() - zio->io_queued_timestamp) /
+	    (NANOSEC / MICROSEC);
+
+	zio->io_stage_us[highbit64(stage) - 1] = MIN(us, UINT32_MAX);
+}
+
+static void
+zio_trace_done(zio_t *zio)
+{
+	hrtime_t total = gethrtime() - zio->io_queued_timestamp;
+	zio_trace_ring_t *ztr;
+	zio_trace_rec_t *zit;
+	int cpu;
+
+	if (zio_trace_threshold_ms == 0 || zio->io_type == ZIO_TYPE_NULL ||
+	    total < MSEC2NSEC(zio_trace_threshold_ms))
+		return;
+
+	cpu = CPU_SEQID;
+	ztr = &zio_trace_rings[cpu];
+	mutex_enter(&ztr->ztr_lock);
+	zit = &ztr->ztr_recs[ztr->ztr_count++ % zio_trace_nrecs];
+	zit->zit_pool_guid = spa_guid(zio->io_spa);
+	zit->zit_vdev_guid = zio->io_vd != NULL ? zio->io_vd->vdev_guid : 0;
+	zit->zit_start = zio->io_queued_timestamp;
+	zit->zit_total = total;
+	zit->zit_taskq = zio->io_taskq_time;
+	zit->zit_vqueue = zio->io_delta;
+	zit->zit_device = zio->io_delay;
+	zit->zit_offset = zio->io_offset;
+	zit->zit_size = zio->io_size;
+	zit->zit_objset = zio->io_bookmark.zb_objset;
+	zit->zit_object = zio->io_bookmark.zb_object;
+	zit->zit_level = zio->io_bookmark.zb_level;
+	zit->zit_blkid = zio->io_bookmark.zb_blkid;
+	zit->zit_stages = zio->io_pipeline_trace;
+	bcopy(zio->io_stage_us, zit->zit_stage_us, sizeof (zit->zit_stage_us));
+	zit->zit_error = zio->io_error;
+	zit->zit_cpu = cpu;
+	zit->zit_type = zio->io_type;
+	zit->zit_priority = zio->io_priority;
+	zit->zit_child = zio->io_child_type;
+	mutex_exit(&ztr->ztr_lock);
+}
+
 /*
  * ==========================================================================
  * Execute the I/O pipeline
@@ -1407,6 +1663,8 @@ zio_taskq_dispatch(zio_t *zio, zio_taskq_type_t q, boolean_t cutinline)
 	 * to dispatch the zio to another taskq at the same time.
 	 */
 	ASSERT(zio->io_tqent.tqent_next == NULL);
+	if (zio_trace_threshold_ms != 0)
+		zio->io_dispatch_timestamp = gethrtime();
 	spa_taskq_dispatch_ent(spa, t, q, (task_func_t *)zio_execute, zio,
 	    flags, &zio->io_tqent);
 }
@@ -1520,6 +1778,11 @@ zio_execute(zio_t *zio)
 
 	ASSERT3U(zio->io_queued_timestamp, >, 0);
 
+	if (zio->io_dispatch_timestamp != 0) {
+		zio->io_taskq_time += gethrtime() - zio->io_dispatch_timestamp;
+		zio->io_dispatch_timestamp = 0;
+	}
+
 	while (zio->io_stage < ZIO_STAGE_DONE) {
 		enum zio_stage pipeline = zio->io_pipeline;
 		enum zio_stage stage = zio->io_stage;
@@ -1553,6 +1816,9 @@ zio_execute(zio_t *zio)
 		}
 
 		zio->io_stage = stage;
+		if (zio_trace_threshold_ms != 0 &&
+		    (zio->io_pipeline_trace & stage) == 0)
+			zio_trace_stage(zio, stage);
 		zio->io_pipeline_trace |= zio->io_stage;
 		rv = zio_pipeline[highbit64(stage) - 1](zio);
 
@@ -1637,6 +1903,7 @@ zio_reexecute(zio_t *pio)
 	pio->io_reexecute = 0;
 	pio->io_flags |= ZIO_FLAG_REEXECUTED;
 	pio->io_pipeline_trace = 0;
+	pio->io_taskq_time = 0;
 	pio->io_error = 0;
 	for (int w = 0; w < ZIO_WAIT_TYPES; w++)
 		pio->io_state[w] = 0;
@@ -2084,7 +2351,8 @@ zio_write_gang_block(zio_t *pio)
 		ASSERT(!(pio->io_flags & ZIO_FLAG_NODATA));
 
 		flags |= METASLAB_ASYNC_ALLOC;
-		VERIFY(refcount_held(&mc->mc_alloc_slots, pio));
+		VERIFY(refcount_held(
+		    &mc->mc_allocator[pio->io_allocator].mca_alloc_slots, pio));
 
 		/*
 		 * The logical zio has already placed a reservation for
@@ -2095,11 +2363,12 @@ zio_write_gang_block(zio_t *pio)
 		 * additional reservations for gang blocks.
 		 */
 		VERIFY(metaslab_class_throttle_reserve(mc, gbh_copies - copies,
-		    pio, flags));
+		    pio->io_allocator, pio, flags));
 	}
 
 	error = metaslab_alloc(spa, mc, SPA_GANGBLOCKSIZE,
-	    bp, gbh_copies, txg, pio == gio ? NULL : gio->io_bp, flags, pio);
+	    bp, gbh_copies, txg, pio == gio ? NULL : gio->io_bp, flags, pio,
+	    pio->io_allocator);
 	if (error) {
 		if (pio->io_flags & ZIO_FLAG_IO_ALLOCATING) {
 			ASSERT(pio->io_priority == ZIO_PRIORITY_ASYNC_WRITE);
@@ -2113,7 +2382,7 @@ zio_write_gang_block(zio_t *pio)
 			 * stage.
 			 */
 			metaslab_class_throttle_unreserve(mc,
-			    gbh_copies - copies, pio);
+			    gbh_copies - copies, pio->io_allocator, pio);
 		}
 		pio->io_error = error;
 		return (ZIO_PIPELINE_CONTINUE);
@@ -2152,13 +2421,20 @@ zio_write_gang_block(zio_t *pio)
 		zp.zp_dedup = B_FALSE;
 		zp.zp_dedup_verify = B_FALSE;
 		zp.zp_nopwrite = B_FALSE;
+		zp.zp_special_smallblk = 0;
 
 		zio_t *cio = zio_write(zio, spa, txg, &gbh->zg_blkptr[g],
-		    (char *)pio->io_data + (pio->io_size - resid), lsize, &zp,
-		    zio_write_gang_member_ready, NULL, NULL, NULL,
+		    (char *)pio->io_data + (pio->io_size - resid), lsize,
+		    lsize, &zp, zio_write_gang_member_ready, NULL, NULL, NULL,
 		    &gn->gn_child[g], pio->io_priority,
 		    ZIO_GANG_CHILD_FLAGS(pio), &pio->io_bookmark);
 
+		/*
+		 * The children allocate near their gang header, and their
+		 * throttle slots come from the same allocator.
+		 */
+		cio->io_allocator = pio->io_allocator;
+
 		if (pio->io_flags & ZIO_FLAG_IO_ALLOCATING) {
 			ASSERT(pio->io_priority == ZIO_PRIORITY_ASYNC_WRITE);
 			ASSERT(!(pio->io_flags & ZIO_FLAG_NODATA));
@@ -2169,7 +2445,7 @@ zio_write_gang_block(zio_t *pio)
 			 * slot for them here.
 			 */
 			VERIFY(metaslab_class_throttle_reserve(mc,
-			    zp.zp_copies, cio, flags));
+			    zp.zp_copies, cio->io_allocator, cio, flags));
 		}
 		zio_nowait(cio);
 	}
@@ -2561,7 +2837,7 @@ zio_ddt_write(zio_t *zio)
 		}
 
 		dio = zio_write(zio, spa, txg, bp, zio->io_orig_data,
-		    zio->io_orig_size, &czp, NULL, NULL,
+		    zio->io_orig_size, zio->io_orig_size, &czp, NULL, NULL,
 		    NULL, zio_ddt_ditto_write_done, dde, zio->io_priority,
 		    ZIO_DDT_CHILD_FLAGS(zio), &zio->io_bookmark);
 
@@ -2583,7 +2859,7 @@ zio_ddt_write(zio_t *zio)
 		ddt_phys_addref(ddp);
 	} else {
 		cio = zio_write(zio, spa, txg, bp, zio->io_orig_data,
-		    zio->io_orig_size, zp,
+		    zio->io_orig_size, zio->io_orig_size, zp,
 		    zio_ddt_child_write_ready, NULL, NULL,
 		    zio_ddt_child_write_done, dde, zio->io_priority,
 		    ZIO_DDT_CHILD_FLAGS(zio), &zio->io_bookmark);
@@ -2631,29 +2907,49 @@ zio_ddt_free(zio_t *zio)
  * ==========================================================================
  */
 
+/*
+ * Pick the allocator for a write.  Blocks of an object that lie in the same
+ * 2^20-block region hash to the same allocator, so they keep being placed
+ * next to each other on disk, while different objects and distant regions
+ * of large objects spread over all of the pool's allocators.
+ */
+static int
+zio_allocator(spa_t *spa, const zbookmark_phys_t *zb)
+{
+	uint64_t h;
+
+	h = zb->zb_objset * 0x9e3779b97f4a7c15ULL;
+	h ^= (zb->zb_object + zb->zb_level) * 0xc2b2ae3d27d4eb4fULL;
+	h ^= (zb->zb_blkid >> 20) * 0x165667b19e3779b1ULL;
+	h ^= h >> 32;
+
+	return (h % spa->spa_alloc_count);
+}
+
 static zio_t *
-zio_io_to_allocate(spa_t *spa)
+zio_io_to_allocate(spa_t *spa, int allocator)
 {
 	zio_t *zio;
 
-	ASSERT(MUTEX_HELD(&spa->spa_alloc_lock));
+	ASSERT(MUTEX_HELD(&spa->spa_alloc_locks[allocator]));
 
-	zio = avl_first(&spa->spa_alloc_tree);
+	zio = avl_first(&spa->spa_alloc_trees[allocator]);
 	if (zio == NULL)
 		return (NULL);
 
 	ASSERT(IO_IS_ALLOCATING(zio));
+	ASSERT3S(zio->io_allocator, ==, allocator);
 
 	/*
 	 * Try to place a reservation for this zio. If we're unable to
 	 * reserve then we throttle.
 	 */
 	if (!metaslab_class_throttle_reserve(spa_normal_class(spa),
-	    zio->io_prop.zp_copies, zio, 0)) {
+	    zio->io_prop.zp_copies, allocator, zio, 0)) {
 		return (NULL);
 	}
 
-	avl_remove(&spa->spa_alloc_tree, zio);
+	avl_remove(&spa->spa_alloc_trees[allocator], zio);
 	ASSERT3U(zio->io_stage, <, ZIO_STAGE_DVA_ALLOCATE);
 
 	return (zio);
@@ -2665,6 +2961,13 @@ zio_dva_throttle(zio_t *zio)
 	spa_t *spa = zio->io_spa;
 	zio_t *nio;
 
+	/*
+	 * Gang children were given their parent's allocator when they
+	 * were created.
+	 */
+	if (zio->io_child_type != ZIO_CHILD_GANG)
+		zio->io_allocator = zio_allocator(spa, &zio->io_bookmark);
+
 	if (zio->io_priority == ZIO_PRIORITY_SYNC_WRITE ||
 	    !spa_normal_class(zio->io_spa)->mc_alloc_throttle_enabled ||
 	    zio->io_child_type == ZIO_CHILD_GANG ||
@@ -2677,13 +2980,13 @@ zio_dva_throttle(zio_t *zio)
 	ASSERT3U(zio->io_queued_timestamp, >, 0);
 	ASSERT(zio->io_stage == ZIO_STAGE_DVA_THROTTLE);
 
-	mutex_enter(&spa->spa_alloc_lock);
+	mutex_enter(&spa->spa_alloc_locks[zio->io_allocator]);
 
 	ASSERT(zio->io_type == ZIO_TYPE_WRITE);
-	avl_add(&spa->spa_alloc_tree, zio);
+	avl_add(&spa->spa_alloc_trees[zio->io_allocator], zio);
 
-	nio = zio_io_to_allocate(zio->io_spa);
-	mutex_exit(&spa->spa_alloc_lock);
+	nio = zio_io_to_allocate(spa, zio->io_allocator);
+	mutex_exit(&spa->spa_alloc_locks[zio->io_allocator]);
 
 	if (nio == zio)
 		return (ZIO_PIPELINE_CONTINUE);
@@ -2706,13 +3009,13 @@ zio_dva_throttle(zio_t *zio)
 }
 
 void
-zio_allocate_dispatch(spa_t *spa)
+zio_allocate_dispatch(spa_t *spa, int allocator)
 {
 	zio_t *zio;
 
-	mutex_enter(&spa->spa_alloc_lock);
-	zio = zio_io_to_allocate(spa);
-	mutex_exit(&spa->spa_alloc_lock);
+	mutex_enter(&spa->spa_alloc_locks[allocator]);
+	zio = zio_io_to_allocate(spa, allocator);
+	mutex_exit(&spa->spa_alloc_locks[allocator]);
 	if (zio == NULL)
 		return;
 
@@ -2725,7 +3028,7 @@ static int
 zio_dva_allocate(zio_t *zio)
 {
 	spa_t *spa = zio->io_spa;
-	metaslab_class_t *mc = spa_normal_class(spa);
+	metaslab_class_t *mc;
 	blkptr_t *bp = zio->io_bp;
 	int error;
 	int flags = 0;
@@ -2751,8 +3054,23 @@ zio_dva_allocate(zio_t *zio)
 		flags |= METASLAB_ASYNC_ALLOC;
 	}
 
+	mc = spa_preferred_class(spa, zio->io_size, zio->io_prop.zp_type,
+	    zio->io_prop.zp_level, zio->io_prop.zp_special_smallblk);
+
 	error = metaslab_alloc(spa, mc, zio->io_size, bp,
-	    zio->io_prop.zp_copies, zio->io_txg, NULL, flags, zio);
+	    zio->io_prop.zp_copies, zio->io_txg, NULL, flags, zio,
+	    zio->io_allocator);
+
+	/*
+	 * If the preferred class is out of space, fall back to the normal
+	 * class rather than ganging.
+	 */
+	if (error == ENOSPC && mc != spa_normal_class(spa)) {
+		mc = spa_normal_class(spa);
+		error = metaslab_alloc(spa, mc, zio->io_size, bp,
+		    zio->io_prop.zp_copies, zio->io_txg, NULL, flags, zio,
+		    zio->io_allocator);
+	}
 
 	if (error != 0) {
 		spa_dbgmsg(spa, "%s: metaslab allocation failure: zio %p, "
@@ -2816,17 +3134,29 @@ zio_alloc_zil(spa_t *spa, uint64_t txg, blkptr_t *new_bp, blkptr_t *old_bp,
     uint64_t size, boolean_t use_slog)
 {
 	int error = 1;
+	int allocator = 0;
 
 	ASSERT(txg > spa_syncing_txg(spa));
 
+	/*
+	 * Keep each dataset's log chain on one allocator; the previous
+	 * block's checksum seed records which objset it belongs to.
+	 */
+	if (old_bp != NULL) {
+		allocator = old_bp->blk_cksum.zc_word[ZIL_ZC_OBJSET] %
+		    spa->spa_alloc_count;
+	}
+
 	if (use_slog) {
 		error = metaslab_alloc(spa, spa_log_class(spa), size,
-		    new_bp, 1, txg, old_bp, METASLAB_HINTBP_AVOID, NULL);
+		    new_bp, 1, txg, old_bp, METASLAB_HINTBP_AVOID, NULL,
+		    allocator);
 	}
 
 	if (error) {
 		error = metaslab_alloc(spa, spa_normal_class(spa), size,
-		    new_bp, 1, txg, old_bp, METASLAB_HINTBP_AVOID, NULL);
+		    new_bp, 1, txg, old_bp, METASLAB_HINTBP_AVOID, NULL,
+		    allocator);
 	}
 
 	if (error == 0) {
@@ -2972,6 +3302,18 @@ zio_vdev_io_start(zio_t *zio)
 		return (ZIO_PIPELINE_CONTINUE);
 	}
 
+	if (vd->vdev_ops->vdev_op_leaf && zio->io_type == ZIO_TYPE_IOCTL &&
+	    zio->io_cmd == DKIOCFREE) {
+		if ((zio = vdev_queue_io(zio)) == NULL)
+			return (ZIO_PIPELINE_STOP);
+
+		if (!vdev_accessible(vd, zio)) {
+			zio->io_error = SET_ERROR(ENXIO);
+			zio_interrupt(zio);
+			return (ZIO_PIPELINE_STOP);
+		}
+	}
+
 	if (vd->vdev_ops->vdev_op_leaf &&
 	    (zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE)) {
 
@@ -3002,7 +3344,9 @@ zio_vdev_io_done(zio_t *zio)
 	if (zio_wait_for_children(zio, ZIO_CHILD_VDEV, ZIO_WAIT_DONE))
 		return (ZIO_PIPELINE_STOP);
 
-	ASSERT(zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE);
+	ASSERT(zio->io_type == ZIO_TYPE_READ ||
+	    zio->io_type == ZIO_TYPE_WRITE ||
+	    (zio->io_type == ZIO_TYPE_IOCTL && zio->io_cmd == DKIOCFREE));
 
 	if (vd != NULL && vd->vdev_ops->vdev_op_leaf) {
 
@@ -3018,10 +3362,14 @@ zio_vdev_io_done(zio_t *zio)
 		if (zio_injection_enabled && zio->io_error == 0)
 			zio->io_error = zio_handle_label_injection(zio, EIO);
 
+		/*
+		 * A failed trim says nothing about the health of the device,
+		 * so it isn't worth a probe.
+		 */
 		if (zio->io_error) {
 			if (!vdev_accessible(vd, zio)) {
 				zio->io_error = SET_ERROR(ENXIO);
-			} else {
+			} else if (zio->io_type != ZIO_TYPE_IOCTL) {
 				unexpected_error = B_TRUE;
 			}
 		}
@@ -3300,8 +3648,8 @@ zio_ready(zio_t *zio)
 			 */
 			metaslab_class_throttle_unreserve(
 			    spa_normal_class(zio->io_spa),
-			    zio->io_prop.zp_copies, zio);
-			zio_allocate_dispatch(zio->io_spa);
+			    zio->io_prop.zp_copies, zio->io_allocator, zio);
+			zio_allocate_dispatch(zio->io_spa, zio->io_allocator);
 		}
 	}
 
@@ -3384,18 +3732,19 @@ zio_dva_throttle_done(zio_t *zio)
 	ASSERT0(zio->io_flags & ZIO_FLAG_NOPWRITE);
 
 	mutex_enter(&pio->io_lock);
-	metaslab_group_alloc_decrement(zio->io_spa, vd->vdev_id, pio, flags);
+	metaslab_group_alloc_decrement(zio->io_spa, vd->vdev_id, pio, flags,
+	    pio->io_allocator);
 	mutex_exit(&pio->io_lock);
 
 	metaslab_class_throttle_unreserve(spa_normal_class(zio->io_spa),
-	    1, pio);
+	    1, pio->io_allocator, pio);
 
 	/*
 	 * Call into the pipeline to see if there is more work that
 	 * needs to be done. If there is work to be done it will be
 	 * dispatched to another taskq thread.
 	 */
-	zio_allocate_dispatch(zio->io_spa);
+	zio_allocate_dispatch(zio->io_spa, pio->io_allocator);
 }
 
 static int
@@ -3440,8 +3789,10 @@ zio_done(zio_t *zio)
 		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
 		ASSERT(zio->io_priority == ZIO_PRIORITY_ASYNC_WRITE);
 		ASSERT(bp != NULL);
-		metaslab_group_alloc_verify(spa, zio->io_bp, zio);
-		VERIFY(refcount_not_held(&mc->mc_alloc_slots, zio));
+		metaslab_group_alloc_verify(spa, zio->io_bp, zio,
+		    zio->io_allocator);
+		VERIFY(refcount_not_held(
+		    &mc->mc_allocator[zio->io_allocator].mca_alloc_slots, zio));
 	}
 
 	for (int c = 0; c < ZIO_CHILD_TYPES; c++)
@@ -3677,6 +4028,8 @@ zio_done(zio_t *zio)
 	if (zio->io_done)
 		zio->io_done(zio);
 
+	zio_trace_done(zio);
+
 	mutex_enter(&zio->io_lock);
 	zio->io_state[ZIO_WAIT_DONE] = 1;
 	mutex_exit(&zio->io_lock);
@@ -33,6 +33,7 @@
 
 #include <sys/zfs_context.h>
 #include <sys/compress.h>
+#include <sys/kstat.h>
 #include <sys/spa.h>
 #include <sys/zfeature.h>
 #include <sys/zio.h>
@@ -61,6 +62,64 @@ zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS] = {
 	{lz4_compress,		lz4_decompress,		0,	"lz4"},
 };
 
+/*
+ * Before running one of the slower compressors (gzip) on a block,
+ * try LZ4 on it first.  If even LZ4 can't shrink the block by
+ * 1 / 2^zio_compress_early_abort_shift, the data is almost certainly
+ * already compressed or encrypted, and the slow compressor won't get the
+ * 12.5% saving we require either; so store the block uncompressed without
+ * running it.  LZ4 gives up quickly on incompressible input, so this costs
+ * little next to the compressor it saves.
+ */
+boolean_t zio_compress_early_abort = B_TRUE;
+int zio_compress_early_abort_shift = 5;
+
+typedef struct zio_compress_stats {
+	kstat_named_t zcs_early_abort_tried;
+	kstat_named_t zcs_early_abort_aborted;
+} zio_compress_stats_t;
+
+static zio_compress_stats_t zio_compress_stats = {
+	{ "early_abort_tried",		KSTAT_DATA_UINT64 },
+	{ "early_abort_aborted",	KSTAT_DATA_UINT64 },
+};
+
+#define	ZCSTAT_BUMP(stat) \
+	atomic_inc_64(&zio_compress_stats.stat.value.ui64);
+
+static kstat_t *zio_compress_ksp;
+
+void
+zio_compress_init(void)
+{
+	zio_compress_ksp = kstat_create("zfs", 0, "compressstats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zio_compress_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (zio_compress_ksp != NULL) {
+		zio_compress_ksp->ks_data = &zio_compress_stats;
+		kstat_install(zio_compress_ksp);
+	}
+}
+
+void
+zio_compress_fini(void)
+{
+	if (zio_compress_ksp != NULL) {
+		kstat_delete(zio_compress_ksp);
+		zio_compress_ksp = NULL;
+	}
+}
+
+/*
+ * Is this compressor slow enough that an LZ4 trial run is worthwhile?
+ */
+static boolean_t
+zio_compress_is_slow(zio_compress_info_t *ci)
+{
+	return (ci->ci_compress == gzip_compress);
+}
+
 enum zio_compress
 zio_compress_select(spa_t *spa, enum zio_compress child,
     enum zio_compress parent)
@@ -110,6 +169,17 @@ zio_compress_data(enum zio_compress c, void *src, void *dst, size_t s_len)
 	if (c == ZIO_COMPRESS_EMPTY)
 		return (s_len);
 
+	if (zio_compress_early_abort && zio_compress_is_slow(ci)) {
+		size_t t_len =
+		    s_len - (s_len >> zio_compress_early_abort_shift);
+
+		ZCSTAT_BUMP(zcs_early_abort_tried);
+		if (lz4_compress(src, dst, s_len, t_len, 0) > t_len) {
+			ZCSTAT_BUMP(zcs_early_abort_aborted);
+			return (s_len);
+		}
+	}
+
 	/* Compress at least 12.5% */
 	d_len = s_len - (s_len >> 3);
 	c_len = ci->ci_compress(src, dst, s_len, d_len, ci->ci_level);
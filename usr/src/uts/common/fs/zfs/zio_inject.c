@@ -120,11 +120,12 @@ zio_match_handler(zbookmark_phys_t *zb, uint64_t type,
 	}
 
 	/*
-	 * Check for an exact match.
+	 * Check for an exact match.  zi_level is unsigned, so the negative
+	 * level of a log block is compared as an int32_t.
 	 */
 	if (zb->zb_objset == record->zi_objset &&
 	    zb->zb_object == record->zi_object &&
-	    zb->zb_level == record->zi_level &&
+	    zb->zb_level == (int32_t)record->zi_level &&
 	    zb->zb_blkid >= record->zi_start &&
 	    zb->zb_blkid <= record->zi_end &&
 	    error == record->zi_error)
@@ -176,9 +177,12 @@ zio_handle_fault_injection(zio_t *zio, int error)
 		return (0);
 
 	/*
-	 * Currently, we only support fault injection on reads.
+	 * Currently, we only support fault injection on reads, and on
+	 * writes of intent log blocks.
 	 */
-	if (zio->io_type != ZIO_TYPE_READ)
+	if (zio->io_type != ZIO_TYPE_READ &&
+	    !(zio->io_type == ZIO_TYPE_WRITE &&
+	    zio->io_logical->io_bookmark.zb_level == ZB_ZIL_LEVEL))
 		return (0);
 
 	rw_enter(&inject_lock, RW_READER);
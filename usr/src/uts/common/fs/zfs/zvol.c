@@ -128,6 +128,7 @@ typedef struct zvol_state {
 	list_t		zv_extents;	/* List of extents for dump */
 	znode_t		zv_znode;	/* for range locking */
 	dmu_buf_t	*zv_dbuf;	/* bonus handle */
+	taskq_t		*zv_taskq;	/* strategy workers */
 } zvol_state_t;
 
 /*
@@ -148,6 +149,15 @@ int zvol_maxphys = DMU_MAX_ACCESS/2;
  */
 boolean_t zvol_unmap_enabled = B_TRUE;
 
+/*
+ * Number of threads each open zvol uses to service zvol_strategy().
+ * Handing the bufs to a taskq lets one busy zvol (e.g. an iSCSI LU) keep
+ * several I/Os in the DMU at once, and lets concurrent synchronous writes
+ * share ZIL commits.  Setting this to 0 makes zvol_strategy() do the I/O
+ * in the caller's context.  Takes effect on the next first open.
+ */
+int zvol_threads = 8;
+
 extern int zfs_set_prop_nvlist(const char *, zprop_source_t,
     nvlist_t *, nvlist_t *);
 static int zvol_remove_zv(zvol_state_t *);
@@ -155,6 +165,7 @@ static int zvol_get_data(void *arg, lr_write_t *lr, char *buf, zio_t *zio);
 static int zvol_dumpify(zvol_state_t *zv);
 static int zvol_dump_fini(zvol_state_t *zv);
 static int zvol_dump_init(zvol_state_t *zv, boolean_t resize);
+static int zvol_free_range(zvol_state_t *zv, uint64_t off, uint64_t len);
 
 static void
 zvol_size_changed(zvol_state_t *zv, uint64_t volsize)
@@ -585,6 +596,7 @@ zvol_remove_zv(zvol_state_t *zv)
 	(void) snprintf(nmbuf, sizeof (nmbuf), "%u", minor);
 	ddi_remove_minor_node(zfs_dip, nmbuf);
 
+	zfs_range_free_shards(&zv->zv_znode);
 	avl_destroy(&zv->zv_znode.z_range_avl);
 	mutex_destroy(&zv->zv_znode.z_range_lock);
 
@@ -643,6 +655,12 @@ zvol_first_open(zvol_state_t *zv)
 	zvol_size_changed(zv, volsize);
 	zv->zv_zilog = zil_open(os, zvol_get_data);
 
+	if (zvol_threads > 0) {
+		zv->zv_taskq = taskq_create_instance("zvol_taskq",
+		    zv->zv_minor, zvol_threads, maxclsyspri, zvol_threads,
+		    INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
+	}
+
 	VERIFY(dsl_prop_get_integer(zv->zv_name, "readonly", &readonly,
 	    NULL) == 0);
 	if (readonly || dmu_objset_is_snapshot(os) ||
@@ -656,6 +674,12 @@ zvol_first_open(zvol_state_t *zv)
 void
 zvol_last_close(zvol_state_t *zv)
 {
+	/* Wait for any bufs still being serviced. */
+	if (zv->zv_taskq != NULL) {
+		taskq_destroy(zv->zv_taskq);
+		zv->zv_taskq = NULL;
+	}
+
 	zil_close(zv->zv_zilog);
 	zv->zv_zilog = NULL;
 
@@ -1209,20 +1233,14 @@ zvol_dumpio(zvol_state_t *zv, void *addr, uint64_t offset, uint64_t size,
 	return (error);
 }
 
+static void zvol_strategy_task(void *);
+
 int
 zvol_strategy(buf_t *bp)
 {
 	zfs_soft_state_t *zs = NULL;
 	zvol_state_t *zv;
-	uint64_t off, volsize;
-	size_t resid;
-	char *addr;
-	objset_t *os;
-	rl_t *rl;
 	int error = 0;
-	boolean_t doread = bp->b_flags & B_READ;
-	boolean_t is_dumpified;
-	boolean_t sync;
 
 	if (getminor(bp->b_edev) == 0) {
 		error = SET_ERROR(EINVAL);
@@ -1248,6 +1266,48 @@ zvol_strategy(buf_t *bp)
 		return (0);
 	}
 
+	if (bp->b_bcount > 0 && ldbtob(bp->b_blkno) >= zv->zv_volsize) {
+		bioerror(bp, EIO);
+		biodone(bp);
+		return (0);
+	}
+
+	/*
+	 * Dumps must complete in this context, and there's no one to run
+	 * the taskq once we've panicked.  If the dispatch fails we do the
+	 * I/O here rather than wait for memory.
+	 */
+	if (zv->zv_taskq == NULL || (zv->zv_flags & ZVOL_DUMPIFIED) ||
+	    ddi_in_panic() || taskq_dispatch(zv->zv_taskq,
+	    zvol_strategy_task, bp, TQ_NOSLEEP) == 0)
+		zvol_strategy_task(bp);
+
+	return (0);
+}
+
+/*
+ * Carry out a buf that zvol_strategy() has validated.  The zvol is open,
+ * and stays open until this returns: zvol_last_close() waits for the
+ * taskq to drain.
+ */
+static void
+zvol_strategy_task(void *arg)
+{
+	buf_t *bp = arg;
+	zvol_state_t *zv;
+	uint64_t off, volsize;
+	size_t resid;
+	char *addr;
+	objset_t *os;
+	rl_t *rl;
+	int error = 0;
+	boolean_t doread = bp->b_flags & B_READ;
+	boolean_t is_dumpified;
+	boolean_t sync;
+
+	zv = zfsdev_get_soft_state(getminor(bp->b_edev), ZSST_ZVOL);
+	ASSERT(zv != NULL);
+
 	off = ldbtob(bp->b_blkno);
 	volsize = zv->zv_volsize;
 
@@ -1258,12 +1318,6 @@ zvol_strategy(buf_t *bp)
 	addr = bp->b_un.b_addr;
 	resid = bp->b_bcount;
 
-	if (resid > 0 && (off < 0 || off >= volsize)) {
-		bioerror(bp, EIO);
-		biodone(bp);
-		return (0);
-	}
-
 	is_dumpified = zv->zv_flags & ZVOL_DUMPIFIED;
 	sync = ((!(bp->b_flags & B_ASYNC) &&
 	    !(zv->zv_flags & ZVOL_WCE)) ||
@@ -1316,8 +1370,6 @@ zvol_strategy(buf_t *bp)
 	if (sync)
 		zil_commit(zv->zv_zilog, ZVOL_OBJ);
 	biodone(bp);
-
-	return (0);
 }
 
 /*
@@ -1600,6 +1652,49 @@ zvol_log_write_minor(void *minor_hdl, dmu_tx_t *tx, offset_t off, ssize_t resid,
 
 	zvol_log_write(zv, tx, off, resid, sync);
 }
+
+/*
+ * Free a range of the volume for an external caller, as DKIOCFREE does
+ * but without committing the ZIL or waiting for the txg to sync.  A
+ * caller freeing many ranges calls zvol_free_sync_minor() once after
+ * the last of them.
+ */
+int
+zvol_free_minor(void *minor_hdl, uint64_t off, uint64_t len)
+{
+	zvol_state_t *zv = minor_hdl;
+
+	if (!zvol_unmap_enabled || off >= zv->zv_volsize)
+		return (0);
+
+	return (zvol_free_range(zv, off, len));
+}
+
+/*
+ * Make the frees done so far stable the way DKIOCFREE does.
+ */
+void
+zvol_free_sync_minor(void *minor_hdl, boolean_t wait_sync)
+{
+	zvol_state_t *zv = minor_hdl;
+
+	/*
+	 * If the write-cache is disabled or 'sync' property
+	 * is set to 'always' then treat this as a synchronous
+	 * operation (i.e. commit to zil).
+	 */
+	if (!(zv->zv_flags & ZVOL_WCE) ||
+	    (zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS))
+		zil_commit(zv->zv_zilog, ZVOL_OBJ);
+
+	/*
+	 * If the caller really wants synchronous writes, and
+	 * can't wait for them, don't return until the write
+	 * is done.
+	 */
+	if (wait_sync)
+		txg_wait_synced(dmu_objset_pool(zv->zv_objset), 0);
+}
 /*
  * END entry points to allow external callers access to the volume.
  */
@@ -1628,6 +1723,33 @@ zvol_log_truncate(zvol_state_t *zv, dmu_tx_t *tx, uint64_t off, uint64_t len,
 	zil_itx_assign(zilog, itx, tx);
 }
 
+/*
+ * Free a range of the volume, logging it to the ZIL.
+ */
+static int
+zvol_free_range(zvol_state_t *zv, uint64_t off, uint64_t len)
+{
+	dmu_tx_t *tx;
+	rl_t *rl;
+	int error;
+
+	rl = zfs_range_lock(&zv->zv_znode, off, len, RL_WRITER);
+	tx = dmu_tx_create(zv->zv_objset);
+	dmu_tx_mark_netfree(tx);
+	error = dmu_tx_assign(tx, TXG_WAIT);
+	if (error != 0) {
+		dmu_tx_abort(tx);
+	} else {
+		zvol_log_truncate(zv, tx, off, len, B_TRUE);
+		dmu_tx_commit(tx);
+		error = dmu_free_long_range(zv->zv_objset, ZVOL_OBJ,
+		    off, len);
+	}
+	zfs_range_unlock(rl);
+
+	return (error);
+}
+
 /*
  * Dirtbag ioctls to support mkfs(1M) for UFS filesystems.  See dkio(7I).
  * Also a dirtbag dkio ioctl for unmap/free-block functionality.
@@ -1774,7 +1896,6 @@ zvol_ioctl(dev_t dev, int cmd, intptr_t arg, int flag, cred_t *cr, int *rvalp)
 	case DKIOCFREE:
 	{
 		dkioc_free_t df;
-		dmu_tx_t *tx;
 
 		if (!zvol_unmap_enabled)
 			break;
@@ -1794,43 +1915,10 @@ zvol_ioctl(dev_t dev, int cmd, intptr_t arg, int flag, cred_t *cr, int *rvalp)
 
 		mutex_exit(&zfsdev_state_lock);
 
-		rl = zfs_range_lock(&zv->zv_znode, df.df_start, df.df_length,
-		    RL_WRITER);
-		tx = dmu_tx_create(zv->zv_objset);
-		dmu_tx_mark_netfree(tx);
-		error = dmu_tx_assign(tx, TXG_WAIT);
-		if (error != 0) {
-			dmu_tx_abort(tx);
-		} else {
-			zvol_log_truncate(zv, tx, df.df_start,
-			    df.df_length, B_TRUE);
-			dmu_tx_commit(tx);
-			error = dmu_free_long_range(zv->zv_objset, ZVOL_OBJ,
-			    df.df_start, df.df_length);
-		}
-
-		zfs_range_unlock(rl);
-
-		if (error == 0) {
-			/*
-			 * If the write-cache is disabled or 'sync' property
-			 * is set to 'always' then treat this as a synchronous
-			 * operation (i.e. commit to zil).
-			 */
-			if (!(zv->zv_flags & ZVOL_WCE) ||
-			    (zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS))
-				zil_commit(zv->zv_zilog, ZVOL_OBJ);
-
-			/*
-			 * If the caller really wants synchronous writes, and
-			 * can't wait for them, don't return until the write
-			 * is done.
-			 */
-			if (df.df_flags & DF_WAIT_SYNC) {
-				txg_wait_synced(
-				    dmu_objset_pool(zv->zv_objset), 0);
-			}
-		}
+		error = zvol_free_range(zv, df.df_start, df.df_length);
+		if (error == 0)
+			zvol_free_sync_minor(zv,
+			    (df.df_flags & DF_WAIT_SYNC) != 0);
 		return (error);
 	}
 
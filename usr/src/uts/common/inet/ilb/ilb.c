@@ -96,12 +96,14 @@ static uint32_t ilb_sticky_expiry = 60;
  * for the removal completion.
  *
  * The conn hash/sticky hash taskq is for processing ilb_conn_hash and
- * ilb_sticky_hash table entry removal.  There are ilb_conn_timer_size timers
- * and ilb_sticky_timer_size timers running for ilb_conn_hash and
- * ilb_sticky_hash cleanup respectively.   Each timer is responsible for one
- * portion (same size) of the hash table.  When a timer fires, it dispatches
- * a conn hash taskq to clean up its portion of the table.  This avoids in
- * line processing of the removal.
+ * ilb_sticky_hash table entry removal.  ilb_conn_hash entries are put on a
+ * timer wheel, in the slot of the time each is next due to be checked.  A
+ * single timer fires every ilb_conn_wheel_tick seconds and dispatches the
+ * conn hash taskq to check the entries in the slots which have come due.
+ * There are ilb_sticky_timer_size timers running for ilb_sticky_hash
+ * cleanup.  Each is responsible for one portion (same size) of the hash
+ * table.  When a timer fires, it dispatches a sticky hash taskq to clean up
+ * its portion of the table.  This avoids in line processing of the removal.
  *
  * There is another delayed processing, the clean up of NAT source address
  * table.  We just use the timer to directly handle it instead of using
@@ -2072,7 +2074,8 @@ ilb_stack_init(netstackid_t stackid, netstack_t *ns)
 	ilbs->ilbs_conn_hash_size = ilb_conn_hash_size;
 	ilbs->ilbs_c2s_conn_hash = NULL;
 	ilbs->ilbs_s2c_conn_hash = NULL;
-	ilbs->ilbs_conn_timer_list = NULL;
+	ilbs->ilbs_conn_timer = NULL;
+	ilbs->ilbs_conn_wheel = NULL;
 
 	ilbs->ilbs_sticky_hash = NULL;
 	ilbs->ilbs_sticky_hash_size = ilb_sticky_hash_size;
@@ -48,8 +48,8 @@
 /*
  * Timer struct for ilb_conn_t and ilb_sticky_t garbage collection
  *
- * start: starting index into the hash table to do gc
- * end: ending index into the hash table to do gc
+ * start: starting index into the hash table to do gc (sticky hash only)
+ * end: ending index into the hash table to do gc (sticky hash only)
  * ilbs: pointer to the ilb_stack_t of the IP stack
  * tid_lock: mutex to protect the timer id.
  * tid: timer id of the timer
@@ -74,14 +74,24 @@ typedef struct ilb_timer_s {
 static struct kmem_cache *ilb_conn_cache = NULL;
 
 /*
- * There are 60 timers running to do conn cache garbage collection.  Each
- * gc thread is responsible for 1/60 of the conn hash table.
+ * Conn cache entries are garbage collected using a timer wheel of
+ * ilb_conn_wheel_size slots, each ilb_conn_wheel_tick seconds apart.  An
+ * entry sits in the slot of the time it is next due to be checked, so the
+ * wheel timer only visits entries which may have expired instead of
+ * sweeping the whole conn hash table.  An entry due more than one
+ * revolution ahead is checked and put back each time its slot comes round.
  */
-static int ilb_conn_timer_size = 60;
+static int ilb_conn_wheel_size = 256;
+static int ilb_conn_wheel_tick = 1;
 
-/* Each of the above gc timers wake up every 15s to do the gc. */
+/* A TCP conn which has sent a FIN is checked every 15s for completion. */
 static int ilb_conn_cache_timeout = 15;
 
+#define	ILB_CONN_WHEEL_TICK(t)	((t) / SEC_TO_TICK(ilb_conn_wheel_tick))
+#define	ILB_CONN_WHEEL_SLOT(t)	((int)((t) % ilb_conn_wheel_size))
+
+static void ilb_conn_timer(void *);
+
 #define	ILB_STICKY_HASH(saddr, rule, hash_size)			\
 	(((*((saddr) + 3) ^ ((rule) >> 24)) * 29791 +		\
 	(*((saddr) + 2) ^ ((rule) >> 16)) * 961 +		\
@@ -192,64 +202,124 @@ ilb_conn_remove(ilb_conn_t *connp)
 }
 
 /*
- * Routine to do periodic garbage collection of conn hash entries.  When
- * a conn hash timer fires, it dispatches a taskq to call this function
- * to do the gc.  Note that each taskq is responisble for a portion of
- * the table.  The portion is stored in timer->start, timer->end.
+ * Return the time (in lbolt) at which a conn hash entry next needs to be
+ * checked by the timer wheel.  The caller should hold at least one of the
+ * entry's hash locks.  The other direction's fields may change under us,
+ * which at worst makes the entry due a little early or late.
+ */
+static int64_t
+ilb_conn_due(ilb_conn_t *connp, int64_t now)
+{
+	int64_t due, die_time;
+
+	if (connp->conn_gc)
+		return (now);
+
+	due = MAX(connp->conn_c2s_atime, connp->conn_s2c_atime) +
+	    SEC_TO_TICK(connp->conn_expiry);
+	die_time = connp->conn_server->iser_die_time;
+	if (die_time != 0 && die_time < due)
+		due = die_time;
+
+	/* Check a closing TCP conn regularly to find out when it is done. */
+	if (connp->conn_l4 == IPPROTO_TCP &&
+	    (connp->conn_c2s_tcp_fin_sent || connp->conn_s2c_tcp_fin_sent))
+		due = MIN(due, now + SEC_TO_TICK(ilb_conn_cache_timeout));
+
+	return (due);
+}
+
+/*
+ * Add a conn hash entry, which must not already be on the timer wheel, to
+ * the wheel slot for the given time.
  */
 static void
-ilb_conn_cleanup(void *arg)
+ilb_conn_wheel_add(ilb_stack_t *ilbs, ilb_conn_t *connp, int64_t due)
 {
-	ilb_timer_t *timer = (ilb_timer_t *)arg;
-	uint32_t i;
-	ilb_stack_t *ilbs;
+	ilb_conn_wheel_t *cw;
+	int64_t tick;
+	int slot;
+
+	/* Never add to a slot which has already been processed. */
+	tick = ILB_CONN_WHEEL_TICK(due);
+	if (tick <= ilbs->ilbs_conn_wheel_cur)
+		tick = ilbs->ilbs_conn_wheel_cur + 1;
+	slot = ILB_CONN_WHEEL_SLOT(tick);
+
+	cw = &ilbs->ilbs_conn_wheel[slot];
+	mutex_enter(&cw->cw_lock);
+	ASSERT(connp->conn_wheel_slot == -1);
+	connp->conn_wheel_slot = slot;
+	connp->conn_wheel_time = due;
+	list_insert_tail(&cw->cw_head, connp);
+	mutex_exit(&cw->cw_lock);
+}
+
+/*
+ * Move a conn hash entry on the timer wheel so that it is checked no later
+ * than the given time.  The caller must hold one of the entry's hash locks,
+ * so it cannot be removed under us.  If the entry is not on the wheel, it is
+ * either being added or being checked by ilb_conn_wheel_expire() (which
+ * holds both hash locks for the check, hence sees whatever the caller has
+ * changed), so there is nothing to do.
+ */
+static void
+ilb_conn_wheel_move(ilb_stack_t *ilbs, ilb_conn_t *connp, int64_t due)
+{
+	ilb_conn_wheel_t *cw;
+	int slot;
+
+	if ((slot = connp->conn_wheel_slot) == -1)
+		return;
+
+	cw = &ilbs->ilbs_conn_wheel[slot];
+	mutex_enter(&cw->cw_lock);
+	if (connp->conn_wheel_slot != slot || connp->conn_wheel_time <= due) {
+		mutex_exit(&cw->cw_lock);
+		return;
+	}
+	list_remove(&cw->cw_head, connp);
+	connp->conn_wheel_slot = -1;
+	mutex_exit(&cw->cw_lock);
+
+	ilb_conn_wheel_add(ilbs, connp, due);
+}
+
+/*
+ * Check all the conn hash entries in one timer wheel slot.  Expired entries
+ * are removed, the rest are put back on the wheel for the time they are
+ * next due.  The conn hash timer wheel is the only place where an entry is
+ * removed (apart from ilb_conn_hash_fini()), so an entry taken off the slot
+ * cannot go away before we get hold of its hash locks.
+ */
+static void
+ilb_conn_wheel_expire(ilb_stack_t *ilbs, int slot, int64_t now)
+{
+	ilb_conn_wheel_t *cw;
 	ilb_conn_hash_t *c2s_hash, *s2c_hash;
-	ilb_conn_t *connp, *nxt_connp;
-	int64_t now;
-	int64_t expiry;
-	boolean_t die_now;
+	ilb_conn_t *connp;
+	list_t due_list;
+	int64_t due;
 
-	ilbs = timer->ilbs;
-	c2s_hash = ilbs->ilbs_c2s_conn_hash;
-	ASSERT(c2s_hash != NULL);
+	list_create(&due_list, sizeof (ilb_conn_t),
+	    offsetof(ilb_conn_t, conn_wheel_node));
 
-	now = ddi_get_lbolt64();
-	for (i = timer->start; i < timer->end; i++) {
-		mutex_enter(&c2s_hash[i].ilb_conn_hash_lock);
-		if ((connp = c2s_hash[i].ilb_connp) == NULL) {
-			ASSERT(c2s_hash[i].ilb_conn_cnt == 0);
-			mutex_exit(&c2s_hash[i].ilb_conn_hash_lock);
-			continue;
-		}
-		do {
-			ASSERT(c2s_hash[i].ilb_conn_cnt > 0);
-			ASSERT(connp->conn_c2s_hash == &c2s_hash[i]);
-			nxt_connp = connp->conn_c2s_next;
-			expiry = now - SEC_TO_TICK(connp->conn_expiry);
-			if (connp->conn_server->iser_die_time != 0 &&
-			    connp->conn_server->iser_die_time < now)
-				die_now = B_TRUE;
-			else
-				die_now = B_FALSE;
-			s2c_hash = connp->conn_s2c_hash;
-			mutex_enter(&s2c_hash->ilb_conn_hash_lock);
-
-			if (connp->conn_gc || die_now ||
-			    (connp->conn_c2s_atime < expiry &&
-			    connp->conn_s2c_atime < expiry)) {
-				/* Need to update the nat list cur_connp */
-				if (connp == ilbs->ilbs_conn_list_connp) {
-					ilbs->ilbs_conn_list_connp =
-					    connp->conn_c2s_next;
-				}
-				ilb_conn_remove(connp);
-				goto nxt_connp;
-			}
+	cw = &ilbs->ilbs_conn_wheel[slot];
+	mutex_enter(&cw->cw_lock);
+	while ((connp = list_remove_head(&cw->cw_head)) != NULL) {
+		connp->conn_wheel_slot = -1;
+		list_insert_tail(&due_list, connp);
+	}
+	mutex_exit(&cw->cw_lock);
 
-			if (connp->conn_l4 != IPPROTO_TCP)
-				goto nxt_connp;
+	while ((connp = list_remove_head(&due_list)) != NULL) {
+		c2s_hash = connp->conn_c2s_hash;
+		s2c_hash = connp->conn_s2c_hash;
+		mutex_enter(&c2s_hash->ilb_conn_hash_lock);
+		mutex_enter(&s2c_hash->ilb_conn_hash_lock);
 
-			/* Update and check TCP related conn info */
+		/* Update and check TCP related conn info */
+		if (connp->conn_l4 == IPPROTO_TCP) {
 			if (connp->conn_c2s_tcp_fin_sent &&
 			    SEQ_GT(connp->conn_s2c_tcp_ack,
 			    connp->conn_c2s_tcp_fss)) {
@@ -262,40 +332,77 @@ ilb_conn_cleanup(void *arg)
 			}
 			if (connp->conn_c2s_tcp_fin_acked &&
 			    connp->conn_s2c_tcp_fin_acked) {
-				ilb_conn_remove(connp);
+				connp->conn_gc = B_TRUE;
+			}
+		}
+
+		due = ilb_conn_due(connp, now);
+		if (due <= now) {
+			/* Need to update the nat list cur_connp */
+			if (connp == ilbs->ilbs_conn_list_connp) {
+				ilbs->ilbs_conn_list_connp =
+				    connp->conn_c2s_next;
 			}
-nxt_connp:
-			mutex_exit(&s2c_hash->ilb_conn_hash_lock);
-			connp = nxt_connp;
-		} while (connp != NULL);
-		mutex_exit(&c2s_hash[i].ilb_conn_hash_lock);
+			ilb_conn_remove(connp);
+		} else {
+			ilb_conn_wheel_add(ilbs, connp, due);
+		}
+		mutex_exit(&s2c_hash->ilb_conn_hash_lock);
+		mutex_exit(&c2s_hash->ilb_conn_hash_lock);
 	}
+	list_destroy(&due_list);
 }
 
-/* Conn hash timer routine.  It dispatches a taskq and restart the timer */
+/*
+ * Conn hash timer wheel routine, run from the conn taskq.  It processes all
+ * the slots which have become due since it last ran and restarts the timer.
+ * The timer is only restarted here so that there is never more than one of
+ * these running.
+ */
 static void
-ilb_conn_timer(void *arg)
+ilb_conn_cleanup(void *arg)
 {
 	ilb_timer_t *timer = (ilb_timer_t *)arg;
+	ilb_stack_t *ilbs = timer->ilbs;
+	int64_t now, tick;
+
+	now = ddi_get_lbolt64();
+	tick = ILB_CONN_WHEEL_TICK(now);
+
+	/* However far behind we are, each slot only needs to be done once. */
+	if (tick - ilbs->ilbs_conn_wheel_cur > ilb_conn_wheel_size)
+		ilbs->ilbs_conn_wheel_cur = tick - ilb_conn_wheel_size;
+	while (ilbs->ilbs_conn_wheel_cur < tick) {
+		ilbs->ilbs_conn_wheel_cur++;
+		ilb_conn_wheel_expire(ilbs,
+		    ILB_CONN_WHEEL_SLOT(ilbs->ilbs_conn_wheel_cur), now);
+	}
 
-	(void) taskq_dispatch(timer->ilbs->ilbs_conn_taskq, ilb_conn_cleanup,
-	    arg, TQ_SLEEP);
 	mutex_enter(&timer->tid_lock);
-	if (timer->tid == 0) {
-		mutex_exit(&timer->tid_lock);
-	} else {
+	if (timer->tid != 0) {
 		timer->tid = timeout(ilb_conn_timer, arg,
-		    SEC_TO_TICK(ilb_conn_cache_timeout));
-		mutex_exit(&timer->tid_lock);
+		    SEC_TO_TICK(ilb_conn_wheel_tick));
 	}
+	mutex_exit(&timer->tid_lock);
+}
+
+/* Conn hash timer routine.  It dispatches a taskq to run the timer wheel. */
+static void
+ilb_conn_timer(void *arg)
+{
+	ilb_timer_t *timer = (ilb_timer_t *)arg;
+
+	(void) taskq_dispatch(timer->ilbs->ilbs_conn_taskq, ilb_conn_cleanup,
+	    arg, TQ_SLEEP);
 }
 
 void
 ilb_conn_hash_init(ilb_stack_t *ilbs)
 {
 	extern pri_t minclsyspri;
-	int i, part;
+	int i;
 	ilb_timer_t *tm;
+	ilb_conn_wheel_t *cw;
 	char tq_name[TASKQ_NAMELEN];
 
 	/*
@@ -334,31 +441,27 @@ ilb_conn_hash_init(ilb_stack_t *ilbs)
 	(void) snprintf(tq_name, sizeof (tq_name), "ilb_conn_taskq_%p",
 	    (void *)ilbs->ilbs_netstack);
 	ASSERT(ilbs->ilbs_conn_taskq == NULL);
-	ilbs->ilbs_conn_taskq = taskq_create(tq_name,
-	    ilb_conn_timer_size * 2, minclsyspri, ilb_conn_timer_size,
-	    ilb_conn_timer_size * 2, TASKQ_PREPOPULATE|TASKQ_DYNAMIC);
-
-	ASSERT(ilbs->ilbs_conn_timer_list == NULL);
-	ilbs->ilbs_conn_timer_list = kmem_zalloc(sizeof (ilb_timer_t) *
-	    ilb_conn_timer_size, KM_SLEEP);
-
-	/*
-	 * The hash table is divided in equal partition for those timers
-	 * to do garbage collection.
-	 */
-	part = ilbs->ilbs_conn_hash_size / ilb_conn_timer_size + 1;
-	for (i = 0; i < ilb_conn_timer_size; i++) {
-		tm = ilbs->ilbs_conn_timer_list + i;
-		tm->start = i * part;
-		tm->end = i * part + part;
-		if (tm->end > ilbs->ilbs_conn_hash_size)
-			tm->end = ilbs->ilbs_conn_hash_size;
-		tm->ilbs = ilbs;
-		mutex_init(&tm->tid_lock, NULL, MUTEX_DEFAULT, NULL);
-		/* Spread out the starting execution time of all the timers. */
-		tm->tid = timeout(ilb_conn_timer, tm,
-		    SEC_TO_TICK(ilb_conn_cache_timeout + i));
+	ilbs->ilbs_conn_taskq = taskq_create(tq_name, 1, minclsyspri, 1, 1,
+	    TASKQ_PREPOPULATE);
+
+	ASSERT(ilbs->ilbs_conn_wheel == NULL);
+	ilbs->ilbs_conn_wheel = kmem_zalloc(sizeof (ilb_conn_wheel_t) *
+	    ilb_conn_wheel_size, KM_SLEEP);
+	for (i = 0; i < ilb_conn_wheel_size; i++) {
+		cw = ilbs->ilbs_conn_wheel + i;
+		mutex_init(&cw->cw_lock, NULL, MUTEX_DEFAULT, NULL);
+		list_create(&cw->cw_head, sizeof (ilb_conn_t),
+		    offsetof(ilb_conn_t, conn_wheel_node));
 	}
+	ilbs->ilbs_conn_wheel_cur = ILB_CONN_WHEEL_TICK(ddi_get_lbolt64());
+
+	ASSERT(ilbs->ilbs_conn_timer == NULL);
+	tm = kmem_zalloc(sizeof (ilb_timer_t), KM_SLEEP);
+	tm->ilbs = ilbs;
+	mutex_init(&tm->tid_lock, NULL, MUTEX_DEFAULT, NULL);
+	ilbs->ilbs_conn_timer = tm;
+	tm->tid = timeout(ilb_conn_timer, tm,
+	    SEC_TO_TICK(ilb_conn_wheel_tick));
 }
 
 void
@@ -367,27 +470,42 @@ ilb_conn_hash_fini(ilb_stack_t *ilbs)
 	uint32_t i;
 	ilb_conn_t *connp;
 	ilb_conn_hash_t *hash;
+	ilb_conn_wheel_t *cw;
+	ilb_timer_t *tm;
+	timeout_id_t tid;
 
 	if (ilbs->ilbs_c2s_conn_hash == NULL) {
 		ASSERT(ilbs->ilbs_s2c_conn_hash == NULL);
 		return;
 	}
 
-	/* Stop all the timers first. */
-	for (i = 0; i < ilb_conn_timer_size; i++) {
-		timeout_id_t tid;
-
-		/* Setting tid to 0 tells the timer handler not to restart. */
-		mutex_enter(&ilbs->ilbs_conn_timer_list[i].tid_lock);
-		tid = ilbs->ilbs_conn_timer_list[i].tid;
-		ilbs->ilbs_conn_timer_list[i].tid = 0;
-		mutex_exit(&ilbs->ilbs_conn_timer_list[i].tid_lock);
-		(void) untimeout(tid);
-	}
-	kmem_free(ilbs->ilbs_conn_timer_list, sizeof (ilb_timer_t) *
-	    ilb_conn_timer_size);
+	/*
+	 * Stop the timer first.  Setting tid to 0 tells the timer wheel
+	 * routine not to restart it.
+	 */
+	tm = ilbs->ilbs_conn_timer;
+	mutex_enter(&tm->tid_lock);
+	tid = tm->tid;
+	tm->tid = 0;
+	mutex_exit(&tm->tid_lock);
+	(void) untimeout(tid);
 	taskq_destroy(ilbs->ilbs_conn_taskq);
 	ilbs->ilbs_conn_taskq = NULL;
+	mutex_destroy(&tm->tid_lock);
+	kmem_free(tm, sizeof (ilb_timer_t));
+	ilbs->ilbs_conn_timer = NULL;
+
+	/* The conns are freed below, just take them off the timer wheel. */
+	for (i = 0; i < ilb_conn_wheel_size; i++) {
+		cw = ilbs->ilbs_conn_wheel + i;
+		while (list_remove_head(&cw->cw_head) != NULL)
+			;
+		list_destroy(&cw->cw_head);
+		mutex_destroy(&cw->cw_lock);
+	}
+	kmem_free(ilbs->ilbs_conn_wheel, sizeof (ilb_conn_wheel_t) *
+	    ilb_conn_wheel_size);
+	ilbs->ilbs_conn_wheel = NULL;
 
 	/* Then remove all the conns. */
 	hash = ilbs->ilbs_s2c_conn_hash;
@@ -532,6 +650,7 @@ ilb_conn_add(ilb_stack_t *ilbs, ilb_rule_t *rule, ilb_server_t *server,
 	connp->conn_rule_cache.info = *info;
 
 	connp->conn_gc = B_FALSE;
+	connp->conn_wheel_slot = -1;
 
 	connp->conn_expiry = rule->ir_nat_expiry;
 	connp->conn_cr_time = ddi_get_lbolt64();
@@ -684,6 +803,10 @@ ilb_conn_add(ilb_stack_t *ilbs, ilb_rule_t *rule, ilb_server_t *server,
 	hash[i].ilb_connp = connp;
 	mutex_exit(&hash[i].ilb_conn_hash_lock);
 
+	/* Only the timer wheel removes an entry, so it is safe to add now. */
+	ilb_conn_wheel_add(ilbs, connp,
+	    ilb_conn_due(connp, connp->conn_cr_time));
+
 	return (0);
 }
 
@@ -754,8 +877,11 @@ ilb_find_conn(ilb_stack_t *ilbs, void *iph, void *tph, int l4, in6_addr_t *src,
 	uint_t i;
 	ilb_conn_t *connp;
 	boolean_t tcp_alive;
+	boolean_t recheck = B_FALSE;
 	boolean_t ret = B_FALSE;
+	int64_t now, die_time;
 
+	now = ddi_get_lbolt64();
 	i = ILB_CONN_HASH((uint8_t *)&src->s6_addr32[3], ntohs(sport),
 	    (uint8_t *)&dst->s6_addr32[3], ntohs(dport),
 	    ilbs->ilbs_conn_hash_size);
@@ -769,7 +895,7 @@ ilb_find_conn(ilb_stack_t *ilbs, void *iph, void *tph, int l4, in6_addr_t *src,
 			    connp->conn_c2s_sport == sport &&
 			    IN6_ARE_ADDR_EQUAL(src, &connp->conn_c2s_saddr) &&
 			    IN6_ARE_ADDR_EQUAL(dst, &connp->conn_c2s_daddr)) {
-				connp->conn_c2s_atime = ddi_get_lbolt64();
+				connp->conn_c2s_atime = now;
 				connp->conn_c2s_pkt_cnt++;
 				*rule_cache = connp->conn_rule_cache;
 				*ip_sum = connp->conn_c2s_ip_sum;
@@ -788,7 +914,7 @@ ilb_find_conn(ilb_stack_t *ilbs, void *iph, void *tph, int l4, in6_addr_t *src,
 			    connp->conn_s2c_sport == sport &&
 			    IN6_ARE_ADDR_EQUAL(src, &connp->conn_s2c_saddr) &&
 			    IN6_ARE_ADDR_EQUAL(dst, &connp->conn_s2c_daddr)) {
-				connp->conn_s2c_atime = ddi_get_lbolt64();
+				connp->conn_s2c_atime = now;
 				connp->conn_s2c_pkt_cnt++;
 				*rule_cache = connp->conn_rule_cache;
 				*ip_sum = connp->conn_s2c_ip_sum;
@@ -809,11 +935,26 @@ ilb_find_conn(ilb_stack_t *ilbs, void *iph, void *tph, int l4, in6_addr_t *src,
 			    c2s);
 			if (!tcp_alive) {
 				connp->conn_gc = B_TRUE;
+				recheck = B_TRUE;
+			} else if (((tcpha_t *)tph)->tha_flags & TH_FIN) {
+				recheck = B_TRUE;
 			}
 			break;
 		default:
 			break;
 		}
+
+		/*
+		 * The timer wheel only looks at an entry when it is due to
+		 * expire.  Have it look sooner if the conn is going away or
+		 * the drain time of its server is up.
+		 */
+		die_time = connp->conn_server->iser_die_time;
+		if (die_time != 0 && die_time < now)
+			recheck = B_TRUE;
+		if (recheck)
+			ilb_conn_wheel_move(ilbs, connp,
+			    ilb_conn_due(connp, now));
 	}
 	mutex_exit(&hash[i].ilb_conn_hash_lock);
 
@@ -51,6 +51,22 @@ typedef struct ilb_conn_hash_s {
 #endif
 } ilb_conn_hash_t;
 
+/*
+ * Struct of a slot in the conn expiry timer wheel
+ *
+ * cw_head: list of conn hash entries to be checked when this slot is due
+ * cw_lock: mutex to protect the list
+ */
+typedef struct ilb_conn_wheel_s {
+	list_t			cw_head;
+	kmutex_t		cw_lock;
+#if defined(_LP64) || defined(_I32LPx)
+	char			cw_pad[24];
+#else
+	char			cw_pad[40];
+#endif
+} ilb_conn_wheel_t;
+
 /*
  * Extracted rule/server info for faster access without holding a reference
  * to a rule or server.
@@ -118,6 +134,10 @@ struct ilb_conn_info {
  * conn_sticky: pointer to the sticky info of this client, used to do
  *              reference counting on the sticky info.
  * conn_gc: indicates whether this entry needs to be garbage collected
+ * conn_wheel_node: linked list node of the timer wheel slot
+ * conn_wheel_slot: index of the timer wheel slot holding this entry, -1 if
+ *                  it is not on the wheel
+ * conn_wheel_time: time this entry is due to be checked on the wheel
  */
 typedef struct ilb_conn_s {
 	int			conn_l4;
@@ -172,6 +192,11 @@ typedef struct ilb_conn_s {
 	struct ilb_sticky_s	*conn_sticky;
 
 	boolean_t		conn_gc;
+
+	/* Protected by the cw_lock of the slot it is on. */
+	list_node_t		conn_wheel_node;
+	int			conn_wheel_slot;
+	int64_t			conn_wheel_time;
 } ilb_conn_t;
 
 /*
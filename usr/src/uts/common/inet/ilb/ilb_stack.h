@@ -68,14 +68,18 @@ typedef struct ilb_stack {
 	 * ilbs_conn_hash_szie: size of the conn cache hash table
 	 * ilbs_c2s_conn_hash: client to server conn cache hash table
 	 * ilbs_s2c_conn_hash: server to client conn cache hash table
-	 * ilbs_conn_timer_list: list of all timers for handling conn cache
+	 * ilbs_conn_timer: timer driving the conn cache expiry timer wheel
 	 * ilbs_conn_taskq: taskq for conn cache related delayed processing
+	 * ilbs_conn_wheel: conn cache expiry timer wheel
+	 * ilbs_conn_wheel_cur: the last timer wheel tick processed
 	 */
 	size_t				ilbs_conn_hash_size;
 	struct ilb_conn_hash_s		*ilbs_c2s_conn_hash;
 	struct ilb_conn_hash_s		*ilbs_s2c_conn_hash;
-	struct ilb_timer_s		*ilbs_conn_timer_list;
+	struct ilb_timer_s		*ilbs_conn_timer;
 	taskq_t				*ilbs_conn_taskq;
+	struct ilb_conn_wheel_s		*ilbs_conn_wheel;
+	int64_t				ilbs_conn_wheel_cur;
 
 	/*
 	 * Sticky (persistent) cache info
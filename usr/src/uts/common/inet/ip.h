@@ -2253,6 +2253,7 @@ struct ip_xmit_attr_s {
 #define	IXAF_LSO_CAPAB		0x200000000	/* Capable of LSO */
 #define	IXAF_VERIFY_ZCOPY	0x400000000	/* Check Zero Copy capability */
 #define	IXAF_ZCOPY_CAPAB	0x800000000	/* Capable of ZEROCOPY */
+#define	IXAF_GSO		0x1000000000	/* IP segments LSO sends */
 
 /*
  * The normal flags for sending packets e.g., icmp errors
@@ -2361,6 +2362,9 @@ struct ip_recv_attr_s {
 
 	uint32_t	ira_esp_udp_ports;	/* IRAF_ESP_UDP_PORTS */
 
+	/* Async ESP crypto requests for the chain. IRAF_CRYPTO_BATCH */
+	struct crypto_batch *ira_crypto_batch;
+
 	/*
 	 * For IP_RECVSLLA and ip_ndp_conflict/find_solicitation.
 	 * Same size as max for sockaddr_dl
@@ -2412,7 +2416,7 @@ struct ip_recv_attr_s {
 
 #define	IRAF_L2DST_MULTICAST	0x01000000	/* Multicast at L2 */
 #define	IRAF_L2DST_BROADCAST	0x02000000	/* Broadcast at L2 */
-/* Unused 0x04000000 */
+#define	IRAF_CRYPTO_BATCH	0x04000000	/* ira_crypto_batch is set */
 /* Unused 0x08000000 */
 
 /* Below starts with 0x10000000 */
@@ -3044,6 +3048,7 @@ extern vmem_t *ip_minor_arena_la;
 #define	ips_ipv6_strict_src_multihoming	ips_propinfo_tbl[81].prop_cur_uval
 #define	ips_ipv6_drop_inbound_icmpv6	ips_propinfo_tbl[82].prop_cur_bval
 #define	ips_ip_dce_reclaim_threshold	ips_propinfo_tbl[83].prop_cur_uval
+#define	ips_ip_gso_outbound		ips_propinfo_tbl[84].prop_cur_bval
 
 extern int	dohwcksum;	/* use h/w cksum if supported by the h/w */
 #ifdef ZC_TEST
@@ -3311,6 +3316,8 @@ extern int	ip_output_simple_v6(mblk_t *, ip_xmit_attr_t *);
 extern int	ip_output_options(mblk_t *, ipha_t *, ip_xmit_attr_t *,
     ill_t *);
 extern void	ip_output_local_options(ipha_t *, ip_stack_t *);
+extern boolean_t ip_gso_usable(const ip_xmit_attr_t *);
+extern void	ip_gso_enable(ip_xmit_attr_t *);
 
 extern ip_xmit_attr_t *conn_get_ixa(conn_t *, boolean_t);
 extern ip_xmit_attr_t *conn_get_ixa_tryhard(conn_t *, boolean_t);
@@ -3591,6 +3598,8 @@ typedef int			(*ip_capab_func_t)(void *, uint_t,
  * specific acceptor functions.
  */
 typedef	mblk_t *(*ip_mac_rx_t)(void *, size_t);
+typedef	void *(*ip_mac_steer_t)(void *, processorid_t, uint32_t, uint32_t,
+    uint32_t);
 typedef mblk_t *(*ip_accept_t)(ill_t *, ill_rx_ring_t *,
     squeue_t *, mblk_t *, mblk_t **, uint_t *);
 
@@ -3608,6 +3617,7 @@ struct ill_rx_ring {
 	ip_mac_rx_t		rr_rx;		/* Driver receive function */
 	ip_accept_t		rr_ip_accept;	/* IP accept function */
 	void			*rr_rx_handle;	/* Handle for Rx ring */
+	ip_mac_steer_t		rr_steer;	/* Flow steering func */
 	squeue_t		*rr_sqp; /* Squeue the ring is bound to */
 	ill_t			*rr_ill;	/* back pointer to ill */
 	ip_ring_state_t		rr_ring_state;	/* State of this ring */
@@ -3650,6 +3660,8 @@ extern boolean_t 	ip_squeue_fanout;
 extern void ip_squeue_init(void (*)(squeue_t *));
 extern squeue_t	*ip_squeue_random(uint_t);
 extern squeue_t *ip_squeue_get(ill_rx_ring_t *);
+extern squeue_t *ip_squeue_steer(ip_recv_attr_t *, processorid_t, ipaddr_t,
+    ipaddr_t, uint32_t);
 extern squeue_t *ip_squeue_getfree(pri_t);
 extern int ip_squeue_cpu_move(squeue_t *, processorid_t);
 extern void *ip_squeue_add_ring(ill_t *, void *);
@@ -3772,6 +3784,8 @@ extern int	inet_pton(int, char *, void *);
 #define	SQTAG_TCP_SHUTDOWN_OUTPUT	43
 #define	SQTAG_TCP_IXA_CLEANUP		44
 #define	SQTAG_TCP_SEND_SYNACK		45
+#define	SQTAG_TCP_RX_STEER		46
+#define	SQTAG_SCTP_INPUT		47
 
 extern sin_t	sin_null;	/* Zero address for quick clears */
 extern sin6_t	sin6_null;	/* Zero address for quick clears */
@@ -674,6 +674,9 @@ conn_opt_get(conn_opt_arg_t *coa, t_scalar_t level, t_scalar_t name,
 		case SO_EXCLBIND:
 			*i1 = connp->conn_exclbind ? SO_EXCLBIND : 0;
 			break;
+		case SO_REUSEPORT:
+			*i1 = connp->conn_reuseport ? SO_REUSEPORT : 0;
+			break;
 		case SO_PROTOTYPE:
 			*i1 = connp->conn_proto;
 			break;
@@ -1164,6 +1167,9 @@ conn_opt_set_socket(conn_opt_arg_t *coa, t_scalar_t name, uint_t inlen,
 	case SO_EXCLBIND:
 		connp->conn_exclbind = onoff;
 		break;
+	case SO_REUSEPORT:
+		connp->conn_reuseport = onoff;
+		break;
 	}
 	mutex_exit(&connp->conn_lock);
 	return (0);
@@ -2683,8 +2689,12 @@ conn_connect(conn_t *connp, iulp_t *uinfo, uint32_t flags)
 	 *
 	 * Currently, won't enable LSO for IRE_LOOPBACK or IRE_LOCAL, because
 	 * the receiver can not handle it. Also not to enable LSO for MULTIRT.
+	 *
+	 * If the ill can't do LSO, IP can still take the large sends and
+	 * segment them itself just before handing them to the ill; see
+	 * ip_output_gso_v4().
 	 */
-	ixa->ixa_flags &= ~IXAF_LSO_CAPAB;
+	ixa->ixa_flags &= ~(IXAF_LSO_CAPAB | IXAF_GSO);
 
 	ASSERT(ixa->ixa_ire != NULL);
 	if (ixa->ixa_ipst->ips_ip_lso_outbound && (flags & IPDF_LSO) &&
@@ -2697,6 +2707,9 @@ conn_connect(conn_t *connp, iulp_t *uinfo, uint32_t flags)
 	    ILL_LSO_TCP_IPV6_USABLE(ixa->ixa_nce->nce_ill))) {
 		ixa->ixa_lso_capab = *ixa->ixa_nce->nce_ill->ill_lso_capab;
 		ixa->ixa_flags |= IXAF_LSO_CAPAB;
+	} else if ((flags & IPDF_LSO) && ixa->ixa_nce != NULL &&
+	    ip_gso_usable(ixa)) {
+		ip_gso_enable(ixa);
 	}
 
 	/* Check whether ZEROCOPY capability is usable for this connection. */
@@ -3480,7 +3480,7 @@ ip_set_destination_v4(ipaddr_t *src_addrp, ipaddr_t dst_addr, ipaddr_t firsthop,
 		else
 			dce = dce_lookup_v4(dst_addr, ipst, &generation);
 	} else {
-		dce = dce_lookup_v4(dst_addr, ipst, &generation);
+		dce = ip_dcache_dce_v4(dst_addr, ipst, &generation);
 	}
 	ASSERT(dce != NULL);
 	if (ixa->ixa_dce != NULL)
@@ -4418,6 +4418,7 @@ ip_stack_fini(netstackid_t stackid, void *arg)
 	    ip_propinfo_count * sizeof (mod_prop_info_t));
 	ipst->ips_propinfo_tbl = NULL;
 
+	ip_dcache_fini(ipst);
 	dce_stack_destroy(ipst);
 	ip_mrouter_stack_destroy(ipst);
 
@@ -4648,6 +4649,7 @@ ip_stack_init(netstackid_t stackid, netstack_t *ns)
 	conn_drain_init(ipst);
 	ip_mrouter_stack_init(ipst);
 	dce_stack_init(ipst);
+	ip_dcache_init(ipst);
 
 	ipst->ips_ip_multirt_log_interval = 1000;
 
@@ -13961,6 +13963,10 @@ ip_kstat2_init(netstackid_t stackid, ip_stat_t *ip_statisticsp)
 		{ "conn_in_recvpktinfo",	KSTAT_DATA_UINT64 },
 		{ "conn_in_recvtclass",		KSTAT_DATA_UINT64 },
 		{ "conn_in_timestamp",		KSTAT_DATA_UINT64 },
+		{ "ip_out_gso",			KSTAT_DATA_UINT64 },
+		{ "ip_out_gso_segs",		KSTAT_DATA_UINT64 },
+		{ "ip_out_gso_fail",		KSTAT_DATA_UINT64 },
+		{ "ip_dcache_miss",		KSTAT_DATA_UINT64 },
 	};
 
 	ksp = kstat_create_netstack("ip", 0, "ipstat", "net",
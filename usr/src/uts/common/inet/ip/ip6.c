@@ -2098,7 +2098,7 @@ ip_set_destination_v6(in6_addr_t *src_addrp, const in6_addr_t *dst_addr,
 			    &generation);
 		}
 	} else {
-		dce = dce_lookup_v6(dst_addr, ifindex, ipst, &generation);
+		dce = ip_dcache_dce_v6(dst_addr, ifindex, ipst, &generation);
 	}
 	ASSERT(dce != NULL);
 	if (ixa->ixa_dce != NULL)
@@ -198,6 +198,7 @@ ip_input_common_v6(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 	ip6_t		*ip6h;
 	ip_recv_attr_t	iras;	/* Receive attributes */
 	rtc_t		rtc;
+	crypto_batch_t	cbatch;	/* Async ESP crypto requests */
 	iaflags_t	chain_flags = 0;	/* Fixed for chain */
 	mblk_t 		*ahead = NULL;	/* Accepted head */
 	mblk_t		*atail = NULL;	/* Accepted tail */
@@ -250,6 +251,14 @@ ip_input_common_v6(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 	rtc.rtc_ire = NULL;
 	rtc.rtc_ip6addr = ipv6_all_zeros;
 
+	/*
+	 * Asynchronous ESP requests are held in cbatch and handed to
+	 * KCF in one go once the whole chain has been through.
+	 */
+	bzero(&cbatch, sizeof (cbatch));
+	iras.ira_crypto_batch = &cbatch;
+	chain_flags |= IRAF_CRYPTO_BATCH;
+
 	/* Loop over b_next */
 	for (mp = mp_chain; mp != NULL; mp = mp_chain) {
 		mp_chain = mp->b_next;
@@ -384,6 +393,7 @@ ip_input_common_v6(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 		ASSERT(!IN6_IS_ADDR_UNSPECIFIED(&rtc.rtc_ip6addr));
 		ire_refrele(rtc.rtc_ire);
 	}
+	crypto_batch_submit(&cbatch);
 
 	if (ahead != NULL) {
 		/* Better be called from ip_accept_tcp */
@@ -794,7 +804,7 @@ ill_input_short_v6(mblk_t *mp, void *iph_arg, void *nexthop_arg,
 			ire = ire_linklocal(&nexthop, ill, ira, irr_flags,
 			    ipst);
 		} else {
-			ire = ire_route_recursive_dstonly_v6(&nexthop,
+			ire = ip_dcache_forward_v6(&nexthop,
 			    irr_flags, ira->ira_xmit_hint, ipst);
 		}
 		ASSERT(ire != NULL);
@@ -2273,6 +2283,10 @@ repeat:
 			return;
 		}
 
+		/* Pass up a squeue hint to sctp, see ip_fanout_v4 */
+		if (ira->ira_sqp == NULL)
+			ira->ira_sqp = ip_squeue_get(ira->ira_ring);
+
 		/* Found a client; up it goes */
 		BUMP_MIB(ill->ill_ip_mib, ipIfStatsHCInDelivers);
 		sctp_input(connp, NULL, ip6h, mp, ira);
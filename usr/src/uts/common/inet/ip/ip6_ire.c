@@ -1471,10 +1471,13 @@ ire_route_recursive_v6(const in6_addr_t *nexthop, uint_t ire_type,
  * If we find any IRE_LOCAL|BROADCAST etc past the first iteration it
  * is an error.
  * Allow at most one RTF_INDIRECT.
+ *
+ * If generationp is set, the generation of the returned ire is stored there,
+ * with IRE_GENERATION_VERIFY meaning that the caller should not cache it.
  */
 ire_t *
 ire_route_recursive_dstonly_v6(const in6_addr_t *nexthop, uint_t irr_flags,
-    uint32_t xmit_hint, ip_stack_t *ipst)
+    uint32_t xmit_hint, ip_stack_t *ipst, uint_t *generationp)
 {
 	ire_t	*ire;
 	ire_t	*ire1;
@@ -1495,6 +1498,8 @@ ire_route_recursive_dstonly_v6(const in6_addr_t *nexthop, uint_t irr_flags,
 		if (ire->ire_dep_parent->ire_generation ==
 		    ire->ire_dep_parent_generation) {
 			mutex_exit(&ire->ire_lock);
+			if (generationp != NULL)
+				*generationp = generation;
 			return (ire);
 		}
 		mutex_exit(&ire->ire_lock);
@@ -1505,8 +1510,11 @@ ire_route_recursive_dstonly_v6(const in6_addr_t *nexthop, uint_t irr_flags,
 		 * doesn't yet have one) then we are done. Includes
 		 * IRE_INTERFACE with a full 128 bit mask.
 		 */
-		if (ire->ire_nce_capable)
+		if (ire->ire_nce_capable) {
+			if (generationp != NULL)
+				*generationp = generation;
 			return (ire);
+		}
 	}
 
 	/*
@@ -1517,5 +1525,7 @@ ire_route_recursive_dstonly_v6(const in6_addr_t *nexthop, uint_t irr_flags,
 	    NULL, MATCH_IRE_DSTONLY, irr_flags, xmit_hint, ipst, NULL, NULL,
 	    &generation);
 	ire_refrele(ire);
+	if (generationp != NULL)
+		*generationp = generation;
 	return (ire1);
 }
@@ -228,7 +228,7 @@ repeat_ire:
 	if (IN6_IS_ADDR_LINKSCOPE(&dst))
 		ifindex = nce->nce_common->ncec_ill->ill_phyint->phyint_ifindex;
 
-	dce = dce_lookup_v6(&dst, ifindex, ipst, NULL);
+	dce = ip_dcache_dce_v6(&dst, ifindex, ipst, NULL);
 	ASSERT(dce != NULL);
 
 	if (!(ixaflags & IXAF_PMTU_DISCOVERY)) {
@@ -512,7 +512,8 @@ ip_recv_attr_to_mblk(ip_recv_attr_t *ira)
 
 	bzero(irm, sizeof (*irm));
 	irm->irm_inbound = B_TRUE;
-	irm->irm_flags = ira->ira_flags;
+	/* The crypto batch belongs to the ip_input() chain loop. */
+	irm->irm_flags = ira->ira_flags & ~IRAF_CRYPTO_BATCH;
 	if (ill != NULL) {
 		/* Internal to IP - preserve ip_stack_t, ill and rill */
 		irm->irm_stackid =
@@ -0,0 +1,498 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Per-CPU destination cache.
+ *
+ * Connections cache their ire_t and dce_t in the ip_xmit_attr_t, but
+ * packets that are forwarded, and datagrams sent to a new destination on
+ * an unconnected socket, look up the forwarding table and the dce hash
+ * for every packet (or every chain of packets for the same destination).
+ * Those lookups take the radix tree and bucket locks, which on a router
+ * forwarding from many CPUs means every CPU writing the same cache lines.
+ *
+ * Each CPU instead keeps a small direct-mapped table of recent results,
+ * holding a reference on each ire_t or dce_t together with the generation
+ * number it was looked up with.  The entry is used only if the generation
+ * still matches, which is the same check ip_output does on the cached
+ * ixa_ire and ixa_dce: any route change which could affect the result
+ * (including a parent route changing) bumps the generation, and condemned
+ * entries have their own generation number.  Results which depend on
+ * more than the destination are not cached: ECMP buckets, where the
+ * transmit hint selects the route, and lookups which return
+ * IRE_GENERATION_VERIFY.
+ *
+ * A CPU's table is only used with preemption disabled, and is claimed
+ * with a compare-and-swap on idc_busy, which is only ever contended by an
+ * interrupt on the same CPU or by ip_dcache_flush(); in both cases the
+ * loser bypasses the cache rather than waiting.  Displaced references are
+ * released after the table has been given back.
+ *
+ * The references held here would keep an ill from being unplumbed, so
+ * the cache is flushed wherever the conns are told to drop stale
+ * references with conn_ixa_cleanup.  The tables are allocated the first
+ * time a CPU misses; ip_dcache_size is their number of entries, and zero
+ * disables the cache.
+ */
+
+#include <sys/types.h>
+#include <sys/systm.h>
+#include <sys/kmem.h>
+#include <sys/cpuvar.h>
+#include <sys/cpu.h>
+#include <sys/atomic.h>
+#include <sys/debug.h>
+
+#include <netinet/in.h>
+#include <inet/common.h>
+#include <inet/ip.h>
+#include <inet/ip6.h>
+#include <inet/ip_ire.h>
+
+#include <sys/tsol/label.h>
+
+uint_t ip_dcache_size = 64;
+
+/* ide_kind values */
+#define	IDE_FORWARD	0x1	/* ire_route_recursive_dstonly */
+#define	IDE_ROUTE	0x2	/* ire_route_recursive, no ill or label */
+#define	IDE_DCE		0x3	/* dce_lookup */
+#define	IDE_V6		0x10
+
+typedef struct ip_dcache_ent_s {
+	in6_addr_t	ide_dst;
+	uint_t		ide_kind;
+	uint_t		ide_arg;	/* irr_flags or zoneid */
+	ire_t		*ide_ire;
+	dce_t		*ide_dce;
+	uint_t		ide_generation;
+	in6_addr_t	ide_setsrc;
+} ip_dcache_ent_t;
+
+typedef struct ip_dcache_s {
+	volatile uint_t	idc_busy;
+	uint_t		idc_mask;
+	ip_dcache_ent_t	idc_ent[1];
+} ip_dcache_t;
+
+#define	IP_DCACHE_ALLOCSIZE(n)	\
+	(offsetof(ip_dcache_t, idc_ent) + (n) * sizeof (ip_dcache_ent_t))
+
+static uint_t
+ip_dcache_hash(const in6_addr_t *dst, uint_t kind, uint_t mask)
+{
+	uint32_t h;
+
+	h = dst->s6_addr32[0] ^ dst->s6_addr32[1] ^ dst->s6_addr32[2] ^
+	    dst->s6_addr32[3];
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return ((h ^ kind) & mask);
+}
+
+/*
+ * Claim this CPU's table.  Returns NULL, with preemption enabled, if the
+ * cache is disabled or the table is in use.
+ */
+static ip_dcache_t *
+ip_dcache_enter(ip_stack_t *ipst)
+{
+	ip_dcache_t	*idc;
+
+	if (ipst->ips_dcache == NULL)
+		return (NULL);
+
+	kpreempt_disable();
+	idc = ipst->ips_dcache[CPU->cpu_seqid];
+	if (idc == NULL || atomic_cas_uint(&idc->idc_busy, 0, 1) != 0) {
+		kpreempt_enable();
+		return (NULL);
+	}
+	membar_enter();
+	return (idc);
+}
+
+static void
+ip_dcache_exit(ip_dcache_t *idc)
+{
+	membar_exit();
+	idc->idc_busy = 0;
+	kpreempt_enable();
+}
+
+/*
+ * Find a current entry and take a reference on its result.
+ */
+static boolean_t
+ip_dcache_get(ip_stack_t *ipst, const in6_addr_t *dst, uint_t kind,
+    uint_t arg, ire_t **irep, dce_t **dcep, uint_t *generationp,
+    in6_addr_t *setsrcp)
+{
+	ip_dcache_t	*idc;
+	ip_dcache_ent_t	*ide;
+	boolean_t	hit = B_FALSE;
+
+	if ((idc = ip_dcache_enter(ipst)) == NULL)
+		return (B_FALSE);
+
+	ide = &idc->idc_ent[ip_dcache_hash(dst, kind, idc->idc_mask)];
+	if (ide->ide_kind != kind || ide->ide_arg != arg ||
+	    !IN6_ARE_ADDR_EQUAL(&ide->ide_dst, dst)) {
+		ip_dcache_exit(idc);
+		return (B_FALSE);
+	}
+
+	if (ide->ide_ire != NULL &&
+	    ide->ide_ire->ire_generation == ide->ide_generation) {
+		ire_refhold(ide->ide_ire);
+		*irep = ide->ide_ire;
+		if (setsrcp != NULL)
+			*setsrcp = ide->ide_setsrc;
+		hit = B_TRUE;
+	} else if (ide->ide_dce != NULL &&
+	    ide->ide_dce->dce_generation == ide->ide_generation) {
+		dce_refhold(ide->ide_dce);
+		*dcep = ide->ide_dce;
+		hit = B_TRUE;
+	}
+	if (hit && generationp != NULL)
+		*generationp = ide->ide_generation;
+	ip_dcache_exit(idc);
+	return (hit);
+}
+
+/*
+ * Allocate this CPU's table.  Called after a miss, so an allocation
+ * failure only means the next miss will try again.
+ */
+static void
+ip_dcache_alloc(ip_stack_t *ipst)
+{
+	ip_dcache_t	*idc;
+	uint_t		n = ipst->ips_dcache_size;
+	processorid_t	seqid;
+
+	idc = kmem_zalloc(IP_DCACHE_ALLOCSIZE(n), KM_NOSLEEP);
+	if (idc == NULL)
+		return;
+	idc->idc_mask = n - 1;
+
+	/*
+	 * We may have migrated since the miss; this still fills in the
+	 * table of whichever CPU we are now on.
+	 */
+	kpreempt_disable();
+	seqid = CPU->cpu_seqid;
+	membar_producer();
+	if (atomic_cas_ptr(&ipst->ips_dcache[seqid], NULL, idc) == NULL)
+		idc = NULL;
+	kpreempt_enable();
+	if (idc != NULL)
+		kmem_free(idc, IP_DCACHE_ALLOCSIZE(n));
+}
+
+/*
+ * Enter a result into this CPU's table, taking a reference for it, and
+ * release whatever it displaced.
+ */
+static void
+ip_dcache_put(ip_stack_t *ipst, const in6_addr_t *dst, uint_t kind,
+    uint_t arg, ire_t *ire, dce_t *dce, uint_t generation,
+    const in6_addr_t *setsrcp)
+{
+	ip_dcache_t	*idc;
+	ip_dcache_ent_t	*ide;
+	ire_t		*oire;
+	dce_t		*odce;
+
+	if (ipst->ips_dcache == NULL)
+		return;
+	if (ipst->ips_dcache[CPU->cpu_seqid] == NULL)
+		ip_dcache_alloc(ipst);
+	if ((idc = ip_dcache_enter(ipst)) == NULL)
+		return;
+
+	if (ire != NULL)
+		ire_refhold(ire);
+	else
+		dce_refhold(dce);
+
+	ide = &idc->idc_ent[ip_dcache_hash(dst, kind, idc->idc_mask)];
+	oire = ide->ide_ire;
+	odce = ide->ide_dce;
+	ide->ide_dst = *dst;
+	ide->ide_kind = kind;
+	ide->ide_arg = arg;
+	ide->ide_ire = ire;
+	ide->ide_dce = dce;
+	ide->ide_generation = generation;
+	if (setsrcp != NULL)
+		ide->ide_setsrc = *setsrcp;
+	else
+		ide->ide_setsrc = ipv6_all_zeros;
+	ip_dcache_exit(idc);
+
+	if (oire != NULL)
+		ire_refrele(oire);
+	if (odce != NULL)
+		dce_refrele(odce);
+}
+
+/*
+ * Whether a route lookup result can be reused for other packets to the
+ * same destination.
+ */
+static boolean_t
+ip_dcache_cacheable(const ire_t *ire, uint_t generation)
+{
+	if (generation == IRE_GENERATION_VERIFY ||
+	    generation == IRE_GENERATION_CONDEMNED)
+		return (B_FALSE);
+	if (ire->ire_type & IRE_NOROUTE)
+		return (B_FALSE);
+	if (ire->ire_bucket != NULL && ire->ire_bucket->irb_ire_cnt > 1)
+		return (B_FALSE);
+	return (B_TRUE);
+}
+
+/*
+ * ire_route_recursive_dstonly_v4 for ip_input_forward.
+ */
+ire_t *
+ip_dcache_forward_v4(ipaddr_t nexthop, uint_t irr_flags, uint32_t xmit_hint,
+    ip_stack_t *ipst)
+{
+	in6_addr_t	dst;
+	ire_t		*ire = NULL;
+	dce_t		*dce = NULL;
+	uint_t		generation;
+
+	IN6_IPADDR_TO_V4MAPPED(nexthop, &dst);
+	if (ip_dcache_get(ipst, &dst, IDE_FORWARD, irr_flags, &ire, &dce,
+	    NULL, NULL))
+		return (ire);
+
+	ire = ire_route_recursive_dstonly_v4(nexthop, irr_flags, xmit_hint,
+	    ipst, &generation);
+	if (ipst->ips_dcache != NULL) {
+		IP_STAT(ipst, ip_dcache_miss);
+		if (ip_dcache_cacheable(ire, generation)) {
+			ip_dcache_put(ipst, &dst, IDE_FORWARD, irr_flags, ire,
+			    NULL, generation, NULL);
+		}
+	}
+	return (ire);
+}
+
+/*
+ * ire_route_recursive_dstonly_v6 for ip_input_forward_v6.
+ */
+ire_t *
+ip_dcache_forward_v6(const in6_addr_t *nexthop, uint_t irr_flags,
+    uint32_t xmit_hint, ip_stack_t *ipst)
+{
+	ire_t		*ire = NULL;
+	dce_t		*dce = NULL;
+	uint_t		generation;
+
+	if (ip_dcache_get(ipst, nexthop, IDE_FORWARD | IDE_V6, irr_flags,
+	    &ire, &dce, NULL, NULL))
+		return (ire);
+
+	ire = ire_route_recursive_dstonly_v6(nexthop, irr_flags, xmit_hint,
+	    ipst, &generation);
+	if (ipst->ips_dcache != NULL) {
+		IP_STAT(ipst, ip_dcache_miss);
+		if (ip_dcache_cacheable(ire, generation)) {
+			ip_dcache_put(ipst, nexthop, IDE_FORWARD | IDE_V6,
+			    irr_flags, ire, NULL, generation, NULL);
+		}
+	}
+	return (ire);
+}
+
+/*
+ * The unicast lookup in ip_select_route when there is no ill, ire type or
+ * label to match; setsrcp is v4-mapped for IPv4.  The result is cached
+ * per zone, since zones may see different routes.
+ */
+ire_t *
+ip_dcache_route(const in6_addr_t *nexthop, boolean_t isv6, zoneid_t zoneid,
+    uint32_t xmit_hint, ip_stack_t *ipst, in6_addr_t *setsrcp,
+    uint_t *generationp)
+{
+	ire_t		*ire = NULL;
+	dce_t		*dce = NULL;
+	uint_t		kind = isv6 ? IDE_ROUTE | IDE_V6 : IDE_ROUTE;
+	uint_t		generation;
+	in6_addr_t	setsrc = ipv6_all_zeros;
+	boolean_t	cache;
+
+	cache = (ipst->ips_dcache != NULL && !is_system_labeled());
+	if (cache && ip_dcache_get(ipst, nexthop, kind, (uint_t)zoneid,
+	    &ire, &dce, generationp, setsrcp))
+		return (ire);
+
+	if (!isv6) {
+		ipaddr_t	v4nexthop;
+		ipaddr_t	v4setsrc = INADDR_ANY;
+
+		IN6_V4MAPPED_TO_IPADDR(nexthop, v4nexthop);
+		ire = ire_route_recursive_v4(v4nexthop, 0, NULL, zoneid, NULL,
+		    MATCH_IRE_SECATTR, IRR_ALLOCATE, xmit_hint, ipst,
+		    &v4setsrc, NULL, &generation);
+		IN6_IPADDR_TO_V4MAPPED(v4setsrc, &setsrc);
+	} else {
+		ire = ire_route_recursive_v6(nexthop, 0, NULL, zoneid, NULL,
+		    MATCH_IRE_SECATTR, IRR_ALLOCATE, xmit_hint, ipst,
+		    &setsrc, NULL, &generation);
+	}
+	if (setsrcp != NULL)
+		*setsrcp = setsrc;
+	if (generationp != NULL)
+		*generationp = generation;
+
+	if (cache) {
+		IP_STAT(ipst, ip_dcache_miss);
+		if (ip_dcache_cacheable(ire, generation)) {
+			ip_dcache_put(ipst, nexthop, kind, (uint_t)zoneid,
+			    ire, NULL, generation, &setsrc);
+		}
+	}
+	return (ire);
+}
+
+/*
+ * dce_lookup_v4.  The default dce is cached too, since its generation
+ * changes whenever a dce is added.
+ */
+dce_t *
+ip_dcache_dce_v4(ipaddr_t dst, ip_stack_t *ipst, uint_t *generationp)
+{
+	in6_addr_t	dst6;
+	ire_t		*ire = NULL;
+	dce_t		*dce = NULL;
+	uint_t		generation;
+
+	IN6_IPADDR_TO_V4MAPPED(dst, &dst6);
+	if (ip_dcache_get(ipst, &dst6, IDE_DCE, 0, &ire, &dce, generationp,
+	    NULL))
+		return (dce);
+
+	dce = dce_lookup_v4(dst, ipst, &generation);
+	if (generationp != NULL)
+		*generationp = generation;
+	if (ipst->ips_dcache != NULL) {
+		IP_STAT(ipst, ip_dcache_miss);
+		if (generation != DCE_GENERATION_VERIFY &&
+		    generation != DCE_GENERATION_CONDEMNED) {
+			ip_dcache_put(ipst, &dst6, IDE_DCE, 0, NULL, dce,
+			    generation, NULL);
+		}
+	}
+	return (dce);
+}
+
+/*
+ * dce_lookup_v6, cached by destination and interface index.
+ */
+dce_t *
+ip_dcache_dce_v6(const in6_addr_t *dst, uint_t ifindex, ip_stack_t *ipst,
+    uint_t *generationp)
+{
+	ire_t		*ire = NULL;
+	dce_t		*dce = NULL;
+	uint_t		generation;
+
+	if (ip_dcache_get(ipst, dst, IDE_DCE | IDE_V6, ifindex, &ire, &dce,
+	    generationp, NULL))
+		return (dce);
+
+	dce = dce_lookup_v6(dst, ifindex, ipst, &generation);
+	if (generationp != NULL)
+		*generationp = generation;
+	if (ipst->ips_dcache != NULL) {
+		IP_STAT(ipst, ip_dcache_miss);
+		if (generation != DCE_GENERATION_VERIFY &&
+		    generation != DCE_GENERATION_CONDEMNED) {
+			ip_dcache_put(ipst, dst, IDE_DCE | IDE_V6, ifindex,
+			    NULL, dce, generation, NULL);
+		}
+	}
+	return (dce);
+}
+
+/*
+ * Drop every cached reference.  Lookups which race with the flush simply
+ * bypass the table being flushed.
+ */
+void
+ip_dcache_flush(ip_stack_t *ipst)
+{
+	ip_dcache_t	*idc;
+	ip_dcache_ent_t	*ide;
+	int		i;
+	uint_t		j;
+
+	if (ipst->ips_dcache == NULL)
+		return;
+
+	for (i = 0; i < max_ncpus; i++) {
+		if ((idc = ipst->ips_dcache[i]) == NULL)
+			continue;
+		while (atomic_cas_uint(&idc->idc_busy, 0, 1) != 0)
+			SMT_PAUSE();
+		membar_enter();
+		for (j = 0; j <= idc->idc_mask; j++) {
+			ide = &idc->idc_ent[j];
+			if (ide->ide_ire != NULL)
+				ire_refrele(ide->ide_ire);
+			if (ide->ide_dce != NULL)
+				dce_refrele(ide->ide_dce);
+			bzero(ide, sizeof (*ide));
+		}
+		membar_exit();
+		idc->idc_busy = 0;
+	}
+}
+
+void
+ip_dcache_init(ip_stack_t *ipst)
+{
+	uint_t	n = ip_dcache_size;
+
+	if (n == 0 || !ISP2(n)) {
+		ipst->ips_dcache = NULL;
+		return;
+	}
+	ipst->ips_dcache_size = n;
+	ipst->ips_dcache = kmem_zalloc(max_ncpus * sizeof (ip_dcache_t *),
+	    KM_SLEEP);
+}
+
+void
+ip_dcache_fini(ip_stack_t *ipst)
+{
+	int	i;
+
+	if (ipst->ips_dcache == NULL)
+		return;
+
+	ip_dcache_flush(ipst);
+	for (i = 0; i < max_ncpus; i++) {
+		if (ipst->ips_dcache[i] != NULL) {
+			kmem_free(ipst->ips_dcache[i],
+			    IP_DCACHE_ALLOCSIZE(ipst->ips_dcache_size));
+		}
+	}
+	kmem_free(ipst->ips_dcache, max_ncpus * sizeof (ip_dcache_t *));
+	ipst->ips_dcache = NULL;
+}
@@ -1271,7 +1271,12 @@ ip_select_route(const in6_addr_t *v6dst, const in6_addr_t v6src,
 	}
 
 retry:
-	if (!isv6) {
+	if (ill == NULL && match_args == MATCH_IRE_SECATTR &&
+	    ixa->ixa_tsl == NULL) {
+		/* Nothing but the destination matters; try the cache */
+		ire = ip_dcache_route(&v6nexthop, isv6, ixa->ixa_zoneid,
+		    ixa->ixa_xmit_hint, ipst, setsrcp, generationp);
+	} else if (!isv6) {
 		ipaddr_t	v4nexthop;
 		ipaddr_t	v4setsrc = INADDR_ANY;
 
@@ -1713,10 +1718,13 @@ ire_route_recursive_v4(ipaddr_t nexthop, uint_t ire_type, const ill_t *ill,
  * If we find any IRE_LOCAL|BROADCAST etc past the first iteration it
  * is an error.
  * Allow at most one RTF_INDIRECT.
+ *
+ * If generationp is set, the generation of the returned ire is stored there,
+ * with IRE_GENERATION_VERIFY meaning that the caller should not cache it.
  */
 ire_t *
 ire_route_recursive_dstonly_v4(ipaddr_t nexthop, uint_t irr_flags,
-    uint32_t xmit_hint, ip_stack_t *ipst)
+    uint32_t xmit_hint, ip_stack_t *ipst, uint_t *generationp)
 {
 	ire_t	*ire;
 	ire_t	*ire1;
@@ -1736,6 +1744,8 @@ ire_route_recursive_dstonly_v4(ipaddr_t nexthop, uint_t irr_flags,
 		if (ire->ire_dep_parent->ire_generation ==
 		    ire->ire_dep_parent_generation) {
 			mutex_exit(&ire->ire_lock);
+			if (generationp != NULL)
+				*generationp = generation;
 			return (ire);
 		}
 		mutex_exit(&ire->ire_lock);
@@ -1746,8 +1756,11 @@ ire_route_recursive_dstonly_v4(ipaddr_t nexthop, uint_t irr_flags,
 		 * doesn't yet have one) then we are done. Includes
 		 * IRE_INTERFACE with a full 32 bit mask.
 		 */
-		if (ire->ire_nce_capable)
+		if (ire->ire_nce_capable) {
+			if (generationp != NULL)
+				*generationp = generation;
 			return (ire);
+		}
 	}
 
 	/*
@@ -1758,6 +1771,8 @@ ire_route_recursive_dstonly_v4(ipaddr_t nexthop, uint_t irr_flags,
 	    NULL, MATCH_IRE_DSTONLY, irr_flags, xmit_hint, ipst, NULL, NULL,
 	    &generation);
 	ire_refrele(ire);
+	if (generationp != NULL)
+		*generationp = generation;
 	return (ire1);
 }
 
@@ -448,6 +448,7 @@ ill_delete(ill_t *ill)
 	 * ill (we actually walk all that now have stale references).
 	 */
 	ipcl_walk(conn_ixa_cleanup, (void *)B_TRUE, ipst);
+	ip_dcache_flush(ipst);
 
 	/* With IPv6 we have dce_ifindex. Cleanup for neatness */
 	if (ill->ill_isv6)
@@ -1169,6 +1170,7 @@ ill_down_start(queue_t *q, mblk_t *mp)
 	 * ill (we actually walk all that now have stale references).
 	 */
 	ipcl_walk(conn_ixa_cleanup, (void *)B_TRUE, ill->ill_ipst);
+	ip_dcache_flush(ill->ill_ipst);
 
 	/* With IPv6 we have dce_ifindex. Cleanup for neatness */
 	if (ill->ill_isv6)
@@ -13418,6 +13420,7 @@ ipif_down(ipif_t *ipif, queue_t *q, mblk_t *mp)
 	 * ipif (we actually walk all that now have stale references).
 	 */
 	ipcl_walk(conn_ixa_cleanup, (void *)B_TRUE, ipst);
+	ip_dcache_flush(ipst);
 
 	/*
 	 * If mp is NULL the caller will wait for the appropriate refcnt.
@@ -201,6 +201,7 @@ ip_input_common_v4(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 	ipha_t		*ipha;
 	ip_recv_attr_t	iras;	/* Receive attributes */
 	rtc_t		rtc;
+	crypto_batch_t	cbatch;	/* Async ESP crypto requests */
 	iaflags_t	chain_flags = 0;	/* Fixed for chain */
 	mblk_t 		*ahead = NULL;	/* Accepted head */
 	mblk_t		*atail = NULL;	/* Accepted tail */
@@ -253,6 +254,14 @@ ip_input_common_v4(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 	rtc.rtc_ire = NULL;
 	rtc.rtc_ipaddr = INADDR_ANY;
 
+	/*
+	 * Asynchronous ESP requests are held in cbatch and handed to
+	 * KCF in one go once the whole chain has been through.
+	 */
+	bzero(&cbatch, sizeof (cbatch));
+	iras.ira_crypto_batch = &cbatch;
+	chain_flags |= IRAF_CRYPTO_BATCH;
+
 	/* Loop over b_next */
 	for (mp = mp_chain; mp != NULL; mp = mp_chain) {
 		mp_chain = mp->b_next;
@@ -402,6 +411,7 @@ ip_input_common_v4(ill_t *ill, ill_rx_ring_t *ip_ring, mblk_t *mp_chain,
 		ASSERT(rtc.rtc_ipaddr != INADDR_ANY);
 		ire_refrele(rtc.rtc_ire);
 	}
+	crypto_batch_submit(&cbatch);
 
 	if (ahead != NULL) {
 		/* Better be called from ip_accept_tcp */
@@ -803,7 +813,7 @@ after_ilb:
 			ire = ire_multicast(ill);
 		} else {
 			/* Just match the destination */
-			ire = ire_route_recursive_dstonly_v4(nexthop, irr_flags,
+			ire = ip_dcache_forward_v4(nexthop, irr_flags,
 			    ira->ira_xmit_hint, ipst);
 		}
 		ASSERT(ire != NULL);
@@ -2616,6 +2626,14 @@ ip_fanout_v4(mblk_t *mp, ipha_t *ipha, ip_recv_attr_t *ira)
 			return;
 		}
 
+		/*
+		 * Pass up a squeue hint to sctp, as for tcp above. Eagers
+		 * created from an INIT take this squeue so the association
+		 * is processed on the CPU servicing the ring it arrives on.
+		 */
+		if (ira->ira_sqp == NULL)
+			ira->ira_sqp = ip_squeue_get(ira->ira_ring);
+
 		/* Found a client; up it goes */
 		BUMP_MIB(ill->ill_ip_mib, ipIfStatsHCInDelivers);
 		sctp_input(connp, ipha, NULL, mp, ira);
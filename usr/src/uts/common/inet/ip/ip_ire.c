@@ -2216,6 +2216,7 @@ ip_ire_reclaim_stack(ip_stack_t *ipst)
 	 * have.
 	 */
 	ipcl_walk(conn_ixa_cleanup, (void *)B_FALSE, ipst);
+	ip_dcache_flush(ipst);
 }
 
 /*
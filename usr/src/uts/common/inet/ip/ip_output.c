@@ -647,6 +647,9 @@ ip_verify_dce(mblk_t *mp, ip_xmit_attr_t *ixa)
 /*
  * Verify LSO usability. Keep the return value simple to indicate whether
  * the LSO capability has changed. Handle both IPv4 and IPv6.
+ *
+ * When the ill can't do LSO we fall back to segmenting in IP (IXAF_GSO),
+ * and go back to the ill as soon as it can do it again.
  */
 static boolean_t
 ip_verify_lso(ill_t *ill, ip_xmit_attr_t *ixa)
@@ -654,46 +657,68 @@ ip_verify_lso(ill_t *ill, ip_xmit_attr_t *ixa)
 	ill_lso_capab_t	*lsoc = &ixa->ixa_lso_capab;
 	ill_lso_capab_t	*new_lsoc = ill->ill_lso_capab;
 
-	if (ixa->ixa_flags & IXAF_LSO_CAPAB) {
-		/*
-		 * Not unsable any more.
-		 */
-		if ((ixa->ixa_flags & IXAF_IPSEC_SECURE) ||
-		    (ixa->ixa_ire->ire_type & (IRE_LOCAL | IRE_LOOPBACK)) ||
-		    (ixa->ixa_ire->ire_flags & RTF_MULTIRT) ||
-		    ((ixa->ixa_flags & IXAF_IS_IPV4) ?
-		    !ILL_LSO_TCP_IPV4_USABLE(ill) :
-		    !ILL_LSO_TCP_IPV6_USABLE(ill))) {
-			ixa->ixa_flags &= ~IXAF_LSO_CAPAB;
-
-			return (B_FALSE);
-		}
-
+	if (!(ixa->ixa_flags & IXAF_IPSEC_SECURE) &&
+	    !(ixa->ixa_ire->ire_type & (IRE_LOCAL | IRE_LOOPBACK)) &&
+	    !(ixa->ixa_ire->ire_flags & RTF_MULTIRT) &&
+	    ((ixa->ixa_flags & IXAF_IS_IPV4) ?
+	    ILL_LSO_TCP_IPV4_USABLE(ill) :
+	    ILL_LSO_TCP_IPV6_USABLE(ill))) {
 		/*
-		 * Capability has changed, refresh the copy in ixa.
+		 * Newly usable, or the capability has changed; refresh the
+		 * copy in ixa.
 		 */
-		if (lsoc->ill_lso_max != new_lsoc->ill_lso_max) {
+		if (!(ixa->ixa_flags & IXAF_LSO_CAPAB) ||
+		    (ixa->ixa_flags & IXAF_GSO) ||
+		    lsoc->ill_lso_max != new_lsoc->ill_lso_max) {
 			*lsoc = *new_lsoc;
+			ixa->ixa_flags &= ~IXAF_GSO;
+			ixa->ixa_flags |= IXAF_LSO_CAPAB;
 
 			return (B_FALSE);
 		}
-	} else { /* Was not usable */
-		if (!(ixa->ixa_flags & IXAF_IPSEC_SECURE) &&
-		    !(ixa->ixa_ire->ire_type & (IRE_LOCAL | IRE_LOOPBACK)) &&
-		    !(ixa->ixa_ire->ire_flags & RTF_MULTIRT) &&
-		    ((ixa->ixa_flags & IXAF_IS_IPV4) ?
-		    ILL_LSO_TCP_IPV4_USABLE(ill) :
-		    ILL_LSO_TCP_IPV6_USABLE(ill))) {
-			*lsoc = *new_lsoc;
-			ixa->ixa_flags |= IXAF_LSO_CAPAB;
+	} else if (ip_gso_usable(ixa)) {
+		if (!(ixa->ixa_flags & IXAF_GSO)) {
+			ip_gso_enable(ixa);
 
 			return (B_FALSE);
 		}
+	} else if (ixa->ixa_flags & IXAF_LSO_CAPAB) {
+		/*
+		 * Not unsable any more.
+		 */
+		ixa->ixa_flags &= ~(IXAF_LSO_CAPAB | IXAF_GSO);
+
+		return (B_FALSE);
 	}
 
 	return (B_TRUE);
 }
 
+/*
+ * Can IP segment large TCP sends itself for this destination?  This is
+ * only done for IPv4, and under the same restrictions as LSO.
+ */
+boolean_t
+ip_gso_usable(const ip_xmit_attr_t *ixa)
+{
+	return (ixa->ixa_ipst->ips_ip_gso_outbound &&
+	    (ixa->ixa_flags & IXAF_IS_IPV4) &&
+	    !(ixa->ixa_flags & IXAF_IPSEC_SECURE) &&
+	    !(ixa->ixa_ire->ire_type & (IRE_LOCAL | IRE_LOOPBACK)) &&
+	    !(ixa->ixa_ire->ire_flags & RTF_MULTIRT));
+}
+
+/*
+ * Give the ULP an LSO capability that IP implements; see ip_output_gso_v4().
+ */
+void
+ip_gso_enable(ip_xmit_attr_t *ixa)
+{
+	ixa->ixa_lso_capab.ill_lso_flags = LSO_BASIC_TCP_IPV4;
+	ixa->ixa_lso_capab.ill_lso_max = IP_MAXPACKET;
+	ixa->ixa_flags |= IXAF_LSO_CAPAB | IXAF_GSO;
+}
+
 /*
  * Verify ZEROCOPY usability. Keep the return value simple to indicate whether
  * the ZEROCOPY capability has changed. Handle both IPv4 and IPv6.
@@ -924,7 +949,7 @@ repeat_ire:
 	/*
 	 * Check for a dce_t with a path mtu.
 	 */
-	dce = dce_lookup_v4(dst, ipst, NULL);
+	dce = ip_dcache_dce_v4(dst, ipst, NULL);
 	ASSERT(dce != NULL);
 
 	if (!(ixaflags & IXAF_PMTU_DISCOVERY)) {
@@ -1814,6 +1839,161 @@ ip_output_cksum_v4(iaflags_t ixaflags, mblk_t *mp, ipha_t *ipha,
 	return (ip_output_sw_cksum_v4(mp, ipha, ixa));
 }
 
+/*
+ * Return len bytes of a message, starting off bytes into *mpp, as a chain
+ * of dupb()s, and advance *mpp and *offp past them.  Returns NULL if dupb
+ * fails.
+ */
+static mblk_t *
+ip_gso_carve(mblk_t **mpp, uint_t *offp, uint_t len)
+{
+	mblk_t	*mp = *mpp;
+	mblk_t	*head = NULL;
+	mblk_t	**tailp = &head;
+	mblk_t	*mp1;
+	uint_t	off = *offp;
+	uint_t	n;
+
+	while (len > 0) {
+		ASSERT(mp != NULL);
+		if ((n = MBLKL(mp) - off) == 0) {
+			mp = mp->b_cont;
+			off = 0;
+			continue;
+		}
+		if ((mp1 = dupb(mp)) == NULL) {
+			freemsg(head);
+			return (NULL);
+		}
+		n = MIN(n, len);
+		mp1->b_rptr += off;
+		mp1->b_wptr = mp1->b_rptr + n;
+		*tailp = mp1;
+		tailp = &mp1->b_cont;
+		off += n;
+		len -= n;
+	}
+	*mpp = mp;
+	*offp = off;
+	return (head);
+}
+
+/*
+ * Generic segmentation offload: TCP has built a send of up to 64K for an
+ * ill that can't do LSO, so cut it into MSS-sized segments here, as late
+ * as we can, and hand each to ixa_postfragfn.  The payload isn't copied;
+ * each segment is a copy of the headers followed by dupb()s of the data.
+ * A segment's checksum is done by the hardware where it can, otherwise in
+ * software, which makes a single pass over the data.
+ *
+ * ire_send_wire_v4() reserved ixa_extra_ident + 1 consecutive idents and
+ * put the last in the header; the segments use them in order.
+ */
+static int
+ip_output_gso_v4(mblk_t *mp, ipha_t *ipha, ip_xmit_attr_t *ixa, ill_t *ill)
+{
+	ip_stack_t	*ipst = ixa->ixa_ipst;
+	iaflags_t	ixaflags = ixa->ixa_flags;
+	uint_t		pktlen = ixa->ixa_pktlen;
+	uint16_t	ip_hdr_length = ixa->ixa_ip_hdr_length;
+	uint32_t	mss = DB_LSOMSS(mp);
+	tcpha_t		*tcpha;
+	uint_t		hdr_len, tcp_len, paylen, seglen, off;
+	uint32_t	seq;
+	uint16_t	ident;
+	uint8_t		flags;
+	mblk_t		*data_mp, *seg_mp;
+	uint_t		data_off, nsegs = 0;
+	int		error = 0;
+
+	ASSERT(ixa->ixa_protocol == IPPROTO_TCP);
+	ASSERT(IS_SIMPLE_IPH(ipha) && mss != 0);
+
+	tcpha = (tcpha_t *)(mp->b_rptr + ip_hdr_length);
+	tcp_len = TCP_HDR_LENGTH(tcpha);
+	hdr_len = ip_hdr_length + tcp_len;
+	ASSERT(MBLKL(mp) >= hdr_len);
+	paylen = pktlen - hdr_len;
+
+	seq = ntohl(tcpha->tha_seq);
+	ident = ntohs(ipha->ipha_ident) - ixa->ixa_extra_ident;
+	flags = tcpha->tha_flags;
+
+	data_mp = mp;
+	data_off = hdr_len;
+	for (off = 0; off < paylen; off += seglen) {
+		ipha_t	*sipha;
+		tcpha_t	*stcpha;
+
+		seglen = MIN(mss, paylen - off);
+
+		seg_mp = allocb_tmpl(ipst->ips_ip_wroff_extra + hdr_len, mp);
+		if (seg_mp == NULL) {
+			error = ENOBUFS;
+			break;
+		}
+		seg_mp->b_rptr += ipst->ips_ip_wroff_extra;
+		seg_mp->b_wptr = seg_mp->b_rptr + hdr_len;
+		seg_mp->b_band = mp->b_band;
+		bcopy(mp->b_rptr, seg_mp->b_rptr, hdr_len);
+
+		seg_mp->b_cont = ip_gso_carve(&data_mp, &data_off, seglen);
+		if (seg_mp->b_cont == NULL) {
+			freeb(seg_mp);
+			error = ENOBUFS;
+			break;
+		}
+
+		sipha = (ipha_t *)seg_mp->b_rptr;
+		sipha->ipha_length = htons(hdr_len + seglen);
+		sipha->ipha_ident = htons(ident);
+		ident++;
+
+		/*
+		 * Only the first segment carries CWR, and only the last PUSH
+		 * and FIN.  As for any other send, the checksum routines
+		 * expect the TCP length in the checksum field.
+		 */
+		stcpha = (tcpha_t *)(seg_mp->b_rptr + ip_hdr_length);
+		stcpha->tha_seq = htonl(seq + off);
+		stcpha->tha_flags = flags;
+		if (off != 0)
+			stcpha->tha_flags &= ~TH_CWR;
+		if (off + seglen != paylen)
+			stcpha->tha_flags &= ~(TH_PUSH | TH_FIN);
+		stcpha->tha_sum = htons(tcp_len + seglen);
+
+		ixa->ixa_pktlen = hdr_len + seglen;
+		if (!ip_output_cksum_v4(ixaflags, seg_mp, sipha, ixa, ill)) {
+			BUMP_MIB(ill->ill_ip_mib, ipIfStatsOutDiscards);
+			ip_drop_output("ipIfStatsOutDiscards", seg_mp, ill);
+			freemsg(seg_mp);
+			error = EINVAL;
+			break;
+		}
+		nsegs++;
+		error = (ixa->ixa_postfragfn)(seg_mp, ixa->ixa_nce, ixaflags,
+		    hdr_len + seglen, ixa->ixa_xmit_hint, ixa->ixa_zoneid,
+		    ixa->ixa_no_loop_zoneid, &ixa->ixa_cookie);
+		if (error != 0 && error != EWOULDBLOCK)
+			break;
+
+		/* No need to redo state machine for the other segments */
+		ixaflags &= ~IXAF_REACH_CONF;
+	}
+	ixa->ixa_pktlen = pktlen;
+
+	IP_STAT(ipst, ip_out_gso);
+	IP_STAT_UPDATE(ipst, ip_out_gso_segs, nsegs);
+	if (off < paylen) {
+		/* The rest will be retransmitted */
+		IP_STAT(ipst, ip_out_gso_fail);
+		ip_drop_output("ip_output_gso_v4 failed", NULL, ill);
+	}
+	freemsg(mp);
+	return (error);
+}
+
 /*
  * ire_sendfn for offlink and onlink destinations.
  * Also called from the multicast, broadcast, multirt send functions.
@@ -2024,6 +2204,10 @@ ire_send_wire_v4(ire_t *ire, mblk_t *mp, void *iph_arg,
 		    ixa->ixa_zoneid, ixa->ixa_no_loop_zoneid,
 		    ixa->ixa_postfragfn, &ixa->ixa_cookie));
 	}
+	/* A large send for an ill that can't do LSO */
+	if ((ixaflags & IXAF_GSO) && (DB_LSOFLAGS(mp) & HW_LSO))
+		return (ip_output_gso_v4(mp, ipha, ixa, ill));
+
 	if (ixaflags & IXAF_SET_ULP_CKSUM) {
 		/* Compute ULP checksum and IP header checksum */
 		/* An IS_UNDER_IPMP ill is ok here */
@@ -42,6 +42,7 @@
 #include <inet/ipsecesp.h>
 #include <inet/ipsecah.h>
 #include <sys/kstat.h>
+#include <sys/pcpu_counter.h>
 
 /*
  * Returns B_TRUE if the identities in the SA match the identities
@@ -78,6 +78,13 @@
  * not bound to a CPU, and we're currently servicing the interrupt which
  * generated the packet, then bind the squeue to CPU.
  *
+ * squeue_t *ip_squeue_steer(ip_recv_attr_t *, processorid_t, faddr, laddr,
+ *     ports)
+ *
+ * Asks mac to deliver an IPv4 TCP flow arriving on the packet's ring to the
+ * soft ring bound to the given CPU, and returns the squeue of that ring, so
+ * that a connection can follow the thread that reads from it.
+ *
  *
  * DR Notes
  * ========
@@ -517,6 +524,7 @@ ip_squeue_add_ring(ill_t *ill, void *mrp)
 	rx_ring->rr_intr_disable =
 	    (ip_mac_intr_disable_t)mrfp->mrf_intr_disable;
 	rx_ring->rr_rx_handle = mrfp->mrf_rx_arg;
+	rx_ring->rr_steer = (ip_mac_steer_t)mrfp->mrf_steer;
 	rx_ring->rr_ill = ill;
 
 	pri = mrfp->mrf_flow_priority;
@@ -691,6 +699,64 @@ ip_squeue_get(ill_rx_ring_t *ill_rx_ring)
 	return (sqp);
 }
 
+/*
+ * Receive flow steering.  A packet of the IPv4 TCP flow faddr/laddr/ports
+ * (ports as they appear in the TCP header, source port first) came in on
+ * ira->ira_ring, and the thread consuming the flow runs on cpuid.  Ask mac
+ * to deliver the flow to the soft ring bound to that CPU instead, if the
+ * ring's SRS has one, and return the squeue of the new ring, bound to the
+ * same CPU.  Returns NULL if the flow cannot be steered there.
+ *
+ * The ira may have been through ip_recv_attr_to_mblk(), so the ring is only
+ * trusted once it has been found in the ill's table, under ill_lock; that
+ * also keeps mac from tearing the soft rings down while mac is asked.
+ */
+squeue_t *
+ip_squeue_steer(ip_recv_attr_t *ira, processorid_t cpuid, ipaddr_t faddr,
+    ipaddr_t laddr, uint32_t ports)
+{
+	ill_t		*ill = ira->ira_rill;
+	ill_rx_ring_t	*rx_ring = ira->ira_ring;
+	ill_rx_ring_t	*ring_tbl;
+	squeue_t	*sqp = NULL;
+	void		*handle;
+	int		idx;
+
+	if (ill == NULL || rx_ring == NULL || ill->ill_dld_capab == NULL)
+		return (NULL);
+
+	ring_tbl = ill->ill_dld_capab->idc_poll.idp_ring_tbl;
+	if (rx_ring < &ring_tbl[0] || rx_ring >= &ring_tbl[ILL_MAX_RINGS])
+		return (NULL);
+
+	mutex_enter(&ill->ill_lock);
+	if (rx_ring->rr_ring_state != RR_SQUEUE_BOUND ||
+	    rx_ring->rr_steer == NULL) {
+		mutex_exit(&ill->ill_lock);
+		return (NULL);
+	}
+
+	handle = rx_ring->rr_steer(rx_ring->rr_rx_handle, cpuid, faddr, laddr,
+	    ports);
+	if (handle == NULL) {
+		mutex_exit(&ill->ill_lock);
+		return (NULL);
+	}
+
+	for (idx = 0; idx < ILL_MAX_RINGS; idx++) {
+		rx_ring = &ring_tbl[idx];
+		if (rx_ring->rr_rx_handle == handle &&
+		    rx_ring->rr_ring_state == RR_SQUEUE_BOUND) {
+			if (rx_ring->rr_sqp->sq_bind == cpuid)
+				sqp = rx_ring->rr_sqp;
+			break;
+		}
+	}
+	mutex_exit(&ill->ill_lock);
+
+	return (sqp);
+}
+
 /*
  * Called when a CPU goes offline. It's squeue_set_t is destroyed, and all
  * squeues are unboudn and moved to the unbound set.
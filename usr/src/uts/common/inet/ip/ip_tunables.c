@@ -915,6 +915,10 @@ mod_prop_info_t ip_propinfo_tbl[] = {
 	    mod_set_uint32, mod_get_uint32,
 	    {1, 100000, 32}, {32} },
 
+	{ "_gso_outbound", MOD_PROTO_IP,
+	    mod_set_boolean, mod_get_boolean,
+	    {B_TRUE}, {B_TRUE} },
+
 	{ "mtu", MOD_PROTO_IPV4, NULL, ip_get_mtu, {0}, {0} },
 
 	{ "mtu", MOD_PROTO_IPV6, NULL, ip_get_mtu, {0}, {0} },
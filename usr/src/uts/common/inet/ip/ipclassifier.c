@@ -1514,6 +1514,46 @@ ipcl_conn_insert_v6(conn_t *connp)
 	return (ret);
 }
 
+/*
+ * Listeners that share an address and port through SO_REUSEPORT (see
+ * tcp_bindi()) form a group, and each connection request goes to one of
+ * them, picked by a hash of the remote address and the ports, so that
+ * each listener, with its own accept queue and squeue, sees its share.
+ * connp is the first listener in the bind hash bucket that matched the
+ * packet; the rest of its group can only follow it in the bucket.
+ */
+#define	IPCL_REUSEPORT_GROUP(connp, first)				\
+	((connp)->conn_reuseport &&					\
+	(connp)->conn_proto == (first)->conn_proto &&			\
+	(connp)->conn_lport == (first)->conn_lport &&			\
+	(connp)->conn_zoneid == (first)->conn_zoneid &&			\
+	(connp)->conn_ipversion == (first)->conn_ipversion &&		\
+	(connp)->conn_ipv6_v6only == (first)->conn_ipv6_v6only &&	\
+	IN6_ARE_ADDR_EQUAL(&(connp)->conn_laddr_v6,			\
+	&(first)->conn_laddr_v6))
+
+static conn_t *
+ipcl_reuseport_select(conn_t *connp, uint32_t src, uint32_t ports)
+{
+	conn_t	*tconnp;
+	uint_t	n = 0;
+
+	ASSERT(connp->conn_reuseport);
+
+	for (tconnp = connp; tconnp != NULL; tconnp = tconnp->conn_next) {
+		if (IPCL_REUSEPORT_GROUP(tconnp, connp))
+			n++;
+	}
+	if (n == 1)
+		return (connp);
+
+	n = (ntohl(src) ^ (ports >> 16) ^ ports) % n;
+	for (tconnp = connp; ; tconnp = tconnp->conn_next) {
+		if (IPCL_REUSEPORT_GROUP(tconnp, connp) && n-- == 0)
+			return (tconnp);
+	}
+}
+
 /*
  * v4 packet classifying function. looks up the fanout table to
  * find the conn, the packet belongs to. returns the conn with
@@ -1589,6 +1629,10 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 				break;
 		}
 
+		if (connp != NULL && connp->conn_reuseport)
+			connp = ipcl_reuseport_select(connp, ipha->ipha_src,
+			    ports);
+
 		/*
 		 * If the matching connection is SLP on a private address, then
 		 * the label on the packet must match the local zone's label.
@@ -1733,6 +1777,10 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 				break;
 		}
 
+		if (connp != NULL && connp->conn_reuseport)
+			connp = ipcl_reuseport_select(connp,
+			    V4_PART_OF_V6(ip6h->ip6_src), ports);
+
 		if (connp != NULL && (ira->ira_flags & IRAF_SYSTEM_LABELED) &&
 		    !tsol_receive_local(mp, &ip6h->ip6_dst, IPV6_VERSION,
 		    ira, connp)) {
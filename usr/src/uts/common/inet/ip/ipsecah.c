@@ -69,6 +69,7 @@
 #include <sys/crypto/common.h>
 #include <sys/crypto/api.h>
 #include <sys/kstat.h>
+#include <sys/pcpu_counter.h>
 #include <sys/strsubr.h>
 
 #include <sys/tsol/tnet.h>
@@ -194,6 +195,8 @@ ah_kstat_init(ipsecah_stack_t *ahstack, netstackid_t stackid)
 		return (B_FALSE);
 
 	ahstack->ah_kstats = ahstack->ah_ksp->ks_data;
+	ahstack->ah_counters = pcpu_counter_create(
+	    sizeof (ah_kstats_t) / sizeof (kstat_named_t), KM_SLEEP);
 
 	ahstack->ah_ksp->ks_update = ah_kstat_update;
 	ahstack->ah_ksp->ks_private = (void *)(uintptr_t)stackid;
@@ -230,6 +233,7 @@ ah_kstat_update(kstat_t *kp, int rw)
 	netstackid_t	stackid = (netstackid_t)(uintptr_t)kp->ks_private;
 	netstack_t	*ns;
 	ipsec_stack_t	*ipss;
+	ipsecah_stack_t	*ahstack;
 
 	if ((kp == NULL) || (kp->ks_data == NULL))
 		return (EIO);
@@ -241,12 +245,15 @@ ah_kstat_update(kstat_t *kp, int rw)
 	if (ns == NULL)
 		return (-1);
 	ipss = ns->netstack_ipsec;
-	if (ipss == NULL) {
+	ahstack = ns->netstack_ipsecah;
+	if (ipss == NULL || ahstack == NULL) {
 		netstack_rele(ns);
 		return (-1);
 	}
 	ekp = (ah_kstats_t *)kp->ks_data;
 
+	pcpu_counter_kstat_update(ahstack->ah_counters, kp->ks_data);
+
 	mutex_enter(&ipss->ipsec_alg_lock);
 	ekp->ah_stat_num_aalgs.value.ui64 = ipss->ipsec_nalgs[IPSEC_ALG_AUTH];
 	mutex_exit(&ipss->ipsec_alg_lock);
@@ -462,6 +469,8 @@ ipsecah_stack_fini(netstackid_t stackid, void *arg)
 	kstat_delete_netstack(ahstack->ah_ksp, stackid);
 	ahstack->ah_ksp = NULL;
 	ahstack->ah_kstats = NULL;
+	pcpu_counter_destroy(ahstack->ah_counters);
+	ahstack->ah_counters = NULL;
 
 	kmem_free(ahstack, sizeof (*ahstack));
 }
@@ -2836,10 +2845,12 @@ ah_crypto_failed(mblk_t *data_mp, boolean_t is_inbound, int kef_rc,
 
 /*
  * A statement-equivalent macro, _cr MUST point to a modifiable
- * crypto_call_req_t.
+ * crypto_call_req_t.  As for ESP, KCF may complete the request
+ * synchronously (CRYPTO_INLINE_OK).
  */
-#define	AH_INIT_CALLREQ(_cr, _mp, _callback)		\
-	(_cr)->cr_flag = CRYPTO_SKIP_REQID|CRYPTO_ALWAYS_QUEUE;	\
+#define	AH_INIT_CALLREQ(_cr, _mp, _callback)				\
+	(_cr)->cr_flag = CRYPTO_SKIP_REQID|CRYPTO_ALWAYS_QUEUE|		\
+	    CRYPTO_INLINE_OK;						\
 	(_cr)->cr_callback_arg = (_mp);				\
 	(_cr)->cr_callback_func = (_callback)
 
@@ -62,6 +62,7 @@
 #include <inet/ipdrop.h>
 #include <inet/tcp.h>
 #include <sys/kstat.h>
+#include <sys/pcpu_counter.h>
 #include <sys/policy.h>
 #include <sys/strsun.h>
 #include <sys/strsubr.h>
@@ -207,23 +208,26 @@ typedef struct esp_kstats_s {
 } esp_kstats_t;
 
 /*
- * espstack->esp_kstats is equal to espstack->esp_ksp->ks_data if
- * kstat_create_netstack for espstack->esp_ksp succeeds, but when it
- * fails, it will be NULL. Note this is done for all stack instances,
- * so it *could* fail. hence a non-NULL checking is done for
+ * The counters are kept per-CPU in espstack->esp_counters, one for each
+ * entry of esp_kstats_t, and summed into espstack->esp_ksp->ks_data by
+ * esp_kstat_update().  Both are set up by esp_kstat_init(), which *could*
+ * fail for any stack instance; hence a non-NULL checking is done for
  * ESP_BUMP_STAT and ESP_DEBUMP_STAT
  */
+#define	ESP_STAT_INDEX(x)						\
+	PCPU_COUNTER_KSTAT_INDEX(esp_kstats_t, esp_stat_ ## x)
+
 #define	ESP_BUMP_STAT(espstack, x)					\
 do {									\
-	if (espstack->esp_kstats != NULL)				\
-		(espstack->esp_kstats->esp_stat_ ## x).value.ui64++;	\
+	if (espstack->esp_counters != NULL)				\
+		PCPU_COUNTER_INC(espstack->esp_counters, ESP_STAT_INDEX(x)); \
 _NOTE(CONSTCOND)							\
 } while (0)
 
 #define	ESP_DEBUMP_STAT(espstack, x)					\
 do {									\
-	if (espstack->esp_kstats != NULL)				\
-		(espstack->esp_kstats->esp_stat_ ## x).value.ui64--;	\
+	if (espstack->esp_counters != NULL)				\
+		PCPU_COUNTER_DEC(espstack->esp_counters, ESP_STAT_INDEX(x)); \
 _NOTE(CONSTCOND)							\
 } while (0)
 
@@ -241,6 +245,8 @@ esp_kstat_init(ipsecesp_stack_t *espstack, netstackid_t stackid)
 		return (B_FALSE);
 
 	espstack->esp_kstats = espstack->esp_ksp->ks_data;
+	espstack->esp_counters = pcpu_counter_create(
+	    sizeof (esp_kstats_t) / sizeof (kstat_named_t), KM_SLEEP);
 
 	espstack->esp_ksp->ks_update = esp_kstat_update;
 	espstack->esp_ksp->ks_private = (void *)(uintptr_t)stackid;
@@ -281,6 +287,7 @@ esp_kstat_update(kstat_t *kp, int rw)
 	netstackid_t	stackid = (zoneid_t)(uintptr_t)kp->ks_private;
 	netstack_t	*ns;
 	ipsec_stack_t	*ipss;
+	ipsecesp_stack_t *espstack;
 
 	if ((kp == NULL) || (kp->ks_data == NULL))
 		return (EIO);
@@ -292,12 +299,15 @@ esp_kstat_update(kstat_t *kp, int rw)
 	if (ns == NULL)
 		return (-1);
 	ipss = ns->netstack_ipsec;
-	if (ipss == NULL) {
+	espstack = ns->netstack_ipsecesp;
+	if (ipss == NULL || espstack == NULL) {
 		netstack_rele(ns);
 		return (-1);
 	}
 	ekp = (esp_kstats_t *)kp->ks_data;
 
+	pcpu_counter_kstat_update(espstack->esp_counters, kp->ks_data);
+
 	mutex_enter(&ipss->ipsec_alg_lock);
 	ekp->esp_stat_num_aalgs.value.ui64 =
 	    ipss->ipsec_nalgs[IPSEC_ALG_AUTH];
@@ -570,6 +580,8 @@ ipsecesp_stack_fini(netstackid_t stackid, void *arg)
 	kstat_delete_netstack(espstack->esp_ksp, stackid);
 	espstack->esp_ksp = NULL;
 	espstack->esp_kstats = NULL;
+	pcpu_counter_destroy(espstack->esp_counters);
+	espstack->esp_counters = NULL;
 	kmem_free(espstack, sizeof (*espstack));
 }
 
@@ -2024,10 +2036,13 @@ esp_crypto_failed(mblk_t *data_mp, boolean_t is_inbound, int kef_rc,
 
 /*
  * A statement-equivalent macro, _cr MUST point to a modifiable
- * crypto_call_req_t.
+ * crypto_call_req_t.  KCF may still complete the request synchronously
+ * (CRYPTO_INLINE_OK) when a software provider is otherwise idle; the
+ * callers handle CRYPTO_SUCCESS from the framework either way.
  */
 #define	ESP_INIT_CALLREQ(_cr, _mp, _callback)				\
-	(_cr)->cr_flag = CRYPTO_SKIP_REQID|CRYPTO_ALWAYS_QUEUE;	\
+	(_cr)->cr_flag = CRYPTO_SKIP_REQID|CRYPTO_ALWAYS_QUEUE|		\
+	    CRYPTO_INLINE_OK;						\
 	(_cr)->cr_callback_arg = (_mp);				\
 	(_cr)->cr_callback_func = (_callback)
 
@@ -2133,6 +2148,15 @@ esp_submit_req_inbound(mblk_t *esp_mp, ip_recv_attr_t *ira,
 		linkb(mp, esp_mp);
 		callrp = &call_req;
 		ESP_INIT_CALLREQ(callrp, mp, esp_kcf_callback_inbound);
+		/*
+		 * Coming from the ip_input() chain loop, let KCF queue the
+		 * request along with the rest of the chain's when the loop
+		 * is done.
+		 */
+		if (ira->ira_flags & IRAF_CRYPTO_BATCH) {
+			callrp->cr_flag |= CRYPTO_BATCH;
+			callrp->cr_batch = ira->ira_crypto_batch;
+		}
 	} else {
 		/*
 		 * If we know we are going to do sync then ipsec_crypto_t
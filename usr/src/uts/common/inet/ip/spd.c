@@ -45,6 +45,7 @@
 #include <sys/param.h>
 #include <sys/kmem.h>
 #include <sys/ddi.h>
+#include <sys/pcpu_counter.h>
 
 #include <sys/crypto/api.h>
 
@@ -105,6 +106,7 @@ static void ipsec_prov_update_callback_stack(uint32_t, void *, netstack_t *);
 static boolean_t ipsec_compare_action(ipsec_policy_t *, ipsec_policy_t *);
 static uint32_t selector_hash(ipsec_selector_t *, ipsec_policy_root_t *);
 static boolean_t ipsec_kstat_init(ipsec_stack_t *);
+static int ipsec_kstat_update(kstat_t *, int);
 static void ipsec_kstat_destroy(ipsec_stack_t *);
 static int ipsec_free_tables(ipsec_stack_t *);
 static int tunnel_compare(const void *, const void *);
@@ -555,6 +557,10 @@ ipsec_kstat_init(ipsec_stack_t *ipss)
 		return (B_FALSE);
 
 	ipss->ipsec_kstats = ipss->ipsec_ksp->ks_data;
+	ipss->ipsec_counters = pcpu_counter_create(IPSEC_NCOUNTERS, KM_SLEEP);
+
+	ipss->ipsec_ksp->ks_update = ipsec_kstat_update;
+	ipss->ipsec_ksp->ks_private = ipss;
 
 #define	KI(x) kstat_named_init(&ipss->ipsec_kstats->x, #x, KSTAT_DATA_UINT64)
 	KI(esp_stat_in_requests);
@@ -571,13 +577,26 @@ ipsec_kstat_init(ipsec_stack_t *ipss)
 	return (B_TRUE);
 }
 
+static int
+ipsec_kstat_update(kstat_t *kp, int rw)
+{
+	ipsec_stack_t *ipss = kp->ks_private;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	pcpu_counter_kstat_update(ipss->ipsec_counters, kp->ks_data);
+	return (0);
+}
+
 static void
 ipsec_kstat_destroy(ipsec_stack_t *ipss)
 {
 	kstat_delete_netstack(ipss->ipsec_ksp,
 	    ipss->ipsec_netstack->netstack_stackid);
 	ipss->ipsec_kstats = NULL;
-
+	pcpu_counter_destroy(ipss->ipsec_counters);
+	ipss->ipsec_counters = NULL;
 }
 
 /*
@@ -264,9 +264,21 @@ extern ire_t	*ire_route_recursive_v6(const in6_addr_t *, uint_t,
     const ill_t *, zoneid_t, const ts_label_t *, uint_t, uint_t, uint32_t,
     ip_stack_t *, in6_addr_t *, tsol_ire_gw_secattr_t **, uint_t *);
 extern ire_t	*ire_route_recursive_dstonly_v4(ipaddr_t, uint_t,
-    uint32_t, ip_stack_t *);
+    uint32_t, ip_stack_t *, uint_t *);
 extern ire_t	*ire_route_recursive_dstonly_v6(const in6_addr_t *, uint_t,
-    uint32_t, ip_stack_t *);
+    uint32_t, ip_stack_t *, uint_t *);
+
+extern ire_t	*ip_dcache_forward_v4(ipaddr_t, uint_t, uint32_t, ip_stack_t *);
+extern ire_t	*ip_dcache_forward_v6(const in6_addr_t *, uint_t, uint32_t,
+    ip_stack_t *);
+extern ire_t	*ip_dcache_route(const in6_addr_t *, boolean_t, zoneid_t,
+    uint32_t, ip_stack_t *, in6_addr_t *, uint_t *);
+extern dce_t	*ip_dcache_dce_v4(ipaddr_t, ip_stack_t *, uint_t *);
+extern dce_t	*ip_dcache_dce_v6(const in6_addr_t *, uint_t, ip_stack_t *,
+    uint_t *);
+extern void	ip_dcache_flush(ip_stack_t *);
+extern void	ip_dcache_init(ip_stack_t *);
+extern void	ip_dcache_fini(ip_stack_t *);
 extern ire_t	*ire_route_recursive_impl_v4(ire_t *ire, ipaddr_t, uint_t,
     const ill_t *, zoneid_t, const ts_label_t *, uint_t, uint_t, uint32_t,
     ip_stack_t *, ipaddr_t *, tsol_ire_gw_secattr_t **, uint_t *);
@@ -86,6 +86,10 @@ typedef struct ip_stat {
 	kstat_named_t	conn_in_recvpktinfo;
 	kstat_named_t	conn_in_recvtclass;
 	kstat_named_t	conn_in_timestamp;
+	kstat_named_t	ip_out_gso;
+	kstat_named_t	ip_out_gso_segs;
+	kstat_named_t	ip_out_gso_fail;
+	kstat_named_t	ip_dcache_miss;
 } ip_stat_t;
 
 
@@ -270,6 +274,10 @@ struct ip_stack {
 	struct dcb_s	*ips_dce_hash_v6;
 	uint_t		ips_dce_reclaim_needed;
 
+	/* Per-CPU ire and dce lookup cache, see ip_dcache.c */
+	struct ip_dcache_s **ips_dcache;
+	uint_t		ips_dcache_size;
+
 	/* pending binds */
 	mblk_t		*ips_ip6_asp_pending_ops;
 	mblk_t		*ips_ip6_asp_pending_ops_tail;
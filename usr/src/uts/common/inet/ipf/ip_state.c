@@ -62,6 +62,7 @@ struct file;
 # include <sys/byteorder.h>
 # ifdef _KERNEL
 #  include <sys/dditypes.h>
+#  include <sys/cpuvar.h>
 # endif
 # include <sys/stream.h>
 # include <sys/kmem.h>
@@ -142,6 +143,15 @@ int fr_stgetent __P((caddr_t, ipf_stack_t *));
 #define	DOUBLE_HASH(x, ifs)	\
     (((x) + ifs->ifs_ips_seed[(x) % ifs->ifs_fr_statesize]) % ifs->ifs_fr_statesize)
 
+#if defined(_KERNEL) && (defined(__SVR4) || defined(__svr4__))
+# define	IPS_NCPU	max_ncpus
+# define	IPS_CPU		CPU->cpu_seqid
+#else
+# define	IPS_NCPU	1
+# define	IPS_CPU		0
+#endif
+#define	IPS_PCPU_BUMP(ifs, x)	((ifs)->ifs_ips_pcpu[IPS_CPU].x++)
+
 
 /* ------------------------------------------------------------------------ */
 /* Function:    fr_stateinit                                                */
@@ -215,6 +225,14 @@ ipf_stack_t *ifs;
 	bzero((char *)ifs->ifs_ips_stats.iss_bucketlen, 
 	      ifs->ifs_fr_statesize * sizeof(u_long));
 
+	ifs->ifs_ips_ncpu = IPS_NCPU;
+	KMALLOCS(ifs->ifs_ips_pcpu, ips_pcpu_t *,
+		 ifs->ifs_ips_ncpu * sizeof(ips_pcpu_t));
+	if (ifs->ifs_ips_pcpu == NULL)
+		return -1;
+	bzero((char *)ifs->ifs_ips_pcpu,
+	      ifs->ifs_ips_ncpu * sizeof(ips_pcpu_t));
+
 	if (ifs->ifs_fr_state_maxbucket == 0) {
 		for (i = ifs->ifs_fr_statesize; i > 0; i >>= 1)
 			ifs->ifs_fr_state_maxbucket++;
@@ -332,6 +350,12 @@ ipf_stack_t *ifs;
 		ifs->ifs_ips_stats.iss_bucketlen = NULL;
 	}
 
+	if (ifs->ifs_ips_pcpu != NULL) {
+		KFREES(ifs->ifs_ips_pcpu,
+		       ifs->ifs_ips_ncpu * sizeof(ips_pcpu_t));
+		ifs->ifs_ips_pcpu = NULL;
+	}
+
 	if (ifs->ifs_fr_state_maxbucket_reset == 1)
 		ifs->ifs_fr_state_maxbucket = 0;
 
@@ -354,6 +378,15 @@ ipf_stack_t *ifs;
 static ips_stat_t *fr_statetstats(ifs)
 ipf_stack_t *ifs;
 {
+	u_long hits = 0, miss = 0;
+	int i;
+
+	for (i = 0; i < ifs->ifs_ips_ncpu; i++) {
+		hits += ifs->ifs_ips_pcpu[i].ipp_hits;
+		miss += ifs->ifs_ips_pcpu[i].ipp_miss;
+	}
+	ifs->ifs_ips_stats.iss_hits = hits;
+	ifs->ifs_ips_stats.iss_miss = miss;
 	ifs->ifs_ips_stats.iss_active = ifs->ifs_ips_num;
 	ifs->ifs_ips_stats.iss_statesize = ifs->ifs_fr_statesize;
 	ifs->ifs_ips_stats.iss_statemax = ifs->ifs_fr_statemax;
@@ -2530,7 +2563,7 @@ fr_info_t *fin;
 				oi = (backward << 1) + ofin.fin_out;
 				if (is->is_icmppkts[i] > is->is_pkts[oi])
 					continue;
-				ifs->ifs_ips_stats.iss_hits++;
+				IPS_PCPU_BUMP(ifs, ipp_hits);
 				is->is_icmppkts[i]++;
 				return is;
 			}
@@ -2587,7 +2620,7 @@ fr_info_t *fin;
 			if (((is->is_pass & FR_NOICMPERR) != 0) ||
 			    (is->is_icmppkts[i] > is->is_pkts[oi]))
 				break;
-			ifs->ifs_ips_stats.iss_hits++;
+			IPS_PCPU_BUMP(ifs, ipp_hits);
 			is->is_icmppkts[i]++;
 			/*
 			 * we deliberately do not touch the timeouts
@@ -2944,6 +2977,28 @@ ipftq_t *ifq;
 	 * queue is different to the last one it was on and move it if so.
 	 */
 	tqe = &is->is_sti;
+#ifdef ATOMIC_INC64_NV
+	if ((tqe->tqe_flags & TQE_RULEBASED) != 0)
+		ifq = is->is_tqehead[fin->fin_rev];
+
+	/*
+	 * is_lock is only needed to move the entry between (or within)
+	 * timeout queues.  fr_movequeue() does nothing for an entry already
+	 * refreshed on the right queue this tick, which is the common case
+	 * for a busy flow, so check that first and leave the lock alone.
+	 * The counters don't need it either.
+	 */
+	if ((ifq != NULL) && ((tqe->tqe_ifq != ifq) ||
+	    (tqe->tqe_touched != ifs->ifs_fr_ticks))) {
+		MUTEX_ENTER(&is->is_lock);
+		fr_movequeue(tqe, tqe->tqe_ifq, ifq, ifs);
+		MUTEX_EXIT(&is->is_lock);
+	}
+
+	fin->fin_pktnum = ATOMIC_INC64_NV(is->is_pkts[i]) +
+	    is->is_icmppkts[i];
+	ATOMIC_ADD64(is->is_bytes[i], fin->fin_plen);
+#else
 	MUTEX_ENTER(&is->is_lock);
 	if ((tqe->tqe_flags & TQE_RULEBASED) != 0)
 		ifq = is->is_tqehead[fin->fin_rev];
@@ -2955,13 +3010,14 @@ ipftq_t *ifq;
 	fin->fin_pktnum = is->is_pkts[i] + is->is_icmppkts[i];
 	is->is_bytes[i] += fin->fin_plen;
 	MUTEX_EXIT(&is->is_lock);
+#endif
 
 #ifdef	IPFILTER_SYNC
 	if (is->is_flags & IS_STATESYNC)
 		ipfsync_update(SMC_STATE, fin, is->is_sync);
 #endif
 
-	ATOMIC_INCL(ifs->ifs_ips_stats.iss_hits);
+	IPS_PCPU_BUMP(ifs, ipp_hits);
 
 	fin->fin_fr = is->is_rule;
 
@@ -3058,7 +3114,7 @@ u_32_t *passp;
 		break;
 	}
 	if (is == NULL) {
-		ATOMIC_INCL(ifs->ifs_ips_stats.iss_miss);
+		IPS_PCPU_BUMP(ifs, ipp_miss);
 		return NULL;
 	}
 
@@ -4115,7 +4171,7 @@ fr_info_t *fin;
 				if (((ic->ici_type == ICMP6_ECHO_REPLY) &&
 				     (oic->icmp6_type == ICMP6_ECHO_REQUEST)) ||
 				     (ic->ici_type - 1 == oic->icmp6_type )) {
-				    	ifs->ifs_ips_stats.iss_hits++;
+				    	IPS_PCPU_BUMP(ifs, ipp_hits);
 					backward = IP6_NEQ(&is->is_dst, &src);
 					fin->fin_rev = !backward;
 					i = (backward << 1) + fin->fin_out;
@@ -4165,7 +4221,7 @@ fr_info_t *fin;
 			continue;
 		is = fr_matchsrcdst(&ofin, is, &src, &dst, tcp, FI_ICMPCMP);
 		if (is != NULL) {
-			ifs->ifs_ips_stats.iss_hits++;
+			IPS_PCPU_BUMP(ifs, ipp_hits);
 			backward = IP6_NEQ(&is->is_dst, &src);
 			fin->fin_rev = !backward;
 			i = (backward << 1) + fin->fin_out;
@@ -247,6 +247,8 @@ typedef unsigned int	u_32_t;
 #    define	ATOMIC_DECL(x)		atomic_dec_ulong(&(x))
 #   endif /* SOLARIS2 == 6 */
 #   define	ATOMIC_INC64(x)		atomic_inc_64((uint64_t *)&(x))
+#   define	ATOMIC_INC64_NV(x)	atomic_inc_64_nv((uint64_t *)&(x))
+#   define	ATOMIC_ADD64(x, y)	atomic_add_64((uint64_t *)&(x), (y))
 #   define	ATOMIC_INC32(x)		atomic_inc_32((uint32_t *)&(x))
 #   define	ATOMIC_INC16(x)		atomic_inc_16((uint16_t *)&(x))
 #   define	ATOMIC_DEC64(x)		atomic_dec_64((uint64_t *)&(x))
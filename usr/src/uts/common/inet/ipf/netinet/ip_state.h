@@ -221,6 +221,17 @@ typedef	struct	ips_stat {
 	u_int	iss_orphans;
 } ips_stat_t;
 
+/*
+ * The lookup hit/miss counters are bumped for every packet, so each CPU
+ * keeps its own on a cache line of its own.  They are summed into
+ * iss_hits/iss_miss when the statistics are read.
+ */
+typedef	struct	ips_pcpu {
+	u_long	ipp_hits;
+	u_long	ipp_miss;
+	char	ipp_pad[64 - 2 * sizeof (u_long)];
+} ips_pcpu_t;
+
 typedef struct port_pair {
 	uint16_t	pp_sport;
 	uint16_t	pp_dport;
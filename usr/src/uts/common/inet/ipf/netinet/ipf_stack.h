@@ -261,6 +261,8 @@ struct ipf_stack {
 	uint_t			ifs_state_flush_level_hi;
 	uint_t			ifs_state_flush_level_lo;
 	ips_stat_t		ifs_ips_stats;
+	ips_pcpu_t		*ifs_ips_pcpu;
+	int			ifs_ips_ncpu;
 
 	ulong_t			ifs_fr_tcpidletimeout;
 	ulong_t			ifs_fr_tcpclosewait;
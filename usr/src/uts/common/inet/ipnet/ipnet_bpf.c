@@ -50,6 +50,8 @@ static void ipnet_bpf_promisc_remove(uintptr_t);
 static void ipnet_bpf_sdu_get(uintptr_t, uint_t *);
 static int ipnet_bpf_tx(uintptr_t, mblk_t *);
 static int ipnet_bpf_type(uintptr_t);
+static int ipnet_bpf_rxhook_add(uintptr_t, void *, uintptr_t *);
+static void ipnet_bpf_rxhook_remove(uintptr_t);
 
 bpf_provider_t bpf_ipnet = {
 	BPR_IPNET,
@@ -67,6 +69,8 @@ bpf_provider_t bpf_ipnet = {
 	ipnet_bpf_client_open,
 	ipnet_bpf_getzone,
 	ipnet_bpf_getdlt,
+	ipnet_bpf_rxhook_add,
+	ipnet_bpf_rxhook_remove,
 };
 
 /*ARGSUSED*/
@@ -221,3 +225,20 @@ ipnet_bpf_getdlt(uintptr_t handle, uint_t *dlp)
 	*dlp = DL_IPNET;
 	return (0);
 }
+
+/*
+ * ipnet only observes packets that IP has already accepted, so there is
+ * nothing early enough in its path for a receive hook to run.
+ */
+/*ARGSUSED*/
+static int
+ipnet_bpf_rxhook_add(uintptr_t handle, void *arg, uintptr_t *hookp)
+{
+	return (ENOTSUP);
+}
+
+/*ARGSUSED*/
+static void
+ipnet_bpf_rxhook_remove(uintptr_t hhandle)
+{
+}
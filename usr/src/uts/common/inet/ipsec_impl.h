@@ -769,6 +769,7 @@ struct ipsec_stack {
 	/* stats */
 	kstat_t			*ipsec_ksp;
 	struct ipsec_kstats_s	*ipsec_kstats;
+	struct pcpu_counter	*ipsec_counters;
 
 /* sadb.c */
 	/* Packet dropper for generic SADB drops. */
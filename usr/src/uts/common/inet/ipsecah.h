@@ -66,22 +66,25 @@ typedef struct ah_kstats_s
 } ah_kstats_t;
 
 /*
- * ahstack->ah_kstats is equal to ahstack->ah_ksp->ks_data if
- * kstat_create_netstack for ahstack->ah_ksp succeeds, but when it
- * fails, it will be NULL. Note this is done for all stack instances,
- * so it *could* fail. hence a non-NULL checking is done for
- * AH_BUMP_STAT and AH_DEBUMP_STAT
+ * The counters are kept per-CPU in ahstack->ah_counters (see
+ * <sys/pcpu_counter.h>), one for each entry of ah_kstats_t, and summed into
+ * ahstack->ah_ksp->ks_data by the kstat's update routine.  Both are set up
+ * when the kstat is created, which *could* fail for any stack instance;
+ * hence a non-NULL checking is done for AH_BUMP_STAT and AH_DEBUMP_STAT
  */
+#define	AH_STAT_INDEX(x)						\
+	PCPU_COUNTER_KSTAT_INDEX(ah_kstats_t, ah_stat_ ## x)
+
 #define	AH_BUMP_STAT(ahstack, x)					\
 do {									\
-	if (ahstack->ah_kstats != NULL)					\
-		(ahstack->ah_kstats->ah_stat_ ## x).value.ui64++;	\
+	if (ahstack->ah_counters != NULL)				\
+		PCPU_COUNTER_INC(ahstack->ah_counters, AH_STAT_INDEX(x)); \
 _NOTE(CONSTCOND)							\
 } while (0)
 #define	AH_DEBUMP_STAT(ahstack, x)					\
 do {									\
-	if (ahstack->ah_kstats != NULL)					\
-		(ahstack->ah_kstats->ah_stat_ ## x).value.ui64--;	\
+	if (ahstack->ah_counters != NULL)				\
+		PCPU_COUNTER_DEC(ahstack->ah_counters, AH_STAT_INDEX(x)); \
 _NOTE(CONSTCOND)							\
 } while (0)
 
@@ -102,6 +105,7 @@ struct ipsecah_stack {
 
 	kstat_t			*ah_ksp;
 	ah_kstats_t		*ah_kstats;
+	struct pcpu_counter	*ah_counters;	/* Backs ah_kstats */
 
 	/*
 	 * Keysock instance of AH.  There can be only one per stack instance.
@@ -58,6 +58,7 @@ struct ipsecesp_stack {
 
 	kstat_t			*esp_ksp;
 	struct esp_kstats_s	*esp_kstats;
+	struct pcpu_counter	*esp_counters;	/* Backs esp_kstats */
 
 	/*
 	 * Keysock instance of ESP.  There can be only one per stack instance.
@@ -120,7 +120,7 @@ static dev_info_t *kssl_dip = NULL;
 crypto_mechanism_t rsa_x509_mech = {CRYPTO_MECH_INVALID, NULL, 0};
 crypto_mechanism_t hmac_md5_mech = {CRYPTO_MECH_INVALID, NULL, 0};
 crypto_mechanism_t hmac_sha1_mech = {CRYPTO_MECH_INVALID, NULL, 0};
-crypto_call_flag_t kssl_call_flag = CRYPTO_ALWAYS_QUEUE;
+crypto_call_flag_t kssl_call_flag = CRYPTO_ALWAYS_QUEUE | CRYPTO_INLINE_OK;
 
 KSSLCipherDef cipher_defs[] = { /* indexed by SSL3BulkCipher */
 	/* type bsize keysz crypto_mech_type_t */
@@ -948,18 +948,29 @@ typedef struct ipsec_kstats_s {
  * fails, it will be NULL. Note this is done for all stack instances,
  * so it *could* fail. hence a non-NULL checking is done for
  * IP_ESP_BUMP_STAT, IP_AH_BUMP_STAT and IP_ACQUIRE_STAT
+ *
+ * The ESP and AH counters, which lead the structure, are kept per-CPU in
+ * (ipss)->ipsec_counters (see <sys/pcpu_counter.h>) and summed into
+ * ks_data when the kstat is read.  The sadb_acquire entries are high-water
+ * marks, kept in ks_data itself.
  */
+#define	IPSEC_STAT_INDEX(x)						\
+	PCPU_COUNTER_KSTAT_INDEX(ipsec_kstats_t, x)
+#define	IPSEC_NCOUNTERS		IPSEC_STAT_INDEX(sadb_acquire_maxpackets)
+
 #define	IP_ESP_BUMP_STAT(ipss, x)					\
 do {									\
-	if ((ipss)->ipsec_kstats != NULL)				\
-		((ipss)->ipsec_kstats->esp_stat_ ## x).value.ui64++;	\
+	if ((ipss)->ipsec_counters != NULL)				\
+		PCPU_COUNTER_INC((ipss)->ipsec_counters,		\
+		    IPSEC_STAT_INDEX(esp_stat_ ## x));			\
 _NOTE(CONSTCOND)							\
 } while (0)
 
 #define	IP_AH_BUMP_STAT(ipss, x)					\
 do {									\
-	if ((ipss)->ipsec_kstats != NULL)				\
-		((ipss)->ipsec_kstats->ah_stat_ ## x).value.ui64++;	\
+	if ((ipss)->ipsec_counters != NULL)				\
+		PCPU_COUNTER_INC((ipss)->ipsec_counters,		\
+		    IPSEC_STAT_INDEX(ah_stat_ ## x));			\
 _NOTE(CONSTCOND)							\
 } while (0)
 
@@ -203,6 +203,9 @@ sctp_create_eager(sctp_t *psctp)
 	sctp->sctp_ack_mp = ack_mp;
 	sctp->sctp_heartbeat_mp = hb_mp;
 
+	/* sctp_conn_request() rebinds to the squeue the INIT came in on */
+	sctp_squeue_bind(connp, NULL);
+
 	if (sctp_init_values(sctp, psctp, KM_NOSLEEP) != 0) {
 		freeb(ack_mp);
 		freeb(hb_mp);
@@ -231,6 +234,21 @@ sctp_create_eager(sctp_t *psctp)
 	return (sctp);
 }
 
+/*
+ * Bind an association to the squeue its inbound packets are processed on.
+ * A NULL sqp picks one at random, as tcp does for active opens.
+ */
+void
+sctp_squeue_bind(conn_t *connp, squeue_t *sqp)
+{
+	if (sqp == NULL)
+		sqp = IP_SQUEUE_GET((uint_t)gethrtime());
+
+	connp->conn_sqp = sqp;
+	connp->conn_initial_sqp = sqp;
+	connp->conn_ixa->ixa_sqp = sqp;
+}
+
 /*
  * We are dying for some reason.  Try to do it gracefully.
  */
@@ -1389,6 +1407,8 @@ sctp_create(void *ulpd, sctp_t *parent, int family, int type, int flags,
 	sctp->sctp_ack_mp = ack_mp;
 	sctp->sctp_heartbeat_mp = hb_mp;
 
+	sctp_squeue_bind(connp, NULL);
+
 	/*
 	 * Have conn_ip_output drop packets should our outer source
 	 * go invalid, and tell us about mtu changes.
@@ -194,6 +194,14 @@ sctp_conn_request(sctp_t *sctp, mblk_t *mp, uint_t ifindex, uint_t ip_hdr_len,
 	}
 	econnp = eager->sctp_connp;
 
+	/*
+	 * Process the new association on the squeue IP picked from the
+	 * receive ring the INIT arrived on, so that its traffic stays on
+	 * that CPU instead of being spread over the listener's.
+	 */
+	if (ira->ira_sqp != NULL)
+		sctp_squeue_bind(econnp, ira->ira_sqp);
+
 	if (connp->conn_policy != NULL) {
 		/* Inherit the policy from the listener; use actions from ira */
 		if (!ip_ipsec_policy_inherit(econnp, connp, ira)) {
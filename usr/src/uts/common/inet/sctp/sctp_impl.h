@@ -1143,6 +1143,7 @@ extern void	sctp_shutdown_complete(sctp_t *);
 extern void	sctp_set_if_mtu(sctp_t *);
 extern void	sctp_set_iplen(sctp_t *, mblk_t *, ip_xmit_attr_t *);
 extern void	sctp_set_ulp_prop(sctp_t *);
+extern void	sctp_squeue_bind(conn_t *, squeue_t *);
 extern void	sctp_ss_rexmit(sctp_t *);
 extern void	sctp_stack_cpu_add(sctp_stack_t *, processorid_t);
 extern size_t	sctp_supaddr_param_len(sctp_t *);
@@ -33,6 +33,8 @@
 #include <sys/socket.h>
 #include <sys/strsun.h>
 #include <sys/strsubr.h>
+#include <sys/squeue_impl.h>
+#include <sys/squeue.h>
 
 #include <netinet/in.h>
 #include <netinet/ip6.h>
@@ -3506,6 +3508,76 @@ sctp_ootb_input(mblk_t *mp, ip_recv_attr_t *ira, ip_stack_t *ipst)
 	freemsg(mp);
 }
 
+/*
+ * Process one inbound packet for an association, or queue it on the
+ * association's recvq if another thread is already running it.
+ */
+static void
+sctp_input_process(sctp_t *sctp, mblk_t *mp, ip_recv_attr_t *ira)
+{
+	ill_t		*ill = ira->ira_ill;
+	ill_t		*rill = ira->ira_rill;
+
+	ira->ira_ill = ira->ira_rill = NULL;
+
+	mutex_enter(&sctp->sctp_lock);
+	if (sctp->sctp_running) {
+		sctp_add_recvq(sctp, mp, B_FALSE, ira);
+		mutex_exit(&sctp->sctp_lock);
+		goto done;
+	} else {
+		sctp->sctp_running = B_TRUE;
+		mutex_exit(&sctp->sctp_lock);
+
+		mutex_enter(&sctp->sctp_recvq_lock);
+		if (sctp->sctp_recvq != NULL) {
+			sctp_add_recvq(sctp, mp, B_TRUE, ira);
+			mutex_exit(&sctp->sctp_recvq_lock);
+			WAKE_SCTP(sctp);
+			goto done;
+		}
+	}
+	mutex_exit(&sctp->sctp_recvq_lock);
+	if (ira->ira_flags & IRAF_ICMP_ERROR)
+		sctp_icmp_error(sctp, mp);
+	else
+		sctp_input_data(sctp, mp, ira);
+	WAKE_SCTP(sctp);
+
+done:
+	ira->ira_ill = ill;
+	ira->ira_rill = rill;
+}
+
+/*
+ * Squeue callback for sctp_input().  The squeue holds a conn_t reference
+ * for us; take an sctp_t reference for the duration of the processing
+ * unless the association lost its last one while the packet was queued.
+ * Packets that pile up behind a busy squeue are drained here back to
+ * back on the association's CPU.
+ */
+/* ARGSUSED2 */
+static void
+sctp_input_squeue(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *ira)
+{
+	conn_t	*connp = (conn_t *)arg;
+	sctp_t	*sctp = CONN2SCTP(connp);
+
+	ASSERT(ira != NULL);
+
+	mutex_enter(&sctp->sctp_reflock);
+	if (sctp->sctp_refcnt == 0) {
+		mutex_exit(&sctp->sctp_reflock);
+		freemsg(mp);
+		return;
+	}
+	sctp->sctp_refcnt++;
+	mutex_exit(&sctp->sctp_reflock);
+
+	sctp_input_process(sctp, mp, ira);
+	SCTP_REFRELE(sctp);
+}
+
 /*
  * Handle sctp packets.
  * Note that we rele the sctp_t (the caller got a reference on it).
@@ -3520,7 +3592,6 @@ sctp_input(conn_t *connp, ipha_t *ipha, ip6_t *ip6h, mblk_t *mp,
 	ip_stack_t	*ipst = ill->ill_ipst;
 	ipsec_stack_t	*ipss = ipst->ips_netstack->netstack_ipsec;
 	iaflags_t	iraflags = ira->ira_flags;
-	ill_t		*rill = ira->ira_rill;
 
 	secure = iraflags & IRAF_IPSEC_SECURE;
 
@@ -3543,36 +3614,20 @@ sctp_input(conn_t *connp, ipha_t *ipha, ip6_t *ip6h, mblk_t *mp,
 		}
 	}
 
-	ira->ira_ill = ira->ira_rill = NULL;
-
-	mutex_enter(&sctp->sctp_lock);
-	if (sctp->sctp_running) {
-		sctp_add_recvq(sctp, mp, B_FALSE, ira);
-		mutex_exit(&sctp->sctp_lock);
-		goto done;
-	} else {
-		sctp->sctp_running = B_TRUE;
-		mutex_exit(&sctp->sctp_lock);
-
-		mutex_enter(&sctp->sctp_recvq_lock);
-		if (sctp->sctp_recvq != NULL) {
-			sctp_add_recvq(sctp, mp, B_TRUE, ira);
-			mutex_exit(&sctp->sctp_recvq_lock);
-			WAKE_SCTP(sctp);
-			goto done;
-		}
+	if (connp->conn_sqp != NULL) {
+		/*
+		 * Trade the sctp_t reference from the fanout for the conn_t
+		 * reference the squeue drops after sctp_input_squeue() ran.
+		 */
+		CONN_INC_REF(connp);
+		SCTP_REFRELE(sctp);
+		SQUEUE_ENTER_ONE(connp->conn_sqp, mp, sctp_input_squeue,
+		    connp, ira, SQ_PROCESS, SQTAG_SCTP_INPUT);
+		return;
 	}
-	mutex_exit(&sctp->sctp_recvq_lock);
-	if (ira->ira_flags & IRAF_ICMP_ERROR)
-		sctp_icmp_error(sctp, mp);
-	else
-		sctp_input_data(sctp, mp, ira);
-	WAKE_SCTP(sctp);
 
-done:
+	sctp_input_process(sctp, mp, ira);
 	SCTP_REFRELE(sctp);
-	ira->ira_ill = ill;
-	ira->ira_rill = rill;
 }
 
 static void
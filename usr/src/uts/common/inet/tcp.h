@@ -46,6 +46,7 @@ extern "C" {
 #include <inet/mib2.h>
 #include <inet/tcp_stack.h>
 #include <inet/tcp_sack.h>
+#include <inet/tcp_cc.h>
 
 /* TCP states */
 #define	TCPS_CLOSED		-6
@@ -493,6 +494,17 @@ typedef struct tcp_s {
 	/* FIN-WAIT-2 flush timeout */
 	uint32_t		tcp_fin_wait_2_flush_interval;
 
+	/* Congestion control algorithm and its per-connection state */
+	tcp_cc_ops_t		*tcp_cc;
+	uint64_t		tcp_cc_priv[TCP_CC_PRIV_WORDS];
+
+	/* Kernel TLS transmit state, see tcp_tls.c */
+	struct tcp_tls_s	*tcp_tls;
+
+	/* Receive flow steering, see tcp_rx_steer() */
+	processorid_t		tcp_rx_cpu;	/* CPU of the last reader */
+	int64_t			tcp_rx_steer_time; /* lbolt of last attempt */
+
 #ifdef DEBUG
 	pc_t			tcmp_stk[15];
 #endif
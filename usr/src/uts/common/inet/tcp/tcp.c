@@ -1422,6 +1422,9 @@ tcp_free(tcp_t *tcp)
 	 */
 	tcp_close_mpp(&tcp->tcp_conn.tcp_eager_conn_ind);
 
+	tcp_cc_detach(tcp);
+	tcp_tls_free(tcp);
+
 	/*
 	 * If this is a non-STREAM socket still holding on to an upper
 	 * handle, release it. As a result of fallback we might also see
@@ -1630,6 +1633,9 @@ tcp_connect_ipv4(tcp_t *tcp, ipaddr_t *dstaddrp, in_port_t dstport,
 	    connp->conn_fport == connp->conn_lport)
 		return (-TBADADDR);
 
+	if (tcps->tcps_tw_cnt != 0)
+		tcp_time_wait_reuse(tcp);
+
 	tcp->tcp_state = TCPS_SYN_SENT;
 
 	return (ipcl_conn_insert_v4(connp));
@@ -1726,6 +1732,9 @@ tcp_connect_ipv6(tcp_t *tcp, in6_addr_t *dstaddrp, in_port_t dstport,
 	    connp->conn_fport == connp->conn_lport)
 		return (-TBADADDR);
 
+	if (tcps->tcps_tw_cnt != 0)
+		tcp_time_wait_reuse(tcp);
+
 	tcp->tcp_state = TCPS_SYN_SENT;
 
 	return (ipcl_conn_insert_v6(connp));
@@ -2181,6 +2190,10 @@ tcp_reinit_values(tcp)
 
 	DONTCARE(tcp->tcp_cwnd_ssthresh); /* Init in tcp_set_destination */
 	DONTCARE(tcp->tcp_cwnd_max);		/* Init in tcp_init_values */
+	DONTCARE(tcp->tcp_cc);			/* Init in tcp_init_values */
+	DONTCARE(tcp->tcp_cc_priv);		/* Init in tcp_init_values */
+	DONTCARE(tcp->tcp_rx_cpu);		/* Init in tcp_init_values */
+	DONTCARE(tcp->tcp_rx_steer_time);	/* Init in tcp_init_values */
 	tcp->tcp_csuna = 0;
 
 	tcp->tcp_rto = 0;			/* Displayed in MIB */
@@ -2417,6 +2430,17 @@ tcp_init_values(tcp_t *tcp, tcp_t *parent)
 	tcp->tcp_cwnd_max = tcps->tcps_cwnd_max_;
 	tcp->tcp_cwnd_ssthresh = TCP_MAX_LARGEWIN;
 
+	/* An eager uses its listener's congestion control algorithm. */
+	if (parent != NULL) {
+		tcp_cc_hold(parent->tcp_cc);
+		tcp_cc_attach(tcp, parent->tcp_cc);
+	} else {
+		tcp_cc_attach(tcp, tcp_cc_stack_default(tcps));
+	}
+
+	tcp->tcp_rx_cpu = PBIND_NONE;
+	tcp->tcp_rx_steer_time = 0;
+
 	tcp->tcp_maxpsz_multiplier = tcps->tcps_maxpsz_multiplier;
 
 	/* NOTE:  ISS is now set in tcp_set_destination(). */
@@ -3710,6 +3734,9 @@ tcp_ddi_g_init(void)
 
 	tcp_g_kstat = tcp_g_kstat_init(&tcp_g_statistics);
 
+	tcp_cc_g_init();
+	tcp_time_wait_g_init();
+
 	tcp_squeue_flag = tcp_squeue_switch(tcp_squeue_wput);
 
 	/*
@@ -3833,6 +3860,9 @@ tcp_stack_init(netstackid_t stackid, netstack_t *ns)
 	list_create(&tcps->tcps_listener_conf, sizeof (tcp_listener_t),
 	    offsetof(tcp_listener_t, tl_link));
 
+	tcp_cc_stack_init(tcps);
+	tcp_time_wait_stack_init(tcps);
+
 	return (tcps);
 }
 
@@ -3852,6 +3882,9 @@ tcp_ddi_g_destroy(void)
 	kmem_cache_destroy(tcp_notsack_blk_cache);
 
 	netstack_unregister(NS_TCP);
+
+	tcp_cc_g_destroy();
+	tcp_time_wait_g_destroy();
 }
 
 /*
@@ -3882,6 +3915,9 @@ tcp_stack_fini(netstackid_t stackid, void *arg)
 
 	tcp_listener_conf_cleanup(tcps);
 
+	tcp_cc_stack_fini(tcps);
+	tcp_time_wait_stack_fini(tcps);
+
 	for (i = 0; i < tcps->tcps_sc_cnt; i++)
 		kmem_free(tcps->tcps_sc[i], sizeof (tcp_stats_cpu_t));
 	kmem_free(tcps->tcps_sc, max_ncpus * sizeof (tcp_stats_cpu_t *));
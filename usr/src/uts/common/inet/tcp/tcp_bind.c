@@ -813,6 +813,20 @@ tcp_bindi(tcp_t *tcp, in_port_t port, const in6_addr_t *laddr,
 			    bind_to_req_port_only)
 				continue;
 
+			/*
+			 * SO_REUSEPORT lets endpoints of the same user share
+			 * an address and port, if all of them set it before
+			 * binding.  Incoming connections are spread over the
+			 * listeners by ipcl_classify_v4() and v6().
+			 */
+			if (connp->conn_reuseport && lconnp->conn_reuseport &&
+			    bind_to_req_port_only &&
+			    IN6_ARE_ADDR_EQUAL(laddr,
+			    &lconnp->conn_bound_addr_v6) &&
+			    crgetuid(connp->conn_cred) ==
+			    crgetuid(lconnp->conn_cred))
+				continue;
+
 			/*
 			 * Ideally, we should make sure that the source
 			 * address, remote address, and remote port in the
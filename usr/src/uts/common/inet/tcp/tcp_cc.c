@@ -0,0 +1,310 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * TCP congestion control framework, and NewReno, the default algorithm.
+ * See <inet/tcp_cc.h> for the interface between TCP and an algorithm.
+ *
+ * Algorithms are kept on a list, protected by tcp_cc_lock, which also
+ * protects each stack's tcps_cc_default.  Every connection, and every
+ * stack default, holds a reference on its algorithm so that the algorithm
+ * cannot be unregistered while it is in use; a connection only takes its
+ * reference from something that already holds one (the stack default
+ * under tcp_cc_lock, its listener, or tcp_cc_lookup()).
+ */
+
+#include <sys/types.h>
+#include <sys/systm.h>
+#include <sys/ksynch.h>
+#include <sys/atomic.h>
+#include <sys/debug.h>
+#include <inet/tcp_impl.h>
+
+static krwlock_t	tcp_cc_lock;
+static tcp_cc_ops_t	*tcp_cc_algs;
+
+static tcp_cc_ops_t *
+tcp_cc_find(const char *name)
+{
+	tcp_cc_ops_t	*cc;
+
+	ASSERT(RW_LOCK_HELD(&tcp_cc_lock));
+	for (cc = tcp_cc_algs; cc != NULL; cc = cc->tcc_next) {
+		if (strcmp(cc->tcc_name, name) == 0)
+			return (cc);
+	}
+	return (NULL);
+}
+
+int
+tcp_cc_register(tcp_cc_ops_t *cc)
+{
+	tcp_cc_ops_t	**ccp;
+
+	if (strlen(cc->tcc_name) >= TCP_CA_NAME_MAX || cc->tcc_ack == NULL ||
+	    cc->tcc_loss == NULL || cc->tcc_rto == NULL ||
+	    cc->tcc_idle == NULL)
+		return (EINVAL);
+
+	rw_enter(&tcp_cc_lock, RW_WRITER);
+	if (tcp_cc_find(cc->tcc_name) != NULL) {
+		rw_exit(&tcp_cc_lock);
+		return (EEXIST);
+	}
+	/* Keep the list in registration order, for tcp_cc_list(). */
+	for (ccp = &tcp_cc_algs; *ccp != NULL; ccp = &(*ccp)->tcc_next)
+		;
+	cc->tcc_next = NULL;
+	cc->tcc_refcnt = 0;
+	*ccp = cc;
+	rw_exit(&tcp_cc_lock);
+	return (0);
+}
+
+int
+tcp_cc_unregister(tcp_cc_ops_t *cc)
+{
+	tcp_cc_ops_t	**ccp;
+
+	rw_enter(&tcp_cc_lock, RW_WRITER);
+	if (cc->tcc_refcnt != 0) {
+		rw_exit(&tcp_cc_lock);
+		return (EBUSY);
+	}
+	for (ccp = &tcp_cc_algs; *ccp != NULL; ccp = &(*ccp)->tcc_next) {
+		if (*ccp == cc) {
+			*ccp = cc->tcc_next;
+			rw_exit(&tcp_cc_lock);
+			return (0);
+		}
+	}
+	rw_exit(&tcp_cc_lock);
+	return (ENOENT);
+}
+
+/*
+ * Find an algorithm by name and return it held, or NULL.
+ */
+tcp_cc_ops_t *
+tcp_cc_lookup(const char *name)
+{
+	tcp_cc_ops_t	*cc;
+
+	rw_enter(&tcp_cc_lock, RW_READER);
+	if ((cc = tcp_cc_find(name)) != NULL)
+		atomic_inc_32(&cc->tcc_refcnt);
+	rw_exit(&tcp_cc_lock);
+	return (cc);
+}
+
+void
+tcp_cc_hold(tcp_cc_ops_t *cc)
+{
+	ASSERT(cc->tcc_refcnt != 0);
+	atomic_inc_32(&cc->tcc_refcnt);
+}
+
+void
+tcp_cc_rele(tcp_cc_ops_t *cc)
+{
+	ASSERT(cc->tcc_refcnt != 0);
+	atomic_dec_32(&cc->tcc_refcnt);
+}
+
+/*
+ * Switch a connection to the given algorithm, consuming the caller's
+ * hold on it.  The new algorithm carries on from the current window.
+ */
+void
+tcp_cc_attach(tcp_t *tcp, tcp_cc_ops_t *cc)
+{
+	tcp_cc_detach(tcp);
+
+	bzero(tcp->tcp_cc_priv, sizeof (tcp->tcp_cc_priv));
+	tcp->tcp_cwnd_cnt = 0;
+	tcp->tcp_cc = cc;
+	if (cc->tcc_init != NULL)
+		cc->tcc_init(tcp);
+}
+
+void
+tcp_cc_detach(tcp_t *tcp)
+{
+	if (tcp->tcp_cc != NULL) {
+		tcp_cc_rele(tcp->tcp_cc);
+		tcp->tcp_cc = NULL;
+	}
+}
+
+void
+tcp_cc_stack_init(tcp_stack_t *tcps)
+{
+	tcps->tcps_cc_default = tcp_cc_lookup(tcp_cc_newreno.tcc_name);
+	VERIFY(tcps->tcps_cc_default != NULL);
+}
+
+void
+tcp_cc_stack_fini(tcp_stack_t *tcps)
+{
+	tcp_cc_rele(tcps->tcps_cc_default);
+	tcps->tcps_cc_default = NULL;
+}
+
+/*
+ * Return the stack's default algorithm, held.
+ */
+tcp_cc_ops_t *
+tcp_cc_stack_default(tcp_stack_t *tcps)
+{
+	tcp_cc_ops_t	*cc;
+
+	rw_enter(&tcp_cc_lock, RW_READER);
+	cc = tcps->tcps_cc_default;
+	atomic_inc_32(&cc->tcc_refcnt);
+	rw_exit(&tcp_cc_lock);
+	return (cc);
+}
+
+int
+tcp_cc_set_stack_default(tcp_stack_t *tcps, const char *name)
+{
+	tcp_cc_ops_t	*cc, *old;
+
+	rw_enter(&tcp_cc_lock, RW_WRITER);
+	if ((cc = tcp_cc_find(name)) == NULL) {
+		rw_exit(&tcp_cc_lock);
+		return (EINVAL);
+	}
+	atomic_inc_32(&cc->tcc_refcnt);
+	old = tcps->tcps_cc_default;
+	tcps->tcps_cc_default = cc;
+	rw_exit(&tcp_cc_lock);
+
+	tcp_cc_rele(old);
+	return (0);
+}
+
+/*
+ * Write the names of the registered algorithms, separated by commas, to
+ * buf.  As with snprintf(), return the length the full list needs.
+ */
+size_t
+tcp_cc_list(char *buf, size_t size)
+{
+	tcp_cc_ops_t	*cc;
+	size_t		len = 0;
+
+	if (size != 0)
+		buf[0] = '\0';
+	rw_enter(&tcp_cc_lock, RW_READER);
+	for (cc = tcp_cc_algs; cc != NULL; cc = cc->tcc_next) {
+		len += snprintf(buf + MIN(len, size), size - MIN(len, size),
+		    "%s%s", cc == tcp_cc_algs ? "" : ",", cc->tcc_name);
+	}
+	rw_exit(&tcp_cc_lock);
+	return (len);
+}
+
+void
+tcp_cc_g_init(void)
+{
+	rw_init(&tcp_cc_lock, NULL, RW_DEFAULT, NULL);
+	VERIFY0(tcp_cc_register(&tcp_cc_newreno));
+	VERIFY0(tcp_cc_register(&tcp_cc_cubic));
+}
+
+void
+tcp_cc_g_destroy(void)
+{
+	VERIFY0(tcp_cc_unregister(&tcp_cc_cubic));
+	VERIFY0(tcp_cc_unregister(&tcp_cc_newreno));
+	rw_destroy(&tcp_cc_lock);
+}
+
+/*
+ * NewReno: slow start and congestion avoidance as in RFC 5681, and the
+ * window halved on loss, as TCP has always done it.
+ */
+/* ARGSUSED */
+static void
+newreno_ack(tcp_t *tcp, uint32_t bytes_acked)
+{
+	uint32_t	cwnd = tcp->tcp_cwnd;
+	uint32_t	add = tcp->tcp_mss;
+
+	if (cwnd >= tcp->tcp_cwnd_ssthresh) {
+		/*
+		 * This is to prevent an increase of less than 1 MSS of
+		 * tcp_cwnd.  With partial increase, tcp_wput_data()
+		 * may send out tinygrams in order to preserve mblk
+		 * boundaries.
+		 *
+		 * By initializing tcp_cwnd_cnt to new tcp_cwnd and
+		 * decrementing it by 1 MSS for every ACKs, tcp_cwnd is
+		 * increased by 1 MSS for every RTTs.
+		 */
+		if (tcp->tcp_cwnd_cnt <= 0) {
+			tcp->tcp_cwnd_cnt = cwnd + add;
+		} else {
+			tcp->tcp_cwnd_cnt -= add;
+			add = 0;
+		}
+	}
+	tcp->tcp_cwnd = MIN(cwnd + add, tcp->tcp_cwnd_max);
+}
+
+static void
+newreno_loss(tcp_t *tcp, int how)
+{
+	uint32_t	mss = tcp->tcp_mss;
+	uint32_t	npkt;
+
+	npkt = ((tcp->tcp_snxt - tcp->tcp_suna) >> 1) / mss;
+	tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) * mss;
+	if (how == TCP_CC_LOSS_DUPACK)
+		tcp->tcp_cwnd = (npkt + tcp->tcp_dupack_cnt) * mss;
+	else
+		tcp->tcp_cwnd = npkt * mss;
+}
+
+static void
+newreno_rto(tcp_t *tcp)
+{
+	uint32_t	npkt;
+
+	/*
+	 * Set the ssthresh to one half of current effective window and
+	 * cwnd to one MSS.
+	 */
+	if (!tcp->tcp_cwr || tcp->tcp_rexmit) {
+		npkt = ((tcp->tcp_timer_backoff ?
+		    tcp->tcp_cwnd_ssthresh :
+		    tcp->tcp_snxt - tcp->tcp_suna) >> 1) / tcp->tcp_mss;
+		tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) * tcp->tcp_mss;
+	}
+	tcp->tcp_cwnd = tcp->tcp_mss;
+	tcp->tcp_cwnd_cnt = 0;
+}
+
+static void
+newreno_idle(tcp_t *tcp)
+{
+	TCP_SET_INIT_CWND(tcp, tcp->tcp_mss,
+	    tcp->tcp_tcps->tcps_slow_start_after_idle);
+}
+
+tcp_cc_ops_t tcp_cc_newreno = {
+	.tcc_name =	"newreno",
+	.tcc_ack =	newreno_ack,
+	.tcc_loss =	newreno_loss,
+	.tcc_rto =	newreno_rto,
+	.tcc_idle =	newreno_idle,
+};
@@ -0,0 +1,246 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * CUBIC congestion control (RFC 8312).
+ *
+ * In congestion avoidance the window follows
+ *
+ *	W(t) = C * (t - K)^3 + W_max
+ *
+ * where t is the time since the last reduction, W_max the window at which
+ * it happened and K the time W(t) takes to climb back to W_max.  Because
+ * growth depends on time rather than on the rate of ACKs, a long, fast
+ * path regains its window far sooner than with NewReno's one segment per
+ * round trip.  On short paths, where NewReno would do better, the window
+ * instead follows an estimate of what NewReno would have reached (the
+ * "TCP-friendly region").  Slow start is unchanged.
+ *
+ * Times are in milliseconds and windows in bytes.  The time since the
+ * reduction is capped at CUBIC_MAX_T, which keeps (t - K)^3 in 64 bits;
+ * by then the window is far past anything tcp_cwnd_max allows.
+ */
+
+#include <sys/types.h>
+#include <sys/systm.h>
+#include <sys/debug.h>
+#include <inet/tcp_impl.h>
+
+/* beta_cubic = 0.7: the window is reduced to 7/10 on loss */
+#define	CUBIC_BETA_NUM		7
+#define	CUBIC_BETA_DEN		10
+
+/* With fast convergence, W_max is set to (1 + beta_cubic) / 2 = 17/20. */
+#define	CUBIC_FC_NUM		17
+#define	CUBIC_FC_DEN		20
+
+/* The TCP-friendly window grows by 3 (1 - beta) / (1 + beta) = 9/17. */
+#define	CUBIC_ALPHA_NUM		9
+#define	CUBIC_ALPHA_DEN		17
+
+/*
+ * C = 0.4 segments/s^3.  One millisecond cubed is 10^-9 s^3, so a time of
+ * t milliseconds is worth 0.4 * t^3 / 10^9 segments, or t^3 / CUBIC_T3_DIV
+ * in 1/1024ths of a segment.
+ */
+#define	CUBIC_T3_DIV		2441406
+#define	CUBIC_SEG_SHIFT		10
+
+#define	CUBIC_MAX_T		(1 << 20)
+
+typedef struct cubic_state {
+	int64_t		cs_epoch;	/* start of the epoch, or 0 */
+	uint32_t	cs_wmax;	/* window at the last reduction */
+	uint32_t	cs_origin;	/* W_max of the current curve */
+	uint32_t	cs_k;		/* time to reach cs_origin */
+	uint32_t	cs_west;	/* window at the start of the epoch */
+	uint32_t	cs_acc;		/* increase not yet added to tcp_cwnd */
+} cubic_state_t;
+
+CTASSERT(sizeof (cubic_state_t) <= sizeof (((tcp_t *)0)->tcp_cc_priv));
+
+int cubic_fast_convergence = 1;
+
+#define	CUBIC_STATE(tcp)	((cubic_state_t *)(tcp)->tcp_cc_priv)
+
+/*
+ * Integer cube root, rounded down.
+ */
+static uint64_t
+cubic_cbrt(uint64_t x)
+{
+	uint64_t	y = 0, b;
+	int		s;
+
+	for (s = 63; s >= 0; s -= 3) {
+		y <<= 1;
+		b = 3 * y * (y + 1) + 1;
+		if ((x >> s) >= b) {
+			x -= b << s;
+			y++;
+		}
+	}
+	return (y);
+}
+
+/*
+ * W(t), in bytes.
+ */
+static uint64_t
+cubic_window(cubic_state_t *cs, int64_t t, uint32_t mss)
+{
+	int64_t		d = t - cs->cs_k;
+	uint64_t	ad = MIN(d < 0 ? -d : d, CUBIC_MAX_T);
+	uint64_t	delta;
+
+	delta = ((ad * ad * ad / CUBIC_T3_DIV) * mss) >> CUBIC_SEG_SHIFT;
+	if (d >= 0)
+		return (cs->cs_origin + delta);
+	return (delta < cs->cs_origin ? cs->cs_origin - delta : 0);
+}
+
+static void
+cubic_ack(tcp_t *tcp, uint32_t bytes_acked)
+{
+	cubic_state_t	*cs = CUBIC_STATE(tcp);
+	uint32_t	mss = tcp->tcp_mss;
+	uint32_t	cwnd = tcp->tcp_cwnd;
+	int64_t		now, t, srtt;
+	uint64_t	target, west, incr, diff;
+
+	if (cwnd < tcp->tcp_cwnd_ssthresh) {
+		tcp->tcp_cwnd = MIN(cwnd + mss, tcp->tcp_cwnd_max);
+		return;
+	}
+
+	/*
+	 * The window does not grow during fast recovery; it is set back to
+	 * ssthresh when recovery ends, and the epoch starts from there.
+	 */
+	if (tcp->tcp_dupack_cnt >= tcp->tcp_tcps->tcps_dupack_fast_retransmit)
+		return;
+
+	now = TICK_TO_MSEC(LBOLT_FASTPATH64);
+	if (cs->cs_epoch == 0) {
+		cs->cs_epoch = MAX(now, 1);
+		cs->cs_acc = 0;
+		cs->cs_west = cwnd;
+		if (cwnd < cs->cs_wmax) {
+			diff = cs->cs_wmax - cwnd;
+			cs->cs_origin = cs->cs_wmax;
+			cs->cs_k = cubic_cbrt(((diff << CUBIC_SEG_SHIFT) / mss) *
+			    CUBIC_T3_DIV);
+		} else {
+			cs->cs_origin = cwnd;
+			cs->cs_k = 0;
+		}
+	}
+
+	/* tcp_rtt_sa is eight times the smoothed RTT, in milliseconds. */
+	srtt = MAX(tcp->tcp_rtt_sa >> 3, 1);
+	t = MIN(now - cs->cs_epoch, CUBIC_MAX_T);
+
+	/* Aim for where the curve will be one round trip from now. */
+	target = cubic_window(cs, t + srtt, mss);
+
+	/* The window NewReno would have reached since the reduction. */
+	west = cs->cs_west + (CUBIC_ALPHA_NUM * mss * (uint64_t)t) /
+	    (CUBIC_ALPHA_DEN * srtt);
+	if (west > target)
+		target = west;
+
+	if (target > cwnd) {
+		/*
+		 * Spread the increase over the next window's worth of ACKs,
+		 * and grow by no more than half the window per round trip.
+		 * As with NewReno, only ever add whole segments.
+		 */
+		target = MIN(target, cwnd + cwnd / 2);
+		incr = (target - cwnd) * bytes_acked / cwnd;
+		cs->cs_acc = MIN(cs->cs_acc + incr, cwnd);
+		if (cs->cs_acc >= mss) {
+			cwnd += cs->cs_acc / mss * mss;
+			cs->cs_acc %= mss;
+		}
+	}
+	tcp->tcp_cwnd = MIN(cwnd, tcp->tcp_cwnd_max);
+}
+
+/*
+ * Note the window at which congestion happened, and start a new epoch on
+ * the next ACK in congestion avoidance.  As with NewReno, the amount of
+ * data in flight stands for the window.
+ */
+static uint32_t
+cubic_reduce(tcp_t *tcp, uint32_t win)
+{
+	cubic_state_t	*cs = CUBIC_STATE(tcp);
+	uint32_t	mss = tcp->tcp_mss;
+
+	if (cubic_fast_convergence && win < cs->cs_wmax) {
+		cs->cs_wmax = (uint64_t)win * CUBIC_FC_NUM / CUBIC_FC_DEN;
+	} else {
+		cs->cs_wmax = win;
+	}
+	cs->cs_epoch = 0;
+
+	return ((uint32_t)((uint64_t)win * CUBIC_BETA_NUM / CUBIC_BETA_DEN /
+	    mss));
+}
+
+static void
+cubic_loss(tcp_t *tcp, int how)
+{
+	uint32_t	mss = tcp->tcp_mss;
+	uint32_t	npkt;
+
+	npkt = cubic_reduce(tcp, tcp->tcp_snxt - tcp->tcp_suna);
+	tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) * mss;
+	if (how == TCP_CC_LOSS_DUPACK)
+		tcp->tcp_cwnd = (npkt + tcp->tcp_dupack_cnt) * mss;
+	else
+		tcp->tcp_cwnd = npkt * mss;
+}
+
+static void
+cubic_rto(tcp_t *tcp)
+{
+	uint32_t	npkt;
+
+	if (!tcp->tcp_cwr || tcp->tcp_rexmit) {
+		if (tcp->tcp_timer_backoff == 0) {
+			npkt = cubic_reduce(tcp,
+			    tcp->tcp_snxt - tcp->tcp_suna);
+		} else {
+			npkt = (tcp->tcp_cwnd_ssthresh >> 1) / tcp->tcp_mss;
+		}
+		tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) * tcp->tcp_mss;
+	}
+	CUBIC_STATE(tcp)->cs_epoch = 0;
+	tcp->tcp_cwnd = tcp->tcp_mss;
+	tcp->tcp_cwnd_cnt = 0;
+}
+
+static void
+cubic_idle(tcp_t *tcp)
+{
+	CUBIC_STATE(tcp)->cs_epoch = 0;
+	TCP_SET_INIT_CWND(tcp, tcp->tcp_mss,
+	    tcp->tcp_tcps->tcps_slow_start_after_idle);
+}
+
+tcp_cc_ops_t tcp_cc_cubic = {
+	.tcc_name =	"cubic",
+	.tcc_ack =	cubic_ack,
+	.tcc_loss =	cubic_loss,
+	.tcc_rto =	cubic_rto,
+	.tcc_idle =	cubic_idle,
+};
@@ -62,11 +62,6 @@
 	(TCPOPT_NOP << 8) | TCPOPT_NOP)
 #endif
 
-/*
- *  PAWS needs a timer for 24 days.  This is the number of ticks in 24 days
- */
-#define	PAWS_TIMEOUT	((clock_t)(24*24*60*60*hz))
-
 /*
  * Since tcp_listener is not cleared atomically with tcp_detached
  * being cleared we need this extra bit to tell a detached connection
@@ -153,6 +148,12 @@ static boolean_t tcp_icmp_source_quench = B_FALSE;
 
 static boolean_t tcp_outbound_squeue_switch = B_FALSE;
 
+/*
+ * With the _rx_steer property set, the minimum time in milliseconds
+ * between two attempts to move a connection to its reader's CPU.
+ */
+static uint32_t tcp_rx_steer_interval = 100;
+
 static mblk_t	*tcp_conn_create_v4(conn_t *, conn_t *, mblk_t *,
 		    ip_recv_attr_t *);
 static mblk_t	*tcp_conn_create_v6(conn_t *, conn_t *, mblk_t *,
@@ -166,6 +167,8 @@ static void	tcp_process_options(tcp_t *, tcpha_t *);
 static mblk_t	*tcp_reass(tcp_t *, mblk_t *, uint32_t);
 static void	tcp_reass_elim_overlap(tcp_t *, mblk_t *);
 static void	tcp_rsrv_input(void *, mblk_t *, void *, ip_recv_attr_t *);
+static boolean_t	tcp_rx_steer(tcp_t *, squeue_t *, mblk_t *,
+		    ip_recv_attr_t *);
 static void	tcp_set_rto(tcp_t *, time_t);
 static void	tcp_setcred_data(mblk_t *, ip_recv_attr_t *);
 
@@ -1301,6 +1304,13 @@ tcp_input_listener(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *ira)
 		return;
 	}
 
+	/*
+	 * A SYN for the 4-tuple of a compact TIME_WAIT entry is only passed
+	 * on to the listener if it is acceptable; see tcp_time_wait_input().
+	 */
+	if (tcps->tcps_tw_cnt != 0 && tcp_time_wait_input(tcps, mp, ira))
+		return;
+
 	if (listener->tcp_state != TCPS_LISTEN)
 		goto error2;
 
@@ -1856,6 +1866,14 @@ tcp_input_listener_unbound(void *arg, mblk_t *mp, void *arg2,
 	ASSERT(ira->ira_sqp != NULL);
 	new_sqp = ira->ira_sqp;
 
+	/*
+	 * A listener sharing its port through SO_REUSEPORT stays on the
+	 * squeue it was created on, so that the listeners of a group do not
+	 * all end up on the squeue of the ring their first SYNs came in on.
+	 */
+	if (connp->conn_reuseport)
+		new_sqp = connp->conn_sqp;
+
 	if (connp->conn_fanout == NULL)
 		goto done;
 
@@ -2289,6 +2307,59 @@ static sock_upcalls_t tcp_dummy_upcalls = {
 	tcp_dummy_onearg
 };
 
+/*
+ * Receive flow steering.  The squeue a connection lives on is picked by
+ * the ring its first packet arrived on, and mac spreads flows over its
+ * soft rings by hash, so the CPU that processes a connection's input is
+ * often not the one its application reads it from, and every segment's
+ * data then crosses CPUs on its way to the reader.  sockfs reports the CPU
+ * of the thread reading from the socket (tcp_recv_cpu()), and when it is
+ * not the one sqp is bound to, ask IP and mac to deliver the flow to the
+ * soft ring, and so the squeue, bound to that CPU instead.  If that works,
+ * move the connection to the new squeue, which is safe because we are in
+ * the old one: packets still on their way there are sent on by the
+ * squeue code once it sees that conn_sqp has changed.  mp goes along with
+ * the connection, and B_TRUE is returned.
+ *
+ * The few segments already queued on the old soft ring may arrive after
+ * the first ones on the new, which is why a connection is moved no more
+ * than once every tcp_rx_steer_interval milliseconds.  Only IPv4 flows
+ * that arrive on a ring IP polls can be steered.
+ */
+static boolean_t
+tcp_rx_steer(tcp_t *tcp, squeue_t *sqp, mblk_t *mp, ip_recv_attr_t *ira)
+{
+	conn_t		*connp = tcp->tcp_connp;
+	squeue_t	*new_sqp;
+	int64_t		now;
+
+	ASSERT(connp->conn_sqp == sqp);
+
+	if (tcp->tcp_state != TCPS_ESTABLISHED ||
+	    !(ira->ira_flags & IRAF_IS_IPV4))
+		return (B_FALSE);
+
+	now = LBOLT_FASTPATH64;
+	if (now - tcp->tcp_rx_steer_time <
+	    MSEC_TO_TICK(tcp_rx_steer_interval))
+		return (B_FALSE);
+	tcp->tcp_rx_steer_time = now;
+
+	new_sqp = ip_squeue_steer(ira, tcp->tcp_rx_cpu, connp->conn_faddr_v4,
+	    connp->conn_laddr_v4, connp->conn_ports);
+	if (new_sqp == NULL || new_sqp == sqp)
+		return (B_FALSE);
+
+	TCP_STAT(tcp->tcp_tcps, tcp_rx_steer);
+	CONN_INC_REF(connp);
+	SQUEUE_SWITCH(connp, new_sqp);
+	/* No special MT issues for outbound ixa_sqp hint */
+	connp->conn_ixa->ixa_sqp = new_sqp;
+	SQUEUE_ENTER_ONE(new_sqp, mp, tcp_input_data, connp, ira,
+	    ip_squeue_flag, SQTAG_TCP_RX_STEER);
+	return (B_TRUE);
+}
+
 /*
  * Handle M_DATA messages from IP. Its called directly from IP via
  * squeue for received IP packets.
@@ -2324,8 +2395,6 @@ tcp_input_data(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *ira)
 	ip_pkt_t	ipp;
 	boolean_t	ofo_seg = B_FALSE; /* Out of order segment */
 	uint32_t	cwnd;
-	uint32_t	add;
-	int		npkt;
 	int		mss;
 	conn_t		*connp = (conn_t *)arg;
 	squeue_t	*sqp = (squeue_t *)arg2;
@@ -2401,6 +2470,11 @@ tcp_input_data(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *ira)
 		return;
 	}
 
+	if (sqp != NULL && tcps->tcps_rx_steer &&
+	    tcp->tcp_rx_cpu != PBIND_NONE && tcp->tcp_rx_cpu != sqp->sq_bind &&
+	    tcp_rx_steer(tcp, sqp, mp, ira))
+		return;
+
 	if (sqp != NULL) {
 		/*
 		 * This is the correct place to update tcp_last_recv_time. Note
@@ -3856,14 +3930,12 @@ process_ack:
 		tcp->tcp_cwr = B_FALSE;
 	if (tcp->tcp_ecn_ok && (flags & TH_ECE)) {
 		if (!tcp->tcp_cwr) {
-			npkt = ((tcp->tcp_snxt - tcp->tcp_suna) >> 1) / mss;
-			tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) * mss;
-			tcp->tcp_cwnd = npkt * mss;
+			tcp->tcp_cc->tcc_loss(tcp, TCP_CC_LOSS_ECN);
 			/*
 			 * If the cwnd is 0, use the timer to clock out
 			 * new segments.  This is required by the ECN spec.
 			 */
-			if (npkt == 0) {
+			if (tcp->tcp_cwnd == 0) {
 				TCP_TIMER_RESTART(tcp, tcp->tcp_rto);
 				/*
 				 * This makes sure that when the ACK comes
@@ -3948,12 +4020,8 @@ process_ack:
 				 * dropped (due to congestion.)
 				 */
 				if (!tcp->tcp_cwr) {
-					npkt = ((tcp->tcp_snxt -
-					    tcp->tcp_suna) >> 1) / mss;
-					tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) *
-					    mss;
-					tcp->tcp_cwnd = (npkt +
-					    tcp->tcp_dupack_cnt) * mss;
+					tcp->tcp_cc->tcc_loss(tcp,
+					    TCP_CC_LOSS_DUPACK);
 				}
 				if (tcp->tcp_ecn_ok) {
 					tcp->tcp_cwr = B_TRUE;
@@ -4264,32 +4332,10 @@ process_ack:
 	 *
 	 * If TCP is not ECN capable or TCP is ECN capable but the
 	 * congestion experience bit is not set, increase the tcp_cwnd as
-	 * usual.
+	 * usual, as the congestion control algorithm sees fit.
 	 */
-	if (!tcp->tcp_ecn_ok || !(flags & TH_ECE)) {
-		cwnd = tcp->tcp_cwnd;
-		add = mss;
-
-		if (cwnd >= tcp->tcp_cwnd_ssthresh) {
-			/*
-			 * This is to prevent an increase of less than 1 MSS of
-			 * tcp_cwnd.  With partial increase, tcp_wput_data()
-			 * may send out tinygrams in order to preserve mblk
-			 * boundaries.
-			 *
-			 * By initializing tcp_cwnd_cnt to new tcp_cwnd and
-			 * decrementing it by 1 MSS for every ACKs, tcp_cwnd is
-			 * increased by 1 MSS for every RTTs.
-			 */
-			if (tcp->tcp_cwnd_cnt <= 0) {
-				tcp->tcp_cwnd_cnt = cwnd + add;
-			} else {
-				tcp->tcp_cwnd_cnt -= add;
-				add = 0;
-			}
-		}
-		tcp->tcp_cwnd = MIN(cwnd + add, tcp->tcp_cwnd_max);
-	}
+	if (!tcp->tcp_ecn_ok || !(flags & TH_ECE))
+		tcp->tcp_cc->tcc_ack(tcp, bytes_acked);
 
 	/* See if the latest urgent data has been acknowledged */
 	if ((tcp->tcp_valid_bits & TCP_URG_VALID) &&
@@ -83,6 +83,7 @@ opdes_t	tcp_opt_arr[] = {
 { SO_ALLZONES, SOL_SOCKET, OA_R, OA_RW, OP_CONFIG, 0, sizeof (int),
 	0 },
 { SO_EXCLBIND, SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
+{ SO_REUSEPORT, SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
 
 { SO_DOMAIN,	SOL_SOCKET, OA_R, OA_R, OP_NP, 0, sizeof (int), 0 },
 
@@ -139,6 +140,12 @@ opdes_t	tcp_opt_arr[] = {
 
 { TCP_LINGER2, IPPROTO_TCP, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
 
+{ TCP_CONGESTION, IPPROTO_TCP, OA_RW, OA_RW, OP_NP,
+	(OP_VARLEN|OP_NODEFAULT), TCP_CA_NAME_MAX, -1 /* not initialized */ },
+
+{ TCP_TLS_TX, IPPROTO_TCP, OA_W, OA_W, OP_NP, OP_NODEFAULT,
+	sizeof (tcp_tls_info_t), -1 /* not initialized */ },
+
 { IP_OPTIONS,	IPPROTO_IP, OA_RW, OA_RW, OP_NP,
 	(OP_VARLEN|OP_NODEFAULT),
 	IP_MAX_OPT_LENGTH + IP_ADDR_LEN, -1 /* not initialized */ },
@@ -446,6 +453,11 @@ tcp_opt_get(conn_t *connp, int level, int name, uchar_t *ptr)
 		case TCP_LINGER2:
 			*i1 = tcp->tcp_fin_wait_2_flush_interval / SECONDS;
 			return (sizeof (int));
+		case TCP_CONGESTION:
+			/* Caller ensures enough space */
+			(void) strlcpy((char *)ptr, tcp->tcp_cc->tcc_name,
+			    TCP_CA_NAME_MAX);
+			return (strlen((char *)ptr) + 1);
 		}
 		break;
 	case IPPROTO_IP:
@@ -948,6 +960,32 @@ tcp_opt_set(conn_t *connp, uint_t optset_context, int level, int name,
 			}
 			tcp->tcp_fin_wait_2_flush_interval = *i1 * SECONDS;
 			break;
+		case TCP_CONGESTION: {
+			char		name[TCP_CA_NAME_MAX];
+			size_t		len = MIN(inlen, sizeof (name) - 1);
+			tcp_cc_ops_t	*cc;
+
+			/* The name need not be NUL terminated. */
+			bcopy(invalp, name, len);
+			name[len] = '\0';
+			if ((cc = tcp_cc_lookup(name)) == NULL) {
+				*outlenp = 0;
+				return (ENOENT);
+			}
+			if (checkonly)
+				tcp_cc_rele(cc);
+			else
+				tcp_cc_attach(tcp, cc);
+			break;
+		}
+		case TCP_TLS_TX:
+			reterr = tcp_tls_set(tcp, (tcp_tls_info_t *)invalp,
+			    checkonly);
+			if (reterr != 0) {
+				*outlenp = 0;
+				return (reterr);
+			}
+			break;
 		default:
 			break;
 		}
@@ -59,8 +59,6 @@ static void	tcp_wput_iocdata(tcp_t *tcp, mblk_t *mp);
 static int	tcp_xmit_end(tcp_t *);
 static int	tcp_send(tcp_t *, const int, const int, const int,
 		    const int, int *, uint_t *, int *, mblk_t **, mblk_t *);
-static void	tcp_xmit_early_reset(char *, mblk_t *, uint32_t, uint32_t,
-		    int, ip_recv_attr_t *, ip_stack_t *, conn_t *);
 static boolean_t	tcp_send_rst_chk(tcp_stack_t *);
 static void	tcp_process_shrunk_swnd(tcp_t *, uint32_t);
 static void	tcp_fill_header(tcp_t *, uchar_t *, clock_t, int);
@@ -917,6 +915,12 @@ tcp_wput_proto(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *dummy)
 			goto non_urgent_data;
 		} else {
 			/* TODO: options, flags, ... from user */
+			if (tcp->tcp_tls != NULL && mp->b_cont != NULL &&
+			    (mp->b_cont = tcp_tls_output(tcp,
+			    mp->b_cont)) == NULL) {
+				freeb(mp);
+				return;
+			}
 			/* Set length to zero for reclamation below */
 			tcp_wput_data(tcp, mp->b_cont, B_TRUE);
 			freeb(mp);
@@ -1118,6 +1122,13 @@ tcp_output(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *dummy)
 	tcp->tcp_squeue_bytes -= msize;
 	mutex_exit(&tcp->tcp_non_sq_lock);
 
+	/* Frame the data into TLS records before it is queued anywhere */
+	if (tcp->tcp_tls != NULL) {
+		if ((mp = tcp_tls_output(tcp, mp)) == NULL)
+			return;
+		msize = msgdsize(mp);
+	}
+
 	/* Bypass tcp protocol for fused tcp loopback */
 	if (tcp->tcp_fused && tcp_fuse_output(tcp, mp, msize))
 		return;
@@ -1185,12 +1196,13 @@ tcp_output(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *dummy)
 	 * start again to get back the connection's "self-clock" as
 	 * described in VJ's paper.
 	 *
-	 * Reinitialize tcp_cwnd after idle.
+	 * Let the congestion control algorithm reinitialize tcp_cwnd after
+	 * idle.
 	 */
 	now = LBOLT_FASTPATH;
 	if ((tcp->tcp_suna == snxt) && !tcp->tcp_localnet &&
 	    (TICK_TO_MSEC(now - tcp->tcp_last_recv_time) >= tcp->tcp_rto)) {
-		TCP_SET_INIT_CWND(tcp, mss, tcps->tcps_slow_start_after_idle);
+		tcp->tcp_cc->tcc_idle(tcp);
 	}
 
 	usable = tcp->tcp_swnd;		/* tcp window size */
@@ -1388,6 +1400,23 @@ tcp_output_urgent(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *dummy)
 	conn_t *connp = (conn_t *)arg;
 	tcp_t *tcp = connp->conn_tcp;
 
+	/*
+	 * With kernel TLS the urgent offset must point into the records,
+	 * so encrypt first, stripping any T_EXDATA_REQ.
+	 */
+	if (tcp->tcp_tls != NULL) {
+		if (DB_TYPE(mp) != M_DATA) {
+			mblk_t *mp1 = mp;
+
+			mp = mp->b_cont;
+			freeb(mp1);
+			if (mp == NULL)
+				return;
+		}
+		if ((mp = tcp_tls_output(tcp, mp)) == NULL)
+			return;
+	}
+
 	msize = msgdsize(mp);
 
 	len = msize - 1;
@@ -2433,14 +2462,20 @@ tcp_xmit_ctl(char *str, tcp_t *tcp, uint32_t seq, uint32_t ack, int ctl)
  * when RST is in response to an unexpected inbound packet for which
  * there is active tcp state in the system.
  *
+ * A compact TIME_WAIT entry, which has no conn_t to build its segments from,
+ * also uses this to send ACKs.  win is the (scaled) window to advertise and,
+ * if tsecr is not NULL, a timestamp option is added with it as the echo
+ * reply.
+ *
  * IPSEC NOTE : Try to send the reply with the same protection as it came
  * in.  We have the ip_recv_attr_t which is reversed to form the ip_xmit_attr_t.
  * That way the packet will go out at the same level of protection as it
  * came in with.
  */
-static void
-tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
-    ip_recv_attr_t *ira, ip_stack_t *ipst, conn_t *connp)
+void
+tcp_xmit_early_ctl(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
+    uint32_t win, const uint32_t *tsecr, ip_recv_attr_t *ira, ip_stack_t *ipst,
+    conn_t *connp)
 {
 	ipha_t		*ipha = NULL;
 	ip6_t		*ip6h = NULL;
@@ -2455,8 +2490,9 @@ tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
 	uint_t		ip_hdr_len = ira->ira_ip_hdr_length;
 	boolean_t	need_refrele = B_FALSE;		/* ixa_refrele(ixa) */
 	ushort_t	port;
+	uint_t		optlen = (tsecr != NULL) ? TCPOPT_REAL_TS_LEN : 0;
 
-	if (!tcp_send_rst_chk(tcps)) {
+	if ((ctl & TH_RST) && !tcp_send_rst_chk(tcps)) {
 		TCP_STAT(tcps, tcp_rst_unsent);
 		freemsg(mp);
 		return;
@@ -2498,7 +2534,7 @@ tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
 
 	if (str && tcps->tcps_dbg) {
 		(void) strlog(TCP_MOD_ID, 0, 1, SL_TRACE,
-		    "tcp_xmit_early_reset: '%s', seq 0x%x, ack 0x%x, "
+		    "tcp_xmit_early_ctl: '%s', seq 0x%x, ack 0x%x, "
 		    "flags 0x%x",
 		    str, seq, ack, ctl);
 	}
@@ -2564,9 +2600,23 @@ tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
 		freemsg(mp);
 		goto done;
 	}
-	tcpha->tha_offset_and_reserved = (5 << 4);
-	len = ip_hdr_len + sizeof (tcpha_t);
+	len = ip_hdr_len + sizeof (tcpha_t) + optlen;
+	if (mp->b_datap->db_lim - mp->b_rptr < len) {
+		freemsg(mp);
+		goto done;
+	}
+	tcpha->tha_offset_and_reserved = ((5 + optlen / 4) << 4);
 	mp->b_wptr = &mp->b_rptr[len];
+	if (optlen != 0) {
+		uint8_t	*opt = (uint8_t *)(tcpha + 1);
+
+		opt[0] = TCPOPT_NOP;
+		opt[1] = TCPOPT_NOP;
+		opt[2] = TCPOPT_TSTAMP;
+		opt[3] = TCPOPT_TSTAMP_LEN;
+		U32_TO_BE32((uint32_t)LBOLT_FASTPATH, opt + 4);
+		U32_TO_BE32(*tsecr, opt + 8);
+	}
 	if (IPH_HDR_VERSION(mp->b_rptr) == IPV4_VERSION) {
 		ipha->ipha_length = htons(len);
 		/* Swap addresses */
@@ -2601,8 +2651,8 @@ tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
 
 	tcpha->tha_ack = htonl(ack);
 	tcpha->tha_seq = htonl(seq);
-	tcpha->tha_win = 0;
-	tcpha->tha_sum = htons(sizeof (tcpha_t));
+	tcpha->tha_win = htons(win);
+	tcpha->tha_sum = htons(sizeof (tcpha_t) + optlen);
 	tcpha->tha_flags = (uint8_t)ctl;
 	if (ctl & TH_RST) {
 		if (ctl & TH_ACK) {
@@ -2622,6 +2672,8 @@ tcp_xmit_early_reset(char *str, mblk_t *mp, uint32_t seq, uint32_t ack, int ctl,
 		}
 		TCPS_BUMP_MIB(tcps, tcpOutRsts);
 		TCPS_BUMP_MIB(tcps, tcpOutControl);
+	} else if (ctl & TH_ACK) {
+		TCPS_BUMP_MIB(tcps, tcpOutAck);
 	}
 
 	/* Discard any old label */
@@ -2734,6 +2786,10 @@ tcp_xmit_listeners_reset(mblk_t *mp, ip_recv_attr_t *ira, ip_stack_t *ipst,
 		return;
 	}
 
+	/* The segment may belong to a compact TIME_WAIT entry. */
+	if (tcps->tcps_tw_cnt != 0 && tcp_time_wait_input(tcps, mp, ira))
+		return;
+
 	rptr = mp->b_rptr;
 
 	tcpha = (tcpha_t *)&rptr[ip_hdr_len];
@@ -2745,8 +2801,8 @@ tcp_xmit_listeners_reset(mblk_t *mp, ip_recv_attr_t *ira, ip_stack_t *ipst,
 	if (flags & TH_RST) {
 		freemsg(mp);
 	} else if (flags & TH_ACK) {
-		tcp_xmit_early_reset("no tcp, reset", mp, seg_ack, 0, TH_RST,
-		    ira, ipst, connp);
+		tcp_xmit_early_ctl("no tcp, reset", mp, seg_ack, 0, TH_RST,
+		    0, NULL, ira, ipst, connp);
 	} else {
 		if (flags & TH_SYN) {
 			seg_len++;
@@ -2763,8 +2819,9 @@ tcp_xmit_listeners_reset(mblk_t *mp, ip_recv_attr_t *ira, ip_stack_t *ipst,
 			return;
 		}
 
-		tcp_xmit_early_reset("no tcp, reset/ack", mp, 0,
-		    seg_seq + seg_len, TH_RST | TH_ACK, ira, ipst, connp);
+		tcp_xmit_early_ctl("no tcp, reset/ack", mp, 0,
+		    seg_seq + seg_len, TH_RST | TH_ACK, 0, NULL, ira, ipst,
+		    connp);
 	}
 }
 
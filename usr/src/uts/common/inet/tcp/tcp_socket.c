@@ -69,6 +69,7 @@ static void	tcp_clr_flowctrl(sock_lower_handle_t);
 static int	tcp_ioctl(sock_lower_handle_t, int, intptr_t, int, int32_t *,
 		    cred_t *);
 static int	tcp_close(sock_lower_handle_t, int, cred_t *);
+static void	tcp_recv_cpu(sock_lower_handle_t, processorid_t);
 
 sock_downcalls_t sock_tcp_downcalls = {
 	tcp_activate,
@@ -88,6 +89,7 @@ sock_downcalls_t sock_tcp_downcalls = {
 	tcp_clr_flowctrl,
 	tcp_ioctl,
 	tcp_close,
+	tcp_recv_cpu,
 };
 
 /* ARGSUSED */
@@ -648,6 +650,19 @@ tcp_clr_flowctrl(sock_lower_handle_t proto_handle)
 	squeue_synch_exit(connp);
 }
 
+/*
+ * sockfs is about to read from the socket on the given CPU.  Note it for
+ * tcp_rx_steer(); this is only a hint, so it is updated outside the squeue.
+ */
+static void
+tcp_recv_cpu(sock_lower_handle_t proto_handle, processorid_t cpuid)
+{
+	tcp_t	*tcp = ((conn_t *)proto_handle)->conn_tcp;
+
+	if (tcp->tcp_rx_cpu != cpuid)
+		tcp->tcp_rx_cpu = cpuid;
+}
+
 /* ARGSUSED */
 static int
 tcp_ioctl(sock_lower_handle_t proto_handle, int cmd, intptr_t arg,
@@ -728,6 +728,11 @@ tcp_kstat2_init(netstackid_t stackid)
 		{ "tcp_rst_unsent",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_reclaim_cnt",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_reass_timeout",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_rx_steer",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_reuse",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_tls_records",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_tls_encrypt_fail",	KSTAT_DATA_UINT64, 0 },
 #ifdef TCP_DEBUG_COUNTER
 		{ "tcp_time_wait",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_rput_time_wait",		KSTAT_DATA_UINT64, 0 },
@@ -935,6 +940,11 @@ tcp_clr_stats(tcp_stat_t *stats)
 	stats->tcp_rst_unsent.value.ui64 = 0;
 	stats->tcp_reclaim_cnt.value.ui64 = 0;
 	stats->tcp_reass_timeout.value.ui64 = 0;
+	stats->tcp_rx_steer.value.ui64 = 0;
+	stats->tcp_time_wait_compact.value.ui64 = 0;
+	stats->tcp_time_wait_reuse.value.ui64 = 0;
+	stats->tcp_tls_records.value.ui64 = 0;
+	stats->tcp_tls_encrypt_fail.value.ui64 = 0;
 
 #ifdef TCP_DEBUG_COUNTER
 	stats->tcp_time_wait.value.ui64 = 0;
@@ -1031,6 +1041,16 @@ tcp_add_stats(tcp_stat_counter_t *from, tcp_stat_t *to)
 	    from->tcp_reclaim_cnt;
 	to->tcp_reass_timeout.value.ui64 +=
 	    from->tcp_reass_timeout;
+	to->tcp_rx_steer.value.ui64 +=
+	    from->tcp_rx_steer;
+	to->tcp_time_wait_compact.value.ui64 +=
+	    from->tcp_time_wait_compact;
+	to->tcp_time_wait_reuse.value.ui64 +=
+	    from->tcp_time_wait_reuse;
+	to->tcp_tls_records.value.ui64 +=
+	    from->tcp_tls_records;
+	to->tcp_tls_encrypt_fail.value.ui64 +=
+	    from->tcp_tls_encrypt_fail;
 
 #ifdef TCP_DEBUG_COUNTER
 	to->tcp_time_wait.value.ui64 +=
@@ -25,8 +25,9 @@
  */
 
 /*
- * This file contains functions related to TCP time wait processing.  Also
- * refer to the time wait handling comments in tcp_impl.h.
+ * This file contains functions related to TCP time wait processing,
+ * including the compact TIME_WAIT entries (tcp_tw_t).  Also refer to the
+ * time wait handling comments in tcp_impl.h.
  */
 
 #include <sys/types.h>
@@ -42,12 +43,25 @@
 #include <inet/tcp_cluster.h>
 
 static void tcp_time_wait_purge(tcp_t *, tcp_squeue_priv_t *);
+static boolean_t tcp_tw_create(tcp_t *, squeue_t *, tcp_squeue_priv_t *);
 
 #define	TW_BUCKET(t)					\
 	(((t) / MSEC_TO_TICK(TCP_TIME_WAIT_DELAY)) % TCP_TIME_WAIT_BUCKETS)
 
 #define	TW_BUCKET_NEXT(b)	(((b) + 1) % TCP_TIME_WAIT_BUCKETS)
 
+/* The tcps_tw_fanout bucket, hashed as IPCL_CONN_HASH() does */
+#define	TW_FANOUT(tcps, faddr, ports)					\
+	(&(tcps)->tcps_tw_fanout[(ntohl(V4_PART_OF_V6((faddr))) ^	\
+	((ports) >> 24) ^ ((ports) >> 16) ^ ((ports) >> 8) ^ (ports)) %	\
+	(tcps)->tcps_tw_fanout_size])
+
+#define	TW_TSP(tw)							\
+	(*((tcp_squeue_priv_t **)squeue_getprivate((tw)->tw_sqp,	\
+	SQPRIVATE_TCP)))
+
+static kmem_cache_t	*tcp_tw_cache;
+
 
 /*
  * Remove a connection from the list of detached TIME_WAIT connections.
@@ -122,52 +136,15 @@ tcp_time_wait_remove(tcp_t *tcp, tcp_squeue_priv_t *tsp)
 
 
 /*
- * Add a connection to the list of detached TIME_WAIT connections
- * and set its time to expire.
+ * Return the current time on the squeue's timing wheel.  The wheel's offset
+ * is (re)initialized here if nothing is waiting to expire.
  */
-void
-tcp_time_wait_append(tcp_t *tcp)
+static int64_t
+tcp_time_wait_now(tcp_squeue_priv_t *tsp)
 {
-	tcp_stack_t	*tcps = tcp->tcp_tcps;
-	squeue_t	*sqp = tcp->tcp_connp->conn_sqp;
-	tcp_squeue_priv_t *tsp =
-	    *((tcp_squeue_priv_t **)squeue_getprivate(sqp, SQPRIVATE_TCP));
-	int64_t		now, schedule;
-	unsigned int	bucket;
-
-	tcp_timers_stop(tcp);
+	int64_t		now;
 
-	/* Freed above */
-	ASSERT(tcp->tcp_timer_tid == 0);
-	ASSERT(tcp->tcp_ack_tid == 0);
-
-	/* must have happened at the time of detaching the tcp */
-	ASSERT(TCP_IS_DETACHED(tcp));
-	ASSERT(tcp->tcp_state == TCPS_TIME_WAIT);
-	ASSERT(tcp->tcp_ptpahn == NULL);
-	ASSERT(tcp->tcp_flow_stopped == 0);
-	ASSERT(tcp->tcp_time_wait_next == NULL);
-	ASSERT(tcp->tcp_time_wait_prev == NULL);
-	ASSERT(tcp->tcp_time_wait_expire == 0);
-	ASSERT(tcp->tcp_listener == NULL);
-
-	TCP_DBGSTAT(tcps, tcp_time_wait);
-	mutex_enter(&tsp->tcp_time_wait_lock);
-
-	/*
-	 * Immediately expire loopback connections.  Since there is no worry
-	 * about packets on the local host showing up after a long network
-	 * delay, this is safe and allows much higher rates of connection churn
-	 * for applications operating locally.
-	 *
-	 * This typically bypasses the tcp_free_list fast path due to squeue
-	 * re-entry for the loopback close operation.
-	 */
-	if (tcp->tcp_loopback) {
-		tcp_time_wait_purge(tcp, tsp);
-		mutex_exit(&tsp->tcp_time_wait_lock);
-		return;
-	}
+	ASSERT(MUTEX_HELD(&tsp->tcp_time_wait_lock));
 
 	/*
 	 * In order to reap TIME_WAITs reliably, we should use a source of time
@@ -190,26 +167,19 @@ tcp_time_wait_append(tcp_t *tcp)
 		tsp->tcp_time_wait_offset =
 		    now % MSEC_TO_TICK(TCP_TIME_WAIT_DELAY);
 	}
-	now -= tsp->tcp_time_wait_offset;
-
-	/*
-	 * Use the netstack-defined timeout, rounded up to the minimum
-	 * time_wait_collector interval.
-	 */
-	schedule = now + MSEC_TO_TICK(tcps->tcps_time_wait_interval);
-	tcp->tcp_time_wait_expire = schedule;
+	return (now - tsp->tcp_time_wait_offset);
+}
 
-	/*
-	 * Append the connection into the appropriate bucket.
-	 */
-	bucket = TW_BUCKET(tcp->tcp_time_wait_expire);
-	tcp->tcp_time_wait_next = tsp->tcp_time_wait_bucket[bucket];
-	tsp->tcp_time_wait_bucket[bucket] = tcp;
-	if (tcp->tcp_time_wait_next != NULL) {
-		ASSERT(tcp->tcp_time_wait_next->tcp_time_wait_prev == NULL);
-		tcp->tcp_time_wait_next->tcp_time_wait_prev = tcp;
-	}
-	tsp->tcp_time_wait_cnt++;
+/*
+ * An entry expiring at schedule has just been put on one of the squeue's
+ * wheels; make sure that the collector will run for it.  Drops
+ * tcp_time_wait_lock.
+ */
+static void
+tcp_time_wait_schedule(tcp_squeue_priv_t *tsp, squeue_t *sqp, int64_t now,
+    int64_t schedule)
+{
+	ASSERT(MUTEX_HELD(&tsp->tcp_time_wait_lock));
 
 	/*
 	 * Round delay up to the nearest bucket boundary.
@@ -259,6 +229,84 @@ tcp_time_wait_append(tcp_t *tcp)
 	mutex_exit(&tsp->tcp_time_wait_lock);
 }
 
+/*
+ * Add a connection to the list of detached TIME_WAIT connections
+ * and set its time to expire.
+ */
+void
+tcp_time_wait_append(tcp_t *tcp)
+{
+	tcp_stack_t	*tcps = tcp->tcp_tcps;
+	squeue_t	*sqp = tcp->tcp_connp->conn_sqp;
+	tcp_squeue_priv_t *tsp =
+	    *((tcp_squeue_priv_t **)squeue_getprivate(sqp, SQPRIVATE_TCP));
+	int64_t		now, schedule;
+	unsigned int	bucket;
+
+	tcp_timers_stop(tcp);
+
+	/* Freed above */
+	ASSERT(tcp->tcp_timer_tid == 0);
+	ASSERT(tcp->tcp_ack_tid == 0);
+
+	/* must have happened at the time of detaching the tcp */
+	ASSERT(TCP_IS_DETACHED(tcp));
+	ASSERT(tcp->tcp_state == TCPS_TIME_WAIT);
+	ASSERT(tcp->tcp_ptpahn == NULL);
+	ASSERT(tcp->tcp_flow_stopped == 0);
+	ASSERT(tcp->tcp_time_wait_next == NULL);
+	ASSERT(tcp->tcp_time_wait_prev == NULL);
+	ASSERT(tcp->tcp_time_wait_expire == 0);
+	ASSERT(tcp->tcp_listener == NULL);
+
+	TCP_DBGSTAT(tcps, tcp_time_wait);
+
+	/* Keep only a tcp_tw_t if we can; see tcp_tw_create(). */
+	if (tcps->tcps_time_wait_compact && !tcp->tcp_loopback &&
+	    tcp_tw_create(tcp, sqp, tsp))
+		return;
+
+	mutex_enter(&tsp->tcp_time_wait_lock);
+
+	/*
+	 * Immediately expire loopback connections.  Since there is no worry
+	 * about packets on the local host showing up after a long network
+	 * delay, this is safe and allows much higher rates of connection churn
+	 * for applications operating locally.
+	 *
+	 * This typically bypasses the tcp_free_list fast path due to squeue
+	 * re-entry for the loopback close operation.
+	 */
+	if (tcp->tcp_loopback) {
+		tcp_time_wait_purge(tcp, tsp);
+		mutex_exit(&tsp->tcp_time_wait_lock);
+		return;
+	}
+
+	now = tcp_time_wait_now(tsp);
+
+	/*
+	 * Use the netstack-defined timeout, rounded up to the minimum
+	 * time_wait_collector interval.
+	 */
+	schedule = now + MSEC_TO_TICK(tcps->tcps_time_wait_interval);
+	tcp->tcp_time_wait_expire = schedule;
+
+	/*
+	 * Append the connection into the appropriate bucket.
+	 */
+	bucket = TW_BUCKET(tcp->tcp_time_wait_expire);
+	tcp->tcp_time_wait_next = tsp->tcp_time_wait_bucket[bucket];
+	tsp->tcp_time_wait_bucket[bucket] = tcp;
+	if (tcp->tcp_time_wait_next != NULL) {
+		ASSERT(tcp->tcp_time_wait_next->tcp_time_wait_prev == NULL);
+		tcp->tcp_time_wait_next->tcp_time_wait_prev = tcp;
+	}
+	tsp->tcp_time_wait_cnt++;
+
+	tcp_time_wait_schedule(tsp, sqp, now, schedule);
+}
+
 /*
  * Wrapper to call tcp_close_detached() via squeue to clean up TIME-WAIT
  * tcp_t.  Used in tcp_time_wait_collector().
@@ -392,9 +440,246 @@ tcp_time_wait_purge(tcp_t *tcp, tcp_squeue_priv_t *tsp)
 	mutex_enter(&tsp->tcp_time_wait_lock);
 }
 
+static void
+tcp_tw_free(tcp_tw_t *tw)
+{
+	ASSERT(!tw->tw_hashed);
+	ASSERT(tw->tw_expire == 0);
+
+	netstack_rele(tw->tw_tcps->tcps_netstack);
+	kmem_cache_free(tcp_tw_cache, tw);
+}
+
+static void
+tcp_tw_wheel_insert(tcp_squeue_priv_t *tsp, tcp_tw_t *tw, int64_t expire)
+{
+	unsigned int	bucket = TW_BUCKET(expire);
+
+	ASSERT(MUTEX_HELD(&tsp->tcp_time_wait_lock));
+	ASSERT(tw->tw_expire == 0);
+
+	tw->tw_expire = expire;
+	tw->tw_prev = NULL;
+	tw->tw_next = tsp->tcp_tw_bucket[bucket];
+	if (tw->tw_next != NULL)
+		tw->tw_next->tw_prev = tw;
+	tsp->tcp_tw_bucket[bucket] = tw;
+	tsp->tcp_time_wait_cnt++;
+}
+
+static void
+tcp_tw_wheel_remove(tcp_squeue_priv_t *tsp, tcp_tw_t *tw)
+{
+	ASSERT(MUTEX_HELD(&tsp->tcp_time_wait_lock));
+	ASSERT(tw->tw_expire != 0);
+	ASSERT(tsp->tcp_time_wait_cnt > 0);
+
+	if (tw->tw_next != NULL)
+		tw->tw_next->tw_prev = tw->tw_prev;
+	if (tw->tw_prev != NULL) {
+		tw->tw_prev->tw_next = tw->tw_next;
+	} else {
+		unsigned int bucket = TW_BUCKET(tw->tw_expire);
+
+		ASSERT(tsp->tcp_tw_bucket[bucket] == tw);
+		tsp->tcp_tw_bucket[bucket] = tw->tw_next;
+	}
+	tw->tw_next = NULL;
+	tw->tw_prev = NULL;
+	tw->tw_expire = 0;
+	tsp->tcp_time_wait_cnt--;
+}
+
+static void
+tcp_tw_unhash(tcp_tw_t *tw, tcp_tw_fanout_t *twf)
+{
+	tcp_tw_t	**twp;
+
+	ASSERT(MUTEX_HELD(&twf->twf_lock));
+	ASSERT(tw->tw_hashed);
+
+	for (twp = &twf->twf_head; *twp != tw; twp = &(*twp)->tw_hash_next)
+		ASSERT(*twp != NULL);
+	*twp = tw->tw_hash_next;
+	tw->tw_hash_next = NULL;
+	tw->tw_hashed = B_FALSE;
+	atomic_dec_32(&tw->tw_tcps->tcps_tw_cnt);
+}
+
+/*
+ * End the TIME_WAIT of an entry found in the hash.  Returns B_TRUE if the
+ * caller is to free the entry, which it must do after dropping twf_lock;
+ * otherwise the collector already has it.
+ */
+static boolean_t
+tcp_tw_kill(tcp_tw_t *tw, tcp_tw_fanout_t *twf)
+{
+	tcp_squeue_priv_t *tsp = TW_TSP(tw);
+	boolean_t	mine;
+
+	tcp_tw_unhash(tw, twf);
+	mutex_enter(&tsp->tcp_time_wait_lock);
+	if ((mine = (tw->tw_expire != 0)))
+		tcp_tw_wheel_remove(tsp, tw);
+	mutex_exit(&tsp->tcp_time_wait_lock);
+	return (mine);
+}
+
+/*
+ * Restart the TIME_WAIT interval of an entry found in the hash, as for a
+ * duplicate FIN.  The collector's timer is left alone: it is already due no
+ * later than any of the entries of this stack, and the collector looks for
+ * the next non-empty bucket each time it runs.
+ */
+static void
+tcp_tw_restart(tcp_tw_t *tw)
+{
+	tcp_squeue_priv_t *tsp = TW_TSP(tw);
+	int64_t		expire;
+
+	mutex_enter(&tsp->tcp_time_wait_lock);
+	if (tw->tw_expire != 0) {
+		tcp_tw_wheel_remove(tsp, tw);
+		expire = ddi_get_lbolt64() - tsp->tcp_time_wait_offset +
+		    MSEC_TO_TICK(tw->tw_tcps->tcps_time_wait_interval);
+		tcp_tw_wheel_insert(tsp, tw, expire);
+	}
+	mutex_exit(&tsp->tcp_time_wait_lock);
+}
+
+/*
+ * Free the expired compact entries of a bucket.  They are taken off the
+ * wheel first, then off the hash once tcp_time_wait_lock has been dropped.
+ */
+static void
+tcp_tw_collect(tcp_squeue_priv_t *tsp, unsigned int idx, int64_t now)
+{
+	tcp_tw_t	*tw, *expired = NULL;
+	tcp_tw_fanout_t	*twf;
+
+	ASSERT(MUTEX_HELD(&tsp->tcp_time_wait_lock));
+
+	/* As for tcp_t entries, stop at the first one expiring later. */
+	while ((tw = tsp->tcp_tw_bucket[idx]) != NULL &&
+	    now >= tw->tw_expire) {
+		tcp_tw_wheel_remove(tsp, tw);
+		tw->tw_next = expired;
+		expired = tw;
+	}
+	if (expired == NULL)
+		return;
+
+	mutex_exit(&tsp->tcp_time_wait_lock);
+	while ((tw = expired) != NULL) {
+		expired = tw->tw_next;
+		tw->tw_next = NULL;
+
+		twf = TW_FANOUT(tw->tw_tcps, tw->tw_faddr, tw->tw_ports);
+		mutex_enter(&twf->twf_lock);
+		if (tw->tw_hashed)
+			tcp_tw_unhash(tw, twf);
+		mutex_exit(&twf->twf_lock);
+		tcp_tw_free(tw);
+	}
+	mutex_enter(&tsp->tcp_time_wait_lock);
+}
+
+static tcp_tw_t *
+tcp_tw_lookup(tcp_tw_fanout_t *twf, const in6_addr_t *laddr,
+    const in6_addr_t *faddr, uint32_t ports, zoneid_t zoneid)
+{
+	tcp_tw_t	*tw;
+
+	ASSERT(MUTEX_HELD(&twf->twf_lock));
+	for (tw = twf->twf_head; tw != NULL; tw = tw->tw_hash_next) {
+		if (tw->tw_ports == ports &&
+		    IN6_ARE_ADDR_EQUAL(&tw->tw_faddr, faddr) &&
+		    IN6_ARE_ADDR_EQUAL(&tw->tw_laddr, laddr) &&
+		    (zoneid == ALL_ZONES || tw->tw_zoneid == zoneid))
+			return (tw);
+	}
+	return (NULL);
+}
+
+/*
+ * Replace a detached TIME_WAIT connection with a tcp_tw_t, and release the
+ * connection.  Only connections which use timestamps are converted, so that
+ * PAWS protects a new connection which takes over the 4-tuple.  Those that
+ * need more than the 4-tuple to answer a segment (IPsec, labels, IP_NEXTHOP,
+ * SO_ALLZONES, clustering) keep their conn_t.  Returns B_FALSE if the
+ * connection was not converted.
+ */
+static boolean_t
+tcp_tw_create(tcp_t *tcp, squeue_t *sqp, tcp_squeue_priv_t *tsp)
+{
+	conn_t		*connp = tcp->tcp_connp;
+	tcp_stack_t	*tcps = tcp->tcp_tcps;
+	tcp_tw_fanout_t	*twf;
+	tcp_tw_t	*tw;
+	int64_t		now, schedule;
+
+	if (!tcp->tcp_snd_ts_ok || cl_inet_disconnect != NULL ||
+	    is_system_labeled() || connp->conn_policy != NULL ||
+	    connp->conn_latch != NULL || connp->conn_in_enforce_policy ||
+	    connp->conn_out_enforce_policy || connp->conn_allzones ||
+	    (connp->conn_ixa->ixa_flags & IXAF_NEXTHOP_SET))
+		return (B_FALSE);
+
+	if ((tw = kmem_cache_alloc(tcp_tw_cache, KM_NOSLEEP)) == NULL)
+		return (B_FALSE);
+
+	tw->tw_next = NULL;
+	tw->tw_prev = NULL;
+	tw->tw_expire = 0;
+	tw->tw_tcps = tcps;
+	tw->tw_sqp = sqp;
+	tw->tw_laddr = connp->conn_laddr_v6;
+	tw->tw_faddr = connp->conn_faddr_v6;
+	tw->tw_ports = connp->conn_ports;
+	tw->tw_zoneid = connp->conn_zoneid;
+	tw->tw_snxt = tcp->tcp_snxt;
+	tw->tw_rnxt = tcp->tcp_rnxt;
+	tw->tw_rwnd = tcp->tcp_rwnd;
+	tw->tw_ts_recent = tcp->tcp_ts_recent;
+	tw->tw_last_rcv_lbolt = tcp->tcp_last_rcv_lbolt;
+	tw->tw_rcv_ws = tcp->tcp_rcv_ws;
+	tw->tw_ipversion = connp->conn_ipversion;
+	netstack_hold(tcps->tcps_netstack);
+
+	/*
+	 * The entry goes into the hash before it is on the wheel.  Should it
+	 * be killed in between, tw_expire is still 0 and it is left for the
+	 * collector, which frees it when it expires.
+	 */
+	twf = TW_FANOUT(tcps, tw->tw_faddr, tw->tw_ports);
+	mutex_enter(&twf->twf_lock);
+	tw->tw_hash_next = twf->twf_head;
+	twf->twf_head = tw;
+	tw->tw_hashed = B_TRUE;
+	atomic_inc_32(&tcps->tcps_tw_cnt);
+	mutex_exit(&twf->twf_lock);
+
+	mutex_enter(&tsp->tcp_time_wait_lock);
+	now = tcp_time_wait_now(tsp);
+	schedule = now + MSEC_TO_TICK(tcps->tcps_time_wait_interval);
+	tcp_tw_wheel_insert(tsp, tw, schedule);
+	tcp_time_wait_schedule(tsp, sqp, now, schedule);
+
+	TCP_STAT(tcps, tcp_time_wait_compact);
+
+	/*
+	 * The connection is closed on its squeue once the caller is done
+	 * with it, as for a loopback connection.
+	 */
+	mutex_enter(&tsp->tcp_time_wait_lock);
+	tcp_time_wait_purge(tcp, tsp);
+	mutex_exit(&tsp->tcp_time_wait_lock);
+	return (B_TRUE);
+}
+
 /*
- * Purge any tcp_t instances associated with this squeue which have expired
- * from the TIME_WAIT state.
+ * Purge any tcp_t instances, and any compact entries, associated with this
+ * squeue which have expired from the TIME_WAIT state.
  */
 void
 tcp_time_wait_collector(void *arg)
@@ -511,6 +796,12 @@ retry:
 		tcp = tsp->tcp_time_wait_bucket[idx];
 	}
 
+	/*
+	 * Then the compact entries in the same bucket.
+	 */
+	if (tsp->tcp_tw_bucket[idx] != NULL)
+		tcp_tw_collect(tsp, idx, now);
+
 	if (tsp->tcp_time_wait_cnt == 0) {
 		/*
 		 * There is not a need for the collector to schedule a new
@@ -534,14 +825,16 @@ retry:
 		 */
 		sched_new = sched_cur + MSEC_TO_TICK(TCP_TIME_WAIT_DELAY);
 		nidx = TW_BUCKET_NEXT(idx);
-		while (tsp->tcp_time_wait_bucket[nidx] == NULL) {
+		while (tsp->tcp_time_wait_bucket[nidx] == NULL &&
+		    tsp->tcp_tw_bucket[nidx] == NULL) {
 			if (nidx == idx) {
 				break;
 			}
 			nidx = TW_BUCKET_NEXT(nidx);
 			sched_new += MSEC_TO_TICK(TCP_TIME_WAIT_DELAY);
 		}
-		ASSERT(tsp->tcp_time_wait_bucket[nidx] != NULL);
+		ASSERT(tsp->tcp_time_wait_bucket[nidx] != NULL ||
+		    tsp->tcp_tw_bucket[nidx] != NULL);
 	}
 
 	/*
@@ -586,6 +879,67 @@ retry:
 	mutex_exit(&tsp->tcp_time_wait_lock);
 }
 
+/*
+ * A SYN is about to be accepted for the 4-tuple of a connection in
+ * TIME_WAIT, whose tcp_snxt is snxt.  Make sure that the new connection
+ * picks an ISS greater than (snxt + tcp_iss_incr/2).
+ *
+ * The next ISS generated is equal to tcp_iss_incr_extra + tcp_iss_incr/2 +
+ * other components depending on the value of tcp_strong_iss.  We
+ * pre-calculate the new ISS here and compare with snxt to determine if we
+ * need to make adjustment to tcp_iss_incr_extra.
+ *
+ * The above calculation is ugly and is a waste of CPU cycles...
+ */
+static void
+tcp_time_wait_iss_adjust(tcp_stack_t *tcps, uint32_t snxt, uint32_t ports,
+    const in6_addr_t *laddr, const in6_addr_t *faddr)
+{
+	uint32_t new_iss = tcps->tcps_iss_incr_extra;
+	int32_t adj;
+
+	switch (tcps->tcps_strong_iss) {
+	case 2: {
+		/* Add time and MD5 components. */
+		uint32_t answer[4];
+		struct {
+			uint32_t ports;
+			in6_addr_t src;
+			in6_addr_t dst;
+		} arg;
+		MD5_CTX context;
+
+		mutex_enter(&tcps->tcps_iss_key_lock);
+		context = tcps->tcps_iss_key;
+		mutex_exit(&tcps->tcps_iss_key_lock);
+		arg.ports = ports;
+		/* We use MAPPED addresses in tcp_iss_init */
+		arg.src = *laddr;
+		arg.dst = *faddr;
+		MD5Update(&context, (uchar_t *)&arg, sizeof (arg));
+		MD5Final((uchar_t *)answer, &context);
+		answer[0] ^= answer[1] ^ answer[2] ^ answer[3];
+		new_iss += (gethrtime() >> ISS_NSEC_SHT) + answer[0];
+		break;
+	}
+	case 1:
+		/* Add time component and min random (i.e. 1). */
+		new_iss += (gethrtime() >> ISS_NSEC_SHT) + 1;
+		break;
+	default:
+		/* Add only time component. */
+		new_iss += (uint32_t)gethrestime_sec() * tcps->tcps_iss_incr;
+		break;
+	}
+	if ((adj = (int32_t)(snxt - new_iss)) > 0) {
+		/*
+		 * New ISS not guaranteed to be tcp_iss_incr/2 ahead of the
+		 * current snxt, so add the difference to tcp_iss_incr_extra.
+		 */
+		tcps->tcps_iss_incr_extra += adj;
+	}
+}
+
 /*
  * tcp_time_wait_processing() handles processing of incoming packets when
  * the tcp_t is in the TIME_WAIT state.
@@ -675,67 +1029,11 @@ tcp_time_wait_processing(tcp_t *tcp, mblk_t *mp, uint32_t seg_seq,
 	}
 
 	if ((flags & TH_SYN) && gap > 0 && rgap < 0) {
-		/*
-		 * Make sure that when we accept the connection, pick
-		 * an ISS greater than (tcp_snxt + tcp_iss_incr/2) for the
-		 * old connection.
-		 *
-		 * The next ISS generated is equal to tcp_iss_incr_extra
-		 * + tcp_iss_incr/2 + other components depending on the
-		 * value of tcp_strong_iss.  We pre-calculate the new
-		 * ISS here and compare with tcp_snxt to determine if
-		 * we need to make adjustment to tcp_iss_incr_extra.
-		 *
-		 * The above calculation is ugly and is a
-		 * waste of CPU cycles...
-		 */
-		uint32_t new_iss = tcps->tcps_iss_incr_extra;
-		int32_t adj;
 		ip_stack_t *ipst = tcps->tcps_netstack->netstack_ip;
 
-		switch (tcps->tcps_strong_iss) {
-		case 2: {
-			/* Add time and MD5 components. */
-			uint32_t answer[4];
-			struct {
-				uint32_t ports;
-				in6_addr_t src;
-				in6_addr_t dst;
-			} arg;
-			MD5_CTX context;
-
-			mutex_enter(&tcps->tcps_iss_key_lock);
-			context = tcps->tcps_iss_key;
-			mutex_exit(&tcps->tcps_iss_key_lock);
-			arg.ports = connp->conn_ports;
-			/* We use MAPPED addresses in tcp_iss_init */
-			arg.src = connp->conn_laddr_v6;
-			arg.dst = connp->conn_faddr_v6;
-			MD5Update(&context, (uchar_t *)&arg,
-			    sizeof (arg));
-			MD5Final((uchar_t *)answer, &context);
-			answer[0] ^= answer[1] ^ answer[2] ^ answer[3];
-			new_iss += (gethrtime() >> ISS_NSEC_SHT) + answer[0];
-			break;
-		}
-		case 1:
-			/* Add time component and min random (i.e. 1). */
-			new_iss += (gethrtime() >> ISS_NSEC_SHT) + 1;
-			break;
-		default:
-			/* Add only time component. */
-			new_iss += (uint32_t)gethrestime_sec() *
-			    tcps->tcps_iss_incr;
-			break;
-		}
-		if ((adj = (int32_t)(tcp->tcp_snxt - new_iss)) > 0) {
-			/*
-			 * New ISS not guaranteed to be tcp_iss_incr/2
-			 * ahead of the current tcp_snxt, so add the
-			 * difference to tcp_iss_incr_extra.
-			 */
-			tcps->tcps_iss_incr_extra += adj;
-		}
+		tcp_time_wait_iss_adjust(tcps, tcp->tcp_snxt,
+		    connp->conn_ports, &connp->conn_laddr_v6,
+		    &connp->conn_faddr_v6);
 		/*
 		 * If tcp_clean_death() can not perform the task now,
 		 * drop the SYN packet and let the other side re-xmit.
@@ -827,3 +1125,253 @@ process_ack:
 done:
 	freemsg(mp);
 }
+
+/*
+ * tcp_time_wait_input() does for a compact TIME_WAIT entry what
+ * tcp_time_wait_processing() does for a tcp_t.  It is called for segments
+ * which matched no conn_t, and returns B_FALSE if the segment does not
+ * belong to an entry, or is a SYN which may start a new connection in
+ * place of the entry; the caller then carries on with it.  Otherwise the
+ * segment is consumed.
+ */
+boolean_t
+tcp_time_wait_input(tcp_stack_t *tcps, mblk_t *mp, ip_recv_attr_t *ira)
+{
+	ip_stack_t	*ipst = tcps->tcps_netstack->netstack_ip;
+	uint_t		ip_hdr_len = ira->ira_ip_hdr_length;
+	tcpha_t		*tcpha = (tcpha_t *)&mp->b_rptr[ip_hdr_len];
+	tcp_tw_fanout_t	*twf;
+	tcp_tw_t	*tw;
+	boolean_t	dead = B_FALSE;
+	in6_addr_t	laddr, faddr;
+	uint32_t	ports, seg_seq, seg_ack;
+	uint32_t	seq, ack, win, tsecr;
+	int32_t		gap, rgap;
+	int		seg_len;
+	uint_t		flags;
+	int		ctl = 0;
+	tcp_opt_t	tcpopt;
+
+	if (IPH_HDR_VERSION(mp->b_rptr) == IPV4_VERSION) {
+		ipha_t	*ipha = (ipha_t *)mp->b_rptr;
+
+		IN6_IPADDR_TO_V4MAPPED(ipha->ipha_src, &faddr);
+		IN6_IPADDR_TO_V4MAPPED(ipha->ipha_dst, &laddr);
+	} else {
+		ip6_t	*ip6h = (ip6_t *)mp->b_rptr;
+
+		faddr = ip6h->ip6_src;
+		laddr = ip6h->ip6_dst;
+	}
+	/* Source and destination port, as in conn_ports */
+	ports = *(uint32_t *)tcpha;
+
+	twf = TW_FANOUT(tcps, faddr, ports);
+	mutex_enter(&twf->twf_lock);
+	tw = tcp_tw_lookup(twf, &laddr, &faddr, ports, ira->ira_zoneid);
+	if (tw == NULL) {
+		mutex_exit(&twf->twf_lock);
+		return (B_FALSE);
+	}
+
+	flags = (unsigned int)tcpha->tha_flags & 0xFF;
+	seg_seq = ntohl(tcpha->tha_seq);
+	seg_ack = ntohl(tcpha->tha_ack);
+	seg_len = msgdsize(mp) - (ip_hdr_len + TCP_HDR_LENGTH(tcpha));
+
+	if (!(flags & TH_RST)) {
+		tcpopt.tcp = NULL;
+		if (!(tcp_parse_options(tcpha, &tcpopt) &
+		    TCP_OPT_TSTAMP_PRESENT))
+			goto done;
+		/* PAWS, as tcp_paws_check() */
+		if (TSTMP_LT(tcpopt.tcp_opt_ts_val, tw->tw_ts_recent)) {
+			if (LBOLT_FASTPATH64 <
+			    tw->tw_last_rcv_lbolt + PAWS_TIMEOUT) {
+				ctl = TH_ACK;
+				goto done;
+			}
+			tw->tw_ts_recent = tcpopt.tcp_opt_ts_val;
+		}
+	}
+	gap = seg_seq - tw->tw_rnxt;
+	rgap = tw->tw_rwnd - (gap + seg_len);
+	if (gap < 0) {
+		TCPS_BUMP_MIB(tcps, tcpInDataDupSegs);
+		TCPS_UPDATE_MIB(tcps, tcpInDataDupBytes,
+		    (seg_len > -gap ? -gap : seg_len));
+		seg_len += gap;
+		if (seg_len < 0 || (seg_len == 0 && !(flags & TH_FIN))) {
+			if (flags & TH_RST)
+				goto done;
+			/* A duplicate FIN restarts the 2 MSL timer. */
+			if ((flags & TH_FIN) && seg_len == -1)
+				tcp_tw_restart(tw);
+			ctl = TH_ACK;
+			goto done;
+		}
+		seg_seq = tw->tw_rnxt;
+	}
+
+	if ((flags & TH_SYN) && gap > 0 && rgap < 0) {
+		tcp_time_wait_iss_adjust(tcps, tw->tw_snxt, tw->tw_ports,
+		    &tw->tw_laddr, &tw->tw_faddr);
+		dead = tcp_tw_kill(tw, twf);
+		mutex_exit(&twf->twf_lock);
+		if (dead)
+			tcp_tw_free(tw);
+		TCP_STAT(tcps, tcp_time_wait_syn_success);
+		return (B_FALSE);
+	}
+
+	if (rgap < 0) {
+		TCPS_BUMP_MIB(tcps, tcpInDataPastWinSegs);
+		TCPS_UPDATE_MIB(tcps, tcpInDataPastWinBytes, -rgap);
+		seg_len += rgap;
+		if (seg_len <= 0) {
+			if (!(flags & TH_RST))
+				ctl = TH_ACK;
+			goto done;
+		}
+	}
+	if (!(flags & TH_RST) &&
+	    TSTMP_GEQ(tcpopt.tcp_opt_ts_val, tw->tw_ts_recent) &&
+	    SEQ_LEQ(seg_seq, tw->tw_rnxt)) {
+		tw->tw_ts_recent = tcpopt.tcp_opt_ts_val;
+		tw->tw_last_rcv_lbolt = ddi_get_lbolt64();
+	}
+
+	if (seg_seq != tw->tw_rnxt && seg_len > 0) {
+		/* Always ack out of order packets */
+		ctl = TH_ACK;
+	} else if (seg_len > 0) {
+		TCPS_BUMP_MIB(tcps, tcpInClosed);
+		TCPS_BUMP_MIB(tcps, tcpInDataInorderSegs);
+		TCPS_UPDATE_MIB(tcps, tcpInDataInorderBytes, seg_len);
+	}
+	if (flags & TH_RST) {
+		dead = tcp_tw_kill(tw, twf);
+		ctl = 0;
+		goto done;
+	}
+	if (flags & TH_SYN) {
+		/* Refer to RFC 1122, 4.2.2.13. */
+		ctl = TH_RST | TH_ACK;
+		seq = seg_ack;
+		ack = seg_seq + 1;
+		goto done;
+	}
+	/* Acks something not sent */
+	if ((flags & TH_ACK) && (int32_t)(seg_ack - tw->tw_snxt) > 0)
+		ctl = TH_ACK;
+done:
+	if (ctl == TH_ACK) {
+		seq = tw->tw_snxt;
+		ack = tw->tw_rnxt;
+		win = tw->tw_rwnd >> tw->tw_rcv_ws;
+		tsecr = tw->tw_ts_recent;
+	}
+	mutex_exit(&twf->twf_lock);
+	if (dead)
+		tcp_tw_free(tw);
+
+	if (ctl == TH_ACK) {
+		tcp_xmit_early_ctl(NULL, mp, seq, ack, TH_ACK, win, &tsecr,
+		    ira, ipst, NULL);
+	} else if (ctl != 0) {
+		tcp_xmit_early_ctl("TH_SYN", mp, seq, ack, ctl, 0, NULL,
+		    ira, ipst, NULL);
+	} else {
+		freemsg(mp);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Called by connect() once the 4-tuple and ISS of tcp are known.  A compact
+ * TIME_WAIT entry for the same 4-tuple is done away with, and the ISS made
+ * to start past the old connection's sequence space, as for a SYN accepted
+ * in TIME_WAIT.
+ */
+void
+tcp_time_wait_reuse(tcp_t *tcp)
+{
+	conn_t		*connp = tcp->tcp_connp;
+	tcp_stack_t	*tcps = tcp->tcp_tcps;
+	tcp_tw_fanout_t	*twf;
+	tcp_tw_t	*tw;
+	uint32_t	snxt;
+	boolean_t	dead;
+
+	twf = TW_FANOUT(tcps, connp->conn_faddr_v6, connp->conn_ports);
+	mutex_enter(&twf->twf_lock);
+	tw = tcp_tw_lookup(twf, &connp->conn_laddr_v6, &connp->conn_faddr_v6,
+	    connp->conn_ports, connp->conn_zoneid);
+	if (tw == NULL) {
+		mutex_exit(&twf->twf_lock);
+		return;
+	}
+	snxt = tw->tw_snxt;
+	dead = tcp_tw_kill(tw, twf);
+	mutex_exit(&twf->twf_lock);
+	if (dead)
+		tcp_tw_free(tw);
+	TCP_STAT(tcps, tcp_time_wait_reuse);
+
+	if (SEQ_LT(tcp->tcp_iss, snxt + (tcps->tcps_iss_incr >> 1))) {
+		tcp->tcp_iss = snxt + (tcps->tcps_iss_incr >> 1);
+		tcp->tcp_fss = tcp->tcp_iss - 1;
+		tcp->tcp_suna = tcp->tcp_iss;
+		tcp->tcp_snxt = tcp->tcp_iss + 1;
+		tcp->tcp_rexmit_nxt = tcp->tcp_snxt;
+		tcp->tcp_csuna = tcp->tcp_snxt;
+	}
+}
+
+void
+tcp_time_wait_g_init(void)
+{
+	tcp_tw_cache = kmem_cache_create("tcp_tw_cache", sizeof (tcp_tw_t),
+	    0, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+void
+tcp_time_wait_g_destroy(void)
+{
+	kmem_cache_destroy(tcp_tw_cache);
+}
+
+void
+tcp_time_wait_stack_init(tcp_stack_t *tcps)
+{
+	ip_stack_t	*ipst = tcps->tcps_netstack->netstack_ip;
+	uint_t		i;
+
+	tcps->tcps_tw_fanout_size = ipst->ips_ipcl_conn_fanout_size;
+	tcps->tcps_tw_fanout = kmem_zalloc(tcps->tcps_tw_fanout_size *
+	    sizeof (tcp_tw_fanout_t), KM_SLEEP);
+	for (i = 0; i < tcps->tcps_tw_fanout_size; i++) {
+		mutex_init(&tcps->tcps_tw_fanout[i].twf_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
+	tcps->tcps_tw_cnt = 0;
+}
+
+/*
+ * Every compact entry holds a reference on its netstack, so by now they
+ * are all gone.
+ */
+void
+tcp_time_wait_stack_fini(tcp_stack_t *tcps)
+{
+	uint_t		i;
+
+	ASSERT(tcps->tcps_tw_cnt == 0);
+	for (i = 0; i < tcps->tcps_tw_fanout_size; i++) {
+		ASSERT(tcps->tcps_tw_fanout[i].twf_head == NULL);
+		mutex_destroy(&tcps->tcps_tw_fanout[i].twf_lock);
+	}
+	kmem_free(tcps->tcps_tw_fanout, tcps->tcps_tw_fanout_size *
+	    sizeof (tcp_tw_fanout_t));
+	tcps->tcps_tw_fanout = NULL;
+}
@@ -787,29 +787,17 @@ tcp_timer(void *arg)
 			} else {
 				/*
 				 * After retransmission, we need to do
-				 * slow start.  Set the ssthresh to one
-				 * half of current effective window and
-				 * cwnd to one MSS.  Also reset
-				 * tcp_cwnd_cnt.
+				 * slow start.  The congestion control
+				 * algorithm lowers the ssthresh and sets
+				 * cwnd to one MSS.
 				 *
 				 * Note that if tcp_ssthresh is reduced because
-				 * of ECN, do not reduce it again unless it is
-				 * already one window of data away (tcp_cwr
-				 * should then be cleared) or this is a
-				 * timeout for a retransmitted segment.
+				 * of ECN, it should not be reduced again unless
+				 * it is already one window of data away
+				 * (tcp_cwr should then be cleared) or this is
+				 * a timeout for a retransmitted segment.
 				 */
-				uint32_t npkt;
-
-				if (!tcp->tcp_cwr || tcp->tcp_rexmit) {
-					npkt = ((tcp->tcp_timer_backoff ?
-					    tcp->tcp_cwnd_ssthresh :
-					    tcp->tcp_snxt -
-					    tcp->tcp_suna) >> 1) / tcp->tcp_mss;
-					tcp->tcp_cwnd_ssthresh = MAX(npkt, 2) *
-					    tcp->tcp_mss;
-				}
-				tcp->tcp_cwnd = tcp->tcp_mss;
-				tcp->tcp_cwnd_cnt = 0;
+				tcp->tcp_cc->tcc_rto(tcp);
 				if (tcp->tcp_ecn_ok) {
 					tcp->tcp_cwr = B_TRUE;
 					tcp->tcp_cwr_snd_max = tcp->tcp_snxt;
@@ -0,0 +1,243 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Kernel TLS transmit record layer.
+ *
+ * Once userland has completed a TLS handshake, it can hand the write key,
+ * the implicit part of the nonce and the next record sequence number of the
+ * session to the connection with the TCP_TLS_TX socket option.  From then
+ * on all data written to the socket, sendfile() data included, is framed
+ * into TLS 1.2 application_data records and encrypted with AES-GCM through
+ * KCF before it is put on the transmit list.  This is done by
+ * tcp_tls_output() on the connection's squeue, so records are built in
+ * sequence order.  The cipher reads the cleartext in place, so pages loaned
+ * by sendfile() are never copied, and are released as soon as their records
+ * have been built rather than when they are acknowledged.
+ *
+ * Unlike kssl, which terminates the whole TLS session in the kernel on a
+ * configured port, only the bulk data path is done here: the handshake,
+ * alerts and the receive direction stay in the application.
+ * Retransmissions resend the encrypted records from the transmit list.
+ */
+
+#include <sys/types.h>
+#include <sys/systm.h>
+#include <sys/stream.h>
+#include <sys/strsun.h>
+#include <sys/kmem.h>
+#include <sys/debug.h>
+#include <sys/byteorder.h>
+#include <sys/crypto/api.h>
+#include <netinet/tcp.h>
+#include <inet/tcp_impl.h>
+
+#define	TLS_HDR_LEN		5
+#define	TLS_GCM_SALT_LEN	4	/* implicit part of the nonce */
+#define	TLS_GCM_EXPLICIT_LEN	8	/* explicit part, sent in the record */
+#define	TLS_GCM_IV_LEN		(TLS_GCM_SALT_LEN + TLS_GCM_EXPLICIT_LEN)
+#define	TLS_GCM_TAG_LEN		16
+#define	TLS_AAD_LEN		13	/* seq, type, version, length */
+#define	TLS_MAX_PLAINTEXT	16384
+#define	TLS_MAX_KEY_LEN		32
+#define	TLS_CT_APPLICATION_DATA	23
+
+#define	TLS_OVERHEAD	(TLS_HDR_LEN + TLS_GCM_EXPLICIT_LEN + TLS_GCM_TAG_LEN)
+
+typedef struct tcp_tls_s {
+	crypto_mechanism_t	tt_mech;
+	crypto_key_t		tt_key;
+	crypto_ctx_template_t	tt_tmpl;
+	uint64_t		tt_seq;		/* next record's sequence */
+	uint16_t		tt_version;
+	uint8_t			tt_salt[TLS_GCM_SALT_LEN];
+	uint8_t			tt_keybuf[TLS_MAX_KEY_LEN];
+} tcp_tls_t;
+
+/*
+ * Install the transmit keys in tti on the connection.  Called from
+ * tcp_opt_set() on the squeue.
+ */
+int
+tcp_tls_set(tcp_t *tcp, const tcp_tls_info_t *tti, boolean_t checkonly)
+{
+	tcp_tls_t		*tt;
+	crypto_mech_type_t	mech;
+	size_t			keylen;
+
+	if (tti->tti_version != TCP_TLS_VERSION_1_2)
+		return (ENOTSUP);
+
+	switch (tti->tti_cipher) {
+	case TCP_TLS_CIPHER_AES_GCM_128:
+		keylen = 16;
+		break;
+	case TCP_TLS_CIPHER_AES_GCM_256:
+		keylen = 32;
+		break;
+	default:
+		return (ENOTSUP);
+	}
+
+	/* Rekeying would need records in flight to be tracked, so refuse */
+	if (tcp->tcp_tls != NULL)
+		return (EALREADY);
+	if (tcp->tcp_state < TCPS_ESTABLISHED ||
+	    tcp->tcp_state > TCPS_CLOSE_WAIT)
+		return (ENOTCONN);
+
+	if ((mech = crypto_mech2id(SUN_CKM_AES_GCM)) == CRYPTO_MECH_INVALID)
+		return (ENOTSUP);
+	if (checkonly)
+		return (0);
+
+	if ((tt = kmem_zalloc(sizeof (*tt), KM_NOSLEEP)) == NULL)
+		return (ENOMEM);
+
+	tt->tt_mech.cm_type = mech;
+	bcopy(tti->tti_key, tt->tt_keybuf, keylen);
+	tt->tt_key.ck_format = CRYPTO_KEY_RAW;
+	tt->tt_key.ck_data = tt->tt_keybuf;
+	tt->tt_key.ck_length = CRYPTO_BYTES2BITS(keylen);
+	bcopy(tti->tti_salt, tt->tt_salt, sizeof (tt->tt_salt));
+	tt->tt_seq = BE_IN64(tti->tti_seq);
+	tt->tt_version = tti->tti_version;
+
+	/* A template only saves the key schedule; go without one if need be */
+	if (crypto_create_ctx_template(&tt->tt_mech, &tt->tt_key,
+	    &tt->tt_tmpl, KM_NOSLEEP) != CRYPTO_SUCCESS)
+		tt->tt_tmpl = NULL;
+
+	tcp->tcp_tls = tt;
+	return (0);
+}
+
+void
+tcp_tls_free(tcp_t *tcp)
+{
+	tcp_tls_t	*tt = tcp->tcp_tls;
+
+	if (tt == NULL)
+		return;
+	tcp->tcp_tls = NULL;
+
+	if (tt->tt_tmpl != NULL)
+		crypto_destroy_ctx_template(tt->tt_tmpl);
+	bzero(tt->tt_keybuf, sizeof (tt->tt_keybuf));
+	kmem_free(tt, sizeof (*tt));
+}
+
+/*
+ * Replace the cleartext in mp with the TLS records carrying it, one mblk
+ * per record.  Returns NULL if a record could not be built; the peer cannot
+ * resynchronise after a missing record, so the connection is reset.
+ */
+mblk_t *
+tcp_tls_output(tcp_t *tcp, mblk_t *mp)
+{
+	tcp_tls_t		*tt = tcp->tcp_tls;
+	tcp_stack_t		*tcps = tcp->tcp_tcps;
+	crypto_mechanism_t	mech;
+	CK_AES_GCM_PARAMS	gcm;
+	crypto_data_t		in, out;
+	uchar_t			iv[TLS_GCM_IV_LEN];
+	uchar_t			aad[TLS_AAD_LEN];
+	mblk_t			*head = NULL;
+	mblk_t			**tailp = &head;
+	mblk_t			*bp;
+	size_t			resid = 0;
+	size_t			len;
+	boolean_t		notify = B_FALSE;
+	uchar_t			*p;
+
+	ASSERT(tt != NULL);
+
+	for (bp = mp; bp != NULL; bp = bp->b_cont) {
+		resid += MBLKL(bp);
+		if (bp->b_datap->db_struioflag & STRUIO_ZCNOTIFY)
+			notify = B_TRUE;
+	}
+	if (resid == 0)
+		return (mp);
+
+	gcm.pIv = iv;
+	gcm.ulIvLen = sizeof (iv);
+	gcm.ulIvBits = CRYPTO_BYTES2BITS(sizeof (iv));
+	gcm.pAAD = aad;
+	gcm.ulAADLen = sizeof (aad);
+	gcm.ulTagBits = CRYPTO_BYTES2BITS(TLS_GCM_TAG_LEN);
+	mech = tt->tt_mech;
+	mech.cm_param = (caddr_t)&gcm;
+	mech.cm_param_len = sizeof (gcm);
+	bcopy(tt->tt_salt, iv, TLS_GCM_SALT_LEN);
+
+	bzero(&in, sizeof (in));
+	in.cd_format = CRYPTO_DATA_MBLK;
+	in.cd_mp = mp;
+	bzero(&out, sizeof (out));
+	out.cd_format = CRYPTO_DATA_RAW;
+
+	while (resid > 0) {
+		len = MIN(resid, TLS_MAX_PLAINTEXT);
+		if ((bp = allocb(len + TLS_OVERHEAD, BPRI_MED)) == NULL)
+			goto fail;
+		p = bp->b_wptr;
+
+		p[0] = TLS_CT_APPLICATION_DATA;
+		BE_OUT16(p + 1, tt->tt_version);
+		BE_OUT16(p + 3, len + TLS_GCM_EXPLICIT_LEN + TLS_GCM_TAG_LEN);
+		BE_OUT64(p + TLS_HDR_LEN, tt->tt_seq);
+		bcopy(p + TLS_HDR_LEN, iv + TLS_GCM_SALT_LEN,
+		    TLS_GCM_EXPLICIT_LEN);
+
+		BE_OUT64(aad, tt->tt_seq);
+		aad[8] = TLS_CT_APPLICATION_DATA;
+		BE_OUT16(aad + 9, tt->tt_version);
+		BE_OUT16(aad + 11, len);
+
+		in.cd_length = len;
+		out.cd_raw.iov_base = (char *)p + TLS_HDR_LEN +
+		    TLS_GCM_EXPLICIT_LEN;
+		out.cd_raw.iov_len = len + TLS_GCM_TAG_LEN;
+		out.cd_length = len + TLS_GCM_TAG_LEN;
+
+		if (crypto_encrypt(&mech, &in, &tt->tt_key, tt->tt_tmpl,
+		    &out, NULL) != CRYPTO_SUCCESS) {
+			freeb(bp);
+			goto fail;
+		}
+
+		bp->b_wptr += len + TLS_OVERHEAD;
+		*tailp = bp;
+		tailp = &bp->b_cont;
+
+		tt->tt_seq++;
+		in.cd_offset += len;
+		resid -= len;
+		TCP_STAT(tcps, tcp_tls_records);
+	}
+
+	freemsg(mp);
+	if (notify)
+		tcp_zcopy_notify(tcp);
+	return (head);
+
+fail:
+	TCP_STAT(tcps, tcp_tls_encrypt_fail);
+	freemsg(head);
+	freemsg(mp);
+	if (notify)
+		tcp_zcopy_notify(tcp);
+	tcp_xmit_ctl("tcp_tls_output: record lost", tcp, tcp->tcp_snxt,
+	    tcp->tcp_rnxt, TH_RST | TH_ACK);
+	(void) tcp_clean_death(tcp, ENOMEM);
+	return (NULL);
+}
@@ -199,6 +199,47 @@ tcp_get_buf_prop(netstack_t *stack, mod_prop_info_t *pinfo, const char *ifname,
 	    pinfo, ifname, val, psize, flags));
 }
 
+/*
+ * Set the congestion control algorithm used by new connections.
+ */
+/* ARGSUSED */
+static int
+tcp_set_cc_algo(netstack_t *stack, cred_t *cr, mod_prop_info_t *pinfo,
+    const char *ifname, const void *pval, uint_t flags)
+{
+	if (flags & MOD_PROP_DEFAULT)
+		pval = tcp_cc_newreno.tcc_name;
+
+	return (tcp_cc_set_stack_default(stack->netstack_tcp, pval));
+}
+
+/*
+ * The possible values are the names of the registered algorithms.
+ */
+/* ARGSUSED */
+static int
+tcp_get_cc_algo(netstack_t *stack, mod_prop_info_t *pinfo, const char *ifname,
+    void *pval, uint_t psize, uint_t flags)
+{
+	tcp_cc_ops_t	*cc;
+	size_t		nbytes;
+
+	if (flags & MOD_PROP_DEFAULT) {
+		nbytes = snprintf(pval, psize, "%s", tcp_cc_newreno.tcc_name);
+	} else if (flags & MOD_PROP_PERM) {
+		nbytes = snprintf(pval, psize, "%u", MOD_PROP_PERM_RW);
+	} else if (flags & MOD_PROP_POSSIBLE) {
+		nbytes = tcp_cc_list(pval, psize);
+	} else {
+		cc = tcp_cc_stack_default(stack->netstack_tcp);
+		nbytes = snprintf(pval, psize, "%s", cc->tcc_name);
+		tcp_cc_rele(cc);
+	}
+	if (nbytes >= psize)
+		return (ENOBUFS);
+	return (0);
+}
+
 /*
  * Special checkers for smallest/largest anonymous port so they don't
  * ever happen to be (largest < smallest).
@@ -527,6 +568,17 @@ mod_prop_info_t tcp_propinfo_tbl[] = {
 	    {1, ISS_INCR, ISS_INCR},
 	    {ISS_INCR} },
 
+	{ "congestion_control", MOD_PROTO_TCP,
+	    tcp_set_cc_algo, tcp_get_cc_algo, {0}, {0} },
+
+	{ "_rx_steer", MOD_PROTO_TCP,
+	    mod_set_boolean, mod_get_boolean,
+	    {B_FALSE}, {B_FALSE} },
+
+	{ "_time_wait_compact", MOD_PROTO_TCP,
+	    mod_set_boolean, mod_get_boolean,
+	    {B_FALSE}, {B_FALSE} },
+
 	{ "?", MOD_PROTO_TCP, NULL, mod_get_allprop, {0}, {0} },
 
 	{ NULL, 0, NULL, NULL, {0}, {0} }
@@ -0,0 +1,99 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_INET_TCP_CC_H
+#define	_INET_TCP_CC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#if (defined(_KERNEL) || defined(_KMEMUSER))
+
+/*
+ * TCP congestion control algorithms.
+ *
+ * How a sender moves tcp_cwnd and tcp_cwnd_ssthresh is delegated to a
+ * tcp_cc_ops_t.  The stack default is chosen with the "congestion_control"
+ * property and a connection may pick another with the TCP_CONGESTION
+ * socket option.  Loss recovery itself (fast retransmit, limited transmit,
+ * SACK, the ECN handshake) stays in TCP; the algorithm only decides the
+ * size of the window.  All hooks are called on the connection's squeue.
+ *
+ *	tcc_init	The algorithm has just been attached to the
+ *			connection; tcp_cc_priv has been zeroed.  Optional.
+ *	tcc_ack		A segment acknowledged new data (second argument,
+ *			in bytes) and did not carry ECN-Echo.
+ *	tcc_loss	Congestion was signalled, either by the duplicate ACK
+ *			that starts fast retransmit (TCP_CC_LOSS_DUPACK) or by
+ *			ECN-Echo (TCP_CC_LOSS_ECN).  Set tcp_cwnd_ssthresh
+ *			and tcp_cwnd; for TCP_CC_LOSS_DUPACK, tcp_cwnd must
+ *			include the tcp_dupack_cnt segments that have left
+ *			the network.  Not called again while tcp_cwr is set.
+ *	tcc_rto		The retransmission timer expired.  Set
+ *			tcp_cwnd_ssthresh (unless tcp_cwr is set and this is
+ *			not a retransmission) and restart slow start.
+ *	tcc_idle	The connection has data to send after being idle for
+ *			longer than the RTO.
+ *
+ * An algorithm keeps its per-connection state in tcp_cc_priv.
+ */
+#define	TCP_CC_PRIV_WORDS	4
+
+#define	TCP_CC_LOSS_DUPACK	1
+#define	TCP_CC_LOSS_ECN		2
+
+struct tcp_s;
+
+typedef struct tcp_cc_ops {
+	const char	*tcc_name;
+	void		(*tcc_init)(struct tcp_s *);
+	void		(*tcc_ack)(struct tcp_s *, uint32_t);
+	void		(*tcc_loss)(struct tcp_s *, int);
+	void		(*tcc_rto)(struct tcp_s *);
+	void		(*tcc_idle)(struct tcp_s *);
+
+	/* Private to the framework */
+	struct tcp_cc_ops *tcc_next;
+	volatile uint32_t tcc_refcnt;
+} tcp_cc_ops_t;
+
+#endif	/* (defined(_KERNEL) || defined(_KMEMUSER)) */
+
+#ifdef _KERNEL
+
+extern tcp_cc_ops_t	tcp_cc_newreno;
+extern tcp_cc_ops_t	tcp_cc_cubic;
+
+extern void	tcp_cc_g_init(void);
+extern void	tcp_cc_g_destroy(void);
+extern int	tcp_cc_register(tcp_cc_ops_t *);
+extern int	tcp_cc_unregister(tcp_cc_ops_t *);
+
+extern tcp_cc_ops_t	*tcp_cc_lookup(const char *);
+extern void	tcp_cc_hold(tcp_cc_ops_t *);
+extern void	tcp_cc_rele(tcp_cc_ops_t *);
+extern void	tcp_cc_attach(struct tcp_s *, tcp_cc_ops_t *);
+extern void	tcp_cc_detach(struct tcp_s *);
+
+extern void	tcp_cc_stack_init(tcp_stack_t *);
+extern void	tcp_cc_stack_fini(tcp_stack_t *);
+extern tcp_cc_ops_t	*tcp_cc_stack_default(tcp_stack_t *);
+extern int	tcp_cc_set_stack_default(tcp_stack_t *, const char *);
+extern size_t	tcp_cc_list(char *, size_t);
+
+#endif	/* _KERNEL */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _INET_TCP_CC_H */
@@ -194,7 +194,52 @@ extern kmem_cache_t *tcp_timercache;
  * with the tcp_stack_t and conn_netstack.  Any tcp_t connections stored in the
  * tcp_free_list are disassociated and have NULL tcp_tcps and conn_netstack
  * pointers.
- */
+ *
+ * When the _time_wait_compact property is set, a detached connection that
+ * negotiated timestamps does not keep its conn_t and tcp_t for the whole
+ * TIME_WAIT interval.  tcp_time_wait_append() copies what TIME_WAIT needs
+ * (the 4-tuple, tcp_snxt, tcp_rnxt, the receive window and the timestamp
+ * state) into a much smaller tcp_tw_t and releases the connection at once,
+ * along with its port.  The tcp_tw_t goes into the squeue's tcp_tw_bucket
+ * wheel, which shares the schedule, offset and timer of the
+ * tcp_time_wait_bucket wheel, and into the stack's tcps_tw_fanout hash.
+ * tcp_time_wait_input() looks segments which match no conn_t up in the
+ * hash, and tcp_time_wait_reuse() lets connect() take over an entry's
+ * 4-tuple; the timestamps keep old duplicates out of the new connection.
+ *
+ * The hash linkage of a tcp_tw_t is protected by the bucket's twf_lock and
+ * its wheel linkage and tw_expire by tcp_time_wait_lock, taken in that
+ * order.  An entry is removed from the hash before it is freed, and it is
+ * freed by whoever removes it from the wheel.  The collector takes expired
+ * entries off the wheel first, so an entry found in the hash with a zero
+ * tw_expire belongs to the collector and must be left alone.
+ */
+typedef struct tcp_tw_s {
+	struct tcp_tw_s	*tw_hash_next;
+	struct tcp_tw_s	*tw_next;	/* tcp_tw_bucket linkage */
+	struct tcp_tw_s	*tw_prev;
+	int64_t		tw_expire;	/* 0 when not on the wheel */
+	tcp_stack_t	*tw_tcps;	/* holds a netstack reference */
+	squeue_t	*tw_sqp;
+	in6_addr_t	tw_laddr;	/* IPv4-mapped for IPv4 */
+	in6_addr_t	tw_faddr;
+	uint32_t	tw_ports;	/* fport and lport, as conn_ports */
+	zoneid_t	tw_zoneid;
+	uint32_t	tw_snxt;
+	uint32_t	tw_rnxt;
+	uint32_t	tw_rwnd;
+	uint32_t	tw_ts_recent;
+	int64_t		tw_last_rcv_lbolt;
+	uint8_t		tw_rcv_ws;
+	uint8_t		tw_ipversion;
+	boolean_t	tw_hashed;
+} tcp_tw_t;
+
+typedef struct tcp_tw_fanout_s {
+	kmutex_t	twf_lock;
+	tcp_tw_t	*twf_head;
+} tcp_tw_fanout_t;
+
 typedef struct tcp_squeue_priv_s {
 	kmutex_t	tcp_time_wait_lock;
 	boolean_t	tcp_time_wait_collector_active;
@@ -203,6 +248,7 @@ typedef struct tcp_squeue_priv_s {
 	int64_t		tcp_time_wait_schedule;
 	int64_t		tcp_time_wait_offset;
 	tcp_t		*tcp_time_wait_bucket[TCP_TIME_WAIT_BUCKETS];
+	tcp_tw_t	*tcp_tw_bucket[TCP_TIME_WAIT_BUCKETS];
 	tcp_t		*tcp_free_list;
 	uint_t		tcp_free_list_cnt;
 } tcp_squeue_priv_t;
@@ -235,6 +281,11 @@ typedef struct tcp_squeue_priv_s {
 #define	TSTMP_GEQ(a, b)	((int32_t)((a)-(b)) >= 0)
 #define	TSTMP_LT(a, b)	((int32_t)((a)-(b)) < 0)
 
+/*
+ *  PAWS needs a timer for 24 days.  This is the number of ticks in 24 days
+ */
+#define	PAWS_TIMEOUT	((clock_t)(24*24*60*60*hz))
+
 /*
  * Initialize cwnd according to RFC 3390.  def_max_init_cwnd is
  * either tcp_slow_start_initial or tcp_slow_start_after idle
@@ -573,6 +624,8 @@ extern uint32_t tcp_early_abort;
 #define	tcps_dev_flow_ctl		tcps_propinfo_tbl[58].prop_cur_bval
 #define	tcps_reass_timeout		tcps_propinfo_tbl[59].prop_cur_uval
 #define	tcps_iss_incr			tcps_propinfo_tbl[65].prop_cur_uval
+#define	tcps_rx_steer			tcps_propinfo_tbl[67].prop_cur_bval
+#define	tcps_time_wait_compact		tcps_propinfo_tbl[68].prop_cur_bval
 
 extern struct qinit tcp_rinitv4, tcp_rinitv6;
 extern boolean_t do_tcp_fusion;
@@ -681,6 +734,9 @@ extern void	tcp_wput_data(tcp_t *, mblk_t *, boolean_t);
 extern void	tcp_wput_sock(queue_t *, mblk_t *);
 extern void	tcp_wput_fallback(queue_t *, mblk_t *);
 extern void	tcp_xmit_ctl(char *, tcp_t *, uint32_t, uint32_t, int);
+extern void	tcp_xmit_early_ctl(char *, mblk_t *, uint32_t, uint32_t, int,
+		    uint32_t, const uint32_t *, ip_recv_attr_t *, ip_stack_t *,
+		    conn_t *);
 extern void	tcp_xmit_listeners_reset(mblk_t *, ip_recv_attr_t *,
 		    ip_stack_t *i, conn_t *);
 extern mblk_t	*tcp_xmit_mp(tcp_t *, mblk_t *, int32_t, int32_t *,
@@ -748,6 +804,13 @@ extern void	tcp_use_pure_tpi(tcp_t *);
 extern void	tcp_do_capability_ack(tcp_t *, struct T_capability_ack *,
 		    t_uscalar_t);
 
+/*
+ * Kernel TLS record layer functions in tcp_tls.c.
+ */
+extern int	tcp_tls_set(tcp_t *, const tcp_tls_info_t *, boolean_t);
+extern void	tcp_tls_free(tcp_t *);
+extern mblk_t	*tcp_tls_output(tcp_t *, mblk_t *);
+
 /*
  * TCP option processing related functions in tcp_opt_data.c
  */
@@ -763,6 +826,13 @@ extern void		tcp_time_wait_collector(void *);
 extern boolean_t	tcp_time_wait_remove(tcp_t *, tcp_squeue_priv_t *);
 extern void		tcp_time_wait_processing(tcp_t *, mblk_t *, uint32_t,
 			    uint32_t, int, tcpha_t *, ip_recv_attr_t *);
+extern boolean_t	tcp_time_wait_input(tcp_stack_t *, mblk_t *,
+			    ip_recv_attr_t *);
+extern void		tcp_time_wait_reuse(tcp_t *);
+extern void		tcp_time_wait_g_init(void);
+extern void		tcp_time_wait_g_destroy(void);
+extern void		tcp_time_wait_stack_init(tcp_stack_t *);
+extern void		tcp_time_wait_stack_fini(tcp_stack_t *);
 
 /*
  * Misc functions in tcp_misc.c.
@@ -114,6 +114,20 @@ struct tcp_stack {
 	kmutex_t	tcps_listener_conf_lock;
 	list_t		tcps_listener_conf;
 
+	/*
+	 * Congestion control algorithm for new connections, held.
+	 * Protected by tcp_cc_lock.
+	 */
+	struct tcp_cc_ops *tcps_cc_default;
+
+	/*
+	 * Compact TIME_WAIT entries, hashed by 4-tuple; see tcp_impl.h.
+	 * tcps_tw_cnt is the number of entries in the hash.
+	 */
+	struct tcp_tw_fanout_s *tcps_tw_fanout;
+	uint_t		tcps_tw_fanout_size;
+	uint32_t	tcps_tw_cnt;
+
 	/*
 	 * Per CPU stats
 	 *
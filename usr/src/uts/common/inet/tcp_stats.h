@@ -121,6 +121,11 @@ typedef struct tcp_stat {
 	kstat_named_t	tcp_rst_unsent;
 	kstat_named_t	tcp_reclaim_cnt;
 	kstat_named_t	tcp_reass_timeout;
+	kstat_named_t	tcp_rx_steer;
+	kstat_named_t	tcp_time_wait_compact;
+	kstat_named_t	tcp_time_wait_reuse;
+	kstat_named_t	tcp_tls_records;
+	kstat_named_t	tcp_tls_encrypt_fail;
 #ifdef TCP_DEBUG_COUNTER
 	kstat_named_t	tcp_time_wait;
 	kstat_named_t	tcp_rput_time_wait;
@@ -177,6 +182,11 @@ typedef struct tcp_stat_counter_s {
 	uint64_t	tcp_rst_unsent;
 	uint64_t	tcp_reclaim_cnt;
 	uint64_t	tcp_reass_timeout;
+	uint64_t	tcp_rx_steer;
+	uint64_t	tcp_time_wait_compact;
+	uint64_t	tcp_time_wait_reuse;
+	uint64_t	tcp_tls_records;
+	uint64_t	tcp_tls_encrypt_fail;
 #ifdef TCP_DEBUG_COUNTER
 	uint64_t	tcp_time_wait;
 	uint64_t	tcp_rput_time_wait;
@@ -1583,6 +1583,11 @@ udp_opt_get(conn_t *connp, t_scalar_t level, t_scalar_t name,
 			*i1 = udp->udp_rcvhdr ? 1 : 0;
 			mutex_exit(&connp->conn_lock);
 			return (sizeof (int));
+		case UDP_SEGMENT:
+			mutex_enter(&connp->conn_lock);
+			*i1 = udp->udp_segsize;
+			mutex_exit(&connp->conn_lock);
+			return (sizeof (int));
 		}
 	}
 	mutex_enter(&connp->conn_lock);
@@ -1718,6 +1723,16 @@ udp_do_opt_set(conn_opt_arg_t *coa, int level, int name,
 			udp->udp_rcvhdr = onoff;
 			mutex_exit(&connp->conn_lock);
 			return (0);
+		case UDP_SEGMENT:
+			if (*i1 < 0 || *i1 > (connp->conn_family == AF_INET ?
+			    UDP_MAXPACKET_IPV4 : UDP_MAXPACKET_IPV6))
+				return (EINVAL);
+			if (!checkonly) {
+				mutex_enter(&connp->conn_lock);
+				udp->udp_segsize = *i1;
+				mutex_exit(&connp->conn_lock);
+			}
+			return (0);
 		}
 		break;
 	}
@@ -5896,9 +5911,12 @@ done:
 	return (error);
 }
 
-int
-udp_send(sock_lower_handle_t proto_handle, mblk_t *mp, struct nmsghdr *msg,
-    cred_t *cr)
+/*
+ * Send one datagram.
+ */
+static int
+udp_send_dgram(sock_lower_handle_t proto_handle, mblk_t *mp,
+    struct nmsghdr *msg, cred_t *cr)
 {
 	sin6_t		*sin6;
 	sin_t		*sin = NULL;
@@ -6129,6 +6147,74 @@ udp_send(sock_lower_handle_t proto_handle, mblk_t *mp, struct nmsghdr *msg,
 	}
 }
 
+/*
+ * Split the first len bytes of data off mp, which must hold more than
+ * that, and return the rest in *restp.
+ */
+static int
+udp_segment(mblk_t *mp, uint_t len, mblk_t **restp)
+{
+	mblk_t	*bp, *rest;
+	uint_t	n;
+
+	for (bp = mp; (n = MBLKL(bp)) < len; bp = bp->b_cont) {
+		len -= n;
+		ASSERT(bp->b_cont != NULL);
+	}
+	if (n == len) {
+		*restp = bp->b_cont;
+		bp->b_cont = NULL;
+		return (0);
+	}
+	if ((rest = dupb(bp)) == NULL)
+		return (ENOMEM);
+	rest->b_rptr += len;
+	rest->b_cont = bp->b_cont;
+	bp->b_wptr = bp->b_rptr + len;
+	bp->b_cont = NULL;
+	*restp = rest;
+	return (0);
+}
+
+/*
+ * With UDP_SEGMENT set, a send larger than the segment size goes out as a
+ * train of datagrams of that size, the last possibly shorter, so that an
+ * application can hand UDP a large buffer in one call.  The datagrams
+ * take the same path as single sends, and after the first each one finds
+ * its destination's route and header template already cached in the
+ * conn_t.  If one of them cannot be sent the rest are dropped.
+ */
+int
+udp_send(sock_lower_handle_t proto_handle, mblk_t *mp, struct nmsghdr *msg,
+    cred_t *cr)
+{
+	conn_t		*connp = (conn_t *)proto_handle;
+	uint_t		segsize = connp->conn_udp->udp_segsize;
+	mblk_t		*rest;
+	size_t		resid;
+	int		error;
+
+	if (segsize == 0 || (resid = msgdsize(mp)) <= segsize)
+		return (udp_send_dgram(proto_handle, mp, msg, cr));
+
+	do {
+		if ((error = udp_segment(mp, segsize, &rest)) != 0) {
+			UDPS_BUMP_MIB(connp->conn_udp->udp_us, udpOutErrors);
+			freemsg(mp);
+			return (error);
+		}
+		error = udp_send_dgram(proto_handle, mp, msg, cr);
+		mp = rest;
+		resid -= segsize;
+	} while (error == 0 && resid > segsize);
+
+	if (error != 0) {
+		freemsg(mp);
+		return (error);
+	}
+	return (udp_send_dgram(proto_handle, mp, msg, cr));
+}
+
 int
 udp_fallback(sock_lower_handle_t proto_handle, queue_t *q,
     boolean_t issocket, so_proto_quiesced_cb_t quiesced_cb,
@@ -35,6 +35,7 @@
 #include <sys/uio.h>
 #include <sys/aio_req.h>
 #include <sys/cred.h>
+#include <sys/cpuvar.h>
 #include <sys/modctl.h>
 #include <sys/cmlb.h>
 #include <sys/conf.h>
@@ -58,12 +59,26 @@
 
 typedef struct bd bd_t;
 typedef struct bd_xfer_impl bd_xfer_impl_t;
+typedef struct bd_queue bd_queue_t;
+
+/*
+ * One of these for each submission queue the parent driver advertises.
+ * Transfers are placed on the queue of the CPU that submits them, so that
+ * CPUs submitting I/O concurrently don't contend for a single lock.
+ */
+struct bd_queue {
+	kmutex_t	q_iomutex;
+	uint32_t	q_qsize;
+	uint32_t	q_qactive;
+	list_t		q_runq;
+	list_t		q_waitq;
+};
 
 struct bd {
 	void		*d_private;
 	dev_info_t	*d_dip;
 	kmutex_t	d_ocmutex;
-	kmutex_t	d_iomutex;
+	kmutex_t	d_ksmutex;	/* protects d_kiop */
 	kmutex_t	*d_errmutex;
 	kmutex_t	d_statemutex;
 	kcondvar_t	d_statecv;
@@ -73,17 +88,17 @@ struct bd {
 	uint64_t	d_open_excl;	/* bit mask indexed by partition */
 	uint64_t	d_open_reg[OTYPCNT];		/* bit mask */
 
-	uint32_t	d_qsize;
-	uint32_t	d_qactive;
+	uint32_t	d_qcount;
+	bd_queue_t	*d_queues;
 	uint32_t	d_maxxfer;
+	uint64_t	d_free_maxblks;
+	uint64_t	d_zero_maxblks;
 	uint32_t	d_blkshift;
 	uint32_t	d_pblkshift;
 	uint64_t	d_numblks;
 	ddi_devid_t	d_devid;
 
 	kmem_cache_t	*d_cache;
-	list_t		d_runq;
-	list_t		d_waitq;
 	kstat_t		*d_ksp;
 	kstat_io_t	*d_kiop;
 	kstat_t		*d_errstats;
@@ -132,6 +147,7 @@ struct bd_xfer_impl {
 #define	i_nblks		i_public.x_nblks
 #define	i_blkno		i_public.x_blkno
 #define	i_flags		i_public.x_flags
+#define	i_qnum		i_public.x_qnum
 
 
 /*
@@ -165,12 +181,15 @@ static int bd_tg_rdwr(dev_info_t *, uchar_t, void *, diskaddr_t, size_t,
 static int bd_tg_getinfo(dev_info_t *, int, void *, void *);
 static int bd_xfer_ctor(void *, void *, int);
 static void bd_xfer_dtor(void *, void *);
-static void bd_sched(bd_t *);
+static void bd_queues_alloc(bd_t *, uint32_t, uint32_t);
+static void bd_queues_free(bd_t *);
+static void bd_sched(bd_t *, bd_queue_t *);
 static void bd_submit(bd_t *, bd_xfer_impl_t *);
 static void bd_runq_exit(bd_xfer_impl_t *, int);
 static void bd_update_state(bd_t *);
 static int bd_check_state(bd_t *, enum dkio_state *);
 static int bd_flush_write_cache(bd_t *, struct dk_callback *);
+static int bd_free_space(dev_t, bd_t *, dkioc_free_t *);
 
 struct cmlb_tg_ops bd_tg_ops = {
 	TG_DK_OPS_VERSION_1,
@@ -535,23 +554,18 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	hdl->h_bd = bd;
 	ddi_set_driver_private(dip, bd);
 
-	mutex_init(&bd->d_iomutex, NULL, MUTEX_DRIVER, NULL);
+	mutex_init(&bd->d_ksmutex, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&bd->d_ocmutex, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&bd->d_statemutex, NULL, MUTEX_DRIVER, NULL);
 	cv_init(&bd->d_statecv, NULL, CV_DRIVER, NULL);
 
-	list_create(&bd->d_waitq, sizeof (bd_xfer_impl_t),
-	    offsetof(struct bd_xfer_impl, i_linkage));
-	list_create(&bd->d_runq, sizeof (bd_xfer_impl_t),
-	    offsetof(struct bd_xfer_impl, i_linkage));
-
 	bd->d_cache = kmem_cache_create(kcache, sizeof (bd_xfer_impl_t), 8,
 	    bd_xfer_ctor, bd_xfer_dtor, NULL, bd, NULL, 0);
 
 	bd->d_ksp = kstat_create(ddi_driver_name(dip), inst, NULL, "disk",
 	    KSTAT_TYPE_IO, 1, KSTAT_FLAG_PERSISTENT);
 	if (bd->d_ksp != NULL) {
-		bd->d_ksp->ks_lock = &bd->d_iomutex;
+		bd->d_ksp->ks_lock = &bd->d_ksmutex;
 		kstat_install(bd->d_ksp);
 		bd->d_kiop = bd->d_ksp->ks_data;
 	} else {
@@ -570,12 +584,14 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 
 	bzero(&drive, sizeof (drive));
 	bd->d_ops.o_drive_info(bd->d_private, &drive);
-	bd->d_qsize = drive.d_qsize;
+	bd_queues_alloc(bd, drive.d_qcount, drive.d_qsize);
 	bd->d_removable = drive.d_removable;
 	bd->d_hotpluggable = drive.d_hotpluggable;
 
 	if (drive.d_maxxfer && drive.d_maxxfer < bd->d_maxxfer)
 		bd->d_maxxfer = drive.d_maxxfer;
+	bd->d_free_maxblks = drive.d_free_maxblks;
+	bd->d_zero_maxblks = drive.d_zero_maxblks;
 
 	bd_create_inquiry_props(dip, &drive);
 
@@ -590,12 +606,11 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	if (rv != 0) {
 		cmlb_free_handle(&bd->d_cmlbh);
 		kmem_cache_destroy(bd->d_cache);
-		mutex_destroy(&bd->d_iomutex);
+		bd_queues_free(bd);
+		mutex_destroy(&bd->d_ksmutex);
 		mutex_destroy(&bd->d_ocmutex);
 		mutex_destroy(&bd->d_statemutex);
 		cv_destroy(&bd->d_statecv);
-		list_destroy(&bd->d_waitq);
-		list_destroy(&bd->d_runq);
 		if (bd->d_ksp != NULL) {
 			kstat_delete(bd->d_ksp);
 			bd->d_ksp = NULL;
@@ -674,12 +689,11 @@ bd_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 	if (bd->d_devid)
 		ddi_devid_free(bd->d_devid);
 	kmem_cache_destroy(bd->d_cache);
-	mutex_destroy(&bd->d_iomutex);
+	bd_queues_free(bd);
+	mutex_destroy(&bd->d_ksmutex);
 	mutex_destroy(&bd->d_ocmutex);
 	mutex_destroy(&bd->d_statemutex);
 	cv_destroy(&bd->d_statecv);
-	list_destroy(&bd->d_waitq);
-	list_destroy(&bd->d_runq);
 	ddi_soft_state_free(bd_state, ddi_get_instance(dip));
 	return (DDI_SUCCESS);
 }
@@ -1341,6 +1355,14 @@ bd_ioctl(dev_t dev, int cmd, intptr_t arg, int flag, cred_t *credp, int *rvalp)
 		rv = bd_flush_write_cache(bd, dkc);
 		return (rv);
 	}
+	case DKIOCFREE: {
+		dkioc_free_t df;
+
+		if (ddi_copyin(ptr, &df, sizeof (df), flag)) {
+			return (EFAULT);
+		}
+		return (bd_free_space(dev, bd, &df));
+	}
 
 	default:
 		break;
@@ -1471,20 +1493,64 @@ bd_tg_getinfo(dev_info_t *dip, int cmd, void *arg, void *tg_cookie)
 }
 
 
+/*
+ * Set up the submission queues.  Drivers that don't advertise a queue
+ * count get a single queue.  Each queue may have up to qsize transfers
+ * outstanding in the driver.
+ */
+static void
+bd_queues_alloc(bd_t *bd, uint32_t qcount, uint32_t qsize)
+{
+	if (qcount == 0)
+		qcount = 1;
+
+	bd->d_qcount = qcount;
+	bd->d_queues = kmem_zalloc(qcount * sizeof (bd_queue_t), KM_SLEEP);
+
+	for (uint32_t i = 0; i < qcount; i++) {
+		bd_queue_t *bq = &bd->d_queues[i];
+
+		mutex_init(&bq->q_iomutex, NULL, MUTEX_DRIVER, NULL);
+		bq->q_qsize = qsize;
+		list_create(&bq->q_waitq, sizeof (bd_xfer_impl_t),
+		    offsetof(struct bd_xfer_impl, i_linkage));
+		list_create(&bq->q_runq, sizeof (bd_xfer_impl_t),
+		    offsetof(struct bd_xfer_impl, i_linkage));
+	}
+}
+
+static void
+bd_queues_free(bd_t *bd)
+{
+	for (uint32_t i = 0; i < bd->d_qcount; i++) {
+		bd_queue_t *bq = &bd->d_queues[i];
+
+		mutex_destroy(&bq->q_iomutex);
+		list_destroy(&bq->q_waitq);
+		list_destroy(&bq->q_runq);
+	}
+
+	kmem_free(bd->d_queues, bd->d_qcount * sizeof (bd_queue_t));
+	bd->d_queues = NULL;
+	bd->d_qcount = 0;
+}
+
 static void
-bd_sched(bd_t *bd)
+bd_sched(bd_t *bd, bd_queue_t *bq)
 {
 	bd_xfer_impl_t	*xi;
 	struct buf	*bp;
 	int		rv;
 
-	mutex_enter(&bd->d_iomutex);
+	mutex_enter(&bq->q_iomutex);
 
-	while ((bd->d_qactive < bd->d_qsize) &&
-	    ((xi = list_remove_head(&bd->d_waitq)) != NULL)) {
-		bd->d_qactive++;
+	while ((bq->q_qactive < bq->q_qsize) &&
+	    ((xi = list_remove_head(&bq->q_waitq)) != NULL)) {
+		bq->q_qactive++;
+		mutex_enter(&bd->d_ksmutex);
 		kstat_waitq_to_runq(bd->d_kiop);
-		list_insert_tail(&bd->d_runq, xi);
+		mutex_exit(&bd->d_ksmutex);
+		list_insert_tail(&bq->q_runq, xi);
 
 		/*
 		 * Submit the job to the driver.  We drop the I/O mutex
@@ -1492,7 +1558,7 @@ bd_sched(bd_t *bd)
 		 * completion routine calls back into us synchronously.
 		 */
 
-		mutex_exit(&bd->d_iomutex);
+		mutex_exit(&bq->q_iomutex);
 
 		rv = xi->i_func(bd->d_private, &xi->i_public);
 		if (rv != 0) {
@@ -1502,42 +1568,53 @@ bd_sched(bd_t *bd)
 
 			atomic_inc_32(&bd->d_kerr->bd_transerrs.value.ui32);
 
-			mutex_enter(&bd->d_iomutex);
-			bd->d_qactive--;
+			mutex_enter(&bq->q_iomutex);
+			bq->q_qactive--;
+			mutex_enter(&bd->d_ksmutex);
 			kstat_runq_exit(bd->d_kiop);
-			list_remove(&bd->d_runq, xi);
+			mutex_exit(&bd->d_ksmutex);
+			list_remove(&bq->q_runq, xi);
 			bd_xfer_free(xi);
 		} else {
-			mutex_enter(&bd->d_iomutex);
+			mutex_enter(&bq->q_iomutex);
 		}
 	}
 
-	mutex_exit(&bd->d_iomutex);
+	mutex_exit(&bq->q_iomutex);
 }
 
 static void
 bd_submit(bd_t *bd, bd_xfer_impl_t *xi)
 {
-	mutex_enter(&bd->d_iomutex);
-	list_insert_tail(&bd->d_waitq, xi);
+	uint32_t	q = CPU->cpu_seqid % bd->d_qcount;
+	bd_queue_t	*bq = &bd->d_queues[q];
+
+	xi->i_qnum = q;
+
+	mutex_enter(&bq->q_iomutex);
+	list_insert_tail(&bq->q_waitq, xi);
+	mutex_enter(&bd->d_ksmutex);
 	kstat_waitq_enter(bd->d_kiop);
-	mutex_exit(&bd->d_iomutex);
+	mutex_exit(&bd->d_ksmutex);
+	mutex_exit(&bq->q_iomutex);
 
-	bd_sched(bd);
+	bd_sched(bd, bq);
 }
 
 static void
 bd_runq_exit(bd_xfer_impl_t *xi, int err)
 {
-	bd_t	*bd = xi->i_bd;
-	buf_t	*bp = xi->i_bp;
+	bd_t		*bd = xi->i_bd;
+	buf_t		*bp = xi->i_bp;
+	bd_queue_t	*bq = &bd->d_queues[xi->i_qnum];
 
-	mutex_enter(&bd->d_iomutex);
-	bd->d_qactive--;
-	kstat_runq_exit(bd->d_kiop);
-	list_remove(&bd->d_runq, xi);
-	mutex_exit(&bd->d_iomutex);
+	mutex_enter(&bq->q_iomutex);
+	bq->q_qactive--;
+	list_remove(&bq->q_runq, xi);
+	mutex_exit(&bq->q_iomutex);
 
+	mutex_enter(&bd->d_ksmutex);
+	kstat_runq_exit(bd->d_kiop);
 	if (err == 0) {
 		if (bp->b_flags & B_READ) {
 			bd->d_kiop->reads++;
@@ -1547,7 +1624,9 @@ bd_runq_exit(bd_xfer_impl_t *xi, int err)
 			bd->d_kiop->nwritten += (bp->b_bcount - xi->i_resid);
 		}
 	}
-	bd_sched(bd);
+	mutex_exit(&bd->d_ksmutex);
+
+	bd_sched(bd, bq);
 }
 
 static void
@@ -1707,6 +1786,92 @@ bd_flush_write_cache(bd_t *bd, struct dk_callback *dkc)
 	return (rv);
 }
 
+/*
+ * Maximum number of free or zero transfers in flight for one DKIOCFREE.
+ */
+#define	BD_FREE_BATCH	32
+
+/*
+ * Free (or, with DF_ZERO, zero) a byte range of a partition.  The range is
+ * split into transfers the driver can take and issued BD_FREE_BATCH at a
+ * time, spread across the submission queues like any other I/O.  Only
+ * whole blocks inside the range are freed; freeing is advisory, but
+ * zeroing is not, so a zero request must be block aligned.  We always wait
+ * for completion, so DF_WAIT_SYNC needs no special handling.
+ */
+static int
+bd_free_space(dev_t dev, bd_t *bd, dkioc_free_t *df)
+{
+	buf_t		*bps[BD_FREE_BATCH];
+	bd_xfer_impl_t	*xi;
+	diskaddr_t	p_lba;
+	diskaddr_t	p_nblks;
+	uint64_t	blk, end, maxblks, nblks;
+	uint32_t	shift = bd->d_blkshift;
+	int		(*func)(void *, bd_xfer_t *);
+	int		i, n;
+	int		rv = 0;
+
+	if (df->df_flags & DF_ZERO) {
+		func = bd->d_ops.o_zero;
+		maxblks = bd->d_zero_maxblks;
+		if ((P2PHASE(df->df_start, 1U << shift) != 0) ||
+		    (P2PHASE(df->df_length, 1U << shift) != 0))
+			return (EINVAL);
+	} else {
+		func = bd->d_ops.o_free;
+		maxblks = bd->d_free_maxblks;
+	}
+	if (func == NULL)
+		return (ENOTSUP);
+	if (bd->d_rdonly)
+		return (EROFS);
+	if (maxblks == 0)
+		maxblks = UINT64_MAX;
+
+	if (cmlb_partinfo(bd->d_cmlbh, BDPART(dev), &p_nblks, &p_lba,
+	    NULL, NULL, 0))
+		return (ENXIO);
+
+	blk = P2ROUNDUP(df->df_start, 1U << shift) >> shift;
+	end = (df->df_start + df->df_length) >> shift;
+	if (end > p_nblks || df->df_start + df->df_length < df->df_start)
+		return (EINVAL);
+
+	while (blk < end && rv == 0) {
+		for (n = 0; n < BD_FREE_BATCH && blk < end; n++) {
+			nblks = MIN(end - blk, maxblks);
+
+			bps[n] = getrbuf(KM_SLEEP);
+			bps[n]->b_resid = 0;
+			bps[n]->b_bcount = 0;
+			bps[n]->b_lblkno = blk;
+
+			xi = bd_xfer_alloc(bd, bps[n], func, KM_SLEEP);
+			if (xi == NULL) {
+				rv = geterror(bps[n]);
+				freerbuf(bps[n]);
+				break;
+			}
+			xi->i_flags = 0;
+			xi->i_blkno = p_lba + blk;
+			xi->i_nblks = nblks;
+			bd_submit(bd, xi);
+
+			blk += nblks;
+		}
+
+		for (i = 0; i < n; i++) {
+			(void) biowait(bps[i]);
+			if (rv == 0)
+				rv = geterror(bps[i]);
+			freerbuf(bps[i]);
+		}
+	}
+
+	return (rv);
+}
+
 /*
  * Nexus support.
  */
@@ -1751,7 +1916,11 @@ bd_alloc_handle(void *private, bd_ops_t *ops, ddi_dma_attr_t *dma, int kmflag)
 
 	hdl = kmem_zalloc(sizeof (*hdl), kmflag);
 	if (hdl != NULL) {
-		hdl->h_ops = *ops;
+		/* Version 0 drivers know nothing of o_free and o_zero. */
+		if (ops->o_version == BD_OPS_VERSION_0)
+			bcopy(ops, &hdl->h_ops, offsetof(bd_ops_t, o_free));
+		else
+			hdl->h_ops = *ops;
 		hdl->h_dma = dma;
 		hdl->h_private = private;
 	}
@@ -75,11 +75,16 @@
 #include <sys/file.h>
 #include <sys/sysmacros.h>
 #include <sys/zone.h>
+#include <sys/sunddi.h>
+#include <sys/ddidevmap.h>
+#include <sys/mman.h>
+#include <sys/atomic.h>
 
 #include <sys/socket.h>
 #include <sys/errno.h>
 #include <sys/poll.h>
 #include <sys/dlpi.h>
+#include <sys/ethernet.h>
 #include <sys/neti.h>
 
 #include <net/if.h>
@@ -106,6 +111,12 @@
  */
 #define	BPF_BUFSIZE (32 * 1024)
 
+/*
+ * The smallest frame in a capture ring leaves room for the frame header
+ * and the start of a packet.
+ */
+#define	BPF_RING_MINFRAME	64
+
 typedef void *(*cp_fn_t)(void *, const void *, size_t);
 
 /*
@@ -113,6 +124,10 @@ typedef void *(*cp_fn_t)(void *, const void *, size_t);
  */
 int bpf_bufsize = BPF_BUFSIZE;
 int bpf_maxbufsize = (16 * 1024 * 1024);
+/*
+ * The limit for the size of a BIOCSRING capture ring.
+ */
+size_t bpf_maxringsize = (256 * 1024 * 1024);
 static mod_hash_t *bpf_hash = NULL;
 
 /*
@@ -129,6 +144,7 @@ static bpf_kstats_t bpf_kstats = {
 	{ "receive",		KSTAT_DATA_UINT64 },
 	{ "captured",		KSTAT_DATA_UINT64 },
 	{ "dropped",		KSTAT_DATA_UINT64 },
+	{ "rxHookDropped",	KSTAT_DATA_UINT64 },
 };
 static kstat_t *bpf_ksp;
 
@@ -137,11 +153,24 @@ static kstat_t *bpf_ksp;
  */
 LIST_HEAD(, bpf_d) bpf_list;
 
+/*
+ * bpf_fanouts is the list of BIOCSFANOUT groups, protected by bpf_mtx.
+ * When both are needed, bd_lock is taken before bpf_mtx.
+ */
+static LIST_HEAD(, bpf_fanout) bpf_fanouts;
+
+extern dev_info_t *bpf_dev_info;
+
 static int	bpf_allocbufs(struct bpf_d *);
 static void	bpf_clear_timeout(struct bpf_d *);
 static void	bpf_deliver(struct bpf_d *, cp_fn_t,
-		    void *, uint_t, uint_t, boolean_t);
+		    void *, uint_t, uint_t, boolean_t, uint32_t);
 static void	bpf_freed(struct bpf_d *);
+static int	bpf_setring(struct bpf_d *, struct bpf_ring_req *);
+static int	bpf_setfanout(struct bpf_d *, uint_t, struct bpf_fanout **);
+static void	bpf_fanout_leave(struct bpf_d *);
+static uint32_t	bpf_flow_hash(struct bpf_d *, mblk_t *);
+static int	bpf_setrxhook(struct bpf_d *, struct bpf_program *);
 static int	bpf_ifname(struct bpf_d *d, char *, int);
 static void	*bpf_mcpy(void *, const void *, size_t);
 static int	bpf_attachd(struct bpf_d *, const char *, int);
@@ -152,6 +181,8 @@ static inline void
 		bpf_wakeup(struct bpf_d *);
 static void	catchpacket(struct bpf_d *, uchar_t *, uint_t, uint_t,
 		    cp_fn_t, struct timeval *);
+static void	catchpacket_ring(struct bpf_d *, uchar_t *, uint_t, uint_t,
+		    cp_fn_t, struct timeval *);
 static void	reset_d(struct bpf_d *);
 static int	bpf_getdltlist(struct bpf_d *, struct bpf_dltlist *);
 static int	bpf_setdlt(struct bpf_d *, void *);
@@ -317,6 +348,8 @@ next:
 	d->bd_dlt = nicdlt;
 	hdrlen = bpf_dl_hdrsize(nicdlt);
 	d->bd_hdrlen = BPF_WORDALIGN(hdrlen + SIZEOF_BPF_HDR) - hdrlen;
+	d->bd_ring_hdrlen = BPF_WORDALIGN(hdrlen +
+	    sizeof (struct bpf_ring_hdr)) - hdrlen;
 
 	(void) strlcpy(d->bd_ifname, MBPF_CLIENT_NAME(&d->bd_mac, mcip),
 	    sizeof (d->bd_ifname));
@@ -334,11 +367,23 @@ next:
 static void
 bpf_detachd(struct bpf_d *d)
 {
+	uintptr_t rxh;
 	uintptr_t mph;
 	uintptr_t mch;
 	uintptr_t mh;
 
 	ASSERT(d->bd_inuse == -1);
+	/*
+	 * A fanout group only holds descriptors attached to its link.
+	 */
+	if (d->bd_fanout != NULL) {
+		mutex_enter(&bpf_mtx);
+		bpf_fanout_leave(d);
+		mutex_exit(&bpf_mtx);
+	}
+
+	rxh = d->bd_rxhook_handle;
+	d->bd_rxhook_handle = 0;
 	mch = d->bd_mcip;
 	d->bd_mcip = 0;
 	mh = d->bd_bif;
@@ -371,6 +416,9 @@ bpf_detachd(struct bpf_d *d)
 	 * locks held that are part of the bpf_mtap() call path.
 	 */
 	mutex_exit(&d->bd_lock);
+	if (rxh != 0)
+		MBPF_RXHOOK_REMOVE(&d->bd_mac, rxh);
+
 	if (mph != 0)
 		MBPF_PROMISC_REMOVE(&d->bd_mac, mph);
 
@@ -387,6 +435,15 @@ bpf_detachd(struct bpf_d *d)
 	mutex_enter(&d->bd_lock);
 	*d->bd_ifname = '\0';
 	(void) memset(&d->bd_mac, 0, sizeof (d->bd_mac));
+
+	/*
+	 * A receive hook belongs to the interface it was set on.
+	 */
+	if (d->bd_rxhook != NULL) {
+		kmem_free(d->bd_rxhook, d->bd_rxhook_size);
+		d->bd_rxhook = NULL;
+		d->bd_rxhook_size = 0;
+	}
 }
 
 
@@ -420,6 +477,7 @@ bpfilterattach(void)
 	mutex_init(&bpf_mtx, NULL, MUTEX_DRIVER, NULL);
 
 	LIST_INIT(&bpf_list);
+	LIST_INIT(&bpf_fanouts);
 
 	return (0);
 }
@@ -587,6 +645,12 @@ bpfread(dev_t dev, struct uio *uio, cred_t *cred)
 	if ((d->bd_fmode & FREAD) == 0)
 		return (EBADF);
 
+	/*
+	 * With a capture ring, packets are only delivered to the ring.
+	 */
+	if (d->bd_ring != NULL)
+		return (EINVAL);
+
 	/*
 	 * Restrict application to use a buffer the same size as
 	 * the kernel buffers.
@@ -821,6 +885,9 @@ reset_d(struct bpf_d *d)
  *  BIOCVERSION		Get filter language version.
  *  BIOCGHDRCMPLT	Get "header already complete" flag.
  *  BIOCSHDRCMPLT	Set "header already complete" flag.
+ *  BIOCSRXHOOK		Set early receive drop filter.
+ *  BIOCSRING		Set up memory-mapped capture ring.
+ *  BIOCSFANOUT		Join or leave fanout group.
  */
 /* ARGSUSED */
 int
@@ -910,6 +977,57 @@ bpfioctl(dev_t dev, int cmd, intptr_t addr, int mode, cred_t *cred, int *rval)
 		error = bpf_setf(d, &prog);
 		break;
 
+	/*
+	 * Set early receive drop filter on the attached interface.
+	 */
+	case BIOCSRXHOOK:
+		if (ddi_copyin((void *)addr, &prog, sizeof (prog), mode)) {
+			error = EFAULT;
+			break;
+		}
+		error = bpf_setrxhook(d, &prog);
+		break;
+
+	/*
+	 * Set up a capture ring for mmap(2) in place of the read buffers.
+	 */
+	case BIOCSRING:
+		{
+			struct bpf_ring_req req;
+
+			if (copyin((void *)addr, &req, sizeof (req)) != 0) {
+				error = EFAULT;
+				break;
+			}
+			error = bpf_setring(d, &req);
+			if (error == 0 &&
+			    copyout(&req, (void *)addr, sizeof (req)) != 0)
+				error = EFAULT;
+			break;
+		}
+
+	/*
+	 * Join or leave a fanout group.
+	 */
+	case BIOCSFANOUT:
+		{
+			struct bpf_fanout *bf = NULL;
+			uint_t id;
+
+			if (copyin((void *)addr, &id, sizeof (id)) != 0) {
+				error = EFAULT;
+				break;
+			}
+			if (id != 0)
+				bf = kmem_zalloc(sizeof (*bf), KM_SLEEP);
+			mutex_enter(&d->bd_lock);
+			error = bpf_setfanout(d, id, &bf);
+			mutex_exit(&d->bd_lock);
+			if (bf != NULL)
+				kmem_free(bf, sizeof (*bf));
+			break;
+		}
+
 	/*
 	 * Flush read packet buffer.
 	 */
@@ -1129,6 +1247,19 @@ bpfioctl(dev_t dev, int cmd, intptr_t addr, int mode, cred_t *cred, int *rval)
 		error = bpf_setf(d, &prog);
 		break;
 	}
+
+	case BIOCSRXHOOK32: {
+		struct bpf_program32 prog32;
+
+		if (ddi_copyin((void *)addr, &prog32, sizeof (prog32), mode)) {
+			error = EFAULT;
+			break;
+		}
+		prog.bf_len = prog32.bf_len;
+		prog.bf_insns = (void *)(uint64_t)prog32.bf_insns;
+		error = bpf_setrxhook(d, &prog);
+		break;
+	}
 #endif
 
 	/*
@@ -1294,6 +1425,105 @@ bpf_setf(struct bpf_d *d, struct bpf_program *fp)
 	return (EINVAL);
 }
 
+/*
+ * Set the early receive hook program of d to fp and install it on the
+ * interface d is attached to. The provider runs the program on every
+ * inbound packet before the packet is classified or delivered anywhere,
+ * including to other bpf listeners, and drops those for which it returns
+ * zero. As with bpf_setf(), an "empty" program removes any existing hook.
+ * Dropping traffic affects every consumer of the link, so this requires
+ * the descriptor to be open for writing.
+ */
+static int
+bpf_setrxhook(struct bpf_d *d, struct bpf_program *fp)
+{
+	struct bpf_insn *fcode = NULL, *old;
+	uint_t flen, size = 0;
+	uintptr_t handle = 0;
+	uintptr_t oldhandle;
+	size_t oldsize;
+	int error = 0;
+
+	if ((d->bd_fmode & FWRITE) == 0)
+		return (EBADF);
+
+	if (fp->bf_insns == 0) {
+		if (fp->bf_len != 0)
+			return (EINVAL);
+	} else {
+		flen = fp->bf_len;
+		if (flen == 0 || flen > BPF_MAXINSNS)
+			return (EINVAL);
+
+		size = flen * sizeof (*fp->bf_insns);
+		fcode = kmem_alloc(size, KM_SLEEP);
+		if (copyin(fp->bf_insns, fcode, size) != 0) {
+			kmem_free(fcode, size);
+			return (EFAULT);
+		}
+		if (!bpf_validate(fcode, (int)flen)) {
+			kmem_free(fcode, size);
+			return (EINVAL);
+		}
+	}
+
+	mutex_enter(&d->bd_lock);
+	while (d->bd_inuse != 0) {
+		d->bd_waiting++;
+		if (cv_wait_sig(&d->bd_wait, &d->bd_lock) <= 0) {
+			d->bd_waiting--;
+			mutex_exit(&d->bd_lock);
+			if (fcode != NULL)
+				kmem_free(fcode, size);
+			return (EINTR);
+		}
+		d->bd_waiting--;
+	}
+	if (fcode != NULL && d->bd_bif == 0) {
+		mutex_exit(&d->bd_lock);
+		kmem_free(fcode, size);
+		return (EINVAL);
+	}
+	d->bd_inuse = -1;
+
+	/*
+	 * The running hook reads bd_rxhook without any lock, so the old
+	 * program can only be freed once the provider has removed the hook.
+	 * The new one is in place before its hook is added for the same
+	 * reason.
+	 */
+	oldhandle = d->bd_rxhook_handle;
+	old = d->bd_rxhook;
+	oldsize = d->bd_rxhook_size;
+	d->bd_rxhook_handle = 0;
+	mutex_exit(&d->bd_lock);
+
+	if (oldhandle != 0)
+		MBPF_RXHOOK_REMOVE(&d->bd_mac, oldhandle);
+
+	d->bd_rxhook = fcode;
+	d->bd_rxhook_size = size;
+	if (fcode != NULL) {
+		error = MBPF_RXHOOK_ADD(&d->bd_mac, d->bd_bif, d, &handle);
+		if (error != 0) {
+			d->bd_rxhook = NULL;
+			d->bd_rxhook_size = 0;
+			kmem_free(fcode, size);
+		}
+	}
+
+	mutex_enter(&d->bd_lock);
+	d->bd_rxhook_handle = handle;
+	d->bd_inuse = 0;
+	if (d->bd_waiting != 0)
+		cv_signal(&d->bd_wait);
+	mutex_exit(&d->bd_lock);
+
+	if (old != NULL)
+		kmem_free(old, oldsize);
+	return (error);
+}
+
 /*
  * Detach a file from its current interface (if attached at all) and attach
  * to the interface indicated by the name stored in ifname.
@@ -1345,7 +1575,7 @@ bpf_setif(struct bpf_d *d, char *ifname, int namesize)
 	d->bd_inuse = -1;
 	mutex_exit(&d->bd_lock);
 
-	if (d->bd_sbuf == 0)
+	if (d->bd_sbuf == 0 && d->bd_ring == NULL)
 		error = bpf_allocbufs(d);
 
 	if (error == 0) {
@@ -1415,7 +1645,26 @@ bpfchpoll(dev_t dev, short events, int anyyet, short *reventsp,
 		 * An imitation of the FIONREAD ioctl code.
 		 */
 		mutex_enter(&d->bd_lock);
-		if (d->bd_hlen != 0 ||
+		if (d->bd_ring != NULL) {
+			/*
+			 * The last frame filled is the first one the
+			 * application has yet to look at, if any.
+			 */
+			struct bpf_ring_hdr *rh;
+			uint_t last;
+
+			last = (d->bd_ring_next == 0 ? d->bd_ring_nframes :
+			    d->bd_ring_next) - 1;
+			rh = (struct bpf_ring_hdr *)(d->bd_ring +
+			    (size_t)last * d->bd_ring_fsize);
+			if (rh->brh_status == BPF_RING_USER) {
+				*reventsp |= events & (POLLIN | POLLRDNORM);
+			} else {
+				*reventsp = 0;
+				if (!anyyet)
+					*phpp = &d->bd_poll;
+			}
+		} else if (d->bd_hlen != 0 ||
 		    ((d->bd_immediate || d->bd_state == BPF_TIMED_OUT) &&
 		    d->bd_slen != 0)) {
 			*reventsp |= events & (POLLIN | POLLRDNORM);
@@ -1475,12 +1724,15 @@ bpf_mcpy(void *dst_arg, const void *src_arg, size_t len)
  * cpfn    a function that can copy marg into the listener's buffer
  * pktlen  length of the packet
  * issent  boolean indicating whether the packet was sent or receive
+ * hash    flow hash of the packet, if d is in a fanout group
  */
 static inline void
 bpf_deliver(struct bpf_d *d, cp_fn_t cpfn, void *marg, uint_t pktlen,
-    uint_t buflen, boolean_t issent)
+    uint_t buflen, boolean_t issent, uint32_t hash)
 {
+	struct bpf_fanout *bf;
 	struct timeval tv;
+	uint_t count;
 	uint_t slen;
 
 	if (!d->bd_seesent && issent)
@@ -1491,6 +1743,18 @@ bpf_deliver(struct bpf_d *d, cp_fn_t cpfn, void *marg, uint_t pktlen,
 	 * is important to protect even the outer ones.
 	 */
 	mutex_enter(&d->bd_lock);
+	if ((bf = d->bd_fanout) != NULL) {
+		/*
+		 * Only the member of the group the flow hashes to sees the
+		 * packet.  Other members may be joining or leaving, which
+		 * only moves the odd packet to the wrong member.
+		 */
+		count = bf->bf_count;
+		if (count != 0 && bf->bf_members[hash % count] != d) {
+			mutex_exit(&d->bd_lock);
+			return;
+		}
+	}
 	slen = bpf_filter(d->bd_filter, marg, pktlen, buflen);
 	DTRACE_PROBE5(bpf__packet, struct bpf_if *, d->bd_bif,
 	    struct bpf_d *, d, void *, marg, uint_t, pktlen, uint_t, slen);
@@ -1501,6 +1765,9 @@ bpf_deliver(struct bpf_d *d, cp_fn_t cpfn, void *marg, uint_t pktlen,
 		catchpacket(d, marg, pktlen, slen, cpfn, &tv);
 	}
 	mutex_exit(&d->bd_lock);
+
+	if (slen != 0 && d->bd_ring != NULL)
+		pollwakeup(&d->bd_poll, POLLIN | POLLRDNORM);
 }
 
 /*
@@ -1513,6 +1780,7 @@ bpf_mtap(void *arg, mac_resource_handle_t mrh, mblk_t *m, boolean_t issent)
 	cp_fn_t cpfn;
 	struct bpf_d *d = arg;
 	uint_t pktlen, buflen;
+	uint32_t hash;
 	void *marg;
 
 	pktlen = msgdsize(m);
@@ -1527,7 +1795,8 @@ bpf_mtap(void *arg, mac_resource_handle_t mrh, mblk_t *m, boolean_t issent)
 		buflen = 0;
 	}
 
-	bpf_deliver(d, cpfn, marg, pktlen, buflen, issent);
+	hash = (d->bd_fanout != NULL) ? bpf_flow_hash(d, m) : 0;
+	bpf_deliver(d, cpfn, marg, pktlen, buflen, issent, hash);
 }
 
 /*
@@ -1543,11 +1812,13 @@ bpf_itap(void *arg, mblk_t *m, boolean_t issent, uint_t length)
 {
 	hook_pkt_observe_t *hdr;
 	struct bpf_d *d = arg;
+	uint32_t hash;
 
 	hdr = (hook_pkt_observe_t *)m->b_rptr;
 	if (ntohl(hdr->hpo_ifindex) != d->bd_linkid)
 		return;
-	bpf_deliver(d, bpf_mcpy, m, length, 0, issent);
+	hash = (d->bd_fanout != NULL) ? bpf_flow_hash(d, m) : 0;
+	bpf_deliver(d, bpf_mcpy, m, length, 0, issent, hash);
 
 }
 
@@ -1570,6 +1841,10 @@ catchpacket(struct bpf_d *d, uchar_t *pkt, uint_t pktlen, uint_t snaplen,
 
 	++d->bd_ccount;
 	ks_stats.kp_capture.value.ui64++;
+	if (d->bd_ring != NULL) {
+		catchpacket_ring(d, pkt, pktlen, snaplen, cpfn, tv);
+		return;
+	}
 	/*
 	 * Figure out how many bytes to move.  If the packet is
 	 * greater or equal to the snapshot length, transfer that
@@ -1634,6 +1909,43 @@ catchpacket(struct bpf_d *d, uchar_t *pkt, uint_t pktlen, uint_t snaplen,
 		bpf_wakeup(d);
 }
 
+/*
+ * Move the packet data into the next frame of the capture ring, or drop
+ * the packet if the application has yet to give that frame back.  The
+ * frame is handed over by setting brh_status once the rest of it has been
+ * written.
+ */
+static void
+catchpacket_ring(struct bpf_d *d, uchar_t *pkt, uint_t pktlen,
+    uint_t snaplen, cp_fn_t cpfn, struct timeval *tv)
+{
+	struct bpf_ring_hdr *rh;
+	uint_t caplen;
+
+	rh = (struct bpf_ring_hdr *)(d->bd_ring +
+	    (size_t)d->bd_ring_next * d->bd_ring_fsize);
+	if (rh->brh_status != BPF_RING_KERNEL) {
+		++d->bd_dcount;
+		ks_stats.kp_dropped.value.ui64++;
+		return;
+	}
+
+	caplen = min(snaplen, pktlen);
+	if (caplen > d->bd_ring_fsize - d->bd_ring_hdrlen)
+		caplen = d->bd_ring_fsize - d->bd_ring_hdrlen;
+	(*cpfn)((uchar_t *)rh + d->bd_ring_hdrlen, pkt, caplen);
+	rh->brh_caplen = caplen;
+	rh->brh_datalen = pktlen;
+	rh->brh_hdrlen = (uint16_t)d->bd_ring_hdrlen;
+	rh->brh_tstamp.tv_sec = tv->tv_sec;
+	rh->brh_tstamp.tv_usec = tv->tv_usec;
+	membar_producer();
+	rh->brh_status = BPF_RING_USER;
+
+	if (++d->bd_ring_next == d->bd_ring_nframes)
+		d->bd_ring_next = 0;
+}
+
 /*
  * Initialize all nonzero fields of a descriptor.
  */
@@ -1674,6 +1986,242 @@ bpf_freed(struct bpf_d *d)
 	}
 	if (d->bd_filter)
 		kmem_free(d->bd_filter, d->bd_filter_size);
+	if (d->bd_ring != NULL)
+		ddi_umem_free(d->bd_ring_cookie);
+}
+
+/*
+ * Set up the capture ring described by req in place of the read buffers,
+ * and return the length to map in brr_mapsize.  The ring is allocated
+ * zeroed, so every frame starts out as BPF_RING_KERNEL.
+ */
+static int
+bpf_setring(struct bpf_d *d, struct bpf_ring_req *req)
+{
+	ddi_umem_cookie_t cookie;
+	caddr_t ring;
+	size_t size;
+
+	if (req->brr_framesize < BPF_RING_MINFRAME ||
+	    (req->brr_framesize & (BPF_ALIGNMENT - 1)) != 0 ||
+	    req->brr_nframes == 0 ||
+	    req->brr_nframes > bpf_maxringsize / req->brr_framesize)
+		return (EINVAL);
+	size = ptob(btopr((size_t)req->brr_framesize * req->brr_nframes));
+
+	mutex_enter(&d->bd_lock);
+	if (d->bd_bif != 0 || d->bd_ring != NULL) {
+		mutex_exit(&d->bd_lock);
+		return (EBUSY);
+	}
+	mutex_exit(&d->bd_lock);
+
+	ring = ddi_umem_alloc(size, DDI_UMEM_SLEEP, &cookie);
+
+	mutex_enter(&d->bd_lock);
+	if (d->bd_bif != 0 || d->bd_ring != NULL) {
+		mutex_exit(&d->bd_lock);
+		ddi_umem_free(cookie);
+		return (EBUSY);
+	}
+	d->bd_ring = ring;
+	d->bd_ring_cookie = cookie;
+	d->bd_ring_size = size;
+	d->bd_ring_fsize = req->brr_framesize;
+	d->bd_ring_nframes = req->brr_nframes;
+	d->bd_ring_next = 0;
+	mutex_exit(&d->bd_lock);
+
+	req->brr_mapsize = size;
+	return (0);
+}
+
+/*
+ * Map the capture ring into the application.
+ */
+/* ARGSUSED */
+int
+bpfdevmap(dev_t dev, devmap_cookie_t dhp, offset_t off, size_t len,
+    size_t *maplen, uint_t model)
+{
+	struct bpf_d *d = bpf_dev_get(getminor(dev));
+	int error;
+
+	if (d->bd_ring == NULL || off < 0 || (size_t)off >= d->bd_ring_size ||
+	    len > d->bd_ring_size - off)
+		return (EINVAL);
+
+	error = devmap_umem_setup(dhp, bpf_dev_info, NULL, d->bd_ring_cookie,
+	    off, len, PROT_READ | PROT_WRITE | PROT_USER, 0, NULL);
+	if (error == 0)
+		*maplen = len;
+	return (error);
+}
+
+/*
+ * Move d to the fanout group id, creating the group from *bfp if it does
+ * not exist yet; *bfp is cleared if it was used.  An id of 0 only leaves
+ * the current group.  Called with bd_lock held.
+ */
+static int
+bpf_setfanout(struct bpf_d *d, uint_t id, struct bpf_fanout **bfp)
+{
+	struct bpf_fanout *bf;
+	int error = 0;
+
+	ASSERT(MUTEX_HELD(&d->bd_lock));
+
+	if (id != 0 && d->bd_bif == 0)
+		return (EINVAL);
+	if (d->bd_fanout != NULL && d->bd_fanout->bf_id == id)
+		return (0);
+
+	mutex_enter(&bpf_mtx);
+	bpf_fanout_leave(d);
+	if (id == 0) {
+		mutex_exit(&bpf_mtx);
+		return (0);
+	}
+
+	LIST_FOREACH(bf, &bpf_fanouts, bf_next) {
+		if (bf->bf_id == id && bf->bf_zone == d->bd_zone)
+			break;
+	}
+	if (bf == NULL) {
+		bf = *bfp;
+		*bfp = NULL;
+		bf->bf_id = id;
+		bf->bf_zone = d->bd_zone;
+		bf->bf_linkid = d->bd_linkid;
+		LIST_INSERT_HEAD(&bpf_fanouts, bf, bf_next);
+	} else if (bf->bf_linkid != d->bd_linkid) {
+		error = EBUSY;
+	} else if (bf->bf_count == BPF_FANOUT_MAX) {
+		error = ENOSPC;
+	}
+
+	if (error == 0) {
+		bf->bf_members[bf->bf_count++] = d;
+		d->bd_fanout = bf;
+	}
+	mutex_exit(&bpf_mtx);
+	return (error);
+}
+
+/*
+ * Take d out of its fanout group, freeing the group once it is empty.
+ * Called with bd_lock and bpf_mtx held.
+ */
+static void
+bpf_fanout_leave(struct bpf_d *d)
+{
+	struct bpf_fanout *bf = d->bd_fanout;
+	uint_t i;
+
+	ASSERT(MUTEX_HELD(&d->bd_lock));
+	ASSERT(MUTEX_HELD(&bpf_mtx));
+
+	if (bf == NULL)
+		return;
+	d->bd_fanout = NULL;
+
+	for (i = 0; bf->bf_members[i] != d; i++)
+		;
+	bf->bf_count--;
+	bf->bf_members[i] = bf->bf_members[bf->bf_count];
+	bf->bf_members[bf->bf_count] = NULL;
+
+	if (bf->bf_count == 0) {
+		LIST_REMOVE(bf, bf_next);
+		kmem_free(bf, sizeof (*bf));
+	}
+}
+
+#define	BPF_HASH_HDRLEN	96	/* enough for link, IPv6 and port headers */
+#define	BPF_HASH_W(p)	\
+	(((uint32_t)(p)[0] << 24) | ((p)[1] << 16) | ((p)[2] << 8) | (p)[3])
+#define	BPF_HASH_H(p)	(((p)[0] << 8) | (p)[1])
+
+/*
+ * Hash the addresses and, when present, the ports of the IP packet in m
+ * to choose the fanout group member that sees it.  Both directions of a
+ * flow hash alike.  Packets that are not IP, or whose link header is not
+ * known, all hash to 0.
+ */
+static uint32_t
+bpf_flow_hash(struct bpf_d *d, mblk_t *m)
+{
+	uchar_t buf[BPF_HASH_HDRLEN];
+	uint_t len, off, hlen;
+	uint32_t h;
+	uchar_t proto;
+	mblk_t *bp;
+	uint_t n;
+	int i;
+
+	for (len = 0, bp = m; bp != NULL && len < sizeof (buf);
+	    bp = bp->b_cont) {
+		n = min(M_LEN(bp), sizeof (buf) - len);
+		bcopy(bp->b_rptr, buf + len, n);
+		len += n;
+	}
+
+	switch (d->bd_dlt) {
+	case DLT_EN10MB:
+		off = 14;
+		if (len >= 18 && BPF_HASH_H(buf + 12) == ETHERTYPE_VLAN)
+			off = 18;
+		if (len < off || (BPF_HASH_H(buf + off - 2) != ETHERTYPE_IP &&
+		    BPF_HASH_H(buf + off - 2) != ETHERTYPE_IPV6))
+			return (0);
+		break;
+	case DLT_IPNET:
+		off = 24;	/* hook_pkt_observe_t as seen by bpf */
+		break;
+	case DLT_RAW:
+		off = 0;
+		break;
+	default:
+		return (0);
+	}
+	if (len <= off)
+		return (0);
+
+	switch (buf[off] >> 4) {
+	case 4:
+		if (len < off + 20)
+			return (0);
+		hlen = (buf[off] & 0xf) << 2;
+		proto = buf[off + 9];
+		h = BPF_HASH_W(buf + off + 12) ^ BPF_HASH_W(buf + off + 16);
+		/* Only the first fragment has the ports */
+		if ((BPF_HASH_H(buf + off + 6) & 0x3fff) != 0)
+			proto = 0;
+		break;
+	case 6:
+		if (len < off + 40)
+			return (0);
+		hlen = 40;
+		proto = buf[off + 6];
+		for (h = 0, i = 8; i < 40; i += 4)
+			h ^= BPF_HASH_W(buf + off + i);
+		break;
+	default:
+		return (0);
+	}
+
+	switch (proto) {
+	case IPPROTO_TCP:
+	case IPPROTO_UDP:
+	case IPPROTO_SCTP:
+		if (len >= off + hlen + 4)
+			h ^= BPF_HASH_H(buf + off + hlen) ^
+			    BPF_HASH_H(buf + off + hlen + 2);
+		break;
+	}
+
+	h *= 0x9e3779b1;
+	return (h ^ (h >> 16));
 }
 
 /*
@@ -1813,6 +2361,48 @@ bpf_setdlt(struct bpf_d *d, void *addr)
 	return (error);
 }
 
+/*
+ * Receive hook installed on a MAC by BIOCSRXHOOK. Packets the descriptor's
+ * program returns zero for are freed, the rest are handed back to the MAC
+ * layer in their original order.
+ */
+mblk_t *
+bpf_rxhook(void *arg, mblk_t *mp_chain)
+{
+	struct bpf_d *d = arg;
+	struct bpf_insn *pc = d->bd_rxhook;
+	mblk_t *head = NULL;
+	mblk_t **tailp = &head;
+	mblk_t *mp, *next;
+	uint_t pktlen, buflen;
+	uchar_t *marg;
+
+	for (mp = mp_chain; mp != NULL; mp = next) {
+		next = mp->b_next;
+		mp->b_next = NULL;
+
+		if (mp->b_cont == NULL) {
+			marg = mtod(mp, uchar_t *);
+			pktlen = buflen = M_LEN(mp);
+		} else {
+			marg = (uchar_t *)mp;
+			pktlen = msgdsize(mp);
+			buflen = 0;
+		}
+
+		if (bpf_filter(pc, marg, pktlen, buflen) == 0) {
+			DTRACE_PROBE2(bpf__rxhook__drop, struct bpf_d *, d,
+			    mblk_t *, mp);
+			ks_stats.kp_rxhook_dropped.value.ui64++;
+			freemsg(mp);
+			continue;
+		}
+		*tailp = mp;
+		tailp = &mp->b_next;
+	}
+	return (head);
+}
+
 /*
  * bpf_clear_timeout is called with the bd_lock mutex held, providing it
  * with the necessary protection to retrieve and modify bd_callout but it
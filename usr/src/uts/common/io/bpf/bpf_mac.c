@@ -53,6 +53,8 @@ static const char *mac_bpf_client_name(uintptr_t);
 static int	mac_bpf_getdlt(uintptr_t, uint_t *);
 static int	mac_bpf_getlinkid(const char *, datalink_id_t *, zoneid_t);
 static int	mac_bpf_getzone(uintptr_t, zoneid_t *);
+static int	mac_bpf_rxhook_add(uintptr_t, void *, uintptr_t *);
+static void	mac_bpf_rxhook_remove(uintptr_t);
 
 bpf_provider_t bpf_mac = {
 	BPR_MAC,
@@ -69,7 +71,9 @@ bpf_provider_t bpf_mac = {
 	mac_bpf_client_name,
 	mac_bpf_client_open,
 	mac_bpf_getzone,
-	mac_bpf_getdlt
+	mac_bpf_getdlt,
+	mac_bpf_rxhook_add,
+	mac_bpf_rxhook_remove
 };
 
 /*ARGSUSED*/
@@ -187,3 +191,17 @@ mac_bpf_getdlt(uintptr_t handle, uint_t *dltp)
 
 	return (0);
 }
+
+static int
+mac_bpf_rxhook_add(uintptr_t mhandle, void *arg, uintptr_t *hookp)
+{
+	*hookp = (uintptr_t)mac_rx_hook_add((mac_handle_t)mhandle, bpf_rxhook,
+	    arg);
+	return (0);
+}
+
+static void
+mac_bpf_rxhook_remove(uintptr_t hhandle)
+{
+	mac_rx_hook_remove((mac_rx_hook_handle_t)hhandle);
+}
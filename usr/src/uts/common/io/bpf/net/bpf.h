@@ -147,12 +147,16 @@ struct bpf_version {
 #define	BIOCSSEESENT	 _IOW('B', 121, uint_t)
 #define	BIOCSRTIMEOUT	 _IOW('B', 122, struct timeval)
 #define	BIOCGRTIMEOUT	 _IOR('B', 123, struct timeval)
+#define	BIOCSRXHOOK	 _IOW('B', 124, struct bpf_program)
+#define	BIOCSRING	_IOWR('B', 125, struct bpf_ring_req)
+#define	BIOCSFANOUT	 _IOW('B', 126, uint_t)
 /*
  */
 #define	BIOCSETF32	 _IOW('B', 103, struct bpf_program32)
 #define	BIOCGDLTLIST32	_IOWR('B', 119, struct bpf_dltlist32)
 #define	BIOCSRTIMEOUT32	 _IOW('B', 122, struct timeval32)
 #define	BIOCGRTIMEOUT32	 _IOR('B', 123, struct timeval32)
+#define	BIOCSRXHOOK32	 _IOW('B', 124, struct bpf_program32)
 
 /*
  * Structure prepended to each packet. This is "wire" format, so we
@@ -188,6 +192,44 @@ struct bpf_hdr {
 #endif
 #endif
 
+/*
+ * Memory-mapped capture ring, set up with BIOCSRING before the descriptor
+ * is attached to an interface and then mapped with mmap(2) at offset 0.
+ * The ring is an array of brr_nframes frames of brr_framesize bytes, each
+ * starting with a bpf_ring_hdr.  The kernel fills the frames in order,
+ * handing each one to the application by setting brh_status to
+ * BPF_RING_USER; the application gives it back by resetting brh_status to
+ * BPF_RING_KERNEL.  Packets arriving while the next frame is still owned by
+ * the application are dropped.  The packet data starts brh_hdrlen bytes
+ * into the frame, and poll(2) reports POLLIN while a filled frame waits.
+ */
+struct bpf_ring_req {
+	uint32_t	brr_framesize;	/* bytes per frame, BPF_ALIGNMENT'ed */
+	uint32_t	brr_nframes;	/* number of frames */
+	uint64_t	brr_mapsize;	/* out: length to mmap */
+};
+
+struct bpf_ring_hdr {
+	volatile uint32_t brh_status;	/* BPF_RING_KERNEL or BPF_RING_USER */
+	uint32_t	brh_caplen;	/* length of captured portion */
+	uint32_t	brh_datalen;	/* original length of packet */
+	uint16_t	brh_hdrlen;	/* offset of the packet in the frame */
+	uint16_t	brh_pad;
+	struct bpf_timeval brh_tstamp;	/* time stamp */
+};
+
+#define	BPF_RING_KERNEL	0		/* frame may be filled */
+#define	BPF_RING_USER	1		/* frame holds a packet */
+
+/*
+ * BIOCSFANOUT puts an attached descriptor in the fanout group with the
+ * given non-zero id; each packet seen on the interface is then delivered
+ * to only one member of the group, chosen by a hash of its flow.  All
+ * members of a group must be attached to the same interface.  An id of 0
+ * leaves the group.
+ */
+#define	BPF_FANOUT_MAX	64		/* members in a fanout group */
+
 /* Pull in data-link level type codes. */
 #include <net/dlt.h>
 
@@ -286,6 +328,7 @@ extern void	bpfdetach(uintptr_t);
 extern uint_t	bpf_filter(struct bpf_insn *, uchar_t *, uint_t, uint_t);
 extern void	bpf_itap(void *, mblk_t *, boolean_t, uint_t);
 extern void	bpf_mtap(void *, mac_resource_handle_t, mblk_t *, boolean_t);
+extern mblk_t	*bpf_rxhook(void *, mblk_t *);
 extern int	bpf_validate(struct bpf_insn *, int);
 
 #endif /* _KERNEL */
@@ -49,6 +49,7 @@
 #include <sys/mutex.h>
 #include <sys/condvar.h>
 #include <sys/queue.h>
+#include <sys/dditypes.h>
 
 /*
  * Access to "layer 2" networking is provided through each such provider
@@ -74,6 +75,8 @@ typedef struct bpf_provider_s {
 	int		(*bpr_client_open)(uintptr_t, uintptr_t *);
 	int		(*bpr_getzone)(uintptr_t, zoneid_t *);
 	int		(*bpr_getdlt)(uintptr_t, uint_t *);
+	int		(*bpr_rxhook_add)(uintptr_t, void *, uintptr_t *);
+	void		(*bpr_rxhook_remove)(uintptr_t);
 } bpf_provider_t;
 
 typedef struct bpf_provider_list {
@@ -106,6 +109,8 @@ typedef struct bpf_provider_list {
 #define	MBPF_GET_ZONE(_m, _h, _zp)	(_m)->bpr_getzone(_h, _zp)
 #define	MBPF_GET_DLT(_m, _h, _dp)	(_m)->bpr_getdlt(_h, _dp);
 #define	MBPF_GET_HDRLEN(_m, _h, _dp)	(_m)->bpr_gethdrlen(_h, _dp);
+#define	MBPF_RXHOOK_ADD(_m, _h, _d, _p)	(_m)->bpr_rxhook_add(_h, _d, _p)
+#define	MBPF_RXHOOK_REMOVE(_m, _h)	(_m)->bpr_rxhook_remove(_h)
 
 
 /*
@@ -177,6 +182,38 @@ struct bpf_d {
 	 * be kept across changing DLT or network interface.
 	 */
 	int		bd_promisc_flags;
+	/*
+	 * Program run by the provider on inbound packets before they are
+	 * delivered, and the handle of the hook that runs it.
+	 */
+	struct bpf_insn	*bd_rxhook;
+	size_t		bd_rxhook_size;
+	uintptr_t	bd_rxhook_handle;
+	/*
+	 * Memory-mapped capture ring set up by BIOCSRING.  When bd_ring is
+	 * set, packets are put in the ring rather than the read buffers.
+	 */
+	caddr_t		bd_ring;
+	ddi_umem_cookie_t bd_ring_cookie;
+	size_t		bd_ring_size;	/* mapped length */
+	uint_t		bd_ring_fsize;	/* bytes per frame */
+	uint_t		bd_ring_nframes;
+	uint_t		bd_ring_next;	/* next frame to fill */
+	int		bd_ring_hdrlen;	/* offset of packet in a frame */
+	struct bpf_fanout *bd_fanout;	/* fanout group joined, if any */
+};
+
+/*
+ * A fanout group set up by BIOCSFANOUT.  Groups are named by an id that
+ * is private to the zone, and hold descriptors attached to one link.
+ */
+struct bpf_fanout {
+	LIST_ENTRY(bpf_fanout) bf_next;
+	uint_t		bf_id;
+	zoneid_t	bf_zone;
+	datalink_id_t	bf_linkid;
+	uint_t		bf_count;	/* members in bf_members */
+	struct bpf_d	*bf_members[BPF_FANOUT_MAX];
 };
 
 
@@ -211,6 +248,7 @@ typedef struct bpf_kstats_s {
 	kstat_named_t	kp_receive;
 	kstat_named_t	kp_capture;
 	kstat_named_t	kp_dropped;
+	kstat_named_t	kp_rxhook_dropped;
 } bpf_kstats_t;
 
 int	 bpf_setf(struct bpf_d *, struct bpf_program *);
@@ -31,10 +31,14 @@
  */
 
 #include <sys/types.h>
+#include <sys/atomic.h>
 #include <sys/bitmap.h>
 #include <sys/cmn_err.h>
 #include <sys/conf.h>
+#include <sys/cpu.h>
+#include <sys/cpuvar.h>
 #include <sys/ddi.h>
+#include <sys/disp.h>
 #include <sys/errno.h>
 #include <sys/kstat.h>
 #include <sys/modctl.h>
@@ -115,6 +119,12 @@
  *   thread that's forwarding a packet to a known destination holds a reference
  *   to a forwarding entry.
  *
+ *   Entries in the tree are also on the bi_fwdhash chains, which the data
+ *   path searches without bi_rwlock between fwd_walk_enter() and
+ *   fwd_walk_exit().  So when an entry is removed, the tree's reference is
+ *   handed to fwd_retire() rather than dropped; fwd_reclaim() drops it once
+ *   every walk that might have found the entry has finished.
+ *
  * TRILL notes:
  *
  *   The TRILL module does all of its I/O through bridging.  It uses references
@@ -186,9 +196,38 @@ static timeout_id_t bridge_timerid;
 static clock_t bridge_scan_interval;
 static clock_t bridge_fwd_age;
 
+/*
+ * Number of bi_fwdhash chains in each bridge instance; rounded up to a power
+ * of two.
+ */
+uint_t bridge_fwd_hash_size = 1024;
+
+#define	FWD_HASH(bip, addr)						\
+	((((uint_t)(addr)[3] << 16) ^ ((uint_t)(addr)[4] << 8) ^	\
+	(addr)[5] ^ ((uint_t)(addr)[2] << 4)) & (bip)->bi_fwdhashmask)
+
+/*
+ * State for lockless bi_fwdhash walks, one per CPU.  bc_active is non-zero
+ * while a walk is in progress on the CPU, and bc_gen changes each time the
+ * outermost walk finishes.
+ */
+typedef struct bridge_cpu_s {
+	volatile uint_t	bc_active;
+	volatile uint_t	bc_gen;
+	uchar_t		bc_pad[64 - 2 * sizeof (uint_t)];
+} bridge_cpu_t;
+
+static bridge_cpu_t *bridge_cpu;
+
+/* Entries removed from bi_fwd whose tree reference is yet to be dropped */
+static kmutex_t fwd_limbo_lock;
+static struct bridge_fwd_s *fwd_limbo;
+static boolean_t fwd_reclaim_pending;
+
 static bridge_inst_t *bridge_find_name(const char *);
 static void bridge_timer(void *);
 static void bridge_unref(bridge_inst_t *);
+static void fwd_unref(struct bridge_fwd_s *);
 
 static const uint8_t zero_addr[ETHERADDRL] = { 0 };
 
@@ -691,6 +730,8 @@ inst_free(bridge_inst_t *bip)
 	list_destroy(&bip->bi_links);
 	cv_destroy(&bip->bi_linkwait);
 	avl_destroy(&bip->bi_fwd);
+	kmem_free(bip->bi_fwdhash,
+	    (bip->bi_fwdhashmask + 1) * sizeof (bridge_fwd_t *));
 	if (bip->bi_ksp != NULL)
 		kstat_delete(bip->bi_ksp);
 	kmem_free(bip, sizeof (*bip));
@@ -700,6 +741,7 @@ static bridge_inst_t *
 inst_alloc(const char *bridge)
 {
 	bridge_inst_t *bip;
+	uint_t nchains;
 
 	bip = kmem_zalloc(sizeof (*bip), KM_SLEEP);
 	bip->bi_refs = 1;
@@ -710,6 +752,10 @@ inst_alloc(const char *bridge)
 	cv_init(&bip->bi_linkwait, NULL, CV_DRIVER, NULL);
 	avl_create(&bip->bi_fwd, fwd_compare, sizeof (bridge_fwd_t),
 	    offsetof(bridge_fwd_t, bf_node));
+	nchains = 1U << highbit(MAX(bridge_fwd_hash_size, 2) - 1);
+	bip->bi_fwdhash = kmem_zalloc(nchains * sizeof (bridge_fwd_t *),
+	    KM_SLEEP);
+	bip->bi_fwdhashmask = nchains - 1;
 	return (bip);
 }
 
@@ -908,29 +954,184 @@ fwd_alloc(const uint8_t *addr, uint_t nlinks, uint16_t nick)
 	return (bfp);
 }
 
+/*
+ * Lockless walks of bi_fwdhash.  A walk runs with preemption disabled, and
+ * doesn't block.  It may find entries that are being removed, so it must take
+ * a reference on an entry it wants to use after fwd_walk_exit().  Walks may
+ * nest, when an interrupt handler walks on a CPU whose thread was walking.
+ */
+static bridge_cpu_t *
+fwd_walk_enter(void)
+{
+	bridge_cpu_t *bcp;
+
+	kpreempt_disable();
+	bcp = &bridge_cpu[CPU->cpu_seqid];
+	bcp->bc_active++;
+	membar_enter();
+	return (bcp);
+}
+
+static void
+fwd_walk_exit(bridge_cpu_t *bcp)
+{
+	membar_exit();
+	if (bcp->bc_active == 1)
+		bcp->bc_gen++;
+	bcp->bc_active--;
+	kpreempt_enable();
+}
+
+/*
+ * Wait until every walk in progress when we were called has finished.  Walks
+ * are short, so we just spin.  Must not be called from a context that could
+ * have interrupted a walk.
+ */
+static void
+fwd_sync(void)
+{
+	bridge_cpu_t *bcp;
+	uint_t gen;
+	int i;
+
+	membar_enter();
+	for (i = 0; i < max_ncpus; i++) {
+		bcp = &bridge_cpu[i];
+		if (bcp->bc_active == 0)
+			continue;
+		gen = bcp->bc_gen;
+		while (bcp->bc_active != 0 && bcp->bc_gen == gen)
+			SMT_PAUSE();
+	}
+}
+
+/*
+ * Find the entry for a destination in bi_fwdhash.  As with the AVL tree, an
+ * IVL duplicate (BFF_VLANLOCAL) is used if there's one for the VLAN;
+ * otherwise, the main entry for the address is.  Must be called within a walk.
+ */
 static bridge_fwd_t *
-fwd_find(bridge_inst_t *bip, const uint8_t *addr, uint16_t vlanid)
+fwd_lookup(bridge_inst_t *bip, const uint8_t *addr, uint16_t vlanid)
 {
 	bridge_fwd_t *bfp, *vbfp;
-	bridge_fwd_t match;
+	bridge_fwd_t *head = bip->bi_fwdhash[FWD_HASH(bip, addr)];
 
-	bcopy(addr, match.bf_dest, ETHERADDRL);
-	match.bf_flags = 0;
-	rw_enter(&bip->bi_rwlock, RW_READER);
-	if ((bfp = avl_find(&bip->bi_fwd, &match, NULL)) != NULL) {
-		if (bfp->bf_vlanid != vlanid && bfp->bf_vcnt > 0) {
-			match.bf_vlanid = vlanid;
-			match.bf_flags = BFF_VLANLOCAL;
-			vbfp = avl_find(&bip->bi_fwd, &match, NULL);
-			if (vbfp != NULL)
+	for (bfp = head; bfp != NULL; bfp = bfp->bf_hnext) {
+		if (!(bfp->bf_flags & BFF_VLANLOCAL) &&
+		    bcmp(bfp->bf_dest, addr, ETHERADDRL) == 0)
+			break;
+	}
+	if (bfp != NULL && bfp->bf_vlanid != vlanid && bfp->bf_vcnt > 0) {
+		for (vbfp = head; vbfp != NULL; vbfp = vbfp->bf_hnext) {
+			if (vbfp->bf_vlanid == vlanid &&
+			    bcmp(vbfp->bf_dest, addr, ETHERADDRL) == 0) {
 				bfp = vbfp;
+				break;
+			}
 		}
-		atomic_inc_uint(&bfp->bf_refs);
 	}
-	rw_exit(&bip->bi_rwlock);
 	return (bfp);
 }
 
+static bridge_fwd_t *
+fwd_find(bridge_inst_t *bip, const uint8_t *addr, uint16_t vlanid)
+{
+	bridge_cpu_t *bcp;
+	bridge_fwd_t *bfp;
+
+	bcp = fwd_walk_enter();
+	if ((bfp = fwd_lookup(bip, addr, vlanid)) != NULL)
+		atomic_inc_uint(&bfp->bf_refs);
+	fwd_walk_exit(bcp);
+	return (bfp);
+}
+
+/*
+ * Add an entry to bi_fwd, at the given AVL index, and to bi_fwdhash.  The
+ * entry must be complete, as walks can find it at once.
+ */
+static void
+fwd_link(bridge_inst_t *bip, bridge_fwd_t *bfp, avl_index_t idx)
+{
+	bridge_fwd_t **bfpp = &bip->bi_fwdhash[FWD_HASH(bip, bfp->bf_dest)];
+
+	ASSERT(RW_WRITE_HELD(&bip->bi_rwlock));
+	avl_insert(&bip->bi_fwd, bfp, idx);
+	bfp->bf_hnext = *bfpp;
+	membar_producer();
+	*bfpp = bfp;
+}
+
+/*
+ * Remove an entry from bi_fwd and bi_fwdhash.  bf_hnext is left alone so that
+ * walks looking at the entry can step off it.  The caller passes the tree
+ * reference to fwd_retire().
+ */
+static void
+fwd_unlink(bridge_inst_t *bip, bridge_fwd_t *bfp)
+{
+	bridge_fwd_t **bfpp = &bip->bi_fwdhash[FWD_HASH(bip, bfp->bf_dest)];
+
+	ASSERT(RW_WRITE_HELD(&bip->bi_rwlock));
+	ASSERT(bfp->bf_flags & BFF_INTREE);
+	while (*bfpp != bfp) {
+		ASSERT(*bfpp != NULL);
+		bfpp = &(*bfpp)->bf_hnext;
+	}
+	*bfpp = bfp->bf_hnext;
+	avl_remove(&bip->bi_fwd, bfp);
+	bfp->bf_flags &= ~BFF_INTREE;
+}
+
+/*
+ * Free the entries on fwd_limbo once no walk can be looking at them.  This
+ * runs on bridge_taskq, as fwd_sync() can't be called from the receive path.
+ */
+/* ARGSUSED */
+static void
+fwd_reclaim(void *arg)
+{
+	bridge_fwd_t *bfp, *bfnext;
+
+	mutex_enter(&fwd_limbo_lock);
+	bfnext = fwd_limbo;
+	fwd_limbo = NULL;
+	fwd_reclaim_pending = B_FALSE;
+	mutex_exit(&fwd_limbo_lock);
+
+	fwd_sync();
+	while ((bfp = bfnext) != NULL) {
+		bfnext = bfp->bf_limbo;
+		fwd_unref(bfp);		/* drop tree reference */
+	}
+}
+
+static void
+fwd_reclaim_kick(void)
+{
+	mutex_enter(&fwd_limbo_lock);
+	if (fwd_limbo != NULL && !fwd_reclaim_pending) {
+		fwd_reclaim_pending = (ddi_taskq_dispatch(bridge_taskq,
+		    fwd_reclaim, NULL, DDI_NOSLEEP) == DDI_SUCCESS);
+	}
+	mutex_exit(&fwd_limbo_lock);
+}
+
+/*
+ * Drop the tree reference of an entry taken out by fwd_unlink().  If the
+ * reclaim can't be dispatched now, bridge_timer() tries again.
+ */
+static void
+fwd_retire(bridge_fwd_t *bfp)
+{
+	ASSERT(!(bfp->bf_flags & BFF_INTREE));
+	mutex_enter(&fwd_limbo_lock);
+	bfp->bf_limbo = fwd_limbo;
+	fwd_limbo = bfp;
+	mutex_exit(&fwd_limbo_lock);
+	fwd_reclaim_kick();
+}
+
 static void
 fwd_free(bridge_fwd_t *bfp)
 {
@@ -965,8 +1166,7 @@ fwd_delete(bridge_fwd_t *bfp)
 		rw_enter(&bip->bi_rwlock, RW_WRITER);
 		/* Another thread could beat us to this */
 		if (bfp->bf_flags & BFF_INTREE) {
-			avl_remove(&bip->bi_fwd, bfp);
-			bfp->bf_flags &= ~BFF_INTREE;
+			fwd_unlink(bip, bfp);
 			if (bfp->bf_flags & BFF_VLANLOCAL) {
 				bfp->bf_flags &= ~BFF_VLANLOCAL;
 				bfpzero = avl_find(&bip->bi_fwd, bfp, NULL);
@@ -974,7 +1174,7 @@ fwd_delete(bridge_fwd_t *bfp)
 					bfpzero->bf_vcnt--;
 			}
 			rw_exit(&bip->bi_rwlock);
-			fwd_unref(bfp);		/* no longer in avl tree */
+			fwd_retire(bfp);	/* no longer in avl tree */
 		} else {
 			rw_exit(&bip->bi_rwlock);
 		}
@@ -991,9 +1191,9 @@ fwd_insert(bridge_inst_t *bip, bridge_fwd_t *bfp)
 	if (!(bip->bi_flags & BIF_SHUTDOWN) &&
 	    avl_numnodes(&bip->bi_fwd) < bip->bi_tablemax &&
 	    avl_find(&bip->bi_fwd, bfp, &idx) == NULL) {
-		avl_insert(&bip->bi_fwd, bfp, idx);
 		bfp->bf_flags |= BFF_INTREE;
 		atomic_inc_uint(&bfp->bf_refs);	/* avl entry */
+		fwd_link(bip, bfp, idx);
 		retv = B_TRUE;
 	} else {
 		retv = B_FALSE;
@@ -1046,15 +1246,14 @@ fwd_update_local(bridge_link_t *blp, const uint8_t *oldaddr,
 		}
 		/* If no more links, then remove and free up */
 		if (bfp->bf_nlinks == 0) {
-			avl_remove(&bip->bi_fwd, bfp);
-			bfp->bf_flags &= ~BFF_INTREE;
+			fwd_unlink(bip, bfp);
 		} else {
 			bfp = NULL;
 		}
 	}
 	rw_exit(&bip->bi_rwlock);
 	if (bfp != NULL)
-		fwd_unref(bfp);		/* no longer in avl tree */
+		fwd_retire(bfp);	/* no longer in avl tree */
 
 	/*
 	 * Now get the new link address and add this link to the list.  The
@@ -1082,8 +1281,7 @@ no_old_addr:
 		    RBRIDGE_NICKNAME_NONE);
 		if (bfnew != NULL) {
 			KIINCR(bki_count);
-			avl_remove(&bip->bi_fwd, bfp);
-			bfp->bf_flags &= ~BFF_INTREE;
+			fwd_unlink(bip, bfp);
 			bfnew->bf_nlinks = bfp->bf_nlinks;
 			bcopy(bfp->bf_links, bfnew->bf_links,
 			    bfp->bf_nlinks * sizeof (bfp));
@@ -1101,9 +1299,9 @@ no_old_addr:
 
 		if (bfnew != bfp) {
 			/* local addresses are not subject to table limits */
-			avl_insert(&bip->bi_fwd, bfnew, idx);
 			bfnew->bf_flags |= (BFF_INTREE | BFF_LOCALADDR);
 			atomic_inc_uint(&bfnew->bf_refs);	/* avl entry */
+			fwd_link(bip, bfnew, idx);
 		}
 	}
 	rw_exit(&bip->bi_rwlock);
@@ -1115,7 +1313,7 @@ no_new_addr:
 	 * the AVL tree above.
 	 */
 	if (bfnew != NULL && bfp != NULL && bfnew != bfp)
-		fwd_unref(bfp);
+		fwd_retire(bfp);
 
 	/* Account for removed entry. */
 	if (drop_ref)
@@ -1193,8 +1391,7 @@ link_shutdown(void *arg)
 				bfp->bf_links[i] = bfp->bf_links[i + 1];
 		} else {
 			ASSERT(bfp->bf_flags & BFF_INTREE);
-			avl_remove(&bip->bi_fwd, bfp);
-			bfp->bf_flags &= ~BFF_INTREE;
+			fwd_unlink(bip, bfp);
 			avl_add(&fwd_scavenge, bfp);
 		}
 	}
@@ -1203,7 +1400,7 @@ link_shutdown(void *arg)
 	while ((bfp = bfnext) != NULL) {
 		bfnext = AVL_NEXT(&fwd_scavenge, bfp);
 		avl_remove(&fwd_scavenge, bfp);
-		fwd_unref(bfp);
+		fwd_retire(bfp);
 	}
 	avl_destroy(&fwd_scavenge);
 
@@ -1434,8 +1631,7 @@ bridge_timer(void *arg)
 			if (!(bfp->bf_flags & BFF_LOCALADDR) &&
 			    (ddi_get_lbolt() - bfp->bf_lastheard) > age_limit) {
 				ASSERT(bfp->bf_flags & BFF_INTREE);
-				avl_remove(&bip->bi_fwd, bfp);
-				bfp->bf_flags &= ~BFF_INTREE;
+				fwd_unlink(bip, bfp);
 				avl_add(&fwd_scavenge, bfp);
 			}
 		}
@@ -1453,11 +1649,12 @@ bridge_timer(void *arg)
 			bfnext = AVL_NEXT(&fwd_scavenge, bfp);
 			avl_remove(&fwd_scavenge, bfp);
 			KIINCR(bki_expire);
-			fwd_unref(bfp);	/* drop tree reference */
+			fwd_retire(bfp);	/* drop tree reference */
 		}
 	}
 	mutex_exit(&inst_lock);
 	avl_destroy(&fwd_scavenge);
+	fwd_reclaim_kick();
 
 	/*
 	 * Scan the bridge_mac_t entries and try to free up the ones that are
@@ -1571,6 +1768,8 @@ bridge_learn(bridge_link_t *blp, const uint8_t *saddr, uint16_t ingress_nick,
 {
 	bridge_inst_t *bip = blp->bl_inst;
 	bridge_fwd_t *bfp, *bfpnew;
+	bridge_cpu_t *bcp;
+	clock_t now;
 	int i;
 	boolean_t replaced = B_FALSE;
 
@@ -1582,8 +1781,13 @@ bridge_learn(bridge_link_t *blp, const uint8_t *saddr, uint16_t ingress_nick,
 	 * If the source is known, then check whether it belongs on this link.
 	 * If not, and this isn't a fixed local address, then we've detected a
 	 * move.  If it's not known, learn it.
+	 *
+	 * This is done for every packet, so the common case of a known source
+	 * is handled within the walk, without taking a reference on the entry,
+	 * and bf_lastheard is written only when it changes.
 	 */
-	if ((bfp = fwd_find(bip, saddr, vlanid)) != NULL) {
+	bcp = fwd_walk_enter();
+	if ((bfp = fwd_lookup(bip, saddr, vlanid)) != NULL) {
 		/*
 		 * If the packet has a fixed local source address, then there's
 		 * nothing we can learn.  We must quit.  If this was a received
@@ -1592,7 +1796,7 @@ bridge_learn(bridge_link_t *blp, const uint8_t *saddr, uint16_t ingress_nick,
 		 * that's the normal case.
 		 */
 		if (bfp->bf_flags & BFF_LOCALADDR) {
-			fwd_unref(bfp);
+			fwd_walk_exit(bcp);
 			return;
 		}
 
@@ -1604,13 +1808,17 @@ bridge_learn(bridge_link_t *blp, const uint8_t *saddr, uint16_t ingress_nick,
 		if (bfp->bf_trill_nick == ingress_nick) {
 			for (i = 0; i < bfp->bf_nlinks; i++) {
 				if (bfp->bf_links[i] == blp) {
-					bfp->bf_lastheard = ddi_get_lbolt();
-					fwd_unref(bfp);
+					now = ddi_get_lbolt();
+					if (bfp->bf_lastheard != now)
+						bfp->bf_lastheard = now;
+					fwd_walk_exit(bcp);
 					return;
 				}
 			}
 		}
+		atomic_inc_uint(&bfp->bf_refs);
 	}
+	fwd_walk_exit(bcp);
 
 	/*
 	 * Note that we intentionally "unlearn" things that appear to be under
@@ -2667,8 +2875,7 @@ bridge_trill_flush(bridge_link_t *blp, uint16_t vlan, boolean_t dotrill)
 				continue;
 		}
 		ASSERT(bfp->bf_flags & BFF_INTREE);
-		avl_remove(&bip->bi_fwd, bfp);
-		bfp->bf_flags &= ~BFF_INTREE;
+		fwd_unlink(bip, bfp);
 		avl_add(&fwd_scavenge, bfp);
 	}
 	rw_exit(&bip->bi_rwlock);
@@ -2676,7 +2883,7 @@ bridge_trill_flush(bridge_link_t *blp, uint16_t vlan, boolean_t dotrill)
 	while ((bfp = bfnext) != NULL) {
 		bfnext = AVL_NEXT(&fwd_scavenge, bfp);
 		avl_remove(&fwd_scavenge, bfp);
-		fwd_unref(bfp);
+		fwd_retire(bfp);
 	}
 	avl_destroy(&fwd_scavenge);
 }
@@ -3271,8 +3478,7 @@ bridge_ioctl(queue_t *wq, mblk_t *mp)
 					continue;
 			}
 			ASSERT(bfp->bf_flags & BFF_INTREE);
-			avl_remove(&bip->bi_fwd, bfp);
-			bfp->bf_flags &= ~BFF_INTREE;
+			fwd_unlink(bip, bfp);
 			avl_add(&fwd_scavenge, bfp);
 		}
 		rw_exit(&bip->bi_rwlock);
@@ -3280,7 +3486,7 @@ bridge_ioctl(queue_t *wq, mblk_t *mp)
 		while ((bfp = bfnext) != NULL) {
 			bfnext = AVL_NEXT(&fwd_scavenge, bfp);
 			avl_remove(&fwd_scavenge, bfp);
-			fwd_unref(bfp);	/* drop tree reference */
+			fwd_retire(bfp);	/* drop tree reference */
 		}
 		avl_destroy(&fwd_scavenge);
 		break;
@@ -3332,6 +3538,9 @@ bridge_inst_init(void)
 	bridge_scan_interval = 5 * drv_usectohz(1000000);
 	bridge_fwd_age = 25 * drv_usectohz(1000000);
 
+	bridge_cpu = kmem_zalloc(max_ncpus * sizeof (bridge_cpu_t), KM_SLEEP);
+	mutex_init(&fwd_limbo_lock, NULL, MUTEX_DRIVER, NULL);
+
 	rw_init(&bmac_rwlock, NULL, RW_DRIVER, NULL);
 	list_create(&bmac_list, sizeof (bridge_mac_t),
 	    offsetof(bridge_mac_t, bm_node));
@@ -3364,6 +3573,9 @@ bridge_inst_fini(void)
 	mutex_destroy(&inst_lock);
 	cv_destroy(&stream_ref_cv);
 	mutex_destroy(&stream_ref_lock);
+	ASSERT(fwd_limbo == NULL);
+	mutex_destroy(&fwd_limbo_lock);
+	kmem_free(bridge_cpu, max_ncpus * sizeof (bridge_cpu_t));
 }
 
 /*
@@ -3410,6 +3622,7 @@ bridge_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 
 	ddi_remove_minor_node(dip, NULL);
 	ddi_taskq_destroy(bridge_taskq);
+	fwd_reclaim(NULL);	/* in case a dispatch failed */
 	bridge_dev_info = NULL;
 	return (DDI_SUCCESS);
 }
@@ -3688,23 +3688,25 @@ out:
 }
 
 /*
- * Unmap a region in a volume.  Currently only supported for zvols.
+ * Unmap the next regions in ext in a volume.  Currently only supported
+ * for zvols.  The regions are made stable together once the last of them
+ * has been freed.
  */
 int
-sbd_unmap(sbd_lu_t *sl, uint64_t offset, uint64_t length)
+sbd_unmap(sbd_lu_t *sl, sbd_unmap_ext_t *ext, uint_t next)
 {
 	vnode_t *vp;
 	int unused;
+	int ret = 0;
+	uint_t i;
 	dkioc_free_t df;
 
 	/* Right now, we only support UNMAP on zvols. */
 	if (!(sl->sl_flags & SL_ZFS_META))
 		return (EIO);
 
-	df.df_flags = (sl->sl_flags & SL_WRITEBACK_CACHE_DISABLE) ?
-	    DF_WAIT_SYNC : 0;
-	df.df_start = offset;
-	df.df_length = length;
+	if (sl->sl_flags & SL_CALL_ZVOL)
+		return (sbd_zvol_unmap(sl, ext, next));
 
 	/* Use the data vnode we have to send a fop_ioctl(). */
 	vp = sl->sl_data_vp;
@@ -3713,6 +3715,17 @@ sbd_unmap(sbd_lu_t *sl, uint64_t offset, uint64_t length)
 		return (EIO);
 	}
 
-	return (VOP_IOCTL(vp, DKIOCFREE, (intptr_t)(&df), FKIOCTL, kcred,
-	    &unused, NULL));
+	for (i = 0; i < next && ret == 0; i++) {
+		/* Waiting for the txg once covers all of the regions */
+		df.df_flags = (i == next - 1 &&
+		    (sl->sl_flags & SL_WRITEBACK_CACHE_DISABLE)) ?
+		    DF_WAIT_SYNC : 0;
+		df.df_start = ext[i].ue_off;
+		df.df_length = ext[i].ue_len;
+
+		ret = VOP_IOCTL(vp, DKIOCFREE, (intptr_t)(&df), FKIOCTL,
+		    kcred, &unused, NULL);
+	}
+
+	return (ret);
 }
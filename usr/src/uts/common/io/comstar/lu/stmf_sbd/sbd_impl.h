@@ -292,6 +292,7 @@ void sbd_zvol_rele_write_bufs_abort(sbd_lu_t *sl, stmf_data_buf_t *dbuf);
 int sbd_zvol_rele_write_bufs(sbd_lu_t *sl, stmf_data_buf_t *dbuf);
 int sbd_zvol_copy_read(sbd_lu_t *sl, uio_t *uio);
 int sbd_zvol_copy_write(sbd_lu_t *sl, uio_t *uio, int flags);
+int sbd_zvol_unmap(sbd_lu_t *sl, sbd_unmap_ext_t *ext, uint_t next);
 
 stmf_status_t sbd_task_alloc(struct scsi_task *task);
 void sbd_new_task(struct scsi_task *task, struct stmf_data_buf *initial_dbuf);
@@ -2467,7 +2467,11 @@ sbd_handle_write_same(scsi_task_t *task, struct stmf_data_buf *initial_dbuf)
 
 	/* Check if the command is for the unmap function */
 	if (unmap) {
-		if (sbd_unmap(sl, addr, len) != 0) {
+		sbd_unmap_ext_t ext;
+
+		ext.ue_off = addr;
+		ext.ue_len = len;
+		if (sbd_unmap(sl, &ext, 1) != 0) {
 			stmf_scsilib_send_status(task, STATUS_CHECK,
 			    STMF_SAA_LBA_OUT_OF_RANGE);
 		} else {
@@ -2575,6 +2579,8 @@ sbd_handle_unmap_xfer(scsi_task_t *task, uint8_t *buf, uint32_t buflen)
 	sbd_lu_t *sl = (sbd_lu_t *)task->task_lu->lu_provider_private;
 	uint32_t ulen, dlen, num_desc;
 	uint64_t addr, len;
+	sbd_unmap_ext_t *ext;
+	uint_t next = 0;
 	uint8_t *p;
 	int ret;
 
@@ -2593,20 +2599,36 @@ sbd_handle_unmap_xfer(scsi_task_t *task, uint8_t *buf, uint32_t buflen)
 		return;
 	}
 
+	/*
+	 * Gather the descriptors, merging those that continue the previous
+	 * one, so the whole list is freed and made stable in one go.
+	 */
+	ext = kmem_alloc(num_desc * sizeof (sbd_unmap_ext_t), KM_SLEEP);
 	for (p = buf + 8; num_desc; num_desc--, p += 16) {
 		addr = READ_SCSI64(p, uint64_t);
 		addr <<= sl->sl_data_blocksize_shift;
 		len = READ_SCSI32(p+8, uint64_t);
 		len <<= sl->sl_data_blocksize_shift;
-		ret = sbd_unmap(sl, addr, len);
-		if (ret != 0) {
-			stmf_scsilib_send_status(task, STATUS_CHECK,
-			    STMF_SAA_LBA_OUT_OF_RANGE);
-			return;
+		if (len == 0)
+			continue;
+		if (next > 0 &&
+		    ext[next - 1].ue_off + ext[next - 1].ue_len == addr) {
+			ext[next - 1].ue_len += len;
+			continue;
 		}
+		ext[next].ue_off = addr;
+		ext[next].ue_len = len;
+		next++;
+	}
+
+	ret = (next > 0) ? sbd_unmap(sl, ext, next) : 0;
+	kmem_free(ext, (dlen >> 4) * sizeof (sbd_unmap_ext_t));
+	if (ret != 0) {
+		stmf_scsilib_send_status(task, STATUS_CHECK,
+		    STMF_SAA_LBA_OUT_OF_RANGE);
+		return;
 	}
 
-unmap_done:
 	stmf_scsilib_send_status(task, STATUS_GOOD, 0);
 }
 
@@ -78,6 +78,8 @@
  *    zfs_range_unlock()
  *
  *    zvol_log_write()
+ *    zvol_free_minor()
+ *    zvol_free_sync_minor()
  *
  *    dmu_read_uio()
  *    dmu_write_uio()
@@ -456,3 +458,25 @@ sbd_zvol_copy_write(sbd_lu_t *sl, uio_t *uio, int flags)
 		error = EIO;
 	return (error);
 }
+
+/*
+ * Unmap interface for callers using direct zvol access.  Like a DKIOCFREE
+ * per region, except that the ZIL is committed and the txg waited for only
+ * once, after the last region has been freed.
+ */
+int
+sbd_zvol_unmap(sbd_lu_t *sl, sbd_unmap_ext_t *ext, uint_t next)
+{
+	int		error = 0;
+	uint_t		i;
+
+	for (i = 0; i < next && error == 0; i++) {
+		error = zvol_free_minor(sl->sl_zvol_minor_hdl, ext[i].ue_off,
+		    ext[i].ue_len);
+	}
+	if (error == 0) {
+		zvol_free_sync_minor(sl->sl_zvol_minor_hdl,
+		    (sl->sl_flags & SL_WRITEBACK_CACHE_DISABLE) != 0);
+	}
+	return (error);
+}
@@ -300,7 +300,16 @@ sbd_status_t sbd_write_lu_info(sbd_lu_t *sl);
 sbd_status_t sbd_flush_data_cache(sbd_lu_t *sl, int fsync_done);
 sbd_status_t sbd_wcd_set(int wcd, sbd_lu_t *sl);
 void sbd_wcd_get(int *wcd, sbd_lu_t *sl);
-int sbd_unmap(sbd_lu_t *, uint64_t, uint64_t);
+
+/*
+ * A byte range to be unmapped.
+ */
+typedef struct sbd_unmap_ext {
+	uint64_t	ue_off;
+	uint64_t	ue_len;
+} sbd_unmap_ext_t;
+
+int sbd_unmap(sbd_lu_t *, sbd_unmap_ext_t *, uint_t);
 
 #ifdef	__cplusplus
 }
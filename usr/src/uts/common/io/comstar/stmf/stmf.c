@@ -36,6 +36,7 @@
 #include <sys/scsi/generic/persist.h>
 #include <sys/scsi/impl/scsi_reset_notify.h>
 #include <sys/disp.h>
+#include <sys/cpuvar.h>
 #include <sys/byteorder.h>
 #include <sys/atomic.h>
 #include <sys/ethernet.h>
@@ -225,7 +226,6 @@ static int stmf_i_max_nworkers;
 static int stmf_i_min_nworkers;
 static int stmf_nworkers_cur;		/* # of workers currently running */
 static int stmf_nworkers_needed;	/* # of workers need to be running */
-static int stmf_worker_sel_counter = 0;
 static uint32_t stmf_cur_ntasks = 0;
 static clock_t stmf_wm_last = 0;
 /*
@@ -4432,7 +4432,7 @@ stmf_post_task(scsi_task_t *task, stmf_data_buf_t *dbuf)
 	stmf_i_scsi_task_t *itask = (stmf_i_scsi_task_t *)
 	    task->task_stmf_private;
 	stmf_i_lu_t *ilu = (stmf_i_lu_t *)task->task_lu->lu_stmf_private;
-	int nv;
+	int nv, nw;
 	uint32_t old, new;
 	uint32_t ct;
 	stmf_worker_t *w, *w1;
@@ -4444,18 +4444,18 @@ stmf_post_task(scsi_task_t *task, stmf_data_buf_t *dbuf)
 	/* Latest value of currently running tasks */
 	ct = atomic_inc_32_nv(&stmf_cur_ntasks);
 
-	/* Select the next worker using round robin */
-	nv = (int)atomic_inc_32_nv((uint32_t *)&stmf_worker_sel_counter);
-	if (nv >= stmf_nworkers_accepting_cmds) {
-		int s = nv;
-		do {
-			nv -= stmf_nworkers_accepting_cmds;
-		} while (nv >= stmf_nworkers_accepting_cmds);
-		if (nv < 0)
-			nv = 0;
-		/* Its ok if this cas fails */
-		(void) atomic_cas_32((uint32_t *)&stmf_worker_sel_counter,
-		    s, nv);
+	/*
+	 * Select the next worker using round robin on a per-LU cursor,
+	 * offset by the CPU posting the task.  A single global cursor
+	 * bounced between all the CPUs posting tasks, and made the
+	 * tasks of a busy LU and of the LUs behind it share workers.
+	 */
+	nw = stmf_nworkers_accepting_cmds;
+	if (nw > 0) {
+		nv = (int)((atomic_inc_32_nv(&ilu->ilu_worker_sel) +
+		    CPU->cpu_seqid) % nw);
+	} else {
+		nv = 0;
 	}
 	w = &stmf_workers[nv];
 
@@ -4463,7 +4463,7 @@ stmf_post_task(scsi_task_t *task, stmf_data_buf_t *dbuf)
 	 * A worker can be pinned by interrupt. So select the next one
 	 * if it has lower load.
 	 */
-	if ((nv + 1) >= stmf_nworkers_accepting_cmds) {
+	if ((nv + 1) >= nw) {
 		w1 = stmf_workers;
 	} else {
 		w1 = &stmf_workers[nv + 1];
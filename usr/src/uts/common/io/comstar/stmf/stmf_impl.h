@@ -89,7 +89,7 @@ typedef struct stmf_i_lu {
 	uint32_t	ilu_ntasks;	 /* # of tasks in the ilu_task list */
 	uint32_t	ilu_ntasks_free;	/* # of tasks that are free */
 	uint32_t	ilu_ntasks_min_free; /* # minimal free tasks */
-	uint32_t	rsvd1;
+	uint32_t	ilu_worker_sel;	/* worker selection cursor */
 	uint32_t	ilu_proxy_registered;
 	uint64_t	ilu_reg_msgid;
 	struct stmf_i_scsi_task	*ilu_tasks;
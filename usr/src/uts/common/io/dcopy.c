@@ -36,6 +36,13 @@
 #include <sys/modctl.h>
 #include <sys/sysmacros.h>
 #include <sys/atomic.h>
+#include <sys/cpuvar.h>
+#include <sys/cpu.h>
+#include <sys/disp.h>
+#include <sys/taskq.h>
+#include <sys/taskq_impl.h>
+#include <vm/as.h>
+#include <vm/hat.h>
 
 
 #include <sys/dcopy.h>
@@ -45,6 +52,9 @@
 /* Number of entries per channel to allocate */
 uint_t dcopy_channel_size = 1024;
 
+/* Smallest copy dcopy_copy() will offload */
+size_t dcopy_copy_min = 32 * 1024;
+
 
 typedef struct dcopy_list_s {
 	list_t			dl_list;
@@ -83,6 +93,32 @@ typedef struct dcopy_stats_s {
 	kstat_named_t	cs_capabilities;
 } dcopy_stats_t;
 
+/* dcopy_copy() statistics, including why copies weren't offloaded */
+typedef struct dcopy_copy_stats_s {
+	kstat_named_t	cc_copies;
+	kstat_named_t	cc_bytes;
+	kstat_named_t	cc_async;
+	kstat_named_t	cc_fb_small;
+	kstat_named_t	cc_fb_idle;
+	kstat_named_t	cc_fb_intr;
+	kstat_named_t	cc_fb_nochan;
+	kstat_named_t	cc_fb_unmapped;
+	kstat_named_t	cc_fb_nores;
+	kstat_named_t	cc_dma_error;
+} dcopy_copy_stats_t;
+
+/* an asynchronous dcopy_copy() in flight */
+typedef struct dcopy_copy_req_s {
+	const void	*cr_src;
+	void		*cr_dst;
+	size_t		cr_len;
+	dcopy_handle_t	cr_channel;
+	dcopy_cmd_t	cr_cmd;
+	dcopy_done_t	cr_done;
+	void		*cr_arg;
+	taskq_ent_t	cr_tqent;
+} dcopy_copy_req_t;
+
 /* DMA channel state */
 struct dcopy_channel_s {
 	/* DMA driver channel private pointer */
@@ -126,6 +162,11 @@ struct dcopy_channel_s {
 typedef struct dcopy_state_s {
 	dcopy_list_t		d_device_list;
 	dcopy_list_t		d_globalchan_list;
+
+	/* dcopy_copy() completions and statistics */
+	taskq_t			*d_copy_taskq;
+	kstat_t			*d_copy_kstat;
+	dcopy_copy_stats_t	d_copy_stat;
 } dcopy_state_t;
 dcopy_state_t *dcopy_statep;
 
@@ -158,6 +199,13 @@ static void dcopy_device_cleanup(dcopy_device_handle_t device,
 static int dcopy_stats_init(dcopy_handle_t channel);
 static void dcopy_stats_fini(dcopy_handle_t channel);
 
+static int dcopy_copy_stats_init();
+static kstat_named_t *dcopy_copy_post(const void *src, void *dst, size_t len,
+    dcopy_handle_t *channel, dcopy_cmd_t *cmd);
+static void dcopy_copy_wait(const void *src, void *dst, size_t len,
+    dcopy_handle_t channel, dcopy_cmd_t cmd);
+static void dcopy_copy_done(void *arg);
+
 
 /*
  * _init()
@@ -231,9 +279,19 @@ dcopy_init()
 		goto dcopyinitfail_global;
 	}
 
+	/* waits for asynchronous dcopy_copy()s and runs their callbacks */
+	dcopy_statep->d_copy_taskq = taskq_create("dcopy_copy", 64,
+	    minclsyspri, 1, INT_MAX, TASKQ_DYNAMIC | TASKQ_PREPOPULATE);
+
+	e = dcopy_copy_stats_init();
+	if (e != DCOPY_SUCCESS) {
+		goto dcopyinitfail_cback;
+	}
+
 	return (0);
 
 dcopyinitfail_cback:
+	taskq_destroy(dcopy_statep->d_copy_taskq);
 	dcopy_list_fini(&dcopy_statep->d_globalchan_list);
 dcopyinitfail_global:
 	dcopy_list_fini(&dcopy_statep->d_device_list);
@@ -257,6 +315,8 @@ dcopy_fini()
 	ASSERT(list_head(&dcopy_statep->d_globalchan_list.dl_list) == NULL);
 	ASSERT(list_head(&dcopy_statep->d_device_list.dl_list) == NULL);
 
+	kstat_delete(dcopy_statep->d_copy_kstat);
+	taskq_destroy(dcopy_statep->d_copy_taskq);
 	dcopy_list_fini(&dcopy_statep->d_globalchan_list);
 	dcopy_list_fini(&dcopy_statep->d_device_list);
 	kmem_free(dcopy_statep, sizeof (*dcopy_statep));
@@ -531,8 +591,269 @@ repoll:
 	return (e);
 }
 
+
+/*
+ * dcopy_copy()
+ */
+int
+dcopy_copy(const void *src, void *dst, size_t len, int flags,
+    dcopy_done_t done, void *arg)
+{
+	dcopy_copy_stats_t *stats = &dcopy_statep->d_copy_stat;
+	dcopy_copy_req_t *req = NULL;
+	dcopy_handle_t channel;
+	dcopy_cmd_t cmd;
+	kstat_named_t *fallback;
+
+
+	if (len < dcopy_copy_min) {
+		atomic_inc_64(&stats->cc_fb_small.value.ui64);
+		return (DCOPY_FAILURE);
+	}
+
+	/* we have to be able to block for the completion */
+	if (servicing_interrupt()) {
+		atomic_inc_64(&stats->cc_fb_intr.value.ui64);
+		return (DCOPY_FAILURE);
+	}
+
+	/*
+	 * With DCOPY_COPY_IFBUSY the caller only wants the copy offloaded if
+	 * that frees the CPU for someone else. This is only a hint, so we
+	 * don't mind the CPU changing under us.
+	 */
+	if ((flags & DCOPY_COPY_IFBUSY) &&
+	    CPU->cpu_disp->disp_nrunnable == 0) {
+		atomic_inc_64(&stats->cc_fb_idle.value.ui64);
+		return (DCOPY_FAILURE);
+	}
+
+	if (done != NULL) {
+		req = kmem_zalloc(sizeof (*req), KM_NOSLEEP);
+		if (req == NULL) {
+			atomic_inc_64(&stats->cc_fb_nores.value.ui64);
+			return (DCOPY_FAILURE);
+		}
+	}
+
+	fallback = dcopy_copy_post(src, dst, len, &channel, &cmd);
+	if (fallback != NULL) {
+		if (done != NULL) {
+			kmem_free(req, sizeof (*req));
+		}
+		atomic_inc_64(&fallback->value.ui64);
+		return (DCOPY_FAILURE);
+	}
+
+	atomic_inc_64(&stats->cc_copies.value.ui64);
+	atomic_add_64(&stats->cc_bytes.value.ui64, len);
+
+	if (done == NULL) {
+		dcopy_copy_wait(src, dst, len, channel, cmd);
+		return (DCOPY_SUCCESS);
+	}
+
+	atomic_inc_64(&stats->cc_async.value.ui64);
+	req->cr_src = src;
+	req->cr_dst = dst;
+	req->cr_len = len;
+	req->cr_channel = channel;
+	req->cr_cmd = cmd;
+	req->cr_done = done;
+	req->cr_arg = arg;
+	taskq_dispatch_ent(dcopy_statep->d_copy_taskq, dcopy_copy_done, req,
+	    0, &req->cr_tqent);
+
+	return (DCOPY_SUCCESS);
+}
+
 /* *** END OF EXTERNAL INTERFACE *** */
 
+
+/*
+ * dcopy_copy_post()
+ *   post the commands for a dcopy_copy(), one for each run of source and
+ *   destination that is physically contiguous on both sides. Only the last
+ *   command interrupts. Returns NULL if all were posted, or the statistic
+ *   for the reason the copy can't be offloaded.
+ */
+static kstat_named_t *
+dcopy_copy_post(const void *src, void *dst, size_t len,
+    dcopy_handle_t *channel, dcopy_cmd_t *cmd)
+{
+	dcopy_copy_stats_t *stats = &dcopy_statep->d_copy_stat;
+	kstat_named_t *fallback = NULL;
+	dcopy_cmd_t posted = NULL;
+	dcopy_cmd_t last = NULL;
+	dcopy_cmd_t next;
+	uint64_t spa, dpa;
+	pfn_t spfn, dpfn;
+	size_t cnt;
+	int flags;
+
+
+	if (dcopy_alloc(DCOPY_NOSLEEP, channel) != DCOPY_SUCCESS) {
+		return (&stats->cc_fb_nochan);
+	}
+
+	while (len > 0) {
+		spfn = hat_getpfnum(kas.a_hat, (caddr_t)src);
+		dpfn = hat_getpfnum(kas.a_hat, (caddr_t)dst);
+		if (spfn == PFN_INVALID || dpfn == PFN_INVALID) {
+			fallback = &stats->cc_fb_unmapped;
+			break;
+		}
+		spa = ptob((uint64_t)spfn) + ((uintptr_t)src & PAGEOFFSET);
+		dpa = ptob((uint64_t)dpfn) + ((uintptr_t)dst & PAGEOFFSET);
+
+		/* extend the run while both sides stay contiguous */
+		cnt = 0;
+		do {
+			cnt += MIN(MIN(len - cnt,
+			    PAGESIZE - ((spa + cnt) & PAGEOFFSET)),
+			    PAGESIZE - ((dpa + cnt) & PAGEOFFSET));
+		} while (cnt < len &&
+		    ptob((uint64_t)hat_getpfnum(kas.a_hat,
+		    (caddr_t)src + cnt)) == P2ALIGN(spa + cnt, PAGESIZE) &&
+		    ptob((uint64_t)hat_getpfnum(kas.a_hat,
+		    (caddr_t)dst + cnt)) == P2ALIGN(dpa + cnt, PAGESIZE));
+
+		next = last;
+		flags = DCOPY_NOSLEEP | (last != NULL ? DCOPY_ALLOC_LINK : 0);
+		if (dcopy_cmd_alloc(*channel, flags, &next) != DCOPY_SUCCESS) {
+			fallback = &stats->cc_fb_nores;
+			break;
+		}
+		last = next;
+
+		ASSERT(last->dp_version == DCOPY_CMD_V0);
+		last->dp_cmd = DCOPY_CMD_COPY;
+		last->dp_flags = (cnt == len) ?
+		    DCOPY_CMD_INTR : DCOPY_CMD_NOFLAGS;
+		last->dp.copy.cc_source = spa;
+		last->dp.copy.cc_dest = dpa;
+		last->dp.copy.cc_size = cnt;
+		if (dcopy_cmd_post(last) != DCOPY_SUCCESS) {
+			fallback = &stats->cc_fb_nores;
+			break;
+		}
+		posted = last;
+
+		src = (caddr_t)src + cnt;
+		dst = (caddr_t)dst + cnt;
+		len -= cnt;
+	}
+
+	if (fallback == NULL) {
+		*cmd = last;
+		return (NULL);
+	}
+
+	/*
+	 * Let whatever we already posted finish before we free it; the caller
+	 * will copy the whole range itself. Without DCOPY_CMD_INTR we can't
+	 * block, but this is rare.
+	 */
+	if (posted != NULL) {
+		while (dcopy_cmd_poll(posted, DCOPY_POLL_NOFLAGS) ==
+		    DCOPY_PENDING) {
+			SMT_PAUSE();
+		}
+	}
+	if (last != NULL) {
+		dcopy_cmd_free(&last);
+	}
+	dcopy_free(channel);
+
+	return (fallback);
+}
+
+
+/*
+ * dcopy_copy_wait()
+ *   wait for the commands of a dcopy_copy() to complete, and free them. If
+ *   the DMA engine failed, fall back to bcopy() so the copy still happens.
+ */
+static void
+dcopy_copy_wait(const void *src, void *dst, size_t len,
+    dcopy_handle_t channel, dcopy_cmd_t cmd)
+{
+	dcopy_copy_stats_t *stats = &dcopy_statep->d_copy_stat;
+
+
+	if (dcopy_cmd_poll(cmd, DCOPY_POLL_BLOCK) != DCOPY_COMPLETED) {
+		atomic_inc_64(&stats->cc_dma_error.value.ui64);
+		bcopy(src, dst, len);
+	}
+
+	dcopy_cmd_free(&cmd);
+	dcopy_free(&channel);
+}
+
+
+/*
+ * dcopy_copy_done()
+ *   taskq callback completing an asynchronous dcopy_copy().
+ */
+static void
+dcopy_copy_done(void *arg)
+{
+	dcopy_copy_req_t *req = arg;
+
+
+	dcopy_copy_wait(req->cr_src, req->cr_dst, req->cr_len,
+	    req->cr_channel, req->cr_cmd);
+	req->cr_done(req->cr_arg, 0);
+	kmem_free(req, sizeof (*req));
+}
+
+
+/*
+ * dcopy_copy_stats_init()
+ */
+static int
+dcopy_copy_stats_init()
+{
+	dcopy_copy_stats_t *stats;
+
+
+	stats = &dcopy_statep->d_copy_stat;
+
+	dcopy_statep->d_copy_kstat = kstat_create("dcopy", 0, "copy", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (dcopy_copy_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (dcopy_statep->d_copy_kstat == NULL) {
+		return (DCOPY_FAILURE);
+	}
+	dcopy_statep->d_copy_kstat->ks_data = stats;
+
+	kstat_named_init(&stats->cc_copies, "copies",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_bytes, "bytes",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_async, "async",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_small, "fallback_small",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_idle, "fallback_idle",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_intr, "fallback_intr",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_nochan, "fallback_nochan",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_unmapped, "fallback_unmapped",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_fb_nores, "fallback_noresources",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&stats->cc_dma_error, "dma_error",
+	    KSTAT_DATA_UINT64);
+
+	kstat_install(dcopy_statep->d_copy_kstat);
+
+	return (DCOPY_SUCCESS);
+}
+
 /*
  * dcopy_list_init()
  */
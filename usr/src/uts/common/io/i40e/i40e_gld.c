@@ -38,7 +38,8 @@ char *i40e_priv_props[] = {
 static int
 i40e_group_remove_mac(void *arg, const uint8_t *mac_addr)
 {
-	i40e_t *i40e = arg;
+	i40e_rx_group_t *rxg = arg;
+	i40e_t *i40e = rxg->irg_i40e;
 	struct i40e_aqc_remove_macvlan_element_data filt;
 	struct i40e_hw *hw = &i40e->i40e_hw_space;
 	int ret, i, last;
@@ -67,6 +68,7 @@ i40e_group_remove_mac(void *arg, const uint8_t *mac_addr)
 
 	iua = &i40e->i40e_uaddrs[i];
 	ASSERT(i40e->i40e_resources.ifr_nmacfilt_used > 0);
+	ASSERT3S(iua->iua_vsi, ==, rxg->irg_vsi_seid);
 
 	bzero(&filt, sizeof (filt));
 	bcopy(mac_addr, filt.mac_addr, ETHERADDRL);
@@ -106,7 +108,8 @@ done:
 static int
 i40e_group_add_mac(void *arg, const uint8_t *mac_addr)
 {
-	i40e_t *i40e = arg;
+	i40e_rx_group_t *rxg = arg;
+	i40e_t *i40e = rxg->irg_i40e;
 	struct i40e_hw *hw = &i40e->i40e_hw_space;
 	int i, ret;
 	i40e_uaddr_t *iua;
@@ -136,15 +139,15 @@ i40e_group_add_mac(void *arg, const uint8_t *mac_addr)
 	}
 
 	/*
-	 * Note, the general use of the i40e_vsi_id will have to be refactored
-	 * when we have proper group support.
+	 * The filter goes on the group's own VSI, which is what steers traffic
+	 * for this address to the group's rings.
 	 */
 	bzero(&filt, sizeof (filt));
 	bcopy(mac_addr, filt.mac_addr, ETHERADDRL);
 	filt.flags = I40E_AQC_MACVLAN_ADD_PERFECT_MATCH	|
 	    I40E_AQC_MACVLAN_ADD_IGNORE_VLAN;
 
-	if ((ret = i40e_aq_add_macvlan(hw, i40e->i40e_vsi_id, &filt, 1,
+	if ((ret = i40e_aq_add_macvlan(hw, rxg->irg_vsi_seid, &filt, 1,
 	    NULL)) != I40E_SUCCESS) {
 		i40e_error(i40e, "failed to add mac address "
 		    "%2x:%2x:%2x:%2x:%2x:%2x to unicast filter: %d",
@@ -156,7 +159,7 @@ i40e_group_add_mac(void *arg, const uint8_t *mac_addr)
 
 	iua = &i40e->i40e_uaddrs[i40e->i40e_resources.ifr_nmacfilt_used];
 	bcopy(mac_addr, iua->iua_mac, ETHERADDRL);
-	iua->iua_vsi = i40e->i40e_vsi_id;
+	iua->iua_vsi = rxg->irg_vsi_seid;
 	i40e->i40e_resources.ifr_nmacfilt_used++;
 	ASSERT(i40e->i40e_resources.ifr_nmacfilt_used <=
 	    i40e->i40e_resources.ifr_nmacfilt);
@@ -454,9 +457,9 @@ i40e_rx_ring_intr_enable(mac_intr_handle_t intrh)
 	i40e_t *i40e = itrq->itrq_i40e;
 
 	mutex_enter(&i40e->i40e_general_lock);
-	ASSERT(i40e->i40e_intr_poll == B_TRUE);
+	ASSERT(itrq->itrq_intr_poll == B_TRUE);
 	i40e_intr_rx_queue_enable(i40e, itrq->itrq_index);
-	i40e->i40e_intr_poll = B_FALSE;
+	itrq->itrq_intr_poll = B_FALSE;
 	mutex_exit(&i40e->i40e_general_lock);
 
 	return (0);
@@ -471,7 +474,7 @@ i40e_rx_ring_intr_disable(mac_intr_handle_t intrh)
 
 	mutex_enter(&i40e->i40e_general_lock);
 	i40e_intr_rx_queue_disable(i40e, itrq->itrq_index);
-	i40e->i40e_intr_poll = B_TRUE;
+	itrq->itrq_intr_poll = B_TRUE;
 	mutex_exit(&i40e->i40e_general_lock);
 
 	return (0);
@@ -517,15 +520,17 @@ i40e_fill_rx_ring(void *arg, mac_ring_type_t rtype, const int group_index,
 {
 	i40e_t *i40e = arg;
 	mac_intr_t *mintr = &infop->mri_intr;
-	i40e_trqpair_t *itrq = &i40e->i40e_trqpairs[ring_index];
+	i40e_trqpair_t *itrq;
 
 	/*
-	 * We assert the group number and ring index to help sanity check
-	 * ourselves and mark that we'll need to rework this when we have
-	 * multiple groups.
+	 * MAC hands us the ring's index within its group; the group's rings
+	 * are the contiguous run of queue pairs that back its VSI.
 	 */
-	ASSERT3S(group_index, ==, 0);
-	ASSERT3S(ring_index, <, i40e->i40e_num_trqpairs);
+	ASSERT3S(group_index, >=, 0);
+	ASSERT3S(group_index, <, i40e->i40e_num_rx_groups);
+	ASSERT3S(ring_index, <, i40e->i40e_num_rings_per_group);
+	itrq = &i40e->i40e_trqpairs[I40E_GROUP_QUEUE_BASE(i40e, group_index) +
+	    ring_index];
 
 	itrq->itrq_macrxring = rh;
 	infop->mri_driver = (mac_ring_driver_t)itrq;
@@ -553,24 +558,21 @@ i40e_fill_rx_group(void *arg, mac_ring_type_t rtype, const int index,
     mac_group_info_t *infop, mac_group_handle_t gh)
 {
 	i40e_t *i40e = arg;
+	i40e_rx_group_t *rxg;
 
 	if (rtype != MAC_RING_TYPE_RX)
 		return;
 
-	/*
-	 * Note, this is a simplified view of a group, given that we only have a
-	 * single group and a single ring at the moment. We'll want to expand
-	 * upon this as we leverage more hardware functionality.
-	 */
-	i40e->i40e_rx_group_handle = gh;
-	infop->mgi_driver = (mac_group_driver_t)i40e;
+	ASSERT3S(index, <, i40e->i40e_num_rx_groups);
+	rxg = &i40e->i40e_rx_groups[index];
+	rxg->irg_grp_hdl = gh;
+
+	infop->mgi_driver = (mac_group_driver_t)rxg;
 	infop->mgi_start = NULL;
 	infop->mgi_stop = NULL;
 	infop->mgi_addmac = i40e_group_add_mac;
 	infop->mgi_remmac = i40e_group_remove_mac;
-
-	ASSERT(i40e->i40e_num_rx_groups == I40E_GROUP_MAX);
-	infop->mgi_count = i40e->i40e_num_trqpairs;
+	infop->mgi_count = i40e->i40e_num_rings_per_group;
 }
 
 static boolean_t
@@ -611,7 +613,7 @@ i40e_m_getcapab(void *arg, mac_capab_t cap, void *cap_data)
 		case MAC_RING_TYPE_RX:
 			cap_rings->mr_rnum = i40e->i40e_num_trqpairs;
 			cap_rings->mr_rget = i40e_fill_rx_ring;
-			cap_rings->mr_gnum = I40E_GROUP_MAX;
+			cap_rings->mr_gnum = i40e->i40e_num_rx_groups;
 			cap_rings->mr_gget = i40e_fill_rx_group;
 			cap_rings->mr_gaddring = NULL;
 			cap_rings->mr_gremring = NULL;
@@ -76,10 +76,14 @@
  * queue defines the next one in either the I40E_QINT_RQCTL or I40E_QINT_TQCTL
  * register.
  *
- * Because we only have a single queue enabled at the moment and we always have
- * two interrupts, we do something pretty simple and just know that there's one
- * data queue in the interrupt handler. Longer term, we'll need to think harder
- * about this, but for the moment it'll have to suffice.
+ * Queue pairs are spread round-robin over the I/O vectors: queue pair q is
+ * serviced by vector 1 + (q % (i40e_intr_count - 1)), both for transmit and
+ * receive. Each vector's linked list therefore starts with the receive side of
+ * its lowest numbered queue pair, which links to that pair's transmit side,
+ * which in turn links to the receive side of the next queue pair on the same
+ * vector, and so on. When the vector fires, we walk that same set of queue
+ * pairs. Receive rings that MAC has put into polling mode are skipped, as their
+ * own interrupt cause has been disabled.
  *
  * Finally, the individual interrupt vector itself has the ability to be enabled
  * and disabled. The overall interrupt is controlled through the
@@ -388,33 +392,54 @@ i40e_intr_init_queue_msix(i40e_t *i40e)
 {
 	i40e_hw_t *hw = &i40e->i40e_hw_space;
 	uint32_t reg;
+	int i, nvec;
+
+	ASSERT3U(i40e->i40e_intr_count, >=, 2);
+	nvec = i40e->i40e_intr_count - 1;
 
 	/*
-	 * Because we only have a single queue, just do something simple now.
-	 * How this all works will need to really be properly redone based on
-	 * the bit maps, etc. Note that we skip the ITR logic for the moment,
+	 * Root each vector's list at the receive side of the first queue pair
+	 * that it services. Note that we skip the ITR logic for the moment,
 	 * just to make our lives as explicit and simple as possible.
 	 */
-	reg = (0 << I40E_PFINT_LNKLSTN_FIRSTQ_INDX_SHIFT) |
-	    (I40E_QUEUE_TYPE_RX << I40E_PFINT_LNKLSTN_FIRSTQ_TYPE_SHIFT);
-	I40E_WRITE_REG(hw, I40E_PFINT_LNKLSTN(0), reg);
-
-	reg = (1 << I40E_QINT_RQCTL_MSIX_INDX_SHIFT) |
-	    (I40E_ITR_INDEX_RX << I40E_QINT_RQCTL_ITR_INDX_SHIFT) |
-	    (0 << I40E_QINT_RQCTL_NEXTQ_INDX_SHIFT) |
-	    (I40E_QUEUE_TYPE_TX << I40E_QINT_RQCTL_NEXTQ_TYPE_SHIFT) |
-	    I40E_QINT_RQCTL_CAUSE_ENA_MASK;
-
-	I40E_WRITE_REG(hw, I40E_QINT_RQCTL(0), reg);
-
-	reg = (1 << I40E_QINT_RQCTL_MSIX_INDX_SHIFT) |
-	    (I40E_ITR_INDEX_TX << I40E_QINT_RQCTL_ITR_INDX_SHIFT) |
-	    (I40E_QUEUE_TYPE_EOL << I40E_QINT_TQCTL_NEXTQ_INDX_SHIFT) |
-	    (I40E_QUEUE_TYPE_RX << I40E_QINT_RQCTL_NEXTQ_TYPE_SHIFT) |
-	    I40E_QINT_TQCTL_CAUSE_ENA_MASK;
+	for (i = 0; i < nvec; i++) {
+		if (i < i40e->i40e_num_trqpairs) {
+			reg = (i << I40E_PFINT_LNKLSTN_FIRSTQ_INDX_SHIFT) |
+			    (I40E_QUEUE_TYPE_RX <<
+			    I40E_PFINT_LNKLSTN_FIRSTQ_TYPE_SHIFT);
+		} else {
+			reg = I40E_QUEUE_TYPE_EOL;
+		}
+		I40E_WRITE_REG(hw, I40E_PFINT_LNKLSTN(i), reg);
+	}
 
-	I40E_WRITE_REG(hw, I40E_QINT_TQCTL(0), reg);
+	for (i = 0; i < i40e->i40e_num_trqpairs; i++) {
+		i40e_trqpair_t *itrq = &i40e->i40e_trqpairs[i];
+		int next = i + nvec;
+
+		reg = (itrq->itrq_rx_intrvec <<
+		    I40E_QINT_RQCTL_MSIX_INDX_SHIFT) |
+		    (I40E_ITR_INDEX_RX << I40E_QINT_RQCTL_ITR_INDX_SHIFT) |
+		    (i << I40E_QINT_RQCTL_NEXTQ_INDX_SHIFT) |
+		    (I40E_QUEUE_TYPE_TX << I40E_QINT_RQCTL_NEXTQ_TYPE_SHIFT) |
+		    I40E_QINT_RQCTL_CAUSE_ENA_MASK;
+
+		I40E_WRITE_REG(hw, I40E_QINT_RQCTL(i), reg);
+
+		reg = (itrq->itrq_tx_intrvec <<
+		    I40E_QINT_TQCTL_MSIX_INDX_SHIFT) |
+		    (I40E_ITR_INDEX_TX << I40E_QINT_TQCTL_ITR_INDX_SHIFT) |
+		    (I40E_QUEUE_TYPE_RX << I40E_QINT_TQCTL_NEXTQ_TYPE_SHIFT) |
+		    I40E_QINT_TQCTL_CAUSE_ENA_MASK;
+		if (next < i40e->i40e_num_trqpairs) {
+			reg |= next << I40E_QINT_TQCTL_NEXTQ_INDX_SHIFT;
+		} else {
+			reg |= I40E_QUEUE_TYPE_EOL <<
+			    I40E_QINT_TQCTL_NEXTQ_INDX_SHIFT;
+		}
 
+		I40E_WRITE_REG(hw, I40E_QINT_TQCTL(i), reg);
+	}
 }
 
 /*
@@ -664,6 +689,7 @@ i40e_intr_msix(void *arg1, void *arg2)
 {
 	i40e_t *i40e = (i40e_t *)arg1;
 	int vector_idx = (int)(uintptr_t)arg2;
+	int i;
 
 	/*
 	 * When using MSI-X interrupts, vector 0 is always reserved for the
@@ -675,20 +701,22 @@ i40e_intr_msix(void *arg1, void *arg2)
 		return (DDI_INTR_CLAIMED);
 	}
 
-	VERIFY(vector_idx == 1);
+	VERIFY3S(vector_idx, <, i40e->i40e_intr_count);
 
 	/*
-	 * Note that we explicitly do not check this value under the lock even
-	 * though assignments to it are done so. In this case, the cost of
-	 * getting this wrong is at worst a bit of additional contention and
-	 * even more rarely, a duplicated packet. However, the cost on the other
-	 * hand is a lot more. This is something that as we more generally
-	 * implement ring support we should revisit.
+	 * Note that we explicitly do not check the ring's poll state under the
+	 * lock even though assignments to it are done so. In this case, the
+	 * cost of getting this wrong is at worst a bit of additional contention
+	 * and even more rarely, a duplicated packet. However, the cost on the
+	 * other hand is a lot more.
 	 */
-	if (i40e->i40e_intr_poll != B_TRUE)
-		i40e_intr_rx_work(i40e, 0);
-	i40e_intr_tx_work(i40e, 0);
-	i40e_intr_io_enable(i40e, 1);
+	for (i = vector_idx - 1; i < i40e->i40e_num_trqpairs;
+	    i += i40e->i40e_intr_count - 1) {
+		if (i40e->i40e_trqpairs[i].itrq_intr_poll != B_TRUE)
+			i40e_intr_rx_work(i40e, i);
+		i40e_intr_tx_work(i40e, i);
+	}
+	i40e_intr_io_enable(i40e, vector_idx);
 
 	return (DDI_INTR_CLAIMED);
 }
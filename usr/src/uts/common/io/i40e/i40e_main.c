@@ -149,11 +149,34 @@
  * it's up to us to map these queues to VSIs and VFs. Since we don't support any
  * VFs at this time, we only focus on assignments to VSIs.
  *
- * At the moment, we used a static mapping of transmit/receive queue pairs to a
- * given VSI (eg. rings to a group). Though in the fullness of time, we want to
- * make this something which is fully dynamic and take advantage of documented,
- * but not yet available functionality for adding filters based on VXLAN and
- * other encapsulation technologies.
+ * We use a static mapping of transmit/receive queue pairs to a given VSI (eg.
+ * rings to a group): group N owns the i40e_t`i40e_num_rings_per_group queue
+ * pairs starting at N * i40e_num_rings_per_group. The number of groups and of
+ * rings per group come from the "rx_groups" and "rx_rings_per_group" .conf
+ * properties, trimmed to what the PF actually has in queues, VSIs, and RSS
+ * lookup table width. Because the queues of a VSI's traffic class must be a
+ * power of two, so must the number of rings per group. Transmit rings are not
+ * grouped as far as MAC is concerned, but each transmit queue is still owned
+ * by the VSI of the group that its queue pair belongs to. Though in the
+ * fullness of time, we want to make this something which is fully dynamic and
+ * take advantage of documented, but not yet available functionality for adding
+ * filters based on VXLAN and other encapsulation technologies.
+ *
+ * ---
+ * RSS
+ * ---
+ *
+ * Within a group, receive side scaling spreads traffic across the group's
+ * rings. The hardware hashes the packet classifier types enabled in
+ * PFQF_HENA with the key in PFQF_HKEY, and uses the low bits of the hash to
+ * index the lookup table in PFQF_HLUT. Each entry of the table is a queue
+ * index relative to the start of the VSI's traffic class, so the one PF-wide
+ * table serves every group alike. The key is picked at random once per attach.
+ * By default the table simply cycles through a group's rings; the "rss_lut"
+ * .conf property may instead give a list of ring indexes, which is repeated to
+ * fill the table, to weight or restrict the rings that traffic hashes to. RSS
+ * can be turned off entirely with "rss_enable", in which case all of a group's
+ * traffic lands on its first ring.
  *
  * -------------------------------------
  * Broadcast, Multicast, and Promiscuous
@@ -187,14 +210,17 @@
  * VSI Management
  * --------------
  *
- * At this time, we currently only support a single MAC group, and thus a single
- * VSI. This VSI is considered the default VSI and should be the only one that
- * exists after a reset. Currently it is stored as the member
- * i40e_t`i40e_vsi_id. While this works for the moment and for an initial
- * driver, it's not sufficient for the longer-term path of the driver. Instead,
- * we'll want to actually have a unique i40e_vsi_t structure which is used
- * everywhere. Note that this means that every place that uses the
- * i40e_t`i40e_vsi_id will need to be refactored.
+ * Every MAC group is a VSI, described by an i40e_rx_group_t. The first group is
+ * always the default VSI, which firmware creates for the PF and which should be
+ * the only one that exists after a reset. It's stored as the member
+ * i40e_t`i40e_vsi_id, and it's the VSI that broadcast, multicast, and
+ * promiscuous state are tied to. When we have more than one group, we add a
+ * VEB (virtual Ethernet bridge) between the port's MAC and the default VSI and
+ * then add one VMDq VSI to the VEB for each of the remaining groups. Unicast
+ * addresses that MAC assigns to a group become perfect-match MAC filters on
+ * that group's VSI, so traffic for them only ever reaches the group's rings.
+ * The extra VSIs and the VEB are created once at attach time and removed when
+ * we detach; the default VSI's queue mapping is refreshed on every start.
  *
  * ----------------
  * Structure Layout
@@ -249,6 +275,7 @@
  *          | i40e_mcast_promisccount --+---> Active multicast state
  *          | i40e_promisc_on         --+---> Current promiscuous mode state
  *          | int                     --+---> Number of transmit/receive pairs
+ *          | i40e_rx_group_t *       --+---> Receive groups and their VSIs
  *          | kstat_t *               --+---> PF kstats
  *          | kstat_t *               --+---> VSI kstats
  *          | i40e_pf_stats_t         --+---> PF kstat backing data
@@ -359,8 +386,7 @@
  * overview of expected work:
  *
  *  o TSO support
- *  o RSS / multiple ring support
- *  o Multiple group support
+ *  o Flow director (sideband) filters, once MAC can hand flows to hardware
  *  o DMA binding and breaking up the locking in ring recycling.
  *  o Enhanced detection of device errors
  *  o Participation in IRM
@@ -381,6 +407,8 @@ static kmutex_t i40e_glock;
 static list_t i40e_glist;
 static list_t i40e_dlist;
 
+static void i40e_delete_vsis(i40e_t *);
+
 /*
  * Access attributes for register mapping.
  */
@@ -779,6 +807,12 @@ i40e_get_vsi_id(i40e_t *i40e)
 		return (-1);
 	}
 
+	/*
+	 * The default VSI's uplink is the port's MAC, which is where we attach
+	 * a VEB if we end up with more than one group.
+	 */
+	i40e->i40e_mac_seid = LE_16(sw_config->element[0].uplink_seid);
+
 	return (sw_config->element[0].seid);
 }
 
@@ -1106,6 +1140,12 @@ i40e_free_trqpairs(i40e_t *i40e)
 		i40e->i40e_trqpairs = NULL;
 	}
 
+	if (i40e->i40e_rx_groups != NULL) {
+		kmem_free(i40e->i40e_rx_groups,
+		    sizeof (i40e_rx_group_t) * i40e->i40e_num_rx_groups);
+		i40e->i40e_rx_groups = NULL;
+	}
+
 	cv_destroy(&i40e->i40e_rx_pending_cv);
 	mutex_destroy(&i40e->i40e_rx_pending_lock);
 	mutex_destroy(&i40e->i40e_general_lock);
@@ -1141,29 +1181,69 @@ i40e_alloc_trqpairs(i40e_t *i40e)
 		itrq->itrq_index = i;
 	}
 
+	i40e->i40e_rx_groups = kmem_zalloc(sizeof (i40e_rx_group_t) *
+	    i40e->i40e_num_rx_groups, KM_SLEEP);
+	for (i = 0; i < i40e->i40e_num_rx_groups; i++) {
+		i40e_rx_group_t *rxg = &i40e->i40e_rx_groups[i];
+
+		rxg->irg_index = i;
+		rxg->irg_i40e = i40e;
+	}
+
 	return (B_TRUE);
 }
 
 
 
 /*
- * Unless a .conf file already overrode i40e_t structure values, they will
- * be 0, and need to be set in conjunction with the now-available HW report.
- *
- * However, at the moment, we cap all of these resources as we only support a
- * single receive ring and a single group.
+ * The .conf file (or its defaults) told us how many groups and rings per group
+ * we'd like; trim those to what the now-available HW report says this PF has.
+ * Every group beyond the first needs a VSI of its own and every ring a queue
+ * pair, while the RSS lookup table entries bound the rings in a group. When
+ * short of queue pairs, we give up groups before rings.
  */
-/* ARGSUSED */
 static void
 i40e_hw_to_instance(i40e_t *i40e, i40e_hw_t *hw)
 {
-	if (i40e->i40e_num_trqpairs == 0) {
-		i40e->i40e_num_trqpairs = I40E_TRQPAIR_MAX;
+	i40e_func_rsrc_t *rsrc = &i40e->i40e_resources;
+	int nqp, nrings, ngroups;
+
+	nqp = MIN(hw->func_caps.num_rx_qp, hw->func_caps.num_tx_qp);
+	nrings = MIN(i40e->i40e_num_rings_per_group, nqp);
+	if (hw->func_caps.rss_table_entry_width != 0 &&
+	    hw->func_caps.rss_table_entry_width < 31) {
+		nrings = MIN(nrings,
+		    1 << hw->func_caps.rss_table_entry_width);
+	}
+	nrings = MAX(nrings, 1);
+	nrings = 1 << (highbit(nrings) - 1);
+
+	ngroups = MIN(i40e->i40e_num_rx_groups, nqp / nrings);
+	if (rsrc->ifr_nvsis > rsrc->ifr_nvsis_used) {
+		ngroups = MIN(ngroups,
+		    1 + rsrc->ifr_nvsis - rsrc->ifr_nvsis_used);
+	} else {
+		ngroups = 1;
 	}
+	ngroups = MAX(ngroups, 1);
 
-	if (i40e->i40e_num_rx_groups == 0) {
-		i40e->i40e_num_rx_groups = I40E_GROUP_MAX;
+	if (nrings != i40e->i40e_num_rings_per_group ||
+	    ngroups != i40e->i40e_num_rx_groups) {
+		i40e_log(i40e, "using %d rx groups of %d rings, rather than "
+		    "%d of %d", ngroups, nrings, i40e->i40e_num_rx_groups,
+		    i40e->i40e_num_rings_per_group);
 	}
+
+	i40e->i40e_num_rings_per_group = nrings;
+	i40e->i40e_num_rx_groups = ngroups;
+	i40e->i40e_num_trqpairs = ngroups * nrings;
+
+	/*
+	 * Pick the RSS key once per attach, so that a flow keeps hashing to the
+	 * same ring across a stop and start of the device.
+	 */
+	(void) random_get_pseudo_bytes((uint8_t *)i40e->i40e_rss_key,
+	    sizeof (i40e->i40e_rss_key));
 }
 
 /*
@@ -1335,6 +1415,9 @@ i40e_unconfigure(dev_info_t *devinfo, i40e_t *i40e)
 	if (i40e->i40e_attach_progress & I40E_ATTACH_ADD_INTR)
 		i40e_rem_intr_handlers(i40e);
 
+	if (i40e->i40e_attach_progress & I40E_ATTACH_VSIS)
+		i40e_delete_vsis(i40e);
+
 	if (i40e->i40e_attach_progress & I40E_ATTACH_ALLOC_RINGSLOCKS)
 		i40e_free_trqpairs(i40e);
 
@@ -1510,6 +1593,43 @@ i40e_get_prop(i40e_t *i40e, char *prop, int min, int max, int def)
 	return (val);
 }
 
+/*
+ * The "rss_lut" property is a list of ring indexes within a group. We only
+ * check it against the largest number of rings a group could have here, as
+ * the real number isn't known until we've seen the hardware's resources; see
+ * i40e_config_rss() for how it's applied.
+ */
+static void
+i40e_init_rss_lut_prop(i40e_t *i40e)
+{
+	int *lut;
+	uint_t i, nlut;
+
+	i40e->i40e_rss_lut_nconf = 0;
+	if (ddi_prop_lookup_int_array(DDI_DEV_T_ANY, i40e->i40e_dip,
+	    DDI_PROP_DONTPASS, "rss_lut", &lut, &nlut) != DDI_PROP_SUCCESS)
+		return;
+
+	if (nlut > I40E_RSS_LUT_MAX) {
+		i40e_log(i40e, "ignoring rss_lut entries past the first %d",
+		    I40E_RSS_LUT_MAX);
+		nlut = I40E_RSS_LUT_MAX;
+	}
+
+	for (i = 0; i < nlut; i++) {
+		if (lut[i] < 0 || lut[i] >= i40e->i40e_num_rings_per_group) {
+			i40e_log(i40e, "ignoring rss_lut, entry %u (%d) is not "
+			    "a ring index", i, lut[i]);
+			ddi_prop_free(lut);
+			return;
+		}
+		i40e->i40e_rss_lut_conf[i] = (uint8_t)lut[i];
+	}
+
+	i40e->i40e_rss_lut_nconf = nlut;
+	ddi_prop_free(lut);
+}
+
 static void
 i40e_init_properties(i40e_t *i40e)
 {
@@ -1543,6 +1663,10 @@ i40e_init_properties(i40e_t *i40e)
 		    I40E_DESC_ALIGN);
 	}
 
+	i40e->i40e_rx_free_list_size = i40e_get_prop(i40e, "rx_free_list_size",
+	    I40E_MIN_RX_FREE_LIST_SIZE, I40E_MAX_RX_FREE_LIST_SIZE,
+	    i40e->i40e_rx_ring_size * I40E_DEF_RX_FREE_LIST_MULT);
+
 	i40e->i40e_rx_limit_per_intr = i40e_get_prop(i40e, "rx_limit_per_intr",
 	    I40E_MIN_RX_LIMIT_PER_INTR,	I40E_MAX_RX_LIMIT_PER_INTR,
 	    I40E_DEF_RX_LIMIT_PER_INTR);
@@ -1570,11 +1694,23 @@ i40e_init_properties(i40e_t *i40e)
 	i40e->i40e_other_itr = i40e_get_prop(i40e, "other_intr_throttle",
 	    I40E_MIN_ITR, I40E_MAX_ITR, I40E_DEF_OTHER_ITR);
 
+	i40e->i40e_num_rx_groups = i40e_get_prop(i40e, "rx_groups",
+	    I40E_MIN_RX_GROUPS, I40E_MAX_RX_GROUPS, I40E_DEF_RX_GROUPS);
+
+	i40e->i40e_num_rings_per_group = i40e_get_prop(i40e,
+	    "rx_rings_per_group", I40E_MIN_RINGS_PER_GROUP,
+	    I40E_MAX_RINGS_PER_GROUP, I40E_DEF_RINGS_PER_GROUP);
+
 	if (!i40e->i40e_mr_enable) {
 		i40e->i40e_num_trqpairs = I40E_TRQPAIR_NOMSIX;
 		i40e->i40e_num_rx_groups = I40E_GROUP_NOMSIX;
+		i40e->i40e_num_rings_per_group = I40E_TRQPAIR_NOMSIX;
 	}
 
+	i40e->i40e_rss_enable = i40e_get_prop(i40e, "rss_enable",
+	    B_FALSE, B_TRUE, B_TRUE);
+	i40e_init_rss_lut_prop(i40e);
+
 	i40e_update_mtu(i40e);
 }
 
@@ -1583,8 +1719,11 @@ i40e_init_properties(i40e_t *i40e)
  * of which are restrictions from hardware. For a fuller treatment, see
  * i40e_intr.c.
  *
- * Currently, to use MSI-X we require two interrupts be available though in
- * theory we should participate in IRM and happily use more interrupts.
+ * To use MSI-X we require two interrupts be available: one for the admin queue
+ * and other causes, plus at least one for I/O. We ask for one I/O interrupt per
+ * transmit/receive queue pair, bounded by what the PF supports, and spread the
+ * queue pairs over however many we actually get. In theory we should also
+ * participate in IRM.
  *
  * Hardware only supports a single MSI being programmed and therefore if we
  * don't have MSI-X interrupts available at this time, then we ratchet down the
@@ -1604,15 +1743,17 @@ i40e_alloc_intr_handles(i40e_t *i40e, dev_info_t *devinfo, int intr_type)
 		break;
 	case DDI_INTR_TYPE_MSIX:
 		/*
-		 * At the moment, we always request two MSI-X while we still
-		 * only support a single interrupt. The upper bound on what's
-		 * supported by a given device is defined by MSI_X_PF_N in
-		 * GLPCI_CNF2. When we evolve, we should read it to determine
-		 * what the real max is.
+		 * The upper bound on what's supported by a given device is
+		 * defined by MSI_X_PF_N in GLPCI_CNF2, which the common code
+		 * reports to us as part of the function capabilities.
 		 */
-		ASSERT(i40e->i40e_num_trqpairs == 1);
-		request = 2;
+		request = 1 + i40e->i40e_num_trqpairs;
+		if (i40e->i40e_hw_space.func_caps.num_msix_vectors != 0) {
+			request = MIN(request,
+			    i40e->i40e_hw_space.func_caps.num_msix_vectors);
+		}
 		min = 2;
+		request = MAX(request, min);
 		break;
 	default:
 		panic("bad interrupt type passed to i40e_alloc_intr_handles: "
@@ -1715,6 +1856,7 @@ i40e_alloc_intrs(i40e_t *i40e, dev_info_t *devinfo)
 	 */
 	i40e->i40e_num_trqpairs = I40E_TRQPAIR_NOMSIX;
 	i40e->i40e_num_rx_groups = I40E_GROUP_NOMSIX;
+	i40e->i40e_num_rings_per_group = I40E_TRQPAIR_NOMSIX;
 
 	if ((intr_types & DDI_INTR_TYPE_MSI) &&
 	    (i40e->i40e_intr_force <= I40E_INTR_MSI)) {
@@ -1736,23 +1878,25 @@ i40e_alloc_intrs(i40e_t *i40e, dev_info_t *devinfo)
 static boolean_t
 i40e_map_intrs_to_vectors(i40e_t *i40e)
 {
+	int i, nvec;
+
 	if (i40e->i40e_intr_type != DDI_INTR_TYPE_MSIX) {
 		return (B_TRUE);
 	}
 
 	/*
-	 * At the moment, we only have one queue and one interrupt thus both are
-	 * on that one interrupt. However, longer term we need to go back to
-	 * using the ixgbe style map of queues to vectors or walk the linked
-	 * list from the device to know what to go handle. Therefore for the
-	 * moment, since we need to map our single set of rings to the one
-	 * I/O interrupt that exists for MSI-X.
+	 * Vector zero belongs to the admin queue. Deal the queue pairs out
+	 * round-robin over the rest, keeping each pair's transmit and receive
+	 * sides together; i40e_intr_init_queue_msix() and i40e_intr_msix()
+	 * both rely on this layout.
 	 */
-	ASSERT(i40e->i40e_intr_count == 2);
-	ASSERT(i40e->i40e_num_trqpairs == 1);
+	ASSERT3U(i40e->i40e_intr_count, >=, 2);
+	nvec = i40e->i40e_intr_count - 1;
 
-	i40e->i40e_trqpairs[0].itrq_rx_intrvec = 1;
-	i40e->i40e_trqpairs[0].itrq_tx_intrvec = 1;
+	for (i = 0; i < i40e->i40e_num_trqpairs; i++) {
+		i40e->i40e_trqpairs[i].itrq_rx_intrvec = 1 + (i % nvec);
+		i40e->i40e_trqpairs[i].itrq_tx_intrvec = 1 + (i % nvec);
+	}
 
 	return (B_TRUE);
 }
@@ -1890,9 +2034,9 @@ i40e_init_macaddrs(i40e_t *i40e, i40e_hw_t *hw)
 }
 
 /*
- * Configure the hardware for the Virtual Station Interface (VSI).  Currently
- * we only support one, but in the future we could instantiate more than one
- * per attach-point.
+ * Configure the hardware for the default Virtual Station Interface (VSI), which
+ * backs the first group. The VSIs of the other groups are set up once, when
+ * they're added by i40e_add_vsis().
  */
 static boolean_t
 i40e_config_vsi(i40e_t *i40e, i40e_hw_t *hw)
@@ -1910,12 +2054,15 @@ i40e_config_vsi(i40e_t *i40e, i40e_hw_t *hw)
 	}
 
 	/*
-	 * Set the queue and traffic class bits.  Keep it simple for now.
+	 * Set the queue and traffic class bits. The default VSI owns the first
+	 * group's queue pairs.
 	 */
 	context.info.valid_sections = I40E_AQ_VSI_PROP_QUEUE_MAP_VALID;
 	context.info.mapping_flags = I40E_AQ_VSI_QUE_MAP_CONTIG;
-	context.info.queue_mapping[0] = I40E_ASSIGN_ALL_QUEUES;
-	context.info.tc_mapping[0] = I40E_TRAFFIC_CLASS_NO_QUEUES;
+	context.info.queue_mapping[0] =
+	    CPU_TO_LE16(I40E_GROUP_QUEUE_BASE(i40e, 0));
+	context.info.tc_mapping[0] = CPU_TO_LE16(
+	    I40E_TRAFFIC_CLASS_QUEUES(i40e->i40e_num_rings_per_group));
 
 	context.info.valid_sections |= I40E_AQ_VSI_PROP_VLAN_VALID;
 	context.info.port_vlan_flags = I40E_AQ_VSI_PVLAN_MODE_ALL |
@@ -1937,6 +2084,172 @@ i40e_config_vsi(i40e_t *i40e, i40e_hw_t *hw)
 	return (B_TRUE);
 }
 
+/*
+ * Remove whatever i40e_add_vsis() managed to add, including after it fails
+ * part way. Once the VEB goes away, firmware connects the default VSI straight
+ * to the MAC again.
+ */
+static void
+i40e_delete_vsis(i40e_t *i40e)
+{
+	i40e_hw_t *hw = &i40e->i40e_hw_space;
+	int i, err;
+
+	for (i = i40e->i40e_num_rx_groups - 1; i > 0; i--) {
+		i40e_rx_group_t *rxg = &i40e->i40e_rx_groups[i];
+
+		if (rxg->irg_vsi_seid == 0)
+			continue;
+
+		err = i40e_aq_delete_element(hw, rxg->irg_vsi_seid, NULL);
+		if (err != I40E_SUCCESS) {
+			i40e_error(i40e, "failed to delete VSI %d: %d",
+			    rxg->irg_vsi_seid, err);
+		}
+		rxg->irg_vsi_seid = 0;
+		i40e->i40e_resources.ifr_nvsis_used--;
+	}
+
+	if (i40e->i40e_veb_seid != 0) {
+		err = i40e_aq_delete_element(hw, i40e->i40e_veb_seid, NULL);
+		if (err != I40E_SUCCESS) {
+			i40e_error(i40e, "failed to delete VEB %d: %d",
+			    i40e->i40e_veb_seid, err);
+		}
+		i40e->i40e_veb_seid = 0;
+	}
+}
+
+/*
+ * Add a VMDq VSI to the VEB for every group past the first, giving each the
+ * contiguous run of queue pairs that make up its rings. With only a single
+ * group there's nothing to do and the default VSI stays directly on the MAC.
+ */
+static boolean_t
+i40e_add_vsis(i40e_t *i40e)
+{
+	i40e_hw_t *hw = &i40e->i40e_hw_space;
+	struct i40e_vsi_context	context;
+	int i, err;
+
+	i40e->i40e_rx_groups[0].irg_vsi_seid = i40e->i40e_vsi_id;
+
+	bzero(&context, sizeof (struct i40e_vsi_context));
+	context.seid = i40e->i40e_vsi_id;
+	context.pf_num = hw->pf_id;
+	err = i40e_aq_get_vsi_params(hw, &context, NULL);
+	if (err != I40E_SUCCESS) {
+		i40e_error(i40e, "get VSI params failed with %d", err);
+		return (B_FALSE);
+	}
+	i40e->i40e_rx_groups[0].irg_vsi_number = context.vsi_number;
+
+	if (i40e->i40e_num_rx_groups == 1)
+		return (B_TRUE);
+
+	err = i40e_aq_add_veb(hw, i40e->i40e_mac_seid, i40e->i40e_vsi_id, 0x1,
+	    B_FALSE, B_TRUE, &i40e->i40e_veb_seid, NULL);
+	if (err != I40E_SUCCESS) {
+		i40e_error(i40e, "failed to add VEB: %d, %d", err,
+		    hw->aq.asq_last_status);
+		return (B_FALSE);
+	}
+
+	for (i = 1; i < i40e->i40e_num_rx_groups; i++) {
+		i40e_rx_group_t *rxg = &i40e->i40e_rx_groups[i];
+
+		bzero(&context, sizeof (struct i40e_vsi_context));
+		context.uplink_seid = i40e->i40e_veb_seid;
+		context.pf_num = hw->pf_id;
+		context.flags = I40E_AQ_VSI_TYPE_VMDQ2;
+		context.connection_type = I40E_AQ_VSI_CONN_TYPE_NORMAL;
+
+		context.info.valid_sections =
+		    CPU_TO_LE16(I40E_AQ_VSI_PROP_QUEUE_MAP_VALID |
+		    I40E_AQ_VSI_PROP_VLAN_VALID);
+		context.info.mapping_flags =
+		    CPU_TO_LE16(I40E_AQ_VSI_QUE_MAP_CONTIG);
+		context.info.queue_mapping[0] =
+		    CPU_TO_LE16(I40E_GROUP_QUEUE_BASE(i40e, i));
+		context.info.tc_mapping[0] = CPU_TO_LE16(
+		    I40E_TRAFFIC_CLASS_QUEUES(i40e->i40e_num_rings_per_group));
+		context.info.port_vlan_flags = I40E_AQ_VSI_PVLAN_MODE_ALL |
+		    I40E_AQ_VSI_PVLAN_EMOD_NOTHING;
+
+		err = i40e_aq_add_vsi(hw, &context, NULL);
+		if (err != I40E_SUCCESS) {
+			i40e_error(i40e, "failed to add VSI for group %d: "
+			    "%d, %d", i, err, hw->aq.asq_last_status);
+			i40e_delete_vsis(i40e);
+			return (B_FALSE);
+		}
+
+		rxg->irg_vsi_seid = context.seid;
+		rxg->irg_vsi_number = context.vsi_number;
+		i40e->i40e_resources.ifr_nvsis_used++;
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Program the RSS key, lookup table, and hashed packet types. See the RSS
+ * section of the big theory statement for how these fit together.
+ */
+static void
+i40e_config_rss(i40e_t *i40e, i40e_hw_t *hw)
+{
+	uint8_t lut[I40E_RSS_LUT_MAX];
+	uint64_t hena;
+	uint32_t reg;
+	uint_t i, nlut;
+
+	if (!i40e->i40e_rss_enable || i40e->i40e_num_rings_per_group == 1) {
+		I40E_WRITE_REG(hw, I40E_PFQF_HENA(0), 0);
+		I40E_WRITE_REG(hw, I40E_PFQF_HENA(1), 0);
+		return;
+	}
+
+	for (i = 0; i < I40E_RSS_KEY_WORDS; i++)
+		I40E_WRITE_REG(hw, I40E_PFQF_HKEY(i), i40e->i40e_rss_key[i]);
+
+	/*
+	 * The PF's table is either 128 or 512 entries and must be told which.
+	 */
+	nlut = MIN(hw->func_caps.rss_table_size, I40E_RSS_LUT_MAX);
+	if (nlut == 0)
+		nlut = I40E_RSS_LUT_MAX;
+	reg = I40E_READ_REG(hw, I40E_PFQF_CTL_0);
+	if (nlut == I40E_RSS_LUT_MAX)
+		reg |= I40E_PFQF_CTL_0_HASHLUTSIZE_512;
+	else
+		reg &= ~I40E_PFQF_CTL_0_HASHLUTSIZE_512;
+	I40E_WRITE_REG(hw, I40E_PFQF_CTL_0, reg);
+
+	for (i = 0; i < nlut; i++) {
+		uint_t ring;
+
+		if (i40e->i40e_rss_lut_nconf != 0)
+			ring = i40e->i40e_rss_lut_conf[i %
+			    i40e->i40e_rss_lut_nconf];
+		else
+			ring = i;
+		lut[i] = ring % i40e->i40e_num_rings_per_group;
+	}
+
+	for (i = 0; i < nlut / 4; i++) {
+		reg = lut[i * 4] | (lut[i * 4 + 1] << 8) |
+		    (lut[i * 4 + 2] << 16) | (lut[i * 4 + 3] << 24);
+		I40E_WRITE_REG(hw, I40E_PFQF_HLUT(i), reg);
+	}
+
+	hena = (uint64_t)I40E_READ_REG(hw, I40E_PFQF_HENA(0)) |
+	    ((uint64_t)I40E_READ_REG(hw, I40E_PFQF_HENA(1)) << 32);
+	hena |= I40E_RSS_HENA_DEFAULT;
+	I40E_WRITE_REG(hw, I40E_PFQF_HENA(0), (uint32_t)hena);
+	I40E_WRITE_REG(hw, I40E_PFQF_HENA(1), (uint32_t)(hena >> 32));
+}
+
 /*
  * Wrapper to kick the chipset on.
  */
@@ -1982,6 +2295,8 @@ i40e_chip_start(i40e_t *i40e)
 	if (!i40e_config_vsi(i40e, hw))
 		return (B_FALSE);
 
+	i40e_config_rss(i40e, hw);
+
 	i40e_flush(hw);
 
 	return (B_TRUE);
@@ -2332,12 +2647,13 @@ i40e_setup_tx_hmc(i40e_trqpair_t *itrq)
 
 	/*
 	 * We're supposed to assign the rdylist field with the value of the
-	 * traffic class index for the first device. We query the VSI parameters
-	 * again to get what the handle is. Note that every queue is always
-	 * assigned to traffic class zero, because we don't actually use them.
+	 * traffic class index for the first device. We query the parameters of
+	 * the VSI that owns this queue to get what the handle is. Note that
+	 * every queue is always assigned to traffic class zero, because we
+	 * don't actually use them.
 	 */
 	bzero(&context, sizeof (struct i40e_vsi_context));
-	context.seid = i40e->i40e_vsi_id;
+	context.seid = I40E_QUEUE_GROUP(i40e, itrq->itrq_index)->irg_vsi_seid;
 	context.pf_num = hw->pf_id;
 	err = i40e_aq_get_vsi_params(hw, &context, NULL);
 	if (err != I40E_SUCCESS) {
@@ -2375,6 +2691,7 @@ i40e_setup_tx_rings(i40e_t *i40e)
 
 	for (i = 0; i < i40e->i40e_num_trqpairs; i++) {
 		i40e_trqpair_t *itrq = &i40e->i40e_trqpairs[i];
+		i40e_rx_group_t *rxg;
 		uint32_t reg;
 
 		/*
@@ -2391,8 +2708,17 @@ i40e_setup_tx_rings(i40e_t *i40e)
 
 		/*
 		 * Step 3. Verify that it's clear that this PF owns this queue.
+		 * Queues of the groups past the first belong to their VMDq VSI.
 		 */
-		reg = I40E_QTX_CTL_PF_QUEUE;
+		rxg = I40E_QUEUE_GROUP(i40e, itrq->itrq_index);
+		if (rxg->irg_index == 0) {
+			reg = I40E_QTX_CTL_PF_QUEUE;
+		} else {
+			reg = I40E_QTX_CTL_VM_QUEUE;
+			reg |= (rxg->irg_vsi_number <<
+			    I40E_QTX_CTL_VFVM_INDX_SHIFT) &
+			    I40E_QTX_CTL_VFVM_INDX_MASK;
+		}
 		reg |= (hw->pf_id << I40E_QTX_CTL_PF_INDX_SHIFT) &
 		    I40E_QTX_CTL_PF_INDX_MASK;
 		I40E_WRITE_REG(hw, I40E_QTX_CTL(itrq->itrq_index), reg);
@@ -2702,6 +3028,12 @@ i40e_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	}
 	i40e->i40e_attach_progress |= I40E_ATTACH_ALLOC_RINGSLOCKS;
 
+	if (!i40e_add_vsis(i40e)) {
+		i40e_error(i40e, "Failed to add VSIs for the rx groups.");
+		goto attach_fail;
+	}
+	i40e->i40e_attach_progress |= I40E_ATTACH_VSIS;
+
 	if (!i40e_map_intrs_to_vectors(i40e)) {
 		i40e_error(i40e, "Failed to map interrupts to vectors.");
 		goto attach_fail;
@@ -1269,6 +1269,12 @@ i40e_stats_trqpair_init(i40e_trqpair_t *itrq)
 	kstat_named_init(&rsp->irxs_rx_bind_nomp, "rx_bind_nomp",
 	    KSTAT_DATA_UINT64);
 	rsp->irxs_rx_bind_nomp.value.ui64 = 0;
+	kstat_named_init(&rsp->irxs_rx_bind, "rx_bind",
+	    KSTAT_DATA_UINT64);
+	rsp->irxs_rx_bind.value.ui64 = 0;
+	kstat_named_init(&rsp->irxs_rx_copy, "rx_copy",
+	    KSTAT_DATA_UINT64);
+	rsp->irxs_rx_copy.value.ui64 = 0;
 	kstat_named_init(&rsp->irxs_rx_copy_nomem, "rx_copy_nomem",
 	    KSTAT_DATA_UINT64);
 	rsp->irxs_rx_copy_nomem.value.ui64 = 0;
@@ -91,6 +91,16 @@ extern "C" {
 #define	I40E_MAX_RX_RING_SIZE	4096
 #define	I40E_DEF_RX_RING_SIZE	1024
 
+/*
+ * The rx free list holds the spare control blocks that we swap onto the ring
+ * when we loan a buffer up the stack. By default it's twice the size of the
+ * ring, so that a burst of loaned buffers that upper layers hang on to doesn't
+ * immediately push us back to copying.
+ */
+#define	I40E_MIN_RX_FREE_LIST_SIZE	64
+#define	I40E_MAX_RX_FREE_LIST_SIZE	16384
+#define	I40E_DEF_RX_FREE_LIST_MULT	2
+
 #define	I40E_DESC_ALIGN		32
 
 /*
@@ -241,18 +251,20 @@ typedef enum i40e_itr_index {
 
 /*
  * Whenever we establish and create a VSI, we need to assign some number of
- * queues that it's allowed to access from the PF. Because we only have a single
- * VSI per PF at this time, we assign it all the queues.
+ * queues that it's allowed to access from the PF. Each VSI is given the
+ * contiguous run of queues that back its receive group, starting at
+ * I40E_GROUP_QUEUE_BASE().
  *
  * Many of the devices support what's called Data-center Bridging. Which is a
  * feature that we don't have much use of at this time. However, we still need
  * to fill in this information. We follow the guidance of the note in Table 7-80
- * which talks about bytes 62-77. It says that if we don't want to assign
- * anything to traffic classes, we should set the field to zero. Effectively
- * this means that everything in the system is assigned to traffic class zero.
+ * which talks about bytes 62-77. Every queue of the VSI is placed in traffic
+ * class zero, which starts at the VSI's first queue and covers a power of two
+ * number of queues; the field holds that power.
  */
-#define	I40E_ASSIGN_ALL_QUEUES		0
-#define	I40E_TRAFFIC_CLASS_NO_QUEUES	0
+#define	I40E_TRAFFIC_CLASS_QUEUES(nqueues)			\
+	(((highbit(nqueues) - 1) << I40E_AQ_VSI_TC_QUE_NUMBER_SHIFT) &	\
+	I40E_AQ_VSI_TC_QUE_NUMBER_MASK)
 
 /*
  * This defines the error mask that we care about from rx descriptors. Currently
@@ -268,16 +280,49 @@ typedef enum i40e_itr_index {
 #define	I40E_DDI_PROP_LEN	64
 
 /*
- * We currently consolidate some overrides that we use in the code here. These
- * will be gone in the fullness of time, but as we're bringing up the device,
- * this is what we use.
+ * Sizing of receive groups and of the transmit/receive queue pairs in each of
+ * them. Every group is backed by its own VSI and each VSI's queues must be a
+ * power of two, so the number of rings per group is rounded down to one. The
+ * total number of queue pairs is the product of the two. Without MSI-X we only
+ * ever have a single group with a single ring.
  */
-#define	I40E_GROUP_MAX		1
-#define	I40E_TRQPAIR_MAX	1
+#define	I40E_MIN_RX_GROUPS		1
+#define	I40E_MAX_RX_GROUPS		32
+#define	I40E_DEF_RX_GROUPS		4
+
+#define	I40E_MIN_RINGS_PER_GROUP	1
+#define	I40E_MAX_RINGS_PER_GROUP	16
+#define	I40E_DEF_RINGS_PER_GROUP	4
 
 #define	I40E_GROUP_NOMSIX	1
 #define	I40E_TRQPAIR_NOMSIX	1
 
+#define	I40E_GROUP_QUEUE_BASE(i40e, group)	\
+	((group) * (i40e)->i40e_num_rings_per_group)
+#define	I40E_QUEUE_GROUP(i40e, queue)	\
+	(&(i40e)->i40e_rx_groups[(queue) / (i40e)->i40e_num_rings_per_group])
+
+/*
+ * RSS sizing. The hash key is always the full 52 bytes that the PF registers
+ * hold and the lookup table is at most 512 one-byte entries, four to a
+ * register. The default set of hashed packet classifier types covers TCP, UDP,
+ * SCTP and other IP traffic for both IPv4 and IPv6, including fragments.
+ */
+#define	I40E_RSS_KEY_WORDS	(I40E_PFQF_HKEY_MAX_INDEX + 1)
+#define	I40E_RSS_LUT_MAX	((I40E_PFQF_HLUT_MAX_INDEX + 1) * 4)
+
+#define	I40E_RSS_HENA_DEFAULT	(				\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV4_UDP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV4_TCP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV4_SCTP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV4_OTHER) |		\
+	(1ULL << I40E_FILTER_PCTYPE_FRAG_IPV4) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV6_UDP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV6_TCP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV6_SCTP) |		\
+	(1ULL << I40E_FILTER_PCTYPE_NONF_IPV6_OTHER) |		\
+	(1ULL << I40E_FILTER_PCTYPE_FRAG_IPV6))
+
 /*
  * It seems reasonable to cast this to void because the only reason that we
  * should be getting a DDI_FAILURE is due to the fact that we specify addresses
@@ -312,6 +357,7 @@ typedef enum i40e_attach_state {
 	I40E_ATTACH_ADD_INTR	= 0x0020,	/* Intr handlers added */
 	I40E_ATTACH_COMMON_CODE	= 0x0040, 	/* Intel code initialized */
 	I40E_ATTACH_INIT	= 0x0080,	/* Device initialized */
+	I40E_ATTACH_VSIS	= 0x0100,	/* Group VSIs and VEB added */
 	I40E_ATTACH_STATS	= 0x0200,	/* Kstats created */
 	I40E_ATTACH_MAC		= 0x0800,	/* MAC registered */
 	I40E_ATTACH_ENABLE_INTR	= 0x1000,	/* DDI interrupts enabled */
@@ -371,6 +417,7 @@ typedef struct i40e_dma_buffer {
  * RX Control Block
  */
 typedef struct i40e_rx_control_block {
+	struct i40e_rx_control_block	*rcb_next;
 	mblk_t			*rcb_mp;
 	uint32_t		rcb_ref;
 	i40e_dma_buffer_t	rcb_dma;
@@ -409,13 +456,15 @@ typedef struct i40e_rx_data {
 	uint32_t rxd_desc_next;			/* Index of next rx desc */
 
 	/*
-	 * RX control block list definitions
+	 * RX control block list definitions. The free list is only touched
+	 * with the ring's itrq_rx_lock held. The recycle list is a lock-free
+	 * stack that i40e_rx_recycle() pushes returned control blocks onto;
+	 * the rx path takes it over wholesale when the free list runs dry.
 	 */
-	kmutex_t		rxd_free_lock;	/* Lock to protect free data */
 	i40e_rx_control_block_t	*rxd_rcb_area;	/* Array of control blocks */
 	i40e_rx_control_block_t	**rxd_work_list; /* Work list of rcbs */
-	i40e_rx_control_block_t	**rxd_free_list; /* Free list of rcbs */
-	uint32_t		rxd_rcb_free;	/* Number of free rcbs */
+	i40e_rx_control_block_t	*rxd_free_list;	/* Free list of rcbs */
+	i40e_rx_control_block_t	*rxd_recycle_list; /* Recycled rcbs */
 
 	/*
 	 * RX software ring settings
@@ -467,6 +516,8 @@ typedef struct i40e_rxq_stat {
 	kstat_named_t	irxs_rx_intr_limit;	/* Hit i40e_rx_limit_per_intr */
 	kstat_named_t	irxs_rx_bind_norcb;	/* No replacement rcb free */
 	kstat_named_t	irxs_rx_bind_nomp;	/* No mblk_t in bind rcb */
+	kstat_named_t	irxs_rx_bind;		/* Frames loaned up */
+	kstat_named_t	irxs_rx_copy;		/* Frames copied */
 
 	/*
 	 * The following set of statistics covers rx checksum related activity.
@@ -526,6 +577,7 @@ typedef struct i40e_trqpair {
 	uint64_t itrq_rxgen;		/* Generation number for mac/GLDv3. */
 	uint32_t itrq_index;		/* Queue index in the PF */
 	uint32_t itrq_rx_intrvec;	/* Receive interrupt vector. */
+	boolean_t itrq_intr_poll;	/* True when polling rather than intr */
 
 	/* Receive-side stats. */
 	i40e_rxq_stat_t	itrq_rxstat;
@@ -568,6 +620,21 @@ typedef struct i40e_trqpair {
 
 } i40e_trqpair_t;
 
+/*
+ * A receive ring group. Every group is backed by its own VSI, so the MAC
+ * filters that MAC programs into a group steer traffic only to that group's
+ * rings, where RSS then spreads it out. Group zero is always the default VSI
+ * that firmware created for the PF; the others hang off of a VEB that we add
+ * below it.
+ */
+typedef struct i40e_rx_group {
+	uint32_t		irg_index;	/* Index in i40e_rx_groups */
+	struct i40e		*irg_i40e;
+	mac_group_handle_t	irg_grp_hdl;	/* Handle from MAC */
+	uint16_t		irg_vsi_seid;	/* Switch element ID of VSI */
+	uint16_t		irg_vsi_number;	/* Absolute VSI number */
+} i40e_rx_group_t;
+
 /*
  * VSI statistics.
  *
@@ -768,6 +835,8 @@ typedef struct i40e {
 	 * Device state, switch information, and resources.
 	 */
 	int			i40e_vsi_id;
+	uint16_t		i40e_mac_seid;
+	uint16_t		i40e_veb_seid;
 	struct i40e_device	*i40e_device;
 	i40e_func_rsrc_t	i40e_resources;
 	uint16_t		i40e_switch_rsrc_alloc;
@@ -792,9 +861,11 @@ typedef struct i40e {
 	uint_t		i40e_other_itr;
 
 	int		i40e_num_rx_groups;
+	int		i40e_num_rings_per_group;
+	i40e_rx_group_t	*i40e_rx_groups;
 	int		i40e_num_rx_descs;
-	mac_group_handle_t i40e_rx_group_handle;
 	uint32_t	i40e_rx_ring_size;
+	uint32_t	i40e_rx_free_list_size;
 	uint32_t	i40e_rx_buf_size;
 	boolean_t	i40e_rx_hcksum_enable;
 	uint32_t	i40e_rx_dma_min;
@@ -809,13 +880,17 @@ typedef struct i40e {
 	uint32_t	i40e_tx_dma_min;
 	uint_t		i40e_tx_itr;
 
+	/*
+	 * RSS tunables. The lookup table from the .conf file, if any, holds
+	 * ring indexes within a group and is repeated to fill the hardware's.
+	 */
+	boolean_t	i40e_rss_enable;
+	uint32_t	i40e_rss_key[I40E_RSS_KEY_WORDS];
+	uint8_t		i40e_rss_lut_conf[I40E_RSS_LUT_MAX];
+	uint_t		i40e_rss_lut_nconf;
+
 	/*
 	 * Interrupt state
-	 *
-	 * Note that the use of a single boolean_t for i40e_intr_poll isn't
-	 * really the best design. When we have more than a single ring on the
-	 * device working, we'll transition to using something more
-	 * sophisticated.
 	 */
 	uint_t		i40e_intr_pri;
 	uint_t		i40e_intr_force;
@@ -827,7 +902,6 @@ typedef struct i40e {
 	size_t		i40e_intr_size;
 	ddi_intr_handle_t *i40e_intr_handles;
 	ddi_cb_handle_t	i40e_callback_handle;
-	boolean_t	i40e_intr_poll;
 
 	/*
 	 * DMA attributes. See i40e_transceiver.c for why we have copies of them
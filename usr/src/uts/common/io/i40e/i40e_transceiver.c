@@ -113,13 +113,13 @@
  *
  * To try and ensure that the device always has blocks that it can receive data
  * into, we maintain two lists of control blocks, a working list and a free
- * list. Each list is sized equal to the number of descriptors in the rx ring.
- * During the GLDv3 mc_start routine, we allocate a number of rx control blocks
- * equal to twice the number of descriptors in the ring and we assign them
- * equally to the free list and to the working list. Each control block also has
- * DMA memory allocated and associated with which it will be used to receive the
- * actual packet data. All of a received frame's data will end up in a single
- * DMA buffer.
+ * list. The working list is sized equal to the number of descriptors in the rx
+ * ring; the free list is sized by the rx_free_list_size property, which
+ * defaults to twice the ring size. During the GLDv3 mc_start routine, we
+ * allocate enough rx control blocks to fill both lists and assign them
+ * accordingly. Each control block also has DMA memory allocated and associated
+ * with which it will be used to receive the actual packet data. All of a
+ * received frame's data will end up in a single DMA buffer.
  *
  * During operation, we always maintain the invariant that each rx descriptor
  * has an associated rx control block which lives in the working list. If we
@@ -131,10 +131,17 @@
  *
  * Loaned message blocks come back to use when freemsg(9F) or freeb(9F) is
  * called on the block, at which point we restore the rx control block to the
- * free list and are able to reuse the DMA memory again. While the scheme may
- * seem odd, it importantly keeps us out of trying to do any DMA allocations in
- * the normal path of operation, even though we may still have to allocate
- * message blocks and copy.
+ * free list and are able to reuse the DMA memory again. The free routine can
+ * run on any CPU and in any context, so rather than contend with the rx path
+ * on a lock, it pushes the control block onto a lock-free stack, the recycle
+ * list, with a compare-and-swap. The rx path, which alone consumes control
+ * blocks while holding the ring's lock, pops from a private free list and only
+ * when that is empty does it atomically take over the entire recycle list.
+ * Because the consumer never pops individual entries off of the shared stack,
+ * there is no ABA problem to worry about. While the scheme may seem odd, it
+ * importantly keeps us out of trying to do any DMA allocations in the normal
+ * path of operation, even though we may still have to allocate message blocks
+ * and copy.
  *
  * The following state machine describes the life time of a rx control block. In
  * the diagram we abbrviate the rx ring descriptor entry as rxd and the rx
@@ -632,13 +639,6 @@ i40e_free_rx_data(i40e_rx_data_t *rxd)
 		rxd->rxd_rcb_area = NULL;
 	}
 
-	if (rxd->rxd_free_list != NULL) {
-		kmem_free(rxd->rxd_free_list,
-		    sizeof (i40e_rx_control_block_t *) *
-		    rxd->rxd_free_list_size);
-		rxd->rxd_free_list = NULL;
-	}
-
 	if (rxd->rxd_work_list != NULL) {
 		kmem_free(rxd->rxd_work_list,
 		    sizeof (i40e_rx_control_block_t *) *
@@ -661,9 +661,7 @@ i40e_alloc_rx_data(i40e_t *i40e, i40e_trqpair_t *itrq)
 	rxd->rxd_i40e = i40e;
 
 	rxd->rxd_ring_size = i40e->i40e_rx_ring_size;
-	rxd->rxd_free_list_size = i40e->i40e_rx_ring_size;
-
-	rxd->rxd_rcb_free = rxd->rxd_free_list_size;
+	rxd->rxd_free_list_size = i40e->i40e_rx_free_list_size;
 
 	rxd->rxd_work_list = kmem_zalloc(sizeof (i40e_rx_control_block_t *) *
 	    rxd->rxd_ring_size, KM_NOSLEEP);
@@ -674,14 +672,6 @@ i40e_alloc_rx_data(i40e_t *i40e, i40e_trqpair_t *itrq)
 		goto cleanup;
 	}
 
-	rxd->rxd_free_list = kmem_zalloc(sizeof (i40e_rx_control_block_t *) *
-	    rxd->rxd_free_list_size, KM_NOSLEEP);
-	if (rxd->rxd_free_list == NULL) {
-		i40e_error(i40e, "failed to allocate a %d entry rx free list "
-		    "for ring %d", rxd->rxd_free_list_size, itrq->itrq_index);
-		goto cleanup;
-	}
-
 	rxd->rxd_rcb_area = kmem_zalloc(sizeof (i40e_rx_control_block_t) *
 	    (rxd->rxd_free_list_size + rxd->rxd_ring_size), KM_NOSLEEP);
 	if (rxd->rxd_rcb_area == NULL) {
@@ -792,7 +782,8 @@ i40e_alloc_rx_dma(i40e_rx_data_t *rxd)
 		if (i < rxd->rxd_ring_size) {
 			rxd->rxd_work_list[i] = rcb;
 		} else {
-			rxd->rxd_free_list[i - rxd->rxd_ring_size] = rcb;
+			rcb->rcb_next = rxd->rxd_free_list;
+			rxd->rxd_free_list = rcb;
 		}
 
 		dmap = &rcb->rcb_dma;
@@ -1069,32 +1060,46 @@ i40e_init_dma_attrs(i40e_t *i40e, boolean_t fma)
 	}
 }
 
+/*
+ * Return a control block to the recycle list. This may be called from any
+ * context, so it must not block. See the big theory statement.
+ */
 static void
 i40e_rcb_free(i40e_rx_data_t *rxd, i40e_rx_control_block_t *rcb)
 {
-	mutex_enter(&rxd->rxd_free_lock);
-	ASSERT(rxd->rxd_rcb_free < rxd->rxd_free_list_size);
-	ASSERT(rxd->rxd_free_list[rxd->rxd_rcb_free] == NULL);
-	rxd->rxd_free_list[rxd->rxd_rcb_free] = rcb;
-	rxd->rxd_rcb_free++;
-	mutex_exit(&rxd->rxd_free_lock);
+	i40e_rx_control_block_t *head, *old;
+
+	head = rxd->rxd_recycle_list;
+	for (;;) {
+		rcb->rcb_next = head;
+		membar_producer();
+		old = atomic_cas_ptr(&rxd->rxd_recycle_list, head, rcb);
+		if (old == head)
+			break;
+		head = old;
+	}
 }
 
+/*
+ * Grab a control block to swap onto the ring. This must only be called with
+ * the ring's rx lock held, as it's the sole consumer of the free lists.
+ */
 static i40e_rx_control_block_t *
 i40e_rcb_alloc(i40e_rx_data_t *rxd)
 {
 	i40e_rx_control_block_t *rcb;
 
-	mutex_enter(&rxd->rxd_free_lock);
-	if (rxd->rxd_rcb_free == 0) {
-		mutex_exit(&rxd->rxd_free_lock);
-		return (NULL);
+	if (rxd->rxd_free_list == NULL) {
+		rxd->rxd_free_list = atomic_swap_ptr(&rxd->rxd_recycle_list,
+		    NULL);
+		membar_consumer();
+		if (rxd->rxd_free_list == NULL)
+			return (NULL);
 	}
-	rxd->rxd_rcb_free--;
-	rcb = rxd->rxd_free_list[rxd->rxd_rcb_free];
-	VERIFY(rcb != NULL);
-	rxd->rxd_free_list[rxd->rxd_rcb_free] = NULL;
-	mutex_exit(&rxd->rxd_free_lock);
+
+	rcb = rxd->rxd_free_list;
+	rxd->rxd_free_list = rcb->rcb_next;
+	rcb->rcb_next = NULL;
 
 	return (rcb);
 }
@@ -1189,7 +1194,7 @@ i40e_rx_bind(i40e_trqpair_t *itrq, i40e_rx_data_t *rxd, uint32_t index,
 		    rcb->rcb_dma.dmab_size, 0, &rcb->rcb_free_rtn);
 		if (rcb->rcb_mp == NULL) {
 			itrq->itrq_rxstat.irxs_rx_bind_nomp.value.ui64++;
-			i40e_rcb_free(rxd, rcb);
+			i40e_rcb_free(rxd, rep_rcb);
 			return (NULL);
 		}
 	}
@@ -1199,7 +1204,7 @@ i40e_rx_bind(i40e_trqpair_t *itrq, i40e_rx_data_t *rxd, uint32_t index,
 	if (i40e_check_dma_handle(rcb->rcb_dma.dmab_dma_handle) != DDI_FM_OK) {
 		ddi_fm_service_impact(i40e->i40e_dip, DDI_SERVICE_DEGRADED);
 		atomic_or_32(&i40e->i40e_state, I40E_ERROR);
-		i40e_rcb_free(rxd, rcb);
+		i40e_rcb_free(rxd, rep_rcb);
 		return (NULL);
 	}
 
@@ -1212,6 +1217,7 @@ i40e_rx_bind(i40e_trqpair_t *itrq, i40e_rx_data_t *rxd, uint32_t index,
 	mp->b_next = mp->b_cont = NULL;
 
 	rxd->rxd_work_list[index] = rep_rcb;
+	itrq->itrq_rxstat.irxs_rx_bind.value.ui64++;
 	return (mp);
 }
 
@@ -1248,6 +1254,7 @@ i40e_rx_copy(i40e_trqpair_t *itrq, i40e_rx_data_t *rxd, uint32_t index,
 	mp->b_rptr += I40E_BUF_IPHDR_ALIGNMENT;
 	bcopy(rcb->rcb_dma.dmab_address, mp->b_rptr, plen);
 	mp->b_wptr = mp->b_rptr + plen;
+	itrq->itrq_rxstat.irxs_rx_copy.value.ui64++;
 
 	return (mp);
 }
@@ -1994,6 +2001,7 @@ i40e_tx_recycle_ring(i40e_trqpair_t *itrq)
 {
 	uint32_t wbhead, toclean, count;
 	i40e_tx_control_block_t *tcbhead;
+	mblk_t *mpchain = NULL;
 	i40e_t *i40e = itrq->itrq_i40e;
 
 	mutex_enter(&itrq->itrq_tx_lock);
@@ -2065,15 +2073,22 @@ i40e_tx_recycle_ring(i40e_trqpair_t *itrq)
 	mutex_exit(&itrq->itrq_tx_lock);
 
 	/*
-	 * Now clean up the tcb.
+	 * Now clean up the tcb. The mblks are gathered up and freed together
+	 * once we're done.
 	 */
 	while (tcbhead != NULL) {
 		i40e_tx_control_block_t *tcb = tcbhead;
 
 		tcbhead = tcb->tcb_next;
+		if (tcb->tcb_mp != NULL) {
+			tcb->tcb_mp->b_next = mpchain;
+			mpchain = tcb->tcb_mp;
+			tcb->tcb_mp = NULL;
+		}
 		i40e_tcb_reset(tcb);
 		i40e_tcb_free(itrq, tcb);
 	}
+	freemsgchain_bulk(mpchain);
 
 	DTRACE_PROBE2(i40e__recycle, i40e_trqpair_t *, itrq, uint32_t, count);
 }
@@ -2299,6 +2299,9 @@ idm_conn_set_isid(idm_conn_t *ic, uint8_t isid[ISCSI_ISID_LEN])
 static int
 _idm_init(void)
 {
+	/* Tabulate the operators for the CRC-32C digests */
+	idm_crc32c_init();
+
 	/* Initialize the rwlock for the taskid table */
 	rw_init(&idm.idm_taskid_table_lock, NULL, RW_DRIVER, NULL);
 
@@ -902,6 +902,170 @@ uint32_t idm_crc32c_table[256] =
 	0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
 };
 
+#if defined(__amd64)
+/*
+ * The crc32 instruction takes three cycles to complete but a new one
+ * can start every cycle, so long buffers are checksummed as three
+ * interleaved streams.  The CRCs of the streams are then combined by
+ * shifting each over the length of the stream after it (appending
+ * that many zero bytes) and adding in the CRC of that stream.  The
+ * shift operators are tabulated by idm_crc32c_init().
+ */
+#define	IDM_CRC32C_LONG		8192
+#define	IDM_CRC32C_SHORT	256
+
+static uint32_t idm_crc32c_long[4][256];
+static uint32_t idm_crc32c_short[4][256];
+
+static uint32_t
+idm_gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	while (vec != 0) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+	return (sum);
+}
+
+static void
+idm_gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = idm_gf2_matrix_times(mat, mat[n]);
+}
+
+/*
+ * Tabulate the operator appending len (a power of two) zero bytes.
+ */
+static void
+idm_crc32c_zeros(uint32_t zeros[][256], size_t len)
+{
+	uint32_t even[32], odd[32];
+	uint32_t *op;
+	uint32_t row;
+	int n;
+
+	/* Operator for one zero bit (the reflected polynomial) */
+	odd[0] = 0x82F63B78;
+	row = 1;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	/* Two zero bits in even, four in odd */
+	idm_gf2_matrix_square(even, odd);
+	idm_gf2_matrix_square(odd, even);
+
+	/* Each square doubles the count, starting from one zero byte */
+	for (;;) {
+		idm_gf2_matrix_square(even, odd);
+		op = even;
+		if ((len >>= 1) == 0)
+			break;
+		idm_gf2_matrix_square(odd, even);
+		op = odd;
+		if ((len >>= 1) == 0)
+			break;
+	}
+
+	for (n = 0; n < 256; n++) {
+		zeros[0][n] = idm_gf2_matrix_times(op, n);
+		zeros[1][n] = idm_gf2_matrix_times(op, n << 8);
+		zeros[2][n] = idm_gf2_matrix_times(op, n << 16);
+		zeros[3][n] = idm_gf2_matrix_times(op, n << 24);
+	}
+}
+
+static uint32_t
+idm_crc32c_shift(uint32_t zeros[][256], uint32_t crc)
+{
+	return (zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+	    zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24]);
+}
+
+/*
+ * Hardware CRC-32C of a buffer, continuing from crc in the same way
+ * as intel_crc32c().
+ */
+static uint32_t
+idm_crc32c_hw(uint8_t *buffer, unsigned long length, uint32_t crc)
+{
+	uint32_t crc1, crc2;
+	uint8_t *end;
+
+	if (length < 3 * IDM_CRC32C_SHORT)
+		return (intel_crc32c(buffer, length, crc));
+
+	while (((uintptr_t)buffer & 7) != 0) {
+		crc = mm_crc32_u8(crc, buffer++);
+		length--;
+	}
+
+	while (length >= 3 * IDM_CRC32C_LONG) {
+		crc1 = crc2 = 0;
+		end = buffer + IDM_CRC32C_LONG;
+		do {
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc = mm_crc32_u64(crc, (uint64_t *)buffer);
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc1 = mm_crc32_u64(crc1, (uint64_t *)
+			    (buffer + IDM_CRC32C_LONG));
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc2 = mm_crc32_u64(crc2, (uint64_t *)
+			    (buffer + 2 * IDM_CRC32C_LONG));
+			buffer += 8;
+		} while (buffer < end);
+		crc = idm_crc32c_shift(idm_crc32c_long, crc) ^ crc1;
+		crc = idm_crc32c_shift(idm_crc32c_long, crc) ^ crc2;
+		buffer += 2 * IDM_CRC32C_LONG;
+		length -= 3 * IDM_CRC32C_LONG;
+	}
+
+	while (length >= 3 * IDM_CRC32C_SHORT) {
+		crc1 = crc2 = 0;
+		end = buffer + IDM_CRC32C_SHORT;
+		do {
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc = mm_crc32_u64(crc, (uint64_t *)buffer);
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc1 = mm_crc32_u64(crc1, (uint64_t *)
+			    (buffer + IDM_CRC32C_SHORT));
+			/* LINTED E_BAD_PTR_CAST_ALIGN */
+			crc2 = mm_crc32_u64(crc2, (uint64_t *)
+			    (buffer + 2 * IDM_CRC32C_SHORT));
+			buffer += 8;
+		} while (buffer < end);
+		crc = idm_crc32c_shift(idm_crc32c_short, crc) ^ crc1;
+		crc = idm_crc32c_shift(idm_crc32c_short, crc) ^ crc2;
+		buffer += 2 * IDM_CRC32C_SHORT;
+		length -= 3 * IDM_CRC32C_SHORT;
+	}
+
+	return (intel_crc32c(buffer, length, crc));
+}
+#else
+#define	idm_crc32c_hw(buffer, length, crc)	HW_CRC32(buffer, length, crc)
+#endif	/* __amd64 */
+
+/*
+ * Called once when the module loads, before any digest is computed.
+ */
+void
+idm_crc32c_init(void)
+{
+#if defined(__amd64)
+	idm_crc32c_zeros(idm_crc32c_long, IDM_CRC32C_LONG);
+	idm_crc32c_zeros(idm_crc32c_short, IDM_CRC32C_SHORT);
+#endif
+}
+
 /*
  * iscsi_crc32c - Steps through buffer one byte at at time, calculates
  * reflected crc using table.
@@ -925,7 +1089,7 @@ idm_crc32c(void *address, unsigned long length)
 		}
 	}
 	if (iscsi_crc32_hd == 0)
-		return (HW_CRC32(buffer, length, crc));
+		return (idm_crc32c_hw(buffer, length, crc));
 
 	while (length--) {
 		crc = idm_crc32c_table[(crc ^ *buffer++) & 0xFFL] ^
@@ -968,7 +1132,7 @@ idm_crc32c_continued(void *address, unsigned long length, uint32_t crc)
 		}
 	}
 	if (iscsi_crc32_hd == 0)
-		return (HW_CRC32_CONT(buffer, length, crc));
+		return (idm_crc32c_hw(buffer, length, crc ^ 0xFFFFFFFF));
 
 
 #ifdef	_BIG_ENDIAN
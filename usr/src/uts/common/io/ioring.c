@@ -0,0 +1,1115 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Support for the ioring facility: submission and completion queues shared
+ * with the application, through which a batch of reads, writes, fsyncs,
+ * sends, receives and accepts can be started and reaped with one ioctl.
+ *
+ * Opening /dev/ioring gives a clone instance; IORINGIOC_SETUP sizes the
+ * queues and returns the length of the region to mmap(2).  The region is
+ * kernel memory from ddi_umem_alloc(), so the driver reads submissions and
+ * writes completions through its kernel mapping without faulting.
+ *
+ * IORINGIOC_ENTER copies each new submission into an ioring_req_t, takes a
+ * hold on its file and hands it to the ring's taskq.  The workers are kernel
+ * threads and can't touch the submitter's address space, so data moves
+ * through a kernel buffer: writes and sends are copied in at submission,
+ * and reads and receives are copied out when the completion is posted.
+ * Posting is likewise done by IORINGIOC_ENTER, in the submitter's context,
+ * which also lets an accepted connection be given a descriptor there.
+ * Completed requests wait on ir_done until then; the ring polls readable
+ * while any are waiting, so it can be watched with poll(2) or associated
+ * with an event port.
+ *
+ * Socket operations are attempted without blocking.  One that would block
+ * is parked and retried every ioring_retry_ticks, so that a worker is never
+ * tied up by a quiet connection and so that close can cancel it.
+ */
+
+#include <sys/ddi.h>
+#include <sys/sunddi.h>
+#include <sys/ioring.h>
+#include <sys/conf.h>
+#include <sys/vmem.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/fcntl.h>
+#include <sys/disp.h>
+#include <sys/kmem.h>
+#include <sys/list.h>
+#include <sys/taskq_impl.h>
+#include <sys/vnode.h>
+#include <sys/nbmlock.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/cred.h>
+#include <sys/proc.h>
+#include <sys/socket.h>
+#include <sys/socketvar.h>
+#include <sys/model.h>
+#include <sys/atomic.h>
+#include <fs/sockfs/sockcommon.h>
+
+struct ioring_state;
+typedef struct ioring_state ioring_state_t;
+
+typedef struct ioring_req {
+	taskq_ent_t	irq_tqent;		/* taskq linkage */
+	list_node_t	irq_node;		/* on ir_done or ir_parked */
+	ioring_state_t	*irq_state;		/* owning ring */
+	ioring_sqe_t	irq_sqe;		/* copy of the submission */
+	file_t		*irq_fp;		/* held file */
+	cred_t		*irq_cred;		/* submitter's credentials */
+	caddr_t		irq_buf;		/* bounce buffer */
+	size_t		irq_len;		/* length of irq_buf */
+	u_offset_t	irq_maxoff;		/* largest offset for model */
+	rlim64_t	irq_llimit;		/* file size limit */
+	struct sonode	*irq_nso;		/* accepted connection */
+	timeout_id_t	irq_tid;		/* retry timeout, if parked */
+	int		irq_error;		/* errno, or 0 */
+	ssize_t		irq_res;		/* bytes transferred */
+} ioring_req_t;
+
+struct ioring_state {
+	kmutex_t ir_lock;			/* protects the fields below */
+	kcondvar_t ir_cv;			/* signalled on completion */
+	pollhead_t ir_pollhd;			/* poll head */
+	list_t ir_done;				/* completed, not yet posted */
+	list_t ir_parked;			/* waiting to be retried */
+	uint_t ir_inflight;			/* submitted, not yet posted */
+	boolean_t ir_closing;			/* ring is being torn down */
+	kmutex_t ir_enter_lock;			/* serializes setup and enter */
+	proc_t *ir_proc;			/* process that set up ring */
+	ddi_umem_cookie_t ir_cookie;		/* shared region */
+	size_t ir_size;				/* size of shared region */
+	ioring_hdr_t *ir_hdr;			/* kernel view of region */
+	uint32_t ir_sq_entries;			/* trusted copies of the */
+	uint32_t ir_cq_entries;			/* shared queue geometry */
+	uint32_t ir_sq_head;			/* and kernel-owned indices */
+	uint32_t ir_cq_tail;
+	ioring_sqe_t *ir_sqes;			/* submission queue */
+	ioring_cqe_t *ir_cqes;			/* completion queue */
+	taskq_t *ir_taskq;			/* workers */
+	ioring_state_t *ir_next;		/* next state on global list */
+};
+
+/*
+ * Tunables.
+ */
+uint_t	ioring_nthreads = 4;		/* default workers per ring */
+uint_t	ioring_max_nthreads = 64;	/* most workers per ring */
+size_t	ioring_maxio = 1024 * 1024;	/* largest single transfer */
+clock_t	ioring_retry_ticks = 1;		/* socket retry interval */
+
+/*
+ * Internal global variables.
+ */
+static kmutex_t		ioring_lock;		/* lock protecting state */
+static dev_info_t	*ioring_devi;		/* device info */
+static vmem_t		*ioring_minor;		/* minor number arena */
+static void		*ioring_softstate;	/* softstate pointer */
+static ioring_state_t	*ioring_state;		/* global list of state */
+static kmem_cache_t	*ioring_req_cache;	/* ioring_req_t cache */
+
+static void ioring_exec(void *);
+
+static void
+ioring_req_free(ioring_req_t *req)
+{
+	if (req->irq_nso != NULL) {
+		(void) socket_close(req->irq_nso, 0, req->irq_cred);
+		socket_destroy(req->irq_nso);
+	}
+	if (req->irq_buf != NULL)
+		kmem_free(req->irq_buf, req->irq_len);
+	if (req->irq_fp != NULL)
+		(void) closef(req->irq_fp);
+	if (req->irq_cred != NULL)
+		crfree(req->irq_cred);
+	kmem_cache_free(ioring_req_cache, req);
+}
+
+/*
+ * Move a finished request to the done list and wake anyone waiting for it.
+ */
+static void
+ioring_complete(ioring_req_t *req)
+{
+	ioring_state_t *state = req->irq_state;
+
+	mutex_enter(&state->ir_lock);
+	list_insert_tail(&state->ir_done, req);
+	cv_broadcast(&state->ir_cv);
+	mutex_exit(&state->ir_lock);
+
+	pollwakeup(&state->ir_pollhd, POLLRDNORM | POLLIN);
+}
+
+static void
+ioring_retry(void *arg)
+{
+	ioring_req_t *req = arg;
+	ioring_state_t *state = req->irq_state;
+
+	mutex_enter(&state->ir_lock);
+	if (req->irq_tid == 0) {
+		/*
+		 * The ring is closing and has already claimed this request.
+		 */
+		mutex_exit(&state->ir_lock);
+		return;
+	}
+	req->irq_tid = 0;
+	list_remove(&state->ir_parked, req);
+
+	/*
+	 * Dispatch before dropping the lock, so that close can't destroy
+	 * the taskq between our check and the dispatch.
+	 */
+	taskq_dispatch_ent(state->ir_taskq, ioring_exec, req, 0,
+	    &req->irq_tqent);
+	mutex_exit(&state->ir_lock);
+}
+
+/*
+ * A socket operation would have blocked; try it again later, unless the
+ * ring is going away.
+ */
+static void
+ioring_park(ioring_req_t *req)
+{
+	ioring_state_t *state = req->irq_state;
+
+	mutex_enter(&state->ir_lock);
+	if (state->ir_closing) {
+		mutex_exit(&state->ir_lock);
+		req->irq_error = ECANCELED;
+		ioring_complete(req);
+		return;
+	}
+	list_insert_tail(&state->ir_parked, req);
+	req->irq_tid = timeout(ioring_retry, req, ioring_retry_ticks);
+	mutex_exit(&state->ir_lock);
+}
+
+/*
+ * Reads and writes on everything but sockets; modelled on pread() and
+ * pwrite().
+ */
+static int
+ioring_rw(ioring_req_t *req)
+{
+	ioring_sqe_t *sqe = &req->irq_sqe;
+	file_t *fp = req->irq_fp;
+	vnode_t *vp = fp->f_vnode;
+	boolean_t write = (sqe->sqe_op == IORING_OP_WRITE);
+	u_offset_t fileoff = sqe->sqe_off;
+	ssize_t bcount = req->irq_len;
+	int fflag = fp->f_flag;
+	int rwflag = write ? 1 : 0;
+	int ioflag, svmand, in_crit = 0;
+	struct uio auio;
+	struct iovec aiov;
+	int error;
+
+	if ((fflag & (write ? FWRITE : FREAD)) == 0)
+		return (EBADF);
+
+	switch (vp->v_type) {
+	case VREG:
+		if (bcount == 0)
+			return (0);
+		if (fileoff > req->irq_maxoff)
+			return (write ? EFBIG : EINVAL);
+		if (write && fileoff >= req->irq_llimit)
+			return (EFBIG);
+		if (fileoff + bcount > req->irq_maxoff)
+			bcount = (ssize_t)((offset_t)req->irq_maxoff - fileoff);
+		break;
+	case VBLK:
+		break;
+	case VCHR:
+		/*
+		 * STREAMS devices may consult the calling process's session
+		 * and signal it, neither of which makes sense for a worker.
+		 */
+		if (vp->v_stream != NULL)
+			return (ENOTSUP);
+		break;
+	case VFIFO:
+		return (ESPIPE);
+	default:
+		return (EINVAL);
+	}
+
+	if (nbl_need_check(vp)) {
+		nbl_start_crit(vp, RW_READER);
+		in_crit = 1;
+		error = nbl_svmand(vp, fp->f_cred, &svmand);
+		if (error != 0)
+			goto out;
+		if (nbl_conflict(vp, write ? NBL_WRITE : NBL_READ, fileoff,
+		    bcount, svmand, NULL)) {
+			error = EACCES;
+			goto out;
+		}
+	}
+
+	aiov.iov_base = req->irq_buf;
+	aiov.iov_len = bcount;
+	auio.uio_loffset = fileoff;
+	auio.uio_iov = &aiov;
+	auio.uio_iovcnt = 1;
+	auio.uio_resid = bcount;
+	auio.uio_segflg = UIO_SYSSPACE;
+	auio.uio_llimit = write ? req->irq_llimit : MAXOFFSET_T;
+	auio.uio_fmode = fflag;
+	auio.uio_extflg = write ? UIO_COPY_DEFAULT : UIO_COPY_CACHED;
+
+	(void) VOP_RWLOCK(vp, rwflag, NULL);
+	if (write) {
+		ioflag = auio.uio_fmode & (FSYNC|FDSYNC|FRSYNC);
+		error = VOP_WRITE(vp, &auio, ioflag, fp->f_cred, NULL);
+	} else {
+		ioflag = auio.uio_fmode & (FAPPEND|FSYNC|FDSYNC|FRSYNC);
+		if ((ioflag & FRSYNC) == 0)
+			ioflag &= ~(FSYNC|FDSYNC);
+		error = VOP_READ(vp, &auio, ioflag, fp->f_cred, NULL);
+	}
+	VOP_RWUNLOCK(vp, rwflag, NULL);
+	bcount -= auio.uio_resid;
+
+	if (error == EINTR && bcount != 0)
+		error = 0;
+	req->irq_res = bcount;
+out:
+	if (in_crit)
+		nbl_end_crit(vp);
+	return (error);
+}
+
+/*
+ * Socket operations.  These go straight to the socket's ops vector with
+ * the nonblocking flag set; socket_sendmsg() is avoided since it would
+ * post SIGPIPE to the worker rather than to the submitter, so EPIPE is
+ * simply reported in the completion.
+ */
+static int
+ioring_sock(ioring_req_t *req)
+{
+	ioring_sqe_t *sqe = &req->irq_sqe;
+	file_t *fp = req->irq_fp;
+	struct sonode *so = VTOSO(fp->f_vnode);
+	struct nmsghdr msg;
+	struct uio auio;
+	struct iovec aiov;
+	boolean_t send;
+	int error;
+
+	if (sqe->sqe_op == IORING_OP_ACCEPT)
+		return (socket_accept(so, fp->f_flag | FNONBLOCK,
+		    req->irq_cred, &req->irq_nso));
+
+	send = (sqe->sqe_op == IORING_OP_WRITE ||
+	    sqe->sqe_op == IORING_OP_SENDMSG);
+
+	bzero(&msg, sizeof (msg));
+	if (sqe->sqe_op == IORING_OP_SENDMSG) {
+		msg.msg_flags = sqe->sqe_opflags &
+		    (MSG_OOB | MSG_EOR | MSG_DONTROUTE);
+	} else if (sqe->sqe_op == IORING_OP_RECVMSG) {
+		msg.msg_flags = sqe->sqe_opflags & (MSG_OOB | MSG_PEEK);
+	}
+	msg.msg_flags |= MSG_DONTWAIT;
+
+	aiov.iov_base = req->irq_buf;
+	aiov.iov_len = req->irq_len;
+	auio.uio_loffset = 0;
+	auio.uio_iov = &aiov;
+	auio.uio_iovcnt = 1;
+	auio.uio_resid = req->irq_len;
+	auio.uio_segflg = UIO_SYSSPACE;
+	auio.uio_llimit = MAXOFFSET_T;
+	auio.uio_fmode = fp->f_flag | FNONBLOCK;
+
+	if (send) {
+		auio.uio_extflg = UIO_COPY_DEFAULT;
+		error = SOP_SENDMSG(so, &msg, &auio, req->irq_cred);
+	} else {
+		auio.uio_extflg = UIO_COPY_CACHED;
+		error = SOP_RECVMSG(so, &msg, &auio, req->irq_cred);
+		if (msg.msg_namelen != 0)
+			kmem_free(msg.msg_name, (size_t)msg.msg_namelen);
+		if (msg.msg_controllen != 0)
+			kmem_free(msg.msg_control, (size_t)msg.msg_controllen);
+	}
+
+	req->irq_res = req->irq_len - auio.uio_resid;
+	if (error != 0 && req->irq_res != 0 &&
+	    (error == EINTR || error == EWOULDBLOCK || error == ENOMEM))
+		error = 0;
+
+	return (error);
+}
+
+static void
+ioring_exec(void *arg)
+{
+	ioring_req_t *req = arg;
+	ioring_sqe_t *sqe = &req->irq_sqe;
+	vnode_t *vp = req->irq_fp != NULL ? req->irq_fp->f_vnode : NULL;
+	int error = 0;
+
+	switch (sqe->sqe_op) {
+	case IORING_OP_NOP:
+		break;
+
+	case IORING_OP_READ:
+	case IORING_OP_WRITE:
+		if (vp->v_type == VSOCK)
+			error = ioring_sock(req);
+		else
+			error = ioring_rw(req);
+		break;
+
+	case IORING_OP_FSYNC:
+		error = VOP_FSYNC(vp,
+		    (sqe->sqe_opflags & IORING_FSYNC_DATASYNC) ? FDSYNC : FSYNC,
+		    req->irq_fp->f_cred, NULL);
+		break;
+
+	case IORING_OP_SENDMSG:
+	case IORING_OP_RECVMSG:
+	case IORING_OP_ACCEPT:
+		error = ioring_sock(req);
+		break;
+	}
+
+	if (error == EWOULDBLOCK && vp != NULL && vp->v_type == VSOCK &&
+	    !(req->irq_fp->f_flag & (FNONBLOCK | FNDELAY))) {
+		ioring_park(req);
+		return;
+	}
+
+	req->irq_error = error;
+	ioring_complete(req);
+}
+
+/*
+ * Turn a submission entry into a request.  Returns the errno to report in
+ * the completion if the request can't be started.
+ */
+static int
+ioring_prep(ioring_req_t *req)
+{
+	ioring_sqe_t *sqe = &req->irq_sqe;
+	vnode_t *vp;
+	file_t *fp;
+
+	if (sqe->sqe_op >= IORING_OP_MAX || sqe->sqe_flags != 0)
+		return (EINVAL);
+
+	if (sqe->sqe_op == IORING_OP_NOP)
+		return (0);
+
+	if ((fp = getf(sqe->sqe_fd)) == NULL)
+		return (EBADF);
+
+	/*
+	 * The request outlives this system call, so it needs a hold on the
+	 * file itself rather than on the descriptor.
+	 */
+	mutex_enter(&fp->f_tlock);
+	fp->f_count++;
+	mutex_exit(&fp->f_tlock);
+	releasef(sqe->sqe_fd);
+	req->irq_fp = fp;
+	vp = fp->f_vnode;
+
+	switch (sqe->sqe_op) {
+	case IORING_OP_SENDMSG:
+	case IORING_OP_RECVMSG:
+	case IORING_OP_ACCEPT:
+		if (vp->v_type != VSOCK)
+			return (ENOTSOCK);
+		break;
+	}
+
+	/*
+	 * Receiving on an AF_UNIX socket may install passed descriptors in
+	 * the receiving process, which for a worker is the wrong one.
+	 */
+	if ((sqe->sqe_op == IORING_OP_READ ||
+	    sqe->sqe_op == IORING_OP_RECVMSG) && vp->v_type == VSOCK &&
+	    VTOSO(vp)->so_family == AF_UNIX)
+		return (EOPNOTSUPP);
+
+	if (sqe->sqe_op == IORING_OP_READ || sqe->sqe_op == IORING_OP_WRITE ||
+	    sqe->sqe_op == IORING_OP_SENDMSG ||
+	    sqe->sqe_op == IORING_OP_RECVMSG) {
+		req->irq_len = MIN(sqe->sqe_len, ioring_maxio);
+		if (req->irq_len != 0)
+			req->irq_buf = kmem_alloc(req->irq_len, KM_SLEEP);
+	}
+
+	if ((sqe->sqe_op == IORING_OP_WRITE ||
+	    sqe->sqe_op == IORING_OP_SENDMSG) && req->irq_len != 0 &&
+	    copyin((void *)(uintptr_t)sqe->sqe_addr, req->irq_buf,
+	    req->irq_len) != 0)
+		return (EFAULT);
+
+#ifdef _SYSCALL32_IMPL
+	req->irq_maxoff = get_udatamodel() == DATAMODEL_ILP32 ?
+	    MAXOFF32_T : MAXOFFSET_T;
+#else
+	req->irq_maxoff = MAXOFF32_T;
+#endif
+	req->irq_llimit = curproc->p_fsz_ctl;
+
+	return (0);
+}
+
+/*
+ * Consume up to to_submit entries from the submission queue.  The number
+ * outstanding is bounded by the size of the completion queue, so that every
+ * request has somewhere to land.  Only ir_sq_tail is taken from the shared
+ * header; the application could scribble on the rest.
+ */
+static uint_t
+ioring_submit(ioring_state_t *state, uint_t to_submit)
+{
+	ioring_hdr_t *hdr = state->ir_hdr;
+	uint32_t head, tail;
+	uint_t n, room;
+	ioring_req_t *req;
+	int error;
+
+	head = state->ir_sq_head;
+	tail = hdr->ir_sq_tail;
+	membar_consumer();
+
+	mutex_enter(&state->ir_lock);
+	room = state->ir_cq_entries - state->ir_inflight;
+	mutex_exit(&state->ir_lock);
+
+	to_submit = MIN(to_submit, tail - head);
+	to_submit = MIN(to_submit, state->ir_sq_entries);
+	to_submit = MIN(to_submit, room);
+
+	for (n = 0; n < to_submit; n++, head++) {
+		req = kmem_cache_alloc(ioring_req_cache, KM_SLEEP);
+		bzero(req, sizeof (*req));
+		req->irq_state = state;
+		req->irq_sqe =
+		    state->ir_sqes[head & (state->ir_sq_entries - 1)];
+		req->irq_cred = CRED();
+		crhold(req->irq_cred);
+
+		mutex_enter(&state->ir_lock);
+		state->ir_inflight++;
+		mutex_exit(&state->ir_lock);
+
+		if ((error = ioring_prep(req)) != 0) {
+			req->irq_error = error;
+			ioring_complete(req);
+			continue;
+		}
+
+		taskq_dispatch_ent(state->ir_taskq, ioring_exec, req, 0,
+		    &req->irq_tqent);
+	}
+
+	state->ir_sq_head = head;
+	membar_producer();
+	hdr->ir_sq_head = head;
+
+	return (n);
+}
+
+/*
+ * Finish a request in the submitter's context and return its result.
+ */
+static int32_t
+ioring_finish(ioring_req_t *req)
+{
+	ioring_sqe_t *sqe = &req->irq_sqe;
+	file_t *nfp;
+	int nfd, error;
+
+	if (req->irq_error != 0)
+		return (-req->irq_error);
+
+	switch (sqe->sqe_op) {
+	case IORING_OP_READ:
+	case IORING_OP_RECVMSG:
+		if (req->irq_res != 0 &&
+		    copyout(req->irq_buf, (void *)(uintptr_t)sqe->sqe_addr,
+		    req->irq_res) != 0)
+			return (-EFAULT);
+		break;
+
+	case IORING_OP_ACCEPT:
+		if ((nfd = ufalloc(0)) == -1)
+			return (-EMFILE);
+		if ((error = falloc(NULL, FWRITE|FREAD, &nfp, NULL)) != 0) {
+			setf(nfd, NULL);
+			return (-error);
+		}
+		nfp->f_vnode = SOTOV(req->irq_nso);
+		mutex_exit(&nfp->f_tlock);
+		setf(nfd, nfp);
+		req->irq_nso = NULL;
+
+		if (sqe->sqe_opflags & SOCK_CLOEXEC)
+			f_setfd(nfd, FD_CLOEXEC);
+
+		if (sqe->sqe_opflags & SOCK_NONBLOCK) {
+			if (VOP_SETFL(nfp->f_vnode, nfp->f_flag, FNONBLOCK,
+			    nfp->f_cred, NULL) == 0) {
+				mutex_enter(&nfp->f_tlock);
+				nfp->f_flag |= FNONBLOCK;
+				mutex_exit(&nfp->f_tlock);
+			}
+		}
+		return (nfd);
+	}
+
+	return ((int32_t)req->irq_res);
+}
+
+/*
+ * Post as many completed requests as the completion queue has room for.
+ */
+static uint_t
+ioring_reap(ioring_state_t *state)
+{
+	ioring_hdr_t *hdr = state->ir_hdr;
+	ioring_cqe_t *cqe;
+	ioring_req_t *req;
+	uint32_t tail;
+	uint_t n = 0;
+
+	tail = state->ir_cq_tail;
+
+	for (;;) {
+		if (tail - hdr->ir_cq_head >= state->ir_cq_entries) {
+			mutex_enter(&state->ir_lock);
+			if (!list_is_empty(&state->ir_done))
+				hdr->ir_cq_overflow++;
+			mutex_exit(&state->ir_lock);
+			break;
+		}
+
+		mutex_enter(&state->ir_lock);
+		if ((req = list_remove_head(&state->ir_done)) == NULL) {
+			mutex_exit(&state->ir_lock);
+			break;
+		}
+		state->ir_inflight--;
+		mutex_exit(&state->ir_lock);
+
+		cqe = &state->ir_cqes[tail & (state->ir_cq_entries - 1)];
+		cqe->cqe_user_data = req->irq_sqe.sqe_user_data;
+		cqe->cqe_res = ioring_finish(req);
+		cqe->cqe_flags = 0;
+		ioring_req_free(req);
+
+		state->ir_cq_tail = ++tail;
+		membar_producer();
+		hdr->ir_cq_tail = tail;
+		n++;
+	}
+
+	return (n);
+}
+
+static int
+ioring_setup(ioring_state_t *state, ioring_params_t *p)
+{
+	uint32_t sq_entries, cq_entries, nthreads;
+	size_t sq_off, cq_off, size;
+	ioring_hdr_t *hdr;
+
+	if (state->ir_hdr != NULL)
+		return (EBUSY);
+
+	if (p->irp_flags != 0 || p->irp_sq_entries == 0 ||
+	    p->irp_sq_entries > IORING_MAX_ENTRIES ||
+	    p->irp_cq_entries > 2 * IORING_MAX_ENTRIES)
+		return (EINVAL);
+
+	sq_entries = 1U << highbit(p->irp_sq_entries - 1);
+	cq_entries = p->irp_cq_entries != 0 ?
+	    1U << highbit(p->irp_cq_entries - 1) : 2 * sq_entries;
+	if (cq_entries < sq_entries)
+		return (EINVAL);
+
+	nthreads = p->irp_nthreads != 0 ? p->irp_nthreads : ioring_nthreads;
+	nthreads = MIN(nthreads, ioring_max_nthreads);
+
+	sq_off = P2ROUNDUP(sizeof (ioring_hdr_t), 64);
+	cq_off = sq_off + sq_entries * sizeof (ioring_sqe_t);
+	size = ptob(btopr(cq_off + cq_entries * sizeof (ioring_cqe_t)));
+
+	hdr = ddi_umem_alloc(size, DDI_UMEM_SLEEP, &state->ir_cookie);
+	hdr->ir_sq_mask = sq_entries - 1;
+	hdr->ir_sq_entries = sq_entries;
+	hdr->ir_cq_mask = cq_entries - 1;
+	hdr->ir_cq_entries = cq_entries;
+	hdr->ir_sq_off = (uint32_t)sq_off;
+	hdr->ir_cq_off = (uint32_t)cq_off;
+
+	state->ir_size = size;
+	state->ir_sq_entries = sq_entries;
+	state->ir_cq_entries = cq_entries;
+	state->ir_sqes = (ioring_sqe_t *)((caddr_t)hdr + sq_off);
+	state->ir_cqes = (ioring_cqe_t *)((caddr_t)hdr + cq_off);
+	state->ir_taskq = taskq_create("ioring_taskq", nthreads, minclsyspri,
+	    nthreads, INT_MAX, TASKQ_PREPOPULATE);
+	state->ir_proc = curproc;
+
+	membar_producer();
+	state->ir_hdr = hdr;
+
+	p->irp_sq_entries = sq_entries;
+	p->irp_cq_entries = cq_entries;
+	p->irp_nthreads = nthreads;
+	p->irp_size = size;
+
+	return (0);
+}
+
+static int
+ioring_enter(ioring_state_t *state, ioring_enter_t *e)
+{
+	uint_t reaped, n;
+	int error = 0;
+
+	if (e->ire_flags != 0)
+		return (EINVAL);
+
+	e->ire_submitted = ioring_submit(state, e->ire_to_submit);
+	reaped = ioring_reap(state);
+
+	while (reaped < e->ire_min_complete) {
+		mutex_enter(&state->ir_lock);
+		while (list_is_empty(&state->ir_done) &&
+		    state->ir_inflight != 0) {
+			if (!cv_wait_sig_swap(&state->ir_cv, &state->ir_lock)) {
+				error = EINTR;
+				break;
+			}
+		}
+		if (error != 0 || list_is_empty(&state->ir_done)) {
+			mutex_exit(&state->ir_lock);
+			break;
+		}
+		mutex_exit(&state->ir_lock);
+
+		if ((n = ioring_reap(state)) == 0) {
+			/*
+			 * The completion queue is full; the application has
+			 * to make room before anything more can be posted.
+			 */
+			break;
+		}
+		reaped += n;
+	}
+
+	/*
+	 * Having submitted something, an interrupted wait isn't an error.
+	 */
+	if (error == EINTR && e->ire_submitted != 0)
+		error = 0;
+
+	return (error);
+}
+
+/*ARGSUSED*/
+static int
+ioring_open(dev_t *devp, int flag, int otyp, cred_t *cred_p)
+{
+	ioring_state_t *state;
+	major_t major = getemajor(*devp);
+	minor_t minor = getminor(*devp);
+
+	if (minor != IORINGMNRN_IORING)
+		return (ENXIO);
+
+	mutex_enter(&ioring_lock);
+
+	minor = (minor_t)(uintptr_t)vmem_alloc(ioring_minor, 1,
+	    VM_BESTFIT | VM_SLEEP);
+
+	if (ddi_soft_state_zalloc(ioring_softstate, minor) != DDI_SUCCESS) {
+		vmem_free(ioring_minor, (void *)(uintptr_t)minor, 1);
+		mutex_exit(&ioring_lock);
+		return (ENOMEM);
+	}
+
+	state = ddi_get_soft_state(ioring_softstate, minor);
+	*devp = makedevice(major, minor);
+
+	mutex_init(&state->ir_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&state->ir_enter_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&state->ir_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&state->ir_done, sizeof (ioring_req_t),
+	    offsetof(ioring_req_t, irq_node));
+	list_create(&state->ir_parked, sizeof (ioring_req_t),
+	    offsetof(ioring_req_t, irq_node));
+
+	state->ir_next = ioring_state;
+	ioring_state = state;
+
+	mutex_exit(&ioring_lock);
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+ioring_poll(dev_t dev, short events, int anyyet, short *reventsp,
+    struct pollhead **phpp)
+{
+	ioring_state_t *state;
+	minor_t minor = getminor(dev);
+	ioring_hdr_t *hdr;
+	short revents = 0;
+
+	state = ddi_get_soft_state(ioring_softstate, minor);
+
+	mutex_enter(&state->ir_lock);
+
+	if (!list_is_empty(&state->ir_done))
+		revents |= POLLRDNORM | POLLIN;
+
+	if ((hdr = state->ir_hdr) != NULL) {
+		if (hdr->ir_cq_tail != hdr->ir_cq_head)
+			revents |= POLLRDNORM | POLLIN;
+		if (state->ir_inflight < state->ir_cq_entries)
+			revents |= POLLWRNORM | POLLOUT;
+	}
+
+	if (!(*reventsp = revents & events) && !anyyet)
+		*phpp = &state->ir_pollhd;
+
+	mutex_exit(&state->ir_lock);
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+ioring_ioctl(dev_t dev, int cmd, intptr_t arg, int md, cred_t *cr, int *rv)
+{
+	ioring_state_t *state;
+	minor_t minor = getminor(dev);
+	ioring_params_t params;
+	ioring_enter_t enter;
+	int error;
+
+	state = ddi_get_soft_state(ioring_softstate, minor);
+
+	switch (cmd) {
+	case IORINGIOC_SETUP:
+		if (ddi_copyin((void *)arg, &params, sizeof (params), md) != 0)
+			return (EFAULT);
+
+		mutex_enter(&state->ir_enter_lock);
+		error = ioring_setup(state, &params);
+		mutex_exit(&state->ir_enter_lock);
+
+		if (error == 0 &&
+		    ddi_copyout(&params, (void *)arg, sizeof (params), md) != 0)
+			error = EFAULT;
+
+		return (error);
+
+	case IORINGIOC_ENTER:
+		if (ddi_copyin((void *)arg, &enter, sizeof (enter), md) != 0)
+			return (EFAULT);
+
+		mutex_enter(&state->ir_enter_lock);
+		if (state->ir_hdr == NULL) {
+			error = ENXIO;
+		} else if (state->ir_proc != curproc) {
+			/*
+			 * Descriptors in the requests, and the buffers, are
+			 * those of the process that set the ring up.
+			 */
+			error = EPERM;
+		} else {
+			error = ioring_enter(state, &enter);
+		}
+		mutex_exit(&state->ir_enter_lock);
+
+		if (error == 0 &&
+		    ddi_copyout(&enter, (void *)arg, sizeof (enter), md) != 0)
+			error = EFAULT;
+
+		return (error);
+
+	default:
+		break;
+	}
+
+	return (ENOTTY);
+}
+
+/*ARGSUSED*/
+static int
+ioring_devmap(dev_t dev, devmap_cookie_t dhp, offset_t off, size_t len,
+    size_t *maplen, uint_t model)
+{
+	ioring_state_t *state;
+	minor_t minor = getminor(dev);
+	int error;
+
+	state = ddi_get_soft_state(ioring_softstate, minor);
+
+	if (state->ir_hdr == NULL || off < 0 ||
+	    (size_t)off >= state->ir_size || len > state->ir_size - off)
+		return (-1);
+
+	error = devmap_umem_setup(dhp, ioring_devi, NULL, state->ir_cookie,
+	    off, len, PROT_READ | PROT_WRITE | PROT_USER, 0, NULL);
+	if (error != 0)
+		return (error);
+
+	*maplen = len;
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+ioring_close(dev_t dev, int flag, int otyp, cred_t *cred_p)
+{
+	ioring_state_t *state, **sp;
+	minor_t minor = getminor(dev);
+	ioring_req_t *req;
+	timeout_id_t tid;
+
+	state = ddi_get_soft_state(ioring_softstate, minor);
+
+	if (state->ir_pollhd.ph_list != NULL) {
+		pollwakeup(&state->ir_pollhd, POLLERR);
+		pollhead_clean(&state->ir_pollhd);
+	}
+
+	/*
+	 * Cancel parked requests, then let those in the workers finish.
+	 * Nothing will be parked once ir_closing is set.
+	 */
+	mutex_enter(&state->ir_lock);
+	state->ir_closing = B_TRUE;
+	while ((req = list_remove_head(&state->ir_parked)) != NULL) {
+		tid = req->irq_tid;
+		req->irq_tid = 0;
+		mutex_exit(&state->ir_lock);
+		(void) untimeout(tid);
+		ioring_req_free(req);
+		mutex_enter(&state->ir_lock);
+	}
+	mutex_exit(&state->ir_lock);
+
+	if (state->ir_taskq != NULL)
+		taskq_destroy(state->ir_taskq);
+
+	while ((req = list_remove_head(&state->ir_done)) != NULL)
+		ioring_req_free(req);
+
+	if (state->ir_hdr != NULL)
+		ddi_umem_free(state->ir_cookie);
+
+	list_destroy(&state->ir_done);
+	list_destroy(&state->ir_parked);
+	cv_destroy(&state->ir_cv);
+	mutex_destroy(&state->ir_enter_lock);
+	mutex_destroy(&state->ir_lock);
+
+	mutex_enter(&ioring_lock);
+
+	/*
+	 * Remove our state from our global list.
+	 */
+	for (sp = &ioring_state; *sp != state; sp = &((*sp)->ir_next))
+		VERIFY(*sp != NULL);
+
+	*sp = (*sp)->ir_next;
+
+	ddi_soft_state_free(ioring_softstate, minor);
+	vmem_free(ioring_minor, (void *)(uintptr_t)minor, 1);
+
+	mutex_exit(&ioring_lock);
+
+	return (0);
+}
+
+static int
+ioring_attach(dev_info_t *devi, ddi_attach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_ATTACH:
+		break;
+
+	case DDI_RESUME:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+
+	mutex_enter(&ioring_lock);
+
+	if (ddi_soft_state_init(&ioring_softstate,
+	    sizeof (ioring_state_t), 0) != 0) {
+		cmn_err(CE_NOTE, "/dev/ioring failed to create soft state");
+		mutex_exit(&ioring_lock);
+		return (DDI_FAILURE);
+	}
+
+	if (ddi_create_minor_node(devi, "ioring", S_IFCHR,
+	    IORINGMNRN_IORING, DDI_PSEUDO, NULL) == DDI_FAILURE) {
+		cmn_err(CE_NOTE, "/dev/ioring couldn't create minor node");
+		ddi_soft_state_fini(&ioring_softstate);
+		mutex_exit(&ioring_lock);
+		return (DDI_FAILURE);
+	}
+
+	ddi_report_dev(devi);
+	ioring_devi = devi;
+
+	ioring_minor = vmem_create("ioring_minor", (void *)IORINGMNRN_CLONE,
+	    UINT32_MAX - IORINGMNRN_CLONE, 1, NULL, NULL, NULL, 0,
+	    VM_SLEEP | VMC_IDENTIFIER);
+
+	ioring_req_cache = kmem_cache_create("ioring_req_cache",
+	    sizeof (ioring_req_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
+	mutex_exit(&ioring_lock);
+
+	return (DDI_SUCCESS);
+}
+
+/*ARGSUSED*/
+static int
+ioring_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_DETACH:
+		break;
+
+	case DDI_SUSPEND:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+
+	mutex_enter(&ioring_lock);
+	kmem_cache_destroy(ioring_req_cache);
+	vmem_destroy(ioring_minor);
+
+	ddi_remove_minor_node(ioring_devi, NULL);
+	ioring_devi = NULL;
+
+	ddi_soft_state_fini(&ioring_softstate);
+	mutex_exit(&ioring_lock);
+
+	return (DDI_SUCCESS);
+}
+
+/*ARGSUSED*/
+static int
+ioring_info(dev_info_t *dip, ddi_info_cmd_t infocmd, void *arg, void **result)
+{
+	int error;
+
+	switch (infocmd) {
+	case DDI_INFO_DEVT2DEVINFO:
+		*result = (void *)ioring_devi;
+		error = DDI_SUCCESS;
+		break;
+	case DDI_INFO_DEVT2INSTANCE:
+		*result = (void *)0;
+		error = DDI_SUCCESS;
+		break;
+	default:
+		error = DDI_FAILURE;
+	}
+	return (error);
+}
+
+static struct cb_ops ioring_cb_ops = {
+	ioring_open,		/* open */
+	ioring_close,		/* close */
+	nulldev,		/* strategy */
+	nulldev,		/* print */
+	nodev,			/* dump */
+	nodev,			/* read */
+	nodev,			/* write */
+	ioring_ioctl,		/* ioctl */
+	ioring_devmap,		/* devmap */
+	nodev,			/* mmap */
+	ddi_devmap_segmap,	/* segmap */
+	ioring_poll,		/* poll */
+	ddi_prop_op,		/* cb_prop_op */
+	0,			/* streamtab  */
+	D_DEVMAP | D_NEW | D_MP	/* Driver compatibility flag */
+};
+
+static struct dev_ops ioring_ops = {
+	DEVO_REV,		/* devo_rev */
+	0,			/* refcnt */
+	ioring_info,		/* get_dev_info */
+	nulldev,		/* identify */
+	nulldev,		/* probe */
+	ioring_attach,		/* attach */
+	ioring_detach,		/* detach */
+	nodev,			/* reset */
+	&ioring_cb_ops,		/* driver operations */
+	NULL,			/* bus operations */
+	nodev,			/* dev power */
+	ddi_quiesce_not_needed,	/* quiesce */
+};
+
+static struct modldrv modldrv = {
+	&mod_driverops,		/* module type (this is a pseudo driver) */
+	"ioring support",	/* name of module */
+	&ioring_ops,		/* driver ops */
+};
+
+static struct modlinkage modlinkage = {
+	MODREV_1,
+	(void *)&modldrv,
+	NULL
+};
+
+int
+_init(void)
+{
+	return (mod_install(&modlinkage));
+}
+
+int
+_info(struct modinfo *modinfop)
+{
+	return (mod_info(&modlinkage, modinfop));
+}
+
+int
+_fini(void)
+{
+	return (mod_remove(&modlinkage));
+}
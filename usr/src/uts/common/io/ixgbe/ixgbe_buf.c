@@ -212,14 +212,12 @@ ixgbe_alloc_rx_ring_data(ixgbe_rx_ring_t *rx_ring)
 	}
 
 	rx_data->rx_ring = rx_ring;
-	mutex_init(&rx_data->recycle_lock, NULL,
-	    MUTEX_DRIVER, DDI_INTR_PRI(ixgbe->intr_pri));
 
 	rx_data->ring_size = ixgbe->rx_ring_size;
-	rx_data->free_list_size = ixgbe->rx_ring_size;
+	rx_data->free_list_size = ixgbe->rx_free_list_size;
 
-	rx_data->rcb_head = 0;
-	rx_data->rcb_tail = 0;
+	rx_data->free_list = NULL;
+	rx_data->recycle_list = NULL;
 	rx_data->rcb_free = rx_data->free_list_size;
 
 	/*
@@ -234,18 +232,6 @@ ixgbe_alloc_rx_ring_data(ixgbe_rx_ring_t *rx_ring)
 		goto alloc_rx_data_failure;
 	}
 
-	/*
-	 * Allocate memory for the free list.
-	 */
-	rx_data->free_list = kmem_zalloc(sizeof (rx_control_block_t *) *
-	    rx_data->free_list_size, KM_NOSLEEP);
-
-	if (rx_data->free_list == NULL) {
-		ixgbe_error(ixgbe,
-		    "Cound not allocate memory for rx free list");
-		goto alloc_rx_data_failure;
-	}
-
 	/*
 	 * Allocate memory for the rx control blocks for work list and
 	 * free list.
@@ -292,13 +278,6 @@ ixgbe_free_rx_ring_data(ixgbe_rx_data_t *rx_data)
 		rx_data->work_list = NULL;
 	}
 
-	if (rx_data->free_list != NULL) {
-		kmem_free(rx_data->free_list,
-		    sizeof (rx_control_block_t *) * rx_data->free_list_size);
-		rx_data->free_list = NULL;
-	}
-
-	mutex_destroy(&rx_data->recycle_lock);
 	kmem_free(rx_data, sizeof (ixgbe_rx_data_t));
 }
 
@@ -844,7 +823,8 @@ ixgbe_alloc_rcb_lists(ixgbe_rx_data_t *rx_data)
 			rx_data->work_list[i] = rcb;
 		} else {
 			/* Attach the rx control block to the free list */
-			rx_data->free_list[i - rx_data->ring_size] = rcb;
+			rcb->free_next = rx_data->free_list;
+			rx_data->free_list = rcb;
 		}
 
 		rx_buf = &rcb->rx_buf;
@@ -3304,6 +3304,7 @@ ixgbe_get_conf(ixgbe_t *ixgbe)
 	 *    tx_ring_size
 	 *    rx_queue_number
 	 *    rx_ring_size
+	 *    rx_free_list_size
 	 *
 	 * Call ixgbe_get_prop() to get the value for a specific
 	 * configuration parameter.
@@ -3350,6 +3351,9 @@ ixgbe_get_conf(ixgbe_t *ixgbe)
 	    ixgbe->capab->def_rx_que_num);
 	ixgbe->rx_ring_size = ixgbe_get_prop(ixgbe, PROP_RX_RING_SIZE,
 	    MIN_RX_RING_SIZE, MAX_RX_RING_SIZE, DEFAULT_RX_RING_SIZE);
+	ixgbe->rx_free_list_size = ixgbe_get_prop(ixgbe, PROP_RX_FREE_LIST_SIZE,
+	    MIN_RX_FREE_LIST_SIZE, MAX_RX_FREE_LIST_SIZE,
+	    ixgbe->rx_ring_size * DEFAULT_RX_FREE_LIST_MULT);
 
 	/*
 	 * Multiple groups configuration
@@ -44,6 +44,55 @@ static uint32_t ixgbe_lro_get_first(ixgbe_rx_data_t *, uint32_t);
 #pragma inline(ixgbe_lro_get_first)
 #endif
 
+/*
+ * The rx free list is split in two. Recycled rx control blocks are pushed
+ * onto recycle_list, a lock-free stack, from whatever context freeb() runs
+ * in. The receive path, which is the only consumer and always holds rx_lock,
+ * pops from its private free_list and, when that runs dry, takes over the
+ * whole recycle_list with a single atomic swap. Since nothing ever pops a
+ * single entry off recycle_list there is no ABA hazard.
+ *
+ * rcb_free counts the rcbs on both lists. A producer only bumps it after its
+ * push is visible, so a successful ixgbe_atomic_reserve() guarantees that
+ * enough rcbs can be found on the two lists.
+ */
+static void
+ixgbe_rcb_put(ixgbe_rx_data_t *rx_data, rx_control_block_t *rcb)
+{
+	rx_control_block_t *head, *old;
+
+	head = rx_data->recycle_list;
+	for (;;) {
+		rcb->free_next = head;
+		membar_producer();
+		old = atomic_cas_ptr(&rx_data->recycle_list, head, rcb);
+		if (old == head)
+			break;
+		head = old;
+	}
+}
+
+static rx_control_block_t *
+ixgbe_rcb_get(ixgbe_rx_data_t *rx_data)
+{
+	rx_control_block_t *rcb;
+
+	ASSERT(mutex_owned(&rx_data->rx_ring->rx_lock));
+
+	if (rx_data->free_list == NULL) {
+		rx_data->free_list = atomic_swap_ptr(&rx_data->recycle_list,
+		    NULL);
+		membar_consumer();
+	}
+
+	rcb = rx_data->free_list;
+	ASSERT(rcb != NULL);
+	rx_data->free_list = rcb->free_next;
+	rcb->free_next = NULL;
+
+	return (rcb);
+}
+
 /*
  * ixgbe_rx_recycle - The call-back function to reclaim rx buffer.
  *
@@ -58,7 +107,6 @@ ixgbe_rx_recycle(caddr_t arg)
 	ixgbe_rx_ring_t *rx_ring;
 	ixgbe_rx_data_t	*rx_data;
 	rx_control_block_t *recycle_rcb;
-	uint32_t free_index;
 	uint32_t ref_cnt;
 
 	recycle_rcb = (rx_control_block_t *)(uintptr_t)arg;
@@ -87,15 +135,7 @@ ixgbe_rx_recycle(caddr_t arg)
 	/*
 	 * Put the recycled rx control block into free list
 	 */
-	mutex_enter(&rx_data->recycle_lock);
-
-	free_index = rx_data->rcb_tail;
-	ASSERT(rx_data->free_list[free_index] == NULL);
-
-	rx_data->free_list[free_index] = recycle_rcb;
-	rx_data->rcb_tail = NEXT_INDEX(free_index, 1, rx_data->free_list_size);
-
-	mutex_exit(&rx_data->recycle_lock);
+	ixgbe_rcb_put(rx_data, recycle_rcb);
 
 	/*
 	 * The atomic operation on the number of the available rx control
@@ -176,6 +216,7 @@ ixgbe_rx_copy(ixgbe_rx_data_t *rx_data, uint32_t index, uint32_t pkt_len)
 	bcopy(current_rcb->rx_buf.address, mp->b_rptr, pkt_len);
 	mp->b_wptr = mp->b_rptr + pkt_len;
 
+	rx_data->rx_ring->stat_rx_copy++;
 	return (mp);
 }
 
@@ -190,7 +231,6 @@ ixgbe_rx_bind(ixgbe_rx_data_t *rx_data, uint32_t index, uint32_t pkt_len)
 {
 	rx_control_block_t *current_rcb;
 	rx_control_block_t *free_rcb;
-	uint32_t free_index;
 	mblk_t *mp;
 	ixgbe_t	*ixgbe = rx_data->rx_ring->ixgbe;
 
@@ -199,8 +239,10 @@ ixgbe_rx_bind(ixgbe_rx_data_t *rx_data, uint32_t index, uint32_t pkt_len)
 	 * the current DMA buffer upstream. We'll have to return
 	 * and use bcopy to process the packet.
 	 */
-	if (ixgbe_atomic_reserve(&rx_data->rcb_free, 1) < 0)
+	if (ixgbe_atomic_reserve(&rx_data->rcb_free, 1) < 0) {
+		rx_data->rx_ring->stat_rx_bind_norcb++;
 		return (NULL);
+	}
 
 	current_rcb = rx_data->work_list[index];
 	/*
@@ -245,17 +287,14 @@ ixgbe_rx_bind(ixgbe_rx_data_t *rx_data, uint32_t index, uint32_t pkt_len)
 	/*
 	 * Strip off one free rx control block from the free list
 	 */
-	free_index = rx_data->rcb_head;
-	free_rcb = rx_data->free_list[free_index];
-	ASSERT(free_rcb != NULL);
-	rx_data->free_list[free_index] = NULL;
-	rx_data->rcb_head = NEXT_INDEX(free_index, 1, rx_data->free_list_size);
+	free_rcb = ixgbe_rcb_get(rx_data);
 
 	/*
 	 * Put the rx control block to the work list
 	 */
 	rx_data->work_list[index] = free_rcb;
 
+	rx_data->rx_ring->stat_rx_bind++;
 	return (mp);
 }
 
@@ -272,7 +311,6 @@ ixgbe_lro_bind(ixgbe_rx_data_t *rx_data, uint32_t lro_start,
 	rx_control_block_t *current_rcb;
 	union ixgbe_adv_rx_desc *current_rbd;
 	rx_control_block_t *free_rcb;
-	uint32_t free_index;
 	int lro_next;
 	uint32_t last_pkt_len;
 	uint32_t i;
@@ -286,8 +324,10 @@ ixgbe_lro_bind(ixgbe_rx_data_t *rx_data, uint32_t lro_start,
 	 * the current DMA buffer upstream. We'll have to return
 	 * and use bcopy to process the packet.
 	 */
-	if (ixgbe_atomic_reserve(&rx_data->rcb_free, lro_num) < 0)
+	if (ixgbe_atomic_reserve(&rx_data->rcb_free, lro_num) < 0) {
+		rx_data->rx_ring->stat_rx_bind_norcb++;
 		return (NULL);
+	}
 	current_rcb = rx_data->work_list[lro_start];
 
 	/*
@@ -354,12 +394,7 @@ ixgbe_lro_bind(ixgbe_rx_data_t *rx_data, uint32_t lro_start,
 		/*
 		 * Strip off one free rx control block from the free list
 		 */
-		free_index = rx_data->rcb_head;
-		free_rcb = rx_data->free_list[free_index];
-		ASSERT(free_rcb != NULL);
-		rx_data->free_list[free_index] = NULL;
-		rx_data->rcb_head = NEXT_INDEX(free_index, 1,
-		    rx_data->free_list_size);
+		free_rcb = ixgbe_rcb_get(rx_data);
 
 		/*
 		 * Put the rx control block to the work list
@@ -376,6 +411,7 @@ ixgbe_lro_bind(ixgbe_rx_data_t *rx_data, uint32_t lro_start,
 		current_rcb = rx_data->work_list[lro_next];
 		current_rbd = &rx_data->rbd_ring[lro_next];
 	}
+	rx_data->rx_ring->stat_rx_bind++;
 	return (mblk_head);
 }
 
@@ -458,6 +494,7 @@ ixgbe_lro_copy(ixgbe_rx_data_t *rx_data, uint32_t lro_start,
 		current_rbd = &rx_data->rbd_ring[lro_next];
 	}
 
+	rx_data->rx_ring->stat_rx_copy++;
 	return (mp);
 }
 
@@ -58,6 +58,18 @@ ixgbe_update_stats(kstat_t *ks, int rw)
 	ixgbe_ks->reset_count.value.ui64 = ixgbe->reset_count;
 	ixgbe_ks->lroc.value.ui64 = ixgbe->lro_pkt_count;
 
+	ixgbe_ks->rx_bind.value.ui64 = 0;
+	ixgbe_ks->rx_copy.value.ui64 = 0;
+	ixgbe_ks->rx_bind_norcb.value.ui64 = 0;
+	for (i = 0; i < ixgbe->num_rx_rings; i++) {
+		ixgbe_ks->rx_bind.value.ui64 +=
+		    ixgbe->rx_rings[i].stat_rx_bind;
+		ixgbe_ks->rx_copy.value.ui64 +=
+		    ixgbe->rx_rings[i].stat_rx_copy;
+		ixgbe_ks->rx_bind_norcb.value.ui64 +=
+		    ixgbe->rx_rings[i].stat_rx_bind_norcb;
+	}
+
 #ifdef IXGBE_DEBUG
 	ixgbe_ks->rx_frame_error.value.ui64 = 0;
 	ixgbe_ks->rx_cksum_error.value.ui64 = 0;
@@ -459,6 +471,12 @@ ixgbe_init_stats(ixgbe_t *ixgbe)
 	    KSTAT_DATA_UINT64);
 	kstat_named_init(&ixgbe_ks->lroc, "lro_pkt_count",
 	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ixgbe_ks->rx_bind, "rx_bind",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ixgbe_ks->rx_copy, "rx_copy",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ixgbe_ks->rx_bind_norcb, "rx_bind_norcb",
+	    KSTAT_DATA_UINT64);
 	/*
 	 * Function to provide kernel stat update on demand
 	 */
@@ -121,6 +121,7 @@ extern "C" {
  */
 #define	MAX_TX_RING_SIZE		4096
 #define	MAX_RX_RING_SIZE		4096
+#define	MAX_RX_FREE_LIST_SIZE		16384
 
 #define	MAX_RX_LIMIT_PER_INTR		4096
 
@@ -135,6 +136,7 @@ extern "C" {
  */
 #define	MIN_TX_RING_SIZE		64
 #define	MIN_RX_RING_SIZE		64
+#define	MIN_RX_FREE_LIST_SIZE		64
 
 #define	MIN_MTU				ETHERMIN
 #define	MIN_RX_LIMIT_PER_INTR		16
@@ -149,6 +151,7 @@ extern "C" {
  */
 #define	DEFAULT_TX_RING_SIZE		1024
 #define	DEFAULT_RX_RING_SIZE		1024
+#define	DEFAULT_RX_FREE_LIST_MULT	2	/* x rx_ring_size */
 
 #define	DEFAULT_MTU			ETHERMTU
 #define	DEFAULT_RX_LIMIT_PER_INTR	256
@@ -218,6 +221,7 @@ extern "C" {
 #define	PROP_TX_RING_SIZE		"tx_ring_size"
 #define	PROP_RX_QUEUE_NUM		"rx_queue_number"
 #define	PROP_RX_RING_SIZE		"rx_ring_size"
+#define	PROP_RX_FREE_LIST_SIZE		"rx_free_list_size"
 #define	PROP_RX_GROUP_NUM		"rx_group_number"
 
 #define	PROP_INTR_FORCE			"intr_force"
@@ -441,6 +445,7 @@ typedef struct tx_control_block {
  * RX Control Block
  */
 typedef struct rx_control_block {
+	struct rx_control_block	*free_next;	/* Next rcb on free list */
 	mblk_t			*mp;
 	uint32_t		ref_cnt;
 	dma_buffer_t		rx_buf;
@@ -532,8 +537,6 @@ typedef struct ixgbe_tx_ring {
  * Software Receive Ring
  */
 typedef struct ixgbe_rx_data {
-	kmutex_t		recycle_lock;	/* Recycle lock, for rcb_tail */
-
 	/*
 	 * Rx descriptor ring definitions
 	 */
@@ -546,9 +549,8 @@ typedef struct ixgbe_rx_data {
 	 */
 	rx_control_block_t	*rcb_area;
 	rx_control_block_t	**work_list;	/* Work list of rcbs */
-	rx_control_block_t	**free_list;	/* Free list of rcbs */
-	uint32_t		rcb_head;	/* Index of next free rcb */
-	uint32_t		rcb_tail;	/* Index to put recycled rcb */
+	rx_control_block_t	*free_list;	/* Free rcbs, under rx_lock */
+	rx_control_block_t	*recycle_list;	/* Recycled rcbs, lock-free */
 	uint32_t		rcb_free;	/* Number of free rcbs */
 
 	/*
@@ -590,6 +592,9 @@ typedef struct ixgbe_rx_ring {
 #endif
 	uint64_t		stat_rbytes;
 	uint64_t		stat_ipackets;
+	uint64_t		stat_rx_bind;	/* Packets loaned upstream */
+	uint64_t		stat_rx_copy;	/* Packets copied */
+	uint64_t		stat_rx_bind_norcb; /* No free rcb to loan */
 
 	mac_ring_handle_t	ring_handle;
 	uint64_t		ring_gen_num;
@@ -661,6 +666,7 @@ typedef struct ixgbe {
 	ixgbe_rx_ring_t		*rx_rings;	/* Array of rx rings */
 	uint32_t		num_rx_rings;	/* Number of rx rings in use */
 	uint32_t		rx_ring_size;	/* Rx descriptor ring size */
+	uint32_t		rx_free_list_size; /* Rx free list size */
 	uint32_t		rx_buf_size;	/* Rx buffer size */
 	boolean_t		lro_enable;	/* Large Receive Offload */
 	uint64_t		lro_pkt_count;	/* LRO packet count */
@@ -824,6 +830,10 @@ typedef struct ixgbe_stat {
 	kstat_named_t mptc;	/* Multicast Packets Xmited Count */
 	kstat_named_t bptc;	/* Broadcast Packets Xmited Count */
 	kstat_named_t lroc;	/* LRO Packets Received Count */
+
+	kstat_named_t rx_bind;		/* Rx Packets Loaned Upstream */
+	kstat_named_t rx_copy;		/* Rx Packets Copied */
+	kstat_named_t rx_bind_norcb;	/* Rx Loan Fail Freelist Empty */
 } ixgbe_stat_t;
 
 /*
@@ -1209,6 +1209,7 @@ ixgbe_tx_recycle_legacy(ixgbe_tx_ring_t *tx_ring)
 	boolean_t desc_done;
 	tx_control_block_t *tcb;
 	link_list_t pending_list;
+	mblk_t *mp_chain = NULL;
 	ixgbe_t *ixgbe = tx_ring->ixgbe;
 
 	mutex_enter(&tx_ring->recycle_lock);
@@ -1341,8 +1342,14 @@ ixgbe_tx_recycle_legacy(ixgbe_tx_ring_t *tx_ring)
 	tcb = (tx_control_block_t *)LIST_GET_HEAD(&pending_list);
 	while (tcb != NULL) {
 		/*
-		 * Release the resources occupied by the tx control block
+		 * Gather the mblk to be freed with the rest, then release
+		 * the other resources occupied by the tx control block
 		 */
+		if (tcb->mp != NULL) {
+			tcb->mp->b_next = mp_chain;
+			mp_chain = tcb->mp;
+			tcb->mp = NULL;
+		}
 		ixgbe_free_tcb(tcb);
 
 		tcb = (tx_control_block_t *)
@@ -1354,6 +1361,11 @@ ixgbe_tx_recycle_legacy(ixgbe_tx_ring_t *tx_ring)
 	 */
 	ixgbe_put_free_list(tx_ring, &pending_list);
 
+	/*
+	 * Free the transmitted mblks in one batch
+	 */
+	freemsgchain_bulk(mp_chain);
+
 	return (desc_num);
 }
 
@@ -1371,6 +1383,7 @@ ixgbe_tx_recycle_head_wb(ixgbe_tx_ring_t *tx_ring)
 	int desc_num;
 	tx_control_block_t *tcb;
 	link_list_t pending_list;
+	mblk_t *mp_chain = NULL;
 	ixgbe_t *ixgbe = tx_ring->ixgbe;
 
 	mutex_enter(&tx_ring->recycle_lock);
@@ -1488,8 +1501,14 @@ ixgbe_tx_recycle_head_wb(ixgbe_tx_ring_t *tx_ring)
 	tcb = (tx_control_block_t *)LIST_GET_HEAD(&pending_list);
 	while (tcb) {
 		/*
-		 * Release the resources occupied by the tx control block
+		 * Gather the mblk to be freed with the rest, then release
+		 * the other resources occupied by the tx control block
 		 */
+		if (tcb->mp != NULL) {
+			tcb->mp->b_next = mp_chain;
+			mp_chain = tcb->mp;
+			tcb->mp = NULL;
+		}
 		ixgbe_free_tcb(tcb);
 
 		tcb = (tx_control_block_t *)
@@ -1501,6 +1520,11 @@ ixgbe_tx_recycle_head_wb(ixgbe_tx_ring_t *tx_ring)
 	 */
 	ixgbe_put_free_list(tx_ring, &pending_list);
 
+	/*
+	 * Free the transmitted mblks in one batch
+	 */
+	freemsgchain_bulk(mp_chain);
+
 	return (desc_num);
 }
 
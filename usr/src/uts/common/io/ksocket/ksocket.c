@@ -684,6 +684,35 @@ ksocket_setcallbacks(ksocket_t ks, ksocket_callbacks_t *cb, void *arg,
 	return (0);
 }
 
+/*
+ * Have the data arriving on a socket handed straight to func, in the
+ * protocol's receive context, rather than queued for ksocket_recv() and
+ * friends.  func gets the message as the protocol passed it up (for a
+ * datagram socket, a T_unitdata_ind with the data in b_cont), and must
+ * free it.  Passing a NULL
+ * func goes back to queueing; data already delivered is not affected.
+ * Only sockets that are not STREAMS-based can do this.
+ */
+int
+ksocket_krecv_set(ksocket_t ks, ksocket_krecv_f func, void *arg)
+{
+	struct sonode *so;
+
+	if (!KSOCKET_VALID(ks))
+		return (ENOTSOCK);
+
+	so = KSTOSO(ks);
+
+	if (so->so_ops != &so_sonodeops)
+		return (ENOTSUP);
+
+	mutex_enter(&so->so_lock);
+	so->so_krecv_cb = func;
+	so->so_krecv_arg = func != NULL ? arg : NULL;
+	mutex_exit(&so->so_lock);
+	return (0);
+}
+
 int
 ksocket_ioctl(ksocket_t ks, int cmd, intptr_t arg, int *rvalp, struct cred *cr)
 {
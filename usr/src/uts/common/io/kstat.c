@@ -399,6 +399,67 @@ out:
 	return (error);
 }
 
+static int
+read_kstat_datav(int *rvalp, void *user_krv, int flag)
+{
+	kstat_readv_t krv;
+#ifdef _MULTI_DATAMODEL
+	kstat_readv32_t krv32;
+	caddr32_t uksp32;
+#endif
+	void *uksp;
+	uint_t model, i;
+	int error;
+
+	switch (model = ddi_model_convert_from(flag & FMODELS)) {
+#ifdef _MULTI_DATAMODEL
+	case DDI_MODEL_ILP32:
+		if (copyin(user_krv, &krv32, sizeof (kstat_readv32_t)) != 0)
+			return (EFAULT);
+		krv.kr_ksps = (kstat_t **)(uintptr_t)krv32.kr_ksps;
+		krv.kr_errors = (int *)(uintptr_t)krv32.kr_errors;
+		krv.kr_nksps = krv32.kr_nksps;
+		break;
+#endif
+	default:
+	case DDI_MODEL_NONE:
+		if (copyin(user_krv, &krv, sizeof (kstat_readv_t)) != 0)
+			return (EFAULT);
+	}
+
+	/*
+	 * Each kstat is read exactly as KSTAT_IOC_READ would read it; all
+	 * that we save is the system call for each (which, for a monitoring
+	 * agent reading thousands of kstats per interval, is the bulk of its
+	 * cost).  A failure to read one kstat is reported in its element of
+	 * kr_errors, and doesn't prevent the others from being read.
+	 */
+	for (i = 0; i < krv.kr_nksps; i++) {
+		switch (model) {
+#ifdef _MULTI_DATAMODEL
+		case DDI_MODEL_ILP32:
+			if (copyin((caddr32_t *)krv.kr_ksps + i, &uksp32,
+			    sizeof (uksp32)) != 0)
+				return (EFAULT);
+			uksp = (void *)(uintptr_t)uksp32;
+			break;
+#endif
+		default:
+		case DDI_MODEL_NONE:
+			if (copyin(krv.kr_ksps + i, &uksp, sizeof (uksp)) != 0)
+				return (EFAULT);
+		}
+
+		error = read_kstat_data(rvalp, uksp, flag);
+
+		if (copyout(&error, krv.kr_errors + i, sizeof (error)) != 0)
+			return (EFAULT);
+	}
+
+	*rvalp = kstat_chain_id;
+	return (0);
+}
+
 static int
 write_kstat_data(int *rvalp, void *user_ksp, int flag, cred_t *cred)
 {
@@ -679,6 +740,10 @@ kstat_ioctl(dev_t dev, int cmd, intptr_t data, int flag, cred_t *cr, int *rvalp)
 		rc = write_kstat_data(rvalp, (void *)data, flag, cr);
 		break;
 
+	case KSTAT_IOC_READV:
+		rc = read_kstat_datav(rvalp, (void *)data, flag);
+		break;
+
 	default:
 		/* invalid request */
 		rc = EINVAL;
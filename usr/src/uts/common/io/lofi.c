@@ -149,6 +149,8 @@
 #include <sys/sysevent/dev.h>
 #include <LzmaDec.h>
 
+extern int lz4_decompress(void *, void *, size_t, size_t, int);
+
 #define	NBLOCKS_PROP_NAME	"Nblocks"
 #define	SIZE_PROP_NAME		"Size"
 #define	ZONE_PROP_NAME		"zone"
@@ -202,16 +204,30 @@ const char lofi_crypto_magic[6] = LOFI_CRYPTO_MAGIC;
  * when accessing small parts of a segment's data, we cache and reuse
  * the uncompressed segment's data.
  *
- * A single cached segment is sufficient to avoid lots of duplicate
- * segment decompress operations. A small cache size also reduces the
- * memory footprint.
+ * The cache also holds the segments read ahead (see below), so it has
+ * to be a good deal larger than the read-ahead window to be of use;
+ * with the default 128k segment size, 32 segments cost 4MB per image.
  *
  * lofi_max_comp_cache is the maximum number of decompressed data segments
  * cached for each compressed lofi image. It can be set to 0 to disable
  * caching.
  */
 
-uint32_t lofi_max_comp_cache = 1;
+uint32_t lofi_max_comp_cache = 32;
+
+/*
+ * The segments of a compressed image that a single request spans are
+ * decompressed in parallel by lofi_decomp_taskq, which is shared by all
+ * lofi devices and has lofi_decomp_nthreads threads (0 decompresses
+ * everything in the thread doing the I/O).  The same threads read ahead
+ * the lofi_comp_readahead segments that follow each read into the
+ * segment cache, so that sequential readers -- booting from an ISO or
+ * zone image -- find them already decompressed.  Setting
+ * lofi_comp_readahead to 0 disables read-ahead.
+ */
+int lofi_decomp_nthreads = 8;
+uint32_t lofi_comp_readahead = 4;
+static taskq_t *lofi_decomp_taskq;
 
 static int gzip_decompress(void *src, size_t srclen, void *dst,
 	size_t *destlen, int level);
@@ -219,13 +235,49 @@ static int gzip_decompress(void *src, size_t srclen, void *dst,
 static int lzma_decompress(void *src, size_t srclen, void *dst,
 	size_t *dstlen, int level);
 
+static int lofi_lz4_decompress(void *src, size_t srclen, void *dst,
+	size_t *dstlen, int level);
+
 lofi_compress_info_t lofi_compress_table[LOFI_COMPRESS_FUNCTIONS] = {
 	{gzip_decompress,	NULL,	6,	"gzip"}, /* default */
 	{gzip_decompress,	NULL,	6,	"gzip-6"},
 	{gzip_decompress,	NULL,	9,	"gzip-9"},
-	{lzma_decompress,	NULL,	0,	"lzma"}
+	{lzma_decompress,	NULL,	0,	"lzma"},
+	{lofi_lz4_decompress,	NULL,	0,	"lz4"}
 };
 
+/*
+ * A segment of a compressed image needed by a request, and where its
+ * uncompressed data comes from: a cache entry we hold (seg_lc), the
+ * uncompressed copy stored in the image, or seg_data we allocated and
+ * decompressed into.
+ */
+typedef struct lofi_seg {
+	struct lofi_state	*seg_lsp;
+	uint64_t		seg_index;
+	uchar_t			*seg_cmp;	/* SEGHDR + compressed data */
+	size_t			seg_cmplen;
+	uchar_t			*seg_data;	/* uncompressed data */
+	boolean_t		seg_alloc;	/* seg_data is ours to free */
+	struct lofi_comp_cache	*seg_lc;
+	int			seg_error;
+	struct lofi_seg_wait	*seg_wait;
+} lofi_seg_t;
+
+/*
+ * Completion of the segments a request handed to lofi_decomp_taskq.
+ */
+typedef struct lofi_seg_wait {
+	kmutex_t		sw_lock;
+	kcondvar_t		sw_cv;
+	uint_t			sw_pending;
+} lofi_seg_wait_t;
+
+typedef struct lofi_readahead {
+	struct lofi_state	*lr_lsp;
+	uint64_t		lr_index;
+} lofi_readahead_t;
+
 static void lofi_strategy_task(void *);
 static int lofi_tg_rdwr(dev_info_t *, uchar_t, void *, diskaddr_t,
     size_t, void *);
@@ -263,6 +315,8 @@ lofi_free_comp_cache(struct lofi_state *lsp)
 	struct lofi_comp_cache *lc;
 
 	while ((lc = list_remove_head(&lsp->ls_comp_cache)) != NULL) {
+		ASSERT0(lc->lc_refcnt);
+		avl_remove(&lsp->ls_comp_cache_tree, lc);
 		kmem_free(lc->lc_data, lsp->ls_uncomp_seg_sz);
 		kmem_free(lc, sizeof (struct lofi_comp_cache));
 		lsp->ls_comp_cache_count--;
@@ -501,6 +555,15 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 
 	list_remove(&lofi_list, lsp);
 
+	/*
+	 * Read-ahead of compressed segments may still be running after
+	 * the last close; it holds ls_vp_iocount like any other I/O.
+	 */
+	mutex_enter(&lsp->ls_vp_lock);
+	while (lsp->ls_vp_iocount > 0)
+		cv_wait(&lsp->ls_vp_cv, &lsp->ls_vp_lock);
+	mutex_exit(&lsp->ls_vp_lock);
+
 	lofi_free_crypto(lsp);
 
 	/*
@@ -536,6 +599,7 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 	 */
 	lofi_free_comp_cache(lsp);
 	list_destroy(&lsp->ls_comp_cache);
+	avl_destroy(&lsp->ls_comp_cache_tree);
 
 	if (lsp->ls_uncomp_seg_sz > 0) {
 		kmem_free(lsp->ls_comp_index_data, lsp->ls_comp_index_data_sz);
@@ -1100,6 +1164,19 @@ lofi_mapped_rdwr(caddr_t bufaddr, offset_t offset, struct buf *bp,
 	return (error);
 }
 
+static int
+lofi_comp_cache_compare(const void *a, const void *b)
+{
+	const struct lofi_comp_cache *la = a;
+	const struct lofi_comp_cache *lb = b;
+
+	if (la->lc_index < lb->lc_index)
+		return (-1);
+	if (la->lc_index > lb->lc_index)
+		return (1);
+	return (0);
+}
+
 /*
  * Check if segment seg_index is present in the decompressed segment
  * data cache.
@@ -1110,23 +1187,42 @@ lofi_mapped_rdwr(caddr_t bufaddr, offset_t offset, struct buf *bp,
  */
 static struct lofi_comp_cache *
 lofi_find_comp_data(struct lofi_state *lsp, uint64_t seg_index)
+{
+	struct lofi_comp_cache *lc, key;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
+
+	key.lc_index = seg_index;
+	if ((lc = avl_find(&lsp->ls_comp_cache_tree, &key, NULL)) != NULL) {
+		/*
+		 * Decompressed segment data was found in the
+		 * cache.
+		 *
+		 * The cache uses an LRU replacement strategy;
+		 * move the entry to head of list.
+		 */
+		list_remove(&lsp->ls_comp_cache, lc);
+		list_insert_head(&lsp->ls_comp_cache, lc);
+	}
+	return (lc);
+}
+
+/*
+ * Find the least recently used cache entry that no reader holds, and
+ * take it out of the cache.
+ */
+static struct lofi_comp_cache *
+lofi_evict_comp_data(struct lofi_state *lsp)
 {
 	struct lofi_comp_cache *lc;
 
 	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
 
-	for (lc = list_head(&lsp->ls_comp_cache); lc != NULL;
-	    lc = list_next(&lsp->ls_comp_cache, lc)) {
-		if (lc->lc_index == seg_index) {
-			/*
-			 * Decompressed segment data was found in the
-			 * cache.
-			 *
-			 * The cache uses an LRU replacement strategy;
-			 * move the entry to head of list.
-			 */
+	for (lc = list_tail(&lsp->ls_comp_cache); lc != NULL;
+	    lc = list_prev(&lsp->ls_comp_cache, lc)) {
+		if (lc->lc_refcnt == 0) {
 			list_remove(&lsp->ls_comp_cache, lc);
-			list_insert_head(&lsp->ls_comp_cache, lc);
+			avl_remove(&lsp->ls_comp_cache_tree, lc);
 			return (lc);
 		}
 	}
@@ -1139,19 +1235,20 @@ lofi_find_comp_data(struct lofi_state *lsp, uint64_t seg_index)
  *
  * Returns a pointer to the cache element structure in case
  * the data was added to the cache; returns NULL when the data
- * wasn't cached.
+ * wasn't cached, including when the segment already was.
  */
 static struct lofi_comp_cache *
 lofi_add_comp_data(struct lofi_state *lsp, uint64_t seg_index,
     uchar_t *data)
 {
-	struct lofi_comp_cache *lc;
+	struct lofi_comp_cache *lc, key;
+	avl_index_t where;
 
 	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
 
 	while (lsp->ls_comp_cache_count > lofi_max_comp_cache) {
-		lc = list_remove_tail(&lsp->ls_comp_cache);
-		ASSERT(lc != NULL);
+		if ((lc = lofi_evict_comp_data(lsp)) == NULL)
+			break;
 		kmem_free(lc->lc_data, lsp->ls_uncomp_seg_sz);
 		kmem_free(lc, sizeof (struct lofi_comp_cache));
 		lsp->ls_comp_cache_count--;
@@ -1163,11 +1260,18 @@ lofi_add_comp_data(struct lofi_state *lsp, uint64_t seg_index,
 	if (lofi_max_comp_cache == 0)
 		return (NULL);
 
+	/*
+	 * Another request, or read-ahead, got here first.
+	 */
+	key.lc_index = seg_index;
+	if (avl_find(&lsp->ls_comp_cache_tree, &key, &where) != NULL)
+		return (NULL);
+
 	/*
 	 * When the cache has not yet reached the maximum allowed
 	 * number of segments, allocate a new cache element.
-	 * Otherwise the cache is full; reuse the last list element
-	 * (LRU) for caching the decompressed segment data.
+	 * Otherwise the cache is full; reuse the least recently used
+	 * element that is not being copied from.
 	 *
 	 * The cache element for the new decompressed segment data is
 	 * added to the head of the list.
@@ -1175,13 +1279,13 @@ lofi_add_comp_data(struct lofi_state *lsp, uint64_t seg_index,
 	if (lsp->ls_comp_cache_count < lofi_max_comp_cache) {
 		lc = kmem_alloc(sizeof (struct lofi_comp_cache), KM_SLEEP);
 		lc->lc_data = NULL;
-		list_insert_head(&lsp->ls_comp_cache, lc);
 		lsp->ls_comp_cache_count++;
 	} else {
-		lc = list_remove_tail(&lsp->ls_comp_cache);
-		if (lc == NULL)
+		if ((lc = lofi_evict_comp_data(lsp)) == NULL)
 			return (NULL);
-		list_insert_head(&lsp->ls_comp_cache, lc);
+		/* the tree changed under our insertion point */
+		VERIFY(avl_find(&lsp->ls_comp_cache_tree, &key,
+		    &where) == NULL);
 	}
 
 	/*
@@ -1193,6 +1297,9 @@ lofi_add_comp_data(struct lofi_state *lsp, uint64_t seg_index,
 
 	lc->lc_data = data;
 	lc->lc_index = seg_index;
+	lc->lc_refcnt = 0;
+	list_insert_head(&lsp->ls_comp_cache, lc);
+	avl_insert(&lsp->ls_comp_cache_tree, lc, where);
 	return (lc);
 }
 
@@ -1231,6 +1338,227 @@ lzma_decompress(void *src, size_t srclen, void *dst,
 	return (0);
 }
 
+/*
+ * Segments are in the format of the zfs lz4 compressor, whose
+ * implementation we share: a 32-bit big-endian length of the lz4
+ * stream that follows.
+ */
+/*ARGSUSED*/
+static int
+lofi_lz4_decompress(void *src, size_t srclen, void *dst,
+    size_t *dstlen, int level)
+{
+	if (lz4_decompress(src, dst, srclen, *dstlen, level) != 0)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Fill in seg_data for a segment whose compressed data is at seg_cmp,
+ * decompressing it into a newly allocated buffer if need be.
+ */
+static void
+lofi_decomp_seg(lofi_seg_t *seg)
+{
+	struct lofi_state *lsp = seg->seg_lsp;
+	lofi_compress_info_t *li;
+	ulong_t seglen;
+
+	/*
+	 * The first byte in a compressed segment is a flag
+	 * that indicates whether this segment is compressed
+	 * at all.
+	 */
+	if (*seg->seg_cmp == UNCOMPRESSED) {
+		seg->seg_data = seg->seg_cmp + SEGHDR;
+		return;
+	}
+
+	/*
+	 * The last segment is special in that it is
+	 * most likely not going to be the same
+	 * (uncompressed) size as the other segments.
+	 */
+	if (seg->seg_index == (lsp->ls_comp_index_sz - 2))
+		seglen = lsp->ls_uncomp_last_seg_sz;
+	else
+		seglen = lsp->ls_uncomp_seg_sz;
+
+	li = &lofi_compress_table[lsp->ls_comp_algorithm_index];
+	seg->seg_data = kmem_alloc(lsp->ls_uncomp_seg_sz, KM_SLEEP);
+	seg->seg_alloc = B_TRUE;
+	if (li->l_decompress(seg->seg_cmp + SEGHDR, seg->seg_cmplen - SEGHDR,
+	    seg->seg_data, &seglen, li->l_level) != 0)
+		seg->seg_error = EIO;
+}
+
+static void
+lofi_decomp_task(void *arg)
+{
+	lofi_seg_t *seg = arg;
+	lofi_seg_wait_t *sw = seg->seg_wait;
+
+	lofi_decomp_seg(seg);
+
+	mutex_enter(&sw->sw_lock);
+	if (--sw->sw_pending == 0)
+		cv_broadcast(&sw->sw_cv);
+	mutex_exit(&sw->sw_lock);
+}
+
+/*
+ * Decompress those of the nsegs segments that have compressed data,
+ * spreading them over lofi_decomp_taskq when there is more than one.
+ * The calling thread does a share of the work rather than just waiting.
+ */
+static void
+lofi_decomp_segs(lofi_seg_t *segs, uint64_t nsegs)
+{
+	lofi_seg_wait_t sw;
+	lofi_seg_t *first = NULL;
+	uint64_t i;
+
+	mutex_init(&sw.sw_lock, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&sw.sw_cv, NULL, CV_DRIVER, NULL);
+	sw.sw_pending = 0;
+
+	for (i = 0; i < nsegs; i++) {
+		if (segs[i].seg_cmp == NULL)
+			continue;
+		if (first == NULL) {
+			first = &segs[i];
+			continue;
+		}
+		if (lofi_decomp_taskq == NULL) {
+			lofi_decomp_seg(&segs[i]);
+			continue;
+		}
+		segs[i].seg_wait = &sw;
+		mutex_enter(&sw.sw_lock);
+		sw.sw_pending++;
+		mutex_exit(&sw.sw_lock);
+		(void) taskq_dispatch(lofi_decomp_taskq, lofi_decomp_task,
+		    &segs[i], TQ_SLEEP);
+	}
+	if (first != NULL)
+		lofi_decomp_seg(first);
+
+	mutex_enter(&sw.sw_lock);
+	while (sw.sw_pending > 0)
+		cv_wait(&sw.sw_cv, &sw.sw_lock);
+	mutex_exit(&sw.sw_lock);
+
+	mutex_destroy(&sw.sw_lock);
+	cv_destroy(&sw.sw_cv);
+}
+
+/*
+ * Read a compressed segment straight from the image, decompress it
+ * and put it in the cache.
+ */
+static void
+lofi_comp_readahead_task(void *arg)
+{
+	lofi_readahead_t *lr = arg;
+	struct lofi_state *lsp = lr->lr_lsp;
+	lofi_seg_t seg;
+	ssize_t resid;
+
+	bzero(&seg, sizeof (seg));
+	seg.seg_lsp = lsp;
+	seg.seg_index = lr->lr_index;
+	seg.seg_cmplen = lsp->ls_comp_seg_index[seg.seg_index + 1] -
+	    lsp->ls_comp_seg_index[seg.seg_index];
+
+	if (!lsp->ls_vp_closereq && seg.seg_cmplen > SEGHDR) {
+		seg.seg_cmp = kmem_alloc(seg.seg_cmplen, KM_SLEEP);
+		if (vn_rdwr(UIO_READ, lsp->ls_vp, (caddr_t)seg.seg_cmp,
+		    seg.seg_cmplen, lsp->ls_comp_seg_index[seg.seg_index],
+		    UIO_SYSSPACE, 0, RLIM64_INFINITY, kcred, &resid) == 0 &&
+		    resid == 0 && *seg.seg_cmp != UNCOMPRESSED) {
+			lofi_decomp_seg(&seg);
+		}
+	}
+
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	if (seg.seg_alloc && seg.seg_error == 0 &&
+	    lofi_add_comp_data(lsp, seg.seg_index, seg.seg_data) != NULL)
+		seg.seg_alloc = B_FALSE;
+	lsp->ls_comp_ra_pending--;
+	mutex_exit(&lsp->ls_comp_cache_lock);
+
+	if (seg.seg_alloc)
+		kmem_free(seg.seg_data, lsp->ls_uncomp_seg_sz);
+	if (seg.seg_cmp != NULL)
+		kmem_free(seg.seg_cmp, seg.seg_cmplen);
+	kmem_free(lr, sizeof (*lr));
+
+	mutex_enter(&lsp->ls_vp_lock);
+	if (--lsp->ls_vp_iocount == 0)
+		cv_broadcast(&lsp->ls_vp_cv);
+	mutex_exit(&lsp->ls_vp_lock);
+}
+
+/*
+ * A read of a compressed image ended in segment index - 1; start
+ * reading ahead the segments after it that aren't cached yet.  Reads
+ * that keep going where the last read-ahead left off only pick up the
+ * segments beyond it.  Everything here is best effort.
+ */
+static void
+lofi_comp_readahead_start(struct lofi_state *lsp, uint64_t index)
+{
+	lofi_readahead_t *lr;
+	struct lofi_comp_cache key;
+	uint64_t end;
+
+	if (lofi_decomp_taskq == NULL || lofi_comp_readahead == 0 ||
+	    lofi_max_comp_cache == 0)
+		return;
+
+	end = MIN(index + lofi_comp_readahead, lsp->ls_comp_index_sz - 1);
+
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	if (index < lsp->ls_comp_ra_next && lsp->ls_comp_ra_next <= end)
+		index = lsp->ls_comp_ra_next;
+
+	for (; index < end; index++) {
+		if (lsp->ls_comp_ra_pending >= lofi_comp_readahead)
+			break;
+		key.lc_index = index;
+		if (avl_find(&lsp->ls_comp_cache_tree, &key, NULL) != NULL)
+			continue;
+
+		lr = kmem_alloc(sizeof (*lr), KM_NOSLEEP);
+		if (lr == NULL)
+			break;
+		lr->lr_lsp = lsp;
+		lr->lr_index = index;
+
+		mutex_enter(&lsp->ls_vp_lock);
+		if (lsp->ls_vp_closereq) {
+			mutex_exit(&lsp->ls_vp_lock);
+			kmem_free(lr, sizeof (*lr));
+			break;
+		}
+		lsp->ls_vp_iocount++;
+		mutex_exit(&lsp->ls_vp_lock);
+
+		if (taskq_dispatch(lofi_decomp_taskq, lofi_comp_readahead_task,
+		    lr, TQ_NOSLEEP) == NULL) {
+			kmem_free(lr, sizeof (*lr));
+			mutex_enter(&lsp->ls_vp_lock);
+			if (--lsp->ls_vp_iocount == 0)
+				cv_broadcast(&lsp->ls_vp_cv);
+			mutex_exit(&lsp->ls_vp_lock);
+			break;
+		}
+		lsp->ls_comp_ra_pending++;
+	}
+	lsp->ls_comp_ra_next = index;
+	mutex_exit(&lsp->ls_comp_cache_lock);
+}
+
 /*
  * This is basically what strategy used to be before we found we
  * needed task queues.
@@ -1303,13 +1631,10 @@ lofi_strategy_task(void *arg)
 	} else if (lsp->ls_uncomp_seg_sz == 0) {
 		error = lofi_mapped_rdwr(bufaddr, offset, bp, lsp);
 	} else {
-		uchar_t *compressed_seg = NULL, *cmpbuf;
-		uchar_t *uncompressed_seg = NULL;
-		lofi_compress_info_t *li;
+		uchar_t *compressed_seg = NULL;
 		size_t oblkcount;
-		ulong_t seglen;
-		uint64_t sblkno, eblkno, cmpbytes;
-		uint64_t uncompressed_seg_index;
+		uint64_t sblkno, eblkno, nsegs, cmpfirst, cmplast;
+		lofi_seg_t *segs, *seg;
 		struct lofi_comp_cache *lc;
 		offset_t sblkoff, eblkoff;
 		u_offset_t salign, ealign;
@@ -1330,11 +1655,10 @@ lofi_strategy_task(void *arg)
 		if (!(bp->b_flags & B_READ)) {
 			bp->b_resid = bp->b_bcount;
 			error = EROFS;
-			goto done;
+			goto errout;
 		}
 
 		ASSERT(lsp->ls_comp_algorithm_index >= 0);
-		li = &lofi_compress_table[lsp->ls_comp_algorithm_index];
 		/*
 		 * Compute starting and ending compressed segment numbers
 		 * We use only bitwise operations avoiding division and
@@ -1345,61 +1669,55 @@ lofi_strategy_task(void *arg)
 		sblkoff = offset & (lsp->ls_uncomp_seg_sz - 1);
 		eblkno = (offset + bp->b_bcount) >> lsp->ls_comp_seg_shift;
 		eblkoff = (offset + bp->b_bcount) & (lsp->ls_uncomp_seg_sz - 1);
+		if (eblkoff == 0 && eblkno > sblkno)
+			eblkno--;
+		if (eblkno > lsp->ls_comp_index_sz - 2)
+			eblkno = lsp->ls_comp_index_sz - 2;
+
+		nsegs = eblkno - sblkno + 1;
+		segs = kmem_zalloc(nsegs * sizeof (lofi_seg_t), KM_SLEEP);
 
 		/*
-		 * Check the decompressed segment cache.
-		 *
-		 * The cache is used only when the requested data
-		 * is within a segment. Requests that cross
-		 * segment boundaries bypass the cache.
+		 * Check the decompressed segment cache, and hold on to
+		 * the entries found there while we copy from them.
 		 */
-		if (sblkno == eblkno ||
-		    (sblkno + 1 == eblkno && eblkoff == 0)) {
-			/*
-			 * Request doesn't cross a segment boundary,
-			 * now check the cache.
-			 */
-			mutex_enter(&lsp->ls_comp_cache_lock);
-			lc = lofi_find_comp_data(lsp, sblkno);
-			if (lc != NULL) {
-				/*
-				 * We've found the decompressed segment
-				 * data in the cache; reuse it.
-				 */
-				bcopy(lc->lc_data + sblkoff, bufaddr,
-				    bp->b_bcount);
-				mutex_exit(&lsp->ls_comp_cache_lock);
-				bp->b_resid = 0;
-				error = 0;
-				goto done;
+		cmpfirst = nsegs;
+		cmplast = 0;
+		mutex_enter(&lsp->ls_comp_cache_lock);
+		for (i = 0; i < nsegs; i++) {
+			seg = &segs[i];
+			seg->seg_lsp = lsp;
+			seg->seg_index = sblkno + i;
+			if ((lc = lofi_find_comp_data(lsp,
+			    seg->seg_index)) != NULL) {
+				lc->lc_refcnt++;
+				seg->seg_lc = lc;
+				seg->seg_data = lc->lc_data;
+				continue;
 			}
-			mutex_exit(&lsp->ls_comp_cache_lock);
+			if (cmpfirst == nsegs)
+				cmpfirst = i;
+			cmplast = i;
 		}
+		mutex_exit(&lsp->ls_comp_cache_lock);
 
 		/*
-		 * Align start offset to block boundary for segmap
+		 * Preserve original request paramaters
 		 */
-		salign = lsp->ls_comp_seg_index[sblkno];
-		sdiff = salign & (DEV_BSIZE - 1);
-		salign -= sdiff;
-		if (eblkno >= (lsp->ls_comp_index_sz - 1)) {
-			/*
-			 * We're dealing with the last segment of
-			 * the compressed file -- the size of this
-			 * segment *may not* be the same as the
-			 * segment size for the file
-			 */
-			eblkoff = (offset + bp->b_bcount) &
-			    (lsp->ls_uncomp_last_seg_sz - 1);
-			ealign = lsp->ls_vp_comp_size;
-		} else {
-			ealign = lsp->ls_comp_seg_index[eblkno + 1];
-		}
+		oblkcount = bp->b_bcount;
+
+		if (cmpfirst == nsegs)
+			goto copyout;
 
 		/*
-		 * Preserve original request paramaters
+		 * Read the compressed data of the segments the cache
+		 * missed, aligning the start offset to a block boundary
+		 * for segmap.
 		 */
-		oblkcount = bp->b_bcount;
+		salign = lsp->ls_comp_seg_index[sblkno + cmpfirst];
+		sdiff = salign & (DEV_BSIZE - 1);
+		salign -= sdiff;
+		ealign = lsp->ls_comp_seg_index[sblkno + cmplast + 1];
 
 		/*
 		 * Assign the calculated parameters
@@ -1445,120 +1763,91 @@ lofi_strategy_task(void *arg)
 		    bp, lsp);
 
 		bp->b_bcount = oblkcount;
-		bp->b_resid = oblkcount;
-		if (error != 0)
+		if (error != 0) {
+			bp->b_resid = oblkcount;
 			goto done;
+		}
 
 		/*
-		 * decompress compressed blocks start
+		 * Each of the segment index entries contains
+		 * the starting block number for that segment.
+		 * The number of compressed bytes in a segment
+		 * is thus the difference between the starting
+		 * block number of this segment and the starting
+		 * block number of the next segment.
 		 */
-		cmpbuf = compressed_seg + sdiff;
-		for (i = sblkno; i <= eblkno; i++) {
-			ASSERT(i < lsp->ls_comp_index_sz - 1);
-			uchar_t *useg;
-
-			/*
-			 * The last segment is special in that it is
-			 * most likely not going to be the same
-			 * (uncompressed) size as the other segments.
-			 */
-			if (i == (lsp->ls_comp_index_sz - 2)) {
-				seglen = lsp->ls_uncomp_last_seg_sz;
-			} else {
-				seglen = lsp->ls_uncomp_seg_sz;
-			}
-
-			/*
-			 * Each of the segment index entries contains
-			 * the starting block number for that segment.
-			 * The number of compressed bytes in a segment
-			 * is thus the difference between the starting
-			 * block number of this segment and the starting
-			 * block number of the next segment.
-			 */
-			cmpbytes = lsp->ls_comp_seg_index[i + 1] -
-			    lsp->ls_comp_seg_index[i];
+		for (i = cmpfirst; i <= cmplast; i++) {
+			seg = &segs[i];
+			if (seg->seg_lc != NULL)
+				continue;
+			seg->seg_cmp = compressed_seg + sdiff +
+			    (lsp->ls_comp_seg_index[seg->seg_index] -
+			    lsp->ls_comp_seg_index[sblkno + cmpfirst]);
+			seg->seg_cmplen =
+			    lsp->ls_comp_seg_index[seg->seg_index + 1] -
+			    lsp->ls_comp_seg_index[seg->seg_index];
+		}
+		lofi_decomp_segs(&segs[cmpfirst], cmplast - cmpfirst + 1);
 
-			/*
-			 * The first byte in a compressed segment is a flag
-			 * that indicates whether this segment is compressed
-			 * at all.
-			 *
-			 * The variable 'useg' is used (instead of
-			 * uncompressed_seg) in this loop to keep a
-			 * reference to the uncompressed segment.
-			 *
-			 * N.B. If 'useg' is replaced with uncompressed_seg,
-			 * it leads to memory leaks and heap corruption in
-			 * corner cases where compressed segments lie
-			 * adjacent to uncompressed segments.
-			 */
-			if (*cmpbuf == UNCOMPRESSED) {
-				useg = cmpbuf + SEGHDR;
-			} else {
-				if (uncompressed_seg == NULL)
-					uncompressed_seg =
-					    kmem_alloc(lsp->ls_uncomp_seg_sz,
-					    KM_SLEEP);
-				useg = uncompressed_seg;
-				uncompressed_seg_index = i;
-
-				if (li->l_decompress((cmpbuf + SEGHDR),
-				    (cmpbytes - SEGHDR), uncompressed_seg,
-				    &seglen, li->l_level) != 0) {
-					error = EIO;
-					goto done;
-				}
+copyout:
+		/*
+		 * Copy the uncompressed data out.
+		 */
+		bp->b_resid = oblkcount;
+		error = 0;
+		for (i = 0; i < nsegs && bp->b_resid > 0; i++) {
+			seg = &segs[i];
+			if (seg->seg_error != 0) {
+				error = seg->seg_error;
+				break;
 			}
 
-			/*
-			 * Determine how much uncompressed data we
-			 * have to copy and copy it
-			 */
-			xfersize = lsp->ls_uncomp_seg_sz - sblkoff;
-			if (i == eblkno)
-				xfersize -= (lsp->ls_uncomp_seg_sz - eblkoff);
-
-			bcopy((useg + sblkoff), bufaddr, xfersize);
+			xfersize = MIN(lsp->ls_uncomp_seg_sz - sblkoff,
+			    bp->b_resid);
+			bcopy(seg->seg_data + sblkoff, bufaddr, xfersize);
 
-			cmpbuf += cmpbytes;
 			bufaddr += xfersize;
 			bp->b_resid -= xfersize;
 			sblkoff = 0;
+		}
 
-			if (bp->b_resid == 0)
-				break;
-		} /* decompress compressed blocks ends */
-
-		/*
-		 * Skip to done if there is no uncompressed data to cache
-		 */
-		if (uncompressed_seg == NULL)
-			goto done;
-
+done:
 		/*
-		 * Add the data for the last decompressed segment to
-		 * the cache.
+		 * Drop our holds on cache entries and add the segments
+		 * we decompressed to the cache.
 		 *
 		 * In case the uncompressed segment data was added to (and
 		 * is referenced by) the cache, make sure we don't free it
 		 * here.
 		 */
 		mutex_enter(&lsp->ls_comp_cache_lock);
-		if ((lc = lofi_add_comp_data(lsp, uncompressed_seg_index,
-		    uncompressed_seg)) != NULL) {
-			uncompressed_seg = NULL;
+		for (i = 0; i < nsegs; i++) {
+			seg = &segs[i];
+			if (seg->seg_lc != NULL) {
+				seg->seg_lc->lc_refcnt--;
+			} else if (seg->seg_alloc && seg->seg_error == 0 &&
+			    lofi_add_comp_data(lsp, seg->seg_index,
+			    seg->seg_data) != NULL) {
+				seg->seg_alloc = B_FALSE;
+			}
 		}
 		mutex_exit(&lsp->ls_comp_cache_lock);
 
-done:
+		for (i = 0; i < nsegs; i++) {
+			if (segs[i].seg_alloc)
+				kmem_free(segs[i].seg_data,
+				    lsp->ls_uncomp_seg_sz);
+		}
+		kmem_free(segs, nsegs * sizeof (lofi_seg_t));
+
 		if (compressed_seg != NULL) {
 			mutex_enter(&lsp->ls_comp_bufs_lock);
 			lsp->ls_comp_bufs[j].inuse = 0;
 			mutex_exit(&lsp->ls_comp_bufs_lock);
 		}
-		if (uncompressed_seg != NULL)
-			kmem_free(uncompressed_seg, lsp->ls_uncomp_seg_sz);
+
+		if (error == 0)
+			lofi_comp_readahead_start(lsp, eblkno + 1);
 	} /* end of handling compressed files */
 
 	if ((error == 0) && (syncflag != 0))
@@ -2858,6 +3147,9 @@ lofi_map_file(dev_t dev, struct lofi_ioctl *ulip, int pickminor,
 
 	list_create(&lsp->ls_comp_cache, sizeof (struct lofi_comp_cache),
 	    offsetof(struct lofi_comp_cache, lc_list));
+	avl_create(&lsp->ls_comp_cache_tree, lofi_comp_cache_compare,
+	    sizeof (struct lofi_comp_cache),
+	    offsetof(struct lofi_comp_cache, lc_avl));
 
 	/*
 	 * save open mode so file can be closed properly and vnode counts
@@ -3593,9 +3885,19 @@ _init(void)
 	cv_init(&lofi_chan_cv, NULL, CV_DRIVER, NULL);
 	error = nvlist_alloc(&lofi_devlink_cache, NV_UNIQUE_NAME, KM_SLEEP);
 
+	if (lofi_decomp_nthreads > 0) {
+		lofi_decomp_taskq = taskq_create("lofi_decomp",
+		    lofi_decomp_nthreads, minclsyspri, lofi_decomp_nthreads,
+		    INT_MAX, TASKQ_PREPOPULATE);
+	}
+
 	if (error == 0)
 		error = mod_install(&modlinkage);
 	if (error) {
+		if (lofi_decomp_taskq != NULL) {
+			taskq_destroy(lofi_decomp_taskq);
+			lofi_decomp_taskq = NULL;
+		}
 		id_space_destroy(lofi_id);
 		if (lofi_devlink_cache != NULL)
 			nvlist_free(lofi_devlink_cache);
@@ -3632,6 +3934,11 @@ _fini(void)
 	lofi_devlink_cache = NULL;
 	mutex_exit(&lofi_chan_lock);
 
+	if (lofi_decomp_taskq != NULL) {
+		taskq_destroy(lofi_decomp_taskq);
+		lofi_decomp_taskq = NULL;
+	}
+
 	mutex_destroy(&lofi_chan_lock);
 	cv_destroy(&lofi_chan_cv);
 	mutex_destroy(&lofi_lock);
@@ -538,12 +538,15 @@ i_mac_constructor(void *buf, void *arg, int kmflag)
 	rw_init(&mip->mi_rw_lock, NULL, RW_DRIVER, NULL);
 	mutex_init(&mip->mi_notify_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&mip->mi_promisc_lock, NULL, MUTEX_DRIVER, NULL);
+	mutex_init(&mip->mi_rx_hook_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&mip->mi_ring_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	mip->mi_notify_cb_info.mcbi_lockp = &mip->mi_notify_lock;
 	cv_init(&mip->mi_notify_cb_info.mcbi_cv, NULL, CV_DRIVER, NULL);
 	mip->mi_promisc_cb_info.mcbi_lockp = &mip->mi_promisc_lock;
 	cv_init(&mip->mi_promisc_cb_info.mcbi_cv, NULL, CV_DRIVER, NULL);
+	mip->mi_rx_hook_cb_info.mcbi_lockp = &mip->mi_rx_hook_lock;
+	cv_init(&mip->mi_rx_hook_cb_info.mcbi_cv, NULL, CV_DRIVER, NULL);
 
 	mutex_init(&mip->mi_bridge_lock, NULL, MUTEX_DEFAULT, NULL);
 
@@ -584,6 +587,11 @@ i_mac_destructor(void *buf, void *arg)
 	ASSERT(mcbi->mcbi_lockp == &mip->mi_promisc_lock);
 	mcbi->mcbi_lockp = NULL;
 
+	mcbi = &mip->mi_rx_hook_cb_info;
+	ASSERT(mcbi->mcbi_del_cnt == 0 && mip->mi_rx_hook_list == NULL);
+	ASSERT(mcbi->mcbi_lockp == &mip->mi_rx_hook_lock);
+	mcbi->mcbi_lockp = NULL;
+
 	ASSERT(mip->mi_bcast_ngrps == 0 && mip->mi_bcast_grp == NULL);
 	ASSERT(mip->mi_perim_owner == NULL && mip->mi_perim_ocnt == 0);
 
@@ -591,6 +599,8 @@ i_mac_destructor(void *buf, void *arg)
 
 	mutex_destroy(&mip->mi_promisc_lock);
 	cv_destroy(&mip->mi_promisc_cb_info.mcbi_cv);
+	mutex_destroy(&mip->mi_rx_hook_lock);
+	cv_destroy(&mip->mi_rx_hook_cb_info.mcbi_cv);
 	mutex_destroy(&mip->mi_notify_lock);
 	cv_destroy(&mip->mi_notify_cb_info.mcbi_cv);
 	mutex_destroy(&mip->mi_ring_lock);
@@ -3031,6 +3041,7 @@ mac_prop_check_size(mac_prop_id_t id, uint_t valsize, boolean_t is_range)
 	case MAC_PROP_MTU:
 	case MAC_PROP_LLIMIT:
 	case MAC_PROP_LDECAY:
+	case MAC_PROP_LRO:
 		minsize = sizeof (uint32_t);
 		break;
 	case MAC_PROP_FLOWCTRL:
@@ -3217,6 +3228,20 @@ mac_set_prop(mac_handle_t mh, mac_prop_id_t id, char *name, void *val,
 		break;
 	}
 
+	case MAC_PROP_LRO: {
+		uint32_t lro;
+
+		if (valsize < sizeof (lro) ||
+		    (mip->mi_state_flags & MIS_IS_VNIC))
+			return (EINVAL);
+		bcopy(val, &lro, sizeof (lro));
+		if (lro > 1)
+			return (EINVAL);
+		mip->mi_lro = lro;
+		err = 0;
+		break;
+	}
+
 	default:
 		/* For other driver properties, call driver's callback */
 		if (mip->mi_callbacks->mc_callbacks & MC_SETPROP) {
@@ -3288,6 +3313,13 @@ mac_get_prop(mac_handle_t mh, mac_prop_id_t id, char *name, void *val,
 			bcopy(&mip->mi_ldecay, val, sizeof (mip->mi_ldecay));
 		return (0);
 
+	case MAC_PROP_LRO:
+		ASSERT(valsize >= sizeof (uint32_t));
+		if (mip->mi_state_flags & MIS_IS_VNIC)
+			return (EINVAL);
+		bcopy(&mip->mi_lro, val, sizeof (mip->mi_lro));
+		return (0);
+
 	case MAC_PROP_MTU: {
 		uint32_t sdu;
 
@@ -3392,6 +3424,7 @@ mac_prop_info(mac_handle_t mh, mac_prop_id_t id, char *name,
 	case MAC_PROP_PVID:
 	case MAC_PROP_LLIMIT:
 	case MAC_PROP_LDECAY:
+	case MAC_PROP_LRO:
 		return (0);
 
 	case MAC_PROP_MAX_RX_RINGS_AVAIL:
@@ -5323,7 +5356,7 @@ mac_write_flow_stats(flow_entry_t *flent)
 	net_stat_t		*nstat;
 	mac_soft_ring_set_t	*mac_srs;
 	mac_rx_stats_t		*mac_rx_stat;
-	mac_tx_stats_t		*mac_tx_stat;
+	mac_tx_stats_t		mac_tx_stat;
 	int			i;
 
 	ninfo = kmem_zalloc(sizeof (netinfo_t), KM_NOSLEEP);
@@ -5349,11 +5382,11 @@ mac_write_flow_stats(flow_entry_t *flent)
 
 	mac_srs = (mac_soft_ring_set_t *)(flent->fe_tx_srs);
 	if (mac_srs != NULL) {
-		mac_tx_stat = &mac_srs->srs_tx.st_stat;
+		mac_tx_srs_stats_get(mac_srs, &mac_tx_stat);
 
-		nstat->ns_obytes = mac_tx_stat->mts_obytes;
-		nstat->ns_opackets = mac_tx_stat->mts_opackets;
-		nstat->ns_oerrors = mac_tx_stat->mts_oerrors;
+		nstat->ns_obytes = mac_tx_stat.mts_obytes;
+		nstat->ns_opackets = mac_tx_stat.mts_opackets;
+		nstat->ns_oerrors = mac_tx_stat.mts_oerrors;
 	}
 
 	ninfo->ni_record = nstat;
@@ -5408,7 +5441,7 @@ mac_write_link_stats(mac_client_impl_t *mcip)
 	flow_entry_t		*flent;
 	mac_soft_ring_set_t	*mac_srs;
 	mac_rx_stats_t		*mac_rx_stat;
-	mac_tx_stats_t		*mac_tx_stat;
+	mac_tx_stats_t		mac_tx_stat;
 	int			i;
 
 	ninfo = kmem_zalloc(sizeof (netinfo_t), KM_NOSLEEP);
@@ -5438,11 +5471,11 @@ mac_write_link_stats(mac_client_impl_t *mcip)
 
 	mac_srs = (mac_soft_ring_set_t *)(mcip->mci_flent->fe_tx_srs);
 	if (mac_srs != NULL) {
-		mac_tx_stat = &mac_srs->srs_tx.st_stat;
+		mac_tx_srs_stats_get(mac_srs, &mac_tx_stat);
 
-		nstat->ns_obytes = mac_tx_stat->mts_obytes;
-		nstat->ns_opackets = mac_tx_stat->mts_opackets;
-		nstat->ns_oerrors = mac_tx_stat->mts_oerrors;
+		nstat->ns_obytes = mac_tx_stat.mts_obytes;
+		nstat->ns_opackets = mac_tx_stat.mts_opackets;
+		nstat->ns_oerrors = mac_tx_stat.mts_oerrors;
 	}
 
 	ninfo->ni_record = nstat;
@@ -613,12 +613,11 @@ mac_client_stat_get(mac_client_handle_t mch, uint_t stat)
 	flow_entry_t 		*flent = mcip->mci_flent;
 	mac_soft_ring_set_t 	*mac_srs;
 	mac_rx_stats_t		*mac_rx_stat, *old_rx_stat;
-	mac_tx_stats_t		*mac_tx_stat, *old_tx_stat;
+	mac_tx_stats_t		mac_tx_stat, *old_tx_stat;
 	int i;
 	uint64_t val = 0;
 
 	mac_srs = (mac_soft_ring_set_t *)(flent->fe_tx_srs);
-	mac_tx_stat = &mac_srs->srs_tx.st_stat;
 	old_rx_stat = &mcip->mci_misc_stat.mms_defunctrxlanestats;
 	old_tx_stat = &mcip->mci_misc_stat.mms_defuncttxlanestats;
 
@@ -651,15 +650,18 @@ mac_client_stat_get(mac_client_handle_t mch, uint_t stat)
 		val = mcip->mci_misc_stat.mms_brdcstxmt;
 		break;
 	case MAC_STAT_OBYTES:
-		val = mac_tx_stat->mts_obytes;
+		mac_tx_srs_stats_get(mac_srs, &mac_tx_stat);
+		val = mac_tx_stat.mts_obytes;
 		val += old_tx_stat->mts_obytes;
 		break;
 	case MAC_STAT_OPACKETS:
-		val = mac_tx_stat->mts_opackets;
+		mac_tx_srs_stats_get(mac_srs, &mac_tx_stat);
+		val = mac_tx_stat.mts_opackets;
 		val += old_tx_stat->mts_opackets;
 		break;
 	case MAC_STAT_OERRORS:
-		val = mac_tx_stat->mts_oerrors;
+		mac_tx_srs_stats_get(mac_srs, &mac_tx_stat);
+		val = mac_tx_stat.mts_oerrors;
 		val += old_tx_stat->mts_oerrors;
 		break;
 	case MAC_STAT_IPACKETS:
@@ -3448,7 +3450,7 @@ mac_tx(mac_client_handle_t mch, mblk_t *mp_chain, uintptr_t hint,
 	if (!(flag & MAC_TX_NO_HOLD)) {
 		MAC_TX_TRY_HOLD(mcip, mytx, error);
 		if (error != 0) {
-			freemsgchain(mp_chain);
+			freemsgchain_bulk(mp_chain);
 			return (NULL);
 		}
 	}
@@ -3486,7 +3488,7 @@ mac_tx(mac_client_handle_t mch, mblk_t *mp_chain, uintptr_t hint,
 	 * of the mac datapath is required to remove this limitation.
 	 */
 	if (srs == NULL) {
-		freemsgchain(mp_chain);
+		freemsgchain_bulk(mp_chain);
 		goto done;
 	}
 
@@ -3763,6 +3765,73 @@ mac_notify_remove(mac_notify_handle_t mnh, boolean_t wait)
 	return (err);
 }
 
+/*
+ * Add an early receive hook to the specified MAC. The hook is run by
+ * mac_rx_common() on every inbound chain before promiscuous dispatch and
+ * classification, and decides which packets continue up the stack. Please
+ * see the comments above mac_callback_add() for general information about
+ * mac callback addition/deletion in the presence of mac callback list
+ * walkers.
+ */
+mac_rx_hook_handle_t
+mac_rx_hook_add(mac_handle_t mh, mac_rx_hook_t hook_fn, void *arg)
+{
+	mac_impl_t		*mip = (mac_impl_t *)mh;
+	mac_rx_hook_cb_t	*mrhcb;
+	mac_cb_info_t		*mcbi;
+
+	mrhcb = kmem_zalloc(sizeof (mac_rx_hook_cb_t), KM_SLEEP);
+	mrhcb->mrhcb_fn = hook_fn;
+	mrhcb->mrhcb_arg = arg;
+	mrhcb->mrhcb_mip = mip;
+	mrhcb->mrhcb_link.mcb_objp = mrhcb;
+	mrhcb->mrhcb_link.mcb_objsize = sizeof (mac_rx_hook_cb_t);
+	mrhcb->mrhcb_link.mcb_flags = MCB_RX_HOOK_CB_T;
+
+	mcbi = &mip->mi_rx_hook_cb_info;
+
+	i_mac_perim_enter(mip);
+	mutex_enter(mcbi->mcbi_lockp);
+
+	mac_callback_add(&mip->mi_rx_hook_cb_info, &mip->mi_rx_hook_list,
+	    &mrhcb->mrhcb_link);
+
+	mutex_exit(mcbi->mcbi_lockp);
+	i_mac_perim_exit(mip);
+	return ((mac_rx_hook_handle_t)mrhcb);
+}
+
+/*
+ * Remove an early receive hook. On return the hook is no longer running on
+ * any CPU and its argument may be freed by the caller.
+ */
+void
+mac_rx_hook_remove(mac_rx_hook_handle_t mrhh)
+{
+	mac_rx_hook_cb_t	*mrhcb = (mac_rx_hook_cb_t *)mrhh;
+	mac_impl_t		*mip = mrhcb->mrhcb_mip;
+	mac_cb_info_t		*mcbi;
+
+	mcbi = &mip->mi_rx_hook_cb_info;
+
+	i_mac_perim_enter(mip);
+	mutex_enter(mcbi->mcbi_lockp);
+
+	ASSERT(mrhcb->mrhcb_link.mcb_objp == mrhcb);
+	/*
+	 * If there are list walkers the element is only marked condemned,
+	 * and the last walker frees it; wait for that to happen.
+	 */
+	if (mac_callback_remove(&mip->mi_rx_hook_cb_info,
+	    &mip->mi_rx_hook_list, &mrhcb->mrhcb_link))
+		kmem_free(mrhcb, sizeof (mac_rx_hook_cb_t));
+	else
+		mac_callback_remove_wait(&mip->mi_rx_hook_cb_info);
+
+	mutex_exit(mcbi->mcbi_lockp);
+	i_mac_perim_exit(mip);
+}
+
 /*
  * Associate resource management callbacks with the specified MAC
  * clients.
@@ -4002,6 +4071,30 @@ mac_is_mcast(mac_impl_t *mip, mblk_t *mp)
 	    (hdr_info.mhi_dsttype == MAC_ADDRTYPE_MULTICAST));
 }
 
+/*
+ * Run the early receive hooks of the specified MAC over an inbound chain,
+ * returning whatever the hooks let through.
+ */
+mblk_t *
+mac_rx_hook_dispatch(mac_impl_t *mip, mblk_t *mp_chain)
+{
+	mac_rx_hook_cb_t *mrhcb;
+	mac_cb_t *mcb;
+
+	MAC_CALLBACK_WALKER_INC(&mip->mi_rx_hook_cb_info);
+	for (mcb = mip->mi_rx_hook_list; mcb != NULL && mp_chain != NULL;
+	    mcb = mcb->mcb_nextp) {
+		if (mcb->mcb_flags & MCB_CONDEMNED)
+			continue;
+		mrhcb = (mac_rx_hook_cb_t *)mcb->mcb_objp;
+		mp_chain = mrhcb->mrhcb_fn(mrhcb->mrhcb_arg, mp_chain);
+	}
+	MAC_CALLBACK_WALKER_DCR(&mip->mi_rx_hook_cb_info,
+	    &mip->mi_rx_hook_list);
+
+	return (mp_chain);
+}
+
 /*
  * Send a copy of an mblk chain to the MAC clients of the specified MAC.
  * "sender" points to the sender MAC client for outbound packets, and
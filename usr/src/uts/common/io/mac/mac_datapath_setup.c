@@ -389,6 +389,7 @@ mac_srs_client_poll_enable(mac_client_impl_t *mcip,
 	mrf.mrf_receive = (mac_receive_t)mac_soft_ring_poll;
 	mrf.mrf_intr_enable = (mac_intr_enable_t)mac_soft_ring_intr_enable;
 	mrf.mrf_intr_disable = (mac_intr_disable_t)mac_soft_ring_intr_disable;
+	mrf.mrf_steer = (mac_rx_steer_t)mac_soft_ring_steer;
 	mac_srs->srs_type |= SRST_CLIENT_POLL_ENABLED;
 
 	softring = mac_srs->srs_soft_ring_head;
@@ -1732,6 +1733,7 @@ mac_srs_create_proto_softrings(int id, uint16_t type, pri_t pri,
 	    (mac_intr_enable_t)mac_soft_ring_intr_enable;
 	mrf.mrf_intr_disable =
 	    (mac_intr_disable_t)mac_soft_ring_intr_disable;
+	mrf.mrf_steer = (mac_rx_steer_t)mac_soft_ring_steer;
 	mrf.mrf_flow_priority = pri;
 
 	softring = mac_soft_ring_create(id, mac_soft_ring_worker_wait,
@@ -3412,6 +3414,10 @@ mac_srs_free(mac_soft_ring_set_t *mac_srs)
 	mac_srs_ring_free(mac_srs);
 	mac_srs_soft_rings_free(mac_srs);
 	mac_srs_fanout_list_free(mac_srs);
+	if (mac_srs->srs_steer != NULL) {
+		kmem_free(mac_srs->srs_steer, MAC_STEER_SIZE);
+		mac_srs->srs_steer = NULL;
+	}
 
 	mac_srs->srs_bw = NULL;
 	mac_srs_stat_delete(mac_srs);
@@ -198,6 +198,9 @@ mac_register(mac_register_t *mregp, mac_handle_t *mhp)
 	mip->mi_llimit = 1000;
 	mip->mi_ldecay = 200;
 
+	/* Receive coalescing is off until the "lro" property is set */
+	mip->mi_lro = 0;
+
 	driver = (char *)ddi_driver_name(mip->mi_dip);
 
 	/* Construct the MAC name as <drvname><instance> */
@@ -686,6 +689,16 @@ mac_rx_common(mac_handle_t mh, mac_resource_handle_t mrh, mblk_t *mp_chain)
 	mblk_t			*bp = mp_chain;
 	boolean_t		hw_classified = B_FALSE;
 
+	/*
+	 * Early receive hooks get the first look at the chain and may drop
+	 * packets before anything else in the MAC layer touches them.
+	 */
+	if (mip->mi_rx_hook_list != NULL) {
+		if ((mp_chain = mac_rx_hook_dispatch(mip, mp_chain)) == NULL)
+			return;
+		bp = mp_chain;
+	}
+
 	/*
 	 * If there are any promiscuous mode callbacks defined for
 	 * this MAC, pass them a copy if appropriate.
@@ -975,12 +975,14 @@
 #include <sys/vlan.h>
 #include <sys/stack.h>
 #include <sys/archsystm.h>
+#include <sys/pattr.h>
 #include <inet/ipsec_impl.h>
 #include <inet/ip_impl.h>
 #include <inet/sadb.h>
 #include <inet/ipsecesp.h>
 #include <inet/ipsecah.h>
 #include <inet/ip6.h>
+#include <inet/tcp.h>
 
 #include <sys/mac_impl.h>
 #include <sys/mac_client_impl.h>
@@ -1442,6 +1444,20 @@ mac_srs_fire(void *arg)
 
 #define	COMPUTE_INDEX(key, sz)	(key % sz)
 
+/*
+ * Send a TCP flow to the soft ring its consumer asked for, if any, rather
+ * than to the one its hash picks.  See mac_soft_ring_steer().
+ */
+#define	MAC_RX_STEER_INDEX(mac_srs, hash, indx) {			\
+	uint8_t	*steer = (mac_srs)->srs_steer;				\
+	uint_t	s;							\
+									\
+	if (steer != NULL &&						\
+	    (s = steer[(hash) % MAC_STEER_SIZE]) != 0 &&		\
+	    s <= (mac_srs)->srs_tcp_ring_count)				\
+		(indx) = s - 1;						\
+}
+
 #define	FANOUT_ENQUEUE_MP(head, tail, cnt, bw_ctl, sz, sz0, mp) {	\
 	if ((tail) != NULL) {						\
 		ASSERT((tail)->b_next == NULL);				\
@@ -1474,6 +1490,333 @@ enum pkt_type {
  */
 #define	PORTS_SIZE 4
 
+/*
+ * Receive coalescing.
+ *
+ * When the "lro" link property is set, the chain that the fanout code
+ * hands each TCP soft ring is first passed through mac_rx_lro(), which
+ * merges in-order data segments of the same connection into one larger
+ * packet.  IP, the squeue and TCP then run once per merged packet rather
+ * than once per segment.  Only segments that arrived in the same batch
+ * are merged; nothing is held back to wait for more, so no packet is
+ * delivered any later than it would have been.
+ *
+ * A segment is a candidate when its IPv4 header has no options and is
+ * not a fragment's, its headers are in the first mblk, it carries data
+ * with no flags other than ACK and PSH, and its checksum has been
+ * verified by the hardware.  It is merged into the packet held for its
+ * connection if it follows on in sequence and its TOS, TTL,
+ * acknowledgment and TCP options (timestamps included) are the same, so
+ * TCP learns nothing less from the merged packet than it would have from
+ * the segments.  The payload is linked on with b_cont, and the IP length,
+ * TCP window and flags are updated.  Both checksums are then made valid
+ * again, the TCP one from the headers alone: the data of a verified
+ * segment sums to the complement of its pseudo-header and TCP header.
+ *
+ * The merged packet is larger than the MTU, so coalescing should not be
+ * enabled on a link whose traffic is forwarded rather than received.
+ */
+#define	MAC_LRO_NFLOWS	8
+
+uint32_t mac_lro_maxlen = IP_MAXPACKET;
+
+#define	MAC_LRO_PASS(head, tail, cnt, mp) {				\
+	if ((tail) != NULL)						\
+		(tail)->b_next = (mp);					\
+	else								\
+		(head) = (mp);						\
+	(tail) = (mp);							\
+	(cnt)++;							\
+}
+
+typedef struct mac_lro_flow_s {
+	mblk_t		*lf_head;	/* the packet being built */
+	mblk_t		*lf_tail;	/* last mblk of lf_head */
+	ipha_t		*lf_ipha;
+	tcpha_t		*lf_tcpha;
+	uint32_t	lf_seq;		/* sequence number that follows on */
+	uint32_t	lf_len;		/* IP length of the merged packet */
+	uint32_t	lf_dsum;	/* partial checksum of its payload */
+	uint_t		lf_nseg;	/* segments merged */
+} mac_lro_flow_t;
+
+/*
+ * The partial checksum of a segment's pseudo-header and TCP header, for a
+ * TCP length (header and payload) of tcplen.
+ */
+static uint32_t
+mac_lro_hdrsum(ipha_t *ipha, tcpha_t *tcpha, uint_t tcplen)
+{
+	ipaddr_t	src = ipha->ipha_src;
+	ipaddr_t	dst = ipha->ipha_dst;
+	uint32_t	sum;
+
+	sum = (src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) +
+	    htons(tcplen) + IP_TCP_CSUM_COMP;
+	return (IP_BCSUM_PARTIAL((uchar_t *)tcpha, TCP_HDR_LENGTH(tcpha),
+	    sum));
+}
+
+/*
+ * Return the length of the payload if the segment is a candidate for
+ * merging, or 0.  The fanout code has already checked that the IP header
+ * is aligned and in the first mblk, which is not shared, and that the
+ * ports follow it.
+ */
+static uint_t
+mac_lro_check(mblk_t *mp, ipha_t *ipha, tcpha_t *tcpha)
+{
+	uint32_t	flags = DB_CKSUMFLAGS(mp);
+	uint_t		iplen, tcphlen;
+
+	if ((flags & HCK_FULLCKSUM_OK) == 0 &&
+	    ((flags & HCK_FULLCKSUM) == 0 || DB_CKSUM16(mp) != 0xFFFF))
+		return (0);
+
+	if (ipha->ipha_version_and_hdr_length != IP_SIMPLE_HDR_VERSION ||
+	    (ntohs(ipha->ipha_fragment_offset_and_flags) &
+	    (IPH_MF | IPH_OFFSET)) != 0)
+		return (0);
+
+	if ((uchar_t *)tcpha + TCP_MIN_HEADER_LENGTH > mp->b_wptr)
+		return (0);
+	tcphlen = TCP_HDR_LENGTH(tcpha);
+	iplen = ntohs(ipha->ipha_length);
+	if (tcphlen < TCP_MIN_HEADER_LENGTH ||
+	    (uchar_t *)tcpha + tcphlen > mp->b_wptr ||
+	    iplen <= IP_SIMPLE_HDR_LENGTH + tcphlen ||
+	    iplen != (mp->b_cont == NULL ? MBLKL(mp) : msgdsize(mp)))
+		return (0);
+
+	if ((tcpha->tha_flags & ~TH_PUSH) != TH_ACK)
+		return (0);
+
+	/* The IP header checksum is rewritten, so it must be good now. */
+	if ((flags & HCK_IPV4_HDRCKSUM_OK) == 0 && ip_csum_hdr(ipha) != 0)
+		return (0);
+
+	return (iplen - IP_SIMPLE_HDR_LENGTH - tcphlen);
+}
+
+static void
+mac_lro_hold(mac_lro_flow_t *lf, mblk_t *mp, ipha_t *ipha, tcpha_t *tcpha,
+    uint_t paylen)
+{
+	lf->lf_head = mp;
+	while (mp->b_cont != NULL)
+		mp = mp->b_cont;
+	lf->lf_tail = mp;
+	lf->lf_ipha = ipha;
+	lf->lf_tcpha = tcpha;
+	lf->lf_seq = ntohl(tcpha->tha_seq) + paylen;
+	lf->lf_len = ntohs(ipha->ipha_length);
+	lf->lf_dsum = ~mac_lro_hdrsum(ipha, tcpha,
+	    lf->lf_len - IP_SIMPLE_HDR_LENGTH) & 0xFFFF;
+	lf->lf_nseg = 1;
+}
+
+static void
+mac_lro_merge(mac_lro_flow_t *lf, mblk_t *mp, ipha_t *ipha, tcpha_t *tcpha,
+    uint_t paylen)
+{
+	tcpha_t		*htcpha = lf->lf_tcpha;
+	uint_t		tcphlen = TCP_HDR_LENGTH(tcpha);
+	uint32_t	dsum;
+	mblk_t		*nmp;
+
+	dsum = ~mac_lro_hdrsum(ipha, tcpha, tcphlen + paylen) & 0xFFFF;
+	/* Data that starts at an odd offset is summed with its bytes swapped */
+	if ((lf->lf_len - IP_SIMPLE_HDR_LENGTH - tcphlen) & 1)
+		dsum = ((dsum << 8) | (dsum >> 8)) & 0xFFFF;
+	lf->lf_dsum += dsum;
+
+	htcpha->tha_win = tcpha->tha_win;
+	htcpha->tha_flags |= tcpha->tha_flags;
+
+	mp->b_rptr += IP_SIMPLE_HDR_LENGTH + tcphlen;
+	if (mp->b_rptr == mp->b_wptr) {
+		nmp = mp->b_cont;
+		freeb(mp);
+		mp = nmp;
+	}
+	lf->lf_tail->b_cont = mp;
+	while (mp->b_cont != NULL)
+		mp = mp->b_cont;
+	lf->lf_tail = mp;
+
+	lf->lf_seq += paylen;
+	lf->lf_len += paylen;
+	lf->lf_nseg++;
+}
+
+/*
+ * Pass on the packet held for a connection, first fixing up its headers
+ * if anything was merged into it.
+ */
+static void
+mac_lro_flush(mac_lro_flow_t *lf, mblk_t **headp, mblk_t **tailp, int *cntp,
+    uint64_t *reason)
+{
+	mblk_t		*mp = lf->lf_head;
+	ipha_t		*ipha = lf->lf_ipha;
+	tcpha_t		*tcpha = lf->lf_tcpha;
+	uint32_t	sum;
+
+	if (lf->lf_nseg > 1) {
+		ipha->ipha_length = htons(lf->lf_len);
+		ipha->ipha_hdr_checksum = 0;
+		ipha->ipha_hdr_checksum = ip_csum_hdr(ipha);
+
+		tcpha->tha_sum = 0;
+		sum = mac_lro_hdrsum(ipha, tcpha,
+		    lf->lf_len - IP_SIMPLE_HDR_LENGTH) + lf->lf_dsum;
+		sum = (sum & 0xFFFF) + (sum >> 16);
+		sum = (sum & 0xFFFF) + (sum >> 16);
+		tcpha->tha_sum = ~sum & 0xFFFF;
+
+		DB_CKSUMFLAGS(mp) = (DB_CKSUMFLAGS(mp) & ~HCK_FULLCKSUM) |
+		    HCK_FULLCKSUM_OK | HCK_IPV4_HDRCKSUM_OK;
+	}
+
+	MAC_LRO_PASS(*headp, *tailp, *cntp, mp);
+	(*reason)++;
+	lf->lf_head = NULL;
+}
+
+/*
+ * Coalesce the chain of IPv4 TCP packets about to be delivered to a TCP
+ * soft ring, replacing the chain and its count.  Packets of the same
+ * connection stay in order; those of different connections may not.
+ */
+static void
+mac_rx_lro(mac_soft_ring_t *ringp, mblk_t **headp, mblk_t **tailp, int *cntp)
+{
+	mac_lro_flow_t		flows[MAC_LRO_NFLOWS];
+	mac_lro_stats_t		*stat = &ringp->s_ring_lro_stat;
+	mac_soft_ring_set_t	*mac_srs = ringp->s_ring_set;
+	mac_lro_flow_t		*lf;
+	mblk_t			*mp, *next;
+	mblk_t			*head = NULL, *tail = NULL;
+	ipha_t			*ipha, *hipha;
+	tcpha_t			*tcpha, *htcpha;
+	uint_t			paylen, tcphlen;
+	int			nflows = 0, evict = 0;
+	int			i, cnt = 0, incnt = *cntp;
+
+	for (mp = *headp; mp != NULL; mp = next) {
+		next = mp->b_next;
+		mp->b_next = NULL;
+
+		ipha = (ipha_t *)mp->b_rptr;
+		/* LINTED: cast may result in improper alignment */
+		tcpha = (tcpha_t *)((uchar_t *)ipha + IPH_HDR_LENGTH(ipha));
+		if ((uchar_t *)tcpha + PORTS_SIZE > mp->b_wptr) {
+			/*
+			 * Without the ports there is no telling which
+			 * connection this is, so keep it behind them all.
+			 */
+			for (i = 0; i < nflows; i++) {
+				if (flows[i].lf_head != NULL) {
+					mac_lro_flush(&flows[i], &head, &tail,
+					    &cnt, &stat->mls_flush_hdr);
+				}
+			}
+			MAC_LRO_PASS(head, tail, cnt, mp);
+			continue;
+		}
+		paylen = mac_lro_check(mp, ipha, tcpha);
+
+		for (i = 0, lf = NULL; i < nflows; i++) {
+			if (flows[i].lf_head == NULL)
+				continue;
+			hipha = flows[i].lf_ipha;
+			if (hipha->ipha_src == ipha->ipha_src &&
+			    hipha->ipha_dst == ipha->ipha_dst &&
+			    *(uint32_t *)flows[i].lf_tcpha ==
+			    *(uint32_t *)tcpha) {
+				lf = &flows[i];
+				break;
+			}
+		}
+
+		if (lf != NULL) {
+			hipha = lf->lf_ipha;
+			htcpha = lf->lf_tcpha;
+			if (paylen == 0 ||
+			    (tcphlen = TCP_HDR_LENGTH(tcpha)) !=
+			    TCP_HDR_LENGTH(htcpha) ||
+			    ipha->ipha_type_of_service !=
+			    hipha->ipha_type_of_service ||
+			    ipha->ipha_ttl != hipha->ipha_ttl ||
+			    tcpha->tha_ack != htcpha->tha_ack ||
+			    bcmp(&tcpha[1], &htcpha[1],
+			    tcphlen - TCP_MIN_HEADER_LENGTH) != 0) {
+				mac_lro_flush(lf, &head, &tail, &cnt,
+				    &stat->mls_flush_hdr);
+			} else if (ntohl(tcpha->tha_seq) != lf->lf_seq) {
+				mac_lro_flush(lf, &head, &tail, &cnt,
+				    &stat->mls_flush_seq);
+			} else if (lf->lf_len + paylen > mac_lro_maxlen) {
+				mac_lro_flush(lf, &head, &tail, &cnt,
+				    &stat->mls_flush_size);
+			} else {
+				mac_lro_merge(lf, mp, ipha, tcpha, paylen);
+				stat->mls_merged++;
+				if (tcpha->tha_flags & TH_PUSH) {
+					mac_lro_flush(lf, &head, &tail, &cnt,
+					    &stat->mls_flush_push);
+				}
+				continue;
+			}
+		} else if (paylen != 0 && (tcpha->tha_flags & TH_PUSH) == 0) {
+			for (i = 0; i < nflows; i++) {
+				if (flows[i].lf_head == NULL) {
+					lf = &flows[i];
+					break;
+				}
+			}
+			if (lf == NULL && nflows < MAC_LRO_NFLOWS) {
+				lf = &flows[nflows++];
+			} else if (lf == NULL) {
+				lf = &flows[evict++ % MAC_LRO_NFLOWS];
+				mac_lro_flush(lf, &head, &tail, &cnt,
+				    &stat->mls_flush_evict);
+			}
+		}
+
+		/*
+		 * Anything with PSH set is passed straight on, since it
+		 * would be flushed as soon as it was held.
+		 */
+		if (lf == NULL || paylen == 0 || (tcpha->tha_flags & TH_PUSH)) {
+			MAC_LRO_PASS(head, tail, cnt, mp);
+			continue;
+		}
+		mac_lro_hold(lf, mp, ipha, tcpha, paylen);
+	}
+
+	for (i = 0; i < nflows; i++) {
+		if (flows[i].lf_head != NULL) {
+			mac_lro_flush(&flows[i], &head, &tail, &cnt,
+			    &stat->mls_flush_end);
+		}
+	}
+
+	*headp = head;
+	*tailp = tail;
+	*cntp = cnt;
+
+	/*
+	 * The SRS counted every segment on its way in; the merged ones will
+	 * never be counted out by the soft ring.
+	 */
+	if (cnt != incnt) {
+		mutex_enter(&mac_srs->srs_lock);
+		MAC_UPDATE_SRS_COUNT_LOCKED(mac_srs, incnt - cnt);
+		mutex_exit(&mac_srs->srs_lock);
+	}
+}
+
 /*
  * mac_rx_srs_proto_fanout
  *
@@ -1686,6 +2029,10 @@ mac_rx_srs_proto_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 			case OTH:
 				softring = mac_srs->srs_oth_soft_rings[0];
 			}
+			if (type == V4_TCP && mcip->mci_mip->mi_lro) {
+				mac_rx_lro(softring, &headmp[type],
+				    &tailmp[type], &cnt[type]);
+			}
 			mac_rx_soft_ring_process(mcip, softring,
 			    headmp[type], tailmp[type], cnt[type], sz[type]);
 		}
@@ -1861,6 +2208,63 @@ src_dst_based_fanout:
 	return (0);
 }
 
+/*
+ * mac_soft_ring_steer
+ *
+ * Receive flow steering, called by the client (IP) through the mrf_steer
+ * entry point of one of the TCP soft rings it was given.  The consumer of
+ * the IPv4 TCP flow with the given addresses and ports (as they appear in
+ * the flow's packets) now runs on cpuid: look for a TCP soft ring of the
+ * same SRS that is bound to that CPU, send the flow there from now on, and
+ * return that ring, or NULL if there is none.  Only the soft ring fanout
+ * within the SRS is changed; which hardware ring a flow arrives on is up
+ * to the NIC.
+ *
+ * The table is only a hint: flows whose hashes collide share an entry, and
+ * packets already queued on the old ring may be delivered after the first
+ * few on the new one.  The caller is expected to steer rarely.
+ *
+ * The caller must keep the soft ring from going away, which IP does by
+ * holding ill_lock while the ring is RR_SQUEUE_BOUND.
+ */
+void *
+mac_soft_ring_steer(void *arg, processorid_t cpuid, uint32_t src,
+    uint32_t dst, uint32_t ports)
+{
+	mac_soft_ring_t		*ringp = (mac_soft_ring_t *)arg;
+	mac_soft_ring_set_t	*mac_srs = ringp->s_ring_set;
+	mac_soft_ring_t		*softring;
+	uint8_t			*steer;
+	uint32_t		hash;
+	int			i, cnt;
+
+	if (!(mac_srs->srs_type & SRST_FANOUT_SRC_IP))
+		return (NULL);
+
+	cnt = mac_srs->srs_tcp_ring_count;
+	for (i = 0; i < cnt; i++) {
+		softring = mac_srs->srs_tcp_soft_rings[i];
+		if (softring->s_ring_cpuid == cpuid &&
+		    (softring->s_ring_state & S_RING_BOUND))
+			break;
+	}
+	if (i == cnt)
+		return (NULL);
+
+	if ((steer = mac_srs->srs_steer) == NULL) {
+		if ((steer = kmem_zalloc(MAC_STEER_SIZE, KM_NOSLEEP)) == NULL)
+			return (NULL);
+		if (atomic_cas_ptr(&mac_srs->srs_steer, NULL, steer) != NULL) {
+			kmem_free(steer, MAC_STEER_SIZE);
+			steer = mac_srs->srs_steer;
+		}
+	}
+
+	hash = HASH_ADDR(src, dst, ports);
+	steer[hash % MAC_STEER_SIZE] = i + 1;
+	return (softring);
+}
+
 /*
  * mac_rx_srs_fanout
  *
@@ -2129,6 +2533,7 @@ mac_rx_srs_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 			hash = HASH_ADDR(ipha->ipha_src, ipha->ipha_dst,
 			    *(uint32_t *)(mp->b_rptr + ports_offset));
 			indx = COMPUTE_INDEX(hash, mac_srs->srs_tcp_ring_count);
+			MAC_RX_STEER_INDEX(mac_srs, hash, indx);
 			type = V4_TCP;
 			mp->b_rptr += hdrsize;
 			break;
@@ -2179,6 +2584,10 @@ mac_rx_srs_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 					    mac_srs->srs_oth_soft_rings[i];
 					break;
 				}
+				if (type == V4_TCP && mcip->mci_mip->mi_lro) {
+					mac_rx_lro(softring, &headmp[type][i],
+					    &tailmp[type][i], &cnt[type][i]);
+				}
 				mac_rx_soft_ring_process(mcip,
 				    softring, headmp[type][i], tailmp[type][i],
 				    cnt[type][i], sz[type][i]);
@@ -3984,23 +4393,65 @@ mac_tx_bw_mode(mac_soft_ring_set_t *mac_srs, mblk_t *mp_chain,
  * rings that have been removed, no such cookie is needed on the Tx
  * side as the pseudo Tx ring won't be available anymore to
  * aggr_find_tx_ring() once the port has been removed.
+ *
+ * aggr_find_tx_ring() picks the ring from the first packet only. A chain
+ * passed with a hint belongs to one conversation, but one passed without
+ * one may hold many, which would then all leave by the same port. Such
+ * chains are split into runs of packets going to the same ring, and, as
+ * in mac_tx_fanout_mode(), unsent packets are dropped since the caller
+ * keeps no per conversation state.
  */
+#define	MAC_TX_AGGR_RING_PROCESS(ring, chain, flag, ret_mp)		\
+	mac_tx_soft_ring_process(					\
+	    srs_tx->st_soft_rings[((mac_ring_t *)(ring))->mr_index],	\
+	    (chain), (flag), (ret_mp))
+
 static mac_tx_cookie_t
 mac_tx_aggr_mode(mac_soft_ring_set_t *mac_srs, mblk_t *mp_chain,
     uintptr_t fanout_hint, uint16_t flag, mblk_t **ret_mp)
 {
 	mac_srs_tx_t		*srs_tx = &mac_srs->srs_tx;
 	mac_tx_ring_fn_t	find_tx_ring_fn;
-	mac_ring_handle_t	ring = NULL;
+	mac_ring_handle_t	ring = NULL, last_ring = NULL;
 	void			*arg;
-	mac_soft_ring_t		*sringp;
+	mblk_t			*mp, *last_mp, *sub_chain;
 
 	find_tx_ring_fn = srs_tx->st_capab_aggr.mca_find_tx_ring_fn;
 	arg = srs_tx->st_capab_aggr.mca_arg;
-	if (find_tx_ring_fn(arg, mp_chain, fanout_hint, &ring) == NULL)
-		return (NULL);
-	sringp = srs_tx->st_soft_rings[((mac_ring_t *)ring)->mr_index];
-	return (mac_tx_soft_ring_process(sringp, mp_chain, flag, ret_mp));
+	if (fanout_hint != 0 || mp_chain->b_next == NULL) {
+		if (find_tx_ring_fn(arg, mp_chain, fanout_hint, &ring) == NULL)
+			return (NULL);
+		return (MAC_TX_AGGR_RING_PROCESS(ring, mp_chain, flag,
+		    ret_mp));
+	}
+
+	flag |= MAC_DROP_ON_NO_DESC;
+	sub_chain = last_mp = NULL;
+	while (mp_chain != NULL) {
+		mp = mp_chain;
+		mp_chain = mp->b_next;
+		mp->b_next = NULL;
+		if (find_tx_ring_fn(arg, mp, 0, &ring) == NULL)
+			continue;
+
+		if (sub_chain != NULL && ring != last_ring) {
+			(void) MAC_TX_AGGR_RING_PROCESS(last_ring, sub_chain,
+			    flag, NULL);
+			sub_chain = NULL;
+		}
+		if (sub_chain == NULL)
+			sub_chain = mp;
+		else
+			last_mp->b_next = mp;
+		last_mp = mp;
+		last_ring = ring;
+	}
+	if (sub_chain != NULL) {
+		(void) MAC_TX_AGGR_RING_PROCESS(last_ring, sub_chain, flag,
+		    NULL);
+	}
+
+	return (NULL);
 }
 
 void
@@ -4983,7 +5434,6 @@ mac_tx_soft_ring_process(mac_soft_ring_t *ringp, mblk_t *mp_chain,
 			mutex_exit(&ringp->s_ring_lock);
 			return (cookie);
 		}
-		SRS_TX_STATS_UPDATE(mac_srs, &stats);
 		SOFTRING_TX_STATS_UPDATE(ringp, &stats);
 
 		return (NULL);
@@ -653,7 +653,6 @@ mac_tx_soft_ring_drain(mac_soft_ring_t *ringp)
 	mblk_t 			*tail;
 	uint_t			saved_pkt_count, saved_size;
 	mac_tx_stats_t		stats;
-	mac_soft_ring_set_t	*mac_srs = ringp->s_ring_set;
 
 	saved_pkt_count = saved_size = 0;
 	ringp->s_ring_run = curthread;
@@ -700,7 +699,6 @@ mac_tx_soft_ring_drain(mac_soft_ring_t *ringp)
 			return;
 		} else {
 			ringp->s_ring_tx_woken_up = B_FALSE;
-			SRS_TX_STATS_UPDATE(mac_srs, &stats);
 			SOFTRING_TX_STATS_UPDATE(ringp, &stats);
 		}
 	}
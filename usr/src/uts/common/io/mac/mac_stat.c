@@ -64,7 +64,14 @@ enum mac_stat {
 	MAC_STAT_MULTIRCVBYTES,
 	MAC_STAT_BRDCSTRCVBYTES,
 	MAC_STAT_MULTIXMTBYTES,
-	MAC_STAT_BRDCSTXMTBYTES
+	MAC_STAT_BRDCSTXMTBYTES,
+	MAC_STAT_LRO_MERGED,
+	MAC_STAT_LRO_FLUSH_SEQ,
+	MAC_STAT_LRO_FLUSH_HDR,
+	MAC_STAT_LRO_FLUSH_PUSH,
+	MAC_STAT_LRO_FLUSH_SIZE,
+	MAC_STAT_LRO_FLUSH_EVICT,
+	MAC_STAT_LRO_FLUSH_END
 };
 
 static mac_stat_info_t	i_mac_si[] = {
@@ -235,6 +242,13 @@ static mac_stat_info_t  i_mac_tx_hwlane_si[] = {
 static mac_stat_info_t  i_mac_rx_fanout_si[] = {
 	{ MAC_STAT_RBYTES,	"rbytes",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_IPACKETS,	"ipackets",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_LRO_MERGED,	"lro_merged",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_LRO_FLUSH_SEQ, "lro_flush_seq", KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_LRO_FLUSH_HDR, "lro_flush_hdr", KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_LRO_FLUSH_PUSH, "lro_flush_push", KSTAT_DATA_UINT64, 0},
+	{ MAC_STAT_LRO_FLUSH_SIZE, "lro_flush_size", KSTAT_DATA_UINT64, 0},
+	{ MAC_STAT_LRO_FLUSH_EVICT, "lro_flush_evict", KSTAT_DATA_UINT64, 0},
+	{ MAC_STAT_LRO_FLUSH_END, "lro_flush_end", KSTAT_DATA_UINT64,	0}
 };
 #define	MAC_RX_FANOUT_NKSTAT \
 	(sizeof (i_mac_rx_fanout_si) / sizeof (mac_stat_info_t))
@@ -496,16 +510,20 @@ i_mac_tx_swlane_stat_get(void *handle, uint_t stat)
 {
 	mac_soft_ring_set_t *mac_srs = (mac_soft_ring_set_t *)handle;
 	mac_tx_stats_t *mac_tx_stat = &mac_srs->srs_tx.st_stat;
+	mac_tx_stats_t tx_stats;
 
 	switch (stat) {
 	case MAC_STAT_OBYTES:
-		return (mac_tx_stat->mts_obytes);
+		mac_tx_srs_stats_get(mac_srs, &tx_stats);
+		return (tx_stats.mts_obytes);
 
 	case MAC_STAT_OPACKETS:
-		return (mac_tx_stat->mts_opackets);
+		mac_tx_srs_stats_get(mac_srs, &tx_stats);
+		return (tx_stats.mts_opackets);
 
 	case MAC_STAT_OERRORS:
-		return (mac_tx_stat->mts_oerrors);
+		mac_tx_srs_stats_get(mac_srs, &tx_stats);
+		return (tx_stats.mts_oerrors);
 
 	case MAC_STAT_BLOCK:
 		return (mac_tx_stat->mts_blockcnt);
@@ -901,6 +919,35 @@ i_mac_rx_fanout_stat_get(void *handle, uint_t stat)
 		    (oth_ringp->s_ring_total_inpkt);
 		break;
 
+	/* Only the TCP soft ring coalesces */
+	case MAC_STAT_LRO_MERGED:
+		val = tcp_ringp->s_ring_lro_stat.mls_merged;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_SEQ:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_seq;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_HDR:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_hdr;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_PUSH:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_push;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_SIZE:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_size;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_EVICT:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_evict;
+		break;
+
+	case MAC_STAT_LRO_FLUSH_END:
+		val = tcp_ringp->s_ring_lro_stat.mls_flush_end;
+		break;
+
 	default:
 		val = 0;
 		break;
@@ -1274,6 +1321,31 @@ mac_stat_rename(mac_client_impl_t *mcip)
 	mac_misc_stat_create(flent);
 }
 
+/*
+ * A Tx SRS with Tx soft rings leaves the packet, byte and error counts to
+ * the soft rings, so that senders using different rings never write the
+ * same cache line; the counts for the client are the sum of the SRS's own
+ * and those of its soft rings.  A soft ring's counts move to the client's
+ * defunct lane stats when it is removed.
+ */
+void
+mac_tx_srs_stats_get(mac_soft_ring_set_t *mac_srs, mac_tx_stats_t *stats)
+{
+	mac_soft_ring_t	*ringp;
+
+	mutex_enter(&mac_srs->srs_lock);
+	*stats = mac_srs->srs_tx.st_stat;
+	for (ringp = mac_srs->srs_soft_ring_head; ringp != NULL;
+	    ringp = ringp->s_ring_next) {
+		if (!(ringp->s_ring_type & ST_RING_TX))
+			continue;
+		stats->mts_opackets += ringp->s_st_stat.mts_opackets;
+		stats->mts_obytes += ringp->s_st_stat.mts_obytes;
+		stats->mts_oerrors += ringp->s_st_stat.mts_oerrors;
+	}
+	mutex_exit(&mac_srs->srs_lock);
+}
+
 void
 mac_tx_srs_stat_recreate(mac_soft_ring_set_t *tx_srs, boolean_t add_stats)
 {
@@ -466,7 +466,7 @@ mac_pkt_drop(void *arg, mac_resource_handle_t resource, mblk_t *mp,
 		mp1->b_queue = NULL;
 		mp1 = mp1->b_next;
 	}
-	freemsgchain(mp);
+	freemsgchain_bulk(mp);
 }
 
 /*
@@ -39,6 +39,18 @@
  * from all queues sharing an interrupt vector and will post them to a taskq
  * for completion processing.
  *
+ * The rate of interrupts can be reduced with the interrupt coalescing
+ * feature of the controller, which holds back the interrupt for a queue until
+ * a number of completions have accumulated or some time has passed. This is
+ * configured with the intr-coalesce-threshold and intr-coalesce-time
+ * properties. For the lowest latency the driver can instead poll for the
+ * completion of I/O commands: with poll-time set, the thread submitting an
+ * I/O command spins on the completion queue for up to that many microseconds
+ * and completes commands itself, without waiting for an interrupt or the
+ * taskq. If the command hasn't completed by then, it falls back to the
+ * interrupt. Only one thread polls a queue at a time. The nvme:<instance>:intr
+ * kstat counts interrupts and how completions were reaped.
+ *
  *
  * Command Processing:
  *
@@ -56,9 +68,9 @@
  * commands currently being processed by the hardware) and the active command
  * counter. Access to the submission side of a queue pair and the shared state
  * is protected by nq_mutex. The completion side of a queue pair does not need
- * that protection apart from its access to the shared state; it is called only
- * in the interrupt handler which does not run concurrently for the same
- * interrupt vector.
+ * that protection apart from its access to the shared state; it is protected
+ * by nq_cq_mutex instead, since it may be run by the interrupt handler and by
+ * a polling thread.
  *
  * When a command is submitted to a queue pair the active command counter is
  * incremented and a pointer to the command is stored in the command array. The
@@ -74,10 +86,12 @@
  *
  * NVMe devices can have multiple namespaces, each being a independent data
  * store. The driver supports multiple namespaces and creates a blkdev interface
- * for each namespace found. Namespaces can have various attributes to support
- * thin provisioning, extended LBAs, and protection information. This driver
- * does not support any of this and ignores namespaces that have these
- * attributes.
+ * for each active namespace found; namespace IDs the controller reports as
+ * inactive (zero size) are skipped. Namespaces can have various attributes to
+ * support thin provisioning, extended LBAs, and protection information. Thin
+ * provisioned namespaces are supported, with space handed back to the device
+ * through DKIOCFREE (see below). This driver doesn't support extended LBAs or
+ * protection information and ignores namespaces that have these attributes.
  *
  *
  * Blkdev Interface:
@@ -91,6 +105,12 @@
  * an I/O queue. The queue is selected by taking the CPU id modulo the number of
  * queues. There is currently no timeout handling of I/O commands.
  *
+ * If the controller supports the optional Dataset Management and Write Zeroes
+ * commands, DKIOCFREE requests are turned into them: a free becomes a single
+ * Dataset Management command with the deallocate attribute, describing the
+ * range in up to 256 LBA ranges, and a free with DF_ZERO becomes one Write
+ * Zeroes command per 65536 blocks. Neither is polled for.
+ *
  * Blkdev also supports querying device/media information and generating a
  * devid. The driver reports the best block size as determined by the namespace
  * format back to blkdev as physical block size to support partition and block
@@ -148,6 +168,10 @@
  * - io-queue-len: the maximum length of the I/O queues (16-65536)
  * - async-event-limit: the maximum number of asynchronous event requests to be
  *   posted by the driver
+ * - intr-coalesce-time: the interrupt aggregation time in 100us units (0-255)
+ * - intr-coalesce-threshold: the interrupt aggregation threshold (0-255),
+ *   one less than the number of completions to aggregate
+ * - poll-time: the time in microseconds to poll for I/O completions (0-1000)
  *
  *
  * TODO:
@@ -157,7 +181,6 @@
  * - support for the Volatile Write Cache
  * - support for devices supporting very large I/O requests using chained PRPs
  * - support for querying log pages from user space
- * - support for configuring hardware parameters like interrupt coalescing
  * - support for media formatting and hard partitioning into namespaces
  * - support for big-endian systems
  * - support for fast reboot
@@ -178,6 +201,7 @@
 #include <sys/param.h>
 #include <sys/varargs.h>
 #include <sys/cpuvar.h>
+#include <sys/cpu.h>
 #include <sys/disp.h>
 #include <sys/blkdev.h>
 #include <sys/atomic.h>
@@ -256,6 +280,8 @@ static int nvme_bd_cmd(nvme_namespace_t *, bd_xfer_t *, uint8_t);
 static int nvme_bd_read(void *, bd_xfer_t *);
 static int nvme_bd_write(void *, bd_xfer_t *);
 static int nvme_bd_sync(void *, bd_xfer_t *);
+static int nvme_bd_free(void *, bd_xfer_t *);
+static int nvme_bd_zero(void *, bd_xfer_t *);
 static int nvme_bd_devid(void *, dev_info_t *, ddi_devid_t *);
 
 static void nvme_prepare_devid(nvme_t *, uint32_t);
@@ -362,13 +388,15 @@ static struct modlinkage nvme_modlinkage = {
 };
 
 static bd_ops_t nvme_bd_ops = {
-	.o_version	= BD_OPS_VERSION_0,
+	.o_version	= BD_OPS_VERSION_1,
 	.o_drive_info	= nvme_bd_driveinfo,
 	.o_media_info	= nvme_bd_mediainfo,
 	.o_devid_init	= nvme_bd_devid,
 	.o_sync_cache	= nvme_bd_sync,
 	.o_read		= nvme_bd_read,
 	.o_write	= nvme_bd_write,
+	.o_free		= nvme_bd_free,
+	.o_zero		= nvme_bd_zero,
 };
 
 int
@@ -584,6 +612,7 @@ nvme_free_qpair(nvme_qpair_t *qp)
 	int i;
 
 	mutex_destroy(&qp->nq_mutex);
+	mutex_destroy(&qp->nq_cq_mutex);
 
 	if (qp->nq_sqdma != NULL)
 		nvme_free_dma(qp->nq_sqdma);
@@ -609,6 +638,8 @@ nvme_alloc_qpair(nvme_t *nvme, uint32_t nentry, nvme_qpair_t **nqp,
 
 	mutex_init(&qp->nq_mutex, NULL, MUTEX_DRIVER,
 	    DDI_INTR_PRI(nvme->n_intr_pri));
+	mutex_init(&qp->nq_cq_mutex, NULL, MUTEX_DRIVER,
+	    DDI_INTR_PRI(nvme->n_intr_pri));
 
 	if (nvme_zalloc_queue_dma(nvme, nentry, sizeof (nvme_sqe_t),
 	    DDI_DMA_WRITE, &qp->nq_sqdma) != DDI_SUCCESS)
@@ -1007,7 +1038,9 @@ nvme_check_specific_cmd_status(nvme_cmd_t *cmd)
 
 	case NVME_CQE_SC_SPC_NVM_READONLY:
 		/* Write to Read Only Range */
-		ASSERT(cmd->nc_sqe.sqe_opc == NVME_OPC_NVM_WRITE);
+		ASSERT(cmd->nc_sqe.sqe_opc == NVME_OPC_NVM_DSET_MGMT ||
+		    cmd->nc_sqe.sqe_opc == NVME_OPC_NVM_WRITE ||
+		    cmd->nc_sqe.sqe_opc == NVME_OPC_NVM_WRITE_ZERO);
 		atomic_inc_32(&cmd->nc_nvme->n_readonly);
 		bd_error(cmd->nc_xfer, BD_ERR_ILLRQ);
 		return (EROFS);
@@ -1593,6 +1626,44 @@ nvme_set_nqueues(nvme_t *nvme, uint16_t nqueues)
 	return (MIN(nqueues, MIN(nq.b.nq_nsq, nq.b.nq_ncq) + 1));
 }
 
+static void
+nvme_set_intr_coalescing(nvme_t *nvme)
+{
+	nvme_cmd_t *cmd;
+	nvme_intr_coal_t ic = { 0 };
+
+	if (nvme->n_intr_coal_time == 0 && nvme->n_intr_coal_thr == 0)
+		return;
+
+	ic.b.ic_thr = nvme->n_intr_coal_thr;
+	ic.b.ic_time = nvme->n_intr_coal_time;
+
+	cmd = nvme_alloc_cmd(nvme, KM_SLEEP);
+	cmd->nc_sqid = 0;
+	cmd->nc_callback = nvme_wakeup_cmd;
+	cmd->nc_sqe.sqe_opc = NVME_OPC_SET_FEATURES;
+	cmd->nc_sqe.sqe_cdw10 = NVME_FEAT_INTR_COAL;
+	cmd->nc_sqe.sqe_cdw11 = ic.r;
+
+	if (nvme_admin_cmd(cmd, nvme_admin_cmd_timeout) != DDI_SUCCESS) {
+		dev_err(nvme->n_dip, CE_WARN,
+		    "!nvme_admin_cmd failed for SET FEATURES (INTR_COAL)");
+		return;
+	}
+
+	/*
+	 * Interrupt coalescing is only an optimization, so carry on without
+	 * it if the controller refuses.
+	 */
+	if (nvme_check_cmd_status(cmd)) {
+		dev_err(nvme->n_dip, CE_WARN,
+		    "!SET FEATURES (INTR_COAL) failed with sct = %x, sc = %x",
+		    cmd->nc_cqe.cqe_sf.sf_sct, cmd->nc_cqe.cqe_sf.sf_sc);
+	}
+
+	nvme_free_cmd(cmd);
+}
+
 static int
 nvme_create_io_qpair(nvme_t *nvme, nvme_qpair_t *qp, uint16_t idx)
 {
@@ -2064,19 +2135,26 @@ nvme_init(nvme_t *nvme)
 			    1 << idns->id_lbaf[j].lbaf_lbads;
 		}
 
+		/*
+		 * Namespace IDs up to id_nn that aren't attached to this
+		 * controller identify as all zeroes.
+		 */
+		if (idns->id_nsize == 0) {
+			nvme->n_ns[i].ns_ignore = B_TRUE;
+			continue;
+		}
+
 		/*
 		 * We currently don't support namespaces that use either:
-		 * - thin provisioning
 		 * - extended LBAs
 		 * - protection information
 		 */
-		if (idns->id_nsfeat.f_thin ||
-		    idns->id_flbas.lba_extlba ||
+		if (idns->id_flbas.lba_extlba ||
 		    idns->id_dps.dp_pinfo) {
 			dev_err(nvme->n_dip, CE_WARN,
 			    "!ignoring namespace %d, unsupported features: "
-			    "thin = %d, extlba = %d, pinfo = %d", i + 1,
-			    idns->id_nsfeat.f_thin, idns->id_flbas.lba_extlba,
+			    "extlba = %d, pinfo = %d", i + 1,
+			    idns->id_flbas.lba_extlba,
 			    idns->id_dps.dp_pinfo);
 			nvme->n_ns[i].ns_ignore = B_TRUE;
 		}
@@ -2160,6 +2238,8 @@ nvme_init(nvme_t *nvme)
 		}
 	}
 
+	nvme_set_intr_coalescing(nvme);
+
 	/*
 	 * Post more asynchronous events commands to reduce event reporting
 	 * latency as suggested by the spec.
@@ -2200,14 +2280,23 @@ nvme_intr(caddr_t arg1, caddr_t arg2)
 	for (qnum = inum;
 	    qnum < nvme->n_ioq_count + 1 && nvme->n_ioq[qnum] != NULL;
 	    qnum += nvme->n_intr_cnt) {
-		while ((cmd = nvme_retrieve_cmd(nvme, nvme->n_ioq[qnum]))) {
+		nvme_qpair_t *qp = nvme->n_ioq[qnum];
+
+		mutex_enter(&qp->nq_cq_mutex);
+		while ((cmd = nvme_retrieve_cmd(nvme, qp))) {
 			taskq_dispatch_ent((taskq_t *)cmd->nc_nvme->n_cmd_taskq,
 			    cmd->nc_callback, cmd, TQ_NOSLEEP, &cmd->nc_tqent);
 			ccnt++;
 		}
+		mutex_exit(&qp->nq_cq_mutex);
 	}
 
-	return (ccnt > 0 ? DDI_INTR_CLAIMED : DDI_INTR_UNCLAIMED);
+	if (ccnt == 0)
+		return (DDI_INTR_UNCLAIMED);
+
+	atomic_inc_64(&nvme->n_kstat.nk_intrs.value.ui64);
+	atomic_add_64(&nvme->n_kstat.nk_intr_cmds.value.ui64, ccnt);
+	return (DDI_INTR_CLAIMED);
 }
 
 static void
@@ -2374,6 +2463,13 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	nvme->n_async_event_limit = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
 	    DDI_PROP_DONTPASS, "async-event-limit",
 	    NVME_DEFAULT_ASYNC_EVENT_LIMIT);
+	nvme->n_intr_coal_time = MIN(UINT8_MAX, ddi_prop_get_int(DDI_DEV_T_ANY,
+	    dip, DDI_PROP_DONTPASS, "intr-coalesce-time", 0));
+	nvme->n_intr_coal_thr = MIN(UINT8_MAX, ddi_prop_get_int(DDI_DEV_T_ANY,
+	    dip, DDI_PROP_DONTPASS, "intr-coalesce-threshold", 0));
+	nvme->n_poll_time = MIN(NVME_MAX_POLL_TIME,
+	    ddi_prop_get_int(DDI_DEV_T_ANY, dip, DDI_PROP_DONTPASS,
+	    "poll-time", 0));
 
 	if (nvme->n_admin_queue_len < NVME_MIN_ADMIN_QUEUE_LEN)
 		nvme->n_admin_queue_len = NVME_MIN_ADMIN_QUEUE_LEN;
@@ -2451,6 +2547,21 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		goto fail;
 	}
 
+	kstat_named_init(&nvme->n_kstat.nk_intrs, "intrs", KSTAT_DATA_UINT64);
+	kstat_named_init(&nvme->n_kstat.nk_intr_cmds, "intr_cmds",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&nvme->n_kstat.nk_poll_cmds, "poll_cmds",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&nvme->n_kstat.nk_io_cmds, "io_cmds",
+	    KSTAT_DATA_UINT64);
+	nvme->n_ksp = kstat_create(ddi_driver_name(dip), ddi_get_instance(dip),
+	    "intr", "controller", KSTAT_TYPE_NAMED,
+	    sizeof (nvme_kstat_t) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (nvme->n_ksp != NULL) {
+		nvme->n_ksp->ks_data = &nvme->n_kstat;
+		kstat_install(nvme->n_ksp);
+	}
+
 
 	if (nvme_init(nvme) != DDI_SUCCESS)
 		goto fail;
@@ -2551,6 +2662,9 @@ nvme_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 	if (nvme->n_cmd_taskq)
 		ddi_taskq_destroy(nvme->n_cmd_taskq);
 
+	if (nvme->n_ksp != NULL)
+		kstat_delete(nvme->n_ksp);
+
 	if (nvme->n_progress & NVME_CTRL_LIMITS)
 		sema_destroy(&nvme->n_abort_sema);
 
@@ -2696,6 +2810,53 @@ nvme_create_nvm_cmd(nvme_namespace_t *ns, uint8_t opc, bd_xfer_t *xfer)
 			goto fail;
 		break;
 
+	case NVME_OPC_NVM_WRITE_ZERO:
+		VERIFY(xfer->x_nblks <= 0x10000);
+
+		cmd->nc_sqe.sqe_nsid = ns->ns_id;
+
+		cmd->nc_sqe.sqe_cdw10 = xfer->x_blkno & 0xffffffffu;
+		cmd->nc_sqe.sqe_cdw11 = (xfer->x_blkno >> 32);
+		cmd->nc_sqe.sqe_cdw12 = (uint16_t)(xfer->x_nblks - 1);
+		break;
+
+	case NVME_OPC_NVM_DSET_MGMT: {
+		nvme_dsm_range_t *range;
+		uint64_t blkno = xfer->x_blkno;
+		uint64_t nblks = xfer->x_nblks;
+		uint_t nrange;
+
+		VERIFY(nblks <= NVME_DSM_MAX_RANGES * (uint64_t)UINT32_MAX);
+
+		if (nvme_zalloc_dma(nvme,
+		    NVME_DSM_MAX_RANGES * sizeof (nvme_dsm_range_t),
+		    DDI_DMA_WRITE, &nvme->n_prp_dma_attr, &cmd->nc_dma) !=
+		    DDI_SUCCESS) {
+			dev_err(nvme->n_dip, CE_WARN,
+			    "!%s: nvme_zalloc_dma failed", __func__);
+			goto fail;
+		}
+
+		/*LINTED: E_PTR_BAD_CAST_ALIGN*/
+		range = (nvme_dsm_range_t *)cmd->nc_dma->nd_memp;
+		for (nrange = 0; nblks > 0; nrange++) {
+			range[nrange].dr_slba = blkno;
+			range[nrange].dr_nlb = MIN(nblks, UINT32_MAX);
+			blkno += range[nrange].dr_nlb;
+			nblks -= range[nrange].dr_nlb;
+		}
+
+		(void) ddi_dma_sync(cmd->nc_dma->nd_dmah, 0,
+		    cmd->nc_dma->nd_len, DDI_DMA_SYNC_FORDEV);
+
+		cmd->nc_sqe.sqe_nsid = ns->ns_id;
+		cmd->nc_sqe.sqe_dptr.d_prp[0] =
+		    cmd->nc_dma->nd_cookie.dmac_laddress;
+		cmd->nc_sqe.sqe_cdw10 = nrange - 1;
+		cmd->nc_sqe.sqe_cdw11 = NVME_DSM_ATTR_AD;
+		break;
+	}
+
 	case NVME_OPC_NVM_FLUSH:
 		cmd->nc_sqe.sqe_nsid = ns->ns_id;
 		break;
@@ -2731,13 +2892,23 @@ nvme_bd_driveinfo(void *arg, bd_drive_t *drive)
 	nvme_t *nvme = ns->ns_nvme;
 
 	/*
-	 * blkdev maintains one queue size per instance (namespace),
-	 * but all namespace share the I/O queues.
+	 * Let blkdev submit on each of our I/O queues, steering every
+	 * transfer to the queue of the CPU that submits it.  blkdev
+	 * maintains one queue size per instance (namespace), but all
+	 * namespaces share the I/O queues, so each gets an equal share.
 	 * TODO: need to figure out a sane default, or use per-NS I/O queues,
 	 * or change blkdev to handle EAGAIN
 	 */
-	drive->d_qsize = nvme->n_ioq_count * nvme->n_io_queue_len
-	    / nvme->n_namespace_count;
+	drive->d_qcount = nvme->n_ioq_count;
+	drive->d_qsize = MAX(1,
+	    nvme->n_io_queue_len / nvme->n_namespace_count);
+
+	/*
+	 * A Dataset Management command takes up to 256 ranges of up to
+	 * 2^32 - 1 blocks, Write Zeroes a 16 bit block count.
+	 */
+	drive->d_free_maxblks = NVME_DSM_MAX_RANGES * (uint64_t)UINT32_MAX;
+	drive->d_zero_maxblks = 0x10000;
 
 	/*
 	 * d_maxxfer is not set, which means the value is taken from the DMA
@@ -2777,10 +2948,55 @@ nvme_bd_mediainfo(void *arg, bd_media_t *media)
 	return (0);
 }
 
+/*
+ * Spin on the completion queue until the given command has completed or
+ * the poll time has expired, completing commands as they are found.  Only
+ * one thread may poll a queue at a time; this also keeps us from polling
+ * again when a completion submits another command.
+ */
+static void
+nvme_poll_cq(nvme_t *nvme, nvme_qpair_t *qp, nvme_cmd_t *cmd)
+{
+	hrtime_t deadline;
+	nvme_cmd_t *done;
+
+	if (qp->nq_poller != NULL ||
+	    atomic_cas_ptr(&qp->nq_poller, NULL, curthread) != NULL)
+		return;
+
+	deadline = gethrtime() + nvme->n_poll_time * (NANOSEC / MICROSEC);
+
+	do {
+		done = NULL;
+		if (mutex_tryenter(&qp->nq_cq_mutex)) {
+			done = nvme_retrieve_cmd(nvme, qp);
+			mutex_exit(&qp->nq_cq_mutex);
+		}
+
+		if (done == NULL) {
+			SMT_PAUSE();
+			continue;
+		}
+
+		atomic_inc_64(&nvme->n_kstat.nk_poll_cmds.value.ui64);
+		done->nc_callback(done);
+
+		/*
+		 * The command has been freed by its callback; we only
+		 * compare the pointer.
+		 */
+		if (done == cmd)
+			break;
+	} while (gethrtime() < deadline);
+
+	qp->nq_poller = NULL;
+}
+
 static int
 nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 {
 	nvme_t *nvme = ns->ns_nvme;
+	nvme_qpair_t *qp;
 	nvme_cmd_t *cmd;
 
 	if (nvme->n_dead)
@@ -2794,13 +3010,19 @@ nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 	if (cmd == NULL)
 		return (ENOMEM);
 
-	cmd->nc_sqid = (CPU->cpu_id % nvme->n_ioq_count) + 1;
+	cmd->nc_sqid = xfer->x_qnum + 1;
 	ASSERT(cmd->nc_sqid <= nvme->n_ioq_count);
+	qp = nvme->n_ioq[cmd->nc_sqid];
 
-	if (nvme_submit_cmd(nvme->n_ioq[cmd->nc_sqid], cmd)
-	    != DDI_SUCCESS)
+	if (nvme_submit_cmd(qp, cmd) != DDI_SUCCESS)
 		return (EAGAIN);
 
+	atomic_inc_64(&nvme->n_kstat.nk_io_cmds.value.ui64);
+
+	if (nvme->n_poll_time != 0 &&
+	    (opc == NVME_OPC_NVM_READ || opc == NVME_OPC_NVM_WRITE))
+		nvme_poll_cq(nvme, qp, cmd);
+
 	return (0);
 }
 
@@ -2840,6 +3062,38 @@ nvme_bd_sync(void *arg, bd_xfer_t *xfer)
 	return (nvme_bd_cmd(ns, xfer, NVME_OPC_NVM_FLUSH));
 }
 
+static int
+nvme_bd_free(void *arg, bd_xfer_t *xfer)
+{
+	nvme_namespace_t *ns = arg;
+
+	if (ns->ns_nvme->n_dead)
+		return (EIO);
+
+	if (ns->ns_nvme->n_idctl->id_oncs.on_dset_mgmt == 0) {
+		bd_xfer_done(xfer, ENOTSUP);
+		return (0);
+	}
+
+	return (nvme_bd_cmd(ns, xfer, NVME_OPC_NVM_DSET_MGMT));
+}
+
+static int
+nvme_bd_zero(void *arg, bd_xfer_t *xfer)
+{
+	nvme_namespace_t *ns = arg;
+
+	if (ns->ns_nvme->n_dead)
+		return (EIO);
+
+	if (ns->ns_nvme->n_idctl->id_oncs.on_wr_zero == 0) {
+		bd_xfer_done(xfer, ENOTSUP);
+		return (0);
+	}
+
+	return (nvme_bd_cmd(ns, xfer, NVME_OPC_NVM_WRITE_ZERO));
+}
+
 static int
 nvme_bd_devid(void *arg, dev_info_t *devinfo, ddi_devid_t *devid)
 {
@@ -469,7 +469,8 @@ typedef struct {
 		uint16_t on_compare:1;	/* Compare */
 		uint16_t on_wr_unc:1;	/* Write Uncorrectable */
 		uint16_t on_dset_mgmt:1; /* Dataset Management */
-		uint16_t on_rsvd:13;
+		uint16_t on_wr_zero:1;	/* Write Zeroes */
+		uint16_t on_rsvd:12;
 	} id_oncs;
 	struct {			/* Fused Operation Support */
 		uint16_t f_cmp_wr:1;	/* Compare and Write */
@@ -563,6 +564,19 @@ typedef union {
 } nvme_abort_cmd_t;
 
 
+/*
+ * NVMe Dataset Management Command
+ */
+#define	NVME_DSM_MAX_RANGES	256	/* ranges per command */
+#define	NVME_DSM_ATTR_AD	0x4	/* Deallocate, in CDW11 */
+
+typedef struct {
+	uint32_t dr_cattr;		/* Context Attributes */
+	uint32_t dr_nlb;		/* Length in Logical Blocks */
+	uint64_t dr_slba;		/* Starting LBA */
+} nvme_dsm_range_t;
+
+
 /*
  * NVMe Get / Set Features
  */
@@ -618,6 +632,16 @@ typedef union {
 	uint32_t r;
 } nvme_nqueue_t;
 
+/* Interrupt Coalescing */
+typedef union {
+	struct {
+		uint8_t ic_thr;		/* Aggregation Threshold */
+		uint8_t ic_time;	/* Aggregation Time (100us units) */
+		uint16_t ic_rsvd;
+	} b;
+	uint32_t r;
+} nvme_intr_coal_t;
+
 
 /*
  * NVMe Get Log Page
@@ -20,6 +20,7 @@
 #include <sys/sunddi.h>
 #include <sys/blkdev.h>
 #include <sys/taskq_impl.h>
+#include <sys/kstat.h>
 
 /*
  * NVMe driver state
@@ -41,6 +42,7 @@
 #define	NVME_DEFAULT_IO_QUEUE_LEN	1024
 #define	NVME_DEFAULT_ASYNC_EVENT_LIMIT	10
 #define	NVME_MIN_ASYNC_EVENT_LIMIT	1
+#define	NVME_MAX_POLL_TIME		1000	/* microseconds */
 
 
 typedef struct nvme nvme_t;
@@ -49,6 +51,7 @@ typedef struct nvme_dma nvme_dma_t;
 typedef struct nvme_cmd nvme_cmd_t;
 typedef struct nvme_qpair nvme_qpair_t;
 typedef struct nvme_task_arg nvme_task_arg_t;
+typedef struct nvme_kstat nvme_kstat_t;
 
 struct nvme_dma {
 	ddi_dma_handle_t nd_dmah;
@@ -98,6 +101,15 @@ struct nvme_qpair {
 	int nq_phase;
 
 	kmutex_t nq_mutex;
+	kmutex_t nq_cq_mutex;
+	kthread_t *nq_poller;
+};
+
+struct nvme_kstat {
+	kstat_named_t nk_intrs;		/* interrupts claimed */
+	kstat_named_t nk_intr_cmds;	/* completions reaped by interrupt */
+	kstat_named_t nk_poll_cmds;	/* completions reaped by polling */
+	kstat_named_t nk_io_cmds;	/* I/O commands submitted */
 };
 
 struct nvme {
@@ -126,6 +138,9 @@ struct nvme {
 	uint32_t n_admin_queue_len;
 	uint32_t n_io_queue_len;
 	uint16_t n_async_event_limit;
+	uint8_t n_intr_coal_time;
+	uint8_t n_intr_coal_thr;
+	uint32_t n_poll_time;
 	uint16_t n_abort_command_limit;
 	uint64_t n_max_data_transfer_size;
 	boolean_t n_volatile_write_cache_enabled;
@@ -161,6 +176,9 @@ struct nvme {
 
 	ddi_taskq_t *n_cmd_taskq;
 
+	kstat_t *n_ksp;
+	nvme_kstat_t n_kstat;
+
 	nvme_error_log_entry_t *n_error_log;
 	nvme_health_log_t *n_health_log;
 	nvme_fwslot_log_t *n_fwslot_log;
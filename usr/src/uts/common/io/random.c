@@ -58,6 +58,8 @@
 
 #define	HASHSIZE		20	/* Assuming a SHA1 hash algorithm */
 #define	WRITEBUFSIZE		512	/* Size of buffer for write request */
+#define	READBUFSIZE		520	/* Size of buffer for reads */
+					/* Must divide MAXRETBYTES */
 #define	MAXRETBYTES		1040	/* Max bytes returned per read. */
 					/* Must be a multiple of HASHSIZE */
 static dev_info_t *rnd_dip;
@@ -230,7 +232,7 @@ rnd_read(dev_t dev, struct uio *uiop, cred_t *credp)
 	minor_t devno;
 	int error = 0;
 	int nbytes = 0;
-	uint8_t random_bytes[2 * HASHSIZE];
+	uint8_t random_bytes[READBUFSIZE];
 
 	devno = getminor(dev);
 
@@ -267,6 +269,7 @@ rnd_read(dev_t dev, struct uio *uiop, cred_t *credp)
 			break;
 		}
 	}
+	bzero(random_bytes, sizeof (random_bytes));
 	return (error);
 }
 
@@ -367,6 +367,8 @@ static size_t ahci_cmd_table_size;
  *
  *	ahci_dma_prdt_number
  *	ahci_msi_enabled
+ *	ahci_msix_enabled
+ *	ahci_multi_msg_enabled
  *	ahci_buf_64bit_dma
  *	ahci_commu_64bit_dma
  */
@@ -377,6 +379,12 @@ int ahci_dma_prdt_number = AHCI_PRDT_NUMBER;
 /* AHCI MSI is tunable */
 boolean_t ahci_msi_enabled = B_TRUE;
 
+/* AHCI MSI-X is tunable; few HBAs support it */
+boolean_t ahci_msix_enabled = B_TRUE;
+
+/* Using one MSI/MSI-X message per port, where granted, is tunable */
+boolean_t ahci_multi_msg_enabled = B_TRUE;
+
 /*
  * 64-bit dma addressing for data buffer is tunable
  *
@@ -837,9 +845,26 @@ ahci_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	    "ddi_intr_get_supported_types() returned: 0x%x",
 	    intr_types);
 
+	if (ahci_msix_enabled && (intr_types & DDI_INTR_TYPE_MSIX)) {
+		/*
+		 * Try MSI-X first, but fall back to MSI or FIXED if failed
+		 */
+		if (ahci_add_intrs(ahci_ctlp, DDI_INTR_TYPE_MSIX) ==
+		    DDI_SUCCESS) {
+			ahci_ctlp->ahcictl_intr_type = DDI_INTR_TYPE_MSIX;
+			AHCIDBG(AHCIDBG_INIT|AHCIDBG_INTR, ahci_ctlp,
+			    "Using MSI-X interrupt type", NULL);
+			goto intr_done;
+		}
+
+		AHCIDBG(AHCIDBG_INIT|AHCIDBG_INTR, ahci_ctlp,
+		    "MSI-X registration failed, "
+		    "trying MSI interrupts", NULL);
+	}
+
 	if (ahci_msi_enabled && (intr_types & DDI_INTR_TYPE_MSI)) {
 		/*
-		 * Try MSI first, but fall back to FIXED if failed
+		 * Try MSI next, but fall back to FIXED if failed
 		 */
 		if (ahci_add_intrs(ahci_ctlp, DDI_INTR_TYPE_MSI) ==
 		    DDI_SUCCESS) {
@@ -6662,18 +6687,30 @@ ahci_port_intr(ahci_ctl_t *ahci_ctlp, ahci_port_t *ahci_portp, uint8_t port)
 
 /*
  * Interrupt service handler
+ *
+ * arg2 is the index of the interrupt vector. With one vector per port
+ * (ahcictl_intr_per_port), vector n only serves port n, except for the last
+ * vector, which also serves all the ports above it; the ports are then
+ * handled in parallel on different CPUs. Otherwise every vector serves all
+ * the ports.
  */
 static uint_t
 ahci_intr(caddr_t arg1, caddr_t arg2)
 {
-#ifndef __lock_lint
-	_NOTE(ARGUNUSED(arg2))
-#endif
 	/* LINTED */
 	ahci_ctl_t *ahci_ctlp = (ahci_ctl_t *)arg1;
+	int vector = (int)(uintptr_t)arg2;
 	ahci_port_t *ahci_portp;
 	int32_t global_intr_status;
-	uint8_t port;
+	uint8_t port, first_port, last_port;
+
+	first_port = 0;
+	last_port = ahci_ctlp->ahcictl_num_ports - 1;
+	if (ahci_ctlp->ahcictl_intr_per_port) {
+		first_port = vector;
+		if (vector < ahci_ctlp->ahcictl_intr_cnt - 1)
+			last_port = vector;
+	}
 
 	/*
 	 * global_intr_status indicates that the corresponding port has
@@ -6682,7 +6719,10 @@ ahci_intr(caddr_t arg1, caddr_t arg2)
 	global_intr_status = ddi_get32(ahci_ctlp->ahcictl_ahci_acc_handle,
 	    (uint32_t *)AHCI_GLOBAL_IS(ahci_ctlp));
 
-	if (!(global_intr_status & ahci_ctlp->ahcictl_ports_implemented)) {
+	global_intr_status &= ahci_ctlp->ahcictl_ports_implemented &
+	    AHCI_PORT_RANGE_MASK(first_port, last_port);
+
+	if (global_intr_status == 0) {
 		/* The interrupt is not ours */
 		return (DDI_INTR_UNCLAIMED);
 	}
@@ -6700,8 +6740,8 @@ ahci_intr(caddr_t arg1, caddr_t arg2)
 		return (DDI_INTR_UNCLAIMED);
 	}
 
-	/* Loop for all the ports */
-	for (port = 0; port < ahci_ctlp->ahcictl_num_ports; port++) {
+	/* Loop for all the ports served by this vector */
+	for (port = first_port; port <= last_port; port++) {
 		if (!AHCI_PORT_IMPLEMENTED(ahci_ctlp, port)) {
 			continue;
 		}
@@ -8121,9 +8161,11 @@ ahci_disable_all_intrs(ahci_ctl_t *ahci_ctlp)
  * fewer than the requested number of messages is granted in order to determine
  * which port had the interrupt.
  *
- * Note: The current ahci driver only supports the first two interrupt modes:
- * pin based interrupts and single MSI message interrupts, and the reason
- * is indicated in below code.
+ * With multiple messages, we ask for one per port and, if GHC.MRSM shows that
+ * the HBA didn't revert to a single message, let each vector serve its own
+ * port (see ahci_intr()). This way the ports' completions are processed in
+ * parallel rather than by one handler walking all the ports. MSI-X, which
+ * some HBAs implement, is used the same way.
  */
 static int
 ahci_add_intrs(ahci_ctl_t *ahci_ctlp, int intr_type)
@@ -8162,18 +8204,20 @@ ahci_add_intrs(ahci_ctl_t *ahci_ctlp, int intr_type)
 #endif
 
 	/*
-	 * Note: So far Solaris restricts the maximum number of messages for
-	 * x86 to 2, that is avail is 2, so here we set the count with 1 to
-	 * force the driver to use single MSI message interrupt. In future if
-	 * Solaris remove the restriction, then we need to delete the below
-	 * code and try to use multiple interrupt routine to gain better
-	 * performance.
+	 * There's no use in more messages than ports. Multiple MSI messages
+	 * must be a power of 2, so round down to that.
 	 */
-	if ((intr_type == DDI_INTR_TYPE_MSI) && (count > 1)) {
-		AHCIDBG(AHCIDBG_INTR, ahci_ctlp,
-		    "force to use one interrupt routine though the "
-		    "HBA supports %d interrupt", count);
-		count = 1;
+	if (intr_type != DDI_INTR_TYPE_FIXED && count > 1) {
+		if (!ahci_multi_msg_enabled) {
+			AHCIDBG(AHCIDBG_INTR, ahci_ctlp,
+			    "force to use one interrupt routine though the "
+			    "HBA supports %d interrupt", count);
+			count = 1;
+		}
+		count = min(count, ahci_ctlp->ahcictl_num_ports);
+		count = min(count, avail);
+		if (intr_type == DDI_INTR_TYPE_MSI)
+			count = 1 << (ddi_fls(count) - 1);
 	}
 
 	/* Allocate an array of interrupt handles. */
@@ -8238,10 +8282,17 @@ ahci_add_intrs(ahci_ctl_t *ahci_ctlp, int intr_type)
 		return (DDI_FAILURE);
 	}
 
+	/*
+	 * Until we know the HBA is using one message per port, every vector
+	 * serves all the ports.
+	 */
+	ahci_ctlp->ahcictl_intr_per_port = B_FALSE;
+
 	/* Call ddi_intr_add_handler(). */
 	for (i = 0; i < actual; i++) {
 		if (ddi_intr_add_handler(ahci_ctlp->ahcictl_intr_htable[i],
-		    ahci_intr, (caddr_t)ahci_ctlp, NULL) != DDI_SUCCESS) {
+		    ahci_intr, (caddr_t)ahci_ctlp,
+		    (caddr_t)(uintptr_t)i) != DDI_SUCCESS) {
 			AHCIDBG(AHCIDBG_INTR|AHCIDBG_INIT, ahci_ctlp,
 			    "ddi_intr_add_handler() failed", NULL);
 
@@ -8285,6 +8336,26 @@ ahci_add_intrs(ahci_ctl_t *ahci_ctlp, int intr_type)
 		}
 	}
 
+	/*
+	 * With multiple MSI messages, GHC.MRSM set means the HBA reverted to
+	 * single message mode because we got fewer messages than it wanted,
+	 * and raises all its interrupts on the first. MSI-X vectors are
+	 * assigned one per port by the HBA's MSI-X table as programmed.
+	 */
+	if (actual > 1) {
+		uint32_t ghc_control;
+
+		ghc_control = ddi_get32(ahci_ctlp->ahcictl_ahci_acc_handle,
+		    (uint32_t *)AHCI_GLOBAL_GHC(ahci_ctlp));
+		if (intr_type == DDI_INTR_TYPE_MSIX ||
+		    !(ghc_control & AHCI_HBA_GHC_MRSM)) {
+			ahci_ctlp->ahcictl_intr_per_port = B_TRUE;
+			AHCIDBG(AHCIDBG_INIT|AHCIDBG_INTR, ahci_ctlp,
+			    "using %d interrupt vectors, one per port",
+			    actual);
+		}
+	}
+
 	return (DDI_SUCCESS);
 }
 
@@ -8303,7 +8374,8 @@ ahci_rem_intrs(ahci_ctl_t *ahci_ctlp)
 	AHCIDBG(AHCIDBG_ENTRY, ahci_ctlp, "ahci_rem_intrs entered", NULL);
 
 	/* Disable all interrupts. */
-	if ((ahci_ctlp->ahcictl_intr_type == DDI_INTR_TYPE_MSI) &&
+	if ((ahci_ctlp->ahcictl_intr_type == DDI_INTR_TYPE_MSI ||
+	    ahci_ctlp->ahcictl_intr_type == DDI_INTR_TYPE_MSIX) &&
 	    (ahci_ctlp->ahcictl_intr_cap & DDI_INTR_FLAG_BLOCK)) {
 		/* Call ddi_intr_block_disable(). */
 		(void) ddi_intr_block_disable(ahci_ctlp->ahcictl_intr_htable,
@@ -176,6 +176,9 @@ static	char *sd_config_list		= "sd-config-list";
 #define	sd_reset_throttle_timeout	ssd_reset_throttle_timeout
 #define	sd_qfull_throttle_timeout	ssd_qfull_throttle_timeout
 #define	sd_qfull_throttle_enable	ssd_qfull_throttle_enable
+#define	sd_lat_throttle_enable		ssd_lat_throttle_enable
+#define	sd_lat_target_ssd		ssd_lat_target_ssd
+#define	sd_lat_target_hdd		ssd_lat_target_hdd
 #define	sd_check_media_time		ssd_check_media_time
 #define	sd_wait_cmds_complete		ssd_wait_cmds_complete
 #define	sd_label_mutex			ssd_label_mutex
@@ -240,6 +243,15 @@ int sd_min_throttle			= SD_MIN_THROTTLE;
 int sd_rot_delay			= 4; /* Default 4ms Rotation delay */
 int sd_qfull_throttle_enable		= TRUE;
 
+/*
+ * Latency-targeted queue depth: default targets (microseconds) for solid
+ * state and rotating media; the "latency-target" property overrides them
+ * per LUN, and 0 disables the adaptation.
+ */
+int sd_lat_throttle_enable		= TRUE;
+int sd_lat_target_ssd			= SD_LAT_TARGET_SSD;
+int sd_lat_target_hdd			= SD_LAT_TARGET_HDD;
+
 int sd_retry_on_reservation_conflict	= 1;
 int sd_reinstate_resv_delay		= SD_REINSTATE_RESV_DELAY;
 _NOTE(SCHEME_PROTECTS_DATA("safe sharing", sd_reinstate_resv_delay))
@@ -994,6 +1006,7 @@ static int sd_pm_idletime = 1;
 #define	sd_mark_rqs_idle		ssd_mark_rqs_idle
 #define	sd_reduce_throttle		ssd_reduce_throttle
 #define	sd_restore_throttle		ssd_restore_throttle
+#define	sd_latency_throttle		ssd_latency_throttle
 #define	sd_print_incomplete_msg		ssd_print_incomplete_msg
 #define	sd_init_cdb_limits		ssd_init_cdb_limits
 #define	sd_pkt_status_good		ssd_pkt_status_good
@@ -1425,6 +1438,7 @@ static struct buf *sd_mark_rqs_idle(struct sd_lun *un, struct sd_xbuf *xp);
 
 static void sd_reduce_throttle(struct sd_lun *un, int throttle_type);
 static void sd_restore_throttle(void *arg);
+static void sd_latency_throttle(struct sd_lun *un, struct sd_xbuf *xp);
 
 static void sd_init_cdb_limits(struct sd_lun *un);
 
@@ -8208,6 +8222,24 @@ sd_unit_attach(dev_info_t *devi)
 	 */
 	sd_check_solid_state(ssc);
 
+	/*
+	 * Pick the latency target for the adaptive queue depth now that
+	 * we know what kind of media this is.
+	 */
+	if (sd_lat_throttle_enable && !ISCD(un)) {
+		int target = un->un_f_is_solid_state ?
+		    sd_lat_target_ssd : sd_lat_target_hdd;
+
+		target = ddi_prop_get_int(DDI_DEV_T_ANY, devi,
+		    DDI_PROP_DONTPASS, "latency-target", target);
+		mutex_enter(SD_MUTEX(un));
+		un->un_lat_target = (target > 0) ?
+		    (hrtime_t)target * (NANOSEC / MICROSEC) : 0;
+		mutex_exit(SD_MUTEX(un));
+		SD_INFO(SD_LOG_ATTACH_DETACH, un, "sd_unit_attach: "
+		    "un:0x%p latency target %d usec\n", un, target);
+	}
+
 	/*
 	 * Check whether the drive is in emulation mode.
 	 */
@@ -9115,6 +9147,10 @@ sd_create_errstats(struct sd_lun *un, int instance)
 	    KSTAT_DATA_UINT32);
 	kstat_named_init(&stp->sd_rq_pfa_err,	"Predictive Failure Analysis",
 	    KSTAT_DATA_UINT32);
+	kstat_named_init(&stp->sd_qdepth,	"Queue Depth",
+	    KSTAT_DATA_UINT32);
+	kstat_named_init(&stp->sd_latency,	"Latency (usec)",
+	    KSTAT_DATA_UINT64);
 
 	un->un_errstats->ks_private = un;
 	un->un_errstats->ks_update  = nulldev;
@@ -14884,7 +14920,7 @@ sd_start_cmds(struct sd_lun *un, struct buf *immed_bp)
 			 * For all of these conditions, IO processing will
 			 * restart after the condition is cleared.
 			 */
-			if (un->un_ncmds_in_transport >= un->un_throttle) {
+			if (un->un_ncmds_in_transport >= SD_THROTTLE(un)) {
 				SD_TRACE(SD_LOG_IO_CORE | SD_LOG_ERROR, un,
 				    "sd_start_cmds: exiting, "
 				    "throttle limit reached!\n");
@@ -15171,6 +15207,9 @@ got_pkt:
 		}
 
 		un->un_ncmds_in_transport++;
+		if (un->un_ncmds_in_transport > un->un_lat_peak)
+			un->un_lat_peak = un->un_ncmds_in_transport;
+		xp->xb_start = gethrtime();
 		SD_UPDATE_KSTATS(un, statp, bp);
 
 		/*
@@ -15923,7 +15962,7 @@ sd_retry_command(struct sd_lun *un, struct buf *bp, int retry_check_flag,
 		 * do the immediate retry.  If we cannot, then we must
 		 * fall back to queueing up a delayed retry.
 		 */
-		if (un->un_ncmds_in_transport >= un->un_throttle) {
+		if (un->un_ncmds_in_transport >= SD_THROTTLE(un)) {
 			/*
 			 * We are at the throttle limit for the target,
 			 * fall back to delayed retry.
@@ -16764,6 +16803,85 @@ sd_restore_throttle(void *arg)
 	SD_TRACE(SD_LOG_IO | SD_LOG_ERROR, un, "sd_restore_throttle: exit\n");
 }
 
+
+/*
+ *    Function: sd_latency_throttle
+ *
+ * Description: Accounts the latency of a command that has just completed
+ *		and, once per SD_LAT_WINDOW, adjusts the latency-derived cap
+ *		on the number of commands in transport (un_lat_throttle):
+ *		when the mean latency over the window exceeds the LUN's
+ *		target the cap is cut by a quarter, and when it is under the
+ *		target and the cap was actually reached it is raised by one,
+ *		until it is lifted altogether at un_saved_throttle.  This
+ *		keeps one LUN from flooding the HBA with commands the device
+ *		can only queue, while QFULL/BUSY handling in
+ *		sd_reduce_throttle() and sd_restore_throttle() still governs
+ *		un_throttle itself.  The window's queue depth and mean
+ *		latency are exported in the error kstats.
+ *
+ *   Arguments: un - ptr to the sd_lun softstate struct
+ *		xp - ptr to the sd_xbuf of the completed command
+ *
+ *     Context: May be called from interrupt context
+ */
+
+static void
+sd_latency_throttle(struct sd_lun *un, struct sd_xbuf *xp)
+{
+	struct sd_errstats	*stp;
+	hrtime_t		now = gethrtime();
+	short			cap;
+
+	ASSERT(un != NULL);
+	ASSERT(xp != NULL);
+	ASSERT(mutex_owned(SD_MUTEX(un)));
+
+	un->un_lat_sum += now - xp->xb_start;
+	un->un_lat_count++;
+
+	if ((now - un->un_lat_window < SD_LAT_WINDOW) ||
+	    (un->un_lat_count < SD_LAT_MIN_SAMPLES)) {
+		return;
+	}
+
+	un->un_lat_mean = un->un_lat_sum / un->un_lat_count;
+
+	/*
+	 * Leave the cap alone while a QFULL/BUSY reduction is being
+	 * ramped back up; those latencies say nothing about the queue
+	 * depth the LUN can sustain.
+	 */
+	if ((un->un_lat_target != 0) && (un->un_reset_throttle_timeid == NULL)) {
+		cap = (un->un_lat_throttle != 0) ?
+		    un->un_lat_throttle : un->un_saved_throttle;
+		if (un->un_lat_mean > un->un_lat_target) {
+			cap = min(cap, un->un_lat_peak);
+			cap -= max(cap / 4, 1);
+			un->un_lat_throttle = max(cap, un->un_min_throttle);
+		} else if ((un->un_lat_throttle != 0) &&
+		    (un->un_lat_peak >= un->un_lat_throttle)) {
+			un->un_lat_throttle =
+			    (cap + 1 < un->un_saved_throttle) ? cap + 1 : 0;
+		}
+		SD_TRACE(SD_LOG_IO_CORE, un, "sd_latency_throttle: "
+		    "mean latency %lld ns, un_lat_throttle:%d\n",
+		    un->un_lat_mean, un->un_lat_throttle);
+	}
+
+	if (un->un_errstats != NULL) {
+		stp = (struct sd_errstats *)un->un_errstats->ks_data;
+		stp->sd_qdepth.value.ui32 = SD_THROTTLE(un);
+		stp->sd_latency.value.ui64 =
+		    un->un_lat_mean / (NANOSEC / MICROSEC);
+	}
+
+	un->un_lat_window = now;
+	un->un_lat_sum = 0;
+	un->un_lat_count = 0;
+	un->un_lat_peak = un->un_ncmds_in_transport;
+}
+
 /*
  *    Function: sdrunout
  *
@@ -16862,6 +16980,8 @@ sdintr(struct scsi_pkt *pktp)
 	un->un_ncmds_in_transport--;
 	ASSERT(un->un_ncmds_in_transport >= 0);
 
+	sd_latency_throttle(un, xp);
+
 	/* Increment counter to indicate that the callback routine is active */
 	un->un_in_callback++;
 
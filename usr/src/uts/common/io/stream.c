@@ -166,6 +166,7 @@ static struct kmem_cache *fthdr_cache;
 static struct kmem_cache *ftblk_cache;
 
 static void dblk_lastfree(mblk_t *mp, dblk_t *dbp);
+static void dblk_lastfree_reset(mblk_t *mp, dblk_t *dbp);
 static mblk_t *allocb_oversize(size_t size, int flags);
 static int allocb_tryhard_fails;
 static void frnop_func(void *arg);
@@ -447,6 +448,70 @@ out:
 	return (mp);
 }
 
+/*
+ * Number of dblks allocb_chain() and freemsgchain_bulk() move to or from
+ * the kmem magazine layer at a time.
+ */
+#define	DBLK_BATCH	32
+
+/*
+ * Allocate up to cnt mblks of the given size, linked through b_next, for
+ * drivers that refill a ring of buffers at once.  The dblks are taken
+ * from the kmem cache in batches rather than one allocb() at a time.
+ * Returns the number allocated, which is less than cnt only if memory is
+ * short; *chainp is set to the chain, or NULL if there is none.
+ */
+/*ARGSUSED*/
+size_t
+allocb_chain(size_t size, uint_t pri, size_t cnt, mblk_t **chainp)
+{
+	void *bufs[DBLK_BATCH];
+	mblk_t *mp, **mpp = chainp;
+	dblk_t *dbp;
+	size_t index, n = 0, want, got, i;
+
+	*chainp = NULL;
+	index = (size - 1) >> DBLK_SIZE_SHIFT;
+
+	if (index >= (DBLK_MAX_CACHE >> DBLK_SIZE_SHIFT)) {
+		if (size != 0) {
+			for (; n < cnt; n++) {
+				if ((mp = allocb_oversize(size,
+				    KM_NOSLEEP)) == NULL)
+					break;
+				*mpp = mp;
+				mpp = &mp->b_next;
+			}
+			return (n);
+		}
+		index = 0;
+	}
+
+	while (n < cnt) {
+		want = MIN(cnt - n, DBLK_BATCH);
+		got = kmem_cache_alloc_batch(dblk_cache[index], bufs, want,
+		    KM_NOSLEEP);
+		for (i = 0; i < got; i++) {
+			dbp = bufs[i];
+			mp = dbp->db_mblk;
+			DBLK_RTFU_WORD(dbp) = DBLK_RTFU(1, M_DATA, 0, 0);
+			mp->b_next = mp->b_prev = mp->b_cont = NULL;
+			mp->b_rptr = mp->b_wptr = dbp->db_base;
+			mp->b_queue = NULL;
+			MBLK_BAND_FLAG_WORD(mp) = 0;
+			STR_FTALLOC(&dbp->db_fthdr, FTEV_ALLOCB, size);
+			*mpp = mp;
+			mpp = &mp->b_next;
+		}
+		n += got;
+		if (got < want)
+			break;
+	}
+	FTRACE_2("allocb_chain(): cnt=%ld n=%ld", cnt, n);
+
+	return (n);
+}
+
 /*
  * Allocate an mblk taking db_credp and db_cpid from the template.
  * Allow the cred to be NULL.
@@ -667,6 +732,56 @@ freemsg(mblk_t *mp)
 	}
 }
 
+/*
+ * Free a chain of messages linked through b_next, as freemsgchain() does,
+ * for drivers and mac freeing a batch of transmitted or dropped packets.
+ * Ordinary dblks that are on their last reference are collected and
+ * returned to their kmem cache in batches; everything else (shared,
+ * esballoc'd and bcache dblks) is freed through its db_free routine.
+ */
+void
+freemsgchain_bulk(mblk_t *mp)
+{
+	void *bufs[DBLK_BATCH];
+	kmem_cache_t *cp = NULL;
+	size_t n = 0;
+
+	FTRACE_1("freemsgchain_bulk(): mp=0x%lx", (uintptr_t)mp);
+	while (mp != NULL) {
+		mblk_t *next = mp->b_next;
+
+		mp->b_next = NULL;
+		while (mp != NULL) {
+			dblk_t *dbp = mp->b_datap;
+			mblk_t *mp_cont = mp->b_cont;
+
+			ASSERT(dbp->db_ref > 0);
+			ASSERT(mp->b_next == NULL && mp->b_prev == NULL);
+
+			STR_FTEVENT_MBLK(mp, caller(), FTEV_FREEB, dbp->db_ref);
+
+			if (dbp->db_free != dblk_lastfree) {
+				dbp->db_free(mp, dbp);
+				mp = mp_cont;
+				continue;
+			}
+
+			dblk_lastfree_reset(mp, dbp);
+			if (dbp->db_cache != cp || n == DBLK_BATCH) {
+				if (n != 0)
+					kmem_cache_free_batch(cp, bufs, n);
+				cp = dbp->db_cache;
+				n = 0;
+			}
+			bufs[n++] = dbp;
+			mp = mp_cont;
+		}
+		mp = next;
+	}
+	if (n != 0)
+		kmem_cache_free_batch(cp, bufs, n);
+}
+
 /*
  * Reallocate a block for another use.  Try hard to use the old block.
  * If the old data is wanted (copy), leave b_wptr at the end of the data,
@@ -717,8 +832,11 @@ reallocb(mblk_t *mp, size_t size, uint_t copy)
 	return (mp1);
 }
 
+/*
+ * Return a dblk on its last reference to the state its kmem cache expects.
+ */
 static void
-dblk_lastfree(mblk_t *mp, dblk_t *dbp)
+dblk_lastfree_reset(mblk_t *mp, dblk_t *dbp)
 {
 	ASSERT(dbp->db_mblk == mp);
 	if (dbp->db_fthdr != NULL)
@@ -737,7 +855,12 @@ dblk_lastfree(mblk_t *mp, dblk_t *dbp)
 
 	/* and the COOKED and/or UIOA flag(s) */
 	dbp->db_flags &= ~(DBLK_COOKED | DBLK_UIOA);
+}
 
+static void
+dblk_lastfree(mblk_t *mp, dblk_t *dbp)
+{
+	dblk_lastfree_reset(mp, dbp);
 	kmem_cache_free(dbp->db_cache, dbp);
 }
 
@@ -569,6 +569,20 @@ typedef struct so_ux_addr soux_addr_t;
 #define	TL_MAXQLEN	4096
 int tl_maxqlen = TL_MAXQLEN;
 
+/*
+ * Flow control limits for the stream head read queue of AF_UNIX sockets,
+ * which is where a socket's received data waits for the reader.  The
+ * stream head defaults (STRHIGH and STRLOW) let only a few kilobytes
+ * through before the sender is flow controlled, so that a bulk transfer
+ * would ping-pong between the two processes, with a back-enable and a
+ * service procedure run for every message.  setsockopt(SO_RCVBUF) changes
+ * the high water mark of a socket.
+ */
+#define	TL_SOCK_HIWAT	(128 * 1024)
+#define	TL_SOCK_LOWAT	(32 * 1024)
+int tl_sock_hiwat = TL_SOCK_HIWAT;
+int tl_sock_lowat = TL_SOCK_LOWAT;
+
 /*
  *	transport endpoint structure
  */
@@ -1421,6 +1435,8 @@ tl_open(queue_t	*rq, dev_t *devp, int oflag, int sflag,	cred_t	*credp)
 {
 	tl_endpt_t *tep;
 	minor_t	    minor = getminor(*devp);
+	mblk_t	    *mp;
+	struct stroptions *sop;
 
 	/*
 	 * Driver is called directly. Both CLONEOPEN and MODOPEN
@@ -1512,6 +1528,21 @@ tl_open(queue_t	*rq, dev_t *devp, int oflag, int sflag,	cred_t	*credp)
 
 	qprocson(rq);
 
+	/*
+	 * Size the socket's receive buffer (see tl_sock_hiwat).  This is only
+	 * a performance matter, so go on without it if there's no memory.
+	 */
+	if (IS_SOCKET(tep) &&
+	    (mp = allocb(sizeof (struct stroptions), BPRI_MED)) != NULL) {
+		DB_TYPE(mp) = M_SETOPTS;
+		mp->b_wptr += sizeof (struct stroptions);
+		sop = (struct stroptions *)mp->b_rptr;
+		sop->so_flags = SO_HIWAT | SO_LOWAT;
+		sop->so_hiwat = tl_sock_hiwat;
+		sop->so_lowat = tl_sock_lowat;
+		putnext(rq, mp);
+	}
+
 	/*
 	 * Insert acceptor ID in the hash. The AI hash always sleeps on
 	 * insertion so insertion can't fail.
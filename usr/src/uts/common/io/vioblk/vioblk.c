@@ -42,6 +42,8 @@
 #include <sys/debug.h>
 #include <sys/pci.h>
 #include <sys/sysmacros.h>
+#include <sys/atomic.h>
+#include <sys/cpuvar.h>
 #include "virtiovar.h"
 #include "virtioreg.h"
 
@@ -55,6 +57,7 @@
 #define	VIRTIO_BLK_F_SCSI	(1<<7)
 #define	VIRTIO_BLK_F_FLUSH	(1<<9)
 #define	VIRTIO_BLK_F_TOPOLOGY	(1<<10)
+#define	VIRTIO_BLK_F_MQ		(1<<12)
 
 /* Configuration registers */
 #define	VIRTIO_BLK_CONFIG_CAPACITY	0 /* 64bit */
@@ -68,6 +71,8 @@
 #define	VIRTIO_BLK_CONFIG_TOPO_ALIGN	25 /* 8bit */
 #define	VIRTIO_BLK_CONFIG_TOPO_MIN_SZ	26 /* 16bit */
 #define	VIRTIO_BLK_CONFIG_TOPO_OPT_SZ	28 /* 32bit */
+#define	VIRTIO_BLK_CONFIG_WRITEBACK	32 /* 8bit */
+#define	VIRTIO_BLK_CONFIG_NUM_QUEUES	34 /* 16bit */
 
 /* Command */
 #define	VIRTIO_BLK_T_IN			0
@@ -96,6 +101,13 @@
  */
 static char vioblk_ident[] = "VirtIO block driver";
 
+/*
+ * Upper bound on the number of request queues used with VIRTIO_BLK_F_MQ.
+ * We never use more than one per CPU, nor more than there are MSI-X vectors
+ * to give each its own.
+ */
+uint_t vioblk_max_queues = 16;
+
 /* Request header structure */
 struct vioblk_req_hdr {
 	uint32_t		type;   /* VIRTIO_BLK_T_* */
@@ -114,6 +126,13 @@ struct vioblk_req {
 	bd_xfer_t		*xfer;
 };
 
+/* One per request virtqueue. */
+struct vioblk_queue {
+	struct vioblk_softc	*q_sc;
+	struct virtqueue	*q_vq;
+	struct vioblk_req	*q_reqs;
+};
+
 struct vioblk_stats {
 	struct kstat_named	sts_rw_outofmemory;
 	struct kstat_named	sts_rw_badoffset;
@@ -140,9 +159,9 @@ struct vioblk_lstats {
 struct vioblk_softc {
 	dev_info_t		*sc_dev; /* mirrors virtio_softc->sc_dev */
 	struct virtio_softc	sc_virtio;
-	struct virtqueue	*sc_vq;
+	struct vioblk_queue	*sc_queues;
+	int			sc_nqueues;
 	bd_handle_t		bd_h;
-	struct vioblk_req	*sc_reqs;
 	struct vioblk_stats	*ks_data;
 	kstat_t			*sc_intrstat;
 	uint64_t		sc_capacity;
@@ -261,6 +280,7 @@ static int
 vioblk_rw(struct vioblk_softc *sc, bd_xfer_t *xfer, int type,
     uint32_t len)
 {
+	struct vioblk_queue *q = &sc->sc_queues[xfer->x_qnum % sc->sc_nqueues];
 	struct vioblk_req *req;
 	struct vq_entry *ve_hdr;
 	int total_cookies, write;
@@ -275,14 +295,14 @@ vioblk_rw(struct vioblk_softc *sc, bd_xfer_t *xfer, int type,
 	}
 
 	/* allocate top entry */
-	ve_hdr = vq_alloc_entry(sc->sc_vq);
+	ve_hdr = vq_alloc_entry(q->q_vq);
 	if (!ve_hdr) {
 		sc->ks_data->sts_rw_outofmemory.value.ui64++;
 		return (ENOMEM);
 	}
 
 	/* getting request */
-	req = &sc->sc_reqs[ve_hdr->qe_index];
+	req = &q->q_reqs[ve_hdr->qe_index];
 	req->hdr.type = type;
 	req->hdr.ioprio = 0;
 	req->hdr.sector = xfer->x_blkno;
@@ -313,6 +333,20 @@ vioblk_rw(struct vioblk_softc *sc, bd_xfer_t *xfer, int type,
 	return (DDI_SUCCESS);
 }
 
+static void
+vioblk_stop_intrs(struct vioblk_softc *sc)
+{
+	for (int i = 0; i < sc->sc_nqueues; i++)
+		virtio_stop_vq_intr(sc->sc_queues[i].q_vq);
+}
+
+static void
+vioblk_start_intrs(struct vioblk_softc *sc)
+{
+	for (int i = 0; i < sc->sc_nqueues; i++)
+		virtio_start_vq_intr(sc->sc_queues[i].q_vq);
+}
+
 /*
  * Now in polling mode. Interrupts are off, so we
  * 1) poll for the already queued requests to complete.
@@ -323,6 +357,7 @@ static int
 vioblk_rw_poll(struct vioblk_softc *sc, bd_xfer_t *xfer,
     int type, uint32_t len)
 {
+	struct vioblk_queue *q = &sc->sc_queues[xfer->x_qnum % sc->sc_nqueues];
 	clock_t tmout;
 	int ret;
 
@@ -332,9 +367,9 @@ vioblk_rw_poll(struct vioblk_softc *sc, bd_xfer_t *xfer,
 	tmout = drv_usectohz(30000000);
 
 	/* Poll for an empty queue */
-	while (vq_num_used(sc->sc_vq)) {
+	while (vq_num_used(q->q_vq)) {
 		/* Check if any pending requests completed. */
-		ret = vioblk_int_handler((caddr_t)&sc->sc_virtio, NULL);
+		ret = vioblk_int_handler((caddr_t)&sc->sc_virtio, (caddr_t)q);
 		if (ret != DDI_INTR_CLAIMED) {
 			drv_usecwait(10);
 			tmout -= 10;
@@ -348,9 +383,9 @@ vioblk_rw_poll(struct vioblk_softc *sc, bd_xfer_t *xfer,
 
 	tmout = drv_usectohz(30000000);
 	/* Poll for an empty queue again. */
-	while (vq_num_used(sc->sc_vq)) {
+	while (vq_num_used(q->q_vq)) {
 		/* Check if any pending requests completed. */
-		ret = vioblk_int_handler((caddr_t)&sc->sc_virtio, NULL);
+		ret = vioblk_int_handler((caddr_t)&sc->sc_virtio, (caddr_t)q);
 		if (ret != DDI_INTR_CLAIMED) {
 			drv_usecwait(10);
 			tmout -= 10;
@@ -369,7 +404,7 @@ vioblk_read(void *arg, bd_xfer_t *xfer)
 
 	if (xfer->x_flags & BD_XFER_POLL) {
 		if (!sc->sc_in_poll_mode) {
-			virtio_stop_vq_intr(sc->sc_vq);
+			vioblk_stop_intrs(sc);
 			sc->sc_in_poll_mode = 1;
 		}
 
@@ -377,7 +412,7 @@ vioblk_read(void *arg, bd_xfer_t *xfer)
 		    xfer->x_nblks * DEV_BSIZE);
 	} else {
 		if (sc->sc_in_poll_mode) {
-			virtio_start_vq_intr(sc->sc_vq);
+			vioblk_start_intrs(sc);
 			sc->sc_in_poll_mode = 0;
 		}
 
@@ -396,7 +431,7 @@ vioblk_write(void *arg, bd_xfer_t *xfer)
 
 	if (xfer->x_flags & BD_XFER_POLL) {
 		if (!sc->sc_in_poll_mode) {
-			virtio_stop_vq_intr(sc->sc_vq);
+			vioblk_stop_intrs(sc);
 			sc->sc_in_poll_mode = 1;
 		}
 
@@ -404,7 +439,7 @@ vioblk_write(void *arg, bd_xfer_t *xfer)
 		    xfer->x_nblks * DEV_BSIZE);
 	} else {
 		if (sc->sc_in_poll_mode) {
-			virtio_start_vq_intr(sc->sc_vq);
+			vioblk_start_intrs(sc);
 			sc->sc_in_poll_mode = 0;
 		}
 
@@ -437,7 +472,8 @@ vioblk_driveinfo(void *arg, bd_drive_t *drive)
 {
 	struct vioblk_softc *sc = (void *)arg;
 
-	drive->d_qsize = sc->sc_vq->vq_num;
+	drive->d_qsize = sc->sc_queues[0].q_vq->vq_num;
+	drive->d_qcount = sc->sc_nqueues;
 	drive->d_removable = B_FALSE;
 	drive->d_hotpluggable = B_TRUE;
 	drive->d_target = 0;
@@ -599,6 +635,9 @@ vioblk_show_features(struct vioblk_softc *sc, const char *prefix,
 	if (features & VIRTIO_BLK_F_TOPOLOGY)
 		/* LINTED E_PTRDIFF_OVERFLOW */
 		bufp += snprintf(bufp, bufend - bufp, "TOPOLOGY ");
+	if (features & VIRTIO_BLK_F_MQ)
+		/* LINTED E_PTRDIFF_OVERFLOW */
+		bufp += snprintf(bufp, bufend - bufp, "MQ ");
 
 	/* LINTED E_PTRDIFF_OVERFLOW */
 	bufp += snprintf(bufp, bufend - bufp, ")");
@@ -620,7 +659,9 @@ vioblk_dev_features(struct vioblk_softc *sc)
 	    VIRTIO_BLK_F_TOPOLOGY |
 	    VIRTIO_BLK_F_SEG_MAX |
 	    VIRTIO_BLK_F_SIZE_MAX |
-	    VIRTIO_F_RING_INDIRECT_DESC);
+	    VIRTIO_BLK_F_MQ |
+	    VIRTIO_F_RING_INDIRECT_DESC |
+	    VIRTIO_F_RING_EVENT_IDX);
 
 	vioblk_show_features(sc, "Host features: ", host_features);
 	vioblk_show_features(sc, "Negotiated features: ",
@@ -639,15 +680,14 @@ vioblk_dev_features(struct vioblk_softc *sc)
 uint_t
 vioblk_int_handler(caddr_t arg1, caddr_t arg2)
 {
-	struct virtio_softc *vsc = (void *)arg1;
-	struct vioblk_softc *sc = container_of(vsc,
-	    struct vioblk_softc, sc_virtio);
+	struct vioblk_queue *q = (void *)arg2;
+	struct vioblk_softc *sc = q->q_sc;
 	struct vq_entry *ve;
 	uint32_t len;
 	int i = 0, error;
 
-	while ((ve = virtio_pull_chain(sc->sc_vq, &len))) {
-		struct vioblk_req *req = &sc->sc_reqs[ve->qe_index];
+	while ((ve = virtio_pull_chain(q->q_vq, &len))) {
+		struct vioblk_req *req = &q->q_reqs[ve->qe_index];
 		bd_xfer_t *xfer = req->xfer;
 		uint8_t status = req->status;
 		uint32_t type = req->hdr.type;
@@ -670,14 +710,14 @@ vioblk_int_handler(caddr_t arg1, caddr_t arg2)
 				break;
 			case VIRTIO_BLK_S_IOERR:
 				error = EIO;
-				sc->sc_stats.io_errors++;
+				atomic_inc_uint(&sc->sc_stats.io_errors);
 				break;
 			case VIRTIO_BLK_S_UNSUPP:
-				sc->sc_stats.unsupp_errors++;
+				atomic_inc_uint(&sc->sc_stats.unsupp_errors);
 				error = ENOTTY;
 				break;
 			default:
-				sc->sc_stats.nxio_errors++;
+				atomic_inc_uint(&sc->sc_stats.nxio_errors);
 				error = ENXIO;
 				break;
 		}
@@ -693,10 +733,13 @@ vioblk_int_handler(caddr_t arg1, caddr_t arg2)
 		i++;
 	}
 
-	/* update stats */
+	/*
+	 * Update stats. The queues complete independently, so the maximum
+	 * is only approximate.
+	 */
 	if (sc->sc_stats.intr_queuemax < i)
 		sc->sc_stats.intr_queuemax = i;
-	sc->sc_stats.intr_total++;
+	atomic_inc_64(&sc->sc_stats.intr_total);
 
 	return (DDI_INTR_CLAIMED);
 }
@@ -711,32 +754,65 @@ vioblk_config_handler(caddr_t arg1, caddr_t arg2)
 static int
 vioblk_register_ints(struct vioblk_softc *sc)
 {
-	int ret;
+	struct virtio_int_handler *vioblk_vq_h;
+	size_t sz = sizeof (struct virtio_int_handler) * (sc->sc_nqueues + 1);
+	int i, ret;
 
 	struct virtio_int_handler vioblk_conf_h = {
 		vioblk_config_handler
 	};
 
-	struct virtio_int_handler vioblk_vq_h[] = {
-		{ vioblk_int_handler },
-		{ NULL },
-	};
+	/* One handler per request queue, in virtqueue order. */
+	vioblk_vq_h = kmem_zalloc(sz, KM_SLEEP);
+	for (i = 0; i < sc->sc_nqueues; i++) {
+		vioblk_vq_h[i].vh_func = vioblk_int_handler;
+		vioblk_vq_h[i].vh_priv = (void *)&sc->sc_queues[i];
+	}
 
 	ret = virtio_register_ints(&sc->sc_virtio,
 	    &vioblk_conf_h, vioblk_vq_h);
+	kmem_free(vioblk_vq_h, sz);
 
 	return (ret);
 }
 
+/*
+ * Pick the number of request queues. More than one needs an MSI-X vector
+ * for each of them plus the config change handler.
+ */
+static int
+vioblk_nqueues(struct vioblk_softc *sc)
+{
+	int types, nintrs, n;
+
+	if (!(sc->sc_virtio.sc_features & VIRTIO_BLK_F_MQ))
+		return (1);
+
+	if (ddi_intr_get_supported_types(sc->sc_dev, &types) != DDI_SUCCESS ||
+	    !(types & DDI_INTR_TYPE_MSIX) ||
+	    ddi_intr_get_nintrs(sc->sc_dev, DDI_INTR_TYPE_MSIX,
+	    &nintrs) != DDI_SUCCESS)
+		return (1);
+
+	n = virtio_read_device_config_2(&sc->sc_virtio,
+	    VIRTIO_BLK_CONFIG_NUM_QUEUES);
+	n = MIN(n, ncpus);
+	n = MIN(n, vioblk_max_queues);
+	n = MIN(n, nintrs - 1);
+
+	return (MAX(n, 1));
+}
+
 static void
-vioblk_free_reqs(struct vioblk_softc *sc)
+vioblk_free_reqs(struct vioblk_queue *q)
 {
+	struct vioblk_softc *sc = q->q_sc;
 	int i, qsize;
 
-	qsize = sc->sc_vq->vq_num;
+	qsize = q->q_vq->vq_num;
 
 	for (i = 0; i < qsize; i++) {
-		struct vioblk_req *req = &sc->sc_reqs[i];
+		struct vioblk_req *req = &q->q_reqs[i];
 
 		if (req->ndmac)
 			(void) ddi_dma_unbind_handle(req->dmah);
@@ -745,21 +821,23 @@ vioblk_free_reqs(struct vioblk_softc *sc)
 			ddi_dma_free_handle(&req->dmah);
 	}
 
-	kmem_free(sc->sc_reqs, sizeof (struct vioblk_req) * qsize);
+	kmem_free(q->q_reqs, sizeof (struct vioblk_req) * qsize);
+	q->q_reqs = NULL;
 }
 
 static int
-vioblk_alloc_reqs(struct vioblk_softc *sc)
+vioblk_alloc_reqs(struct vioblk_queue *q)
 {
+	struct vioblk_softc *sc = q->q_sc;
 	int i, qsize;
 	int ret;
 
-	qsize = sc->sc_vq->vq_num;
+	qsize = q->q_vq->vq_num;
 
-	sc->sc_reqs = kmem_zalloc(sizeof (struct vioblk_req) * qsize, KM_SLEEP);
+	q->q_reqs = kmem_zalloc(sizeof (struct vioblk_req) * qsize, KM_SLEEP);
 
 	for (i = 0; i < qsize; i++) {
-		struct vioblk_req *req = &sc->sc_reqs[i];
+		struct vioblk_req *req = &q->q_reqs[i];
 
 		ret = ddi_dma_alloc_handle(sc->sc_dev, &vioblk_req_dma_attr,
 		    DDI_DMA_SLEEP, NULL, &req->dmah);
@@ -786,7 +864,7 @@ vioblk_alloc_reqs(struct vioblk_softc *sc)
 	return (0);
 
 exit:
-	vioblk_free_reqs(sc);
+	vioblk_free_reqs(q);
 	return (ENOMEM);
 }
 
@@ -819,6 +897,7 @@ vioblk_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	struct vioblk_softc *sc;
 	struct virtio_softc *vsc;
 	struct vioblk_stats *ks_data;
+	int i;
 
 	instance = ddi_get_instance(devinfo);
 
@@ -900,15 +979,28 @@ vioblk_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	virtio_set_status(&sc->sc_virtio, VIRTIO_CONFIG_DEVICE_STATUS_ACK);
 	virtio_set_status(&sc->sc_virtio, VIRTIO_CONFIG_DEVICE_STATUS_DRIVER);
 
+	ret = vioblk_dev_features(sc);
+	if (ret)
+		goto exit_features;
+
+	/*
+	 * The number of queues decides how many interrupts we ask for, so
+	 * read it before registering them, from where the device config
+	 * lives until MSI-X is enabled.
+	 */
+	vsc->sc_config_offset = VIRTIO_CONFIG_DEVICE_CONFIG_NOMSIX;
+	sc->sc_nqueues = vioblk_nqueues(sc);
+	vsc->sc_nvqs = sc->sc_nqueues;
+	sc->sc_queues = kmem_zalloc(sizeof (struct vioblk_queue) *
+	    sc->sc_nqueues, KM_SLEEP);
+	for (i = 0; i < sc->sc_nqueues; i++)
+		sc->sc_queues[i].q_sc = sc;
+
 	if (vioblk_register_ints(sc)) {
 		dev_err(devinfo, CE_WARN, "Unable to add interrupt");
 		goto exit_int;
 	}
 
-	ret = vioblk_dev_features(sc);
-	if (ret)
-		goto exit_features;
-
 	if (sc->sc_virtio.sc_features & VIRTIO_BLK_F_RO)
 		sc->sc_readonly = B_TRUE;
 	else
@@ -975,15 +1067,19 @@ vioblk_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	    vioblk_bd_dma_attr.dma_attr_maxxfer);
 
 
-	sc->sc_vq = virtio_alloc_vq(&sc->sc_virtio, 0, 0,
-	    sc->sc_seg_max, "I/O request");
-	if (sc->sc_vq == NULL) {
-		goto exit_alloc1;
-	}
+	for (i = 0; i < sc->sc_nqueues; i++) {
+		struct vioblk_queue *q = &sc->sc_queues[i];
 
-	ret = vioblk_alloc_reqs(sc);
-	if (ret) {
-		goto exit_alloc2;
+		q->q_vq = virtio_alloc_vq(&sc->sc_virtio, i, 0,
+		    sc->sc_seg_max, "I/O request");
+		if (q->q_vq == NULL) {
+			goto exit_alloc;
+		}
+
+		ret = vioblk_alloc_reqs(q);
+		if (ret) {
+			goto exit_alloc;
+		}
 	}
 
 	sc->bd_h = bd_alloc_handle(sc, &vioblk_ops, &vioblk_bd_dma_attr,
@@ -992,7 +1088,7 @@ vioblk_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 
 	virtio_set_status(&sc->sc_virtio,
 	    VIRTIO_CONFIG_DEVICE_STATUS_DRIVER_OK);
-	virtio_start_vq_intr(sc->sc_vq);
+	vioblk_start_intrs(sc);
 
 	ret = virtio_enable_ints(&sc->sc_virtio);
 	if (ret)
@@ -1012,15 +1108,22 @@ exit_attach_bd:
 	 * If they ever get split, don't forget to add a call here.
 	 */
 exit_enable_ints:
-	virtio_stop_vq_intr(sc->sc_vq);
+	vioblk_stop_intrs(sc);
 	bd_free_handle(sc->bd_h);
-	vioblk_free_reqs(sc);
-exit_alloc2:
-	virtio_free_vq(sc->sc_vq);
-exit_alloc1:
-exit_features:
+exit_alloc:
+	for (i = 0; i < sc->sc_nqueues; i++) {
+		struct vioblk_queue *q = &sc->sc_queues[i];
+
+		if (q->q_reqs != NULL)
+			vioblk_free_reqs(q);
+		if (q->q_vq != NULL)
+			virtio_free_vq(q->q_vq);
+	}
 	virtio_release_ints(&sc->sc_virtio);
 exit_int:
+	kmem_free(sc->sc_queues, sizeof (struct vioblk_queue) *
+	    sc->sc_nqueues);
+exit_features:
 	virtio_set_status(&sc->sc_virtio, VIRTIO_CONFIG_DEVICE_STATUS_FAILED);
 	ddi_regs_map_free(&sc->sc_virtio.sc_ioh);
 exit_map:
@@ -1052,10 +1155,14 @@ vioblk_detach(dev_info_t *devinfo, ddi_detach_cmd_t cmd)
 	}
 
 	(void) bd_detach_handle(sc->bd_h);
-	virtio_stop_vq_intr(sc->sc_vq);
+	vioblk_stop_intrs(sc);
 	virtio_release_ints(&sc->sc_virtio);
-	vioblk_free_reqs(sc);
-	virtio_free_vq(sc->sc_vq);
+	for (int i = 0; i < sc->sc_nqueues; i++) {
+		vioblk_free_reqs(&sc->sc_queues[i]);
+		virtio_free_vq(sc->sc_queues[i].q_vq);
+	}
+	kmem_free(sc->sc_queues, sizeof (struct vioblk_queue) *
+	    sc->sc_nqueues);
 	virtio_device_reset(&sc->sc_virtio);
 	ddi_regs_map_free(&sc->sc_virtio.sc_ioh);
 	kstat_delete(sc->sc_intrstat);
@@ -1069,7 +1176,7 @@ vioblk_quiesce(dev_info_t *devinfo)
 {
 	struct vioblk_softc *sc = ddi_get_driver_private(devinfo);
 
-	virtio_stop_vq_intr(sc->sc_vq);
+	vioblk_stop_intrs(sc);
 	virtio_device_reset(&sc->sc_virtio);
 
 	return (DDI_SUCCESS);
@@ -78,6 +78,7 @@
 /* Configuration registers */
 #define	VIRTIO_NET_CONFIG_MAC		0 /* 8bit x 6byte */
 #define	VIRTIO_NET_CONFIG_STATUS	6 /* 16bit */
+#define	VIRTIO_NET_CONFIG_MAX_VQ_PAIRS	8 /* 16bit */
 
 /* Feature bits */
 #define	VIRTIO_NET_F_CSUM	(1 << 0) /* Host handles pkts w/ partial csum */
@@ -98,6 +99,8 @@
 #define	VIRTIO_NET_F_CTRL_RX	(1 << 18) /* Control channel RX mode support */
 #define	VIRTIO_NET_F_CTRL_VLAN	(1 << 19) /* Control channel VLAN filtering */
 #define	VIRTIO_NET_F_CTRL_RX_EXTRA (1 << 20) /* Extra RX mode control support */
+#define	VIRTIO_NET_F_GUEST_ANNOUNCE (1 << 21) /* Guest can announce itself */
+#define	VIRTIO_NET_F_MQ		(1 << 22) /* Multiple queue pairs */
 
 #define	VIRTIO_NET_FEATURE_BITS \
 	"\020" \
@@ -118,7 +121,9 @@
 	"\22CTRL_VQ" \
 	"\23CTRL_RX" \
 	"\24CTRL_VLAN" \
-	"\25CTRL_RX_EXTRA"
+	"\25CTRL_RX_EXTRA" \
+	"\26GUEST_ANNOUNCE" \
+	"\27MQ"
 
 /* Status */
 #define	VIRTIO_NET_S_LINK_UP	1
@@ -136,6 +141,7 @@ struct virtio_net_hdr {
 #pragma pack()
 
 #define	VIRTIO_NET_HDR_F_NEEDS_CSUM	1 /* flags */
+#define	VIRTIO_NET_HDR_F_DATA_VALID	2 /* flags */
 #define	VIRTIO_NET_HDR_GSO_NONE		0 /* gso_type */
 #define	VIRTIO_NET_HDR_GSO_TCPV4	1 /* gso_type */
 #define	VIRTIO_NET_HDR_GSO_UDP		3 /* gso_type */
@@ -162,6 +168,12 @@ struct virtio_net_ctrl_cmd {
 #define	VIRTIO_NET_CTRL_VLAN_ADD	0
 #define	VIRTIO_NET_CTRL_VLAN_DEL	1
 
+#define	VIRTIO_NET_CTRL_MQ		4
+#define	VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET	0
+
+#define	VIRTIO_NET_OK			0 /* ack */
+#define	VIRTIO_NET_ERR			1 /* ack */
+
 #pragma pack(1)
 struct virtio_net_ctrl_status {
 	uint8_t	ack;
@@ -179,6 +191,10 @@ struct virtio_net_ctrl_mac_tbl {
 struct virtio_net_ctrl_vlan {
 	uint16_t id;
 };
+
+struct virtio_net_ctrl_mq {
+	uint16_t virtqueue_pairs;
+};
 #pragma pack()
 
 static int vioif_quiesce(dev_info_t *);
@@ -266,18 +282,81 @@ struct vioif_tx_buf {
 	unsigned int		tb_external_num;
 };
 
+/*
+ * Each queue pair of the device is a receive and a transmit virtqueue, and
+ * each virtqueue is presented to MAC as a ring with its own interrupt. Only
+ * the first pair is used by the device until more are enabled through the
+ * control virtqueue.
+ */
+struct vioif_rxq {
+	struct vioif_softc	*rxq_sc;
+	struct virtqueue	*rxq_vq;
+
+	/* Serializes the interrupt handler and MAC polling. */
+	kmutex_t		rxq_lock;
+	mac_ring_handle_t	rxq_ring;
+	uint64_t		rxq_gen;	/* rxq_lock */
+	boolean_t		rxq_polling;	/* rxq_lock */
+
+	/*
+	 * For rx buffers, we keep a pointer array, because the buffers
+	 * can be loaned upstream, and we have to repopulate the array with
+	 * new members.
+	 */
+	struct vioif_rx_buf	**rxq_bufs;
+
+	uint64_t		rxq_ipackets;
+	uint64_t		rxq_rbytes;
+	uint64_t		rxq_brdcstrcv;
+	uint64_t		rxq_multircv;
+	uint64_t		rxq_norecvbuf;
+	uint64_t		rxq_ierrors;
+};
+
+struct vioif_txq {
+	struct vioif_softc	*txq_sc;
+	struct virtqueue	*txq_vq;
+	mac_ring_handle_t	txq_ring;
+
+	unsigned int		txq_stopped:1;
+
+	/*
+	 * For tx, we just allocate an array of buffers. The packet can
+	 * either be copied into the inline buffer, or the external mapping
+	 * could be used to map the packet
+	 */
+	struct vioif_tx_buf	*txq_bufs;
+
+	uint64_t		txq_opackets;
+	uint64_t		txq_obytes;
+	uint64_t		txq_brdcstxmt;
+	uint64_t		txq_multixmt;
+	uint64_t		txq_notxbuf;
+	uint64_t		txq_oerrors;
+};
+
 struct vioif_softc {
 	dev_info_t		*sc_dev; /* mirrors virtio_softc->sc_dev */
 	struct virtio_softc	sc_virtio;
 
 	mac_handle_t sc_mac_handle;
 	mac_register_t *sc_macp;
+	mac_group_handle_t	sc_rx_group;
 
-	struct virtqueue	*sc_rx_vq;
-	struct virtqueue	*sc_tx_vq;
-	struct virtqueue	*sc_ctrl_vq;
+	/*
+	 * sc_nqpairs queue pairs are allocated, and sc_nrings of them are
+	 * in use. The two only differ if the device refused to enable all
+	 * the pairs we asked for.
+	 */
+	struct vioif_rxq	*sc_rxqs;
+	struct vioif_txq	*sc_txqs;
+	uint_t			sc_nqpairs;
+	uint_t			sc_nrings;
+	uint_t			sc_max_qpairs;	/* offered by the device */
 
-	unsigned int		sc_tx_stopped:1;
+	struct virtqueue	*sc_ctrl_vq;
+	/* Holds the command, its data and the ack of a control request. */
+	struct vioif_buf_mapping sc_ctrl_mapping;
 
 	/* Feature bits. */
 	unsigned int		sc_rx_csum:1;
@@ -286,19 +365,6 @@ struct vioif_softc {
 
 	int			sc_mtu;
 	uint8_t			sc_mac[ETHERADDRL];
-	/*
-	 * For rx buffers, we keep a pointer array, because the buffers
-	 * can be loaned upstream, and we have to repopulate the array with
-	 * new members.
-	 */
-	struct vioif_rx_buf	**sc_rxbufs;
-
-	/*
-	 * For tx, we just allocate an array of buffers. The packet can
-	 * either be copied into the inline buffer, or the external mapping
-	 * could be used to map the packet
-	 */
-	struct vioif_tx_buf	*sc_txbufs;
 
 	kstat_t			*sc_intrstat;
 	/*
@@ -311,19 +377,6 @@ struct vioif_softc {
 	/* Copying small packets turns out to be faster then mapping them. */
 	unsigned long		sc_rxcopy_thresh;
 	unsigned long		sc_txcopy_thresh;
-	/* Some statistic coming here */
-	uint64_t		sc_ipackets;
-	uint64_t		sc_opackets;
-	uint64_t		sc_rbytes;
-	uint64_t		sc_obytes;
-	uint64_t		sc_brdcstxmt;
-	uint64_t		sc_brdcstrcv;
-	uint64_t		sc_multixmt;
-	uint64_t		sc_multircv;
-	uint64_t		sc_norecvbuf;
-	uint64_t		sc_notxbuf;
-	uint64_t		sc_ierrors;
-	uint64_t		sc_oerrors;
 };
 
 #define	ETHER_HEADER_LEN		sizeof (struct ether_header)
@@ -358,11 +411,35 @@ struct vioif_softc {
  */
 #define	VIOIF_TX_INLINE_SIZE 2048
 
+/*
+ * A control request is a command header, up to this much data, and an ack,
+ * each in its own descriptor.
+ */
+#define	VIOIF_CTRL_SIZE		64
+#define	VIOIF_CTRL_INDIRECT	3
+/* How long to wait for the device to answer a control request, in ms. */
+#define	VIOIF_CTRL_TIMEOUT	1000
+
 /* Native queue size for all queues */
 #define	VIOIF_RX_QLEN 0
 #define	VIOIF_TX_QLEN 0
 #define	VIOIF_CTRL_QLEN 0
 
+/*
+ * Upper bound on the number of queue pairs used. Every receive queue is
+ * filled with buffers large enough for a 64K frame, so each pair costs as
+ * much memory as a whole single-queue device did.
+ */
+uint_t vioif_max_qpairs = 8;
+
+/*
+ * Whether to accept checksum-offloaded and TSO frames from the host. Such
+ * frames carry only a partial TCP or UDP checksum, which we pass up as
+ * verified; a guest that forwards traffic should turn this off, or it
+ * would send those frames on with a bad checksum.
+ */
+boolean_t vioif_guest_offload = B_TRUE;
+
 static uchar_t vioif_broadcast[ETHERADDRL] = {
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff
 };
@@ -528,12 +605,12 @@ vioif_rx_destruct(void *buffer, void *user_arg)
 }
 
 static void
-vioif_free_mems(struct vioif_softc *sc)
+vioif_free_txq_mems(struct vioif_txq *txq)
 {
 	int i;
 
-	for (i = 0; i < sc->sc_tx_vq->vq_num; i++) {
-		struct vioif_tx_buf *buf = &sc->sc_txbufs[i];
+	for (i = 0; i < txq->txq_vq->vq_num; i++) {
+		struct vioif_tx_buf *buf = &txq->txq_bufs[i];
 		int j;
 
 		/* Tear down the internal mapping. */
@@ -557,52 +634,61 @@ vioif_free_mems(struct vioif_softc *sc)
 		    sizeof (struct vioif_tx_buf) * VIOIF_INDIRECT_MAX - 1);
 	}
 
-	kmem_free(sc->sc_txbufs, sizeof (struct vioif_tx_buf) *
-	    sc->sc_tx_vq->vq_num);
+	kmem_free(txq->txq_bufs, sizeof (struct vioif_tx_buf) *
+	    txq->txq_vq->vq_num);
+	txq->txq_bufs = NULL;
+}
+
+static void
+vioif_free_rxq_mems(struct vioif_rxq *rxq)
+{
+	struct vioif_softc *sc = rxq->rxq_sc;
+	int i;
 
-	for (i = 0; i < sc->sc_rx_vq->vq_num; i++) {
-		struct vioif_rx_buf *buf = sc->sc_rxbufs[i];
+	for (i = 0; i < rxq->rxq_vq->vq_num; i++) {
+		struct vioif_rx_buf *buf = rxq->rxq_bufs[i];
 
 		if (buf)
 			kmem_cache_free(sc->sc_rxbuf_cache, buf);
 	}
-	kmem_free(sc->sc_rxbufs, sizeof (struct vioif_rx_buf *) *
-	    sc->sc_rx_vq->vq_num);
+	kmem_free(rxq->rxq_bufs, sizeof (struct vioif_rx_buf *) *
+	    rxq->rxq_vq->vq_num);
+	rxq->rxq_bufs = NULL;
+}
+
+static void
+vioif_free_mems(struct vioif_softc *sc)
+{
+	int i;
+
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		if (sc->sc_txqs[i].txq_bufs != NULL)
+			vioif_free_txq_mems(&sc->sc_txqs[i]);
+		if (sc->sc_rxqs[i].rxq_bufs != NULL)
+			vioif_free_rxq_mems(&sc->sc_rxqs[i]);
+	}
 }
 
 static int
-vioif_alloc_mems(struct vioif_softc *sc)
+vioif_alloc_txq_mems(struct vioif_txq *txq)
 {
-	int i, txqsize, rxqsize;
+	struct vioif_softc *sc = txq->txq_sc;
+	int i, txqsize;
 	size_t len;
 	unsigned int nsegments;
 
-	txqsize = sc->sc_tx_vq->vq_num;
-	rxqsize = sc->sc_rx_vq->vq_num;
+	txqsize = txq->txq_vq->vq_num;
 
-	sc->sc_txbufs = kmem_zalloc(sizeof (struct vioif_tx_buf) * txqsize,
+	txq->txq_bufs = kmem_zalloc(sizeof (struct vioif_tx_buf) * txqsize,
 	    KM_SLEEP);
-	if (sc->sc_txbufs == NULL) {
+	if (txq->txq_bufs == NULL) {
 		dev_err(sc->sc_dev, CE_WARN,
 		    "Failed to allocate the tx buffers array");
 		goto exit_txalloc;
 	}
 
-	/*
-	 * We don't allocate the rx vioif_bufs, just the pointers, as
-	 * rx vioif_bufs can be loaned upstream, and we don't know the
-	 * total number we need.
-	 */
-	sc->sc_rxbufs = kmem_zalloc(sizeof (struct vioif_rx_buf *) * rxqsize,
-	    KM_SLEEP);
-	if (sc->sc_rxbufs == NULL) {
-		dev_err(sc->sc_dev, CE_WARN,
-		    "Failed to allocate the rx buffers pointer array");
-		goto exit_rxalloc;
-	}
-
 	for (i = 0; i < txqsize; i++) {
-		struct vioif_tx_buf *buf = &sc->sc_txbufs[i];
+		struct vioif_tx_buf *buf = &txq->txq_bufs[i];
 
 		/* Allocate and bind an inline mapping. */
 
@@ -658,7 +744,7 @@ vioif_alloc_mems(struct vioif_softc *sc)
 
 exit_tx:
 	for (i = 0; i < txqsize; i++) {
-		struct vioif_tx_buf *buf = &sc->sc_txbufs[i];
+		struct vioif_tx_buf *buf = &txq->txq_bufs[i];
 
 		if (buf->tb_inline_mapping.vbm_dmah)
 			(void) ddi_dma_unbind_handle(
@@ -678,70 +764,207 @@ exit_tx:
 			    VIOIF_INDIRECT_MAX - 1);
 	}
 
-	kmem_free(sc->sc_rxbufs, sizeof (struct vioif_rx_buf) * rxqsize);
-
-exit_rxalloc:
-	kmem_free(sc->sc_txbufs, sizeof (struct vioif_tx_buf) * txqsize);
+	kmem_free(txq->txq_bufs, sizeof (struct vioif_tx_buf) * txqsize);
+	txq->txq_bufs = NULL;
 exit_txalloc:
 	return (ENOMEM);
 }
 
-/* ARGSUSED */
-int
-vioif_multicst(void *arg, boolean_t add, const uint8_t *macaddr)
+static int
+vioif_alloc_mems(struct vioif_softc *sc)
 {
-	return (DDI_SUCCESS);
+	int i;
+
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		struct vioif_rxq *rxq = &sc->sc_rxqs[i];
+
+		if (vioif_alloc_txq_mems(&sc->sc_txqs[i]) != 0)
+			goto exit_alloc;
+
+		/*
+		 * We don't allocate the rx vioif_bufs, just the pointers, as
+		 * rx vioif_bufs can be loaned upstream, and we don't know the
+		 * total number we need.
+		 */
+		rxq->rxq_bufs = kmem_zalloc(sizeof (struct vioif_rx_buf *) *
+		    rxq->rxq_vq->vq_num, KM_SLEEP);
+		if (rxq->rxq_bufs == NULL) {
+			dev_err(sc->sc_dev, CE_WARN,
+			    "Failed to allocate the rx buffers pointer array");
+			goto exit_alloc;
+		}
+	}
+
+	return (0);
+
+exit_alloc:
+	vioif_free_mems(sc);
+	return (ENOMEM);
+}
+
+/*
+ * The control virtqueue is only used from attach, one request at a time, so
+ * a single buffer serves all requests.
+ */
+static int
+vioif_alloc_ctrl(struct vioif_softc *sc)
+{
+	struct vioif_buf_mapping *map = &sc->sc_ctrl_mapping;
+	unsigned int nsegments;
+	size_t len;
+
+	if (ddi_dma_alloc_handle(sc->sc_dev, &vioif_inline_buf_dma_attr,
+	    DDI_DMA_SLEEP, NULL, &map->vbm_dmah)) {
+		dev_err(sc->sc_dev, CE_WARN,
+		    "Can't allocate dma handle for control buffer");
+		goto exit_handle;
+	}
+
+	if (ddi_dma_mem_alloc(map->vbm_dmah, VIOIF_CTRL_SIZE, &vioif_bufattr,
+	    DDI_DMA_CONSISTENT, DDI_DMA_SLEEP, NULL, &map->vbm_buf, &len,
+	    &map->vbm_acch)) {
+		dev_err(sc->sc_dev, CE_WARN, "Can't allocate control buffer");
+		goto exit_alloc;
+	}
+
+	if (ddi_dma_addr_bind_handle(map->vbm_dmah, NULL, map->vbm_buf, len,
+	    DDI_DMA_RDWR | DDI_DMA_CONSISTENT, DDI_DMA_SLEEP, NULL,
+	    &map->vbm_dmac, &nsegments)) {
+		dev_err(sc->sc_dev, CE_WARN, "Can't bind control buffer");
+		goto exit_bind;
+	}
+
+	/* We asked for a single segment */
+	ASSERT(nsegments == 1);
+
+	return (0);
+
+exit_bind:
+	ddi_dma_mem_free(&map->vbm_acch);
+exit_alloc:
+	ddi_dma_free_handle(&map->vbm_dmah);
+exit_handle:
+	map->vbm_dmah = NULL;
+	return (ENOMEM);
+}
+
+static void
+vioif_free_ctrl(struct vioif_softc *sc)
+{
+	struct vioif_buf_mapping *map = &sc->sc_ctrl_mapping;
+
+	if (map->vbm_dmah == NULL)
+		return;
+
+	(void) ddi_dma_unbind_handle(map->vbm_dmah);
+	ddi_dma_mem_free(&map->vbm_acch);
+	ddi_dma_free_handle(&map->vbm_dmah);
+	map->vbm_dmah = NULL;
+}
+
+/*
+ * Send a request over the control virtqueue and wait for the device to
+ * acknowledge it. Requests are only made from attach, so we poll for the
+ * answer instead of taking an interrupt for it.
+ */
+static int
+vioif_ctrl_cmd(struct vioif_softc *sc, uint8_t class, uint8_t command,
+    const void *data, size_t datalen)
+{
+	struct vioif_buf_mapping *map = &sc->sc_ctrl_mapping;
+	struct virtio_net_ctrl_cmd *cmd;
+	struct virtio_net_ctrl_status *status;
+	uint64_t paddr = map->vbm_dmac.dmac_laddress;
+	struct vq_entry *ve;
+	uint32_t len;
+	int i;
+
+	ASSERT(sizeof (*cmd) + datalen + sizeof (*status) <= VIOIF_CTRL_SIZE);
+
+	ve = vq_alloc_entry(sc->sc_ctrl_vq);
+	if (!ve)
+		return (ENOSPC);
+
+	cmd = (void *)map->vbm_buf;
+	cmd->class = class;
+	cmd->command = command;
+	bcopy(data, map->vbm_buf + sizeof (*cmd), datalen);
+	status = (void *)(map->vbm_buf + sizeof (*cmd) + datalen);
+	status->ack = VIRTIO_NET_ERR;
+
+	virtio_ve_add_indirect_buf(ve, paddr, sizeof (*cmd), B_TRUE);
+	virtio_ve_add_indirect_buf(ve, paddr + sizeof (*cmd), datalen, B_TRUE);
+	virtio_ve_add_indirect_buf(ve, paddr + sizeof (*cmd) + datalen,
+	    sizeof (*status), B_FALSE);
+
+	(void) ddi_dma_sync(map->vbm_dmah, 0, 0, DDI_DMA_SYNC_FORDEV);
+	virtio_push_chain(ve, B_TRUE);
+
+	for (i = 0; i < VIOIF_CTRL_TIMEOUT; i++) {
+		if ((ve = virtio_pull_chain(sc->sc_ctrl_vq, &len)) != NULL)
+			break;
+		drv_usecwait(1000);
+	}
+	if (!ve) {
+		dev_err(sc->sc_dev, CE_WARN,
+		    "Control request %u/%u timed out", class, command);
+		return (ETIMEDOUT);
+	}
+	virtio_free_chain(ve);
+
+	(void) ddi_dma_sync(map->vbm_dmah, 0, 0, DDI_DMA_SYNC_FORKERNEL);
+	return (status->ack == VIRTIO_NET_OK ? 0 : EIO);
 }
 
 /* ARGSUSED */
 int
-vioif_promisc(void *arg, boolean_t on)
+vioif_multicst(void *arg, boolean_t add, const uint8_t *macaddr)
 {
 	return (DDI_SUCCESS);
 }
 
 /* ARGSUSED */
 int
-vioif_unicst(void *arg, const uint8_t *macaddr)
+vioif_promisc(void *arg, boolean_t on)
 {
-	return (DDI_FAILURE);
+	return (DDI_SUCCESS);
 }
 
-
 static uint_t
-vioif_add_rx(struct vioif_softc *sc, int kmflag)
+vioif_add_rx(struct vioif_rxq *rxq, int kmflag)
 {
+	struct vioif_softc *sc = rxq->rxq_sc;
 	uint_t num_added = 0;
 
 	for (;;) {
 		struct vq_entry *ve;
 		struct vioif_rx_buf *buf;
 
-		ve = vq_alloc_entry(sc->sc_rx_vq);
+		ve = vq_alloc_entry(rxq->rxq_vq);
 		if (!ve) {
 			/*
 			 * Out of free descriptors - ring already full.
 			 * It would be better to update sc_norxdescavail
 			 * but MAC does not ask for this info, hence we
-			 * update sc_norecvbuf.
+			 * update rxq_norecvbuf.
 			 */
-			sc->sc_norecvbuf++;
+			rxq->rxq_norecvbuf++;
 			break;
 		}
-		buf = sc->sc_rxbufs[ve->qe_index];
+		buf = rxq->rxq_bufs[ve->qe_index];
 
 		if (!buf) {
 			/* First run, allocate the buffer. */
 			buf = kmem_cache_alloc(sc->sc_rxbuf_cache, kmflag);
-			sc->sc_rxbufs[ve->qe_index] = buf;
+			rxq->rxq_bufs[ve->qe_index] = buf;
 		}
 
 		/* Still nothing? Bye. */
 		if (!buf) {
 			dev_err(sc->sc_dev, CE_WARN,
 			    "Can't allocate rx buffer");
-			sc->sc_norecvbuf++;
-			vq_free_entry(sc->sc_rx_vq, ve);
+			rxq->rxq_norecvbuf++;
+			vq_free_entry(rxq->rxq_vq, ve);
 			break;
 		}
 
@@ -788,39 +1011,49 @@ vioif_add_rx(struct vioif_softc *sc, int kmflag)
 }
 
 static uint_t
-vioif_populate_rx(struct vioif_softc *sc, int kmflag)
+vioif_populate_rx(struct vioif_rxq *rxq, int kmflag)
 {
-	uint_t num_added = vioif_add_rx(sc, kmflag);
+	uint_t num_added = vioif_add_rx(rxq, kmflag);
 
 	if (num_added > 0)
-		virtio_sync_vq(sc->sc_rx_vq);
+		virtio_sync_vq(rxq->rxq_vq);
 
 	return (num_added);
 }
 
-static uint_t
-vioif_process_rx(struct vioif_softc *sc)
+/*
+ * Pull received packets off the ring and return them as a chain. When
+ * poll_bytes is non-zero we stop once that many bytes have been gathered,
+ * as asked by the MAC poll entry point.
+ */
+static mblk_t *
+vioif_process_rx(struct vioif_rxq *rxq, int poll_bytes)
 {
+	struct vioif_softc *sc = rxq->rxq_sc;
 	struct vq_entry *ve;
 	struct vioif_rx_buf *buf;
+	struct virtio_net_hdr *hdr;
 	mblk_t *mphead = NULL, *lastmp = NULL, *mp;
 	uint32_t len;
-	uint_t num_processed = 0;
+	size_t total = 0;
+
+	ASSERT(MUTEX_HELD(&rxq->rxq_lock));
 
-	while ((ve = virtio_pull_chain(sc->sc_rx_vq, &len))) {
+	while ((ve = virtio_pull_chain(rxq->rxq_vq, &len))) {
 
-		buf = sc->sc_rxbufs[ve->qe_index];
+		buf = rxq->rxq_bufs[ve->qe_index];
 		ASSERT(buf);
 
 		if (len < sizeof (struct virtio_net_hdr)) {
 			dev_err(sc->sc_dev, CE_WARN, "RX: Cnain too small: %u",
 			    len - (uint32_t)sizeof (struct virtio_net_hdr));
-			sc->sc_ierrors++;
+			rxq->rxq_ierrors++;
 			virtio_free_chain(ve);
 			continue;
 		}
 
 		len -= sizeof (struct virtio_net_hdr);
+		hdr = (struct virtio_net_hdr *)buf->rb_mapping.vbm_buf;
 		/*
 		 * We copy small packets that happen to fit into a single
 		 * cookie and reuse the buffers. For bigger ones, we loan
@@ -829,8 +1062,8 @@ vioif_process_rx(struct vioif_softc *sc)
 		if (len < sc->sc_rxcopy_thresh) {
 			mp = allocb(len, 0);
 			if (!mp) {
-				sc->sc_norecvbuf++;
-				sc->sc_ierrors++;
+				rxq->rxq_norecvbuf++;
+				rxq->rxq_ierrors++;
 
 				virtio_free_chain(ve);
 				break;
@@ -846,8 +1079,8 @@ vioif_process_rx(struct vioif_softc *sc)
 			    sizeof (struct virtio_net_hdr) +
 			    VIOIF_IP_ALIGN, len, 0, &buf->rb_frtn);
 			if (!mp) {
-				sc->sc_norecvbuf++;
-				sc->sc_ierrors++;
+				rxq->rxq_norecvbuf++;
+				rxq->rxq_ierrors++;
 
 				virtio_free_chain(ve);
 				break;
@@ -859,7 +1092,19 @@ vioif_process_rx(struct vioif_softc *sc)
 			 * Buffer loaned, we will have to allocate a new one
 			 * for this slot.
 			 */
-			sc->sc_rxbufs[ve->qe_index] = NULL;
+			rxq->rxq_bufs[ve->qe_index] = NULL;
+		}
+
+		/*
+		 * Either the host has validated the checksum, or it handed us
+		 * a packet it built itself (possibly a coalesced TSO frame)
+		 * and never checksummed. In both cases there is nothing left
+		 * for the stack to verify.
+		 */
+		if (sc->sc_rx_csum && (hdr->flags &
+		    (VIRTIO_NET_HDR_F_NEEDS_CSUM |
+		    VIRTIO_NET_HDR_F_DATA_VALID)) != 0) {
+			mac_hcksum_set(mp, 0, 0, 0, 0, HCK_FULLCKSUM_OK);
 		}
 
 		/*
@@ -868,13 +1113,13 @@ vioif_process_rx(struct vioif_softc *sc)
 		 */
 		if (mp->b_rptr[0] & 0x1) {
 			if (bcmp(mp->b_rptr, vioif_broadcast, ETHERADDRL) != 0)
-				sc->sc_multircv++;
+				rxq->rxq_multircv++;
 			else
-				sc->sc_brdcstrcv++;
+				rxq->rxq_brdcstrcv++;
 		}
 
-		sc->sc_rbytes += len;
-		sc->sc_ipackets++;
+		rxq->rxq_rbytes += len;
+		rxq->rxq_ipackets++;
 
 		virtio_free_chain(ve);
 
@@ -884,30 +1129,30 @@ vioif_process_rx(struct vioif_softc *sc)
 			lastmp->b_next = mp;
 		}
 		lastmp = mp;
-		num_processed++;
-	}
 
-	if (mphead != NULL) {
-		mac_rx(sc->sc_mac_handle, NULL, mphead);
+		total += len;
+		if (poll_bytes != 0 && total >= poll_bytes)
+			break;
 	}
 
-	return (num_processed);
+	return (mphead);
 }
 
 static uint_t
-vioif_reclaim_used_tx(struct vioif_softc *sc)
+vioif_reclaim_used_tx(struct vioif_txq *txq)
 {
+	struct vioif_softc *sc = txq->txq_sc;
 	struct vq_entry *ve;
 	struct vioif_tx_buf *buf;
 	uint32_t len;
 	mblk_t *mp;
 	uint_t num_reclaimed = 0;
 
-	while ((ve = virtio_pull_chain(sc->sc_tx_vq, &len))) {
+	while ((ve = virtio_pull_chain(txq->txq_vq, &len))) {
 		/* We don't chain descriptors for tx, so don't expect any. */
 		ASSERT(!ve->qe_next);
 
-		buf = &sc->sc_txbufs[ve->qe_index];
+		buf = &txq->txq_bufs[ve->qe_index];
 		mp = buf->tb_mp;
 		buf->tb_mp = NULL;
 
@@ -925,22 +1170,22 @@ vioif_reclaim_used_tx(struct vioif_softc *sc)
 		num_reclaimed++;
 	}
 
-	if (sc->sc_tx_stopped && num_reclaimed > 0) {
-		sc->sc_tx_stopped = 0;
-		mac_tx_update(sc->sc_mac_handle);
+	if (txq->txq_stopped && num_reclaimed > 0) {
+		txq->txq_stopped = 0;
+		mac_tx_ring_update(sc->sc_mac_handle, txq->txq_ring);
 	}
 
 	return (num_reclaimed);
 }
 
-/* sc will be used to update stat counters. */
+/* txq will be used to update stat counters. */
 /* ARGSUSED */
 static inline void
-vioif_tx_inline(struct vioif_softc *sc, struct vq_entry *ve, mblk_t *mp,
+vioif_tx_inline(struct vioif_txq *txq, struct vq_entry *ve, mblk_t *mp,
     size_t msg_size)
 {
 	struct vioif_tx_buf *buf;
-	buf = &sc->sc_txbufs[ve->qe_index];
+	buf = &txq->txq_bufs[ve->qe_index];
 
 	ASSERT(buf);
 
@@ -973,17 +1218,18 @@ vioif_tx_lazy_handle_alloc(struct vioif_softc *sc, struct vioif_tx_buf *buf,
 }
 
 static inline int
-vioif_tx_external(struct vioif_softc *sc, struct vq_entry *ve, mblk_t *mp,
+vioif_tx_external(struct vioif_txq *txq, struct vq_entry *ve, mblk_t *mp,
     size_t msg_size)
 {
 	_NOTE(ARGUNUSED(msg_size));
 
+	struct vioif_softc *sc = txq->txq_sc;
 	struct vioif_tx_buf *buf;
 	mblk_t *nmp;
 	int i, j;
 	int ret = DDI_SUCCESS;
 
-	buf = &sc->sc_txbufs[ve->qe_index];
+	buf = &txq->txq_bufs[ve->qe_index];
 
 	ASSERT(buf);
 
@@ -1008,8 +1254,8 @@ vioif_tx_external(struct vioif_softc *sc, struct vq_entry *ve, mblk_t *mp,
 
 		ret = vioif_tx_lazy_handle_alloc(sc, buf, i);
 		if (ret != DDI_SUCCESS) {
-			sc->sc_notxbuf++;
-			sc->sc_oerrors++;
+			txq->txq_notxbuf++;
+			txq->txq_oerrors++;
 			goto exit_lazy_alloc;
 		}
 		ret = ddi_dma_addr_bind_handle(
@@ -1019,7 +1265,7 @@ vioif_tx_external(struct vioif_softc *sc, struct vq_entry *ve, mblk_t *mp,
 		    DDI_DMA_SLEEP, NULL, &dmac, &ncookies);
 
 		if (ret != DDI_SUCCESS) {
-			sc->sc_oerrors++;
+			txq->txq_oerrors++;
 			dev_err(sc->sc_dev, CE_NOTE,
 			    "TX: Failed to bind external handle");
 			goto exit_bind;
@@ -1030,8 +1276,8 @@ vioif_tx_external(struct vioif_softc *sc, struct vq_entry *ve, mblk_t *mp,
 			dev_err(sc->sc_dev, CE_NOTE,
 			    "TX: Indirect descriptor table limit reached."
 			    " It took %d fragments.", i);
-			sc->sc_notxbuf++;
-			sc->sc_oerrors++;
+			txq->txq_notxbuf++;
+			txq->txq_oerrors++;
 
 			ret = DDI_FAILURE;
 			goto exit_limit;
@@ -1063,8 +1309,9 @@ exit_lazy_alloc:
 }
 
 static boolean_t
-vioif_send(struct vioif_softc *sc, mblk_t *mp)
+vioif_send(struct vioif_txq *txq, mblk_t *mp)
 {
+	struct vioif_softc *sc = txq->txq_sc;
 	struct vq_entry *ve;
 	struct vioif_tx_buf *buf;
 	struct virtio_net_hdr *net_header = NULL;
@@ -1086,14 +1333,14 @@ vioif_send(struct vioif_softc *sc, mblk_t *mp)
 		lso_required = (lso_flags & HW_LSO);
 	}
 
-	ve = vq_alloc_entry(sc->sc_tx_vq);
+	ve = vq_alloc_entry(txq->txq_vq);
 
 	if (!ve) {
-		sc->sc_notxbuf++;
+		txq->txq_notxbuf++;
 		/* Out of free descriptors - try later. */
 		return (B_FALSE);
 	}
-	buf = &sc->sc_txbufs[ve->qe_index];
+	buf = &txq->txq_bufs[ve->qe_index];
 
 	/* Use the inline buffer of the first entry for the virtio_net_hdr. */
 	(void) memset(buf->tb_inline_mapping.vbm_buf, 0,
@@ -1140,9 +1387,9 @@ vioif_send(struct vioif_softc *sc, mblk_t *mp)
 	/* meanwhile update the statistic */
 	if (mp->b_rptr[0] & 0x1) {
 		if (bcmp(mp->b_rptr, vioif_broadcast, ETHERADDRL) != 0)
-				sc->sc_multixmt++;
+				txq->txq_multixmt++;
 			else
-				sc->sc_brdcstxmt++;
+				txq->txq_brdcstxmt++;
 	}
 
 	/*
@@ -1150,24 +1397,24 @@ vioif_send(struct vioif_softc *sc, mblk_t *mp)
 	 * get mapped using the mapped buffer.
 	 */
 	if (msg_size < sc->sc_txcopy_thresh) {
-		vioif_tx_inline(sc, ve, mp, msg_size);
+		vioif_tx_inline(txq, ve, mp, msg_size);
 	} else {
 		/* statistic gets updated by vioif_tx_external when fail */
-		ret = vioif_tx_external(sc, ve, mp, msg_size);
+		ret = vioif_tx_external(txq, ve, mp, msg_size);
 		if (ret != DDI_SUCCESS)
 			goto exit_tx_external;
 	}
 
 	virtio_push_chain(ve, B_TRUE);
 
-	sc->sc_opackets++;
-	sc->sc_obytes += msg_size;
+	txq->txq_opackets++;
+	txq->txq_obytes += msg_size;
 
 	return (B_TRUE);
 
 exit_tx_external:
 
-	vq_free_entry(sc->sc_tx_vq, ve);
+	vq_free_entry(txq->txq_vq, ve);
 	/*
 	 * vioif_tx_external can fail when the buffer does not fit into the
 	 * indirect descriptor table. Free the mp. I don't expect this ever
@@ -1179,17 +1426,17 @@ exit_tx_external:
 }
 
 mblk_t *
-vioif_tx(void *arg, mblk_t *mp)
+vioif_ring_tx(void *arg, mblk_t *mp)
 {
-	struct vioif_softc *sc = arg;
+	struct vioif_txq *txq = arg;
 	mblk_t	*nmp;
 
 	while (mp != NULL) {
 		nmp = mp->b_next;
 		mp->b_next = NULL;
 
-		if (!vioif_send(sc, mp)) {
-			sc->sc_tx_stopped = 1;
+		if (!vioif_send(txq, mp)) {
+			txq->txq_stopped = 1;
 			mp->b_next = nmp;
 			break;
 		}
@@ -1205,26 +1452,35 @@ vioif_start(void *arg)
 	struct vioif_softc *sc = arg;
 	struct vq_entry *ve;
 	uint32_t len;
+	int i;
 
 	mac_link_update(sc->sc_mac_handle,
 	    vioif_link_state(sc));
 
-	virtio_start_vq_intr(sc->sc_rx_vq);
-
 	/*
-	 * Don't start interrupts on sc_tx_vq. We use VIRTIO_F_NOTIFY_ON_EMPTY,
-	 * so the device will send a transmit interrupt when the queue is empty
-	 * and we can reclaim it in one sweep.
+	 * Don't start interrupts on the tx queues. We use
+	 * VIRTIO_F_NOTIFY_ON_EMPTY, so the device will send a transmit
+	 * interrupt when a queue is empty and we can reclaim it in one sweep.
 	 */
 
-	/*
-	 * Clear any data that arrived early on the receive queue and populate
-	 * it with free buffers that the device can use moving forward.
-	 */
-	while ((ve = virtio_pull_chain(sc->sc_rx_vq, &len)) != NULL) {
-		virtio_free_chain(ve);
+	for (i = 0; i < sc->sc_nrings; i++) {
+		struct vioif_rxq *rxq = &sc->sc_rxqs[i];
+
+		mutex_enter(&rxq->rxq_lock);
+		if (!rxq->rxq_polling)
+			virtio_start_vq_intr(rxq->rxq_vq);
+
+		/*
+		 * Clear any data that arrived early on the receive queue and
+		 * populate it with free buffers that the device can use
+		 * moving forward.
+		 */
+		while ((ve = virtio_pull_chain(rxq->rxq_vq, &len)) != NULL) {
+			virtio_free_chain(ve);
+		}
+		(void) vioif_populate_rx(rxq, KM_SLEEP);
+		mutex_exit(&rxq->rxq_lock);
 	}
-	(void) vioif_populate_rx(sc, KM_SLEEP);
 
 	return (DDI_SUCCESS);
 }
@@ -1233,10 +1489,44 @@ void
 vioif_stop(void *arg)
 {
 	struct vioif_softc *sc = arg;
+	int i;
 
-	virtio_stop_vq_intr(sc->sc_rx_vq);
+	for (i = 0; i < sc->sc_nrings; i++)
+		virtio_stop_vq_intr(sc->sc_rxqs[i].rxq_vq);
 }
 
+/*
+ * Sum a per-queue counter, given by its offset, over all queues.
+ */
+static uint64_t
+vioif_rxq_sum(struct vioif_softc *sc, size_t off)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < sc->sc_nqpairs; i++)
+		sum += *(uint64_t *)((caddr_t)&sc->sc_rxqs[i] + off);
+
+	return (sum);
+}
+
+static uint64_t
+vioif_txq_sum(struct vioif_softc *sc, size_t off)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < sc->sc_nqpairs; i++)
+		sum += *(uint64_t *)((caddr_t)&sc->sc_txqs[i] + off);
+
+	return (sum);
+}
+
+#define	VIOIF_RXQ_SUM(sc, f)	\
+	vioif_rxq_sum((sc), offsetof(struct vioif_rxq, f))
+#define	VIOIF_TXQ_SUM(sc, f)	\
+	vioif_txq_sum((sc), offsetof(struct vioif_txq, f))
+
 /* ARGSUSED */
 static int
 vioif_stat(void *arg, uint_t stat, uint64_t *val)
@@ -1245,40 +1535,40 @@ vioif_stat(void *arg, uint_t stat, uint64_t *val)
 
 	switch (stat) {
 	case MAC_STAT_IERRORS:
-		*val = sc->sc_ierrors;
+		*val = VIOIF_RXQ_SUM(sc, rxq_ierrors);
 		break;
 	case MAC_STAT_OERRORS:
-		*val = sc->sc_oerrors;
+		*val = VIOIF_TXQ_SUM(sc, txq_oerrors);
 		break;
 	case MAC_STAT_MULTIRCV:
-		*val = sc->sc_multircv;
+		*val = VIOIF_RXQ_SUM(sc, rxq_multircv);
 		break;
 	case MAC_STAT_BRDCSTRCV:
-		*val = sc->sc_brdcstrcv;
+		*val = VIOIF_RXQ_SUM(sc, rxq_brdcstrcv);
 		break;
 	case MAC_STAT_MULTIXMT:
-		*val = sc->sc_multixmt;
+		*val = VIOIF_TXQ_SUM(sc, txq_multixmt);
 		break;
 	case MAC_STAT_BRDCSTXMT:
-		*val = sc->sc_brdcstxmt;
+		*val = VIOIF_TXQ_SUM(sc, txq_brdcstxmt);
 		break;
 	case MAC_STAT_IPACKETS:
-		*val = sc->sc_ipackets;
+		*val = VIOIF_RXQ_SUM(sc, rxq_ipackets);
 		break;
 	case MAC_STAT_RBYTES:
-		*val = sc->sc_rbytes;
+		*val = VIOIF_RXQ_SUM(sc, rxq_rbytes);
 		break;
 	case MAC_STAT_OPACKETS:
-		*val = sc->sc_opackets;
+		*val = VIOIF_TXQ_SUM(sc, txq_opackets);
 		break;
 	case MAC_STAT_OBYTES:
-		*val = sc->sc_obytes;
+		*val = VIOIF_TXQ_SUM(sc, txq_obytes);
 		break;
 	case MAC_STAT_NORCVBUF:
-		*val = sc->sc_norecvbuf;
+		*val = VIOIF_RXQ_SUM(sc, rxq_norecvbuf);
 		break;
 	case MAC_STAT_NOXMTBUF:
-		*val = sc->sc_notxbuf;
+		*val = VIOIF_TXQ_SUM(sc, txq_notxbuf);
 		break;
 	case MAC_STAT_IFSPEED:
 		/* always 1 Gbit */
@@ -1296,6 +1586,206 @@ vioif_stat(void *arg, uint_t stat, uint64_t *val)
 	return (DDI_SUCCESS);
 }
 
+static int
+vioif_ring_start(mac_ring_driver_t rh, uint64_t gen_num)
+{
+	struct vioif_rxq *rxq = (struct vioif_rxq *)rh;
+
+	mutex_enter(&rxq->rxq_lock);
+	rxq->rxq_gen = gen_num;
+	mutex_exit(&rxq->rxq_lock);
+
+	return (0);
+}
+
+static mblk_t *
+vioif_ring_rx_poll(void *arg, int poll_bytes)
+{
+	struct vioif_rxq *rxq = arg;
+	mblk_t *mp;
+
+	ASSERT3S(poll_bytes, >, 0);
+
+	mutex_enter(&rxq->rxq_lock);
+	mp = vioif_process_rx(rxq, poll_bytes);
+	(void) vioif_populate_rx(rxq, KM_NOSLEEP);
+	mutex_exit(&rxq->rxq_lock);
+
+	return (mp);
+}
+
+static int
+vioif_rx_ring_intr_enable(mac_intr_handle_t intrh)
+{
+	struct vioif_rxq *rxq = (struct vioif_rxq *)intrh;
+
+	mutex_enter(&rxq->rxq_lock);
+	rxq->rxq_polling = B_FALSE;
+	virtio_start_vq_intr(rxq->rxq_vq);
+	mutex_exit(&rxq->rxq_lock);
+
+	return (0);
+}
+
+static int
+vioif_rx_ring_intr_disable(mac_intr_handle_t intrh)
+{
+	struct vioif_rxq *rxq = (struct vioif_rxq *)intrh;
+
+	mutex_enter(&rxq->rxq_lock);
+	virtio_stop_vq_intr(rxq->rxq_vq);
+	rxq->rxq_polling = B_TRUE;
+	mutex_exit(&rxq->rxq_lock);
+
+	return (0);
+}
+
+static int
+vioif_rx_ring_stat(mac_ring_driver_t rh, uint_t stat, uint64_t *val)
+{
+	struct vioif_rxq *rxq = (struct vioif_rxq *)rh;
+
+	switch (stat) {
+	case MAC_STAT_RBYTES:
+		*val = rxq->rxq_rbytes;
+		break;
+	case MAC_STAT_IPACKETS:
+		*val = rxq->rxq_ipackets;
+		break;
+	default:
+		*val = 0;
+		return (ENOTSUP);
+	}
+
+	return (0);
+}
+
+static int
+vioif_tx_ring_stat(mac_ring_driver_t rh, uint_t stat, uint64_t *val)
+{
+	struct vioif_txq *txq = (struct vioif_txq *)rh;
+
+	switch (stat) {
+	case MAC_STAT_OBYTES:
+		*val = txq->txq_obytes;
+		break;
+	case MAC_STAT_OPACKETS:
+		*val = txq->txq_opackets;
+		break;
+	default:
+		*val = 0;
+		return (ENOTSUP);
+	}
+
+	return (0);
+}
+
+/*
+ * With MSI-X each queue has its own vector, laid out by vioif_register_ints()
+ * as rx0, tx0, rx1, tx1, ..., so MAC can retarget them one by one.
+ */
+static void
+vioif_fill_rx_ring(void *arg, mac_ring_type_t rtype, const int group_index,
+    const int ring_index, mac_ring_info_t *infop, mac_ring_handle_t rh)
+{
+	struct vioif_softc *sc = arg;
+	struct vioif_rxq *rxq;
+	mac_intr_t *mintr = &infop->mri_intr;
+
+	ASSERT3S(rtype, ==, MAC_RING_TYPE_RX);
+	ASSERT3S(group_index, ==, 0);
+	ASSERT3S(ring_index, <, sc->sc_nrings);
+
+	rxq = &sc->sc_rxqs[ring_index];
+	rxq->rxq_ring = rh;
+
+	infop->mri_driver = (mac_ring_driver_t)rxq;
+	infop->mri_start = vioif_ring_start;
+	infop->mri_stop = NULL;
+	infop->mri_poll = vioif_ring_rx_poll;
+	infop->mri_stat = vioif_rx_ring_stat;
+
+	mintr->mi_handle = (mac_intr_handle_t)rxq;
+	mintr->mi_enable = vioif_rx_ring_intr_enable;
+	mintr->mi_disable = vioif_rx_ring_intr_disable;
+	if (sc->sc_virtio.sc_int_type == DDI_INTR_TYPE_MSIX) {
+		mintr->mi_ddi_handle =
+		    sc->sc_virtio.sc_intr_htable[2 * ring_index];
+	}
+}
+
+static void
+vioif_fill_tx_ring(void *arg, mac_ring_type_t rtype, const int group_index,
+    const int ring_index, mac_ring_info_t *infop, mac_ring_handle_t rh)
+{
+	struct vioif_softc *sc = arg;
+	struct vioif_txq *txq;
+	mac_intr_t *mintr = &infop->mri_intr;
+
+	ASSERT3S(rtype, ==, MAC_RING_TYPE_TX);
+	ASSERT3S(group_index, ==, -1);
+	ASSERT3S(ring_index, <, sc->sc_nrings);
+
+	txq = &sc->sc_txqs[ring_index];
+	txq->txq_ring = rh;
+
+	infop->mri_driver = (mac_ring_driver_t)txq;
+	infop->mri_start = NULL;
+	infop->mri_stop = NULL;
+	infop->mri_tx = vioif_ring_tx;
+	infop->mri_stat = vioif_tx_ring_stat;
+
+	if (sc->sc_virtio.sc_int_type == DDI_INTR_TYPE_MSIX) {
+		mintr->mi_ddi_handle =
+		    sc->sc_virtio.sc_intr_htable[2 * ring_index + 1];
+	}
+}
+
+/*
+ * The device has no unicast filter of its own: it delivers whatever the host
+ * steers to it, so the only address the group can hold is the primary one.
+ */
+static int
+vioif_group_add_mac(void *arg, const uint8_t *mac_addr)
+{
+	struct vioif_softc *sc = arg;
+
+	if (bcmp(mac_addr, sc->sc_mac, ETHERADDRL) != 0)
+		return (ENOSPC);
+
+	return (0);
+}
+
+static int
+vioif_group_remove_mac(void *arg, const uint8_t *mac_addr)
+{
+	struct vioif_softc *sc = arg;
+
+	if (bcmp(mac_addr, sc->sc_mac, ETHERADDRL) != 0)
+		return (EINVAL);
+
+	return (0);
+}
+
+static void
+vioif_fill_rx_group(void *arg, mac_ring_type_t rtype, const int index,
+    mac_group_info_t *infop, mac_group_handle_t gh)
+{
+	struct vioif_softc *sc = arg;
+
+	ASSERT3S(rtype, ==, MAC_RING_TYPE_RX);
+	ASSERT3S(index, ==, 0);
+
+	sc->sc_rx_group = gh;
+
+	infop->mgi_driver = (mac_group_driver_t)sc;
+	infop->mgi_start = NULL;
+	infop->mgi_stop = NULL;
+	infop->mgi_addmac = vioif_group_add_mac;
+	infop->mgi_remmac = vioif_group_remove_mac;
+	infop->mgi_count = sc->sc_nrings;
+}
+
 static int
 vioif_set_prop_private(struct vioif_softc *sc, const char *pr_name,
     uint_t pr_valsize, const void *pr_val)
@@ -1462,6 +1952,31 @@ vioif_getcapab(void *arg, mac_capab_t cap, void *cap_data)
 			return (B_TRUE);
 		}
 		return (B_FALSE);
+	case MAC_CAPAB_RINGS: {
+		mac_capab_rings_t *cap_rings = cap_data;
+
+		cap_rings->mr_group_type = MAC_GROUP_TYPE_STATIC;
+		cap_rings->mr_rnum = sc->sc_nrings;
+		switch (cap_rings->mr_type) {
+		case MAC_RING_TYPE_TX:
+			cap_rings->mr_gnum = 0;
+			cap_rings->mr_rget = vioif_fill_tx_ring;
+			cap_rings->mr_gget = NULL;
+			cap_rings->mr_gaddring = NULL;
+			cap_rings->mr_gremring = NULL;
+			break;
+		case MAC_RING_TYPE_RX:
+			cap_rings->mr_gnum = 1;
+			cap_rings->mr_rget = vioif_fill_rx_ring;
+			cap_rings->mr_gget = vioif_fill_rx_group;
+			cap_rings->mr_gaddring = NULL;
+			cap_rings->mr_gremring = NULL;
+			break;
+		default:
+			return (B_FALSE);
+		}
+		return (B_TRUE);
+	}
 	default:
 		break;
 	}
@@ -1475,8 +1990,8 @@ static mac_callbacks_t vioif_m_callbacks = {
 	.mc_stop	= vioif_stop,
 	.mc_setpromisc	= vioif_promisc,
 	.mc_multicst	= vioif_multicst,
-	.mc_unicst	= vioif_unicst,
-	.mc_tx		= vioif_tx,
+	.mc_unicst	= NULL,	/* see vioif_group_add_mac() */
+	.mc_tx		= NULL,	/* see vioif_ring_tx() */
 	/* Optional callbacks */
 	.mc_reserved	= NULL,		/* reserved */
 	.mc_ioctl	= NULL,		/* mc_ioctl */
@@ -1516,15 +2031,26 @@ static int
 vioif_dev_features(struct vioif_softc *sc)
 {
 	uint32_t host_features;
+	uint32_t guest_features;
 
-	host_features = virtio_negotiate_features(&sc->sc_virtio,
-	    VIRTIO_NET_F_CSUM |
+	guest_features = VIRTIO_NET_F_CSUM |
 	    VIRTIO_NET_F_HOST_TSO4 |
 	    VIRTIO_NET_F_HOST_ECN |
 	    VIRTIO_NET_F_MAC |
 	    VIRTIO_NET_F_STATUS |
+	    VIRTIO_NET_F_CTRL_VQ |
+	    VIRTIO_NET_F_MQ |
 	    VIRTIO_F_RING_INDIRECT_DESC |
-	    VIRTIO_F_NOTIFY_ON_EMPTY);
+	    VIRTIO_F_NOTIFY_ON_EMPTY;
+	if (vioif_guest_offload) {
+		guest_features |= VIRTIO_NET_F_GUEST_CSUM |
+		    VIRTIO_NET_F_GUEST_TSO4 |
+		    VIRTIO_NET_F_GUEST_TSO6 |
+		    VIRTIO_NET_F_GUEST_ECN;
+	}
+
+	host_features = virtio_negotiate_features(&sc->sc_virtio,
+	    guest_features);
 
 	vioif_show_features(sc, "Host features: ", host_features);
 	vioif_show_features(sc, "Negotiated features: ",
@@ -1592,17 +2118,24 @@ vioif_get_mac(struct vioif_softc *sc)
 uint_t
 vioif_rx_handler(caddr_t arg1, caddr_t arg2)
 {
-	struct virtio_softc *vsc = (void *) arg1;
-	struct vioif_softc *sc = container_of(vsc,
-	    struct vioif_softc, sc_virtio);
+	struct vioif_rxq *rxq = (void *)arg2;
+	struct vioif_softc *sc = rxq->rxq_sc;
+	mblk_t *mp;
+	uint64_t gen;
 
-	/*
-	 * The return values of these functions are not needed but they make
-	 * debugging interrupts simpler because you can use them to detect when
-	 * stuff was processed and repopulated in this handler.
-	 */
-	(void) vioif_process_rx(sc);
-	(void) vioif_populate_rx(sc, KM_NOSLEEP);
+	mutex_enter(&rxq->rxq_lock);
+	/* MAC is polling this ring, it will pick the packets up itself. */
+	if (rxq->rxq_polling) {
+		mutex_exit(&rxq->rxq_lock);
+		return (DDI_INTR_CLAIMED);
+	}
+	mp = vioif_process_rx(rxq, 0);
+	(void) vioif_populate_rx(rxq, KM_NOSLEEP);
+	gen = rxq->rxq_gen;
+	mutex_exit(&rxq->rxq_lock);
+
+	if (mp != NULL)
+		mac_rx_ring(sc->sc_mac_handle, rxq->rxq_ring, mp, gen);
 
 	return (DDI_INTR_CLAIMED);
 }
@@ -1611,48 +2144,84 @@ vioif_rx_handler(caddr_t arg1, caddr_t arg2)
 uint_t
 vioif_tx_handler(caddr_t arg1, caddr_t arg2)
 {
-	struct virtio_softc *vsc = (void *)arg1;
-	struct vioif_softc *sc = container_of(vsc,
-	    struct vioif_softc, sc_virtio);
+	struct vioif_txq *txq = (void *)arg2;
 
 	/*
 	 * The return value of this function is not needed but makes debugging
 	 * interrupts simpler because you can use it to detect if anything was
 	 * reclaimed in this handler.
 	 */
-	(void) vioif_reclaim_used_tx(sc);
+	(void) vioif_reclaim_used_tx(txq);
 
 	return (DDI_INTR_CLAIMED);
 }
 
+/*
+ * Each queue pair gets an rx and a tx handler, in the order the virtqueues
+ * are allocated, so that with MSI-X every queue has a vector of its own.
+ */
 static int
 vioif_register_ints(struct vioif_softc *sc)
 {
-	int ret;
-
-	struct virtio_int_handler vioif_vq_h[] = {
-		{ vioif_rx_handler },
-		{ vioif_tx_handler },
-		{ NULL }
-	};
+	struct virtio_int_handler *vioif_vq_h;
+	size_t sz = sizeof (struct virtio_int_handler) *
+	    (2 * sc->sc_nqpairs + 1);
+	int i, ret;
+
+	vioif_vq_h = kmem_zalloc(sz, KM_SLEEP);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		vioif_vq_h[2 * i].vh_func = vioif_rx_handler;
+		vioif_vq_h[2 * i].vh_priv = (void *)&sc->sc_rxqs[i];
+		vioif_vq_h[2 * i + 1].vh_func = vioif_tx_handler;
+		vioif_vq_h[2 * i + 1].vh_priv = (void *)&sc->sc_txqs[i];
+	}
 
 	ret = virtio_register_ints(&sc->sc_virtio, NULL, vioif_vq_h);
+	kmem_free(vioif_vq_h, sz);
 
 	return (ret);
 }
 
+/*
+ * Pick the number of queue pairs to set up. Going past one needs both the
+ * control queue (to tell the device) and enough MSI-X vectors to give each
+ * queue its own. More pairs than CPUs buys nothing.
+ */
+static int
+vioif_qpairs(struct vioif_softc *sc)
+{
+	int types, nintrs, n;
+
+	if (!vioif_has_feature(sc, VIRTIO_NET_F_MQ) ||
+	    !vioif_has_feature(sc, VIRTIO_NET_F_CTRL_VQ))
+		return (1);
+
+	if (ddi_intr_get_supported_types(sc->sc_dev, &types) != DDI_SUCCESS ||
+	    !(types & DDI_INTR_TYPE_MSIX) ||
+	    ddi_intr_get_nintrs(sc->sc_dev, DDI_INTR_TYPE_MSIX,
+	    &nintrs) != DDI_SUCCESS)
+		return (1);
+
+	n = MIN(sc->sc_max_qpairs, ncpus);
+	n = MIN(n, vioif_max_qpairs);
+	n = MIN(n, nintrs / 2);
+
+	return (MAX(n, 1));
+}
 
 static void
 vioif_check_features(struct vioif_softc *sc)
 {
+	/*
+	 * GUEST_CSUM only means the host may hand us packets with a partial
+	 * or already validated checksum; it does not depend on CSUM.
+	 */
+	if (vioif_has_feature(sc, VIRTIO_NET_F_GUEST_CSUM))
+		sc->sc_rx_csum = 1;
+
 	if (vioif_has_feature(sc, VIRTIO_NET_F_CSUM)) {
 		/* The GSO/GRO featured depend on CSUM, check them here. */
 		sc->sc_tx_csum = 1;
-		sc->sc_rx_csum = 1;
-
-		if (!vioif_has_feature(sc, VIRTIO_NET_F_GUEST_CSUM)) {
-			sc->sc_rx_csum = 0;
-		}
 		cmn_err(CE_NOTE, "Csum enabled.");
 
 		if (vioif_has_feature(sc, VIRTIO_NET_F_HOST_TSO4)) {
@@ -1685,6 +2254,7 @@ vioif_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	struct virtio_softc *vsc;
 	mac_register_t *macp;
 	char cache_name[CACHE_NAME_SIZE];
+	int i;
 
 	instance = ddi_get_instance(devinfo);
 
@@ -1738,7 +2308,30 @@ vioif_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 	if (ret)
 		goto exit_features;
 
-	vsc->sc_nvqs = vioif_has_feature(sc, VIRTIO_NET_F_CTRL_VQ) ? 3 : 2;
+	/*
+	 * MSI-X is not enabled until virtio_enable_ints(), so until then the
+	 * device config lives at the legacy offset.
+	 */
+	vsc->sc_config_offset = VIRTIO_CONFIG_DEVICE_CONFIG_NOMSIX;
+
+	sc->sc_max_qpairs = 1;
+	if (vioif_has_feature(sc, VIRTIO_NET_F_MQ)) {
+		sc->sc_max_qpairs = MAX(1, virtio_read_device_config_2(vsc,
+		    VIRTIO_NET_CONFIG_MAX_VQ_PAIRS));
+	}
+	sc->sc_nqpairs = vioif_qpairs(sc);
+
+	vsc->sc_nvqs = 2 * sc->sc_nqpairs +
+	    (vioif_has_feature(sc, VIRTIO_NET_F_CTRL_VQ) ? 1 : 0);
+
+	sc->sc_rxqs = kmem_zalloc(sizeof (struct vioif_rxq) * sc->sc_nqpairs,
+	    KM_SLEEP);
+	sc->sc_txqs = kmem_zalloc(sizeof (struct vioif_txq) * sc->sc_nqpairs,
+	    KM_SLEEP);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		sc->sc_rxqs[i].rxq_sc = sc;
+		sc->sc_txqs[i].txq_sc = sc;
+	}
 
 	(void) snprintf(cache_name, CACHE_NAME_SIZE, "vioif%d_rx", instance);
 	sc->sc_rxbuf_cache = kmem_cache_create(cache_name,
@@ -1756,36 +2349,70 @@ vioif_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 		goto exit_ints;
 	}
 
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		mutex_init(&sc->sc_rxqs[i].rxq_lock, NULL, MUTEX_DRIVER,
+		    DDI_INTR_PRI(vsc->sc_intr_prio));
+	}
+
 	/*
 	 * Register layout determined, can now access the
 	 * device-specific bits
 	 */
 	vioif_get_mac(sc);
 
-	sc->sc_rx_vq = virtio_alloc_vq(&sc->sc_virtio, 0,
-	    VIOIF_RX_QLEN, VIOIF_INDIRECT_MAX, "rx");
-	if (!sc->sc_rx_vq)
-		goto exit_alloc1;
-	virtio_stop_vq_intr(sc->sc_rx_vq);
-
-	sc->sc_tx_vq = virtio_alloc_vq(&sc->sc_virtio, 1,
-	    VIOIF_TX_QLEN, VIOIF_INDIRECT_MAX, "tx");
-	if (!sc->sc_rx_vq)
-		goto exit_alloc2;
-	virtio_stop_vq_intr(sc->sc_tx_vq);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		char name[16];
+
+		(void) snprintf(name, sizeof (name), "rx%d", i);
+		sc->sc_rxqs[i].rxq_vq = virtio_alloc_vq(&sc->sc_virtio, 2 * i,
+		    VIOIF_RX_QLEN, VIOIF_INDIRECT_MAX, name);
+		if (!sc->sc_rxqs[i].rxq_vq)
+			goto exit_alloc_vqs;
+		virtio_stop_vq_intr(sc->sc_rxqs[i].rxq_vq);
+
+		(void) snprintf(name, sizeof (name), "tx%d", i);
+		sc->sc_txqs[i].txq_vq = virtio_alloc_vq(&sc->sc_virtio,
+		    2 * i + 1, VIOIF_TX_QLEN, VIOIF_INDIRECT_MAX, name);
+		if (!sc->sc_txqs[i].txq_vq)
+			goto exit_alloc_vqs;
+		virtio_stop_vq_intr(sc->sc_txqs[i].txq_vq);
+	}
 
 	if (vioif_has_feature(sc, VIRTIO_NET_F_CTRL_VQ)) {
-		sc->sc_ctrl_vq = virtio_alloc_vq(&sc->sc_virtio, 2,
-		    VIOIF_CTRL_QLEN, 0, "ctrl");
-		if (!sc->sc_ctrl_vq) {
-			goto exit_alloc3;
-		}
+		/* The control queue comes after all of the host's pairs. */
+		sc->sc_ctrl_vq = virtio_alloc_vq(&sc->sc_virtio,
+		    vioif_has_feature(sc, VIRTIO_NET_F_MQ) ?
+		    2 * sc->sc_max_qpairs : 2,
+		    VIOIF_CTRL_QLEN, VIOIF_CTRL_INDIRECT, "ctrl");
+		if (!sc->sc_ctrl_vq)
+			goto exit_alloc_vqs;
 		virtio_stop_vq_intr(sc->sc_ctrl_vq);
+
+		if (vioif_alloc_ctrl(sc))
+			goto exit_alloc_vqs;
 	}
 
 	virtio_set_status(&sc->sc_virtio,
 	    VIRTIO_CONFIG_DEVICE_STATUS_DRIVER_OK);
 
+	/*
+	 * The device starts out using only the first queue pair, ask it to
+	 * spread traffic over the rest. If it refuses we carry on with one.
+	 */
+	sc->sc_nrings = 1;
+	if (sc->sc_nqpairs > 1) {
+		struct virtio_net_ctrl_mq mq;
+
+		mq.virtqueue_pairs = (uint16_t)sc->sc_nqpairs;
+		if (vioif_ctrl_cmd(sc, VIRTIO_NET_CTRL_MQ,
+		    VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &mq, sizeof (mq)) == 0) {
+			sc->sc_nrings = sc->sc_nqpairs;
+		} else {
+			dev_err(devinfo, CE_WARN, "Failed to enable %d queue "
+			    "pairs, using one", sc->sc_nqpairs);
+		}
+	}
+
 	sc->sc_rxloan = 0;
 
 	/* set some reasonable-small default values */
@@ -1815,8 +2442,12 @@ vioif_attach(dev_info_t *devinfo, ddi_attach_cmd_t cmd)
 
 	sc->sc_macp = macp;
 
-	/* Pre-fill the rx ring. */
-	(void) vioif_populate_rx(sc, KM_SLEEP);
+	/* Pre-fill the rx rings. */
+	for (i = 0; i < sc->sc_nrings; i++) {
+		mutex_enter(&sc->sc_rxqs[i].rxq_lock);
+		(void) vioif_populate_rx(&sc->sc_rxqs[i], KM_SLEEP);
+		mutex_exit(&sc->sc_rxqs[i].rxq_lock);
+	}
 
 	ret = mac_register(macp, &sc->sc_mac_handle);
 	if (ret != 0) {
@@ -1841,17 +2472,23 @@ exit_register:
 exit_macalloc:
 	vioif_free_mems(sc);
 exit_alloc_mems:
+exit_alloc_vqs:
 	virtio_release_ints(&sc->sc_virtio);
+	vioif_free_ctrl(sc);
 	if (sc->sc_ctrl_vq)
 		virtio_free_vq(sc->sc_ctrl_vq);
-exit_alloc3:
-	virtio_free_vq(sc->sc_tx_vq);
-exit_alloc2:
-	virtio_free_vq(sc->sc_rx_vq);
-exit_alloc1:
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		if (sc->sc_txqs[i].txq_vq)
+			virtio_free_vq(sc->sc_txqs[i].txq_vq);
+		if (sc->sc_rxqs[i].rxq_vq)
+			virtio_free_vq(sc->sc_rxqs[i].rxq_vq);
+		mutex_destroy(&sc->sc_rxqs[i].rxq_lock);
+	}
 exit_ints:
 	kmem_cache_destroy(sc->sc_rxbuf_cache);
 exit_cache:
+	kmem_free(sc->sc_rxqs, sizeof (struct vioif_rxq) * sc->sc_nqpairs);
+	kmem_free(sc->sc_txqs, sizeof (struct vioif_txq) * sc->sc_nqpairs);
 exit_features:
 	virtio_set_status(&sc->sc_virtio, VIRTIO_CONFIG_DEVICE_STATUS_FAILED);
 	ddi_regs_map_free(&sc->sc_virtio.sc_ioh);
@@ -1867,6 +2504,7 @@ static int
 vioif_detach(dev_info_t *devinfo, ddi_detach_cmd_t cmd)
 {
 	struct vioif_softc *sc;
+	int i;
 
 	if ((sc = ddi_get_driver_private(devinfo)) == NULL)
 		return (DDI_FAILURE);
@@ -1889,8 +2527,10 @@ vioif_detach(dev_info_t *devinfo, ddi_detach_cmd_t cmd)
 		return (DDI_FAILURE);
 	}
 
-	virtio_stop_vq_intr(sc->sc_rx_vq);
-	virtio_stop_vq_intr(sc->sc_tx_vq);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		virtio_stop_vq_intr(sc->sc_rxqs[i].rxq_vq);
+		virtio_stop_vq_intr(sc->sc_txqs[i].txq_vq);
+	}
 
 	virtio_release_ints(&sc->sc_virtio);
 
@@ -1901,14 +2541,22 @@ vioif_detach(dev_info_t *devinfo, ddi_detach_cmd_t cmd)
 	mac_free(sc->sc_macp);
 
 	vioif_free_mems(sc);
-	virtio_free_vq(sc->sc_rx_vq);
-	virtio_free_vq(sc->sc_tx_vq);
+	vioif_free_ctrl(sc);
+	if (sc->sc_ctrl_vq)
+		virtio_free_vq(sc->sc_ctrl_vq);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		virtio_free_vq(sc->sc_rxqs[i].rxq_vq);
+		virtio_free_vq(sc->sc_txqs[i].txq_vq);
+		mutex_destroy(&sc->sc_rxqs[i].rxq_lock);
+	}
 
 	virtio_device_reset(&sc->sc_virtio);
 
 	ddi_regs_map_free(&sc->sc_virtio.sc_ioh);
 
 	kmem_cache_destroy(sc->sc_rxbuf_cache);
+	kmem_free(sc->sc_rxqs, sizeof (struct vioif_rxq) * sc->sc_nqpairs);
+	kmem_free(sc->sc_txqs, sizeof (struct vioif_txq) * sc->sc_nqpairs);
 	kstat_delete(sc->sc_intrstat);
 	kmem_free(sc, sizeof (struct vioif_softc));
 
@@ -1919,12 +2567,15 @@ static int
 vioif_quiesce(dev_info_t *devinfo)
 {
 	struct vioif_softc *sc;
+	int i;
 
 	if ((sc = ddi_get_driver_private(devinfo)) == NULL)
 		return (DDI_FAILURE);
 
-	virtio_stop_vq_intr(sc->sc_rx_vq);
-	virtio_stop_vq_intr(sc->sc_tx_vq);
+	for (i = 0; i < sc->sc_nqpairs; i++) {
+		virtio_stop_vq_intr(sc->sc_rxqs[i].rxq_vq);
+		virtio_stop_vq_intr(sc->sc_txqs[i].txq_vq);
+	}
 	virtio_device_reset(&sc->sc_virtio);
 
 	return (DDI_SUCCESS);
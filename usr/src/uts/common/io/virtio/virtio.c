@@ -129,6 +129,9 @@ virtio_show_features(uint32_t features, char *buf, size_t len)
 	if (features & VIRTIO_F_RING_INDIRECT_DESC)
 		/* LINTED E_PTRDIFF_OVERFLOW */
 		buf += snprintf(buf, bufend - buf, "INDIRECT_DESC ");
+	if (features & VIRTIO_F_RING_EVENT_IDX)
+		/* LINTED E_PTRDIFF_OVERFLOW */
+		buf += snprintf(buf, bufend - buf, "EVENT_IDX ");
 
 	/* LINTED E_PTRDIFF_OVERFLOW */
 	buf += snprintf(buf, bufend - buf, ") ");
@@ -237,17 +240,28 @@ virtio_write_device_config_8(struct virtio_softc *sc, unsigned int index,
 
 /*
  * Start/stop vq interrupt.  No guarantee.
+ *
+ * With event indices the host ignores the flag, so we also move the used
+ * event: to the next entry to interrupt at once, or as far back as it goes
+ * to not interrupt until the ring has wrapped (which it won't while we
+ * aren't consuming).  The flag is still kept for virtio_pull_chain().
  */
 void
 virtio_stop_vq_intr(struct virtqueue *vq)
 {
 	vq->vq_avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+	if (vq->vq_event_idx)
+		VRING_USED_EVENT(vq) = vq->vq_used_idx - 1;
 }
 
 void
 virtio_start_vq_intr(struct virtqueue *vq)
 {
 	vq->vq_avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+	if (vq->vq_event_idx) {
+		VRING_USED_EVENT(vq) = vq->vq_used_idx;
+		membar_producer();
+	}
 }
 
 static ddi_dma_attr_t virtio_vq_dma_attr = {
@@ -443,12 +457,12 @@ virtio_alloc_vq(struct virtio_softc *sc, unsigned int index, unsigned int size,
 	if (size)
 		vq_size = MIN(vq_size, size);
 
-	/* allocsize1: descriptor table + avail ring + pad */
+	/* allocsize1: descriptor table + avail ring + used event + pad */
 	allocsize1 = VIRTQUEUE_ALIGN(sizeof (struct vring_desc) * vq_size +
-	    sizeof (struct vring_avail) + sizeof (uint16_t) * vq_size);
-	/* allocsize2: used ring + pad */
+	    sizeof (struct vring_avail) + sizeof (uint16_t) * (vq_size + 1));
+	/* allocsize2: used ring + avail event + pad */
 	allocsize2 = VIRTQUEUE_ALIGN(sizeof (struct vring_used) +
-	    sizeof (struct vring_used_elem) * vq_size);
+	    sizeof (struct vring_used_elem) * vq_size + sizeof (uint16_t));
 
 	allocsize = allocsize1 + allocsize2;
 
@@ -507,6 +521,8 @@ virtio_alloc_vq(struct virtio_softc *sc, unsigned int index, unsigned int size,
 	ASSERT(indirect_num == 0 ||
 	    virtio_has_feature(sc, VIRTIO_F_RING_INDIRECT_DESC));
 	vq->vq_indirect_num = indirect_num;
+	vq->vq_event_idx = virtio_has_feature(sc, VIRTIO_F_RING_EVENT_IDX) ?
+	    B_TRUE : B_FALSE;
 
 	/* free slot management */
 	vq->vq_entries = kmem_zalloc(sizeof (struct vq_entry) * vq_size,
@@ -678,6 +694,8 @@ void
 virtio_sync_vq(struct virtqueue *vq)
 {
 	struct virtio_softc *vsc = vq->vq_owner;
+	uint16_t old = vq->vq_avail->idx;
+	boolean_t notify;
 
 	/* Make sure the avail ring update hit the buffer */
 	membar_producer();
@@ -687,10 +705,23 @@ virtio_sync_vq(struct virtqueue *vq)
 	/* Make sure the avail idx update hits the buffer */
 	membar_producer();
 
-	/* Make sure we see the flags update */
-	membar_consumer();
+	/* Make sure we see the flags (or avail event) update */
+	membar_enter();
 
-	if (!(vq->vq_used->flags & VRING_USED_F_NO_NOTIFY)) {
+	/*
+	 * With event indices the host tells us how far it has got in the
+	 * ring; if it hasn't caught up to the entries published by the last
+	 * notification yet it will see these ones too, so a batch of chains
+	 * costs a single notification.
+	 */
+	if (vq->vq_event_idx) {
+		notify = VRING_NEED_EVENT(VRING_AVAIL_EVENT(vq),
+		    vq->vq_avail_idx, old);
+	} else {
+		notify = !(vq->vq_used->flags & VRING_USED_F_NO_NOTIFY);
+	}
+
+	if (notify) {
 		ddi_put16(vsc->sc_ioh,
 		    /* LINTED E_BAD_PTR_CAST_ALIGN */
 		    (uint16_t *)(vsc->sc_io_addr +
@@ -782,6 +813,16 @@ virtio_pull_chain(struct virtqueue *vq, uint32_t *len)
 
 	usedidx = vq->vq_used_idx;
 	vq->vq_used_idx++;
+
+	/*
+	 * Ask for an interrupt at the next completion. Once we have seen
+	 * the ring empty, anything the host adds lands past the event.
+	 */
+	if (vq->vq_event_idx &&
+	    !(vq->vq_avail->flags & VRING_AVAIL_F_NO_INTERRUPT)) {
+		VRING_USED_EVENT(vq) = vq->vq_used_idx;
+		membar_enter();
+	}
 	mutex_exit(&vq->vq_used_lock);
 
 	usedidx %= vq->vq_num;
@@ -87,6 +87,7 @@
 
 #define	VIRTIO_F_NOTIFY_ON_EMPTY		(1<<24)
 #define	VIRTIO_F_RING_INDIRECT_DESC		(1<<28)
+#define	VIRTIO_F_RING_EVENT_IDX			(1<<29)
 #define	VIRTIO_F_BAD_FEATURE			(1<<30)
 
 #define	VIRTIO_CONFIG_QUEUE_ADDRESS		8 /* 32bit */
@@ -171,6 +172,20 @@ struct vring_used {
 	struct vring_used_elem ring[];
 } __attribute__((packed));
 
+/*
+ * With VIRTIO_F_RING_EVENT_IDX, each ring is followed by one more index:
+ * the guest puts the used index it wants an interrupt at after the avail
+ * ring, the host puts the avail index it wants a notification at after the
+ * used ring. The flags above are then ignored.
+ */
+#define	VRING_USED_EVENT(vq)	((vq)->vq_avail->ring[(vq)->vq_num])
+#define	VRING_AVAIL_EVENT(vq)	\
+	(*(volatile uint16_t *)&(vq)->vq_used->ring[(vq)->vq_num])
+
+/* Has idx moved past event on its way from old to new? */
+#define	VRING_NEED_EVENT(event, new, old)	\
+	((uint16_t)((new) - (event) - 1) < (uint16_t)((new) - (old)))
+
 
 /* Got nothing to do with the system page size, just a confusing name. */
 #define	VIRTIO_PAGE_SIZE	(4096)
@@ -98,6 +98,7 @@ struct virtqueue {
 	struct virtio_softc	*vq_owner;
 	unsigned int		vq_num; /* queue size (# of entries) */
 	unsigned int		vq_indirect_num;
+	boolean_t		vq_event_idx; /* VIRTIO_F_RING_EVENT_IDX */
 	int			vq_index; /* queue number (0, 1, ...) */
 
 	/* vring pointers (KVA) */
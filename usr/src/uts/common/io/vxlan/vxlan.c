@@ -0,0 +1,1169 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * VXLAN (vxlan) driver: pseudo GLDv3 Ethernet links whose frames are
+ * carried between hosts in UDP, as described in RFC 7348.
+ *
+ * Links that share a zone and a UDP port share a vxlan_mux_t, which owns
+ * the kernel sockets that carry their traffic.  Received datagrams are
+ * handed to vxlan_rx() by sockfs as they arrive, in UDP's receive context,
+ * so a frame goes from the underlying NIC to the overlay link's clients
+ * without being queued or copied.  Frames sent on a link are prefixed with
+ * a VXLAN header and handed to UDP with ksocket_sendmblk(), so the outer
+ * UDP checksum is left to the underlying interface's offload, as for any
+ * other UDP traffic.  The VTEP a frame goes to is chosen by the link's
+ * lookup module; see vxlan_lookup_ops_t.
+ */
+
+#include <sys/policy.h>
+#include <sys/conf.h>
+#include <sys/modctl.h>
+#include <sys/dlpi.h>
+#include <sys/ethernet.h>
+#include <sys/mac.h>
+#include <sys/dls.h>
+#include <sys/mac_ether.h>
+#include <sys/mac_provider.h>
+#include <sys/mac_client_priv.h>
+#include <sys/vlan.h>
+#include <sys/random.h>
+#include <sys/sysmacros.h>
+#include <sys/list.h>
+#include <sys/avl.h>
+#include <sys/strsubr.h>
+#include <sys/strsun.h>
+#include <sys/atomic.h>
+#include <sys/zone.h>
+#include <sys/socket.h>
+#include <sys/ksocket.h>
+#include <sys/sunddi.h>
+#include <netinet/in.h>
+#include <net/vxlan.h>
+
+#include "vxlan_impl.h"
+
+#define	VXLANINFO		"VXLAN Overlay Network Driver"
+
+/*
+ * The number of sockets each mux sends from.  Each is bound to its own
+ * ephemeral port, which becomes the outer UDP source port of the flows
+ * hashed to it; receivers spread VXLAN traffic across their rings by that
+ * port, so more sockets mean finer spreading.
+ */
+uint_t vxlan_tx_sockets = 16;
+
+static dev_info_t *vxlan_dip;
+
+static int vxlan_getinfo(dev_info_t *, ddi_info_cmd_t, void *, void **);
+static int vxlan_attach(dev_info_t *, ddi_attach_cmd_t);
+static int vxlan_detach(dev_info_t *, ddi_detach_cmd_t);
+static int vxlan_ioc_create(void *, intptr_t, int, cred_t *, int *);
+static int vxlan_ioc_delete(void *, intptr_t, int, cred_t *, int *);
+static int vxlan_ioc_info(void *, intptr_t, int, cred_t *, int *);
+static int vxlan_ioc_entry_add(void *, intptr_t, int, cred_t *, int *);
+static int vxlan_ioc_entry_delete(void *, intptr_t, int, cred_t *, int *);
+static void vxlan_rx(ksocket_t, mblk_t *, size_t, int, void *);
+
+static dld_ioc_info_t vxlan_ioc_list[] = {
+	{VXLAN_IOC_CREATE, DLDCOPYINOUT, sizeof (vxlan_ioc_create_t),
+	    vxlan_ioc_create, secpolicy_dl_config},
+	{VXLAN_IOC_DELETE, DLDCOPYIN, sizeof (vxlan_ioc_delete_t),
+	    vxlan_ioc_delete, secpolicy_dl_config},
+	{VXLAN_IOC_INFO, DLDCOPYINOUT, sizeof (vxlan_ioc_info_t),
+	    vxlan_ioc_info, NULL},
+	{VXLAN_IOC_ENTRY_ADD, DLDCOPYIN, sizeof (vxlan_ioc_entry_t),
+	    vxlan_ioc_entry_add, secpolicy_dl_config},
+	{VXLAN_IOC_ENTRY_DELETE, DLDCOPYIN, sizeof (vxlan_ioc_entry_t),
+	    vxlan_ioc_entry_delete, secpolicy_dl_config}
+};
+
+DDI_DEFINE_STREAM_OPS(vxlan_dev_ops, nulldev, nulldev, vxlan_attach,
+    vxlan_detach, nodev, vxlan_getinfo, D_MP, NULL,
+    ddi_quiesce_not_supported);
+
+static struct modldrv vxlan_modldrv = {
+	&mod_driverops,		/* Type of module.  This one is a driver */
+	VXLANINFO,		/* short description */
+	&vxlan_dev_ops		/* driver specific ops */
+};
+
+static struct modlinkage modlinkage = {
+	MODREV_1, &vxlan_modldrv, NULL
+};
+
+/* MAC callback function declarations */
+static int vxlan_m_start(void *);
+static void vxlan_m_stop(void *);
+static int vxlan_m_promisc(void *, boolean_t);
+static int vxlan_m_multicst(void *, boolean_t, const uint8_t *);
+static int vxlan_m_unicst(void *, const uint8_t *);
+static int vxlan_m_stat(void *, uint_t, uint64_t *);
+static mblk_t *vxlan_m_tx(void *, mblk_t *);
+
+static mac_callbacks_t vxlan_m_callbacks = {
+	0,
+	vxlan_m_stat,
+	vxlan_m_start,
+	vxlan_m_stop,
+	vxlan_m_promisc,
+	vxlan_m_multicst,
+	vxlan_m_unicst,
+	vxlan_m_tx
+};
+
+/*
+ * vxlan_lock protects the device list and the mux list, and is held
+ * across each ioctl; vm_lock in each mux protects its AVL tree of devices,
+ * which the receive path searches.
+ */
+static krwlock_t	vxlan_lock;
+static list_t		vxlan_dev_list;
+static list_t		vxlan_mux_list;
+static int		vxlan_count;	/* Num of vxlan instances */
+
+/*
+ * The registered lookup modules.  These are set up in _init() rather
+ * than attach(), so that modules can register before any link exists.
+ */
+static kmutex_t		vxlan_lookup_lock;
+static list_t		vxlan_lookup_list;
+
+static const vxlan_lookup_ops_t vxlan_direct_ops;
+
+int
+_init(void)
+{
+	int	status;
+
+	mutex_init(&vxlan_lookup_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&vxlan_lookup_list, sizeof (vxlan_lookup_t),
+	    offsetof(vxlan_lookup_t, vl_node));
+	VERIFY0(vxlan_lookup_register(&vxlan_direct_ops));
+
+	mac_init_ops(&vxlan_dev_ops, "vxlan");
+	status = mod_install(&modlinkage);
+	if (status != DDI_SUCCESS) {
+		mac_fini_ops(&vxlan_dev_ops);
+		VERIFY0(vxlan_lookup_unregister(&vxlan_direct_ops));
+		list_destroy(&vxlan_lookup_list);
+		mutex_destroy(&vxlan_lookup_lock);
+	}
+
+	return (status);
+}
+
+int
+_fini(void)
+{
+	int	status;
+
+	/* Modules that registered with us depend on us */
+	mutex_enter(&vxlan_lookup_lock);
+	if (list_head(&vxlan_lookup_list) != list_tail(&vxlan_lookup_list)) {
+		mutex_exit(&vxlan_lookup_lock);
+		return (EBUSY);
+	}
+	mutex_exit(&vxlan_lookup_lock);
+
+	status = mod_remove(&modlinkage);
+	if (status == DDI_SUCCESS) {
+		mac_fini_ops(&vxlan_dev_ops);
+		VERIFY0(vxlan_lookup_unregister(&vxlan_direct_ops));
+		list_destroy(&vxlan_lookup_list);
+		mutex_destroy(&vxlan_lookup_lock);
+	}
+
+	return (status);
+}
+
+int
+_info(struct modinfo *modinfop)
+{
+	return (mod_info(&modlinkage, modinfop));
+}
+
+static void
+vxlan_init(void)
+{
+	rw_init(&vxlan_lock, NULL, RW_DEFAULT, NULL);
+	list_create(&vxlan_dev_list, sizeof (vxlan_dev_t),
+	    offsetof(vxlan_dev_t, vd_listnode));
+	list_create(&vxlan_mux_list, sizeof (vxlan_mux_t),
+	    offsetof(vxlan_mux_t, vm_node));
+}
+
+static void
+vxlan_fini(void)
+{
+	ASSERT(vxlan_count == 0);
+	rw_destroy(&vxlan_lock);
+	list_destroy(&vxlan_dev_list);
+	list_destroy(&vxlan_mux_list);
+}
+
+/*ARGSUSED*/
+static int
+vxlan_getinfo(dev_info_t *dip, ddi_info_cmd_t infocmd, void *arg,
+    void **result)
+{
+	switch (infocmd) {
+	case DDI_INFO_DEVT2DEVINFO:
+		*result = vxlan_dip;
+		return (DDI_SUCCESS);
+	case DDI_INFO_DEVT2INSTANCE:
+		*result = NULL;
+		return (DDI_SUCCESS);
+	}
+	return (DDI_FAILURE);
+}
+
+static int
+vxlan_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_ATTACH:
+		if (ddi_get_instance(dip) != 0) {
+			/* we only allow instance 0 to attach */
+			return (DDI_FAILURE);
+		}
+
+		if (dld_ioc_register(VXLAN_IOC, vxlan_ioc_list,
+		    DLDIOCCNT(vxlan_ioc_list)) != 0)
+			return (DDI_FAILURE);
+
+		vxlan_dip = dip;
+		vxlan_init();
+		return (DDI_SUCCESS);
+
+	case DDI_RESUME:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+}
+
+/*ARGSUSED*/
+static int
+vxlan_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_DETACH:
+		/*
+		 * Allow the vxlan instance to be detached only if there
+		 * are no vxlan links configured.
+		 */
+		if (vxlan_count > 0)
+			return (DDI_FAILURE);
+
+		dld_ioc_unregister(VXLAN_IOC);
+		vxlan_fini();
+		vxlan_dip = NULL;
+		return (DDI_SUCCESS);
+
+	case DDI_SUSPEND:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+}
+
+/*
+ * Lookup module registration.
+ */
+
+/* Caller must hold vxlan_lookup_lock */
+static vxlan_lookup_t *
+vxlan_lookup_find(const char *name)
+{
+	vxlan_lookup_t *vl;
+
+	ASSERT(MUTEX_HELD(&vxlan_lookup_lock));
+	for (vl = list_head(&vxlan_lookup_list); vl != NULL;
+	    vl = list_next(&vxlan_lookup_list, vl)) {
+		if (strcmp(vl->vl_ops->vlo_name, name) == 0)
+			return (vl);
+	}
+
+	return (NULL);
+}
+
+int
+vxlan_lookup_register(const vxlan_lookup_ops_t *ops)
+{
+	vxlan_lookup_t *vl;
+
+	if (ops->vlo_version != VXLAN_LOOKUP_VERSION)
+		return (ENOTSUP);
+	if (ops->vlo_name == NULL ||
+	    strlen(ops->vlo_name) >= VXLAN_LOOKUP_NAMELEN ||
+	    ops->vlo_init == NULL || ops->vlo_fini == NULL ||
+	    ops->vlo_lookup == NULL)
+		return (EINVAL);
+
+	vl = kmem_zalloc(sizeof (*vl), KM_SLEEP);
+	vl->vl_ops = ops;
+
+	mutex_enter(&vxlan_lookup_lock);
+	if (vxlan_lookup_find(ops->vlo_name) != NULL) {
+		mutex_exit(&vxlan_lookup_lock);
+		kmem_free(vl, sizeof (*vl));
+		return (EEXIST);
+	}
+	list_insert_tail(&vxlan_lookup_list, vl);
+	mutex_exit(&vxlan_lookup_lock);
+	return (0);
+}
+
+int
+vxlan_lookup_unregister(const vxlan_lookup_ops_t *ops)
+{
+	vxlan_lookup_t *vl;
+
+	mutex_enter(&vxlan_lookup_lock);
+	if ((vl = vxlan_lookup_find(ops->vlo_name)) == NULL ||
+	    vl->vl_ops != ops) {
+		mutex_exit(&vxlan_lookup_lock);
+		return (ENOENT);
+	}
+	if (vl->vl_refcnt != 0) {
+		mutex_exit(&vxlan_lookup_lock);
+		return (EBUSY);
+	}
+	list_remove(&vxlan_lookup_list, vl);
+	mutex_exit(&vxlan_lookup_lock);
+	kmem_free(vl, sizeof (*vl));
+	return (0);
+}
+
+static vxlan_lookup_t *
+vxlan_lookup_hold(const char *name)
+{
+	vxlan_lookup_t *vl;
+
+	mutex_enter(&vxlan_lookup_lock);
+	if ((vl = vxlan_lookup_find(name)) != NULL)
+		vl->vl_refcnt++;
+	mutex_exit(&vxlan_lookup_lock);
+	return (vl);
+}
+
+static void
+vxlan_lookup_rele(vxlan_lookup_t *vl)
+{
+	mutex_enter(&vxlan_lookup_lock);
+	ASSERT(vl->vl_refcnt > 0);
+	vl->vl_refcnt--;
+	mutex_exit(&vxlan_lookup_lock);
+}
+
+/*
+ * The built-in lookup module: a table of MAC addresses and the VTEPs
+ * behind them, maintained with the ENTRY ioctls.
+ */
+
+typedef struct vxlan_direct_ent {
+	avl_node_t		vde_node;
+	uint8_t			vde_mac[ETHERADDRL];
+	struct sockaddr_in6	vde_dest;
+} vxlan_direct_ent_t;
+
+typedef struct vxlan_direct {
+	krwlock_t		vdr_lock;
+	avl_tree_t		vdr_ents;
+} vxlan_direct_t;
+
+static int
+vxlan_direct_cmp(const void *a, const void *b)
+{
+	const vxlan_direct_ent_t *ea = a;
+	const vxlan_direct_ent_t *eb = b;
+	int cmp;
+
+	cmp = bcmp(ea->vde_mac, eb->vde_mac, ETHERADDRL);
+	return (cmp < 0 ? -1 : cmp > 0 ? 1 : 0);
+}
+
+/*ARGSUSED*/
+static int
+vxlan_direct_init(datalink_id_t link_id, uint32_t vni, void **argp)
+{
+	vxlan_direct_t *vdr;
+
+	vdr = kmem_zalloc(sizeof (*vdr), KM_SLEEP);
+	rw_init(&vdr->vdr_lock, NULL, RW_DEFAULT, NULL);
+	avl_create(&vdr->vdr_ents, vxlan_direct_cmp,
+	    sizeof (vxlan_direct_ent_t),
+	    offsetof(vxlan_direct_ent_t, vde_node));
+	*argp = vdr;
+	return (0);
+}
+
+static void
+vxlan_direct_fini(void *arg)
+{
+	vxlan_direct_t *vdr = arg;
+	vxlan_direct_ent_t *vde;
+	void *cookie = NULL;
+
+	while ((vde = avl_destroy_nodes(&vdr->vdr_ents, &cookie)) != NULL)
+		kmem_free(vde, sizeof (*vde));
+	avl_destroy(&vdr->vdr_ents);
+	rw_destroy(&vdr->vdr_lock);
+	kmem_free(vdr, sizeof (*vdr));
+}
+
+static int
+vxlan_direct_lookup(void *arg, const uint8_t *mac, struct sockaddr_in6 *dest)
+{
+	vxlan_direct_t *vdr = arg;
+	vxlan_direct_ent_t key, *vde;
+	int err = ENOENT;
+
+	bcopy(mac, key.vde_mac, ETHERADDRL);
+	rw_enter(&vdr->vdr_lock, RW_READER);
+	if ((vde = avl_find(&vdr->vdr_ents, &key, NULL)) != NULL) {
+		*dest = vde->vde_dest;
+		err = 0;
+	}
+	rw_exit(&vdr->vdr_lock);
+	return (err);
+}
+
+static int
+vxlan_direct_add(void *arg, const uint8_t *mac,
+    const struct sockaddr_in6 *dest)
+{
+	vxlan_direct_t *vdr = arg;
+	vxlan_direct_ent_t *vde, *old;
+	avl_index_t where;
+
+	vde = kmem_zalloc(sizeof (*vde), KM_SLEEP);
+	bcopy(mac, vde->vde_mac, ETHERADDRL);
+	vde->vde_dest = *dest;
+
+	rw_enter(&vdr->vdr_lock, RW_WRITER);
+	if ((old = avl_find(&vdr->vdr_ents, vde, &where)) != NULL) {
+		/* Replace the existing entry's destination */
+		old->vde_dest = *dest;
+		rw_exit(&vdr->vdr_lock);
+		kmem_free(vde, sizeof (*vde));
+		return (0);
+	}
+	avl_insert(&vdr->vdr_ents, vde, where);
+	rw_exit(&vdr->vdr_lock);
+	return (0);
+}
+
+static int
+vxlan_direct_remove(void *arg, const uint8_t *mac)
+{
+	vxlan_direct_t *vdr = arg;
+	vxlan_direct_ent_t key, *vde;
+
+	bcopy(mac, key.vde_mac, ETHERADDRL);
+	rw_enter(&vdr->vdr_lock, RW_WRITER);
+	if ((vde = avl_find(&vdr->vdr_ents, &key, NULL)) == NULL) {
+		rw_exit(&vdr->vdr_lock);
+		return (ENOENT);
+	}
+	avl_remove(&vdr->vdr_ents, vde);
+	rw_exit(&vdr->vdr_lock);
+	kmem_free(vde, sizeof (*vde));
+	return (0);
+}
+
+static const vxlan_lookup_ops_t vxlan_direct_ops = {
+	VXLAN_LOOKUP_VERSION,
+	VXLAN_LOOKUP_DIRECT,
+	vxlan_direct_init,
+	vxlan_direct_fini,
+	vxlan_direct_lookup,
+	vxlan_direct_add,
+	vxlan_direct_remove
+};
+
+/*
+ * Muxes.
+ */
+
+static int
+vxlan_dev_vni_cmp(const void *a, const void *b)
+{
+	const vxlan_dev_t *da = a;
+	const vxlan_dev_t *db = b;
+
+	if (da->vd_vni < db->vd_vni)
+		return (-1);
+	return (da->vd_vni > db->vd_vni ? 1 : 0);
+}
+
+static int
+vxlan_sock_bind(ksocket_t ks, uint16_t port, cred_t *cr)
+{
+	struct sockaddr_in6 sin6;
+
+	bzero(&sin6, sizeof (sin6));
+	sin6.sin6_family = AF_INET6;
+	sin6.sin6_port = htons(port);
+	return (ksocket_bind(ks, (struct sockaddr *)&sin6, sizeof (sin6), cr));
+}
+
+static void
+vxlan_mux_free(vxlan_mux_t *mux)
+{
+	uint_t i;
+
+	/*
+	 * Closing the receive socket waits for UDP to finish any upcall in
+	 * progress, so vxlan_rx() is done with the mux once this returns.
+	 */
+	if (mux->vm_rxsock != NULL)
+		(void) ksocket_close(mux->vm_rxsock, mux->vm_cred);
+	for (i = 0; i < mux->vm_ntxsocks; i++) {
+		if (mux->vm_txsocks[i] != NULL)
+			(void) ksocket_close(mux->vm_txsocks[i], mux->vm_cred);
+	}
+	if (mux->vm_txsocks != NULL) {
+		kmem_free(mux->vm_txsocks,
+		    mux->vm_ntxsocks * sizeof (ksocket_t));
+	}
+	ASSERT(avl_numnodes(&mux->vm_devs) == 0);
+	avl_destroy(&mux->vm_devs);
+	rw_destroy(&mux->vm_lock);
+	crfree(mux->vm_cred);
+	kmem_free(mux, sizeof (*mux));
+}
+
+/*
+ * Find the mux for a zone and port, creating it if need be, and take a
+ * reference on it.  Caller must hold writer vxlan_lock.
+ */
+static int
+vxlan_mux_hold(zoneid_t zoneid, uint16_t port, vxlan_mux_t **muxp)
+{
+	vxlan_mux_t *mux;
+	cred_t *cr;
+	uint_t i;
+	int err;
+
+	ASSERT(RW_WRITE_HELD(&vxlan_lock));
+	for (mux = list_head(&vxlan_mux_list); mux != NULL;
+	    mux = list_next(&vxlan_mux_list, mux)) {
+		if (mux->vm_zoneid == zoneid && mux->vm_port == port) {
+			mux->vm_refcnt++;
+			*muxp = mux;
+			return (0);
+		}
+	}
+
+	/* The sockets belong to the zone, not to whoever made the link */
+	if ((cr = zone_get_kcred(zoneid)) == NULL)
+		return (ENOENT);
+
+	mux = kmem_zalloc(sizeof (*mux), KM_SLEEP);
+	mux->vm_zoneid = zoneid;
+	mux->vm_port = port;
+	mux->vm_cred = cr;
+	rw_init(&mux->vm_lock, NULL, RW_DEFAULT, NULL);
+	avl_create(&mux->vm_devs, vxlan_dev_vni_cmp, sizeof (vxlan_dev_t),
+	    offsetof(vxlan_dev_t, vd_muxnode));
+
+	if ((err = ksocket_socket(&mux->vm_rxsock, AF_INET6, SOCK_DGRAM, 0,
+	    KSOCKET_SLEEP, cr)) != 0) {
+		mux->vm_rxsock = NULL;
+		goto fail;
+	}
+	if ((err = ksocket_krecv_set(mux->vm_rxsock, vxlan_rx, mux)) != 0 ||
+	    (err = vxlan_sock_bind(mux->vm_rxsock, port, cr)) != 0)
+		goto fail;
+
+	mux->vm_ntxsocks = MAX(vxlan_tx_sockets, 1);
+	mux->vm_txsocks = kmem_zalloc(mux->vm_ntxsocks * sizeof (ksocket_t),
+	    KM_SLEEP);
+	for (i = 0; i < mux->vm_ntxsocks; i++) {
+		if ((err = ksocket_socket(&mux->vm_txsocks[i], AF_INET6,
+		    SOCK_DGRAM, 0, KSOCKET_SLEEP, cr)) != 0) {
+			mux->vm_txsocks[i] = NULL;
+			goto fail;
+		}
+		if ((err = vxlan_sock_bind(mux->vm_txsocks[i], 0, cr)) != 0)
+			goto fail;
+	}
+
+	mux->vm_refcnt = 1;
+	list_insert_tail(&vxlan_mux_list, mux);
+	*muxp = mux;
+	return (0);
+
+fail:
+	vxlan_mux_free(mux);
+	return (err);
+}
+
+/* Caller must hold writer vxlan_lock */
+static void
+vxlan_mux_rele(vxlan_mux_t *mux)
+{
+	ASSERT(RW_WRITE_HELD(&vxlan_lock));
+	ASSERT(mux->vm_refcnt > 0);
+	if (--mux->vm_refcnt != 0)
+		return;
+
+	list_remove(&vxlan_mux_list, mux);
+	vxlan_mux_free(mux);
+}
+
+/*
+ * Devices.
+ */
+
+/* Caller must hold vxlan_lock */
+static vxlan_dev_t *
+vxlan_dev_lookup(datalink_id_t link_id)
+{
+	vxlan_dev_t *vdev;
+
+	ASSERT(RW_LOCK_HELD(&vxlan_lock));
+	for (vdev = list_head(&vxlan_dev_list); vdev != NULL;
+	    vdev = list_next(&vxlan_dev_list, vdev)) {
+		if (vdev->vd_link_id == link_id)
+			return (vdev);
+	}
+
+	return (NULL);
+}
+
+static int
+vxlan_init_mac(vxlan_dev_t *vdev)
+{
+	mac_register_t *mac;
+	int err;
+
+	if ((mac = mac_alloc(MAC_VERSION)) == NULL)
+		return (ENOMEM);
+
+	mac->m_type_ident = MAC_PLUGIN_IDENT_ETHER;
+	mac->m_driver = vdev;
+	mac->m_dip = vxlan_dip;
+	mac->m_instance = (uint_t)-1;
+	mac->m_src_addr = vdev->vd_mac_addr;
+	mac->m_callbacks = &vxlan_m_callbacks;
+	mac->m_min_sdu = 0;
+	mac->m_max_sdu = vdev->vd_mtu;
+	mac->m_margin = VLAN_TAGSZ;
+	err = mac_register(mac, &vdev->vd_mh);
+	mac_free(mac);
+	return (err);
+}
+
+static void
+vxlan_dev_free(vxlan_dev_t *vdev)
+{
+	if (vdev->vd_mh != NULL)
+		(void) mac_unregister(vdev->vd_mh);
+	if (vdev->vd_lookup != NULL) {
+		if (vdev->vd_lookup_arg != NULL)
+			vdev->vd_lookup->vl_ops->vlo_fini(vdev->vd_lookup_arg);
+		vxlan_lookup_rele(vdev->vd_lookup);
+	}
+	kmem_free(vdev, sizeof (*vdev));
+}
+
+/* ARGSUSED */
+static int
+vxlan_ioc_create(void *karg, intptr_t arg, int mode, cred_t *cred, int *rvalp)
+{
+	vxlan_ioc_create_t *create_arg = karg;
+	vxlan_dev_t *vdev;
+	vxlan_mux_t *mux;
+	const vxlan_lookup_ops_t *ops;
+	uint16_t port;
+	int err;
+
+	if (create_arg->vic_vni > VXLAN_VNI_MAX)
+		return (EINVAL);
+	if (create_arg->vic_mtu > VXLAN_MAX_MTU)
+		return (EINVAL);
+	if (create_arg->vic_mac_len != 0 &&
+	    create_arg->vic_mac_len != ETHERADDRL)
+		return (EINVAL);
+	if (create_arg->vic_default.sin6_family != 0 &&
+	    create_arg->vic_default.sin6_family != AF_INET6)
+		return (EAFNOSUPPORT);
+
+	create_arg->vic_lookup[VXLAN_LOOKUP_NAMELEN - 1] = '\0';
+	if (create_arg->vic_lookup[0] == '\0') {
+		(void) strlcpy(create_arg->vic_lookup, VXLAN_LOOKUP_DIRECT,
+		    VXLAN_LOOKUP_NAMELEN);
+	}
+	port = create_arg->vic_port != 0 ? create_arg->vic_port : VXLAN_PORT;
+
+	vdev = kmem_zalloc(sizeof (*vdev), KM_SLEEP);
+	vdev->vd_link_id = create_arg->vic_link_id;
+	vdev->vd_zoneid = crgetzoneid(cred);
+	vdev->vd_vni = create_arg->vic_vni;
+	vdev->vd_mtu = create_arg->vic_mtu != 0 ? create_arg->vic_mtu :
+	    VXLAN_DEFAULT_MTU;
+	vdev->vd_default = create_arg->vic_default;
+
+	/* VXLAN links created from configuration on boot pass saved MAC */
+	if (create_arg->vic_mac_len == 0) {
+		/* Generate random MAC address */
+		(void) random_get_pseudo_bytes(vdev->vd_mac_addr, ETHERADDRL);
+		/* Ensure MAC address is not multicast and is local */
+		vdev->vd_mac_addr[0] = (vdev->vd_mac_addr[0] & ~1) | 2;
+	} else {
+		(void) memcpy(vdev->vd_mac_addr, create_arg->vic_mac_addr,
+		    ETHERADDRL);
+	}
+	vdev->vd_mac_len = ETHERADDRL;
+
+	if ((vdev->vd_lookup = vxlan_lookup_hold(create_arg->vic_lookup)) ==
+	    NULL) {
+		kmem_free(vdev, sizeof (*vdev));
+		return (ENOENT);
+	}
+	ops = vdev->vd_lookup->vl_ops;
+	if ((err = ops->vlo_init(vdev->vd_link_id, vdev->vd_vni,
+	    &vdev->vd_lookup_arg)) != 0) {
+		vdev->vd_lookup_arg = NULL;
+		vxlan_dev_free(vdev);
+		return (err);
+	}
+
+	rw_enter(&vxlan_lock, RW_WRITER);
+	if (vxlan_dev_lookup(vdev->vd_link_id) != NULL) {
+		rw_exit(&vxlan_lock);
+		vxlan_dev_free(vdev);
+		return (EEXIST);
+	}
+
+	if ((err = vxlan_mux_hold(vdev->vd_zoneid, port, &mux)) != 0) {
+		rw_exit(&vxlan_lock);
+		vxlan_dev_free(vdev);
+		return (err);
+	}
+	vdev->vd_mux = mux;
+
+	rw_enter(&mux->vm_lock, RW_READER);
+	if (avl_find(&mux->vm_devs, vdev, NULL) != NULL)
+		err = EEXIST;
+	rw_exit(&mux->vm_lock);
+	if (err != 0 ||
+	    (err = vxlan_init_mac(vdev)) != 0 ||
+	    (err = dls_devnet_create(vdev->vd_mh, vdev->vd_link_id,
+	    vdev->vd_zoneid)) != 0) {
+		vxlan_mux_rele(mux);
+		rw_exit(&vxlan_lock);
+		vxlan_dev_free(vdev);
+		return (err);
+	}
+
+	rw_enter(&mux->vm_lock, RW_WRITER);
+	avl_add(&mux->vm_devs, vdev);
+	rw_exit(&mux->vm_lock);
+
+	mac_link_update(vdev->vd_mh, LINK_STATE_UP);
+	mac_tx_update(vdev->vd_mh);
+	list_insert_tail(&vxlan_dev_list, vdev);
+	vxlan_count++;
+
+	/* Always return MAC address back to caller */
+	(void) memcpy(create_arg->vic_mac_addr, vdev->vd_mac_addr,
+	    vdev->vd_mac_len);
+	create_arg->vic_mac_len = vdev->vd_mac_len;
+	rw_exit(&vxlan_lock);
+	return (0);
+}
+
+/* ARGSUSED */
+static int
+vxlan_ioc_delete(void *karg, intptr_t arg, int mode, cred_t *cred, int *rvalp)
+{
+	vxlan_ioc_delete_t *delete_arg = karg;
+	vxlan_dev_t *vdev;
+	vxlan_mux_t *mux;
+	datalink_id_t tmpid;
+	int err;
+
+	rw_enter(&vxlan_lock, RW_WRITER);
+	if ((vdev = vxlan_dev_lookup(delete_arg->vid_link_id)) == NULL ||
+	    vdev->vd_zoneid != crgetzoneid(cred)) {
+		rw_exit(&vxlan_lock);
+		return (ENOENT);
+	}
+
+	if ((err = dls_devnet_destroy(vdev->vd_mh, &tmpid, B_TRUE)) != 0) {
+		rw_exit(&vxlan_lock);
+		return (err);
+	}
+	ASSERT(vdev->vd_link_id == tmpid);
+
+	/* Stop the receive path from finding the device */
+	mux = vdev->vd_mux;
+	rw_enter(&mux->vm_lock, RW_WRITER);
+	avl_remove(&mux->vm_devs, vdev);
+	rw_exit(&mux->vm_lock);
+
+	/* Try disabling the MAC */
+	if ((err = mac_disable(vdev->vd_mh)) != 0) {
+		rw_enter(&mux->vm_lock, RW_WRITER);
+		avl_add(&mux->vm_devs, vdev);
+		rw_exit(&mux->vm_lock);
+		(void) dls_devnet_create(vdev->vd_mh, vdev->vd_link_id,
+		    vdev->vd_zoneid);
+		rw_exit(&vxlan_lock);
+		return (err);
+	}
+
+	list_remove(&vxlan_dev_list, vdev);
+	vxlan_count--;
+	vxlan_mux_rele(mux);
+	rw_exit(&vxlan_lock);
+	vxlan_dev_free(vdev);
+	return (0);
+}
+
+/* ARGSUSED */
+static int
+vxlan_ioc_info(void *karg, intptr_t arg, int mode, cred_t *cred, int *rvalp)
+{
+	vxlan_ioc_info_t *info_arg = karg;
+	vxlan_dev_t *vdev;
+
+	/* Make sure that the vxlan link is visible from the caller's zone. */
+	if (!dls_devnet_islinkvisible(info_arg->vii_link_id, crgetzoneid(cred)))
+		return (ENOENT);
+
+	rw_enter(&vxlan_lock, RW_READER);
+	if ((vdev = vxlan_dev_lookup(info_arg->vii_link_id)) == NULL) {
+		rw_exit(&vxlan_lock);
+		return (ENOENT);
+	}
+
+	info_arg->vii_vni = vdev->vd_vni;
+	info_arg->vii_port = vdev->vd_mux->vm_port;
+	info_arg->vii_mtu = vdev->vd_mtu;
+	(void) memcpy(info_arg->vii_mac_addr, vdev->vd_mac_addr,
+	    vdev->vd_mac_len);
+	info_arg->vii_mac_len = vdev->vd_mac_len;
+	info_arg->vii_default = vdev->vd_default;
+	(void) strlcpy(info_arg->vii_lookup,
+	    vdev->vd_lookup->vl_ops->vlo_name, VXLAN_LOOKUP_NAMELEN);
+	rw_exit(&vxlan_lock);
+	return (0);
+}
+
+static int
+vxlan_ioc_entry(vxlan_ioc_entry_t *entry_arg, boolean_t add, cred_t *cred)
+{
+	vxlan_dev_t *vdev;
+	const vxlan_lookup_ops_t *ops;
+	int err;
+
+	if (add && entry_arg->vie_dest.sin6_family != AF_INET6)
+		return (EAFNOSUPPORT);
+
+	rw_enter(&vxlan_lock, RW_READER);
+	if ((vdev = vxlan_dev_lookup(entry_arg->vie_link_id)) == NULL ||
+	    vdev->vd_zoneid != crgetzoneid(cred)) {
+		rw_exit(&vxlan_lock);
+		return (ENOENT);
+	}
+
+	ops = vdev->vd_lookup->vl_ops;
+	if (add) {
+		err = ops->vlo_add == NULL ? ENOTSUP :
+		    ops->vlo_add(vdev->vd_lookup_arg, entry_arg->vie_mac,
+		    &entry_arg->vie_dest);
+	} else {
+		err = ops->vlo_remove == NULL ? ENOTSUP :
+		    ops->vlo_remove(vdev->vd_lookup_arg, entry_arg->vie_mac);
+	}
+	rw_exit(&vxlan_lock);
+	return (err);
+}
+
+/* ARGSUSED */
+static int
+vxlan_ioc_entry_add(void *karg, intptr_t arg, int mode, cred_t *cred,
+    int *rvalp)
+{
+	return (vxlan_ioc_entry(karg, B_TRUE, cred));
+}
+
+/* ARGSUSED */
+static int
+vxlan_ioc_entry_delete(void *karg, intptr_t arg, int mode, cred_t *cred,
+    int *rvalp)
+{
+	return (vxlan_ioc_entry(karg, B_FALSE, cred));
+}
+
+/*
+ * Data path.
+ */
+
+/*
+ * Called by sockfs with each datagram that arrives on a mux's receive
+ * socket: a T_unitdata_ind followed by the UDP payload.
+ */
+/* ARGSUSED */
+static void
+vxlan_rx(ksocket_t ks, mblk_t *mp, size_t msg_size, int flags, void *arg)
+{
+	vxlan_mux_t *mux = arg;
+	vxlan_dev_t *vdev, key;
+	vxlan_hdr_t vxh;
+	mac_header_info_t hdr_info;
+	mblk_t *data;
+
+	if (DB_TYPE(mp) != M_DATA) {
+		data = mp->b_cont;
+		freeb(mp);
+		if ((mp = data) == NULL)
+			return;
+	}
+
+	if (MBLKL(mp) < sizeof (vxh) && !pullupmsg(mp, sizeof (vxh))) {
+		freemsg(mp);
+		return;
+	}
+	bcopy(mp->b_rptr, &vxh, sizeof (vxh));
+	if ((ntohl(vxh.vxh_flags) & VXLAN_F_VNI) == 0) {
+		freemsg(mp);
+		return;
+	}
+	mp->b_rptr += sizeof (vxh);
+	if (MBLKL(mp) < sizeof (struct ether_header) &&
+	    !pullupmsg(mp, sizeof (struct ether_header))) {
+		freemsg(mp);
+		return;
+	}
+
+	/*
+	 * Whatever the NIC said about the outer packet's checksums says
+	 * nothing about the inner frame's; the stack checks those itself.
+	 */
+	mac_hcksum_set(mp, 0, 0, 0, 0, 0);
+
+	key.vd_vni = ntohl(vxh.vxh_vni) >> VXLAN_VNI_SHIFT;
+	rw_enter(&mux->vm_lock, RW_READER);
+	vdev = avl_find(&mux->vm_devs, &key, NULL);
+	if (vdev == NULL || !(vdev->vd_flags & VDF_STARTED)) {
+		rw_exit(&mux->vm_lock);
+		freemsg(mp);
+		return;
+	}
+
+	if (mac_header_info(vdev->vd_mh, mp, &hdr_info) != 0) {
+		atomic_inc_64(&vdev->vd_stats.vs_ierrors);
+		rw_exit(&mux->vm_lock);
+		freemsg(mp);
+		return;
+	}
+
+	/* Fast path: frames for other unicast addresses are dropped */
+	if (!vdev->vd_promisc &&
+	    hdr_info.mhi_dsttype == MAC_ADDRTYPE_UNICAST &&
+	    bcmp(hdr_info.mhi_daddr, vdev->vd_mac_addr, ETHERADDRL) != 0) {
+		rw_exit(&mux->vm_lock);
+		freemsg(mp);
+		return;
+	}
+
+	atomic_inc_64(&vdev->vd_stats.vs_ipackets);
+	atomic_add_64(&vdev->vd_stats.vs_rbytes, msgdsize(mp));
+	mac_rx(vdev->vd_mh, NULL, mp);
+	rw_exit(&mux->vm_lock);
+}
+
+static void
+vxlan_tx(vxlan_dev_t *vdev, mblk_t *mp)
+{
+	vxlan_mux_t *mux = vdev->vd_mux;
+	struct ether_header *ehp;
+	struct sockaddr_in6 dest;
+	struct nmsghdr msg;
+	vxlan_hdr_t *vxh;
+	ksocket_t ks;
+	mblk_t *hmp;
+	size_t len;
+	int err;
+
+	if (MBLKL(mp) < sizeof (struct ether_header) &&
+	    !pullupmsg(mp, sizeof (struct ether_header))) {
+		atomic_inc_64(&vdev->vd_stats.vs_oerrors);
+		freemsg(mp);
+		return;
+	}
+
+	/* Group addresses, and unicast ones nobody knows, go to the default */
+	/* LINTED: E_BAD_PTR_CAST_ALIGN */
+	ehp = (struct ether_header *)mp->b_rptr;
+	if ((ehp->ether_dhost.ether_addr_octet[0] & 1) != 0 ||
+	    (err = vdev->vd_lookup->vl_ops->vlo_lookup(vdev->vd_lookup_arg,
+	    ehp->ether_dhost.ether_addr_octet, &dest)) == ENOENT) {
+		dest = vdev->vd_default;
+		err = 0;
+	}
+	if (err != 0 || dest.sin6_family != AF_INET6) {
+		atomic_inc_64(&vdev->vd_stats.vs_nodest);
+		freemsg(mp);
+		return;
+	}
+	if (dest.sin6_port == 0)
+		dest.sin6_port = htons(mux->vm_port);
+
+	/* Keep each flow on one source port; see vxlan_tx_sockets */
+	ks = mux->vm_txsocks[mac_pkt_hash(DL_ETHER, mp, MAC_PKT_HASH_L4,
+	    B_TRUE) % mux->vm_ntxsocks];
+
+	len = msgdsize(mp);
+	if ((hmp = allocb(sizeof (*vxh), BPRI_HI)) == NULL) {
+		atomic_inc_64(&vdev->vd_stats.vs_oerrors);
+		freemsg(mp);
+		return;
+	}
+	/* LINTED: E_BAD_PTR_CAST_ALIGN */
+	vxh = (vxlan_hdr_t *)hmp->b_wptr;
+	vxh->vxh_flags = htonl(VXLAN_F_VNI);
+	vxh->vxh_vni = htonl(vdev->vd_vni << VXLAN_VNI_SHIFT);
+	hmp->b_wptr += sizeof (*vxh);
+	hmp->b_cont = mp;
+
+	bzero(&msg, sizeof (msg));
+	msg.msg_name = &dest;
+	msg.msg_namelen = sizeof (dest);
+	msg.msg_flags = MSG_DONTWAIT;
+	if ((err = ksocket_sendmblk(ks, &msg, 0, &hmp, mux->vm_cred)) != 0) {
+		atomic_inc_64(&vdev->vd_stats.vs_oerrors);
+		freemsg(hmp);
+		return;
+	}
+
+	atomic_inc_64(&vdev->vd_stats.vs_opackets);
+	atomic_add_64(&vdev->vd_stats.vs_obytes, len);
+}
+
+static mblk_t *
+vxlan_m_tx(void *arg, mblk_t *mp_chain)
+{
+	vxlan_dev_t *vdev = arg;
+	mblk_t *mp, *nmp;
+
+	if (!(vdev->vd_flags & VDF_STARTED)) {
+		freemsgchain(mp_chain);
+		return (NULL);
+	}
+
+	for (mp = mp_chain; mp != NULL; mp = nmp) {
+		nmp = mp->b_next;
+		mp->b_next = NULL;
+		vxlan_tx(vdev, mp);
+	}
+
+	return (NULL);
+}
+
+static int
+vxlan_m_stat(void *arg, uint_t stat, uint64_t *val)
+{
+	int rval = 0;
+	vxlan_dev_t *vdev = arg;
+
+	ASSERT(vdev->vd_mh != NULL);
+
+	switch (stat) {
+	case MAC_STAT_LINK_STATE:
+		*val = LINK_DUPLEX_FULL;
+		break;
+	case MAC_STAT_LINK_UP:
+		if (vdev->vd_flags & VDF_STARTED)
+			*val = LINK_STATE_UP;
+		else
+			*val = LINK_STATE_DOWN;
+		break;
+	case MAC_STAT_OPACKETS:
+		*val = vdev->vd_stats.vs_opackets;
+		break;
+	case MAC_STAT_OBYTES:
+		*val = vdev->vd_stats.vs_obytes;
+		break;
+	case MAC_STAT_IERRORS:
+		*val = vdev->vd_stats.vs_ierrors;
+		break;
+	case MAC_STAT_OERRORS:
+		*val = vdev->vd_stats.vs_oerrors +
+		    vdev->vd_stats.vs_nodest;
+		break;
+	case MAC_STAT_RBYTES:
+		*val = vdev->vd_stats.vs_rbytes;
+		break;
+	case MAC_STAT_IPACKETS:
+		*val = vdev->vd_stats.vs_ipackets;
+		break;
+	default:
+		rval = ENOTSUP;
+		break;
+	}
+
+	return (rval);
+}
+
+static int
+vxlan_m_start(void *arg)
+{
+	vxlan_dev_t *vdev = arg;
+
+	vdev->vd_flags |= VDF_STARTED;
+	return (0);
+}
+
+static void
+vxlan_m_stop(void *arg)
+{
+	vxlan_dev_t *vdev = arg;
+
+	vdev->vd_flags &= ~VDF_STARTED;
+}
+
+static int
+vxlan_m_promisc(void *arg, boolean_t on)
+{
+	vxlan_dev_t *vdev = arg;
+
+	vdev->vd_promisc = on;
+	return (0);
+}
+
+/*
+ * Group traffic is flooded to the default destination and everything
+ * that arrives from it is passed up, so there is no filter to program.
+ */
+/* ARGSUSED */
+static int
+vxlan_m_multicst(void *arg, boolean_t add, const uint8_t *addrp)
+{
+	return (0);
+}
+
+static int
+vxlan_m_unicst(void *arg, const uint8_t *macaddr)
+{
+	vxlan_dev_t *vdev = arg;
+
+	(void) memcpy(vdev->vd_mac_addr, macaddr, ETHERADDRL);
+	return (0);
+}
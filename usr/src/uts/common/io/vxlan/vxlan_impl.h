@@ -0,0 +1,97 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_SYS_VXLAN_IMPL_H
+#define	_SYS_VXLAN_IMPL_H
+
+#include <sys/types.h>
+#include <sys/list.h>
+#include <sys/avl.h>
+#include <sys/mutex.h>
+#include <sys/rwlock.h>
+#include <sys/ksocket.h>
+#include <sys/mac.h>
+#include <net/vxlan.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * A registered lookup module, and the number of links using it.
+ */
+typedef struct vxlan_lookup {
+	list_node_t		vl_node;
+	const vxlan_lookup_ops_t *vl_ops;
+	uint_t			vl_refcnt;
+} vxlan_lookup_t;
+
+/*
+ * The UDP endpoint shared by all the links of a zone that use the same
+ * port.  One socket, bound to the port, receives for all of them, and
+ * frames are handed to the link whose VNI they carry.  Frames are sent
+ * from a set of sockets bound to ephemeral ports, chosen by a hash of the
+ * inner flow, so that a flow keeps its source port while different flows
+ * are spread across the receiving host's rings by its RSS hash.
+ */
+typedef struct vxlan_mux {
+	list_node_t		vm_node;
+	zoneid_t		vm_zoneid;
+	uint16_t		vm_port;	/* host order */
+	uint_t			vm_refcnt;	/* links using the mux */
+	cred_t			*vm_cred;
+	ksocket_t		vm_rxsock;
+	ksocket_t		*vm_txsocks;
+	uint_t			vm_ntxsocks;
+	krwlock_t		vm_lock;	/* protects vm_devs */
+	avl_tree_t		vm_devs;	/* links, by VNI */
+} vxlan_mux_t;
+
+typedef struct vxlan_stats {
+	uint64_t		vs_rbytes;
+	uint64_t		vs_ipackets;
+	uint64_t		vs_ierrors;
+	uint64_t		vs_obytes;
+	uint64_t		vs_opackets;
+	uint64_t		vs_oerrors;
+	uint64_t		vs_nodest;	/* sends with no VTEP */
+} vxlan_stats_t;
+
+typedef struct vxlan_dev {
+	list_node_t		vd_listnode;
+	avl_node_t		vd_muxnode;
+	datalink_id_t		vd_link_id;
+	zoneid_t		vd_zoneid;	/* zone where created */
+	uint32_t		vd_vni;
+	uint32_t		vd_mtu;
+	vxlan_mux_t		*vd_mux;
+	mac_handle_t		vd_mh;
+	uint_t			vd_flags;	/* VDF_* */
+	boolean_t		vd_promisc;
+	struct sockaddr_in6	vd_default;	/* for unknown destinations */
+	vxlan_lookup_t		*vd_lookup;
+	void			*vd_lookup_arg;
+	uint_t			vd_mac_len;
+	uchar_t			vd_mac_addr[MAXMACADDRLEN];
+	vxlan_stats_t		vd_stats;
+} vxlan_dev_t;
+
+/* VXLAN device flags */
+#define	VDF_STARTED	0x00000001	/* Device started, allow traffic */
+
+#define	VXLAN_DEFAULT_MTU	1500
+#define	VXLAN_MAX_MTU		9000
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_VXLAN_IMPL_H */
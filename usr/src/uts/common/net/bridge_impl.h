@@ -89,6 +89,7 @@ typedef struct bridge_kslink_s {
 
 struct bridge_mac_s;
 struct bridge_stream_s;
+struct bridge_fwd_s;
 
 typedef struct bridge_inst_s {
 	list_node_t	bi_node;
@@ -101,6 +102,8 @@ typedef struct bridge_inst_s {
 	list_t		bi_links;
 	kcondvar_t	bi_linkwait;
 	avl_tree_t	bi_fwd;
+	struct bridge_fwd_s **bi_fwdhash;	/* lockless index of bi_fwd */
+	uint_t		bi_fwdhashmask;
 	kstat_t		*bi_ksp;
 	struct bridge_stream_s *bi_control;
 	struct bridge_mac_s *bi_mac;
@@ -212,9 +215,16 @@ typedef struct bridge_link_s {
  * see.  They're destroyed when they age away.  For forwarding, we look up the
  * destination address in an AVL tree, and the entry found tells us where the
  * that source must live.
+ *
+ * The same entries are also on the chains of a hash table, bi_fwdhash, which
+ * is what the data path uses: it's searched without taking bi_rwlock (see
+ * fwd_walk_enter() in bridge.c).  Both are changed only with bi_rwlock held
+ * as writer.
  */
 typedef struct bridge_fwd_s {
 	avl_node_t	bf_node;
+	struct bridge_fwd_s *bf_hnext;	/* bi_fwdhash chain */
+	struct bridge_fwd_s *bf_limbo;	/* removed, awaiting fwd_reclaim() */
 	uchar_t		bf_dest[ETHERADDRL];
 	uint16_t	bf_trill_nick;	/* destination nickname */
 	clock_t		bf_lastheard;	/* time we last heard from this node */
@@ -0,0 +1,134 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_SYS_VXLAN_H
+#define	_SYS_VXLAN_H
+
+#include <sys/types.h>
+#include <sys/mac.h>
+#include <sys/dld_ioc.h>
+#include <netinet/in.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * VXLAN (RFC 7348) overlay links.  Each link is an Ethernet whose frames
+ * are carried between hosts ("VTEPs") in UDP, tagged with a 24-bit
+ * network identifier (VNI).
+ */
+
+#define	VXLAN_PORT		4789	/* IANA-assigned UDP port */
+#define	VXLAN_VNI_MAX		0xffffff
+#define	VXLAN_LOOKUP_NAMELEN	32
+#define	VXLAN_LOOKUP_DIRECT	"direct"	/* the built-in VTEP table */
+
+/* The VXLAN header, which follows the UDP header */
+typedef struct vxlan_hdr {
+	uint32_t	vxh_flags;	/* VXLAN_F_VNI, network order */
+	uint32_t	vxh_vni;	/* VNI << 8, network order */
+} vxlan_hdr_t;
+
+#define	VXLAN_F_VNI		0x08000000	/* vxh_vni is valid */
+#define	VXLAN_VNI_SHIFT		8
+
+/* VXLAN IOCTL commands handled via DLD driver */
+#define	VXLAN_IOC_CREATE	VXLANIOC(1)
+#define	VXLAN_IOC_DELETE	VXLANIOC(2)
+#define	VXLAN_IOC_INFO		VXLANIOC(3)
+#define	VXLAN_IOC_ENTRY_ADD	VXLANIOC(4)
+#define	VXLAN_IOC_ENTRY_DELETE	VXLANIOC(5)
+
+/*
+ * Frames for broadcast and multicast addresses, and for unicast ones the
+ * lookup module knows nothing of, go to vic_default (which may well be a
+ * multicast group); they are dropped if its sin6_family is 0.  Addresses
+ * are AF_INET6, with IPv4 VTEPs given as IPv4-mapped addresses; a port of
+ * 0 means the link's own UDP port.
+ */
+typedef struct vxlan_ioc_create {
+	datalink_id_t	vic_link_id;
+	uint32_t	vic_vni;
+	uint16_t	vic_port;	/* UDP port; 0 for VXLAN_PORT */
+	uint16_t	vic_pad;
+	uint32_t	vic_mtu;	/* 0 for the default */
+	uint_t		vic_mac_len;	/* 0 for a random address */
+	uchar_t		vic_mac_addr[MAXMACADDRLEN];
+	struct sockaddr_in6 vic_default;
+	char		vic_lookup[VXLAN_LOOKUP_NAMELEN];
+} vxlan_ioc_create_t;
+
+typedef struct vxlan_ioc_delete {
+	datalink_id_t	vid_link_id;
+} vxlan_ioc_delete_t;
+
+typedef struct vxlan_ioc_info {
+	datalink_id_t	vii_link_id;
+	uint32_t	vii_vni;
+	uint16_t	vii_port;
+	uint16_t	vii_pad;
+	uint32_t	vii_mtu;
+	uint_t		vii_mac_len;
+	uchar_t		vii_mac_addr[MAXMACADDRLEN];
+	struct sockaddr_in6 vii_default;
+	char		vii_lookup[VXLAN_LOOKUP_NAMELEN];
+} vxlan_ioc_info_t;
+
+/* vie_dest is ignored by VXLAN_IOC_ENTRY_DELETE */
+typedef struct vxlan_ioc_entry {
+	datalink_id_t	vie_link_id;
+	uchar_t		vie_mac[ETHERADDRL];
+	uint16_t	vie_pad;
+	struct sockaddr_in6 vie_dest;
+} vxlan_ioc_entry_t;
+
+#ifdef	_KERNEL
+
+/*
+ * Lookup modules map a link's destination MAC addresses to the VTEPs
+ * behind them.  The built-in VXLAN_LOOKUP_DIRECT module is a table filled
+ * by VXLAN_IOC_ENTRY_ADD; other modules (a cache of a central directory,
+ * say) register themselves with vxlan_lookup_register() from their _init()
+ * and are chosen by name when a link is created.
+ *
+ * vlo_init() is called as a link is created, and vlo_fini() as it goes
+ * away.  vlo_lookup() is called for each unicast frame sent, in the data
+ * path, and so must not block; it fills in the VTEP's address, and may
+ * leave sin6_port 0 for the link's port.  It returns 0, or ENOENT to send
+ * the frame to the link's default destination.  vlo_add() and
+ * vlo_remove() back the ENTRY ioctls, and may be NULL, in which case
+ * those fail with ENOTSUP.
+ */
+#define	VXLAN_LOOKUP_VERSION	1
+
+typedef struct vxlan_lookup_ops {
+	uint_t		vlo_version;
+	const char	*vlo_name;
+	int		(*vlo_init)(datalink_id_t, uint32_t, void **);
+	void		(*vlo_fini)(void *);
+	int		(*vlo_lookup)(void *, const uint8_t *,
+			    struct sockaddr_in6 *);
+	int		(*vlo_add)(void *, const uint8_t *,
+			    const struct sockaddr_in6 *);
+	int		(*vlo_remove)(void *, const uint8_t *);
+} vxlan_lookup_ops_t;
+
+extern int vxlan_lookup_register(const vxlan_lookup_ops_t *);
+extern int vxlan_lookup_unregister(const vxlan_lookup_ops_t *);
+
+#endif	/* _KERNEL */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_VXLAN_H */
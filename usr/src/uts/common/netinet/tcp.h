@@ -122,6 +122,32 @@ struct tcphdr {
 #define	TCP_RTO_MIN			0x1A
 #define	TCP_RTO_MAX			0x1B
 #define	TCP_LINGER2			0x1C
+#define	TCP_CONGESTION			0x1D
+
+#define	TCP_TLS_TX			0x1E
+
+/* Size of the buffer holding a TCP_CONGESTION algorithm name */
+#define	TCP_CA_NAME_MAX			16
+
+/*
+ * Argument to TCP_TLS_TX.  Once the TLS handshake is done, the application
+ * passes the session's write key, the implicit nonce and the sequence
+ * number of the next record; from then on the kernel sends everything
+ * written to the socket as encrypted application_data records.  The
+ * option can be set once per connection and cannot be read back.
+ */
+#define	TCP_TLS_VERSION_1_2		0x0303
+
+#define	TCP_TLS_CIPHER_AES_GCM_128	1
+#define	TCP_TLS_CIPHER_AES_GCM_256	2
+
+typedef struct tcp_tls_info {
+	uint16_t	tti_version;	/* TCP_TLS_VERSION_* */
+	uint16_t	tti_cipher;	/* TCP_TLS_CIPHER_* */
+	uint8_t		tti_key[32];	/* first 16 bytes for AES_GCM_128 */
+	uint8_t		tti_salt[4];	/* implicit part of the GCM nonce */
+	uint8_t		tti_seq[8];	/* next record sequence, big-endian */
+} tcp_tls_info_t;
 
 /* gap for expansion of ``standard'' options */
 #define	TCP_ANONPRIVBIND		0x20	/* for internal use only  */
@@ -870,6 +870,7 @@ typedef struct nfs4_debug_msg {
  *		mi_bseqid_list
  *		mi_ephemeral
  *		mi_ephemeral_tree
+ *		mi_ra_stamp, mi_ra_bytes, mi_ra_minrtt, mi_ra_bw, mi_ra_rtt
  *
  *	Normally the netconfig information for the mount comes from
  *	mi_curr_serv and mi_klmconfig is NULL.  If NLM calls need to use a
@@ -1006,6 +1007,8 @@ typedef struct mntinfo4 {
 	ushort_t	mi_threads[NFS4_MAX_ASYNC_QUEUES];
 					/* number of active async threads */
 	ushort_t	mi_max_threads;	/* max number of async threads */
+	ushort_t	mi_ra_threads;	/* async threads readahead wants */
+	uint_t		mi_ra_depth;	/* blocks of readahead per stream */
 	kthread_t	*mi_manager_thread; /* async manager thread id */
 	kthread_t	*mi_inactive_thread; /* inactive thread id */
 	kcondvar_t	mi_inact_req_cv; /* notify VOP_INACTIVE thread */
@@ -1013,6 +1016,16 @@ typedef struct mntinfo4 {
 					/* tell workers to work */
 	kcondvar_t	mi_async_cv;	/* all pool threads exited */
 	kmutex_t	mi_async_lock;
+	/*
+	 * Read throughput and latency, from which nfs4_ra_sample() sizes
+	 * readahead
+	 */
+	hrtime_t	mi_ra_stamp;	/* start of the sample interval */
+	uint64_t	mi_ra_bytes;	/* bytes read in the interval */
+	hrtime_t	mi_ra_minrtt;	/* quickest READ in the interval */
+	uint64_t	mi_ra_bw;	/* bandwidth estimate, bytes/sec */
+	hrtime_t	mi_ra_rtt;	/* unloaded READ time estimate */
+	uint_t		mi_nconnect;	/* connections to the server */
 	/*
 	 * Other stuff
 	 */
@@ -1488,6 +1501,7 @@ extern void	nfs4_async_manager(struct vfs *);
 extern void	nfs4_async_manager_stop(struct vfs *);
 extern void	nfs4_async_stop(struct vfs *);
 extern int	nfs4_async_stop_sig(struct vfs *);
+extern void	nfs4_ra_sample(mntinfo4_t *, size_t, hrtime_t);
 extern int	nfs4_async_readahead(vnode_t *, u_offset_t, caddr_t,
 				struct seg *, cred_t *,
 				void (*)(vnode_t *, u_offset_t,
@@ -34,14 +34,23 @@ extern "C" {
 
 /*
  * NFSv4 Duplicate Request cache.
+ *
+ * The cache is split into partitions, each with its own lock, entries and
+ * LRU list, so that requests with different XIDs rarely contend.  Hash
+ * bucket i belongs to partition i % dr_nparts.
  */
-typedef struct rfs4_drc {
+typedef struct rfs4_drc_part {
 	kmutex_t 	lock;
-	uint32_t	dr_hash;
 	uint32_t 	max_size;
 	uint32_t 	in_use;
 	list_t		dr_cache;
+} rfs4_drc_part_t;
+
+typedef struct rfs4_drc {
+	uint32_t	dr_hash;
+	uint32_t	dr_nparts;
 	list_t  	*dr_buckets;
+	rfs4_drc_part_t	*dr_parts;
 } rfs4_drc_t;
 
 /*
@@ -51,7 +60,7 @@ typedef struct rfs4_dupreq {
 	list_node_t 	dr_bkt_next;
 	list_node_t	dr_next;
 	list_t		*dr_bkt;
-	rfs4_drc_t	*drc;
+	rfs4_drc_part_t	*dr_part;
 	int		dr_state;
 	uint32_t	dr_xid;
 	struct netbuf	dr_addr;
@@ -73,11 +82,12 @@ typedef struct rfs4_dupreq {
 extern rfs4_drc_t *nfs4_drc;
 extern uint32_t nfs4_drc_max;
 extern uint32_t nfs4_drc_hash;
+extern uint32_t nfs4_drc_parts;
 
 rfs4_drc_t *rfs4_init_drc(uint32_t, uint32_t);
 void rfs4_fini_drc(rfs4_drc_t *);
 void rfs4_dr_chstate(rfs4_dupreq_t *, int);
-rfs4_dupreq_t *rfs4_alloc_dr(rfs4_drc_t *);
+rfs4_dupreq_t *rfs4_alloc_dr(rfs4_drc_part_t *);
 int rfs4_find_dr(struct svc_req *, rfs4_drc_t *, rfs4_dupreq_t **);
 
 #ifdef	__cplusplus
@@ -53,6 +53,8 @@ static ulong_t callout_counter_low;		/* callout ID increment */
 static ulong_t callout_table_bits;		/* number of table bits in ID */
 static ulong_t callout_table_mask;		/* mask for the table bits */
 static callout_cache_t *callout_caches;		/* linked list of caches */
+static int callout_wheel = 1;			/* use the callout wheel */
+static uint_t callout_idhash_max = CALLOUT_IDHASH_MAX; /* max ID buckets */
 #pragma align 64(callout_table)
 static callout_table_t *callout_table;		/* global callout table array */
 
@@ -154,12 +156,12 @@ static hrtime_t	callout_heap_process(callout_table_t *, hrtime_t, int);
  *	  of expiration.
  */
 #define	CALLOUT_APPEND(ct, cp)						\
-	CALLOUT_HASH_APPEND(ct->ct_idhash[CALLOUT_IDHASH(cp->c_xid)],	\
+	CALLOUT_HASH_APPEND(ct->ct_idhash[CALLOUT_IDHASH(ct, cp->c_xid)], \
 		cp, c_idnext, c_idprev);				\
 	CALLOUT_HASH_APPEND(cp->c_list->cl_callouts, cp, c_clnext, c_clprev)
 
 #define	CALLOUT_DELETE(ct, cp)						\
-	CALLOUT_HASH_DELETE(ct->ct_idhash[CALLOUT_IDHASH(cp->c_xid)],	\
+	CALLOUT_HASH_DELETE(ct->ct_idhash[CALLOUT_IDHASH(ct, cp->c_xid)], \
 		cp, c_idnext, c_idprev);				\
 	CALLOUT_HASH_DELETE(cp->c_list->cl_callouts, cp, c_clnext, c_clprev)
 
@@ -349,6 +351,62 @@ callout_list_get(callout_table_t *ct, hrtime_t expiration, int flags, int hash)
 	return (NULL);
 }
 
+/*
+ * Grow a callout table's ID hash. Callout IDs are handed out sequentially,
+ * so once there are at least as many buckets as pending callouts, most
+ * chains hold a single callout and untimeout() finds it right away instead
+ * of walking a long chain. Like callout_heap_expand(), this drops and
+ * reacquires the callout table mutex to allocate.
+ */
+static void
+callout_idhash_expand(callout_table_t *ct)
+{
+	callout_hash_t *ohash, *nhash;
+	callout_t *cp;
+	size_t osize, nsize;
+	uint_t omask, nmask, i;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	omask = ct->ct_idhash_mask;
+	nmask = (omask + 1) * CALLOUT_IDHASH_GROW - 1;
+	osize = sizeof (callout_hash_t) * (omask + 1);
+	nsize = sizeof (callout_hash_t) * (nmask + 1);
+
+	mutex_exit(&ct->ct_mutex);
+	nhash = kmem_zalloc(nsize, KM_NOSLEEP);
+	mutex_enter(&ct->ct_mutex);
+
+	if (nhash == NULL)
+		return;
+
+	if (ct->ct_idhash_mask != omask) {
+		/*
+		 * Someone else grew the hash while we were away.
+		 */
+		kmem_free(nhash, nsize);
+		return;
+	}
+
+	/*
+	 * Walking each old chain in order keeps the new chains in the
+	 * order the callouts were added.
+	 */
+	ohash = ct->ct_idhash;
+	for (i = 0; i <= omask; i++) {
+		while ((cp = ohash[i].ch_head) != NULL) {
+			CALLOUT_HASH_DELETE(ohash[i], cp, c_idnext, c_idprev);
+			CALLOUT_HASH_APPEND(nhash[(cp->c_xid >>
+			    CALLOUT_COUNTER_SHIFT) & nmask], cp, c_idnext,
+			    c_idprev);
+		}
+	}
+	ct->ct_idhash = nhash;
+	ct->ct_idhash_mask = nmask;
+
+	kmem_free(ohash, osize);
+}
+
 /*
  * Add a new callout list into a callout table's queue in sorted order by
  * expiration.
@@ -507,6 +565,326 @@ callout_queue_process(callout_table_t *ct, hrtime_t delta, int timechange)
 	return (cl->cl_expiration);
 }
 
+/*
+ * Callout wheel. See callo.h for the layout. Slot n of level l lives at
+ * ct_wheel[l * CALLOUT_WHEEL_SLOTS + n], and bit n of ct_wbits[l] is set
+ * while that slot is non-empty. A callout list is placed in level 0 if it
+ * expires within a turn of that level from the wheel time (ct_wtick), else
+ * in the lowest level whose turn covers it; when the wheel time reaches the
+ * start of a slot in a higher level, the slot is cascaded, that is, its
+ * lists are placed again relative to the new wheel time. The wheel time is
+ * only brought up to date when the wheel cyclic fires, which is programmed
+ * for the earliest expiration or cascade.
+ *
+ * Wheel lists stay in the callout list hash like heap lists do, so
+ * timeout_generic() can still find them by expiration. Unlike heap lists,
+ * a wheel list is freed as soon as untimeout_generic() empties it, as it
+ * can be unlinked from its slot in constant time.
+ */
+#define	CALLOUT_WHEEL_TICK(exp)						\
+	((exp) / nsec_per_tick + ((exp) % nsec_per_tick != 0))
+
+#define	CALLOUT_WHEEL_EMPTY(ct)						\
+	(((ct)->ct_wbits[0] | (ct)->ct_wbits[1] |			\
+	(ct)->ct_wbits[2] | (ct)->ct_wbits[3]) == 0)
+
+/*
+ * Return the tick at which slot "slot" of level "level" next needs to be
+ * looked at: the expiration for level 0, the cascade for other levels.
+ */
+static int64_t
+callout_wheel_when(callout_table_t *ct, int level, int slot)
+{
+	int64_t base;
+	int shift, idx;
+
+	shift = level * CALLOUT_WHEEL_BITS;
+	base = ct->ct_wtick >> shift;
+	idx = base & CALLOUT_WHEEL_MASK;
+	if (slot <= idx)
+		slot += CALLOUT_WHEEL_SLOTS;
+
+	return ((base - idx + slot) << shift);
+}
+
+/*
+ * Return the earliest tick at which something in the wheel needs to be
+ * done, or INT64_MAX if the wheel is empty.
+ */
+static int64_t
+callout_wheel_next(callout_table_t *ct)
+{
+	uint64_t bits, later;
+	int64_t next, when;
+	int level, idx, slot;
+
+	next = INT64_MAX;
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		if ((bits = ct->ct_wbits[level]) == 0)
+			continue;
+		idx = (ct->ct_wtick >> (level * CALLOUT_WHEEL_BITS)) &
+		    CALLOUT_WHEEL_MASK;
+		later = bits & ~((2ULL << idx) - 1);
+		if (later != 0)
+			slot = lowbit(later) - 1;
+		else
+			slot = lowbit(bits) - 1;
+		when = callout_wheel_when(ct, level, slot);
+		if (when < next)
+			next = when;
+	}
+
+	return (next);
+}
+
+/*
+ * Return the wheel slot for an expiration tick, or -1 if the tick is not
+ * past the wheel time. Ticks beyond the reach of the wheel go into the
+ * current slot of the last level, which is the last one to be cascaded.
+ */
+static int
+callout_wheel_slot(callout_table_t *ct, int64_t tick)
+{
+	int64_t diff;
+	int level, shift;
+
+	diff = tick - ct->ct_wtick;
+	if (diff <= 0)
+		return (-1);
+
+	for (level = 0, shift = 0; level < CALLOUT_WHEEL_LEVELS - 1;
+	    level++, shift += CALLOUT_WHEEL_BITS) {
+		if (diff < (1LL << (shift + CALLOUT_WHEEL_BITS)))
+			break;
+	}
+	if (diff >= (1LL << (shift + CALLOUT_WHEEL_BITS)))
+		tick = ct->ct_wtick;
+
+	return (level * CALLOUT_WHEEL_SLOTS +
+	    ((tick >> shift) & CALLOUT_WHEEL_MASK));
+}
+
+static void
+callout_wheel_link(callout_table_t *ct, callout_list_t *cl, int slot)
+{
+	cl->cl_flags |= CALLOUT_LIST_FLAG_WHEEL;
+	cl->cl_wslot = slot;
+	CALLOUT_HASH_APPEND(ct->ct_wheel[slot], cl, cl_wnext, cl_wprev);
+	ct->ct_wbits[slot / CALLOUT_WHEEL_SLOTS] |=
+	    1ULL << (slot & CALLOUT_WHEEL_MASK);
+}
+
+static void
+callout_wheel_unlink(callout_table_t *ct, callout_list_t *cl)
+{
+	int slot = cl->cl_wslot;
+
+	cl->cl_flags &= ~CALLOUT_LIST_FLAG_WHEEL;
+	CALLOUT_HASH_DELETE(ct->ct_wheel[slot], cl, cl_wnext, cl_wprev);
+	if (ct->ct_wheel[slot].ch_head == NULL) {
+		ct->ct_wbits[slot / CALLOUT_WHEEL_SLOTS] &=
+		    ~(1ULL << (slot & CALLOUT_WHEEL_MASK));
+	}
+}
+
+/*
+ * Move a callout list that has expired from the wheel to the expired list.
+ */
+static void
+callout_wheel_expire(callout_table_t *ct, callout_list_t *cl)
+{
+	CALLOUT_LIST_DELETE(ct->ct_clhash[CALLOUT_CLHASH(cl->cl_expiration)],
+	    cl);
+	CALLOUT_LIST_APPEND(ct->ct_expired, cl);
+}
+
+/*
+ * Place the callout lists in "lists" into the wheel relative to the
+ * current wheel time, expiring those whose time has come.
+ */
+static void
+callout_wheel_requeue(callout_table_t *ct, callout_hash_t *lists)
+{
+	callout_list_t *cl;
+	int slot;
+
+	while ((cl = lists->ch_head) != NULL) {
+		CALLOUT_HASH_DELETE(*lists, cl, cl_wnext, cl_wprev);
+		slot = callout_wheel_slot(ct,
+		    CALLOUT_WHEEL_TICK(cl->cl_expiration));
+		if (slot < 0) {
+			cl->cl_flags &= ~CALLOUT_LIST_FLAG_WHEEL;
+			callout_wheel_expire(ct, cl);
+		} else {
+			callout_wheel_link(ct, cl, slot);
+		}
+	}
+}
+
+/*
+ * Insert a new callout list into a callout table's wheel and reprogram the
+ * wheel cyclic if needed. Returns 0 if the list has to go into the heap
+ * instead because it expires no later than the wheel time.
+ */
+static int
+callout_wheel_insert(callout_table_t *ct, callout_list_t *cl)
+{
+	hrtime_t when;
+	int slot;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	/*
+	 * An empty wheel is not kept up to date. Catch it up so that the
+	 * new list ends up in as low a level as possible.
+	 */
+	if (CALLOUT_WHEEL_EMPTY(ct))
+		ct->ct_wtick = gethrtime() / nsec_per_tick;
+
+	slot = callout_wheel_slot(ct, CALLOUT_WHEEL_TICK(cl->cl_expiration));
+	if (slot < 0)
+		return (0);
+
+	callout_wheel_link(ct, cl, slot);
+
+	/*
+	 * As with the heap and the queue, do not reprogram the cyclic during
+	 * the CPR suspend phase. callout_resume() will take care of it.
+	 */
+	when = callout_wheel_when(ct, slot / CALLOUT_WHEEL_SLOTS,
+	    slot & CALLOUT_WHEEL_MASK) * nsec_per_tick;
+	if (when < ct->ct_wexp) {
+		ct->ct_wexp = when;
+		if (ct->ct_suspend == 0)
+			(void) cyclic_reprogram(ct->ct_wcyclic, when);
+	}
+
+	return (1);
+}
+
+/*
+ * Advance the wheel time to "tick", which must be the next tick returned
+ * by callout_wheel_next(): cascade whichever slots start at this tick, and
+ * expire the level 0 slot.
+ */
+static void
+callout_wheel_tick(callout_table_t *ct, int64_t tick)
+{
+	callout_hash_t temp;
+	callout_list_t *cl;
+	int level, shift, slot;
+
+	ct->ct_wtick = tick;
+
+	for (level = CALLOUT_WHEEL_LEVELS - 1; level > 0; level--) {
+		shift = level * CALLOUT_WHEEL_BITS;
+		if ((tick & ((1LL << shift) - 1)) != 0)
+			continue;
+		slot = level * CALLOUT_WHEEL_SLOTS +
+		    ((tick >> shift) & CALLOUT_WHEEL_MASK);
+		temp = ct->ct_wheel[slot];
+		ct->ct_wheel[slot].ch_head = NULL;
+		ct->ct_wheel[slot].ch_tail = NULL;
+		ct->ct_wbits[level] &= ~(1ULL << (slot & CALLOUT_WHEEL_MASK));
+		callout_wheel_requeue(ct, &temp);
+	}
+
+	slot = tick & CALLOUT_WHEEL_MASK;
+	while ((cl = ct->ct_wheel[slot].ch_head) != NULL) {
+		ASSERT(CALLOUT_WHEEL_TICK(cl->cl_expiration) == tick);
+		callout_wheel_unlink(ct, cl);
+		callout_wheel_expire(ct, cl);
+	}
+}
+
+/*
+ * Delete and handle all past expirations in a callout table's wheel.
+ */
+static hrtime_t
+callout_wheel_delete(callout_table_t *ct)
+{
+	int64_t now, next;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	now = gethrtime() / nsec_per_tick;
+	while ((next = callout_wheel_next(ct)) <= now)
+		callout_wheel_tick(ct, next);
+
+	/*
+	 * Nothing happens in the wheel before "next", so the wheel time can
+	 * safely be brought up to date.
+	 */
+	ct->ct_wtick = now;
+	ct->ct_wexp = CY_INFINITY;
+
+	/*
+	 * If the wheel is empty or callouts have been suspended, just return.
+	 * The cyclic has already been programmed to infinity by the cyclic
+	 * subsystem.
+	 */
+	if ((next == INT64_MAX) || (ct->ct_suspend > 0))
+		return (CY_INFINITY);
+
+	ct->ct_wexp = next * nsec_per_tick;
+	(void) cyclic_reprogram(ct->ct_wcyclic, ct->ct_wexp);
+
+	return (ct->ct_wexp);
+}
+
+/*
+ * Apply a debugger delta to a callout table's wheel. The wheel holds no
+ * absolute lists, so there is nothing to do for a time change.
+ */
+static hrtime_t
+callout_wheel_process(callout_table_t *ct, hrtime_t delta)
+{
+	callout_hash_t temp;
+	callout_list_t *cl;
+	hrtime_t expiration;
+	int64_t next;
+	int slot;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	if (delta != 0) {
+		temp.ch_head = NULL;
+		temp.ch_tail = NULL;
+		for (slot = 0; slot < CALLOUT_WHEEL_LEVELS *
+		    CALLOUT_WHEEL_SLOTS; slot++) {
+			while ((cl = ct->ct_wheel[slot].ch_head) != NULL) {
+				callout_wheel_unlink(ct, cl);
+				CALLOUT_LIST_DELETE(ct->ct_clhash[
+				    CALLOUT_CLHASH(cl->cl_expiration)], cl);
+				expiration = cl->cl_expiration + delta;
+				if (expiration <= 0)
+					expiration = CY_INFINITY;
+				cl->cl_expiration = expiration;
+				CALLOUT_LIST_INSERT(ct->ct_clhash[
+				    CALLOUT_CLHASH(expiration)], cl);
+				CALLOUT_HASH_APPEND(temp, cl, cl_wnext,
+				    cl_wprev);
+			}
+		}
+		ct->ct_wtick = gethrtime() / nsec_per_tick;
+		callout_wheel_requeue(ct, &temp);
+	}
+
+	/*
+	 * As in callout_queue_process(), if there are expired callouts the
+	 * cyclic needs to go off immediately.
+	 */
+	if (ct->ct_expired.ch_head != NULL) {
+		ct->ct_wexp = gethrtime();
+	} else if ((next = callout_wheel_next(ct)) == INT64_MAX) {
+		ct->ct_wexp = CY_INFINITY;
+	} else {
+		ct->ct_wexp = next * nsec_per_tick;
+	}
+
+	return (ct->ct_wexp);
+}
+
 /*
  * Initialize a callout table's heap, if necessary. Preallocate some free
  * entries so we don't have to check for NULL elsewhere.
@@ -1032,6 +1410,15 @@ timeout_generic(int type, void (*func)(void *), void *arg,
 		(void) callout_heap_process(ct, 0, 0);
 	}
 
+	if ((ct->ct_timeouts_pending >
+	    (uint64_t)(ct->ct_idhash_mask + 1) * CALLOUT_IDHASH_LOAD) &&
+	    (ct->ct_idhash_mask + 1 < callout_idhash_max)) {
+		/*
+		 * The ID hash chains are getting long. Grow the hash.
+		 */
+		callout_idhash_expand(ct);
+	}
+
 	if ((cp = ct->ct_free) == NULL)
 		cp = callout_alloc(ct);
 	else
@@ -1127,6 +1514,18 @@ again:
 		cl->cl_expiration = expiration;
 		cl->cl_flags = clflags;
 
+		/*
+		 * Relative callout lists with a resolution of a tick or more
+		 * go into the wheel. This covers timeout(9F) and most of
+		 * the networking timers.
+		 */
+		if (callout_wheel && (clflags == 0) &&
+		    (resolution >= nsec_per_tick) &&
+		    callout_wheel_insert(ct, cl)) {
+			CALLOUT_LIST_INSERT(ct->ct_clhash[hash], cl);
+			goto out;
+		}
+
 		/*
 		 * Check if we have enough space in the heap to insert one
 		 * expiration. If not, expand the heap.
@@ -1285,9 +1684,9 @@ untimeout_generic(callout_id_t id, int nowait)
 	callout_id_t bogus;
 
 	ct = &callout_table[CALLOUT_ID_TO_TABLE(id)];
-	hash = CALLOUT_IDHASH(id);
 
 	mutex_enter(&ct->ct_mutex);
+	hash = CALLOUT_IDHASH(ct, id);
 
 	/*
 	 * Search the ID hash table for the callout.
@@ -1322,10 +1721,12 @@ untimeout_generic(callout_id_t id, int nowait)
 			ct->ct_timeouts_pending--;
 
 			/*
-			 * If the callout list has become empty, there are 3
+			 * If the callout list has become empty, there are 4
 			 * possibilities. If it is present:
 			 *	- in the heap, it needs to be cleaned along
 			 *	  with its heap entry. Increment a reap count.
+			 *	- in the callout wheel, unlink it from its slot
+			 *	  and the callout list hash, and free it.
 			 *	- in the callout queue, free it.
 			 *	- in the expired list, free it.
 			 */
@@ -1333,6 +1734,11 @@ untimeout_generic(callout_id_t id, int nowait)
 				flags = cl->cl_flags;
 				if (flags & CALLOUT_LIST_FLAG_HEAPED) {
 					ct->ct_nreap++;
+				} else if (flags & CALLOUT_LIST_FLAG_WHEEL) {
+					callout_wheel_unlink(ct, cl);
+					CALLOUT_LIST_DELETE(ct->ct_clhash[
+					    CALLOUT_CLHASH(expiration)], cl);
+					CALLOUT_LIST_FREE(ct, cl);
 				} else if (flags & CALLOUT_LIST_FLAG_QUEUED) {
 					CALLOUT_LIST_DELETE(ct->ct_queue, cl);
 					CALLOUT_LIST_FREE(ct, cl);
@@ -1572,6 +1978,15 @@ callout_queue_realtime(callout_table_t *ct)
 	mutex_exit(&ct->ct_mutex);
 }
 
+void
+callout_wheel_realtime(callout_table_t *ct)
+{
+	mutex_enter(&ct->ct_mutex);
+	(void) callout_wheel_delete(ct);
+	callout_expire(ct);
+	mutex_exit(&ct->ct_mutex);
+}
+
 void
 callout_execute(callout_table_t *ct)
 {
@@ -1619,6 +2034,24 @@ callout_queue_normal(callout_table_t *ct)
 	}
 }
 
+void
+callout_wheel_normal(callout_table_t *ct)
+{
+	int i, exec;
+	hrtime_t exp;
+
+	mutex_enter(&ct->ct_mutex);
+	exp = callout_wheel_delete(ct);
+	CALLOUT_EXEC_COMPUTE(ct, exp, exec);
+	mutex_exit(&ct->ct_mutex);
+
+	for (i = 0; i < exec; i++) {
+		ASSERT(ct->ct_taskq != NULL);
+		(void) taskq_dispatch(ct->ct_taskq,
+		    (task_func_t *)callout_execute, ct, TQ_NOSLEEP);
+	}
+}
+
 /*
  * Suspend callout processing.
  */
@@ -1651,6 +2084,8 @@ callout_suspend(void)
 				    CY_INFINITY);
 				(void) cyclic_reprogram(ct->ct_qcyclic,
 				    CY_INFINITY);
+				(void) cyclic_reprogram(ct->ct_wcyclic,
+				    CY_INFINITY);
 			}
 			mutex_exit(&ct->ct_mutex);
 		}
@@ -1663,7 +2098,7 @@ callout_suspend(void)
 static void
 callout_resume(hrtime_t delta, int timechange)
 {
-	hrtime_t hexp, qexp;
+	hrtime_t hexp, qexp, wexp;
 	int t, f;
 	callout_table_t *ct;
 
@@ -1692,11 +2127,13 @@ callout_resume(hrtime_t delta, int timechange)
 			 */
 			hexp = callout_heap_process(ct, delta, timechange);
 			qexp = callout_queue_process(ct, delta, timechange);
+			wexp = callout_wheel_process(ct, delta);
 
 			ct->ct_suspend--;
 			if (ct->ct_suspend == 0) {
 				(void) cyclic_reprogram(ct->ct_cyclic, hexp);
 				(void) cyclic_reprogram(ct->ct_qcyclic, qexp);
+				(void) cyclic_reprogram(ct->ct_wcyclic, wexp);
 			}
 
 			mutex_exit(&ct->ct_mutex);
@@ -1819,7 +2256,13 @@ callout_hash_init(callout_table_t *ct)
 
 	size = sizeof (callout_hash_t) * CALLOUT_BUCKETS;
 	ct->ct_idhash = kmem_zalloc(size, KM_SLEEP);
+	ct->ct_idhash_mask = CALLOUT_BUCKETS - 1;
 	ct->ct_clhash = kmem_zalloc(size, KM_SLEEP);
+
+	size = sizeof (callout_hash_t) * CALLOUT_WHEEL_LEVELS *
+	    CALLOUT_WHEEL_SLOTS;
+	ct->ct_wheel = kmem_zalloc(size, KM_SLEEP);
+	ct->ct_wexp = CY_INFINITY;
 }
 
 /*
@@ -1859,7 +2302,7 @@ callout_cyclic_init(callout_table_t *ct)
 	cyc_time_t when;
 	processorid_t seqid;
 	int t;
-	cyclic_id_t cyclic, qcyclic;
+	cyclic_id_t cyclic, qcyclic, wcyclic;
 
 	ASSERT(MUTEX_HELD(&ct->ct_mutex));
 
@@ -1940,9 +2383,17 @@ callout_cyclic_init(callout_table_t *ct)
 
 	qcyclic = cyclic_add(&hdlr, &when);
 
+	if (t == CALLOUT_REALTIME)
+		hdlr.cyh_func = (cyc_func_t)callout_wheel_realtime;
+	else
+		hdlr.cyh_func = (cyc_func_t)callout_wheel_normal;
+
+	wcyclic = cyclic_add(&hdlr, &when);
+
 	mutex_enter(&ct->ct_mutex);
 	ct->ct_cyclic = cyclic;
 	ct->ct_qcyclic = qcyclic;
+	ct->ct_wcyclic = wcyclic;
 }
 
 void
@@ -2018,6 +2469,7 @@ callout_cpu_online(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, cp, NULL);
 		cyclic_bind(ct->ct_qcyclic, cp, NULL);
+		cyclic_bind(ct->ct_wcyclic, cp, NULL);
 	}
 }
 
@@ -2041,6 +2493,7 @@ callout_cpu_offline(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, NULL, NULL);
 		cyclic_bind(ct->ct_qcyclic, NULL, NULL);
+		cyclic_bind(ct->ct_wcyclic, NULL, NULL);
 	}
 }
 
@@ -2168,6 +2621,7 @@ callout_init(void)
 			 */
 			ct->ct_cyclic = CYCLIC_NONE;
 			ct->ct_qcyclic = CYCLIC_NONE;
+			ct->ct_wcyclic = CYCLIC_NONE;
 			ct->ct_kstat_data = kmem_zalloc(size, KM_SLEEP);
 		}
 	}
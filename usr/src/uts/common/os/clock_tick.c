@@ -131,6 +131,16 @@
  * clock_tick_scan
  *	Where to begin the scan for single-threaded mode. In multi-threaded,
  *	the clock_tick_set itself contains a field for this.
+ *
+ * clock_tick_idle_skip
+ *	In multi-threaded mode, don't X-call idle CPUs. A set in which every
+ *	CPU is idle has no thread to charge a tick to and is skipped; the
+ *	softint for any other set goes to one of its busy CPUs rather than
+ *	to the next CPU in the rotation. This keeps clock() from waking up
+ *	idle CPUs hz times a second.
+ *
+ * clock_tick_idle_sets
+ *	Number of times a set was skipped because all its CPUs were idle.
  */
 int			clock_tick_threshold;
 int			clock_tick_ncpus;
@@ -148,9 +158,13 @@ clock_tick_set_t	*clock_tick_set;
 int			clock_tick_nsets;
 int			clock_tick_scan;
 ulong_t			clock_tick_intr;
+int			clock_tick_idle_skip = 1;
+ulong_t			clock_tick_idle_sets;
 
 static uint_t	clock_tick_execute(caddr_t, caddr_t);
 static void	clock_tick_execute_common(int, int, int, clock_t, int);
+static cpu_t	*clock_tick_set_busy(clock_tick_set_t *);
+static int	clock_tick_steal(cpu_t *, int);
 
 #define	CLOCK_TICK_ALIGN	64	/* cache alignment */
 
@@ -288,6 +302,40 @@ clock_tick_schedule_one(clock_tick_set_t *csp, int pending, processorid_t cid)
 	 */
 }
 
+/*
+ * Under a hypervisor that reports steal time, don't charge the thread on a
+ * CPU with ticks during which the CPU wasn't really running: take the whole
+ * ticks stolen from the CPU since we last looked off the pending ticks.
+ * Stolen time in excess of the pending ticks (say, after the CPU has been
+ * idle and so not looked at for a while) is dropped.  As the scheduling
+ * classes do their usage and cap accounting per tick, this keeps FSS shares
+ * and CPU caps from charging for time the hypervisor took.
+ */
+static int
+clock_tick_steal(cpu_t *cp, int pending)
+{
+	clock_tick_cpu_t	*ctp;
+	hrtime_t		steal, stolen;
+	int			n;
+
+	if (cpu_steal_timef == NULL)
+		return (pending);
+
+	ctp = clock_tick_cpu[cp->cpu_id];
+	steal = cpu_steal_time(cp);
+	stolen = ctp->ct_stolen + (steal - ctp->ct_steal);
+	ctp->ct_steal = steal;
+
+	n = stolen / nsec_per_tick;
+	if (n >= pending) {
+		ctp->ct_stolen = 0;
+		return (0);
+	}
+	ctp->ct_stolen = stolen - (hrtime_t)n * nsec_per_tick;
+
+	return (pending - n);
+}
+
 static void
 clock_tick_process(cpu_t *cp, clock_t mylbolt, int pending)
 {
@@ -296,6 +344,9 @@ clock_tick_process(cpu_t *cp, clock_t mylbolt, int pending)
 	int		notick, intr;
 	klwp_id_t	lwp;
 
+	if ((pending = clock_tick_steal(cp, pending)) == 0)
+		return;
+
 	/*
 	 * The locking here is rather tricky. thread_free_prevent()
 	 * prevents the thread returned from being freed while we
@@ -504,6 +555,18 @@ clock_tick_schedule(int one_sec)
 		if (csp->ct_scan >= csp->ct_end)
 			csp->ct_scan = csp->ct_start;
 
+		if (clock_tick_idle_skip) {
+			cpu_t *bp;
+
+			if ((bp = clock_tick_set_busy(csp)) == NULL) {
+				clock_tick_idle_sets++;
+				continue;
+			}
+			clock_tick_schedule_one(csp, clock_tick_pending,
+			    bp->cpu_id);
+			continue;
+		}
+
 		clock_tick_schedule_one(csp, clock_tick_pending, cp->cpu_id);
 
 		cp = cp->cpu_next_onln;
@@ -525,6 +588,36 @@ clock_tick_schedule(int one_sec)
 	clock_tick_pending = 0;
 }
 
+/*
+ * Return a CPU of the set, other than the clock CPU, that is running
+ * something other than its idle thread, or NULL if there is none. The
+ * search starts at ct_scan so that the softints rotate among the busy
+ * CPUs. The check is racy; a thread that starts running on an idle CPU
+ * just after we look is charged on the next tick.
+ */
+static cpu_t *
+clock_tick_set_busy(clock_tick_set_t *csp)
+{
+	cpu_t	*cp;
+	int	i;
+
+	ASSERT(MUTEX_HELD(&clock_tick_lock));
+
+	for (i = csp->ct_scan; i < csp->ct_end; i++) {
+		cp = clock_tick_cpus[i];
+		if (cp != NULL && cp != CPU && CLOCK_TICK_XCALL_SAFE(cp) &&
+		    cp->cpu_thread != cp->cpu_idle_thread)
+			return (cp);
+	}
+	for (i = csp->ct_start; i < csp->ct_scan; i++) {
+		cp = clock_tick_cpus[i];
+		if (cp != NULL && cp != CPU && CLOCK_TICK_XCALL_SAFE(cp) &&
+		    cp->cpu_thread != cp->cpu_idle_thread)
+			return (cp);
+	}
+	return (NULL);
+}
+
 static void
 clock_tick_execute_common(int start, int scan, int end, clock_t mylbolt,
 	int pending)
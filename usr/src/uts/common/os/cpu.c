@@ -184,6 +184,7 @@ static struct cpu_sys_stats_ks_data {
 	kstat_named_t cpu_nsec_kernel;
 	kstat_named_t cpu_nsec_dtrace;
 	kstat_named_t cpu_nsec_intr;
+	kstat_named_t cpu_nsec_steal;
 	kstat_named_t cpu_load_intr;
 	kstat_named_t wait_ticks_io;
 	kstat_named_t dtrace_probes;
@@ -243,6 +244,7 @@ static struct cpu_sys_stats_ks_data {
 	{ "cpu_nsec_kernel",	KSTAT_DATA_UINT64 },
 	{ "cpu_nsec_dtrace",	KSTAT_DATA_UINT64 },
 	{ "cpu_nsec_intr",	KSTAT_DATA_UINT64 },
+	{ "cpu_nsec_steal",	KSTAT_DATA_UINT64 },
 	{ "cpu_load_intr",	KSTAT_DATA_UINT64 },
 	{ "wait_ticks_io",	KSTAT_DATA_UINT64 },
 	{ "dtrace_probes",	KSTAT_DATA_UINT64 },
@@ -3215,6 +3217,7 @@ cpu_sys_stats_ks_update(kstat_t *ksp, int rw)
 	csskd->cpu_nsec_dtrace.value.ui64 = cp->cpu_dtrace_nsec;
 	csskd->dtrace_probes.value.ui64 = cp->cpu_dtrace_probes;
 	csskd->cpu_nsec_intr.value.ui64 = cp->cpu_intrlast;
+	csskd->cpu_nsec_steal.value.ui64 = cpu_steal_time(cp);
 	csskd->cpu_load_intr.value.ui64 = cp->cpu_intrload;
 	csskd->bread.value.ui64 = css->bread;
 	csskd->bwrite.value.ui64 = css->bwrite;
@@ -177,6 +177,12 @@ int retire_prevents_attach = 1;
 
 int mtc_off;					/* turn off mt config */
 
+/*
+ * Most threads used to attach the children of a nexus that sets the
+ * DDI_PARALLEL_ATTACH property; 1 or less attaches them one at a time.
+ */
+int devi_attach_threads = 8;
+
 int quiesce_debug = 0;
 
 boolean_t ddi_aliases_present = B_FALSE;
@@ -1920,7 +1926,7 @@ ndi_devi_enter(dev_info_t *dip, int *circular)
 	    DEVI_BUSY_OWNED(dip));
 
 	mutex_enter(&devi->devi_lock);
-	if (devi->devi_busy_thread == curthread) {
+	if (DEVI_BUSY_OWNED(dip)) {
 		devi->devi_circular++;
 	} else {
 		while (DEVI_BUSY_CHANGING(devi) && !panicstr)
@@ -2019,7 +2025,7 @@ ndi_devi_tryenter(dev_info_t *dip, int *circular)
 	ASSERT(dip != NULL);
 
 	mutex_enter(&devi->devi_lock);
-	if (devi->devi_busy_thread == (void *)curthread) {
+	if (DEVI_BUSY_OWNED(dip)) {
 		devi->devi_circular++;
 	} else {
 		if (!DEVI_BUSY_CHANGING(devi)) {
@@ -5188,15 +5194,12 @@ init_bound_node_ev(dev_info_t *pdip, dev_info_t *dip, int flags)
 }
 
 /*
- * attach a node/branch with parent already held busy
+ * Set up a node to be attached, with its parent held busy.  Fails for
+ * nodes that are offline.
  */
 static int
-devi_attach_node(dev_info_t *dip, uint_t flags)
+devi_attach_start(dev_info_t *dip, uint_t flags)
 {
-	dev_info_t *pdip = ddi_get_parent(dip);
-
-	ASSERT(pdip && DEVI_BUSY_OWNED(pdip));
-
 	mutex_enter(&(DEVI(dip)->devi_lock));
 	if (flags & NDI_DEVI_ONLINE) {
 		if (!i_ddi_devi_attached(dip))
@@ -5209,23 +5212,39 @@ devi_attach_node(dev_info_t *dip, uint_t flags)
 	}
 	mutex_exit(&(DEVI(dip)->devi_lock));
 
-	if (i_ddi_attachchild(dip) != DDI_SUCCESS) {
-		mutex_enter(&(DEVI(dip)->devi_lock));
-		DEVI_SET_EVUNINIT(dip);
-		mutex_exit(&(DEVI(dip)->devi_lock));
+	return (NDI_SUCCESS);
+}
 
-		if (ndi_dev_is_persistent_node(dip))
-			(void) ddi_uninitchild(dip);
-		else {
-			/*
-			 * Delete .conf nodes and nodes that are not
-			 * well formed.
-			 */
-			(void) ddi_remove_child(dip, 0);
-		}
-		return (NDI_FAILURE);
+/*
+ * Clean up after a node that failed to attach.  This changes the parent's
+ * list of children, so must be done by the thread that owns the parent.
+ */
+static void
+devi_attach_failed(dev_info_t *dip)
+{
+	ASSERT(DEVI(ddi_get_parent(dip))->devi_busy_thread == curthread);
+
+	mutex_enter(&(DEVI(dip)->devi_lock));
+	DEVI_SET_EVUNINIT(dip);
+	mutex_exit(&(DEVI(dip)->devi_lock));
+
+	if (ndi_dev_is_persistent_node(dip))
+		(void) ddi_uninitchild(dip);
+	else {
+		/*
+		 * Delete .conf nodes and nodes that are not
+		 * well formed.
+		 */
+		(void) ddi_remove_child(dip, 0);
 	}
+}
 
+/*
+ * Report a node that has attached.
+ */
+static void
+devi_attach_done(dev_info_t *dip, uint_t flags)
+{
 	i_ndi_devi_report_status_change(dip, NULL);
 
 	/*
@@ -5243,10 +5262,163 @@ devi_attach_node(dev_info_t *dip, uint_t flags)
 		DEVI_SET_EVADD(dip);
 		mutex_exit(&(DEVI(dip)->devi_lock));
 	}
+}
 
+/*
+ * attach a node/branch with parent already held busy
+ */
+static int
+devi_attach_node(dev_info_t *dip, uint_t flags)
+{
+	dev_info_t *pdip = ddi_get_parent(dip);
+
+	ASSERT(pdip && DEVI_BUSY_OWNED(pdip));
+
+	if (devi_attach_start(dip, flags) != NDI_SUCCESS)
+		return (NDI_FAILURE);
+
+	if (i_ddi_attachchild(dip) != DDI_SUCCESS) {
+		devi_attach_failed(dip);
+		return (NDI_FAILURE);
+	}
+
+	devi_attach_done(dip, flags);
 	return (NDI_SUCCESS);
 }
 
+/*
+ * Parallel attach of the children of a nexus.
+ *
+ * Children are normally attached one after another by the thread that
+ * holds their parent busy.  Behind an HBA with hundreds of disks, whose
+ * attach(9E) each wait on the device, that is most of the time spent
+ * booting.  A nexus whose children can be attached concurrently says so
+ * with the DDI_PARALLEL_ATTACH property, and its children are then probed
+ * and attached by a taskq of up to devi_attach_threads threads, to which
+ * the busy parent is lent (see DEVI_BUSY_LENT).
+ *
+ * Only the probe and attach of a child go to the taskq.  Initializing a
+ * child (which may merge it with a sibling) and cleaning up after one
+ * that fails to attach change the parent's list of children, and are
+ * done by the thread that owns the parent, before and after the taskq.
+ */
+typedef struct devi_attach_task {
+	dev_info_t	*dat_dip;
+	uint_t		dat_flags;
+	int		dat_rv;
+} devi_attach_task_t;
+
+static void
+devi_attach_task(void *arg)
+{
+	devi_attach_task_t *dat = arg;
+
+	dat->dat_rv = i_ddi_attachchild(dat->dat_dip);
+	if (dat->dat_rv == DDI_SUCCESS)
+		devi_attach_done(dat->dat_dip, dat->dat_flags);
+}
+
+static boolean_t
+devi_attach_parallel(dev_info_t *pdip)
+{
+	return (devi_attach_threads > 1 && !MDI_VHCI(pdip) &&
+	    ddi_prop_exists(DDI_DEV_T_ANY, pdip, DDI_PROP_DONTPASS,
+	    DDI_PARALLEL_ATTACH));
+}
+
+/*
+ * Configure all nexus nodes or leaf nodes with matching driver major
+ */
+#define	CONFIG_CHILD(child, flags, major)				\
+	(((major) == DDI_MAJOR_T_NONE) ||				\
+	((major) == ddi_driver_major(child)) ||				\
+	(((flags) & NDI_CONFIG) && (is_leaf_node(child) == 0)))
+
+static void
+config_children_parallel(dev_info_t *pdip, uint_t flags, major_t major)
+{
+	dev_info_t		*child, *next;
+	devi_attach_task_t	*dat;
+	taskq_t			*tq;
+	int			i, n, nchildren;
+
+	ASSERT(DEVI(pdip)->devi_busy_thread == curthread);
+
+	nchildren = 0;
+	for (child = ddi_get_child(pdip); child != NULL;
+	    child = ddi_get_next_sibling(child))
+		nchildren++;
+	dat = kmem_alloc(nchildren * sizeof (*dat), KM_SLEEP);
+
+	/*
+	 * Initialize the children to attach.  Those that are already
+	 * attached, and those that have no driver and so will fail, are
+	 * done here.
+	 */
+	n = 0;
+	child = ddi_get_child(pdip);
+	while (child) {
+		/* NOTE: the child may be removed */
+		next = ddi_get_next_sibling(child);
+
+		if (!CONFIG_CHILD(child, flags, major)) {
+			child = next;
+			continue;
+		}
+		if (i_ddi_node_state(child) < DS_BOUND ||
+		    i_ddi_devi_attached(child)) {
+			(void) devi_attach_node(child, flags);
+			child = next;
+			continue;
+		}
+
+		if (devi_attach_start(child, flags) != NDI_SUCCESS) {
+			child = next;
+			continue;
+		}
+		if (i_ndi_config_node(child, DS_INITIALIZED, 0) !=
+		    NDI_SUCCESS) {
+			devi_attach_failed(child);
+			child = next;
+			continue;
+		}
+
+		dat[n].dat_dip = child;
+		dat[n].dat_flags = flags;
+		dat[n].dat_rv = DDI_FAILURE;
+		n++;
+		child = next;
+	}
+
+	if (n > 1) {
+		tq = taskq_create("devi_attach_taskq",
+		    MIN(n, devi_attach_threads), minclsyspri, n, n,
+		    TASKQ_PREPOPULATE);
+		mutex_enter(&DEVI(pdip)->devi_lock);
+		DEVI(pdip)->devi_busy_taskq = tq;
+		mutex_exit(&DEVI(pdip)->devi_lock);
+
+		for (i = 0; i < n; i++)
+			(void) taskq_dispatch(tq, devi_attach_task, &dat[i],
+			    TQ_SLEEP);
+		taskq_wait(tq);
+
+		mutex_enter(&DEVI(pdip)->devi_lock);
+		DEVI(pdip)->devi_busy_taskq = NULL;
+		mutex_exit(&DEVI(pdip)->devi_lock);
+		taskq_destroy(tq);
+	} else if (n == 1) {
+		devi_attach_task(&dat[0]);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (dat[i].dat_rv != DDI_SUCCESS)
+			devi_attach_failed(dat[i].dat_dip);
+	}
+
+	kmem_free(dat, nchildren * sizeof (*dat));
+}
+
 /* internal function to config immediate children */
 static int
 config_immediate_children(dev_info_t *pdip, uint_t flags, major_t major)
@@ -5274,18 +5446,18 @@ config_immediate_children(dev_info_t *pdip, uint_t flags, major_t major)
 	(void) i_ndi_make_spec_children(pdip, flags);
 	i_ndi_init_hw_children(pdip, flags);
 
+	if (circ == 0 && devi_attach_parallel(pdip)) {
+		config_children_parallel(pdip, flags, major);
+		ndi_devi_exit(pdip, circ);
+		return (NDI_SUCCESS);
+	}
+
 	child = ddi_get_child(pdip);
 	while (child) {
 		/* NOTE: devi_attach_node() may remove the dip */
 		next = ddi_get_next_sibling(child);
 
-		/*
-		 * Configure all nexus nodes or leaf nodes with
-		 * matching driver major
-		 */
-		if ((major == DDI_MAJOR_T_NONE) ||
-		    (major == ddi_driver_major(child)) ||
-		    ((flags & NDI_CONFIG) && (is_leaf_node(child) == 0)))
+		if (CONFIG_CHILD(child, flags, major))
 			(void) devi_attach_node(child, flags);
 		child = next;
 	}
@@ -128,9 +128,17 @@ char	    *dump_stack_scratch; /* scratch area for saving stack summary */
  * dump_metrics_on	if set, metrics are collected in the kernel, passed
  *	to savecore via the dump file, and recorded by savecore in
  *	METRICS.txt.
+ *
+ * dump_ncbuf_per_helper	number of output buffers per helper
+ *	The panic CPU writes the dump synchronously, and while it waits
+ *	for the device, helpers can only keep compressing as long as they
+ *	find free output buffers.  Apart from the few that are
+ *	preallocated, the buffers come from otherwise unused memory at
+ *	panic time, so raising this costs only virtual address space.
  */
 uint_t dump_ncpu_low = 4;	/* minimum config for parallel lzjb */
 uint_t dump_bzip2_level = 1;	/* bzip2 level (1-9) */
+uint_t dump_ncbuf_per_helper = 4; /* output buffers per helper */
 
 /* Use dump_plat_mincpu_default unless this variable is set by /etc/system */
 #define	MINCPU_NOT_SET	((uint_t)-1)
@@ -621,7 +629,9 @@ dump_update_clevel()
 		new->ncbuf = 1;
 		new->ncmap = 1;
 	} else {
-		new->ncbuf = NCBUF_PER_HELPER * new->nhelper;
+		if (dump_ncbuf_per_helper < NCBUF_PER_HELPER)
+			dump_ncbuf_per_helper = NCBUF_PER_HELPER;
+		new->ncbuf = dump_ncbuf_per_helper * new->nhelper;
 		new->ncmap = NCMAP_PER_HELPER * new->nhelper;
 	}
 
@@ -1069,7 +1079,10 @@ foundmax:
 		}
 	}
 
-	/* Finish allocating output buffers */
+	/*
+	 * Finish allocating output buffers.  Any beyond NCBUF_PER_HELPER
+	 * per helper come last, so they never cost a helper its memory.
+	 */
 	for (; cp < endcp && (sz + CBUF_SIZE) <= endsz; cp++) {
 		cp->state = CBUF_FREEBUF;
 		cp->size = CBUF_SIZE;
@@ -1306,6 +1306,32 @@ f_setfd(int fd, char flags)
 	(void) f_setfd_error(fd, flags);
 }
 
+/*
+ * Close file descriptor 'start' and all the ones above it that are open,
+ * for closefrom(3C) and posix_spawn_file_actions_addclosefrom_np(3C); it
+ * is not an error if none are.
+ */
+int
+f_closefrom(int start)
+{
+	uf_info_t *fip = P_FINFO(curproc);
+	uf_entry_t *ufp;
+	file_t *fp;
+	int fd;
+
+	if (start < 0)
+		return (EBADF);
+
+	for (fd = start; fd < fip->fi_nfiles; fd++) {
+		UF_ENTER(ufp, fip, fd);
+		fp = ufp->uf_file;
+		UF_EXIT(ufp);
+		if (fp != NULL)
+			(void) closeandsetf(fd, NULL);
+	}
+	return (0);
+}
+
 #define	BADFD_MIN	3
 #define	BADFD_MAX	255
 
@@ -817,6 +817,7 @@
 #include <sys/atomic.h>
 #include <sys/kobj.h>
 #include <sys/disp.h>
+#include <sys/lgrp.h>
 #include <vm/seg_kmem.h>
 #include <sys/log.h>
 #include <sys/callb.h>
@@ -846,7 +847,10 @@ struct kmem_cache_kstat {
 	kstat_named_t	kmc_depot_alloc;
 	kstat_named_t	kmc_depot_free;
 	kstat_named_t	kmc_depot_contention;
+	kstat_named_t	kmc_lgrp_depot_alloc;
 	kstat_named_t	kmc_slab_alloc;
+	kstat_named_t	kmc_slab_alloc_local;
+	kstat_named_t	kmc_slab_alloc_remote;
 	kstat_named_t	kmc_slab_free;
 	kstat_named_t	kmc_buf_constructed;
 	kstat_named_t	kmc_buf_avail;
@@ -885,7 +889,10 @@ struct kmem_cache_kstat {
 	{ "depot_alloc",	KSTAT_DATA_UINT64 },
 	{ "depot_free",		KSTAT_DATA_UINT64 },
 	{ "depot_contention",	KSTAT_DATA_UINT64 },
+	{ "lgrp_depot_alloc",	KSTAT_DATA_UINT64 },
 	{ "slab_alloc",		KSTAT_DATA_UINT64 },
+	{ "slab_alloc_local",	KSTAT_DATA_UINT64 },
+	{ "slab_alloc_remote",	KSTAT_DATA_UINT64 },
 	{ "slab_free",		KSTAT_DATA_UINT64 },
 	{ "buf_constructed",	KSTAT_DATA_UINT64 },
 	{ "buf_avail",		KSTAT_DATA_UINT64 },
@@ -989,6 +996,7 @@ static uint32_t kmem_reaping_idspace;
  */
 clock_t kmem_reap_interval;	/* cache reaping rate [15 * HZ ticks] */
 int kmem_depot_contention = 3;	/* max failed tryenters per real interval */
+int kmem_lgrp_depot_max = 4;	/* max full magazines per lgroup [0: off] */
 pgcnt_t kmem_reapahead = 0;	/* start reaping N pages before pageout */
 int kmem_panic = 1;		/* whether to panic on error */
 int kmem_logging = 1;		/* kmem_log_enter() override */
@@ -1519,6 +1527,60 @@ kmem_log_event(kmem_log_header_t *lp, kmem_cache_t *cp,
 	KMEM_AUDIT(lp, cp, &bca);
 }
 
+/*
+ * Return the lgroup of the CPU we're running on, or LGRP_NONE if the cache
+ * doesn't track lgroups.  As with KMEM_CPU_CACHE(), we may be preempted and
+ * migrated right after looking; that only costs us some locality.
+ */
+static lgrp_id_t
+kmem_lgrp_id(kmem_cache_t *cp)
+{
+	lpl_t *lpl;
+
+	if (cp->cache_lgrp_full == NULL || (lpl = CPU->cpu_lpl) == NULL ||
+	    lpl->lpl_lgrpid < 0 || lpl->lpl_lgrpid >= nlgrpsmax)
+		return (LGRP_NONE);
+	return (lpl->lpl_lgrpid);
+}
+
+/*
+ * Return the lgroup whose memory backs a new slab.  Slab pages come from
+ * segkmem, which already places them according to the allocating thread's
+ * home lgroup; this just records where they landed, so that the slab layer
+ * can report how often objects are handed out to remote CPUs.
+ */
+static lgrp_id_t
+kmem_slab_lgrp(kmem_cache_t *cp, void *slab)
+{
+	lgrp_t *lgrp;
+	pfn_t pfn;
+
+	if (cp->cache_lgrp_full == NULL ||
+	    (cp->cache_cflags & (KMC_NOTOUCH | KMC_IDENTIFIER)))
+		return (LGRP_NONE);
+
+	pfn = hat_getpfnum(kas.a_hat, (caddr_t)slab);
+	if (pfn == PFN_INVALID || (lgrp = lgrp_pfn_to_lgrp(pfn)) == NULL)
+		return (LGRP_NONE);
+	return (lgrp->lgrp_id);
+}
+
+/*
+ * Account for n objects allocated from slab sp by the current CPU.
+ */
+static void
+kmem_slab_lgrp_alloc(kmem_cache_t *cp, kmem_slab_t *sp, size_t n)
+{
+	ASSERT(MUTEX_HELD(&cp->cache_lock));
+
+	if (sp->slab_lgrpid == LGRP_NONE)
+		return;
+	if (sp->slab_lgrpid == kmem_lgrp_id(cp))
+		cp->cache_slab_alloc_local += n;
+	else
+		cp->cache_slab_alloc_remote += n;
+}
+
 /*
  * Create a new slab for cache cp.
  */
@@ -1575,6 +1637,7 @@ kmem_slab_create(kmem_cache_t *cp, int kmflag)
 	sp->slab_stuck_offset = (uint32_t)-1;
 	sp->slab_later_count = 0;
 	sp->slab_flags = 0;
+	sp->slab_lgrpid = kmem_slab_lgrp(cp, slab);
 
 	ASSERT(chunks > 0);
 	while (chunks-- != 0) {
@@ -1675,6 +1738,7 @@ kmem_slab_alloc_impl(kmem_cache_t *cp, kmem_slab_t *sp, boolean_t prefill)
 	cp->cache_slab_alloc++;
 	cp->cache_bufslab--;
 	sp->slab_refcnt++;
+	kmem_slab_lgrp_alloc(cp, sp, 1);
 
 	bcp = sp->slab_head;
 	sp->slab_head = bcp->bc_next;
@@ -2155,6 +2219,75 @@ kmem_depot_free(kmem_cache_t *cp, kmem_maglist_t *mlp, kmem_magazine_t *mp)
 	mutex_exit(&cp->cache_depot_lock);
 }
 
+/*
+ * Allocate a full magazine, preferring one that was freed on this lgroup.
+ * The per-lgroup lists are checked without the depot lock first, since
+ * they're usually empty and the common case shouldn't pay for them.
+ */
+static kmem_magazine_t *
+kmem_depot_alloc_full(kmem_cache_t *cp)
+{
+	kmem_maglist_t *mlp;
+	kmem_magazine_t *mp;
+	lgrp_id_t lgrpid;
+
+	if ((lgrpid = kmem_lgrp_id(cp)) != LGRP_NONE) {
+		mlp = &cp->cache_lgrp_full[lgrpid];
+		if (mlp->ml_total > 0 &&
+		    (mp = kmem_depot_alloc(cp, mlp)) != NULL)
+			return (mp);
+	}
+
+	return (kmem_depot_alloc(cp, &cp->cache_full));
+}
+
+/*
+ * Free a full magazine to this lgroup's list, or to the shared list once
+ * the lgroup holds kmem_lgrp_depot_max of them.  The limit is checked
+ * without the lock, so it may be exceeded slightly by racing frees.
+ */
+static void
+kmem_depot_free_full(kmem_cache_t *cp, kmem_magazine_t *mp)
+{
+	kmem_maglist_t *mlp = &cp->cache_full;
+	lgrp_id_t lgrpid;
+
+	if ((lgrpid = kmem_lgrp_id(cp)) != LGRP_NONE &&
+	    cp->cache_lgrp_full[lgrpid].ml_total < kmem_lgrp_depot_max)
+		mlp = &cp->cache_lgrp_full[lgrpid];
+
+	kmem_depot_free(cp, mlp, mp);
+}
+
+/*
+ * Move the per-lgroup full magazines back to the shared list, so that the
+ * depot's reaping and purging see all of them.
+ */
+static void
+kmem_depot_lgrp_drain(kmem_cache_t *cp)
+{
+	kmem_maglist_t *mlp;
+	kmem_magazine_t *mp;
+	int i;
+
+	ASSERT(MUTEX_HELD(&cp->cache_depot_lock));
+
+	if (cp->cache_lgrp_full == NULL)
+		return;
+
+	for (i = 0; i < nlgrpsmax; i++) {
+		mlp = &cp->cache_lgrp_full[i];
+		while ((mp = mlp->ml_list) != NULL) {
+			mlp->ml_list = mp->mag_next;
+			mlp->ml_total--;
+			mp->mag_next = cp->cache_full.ml_list;
+			cp->cache_full.ml_list = mp;
+			cp->cache_full.ml_total++;
+		}
+		mlp->ml_min = 0;
+	}
+}
+
 /*
  * Update the working set statistics for cp's depot.
  */
@@ -2177,6 +2310,7 @@ static void
 kmem_depot_ws_zero(kmem_cache_t *cp)
 {
 	mutex_enter(&cp->cache_depot_lock);
+	kmem_depot_lgrp_drain(cp);
 	cp->cache_full.ml_reaplimit = cp->cache_full.ml_total;
 	cp->cache_full.ml_min = cp->cache_full.ml_total;
 	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_total;
@@ -2571,7 +2705,7 @@ kmem_cache_alloc(kmem_cache_t *cp, int kmflag)
 		/*
 		 * Try to get a full magazine from the depot.
 		 */
-		fmp = kmem_depot_alloc(cp, &cp->cache_full);
+		fmp = kmem_depot_alloc_full(cp);
 		if (fmp != NULL) {
 			if (ccp->cc_ploaded != NULL)
 				kmem_depot_free(cp, &cp->cache_empty,
@@ -2681,8 +2815,7 @@ kmem_cpucache_magazine_alloc(kmem_cpu_cache_t *ccp, kmem_cache_t *cp)
 	emp = kmem_depot_alloc(cp, &cp->cache_empty);
 	if (emp != NULL) {
 		if (ccp->cc_ploaded != NULL)
-			kmem_depot_free(cp, &cp->cache_full,
-			    ccp->cc_ploaded);
+			kmem_depot_free_full(cp, ccp->cc_ploaded);
 		kmem_cpu_reload(ccp, emp, 0);
 		return (1);
 	}
@@ -2801,6 +2934,126 @@ kmem_cache_free(kmem_cache_t *cp, void *buf)
 	kmem_slab_free_constructed(cp, buf, B_TRUE);
 }
 
+/*
+ * Allocate up to nbufs constructed objects from cache cp into bufs[].
+ * Whole runs of rounds are moved out of the CPU's loaded magazines under
+ * a single acquisition of cc_lock; anything the magazine layer can't
+ * supply is allocated one at a time via kmem_cache_alloc().  Returns the
+ * number of objects allocated, which is less than nbufs only if an
+ * allocation fails (e.g. with KM_NOSLEEP or a failing constructor).
+ */
+size_t
+kmem_cache_alloc_batch(kmem_cache_t *cp, void **bufs, size_t nbufs,
+    int kmflag)
+{
+	kmem_cpu_cache_t *ccp = KMEM_CPU_CACHE(cp);
+	kmem_magazine_t *fmp;
+	size_t n = 0;
+
+	/*
+	 * Debug and dump-time caches need per-object handling.
+	 */
+	if (ccp->cc_flags & (KMF_BUFTAG | KMF_DUMPDIVERT | KMF_DUMPUNSAFE))
+		goto slow;
+
+	mutex_enter(&ccp->cc_lock);
+	while (n < nbufs) {
+		if (ccp->cc_rounds > 0) {
+			size_t take = MIN(nbufs - n, (size_t)ccp->cc_rounds);
+
+			ccp->cc_rounds -= (short)take;
+			bcopy(&ccp->cc_loaded->mag_round[ccp->cc_rounds],
+			    &bufs[n], take * sizeof (void *));
+			ccp->cc_alloc += take;
+			n += take;
+			continue;
+		}
+
+		if (ccp->cc_prounds > 0) {
+			kmem_cpu_reload(ccp, ccp->cc_ploaded, ccp->cc_prounds);
+			continue;
+		}
+
+		if (ccp->cc_magsize == 0 ||
+		    (ccp->cc_flags & (KMF_DUMPDIVERT | KMF_DUMPUNSAFE)))
+			break;
+
+		fmp = kmem_depot_alloc_full(cp);
+		if (fmp == NULL)
+			break;
+		if (ccp->cc_ploaded != NULL)
+			kmem_depot_free(cp, &cp->cache_empty, ccp->cc_ploaded);
+		kmem_cpu_reload(ccp, fmp, ccp->cc_magsize);
+	}
+	mutex_exit(&ccp->cc_lock);
+
+slow:
+	while (n < nbufs) {
+		if ((bufs[n] = kmem_cache_alloc(cp, kmflag)) == NULL)
+			break;
+		n++;
+	}
+	return (n);
+}
+
+/*
+ * Free nbufs constructed objects in bufs[] to cache cp.  This is the batch
+ * counterpart of kmem_cache_free(): runs of objects are copied into the
+ * CPU's loaded magazines under a single acquisition of cc_lock.
+ */
+void
+kmem_cache_free_batch(kmem_cache_t *cp, void **bufs, size_t nbufs)
+{
+	kmem_cpu_cache_t *ccp = KMEM_CPU_CACHE(cp);
+	size_t n = 0;
+
+#ifdef DEBUG
+	for (size_t i = 0; i < nbufs; i++) {
+		ASSERT(cp->cache_defrag == NULL ||
+		    cp->cache_defrag->kmd_thread != curthread ||
+		    (bufs[i] != cp->cache_defrag->kmd_from_buf &&
+		    bufs[i] != cp->cache_defrag->kmd_to_buf));
+	}
+#endif
+
+	if (ccp->cc_flags & (KMF_BUFTAG | KMF_DUMPDIVERT | KMF_DUMPUNSAFE))
+		goto slow;
+
+	mutex_enter(&ccp->cc_lock);
+	while (n < nbufs) {
+		if (ccp->cc_rounds >= 0 &&
+		    (uint_t)ccp->cc_rounds < ccp->cc_magsize) {
+			size_t put = MIN(nbufs - n,
+			    (size_t)(ccp->cc_magsize - ccp->cc_rounds));
+
+			bcopy(&bufs[n],
+			    &ccp->cc_loaded->mag_round[ccp->cc_rounds],
+			    put * sizeof (void *));
+			ccp->cc_rounds += (short)put;
+			ccp->cc_free += put;
+			n += put;
+			continue;
+		}
+
+		if (ccp->cc_prounds == 0) {
+			kmem_cpu_reload(ccp, ccp->cc_ploaded, ccp->cc_prounds);
+			continue;
+		}
+
+		if (ccp->cc_magsize == 0 ||
+		    (ccp->cc_flags & (KMF_DUMPDIVERT | KMF_DUMPUNSAFE)))
+			break;
+
+		if (!kmem_cpucache_magazine_alloc(ccp, cp))
+			break;
+	}
+	mutex_exit(&ccp->cc_lock);
+
+slow:
+	for (; n < nbufs; n++)
+		kmem_cache_free(cp, bufs[n]);
+}
+
 static void
 kmem_slab_prefill(kmem_cache_t *cp, kmem_slab_t *sp)
 {
@@ -2829,6 +3082,7 @@ kmem_slab_prefill(kmem_cache_t *cp, kmem_slab_t *sp)
 	sp->slab_refcnt += nbufs;
 	cp->cache_bufslab -= nbufs;
 	cp->cache_slab_alloc += nbufs;
+	kmem_slab_lgrp_alloc(cp, sp, nbufs);
 	list_insert_head(&cp->cache_complete_slabs, sp);
 	cp->cache_complete_slab_count++;
 	mutex_exit(&cp->cache_lock);
@@ -3162,6 +3416,7 @@ kmem_reap_start(void *flag)
 		 */
 		if (segkp_fromheap)
 			segkp_cache_free();
+		vmem_segcache_reap();
 	}
 	else
 		kmem_cache_applyall_id(kmem_cache_reap, kmem_taskq, TQ_NOSLEEP);
@@ -3461,7 +3716,8 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmem_cache_t *cp = ksp->ks_private;
 	uint64_t cpu_buf_avail;
 	uint64_t buf_avail = 0;
-	int cpu_seqid;
+	uint64_t lgrp_alloc = 0, lgrp_full = 0;
+	int cpu_seqid, i;
 	long reap;
 
 	ASSERT(MUTEX_HELD(&kmem_cache_kstat_lock));
@@ -3476,6 +3732,8 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmcp->kmc_free.value.ui64		= cp->cache_slab_free;
 	kmcp->kmc_slab_alloc.value.ui64		= cp->cache_slab_alloc;
 	kmcp->kmc_slab_free.value.ui64		= cp->cache_slab_free;
+	kmcp->kmc_slab_alloc_local.value.ui64	= cp->cache_slab_alloc_local;
+	kmcp->kmc_slab_alloc_remote.value.ui64	= cp->cache_slab_alloc_remote;
 
 	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++) {
 		kmem_cpu_cache_t *ccp = &cp->cache_cpu[cpu_seqid];
@@ -3497,18 +3755,30 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 
 	mutex_enter(&cp->cache_depot_lock);
 
-	kmcp->kmc_depot_alloc.value.ui64	= cp->cache_full.ml_alloc;
+	if (cp->cache_lgrp_full != NULL) {
+		for (i = 0; i < nlgrpsmax; i++) {
+			lgrp_alloc += cp->cache_lgrp_full[i].ml_alloc;
+			lgrp_full += cp->cache_lgrp_full[i].ml_total;
+		}
+	}
+
+	kmcp->kmc_depot_alloc.value.ui64	=
+	    cp->cache_full.ml_alloc + lgrp_alloc;
 	kmcp->kmc_depot_free.value.ui64		= cp->cache_empty.ml_alloc;
 	kmcp->kmc_depot_contention.value.ui64	= cp->cache_depot_contention;
-	kmcp->kmc_full_magazines.value.ui64	= cp->cache_full.ml_total;
+	kmcp->kmc_lgrp_depot_alloc.value.ui64	= lgrp_alloc;
+	kmcp->kmc_full_magazines.value.ui64	=
+	    cp->cache_full.ml_total + lgrp_full;
 	kmcp->kmc_empty_magazines.value.ui64	= cp->cache_empty.ml_total;
 	kmcp->kmc_magazine_size.value.ui64	=
 	    (cp->cache_flags & KMF_NOMAGAZINE) ?
 	    0 : cp->cache_magtype->mt_magsize;
 
-	kmcp->kmc_alloc.value.ui64		+= cp->cache_full.ml_alloc;
+	kmcp->kmc_alloc.value.ui64		+=
+	    cp->cache_full.ml_alloc + lgrp_alloc;
 	kmcp->kmc_free.value.ui64		+= cp->cache_empty.ml_alloc;
-	buf_avail += cp->cache_full.ml_total * cp->cache_magtype->mt_magsize;
+	buf_avail += (cp->cache_full.ml_total + lgrp_full) *
+	    cp->cache_magtype->mt_magsize;
 
 	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
 	reap = MIN(reap, cp->cache_full.ml_total);
@@ -3974,6 +4244,12 @@ kmem_cache_create(
 	 * Initialize the depot.
 	 */
 	mutex_init(&cp->cache_depot_lock, NULL, MUTEX_DEFAULT, NULL);
+	if (nlgrpsmax > 1) {
+		cp->cache_lgrp_full = vmem_alloc(kmem_cache_arena,
+		    nlgrpsmax * sizeof (kmem_maglist_t), VM_SLEEP);
+		bzero(cp->cache_lgrp_full,
+		    nlgrpsmax * sizeof (kmem_maglist_t));
+	}
 
 	for (mtp = kmem_magtype; chunksize <= mtp->mt_minbuf; mtp++)
 		continue;
@@ -4163,6 +4439,10 @@ kmem_cache_destroy(kmem_cache_t *cp)
 	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++)
 		mutex_destroy(&cp->cache_cpu[cpu_seqid].cc_lock);
 
+	if (cp->cache_lgrp_full != NULL)
+		vmem_free(kmem_cache_arena, cp->cache_lgrp_full,
+		    nlgrpsmax * sizeof (kmem_maglist_t));
+
 	mutex_destroy(&cp->cache_depot_lock);
 	mutex_destroy(&cp->cache_lock);
 
@@ -4516,6 +4796,15 @@ kmem_init(void)
 
 	kmem_cache_applyall(kmem_cache_magazine_enable, NULL, TQ_SLEEP);
 
+#if defined(_LP64)
+	/*
+	 * Cache larger segments per-CPU in the two busiest VA arenas.  The
+	 * cached address space is never a concern on a 64-bit heap.
+	 */
+	vmem_segcache_enable(heap_arena);
+	vmem_segcache_enable(kmem_va_arena);
+#endif
+
 	kmem_ready = 1;
 
 	/*
@@ -4684,7 +4973,7 @@ kmem_hunt_mags(kmem_cache_t *cp, void *buf)
 {
 	kmem_cpu_cache_t *ccp;
 	kmem_magazine_t	*m;
-	int cpu_seqid;
+	int cpu_seqid, i;
 	int n;		/* magazine rounds */
 	void *tbuf;	/* temporary swap buffer */
 
@@ -4716,6 +5005,15 @@ kmem_hunt_mags(kmem_cache_t *cp, void *buf)
 			return (buf);
 		}
 	}
+	for (i = 0; cp->cache_lgrp_full != NULL && i < nlgrpsmax; i++) {
+		for (m = cp->cache_lgrp_full[i].ml_list; m != NULL;
+		    m = m->mag_next) {
+			if (kmem_hunt_mag(cp, m, n, buf, tbuf) != NULL) {
+				mutex_exit(&cp->cache_depot_lock);
+				return (buf);
+			}
+		}
+	}
 	mutex_exit(&cp->cache_depot_lock);
 
 	/* Hunt the per-CPU magazines. */
@@ -54,6 +54,7 @@
 #include <sys/cpupart.h>
 #include <sys/zone.h>
 #include <sys/loadavg.h>
+#include <sys/pcpu_counter.h>
 #include <vm/page.h>
 #include <vm/anon.h>
 #include <vm/seg_kmem.h>
@@ -1447,3 +1448,74 @@ kstat_timer_stop(kstat_timer_t *ktp)
 	ktp->elapsed_time += etime;
 	ktp->num_events = num_events + 1;
 }
+
+/*
+ * Per-CPU counters; see <sys/pcpu_counter.h>.  Each CPU's copy of the set
+ * is rounded up to a whole number of cache lines, and the copies are laid
+ * out by cpu_seqid, which is below max_ncpus for every CPU that can ever
+ * come online.
+ */
+pcpu_counter_t *
+pcpu_counter_create(uint_t ncounters, int kmflag)
+{
+	pcpu_counter_t *pc;
+	size_t line = CPU_CACHE_COHERENCE_SIZE;
+
+	ASSERT(ncounters != 0);
+
+	if ((pc = kmem_zalloc(sizeof (*pc), kmflag)) == NULL)
+		return (NULL);
+
+	pc->pcc_ncounters = ncounters;
+	pc->pcc_stride = P2ROUNDUP(ncounters * sizeof (uint64_t), line) /
+	    sizeof (uint64_t);
+	pc->pcc_bufsize = max_ncpus * pc->pcc_stride * sizeof (uint64_t) + line;
+	if ((pc->pcc_buf = kmem_zalloc(pc->pcc_bufsize, kmflag)) == NULL) {
+		kmem_free(pc, sizeof (*pc));
+		return (NULL);
+	}
+	pc->pcc_base = (uint64_t *)P2ROUNDUP((uintptr_t)pc->pcc_buf, line);
+
+	return (pc);
+}
+
+void
+pcpu_counter_destroy(pcpu_counter_t *pc)
+{
+	if (pc == NULL)
+		return;
+	kmem_free(pc->pcc_buf, pc->pcc_bufsize);
+	kmem_free(pc, sizeof (*pc));
+}
+
+uint64_t
+pcpu_counter_sum(pcpu_counter_t *pc, uint_t i)
+{
+	uint64_t sum = 0;
+	uint64_t *p;
+	int c;
+
+	ASSERT(i < pc->pcc_ncounters);
+
+	p = pc->pcc_base + i;
+	for (c = 0; c < max_ncpus; c++, p += pc->pcc_stride)
+		sum += *p;
+
+	return (sum);
+}
+
+/*
+ * Store the sums of the set into the first pcc_ncounters entries of a
+ * named kstat's data, which must all be KSTAT_DATA_UINT64.  Intended to be
+ * called from ks_update for a kstat whose layout the set mirrors.
+ */
+void
+pcpu_counter_kstat_update(pcpu_counter_t *pc, kstat_named_t *knp)
+{
+	uint_t i;
+
+	for (i = 0; i < pc->pcc_ncounters; i++) {
+		ASSERT(knp[i].data_type == KSTAT_DATA_UINT64);
+		knp[i].value.ui64 = pcpu_counter_sum(pc, i);
+	}
+}
@@ -3295,9 +3295,19 @@ lgrp_move_thread(kthread_t *t, lpl_t *newlpl, int do_lgrpset_delete)
 	    (p->p_tlist != NULL)) {
 		oldid = oldlpl->lpl_lgrpid;
 
-		if (newlpl != NULL)
+		if (newlpl != NULL) {
 			lgrp_stat_add(oldid, LGRP_NUM_MIGR, 1);
 
+			/*
+			 * Let segvn_pmig_scan() know that this process may
+			 * have memory left behind in the old lgroup.
+			 */
+			if (newlpl->lpl_lgrpid != oldid &&
+			    oldid != LGRP_ROOTID &&
+			    newlpl->lpl_lgrpid != LGRP_ROOTID)
+				p->p_lgrp_rehomed = 1;
+		}
+
 		if ((do_lgrpset_delete) &&
 		    (klgrpset_ismember(p->p_lgrpset, oldid))) {
 			for (tp = p->p_tlist->t_forw; ; tp = tp->t_forw) {
@@ -3445,6 +3455,8 @@ lgrp_madv_to_policy(uchar_t advice, size_t size, int type)
 		return (LGRP_MEM_POLICY_NEXT);
 	case MADV_ACCESS_MANY:
 		return (LGRP_MEM_POLICY_RANDOM);
+	case MADV_ACCESS_INTERLEAVE:
+		return (LGRP_MEM_POLICY_ROUNDROBIN);
 	default:
 		return (lgrp_mem_policy_default(size, type));
 	}
@@ -3547,6 +3559,7 @@ lgrp_privm_policy_set(lgrp_mem_policy_t policy,
 	 */
 	policy_info->mem_policy = policy;
 	policy_info->mem_lgrpid = LGRP_NONE;
+	policy_info->mem_lgrpset = 0;
 
 	return (0);
 }
@@ -3633,6 +3646,7 @@ lgrp_mem_choose(struct seg *seg, caddr_t vaddr, size_t pgsz)
 	unsigned long		off;
 	lgrp_mem_policy_t	policy;
 	lgrp_mem_policy_info_t	*policy_info;
+	klgrpset_t		policy_lgrpset = 0;
 	ushort_t		random;
 	int			stat = 0;
 	extern struct seg	*segkmap;
@@ -3659,6 +3673,9 @@ lgrp_mem_choose(struct seg *seg, caddr_t vaddr, size_t pgsz)
 			policy_info = lgrp_mem_policy_get(seg, vaddr);
 			if (policy_info != NULL) {
 				policy = policy_info->mem_policy;
+				if (policy == LGRP_MEM_POLICY_ROUNDROBIN)
+					policy_lgrpset =
+					    policy_info->mem_lgrpset;
 				if (policy == LGRP_MEM_POLICY_NEXT_SEG) {
 					lgrp_id_t id = policy_info->mem_lgrpid;
 					ASSERT(id != LGRP_NONE);
@@ -3684,9 +3701,10 @@ lgrp_mem_choose(struct seg *seg, caddr_t vaddr, size_t pgsz)
 
 	/*
 	 * When homing threads on root lgrp, override default memory
-	 * allocation policies with root lgroup memory allocation policy
+	 * allocation policies with root lgroup memory allocation policy,
+	 * unless the segment asked for specific lgroups.
 	 */
-	if (lgrp == lgrp_root)
+	if (lgrp == lgrp_root && policy_lgrpset == 0)
 		policy = lgrp_mem_policy_root;
 
 	/*
@@ -3840,6 +3858,33 @@ lgrp_mem_choose(struct seg *seg, caddr_t vaddr, size_t pgsz)
 
 	case LGRP_MEM_POLICY_ROUNDROBIN:
 
+		/*
+		 * If the segment named the lgroups to use, deal its pages
+		 * out across those that have memory in order of offset, so
+		 * that the layout doesn't depend on who touches it first.
+		 */
+		kpreempt_disable();
+		lgrpset = lgrp_root->lgrp_set[LGRP_RSRC_MEM];
+		kpreempt_enable();
+		if (klgrpset_intersects(lgrpset, policy_lgrpset)) {
+			klgrpset_and(lgrpset, policy_lgrpset);
+			klgrpset_nlgrps(lgrpset, lgrps_spanned);
+			off = ((unsigned long)(vaddr - seg->s_base) / pgsz) %
+			    lgrps_spanned;
+
+			for (i = 0; i <= lgrp_alloc_max; i++) {
+				if (!klgrpset_ismember(lgrpset, i))
+					continue;
+				if (off == 0)
+					break;
+				off--;
+			}
+			ASSERT(i <= lgrp_alloc_max);
+			lgrp = lgrp_table[i];
+			lgrp_stat_add(lgrp->lgrp_id, LGRP_NUM_ROUNDROBIN, 1);
+			break;
+		}
+
 		/*
 		 * Use offset within segment to determine
 		 * offset from home lgroup to choose for
@@ -4069,7 +4114,8 @@ lgrp_shm_policy_concat(avl_tree_t *tree, lgrp_shm_policy_seg_t *seg1,
 {
 	if (!seg1 || !seg2 ||
 	    seg1->shm_off + seg1->shm_size != seg2->shm_off ||
-	    seg1->shm_policy.mem_policy != seg2->shm_policy.mem_policy)
+	    seg1->shm_policy.mem_policy != seg2->shm_policy.mem_policy ||
+	    seg1->shm_policy.mem_lgrpset != seg2->shm_policy.mem_lgrpset)
 		return (-1);
 
 	seg1->shm_size += seg2->shm_size;
@@ -4127,6 +4173,19 @@ lgrp_shm_policy_split(avl_tree_t *tree, lgrp_shm_policy_seg_t *seg,
 int
 lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
     ulong_t anon_index, vnode_t *vp, u_offset_t vn_off, size_t len)
+{
+	return (lgrp_shm_policy_set_lgrps(policy, 0, amp, anon_index, vp,
+	    vn_off, len));
+}
+
+/*
+ * As lgrp_shm_policy_set(), but a LGRP_MEM_POLICY_ROUNDROBIN policy only
+ * spreads pages across the lgroups in lgrpset, if it's not empty.
+ */
+int
+lgrp_shm_policy_set_lgrps(lgrp_mem_policy_t policy, klgrpset_t lgrpset,
+    struct anon_map *amp, ulong_t anon_index, vnode_t *vp, u_offset_t vn_off,
+    size_t len)
 {
 	u_offset_t		eoff;
 	lgrp_shm_policy_seg_t	*next;
@@ -4184,6 +4243,8 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 	 */
 	if (policy == LGRP_MEM_POLICY_DEFAULT)
 		policy = lgrp_mem_policy_default(len, MAP_SHARED);
+	if (policy != LGRP_MEM_POLICY_ROUNDROBIN)
+		lgrpset = 0;
 
 	/*
 	 * Create AVL tree if there isn't one yet
@@ -4235,6 +4296,7 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 			    KM_SLEEP);
 			newseg->shm_policy.mem_policy = policy;
 			newseg->shm_policy.mem_lgrpid = LGRP_NONE;
+			newseg->shm_policy.mem_lgrpset = lgrpset;
 			newseg->shm_off = off;
 			avl_insert(tree, newseg, where);
 
@@ -4273,7 +4335,8 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 		/*
 		 * Policy set already?
 		 */
-		if (policy == seg->shm_policy.mem_policy) {
+		if (policy == seg->shm_policy.mem_policy &&
+		    lgrpset == seg->shm_policy.mem_lgrpset) {
 			/*
 			 * Nothing left to do if offset and length
 			 * fall within this segment
@@ -4297,6 +4360,7 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 			 */
 			seg->shm_policy.mem_policy = policy;
 			seg->shm_policy.mem_lgrpid = LGRP_NONE;
+			seg->shm_policy.mem_lgrpset = lgrpset;
 			len = 0;
 
 			/*
@@ -4331,6 +4395,8 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 					newseg->shm_policy.mem_policy = policy;
 					newseg->shm_policy.mem_lgrpid =
 					    LGRP_NONE;
+					newseg->shm_policy.mem_lgrpset =
+					    lgrpset;
 					(void) lgrp_shm_policy_concat(tree,
 					    newseg, AVL_NEXT(tree, newseg));
 					break;
@@ -4348,11 +4414,14 @@ lgrp_shm_policy_set(lgrp_mem_policy_t policy, struct anon_map *amp,
 					newseg->shm_policy.mem_policy = policy;
 					newseg->shm_policy.mem_lgrpid =
 					    LGRP_NONE;
+					newseg->shm_policy.mem_lgrpset =
+					    lgrpset;
 				} else {
 					(void) lgrp_shm_policy_split(tree, seg,
 					    eoff);
 					seg->shm_policy.mem_policy = policy;
 					seg->shm_policy.mem_lgrpid = LGRP_NONE;
+					seg->shm_policy.mem_lgrpset = lgrpset;
 				}
 
 				if (off == seg->shm_off)
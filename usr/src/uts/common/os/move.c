@@ -91,6 +91,17 @@ uiomove(void *p, size_t n, enum uio_rw rw, struct uio *uio)
 			break;
 
 		case UIO_SYSSPACE:
+			/*
+			 * Large copies for callers that asked for it may go to
+			 * a DMA engine, if this CPU has other work to do.
+			 */
+			if ((uio->uio_extflg & UIO_COPY_OFFLOAD) &&
+			    uioasync.enabled &&
+			    dcopy_copy(rw == UIO_READ ? p : iov->iov_base,
+			    rw == UIO_READ ? iov->iov_base : p, cnt,
+			    DCOPY_COPY_IFBUSY, NULL, NULL) == DCOPY_SUCCESS)
+				break;
+
 			if (rw == UIO_READ)
 				error = kcopy_nta(p, iov->iov_base, cnt,
 				    (uio->uio_extflg & UIO_COPY_CACHED));
@@ -149,6 +149,23 @@ term_cpu_mstate(struct cpu *cpu)
 	cpu->cpu_mstate_start = 0;
 }
 
+/*
+ * Steal time is the time a virtual cpu was ready to run but the hypervisor
+ * ran something else.  It is included in the microstate times of the cpu
+ * and of the threads that were on it, since we can't tell it from the
+ * inside.  Platforms that can get it from their hypervisor set
+ * cpu_steal_timef to a routine returning the total for a cpu.
+ */
+hrtime_t (*cpu_steal_timef)(struct cpu *) = NULL;
+
+hrtime_t
+cpu_steal_time(struct cpu *cpu)
+{
+	hrtime_t (*func)(struct cpu *) = cpu_steal_timef;
+
+	return (func == NULL ? 0 : func(cpu));
+}
+
 /* NEW_CPU_MSTATE comments inline in new_cpu_mstate below. */
 
 #define	NEW_CPU_MSTATE(state)						\
@@ -784,6 +801,7 @@ restore_mstate(kthread_t *t)
 	waittime = curtime - waitrq;
 	ms->ms_acct[LMS_WAIT_CPU] += waittime;
 	atomic_add_64(&z->zone_wtime, waittime);
+	zone_lat_record(&z->zone_runq_lat, waittime);
 	CPU->cpu_waitrq += waittime;
 	ms->ms_state_start = curtime;
 }
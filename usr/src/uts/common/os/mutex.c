@@ -176,6 +176,29 @@
  * Only direct handoff can prevent the thundering herd problem, but as
  * mentioned earlier, that would tend to defeat the adaptive spin logic.
  * In practice, option (3) works well because the blocking case is rare.
+ *
+ * Queued spinning for adaptive mutexes:
+ *
+ * Backoff keeps a handful of spinners from saturating the lock's cache
+ * line, but with dozens of CPUs spinning on one lock every release still
+ * sets off a storm of coherence traffic, and the longer backoffs leave the
+ * lock idle.  So before falling into the backoff loop, a contending thread
+ * joins an MCS-style queue: it appends a node on its own stack to the tail
+ * of one of the mutex_spinq hash chains and spins on a flag in that node
+ * until its predecessor hands over.  Only the thread at the head of the
+ * queue spins on the lock itself.  It does so for as long as the owner is
+ * running, up to mutex_spinq_max attempts, and then passes the head of the
+ * queue to its successor, either because it got the lock or because it is
+ * going to take the regular path (and, most likely, block).
+ *
+ * Queued threads run with preemption disabled, so that a waiter can't be
+ * descheduled while its successors depend on it, and they never block
+ * while queued.  Interrupt threads skip the queue: one may have pinned a
+ * queued thread on its own CPU, and would then wait forever behind it.
+ * The queues are hashed by lock address, so two locks can share a queue;
+ * that only delays a waiter until the waiters ahead of it have finished
+ * spinning, which is bounded as described.  Setting mutex_spinq_enable to
+ * zero restores the plain backoff loop.
  */
 
 /*
@@ -334,6 +357,99 @@ uint_t (*mutex_lock_backoff)(uint_t) = default_lock_backoff;
 void (*mutex_lock_delay)(uint_t) = default_lock_delay;
 void (*mutex_delay)(void) = mutex_delay_default;
 
+/*
+ * Queued spinning (see the Big Theory Statement).  Both queue heads and
+ * nodes take a cache line each, so that every waiter spins on its own.
+ */
+#define	MUTEX_SPINQ_SIZE	256
+#define	MUTEX_SPINQ_HASH(lp)	\
+	((((uintptr_t)(lp) >> 6) ^ ((uintptr_t)(lp) >> 14)) & \
+	(MUTEX_SPINQ_SIZE - 1))
+#define	MUTEX_SPINQ_LINE	64
+
+typedef struct mutex_spinq_node {
+	struct mutex_spinq_node	*msn_next;
+	volatile uint_t		msn_wait;
+	char			msn_pad[MUTEX_SPINQ_LINE - sizeof (void *) -
+	    sizeof (uint_t)];
+} mutex_spinq_node_t;
+
+typedef struct mutex_spinq {
+	mutex_spinq_node_t	*msq_tail;
+	char			msq_pad[MUTEX_SPINQ_LINE - sizeof (void *)];
+} mutex_spinq_t;
+
+#pragma align 64(mutex_spinq)
+static mutex_spinq_t mutex_spinq[MUTEX_SPINQ_SIZE];
+
+int mutex_spinq_enable = 1;
+uint_t mutex_spinq_max = 100000;	/* lock attempts by the queue head */
+
+/*
+ * Spin for an adaptive mutex in the queue for its hash chain.  Returns 1 if
+ * we got the lock, or 0 if the caller should carry on with the regular
+ * backoff loop.
+ */
+static int
+mutex_spinq_enter(mutex_impl_t *lp)
+{
+	volatile mutex_impl_t *vlp = (volatile mutex_impl_t *)lp;
+	mutex_spinq_t *msq = &mutex_spinq[MUTEX_SPINQ_HASH(lp)];
+	mutex_spinq_node_t node, *pred, *next;
+	kthread_id_t owner;
+	uint_t tries;
+	int acquired = 0;
+
+	node.msn_next = NULL;
+	node.msn_wait = 1;
+
+	kpreempt_disable();
+	membar_producer();
+	pred = atomic_swap_ptr(&msq->msq_tail, &node);
+	if (pred != NULL) {
+		pred->msn_next = &node;
+		while (node.msn_wait) {
+			if (panicstr)
+				break;
+			mutex_delay();
+		}
+		membar_consumer();
+	}
+
+	for (tries = 0; tries < mutex_spinq_max && !panicstr; tries++) {
+		if ((owner = MUTEX_OWNER(vlp)) == NULL) {
+			if (mutex_adaptive_tryenter(lp)) {
+				acquired = 1;
+				break;
+			}
+			continue;
+		}
+		if (owner == curthread)
+			mutex_panic("recursive mutex_enter", lp);
+		if (owner != MUTEX_NO_OWNER && mutex_owner_running(lp) == NULL)
+			break;
+		mutex_delay();
+	}
+
+	/*
+	 * Pass the head of the queue on, waiting for a successor that has
+	 * swapped itself into the tail to link itself to us.
+	 */
+	if ((next = node.msn_next) == NULL) {
+		if (atomic_cas_ptr(&msq->msq_tail, &node, NULL) != &node) {
+			while ((next = node.msn_next) == NULL)
+				mutex_delay();
+		}
+	}
+	if (next != NULL) {
+		membar_exit();
+		next->msn_wait = 0;
+	}
+	kpreempt_enable();
+
+	return (acquired);
+}
+
 /*
  * mutex_vector_enter() is called from the assembly mutex_enter() routine
  * if the lock is held or is not of type MUTEX_ADAPTIVE.
@@ -381,6 +497,10 @@ mutex_vector_enter(mutex_impl_t *lp)
 
 	spin_time = LOCKSTAT_START_TIME(LS_MUTEX_ENTER_SPIN);
 
+	if (mutex_spinq_enable && !(curthread->t_flag & T_INTR_THREAD) &&
+	    mutex_spinq_enter(lp))
+		goto acquired;
+
 	backoff = mutex_lock_backoff(0);	/* set base backoff */
 	for (;;) {
 		mutex_lock_delay(backoff); /* backoff delay */
@@ -454,6 +574,7 @@ mutex_vector_enter(mutex_impl_t *lp)
 		}
 	}
 
+acquired:
 	ASSERT(MUTEX_OWNER(lp) == curthread);
 
 	if (sleep_time != 0) {
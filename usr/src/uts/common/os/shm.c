@@ -107,6 +107,7 @@
 #include <sys/policy.h>
 #include <sys/zone.h>
 #include <sys/rctl.h>
+#include <sys/lgrp.h>
 
 #include <sys/ipc.h>
 #include <sys/ipc_impl.h>
@@ -630,6 +631,9 @@ shmctl(int shmid, int cmd, void *arg)
 	kmutex_t		*lock;
 	model_t			mdl = get_udatamodel();
 	struct shmid_ds64	ds64;
+	struct shm_advice	adv;
+	lgrp_mem_policy_info_t	*policy_info;
+	lgrp_mem_policy_t	policy;
 	shmatt_t		nattch;
 
 	STRUCT_INIT(ds, mdl);
@@ -648,6 +652,23 @@ shmctl(int shmid, int cmd, void *arg)
 			return (EFAULT);
 		break;
 
+	case SHM_ADVISE:
+		if (copyin(arg, &adv, sizeof (adv)))
+			return (EFAULT);
+		switch (adv.shma_advice) {
+		case MADV_ACCESS_INTERLEAVE:
+			break;
+		case MADV_ACCESS_DEFAULT:
+		case MADV_ACCESS_LWP:
+		case MADV_ACCESS_MANY:
+			if (adv.shma_lgrps == 0)
+				break;
+			/* FALLTHROUGH */
+		default:
+			return (EINVAL);
+		}
+		break;
+
 	case IPC_RMID:
 		return (ipc_rmid(shm_svc, shmid, cr));
 	}
@@ -748,6 +769,56 @@ shmctl(int shmid, int cmd, void *arg)
 		}
 		break;
 
+	/*
+	 * Set placement of the segment's pages.  Only pages allocated
+	 * afterwards are affected, so for ISM and DISM this is meant to
+	 * be used before the first attach creates them.
+	 */
+	case SHM_ADVISE:
+		if (secpolicy_ipc_owner(cr, &sp->shm_perm) != 0) {
+			error = EPERM;
+			break;
+		}
+		if (!lgrp_optimizations())
+			break;
+		policy = lgrp_madv_to_policy(adv.shma_advice,
+		    sp->shm_amp->size, MAP_SHARED);
+		(void) lgrp_shm_policy_set_lgrps(policy, adv.shma_lgrps,
+		    sp->shm_amp, 0, NULL, 0, sp->shm_amp->size);
+		sp->shm_ctime = gethrestime_sec();
+		break;
+
+	case SHM_ADVICE:
+		if (error = ipcperm_access(&sp->shm_perm, SHM_R, cr))
+			break;
+
+		bzero(&adv, sizeof (adv));
+		policy_info = lgrp_shm_policy_get(sp->shm_amp, 0, NULL, 0);
+		switch (policy_info == NULL ? LGRP_MEM_POLICY_DEFAULT :
+		    policy_info->mem_policy) {
+		case LGRP_MEM_POLICY_NEXT:
+			adv.shma_advice = MADV_ACCESS_LWP;
+			break;
+		case LGRP_MEM_POLICY_RANDOM:
+		case LGRP_MEM_POLICY_RANDOM_PSET:
+		case LGRP_MEM_POLICY_RANDOM_PROC:
+			adv.shma_advice = MADV_ACCESS_MANY;
+			break;
+		case LGRP_MEM_POLICY_ROUNDROBIN:
+			adv.shma_advice = MADV_ACCESS_INTERLEAVE;
+			adv.shma_lgrps = policy_info->mem_lgrpset;
+			break;
+		default:
+			adv.shma_advice = MADV_ACCESS_DEFAULT;
+			break;
+		}
+
+		mutex_exit(lock);
+		if (copyout(&adv, arg, sizeof (adv)))
+			return (EFAULT);
+
+		return (0);
+
 	default:
 		error = EINVAL;
 		break;
@@ -235,6 +235,7 @@ int	lwp_mutex_unlock(lwp_mutex_t *);
 int	lwp_mutex_trylock(lwp_mutex_t *, uintptr_t);
 int	lwp_mutex_register(lwp_mutex_t *, caddr_t);
 int	lwp_rwlock_sys(int, lwp_rwlock_t *, timespec_t *);
+int	lwp_addr_sys(int, uint32_t *, uint32_t, timespec_t *, int);
 int	lwp_sema_post(lwp_sema_t *);
 int	lwp_sema_timedwait(lwp_sema_t *, timespec_t *, int);
 int	lwp_sema_trywait(lwp_sema_t *);
@@ -321,6 +322,8 @@ ssize_t	recvfrom(int, void *, size_t, int, struct sockaddr *, socklen_t *);
 ssize_t	recvmsg(int, struct nmsghdr *, int);
 ssize_t	send(int, void *, size_t, int);
 ssize_t	sendmsg(int, struct nmsghdr *, int);
+int	sendmmsg(int, struct mmsghdr *, uint_t, int);
+int	recvmmsg(int, struct mmsghdr *, uint_t, int, timespec_t *);
 ssize_t	sendto(int, void *, size_t, int, struct sockaddr *, socklen_t);
 int	getpeername(int, struct sockaddr *, socklen_t *, int);
 int	getsockname(int, struct sockaddr *, socklen_t *, int);
@@ -329,6 +332,7 @@ int	setsockopt(int, int, int, void *, socklen_t *, int);
 int	sockconfig(int, void *, void *, void *, void *);
 ssize_t	sendfilev(int, int, const struct sendfilevec *, int, size_t *);
 int	getrandom(void *, size_t, int);
+int	getdentsattr(int, void *, size_t);
 
 typedef int64_t	(*llfcn_t)();	/* for casting one-word returns */
 
@@ -582,7 +586,7 @@ struct sysent sysent[NSYSCALL] =
 	/* 122 */ SYSENT_CL("writev",		writev,		3),
 	/* 123 */ SYSENT_CL("preadv",		preadv,		5),
 	/* 124 */ SYSENT_CL("pwritev",		pwritev,	5),
-	/* 125 */ SYSENT_LOADABLE(),			/* (was fxstat) */
+	/* 125 */ SYSENT_CI("getdentsattr",	getdentsattr,	3),
 	/* 126 */ SYSENT_CI("getrandom",	getrandom,	3),
 	/* 127 */ SYSENT_CI("mmapobj",		mmapobjsys,	5),
 	/* 128 */ IF_LP64(
@@ -608,14 +612,14 @@ struct sysent sysent[NSYSCALL] =
 	/* 144 */ SYSENT_CI("sigtimedwait",	sigtimedwait,	3),
 	/* 145 */ SYSENT_CI("lwp_info",		lwp_info,	1),
 	/* 146 */ SYSENT_CI("yield",		yield,		0),
-	/* 147 */ SYSENT_LOADABLE(),		    /* (was lwp_sema_wait) */
+	/* 147 */ SYSENT_CI("lwp_addr_sys",	lwp_addr_sys,	5),
 	/* 148 */ SYSENT_CI("lwp_sema_post",	lwp_sema_post,	1),
 	/* 149 */ SYSENT_CI("lwp_sema_trywait",	lwp_sema_trywait, 1),
 	/* 150 */ SYSENT_CI("lwp_detach",	lwp_detach,	1),
 	/* 151 */ SYSENT_CI("corectl",		corectl,	4),
 	/* 152 */ SYSENT_CI("modctl",		modctl,		6),
 	/* 153 */ SYSENT_CI("fchroot",		fchroot,	1),
-	/* 154 */ SYSENT_LOADABLE(),			/* (was utimes) */
+	/* 154 */ SYSENT_CI("sendmmsg",		sendmmsg,	4),
 	/* 155 */ SYSENT_CI("vhangup",		vhangup,	0),
 	/* 156 */ SYSENT_CI("gettimeofday",	gettimeofday,	1),
 	/* 157 */ SYSENT_CI("getitimer",	getitimer,	2),
@@ -632,7 +636,7 @@ struct sysent sysent[NSYSCALL] =
 			SYSENT_NOSYS()),
 	/* 167 */ SYSENT_CI("lwp_wait",		lwp_wait,	2),
 	/* 168 */ SYSENT_CI("lwp_mutex_wakeup",	lwp_mutex_wakeup,	2),
-	/* 169 */ SYSENT_LOADABLE(),		    /* (was lwp_mutex_lock) */
+	/* 169 */ SYSENT_CI("recvmmsg",		recvmmsg,	5),
 	/* 170 */ SYSENT_CI("lwp_cond_wait",	lwp_cond_wait,		4),
 	/* 171 */ SYSENT_CI("lwp_cond_signal",	lwp_cond_signal,	1),
 	/* 172 */ SYSENT_CI("lwp_cond_broadcast", lwp_cond_broadcast,	1),
@@ -947,7 +951,7 @@ struct sysent sysent32[NSYSCALL] =
 	/* 122 */ SYSENT_CI("writev",		writev32,	3),
 	/* 123 */ SYSENT_CI("preadv",		preadv,		5),
 	/* 124 */ SYSENT_CI("pwritev",		pwritev,	5),
-	/* 125 */ SYSENT_LOADABLE32(),		/*	was fxstat32	*/
+	/* 125 */ SYSENT_CI("getdentsattr",	getdentsattr,	3),
 	/* 126 */ SYSENT_CI("getrandom",	getrandom,	3),
 	/* 127 */ SYSENT_CI("mmapobj",		mmapobjsys,	5),
 	/* 128 */ SYSENT_CI("setrlimit",	setrlimit32,	2),
@@ -969,14 +973,14 @@ struct sysent sysent32[NSYSCALL] =
 	/* 144 */ SYSENT_CI("sigtimedwait",	sigtimedwait,	3),
 	/* 145 */ SYSENT_CI("lwp_info",		lwp_info,	1),
 	/* 146 */ SYSENT_CI("yield",		yield,		0),
-	/* 147 */ SYSENT_LOADABLE32(),		    /* (was lwp_sema_wait) */
+	/* 147 */ SYSENT_CI("lwp_addr_sys",	lwp_addr_sys,	5),
 	/* 148 */ SYSENT_CI("lwp_sema_post",	lwp_sema_post,	1),
 	/* 149 */ SYSENT_CI("lwp_sema_trywait",	lwp_sema_trywait, 1),
 	/* 150 */ SYSENT_CI("lwp_detach",	lwp_detach,	1),
 	/* 151 */ SYSENT_CI("corectl",		corectl,	4),
 	/* 152 */ SYSENT_CI("modctl",		modctl,		6),
 	/* 153 */ SYSENT_CI("fchroot",		fchroot,	1),
-	/* 154 */ SYSENT_LOADABLE32(),			/* (was utimes) */
+	/* 154 */ SYSENT_CI("sendmmsg",		sendmmsg,	4),
 	/* 155 */ SYSENT_CI("vhangup",		vhangup,	0),
 	/* 156 */ SYSENT_CI("gettimeofday",	gettimeofday,	1),
 	/* 157 */ SYSENT_CI("getitimer",	getitimer,	2),
@@ -993,7 +997,7 @@ struct sysent sysent32[NSYSCALL] =
 			SYSENT_NOSYS()),
 	/* 167 */ SYSENT_CI("lwp_wait",		lwp_wait,	2),
 	/* 168 */ SYSENT_CI("lwp_mutex_wakeup",	lwp_mutex_wakeup,	2),
-	/* 169 */ SYSENT_LOADABLE32(),		    /* (was lwp_mutex_lock) */
+	/* 169 */ SYSENT_CI("recvmmsg",		recvmmsg,	5),
 	/* 170 */ SYSENT_CI("lwp_cond_wait",	lwp_cond_wait,		4),
 	/* 171 */ SYSENT_CI("lwp_cond_signal",	lwp_cond_signal,	1),
 	/* 172 */ SYSENT_CI("lwp_cond_broadcast", lwp_cond_broadcast,	1),
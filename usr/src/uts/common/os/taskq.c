@@ -124,6 +124,14 @@
  *		supported for DYNAMIC task queues.  This flag is not compatible
  *		with TASKQ_THREADS_CPU_PCT.
  *
+ *	  TASKQ_PERCPU: Queue tasks on per-CPU run queues rather than on the
+ *		single tq_task list, so that a taskq dispatched to at a high
+ *		rate from many CPUs doesn't serialize on tq_lock. Tasks are
+ *		still executed in no particular order if nthreads > 1, but even
+ *		with a single thread tasks dispatched from different CPUs may
+ *		run out of order. This flag is not supported for DYNAMIC task
+ *		queues.
+ *
  *	The 'pri' field specifies the default priority for the threads that
  *	service all scheduled tasks.
  *
@@ -399,6 +407,40 @@
  *	 memory. One solution may be allocation of buckets when they are first
  *	 touched, but it is not clear how useful it is.
  *
+ * Per-CPU Task Queues Implementation ------------------------------------------
+ *
+ * A TASKQ_PERCPU taskq has an array of 2^n run queues ("lanes"), where n is
+ * chosen as for the dynamic taskq buckets but is further limited so that
+ * there are no more lanes than tq_nthreads_max.  Each lane has its own lock,
+ * task list, condition variable and counters.  A thread's home lane is
+ * determined by its thread_id, and dispatch puts the task on the lane of the
+ * current CPU, so tq_lock is only taken by taskq_dispatch() to allocate an
+ * entry; taskq_dispatch_ent() doesn't take it at all.
+ *
+ * Threads take work from their home lane.  When it is empty (and every
+ * taskq_lane_steal_interval tasks anyway, so that a busy home lane can't
+ * starve the others) they look through the other lanes and steal the oldest
+ * task they find.  A thread which found nothing sleeps on its home lane's
+ * tql_cv.
+ *
+ * Wakeups are batched: a dispatch only signals a lane if it has idle
+ * threads (tql_nidle) and no wakeup is already outstanding (tql_nwake).  A
+ * woken thread that finds more queued work than it can take passes the
+ * wakeup along.  If the dispatching lane has no idle threads, up to
+ * taskq_search_depth neighbouring lanes are checked for one (all of them if
+ * the lane has no threads at all, which can happen when a
+ * TASKQ_THREADS_CPU_PCT taskq shrinks).  An idle thread counts itself in
+ * tql_nidle *before* its final look at the other lanes, and dispatch looks
+ * at tql_nidle *after* queueing; with a memory barrier on each side, either
+ * the dispatcher sees the idle thread or the idle thread sees the task.
+ *
+ * Lane threads don't hold tq_threadlock while running tasks.  Instead,
+ * taskq_suspend() marks every lane TQLANE_SUSPEND, which stops threads from
+ * taking tasks off it, and waits for the tasks already taken (tql_nrunning)
+ * to finish.  While a thread is in the lane loop it isn't counted in
+ * tq_active; it leaves the loop and returns to the tq_lock-protected
+ * management code whenever TASKQ_CHANGING needs its attention.
+ *
  * SUSPEND/RESUME implementation -----------------------------------------------
  *
  *	Before executing a task taskq_thread() (executing non-dynamic task
@@ -431,9 +473,14 @@
  *   3) The global taskq_cpupct_lock, which protects the list of
  *      TASKQ_THREADS_CPU_PCT taskqs.
  *
+ *   4) Each lane of a TASKQ_PERCPU taskq has a lock for its run queue.
+ *
  *   If both (1) and (2) are needed, tq_lock should be taken *after* the bucket
  *   lock.
  *
+ *   If both (1) and (4) are needed, tq_lock should be taken *before* the lane
+ *   lock.  No two lane locks are ever held at once.
+ *
  *   If both (1) and (3) are needed, tq_lock should be taken *after*
  *   taskq_cpupct_lock.
  *
@@ -465,8 +512,14 @@
  *				  Default value: 128
  *
  *	taskq_search_depth	- Maximum # of buckets searched for a free entry
+ *				  or lanes searched for an idle thread
  *				  Default value: 4
  *
+ *	taskq_lane_steal_interval
+ *				- # of tasks a TASKQ_PERCPU thread takes from
+ *				  its home lane before looking at the others
+ *				  Default value: 16
+ *
  *	taskq_dmtbf		- Mean time between induced dispatch failures
  *				  for dynamic task queues.
  *				  Default value: UINT_MAX (no induced failures)
@@ -499,7 +552,7 @@
 #include <sys/sysdc.h>
 #include <sys/note.h>
 
-static kmem_cache_t *taskq_ent_cache, *taskq_cache;
+static kmem_cache_t *taskq_ent_cache, *taskq_cache, *taskq_lane_cache;
 
 /*
  * Pseudo instance numbers for taskqs without explicitly provided instance.
@@ -553,6 +606,13 @@ int taskq_maxbuckets = TASKQ_MAXBUCKETS;
 #define	TASKQ_SEARCH_DEPTH 4
 int taskq_search_depth = TASKQ_SEARCH_DEPTH;
 
+/*
+ * A TASKQ_PERCPU thread looks for work on other lanes after running this many
+ * tasks from its home lane in a row, even if there is more work at home.
+ */
+#define	TASKQ_LANE_STEAL_INTERVAL 16
+int taskq_lane_steal_interval = TASKQ_LANE_STEAL_INTERVAL;
+
 /*
  * Hashing function: mix various bits of x. May be pretty much anything.
  */
@@ -582,6 +642,9 @@ static void taskq_ent_free(taskq_t *, taskq_ent_t *);
 static int taskq_ent_exists(taskq_t *, task_func_t, void *);
 static taskq_ent_t *taskq_bucket_dispatch(taskq_bucket_t *, task_func_t,
     void *);
+static void taskq_lane_enqueue(taskq_t *, taskq_ent_t *, task_func_t, void *,
+    uint_t);
+static void taskq_lane_wakeall(taskq_t *);
 
 /*
  * Task queues kstats.
@@ -596,6 +659,8 @@ struct taskq_kstat {
 	kstat_named_t	tq_nactive;
 	kstat_named_t	tq_pri;
 	kstat_named_t	tq_nthreads;
+	kstat_named_t	tq_steals;
+	kstat_named_t	tq_wakeups;
 } taskq_kstat = {
 	{ "pid",		KSTAT_DATA_UINT64 },
 	{ "tasks",		KSTAT_DATA_UINT64 },
@@ -606,6 +671,8 @@ struct taskq_kstat {
 	{ "nactive",		KSTAT_DATA_UINT64 },
 	{ "priority",		KSTAT_DATA_UINT64 },
 	{ "threads",		KSTAT_DATA_UINT64 },
+	{ "steals",		KSTAT_DATA_UINT64 },
+	{ "wakeups",		KSTAT_DATA_UINT64 },
 };
 
 struct taskq_d_kstat {
@@ -806,6 +873,38 @@ taskq_destructor(void *buf, void *cdrarg)
 	cv_destroy(&tq->tq_maxalloc_cv);
 }
 
+/*ARGSUSED*/
+static int
+taskq_lane_constructor(void *buf, void *cdrarg, int kmflags)
+{
+	taskq_lane_t *l = buf;
+
+	bzero(l, sizeof (taskq_lane_t));
+
+	mutex_init(&l->tql_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&l->tql_cv, NULL, CV_DEFAULT, NULL);
+	cv_init(&l->tql_wait_cv, NULL, CV_DEFAULT, NULL);
+
+	l->tql_task.tqent_next = &l->tql_task;
+	l->tql_task.tqent_prev = &l->tql_task;
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static void
+taskq_lane_destructor(void *buf, void *cdrarg)
+{
+	taskq_lane_t *l = buf;
+
+	ASSERT(l->tql_task.tqent_next == &l->tql_task);
+	ASSERT(l->tql_nthreads == 0);
+
+	mutex_destroy(&l->tql_lock);
+	cv_destroy(&l->tql_cv);
+	cv_destroy(&l->tql_wait_cv);
+}
+
 /*ARGSUSED*/
 static int
 taskq_ent_constructor(void *buf, void *cdrarg, int kmflags)
@@ -836,6 +935,9 @@ taskq_init(void)
 	    taskq_ent_destructor, NULL, NULL, NULL, 0);
 	taskq_cache = kmem_cache_create("taskq_cache", sizeof (taskq_t),
 	    0, taskq_constructor, taskq_destructor, NULL, NULL, NULL, 0);
+	taskq_lane_cache = kmem_cache_create("taskq_lane_cache",
+	    sizeof (taskq_lane_t), 64, taskq_lane_constructor,
+	    taskq_lane_destructor, NULL, NULL, NULL, 0);
 	taskq_id_arena = vmem_create("taskq_id_arena",
 	    (void *)1, INT32_MAX, 1, NULL, NULL, NULL, 0,
 	    VM_SLEEP | VMC_IDENTIFIER);
@@ -862,6 +964,7 @@ taskq_update_nthreads(taskq_t *tq, uint_t ncpus)
 		tq->tq_nthreads_target = newtarget;
 		cv_broadcast(&tq->tq_dispatch_cv);
 		cv_broadcast(&tq->tq_exit_cv);
+		taskq_lane_wakeall(tq);
 	}
 }
 
@@ -1123,6 +1226,171 @@ taskq_bucket_dispatch(taskq_bucket_t *b, task_func_t func, void *arg)
 	return (tqe);
 }
 
+/*
+ * Post a wakeup to an idle thread of lane l.  Only one wakeup is outstanding
+ * at a time; the woken thread passes it on if there is more work.
+ */
+static void
+taskq_lane_wakeup(taskq_lane_t *l)
+{
+	ASSERT(MUTEX_HELD(&l->tql_lock));
+	ASSERT(l->tql_nidle != 0 && l->tql_nwake == 0);
+
+	l->tql_nwake++;
+	l->tql_wakeups++;
+	cv_signal(&l->tql_cv);
+}
+
+/*
+ * Wake up every thread of a TASKQ_PERCPU taskq so that it notices a change
+ * in tq_flags or tq_nthreads_target.
+ */
+static void
+taskq_lane_wakeall(taskq_t *tq)
+{
+	uint_t i;
+
+	ASSERT(MUTEX_HELD(&tq->tq_lock));
+
+	for (i = 0; i < tq->tq_nlanes; i++) {
+		taskq_lane_t *l = tq->tq_lanes[i];
+
+		mutex_enter(&l->tql_lock);
+		cv_broadcast(&l->tql_cv);
+		mutex_exit(&l->tql_lock);
+	}
+}
+
+/*
+ * Called after queueing work on lane 'from', which has no idle threads: find
+ * a nearby lane with an idle thread and wake it, so that it steals the work.
+ */
+static void
+taskq_lane_kick(taskq_t *tq, taskq_lane_t *from)
+{
+	uint_t nlanes = tq->tq_nlanes;
+	uint_t depth, i;
+
+	/* Pairs with the membar_enter() in taskq_lane_thread() */
+	membar_enter();
+
+	if (from->tql_nthreads == 0)
+		depth = nlanes;
+	else
+		depth = MIN(taskq_search_depth + 1, nlanes);
+
+	for (i = 1; i < depth; i++) {
+		taskq_lane_t *l = tq->tq_lanes[(from->tql_id + i) &
+		    (nlanes - 1)];
+
+		/*
+		 * A lane with a wakeup outstanding already has a thread on its
+		 * way, which will find our task once its own lane is empty.
+		 */
+		if (l->tql_nidle == 0 || l->tql_nwake != 0)
+			continue;
+
+		mutex_enter(&l->tql_lock);
+		if (l->tql_nidle != 0 && l->tql_nwake == 0) {
+			taskq_lane_wakeup(l);
+			mutex_exit(&l->tql_lock);
+			return;
+		}
+		mutex_exit(&l->tql_lock);
+	}
+}
+
+/*
+ * Queue a task on the current CPU's lane of a TASKQ_PERCPU taskq.
+ */
+static void
+taskq_lane_enqueue(taskq_t *tq, taskq_ent_t *tqe, task_func_t func,
+    void *arg, uint_t flags)
+{
+	taskq_lane_t *l = tq->tq_lanes[CPU->cpu_seqid & (tq->tq_nlanes - 1)];
+	boolean_t kick = B_FALSE;
+
+	mutex_enter(&l->tql_lock);
+	if (flags & TQ_FRONT) {
+		TQ_PREPEND(l->tql_task, tqe);
+	} else {
+		TQ_APPEND(l->tql_task, tqe);
+	}
+	tqe->tqent_func = func;
+	tqe->tqent_arg = arg;
+	l->tql_tasks++;
+	if (++l->tql_ntasks > l->tql_maxtasks)
+		l->tql_maxtasks = l->tql_ntasks;
+	DTRACE_PROBE2(taskq__enqueue, taskq_t *, tq, taskq_ent_t *, tqe);
+
+	if (l->tql_nidle == 0)
+		kick = B_TRUE;
+	else if (l->tql_nwake == 0)
+		taskq_lane_wakeup(l);
+	mutex_exit(&l->tql_lock);
+
+	if (kick)
+		taskq_lane_kick(tq, l);
+}
+
+/*
+ * Take the oldest task off lane l, unless the lane is suspended.
+ */
+static taskq_ent_t *
+taskq_lane_dequeue(taskq_lane_t *l)
+{
+	taskq_ent_t *tqe;
+
+	ASSERT(MUTEX_HELD(&l->tql_lock));
+
+	if ((l->tql_flags & TQLANE_SUSPEND) ||
+	    (tqe = l->tql_task.tqent_next) == &l->tql_task)
+		return (NULL);
+
+	tqe->tqent_prev->tqent_next = tqe->tqent_next;
+	tqe->tqent_next->tqent_prev = tqe->tqent_prev;
+	l->tql_ntasks--;
+	l->tql_nrunning++;
+
+	/* Pass the wakeup on if there's still work here */
+	if (l->tql_ntasks != 0 && l->tql_nidle != 0 && l->tql_nwake == 0)
+		taskq_lane_wakeup(l);
+
+	return (tqe);
+}
+
+/*
+ * Look for a task on lanes other than 'home'.  Returns the lane the task in
+ * *tqep was taken from, or NULL if there was nothing to steal.
+ */
+static taskq_lane_t *
+taskq_lane_steal(taskq_t *tq, taskq_lane_t *home, taskq_ent_t **tqep)
+{
+	uint_t nlanes = tq->tq_nlanes;
+	uint_t i;
+
+	for (i = 1; i < nlanes; i++) {
+		taskq_lane_t *l = tq->tq_lanes[(home->tql_id + i) &
+		    (nlanes - 1)];
+		taskq_ent_t *tqe;
+
+		if (l->tql_ntasks == 0)
+			continue;
+
+		mutex_enter(&l->tql_lock);
+		tqe = taskq_lane_dequeue(l);
+		mutex_exit(&l->tql_lock);
+
+		if (tqe != NULL) {
+			*tqep = tqe;
+			return (l);
+		}
+	}
+
+	*tqep = NULL;
+	return (NULL);
+}
+
 /*
  * Dispatch a task.
  *
@@ -1163,6 +1431,12 @@ taskq_dispatch(taskq_t *tq, task_func_t func, void *arg, uint_t flags)
 		/* Make sure we start without any flags */
 		tqe->tqent_un.tqent_flags = 0;
 
+		if (tq->tq_flags & TASKQ_PERCPU) {
+			mutex_exit(&tq->tq_lock);
+			taskq_lane_enqueue(tq, tqe, func, arg, flags);
+			return ((taskqid_t)tqe);
+		}
+
 		if (flags & TQ_FRONT) {
 			TQ_ENQUEUE_FRONT(tq, tqe, func, arg);
 		} else {
@@ -1302,6 +1576,12 @@ taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
 	 * to ensure that we don't free it later.
 	 */
 	tqe->tqent_un.tqent_flags |= TQENT_FLAG_PREALLOC;
+
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		taskq_lane_enqueue(tq, tqe, func, arg, flags);
+		return;
+	}
+
 	/*
 	 * Enqueue the task to the underlying queue.
 	 */
@@ -1324,6 +1604,30 @@ taskq_wait(taskq_t *tq)
 {
 	ASSERT(tq != curthread->t_taskq);
 
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		boolean_t again;
+		uint_t i;
+
+		/*
+		 * A running task may dispatch to a lane we've already looked
+		 * at, so keep going until a pass finds every lane idle.
+		 */
+		do {
+			again = B_FALSE;
+			for (i = 0; i < tq->tq_nlanes; i++) {
+				taskq_lane_t *l = tq->tq_lanes[i];
+
+				mutex_enter(&l->tql_lock);
+				while (l->tql_ntasks != 0 ||
+				    l->tql_nrunning != 0) {
+					again = B_TRUE;
+					cv_wait(&l->tql_wait_cv, &l->tql_lock);
+				}
+				mutex_exit(&l->tql_lock);
+			}
+		} while (again);
+	}
+
 	mutex_enter(&tq->tq_lock);
 	while (tq->tq_task.tqent_next != &tq->tq_task || tq->tq_active != 0)
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
@@ -1353,6 +1657,24 @@ taskq_suspend(taskq_t *tq)
 {
 	rw_enter(&tq->tq_threadlock, RW_WRITER);
 
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		uint_t i;
+
+		/*
+		 * Lane threads don't take tq_threadlock; stop them taking more
+		 * tasks and wait for the ones they have to finish.
+		 */
+		for (i = 0; i < tq->tq_nlanes; i++) {
+			taskq_lane_t *l = tq->tq_lanes[i];
+
+			mutex_enter(&l->tql_lock);
+			l->tql_flags |= TQLANE_SUSPEND;
+			while (l->tql_nrunning != 0)
+				cv_wait(&l->tql_wait_cv, &l->tql_lock);
+			mutex_exit(&l->tql_lock);
+		}
+	}
+
 	if (tq->tq_flags & TASKQ_DYNAMIC) {
 		taskq_bucket_t *b = tq->tq_buckets;
 		int bid = 0;
@@ -1388,6 +1710,19 @@ taskq_resume(taskq_t *tq)
 {
 	ASSERT(RW_WRITE_HELD(&tq->tq_threadlock));
 
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		uint_t i;
+
+		for (i = 0; i < tq->tq_nlanes; i++) {
+			taskq_lane_t *l = tq->tq_lanes[i];
+
+			mutex_enter(&l->tql_lock);
+			l->tql_flags &= ~TQLANE_SUSPEND;
+			cv_broadcast(&l->tql_cv);
+			mutex_exit(&l->tql_lock);
+		}
+	}
+
 	if (tq->tq_flags & TASKQ_DYNAMIC) {
 		taskq_bucket_t *b = tq->tq_buckets;
 		int bid = 0;
@@ -1497,6 +1832,120 @@ taskq_thread_wait(taskq_t *tq, kmutex_t *mx, kcondvar_t *cv,
 	return (ret);
 }
 
+/*
+ * A TASKQ_PERCPU thread must go back to taskq_thread() when TASKQ_CHANGING
+ * means it should exit or it may have bookkeeping to do.  Threads that are
+ * staying while higher thread_ids exit keep serving their lanes.
+ */
+#define	TASKQ_LANE_LEAVE(tq, id)					\
+	(((tq)->tq_flags & TASKQ_CHANGING) &&				\
+	((id) > (tq)->tq_nthreads_target ||				\
+	(!((tq)->tq_flags & TASKQ_THREAD_CREATED) &&			\
+	(tq)->tq_nthreads <= (tq)->tq_nthreads_target)))
+
+/*
+ * Run tasks from the lanes of a TASKQ_PERCPU taskq, preferring the thread's
+ * home lane, until TASKQ_LANE_LEAVE() says otherwise.
+ */
+static void
+taskq_lane_thread(taskq_t *tq, taskq_lane_t *home, int thread_id,
+    callb_cpr_t *cprinfo)
+{
+	taskq_lane_t *l;
+	taskq_ent_t *tqe;
+	hrtime_t start, end;
+	boolean_t freeit;
+	int nhome = 0;
+
+	mutex_enter(&home->tql_lock);
+	if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+		CALLB_CPR_SAFE_END(cprinfo, &home->tql_lock);
+	}
+
+	while (!TASKQ_LANE_LEAVE(tq, thread_id)) {
+		l = home;
+		tqe = NULL;
+		if (nhome < taskq_lane_steal_interval)
+			tqe = taskq_lane_dequeue(home);
+
+		if (tqe == NULL) {
+			/*
+			 * Count ourselves idle before looking at the other
+			 * lanes, so that a dispatch to our lane which we'd
+			 * otherwise miss wakes us up.
+			 */
+			nhome = 0;
+			home->tql_nidle++;
+			mutex_exit(&home->tql_lock);
+			membar_enter();
+
+			l = taskq_lane_steal(tq, home, &tqe);
+
+			mutex_enter(&home->tql_lock);
+			if (tqe == NULL) {
+				if ((home->tql_ntasks == 0 ||
+				    (home->tql_flags & TQLANE_SUSPEND)) &&
+				    home->tql_nwake == 0 &&
+				    !TASKQ_LANE_LEAVE(tq, thread_id)) {
+					(void) taskq_thread_wait(tq,
+					    &home->tql_lock, &home->tql_cv,
+					    cprinfo, -1);
+				}
+				if (home->tql_nwake != 0)
+					home->tql_nwake--;
+				home->tql_nidle--;
+				continue;
+			}
+			home->tql_nidle--;
+		}
+		mutex_exit(&home->tql_lock);
+
+		/*
+		 * As in taskq_thread(), a prealloc'd entry belongs to the
+		 * dispatcher again once the function has been called.
+		 */
+		if (tqe->tqent_un.tqent_flags & TQENT_FLAG_PREALLOC) {
+			/* clear pointers to assist assertion checks */
+			tqe->tqent_next = tqe->tqent_prev = NULL;
+			freeit = B_FALSE;
+		} else {
+			freeit = B_TRUE;
+		}
+
+		start = gethrtime();
+		DTRACE_PROBE2(taskq__exec__start, taskq_t *, tq,
+		    taskq_ent_t *, tqe);
+		tqe->tqent_func(tqe->tqent_arg);
+		DTRACE_PROBE2(taskq__exec__end, taskq_t *, tq,
+		    taskq_ent_t *, tqe);
+		end = gethrtime();
+
+		mutex_enter(&l->tql_lock);
+		l->tql_totaltime += end - start;
+		l->tql_executed++;
+		if (l != home)
+			l->tql_steals++;
+		if (--l->tql_nrunning == 0)
+			cv_broadcast(&l->tql_wait_cv);
+		mutex_exit(&l->tql_lock);
+
+		if (freeit) {
+			mutex_enter(&tq->tq_lock);
+			taskq_ent_free(tq, tqe);
+			mutex_exit(&tq->tq_lock);
+		}
+
+		if (l == home)
+			nhome++;
+		mutex_enter(&home->tql_lock);
+	}
+
+	if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+		CALLB_CPR_SAFE_BEGIN(cprinfo);
+	}
+	mutex_exit(&home->tql_lock);
+}
+
 /*
  * Worker thread for processing task queue.
  */
@@ -1507,7 +1956,8 @@ taskq_thread(void *arg)
 
 	taskq_t *tq = arg;
 	taskq_ent_t *tqe;
-	callb_cpr_t cprinfo;
+	taskq_lane_t *home = NULL;
+	callb_cpr_t cprinfo, lcprinfo;
 	hrtime_t start, end;
 	boolean_t freeit;
 
@@ -1541,6 +1991,27 @@ taskq_thread(void *arg)
 	if (tq->tq_nthreads == TASKQ_CREATE_ACTIVE_THREADS)
 		cv_broadcast(&tq->tq_wait_cv);
 
+	/*
+	 * TASKQ_PERCPU threads sleep on their home lane's lock rather than
+	 * tq_lock, so they need a CPR callback for that as well.  It must be
+	 * registered without holding either lock.
+	 */
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		mutex_exit(&tq->tq_lock);
+		home = tq->tq_lanes[(thread_id - 1) & (tq->tq_nlanes - 1)];
+		if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+			CALLB_CPR_INIT(&lcprinfo, &home->tql_lock,
+			    callb_generic_cpr, tq->tq_name);
+		}
+		mutex_enter(&home->tql_lock);
+		home->tql_nthreads++;
+		if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+			CALLB_CPR_SAFE_BEGIN(&lcprinfo);
+		}
+		mutex_exit(&home->tql_lock);
+		mutex_enter(&tq->tq_lock);
+	}
+
 	for (;;) {
 		if (tq->tq_flags & TASKQ_CHANGING) {
 			/* See if we're no longer needed */
@@ -1583,6 +2054,27 @@ taskq_thread(void *arg)
 				}
 			}
 		}
+		if (home != NULL) {
+			/*
+			 * Lane threads are only counted as active while they
+			 * are here, away from the lanes.
+			 */
+			if (--tq->tq_active == 0)
+				cv_broadcast(&tq->tq_wait_cv);
+			if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+				CALLB_CPR_SAFE_BEGIN(&cprinfo);
+			}
+			mutex_exit(&tq->tq_lock);
+
+			taskq_lane_thread(tq, home, thread_id, &lcprinfo);
+
+			mutex_enter(&tq->tq_lock);
+			if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+				CALLB_CPR_SAFE_END(&cprinfo, &tq->tq_lock);
+			}
+			tq->tq_active++;
+			continue;
+		}
 		if ((tqe = tq->tq_task.tqent_next) == &tq->tq_task) {
 			if (--tq->tq_active == 0)
 				cv_broadcast(&tq->tq_wait_cv);
@@ -1653,6 +2145,12 @@ taskq_thread(void *arg)
 	}
 
 	ASSERT(!(tq->tq_flags & TASKQ_CPR_SAFE));
+	if (home != NULL) {
+		mutex_enter(&home->tql_lock);
+		ASSERT(home->tql_nthreads > 0);
+		home->tql_nthreads--;
+		CALLB_CPR_EXIT(&lcprinfo);	/* drops home->tql_lock */
+	}
 	CALLB_CPR_EXIT(&cprinfo);		/* drops tq->tq_lock */
 	if (curthread->t_lwp != NULL) {
 		mutex_enter(&curproc->p_lock);
@@ -1877,6 +2375,9 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 	/* Cannot have DYNAMIC with DUTY_CYCLE */
 	IMPLY((flags & TASKQ_DYNAMIC), !(flags & TASKQ_DUTY_CYCLE));
 
+	/* Cannot have DYNAMIC with PERCPU */
+	IMPLY((flags & TASKQ_DYNAMIC), !(flags & TASKQ_PERCPU));
+
 	/* Cannot have DUTY_CYCLE with a p0 kernel process */
 	IMPLY((flags & TASKQ_DUTY_CYCLE), proc != &p0);
 
@@ -1948,6 +2449,20 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 		tq->tq_threadlist = kmem_alloc(
 		    sizeof (kthread_t *) * max_nthreads, KM_SLEEP);
 
+	if (flags & TASKQ_PERCPU) {
+		uint_t nlanes = MIN(bsize, 1 << (highbit(max_nthreads) - 1));
+		uint_t l_id;
+
+		tq->tq_lanes = kmem_alloc(sizeof (taskq_lane_t *) * nlanes,
+		    KM_SLEEP);
+		tq->tq_nlanes = nlanes;
+		for (l_id = 0; l_id < nlanes; l_id++) {
+			tq->tq_lanes[l_id] = kmem_cache_alloc(taskq_lane_cache,
+			    KM_SLEEP);
+			tq->tq_lanes[l_id]->tql_id = l_id;
+		}
+	}
+
 	mutex_enter(&tq->tq_lock);
 	if (flags & TASKQ_PREPOPULATE) {
 		while (minalloc-- > 0)
@@ -2084,6 +2599,7 @@ taskq_destroy(taskq_t *tq)
 	tq->tq_flags |= TASKQ_CHANGING;
 	cv_broadcast(&tq->tq_dispatch_cv);
 	cv_broadcast(&tq->tq_exit_cv);
+	taskq_lane_wakeall(tq);
 
 	while (tq->tq_nthreads != 0)
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
@@ -2140,6 +2656,34 @@ taskq_destroy(taskq_t *tq)
 		ASSERT(!(tq->tq_flags & TASKQ_DYNAMIC));
 	}
 
+	if (tq->tq_lanes != NULL) {
+		uint_t l_id;
+
+		ASSERT(tq->tq_flags & TASKQ_PERCPU);
+		for (l_id = 0; l_id < tq->tq_nlanes; l_id++) {
+			taskq_lane_t *l = tq->tq_lanes[l_id];
+
+			ASSERT(l->tql_ntasks == 0);
+			ASSERT(l->tql_nrunning == 0);
+			ASSERT(l->tql_nidle == 0);
+
+			/* Cleanup fields before returning l to the cache */
+			l->tql_flags = 0;
+			l->tql_nwake = 0;
+			l->tql_maxtasks = 0;
+			l->tql_tasks = 0;
+			l->tql_executed = 0;
+			l->tql_steals = 0;
+			l->tql_wakeups = 0;
+			l->tql_totaltime = 0;
+			kmem_cache_free(taskq_lane_cache, l);
+		}
+		kmem_free(tq->tq_lanes, sizeof (taskq_lane_t *) *
+		    tq->tq_nlanes);
+		tq->tq_lanes = NULL;
+		tq->tq_nlanes = 0;
+	}
+
 	/*
 	 * Now that all the taskq threads are gone, we can
 	 * drop the zone hold taken in taskq_create_common
@@ -2241,6 +2785,7 @@ taskq_kstat_update(kstat_t *ksp, int rw)
 {
 	struct taskq_kstat *tqsp = &taskq_kstat;
 	taskq_t *tq = ksp->ks_private;
+	uint_t i;
 
 	if (rw == KSTAT_WRITE)
 		return (EACCES);
@@ -2254,6 +2799,24 @@ taskq_kstat_update(kstat_t *ksp, int rw)
 	tqsp->tq_nalloc.value.ui64 = tq->tq_nalloc;
 	tqsp->tq_pri.value.ui64 = tq->tq_pri;
 	tqsp->tq_nthreads.value.ui64 = tq->tq_nthreads;
+	tqsp->tq_steals.value.ui64 = 0;
+	tqsp->tq_wakeups.value.ui64 = 0;
+
+	/*
+	 * For TASKQ_PERCPU taskqs, sum the lane statistics.  nactive counts
+	 * the tasks being run rather than the threads not sleeping.
+	 */
+	for (i = 0; i < tq->tq_nlanes; i++) {
+		taskq_lane_t *l = tq->tq_lanes[i];
+
+		tqsp->tq_tasks.value.ui64 += l->tql_tasks;
+		tqsp->tq_executed.value.ui64 += l->tql_executed;
+		tqsp->tq_maxtasks.value.ui64 += l->tql_maxtasks;
+		tqsp->tq_totaltime.value.ui64 += l->tql_totaltime;
+		tqsp->tq_nactive.value.ui64 += l->tql_nrunning;
+		tqsp->tq_steals.value.ui64 += l->tql_steals;
+		tqsp->tq_wakeups.value.ui64 += l->tql_wakeups;
+	}
 	return (0);
 }
 
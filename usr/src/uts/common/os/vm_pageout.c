@@ -54,9 +54,11 @@
 #include <sys/user.h>
 #include <sys/kmem.h>
 #include <sys/debug.h>
+#include <sys/atomic.h>
 #include <sys/callb.h>
 #include <sys/tnf_probe.h>
 #include <sys/mem_cage.h>
+#include <sys/memnode.h>
 #include <sys/time.h>
 
 #include <vm/hat.h>
@@ -133,6 +135,73 @@ static uint_t	reset_hands;
 
 #define	PAGES_POLL_MASK	1023
 
+/*
+ * Memory is divided into n_page_scanners regions of about the same size,
+ * in page_next() order, each scanned by its own pageout_scanner thread
+ * with its own pair of hands, so that a large system can find pages to
+ * free as fast as it uses them.  By default there is a scanner for each
+ * memory node (which, as the memsegs are in physical order, gives each
+ * one roughly an lgroup's memory), and at least one per
+ * pageout_scanner_pages pages (128G by default), up to MAX_PSCAN_THREADS.
+ * Setting pageout_scanners in /etc/system overrides this.
+ */
+#define	MAX_PSCAN_THREADS	16
+
+uint_t		pageout_scanners = 0;
+pgcnt_t		pageout_scanner_pages = 0;
+static uint_t	n_page_scanners = 1;
+
+/*
+ * pageout_scan_gen:
+ *     Bumped by schedpaging() each time it wants the scanners to run.
+ *
+ * pageout_scanners_busy:
+ *     Number of scanners that haven't yet finished the current cycle;
+ *     schedpaging() leaves the parameters alone until it is zero.
+ *
+ * pageout_cycle_nscan, pageout_cycle_nfreed:
+ *     Pages examined and freed by all scanners in the current cycle.
+ */
+static uint_t	pageout_scan_gen;
+static uint_t	pageout_scanners_busy;
+static pgcnt_t	pageout_cycle_nscan;
+static pgcnt_t	pageout_cycle_nfreed;
+
+/*
+ * The scan rate adapts to the rate at which memory is being used up.
+ * pageout_alloc_rate is a decaying average of the fall in freemem per
+ * schedpaging() interval.  While free memory is short, desscan is raised
+ * (if need be) so that the scanners can free pages as fast as that,
+ * given the number of pages the last cycle examined for each page it
+ * freed, up to a pass over all of memory each second.  Setting
+ * pageout_adaptive to 0 keeps the plain slowscan to fastscan ramp.
+ */
+int		pageout_adaptive = 1;
+static pgcnt_t	pageout_alloc_rate;
+static pgcnt_t	pageout_last_freemem;
+static pgcnt_t	pageout_last_nscan;
+static pgcnt_t	pageout_last_nfreed;
+
+#define	PAGEOUT_RATE_DECAY	4
+
+/*
+ * Caches that can give memory back cheaply, such as the ZFS ARC, register
+ * with pageout_reclaim_register() to be asked for it before the scanners
+ * steal pages from processes.  While free memory is below lotsfree +
+ * needfree, schedpaging() asks each of them to free its share of the
+ * shortfall, in proportion to how much each says it could free.
+ */
+typedef struct pageout_reclaimer {
+	pgcnt_t	(*pr_size)(void *);
+	void	(*pr_reclaim)(void *, pgcnt_t);
+	void	*pr_arg;
+} pageout_reclaimer_t;
+
+#define	PAGEOUT_RECLAIMERS	8
+
+static pageout_reclaimer_t pageout_reclaimers[PAGEOUT_RECLAIMERS];
+static kmutex_t	pageout_reclaim_lock;
+
 /*
  * pageout_sample_lim:
  *     The limit on the number of samples needed to establish a value
@@ -165,7 +234,6 @@ static hrrate_t	pageout_rate = 0;
 static pgcnt_t	pageout_new_spread = 0;
 
 static clock_t	pageout_cycle_ticks;
-static hrtime_t	sample_start, sample_end;
 static hrtime_t	pageout_sample_etime = 0;
 
 /*
@@ -473,10 +541,10 @@ setupclock(int recalc)
 
 	/*
 	 * If we have been called to recalculate the parameters,
-	 * set a flag to re-evaluate the clock hand pointers.
+	 * tell the scanners to re-evaluate their clock hand pointers.
 	 */
 	if (recalc)
-		reset_hands = 1;
+		reset_hands++;
 }
 
 /*
@@ -506,7 +574,7 @@ static kcondvar_t push_cv;
 
 static int async_list_size = 256;	/* number of async request structs */
 
-static void pageout_scanner(void);
+static void pageout_scanner(void *);
 
 /*
  * If a page is being shared more than "po_share" times
@@ -516,31 +584,137 @@ static void pageout_scanner(void);
 #define	MAX_PO_SHARE	((MIN_PO_SHARE) << 24)
 ulong_t	po_share = MIN_PO_SHARE;
 
+/*
+ * Register a cache that can free memory when asked: size() returns the
+ * number of pages it could free, and reclaim() asks it to free that many
+ * pages.  Both are called from schedpaging() and must not block.  Returns
+ * a handle for pageout_reclaim_unregister(), or NULL if there's no room.
+ */
+void *
+pageout_reclaim_register(pgcnt_t (*size)(void *),
+    void (*reclaim)(void *, pgcnt_t), void *arg)
+{
+	pageout_reclaimer_t *pr;
+
+	mutex_enter(&pageout_reclaim_lock);
+	for (pr = pageout_reclaimers;
+	    pr < &pageout_reclaimers[PAGEOUT_RECLAIMERS]; pr++) {
+		if (pr->pr_size == NULL) {
+			pr->pr_reclaim = reclaim;
+			pr->pr_arg = arg;
+			pr->pr_size = size;
+			mutex_exit(&pageout_reclaim_lock);
+			return (pr);
+		}
+	}
+	mutex_exit(&pageout_reclaim_lock);
+	return (NULL);
+}
+
+/*
+ * Once this returns, the reclaimer's callbacks won't be called again.
+ */
+void
+pageout_reclaim_unregister(void *hdl)
+{
+	pageout_reclaimer_t *pr = hdl;
+
+	if (pr == NULL)
+		return;
+
+	mutex_enter(&pageout_reclaim_lock);
+	pr->pr_size = NULL;
+	pr->pr_reclaim = NULL;
+	pr->pr_arg = NULL;
+	mutex_exit(&pageout_reclaim_lock);
+}
+
+/*
+ * Ask the registered reclaimers to free shortfall pages between them, in
+ * proportion to what each could free.  Returns the number asked for.
+ */
+static pgcnt_t
+pageout_reclaim(pgcnt_t shortfall)
+{
+	pageout_reclaimer_t *pr;
+	pgcnt_t size[PAGEOUT_RECLAIMERS];
+	pgcnt_t total = 0, asked = 0, share;
+	int i;
+
+	mutex_enter(&pageout_reclaim_lock);
+	for (i = 0; i < PAGEOUT_RECLAIMERS; i++) {
+		pr = &pageout_reclaimers[i];
+		size[i] = (pr->pr_size != NULL) ? pr->pr_size(pr->pr_arg) : 0;
+		total += size[i];
+	}
+	for (i = 0; i < PAGEOUT_RECLAIMERS && total != 0; i++) {
+		if (size[i] == 0)
+			continue;
+		pr = &pageout_reclaimers[i];
+		if (total <= shortfall)
+			share = size[i];
+		else
+			share = (uint64_t)size[i] * shortfall / total;
+		if (share != 0) {
+			pr->pr_reclaim(pr->pr_arg, share);
+			asked += share;
+		}
+	}
+	mutex_exit(&pageout_reclaim_lock);
+
+	return (asked);
+}
+
 /*
  * Schedule rate for paging.
  * Rate is linear interpolation between
- * slowscan with lotsfree and fastscan when out of memory.
+ * slowscan with lotsfree and fastscan when out of memory,
+ * raised if need be to keep up with the rate memory is being used.
  */
 static void
 schedpaging(void *arg)
 {
 	spgcnt_t vavail;
+	pgcnt_t drop, asked = 0;
 
 	if (freemem < lotsfree + needfree + kmem_reapahead)
 		kmem_reap();
 
-	if (freemem < lotsfree + needfree)
+	if (freemem < lotsfree + needfree) {
 		seg_preap();
+		asked = pageout_reclaim(lotsfree + needfree - freemem);
+	}
 
 	if (kcage_on && (kcage_freemem < kcage_desfree || kcage_needfree))
 		kcage_cageout_wakeup();
 
+	drop = (freemem < pageout_last_freemem) ?
+	    pageout_last_freemem - freemem : 0;
+	pageout_alloc_rate = (pageout_alloc_rate * (PAGEOUT_RATE_DECAY - 1) +
+	    drop) / PAGEOUT_RATE_DECAY;
+	pageout_last_freemem = freemem;
+
 	if (mutex_tryenter(&pageout_mutex)) {
-		/* pageout() not running */
+		if (pageout_scanners_busy != 0) {
+			/* the scanners haven't finished their last cycle */
+			mutex_exit(&pageout_mutex);
+			goto out;
+		}
+
+		/* pageout_scanner() not running */
 		nscan = 0;
 		vavail = freemem - deficit;
 		if (pageout_new_spread != 0)
 			vavail -= needfree;
+
+		/*
+		 * Count what the reclaimers have just been asked for as
+		 * free already, so that the scanners don't steal pages from
+		 * processes while the caches are giving theirs back.  Below
+		 * desfree there's no time to wait and see.
+		 */
+		if (freemem > desfree)
+			vavail += asked;
 		if (vavail < 0)
 			vavail = 0;
 		if (vavail > lotsfree)
@@ -579,11 +753,28 @@ schedpaging(void *arg)
 		pageout_ticks = min_pageout_ticks + (lotsfree - vavail) *
 		    (max_pageout_ticks - min_pageout_ticks) / nz(lotsfree);
 
+		if (pageout_adaptive && pageout_new_spread != 0 &&
+		    freemem < lotsfree + needfree && pageout_alloc_rate != 0) {
+			pgcnt_t want;
+
+			want = pageout_alloc_rate * MAX(1,
+			    pageout_last_nscan / nz(pageout_last_nfreed));
+			want = MIN(want, looppages / RATETOSCHEDPAGING);
+			if (want > desscan) {
+				desscan = want;
+				pageout_ticks = max_pageout_ticks;
+			}
+		}
+
 		if (freemem < lotsfree + needfree ||
 		    pageout_sample_cnt < pageout_sample_lim) {
 			TRACE_1(TR_FAC_VM, TR_PAGEOUT_CV_SIGNAL,
 			    "pageout_cv_signal:freemem %ld", freemem);
-			cv_signal(&proc_pageout->p_cv);
+			pageout_scan_gen++;
+			pageout_scanners_busy = n_page_scanners;
+			pageout_cycle_nscan = 0;
+			pageout_cycle_nfreed = 0;
+			cv_broadcast(&proc_pageout->p_cv);
 		} else {
 			/*
 			 * There are enough free pages, no need to
@@ -599,6 +790,7 @@ schedpaging(void *arg)
 		mutex_exit(&pageout_mutex);
 	}
 
+out:
 	/*
 	 * Signal threads waiting for available memory.
 	 * NOTE: usually we need to grab memavail_lock before cv_broadcast, but
@@ -635,11 +827,11 @@ int dopageout = 1;	/* must be non-zero to turn page stealing on */
  * since the front hand passed.  If modified, they are pushed to
  * swap before being freed.
  *
- * There are 2 threads that act on behalf of the pageout process.
- * One thread scans pages (pageout_scanner) and frees them up if
- * they don't require any VOP_PUTPAGE operation. If a page must be
- * written back to its backing store, the request is put on a list
- * and the other (pageout) thread is signaled. The pageout thread
+ * There are 2 kinds of threads that act on behalf of the pageout process.
+ * The scanner threads (pageout_scanner), one per region of memory, scan
+ * pages and free them up if they don't require any VOP_PUTPAGE operation.
+ * If a page must be written back to its backing store, the request is put
+ * on a list and the pageout thread is signaled. The pageout thread
  * grabs VOP_PUTPAGE requests from the list, and processes them.
  * Some filesystems may require resources for the VOP_PUTPAGE
  * operations (like memory) and hence can block the pageout
@@ -654,6 +846,7 @@ pageout()
 	struct async_reqs *arg;
 	pri_t pageout_pri;
 	int i;
+	uint_t n;
 	pgcnt_t max_pushes;
 	callb_cpr_t cprinfo;
 
@@ -684,9 +877,25 @@ pageout()
 
 	pageout_pri = curthread->t_pri;
 
-	/* Create the pageout scanner thread. */
-	(void) lwp_kernel_create(proc_pageout, pageout_scanner, NULL, TS_RUN,
-	    pageout_pri - 1);
+	min_pageout_ticks = MAX(1,
+	    ((hz * min_percent_cpu) / 100) / RATETOSCHEDPAGING);
+	max_pageout_ticks = MAX(min_pageout_ticks,
+	    ((hz * max_percent_cpu) / 100) / RATETOSCHEDPAGING);
+
+	/*
+	 * Create the pageout scanner threads.
+	 */
+	if (pageout_scanner_pages == 0)
+		pageout_scanner_pages = btop(128ULL << 30);
+	if ((n = pageout_scanners) == 0) {
+		n = MAX(max_mem_nodes, 1);
+		n = MAX(n, total_pages / pageout_scanner_pages);
+	}
+	n_page_scanners = MIN(n, MAX_PSCAN_THREADS);
+	for (n = 0; n < n_page_scanners; n++) {
+		(void) lwp_kernel_create(proc_pageout, pageout_scanner,
+		    (void *)(uintptr_t)n, TS_RUN, pageout_pri - 1);
+	}
 
 	/*
 	 * kick off pageout scheduler.
@@ -737,16 +946,52 @@ pageout()
 }
 
 /*
- * Kernel thread that scans pages looking for ones to free
+ * Find the region of memory scanned by scanner inst, and place its hands.
+ * Returns the front hand's distance from the start of the region.
+ */
+static pgcnt_t
+pageout_scanner_hands(uint_t inst, page_t **startp, pgcnt_t *npagesp,
+    page_t **backp, page_t **frontp)
+{
+	pgcnt_t per = total_pages / n_page_scanners;
+	pgcnt_t npages, spread;
+
+	if (inst == n_page_scanners - 1)
+		npages = total_pages - per * inst;
+	else
+		npages = per;
+
+	/*
+	 * Each scanner covers 1/n of memory at 1/n of the overall rate, so
+	 * the same share of handspreadpages keeps the time between the
+	 * front and back hands the same.
+	 */
+	spread = handspreadpages / n_page_scanners;
+	if (spread >= npages)
+		spread = npages - 1;
+
+	*startp = page_nextn(page_first(), per * inst);
+	*npagesp = npages;
+	*backp = *startp;
+	*frontp = page_nextn(*startp, spread);
+	return (spread);
+}
+
+/*
+ * Kernel thread that scans pages looking for ones to free, in region
+ * (uintptr_t)a of n_page_scanners.
  */
 static void
-pageout_scanner(void)
+pageout_scanner(void *a)
 {
-	struct page *fronthand, *backhand;
-	uint_t count;
+	struct page *fronthand, *backhand, *regionstart;
+	uint_t inst = (uint_t)(uintptr_t)a;
+	uint_t count, gen = 0, hands;
 	callb_cpr_t cprinfo;
-	pgcnt_t	nscan_limit;
-	pgcnt_t	pcount;
+	pgcnt_t	nscan_limit, regionpages, frontpos, backpos;
+	pgcnt_t	pcount, nscanned, nfreed;
+	hrtime_t sample_start, sample_end;
+	clock_t lbolt;
 
 	CALLB_CPR_INIT(&cprinfo, &pageout_mutex, callb_generic_cpr, "poscan");
 	mutex_enter(&pageout_mutex);
@@ -761,38 +1006,42 @@ pageout_scanner(void)
 	 * Set the two clock hands to be separated by a reasonable amount,
 	 * but no more than 360 degrees apart.
 	 */
-	backhand = page_first();
-	if (handspreadpages >= total_pages)
-		fronthand = page_nextn(backhand, total_pages - 1);
-	else
-		fronthand = page_nextn(backhand, handspreadpages);
-
-	min_pageout_ticks = MAX(1,
-	    ((hz * min_percent_cpu) / 100) / RATETOSCHEDPAGING);
-	max_pageout_ticks = MAX(min_pageout_ticks,
-	    ((hz * max_percent_cpu) / 100) / RATETOSCHEDPAGING);
+	hands = reset_hands;
+	frontpos = pageout_scanner_hands(inst, &regionstart, &regionpages,
+	    &backhand, &fronthand);
+	backpos = 0;
 
 loop:
 	cv_signal_pageout();
 
 	CALLB_CPR_SAFE_BEGIN(&cprinfo);
-	cv_wait(&proc_pageout->p_cv, &pageout_mutex);
+	while (gen == pageout_scan_gen)
+		cv_wait(&proc_pageout->p_cv, &pageout_mutex);
 	CALLB_CPR_SAFE_END(&cprinfo, &pageout_mutex);
+	gen = pageout_scan_gen;
 
-	if (!dopageout)
-		goto loop;
+	if (!dopageout) {
+		nscanned = nfreed = 0;
+		goto done;
+	}
 
-	if (reset_hands) {
-		reset_hands = 0;
+	if (hands != reset_hands) {
+		hands = reset_hands;
 
-		backhand = page_first();
-		if (handspreadpages >= total_pages)
-			fronthand = page_nextn(backhand, total_pages - 1);
-		else
-			fronthand = page_nextn(backhand, handspreadpages);
+		frontpos = pageout_scanner_hands(inst, &regionstart,
+		    &regionpages, &backhand, &fronthand);
+		backpos = 0;
 	}
 
-	CPU_STATS_ADDQ(CPU, vm, pgrrun, 1);
+	if (pageout_sample_cnt < pageout_sample_lim)
+		nscan_limit = regionpages;
+	else
+		nscan_limit = desscan / n_page_scanners;
+	lbolt = ddi_get_lbolt();
+	pageout_lbolt = lbolt;
+	mutex_exit(&pageout_mutex);
+
+	CPU_STATS_ADD_K(vm, pgrrun, 1);
 	count = 0;
 
 	TRACE_4(TR_FAC_VM, TR_PAGEOUT_START,
@@ -804,12 +1053,8 @@ loop:
 	    tnf_ulong, pages_free, freemem, tnf_ulong, pages_needed, needfree);
 
 	pcount = 0;
-	if (pageout_sample_cnt < pageout_sample_lim) {
-		nscan_limit = total_pages;
-	} else {
-		nscan_limit = desscan;
-	}
-	pageout_lbolt = ddi_get_lbolt();
+	nscanned = 0;
+	nfreed = 0;
 	sample_start = gethrtime();
 
 	/*
@@ -821,7 +1066,7 @@ loop:
 	 * or not there is enough free memory.
 	 */
 
-	while (nscan < nscan_limit && (freemem < lotsfree + needfree ||
+	while (nscanned < nscan_limit && (freemem < lotsfree + needfree ||
 	    pageout_sample_cnt < pageout_sample_lim)) {
 		int rvfront, rvback;
 
@@ -831,9 +1076,9 @@ loop:
 		 * just every once in a while.
 		 */
 		if ((pcount & PAGES_POLL_MASK) == PAGES_POLL_MASK) {
-			pageout_cycle_ticks = ddi_get_lbolt() - pageout_lbolt;
+			pageout_cycle_ticks = ddi_get_lbolt() - lbolt;
 			if (pageout_cycle_ticks >= pageout_ticks) {
-				++pageout_timeouts;
+				atomic_inc_64(&pageout_timeouts);
 				break;
 			}
 		}
@@ -842,40 +1087,45 @@ loop:
 		 * If checkpage manages to add a page to the free list,
 		 * we give ourselves another couple of trips around the loop.
 		 */
-		if ((rvfront = checkpage(fronthand, FRONT)) == 1)
+		if ((rvfront = checkpage(fronthand, FRONT)) == 1) {
 			count = 0;
-		if ((rvback = checkpage(backhand, BACK)) == 1)
+			nfreed++;
+		}
+		if ((rvback = checkpage(backhand, BACK)) == 1) {
 			count = 0;
+			nfreed++;
+		}
 
 		++pcount;
 
-		/*
-		 * protected by pageout_mutex instead of cpu_stat_lock
-		 */
-		CPU_STATS_ADDQ(CPU, vm, scan, 1);
+		CPU_STATS_ADD_K(vm, scan, 1);
 
 		/*
 		 * Don't include ineligible pages in the number scanned.
 		 */
 		if (rvfront != -1 || rvback != -1)
-			nscan++;
-
-		backhand = page_next(backhand);
+			nscanned++;
 
 		/*
-		 * backhand update and wraparound check are done separately
-		 * because lint barks when it finds an empty "if" body
+		 * Each hand wraps around to the start of this scanner's
+		 * region when it gets to the end.
 		 */
+		if (++backpos == regionpages) {
+			backpos = 0;
+			backhand = regionstart;
+		} else {
+			backhand = page_next(backhand);
+		}
+
+		if (++frontpos == regionpages) {
+			frontpos = 0;
+			fronthand = regionstart;
 
-		if ((fronthand = page_next(fronthand)) == page_first())	{
 			TRACE_2(TR_FAC_VM, TR_PAGEOUT_HAND_WRAP,
 			    "pageout_hand_wrap:freemem %ld whichhand %d",
 			    freemem, FRONT);
 
-			/*
-			 * protected by pageout_mutex instead of cpu_stat_lock
-			 */
-			CPU_STATS_ADDQ(CPU, vm, rev, 1);
+			CPU_STATS_ADD_K(vm, rev, 1);
 			if (++count > 1) {
 				/*
 				 * Extremely unlikely, but it happens.
@@ -898,6 +1148,8 @@ loop:
 					break;
 				}
 			}
+		} else {
+			fronthand = page_next(fronthand);
 		}
 	}
 
@@ -905,23 +1157,46 @@ loop:
 
 	TRACE_5(TR_FAC_VM, TR_PAGEOUT_END,
 	    "pageout_end:freemem %ld lots %ld nscan %ld des %ld count %u",
-	    freemem, lotsfree, nscan, desscan, count);
+	    freemem, lotsfree, nscanned, desscan, count);
 
 	/* Kernel probe */
 	TNF_PROBE_2(pageout_scan_end, "vm pagedaemon", /* CSTYLED */,
-	    tnf_ulong, pages_scanned, nscan, tnf_ulong, pages_free, freemem);
+	    tnf_ulong, pages_scanned, nscanned, tnf_ulong, pages_free, freemem);
+
+	mutex_enter(&pageout_mutex);
 
 	if (pageout_sample_cnt < pageout_sample_lim) {
 		pageout_sample_pages += pcount;
 		pageout_sample_etime += sample_end - sample_start;
-		++pageout_sample_cnt;
 	}
-	if (pageout_sample_cnt >= pageout_sample_lim &&
-	    pageout_new_spread == 0) {
-		pageout_rate = (hrrate_t)pageout_sample_pages *
-		    (hrrate_t)(NANOSEC) / pageout_sample_etime;
-		pageout_new_spread = pageout_rate / 10;
-		setupclock(1);
+
+done:
+	nscan += nscanned;
+	pageout_cycle_nscan += nscanned;
+	pageout_cycle_nfreed += nfreed;
+
+	/*
+	 * The last scanner to finish wraps up the cycle.
+	 */
+	ASSERT(pageout_scanners_busy > 0);
+	if (--pageout_scanners_busy == 0) {
+		pageout_last_nscan = pageout_cycle_nscan;
+		pageout_last_nfreed = pageout_cycle_nfreed;
+
+		if (dopageout && pageout_sample_cnt < pageout_sample_lim)
+			++pageout_sample_cnt;
+		if (pageout_sample_cnt >= pageout_sample_lim &&
+		    pageout_new_spread == 0) {
+			/*
+			 * The rate is per scanner, as the samples add up
+			 * the time each of them spent scanning.
+			 */
+			pageout_rate = (hrrate_t)pageout_sample_pages *
+			    (hrrate_t)(NANOSEC) / nz(pageout_sample_etime);
+			pageout_new_spread = pageout_rate / 10 *
+			    n_page_scanners;
+			setupclock(1);
+		}
 	}
 
 	goto loop;
@@ -130,6 +130,17 @@
  * which provides low-latency per-cpu caching.  The qcache_max argument to
  * vmem_create() specifies the largest allocation size to cache.
  *
+ * Quantum caches are only practical for small multiples of the quantum.
+ * For arenas that also see a lot of larger allocations, such as heap_arena
+ * and kmem_va_arena during ARC growth and shrinkage, vmem_segcache_enable()
+ * adds a small per-CPU cache of recently freed segments up to
+ * vmem_segcache_max bytes.  vmem_alloc() satisfies an allocation from
+ * the current CPU's cache if it holds a segment of exactly the requested
+ * size, without taking the arena lock; vmem_free() returns segments there
+ * while it has room.  Cached segments still count as allocated in the
+ * arena.  They are given back by vmem_segcache_reap(), which kmem_reap()
+ * calls when memory is short, and by vmem_qcache_reap().
+ *
  * 1.9 Relationship to Kernel Memory Allocator
  * -------------------------------------------
  * Every kmem cache has a vmem arena as its slab supplier.  The kernel memory
@@ -187,7 +198,9 @@
  * 2.4 Vmem Locking
  * ----------------
  * For simplicity, all arena state is protected by a per-arena lock.
- * For very hot arenas, use quantum caching for scalability.
+ * For very hot arenas, use quantum caching for scalability.  Each per-CPU
+ * segment cache has its own lock, which is never held across a call into
+ * the arena.
  *
  * 2.5 Vmem Population
  * -------------------
@@ -217,6 +230,7 @@
 #include <sys/atomic.h>
 #include <sys/bitmap.h>
 #include <sys/sysmacros.h>
+#include <sys/cpuvar.h>
 #include <sys/cmn_err.h>
 #include <sys/debug.h>
 #include <sys/panic.h>
@@ -328,6 +342,7 @@ static vmem_t *vmem_vmem_arena;
 static long vmem_update_interval = 15;	/* vmem_update() every 15 seconds */
 uint32_t vmem_mtbf;		/* mean time between failures [default: off] */
 size_t vmem_seg_size = sizeof (vmem_seg_t);
+size_t vmem_segcache_max = 4 << 20; /* largest per-CPU cached segment */
 
 static vmem_kstat_t vmem_kstat_template = {
 	{ "mem_inuse",		KSTAT_DATA_UINT64 },
@@ -344,6 +359,8 @@ static vmem_kstat_t vmem_kstat_template = {
 	{ "populate_fail",	KSTAT_DATA_UINT64 },
 	{ "contains",		KSTAT_DATA_UINT64 },
 	{ "contains_search",	KSTAT_DATA_UINT64 },
+	{ "segcache_hit",	KSTAT_DATA_UINT64 },
+	{ "segcache_miss",	KSTAT_DATA_UINT64 },
 };
 
 /*
@@ -1252,6 +1269,89 @@ vmem_xfree(vmem_t *vmp, void *vaddr, size_t size)
 	}
 }
 
+/*
+ * Take a segment of exactly size bytes from the current CPU's segment cache,
+ * or return NULL if it doesn't have one.
+ */
+static void *
+vmem_segcache_alloc(vmem_t *vmp, size_t size)
+{
+	vmem_segcache_t *vsc = &vmp->vm_segcache[CPU->cpu_seqid];
+	uintptr_t addr = 0;
+	uint_t i;
+
+	mutex_enter(&vsc->vsc_lock);
+	for (i = vsc->vsc_nsegs; i-- != 0; ) {
+		if (vsc->vsc_seg[i].vss_size == size) {
+			addr = vsc->vsc_seg[i].vss_start;
+			vsc->vsc_seg[i] = vsc->vsc_seg[--vsc->vsc_nsegs];
+			break;
+		}
+	}
+	if (addr != 0)
+		vsc->vsc_hit++;
+	else
+		vsc->vsc_miss++;
+	mutex_exit(&vsc->vsc_lock);
+
+	return ((void *)addr);
+}
+
+/*
+ * Put a segment in the current CPU's segment cache.  Returns 0 if the
+ * cache is full, in which case the caller must free it to the arena.
+ */
+static int
+vmem_segcache_free(vmem_t *vmp, void *vaddr, size_t size)
+{
+	vmem_segcache_t *vsc = &vmp->vm_segcache[CPU->cpu_seqid];
+	uint_t n;
+
+	mutex_enter(&vsc->vsc_lock);
+	if ((n = vsc->vsc_nsegs) == VMEM_SEGCACHE_NSEGS) {
+		mutex_exit(&vsc->vsc_lock);
+		return (0);
+	}
+	vsc->vsc_seg[n].vss_start = (uintptr_t)vaddr;
+	vsc->vsc_seg[n].vss_size = size;
+	vsc->vsc_nsegs = n + 1;
+	mutex_exit(&vsc->vsc_lock);
+
+	return (1);
+}
+
+/*
+ * Return every segment in vmp's per-CPU segment caches to the arena.
+ */
+static void
+vmem_segcache_flush(vmem_t *vmp)
+{
+	vmem_segcache_t *vsc;
+	uintptr_t start[VMEM_SEGCACHE_NSEGS];
+	size_t size[VMEM_SEGCACHE_NSEGS];
+	uint_t i, n;
+	int cpu_seqid;
+
+	if (vmp->vm_segcache == NULL)
+		return;
+
+	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++) {
+		vsc = &vmp->vm_segcache[cpu_seqid];
+
+		mutex_enter(&vsc->vsc_lock);
+		n = vsc->vsc_nsegs;
+		for (i = 0; i < n; i++) {
+			start[i] = vsc->vsc_seg[i].vss_start;
+			size[i] = vsc->vsc_seg[i].vss_size;
+		}
+		vsc->vsc_nsegs = 0;
+		mutex_exit(&vsc->vsc_lock);
+
+		for (i = 0; i < n; i++)
+			vmem_xfree(vmp, (void *)start[i], size[i]);
+	}
+}
+
 /*
  * Allocate size bytes from arena vmp.  Returns the allocated address
  * on success, NULL on failure.  vmflag specifies VM_SLEEP or VM_NOSLEEP,
@@ -1276,6 +1376,11 @@ vmem_alloc(vmem_t *vmp, size_t size, int vmflag)
 	    (vmflag & (VM_NOSLEEP | VM_PANIC)) == VM_NOSLEEP)
 		return (NULL);
 
+	if (size - 1 < vmp->vm_segcache_max &&
+	    !(vmflag & (VM_NEXTFIT | VM_ENDALLOC)) &&
+	    (addr = (uintptr_t)vmem_segcache_alloc(vmp, size)) != 0)
+		return ((void *)addr);
+
 	if (vmflag & VM_NEXTFIT)
 		return (vmem_nextfit_alloc(vmp, size, vmflag));
 
@@ -1321,7 +1426,8 @@ vmem_free(vmem_t *vmp, void *vaddr, size_t size)
 	if (size - 1 < vmp->vm_qcache_max)
 		kmem_cache_free(vmp->vm_qcache[(size - 1) >> vmp->vm_qshift],
 		    vaddr);
-	else
+	else if (size - 1 >= vmp->vm_segcache_max ||
+	    !vmem_segcache_free(vmp, vaddr, size))
 		vmem_xfree(vmp, vaddr, size);
 }
 
@@ -1612,6 +1718,15 @@ vmem_destroy(vmem_t *vmp)
 	*vmpp = vmp->vm_next;
 	mutex_exit(&vmem_list_lock);
 
+	if (vmp->vm_segcache != NULL) {
+		vmp->vm_segcache_max = 0;
+		vmem_segcache_flush(vmp);
+		for (i = 0; i < max_ncpus; i++)
+			mutex_destroy(&vmp->vm_segcache[i].vsc_lock);
+		kmem_free(vmp->vm_segcache,
+		    max_ncpus * sizeof (vmem_segcache_t));
+	}
+
 	for (i = 0; i < VMEM_NQCACHE_MAX; i++)
 		if (vmp->vm_qcache[i])
 			kmem_cache_destroy(vmp->vm_qcache[i]);
@@ -1705,9 +1820,24 @@ void
 vmem_update(void *dummy)
 {
 	vmem_t *vmp;
+	uint64_t hit, miss;
+	int i;
 
 	mutex_enter(&vmem_list_lock);
 	for (vmp = vmem_list; vmp != NULL; vmp = vmp->vm_next) {
+		/*
+		 * Gather the per-CPU segment cache statistics.
+		 */
+		if (vmp->vm_segcache != NULL) {
+			hit = miss = 0;
+			for (i = 0; i < max_ncpus; i++) {
+				hit += vmp->vm_segcache[i].vsc_hit;
+				miss += vmp->vm_segcache[i].vsc_miss;
+			}
+			vmp->vm_kstat.vk_segcache_hit.value.ui64 = hit;
+			vmp->vm_kstat.vk_segcache_miss.value.ui64 = miss;
+		}
+
 		/*
 		 * If threads are waiting for resources, wake them up
 		 * periodically so they can issue another kmem_reap()
@@ -1736,6 +1866,49 @@ vmem_qcache_reap(vmem_t *vmp)
 	for (i = 0; i < VMEM_NQCACHE_MAX; i++)
 		if (vmp->vm_qcache[i])
 			kmem_cache_reap_now(vmp->vm_qcache[i]);
+
+	vmem_segcache_flush(vmp);
+}
+
+/*
+ * Give per-CPU caching of segments larger than the quantum caches handle
+ * to arena vmp.  This must be called after kmem is initialized, and has
+ * no effect on arenas whose quantum caches already cover everything up to
+ * vmem_segcache_max.
+ */
+void
+vmem_segcache_enable(vmem_t *vmp)
+{
+	vmem_segcache_t *vsc;
+	size_t max = P2ALIGN(vmem_segcache_max, vmp->vm_quantum);
+	int i;
+
+	ASSERT(!(vmp->vm_cflags & VMC_IDENTIFIER));
+
+	if (max <= vmp->vm_qcache_max || vmp->vm_segcache != NULL)
+		return;
+
+	vsc = kmem_zalloc(max_ncpus * sizeof (vmem_segcache_t), KM_SLEEP);
+	for (i = 0; i < max_ncpus; i++)
+		mutex_init(&vsc[i].vsc_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	vmp->vm_segcache = vsc;
+	membar_producer();
+	vmp->vm_segcache_max = max;
+}
+
+/*
+ * Return the contents of all per-CPU segment caches to their arenas.
+ */
+void
+vmem_segcache_reap(void)
+{
+	vmem_t *vmp;
+
+	mutex_enter(&vmem_list_lock);
+	for (vmp = vmem_list; vmp != NULL; vmp = vmp->vm_next)
+		vmem_segcache_flush(vmp);
+	mutex_exit(&vmem_list_lock);
 }
 
 /*
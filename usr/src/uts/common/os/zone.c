@@ -1989,6 +1989,88 @@ zone_misc_kstat_create(zone_t *zone)
 	return (ksp);
 }
 
+/*
+ * Add one observation of an unscaled latency to a zone latency histogram.
+ */
+void
+zone_lat_record(zone_lathist_t *zl, hrtime_t delta)
+{
+	int b;
+
+	if (delta <= 0)
+		return;
+	scalehrtime(&delta);
+	b = highbit64((uint64_t)delta) - ZONE_LAT_SHIFT;
+	if (b < 0)
+		b = 0;
+	else if (b >= ZONE_LAT_NBUCKETS)
+		b = ZONE_LAT_NBUCKETS - 1;
+	atomic_inc_64(&zl->zl_count[b]);
+}
+
+static int
+zone_lat_kstat_update(kstat_t *ksp, int rw)
+{
+	zone_t *zone = ksp->ks_private;
+	zone_lat_kstat_t *zlp = ksp->ks_data;
+	int i;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (i = 0; i < ZONE_LAT_NBUCKETS; i++) {
+		zlp->zl_runq[i].value.ui64 = zone->zone_runq_lat.zl_count[i];
+		zlp->zl_read[i].value.ui64 = zone->zone_read_lat.zl_count[i];
+		zlp->zl_write[i].value.ui64 = zone->zone_write_lat.zl_count[i];
+	}
+
+	return (0);
+}
+
+static kstat_t *
+zone_lat_kstat_create(zone_t *zone)
+{
+	kstat_t *ksp;
+	zone_lat_kstat_t *zlp;
+	char name[KSTAT_STRLEN];
+	uint64_t lo;
+	int i;
+
+	if ((ksp = kstat_create_zone("zones", zone->zone_id,
+	    "zone_latency", "zone_latency", KSTAT_TYPE_NAMED,
+	    sizeof (zone_lat_kstat_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL, zone->zone_id)) == NULL)
+		return (NULL);
+
+	if (zone->zone_id != GLOBAL_ZONEID)
+		kstat_zone_add(ksp, GLOBAL_ZONEID);
+
+	zlp = ksp->ks_data = kmem_zalloc(sizeof (zone_lat_kstat_t), KM_SLEEP);
+	ksp->ks_data_size += strlen(zone->zone_name) + 1;
+	ksp->ks_lock = &zone->zone_misc_lock;
+	zone->zone_lat_stats = zlp;
+
+	kstat_named_init(&zlp->zl_zonename, "zonename", KSTAT_DATA_STRING);
+	kstat_named_setstr(&zlp->zl_zonename, zone->zone_name);
+
+	/* each bucket is named for its lower bound, e.g. "runq_1024ns" */
+	for (i = 0; i < ZONE_LAT_NBUCKETS; i++) {
+		lo = i == 0 ? 0 : 1ULL << (i + ZONE_LAT_SHIFT - 1);
+		(void) snprintf(name, sizeof (name), "runq_%lluns", lo);
+		kstat_named_init(&zlp->zl_runq[i], name, KSTAT_DATA_UINT64);
+		(void) snprintf(name, sizeof (name), "read_%lluns", lo);
+		kstat_named_init(&zlp->zl_read[i], name, KSTAT_DATA_UINT64);
+		(void) snprintf(name, sizeof (name), "write_%lluns", lo);
+		kstat_named_init(&zlp->zl_write[i], name, KSTAT_DATA_UINT64);
+	}
+
+	ksp->ks_update = zone_lat_kstat_update;
+	ksp->ks_private = zone;
+
+	kstat_install(ksp);
+	return (ksp);
+}
+
 static void
 zone_kstat_create(zone_t *zone)
 {
@@ -2008,6 +2090,11 @@ zone_kstat_create(zone_t *zone)
 		zone->zone_misc_stats = kmem_zalloc(
 		    sizeof (zone_misc_kstat_t), KM_SLEEP);
 	}
+
+	if ((zone->zone_lat_ksp = zone_lat_kstat_create(zone)) == NULL) {
+		zone->zone_lat_stats = kmem_zalloc(
+		    sizeof (zone_lat_kstat_t), KM_SLEEP);
+	}
 }
 
 static void
@@ -2036,6 +2123,8 @@ zone_kstat_delete(zone_t *zone)
 	    sizeof (zone_mcap_kstat_t));
 	zone_kstat_delete_common(&zone->zone_misc_ksp,
 	    sizeof (zone_misc_kstat_t));
+	zone_kstat_delete_common(&zone->zone_lat_ksp,
+	    sizeof (zone_lat_kstat_t));
 }
 
 /*
@@ -2276,6 +2365,7 @@ zone_init(void)
 	zone0.zone_ntasks = 1;
 	mutex_exit(&p0.p_lock);
 	zone0.zone_restart_init = B_TRUE;
+	zone0.zone_lpg_promote = B_TRUE;
 	zone0.zone_brand = &native_brand;
 	rctl_prealloc_destroy(gp);
 	/*
@@ -2578,6 +2668,18 @@ zone_set_phys_mcap(zone_t *zone, const uint64_t *zone_mcap)
 	return (err);
 }
 
+static int
+zone_set_lpg_promote(zone_t *zone, const boolean_t *zone_promote)
+{
+	boolean_t promote;
+	int err = 0;
+
+	if ((err = copyin(zone_promote, &promote, sizeof (boolean_t))) == 0)
+		zone->zone_lpg_promote = (promote != B_FALSE);
+
+	return (err);
+}
+
 static int
 zone_set_sched_class(zone_t *zone, const char *new_class)
 {
@@ -4391,6 +4493,7 @@ zone_create(const char *zone_name, const char *zone_root,
 	zone->zone_ncpus = 0;
 	zone->zone_ncpus_online = 0;
 	zone->zone_restart_init = B_TRUE;
+	zone->zone_lpg_promote = B_TRUE;
 	zone->zone_brand = &native_brand;
 	zone->zone_initname = NULL;
 	mutex_init(&zone->zone_lock, NULL, MUTEX_DEFAULT, NULL);
@@ -5519,6 +5622,14 @@ zone_getattr(zoneid_t zoneid, int attr, void *buf, size_t bufsize)
 		    copyout(&zone->zone_phys_mcap, buf, bufsize) != 0)
 			error = EFAULT;
 		break;
+	case ZONE_ATTR_LPG_PROMOTE:
+		size = sizeof (zone->zone_lpg_promote);
+		if (bufsize > size)
+			bufsize = size;
+		if (buf != NULL &&
+		    copyout(&zone->zone_lpg_promote, buf, bufsize) != 0)
+			error = EFAULT;
+		break;
 	case ZONE_ATTR_SCHED_CLASS:
 		mutex_enter(&class_lock);
 
@@ -5604,10 +5715,11 @@ zone_setattr(zoneid_t zoneid, int attr, void *buf, size_t bufsize)
 		return (set_errno(EPERM));
 
 	/*
-	 * Only the ZONE_ATTR_PHYS_MCAP attribute can be set on the
-	 * global zone.
+	 * Only the ZONE_ATTR_PHYS_MCAP and ZONE_ATTR_LPG_PROMOTE attributes
+	 * can be set on the global zone.
 	 */
-	if (zoneid == GLOBAL_ZONEID && attr != ZONE_ATTR_PHYS_MCAP) {
+	if (zoneid == GLOBAL_ZONEID && attr != ZONE_ATTR_PHYS_MCAP &&
+	    attr != ZONE_ATTR_LPG_PROMOTE) {
 		return (set_errno(EINVAL));
 	}
 
@@ -5624,7 +5736,8 @@ zone_setattr(zoneid_t zoneid, int attr, void *buf, size_t bufsize)
 	 * non-global zones.
 	 */
 	zone_status = zone_status_get(zone);
-	if (attr != ZONE_ATTR_PHYS_MCAP && zone_status > ZONE_IS_READY) {
+	if (attr != ZONE_ATTR_PHYS_MCAP && attr != ZONE_ATTR_LPG_PROMOTE &&
+	    zone_status > ZONE_IS_READY) {
 		err = EINVAL;
 		goto done;
 	}
@@ -5649,6 +5762,9 @@ zone_setattr(zoneid_t zoneid, int attr, void *buf, size_t bufsize)
 	case ZONE_ATTR_PHYS_MCAP:
 		err = zone_set_phys_mcap(zone, (const uint64_t *)buf);
 		break;
+	case ZONE_ATTR_LPG_PROMOTE:
+		err = zone_set_lpg_promote(zone, (const boolean_t *)buf);
+		break;
 	case ZONE_ATTR_SCHED_CLASS:
 		err = zone_set_sched_class(zone, (const char *)buf);
 		break;
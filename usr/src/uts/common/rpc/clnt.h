@@ -662,6 +662,13 @@ typedef enum {
 					/* connection setup error	  */
 #define	CLSET_BINDRESVPORT	10005	/* Set preference for reserve port */
 #define	CLGET_BINDRESVPORT	10006	/* Get preference for reserve port */
+#define	CLSET_NCONNECT		10007	/* Set connections to spread */
+					/* calls over */
+#define	CLGET_NCONNECT		10008	/* Get connections to spread */
+					/* calls over */
+
+#define	CLNT_MAX_NCONNECT	16	/* limit for CLSET_NCONNECT */
+					/* will take */
 #endif
 
 /*
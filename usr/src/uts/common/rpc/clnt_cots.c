@@ -375,6 +375,7 @@ typedef struct cku_private_s {
 	bool_t			cku_nodelayonerr;
 						/* for CLSET_NODELAYONERR */
 	int			cku_useresvport; /* Use reserved port */
+	uint_t			cku_nconns;	/* for CLSET_NCONNECT */
 	struct rpc_cots_client	*cku_stats;	/* stats for zone */
 } cku_private_t;
 
@@ -403,7 +404,7 @@ static struct cm_xprt *connmgr_wrapget(struct netbuf *, const struct timeval *,
 
 static struct cm_xprt *connmgr_get(struct netbuf *, const struct timeval *,
 	struct netbuf *, int, struct netbuf *, struct rpc_err *, dev_t,
-	bool_t, int, cred_t *);
+	bool_t, int, uint_t, cred_t *);
 
 static void connmgr_cancelconn(struct cm_xprt *);
 static enum clnt_stat connmgr_cwait(struct cm_xprt *, const struct timeval *,
@@ -731,6 +732,25 @@ clnt_cots_kcontrol(CLIENT *h, int cmd, char *arg)
 
 		return (TRUE);
 
+	case CLSET_NCONNECT:
+		if (arg == NULL)
+			return (FALSE);
+
+		if (*(uint_t *)arg > CLNT_MAX_NCONNECT)
+			return (FALSE);
+
+		p->cku_nconns = *(uint_t *)arg;
+
+		return (TRUE);
+
+	case CLGET_NCONNECT:
+		if (arg == NULL)
+			return (FALSE);
+
+		*(uint_t *)arg = p->cku_nconns;
+
+		return (TRUE);
+
 	default:
 		return (FALSE);
 	}
@@ -1576,6 +1596,7 @@ clnt_cots_kinit(CLIENT *h, dev_t dev, int family, struct netbuf *addr,
 	p->cku_device = dev;
 	p->cku_addrfmly = family;
 	p->cku_cred = cred;
+	p->cku_nconns = 0;
 
 	if (p->cku_addr.maxlen < addr->len) {
 		if (p->cku_addr.maxlen != 0 && p->cku_addr.buf != NULL)
@@ -1768,7 +1789,8 @@ connmgr_wrapget(
 
 	cm_entry = connmgr_get(retryaddr, waitp, &p->cku_addr, p->cku_addrfmly,
 	    &p->cku_srcaddr, &p->cku_err, p->cku_device,
-	    p->cku_client.cl_nosignal, p->cku_useresvport, p->cku_cred);
+	    p->cku_client.cl_nosignal, p->cku_useresvport, p->cku_nconns,
+	    p->cku_cred);
 
 	if (cm_entry == NULL) {
 		/*
@@ -1797,7 +1819,8 @@ connmgr_wrapget(
  *
  * To implement round-robin load balancing with multiple client connections,
  * the last entry on the list is always selected. Once the entry is selected
- * it's re-inserted to the head of the list.
+ * it's re-inserted to the head of the list.  Up to nconns connections are
+ * made to each server, or clnt_max_conns if nconns is 0; see CLSET_NCONNECT.
  */
 static struct cm_xprt *
 connmgr_get(
@@ -1810,11 +1833,12 @@ connmgr_get(
 	dev_t		device,
 	bool_t		nosignal,
 	int		useresvport,
+	uint_t		nconns,
 	cred_t		*cr)
 {
 	struct cm_xprt *cm_entry;
-	struct cm_xprt *lru_entry;
-	struct cm_xprt **cmp, **prev;
+	struct cm_xprt *lru_entry, *mru_entry;
+	struct cm_xprt **cmp, **prev, **mru_prev;
 	queue_t *wq;
 	TIUSER *tiptr;
 	int i;
@@ -1822,6 +1846,7 @@ connmgr_get(
 	int tidu_size;
 	bool_t	connected;
 	zoneid_t zoneid = rpc_zoneid();
+	int maxconns = nconns != 0 ? nconns : clnt_max_conns;
 
 	/*
 	 * If the call is not a retry, look for a transport entry that
@@ -1832,9 +1857,9 @@ connmgr_get(
 	if (retryaddr == NULL) {
 use_new_conn:
 		i = 0;
-		cm_entry = lru_entry = NULL;
+		cm_entry = lru_entry = mru_entry = NULL;
 
-		prev = cmp = &cm_hd;
+		prev = mru_prev = cmp = &cm_hd;
 		while ((cm_entry = *cmp) != NULL) {
 			ASSERT(cm_entry != cm_entry->x_next);
 			/*
@@ -1907,25 +1932,34 @@ use_new_conn:
 				}
 				i++;
 
-				/* keep track of the last entry */
+				/* keep track of the first and last entries */
+				if (mru_entry == NULL) {
+					mru_entry = cm_entry;
+					mru_prev = cmp;
+				}
 				lru_entry = cm_entry;
 				prev = cmp;
 			}
 			cmp = &cm_entry->x_next;
 		}
 
-		if (i > clnt_max_conns) {
-			RPCLOG(8, "connmgr_get: too many conns, dooming entry"
-			    " %p\n", (void *)lru_entry->x_tiptr);
-			lru_entry->x_doomed = TRUE;
-			goto use_new_conn;
+		/*
+		 * There may be more connections than our maximum if other
+		 * handles asked for more (CLSET_NCONNECT).  Rather than
+		 * tearing those down, use the most recently used one, so
+		 * that the rest go idle and are closed once nobody wants
+		 * them any more.
+		 */
+		if (i > maxconns) {
+			lru_entry = mru_entry;
+			prev = mru_prev;
 		}
 
 		/*
 		 * If we are at the maximum number of connections to
 		 * the server, hand back the least recently used one.
 		 */
-		if (i == clnt_max_conns) {
+		if (i >= maxconns) {
 			/*
 			 * Copy into the handle the source address of
 			 * the connection, which we will use in case of
@@ -67,7 +67,7 @@ extern "C" {
 				 * CQ entries, Tavor returns 2^12 entries.
 				 * 4K CQ entries suffice.  Hence, 4096 - 1.
 				 */
-#define	DEF_SQ_SIZE	128	/* default SendQ size */
+#define	DEF_SQ_SIZE	256	/* default SendQ size */
 #define	DEF_RQ_SIZE	256	/* default RecvQ size */
 #define	DSEG_MAX	2
 #define	RQ_DSEG_MAX	1	/* default RQ data seg */
@@ -250,6 +250,9 @@ struct rib_hca_s {
 	rib_bufpool_t		*recv_pool;	/* recv buf pool */
 	rib_bufpool_t		*send_pool;	/* send buf pool */
 
+	ibt_fmr_pool_hdl_t	fmr_pool;	/* chunk registrations */
+	uint_t			fmr_max_len;	/* largest FMR mapping */
+
 	void			*iblock;	/* interrupt cookie */
 
 	kmem_cache_t	*server_side_cache;	/* long reply pool */
@@ -93,8 +93,8 @@ extern "C" {
 #define	RCL_BUF_LEN	32768
 
 
-#define	RDMA_BUFS_RQST	34	/* Num bufs requested by client */
-#define	RDMA_BUFS_GRANT	32	/* Num bufs granted by server */
+#define	RDMA_BUFS_RQST	130	/* Num bufs requested by client */
+#define	RDMA_BUFS_GRANT	128	/* Num bufs granted by server */
 
 struct xdr_ops *xdrrdma_xops(void);
 
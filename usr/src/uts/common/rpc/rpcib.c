@@ -50,6 +50,7 @@
 #include <sys/proc.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <sys/buf.h>
 #include <sys/stream.h>
 #include <sys/strsubr.h>
 #include <sys/stropts.h>
@@ -214,6 +215,29 @@ uint64_t	cache_limit = 100 * 1024 * 1024;
 static uint64_t	cache_watermark = 80 * 1024 * 1024;
 static bool_t	stats_enabled = FALSE;
 
+/*
+ * Chunks of an RPC that are not in the long reply cache are registered for
+ * the duration of that RPC only.  A full memory registration of a 1MB read
+ * or write writes the whole translation table through the HCA's command
+ * interface, so where the HCA supports it these chunks are mapped through a
+ * per-HCA pool of fast memory regions instead.  Registrations that do not
+ * fit, user address space chunks, and registrations made while the pool is
+ * exhausted fall back to ibt_register_mr().
+ *
+ * rib_fmr_t is what the mrc_linfo of such a registration points to; the
+ * handle is tagged with RIB_MRC_FMR so it is deregistered the same way.
+ */
+typedef struct rib_fmr_s {
+	ibt_mr_hdl_t	fmr_mr_hdl;
+	ibt_ma_hdl_t	fmr_ma_hdl;
+} rib_fmr_t;
+
+#define	RIB_MRC_FMR	0x1
+
+int		rib_fmr_enable = 1;
+uint_t		rib_fmr_pool_size = 2048;
+uint_t		rib_fmr_max_len = 1024 * 1024;
+
 static uint64_t max_unsignaled_rws = 5;
 int nfs_rdma_port = NFS_RDMA_PORT;
 
@@ -373,6 +397,9 @@ static rdma_stat rib_reg_mem(rib_hca_t *, caddr_t adsp, caddr_t, uint_t,
 	ibt_mr_flags_t, ibt_mr_hdl_t *, ibt_mr_desc_t *);
 static rdma_stat rib_reg_mem_user(rib_hca_t *, caddr_t, uint_t, ibt_mr_flags_t,
 	ibt_mr_hdl_t *, ibt_mr_desc_t *, caddr_t);
+static void rib_create_fmr_pool(rib_hca_t *);
+static rdma_stat rib_reg_fmr(rib_hca_t *, caddr_t, uint_t, struct mrc *);
+static void rib_dereg_fmr(rib_hca_t *, struct mrc);
 static rdma_stat rib_conn_to_srv(rib_hca_t *, rib_qp_t *, rpcib_ping_t *);
 static rdma_stat rib_clnt_create_chan(rib_hca_t *, struct netbuf *,
 	rib_qp_t **);
@@ -903,6 +930,8 @@ rpcib_open_hcas(rpcib_state_t *ribstat)
 			goto fail3;
 		}
 
+		rib_create_fmr_pool(hca);
+
 		if (hca->server_side_cache == NULL) {
 			(void) sprintf(rssc_name,
 			    "rib_srvr_cache_%llx",
@@ -3739,6 +3768,12 @@ rib_registermemsync(CONN *conn,  caddr_t adsp, caddr_t buf, uint_t buflen,
 			buf = (caddr_t)l->lrc_buf;
 			buflen = l->lrc_len;
 		}
+	} else if (adsp == NULL && hca->fmr_pool != NULL &&
+	    buflen <= hca->fmr_max_len &&
+	    rib_reg_fmr(hca, buf, buflen, buf_handle) == RDMA_SUCCESS) {
+		*sync_handle = (RIB_SYNCMEM_HANDLE)
+		    (uintptr_t)buf_handle->mrc_linfo;
+		return (RDMA_SUCCESS);
 	}
 	status = rib_reg_mem(hca, adsp, buf, buflen, 0, &mr_hdl, &mr_desc);
 
@@ -3788,11 +3823,117 @@ rib_deregistermemsync(CONN *conn, caddr_t buf, struct mrc buf_handle,
 		if (l->registered)
 			return (RDMA_SUCCESS);
 
+	if (buf_handle.mrc_linfo & RIB_MRC_FMR) {
+		rib_dereg_fmr((ctoqp(conn))->hca, buf_handle);
+		return (RDMA_SUCCESS);
+	}
+
 	(void) rib_deregistermem(conn, buf, buf_handle);
 
 	return (RDMA_SUCCESS);
 }
 
+/*
+ * Set up the FMR pool used for per-RPC chunk registrations.  Failure is not
+ * fatal; chunks are then registered with ibt_register_mr() as before.
+ */
+static void
+rib_create_fmr_pool(rib_hca_t *hca)
+{
+	ibt_fmr_pool_attr_t	fmr_attr;
+
+	hca->fmr_pool = NULL;
+	if (!rib_fmr_enable || !(hca->hca_attrs.hca_flags & IBT_HCA_FMR))
+		return;
+
+	bzero(&fmr_attr, sizeof (fmr_attr));
+	/* a chunk need not start on a page boundary */
+	fmr_attr.fmr_max_pages_per_fmr = btopr(rib_fmr_max_len) + 1;
+	fmr_attr.fmr_pool_size = rib_fmr_pool_size;
+	fmr_attr.fmr_dirty_watermark = rib_fmr_pool_size / 4;
+	fmr_attr.fmr_page_sz = PAGESIZE;
+	fmr_attr.fmr_cache = B_FALSE;
+	fmr_attr.fmr_flags = IBT_MR_SLEEP | IBT_MR_ENABLE_LOCAL_WRITE |
+	    IBT_MR_ENABLE_REMOTE_READ | IBT_MR_ENABLE_REMOTE_WRITE;
+
+	if (ibt_create_fmr_pool(hca->hca_hdl, hca->pd_hdl, &fmr_attr,
+	    &hca->fmr_pool) != IBT_SUCCESS) {
+		hca->fmr_pool = NULL;
+		return;
+	}
+	hca->fmr_max_len = rib_fmr_max_len;
+}
+
+/*
+ * Register the kernel buffer buf through the HCA's FMR pool.  The I/O
+ * virtual address of the region is buf itself, so the chunk addresses put
+ * on the wire do not change.
+ */
+static rdma_stat
+rib_reg_fmr(rib_hca_t *hca, caddr_t buf, uint_t buflen, struct mrc *buf_handle)
+{
+	rib_fmr_t	*fmr;
+	ibt_va_attr_t	va_attr;
+	ibt_reg_req_t	reg_req;
+	ibt_pmr_desc_t	pmr_desc;
+	ibt_status_t	ibt_status;
+	struct buf	bp;
+
+	bioinit(&bp);
+	bp.b_flags = B_BUSY | B_WRITE;
+	bp.b_un.b_addr = buf;
+	bp.b_bcount = buflen;
+
+	bzero(&va_attr, sizeof (va_attr));
+	va_attr.va_vaddr = (ib_vaddr_t)(uintptr_t)buf;
+	va_attr.va_len = buflen;
+	va_attr.va_buf = &bp;
+	va_attr.va_flags = IBT_VA_FMR | IBT_VA_BUF;
+
+	fmr = kmem_alloc(sizeof (*fmr), KM_SLEEP);
+
+	rw_enter(&hca->state_lock, RW_READER);
+	if (hca->state == HCA_DETACHED) {
+		rw_exit(&hca->state_lock);
+		goto fail;
+	}
+	ibt_status = ibt_map_mem_area(hca->hca_hdl, &va_attr,
+	    btopr(buflen) + 1, &reg_req, &fmr->fmr_ma_hdl);
+	if (ibt_status != IBT_SUCCESS) {
+		rw_exit(&hca->state_lock);
+		goto fail;
+	}
+	ibt_status = ibt_register_physical_fmr(hca->hca_hdl, hca->fmr_pool,
+	    &reg_req.fn_arg, &fmr->fmr_mr_hdl, &pmr_desc);
+	rw_exit(&hca->state_lock);
+	if (ibt_status != IBT_SUCCESS) {
+		(void) ibt_unmap_mem_area(hca->hca_hdl, fmr->fmr_ma_hdl);
+		goto fail;
+	}
+	biofini(&bp);
+
+	buf_handle->mrc_linfo = (uintptr_t)fmr | RIB_MRC_FMR;
+	buf_handle->mrc_lmr = (uint32_t)pmr_desc.pmd_lkey;
+	buf_handle->mrc_rmr = (uint32_t)pmr_desc.pmd_rkey;
+	return (RDMA_SUCCESS);
+
+fail:
+	biofini(&bp);
+	kmem_free(fmr, sizeof (*fmr));
+	return (RDMA_FAILED);
+}
+
+static void
+rib_dereg_fmr(rib_hca_t *hca, struct mrc buf_handle)
+{
+	rib_fmr_t	*fmr;
+
+	fmr = (rib_fmr_t *)(uintptr_t)(buf_handle.mrc_linfo & ~RIB_MRC_FMR);
+	(void) ibt_deregister_fmr(hca->hca_hdl, fmr->fmr_mr_hdl);
+	(void) ibt_unmap_mem_area(hca->hca_hdl, fmr->fmr_ma_hdl);
+	kmem_free(fmr, sizeof (*fmr));
+}
+
 /* ARGSUSED */
 rdma_stat
 rib_syncmem(CONN *conn, RIB_SYNCMEM_HANDLE shandle, caddr_t buf,
@@ -3802,6 +3943,10 @@ rib_syncmem(CONN *conn, RIB_SYNCMEM_HANDLE shandle, caddr_t buf,
 	rib_hca_t *hca = (ctoqp(conn))->hca;
 	ibt_mr_sync_t	mr_segment;
 
+	/* FMR mappings are bound consistent and need no sync */
+	if ((uintptr_t)shandle & RIB_MRC_FMR)
+		return (RDMA_SUCCESS);
+
 	mr_segment.ms_handle = (ibt_mr_hdl_t)shandle;
 	mr_segment.ms_vaddr = (ib_vaddr_t)(uintptr_t)buf;
 	mr_segment.ms_len = (ib_memlen_t)len;
@@ -4811,6 +4956,10 @@ rib_free_hca(rib_hca_t *hca)
 	rib_rbufpool_destroy(hca, RECV_BUFFER);
 	rib_rbufpool_destroy(hca, SEND_BUFFER);
 	rib_destroy_cache(hca);
+	if (hca->fmr_pool != NULL) {
+		(void) ibt_destroy_fmr_pool(hca->hca_hdl, hca->fmr_pool);
+		hca->fmr_pool = NULL;
+	}
 	if (rib_mod.rdma_count == 0)
 		(void) rdma_unregister_mod(&rib_mod);
 	(void) ibt_free_pd(hca->hca_hdl, hca->pd_hdl);
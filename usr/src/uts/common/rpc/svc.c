@@ -73,7 +73,11 @@
  *   to restrict resource usage by the service. Some fields are protected
  *   by locks:
  *   - p_req_lock protects several counts and flags:
- *	p_reqs, p_size, p_walkers, p_asleep, p_drowsy, p_req_cv
+ *	p_asleep, p_drowsy, p_qoverflow, p_req_cv
+ *   - p_reqs, p_size and p_walkers are updated with atomics so that
+ *	a thread picking up a request does not have to take p_req_lock;
+ *	decisions to sleep or to wake up a thread are still made with
+ *	p_req_lock held.
  *   - p_thread_lock governs other thread counts:
  *	p_threads, p_detached_threads, p_reserved_threads, p_closing
  *
@@ -204,6 +208,7 @@
 #include <sys/callb.h>
 #include <sys/vtrace.h>
 #include <sys/zone.h>
+#include <sys/atomic.h>
 #include <nfs/nfs.h>
 #include <sys/tsol/label_macro.h>
 
@@ -1882,9 +1887,7 @@ svc_poll(SVCPOOL *pool, SVCMASTERXPRT *xprt, SVCXPRT *clone_xprt)
 		 * If there is no request on the current transport try to
 		 * find another transport with a pending request.
 		 */
-		mutex_enter(&pool->p_req_lock);
-		pool->p_walkers++;
-		mutex_exit(&pool->p_req_lock);
+		atomic_inc_uint((uint_t *)&pool->p_walkers);
 
 		/*
 		 * Make sure that transports will not be destroyed just
@@ -1913,9 +1916,8 @@ svc_poll(SVCPOOL *pool, SVCMASTERXPRT *xprt, SVCXPRT *clone_xprt)
 				if (hint->xp_req_head) {
 					rw_exit(&pool->p_lrwlock);
 
-					mutex_enter(&pool->p_req_lock);
-					pool->p_walkers--;
-					mutex_exit(&pool->p_req_lock);
+					atomic_dec_uint(
+					    (uint_t *)&pool->p_walkers);
 
 					return (hint);
 				}
@@ -1983,9 +1985,8 @@ svc_poll(SVCPOOL *pool, SVCMASTERXPRT *xprt, SVCXPRT *clone_xprt)
 				if (next->xp_req_head) {
 					rw_exit(&pool->p_lrwlock);
 
-					mutex_enter(&pool->p_req_lock);
-					pool->p_walkers--;
-					mutex_exit(&pool->p_req_lock);
+					atomic_dec_uint(
+					    (uint_t *)&pool->p_walkers);
 
 					return (next);
 				}
@@ -2014,7 +2015,7 @@ svc_poll(SVCPOOL *pool, SVCMASTERXPRT *xprt, SVCXPRT *clone_xprt)
 		 * No work to do. Stop the `walk' and go asleep.
 		 * Decrement the `walking-threads' count for the pool.
 		 */
-		pool->p_walkers--;
+		atomic_dec_uint((uint_t *)&pool->p_walkers);
 		rw_exit(&pool->p_lrwlock);
 
 		/*
@@ -2292,12 +2293,19 @@ svc_run(SVCPOOL *pool)
 		mp->b_next = (mblk_t *)0;
 		size = svc_msgsize(mp);
 
-		mutex_enter(&pool->p_req_lock);
-		pool->p_reqs--;
-		if (pool->p_reqs == 0)
-			pool->p_qoverflow = FALSE;
-		pool->p_size -= size;
-		mutex_exit(&pool->p_req_lock);
+		atomic_add_long((ulong_t *)&pool->p_size, -(long)size);
+		if (atomic_dec_uint_nv((uint_t *)&pool->p_reqs) == 0) {
+			/*
+			 * The queue can only be trusted again once it has
+			 * drained; recheck under the lock svc_queuereq()
+			 * holds while it queues a hint and counts the
+			 * request.
+			 */
+			mutex_enter(&pool->p_req_lock);
+			if (pool->p_reqs == 0)
+				pool->p_qoverflow = FALSE;
+			mutex_exit(&pool->p_req_lock);
+		}
 
 		next->xp_reqs--;
 		next->xp_size -= size;
@@ -2417,10 +2425,8 @@ svc_queueclean(queue_t *q)
 		(*RELE_PROC(xprt)) (xprt->xp_wq, mp, FALSE);
 	}
 
-	mutex_enter(&pool->p_req_lock);
-	pool->p_reqs -= xprt->xp_reqs;
-	pool->p_size -= xprt->xp_size;
-	mutex_exit(&pool->p_req_lock);
+	atomic_add_int((uint_t *)&pool->p_reqs, -xprt->xp_reqs);
+	atomic_add_long((ulong_t *)&pool->p_size, -(long)xprt->xp_size);
 
 	xprt->xp_reqs = 0;
 	xprt->xp_size = 0;
@@ -2560,12 +2566,12 @@ svc_queuereq(queue_t *q, mblk_t *mp, bool_t flowcontrol)
 	svc_xprt_qput(pool, xprt);
 
 	/* Increment counters */
-	pool->p_reqs++;
+	atomic_inc_uint((uint_t *)&pool->p_reqs);
 	xprt->xp_reqs++;
 
 	size = svc_msgsize(mp);
 	xprt->xp_size += size;
-	pool->p_size += size;
+	atomic_add_long((ulong_t *)&pool->p_size, size);
 
 	/* Handle flow control */
 	if (flowcontrol)
@@ -2786,10 +2792,9 @@ rdma_stop(rdma_xprt_group_t *rdma_xprts)
 			RDMA_REL_CONN(rdp->conn);
 			freemsg(mp);
 		}
-		mutex_enter(&pool->p_req_lock);
-		pool->p_reqs -= xprt->xp_reqs;
-		pool->p_size -= xprt->xp_size;
-		mutex_exit(&pool->p_req_lock);
+		atomic_add_int((uint_t *)&pool->p_reqs, -xprt->xp_reqs);
+		atomic_add_long((ulong_t *)&pool->p_size,
+		    -(long)xprt->xp_size);
 		xprt->xp_reqs = 0;
 		xprt->xp_size = 0;
 		xprt->xp_full = FALSE;
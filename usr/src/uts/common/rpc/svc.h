@@ -255,7 +255,8 @@ struct __svcpool {
 	 * The pool's thread lock p_thread_lock protects:
 	 * - p_threads, p_detached_threads, p_reserved_threads and p_closing
 	 * The pool's request lock protects:
-	 * - p_asleep, p_drowsy, p_reqs, p_size, p_walkers, p_req_cv.
+	 * - p_asleep, p_drowsy, p_qoverflow, p_req_cv.
+	 * p_reqs, p_size and p_walkers are updated atomically.
 	 * The following fields are `initialized constants':
 	 * - p_id, p_stksize, p_timeout.
 	 * Access to p_next and p_prev is protected by the pool
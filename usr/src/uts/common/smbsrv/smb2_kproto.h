@@ -71,6 +71,9 @@ smb_sdrc_t smb2_query_info(smb_request_t *);
 smb_sdrc_t smb2_set_info(smb_request_t *);
 smb_sdrc_t smb2_oplock_break_ack(smb_request_t *);
 
+uint8_t smb2_lease_oplock_level(uint32_t);
+uint32_t smb2_oplock_lease_state(uint8_t);
+
 int smb2_newrq_negotiate(smb_request_t *);
 
 uint32_t smb2_ofile_getattr(smb_request_t *, smb_ofile_t *, smb_attr_t *);
@@ -312,6 +312,7 @@ int smb_oplock_break(smb_request_t *, smb_node_t *, uint32_t);
 void smb_oplock_break_levelII(smb_node_t *);
 void smb_oplock_ack(smb_node_t *, smb_ofile_t *, uint8_t);
 void smb_oplock_broadcast(smb_node_t *);
+boolean_t smb_oplock_lease_held(smb_request_t *, smb_node_t *);
 
 void smb1_oplock_break_notification(smb_request_t *, uint8_t);
 void smb2_oplock_break_notification(smb_request_t *, uint8_t);
@@ -666,6 +667,7 @@ void smb_request_free(smb_request_t *);
  */
 smb_ofile_t *smb_ofile_lookup_by_fid(smb_request_t *, uint16_t);
 smb_ofile_t *smb_ofile_lookup_by_uniqid(smb_tree_t *, uint32_t);
+smb_ofile_t *smb_ofile_lookup_by_lease(smb_tree_t *, const uint8_t *);
 boolean_t smb_ofile_disallow_fclose(smb_ofile_t *);
 smb_ofile_t *smb_ofile_open(smb_request_t *, smb_node_t *,
     smb_arg_open_t *, uint16_t, uint32_t, smb_error_t *);
@@ -782,6 +784,8 @@ smb_xa_t *smb_xa_find(smb_session_t *session, uint32_t pid, uint16_t mid);
 struct mbuf *smb_mbuf_get(uchar_t *buf, int nbytes);
 struct mbuf *smb_mbuf_allocate(struct uio *uio);
 void smb_mbuf_trim(struct mbuf *mhead, int nbytes);
+struct uio *smb_mbuf_loan_get(vnode_t *, offset_t, uint32_t);
+struct mbuf *smb_mbuf_loan_chain(struct uio *, int);
 
 void smb_check_status(void);
 int smb_handle_write_raw(smb_session_t *session, smb_request_t *sr);
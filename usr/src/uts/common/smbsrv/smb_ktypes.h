@@ -563,6 +563,12 @@ int MBC_SHADOW_CHAIN(struct mbuf_chain *SUBMBC, struct mbuf_chain *MBC,
 #define	SMB_OPLOCK_BATCH	2
 #define	SMB_OPLOCK_LEVEL_II	3
 
+/*
+ * SMB 2.1 leases are carried by the oplock grants above: the lease
+ * key identifies all the handles a client opens under one lease.
+ */
+#define	SMB_LEASE_KEY_SZ	16
+
 typedef struct smb_oplock {
 	kmutex_t		ol_mutex;
 	kcondvar_t		ol_cv;
@@ -1283,6 +1289,8 @@ typedef struct smb_ofile {
 	boolean_t		f_written;
 	char			f_quota_resume[SMB_SID_STRSZ];
 	smb_oplock_grant_t	f_oplock_grant;
+	boolean_t		f_lease;	/* opened under a lease */
+	uint8_t			f_lease_key[SMB_LEASE_KEY_SZ];
 } smb_ofile_t;
 
 typedef struct smb_fileinfo {
@@ -1483,6 +1491,8 @@ typedef struct open_param {
 	struct smb_sd	*sd;	/* for NTTransactCreate */
 	uint8_t		op_oplock_level;	/* requested/granted level */
 	boolean_t	op_oplock_levelII;	/* TRUE if levelII supported */
+	boolean_t	op_lease;		/* SMB2 lease requested */
+	uint8_t		op_lease_key[SMB_LEASE_KEY_SZ];
 } smb_arg_open_t;
 
 struct smb_async_req;
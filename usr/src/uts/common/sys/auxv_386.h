@@ -91,10 +91,11 @@ extern "C" {
 #define	AV_386_2_AVX2		0x00020	/* AVX2 insns */
 #define	AV_386_2_ADX		0x00040	/* ADX insns */
 #define	AV_386_2_RDSEED		0x00080	/* RDSEED insn */
+#define	AV_386_2_SHA		0x00100	/* SHA extensions */
 
 #define	FMT_AV_386_2							\
 	"\020"								\
-	"\10rdseed\07adx\06avx2\05fma\04bmi2\03bmi1\02rdrand\01f16c"
+	"\11sha\10rdseed\07adx\06avx2\05fma\04bmi2\03bmi1\02rdrand\01f16c"
 
 #ifdef __cplusplus
 }
@@ -51,7 +51,12 @@ extern "C" {
  *
  * 3) Fixed queue depth, for each device.  The adapter driver reports
  *    the queue depth at registration.  We don't have any form of
- *    dynamic flow control.
+ *    dynamic flow control.  Drivers for devices with several hardware
+ *    submission queues may also report how many they have (d_qcount);
+ *    each then gets d_qsize transfers, and every transfer carries the
+ *    number of the queue it was submitted on (x_qnum), chosen by the
+ *    submitting CPU.  The driver should send it to the matching hardware
+ *    queue.
  *
  * 4) Negligible power management support.  The framework does not support
  *    fine grained power management.  If the adapter driver wants to use
@@ -72,6 +77,13 @@ extern "C" {
  *    locking bay doors or mechanised media bays.  This could be
  *    added, but at present the only such interesting devices are
  *    covered by the SCSI disk driver.
+ *
+ * 9) Optional freeing of space (DKIOCFREE).  Drivers that can deallocate
+ *    blocks (o_free), or write zeroes without a data transfer (o_zero),
+ *    provide those entry points in a BD_OPS_VERSION_1 bd_ops_t.  These
+ *    transfers carry only x_blkno and x_nblks; blkdev never hands the
+ *    driver more than d_free_maxblks (or d_zero_maxblks) blocks at a
+ *    time, 0 meaning no limit.
  */
 
 typedef struct bd_handle *bd_handle_t;
@@ -93,6 +105,7 @@ struct bd_xfer {
 	unsigned		x_ndmac;
 	caddr_t			x_kaddr;
 	unsigned		x_flags;
+	unsigned		x_qnum;
 };
 
 #define	BD_XFER_POLL		(1U << 0)	/* no interrupts (dump) */
@@ -114,6 +127,9 @@ struct bd_drive {
 	char			*d_serial;
 	size_t			d_revision_len;
 	char			*d_revision;
+	uint32_t		d_qcount;
+	uint64_t		d_free_maxblks;
+	uint64_t		d_zero_maxblks;
 };
 
 struct bd_media {
@@ -149,9 +165,12 @@ struct bd_ops {
 	int	(*o_sync_cache)(void *, bd_xfer_t *);
 	int	(*o_read)(void *, bd_xfer_t *);
 	int	(*o_write)(void *, bd_xfer_t *);
+	int	(*o_free)(void *, bd_xfer_t *);
+	int	(*o_zero)(void *, bd_xfer_t *);
 };
 
 #define	BD_OPS_VERSION_0		0
+#define	BD_OPS_VERSION_1		1
 
 struct bd_errstats {
 	/* these are managed by blkdev itself */
@@ -162,7 +162,8 @@ typedef struct callout {
 #define	CALLOUT_BUCKETS		(1 << CALLOUT_BUCKET_SHIFT)
 #define	CALLOUT_BUCKET_MASK	(CALLOUT_BUCKETS - 1)
 #define	CALLOUT_HASH(x)		((x) & CALLOUT_BUCKET_MASK)
-#define	CALLOUT_IDHASH(x)	CALLOUT_HASH((x) >> CALLOUT_COUNTER_SHIFT)
+#define	CALLOUT_IDHASH(ct, x)	\
+		(((x) >> CALLOUT_COUNTER_SHIFT) & (ct)->ct_idhash_mask)
 /*
  * The multiply by 0 and 1 below are cosmetic. Just to align things better
  * and make it more readable. The multiplications will be done at compile
@@ -230,6 +231,8 @@ typedef struct callout_hash {
  *	Callout list is present in the callout heap.
  * CALLOUT_LIST_FLAG_QUEUED
  *	Callout list is present in the callout queue.
+ * CALLOUT_LIST_FLAG_WHEEL
+ *	Callout list is present in the callout wheel.
  */
 #define	CALLOUT_LIST_FLAG_FREE			0x1
 #define	CALLOUT_LIST_FLAG_ABSOLUTE		0x2
@@ -237,6 +240,7 @@ typedef struct callout_hash {
 #define	CALLOUT_LIST_FLAG_NANO			0x8
 #define	CALLOUT_LIST_FLAG_HEAPED		0x10
 #define	CALLOUT_LIST_FLAG_QUEUED		0x20
+#define	CALLOUT_LIST_FLAG_WHEEL			0x40
 
 struct callout_list {
 	callout_list_t	*cl_next;	/* next in clhash */
@@ -244,6 +248,9 @@ struct callout_list {
 	hrtime_t	cl_expiration;	/* expiration for callouts in list */
 	callout_hash_t	cl_callouts;	/* list of callouts */
 	int		cl_flags;	/* callout flags */
+	int		cl_wslot;	/* callout wheel slot */
+	callout_list_t	*cl_wnext;	/* next in callout wheel slot */
+	callout_list_t	*cl_wprev;	/* prev in callout wheel slot */
 };
 
 /*
@@ -265,6 +272,29 @@ typedef struct callout_heap {
 #endif
 } callout_heap_t;
 
+/*
+ * Callout wheel. Callout lists with a resolution of at least a clock tick
+ * that are neither absolute nor hrestime ones (which covers timeout() and
+ * most network timers) are kept in a hierarchical timer wheel instead of
+ * the heap, so that adding and removing them is constant time. Level 0
+ * has one slot per tick, and each slot of level n covers a whole turn of
+ * level n - 1. Lists further out than the last level can reach are kept
+ * in its farthest slot and go round again when it is cascaded.
+ */
+#define	CALLOUT_WHEEL_BITS	6
+#define	CALLOUT_WHEEL_SLOTS	(1 << CALLOUT_WHEEL_BITS)
+#define	CALLOUT_WHEEL_MASK	(CALLOUT_WHEEL_SLOTS - 1)
+#define	CALLOUT_WHEEL_LEVELS	4
+
+/*
+ * The ID hash starts out with CALLOUT_BUCKETS buckets and is grown by
+ * CALLOUT_IDHASH_GROW whenever there are more than CALLOUT_IDHASH_LOAD
+ * outstanding callouts per bucket, up to callout_idhash_max buckets.
+ */
+#define	CALLOUT_IDHASH_LOAD	2
+#define	CALLOUT_IDHASH_GROW	4
+#define	CALLOUT_IDHASH_MAX	(1 << 18)
+
 /*
  * When the heap contains too many empty callout lists, it needs to be
  * cleaned up. The decision to clean up the heap is a function of the
@@ -373,8 +403,15 @@ typedef struct callout_table {
 	taskq_t		*ct_taskq;	/* taskq to execute normal callouts */
 	kstat_t		*ct_kstats;	/* callout kstats */
 	int		ct_nreap;	/* # heap entries that need reaping */
+	uint_t		ct_idhash_mask;	/* ID hash buckets - 1 */
 	cyclic_id_t	ct_qcyclic;	/* cyclic for the callout queue */
 	callout_hash_t	ct_queue;	/* overflow queue of callouts */
+
+	cyclic_id_t	ct_wcyclic;	/* cyclic for the callout wheel */
+	callout_hash_t	*ct_wheel;	/* callout wheel slots */
+	int64_t		ct_wtick;	/* callout wheel time, in ticks */
+	hrtime_t	ct_wexp;	/* callout wheel cyclic expiration */
+	uint64_t	ct_wbits[CALLOUT_WHEEL_LEVELS]; /* non-empty slots */
 #ifndef _LP64
 	char		ct_pad[12];	/* cache alignment */
 #endif
@@ -61,6 +61,10 @@ extern "C" {
  *	Last CPU to do tick processing for.
  * ct_scan
  *	CPU to start the tick processing from. Rotated every tick.
+ * ct_steal
+ *	Steal time of this CPU when its ticks were last processed.
+ * ct_stolen
+ *	Steal time of this CPU not yet taken off its ticks.
  */
 typedef struct clock_tick_cpu {
 	kmutex_t		ct_lock;
@@ -70,6 +74,8 @@ typedef struct clock_tick_cpu {
 	int			ct_start;
 	int			ct_end;
 	int			ct_scan;
+	hrtime_t		ct_steal;
+	hrtime_t		ct_stolen;
 } clock_tick_cpu_t;
 
 /*
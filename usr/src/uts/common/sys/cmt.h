@@ -101,6 +101,7 @@ typedef struct cmt_lgrp {
 void		pg_cmt_load(cpu_t *, int);
 void		pg_cmt_cpu_startup(cpu_t *);
 int		pg_cmt_can_migrate(cpu_t *, cpu_t *);
+pghw_type_t	pg_cmt_share_hw(cpu_t *, cpu_t *);
 
 /*
  * CMT platform interfaces
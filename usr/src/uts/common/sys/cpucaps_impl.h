@@ -55,6 +55,19 @@ extern "C" {
 #endif
 
 
+/*
+ * Usage charged on a CPU is first taken from that CPU's budget for the cap,
+ * which is prepaid: it is added to cap_usage, a slice at a time, when the CPU
+ * takes it from the cap's headroom.  Threads of one project charging on
+ * different CPUs then mostly stay off cap_usagelock and its cache line.  A
+ * budget is only changed by its own CPU, at high PIL, and is padded to a
+ * cache line of its own.
+ */
+typedef struct cpucap_pcpu {
+	hrtime_t	cpc_budget;	/* prepaid usage left		*/
+	char		cpc_pad[64 - sizeof (hrtime_t)];
+} cpucap_pcpu_t;
+
 /*
  * Most of the per-project or per-zone state related to CPU caps is kept in the
  * cpucap_t structure.
@@ -69,12 +82,14 @@ typedef struct cpucap {
 	hrtime_t	cap_value;	/* scaled CPU usage cap		*/
 	hrtime_t	cap_usage;	/* current CPU usage		*/
 	disp_lock_t	cap_usagelock;	/* protects cap_usage above	*/
+	cpucap_pcpu_t	*cap_pcpu;	/* per-CPU budgets, max_ncpus	*/
 	/*
 	 * Per cap statistics.
 	 */
 	hrtime_t	cap_maxusage;	/* maximum cap usage		*/
 	u_longlong_t	cap_below;	/* # of ticks spend below the cap */
 	u_longlong_t	cap_above;	/* # of ticks spend above the cap */
+	u_longlong_t	cap_refill;	/* # of budgets taken		*/
 } cpucap_t;
 
 /*
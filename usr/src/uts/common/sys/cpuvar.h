@@ -719,6 +719,8 @@ extern void init_cpu_mstate(struct cpu *, int);
 extern void term_cpu_mstate(struct cpu *);
 extern void new_cpu_mstate(int, hrtime_t);
 extern void get_cpu_mstate(struct cpu *, hrtime_t *);
+extern hrtime_t (*cpu_steal_timef)(struct cpu *);
+extern hrtime_t cpu_steal_time(struct cpu *);
 extern void thread_nomigrate(void);
 extern void thread_allowmigrate(void);
 extern void weakbinding_stop(void);
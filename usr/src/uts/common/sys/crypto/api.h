@@ -43,12 +43,29 @@ typedef uint32_t crypto_call_flag_t;
 #define	CRYPTO_ALWAYS_QUEUE	0x00000001	/* ALWAYS queue the req. */
 #define	CRYPTO_NOTIFY_OPDONE	0x00000002	/* Notify intermediate steps */
 #define	CRYPTO_SKIP_REQID	0x00000004	/* Skip request ID generation */
+#define	CRYPTO_BATCH		0x00000008	/* Hold req in cr_batch */
+#define	CRYPTO_INLINE_OK	0x00000010	/* May run in caller */
+
+/*
+ * A batch of asynchronous requests.  A consumer submitting many requests
+ * in a row sets CRYPTO_BATCH (with CRYPTO_ALWAYS_QUEUE and
+ * CRYPTO_SKIP_REQID) and points cr_batch at one of these.  Requests which
+ * would be queued for the software provider threads are held in the batch
+ * instead, and crypto_batch_submit() queues them all at once.  The batch
+ * must start out zeroed and be submitted before it goes out of scope.
+ */
+typedef struct crypto_batch {
+	void			*cb_first;
+	void			*cb_last;
+	uint_t			cb_count;
+} crypto_batch_t;
 
 typedef struct {
 	crypto_call_flag_t	cr_flag;
 	void			(*cr_callback_func)(void *, int);
 	void			*cr_callback_arg;
 	crypto_req_id_t		cr_reqid;
+	crypto_batch_t		*cr_batch;	/* Only with CRYPTO_BATCH */
 } crypto_call_req_t;
 
 /*
@@ -335,6 +352,11 @@ extern int crypto_key_check(crypto_mechanism_t *mech, crypto_key_t *key);
 extern void crypto_cancel_req(crypto_req_id_t req);
 extern void crypto_cancel_ctx(crypto_context_t ctx);
 
+/*
+ * Queue all the asynchronous requests held in a batch.
+ */
+extern void crypto_batch_submit(crypto_batch_t *batch);
+
 /*
  * crypto_get_mech_list(9F) allocates and returns the list of currently
  * supported cryptographic mechanisms.
@@ -191,10 +191,11 @@ typedef struct kcf_areq_node {
 	boolean_t		an_isdual;	/* for internal reuse */
 
 	/*
-	 * Next and previous nodes in the global software
-	 * queue. These fields are NULL for a hardware
+	 * The software queue for this request, and the next and
+	 * previous nodes in it. These fields are NULL for a hardware
 	 * provider since we use a taskq there.
 	 */
+	struct kcf_swq		*an_swq;
 	struct kcf_areq_node	*an_next;
 	struct kcf_areq_node	*an_prev;
 
@@ -268,23 +269,38 @@ typedef struct kcf_reqid_table {
 } kcf_reqid_table_t;
 
 /*
- * Global software provider queue structure. Requests to be
- * handled by a SW provider and have the ALWAYS_QUEUE flag set
- * get queued here.
+ * Software provider queue structure. Requests to be handled by a
+ * SW provider and have the ALWAYS_QUEUE flag set get queued on the
+ * queue of the CPU they were submitted on, so that submitters on
+ * different CPUs do not contend for a lock or its cache line. The
+ * pool threads take requests from their own CPU's queue first, then
+ * from the others.
  */
+typedef struct kcf_swq {
+	kmutex_t		sq_lock;	/* protects the queue */
+	kcf_areq_node_t		*sq_first;
+	kcf_areq_node_t		*sq_last;
+	uint_t			sq_njobs;
+
+	uint8_t			sq_pad[64 - sizeof (kmutex_t) -
+	    2 * sizeof (kcf_areq_node_t *) - sizeof (uint_t)];
+} kcf_swq_t;
+
 typedef struct kcf_global_swq {
 	/*
-	 * gs_cv and gs_lock are used to wait for new requests.
-	 * gs_lock protects the changes to the queue.
+	 * gs_cv and gs_lock are used by idle pool threads to wait
+	 * for new requests. gs_lock protects none of the queues.
 	 */
 	kcondvar_t		gs_cv;
 	kmutex_t		gs_lock;
-	uint_t			gs_njobs;
-	uint_t			gs_maxjobs;
-	kcf_areq_node_t		*gs_first;
-	kcf_areq_node_t		*gs_last;
+	uint_t			gs_maxjobs;	/* limit for all the queues */
+	uint_t			gs_qmaxjobs;	/* limit for each queue */
+	uint_t			gs_nqueues;	/* max_ncpus */
+	kcf_swq_t		*gs_queues;	/* indexed by cpu_seqid */
 } kcf_global_swq_t;
 
+#define	KCF_SWQ_CPU()	(&gswq->gs_queues[CPU->cpu_seqid])
+
 
 /*
  * Internal representation of a canonical context. We contain crypto_ctx_t
@@ -456,6 +472,7 @@ extern int crypto_taskq_threads;
 extern int crypto_taskq_minalloc;
 extern int crypto_taskq_maxalloc;
 extern kcf_global_swq_t *gswq;
+extern uint_t kcf_swq_avail(void);
 extern int kcf_maxthreads;
 extern int kcf_minthreads;
 
@@ -34,7 +34,8 @@ extern "C" {
 #include <sys/types.h>
 
 /*
- * *** This interface is for private use by the IP stack only ***
+ * *** This interface is for private use by the IP stack, and (through
+ * *** dcopy_copy() below) by kernel copy paths only
  */
 
 /* Private dcopy/uioa interface for dcopy to enable/disable dcopy KAPI */
@@ -245,6 +246,30 @@ int dcopy_cmd_post(dcopy_cmd_t cmd);
 int dcopy_cmd_poll(dcopy_cmd_t cmd, int flags);
 
 
+/* dcopy_copy() completion callback; error is always 0 at present */
+typedef void (*dcopy_done_t)(void *arg, int error);
+
+/* dcopy_copy() flags */
+#define	DCOPY_COPY_NOFLAGS	(0)
+#define	DCOPY_COPY_IFBUSY	(1 << 0)
+
+/*
+ * dcopy_copy()
+ *   copy len bytes from src to dst, both kernel virtual addresses, with a
+ *   DMA engine. Copies smaller than dcopy_copy_min, copies from interrupt
+ *   context, and with DCOPY_COPY_IFBUSY copies while no other thread is
+ *   waiting for this CPU, are not offloaded.
+ *   if done == NULL, the copy has completed on return. Otherwise done is
+ *   called from a taskq once it has, and src and dst must remain valid
+ *   (and mapped) until then.
+ *   returns => DCOPY_SUCCESS, or DCOPY_FAILURE if the copy wasn't
+ *   offloaded, in which case nothing was copied, done won't be called,
+ *   and the caller has to copy the data itself.
+ */
+int dcopy_copy(const void *src, void *dst, size_t len, int flags,
+    dcopy_done_t done, void *arg);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -45,6 +45,7 @@
 #include <sys/id_space.h>
 #include <sys/modhash.h>
 #include <sys/bitset.h>
+#include <sys/taskq.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -229,6 +230,7 @@ struct dev_info  {
 	uint_t		devi_flags;		/* configuration flags */
 	int		devi_circular;		/* for recursive operations */
 	void		*devi_busy_thread;	/* thread operating on node */
+	taskq_t		*devi_busy_taskq;	/* taskq lent DEVI_BUSY */
 	void		*devi_taskq;		/* hotplug taskq */
 
 	/* device driver statistical and audit info */
@@ -615,7 +617,16 @@ struct dev_info  {
 
 #define	DEVI_BUSY_CHANGING(dip)	(DEVI(dip)->devi_flags & DEVI_BUSY)
 #define	DEVI_BUSY_OWNED(dip)	(DEVI_BUSY_CHANGING(dip) &&	\
-	((DEVI(dip))->devi_busy_thread == curthread))
+	((DEVI(dip))->devi_busy_thread == curthread ||		\
+	DEVI_BUSY_LENT(dip)))
+
+/*
+ * The thread that owns a busy node may lend it to the threads of a taskq
+ * that work on its behalf while it waits for them, as
+ * config_immediate_children() does to attach children in parallel.
+ */
+#define	DEVI_BUSY_LENT(dip)	(DEVI(dip)->devi_busy_taskq != NULL &&	\
+	taskq_member(DEVI(dip)->devi_busy_taskq, curthread))
 
 #define	DEVI_IS_PCI(dip)	(DEVI(dip)->devi_flags & DEVI_PCI_DEVICE)
 #define	DEVI_SET_PCI(dip)	(DEVI(dip)->devi_flags |= (DEVI_PCI_DEVICE))
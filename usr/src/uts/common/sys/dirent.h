@@ -93,6 +93,42 @@ typedef struct dirent64 {
  */
 #define	MAXGETDENTS_SIZE	(64 * 1024)
 
+/*
+ * Directory entry returned by getdentsattr(2), along with the attributes
+ * that fstatat(fd, da_name, AT_SYMLINK_NOFOLLOW) would report for it.  If
+ * those couldn't be had, because the entry was removed in the meantime
+ * for instance, da_error says why and the attribute fields are zero.
+ * The layout is the same for 32-bit and 64-bit callers; da_dev and
+ * da_rdev are in the caller's dev_t format.
+ */
+typedef struct direntattr {
+	uint64_t	da_ino;		/* "inode number" of entry */
+	uint64_t	da_off;		/* offset of the next entry */
+	uint64_t	da_dev;
+	uint64_t	da_rdev;
+	uint64_t	da_size;
+	uint64_t	da_blocks;
+	int64_t		da_atime_sec;
+	int64_t		da_atime_nsec;
+	int64_t		da_mtime_sec;
+	int64_t		da_mtime_nsec;
+	int64_t		da_ctime_sec;
+	int64_t		da_ctime_nsec;
+	uint32_t	da_mode;
+	uint32_t	da_nlink;
+	uint32_t	da_uid;
+	uint32_t	da_gid;
+	uint32_t	da_blksize;
+	int32_t		da_error;	/* errno if attributes are missing */
+	uint16_t	da_reclen;	/* length of this record */
+	char		da_name[1];	/* name of file */
+} direntattr_t;
+
+#if defined(_KERNEL)
+#define	DIRENTATTR_RECLEN(namelen)	\
+	((offsetof(direntattr_t, da_name[0]) + 1 + (namelen) + 7) & ~ 7)
+#endif
+
 #if !defined(_KERNEL)
 
 /*
@@ -122,6 +158,7 @@ typedef struct dirent64 {
 #endif	/* _LP64 && _LARGEFILE64_SOURCE */
 
 extern int getdents(int, struct dirent *, size_t);
+extern int getdentsattr(int, direntattr_t *, size_t);
 
 /* N.B.: transitional large file interface version deliberately not provided */
 
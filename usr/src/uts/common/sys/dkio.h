@@ -534,6 +534,7 @@ typedef struct dkioc_free_s {
 } dkioc_free_t;
 
 #define	DF_WAIT_SYNC	0x00000001	/* Wait for full write-out of free. */
+#define	DF_ZERO		0x00000002	/* Freed space must read as zeroes. */
 
 #ifdef	__cplusplus
 }
@@ -148,6 +148,11 @@ struct nc_stats {
 	kstat_named_t ncs_dir_finipurg;	/* fini purges */
 	kstat_named_t ncs_dir_rec_last;	/* reclaim last */
 	kstat_named_t ncs_dir_recl_any;	/* reclaim any */
+
+	/* lockless path walk stats */
+
+	kstat_named_t ncs_path_hits;	/* dnlc_lookup_path() resolved path */
+	kstat_named_t ncs_path_misses;	/* dnlc_lookup_path() gave up */
 };
 
 /*
@@ -178,10 +183,13 @@ extern int ncsize;		/* set in param_init() # of dnlc entries */
 extern vnode_t negative_cache_vnode;
 #define	DNLC_NO_VNODE &negative_cache_vnode
 
+struct pathname;
+
 void	dnlc_init(void);
 void	dnlc_enter(vnode_t *, const char *, vnode_t *);
 void	dnlc_update(vnode_t *, const char *, vnode_t *);
 vnode_t	*dnlc_lookup(vnode_t *, const char *);
+vnode_t	*dnlc_lookup_path(vnode_t *, struct pathname *, int);
 void	dnlc_purge(void);
 void	dnlc_purge_vp(vnode_t *);
 int	dnlc_purge_vfsp(vfs_t *, int);
@@ -861,9 +861,26 @@ typedef struct dtrace_difo {
 	uint_t dtdo_krelen;		/* length of krelo table */
 	uint_t dtdo_urelen;		/* length of urelo table */
 	uint_t dtdo_xlmlen;		/* length of translator table */
+#else
+	uint_t dtdo_fast;		/* fast path, if any (see below) */
+	uint_t dtdo_fastvar;		/* variable for DTRACE_DIFO_FAST_VAR */
+	uint_t dtdo_fastpc;		/* instruction that may fault */
+	uint64_t dtdo_fastval;		/* constant, or variable index */
 #endif
 } dtrace_difo_t;
 
+#ifdef _KERNEL
+/*
+ * Many DIF objects -- aggregation keys and action arguments, mostly -- do no
+ * more than return a constant or a built-in variable.  The kernel recognizes
+ * these when it takes a DIF object, and evaluates them without interpreting
+ * their text.
+ */
+#define	DTRACE_DIFO_FAST_NONE	0	/* interpret the text */
+#define	DTRACE_DIFO_FAST_CONST	1	/* return dtdo_fastval */
+#define	DTRACE_DIFO_FAST_VAR	2	/* return variable dtdo_fastvar */
+#endif
+
 /*
  * DTrace Enabling Description Structures
  *
@@ -427,7 +427,8 @@ typedef struct {
 
 /* Solaris ABI specific values */
 #define	SHT_LOOS		0x60000000	/* OS specific range */
-#define	SHT_LOSUNW		0x6fffffef
+#define	SHT_LOSUNW		0x6fffffee
+#define	SHT_SUNW_bloom		0x6fffffee
 #define	SHT_SUNW_capchain	0x6fffffef
 #define	SHT_SUNW_capinfo	0x6ffffff0
 #define	SHT_SUNW_symsort	0x6ffffff1
@@ -775,6 +776,28 @@ typedef	Elf64_Word	Elf64_Capchain;
  */
 #define	CAPINFO_SUNW_GLOB	0xff
 
+/*
+ *	Bloom filter (SHT_SUNW_bloom) entry.
+ *
+ *	A SHT_SUNW_bloom table accompanies the SHT_HASH table of a dynamic
+ *	object, and lets a symbol lookup reject most names that the object
+ *	doesn't define without walking the hash chains.  Entry 0 holds the
+ *	number of filter entries that follow, a power of 2, and entry 1 a
+ *	shift count.  Each symbol in the hash table sets two bits in the
+ *	filter entry selected by its ELF hash value h:
+ *
+ *	ent = filter[(h / BITS) & (nent - 1)]
+ *	bits = (1 << (h % BITS)) | (1 << ((h >> shift) % BITS))
+ *
+ *	where BITS is the number of bits in an entry.
+ */
+#ifndef	_ASM
+typedef	Elf32_Word	Elf32_Bloom;
+#if defined(_LP64) || defined(_LONGLONG_TYPE)
+typedef	Elf64_Xword	Elf64_Bloom;
+#endif
+#endif
+
 /*
  * Capabilities values.
  */
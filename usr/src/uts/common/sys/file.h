@@ -220,6 +220,7 @@ extern int f_setfd_error(int, int);
 extern void f_setfd(int, char);
 extern int f_getfl(int, int *);
 extern int f_badfd(int, int *, int);
+extern int f_closefrom(int);
 extern int fassign(struct vnode **, int, int *);
 extern void fcnt_add(uf_info_t *, int);
 extern void close_exec(uf_info_t *);
@@ -39,7 +39,11 @@ extern "C" {
  * tmpnode is the file system dependent node for tmpfs.
  *
  *	tn_rwlock protects access of the directory list at tn_dir
- *	as well as syncronizing read and writes to the tmpnode
+ *	as well as syncronizing read and writes to the tmpnode.
+ *	tn_dircursor, which records where the last readdir stopped,
+ *	is updated by readers of the list; it always points at an
+ *	entry on the list, and tdirdelete() moves it back an entry
+ *	if the entry it points at is removed.
  *
  *	tn_contents protects growing, shrinking, reading and writing
  *	the file along with tn_rwlock (see below).
@@ -71,6 +75,7 @@ struct tmpnode {
 		struct {
 			struct tdirent	*un_dirlist; /* dirent list */
 			uint_t	un_dirents;	/* number of dirents */
+			struct tdirent	*un_dircursor; /* readdir resume */
 		} un_dirstruct;
 		char 		*un_symlink;	/* pointer to symlink */
 		struct {
@@ -91,6 +96,7 @@ struct tmpnode {
 
 #define	tn_dir		un_tmpnode.un_dirstruct.un_dirlist
 #define	tn_dirents	un_tmpnode.un_dirstruct.un_dirents
+#define	tn_dircursor	un_tmpnode.un_dirstruct.un_dircursor
 #define	tn_symlink	un_tmpnode.un_symlink
 #define	tn_anon		un_tmpnode.un_anonstruct.un_anon
 #define	tn_asize	un_tmpnode.un_anonstruct.un_size
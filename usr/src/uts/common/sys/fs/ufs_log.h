@@ -117,7 +117,15 @@ typedef struct ic_extent_block {
 #define	LDL_CGSIZEREQ(fs) \
 	((fs)->fs_cgsize + ((fs)->fs_cgsize >> 1))
 
+/*
+ * Bounds on the size of the incore log buffers, which start out at the
+ * log's maxtransfer (see ldl_bufsize()).  Log I/O is issued in pieces
+ * of at most maxphys, so the buffers may be larger than that; raising
+ * ldl_minbufsize lets more deltas gather before the log has to wait
+ * for the device, up to ldl_maxbufsize.
+ */
 #define	LDL_MINBUFSIZE		(32 * 1024)
+#define	LDL_MAXBUFSIZE		(4 * 1024 * 1024)
 #define	LDL_USABLE_BSIZE	(DEV_BSIZE - sizeof (sect_trailer_t))
 #define	NB_LEFT_IN_SECTOR(off) 	(LDL_USABLE_BSIZE - ((off) - dbtob(btodb(off))))
 
@@ -349,7 +357,7 @@ enum maptypes	{
  * MAP
  */
 #define	DELTAMAP_NHASH	(512)
-#define	LOGMAP_NHASH	(2048)
+#define	LOGMAP_NHASH	(8192)	/* default for logmap_nhash */
 #define	MAP_INDEX(mof, mtm) \
 	(((mof) >> MAPBLOCKSHIFT) & (mtm->mtm_nhash-1))
 #define	MAP_HASH(mof, mtm) \
@@ -401,6 +409,9 @@ typedef struct mt_map {
 	long			mtm_wantin;
 	long			mtm_active;
 	long			mtm_activesync;
+	long			mtm_nsync;	/* sync ops in this moby */
+	long			mtm_lastnsync;	/* ... and in the last one */
+	int			mtm_gclinger;	/* committer awaits company */
 	ulong_t			mtm_dirty;
 	kmutex_t		mtm_lock;
 	kcondvar_t		mtm_cv_commit;
@@ -679,6 +690,7 @@ extern int ufs_crb_enable;
 
 extern uint_t topkey;
 extern uint32_t ufs_ncg_log;
+extern ulong_t logmap_nhash;
 
 extern uint_t lufs_debug;
 
@@ -159,6 +159,10 @@ typedef enum {
 	ZFS_PROP_REDUNDANT_METADATA,
 	ZFS_PROP_PREV_SNAP,
 	ZFS_PROP_RECEIVE_RESUME_TOKEN,
+	ZFS_PROP_SPECIAL_SMALL_BLOCKS,
+	ZFS_PROP_ARCQUOTA,
+	ZFS_PROP_ARCRESERVATION,
+	ZFS_PROP_DNODESIZE,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
@@ -204,6 +208,8 @@ typedef enum {
 	ZPOOL_PROP_FRAGMENTATION,
 	ZPOOL_PROP_LEAKED,
 	ZPOOL_PROP_MAXBLOCKSIZE,
+	ZPOOL_PROP_AUTOTRIM,
+	ZPOOL_PROP_DESTROYING,
 	ZPOOL_NUM_PROPS
 } zpool_prop_t;
 
@@ -360,6 +366,16 @@ typedef enum {
 	ZFS_REDUNDANT_METADATA_MOST
 } zfs_redundant_metadata_type_t;
 
+typedef enum {
+	ZFS_DNSIZE_LEGACY = 0,
+	ZFS_DNSIZE_AUTO = 1,
+	ZFS_DNSIZE_1K = 1024,
+	ZFS_DNSIZE_2K = 2048,
+	ZFS_DNSIZE_4K = 4096,
+	ZFS_DNSIZE_8K = 8192,
+	ZFS_DNSIZE_16K = 16384
+} zfs_dnsize_type_t;
+
 /*
  * On-disk version number.
  */
@@ -523,6 +539,7 @@ typedef struct zpool_rewind_policy {
 #define	ZPOOL_CONFIG_DTL		"DTL"
 #define	ZPOOL_CONFIG_SCAN_STATS		"scan_stats"	/* not stored on disk */
 #define	ZPOOL_CONFIG_VDEV_STATS		"vdev_stats"	/* not stored on disk */
+#define	ZPOOL_CONFIG_VDEV_STATS_EX	"vdev_stats_ex"	/* not stored on disk */
 #define	ZPOOL_CONFIG_WHOLE_DISK		"whole_disk"
 #define	ZPOOL_CONFIG_ERRCOUNT		"error_count"
 #define	ZPOOL_CONFIG_NOT_PRESENT	"not_present"
@@ -535,6 +552,7 @@ typedef struct zpool_rewind_policy {
 #define	ZPOOL_CONFIG_UNSPARE		"unspare"
 #define	ZPOOL_CONFIG_PHYS_PATH		"phys_path"
 #define	ZPOOL_CONFIG_IS_LOG		"is_log"
+#define	ZPOOL_CONFIG_ALLOCATION_BIAS	"alloc_bias"
 #define	ZPOOL_CONFIG_L2CACHE		"l2cache"
 #define	ZPOOL_CONFIG_HOLE_ARRAY		"hole_array"
 #define	ZPOOL_CONFIG_VDEV_CHILDREN	"vdev_children"
@@ -599,6 +617,12 @@ typedef struct zpool_rewind_policy {
 #define	VDEV_TYPE_LOG			"log"
 #define	VDEV_TYPE_L2CACHE		"l2cache"
 
+/*
+ * Allocation bias of a top-level vdev (ZPOOL_CONFIG_ALLOCATION_BIAS).
+ */
+#define	VDEV_ALLOC_BIAS_DEDUP		"dedup"
+#define	VDEV_ALLOC_BIAS_SPECIAL		"special"
+
 /*
  * This is needed in userland to report the minimum necessary device size.
  *
@@ -699,6 +723,22 @@ typedef enum zio_type {
 	ZIO_TYPES
 } zio_type_t;
 
+/*
+ * I/O priority classes used by the vdev queue.  Needed to interpret the
+ * extended vdev statistics below.
+ */
+typedef enum zio_priority {
+	ZIO_PRIORITY_SYNC_READ,
+	ZIO_PRIORITY_SYNC_WRITE,	/* ZIL */
+	ZIO_PRIORITY_ASYNC_READ,	/* prefetch */
+	ZIO_PRIORITY_ASYNC_WRITE,	/* spa_sync() */
+	ZIO_PRIORITY_SCRUB,		/* asynchronous scrub/resilver reads */
+	ZIO_PRIORITY_TRIM,		/* freeing space on the device */
+	ZIO_PRIORITY_NUM_QUEUEABLE,
+
+	ZIO_PRIORITY_NOW		/* non-queued i/os (e.g. free) */
+} zio_priority_t;
+
 /*
  * Pool statistics.  Note: all fields should be 64-bit because this
  * is passed between kernel and userland as an nvlist uint64 array.
@@ -753,6 +793,75 @@ typedef struct vdev_stat {
 	uint64_t	vs_fragmentation;	/* device fragmentation */
 } vdev_stat_t;
 
+/*
+ * Extended vdev statistics: queue depths and latency and request size
+ * histograms, kept by leaf vdevs and summed over the children of interior
+ * vdevs when requested.  Latency bucket i counts I/Os that took
+ * [2^i, 2^(i+1)) nanoseconds; request size bucket i counts I/Os of
+ * [2^i, 2^(i+1)) bytes.  The last bucket of each also holds everything
+ * larger.  As with vdev_stat_t, all fields must be 64-bit because this is
+ * passed between kernel and userland as an nvlist uint64 array.
+ */
+#define	VDEV_L_HISTO_BUCKETS	37	/* 1ns to ~68s */
+#define	VDEV_RQ_HISTO_BUCKETS	25	/* 1 byte to 16M */
+
+typedef struct vdev_stat_ex {
+	/* number of I/Os issued to the device, and waiting to be issued */
+	uint64_t vsx_active_queue[ZIO_PRIORITY_NUM_QUEUEABLE];
+	uint64_t vsx_pend_queue[ZIO_PRIORITY_NUM_QUEUEABLE];
+
+	/* time from entering the vdev queue to completion */
+	uint64_t vsx_total_histo[ZIO_TYPES][VDEV_L_HISTO_BUCKETS];
+
+	/* time spent waiting in the vdev queue */
+	uint64_t vsx_queue_histo[ZIO_PRIORITY_NUM_QUEUEABLE]
+	    [VDEV_L_HISTO_BUCKETS];
+
+	/* time from issue to the device until completion */
+	uint64_t vsx_disk_histo[ZIO_TYPES][VDEV_L_HISTO_BUCKETS];
+
+	/* sizes of I/Os issued individually, and of aggregated I/Os */
+	uint64_t vsx_ind_histo[ZIO_PRIORITY_NUM_QUEUEABLE]
+	    [VDEV_RQ_HISTO_BUCKETS];
+	uint64_t vsx_agg_histo[ZIO_PRIORITY_NUM_QUEUEABLE]
+	    [VDEV_RQ_HISTO_BUCKETS];
+} vdev_stat_ex_t;
+
+/*
+ * Slow I/O trace records, read from the raw kstat zfs:0:zio_trace.  A zio
+ * that takes longer than zio_trace_threshold_ms from zio_wait() or
+ * zio_nowait() to the end of zio_done() is recorded in a small ring kept
+ * by each CPU, where newer records overwrite older ones.  zit_stage_us[i]
+ * is when the zio first entered pipeline stage 1 << i (see enum zio_stage),
+ * in microseconds after zit_start; only the stages in zit_stages were run.
+ * The record is the same size for 32- and 64-bit readers.
+ */
+#define	ZIO_TRACE_STAGES	24
+
+typedef struct zio_trace_rec {
+	uint64_t	zit_pool_guid;
+	uint64_t	zit_vdev_guid;		/* 0 if not a vdev I/O */
+	hrtime_t	zit_start;		/* when the zio was started */
+	hrtime_t	zit_total;		/* start to completion */
+	hrtime_t	zit_taskq;		/* waiting in zio taskqs */
+	hrtime_t	zit_vqueue;		/* waiting in the vdev queue */
+	hrtime_t	zit_device;		/* issue to device completion */
+	uint64_t	zit_offset;
+	uint64_t	zit_size;
+	uint64_t	zit_objset;		/* the zio's bookmark */
+	uint64_t	zit_object;
+	int64_t		zit_level;
+	uint64_t	zit_blkid;
+	uint32_t	zit_stages;		/* mask of stages run */
+	uint32_t	zit_stage_us[ZIO_TRACE_STAGES];
+	int32_t		zit_error;
+	uint32_t	zit_cpu;		/* CPU that completed it */
+	uint8_t		zit_type;		/* zio_type_t */
+	uint8_t		zit_priority;		/* zio_priority_t */
+	uint8_t		zit_child;		/* enum zio_child */
+	uint8_t		zit_pad;
+} zio_trace_rec_t;
+
 /*
  * DDT statistics.  Note: all fields should be 64-bit because this
  * is passed between kernel and userland as an nvlist uint64 array.
@@ -873,6 +982,8 @@ typedef enum zfs_ioc {
 	ZFS_IOC_BOOKMARK,
 	ZFS_IOC_GET_BOOKMARKS,
 	ZFS_IOC_DESTROY_BOOKMARKS,
+	ZFS_IOC_POOL_TRIM,
+	ZFS_IOC_LIST,
 	ZFS_IOC_LAST
 } zfs_ioc_t;
 
@@ -122,6 +122,9 @@ typedef struct fssproc {
 	uchar_t fss_flags;	/* flags defined below			*/
 	int	fss_timeleft;	/* time remaining in procs quantum	*/
 	uint32_t fss_ticks;	/* ticks accumulated by this thread	*/
+	uint32_t fss_pticks;	/* nice-weighted ticks not yet charged	*/
+				/* to the project			*/
+	uint32_t fss_ptick_cnt;	/* raw ticks not yet charged		*/
 	pri_t	fss_upri;	/* user supplied priority (to priocntl)	*/
 	pri_t	fss_uprilim;	/* user priority limit			*/
 	pri_t	fss_umdpri;	/* user mode priority within fs class	*/
@@ -523,6 +523,8 @@ uint32_t idm_cid_alloc(void);
 
 void idm_cid_free(uint32_t cid);
 
+void idm_crc32c_init(void);
+
 uint32_t idm_crc32c(void *address, unsigned long length);
 
 uint32_t idm_crc32c_continued(void *address, unsigned long length,
@@ -0,0 +1,129 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Header file to support the ioring facility, a pair of queues shared
+ * between a process and the kernel through which batches of I/O requests
+ * can be submitted, and their results collected, without a system call per
+ * request.
+ *
+ * The region mapped from the ring descriptor starts with an ioring_hdr_t,
+ * followed by the submission queue (an array of ioring_sqe_t) at offset
+ * ir_sq_off and the completion queue (an array of ioring_cqe_t) at offset
+ * ir_cq_off.  The application fills in submission entries and advances
+ * ir_sq_tail; IORING_IOC_ENTER consumes them and advances ir_sq_head.  The
+ * kernel fills in completion entries and advances ir_cq_tail; the
+ * application consumes them and advances ir_cq_head.  Indices run freely
+ * and are masked with the corresponding ir_*_mask to find a slot.
+ */
+
+#ifndef _SYS_IORING_H
+#define	_SYS_IORING_H
+
+#include <sys/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Operations.
+ */
+#define	IORING_OP_NOP		0
+#define	IORING_OP_READ		1	/* pread(fd, addr, len, off) */
+#define	IORING_OP_WRITE		2	/* pwrite(fd, addr, len, off) */
+#define	IORING_OP_FSYNC		3	/* fsync(fd) or fdatasync(fd) */
+#define	IORING_OP_SENDMSG	4	/* send(fd, addr, len, opflags) */
+#define	IORING_OP_RECVMSG	5	/* recv(fd, addr, len, opflags) */
+#define	IORING_OP_ACCEPT	6	/* accept4(fd, NULL, NULL, opflags) */
+#define	IORING_OP_MAX		7
+
+/*
+ * Values for sqe_opflags with IORING_OP_FSYNC; the other operations take
+ * MSG_* or SOCK_* flags there, as noted above.
+ */
+#define	IORING_FSYNC_DATASYNC	0x1
+
+typedef struct ioring_sqe {
+	uint8_t		sqe_op;		/* IORING_OP_* */
+	uint8_t		sqe_flags;	/* reserved; must be zero */
+	uint16_t	sqe_pad;
+	int32_t		sqe_fd;		/* file descriptor */
+	uint64_t	sqe_off;	/* file offset */
+	uint64_t	sqe_addr;	/* buffer address */
+	uint32_t	sqe_len;	/* buffer length */
+	uint32_t	sqe_opflags;	/* operation-specific flags */
+	uint64_t	sqe_user_data;	/* returned in the completion */
+} ioring_sqe_t;
+
+typedef struct ioring_cqe {
+	uint64_t	cqe_user_data;	/* from the submission */
+	int32_t		cqe_res;	/* result, or negated errno */
+	uint32_t	cqe_flags;	/* reserved */
+} ioring_cqe_t;
+
+typedef struct ioring_hdr {
+	volatile uint32_t ir_sq_head;	/* next entry the kernel consumes */
+	volatile uint32_t ir_sq_tail;	/* next entry the app fills in */
+	uint32_t	ir_sq_mask;
+	uint32_t	ir_sq_entries;
+	volatile uint32_t ir_cq_head;	/* next entry the app consumes */
+	volatile uint32_t ir_cq_tail;	/* next entry the kernel fills in */
+	uint32_t	ir_cq_mask;
+	uint32_t	ir_cq_entries;
+	volatile uint32_t ir_cq_overflow; /* times completions were held */
+	uint32_t	ir_sq_off;	/* offset of the submission queue */
+	uint32_t	ir_cq_off;	/* offset of the completion queue */
+	uint32_t	ir_pad;
+} ioring_hdr_t;
+
+typedef struct ioring_params {
+	uint32_t	irp_sq_entries;	/* in: requested; out: actual */
+	uint32_t	irp_cq_entries;	/* in: requested or 0; out: actual */
+	uint32_t	irp_nthreads;	/* in: workers, or 0 for the default */
+	uint32_t	irp_flags;	/* reserved; must be zero */
+	uint64_t	irp_size;	/* out: length to mmap */
+} ioring_params_t;
+
+typedef struct ioring_enter {
+	uint32_t	ire_to_submit;	/* entries to consume from the SQ */
+	uint32_t	ire_min_complete; /* completions to wait for */
+	uint32_t	ire_flags;	/* reserved; must be zero */
+	uint32_t	ire_submitted;	/* out: entries consumed */
+} ioring_enter_t;
+
+#define	IORING_MAX_ENTRIES	4096
+
+/*
+ * As with eventfd, the ioctl values are specific to the native
+ * implementation; applications should use the library interfaces.
+ */
+#define	IORINGIOC		(('i' << 24) | ('o' << 16) | ('r' << 8))
+#define	IORINGIOC_SETUP		(IORINGIOC | 1)	/* ioring_params_t */
+#define	IORINGIOC_ENTER		(IORINGIOC | 2)	/* ioring_enter_t */
+
+#ifndef _KERNEL
+
+extern int ioring_setup(ioring_params_t *);
+extern int ioring_enter(int, uint_t, uint_t, uint_t);
+
+#else
+
+#define	IORINGMNRN_IORING	0
+#define	IORINGMNRN_CLONE	1
+
+#endif /* _KERNEL */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_IORING_H */
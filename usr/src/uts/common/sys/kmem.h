@@ -127,6 +127,8 @@ extern void kmem_cache_set_move(kmem_cache_t *,
 extern void kmem_cache_destroy(kmem_cache_t *);
 extern void *kmem_cache_alloc(kmem_cache_t *, int);
 extern void kmem_cache_free(kmem_cache_t *, void *);
+extern size_t kmem_cache_alloc_batch(kmem_cache_t *, void **, size_t, int);
+extern void kmem_cache_free_batch(kmem_cache_t *, void **, size_t);
 extern uint64_t kmem_cache_stat(kmem_cache_t *, char *);
 extern void kmem_cache_reap_now(kmem_cache_t *);
 extern void kmem_cache_move_notify(kmem_cache_t *, void *);
@@ -230,6 +230,7 @@ typedef struct kmem_slab {
 	uint32_t		slab_stuck_offset; /* unmoved buffer offset */
 	uint16_t		slab_later_count; /* cf KMEM_CBRC_LATER */
 	uint16_t		slab_flags;	/* bits to mark the slab */
+	lgrp_id_t		slab_lgrpid;	/* lgroup of slab memory */
 } kmem_slab_t;
 
 #define	KMEM_HASH_INITIAL	64
@@ -282,7 +283,11 @@ typedef struct kmem_cpu_cache {
 } kmem_cpu_cache_t;
 
 /*
- * The magazine lists used in the depot.
+ * The magazine lists used in the depot.  On machines with more than one
+ * lgroup, each cache also keeps a short list of full magazines per lgroup
+ * (cache_lgrp_full[], indexed by lgroup ID) in front of cache_full, so that
+ * a magazine freed on one lgroup is preferentially reloaded there.  These
+ * lists are protected by cache_depot_lock like the rest of the depot.
  */
 typedef struct kmem_maglist {
 	kmem_magazine_t	*ml_list;	/* magazine list */
@@ -348,6 +353,8 @@ struct kmem_cache {
 	uint64_t	cache_lookup_depth;	/* hash lookup depth */
 	uint64_t	cache_depot_contention;	/* mutex contention count */
 	uint64_t	cache_depot_contention_prev; /* previous snapshot */
+	uint64_t	cache_slab_alloc_local;	/* allocs from local slabs */
+	uint64_t	cache_slab_alloc_remote; /* allocs from remote slabs */
 
 	/*
 	 * Cache properties
@@ -399,6 +406,7 @@ struct kmem_cache {
 	kmem_magtype_t	*cache_magtype;		/* magazine type */
 	kmem_maglist_t	cache_full;		/* full magazines */
 	kmem_maglist_t	cache_empty;		/* empty magazines */
+	kmem_maglist_t	*cache_lgrp_full;	/* per-lgroup full magazines */
 	void		*cache_dumpfreelist;	/* heap during crash dump */
 	void		*cache_dumplog;		/* log entry during dump */
 
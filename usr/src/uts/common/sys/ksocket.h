@@ -79,6 +79,12 @@ typedef struct ksocket_callbacks {
 	ksocket_callback_t	ksock_cb_error;
 } ksocket_callbacks_t;
 
+/*
+ * A kernel consumer of a socket's data; see ksocket_krecv_set().
+ */
+typedef	void (*ksocket_krecv_f)(ksocket_t, mblk_t *, size_t, int,
+    void *);
+
 #define	KSOCKET_SLEEP	SOCKET_SLEEP
 #define	KSOCKET_NOSLEEP	SOCKET_NOSLEEP
 
@@ -117,6 +123,7 @@ extern int	ksocket_ioctl(ksocket_t, int, intptr_t, int *, struct cred *);
 extern int	ksocket_spoll(ksocket_t, int, short, short *, struct cred *);
 extern int	ksocket_setcallbacks(ksocket_t, ksocket_callbacks_t *, void *,
 		    struct cred *);
+extern int	ksocket_krecv_set(ksocket_t, ksocket_krecv_f, void *);
 extern int 	ksocket_close(ksocket_t, struct cred *);
 extern void	ksocket_hold(ksocket_t);
 extern void	ksocket_rele(ksocket_t);
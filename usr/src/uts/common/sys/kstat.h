@@ -50,6 +50,7 @@ typedef int	kid_t;		/* unique kstat id */
 #define	KSTAT_IOC_CHAIN_ID	KSTAT_IOC_BASE | 0x01
 #define	KSTAT_IOC_READ		KSTAT_IOC_BASE | 0x02
 #define	KSTAT_IOC_WRITE		KSTAT_IOC_BASE | 0x03
+#define	KSTAT_IOC_READV		KSTAT_IOC_BASE | 0x04
 
 /*
  * /dev/kstat ioctl usage (kd denotes /dev/kstat descriptor):
@@ -57,8 +58,19 @@ typedef int	kid_t;		/* unique kstat id */
  *	kcid = ioctl(kd, KSTAT_IOC_CHAIN_ID, NULL);
  *	kcid = ioctl(kd, KSTAT_IOC_READ, kstat_t *);
  *	kcid = ioctl(kd, KSTAT_IOC_WRITE, kstat_t *);
+ *	kcid = ioctl(kd, KSTAT_IOC_READV, kstat_readv_t *);
+ *
+ * KSTAT_IOC_READV performs a KSTAT_IOC_READ of each of kr_nksps kstats,
+ * storing the error from each (or 0) in the corresponding kr_errors[]
+ * element; it fails only if the request itself cannot be read.
  */
 
+typedef struct kstat_readv {
+	struct kstat	**kr_ksps;	/* kstats to read */
+	int		*kr_errors;	/* per-kstat errors */
+	uint_t		kr_nksps;	/* number of kstats */
+} kstat_readv_t;
+
 #define	KSTAT_STRLEN	31	/* 30 chars + NULL; must be 16 * n - 1 */
 
 /*
@@ -123,6 +135,12 @@ typedef struct kstat32 {
 	caddr32_t	_ks_lock;
 } kstat32_t;
 
+typedef struct kstat_readv32 {
+	caddr32_t	kr_ksps;
+	caddr32_t	kr_errors;
+	uint32_t	kr_nksps;
+} kstat_readv32_t;
+
 #endif	/* _SYSCALL32 */
 
 /*
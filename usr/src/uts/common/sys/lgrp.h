@@ -40,7 +40,9 @@ extern "C" {
 #define	LGRP_NONE	(-1)		/* non-existent lgroup ID */
 
 #if (!defined(_KERNEL) && !defined(_KMEMUSER))
-typedef struct lgrp_mem_policy_info { int opaque[2]; }	lgrp_mem_policy_info_t;
+typedef struct lgrp_mem_policy_info {
+	uint64_t	opaque[2];
+} lgrp_mem_policy_info_t;
 #endif	/* !_KERNEL && !_KMEMUSER */
 
 #if (defined(_KERNEL) || defined(_KMEMUSER))
@@ -329,7 +331,7 @@ typedef enum lgrp_mem_policy {
 	LGRP_MEM_POLICY_RANDOM_PROC,	/* randomly across process */
 	LGRP_MEM_POLICY_RANDOM_PSET,	/* randomly across processor set */
 	LGRP_MEM_POLICY_RANDOM,		/* randomly across all lgroups */
-	LGRP_MEM_POLICY_ROUNDROBIN,	/* round robin across all lgroups */
+	LGRP_MEM_POLICY_ROUNDROBIN,	/* round robin across lgroups */
 	LGRP_MEM_POLICY_NEXT_CPU,	/* Near next CPU to touch memory */
 	LGRP_MEM_POLICY_NEXT_SEG,	/* lgrp specified directly by seg */
 	LGRP_NUM_MEM_POLICIES
@@ -362,6 +364,7 @@ typedef struct lgrp_mnode_cookie {
 typedef struct lgrp_mem_policy_info {
 	int		mem_policy;		/* memory allocation policy */
 	lgrp_id_t	mem_lgrpid;		/* lgroup id */
+	klgrpset_t	mem_lgrpset;		/* lgroups for ROUNDROBIN */
 } lgrp_mem_policy_info_t;
 
 /*
@@ -569,6 +572,8 @@ lgrp_mem_policy_info_t	*lgrp_shm_policy_get(struct anon_map *, ulong_t,
     vnode_t *, u_offset_t);
 int	lgrp_shm_policy_set(lgrp_mem_policy_t, struct anon_map *, ulong_t,
     vnode_t *, u_offset_t, size_t);
+int	lgrp_shm_policy_set_lgrps(lgrp_mem_policy_t, klgrpset_t,
+    struct anon_map *, ulong_t, vnode_t *, u_offset_t, size_t);
 
 /*
  * Used by numat driver
@@ -159,6 +159,7 @@ typedef struct {
 						/*	that produced object */
 #define	DT_SUNW_CAPCHAINENT	0x6000001d	/* capabilities chain entry */
 #define	DT_SUNW_CAPCHAINSZ	0x6000001f	/* capabilities chain size */
+#define	DT_SUNW_BLOOM		0x60000020	/* symbol hash bloom filter */
 
 /*
  * DT_* encoding rules do not apply between DT_HIOS and DT_LOPROC
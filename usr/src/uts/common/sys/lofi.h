@@ -35,6 +35,7 @@
 #include <sys/dkio.h>
 #include <sys/vnode.h>
 #include <sys/list.h>
+#include <sys/avl.h>
 #include <sys/crypto/api.h>
 #include <sys/zone.h>
 #ifdef _KERNEL
@@ -205,12 +206,17 @@ struct lofi_ioctl {
  *
  * To avoid that we have to decompress data of a compressed
  * segment multiple times when accessing parts of the segment's
- * data we cache the uncompressed data, using a simple linked list.
+ * data we cache the uncompressed data.  Entries are looked up by
+ * segment index in an AVL tree and kept on a list in LRU order.
+ * Readers copy out of an entry without holding the cache lock;
+ * lc_refcnt keeps it from being evicted meanwhile.
  */
 struct lofi_comp_cache {
-	list_node_t	lc_list;		/* linked list */
+	list_node_t	lc_list;		/* LRU list */
+	avl_node_t	lc_avl;			/* tree by segment index */
 	uchar_t		*lc_data;		/* decompressed segment data */
 	uint64_t	lc_index;		/* segment index */
+	uint32_t	lc_refcnt;		/* readers copying lc_data */
 };
 
 #define	V_ISLOFIABLE(vtype) \
@@ -291,9 +297,12 @@ struct lofi_state {
 	struct compbuf	*ls_comp_bufs;
 
 	/* lock and anchor for compressed segment caching */
-	kmutex_t	ls_comp_cache_lock;	/* protects ls_comp_cache */
+	kmutex_t	ls_comp_cache_lock;	/* protects ls_comp_cache* */
 	list_t		ls_comp_cache;		/* cached decompressed segs */
+	avl_tree_t	ls_comp_cache_tree;	/* same, by segment index */
 	uint32_t	ls_comp_cache_count;
+	uint64_t	ls_comp_ra_next;	/* next segment to read ahead */
+	uint32_t	ls_comp_ra_pending;	/* read-aheads in progress */
 
 	/* the following fields are required for encryption support */
 	boolean_t		ls_crypto_enabled;
@@ -331,6 +340,7 @@ enum lofi_compress {
 	LOFI_COMPRESS_GZIP_6 = 1,
 	LOFI_COMPRESS_GZIP_9 = 2,
 	LOFI_COMPRESS_LZMA = 3,
+	LOFI_COMPRESS_LZ4 = 4,
 	LOFI_COMPRESS_FUNCTIONS
 };
 
@@ -223,6 +223,7 @@ typedef enum {
 	MAC_PROP_EN_2500FDX_CAP,
 	MAC_PROP_ADV_5000FDX_CAP,
 	MAC_PROP_EN_5000FDX_CAP,
+	MAC_PROP_LRO,
 	MAC_PROP_PRIVATE = -1
 } mac_prop_id_t;
 
@@ -390,6 +391,8 @@ typedef enum {
 
 typedef	int	(*mac_intr_enable_t)(mac_intr_handle_t);
 typedef	int	(*mac_intr_disable_t)(mac_intr_handle_t);
+typedef	void	*(*mac_rx_steer_t)(void *, processorid_t, uint32_t, uint32_t,
+		    uint32_t);
 
 typedef	struct mac_intr_s {
 	mac_intr_handle_t	mi_handle;
@@ -411,6 +414,11 @@ typedef struct mac_rx_fifo_s {
 	 * and get a squeue assigned on that CPU.
 	 */
 	uint_t			mrf_cpu_id;
+	/*
+	 * Move a TCP flow to the soft ring, of the same set as this one,
+	 * that is processed on a given CPU.  See mac_soft_ring_steer().
+	 */
+	mac_rx_steer_t		mrf_steer;
 } mac_rx_fifo_t;
 
 #define	mrf_intr_handle		mrf_intr.mi_handle
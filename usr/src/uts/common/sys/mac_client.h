@@ -49,11 +49,19 @@ extern "C" {
 typedef struct __mac_client_handle *mac_client_handle_t;
 typedef struct __mac_unicast_handle *mac_unicast_handle_t;
 typedef struct __mac_promisc_handle *mac_promisc_handle_t;
+typedef struct __mac_rx_hook_handle *mac_rx_hook_handle_t;
 typedef struct __mac_perim_handle *mac_perim_handle_t;
 typedef uintptr_t mac_tx_cookie_t;
 
 typedef void (*mac_tx_notify_t)(void *, mac_tx_cookie_t);
 
+/*
+ * An early receive hook is handed each inbound packet chain of a MAC before
+ * any promiscuous dispatch or classification takes place. It returns the
+ * chain of packets that should continue up the stack and frees the rest.
+ */
+typedef mblk_t *(*mac_rx_hook_t)(void *, mblk_t *);
+
 typedef enum {
 	MAC_DIAG_NONE,
 	MAC_DIAG_MACADDR_NIC,
@@ -150,6 +158,9 @@ extern void mac_promisc_remove(mac_promisc_handle_t);
 extern mac_notify_handle_t mac_notify_add(mac_handle_t, mac_notify_t, void *);
 extern int mac_notify_remove(mac_notify_handle_t, boolean_t);
 extern void mac_notify_remove_wait(mac_handle_t);
+extern mac_rx_hook_handle_t mac_rx_hook_add(mac_handle_t, mac_rx_hook_t,
+    void *);
+extern void mac_rx_hook_remove(mac_rx_hook_handle_t);
 extern int mac_rename_primary(mac_handle_t, const char *);
 extern	char *mac_client_name(mac_client_handle_t);
 
@@ -337,6 +337,7 @@ extern void mac_client_init(void);
 extern void mac_client_fini(void);
 extern void mac_promisc_dispatch(mac_impl_t *, mblk_t *,
     mac_client_impl_t *);
+extern mblk_t *mac_rx_hook_dispatch(mac_impl_t *, mblk_t *);
 
 extern int mac_validate_props(mac_impl_t *, mac_resource_props_t *);
 
@@ -93,6 +93,7 @@ typedef	struct mac_chain_s {
 #define	MCB_CONDEMNED		0x1		/* Logically deleted */
 #define	MCB_NOTIFY_CB_T		0x2
 #define	MCB_TX_NOTIFY_CB_T	0x4
+#define	MCB_RX_HOOK_CB_T	0x8
 
 extern boolean_t	mac_tx_serialize;
 
@@ -117,6 +118,13 @@ typedef struct mac_notify_cb_s {
 	struct mac_impl_s *mncb_mip;
 } mac_notify_cb_t;
 
+typedef struct mac_rx_hook_cb_s {
+	mac_cb_t	mrhcb_link;		/* Linked list of callbacks */
+	mac_rx_hook_t	mrhcb_fn;		/* hook function */
+	void		*mrhcb_arg;		/* hook argument */
+	struct mac_impl_s *mrhcb_mip;
+} mac_rx_hook_cb_t;
+
 /*
  * mac_callback_add(listinfo, listhead, listelement)
  * mac_callback_remove(listinfo, listhead, listelement)
@@ -518,6 +526,11 @@ struct mac_impl_s {
 	mac_cb_t		*mi_promisc_list;	/* mi_promisc_lock */
 	mac_cb_info_t		mi_promisc_cb_info;	/* mi_promisc_lock */
 
+	/* early receive hooks, run before promiscuous dispatch */
+	kmutex_t		mi_rx_hook_lock;
+	mac_cb_t		*mi_rx_hook_list;	/* mi_rx_hook_lock */
+	mac_cb_info_t		mi_rx_hook_cb_info;	/* mi_rx_hook_lock */
+
 	/* cache of rings over this mac_impl */
 	kmutex_t		mi_ring_lock;
 	mac_ring_t		*mi_ring_freelist;	/* mi_ring_lock */
@@ -559,6 +572,12 @@ struct mac_impl_s {
 	uint32_t		mi_llimit;
 	uint32_t		mi_ldecay;
 
+	/*
+	 * Coalesce received TCP segments in the soft rings (the "lro" link
+	 * property).  Read without a lock on the data path.
+	 */
+	uint32_t		mi_lro;
+
 /* This should be the last block in this structure */
 #ifdef DEBUG
 #define	MAC_PERIM_STACK_DEPTH	15
@@ -121,6 +121,7 @@ struct mac_soft_ring_s {
 	mac_soft_ring_drain_func_t s_ring_drain_func;
 
 	mac_tx_stats_t	s_st_stat;
+	mac_lro_stats_t	s_ring_lro_stat;
 };
 
 typedef void (*mac_srs_drain_proc_t)(mac_soft_ring_set_t *, uint_t);
@@ -334,6 +335,14 @@ struct mac_soft_ring_set_s {
 	mac_soft_ring_t	**srs_tx_soft_rings;
 	int		srs_tx_ring_count;
 
+	/*
+	 * Receive flow steering: for each TCP flow hash (modulo
+	 * MAC_STEER_SIZE), one more than the index of the TCP soft ring
+	 * the flow's consumer asked for, or 0.  Allocated on first use by
+	 * mac_soft_ring_steer() and read without locks.
+	 */
+	uint8_t		*srs_steer;
+
 	/*
 	 * Bandwidth control related members.
 	 * They are common to both Rx- and Tx-side.
@@ -382,6 +391,8 @@ struct mac_soft_ring_set_s {
 	kstat_t		*srs_ksp;
 };
 
+#define	MAC_STEER_SIZE	4096
+
 /*
  * type flags - combination allowed to process and drain the queue
  */
@@ -693,6 +704,8 @@ extern void mac_client_update_classifier(mac_client_impl_t *, boolean_t);
 
 extern void mac_soft_ring_intr_enable(void *);
 extern boolean_t mac_soft_ring_intr_disable(void *);
+extern void *mac_soft_ring_steer(void *, processorid_t, uint32_t, uint32_t,
+    uint32_t);
 extern mac_soft_ring_t *mac_soft_ring_create(int, clock_t, uint16_t,
     pri_t, mac_client_impl_t *, mac_soft_ring_set_t *,
     processorid_t, mac_direct_rx_t, void *, mac_resource_handle_t);
@@ -70,6 +70,20 @@ typedef struct mac_tx_stats_s {
 	uint64_t	mts_sdrops;
 } mac_tx_stats_t;
 
+/*
+ * Receive coalescing on a TCP soft ring.  Every packet that is held for
+ * merging is eventually passed on for exactly one of the flush reasons.
+ */
+typedef struct mac_lro_stats_s {
+	uint64_t	mls_merged;	/* segments merged into another */
+	uint64_t	mls_flush_seq;	/* next segment out of order */
+	uint64_t	mls_flush_hdr;	/* next segment's header differs */
+	uint64_t	mls_flush_push;	/* segment had PSH set */
+	uint64_t	mls_flush_size;	/* packet reached the size limit */
+	uint64_t	mls_flush_evict; /* too many flows in the batch */
+	uint64_t	mls_flush_end;	/* end of the batch */
+} mac_lro_stats_t;
+
 typedef struct mac_misc_stats_s {
 	uint64_t	mms_multircv;
 	uint64_t	mms_brdcstrcv;
@@ -107,6 +121,8 @@ extern void	mac_srs_stat_create(struct mac_soft_ring_set_s *);
 extern void 	mac_srs_stat_delete(struct mac_soft_ring_set_s *);
 extern void	mac_tx_srs_stat_recreate(struct mac_soft_ring_set_s *,
 		    boolean_t);
+extern void	mac_tx_srs_stats_get(struct mac_soft_ring_set_s *,
+		    mac_tx_stats_t *);
 
 extern void	mac_soft_ring_stat_create(struct mac_soft_ring_s *);
 extern void	mac_soft_ring_stat_delete(struct mac_soft_ring_s *);
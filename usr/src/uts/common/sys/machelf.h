@@ -92,6 +92,7 @@ typedef	Elf64_Move	Move;
 typedef	Elf64_Cap	Cap;
 typedef	Elf64_Capinfo	Capinfo;
 typedef	Elf64_Capchain	Capchain;
+typedef	Elf64_Bloom	Bloom;
 #endif	/* _ASM */
 
 #else	/* _ILP32 */
@@ -139,6 +140,7 @@ typedef	Elf32_Move	Move;
 typedef	Elf32_Cap	Cap;
 typedef	Elf32_Capinfo	Capinfo;
 typedef	Elf32_Capchain	Capchain;
+typedef	Elf32_Bloom	Bloom;
 #endif	/* _ASM */
 
 #endif	/* _ILP32 */
@@ -83,6 +83,7 @@ extern "C" {
 #define	MNTOPT_PORT	"port"		/* NFS server IP port number */
 #define	MNTOPT_SECURE	"secure"	/* Secure (AUTH_DES) mounting */
 #define	MNTOPT_RSIZE	"rsize"		/* Max NFS read size (bytes) */
+#define	MNTOPT_NCONNECT	"nconnect"	/* NFS connections per server */
 #define	MNTOPT_WSIZE	"wsize"		/* Max NFS write size (bytes) */
 #define	MNTOPT_TIMEO	"timeo"		/* NFS timeout (1/10 sec) */
 #define	MNTOPT_RETRANS	"retrans"	/* Max retransmissions (soft mnts) */
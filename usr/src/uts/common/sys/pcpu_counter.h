@@ -0,0 +1,76 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_SYS_PCPU_COUNTER_H
+#define	_SYS_PCPU_COUNTER_H
+
+/*
+ * Per-CPU statistics counters.
+ *
+ * A pcpu_counter_t is a set of 64-bit counters with a private copy for
+ * each possible CPU, each copy on cache lines of its own.  Bumping a
+ * counter is a plain add to the current CPU's copy: no atomic, and no
+ * cache line shared with other CPUs.  Readers sum the copies, normally
+ * from a kstat's ks_update callback, so the cost of a counter is paid
+ * when it is looked at rather than when it is bumped.
+ *
+ * As with TCP_STAT() and friends, a thread that is preempted and
+ * migrated in the middle of a bump may lose that update; that is
+ * acceptable for statistics, and is the price of not disabling
+ * preemption on every packet.  Counters are never reset, and may be
+ * decremented; the sum is computed modulo 2^64.
+ */
+
+#include <sys/types.h>
+#include <sys/kstat.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef	_KERNEL
+
+#include <sys/sysmacros.h>
+#include <sys/cpuvar.h>
+
+typedef struct pcpu_counter {
+	uint64_t	*pcc_base;	/* CPU 0's copy, cache line aligned */
+	uint_t		pcc_stride;	/* counters between CPUs' copies */
+	uint_t		pcc_ncounters;	/* counters in the set */
+	void		*pcc_buf;	/* allocation holding the copies */
+	size_t		pcc_bufsize;
+} pcpu_counter_t;
+
+#define	PCPU_COUNTER_ADD(pc, i, n)					\
+	((pc)->pcc_base[CPU->cpu_seqid * (pc)->pcc_stride + (i)] +=	\
+	    (uint64_t)(n))
+#define	PCPU_COUNTER_INC(pc, i)		PCPU_COUNTER_ADD(pc, i, 1)
+#define	PCPU_COUNTER_DEC(pc, i)		PCPU_COUNTER_ADD(pc, i, -1)
+
+/*
+ * Index of a counter kept for the kstat_named_t member "m" of the kstat
+ * data structure "type", for sets that mirror such a structure.
+ */
+#define	PCPU_COUNTER_KSTAT_INDEX(type, m)				\
+	(offsetof(type, m) / sizeof (kstat_named_t))
+
+extern pcpu_counter_t *pcpu_counter_create(uint_t, int);
+extern void pcpu_counter_destroy(pcpu_counter_t *);
+extern uint64_t pcpu_counter_sum(pcpu_counter_t *, uint_t);
+extern void pcpu_counter_kstat_update(pcpu_counter_t *, kstat_named_t *);
+
+#endif	/* _KERNEL */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_PCPU_COUNTER_H */
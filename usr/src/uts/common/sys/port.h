@@ -59,6 +59,12 @@ typedef	struct	port_notify {
 	void		*portnfy_user;	/* user defined */
 } port_notify_t;
 
+typedef struct port_assoc {
+	uintptr_t	pa_object;	/* source specific object */
+	int		pa_events;	/* events to watch for */
+	void		*pa_user;	/* user cookie */
+} port_assoc_t;
+
 
 typedef struct file_obj {
 	timestruc_t	fo_atime;	/* Access time from stat(2) */
@@ -91,6 +97,12 @@ typedef	struct	port_notify32 {
 	caddr32_t 	portnfy_user;	/* user defined */
 } port_notify32_t;
 
+typedef struct port_assoc32 {
+	caddr32_t	pa_object;	/* source specific object */
+	int		pa_events;	/* events to watch for */
+	caddr32_t	pa_user;	/* user cookie */
+} port_assoc32_t;
+
 #endif /* _SYSCALL32 */
 
 /* port_alert() flags */
@@ -98,6 +110,16 @@ typedef	struct	port_notify32 {
 #define	PORT_ALERT_UPDATE	0x02
 #define	PORT_ALERT_INVALID	(PORT_ALERT_SET | PORT_ALERT_UPDATE)
 
+/*
+ * PORT_SOURCE_FD - association flags, or'ed into the events
+ *
+ * By default an fd is dissociated when its event is delivered and has to be
+ * associated again.  An edge-triggered association instead stays in place
+ * and is re-armed as its event is retrieved; from then on, the next poll
+ * notification for the fd produces a new event.
+ */
+#define	PORT_ASSOC_EDGE		0x04000000	/* persistent, edge-triggered */
+
 /*
  * PORT_SOURCE_FILE - events
  */
@@ -231,9 +231,8 @@ typedef struct	proc {
 					/* on which process has threads */
 	volatile lgrp_id_t  p_t1_lgrpid; /* main's thread lgroup id */
 	volatile lgrp_id_t  p_tr_lgrpid; /* text replica's lgroup id */
-#if defined(_LP64)
-	uintptr_t  p_lgrpres2;		/* reserved for lgrp migration */
-#endif
+	volatile uint_t p_lgrp_rehomed;	/* a thread changed home lgroup; */
+					/* cleared by segvn_pmig_scan() */
 	/*
 	 * /proc (process filesystem) debugger interface stuff.
 	 */
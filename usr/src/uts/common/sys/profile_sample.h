@@ -0,0 +1,59 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef _SYS_PROFILE_SAMPLE_H
+#define	_SYS_PROFILE_SAMPLE_H
+
+/*
+ * The continuous stack sampler built into the profile driver.  When its
+ * "profile-sample-hz" property is set, the driver samples the kernel and
+ * user stacks of every CPU at that rate, counting distinct stacks in
+ * per-CPU tables, without any DTrace consumer.  The counts are read (and
+ * reset) through the raw kstat profile:0:samples, whose data is a
+ * profile_sample_hdr_t followed by psh_size bytes of profile_sample_t
+ * records.  Each record is PROFILE_SAMPLE_SIZE(kdepth + udepth) bytes
+ * long; its ps_pcs[] holds the ps_kdepth kernel frames, leaf first,
+ * followed by the ps_udepth user frames of process ps_pid, leaf first.
+ * The same stack may appear in more than one record (once per CPU), and
+ * consumers are expected to fold the records together themselves.
+ */
+
+#include <sys/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	PROFILE_SAMPLE_KSTAT	"samples"
+#define	PROFILE_SAMPLE_MAXDEPTH	32	/* maximum frames of each kind */
+
+typedef struct profile_sample_hdr {
+	hrtime_t	psh_interval;		/* sampling interval */
+	uint64_t	psh_drops;		/* samples dropped */
+	uint64_t	psh_size;		/* bytes of records following */
+} profile_sample_hdr_t;
+
+typedef struct profile_sample {
+	uint64_t	ps_count;		/* times this stack was seen */
+	uint32_t	ps_pid;			/* process, if ps_udepth != 0 */
+	uint16_t	ps_kdepth;		/* kernel frames */
+	uint16_t	ps_udepth;		/* user frames */
+	uint64_t	ps_pcs[1];		/* kernel, then user, frames */
+} profile_sample_t;
+
+#define	PROFILE_SAMPLE_SIZE(depth)	\
+	(offsetof(profile_sample_t, ps_pcs) + (depth) * sizeof (uint64_t))
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_PROFILE_SAMPLE_H */
@@ -144,6 +144,10 @@ extern "C" {
 #define	AHCI_PORT_IMPLEMENTED(ahci_ctlp, port)	\
 	((0x1 << port) & ahci_ctlp->ahcictl_ports_implemented)
 
+/* IS/PI bits for ports first through last */
+#define	AHCI_PORT_RANGE_MASK(first, last)	\
+	((uint32_t)((2ULL << (last)) - (1ULL << (first))))
+
 /* various port interrupt bits */
 	/* Device to Host Register FIS Interrupt */
 #define	AHCI_INTR_STATUS_DHRS (0x1 << 0)
@@ -437,6 +437,7 @@ typedef struct ahci_ctl {
 	size_t			ahcictl_intr_size; /* Size of intr array */
 	uint_t			ahcictl_intr_pri;  /* Intr priority */
 	int			ahcictl_intr_cap;  /* Intr capabilities */
+	boolean_t		ahcictl_intr_per_port; /* Vector n: port n */
 
 	/* FMA capabilities */
 	int			ahcictl_fm_cap;
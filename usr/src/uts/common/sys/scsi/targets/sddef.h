@@ -333,6 +333,18 @@ struct sd_lun {
 	short	un_min_throttle;	/* min value of un_throttle */
 	timeout_id_t	un_reset_throttle_timeid; /* timeout(9F) handle */
 
+	/*
+	 * Latency-targeted queue depth, see sd_latency_throttle().
+	 * un_lat_throttle further caps un_throttle when non-zero.
+	 */
+	short	un_lat_throttle;	/* latency-derived throttle cap */
+	short	un_lat_peak;		/* max cmds in transport in window */
+	uint32_t un_lat_count;		/* # cmds completed in window */
+	hrtime_t un_lat_target;		/* target mean latency, 0 = off */
+	hrtime_t un_lat_window;		/* start time of current window */
+	hrtime_t un_lat_sum;		/* total latency of window cmds */
+	hrtime_t un_lat_mean;		/* mean latency of last window */
+
 	/*
 	 * Multi-host (clustering) support
 	 */
@@ -830,6 +842,8 @@ struct sd_errstats {
 	struct kstat_named	sd_rq_recov_err;
 	struct kstat_named	sd_rq_illrq_err;
 	struct kstat_named	sd_rq_pfa_err;
+	struct kstat_named	sd_qdepth;
+	struct kstat_named	sd_latency;
 };
 
 
@@ -1217,6 +1231,27 @@ struct sd_fi_arq {
 
 #define	SD_MAX_THROTTLE		256
 #define	SD_MIN_THROTTLE		8
+
+/*
+ * Default latency targets for sd_latency_throttle(), in microseconds.
+ * A deep queue on a rotating (possibly SMR) drive costs hundreds of
+ * milliseconds per command long before it buys any throughput, while a
+ * flash device that has slowed to several milliseconds is already
+ * saturated.  SD_LAT_WINDOW is the sampling window.
+ */
+#define	SD_LAT_TARGET_SSD	5000
+#define	SD_LAT_TARGET_HDD	100000
+#define	SD_LAT_WINDOW		MSEC2NSEC(100)
+#define	SD_LAT_MIN_SAMPLES	16
+
+/*
+ * The number of commands sd_start_cmds() may have in transport: the
+ * lower of un_throttle and the latency-derived cap.
+ */
+#define	SD_THROTTLE(un)							\
+	(((un)->un_lat_throttle != 0 &&					\
+	    (un)->un_lat_throttle < (un)->un_throttle) ?		\
+	    (un)->un_lat_throttle : (un)->un_throttle)
 /*
  * Lowest valid max. and min. throttle value.
  * This is set to 2 because if un_min_throttle were allowed to be 1 then
@@ -1401,6 +1436,7 @@ struct sd_xbuf {
 	short	xb_victim_retry_count;
 	short	xb_ua_retry_count;	/* unit_attention retry counter */
 	short	xb_nr_retry_count;	/* not ready retry counter */
+	hrtime_t xb_start;		/* time handed to scsi_transport */
 
 	/*
 	 * Various status and data used when a RQS command is run on
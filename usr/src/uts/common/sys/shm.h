@@ -119,6 +119,21 @@ struct shmid_ds {
  */
 #define	SHM_LOCK	3	/* Lock segment in core */
 #define	SHM_UNLOCK	4	/* Unlock segment */
+#define	SHM_ADVISE	5	/* Set placement advice for segment */
+#define	SHM_ADVICE	6	/* Get placement advice for segment */
+
+/*
+ * Argument to SHM_ADVISE and SHM_ADVICE.  shma_advice is one of the
+ * MADV_ACCESS_* values from <sys/mman.h>; for MADV_ACCESS_INTERLEAVE,
+ * shma_lgrps is a bitmask of the lgroup IDs to spread pages across, or
+ * 0 for all of them.  Advice given before the first attach decides
+ * where the pages of an ISM or DISM segment are created.
+ */
+struct shm_advice {
+	uint_t		shma_advice;	/* MADV_ACCESS_* */
+	uint_t		shma_pad;
+	uint64_t	shma_lgrps;	/* lgroup ID bitmask */
+};
 
 #if !defined(_KERNEL)
 int shmget(key_t, size_t, int);
@@ -189,6 +189,7 @@ struct so_snd_bufinfo {
 #define	SO_EXCLBIND	0x1015		/* exclusive binding */
 #define	SO_MAC_IMPLICIT	0x1016		/* hide mac labels on wire */
 #define	SO_VRRP		0x1017		/* VRRP control socket */
+#define	SO_REUSEPORT	0x1018		/* share a port between listeners */
 
 #ifdef	_KERNEL
 #define	SO_SRCADDR	0x2001		/* Internal: AF_UNIX source address */
@@ -361,6 +362,16 @@ struct msghdr {
 #endif	/* defined(_XPG4_2) || defined(_KERNEL) */
 };
 
+#if !defined(_XPG4_2) || defined(__EXTENSIONS__)
+/*
+ * Message header for recvmmsg and sendmmsg calls.
+ */
+struct mmsghdr {
+	struct msghdr	msg_hdr;		/* the message */
+	unsigned int	msg_len;		/* bytes sent or received */
+};
+#endif	/* !defined(_XPG4_2) || defined(__EXTENSIONS__) */
+
 #if	defined(_KERNEL) || defined(_FAKE_KERNEL)
 
 /*
@@ -419,6 +430,7 @@ struct msghdr32 {
 #define	MSG_DONTWAIT	0x80		/* Don't block for this recv */
 #define	MSG_NOTIFICATION 0x100		/* Notification, not data */
 #define	MSG_XPG4_2	0x8000		/* Private: XPG4.2 flag */
+#define	MSG_WAITFORONE	0x10000		/* recvmmsg: block for first only */
 
 #define	MSG_MAXIOVLEN	16
 
@@ -498,6 +510,8 @@ struct cmsghdr {
 #pragma redefine_extname connect __xnet_connect
 #pragma redefine_extname recvmsg __xnet_recvmsg
 #pragma redefine_extname sendmsg __xnet_sendmsg
+#pragma redefine_extname recvmmsg __xnet_recvmmsg
+#pragma redefine_extname sendmmsg __xnet_sendmmsg
 #pragma redefine_extname sendto __xnet_sendto
 #pragma redefine_extname socket __xnet_socket
 #pragma redefine_extname socketpair __xnet_socketpair
@@ -507,6 +521,8 @@ struct cmsghdr {
 #define	connect	__xnet_connect
 #define	recvmsg	__xnet_recvmsg
 #define	sendmsg	__xnet_sendmsg
+#define	recvmmsg	__xnet_recvmmsg
+#define	sendmmsg	__xnet_sendmmsg
 #define	sendto	__xnet_sendto
 #define	socket	__xnet_socket
 #define	socketpair	__xnet_socketpair
@@ -548,6 +564,13 @@ extern int socket(int, int, int);
 #if !defined(_XPG4_2) || defined(_XPG6) || defined(__EXTENSIONS__)
 extern int sockatmark(int);
 #endif /* !defined(_XPG4_2) || defined(_XPG6) || defined(__EXTENSIONS__) */
+
+#if !defined(_XPG4_2) || defined(__EXTENSIONS__)
+struct timespec;
+extern int recvmmsg(int, struct mmsghdr *, unsigned int, int,
+	struct timespec *);
+extern int sendmmsg(int, struct mmsghdr *, unsigned int, int);
+#endif /* !defined(_XPG4_2) || defined(__EXTENSIONS__) */
 #endif	/* !defined(_KERNEL) || defined(_BOOT) */
 
 #ifdef	__cplusplus
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include <sys/socket.h>
+#include <sys/processor.h>
 
 /*
  * Generation count
@@ -122,6 +123,7 @@ struct sock_downcalls_s {
 	int	(*sd_ioctl)(sock_lower_handle_t, int, intptr_t, int,
 		    int32_t *, cred_t *);
 	int	(*sd_close)(sock_lower_handle_t, int, cred_t *);
+	void	(*sd_recv_cpu)(sock_lower_handle_t, processorid_t);
 };
 
 typedef sock_lower_handle_t (*so_proto_create_func_t)(int, int, int,
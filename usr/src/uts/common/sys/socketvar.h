@@ -234,6 +234,8 @@ struct sonode {
 	ksocket_callbacks_t 	so_ksock_callbacks;
 	void			*so_ksock_cb_arg;	/* callback argument */
 	kcondvar_t		so_closing_cv;
+	ksocket_krecv_f		so_krecv_cb;	/* takes data as it arrives */
+	void			*so_krecv_arg;
 
 	/* != NULL for sodirect enabled socket */
 	struct sodirect_s	*so_direct;
@@ -610,6 +612,7 @@ struct sendfile_stats {
 	uint32_t ss_full_waits;
 	uint32_t ss_empty_waits;
 	uint32_t ss_file_segmap;
+	uint32_t ss_file_loaned;
 };
 
 /*
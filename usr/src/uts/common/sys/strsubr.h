@@ -1254,6 +1254,8 @@ extern fmodsw_impl_t *fmodsw_find(const char *, fmodsw_flags_t);
 extern void fmodsw_rele(fmodsw_impl_t *);
 
 extern void freemsgchain(mblk_t *);
+extern void freemsgchain_bulk(mblk_t *);
+extern size_t allocb_chain(size_t, uint_t, size_t, mblk_t **);
 extern mblk_t *copymsgchain(mblk_t *);
 
 extern mblk_t *mcopyinuio(struct stdata *, uio_t *, ssize_t, ssize_t, int *);
@@ -296,6 +296,7 @@ extern "C" {
 #define	SYS_writev	122
 #define	SYS_preadv	123
 #define	SYS_pwritev	124
+#define	SYS_getdentsattr	125
 #define	SYS_getrandom	126
 #define	SYS_mmapobj	127
 #define	SYS_setrlimit	128
@@ -322,12 +323,20 @@ extern "C" {
 #define	SYS_sigtimedwait	144
 #define	SYS_lwp_info	145
 #define	SYS_yield	146
+#define	SYS_lwp_addr_sys	147
+	/*
+	 * subcodes:
+	 *	lwp_addr_wait(...)      :: syscall(147, 0, ...)
+	 *	lwp_addr_wait_park(...) :: syscall(147, 1, ...)
+	 *	lwp_addr_wake(...)      :: syscall(147, 2, ...)
+	 */
 #define	SYS_lwp_sema_post	148
 #define	SYS_lwp_sema_trywait	149
 #define	SYS_lwp_detach	150
 #define	SYS_corectl	151
 #define	SYS_modctl	152
 #define	SYS_fchroot	153
+#define	SYS_sendmmsg	154
 #define	SYS_vhangup	155
 #define	SYS_gettimeofday	156
 #define	SYS_getitimer		157
@@ -342,6 +351,7 @@ extern "C" {
 #define	SYS_lwp_private		166
 #define	SYS_lwp_wait		167
 #define	SYS_lwp_mutex_wakeup	168
+#define	SYS_recvmmsg		169
 #define	SYS_lwp_cond_wait	170
 #define	SYS_lwp_cond_signal	171
 #define	SYS_lwp_cond_broadcast	172
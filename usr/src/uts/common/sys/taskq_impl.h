@@ -91,6 +91,37 @@ struct taskq_bucket {
 #define	TQBUCKET_CLOSE		0x01
 #define	TQBUCKET_SUSPEND	0x02
 
+/*
+ * Per-CPU run queue ("lane") of a TASKQ_PERCPU task queue.  Tasks are queued
+ * on the lane of the dispatching CPU and are normally run by the threads
+ * whose home lane it is; idle threads steal from other lanes.  Lanes are
+ * allocated from a cache-aligned kmem cache so that they don't share lines.
+ */
+typedef struct taskq_lane {
+	kmutex_t	tql_lock;
+	taskq_ent_t	tql_task;	/* Queued tasks */
+	kcondvar_t	tql_cv;		/* Idle home threads wait here */
+	kcondvar_t	tql_wait_cv;	/* taskq_wait()/taskq_suspend() */
+	uint_t		tql_id;		/* Index in tq_lanes */
+	uint_t		tql_flags;
+	uint_t		tql_nthreads;	/* # of threads homed here */
+	uint_t		tql_nidle;	/* # of home threads looking for work */
+	uint_t		tql_nwake;	/* # of wakeups not yet consumed */
+	uint_t		tql_nrunning;	/* # of tasks from here being run */
+	int		tql_ntasks;	/* # of tasks queued */
+	int		tql_maxtasks;	/* Max number of tasks queued */
+	uint64_t	tql_tasks;	/* Total # of tasks posted */
+	uint64_t	tql_executed;	/* Total # of tasks executed */
+	uint64_t	tql_steals;	/* # run by threads from other lanes */
+	uint64_t	tql_wakeups;	/* # of thread wakeups */
+	hrtime_t	tql_totaltime;	/* Time spent processing tasks */
+} taskq_lane_t;
+
+/*
+ * Lane flags.
+ */
+#define	TQLANE_SUSPEND		0x01
+
 #define	TASKQ_INTERFACE_FLAGS	0x0000ffff	/* defined in <sys/taskq.h> */
 
 /*
@@ -127,6 +158,8 @@ struct taskq {
 	taskq_bucket_t	*tq_buckets;	/* Per-cpu array of buckets */
 	int		tq_instance;
 	uint_t		tq_nbuckets;	/* # of buckets	(2^n)	    */
+	taskq_lane_t	**tq_lanes;	/* TASKQ_PERCPU run queues */
+	uint_t		tq_nlanes;	/* # of lanes (2^n) */
 	union {
 		kthread_t *_tq_thread;
 		kthread_t **_tq_threadlist;
@@ -226,6 +226,7 @@ typedef enum uio_rw { UIO_READ, UIO_WRITE } uio_rw_t;
 
 #define	UIO_ASYNC		0x0002	/* uio_t is really a uioa_t */
 #define	UIO_XUIO		0x0004	/* Structure is xuio_t */
+#define	UIO_COPY_OFFLOAD	0x0008	/* copy may be done by DMA */
 
 /*
  * Global uioasync capability shadow state.
@@ -278,6 +278,7 @@ typedef	uint64_t	vfs_feature_t;
 #define	VFSFT_REPARSE		0x100000100	/* Supports reparse point */
 #define	VFSFT_ZEROCOPY_SUPPORTED	0x100000200
 				/* Support loaning /returning cache buffer */
+#define	VFSFT_DIRTYTRACK	0x100000400	/* Reports vnodes to fsflush */
 /*
  * Argument structure for mount(2).
  *
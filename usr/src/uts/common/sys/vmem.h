@@ -126,6 +126,8 @@ extern vmem_t *vmem_init(const char *, void *, size_t, size_t,
     vmem_alloc_t *, vmem_free_t *);
 extern void vmem_update(void *);
 extern int vmem_is_populator();
+extern void vmem_segcache_enable(vmem_t *);
+extern void vmem_segcache_reap(void);
 extern size_t vmem_seg_size;
 #endif
 
@@ -108,8 +108,26 @@ typedef struct vmem_kstat {
 	kstat_named_t	vk_populate_fail;	/* populates that failed */
 	kstat_named_t	vk_contains;		/* vmem_contains() calls */
 	kstat_named_t	vk_contains_search;	/* vmem_contains() search cnt */
+	kstat_named_t	vk_segcache_hit;	/* segment cache hits */
+	kstat_named_t	vk_segcache_miss;	/* segment cache misses */
 } vmem_kstat_t;
 
+/*
+ * Per-CPU segment cache.  Each one is exactly two cache lines on LP64.
+ */
+#define	VMEM_SEGCACHE_NSEGS	6
+
+typedef struct vmem_segcache {
+	kmutex_t	vsc_lock;	/* protects this CPU's cache */
+	uint_t		vsc_nsegs;	/* number of cached segments */
+	uint64_t	vsc_hit;	/* allocations from this cache */
+	uint64_t	vsc_miss;	/* allocations passed to the arena */
+	struct {
+		uintptr_t	vss_start;	/* start of cached segment */
+		size_t		vss_size;	/* size of cached segment */
+	} vsc_seg[VMEM_SEGCACHE_NSEGS];
+} vmem_segcache_t;
+
 struct vmem {
 	char		vm_name[VMEM_NAMELEN];	/* arena name */
 	kcondvar_t	vm_cv;		/* cv for blocking allocations */
@@ -136,6 +154,8 @@ struct vmem {
 	vmem_seg_t	vm_rotor;	/* rotor for VM_NEXTFIT allocations */
 	vmem_seg_t	*vm_hash0[VMEM_HASH_INITIAL];	/* initial hash table */
 	void		*vm_qcache[VMEM_NQCACHE_MAX];	/* quantum caches */
+	size_t		vm_segcache_max; /* maximum size to cache per-CPU */
+	vmem_segcache_t	*vm_segcache;	/* per-CPU segment caches */
 	vmem_freelist_t	vm_freelist[VMEM_FREELISTS + 1]; /* power-of-2 flists */
 	vmem_kstat_t	vm_kstat;	/* kstat data */
 };
@@ -125,6 +125,9 @@ extern int maxslp;
 extern ulong_t pginrate;
 extern ulong_t pgoutrate;
 extern void swapout_lwp(klwp_t *);
+extern void *pageout_reclaim_register(pgcnt_t (*)(void *),
+    void (*)(void *, pgcnt_t), void *);
+extern void pageout_reclaim_unregister(void *);
 
 extern	int valid_va_range(caddr_t *basep, size_t *lenp, size_t minlen,
 		int dir);
@@ -347,6 +347,15 @@ typedef struct vn_vfslocks_entry {
 
 #define	V_SYSATTR	0x40000	/* vnode is a GFS system attribute */
 
+/*
+ * Set by a file system on a directory that anyone may search and whose
+ * DNLC entries are authoritative, so that dnlc_lookup_path() can walk
+ * through it without calling VOP_LOOKUP().
+ */
+#define	V_DNLCSEARCH	0x80000
+
+#define	VFSFLUSH	0x100000 /* on fsflush's list of vnodes to push */
+
 /*
  * Vnode attributes.  A bit-mask is supplied as part of the
  * structure to indicate the attributes the caller wants to
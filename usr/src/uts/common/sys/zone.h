@@ -104,6 +104,7 @@ extern "C" {
 #define	ZONE_ATTR_FS_ALLOWED	16
 #define	ZONE_ATTR_NETWORK	17
 #define	ZONE_ATTR_INITNORESTART	20
+#define	ZONE_ATTR_LPG_PROMOTE	21
 
 /* Start of the brand-specific attribute namespace */
 #define	ZONE_ATTR_BRAND_ATTRS	32768
@@ -408,6 +409,26 @@ typedef struct {
 	kstat_named_t	zm_boot_time;
 } zone_misc_kstat_t;
 
+/*
+ * Latency histograms, in log2 buckets of nanoseconds.  Bucket 0 counts
+ * latencies below 2^ZONE_LAT_SHIFT ns (about 1us), bucket i counts those in
+ * [2^(i + ZONE_LAT_SHIFT - 1), 2^(i + ZONE_LAT_SHIFT)) ns, and the last
+ * bucket also counts everything longer (from about 4s).
+ */
+#define	ZONE_LAT_SHIFT		10
+#define	ZONE_LAT_NBUCKETS	24
+
+typedef struct zone_lathist {
+	uint64_t	zl_count[ZONE_LAT_NBUCKETS];
+} zone_lathist_t;
+
+typedef struct {
+	kstat_named_t	zl_zonename;	/* full name, kstat truncates name */
+	kstat_named_t	zl_runq[ZONE_LAT_NBUCKETS];
+	kstat_named_t	zl_read[ZONE_LAT_NBUCKETS];
+	kstat_named_t	zl_write[ZONE_LAT_NBUCKETS];
+} zone_lat_kstat_t;
+
 typedef struct zone {
 	/*
 	 * zone_name is never modified once set.
@@ -540,6 +561,7 @@ typedef struct zone {
 	tsol_mlp_list_t zone_mlps;	/* MLPs on zone-private addresses */
 
 	boolean_t	zone_restart_init;	/* Restart init if it dies? */
+	boolean_t	zone_lpg_promote;	/* large page promotion on? */
 	struct brand	*zone_brand;		/* zone's brand */
 	void 		*zone_brand_data;	/* store brand specific data */
 	id_t		zone_defaultcid;	/* dflt scheduling class id */
@@ -596,6 +618,19 @@ typedef struct zone {
 	uint64_t	zone_stime;		/* total system time */
 	uint64_t	zone_utime;		/* total user time */
 	uint64_t	zone_wtime;		/* total time waiting in runq */
+
+	/*
+	 * Latency histograms: time spent waiting on a run queue (updated in
+	 * msacct.c with zone_wtime) and the time taken by read and write
+	 * operations on regular files (updated in fop_read and fop_write).
+	 * The buckets are updated atomically; zone_lat_ksp exports them.
+	 */
+	kstat_t		*zone_lat_ksp;
+	zone_lat_kstat_t *zone_lat_stats;
+	zone_lathist_t	zone_runq_lat;
+	zone_lathist_t	zone_read_lat;
+	zone_lathist_t	zone_write_lat;
+
 	/* fork-fail kstat tracking */
 	uint32_t	zone_ffcap;		/* hit an rctl cap */
 	uint32_t	zone_ffnoproc;		/* get proc/lwp error */
@@ -662,6 +697,7 @@ extern zone_t *zone_find_by_id_nolock(zoneid_t);
 extern int zone_datalink_walk(zoneid_t, int (*)(datalink_id_t, void *), void *);
 extern int zone_check_datalink(zoneid_t *, datalink_id_t);
 extern void zone_loadavg_update();
+extern void zone_lat_record(zone_lathist_t *, hrtime_t);
 
 /*
  * Zone-specific data (ZSD) APIs
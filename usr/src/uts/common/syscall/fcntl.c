@@ -132,6 +132,11 @@ fcntl(int fdes, int cmd, intptr_t arg)
 		if ((error = f_badfd(fdes, &fdres, (int)arg)) == 0)
 			retval = fdres;
 		goto out;
+
+	case F_CLOSEFROM:
+		error = f_closefrom(fdes);
+		retval = 0;
+		goto out;
 	}
 
 	/*
@@ -48,6 +48,8 @@
 #include <sys/debug.h>
 #include <sys/kmem.h>
 #include <sys/cmn_err.h>
+#include <sys/model.h>
+#include <sys/pathname.h>
 
 #if defined(_SYSCALL32_IMPL) || defined(_ILP32)
 
@@ -236,3 +238,156 @@ getdents64(int fd, void *buf, size_t count)
 	releasef(fd);
 	return (count);
 }
+
+/*
+ * Fill in the attributes of directory entry "name" in dvp, as fstatat()
+ * with AT_SYMLINK_NOFOLLOW would find them.
+ */
+static int
+getdentsattr_stat(vnode_t *dvp, char *name, direntattr_t *da)
+{
+	vnode_t *vp;
+	vattr_t vattr;
+	int error;
+
+	if ((error = lookupnameat(name, UIO_SYSSPACE, NO_FOLLOW, NULLVPP,
+	    &vp, dvp)) != 0)
+		return (error);
+
+	vattr.va_mask = AT_STAT | AT_NBLOCKS | AT_BLKSIZE | AT_SIZE;
+	error = VOP_GETATTR(vp, &vattr, 0, CRED(), NULL);
+	VN_RELE(vp);
+	if (error != 0)
+		return (error);
+
+	if (get_udatamodel() == DATAMODEL_NATIVE) {
+		da->da_dev = vattr.va_fsid;
+		da->da_rdev = vattr.va_rdev;
+	} else {
+		dev32_t dev, rdev;
+
+		if (!cmpldev(&dev, vattr.va_fsid) ||
+		    !cmpldev(&rdev, vattr.va_rdev))
+			return (EOVERFLOW);
+		da->da_dev = dev;
+		da->da_rdev = rdev;
+	}
+	da->da_mode = VTTOIF(vattr.va_type) | vattr.va_mode;
+	da->da_nlink = vattr.va_nlink;
+	da->da_uid = vattr.va_uid;
+	da->da_gid = vattr.va_gid;
+	da->da_size = vattr.va_size;
+	da->da_atime_sec = vattr.va_atime.tv_sec;
+	da->da_atime_nsec = vattr.va_atime.tv_nsec;
+	da->da_mtime_sec = vattr.va_mtime.tv_sec;
+	da->da_mtime_nsec = vattr.va_mtime.tv_nsec;
+	da->da_ctime_sec = vattr.va_ctime.tv_sec;
+	da->da_ctime_nsec = vattr.va_ctime.tv_nsec;
+	da->da_blksize = vattr.va_blksize;
+	da->da_blocks = vattr.va_nblocks;
+	return (0);
+}
+
+/*
+ * Read directory entries together with the attributes of the files they
+ * name, saving a directory scan a stat(2) call, and the lookup that goes
+ * with it, for each entry.
+ *
+ * The entries are read with VOP_READDIR() as getdents64() does, and then
+ * looked up and their attributes fetched once the directory's rwlock has
+ * been dropped again: VOP_LOOKUP() may need that lock itself, and the
+ * entry vnodes are found in the DNLC, which VOP_READDIR() has just
+ * warmed, in the common case anyway.  Since each record is larger than
+ * the dirent64 it was made from, not every entry read may fit; the file
+ * offset is left at the first one that didn't, using the offset cookies
+ * from VOP_READDIR().
+ */
+int
+getdentsattr(int fd, void *buf, size_t count)
+{
+	vnode_t *vp;
+	file_t *fp;
+	struct uio auio;
+	struct iovec aiov;
+	dirent64_t *dp;
+	direntattr_t *da;
+	char *dbuf, *obuf;
+	size_t dlen, olen, reclen;
+	offset_t off;
+	int error, sink;
+
+	if (count < sizeof (direntattr_t))
+		return (set_errno(EINVAL));
+
+	if (count > MAXGETDENTS_SIZE)
+		count = MAXGETDENTS_SIZE;
+
+	if ((fp = getf(fd)) == NULL)
+		return (set_errno(EBADF));
+	vp = fp->f_vnode;
+	if (vp->v_type != VDIR) {
+		releasef(fd);
+		return (set_errno(ENOTDIR));
+	}
+	if (!(fp->f_flag & FREAD)) {
+		releasef(fd);
+		return (set_errno(EBADF));
+	}
+
+	dbuf = kmem_alloc(count, KM_SLEEP);
+	aiov.iov_base = dbuf;
+	aiov.iov_len = count;
+	auio.uio_iov = &aiov;
+	auio.uio_iovcnt = 1;
+	auio.uio_loffset = fp->f_offset;
+	auio.uio_segflg = UIO_SYSSPACE;
+	auio.uio_resid = count;
+	auio.uio_fmode = 0;
+	auio.uio_extflg = UIO_COPY_CACHED;
+	(void) VOP_RWLOCK(vp, V_WRITELOCK_FALSE, NULL);
+	error = VOP_READDIR(vp, &auio, fp->f_cred, &sink, NULL, 0);
+	VOP_RWUNLOCK(vp, V_WRITELOCK_FALSE, NULL);
+	if (error) {
+		kmem_free(dbuf, count);
+		releasef(fd);
+		return (set_errno(error));
+	}
+	dlen = count - auio.uio_resid;
+	off = fp->f_offset;
+
+	obuf = kmem_zalloc(count, KM_SLEEP);
+	olen = 0;
+	for (dp = (dirent64_t *)dbuf; (char *)dp < dbuf + dlen;
+	    dp = (dirent64_t *)((char *)dp + dp->d_reclen)) {
+		reclen = DIRENTATTR_RECLEN(strlen(dp->d_name));
+		if (olen + reclen > count)
+			break;
+		da = (direntattr_t *)(obuf + olen);
+		da->da_ino = dp->d_ino;
+		da->da_off = dp->d_off;
+		da->da_reclen = (uint16_t)reclen;
+		(void) strcpy(da->da_name, dp->d_name);
+		da->da_error = getdentsattr_stat(vp, dp->d_name, da);
+		olen += reclen;
+		off = dp->d_off;
+	}
+	if ((char *)dp >= dbuf + dlen)
+		off = auio.uio_loffset;
+	kmem_free(dbuf, count);
+
+	if (olen == 0 && dlen != 0) {
+		/*
+		 * Buffer too small for any entries.
+		 */
+		error = EINVAL;
+	} else if (copyout(obuf, buf, olen) != 0) {
+		error = EFAULT;
+	} else {
+		fp->f_offset = off;
+	}
+	kmem_free(obuf, count);
+	releasef(fd);
+	if (error)
+		return (set_errno(error));
+	return (olen);
+}
@@ -36,11 +36,17 @@
 #define	MAXRANDBYTES	1024
 #define	MAXURANDBYTES	INT_MAX
 
+/*
+ * Bytes generated per copyout; the pseudo-random generator takes its
+ * per-CPU lock once for each.
+ */
+#define	RANDBUFBYTES	512
+
 int
 getrandom(void *bufp, size_t buflen, int flags)
 {
 	int out = 0;
-	uint8_t rbytes[128];
+	uint8_t rbytes[RANDBUFBYTES];
 	uint8_t *buf = bufp;
 
 	if (flags & ~(GRND_NONBLOCK | GRND_RANDOM))
@@ -66,15 +72,19 @@ getrandom(void *bufp, size_t buflen, int flags)
 		}
 
 		if (err == 0) {
-			if (ddi_copyout(rbytes, buf + out, len, 0) != 0)
+			if (ddi_copyout(rbytes, buf + out, len, 0) != 0) {
+				bzero(rbytes, sizeof (rbytes));
 				return (set_errno(EFAULT));
+			}
 			out += len;
 		} else if (err == EAGAIN && out > 0) {
 			break;
 		} else {
+			bzero(rbytes, sizeof (rbytes));
 			return (set_errno(err));
 		}
 	}
 
+	bzero(rbytes, sizeof (rbytes));
 	return (out);
 }
@@ -2227,6 +2227,208 @@ out:
 	return (0);
 }
 
+/*
+ * Wake up to nwake lwps sleeping on the lwpchan; return the number woken.
+ */
+static int
+lwp_addr_release(lwpchan_t *lwpchan, uint32_t nwake)
+{
+	uchar_t waiters = 1;
+	uint32_t nwoken = 0;
+
+	lwpchan_lock(lwpchan, LWPCHAN_CVPOOL);
+	while (waiters != 0 && nwoken < nwake &&
+	    lwp_release(lwpchan, &waiters, T_WAITCVSEM))
+		nwoken++;
+	lwpchan_unlock(lwpchan, LWPCHAN_CVPOOL);
+	return ((int)nwoken);
+}
+
+/*
+ * Address-keyed wait and wakeup.
+ *
+ * lwp_addr_wait() puts the caller to sleep on the 32-bit word at addr,
+ * provided that the word still holds val once the lwpchan lock has been
+ * acquired; otherwise it returns EAGAIN.  lwp_addr_wake() wakes up to
+ * nwake lwps sleeping on the word.  The lwpchan is derived from the word's
+ * address exactly as for the other synchronization objects, so a word in
+ * shared memory can be waited for and woken from different processes when
+ * USYNC_PROCESS is passed in type.
+ *
+ * Unlike the object-based calls above, no part of the object is written
+ * here; the caller implements the synchronization object at user level
+ * and enters the kernel only to block or to wake up blocked lwps.
+ */
+static int
+lwp_addr_wait(uint32_t *addr, uint32_t val, timespec_t *tsp, int type,
+    int check_park)
+{
+	kthread_t *t = curthread;
+	klwp_t *lwp = ttolwp(t);
+	proc_t *p = ttoproc(t);
+	lwp_timer_t lwpt;
+	caddr_t timedwait;
+	clock_t tim = -1;
+	label_t ljb;
+	volatile int locked = 0;
+	volatile int watched = 0;
+	int blocked = 0;
+	uint32_t cur;
+	lwpchan_t lwpchan;
+	int error = 0;
+	int time_error;
+	int imm_timeout = 0;
+	int imm_unpark = 0;
+
+	if ((caddr_t)addr >= p->p_as->a_userlimit)
+		return (set_errno(EFAULT));
+	if ((uintptr_t)addr & (sizeof (uint32_t) - 1))
+		return (set_errno(EINVAL));
+
+	/*
+	 * Put the lwp in an orderly state for debugging,
+	 * in case we are stopped while sleeping, below.
+	 */
+	prstop(PR_REQUESTED, 0);
+
+	timedwait = (caddr_t)tsp;
+	if ((time_error = lwp_timer_copyin(&lwpt, tsp)) == 0 &&
+	    lwpt.lwpt_imm_timeout) {
+		imm_timeout = 1;
+		timedwait = NULL;
+	}
+
+	watched = watch_disable_addr((caddr_t)addr, sizeof (*addr), S_READ);
+
+	if (on_fault(&ljb)) {
+		error = EFAULT;
+		goto out;
+	}
+	if (!get_lwpchan(p->p_as, (caddr_t)addr, type,
+	    &lwpchan, LWPCHAN_CVPOOL)) {
+		error = EFAULT;
+		goto out;
+	}
+	lwpchan_lock(&lwpchan, LWPCHAN_CVPOOL);
+	locked = 1;
+	fuword32_noerr(addr, &cur);
+	if (cur != val) {
+		error = EAGAIN;
+		goto out;
+	}
+	if (time_error) {
+		/* as for semaphores, report a bad timeout only if we'd sleep */
+		error = time_error;
+		goto out;
+	}
+	if (watched) {
+		watch_enable_addr((caddr_t)addr, sizeof (*addr), S_READ);
+		watched = 0;
+	}
+	if (check_park && (!schedctl_is_park() || t->t_unpark)) {
+		/*
+		 * We received a signal at user-level before calling
+		 * here or another thread wants us to return
+		 * immediately with EINTR.  See lwp_unpark().
+		 */
+		imm_unpark = 1;
+		t->t_unpark = 0;
+		timedwait = NULL;
+	} else if (timedwait) {
+		/*
+		 * If we successfully queue the timeout,
+		 * then don't drop t_delay_lock until
+		 * we are on the sleep queue (below).
+		 */
+		mutex_enter(&t->t_delay_lock);
+		if (lwp_timer_enqueue(&lwpt) != 0) {
+			mutex_exit(&t->t_delay_lock);
+			imm_timeout = 1;
+			timedwait = NULL;
+		}
+	}
+	t->t_flag |= T_WAITCVSEM;
+	lwp_block(&lwpchan);
+	blocked = 1;
+	/*
+	 * Nothing should happen to cause the lwp to sleep
+	 * again until after it returns from swtch().
+	 */
+	if (timedwait)
+		mutex_exit(&t->t_delay_lock);
+	locked = 0;
+	lwpchan_unlock(&lwpchan, LWPCHAN_CVPOOL);
+	if (ISSIG(t, JUSTLOOKING) || MUSTRETURN(p, t) ||
+	    (imm_timeout | imm_unpark))
+		setrun(t);
+	swtch();
+	t->t_flag &= ~(T_WAITCVSEM | T_WAKEABLE);
+	if (timedwait)
+		tim = lwp_timer_dequeue(&lwpt);
+	setallwatch();
+	if (ISSIG(t, FORREAL) || lwp->lwp_sysabort ||
+	    MUSTRETURN(p, t) || imm_unpark)
+		error = EINTR;
+	else if (imm_timeout || (timedwait && tim == -1))
+		error = ETIME;
+	lwp->lwp_asleep = 0;
+	lwp->lwp_sysabort = 0;
+out:
+	if (locked)
+		lwpchan_unlock(&lwpchan, LWPCHAN_CVPOOL);
+	no_fault();
+	if (watched)
+		watch_enable_addr((caddr_t)addr, sizeof (*addr), S_READ);
+	if (tsp && !time_error)		/* copyout the residual time left */
+		error = lwp_timer_copyout(&lwpt, error);
+	if (error) {
+		/*
+		 * As in lwp_cond_wait(), if we were woken up and also
+		 * received a UNIX signal or got a timeout, pass the
+		 * wakeup on rather than consuming it.
+		 */
+		if (blocked && t->t_release)
+			(void) lwp_addr_release(&lwpchan, 1);
+		return (set_errno(error));
+	}
+	return (0);
+}
+
+static int
+lwp_addr_wake(uint32_t *addr, uint32_t nwake, int type)
+{
+	proc_t *p = ttoproc(curthread);
+	lwpchan_t lwpchan;
+
+	if ((caddr_t)addr >= p->p_as->a_userlimit)
+		return (set_errno(EFAULT));
+	if ((uintptr_t)addr & (sizeof (uint32_t) - 1))
+		return (set_errno(EINVAL));
+
+	if (!get_lwpchan(p->p_as, (caddr_t)addr, type,
+	    &lwpchan, LWPCHAN_CVPOOL))
+		return (set_errno(EFAULT));
+	return (lwp_addr_release(&lwpchan, nwake));
+}
+
+int
+lwp_addr_sys(int subcode, uint32_t *addr, uint32_t val, timespec_t *tsp,
+    int type)
+{
+	/* only the scope of the address is of interest here */
+	type &= USYNC_PROCESS;
+
+	switch (subcode) {
+	case 0:
+		return (lwp_addr_wait(addr, val, tsp, type, 0));
+	case 1:
+		return (lwp_addr_wait(addr, val, tsp, type, 1));
+	case 2:
+		return (lwp_addr_wake(addr, val, type));
+	}
+	return (set_errno(EINVAL));
+}
+
 #define	TRW_WANT_WRITE		0x1
 #define	TRW_LOCK_GRANTED	0x2
 
@@ -72,6 +72,10 @@ extern int nl7c_sendfilev(struct sonode *, u_offset_t *, struct sendfilevec *,
 		int, ssize_t *);
 extern int snf_segmap(file_t *, vnode_t *, u_offset_t, u_offset_t, ssize_t *,
 		boolean_t);
+extern int snf_loan(file_t *, vnode_t *, u_offset_t, u_offset_t, ssize_t *,
+		boolean_t);
+extern int sendfile_loan_enable;
+extern struct sendfile_stats sf_stats;
 extern sotpi_info_t *sotpi_sototpi(struct sonode *);
 
 #define	SEND_MAX_CHUNK	16
@@ -141,7 +145,7 @@ sendvec_chunk64(file_t *fp, u_offset_t *fileoff, struct ksendfilevec64 *sfv,
 
 		sfv_off = sfv->sfv_off;
 
-		auio.uio_extflg = UIO_COPY_DEFAULT;
+		auio.uio_extflg = UIO_COPY_DEFAULT | UIO_COPY_OFFLOAD;
 		if (sfv->sfv_fd == SFV_FD_SELF) {
 			aiov.iov_len = sfv_len;
 			aiov.iov_base = (caddr_t)(uintptr_t)sfv_off;
@@ -450,7 +454,7 @@ sendvec_small_chunk(file_t *fp, u_offset_t *fileoff, struct sendfilevec *sfv,
 	head->b_wptr = head->b_rptr = head->b_rptr + wroff;
 	bzero(&msg, sizeof (msg));
 
-	auio.uio_extflg = UIO_COPY_DEFAULT;
+	auio.uio_extflg = UIO_COPY_DEFAULT | UIO_COPY_OFFLOAD;
 	for (i = 0; i < copy_cnt; i++) {
 		if (ISSIG(curthread, JUSTLOOKING)) {
 			freemsg(head);
@@ -728,7 +732,7 @@ sendvec_chunk(file_t *fp, u_offset_t *fileoff, struct sendfilevec *sfv,
 	}
 
 	bzero(&msg, sizeof (msg));
-	auio.uio_extflg = UIO_COPY_DEFAULT;
+	auio.uio_extflg = UIO_COPY_DEFAULT | UIO_COPY_OFFLOAD;
 	for (i = 0; i < copy_cnt; i++) {
 		if (ISSIG(curthread, JUSTLOOKING))
 			return (EINTR);
@@ -961,9 +965,18 @@ sendvec_chunk(file_t *fp, u_offset_t *fileoff, struct sendfilevec *sfv,
 				boolean_t nowait;
 
 				nowait = (sfv->sfv_flag & SFV_NOWAIT) != 0;
-				error = snf_segmap(fp, readvp, sfv_off,
-				    (u_offset_t)sfv_len, (ssize_t *)&cnt,
-				    nowait);
+				if (sendfile_loan_enable &&
+				    vfs_has_feature(readvp->v_vfsp,
+				    VFSFT_ZEROCOPY_SUPPORTED)) {
+					sf_stats.ss_file_loaned++;
+					error = snf_loan(fp, readvp, sfv_off,
+					    (u_offset_t)sfv_len,
+					    (ssize_t *)&cnt, nowait);
+				} else {
+					error = snf_segmap(fp, readvp, sfv_off,
+					    (u_offset_t)sfv_len,
+					    (ssize_t *)&cnt, nowait);
+				}
 				releasef(sfv->sfv_fd);
 				*count += cnt;
 				if (error)
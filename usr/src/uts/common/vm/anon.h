@@ -207,6 +207,21 @@ typedef	struct	ani_free {
 #define	ANI_MAX_POOL	(NCPU_P2)
 extern	ani_free_t	*ani_free_pool;
 
+/*
+ * Per-CPU caches of reserved physical swap, so that small reservations
+ * and unreservations do not all take anoninfo_lock.  The pages in them
+ * are counted in k_anoninfo.ani_phys_resv; anon_resv_drain() gives them
+ * back.  Zone swap caps are charged exactly, before the cache is used.
+ */
+typedef struct ani_resv {
+	kmutex_t	ani_resv_lock;
+	pgcnt_t		ani_resv_pages;
+	uchar_t		pad[64 - sizeof (kmutex_t) - sizeof (pgcnt_t)];
+			/* XXX 64 = cacheline size */
+} ani_resv_t;
+
+extern	ani_resv_t	*ani_resv_pool;
+
 /*
  * Since each CPU has its own bucket in ani_free_pool, there should be no
  * contention here.
@@ -421,6 +436,7 @@ extern int	anon_map_demotepages(struct anon_map *, ulong_t,
 extern void	anon_shmap_free_pages(struct anon_map *, ulong_t, size_t);
 extern int	anon_resvmem(size_t, boolean_t, zone_t *, int);
 extern void	anon_unresvmem(size_t, zone_t *);
+extern void	anon_resv_drain(void);
 extern struct	anon_map *anonmap_alloc(size_t, size_t, int);
 extern void	anonmap_free(struct anon_map *);
 extern void	anonmap_purge(struct anon_map *);
@@ -443,7 +443,9 @@ void	hat_setstat(struct as *, caddr_t, size_t, uint_t);
  * Flags for hat_dup
  *
  * HAT_DUP_ALL dup entire address space
- * HAT_DUP_COW dup plus hat_clrattr(..PROT_WRITE) on newas
+ * HAT_DUP_COW write protect the parent's translations of a range being
+ *	shared copy-on-write with the child; the caller must have every
+ *	other lwp of the parent held
  */
 #define	HAT_DUP_ALL		1
 #define	HAT_DUP_COW		2
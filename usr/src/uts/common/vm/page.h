@@ -651,6 +651,7 @@ extern pad_mutex_t ph_mutex[];
 #define	PG_LOCAL	0x0080		/* alloc from given lgrp only */
 #define	PG_NORMALPRI	0x0100		/* PG_WAIT like priority, but */
 					/* non-blocking */
+#define	PG_ZERO		0x0200		/* prefer a pre-zeroed page */
 /*
  * When p_selock has the SE_EWANTED bit set, threads waiting for SE_EXCL
  * access are given priority over all other waiting threads.
@@ -735,6 +736,8 @@ page_t	*page_get_freelist(struct vnode *, u_offset_t, struct seg *,
 
 page_t	*page_get_cachelist(struct vnode *, u_offset_t, struct seg *,
 		caddr_t, uint_t, struct lgrp *);
+page_t	*page_get_zeroed(struct lgrp *, uint_t);
+void	page_zero_init(void);
 #if defined(__i386) || defined(__amd64)
 int	page_chk_freelist(uint_t);
 #endif
@@ -924,6 +927,10 @@ int	page_szc_user_filtered(size_t);
 /*
  * The p_state field holds what used to be the p_age and p_free
  * bits.  These fields are protected by p_selock (see above).
+ *
+ * P_ZEROED is only meaningful to the thread that created the page (see
+ * page_get_zeroed()), and is cleared once the page's "exclusive" lock is
+ * dropped.
  */
 #define	P_FREE		0x80		/* Page on free list */
 #define	P_NORELOC	0x40		/* Page is non-relocatable */
@@ -931,6 +938,7 @@ int	page_szc_user_filtered(size_t);
 #define	P_SWAP		0x10		/* belongs to vnode that is V_ISSWAP */
 #define	P_BOOTPAGES	0x08		/* member of bootpages list */
 #define	P_RAF		0x04		/* page retired at free */
+#define	P_ZEROED	0x02		/* page known to be zero filled */
 
 #define	PP_ISFREE(pp)		((pp)->p_state & P_FREE)
 #define	PP_ISAGED(pp)		(((pp)->p_state & P_FREE) && \
@@ -942,15 +950,17 @@ int	page_szc_user_filtered(size_t);
 #define	PP_ISSWAP(pp)		((pp)->p_state & P_SWAP)
 #define	PP_ISBOOTPAGES(pp)	((pp)->p_state & P_BOOTPAGES)
 #define	PP_ISRAF(pp)		((pp)->p_state & P_RAF)
+#define	PP_ISZEROED(pp)		((pp)->p_state & P_ZEROED)
 
-#define	PP_SETFREE(pp)		((pp)->p_state = ((pp)->p_state & ~P_MIGRATE) \
-				| P_FREE)
+#define	PP_SETFREE(pp)		((pp)->p_state = ((pp)->p_state & \
+				~(P_MIGRATE | P_ZEROED)) | P_FREE)
 #define	PP_SETAGED(pp)		ASSERT(PP_ISAGED(pp))
 #define	PP_SETNORELOC(pp)	((pp)->p_state |= P_NORELOC)
 #define	PP_SETMIGRATE(pp)	((pp)->p_state |= P_MIGRATE)
 #define	PP_SETSWAP(pp)		((pp)->p_state |= P_SWAP)
 #define	PP_SETBOOTPAGES(pp)	((pp)->p_state |= P_BOOTPAGES)
 #define	PP_SETRAF(pp)		((pp)->p_state |= P_RAF)
+#define	PP_SETZEROED(pp)	((pp)->p_state |= P_ZEROED)
 
 #define	PP_CLRFREE(pp)		((pp)->p_state &= ~P_FREE)
 #define	PP_CLRAGED(pp)		ASSERT(!PP_ISAGED(pp))
@@ -959,6 +969,7 @@ int	page_szc_user_filtered(size_t);
 #define	PP_CLRSWAP(pp)		((pp)->p_state &= ~P_SWAP)
 #define	PP_CLRBOOTPAGES(pp)	((pp)->p_state &= ~P_BOOTPAGES)
 #define	PP_CLRRAF(pp)		((pp)->p_state &= ~P_RAF)
+#define	PP_CLRZEROED(pp)	((pp)->p_state &= ~P_ZEROED)
 
 /*
  * Flags for page_t p_toxic, for tracking memory hardware errors.
@@ -663,6 +663,7 @@ page_unlock(page_t *pp)
 		panic("page_unlock: page %p is deleted", (void *)pp);
 	} else if (old < 0) {
 		THREAD_KPRI_RELEASE();
+		PP_CLRZEROED(pp);
 		pp->p_selock &= SE_EWANTED;
 		if (CV_HAS_WAITERS(&pp->p_cv))
 			cv_broadcast(&pp->p_cv);
@@ -739,6 +740,7 @@ page_downgrade(page_t *pp)
 	mutex_enter(pse);
 	excl_waiting =  pp->p_selock & SE_EWANTED;
 	THREAD_KPRI_RELEASE();
+	PP_CLRZEROED(pp);
 	pp->p_selock = SE_READER | excl_waiting;
 	if (CV_HAS_WAITERS(&pp->p_cv))
 		cv_broadcast(&pp->p_cv);
@@ -84,6 +84,9 @@ int		pvn_getpages(
 void		pvn_plist_init(struct page *pp, struct page **pl, size_t plsz,
 			u_offset_t off, size_t io_len, enum seg_rw rw);
 void		pvn_init(void);
+void		fsflush_dirty_vnode(struct vnode *vp);
+
+extern int	fsflush_scan_needed;
 
 /*
  * The value is put in p_hash to identify marker pages. It is safe to
@@ -441,10 +441,13 @@ segspt_create(struct seg *seg, caddr_t argsp)
 
 	/*
 	 * Set policy to affect initial allocation of pages in
-	 * anon_map_createpages()
+	 * anon_map_createpages(), unless placement was already given
+	 * with shmctl(SHM_ADVISE) before the first attach.
 	 */
-	(void) lgrp_shm_policy_set(LGRP_MEM_POLICY_DEFAULT, amp, anon_index,
-	    NULL, 0, ptob(npages));
+	if (lgrp_shm_policy_get(amp, anon_index, NULL, 0) == NULL) {
+		(void) lgrp_shm_policy_set(LGRP_MEM_POLICY_DEFAULT, amp,
+		    anon_index, NULL, 0, ptob(npages));
+	}
 
 	if (sptcargs->flags & SHM_PAGEABLE) {
 		size_t  share_sz;
@@ -1687,8 +1690,10 @@ segspt_shmattach(struct seg *seg, caddr_t *argsp)
 	shmd->shm_amp = shm_amp;
 	shmd->shm_sptseg = shmd_arg->shm_sptseg;
 
-	(void) lgrp_shm_policy_set(LGRP_MEM_POLICY_DEFAULT, shm_amp, 0,
-	    NULL, 0, seg->s_size);
+	if (lgrp_shm_policy_get(shm_amp, 0, NULL, 0) == NULL) {
+		(void) lgrp_shm_policy_set(LGRP_MEM_POLICY_DEFAULT, shm_amp, 0,
+		    NULL, 0, seg->s_size);
+	}
 
 	mutex_init(&shmd->shm_segfree_syncmtx, NULL, MUTEX_DEFAULT, NULL);
 
@@ -2932,7 +2937,8 @@ segspt_shmadvise(struct seg *seg, caddr_t addr, size_t len, uint_t behav)
 		(void) anon_disclaim(amp, pg_idx, len, behav, NULL);
 		ANON_LOCK_EXIT(&amp->a_rwlock);
 	} else if (lgrp_optimizations() && (behav == MADV_ACCESS_LWP ||
-	    behav == MADV_ACCESS_MANY || behav == MADV_ACCESS_DEFAULT)) {
+	    behav == MADV_ACCESS_MANY || behav == MADV_ACCESS_DEFAULT ||
+	    behav == MADV_ACCESS_INTERLEAVE)) {
 		int			already_set;
 		ulong_t			anon_index;
 		lgrp_mem_policy_t	policy;
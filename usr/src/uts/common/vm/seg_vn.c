@@ -61,6 +61,7 @@
 #include <sys/vm.h>
 #include <sys/dumphdr.h>
 #include <sys/lgrp.h>
+#include <sys/var.h>
 
 #include <vm/hat.h>
 #include <vm/as.h>
@@ -403,6 +404,70 @@ static void segvn_trupdate(void);
 static void segvn_trupdate_seg(struct seg *, segvn_data_t *, svntr_t *,
     ulong_t);
 
+/*
+ * Anonymous MAP_PRIVATE segments (heap, stack and large aligned mmaps) are
+ * given a large preferred page size by map_pgszcvec(), but a range that was
+ * first faulted in when no large page was free, or that was populated one
+ * small page at a time by COW, stays mapped with small pages for the life of
+ * the mapping.  The segvn_lpg_promote thread periodically walks the address
+ * spaces of user processes looking for large page aligned ranges of such
+ * segments that are fully populated with small, privately owned, recently
+ * referenced pages.  It unloads their translations, so that the next fault on
+ * the range goes through anon_map_getpages(), which relocates the existing
+ * small pages into a newly allocated large page and maps it with a single
+ * large translation.  Nothing is unloaded when memory is short, or when
+ * page_chk_freelist() doesn't think a large page is likely to be available.
+ *
+ * Promotion can be disabled per zone with ZONE_ATTR_LPG_PROMOTE.
+ */
+#if defined(__x86)
+int		segvn_lpg_promote = 1;
+#else
+int		segvn_lpg_promote = 0;
+#endif
+int		segvn_lpg_promote_time = 10;	/* seconds between scans */
+ulong_t		segvn_lpg_promote_max = 64;	/* ranges unloaded per scan */
+
+segvn_lpgstat_t segvn_lpgstat = {
+	{ "scanned",		KSTAT_DATA_ULONG },
+	{ "promotions",		KSTAT_DATA_ULONG },
+	{ "demotions",		KSTAT_DATA_ULONG },
+	{ "failures",		KSTAT_DATA_ULONG },
+};
+
+static void segvn_lpg_promote_thread(void);
+static void segvn_lpg_promote_scan(void);
+static ulong_t segvn_lpg_promote_as(struct as *, ulong_t);
+static int segvn_lpg_promote_range(struct seg *, caddr_t, uint_t);
+
+/*
+ * A thread's memory is allocated near its home lgroup, but stays where it
+ * is when the dispatcher later moves the thread to another lgroup; unless
+ * the application asks for next-touch migration with MADV_ACCESS_LWP, a
+ * rebalanced long running process keeps using remote memory.  When
+ * lgrp_move_thread() rehomes a thread it sets p_lgrp_rehomed, and the
+ * segvn_pmig thread periodically walks the anonymous private segments of
+ * such processes looking for recently referenced pages that are not in any
+ * lgroup the process has threads homed to.  Those are marked for migration
+ * with page_mark_migrate(), so that the next fault on each moves it to the
+ * home lgroup of the faulting thread.  At most segvn_pmig_max pages are
+ * marked per scan.
+ */
+int		segvn_pmig = 1;
+int		segvn_pmig_time = 5;		/* seconds between scans */
+pgcnt_t		segvn_pmig_max = 16384;		/* pages marked per scan */
+
+segvn_pmigstat_t segvn_pmigstat = {
+	{ "procs",		KSTAT_DATA_ULONG },
+	{ "scanned",		KSTAT_DATA_ULONG },
+	{ "marked",		KSTAT_DATA_ULONG },
+};
+
+static void segvn_pmig_thread(void);
+static void segvn_pmig_scan(void);
+static pgcnt_t segvn_pmig_as(struct as *, klgrpset_t, pgcnt_t);
+static int segvn_pmig_page(struct seg *, caddr_t, klgrpset_t);
+
 /*
  * Initialize segvn data structures
  */
@@ -412,6 +477,7 @@ segvn_init(void)
 	uint_t maxszc;
 	uint_t szc;
 	size_t pgsz;
+	kstat_t *ksp;
 
 	segvn_cache = kmem_cache_create("segvn_cache",
 	    sizeof (struct segvn_data), 0,
@@ -494,6 +560,35 @@ segvn_init(void)
 	}
 #endif
 
+	ksp = kstat_create("unix", 0, "segvn_lpgstat", "vm", KSTAT_TYPE_NAMED,
+	    sizeof (segvn_lpgstat) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp) {
+		ksp->ks_data = (void *)&segvn_lpgstat;
+		kstat_install(ksp);
+	}
+
+	ksp = kstat_create("unix", 0, "segvn_pmigstat", "vm",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (segvn_pmigstat) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp) {
+		ksp->ks_data = (void *)&segvn_pmigstat;
+		kstat_install(ksp);
+	}
+
+	if (lgrp_optimizations() && segvn_pmig) {
+		(void) thread_create(NULL, 0, segvn_pmig_thread,
+		    NULL, 0, &p0, TS_RUN, minclsyspri);
+	}
+
+	if (segvn_lpg_disable != 0 || segvn_maxpgszc == 0)
+		segvn_lpg_promote = 0;
+	if (segvn_lpg_promote) {
+		(void) thread_create(NULL, 0, segvn_lpg_promote_thread,
+		    NULL, 0, &p0, TS_RUN, minclsyspri);
+	}
+
 	if (!ISP2(segvn_pglock_comb_balign) ||
 	    segvn_pglock_comb_balign < PAGESIZE) {
 		segvn_pglock_comb_balign = 1UL << 16; /* 64K */
@@ -1735,8 +1830,9 @@ retry:
 					    newsvd->amp->ahp, 0, seg->s_size);
 				}
 
-				hat_clrattr(seg->s_as->a_hat, seg->s_base,
-				    seg->s_size, PROT_WRITE);
+				(void) hat_dup(seg->s_as->a_hat,
+				    newseg->s_as->a_hat, seg->s_base,
+				    seg->s_size, HAT_DUP_COW);
 			}
 		}
 	}
@@ -4801,6 +4897,8 @@ segvn_fault_anonpages(struct hat *hat, struct seg *seg, caddr_t lpgaddr,
 		 * have relocated locked pages.
 		 */
 		ASSERT(ierr == -1 || ierr == -2);
+		if (ierr == -1 && szc == seg->s_szc)
+			SEGVN_LPG_ADDSTAT(fail);
 
 		if (segvn_anypgsz) {
 			ASSERT(ierr == -2 || szc != 0);
@@ -6793,6 +6891,7 @@ segvn_demote_range(
 		return (err);
 	}
 	ASSERT(badseg1->s_szc == 0);
+	SEGVN_LPG_ADDSTAT(demote);
 
 	if (szc > 1 && (tszcvec = P2PHASE(szcvec, 1 << szc)) > 1) {
 		uint_t tszc = highbit(tszcvec) - 1;
@@ -6835,6 +6934,7 @@ segvn_demote_range(
 		return (err);
 	}
 	ASSERT(badseg2->s_szc == 0);
+	SEGVN_LPG_ADDSTAT(demote);
 
 	if (szc > 1 && (tszcvec = P2PHASE(szcvec, 1 << szc)) > 1) {
 		uint_t tszc = highbit(tszcvec) - 1;
@@ -8058,6 +8158,7 @@ out:
  *	MADV_ACCESS_LWP	- Next LWP will access heavily
  *	MADV_ACCESS_MANY- Many LWPs or processes will access heavily
  *	MADV_PURGE	- Contents will be immediately discarded
+ *	MADV_ACCESS_INTERLEAVE- Spread pages across lgroups by offset
  */
 static int
 segvn_advise(struct seg *seg, caddr_t addr, size_t len, uint_t behav)
@@ -8100,13 +8201,15 @@ segvn_advise(struct seg *seg, caddr_t addr, size_t len, uint_t behav)
 	if ((behav == MADV_SEQUENTIAL &&
 	    (seg->s_szc != 0 || HAT_IS_REGION_COOKIE_VALID(svd->rcookie))) ||
 	    (!lgrp_optimizations() && (behav == MADV_ACCESS_DEFAULT ||
-	    behav == MADV_ACCESS_LWP || behav == MADV_ACCESS_MANY))) {
+	    behav == MADV_ACCESS_LWP || behav == MADV_ACCESS_MANY ||
+	    behav == MADV_ACCESS_INTERLEAVE))) {
 		SEGVN_LOCK_EXIT(seg->s_as, &svd->lock);
 		return (0);
 	}
 
 	if (behav == MADV_SEQUENTIAL || behav == MADV_ACCESS_DEFAULT ||
-	    behav == MADV_ACCESS_LWP || behav == MADV_ACCESS_MANY) {
+	    behav == MADV_ACCESS_LWP || behav == MADV_ACCESS_MANY ||
+	    behav == MADV_ACCESS_INTERLEAVE) {
 		/*
 		 * Since we are going to unload hat mappings
 		 * we first have to flush the cache. Otherwise
@@ -8225,6 +8328,7 @@ segvn_advise(struct seg *seg, caddr_t addr, size_t len, uint_t behav)
 		switch (behav) {
 		case MADV_ACCESS_LWP:
 		case MADV_ACCESS_MANY:
+		case MADV_ACCESS_INTERLEAVE:
 		case MADV_ACCESS_DEFAULT:
 			/*
 			 * Set memory allocation policy for this segment
@@ -8343,6 +8447,7 @@ segvn_advise(struct seg *seg, caddr_t addr, size_t len, uint_t behav)
 
 		case MADV_ACCESS_LWP:
 		case MADV_ACCESS_MANY:
+		case MADV_ACCESS_INTERLEAVE:
 		case MADV_ACCESS_DEFAULT:
 			/*
 			 * Set memory allocation policy for portion of this
@@ -10331,3 +10436,365 @@ segvn_trupdate_seg(struct seg *seg,
 
 	SEGVN_TR_ADDSTAT(asyncrepl);
 }
+
+static void
+segvn_lpg_promote_thread(void)
+{
+	callb_cpr_t cpr_info;
+	kmutex_t cpr_lock;	/* just for CPR stuff */
+
+	mutex_init(&cpr_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	CALLB_CPR_INIT(&cpr_info, &cpr_lock,
+	    callb_generic_cpr, "segvn_lpg_promote");
+
+	for (;;) {
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_BEGIN(&cpr_info);
+		mutex_exit(&cpr_lock);
+		delay(MAX(segvn_lpg_promote_time, 1) * hz);
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_END(&cpr_info, &cpr_lock);
+		mutex_exit(&cpr_lock);
+		if (segvn_lpg_promote)
+			segvn_lpg_promote_scan();
+	}
+}
+
+/*
+ * Walk the process table looking for address spaces with ranges worth
+ * promoting.  As in vmu_calculate(), pidlock can't be held across the scan
+ * of each address space, so each process is held with P_PR_LOCK instead to
+ * keep it from exiting or exec'ing while we look at it.
+ */
+static void
+segvn_lpg_promote_scan(void)
+{
+	proc_t *p;
+	struct as *as;
+	ulong_t budget = segvn_lpg_promote_max;
+	int i;
+
+	mutex_enter(&pidlock);
+	for (i = 0; i < v.v_proc && budget != 0; i++) {
+		p = pid_entry(i);
+		if (p == NULL)
+			continue;
+
+		mutex_enter(&p->p_lock);
+		mutex_exit(&pidlock);
+
+		if (panicstr) {
+			mutex_exit(&p->p_lock);
+			return;
+		}
+
+		/*
+		 * Skip processes that are busy with /proc, and vfork()ed
+		 * children, which borrow the address space of their parent.
+		 */
+		if (!p->p_zone->zone_lpg_promote || (p->p_flag & SVFORK) ||
+		    sprtrylock_proc(p) != 0) {
+			mutex_exit(&p->p_lock);
+			mutex_enter(&pidlock);
+			continue;
+		}
+		as = p->p_as;
+		mutex_exit(&p->p_lock);
+
+		if (as != &kas)
+			budget = segvn_lpg_promote_as(as, budget);
+
+		mutex_enter(&p->p_lock);
+		sprunlock(p);
+		mutex_enter(&pidlock);
+	}
+	mutex_exit(&pidlock);
+}
+
+/*
+ * Look for promotable ranges in the anonymous private segments of an address
+ * space, unloading at most budget of them.  Returns the remaining budget.
+ * Locks are only tried for, since the process may be actively faulting or
+ * changing its mappings; we'll look again on the next scan.
+ */
+static ulong_t
+segvn_lpg_promote_as(struct as *as, ulong_t budget)
+{
+	struct seg *seg;
+	struct segvn_data *svd;
+	caddr_t a, lpgaddr, lpgeaddr;
+	size_t pgsz;
+	uint_t szc;
+
+	if (!AS_LOCK_TRYENTER(as, RW_READER))
+		return (budget);
+
+	for (seg = AS_SEGFIRST(as); seg != NULL && budget != 0;
+	    seg = AS_SEGNEXT(as, seg)) {
+		if (seg->s_ops != &segvn_ops || (szc = seg->s_szc) == 0)
+			continue;
+		svd = (struct segvn_data *)seg->s_data;
+		if (svd->type != MAP_PRIVATE || svd->vp != NULL ||
+		    svd->amp == NULL || (svd->flags & MAP_NORESERVE) ||
+		    svd->tr_state != SEGVN_TR_OFF ||
+		    HAT_IS_REGION_COOKIE_VALID(svd->rcookie))
+			continue;
+
+		pgsz = page_get_pagesize(szc);
+		lpgaddr = (caddr_t)P2ROUNDUP((uintptr_t)seg->s_base, pgsz);
+		lpgeaddr = (caddr_t)P2ALIGN((uintptr_t)(seg->s_base +
+		    seg->s_size), pgsz);
+		if (lpgaddr >= lpgeaddr)
+			continue;
+
+		if (!SEGVN_LOCK_TRYENTER(as, &svd->lock, RW_WRITER))
+			continue;
+		if (svd->softlockcnt != 0) {
+			SEGVN_LOCK_EXIT(as, &svd->lock);
+			continue;
+		}
+		ANON_LOCK_ENTER(&svd->amp->a_rwlock, RW_READER);
+		for (a = lpgaddr; a < lpgeaddr && budget != 0; a += pgsz) {
+			if (freemem < desfree + page_get_pagecnt(szc)) {
+				budget = 0;
+				break;
+			}
+#if defined(__i386) || defined(__amd64)
+			if (!page_chk_freelist(szc)) {
+				budget = 0;
+				break;
+			}
+#endif
+			SEGVN_LPG_ADDSTAT(scan);
+			if (segvn_lpg_promote_range(seg, a, szc)) {
+				hat_unload_callback(as->a_hat, a, pgsz,
+				    HAT_UNLOAD, NULL);
+				SEGVN_LPG_ADDSTAT(promote);
+				budget--;
+			}
+		}
+		ANON_LOCK_EXIT(&svd->amp->a_rwlock);
+		SEGVN_LOCK_EXIT(as, &svd->lock);
+	}
+	AS_LOCK_EXIT(as);
+
+	return (budget);
+}
+
+/*
+ * Return 1 if the large page aligned range at addr is worth promoting: every
+ * constituent page must be resident, privately owned by this segment, not
+ * locked, not already part of a large page, and referenced since pageout
+ * last cleared its reference bit.
+ */
+static int
+segvn_lpg_promote_range(struct seg *seg, caddr_t addr, uint_t szc)
+{
+	struct segvn_data *svd = (struct segvn_data *)seg->s_data;
+	struct anon_map *amp = svd->amp;
+	pgcnt_t pgcnt = page_get_pagecnt(szc);
+	ulong_t an_idx = svd->anon_index + seg_page(seg, addr);
+	struct anon *ap;
+	struct vnode *vp;
+	u_offset_t off;
+	page_t *pp;
+	pgcnt_t i;
+	int hot;
+
+	ASSERT(SEGVN_WRITE_HELD(seg->s_as, &svd->lock));
+	ASSERT(IS_P2ALIGNED(an_idx, pgcnt));
+
+	for (i = 0; i < pgcnt; i++) {
+		ap = anon_get_ptr(amp->ahp, an_idx + i);
+		if (ap == NULL || ap->an_refcnt != 1)
+			return (0);
+		swap_xlate(ap, &vp, &off);
+		if ((pp = page_lookup_nowait(vp, off, SE_SHARED)) == NULL)
+			return (0);
+		hot = (pp->p_szc < szc && pp->p_lckcnt == 0 &&
+		    pp->p_cowcnt == 0 && (hat_pagesync(pp,
+		    HAT_SYNC_DONTZERO | HAT_SYNC_STOPON_REF) & P_REF));
+		page_unlock(pp);
+		if (!hot)
+			return (0);
+	}
+	return (1);
+}
+
+static void
+segvn_pmig_thread(void)
+{
+	callb_cpr_t cpr_info;
+	kmutex_t cpr_lock;	/* just for CPR stuff */
+
+	mutex_init(&cpr_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	CALLB_CPR_INIT(&cpr_info, &cpr_lock,
+	    callb_generic_cpr, "segvn_pmig");
+
+	for (;;) {
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_BEGIN(&cpr_info);
+		mutex_exit(&cpr_lock);
+		delay(MAX(segvn_pmig_time, 1) * hz);
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_END(&cpr_info, &cpr_lock);
+		mutex_exit(&cpr_lock);
+		if (segvn_pmig)
+			segvn_pmig_scan();
+	}
+}
+
+/*
+ * Walk the process table looking for processes that had a thread rehomed
+ * since they were last looked at, holding each with P_PR_LOCK as in
+ * segvn_lpg_promote_scan().  A process whose scan is cut short by the
+ * budget keeps p_lgrp_rehomed set, so the next scan picks it up again.
+ */
+static void
+segvn_pmig_scan(void)
+{
+	proc_t *p;
+	struct as *as;
+	klgrpset_t home;
+	pgcnt_t budget = segvn_pmig_max;
+	int i;
+
+	mutex_enter(&pidlock);
+	for (i = 0; i < v.v_proc && budget != 0; i++) {
+		p = pid_entry(i);
+		if (p == NULL || !p->p_lgrp_rehomed)
+			continue;
+
+		mutex_enter(&p->p_lock);
+		mutex_exit(&pidlock);
+
+		if (panicstr) {
+			mutex_exit(&p->p_lock);
+			return;
+		}
+
+		if ((p->p_flag & SVFORK) || sprtrylock_proc(p) != 0) {
+			mutex_exit(&p->p_lock);
+			mutex_enter(&pidlock);
+			continue;
+		}
+		p->p_lgrp_rehomed = 0;
+		home = p->p_lgrpset;
+		as = p->p_as;
+		mutex_exit(&p->p_lock);
+
+		if (as != &kas && home != 0) {
+			SEGVN_PMIG_ADDSTAT(procs, 1);
+			budget = segvn_pmig_as(as, home, budget);
+			if (budget == 0)
+				p->p_lgrp_rehomed = 1;
+		}
+
+		mutex_enter(&p->p_lock);
+		sprunlock(p);
+		mutex_enter(&pidlock);
+	}
+	mutex_exit(&pidlock);
+}
+
+/*
+ * Mark the hot, remote pages of the anonymous private segments of an address
+ * space for migration, at most budget pages of them.  Only segments using
+ * the next-touch policy are looked at, since for the others lgrp_mem_choose()
+ * wouldn't pick the faulting thread's lgroup anyway.  Returns the remaining
+ * budget.
+ */
+static pgcnt_t
+segvn_pmig_as(struct as *as, klgrpset_t home, pgcnt_t budget)
+{
+	struct seg *seg;
+	struct segvn_data *svd;
+	caddr_t a, eaddr;
+	size_t pgsz;
+
+	if (!AS_LOCK_TRYENTER(as, RW_READER))
+		return (budget);
+
+	for (seg = AS_SEGFIRST(as); seg != NULL && budget != 0;
+	    seg = AS_SEGNEXT(as, seg)) {
+		if (seg->s_ops != &segvn_ops)
+			continue;
+		svd = (struct segvn_data *)seg->s_data;
+		if (svd->type != MAP_PRIVATE || svd->amp == NULL ||
+		    svd->tr_state != SEGVN_TR_OFF ||
+		    svd->policy_info.mem_policy != LGRP_MEM_POLICY_NEXT)
+			continue;
+
+		if (!SEGVN_LOCK_TRYENTER(as, &svd->lock, RW_READER))
+			continue;
+		if (svd->softlockcnt != 0) {
+			SEGVN_LOCK_EXIT(as, &svd->lock);
+			continue;
+		}
+		pgsz = page_get_pagesize(seg->s_szc);
+		a = (caddr_t)P2ALIGN((uintptr_t)seg->s_base, pgsz);
+		eaddr = seg->s_base + seg->s_size;
+		for (; a < eaddr && budget != 0; a += pgsz) {
+			if (a < seg->s_base || a + pgsz > eaddr)
+				continue;
+			SEGVN_PMIG_ADDSTAT(scan, btop(pgsz));
+			if (!segvn_pmig_page(seg, a, home))
+				continue;
+			page_mark_migrate(seg, a, pgsz, svd->amp,
+			    svd->anon_index, NULL, 0, 0);
+			SEGVN_PMIG_ADDSTAT(mark, btop(pgsz));
+			budget -= MIN(budget, btop(pgsz));
+		}
+		SEGVN_LOCK_EXIT(as, &svd->lock);
+	}
+	AS_LOCK_EXIT(as);
+
+	return (budget);
+}
+
+/*
+ * Return 1 if the (possibly large) anonymous page at addr is privately owned
+ * by this segment, not locked, referenced since pageout last cleared its
+ * reference bit, and in none of the lgroups in home.
+ */
+static int
+segvn_pmig_page(struct seg *seg, caddr_t addr, klgrpset_t home)
+{
+	struct segvn_data *svd = (struct segvn_data *)seg->s_data;
+	struct anon_map *amp = svd->amp;
+	ulong_t an_idx = svd->anon_index + seg_page(seg, addr);
+	anon_sync_obj_t cookie;
+	struct anon *ap;
+	struct vnode *vp;
+	u_offset_t off;
+	lgrp_t *lgrp;
+	page_t *pp;
+	int hot;
+
+	ASSERT(SEGVN_LOCK_HELD(seg->s_as, &svd->lock));
+
+	ANON_LOCK_ENTER(&amp->a_rwlock, RW_READER);
+	anon_array_enter(amp, an_idx, &cookie);
+	ap = anon_get_ptr(amp->ahp, an_idx);
+	if (ap == NULL || ap->an_refcnt != 1) {
+		anon_array_exit(&cookie);
+		ANON_LOCK_EXIT(&amp->a_rwlock);
+		return (0);
+	}
+	swap_xlate(ap, &vp, &off);
+	anon_array_exit(&cookie);
+	ANON_LOCK_EXIT(&amp->a_rwlock);
+
+	if ((pp = page_lookup_nowait(vp, off, SE_SHARED)) == NULL)
+		return (0);
+	lgrp = lgrp_pfn_to_lgrp(page_pptonum(pp));
+	hot = (lgrp != NULL && !klgrpset_ismember(home, lgrp->lgrp_id) &&
+	    !PP_ISMIGRATE(pp) && pp->p_lckcnt == 0 && pp->p_cowcnt == 0 &&
+	    (hat_pagesync(pp, HAT_SYNC_DONTZERO | HAT_SYNC_STOPON_REF) &
+	    P_REF));
+	page_unlock(pp);
+
+	return (hot);
+}
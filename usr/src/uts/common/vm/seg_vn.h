@@ -182,6 +182,12 @@ typedef struct	segvn_data {
 #define	SEGVN_TR_ADDSTAT(stat)						\
 	segvn_textrepl_stats[CPU->cpu_id].tr_stat_##stat++
 
+#define	SEGVN_LPG_ADDSTAT(stat)						\
+	segvn_lpgstat.lpg_##stat.value.ul++
+
+#define	SEGVN_PMIG_ADDSTAT(stat, n)					\
+	segvn_pmigstat.pmig_##stat.value.ul += (n)
+
 #define	SEGVN_DATA(seg)	((struct segvn_data *)(seg)->s_data)
 #define	SEG_IS_PARTIAL_RESV(seg)	\
 	((seg)->s_ops == &segvn_ops && SEGVN_DATA(seg) != NULL && \
@@ -227,6 +233,22 @@ typedef struct svntr_stats {
 	ulong_t		tr_stat_newamp;	  /* number of new amp allocs for TR */
 } svntr_stats_t;
 
+/*
+ * kstat statistics for large page promotion of anonymous memory
+ */
+typedef struct segvn_lpgstat {
+	kstat_named_t	lpg_scan;	/* large page ranges examined */
+	kstat_named_t	lpg_promote;	/* ranges unmapped for promotion */
+	kstat_named_t	lpg_demote;	/* large page segments demoted */
+	kstat_named_t	lpg_fail;	/* large page allocation failures */
+} segvn_lpgstat_t;
+
+typedef struct segvn_pmigstat {
+	kstat_named_t	pmig_procs;	/* rehomed processes scanned */
+	kstat_named_t	pmig_scan;	/* pages examined */
+	kstat_named_t	pmig_mark;	/* pages marked for migration */
+} segvn_pmigstat_t;
+
 extern void	segvn_init(void);
 extern int	segvn_create(struct seg *, void *);
 
@@ -131,6 +131,7 @@ int anon_debug;
 kmutex_t	anoninfo_lock;
 struct		k_anoninfo k_anoninfo;
 ani_free_t	*ani_free_pool;
+ani_resv_t	*ani_resv_pool;
 pad_mutex_t	anon_array_lock[ANON_LOCKSIZE];
 kcondvar_t	anon_array_cv[ANON_LOCKSIZE];
 
@@ -243,6 +244,13 @@ anon_init(void)
 	/* Round ani_free_pool to cacheline boundary to avoid false sharing. */
 	ani_free_pool = (ani_free_t *)P2ROUNDUP((uintptr_t)tmp, 64);
 
+	tmp = kmem_zalloc((ANI_MAX_POOL * sizeof (ani_resv_t)) + 63, KM_SLEEP);
+	ani_resv_pool = (ani_resv_t *)P2ROUNDUP((uintptr_t)tmp, 64);
+	for (i = 0; i < ANI_MAX_POOL; i++) {
+		mutex_init(&ani_resv_pool[i].ani_resv_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
+
 	anon_vp = vn_alloc(KM_SLEEP);
 	vn_setops(anon_vp, swap_vnodeops);
 	anon_vp->v_type = VREG;
@@ -763,6 +771,128 @@ set_anoninfo(void)
 	}
 }
 
+/*
+ * Reservations of up to anon_resv_batch pages are taken from and given
+ * back to a per-CPU cache of reserved physical swap (ani_resv_pool),
+ * which is refilled or trimmed by anon_resv_batch pages at a time under
+ * anoninfo_lock.  A cache holds at most 2 * anon_resv_batch pages, and
+ * is only refilled while more than anon_resv_slack() pages of physical
+ * swap are unreserved, so the caches never hold physical swap that a
+ * reservation needs: anon_resvmem() drains them before it falls back on
+ * memory swap.  Setting anon_resv_batch to 0 disables the caches.
+ */
+pgcnt_t anon_resv_batch = 64;
+
+#define	ANI_RESV_CPU()	\
+	(&ani_resv_pool[CPU->cpu_seqid & (ANI_MAX_POOL - 1)])
+
+static pgcnt_t
+anon_resv_slack(void)
+{
+	return (2 * anon_resv_batch * (max_cpu_seqid_ever + 1));
+}
+
+/*
+ * Take npages of physical swap from this CPU's cache, refilling it from
+ * k_anoninfo if need be.  Returns B_FALSE if the reservation has to go
+ * through anon_resvmem()'s slow path.
+ */
+static boolean_t
+anon_resv_cached(pgcnt_t npages)
+{
+	ani_resv_t *arp;
+	pgcnt_t refill;
+
+	if (npages > anon_resv_batch)
+		return (B_FALSE);
+
+	arp = ANI_RESV_CPU();
+	mutex_enter(&arp->ani_resv_lock);
+	if (arp->ani_resv_pages < npages) {
+		refill = npages + anon_resv_batch - arp->ani_resv_pages;
+
+		mutex_enter(&anoninfo_lock);
+		ASSERT(k_anoninfo.ani_max >= k_anoninfo.ani_phys_resv);
+		if (k_anoninfo.ani_max - k_anoninfo.ani_phys_resv <
+		    refill + anon_resv_slack()) {
+			mutex_exit(&anoninfo_lock);
+			mutex_exit(&arp->ani_resv_lock);
+			return (B_FALSE);
+		}
+		k_anoninfo.ani_phys_resv += refill;
+		mutex_exit(&anoninfo_lock);
+		arp->ani_resv_pages += refill;
+	}
+	arp->ani_resv_pages -= npages;
+	mutex_exit(&arp->ani_resv_lock);
+
+	return (B_TRUE);
+}
+
+/*
+ * Give npages of physical swap back to this CPU's cache, trimming it if
+ * it grows too large.  Only used when none of the reservation being
+ * given back could have come from memory swap; returns B_FALSE if the
+ * unreservation has to go through anon_unresvmem()'s slow path.
+ */
+static boolean_t
+anon_unresv_cached(pgcnt_t npages)
+{
+	ani_resv_t *arp;
+	pgcnt_t trim;
+
+	if (npages > anon_resv_batch ||
+	    k_anoninfo.ani_mem_resv > k_anoninfo.ani_locked_swap)
+		return (B_FALSE);
+
+	arp = ANI_RESV_CPU();
+	mutex_enter(&arp->ani_resv_lock);
+	arp->ani_resv_pages += npages;
+	if (arp->ani_resv_pages > 2 * anon_resv_batch) {
+		trim = arp->ani_resv_pages - anon_resv_batch;
+		arp->ani_resv_pages -= trim;
+
+		mutex_enter(&anoninfo_lock);
+		ASSERT(k_anoninfo.ani_phys_resv >= trim);
+		k_anoninfo.ani_phys_resv -= trim;
+		mutex_exit(&anoninfo_lock);
+	}
+	mutex_exit(&arp->ani_resv_lock);
+
+	return (B_TRUE);
+}
+
+/*
+ * Give all the physical swap held in the per-CPU caches back to
+ * k_anoninfo.  Called when physical swap runs short and before a swap
+ * device is deleted; must not be called with anoninfo_lock held.
+ */
+void
+anon_resv_drain(void)
+{
+	ani_resv_t *arp;
+	pgcnt_t pages;
+	int ix;
+
+	ASSERT(!MUTEX_HELD(&anoninfo_lock));
+
+	for (ix = 0; ix < ANI_MAX_POOL; ix++) {
+		arp = &ani_resv_pool[ix];
+		if (arp->ani_resv_pages == 0)
+			continue;
+
+		mutex_enter(&arp->ani_resv_lock);
+		pages = arp->ani_resv_pages;
+		arp->ani_resv_pages = 0;
+
+		mutex_enter(&anoninfo_lock);
+		ASSERT(k_anoninfo.ani_phys_resv >= pages);
+		k_anoninfo.ani_phys_resv -= pages;
+		mutex_exit(&anoninfo_lock);
+		mutex_exit(&arp->ani_resv_lock);
+	}
+}
+
 /*
  * Reserve anon space.
  *
@@ -805,6 +935,18 @@ anon_resvmem(size_t size, boolean_t takemem, zone_t *zone, int tryhard)
 
 		mutex_exit(&p->p_lock);
 	}
+
+	if (takemem && anon_resv_cached(npages))
+		return (1);
+
+	/*
+	 * Physical swap sitting in the per-CPU caches is put back before
+	 * we settle for memory swap or fail.
+	 */
+	if (k_anoninfo.ani_max - k_anoninfo.ani_phys_resv <
+	    npages + anon_resv_slack())
+		anon_resv_drain();
+
 	mutex_enter(&anoninfo_lock);
 
 	/*
@@ -932,6 +1074,9 @@ anon_unresvmem(size_t size, zone_t *zone)
 	if (zone != NULL)
 		rctl_decr_swap(zone, ptob(npages));
 
+	if (anon_unresv_cached(npages))
+		return;
+
 	mutex_enter(&anoninfo_lock);
 
 	ASSERT(k_anoninfo.ani_mem_resv >= k_anoninfo.ani_locked_swap);
@@ -2825,7 +2970,12 @@ anon_zero(struct seg *seg, caddr_t addr, struct anon **app, struct cred *cred)
 	}
 	pp = anon_pl[0];
 
-	pagezero(pp, 0, PAGESIZE);	/* XXX - should set mod bit */
+	/*
+	 * The page may have come from a pre-zeroed pool; see
+	 * page_get_zeroed().
+	 */
+	if (!PP_ISZEROED(pp))
+		pagezero(pp, 0, PAGESIZE);	/* XXX - should set mod bit */
 	page_downgrade(pp);
 	CPU_STATS_ADD_K(vm, zfod, 1);
 	hat_setrefmod(pp);	/* mark as modified so pageout writes back */
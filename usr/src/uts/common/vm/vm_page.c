@@ -256,7 +256,7 @@ uint_t	page_reclaim_zero_locked;
 uint_t	page_rename_exists;
 uint_t	page_rename_count;
 
-uint_t	page_lookup_cnt[20];
+uint_t	page_lookup_cnt[22];
 uint_t	page_lookup_nowait_cnt[10];
 uint_t	page_find_cnt;
 uint_t	page_exists_cnt;
@@ -331,6 +331,13 @@ enum lpap {
 
 enum lpap lpg_alloc_prefer = LPAP_DEFAULT;
 
+/*
+ * /etc/system tunable to control how many times page_lookup_create() will
+ * wait for a busy page without holding the page hash mutex before falling
+ * back to waiting with it held.  See the comment in page_lookup_create().
+ */
+int page_lookup_nolock_waits = 2;
+
 static void page_init_mem_config(void);
 static int page_do_hashin(page_t *, vnode_t *, u_offset_t);
 static void page_do_hashout(page_t *);
@@ -383,6 +390,7 @@ vm_init(void)
 	page_retire_init();
 	vm_usage_init();
 	page_capture_init();
+	page_zero_init();
 }
 
 /*
@@ -726,6 +734,7 @@ page_lookup_create(
 	ulong_t		index;
 	uint_t		hash_locked;
 	uint_t		es;
+	int		nolock_waits;
 
 	ASSERT(MUTEX_NOT_HELD(page_vnode_mutex(vp)));
 	VM_STAT_ADD(page_lookup_cnt[0]);
@@ -738,6 +747,7 @@ page_lookup_create(
 	 * this lock is held.
 	 */
 	hash_locked = 0;
+	nolock_waits = 0;
 	index = PAGE_HASH_FUNC(vp, off);
 	phm = NULL;
 top:
@@ -749,18 +759,42 @@ top:
 		if (!hash_locked) {
 			VM_STAT_ADD(page_lookup_cnt[2]);
 			if (!page_try_reclaim_lock(pp, se, es)) {
+				if (nolock_waits++ >=
+				    page_lookup_nolock_waits) {
+					/*
+					 * Acquire the phm.  Then next time,
+					 * page_lock() will be called, causing
+					 * a wait if the page is busy.  Just
+					 * looping would get pretty boring.
+					 */
+					VM_STAT_ADD(page_lookup_cnt[3]);
+					phm = PAGE_HASH_MUTEX(index);
+					mutex_enter(phm);
+					hash_locked = 1;
+					goto top;
+				}
 				/*
-				 * On a miss, acquire the phm.  Then
-				 * next time, page_lock() will be called,
-				 * causing a wait if the page is busy.
-				 * just looping with page_trylock() would
-				 * get pretty boring.
+				 * The page is busy.  Rather than taking the
+				 * phm and waiting in page_lock(), which has
+				 * every waiter on a hot page re-enter the
+				 * phm as soon as the page is unlocked, wait
+				 * for the page itself without the phm.  The
+				 * page may change identity while we sleep;
+				 * that's caught by the reconfirmation below.
+				 * A free page can't be reclaimed without the
+				 * phm, since its identity isn't stable until
+				 * it's locked, so those go round again.
 				 */
-				VM_STAT_ADD(page_lookup_cnt[3]);
-				phm = PAGE_HASH_MUTEX(index);
-				mutex_enter(phm);
-				hash_locked = 1;
-				goto top;
+				VM_STAT_ADD(page_lookup_cnt[20]);
+				if (!page_lock_es(pp, se, NULL,
+				    P_NO_RECLAIM, es)) {
+					goto top;
+				}
+				if (PP_ISFREE(pp) && !PAGE_EXCL(pp)) {
+					VM_STAT_ADD(page_lookup_cnt[21]);
+					page_unlock(pp);
+					goto top;
+				}
 			}
 		} else {
 			VM_STAT_ADD(page_lookup_cnt[4]);
@@ -2270,8 +2304,8 @@ page_create_va(vnode_t *vp, u_offset_t off, size_t bytes, uint_t flags,
 		panic("page_create: invalid flags");
 		/*NOTREACHED*/
 	}
-	ASSERT((flags & ~(PG_EXCL | PG_WAIT |
-	    PG_NORELOC | PG_PANIC | PG_PUSHPAGE | PG_NORMALPRI)) == 0);
+	ASSERT((flags & ~(PG_EXCL | PG_WAIT | PG_NORELOC | PG_PANIC |
+	    PG_PUSHPAGE | PG_NORMALPRI | PG_ZERO)) == 0);
 	    /* but no others */
 
 	pages_req = npages = btopr(bytes);
@@ -2397,8 +2431,20 @@ top:
 			 * the physical memory
 			 */
 			lgrp = lgrp_mem_choose(seg, vaddr, PAGESIZE);
-			npp = page_get_freelist(vp, off, seg, vaddr, PAGESIZE,
-			    flags | PG_MATCH_COLOR, lgrp);
+
+			/*
+			 * If the caller is going to zero the page, try for
+			 * one that has been zeroed already.  Pool pages were
+			 * taken out of freemem when they were zeroed, so give
+			 * back the page we reserved above.
+			 */
+			if ((flags & PG_ZERO) &&
+			    (npp = page_get_zeroed(lgrp, flags)) != NULL) {
+				page_create_putback(1);
+			} else {
+				npp = page_get_freelist(vp, off, seg, vaddr,
+				    PAGESIZE, flags | PG_MATCH_COLOR, lgrp);
+			}
 			if (npp == NULL) {
 				npp = page_get_cachelist(vp, off, seg,
 				    vaddr, flags | PG_MATCH_COLOR, lgrp);
@@ -3410,6 +3456,18 @@ page_do_hashin(page_t *pp, vnode_t *vp, u_offset_t offset)
 	if ((vp->v_flag & VISSWAP) != 0)
 		PP_SETSWAP(pp);
 
+	/*
+	 * fsflush only scans memory for modified pages once a page has
+	 * been created that it could otherwise miss: one belonging to a
+	 * writable file system that doesn't report the vnodes that may
+	 * have modified pages through fsflush_dirty_vnode().
+	 */
+	if (!fsflush_scan_needed && !VN_ISKAS(vp) &&
+	    (vp->v_flag & VISSWAP) == 0 && (vp->v_vfsp == NULL ||
+	    ((vp->v_vfsp->vfs_flag & VFS_RDONLY) == 0 &&
+	    !vfs_has_feature(vp->v_vfsp, VFSFT_DIRTYTRACK))))
+		fsflush_scan_needed = 1;
+
 	index = PAGE_HASH_FUNC(vp, offset);
 	ASSERT(MUTEX_HELD(PAGE_HASH_MUTEX(index)));
 	listp = &page_hash[index];
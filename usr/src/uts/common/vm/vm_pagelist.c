@@ -64,6 +64,11 @@
 #include <sys/sdt.h>
 #include <sys/dumphdr.h>
 #include <sys/swap.h>
+#include <sys/kstat.h>
+#include <sys/cpuvar.h>
+#include <sys/disp.h>
+#include <sys/proc.h>
+#include <sys/thread.h>
 
 extern uint_t	vac_colors;
 
@@ -4457,3 +4462,293 @@ page_set_colorequiv_arr(void)
 		}
 	}
 }
+
+/*
+ * Pre-zeroed page pools.
+ *
+ * Most anonymous memory is handed out zero-filled, and zeroing the page
+ * in the faulting thread (anon_zero(), anon_map_getpages()) is a large part
+ * of the cost of touching memory for the first time.  To take this out of
+ * the fault path, each memory node has a small pool of free pages that a
+ * low priority thread has already zeroed, while its CPU had nothing else
+ * to run.
+ *
+ * Pool pages are taken off the freelists and accounted for in freemem as if
+ * they were allocated; they are held SE_EXCL, aren't hashed, and are linked
+ * through p_next/p_prev.  A caller of page_create_va() that is going to
+ * zero its page passes PG_ZERO, and page_create_va() then takes a page from
+ * the pools of the lgroup it would have allocated from, before trying the
+ * freelists.  Such pages come back with P_ZEROED set, and the caller can
+ * skip pagezero() if it finds it.  P_ZEROED is only meaningful to the
+ * thread that created the page; it is cleared as soon as the page's
+ * exclusive lock is dropped, and whenever a page is freed.
+ *
+ * Pool pages aren't of any particular color, so PG_MATCH_COLOR has no
+ * effect on them, and they are never in the cage, so PG_NORELOC requests
+ * don't use them.  The pools are drained when memory gets short, and while
+ * memory is being deleted, so that they don't hold onto pages that are
+ * needed elsewhere.
+ *
+ * The zeroing itself is done by pagezero(), which on x86 normally uses
+ * non-temporal stores, so that filling the pool doesn't evict the cache
+ * contents of whatever the CPU runs next.
+ */
+typedef struct page_zero_pool {
+	kmutex_t	pzp_lock;
+	page_t		*pzp_list;	/* zeroed pages */
+	pgcnt_t		pzp_count;	/* number of pages on pzp_list */
+	uint_t		pzp_bin;	/* color to take the next page from */
+} page_zero_pool_t;
+
+static page_zero_pool_t	page_zero_pools[MAX_MEM_NODES];
+
+int		page_zero_enable = 1;
+pgcnt_t		page_zero_pool_max = 0;		/* per pool, 0 = computed */
+pgcnt_t		page_zero_batch = 256;		/* pages zeroed per pass */
+clock_t		page_zero_interval = 0;		/* ticks, 0 = hz / 10 */
+static uint_t	page_zero_deleting;		/* memory deletes in progress */
+
+struct page_zero_stat {
+	kstat_named_t	zeroed;
+	kstat_named_t	hits;
+	kstat_named_t	misses;
+	kstat_named_t	drained;
+} page_zero_stat = {
+	{ "zeroed",		KSTAT_DATA_UINT64 },
+	{ "hits",		KSTAT_DATA_UINT64 },
+	{ "misses",		KSTAT_DATA_UINT64 },
+	{ "drained",		KSTAT_DATA_UINT64 },
+};
+
+#define	PAGE_ZERO_STAT_ADD(stat, n)	\
+	atomic_add_64(&page_zero_stat.stat.value.ui64, (n))
+
+/*
+ * Return up to npages from the pool of mnode to the freelists.
+ */
+static void
+page_zero_drain(int mnode, pgcnt_t npages)
+{
+	page_zero_pool_t *pzp = &page_zero_pools[mnode];
+	page_t *pp;
+	pgcnt_t n = 0;
+
+	while (n < npages && pzp->pzp_count != 0) {
+		mutex_enter(&pzp->pzp_lock);
+		if ((pp = pzp->pzp_list) == NULL) {
+			mutex_exit(&pzp->pzp_lock);
+			break;
+		}
+		page_sub(&pzp->pzp_list, pp);
+		pzp->pzp_count--;
+		mutex_exit(&pzp->pzp_lock);
+
+		ASSERT(PAGE_EXCL(pp) && PP_ISZEROED(pp));
+		page_free(pp, 1);
+		n++;
+	}
+
+	if (n != 0)
+		PAGE_ZERO_STAT_ADD(drained, n);
+}
+
+/*
+ * Zero up to npages free pages from mnode and add them to its pool.
+ * Gives up as soon as memory is short or something else wants this CPU.
+ */
+static void
+page_zero_fill(int mnode, pgcnt_t npages)
+{
+	page_zero_pool_t *pzp = &page_zero_pools[mnode];
+	uint_t flags = 0;
+	int mtype;
+	page_t *pp;
+	pgcnt_t n = 0;
+
+	if (!kcage_on)
+		flags |= PGI_NOCAGE;
+
+	/* LINTED */
+	MTYPE_INIT(mtype, NULL, NULL, flags, PAGESIZE);
+
+	while (n < npages && pzp->pzp_count < page_zero_pool_max &&
+	    freemem > lotsfree + page_zero_pool_max &&
+	    page_zero_deleting == 0 &&
+	    CPU->cpu_disp->disp_nrunnable == 0) {
+		if (!page_create_wait(1, 0))
+			break;
+
+		/*
+		 * Spread the pool over all the colors, so that the pages
+		 * we take are no more likely to collide in the cache than
+		 * those from the freelists would be.
+		 */
+		pzp->pzp_bin = (pzp->pzp_bin + 1) &
+		    (PAGE_GET_PAGECOLORS(0) - 1);
+		pp = page_get_mnode_freelist(mnode, pzp->pzp_bin, mtype, 0,
+		    flags);
+		if (pp == NULL) {
+			page_create_putback(1);
+			break;
+		}
+
+		ASSERT(PAGE_EXCL(pp));
+		ASSERT(pp->p_vnode == NULL);
+		ASSERT(!hat_page_is_mapped(pp));
+		PP_CLRFREE(pp);
+		PP_CLRAGED(pp);
+
+		pagezero(pp, 0, PAGESIZE);
+		PP_SETZEROED(pp);
+
+		mutex_enter(&pzp->pzp_lock);
+		page_add(&pzp->pzp_list, pp);
+		pzp->pzp_count++;
+		mutex_exit(&pzp->pzp_lock);
+		n++;
+	}
+
+	if (n != 0)
+		PAGE_ZERO_STAT_ADD(zeroed, n);
+}
+
+static void
+page_zero_thread(void *arg)
+{
+	int mnode = (int)(uintptr_t)arg;
+	page_zero_pool_t *pzp = &page_zero_pools[mnode];
+	callb_cpr_t cpr_info;
+	kmutex_t cpr_lock;	/* just for CPR stuff */
+
+	mutex_init(&cpr_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	CALLB_CPR_INIT(&cpr_info, &cpr_lock,
+	    callb_generic_cpr, "page_zero");
+
+	for (;;) {
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_BEGIN(&cpr_info);
+		mutex_exit(&cpr_lock);
+		delay(MAX(page_zero_interval, 1));
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_END(&cpr_info, &cpr_lock);
+		mutex_exit(&cpr_lock);
+
+		if (!page_zero_enable || page_zero_deleting != 0 ||
+		    freemem < lotsfree) {
+			page_zero_drain(mnode, pzp->pzp_count);
+			continue;
+		}
+		page_zero_fill(mnode, page_zero_batch);
+	}
+}
+
+/*
+ * Take a zeroed page from the pools of lgrp, for page_create_va().
+ * Returns NULL if they are empty.
+ */
+page_t *
+page_get_zeroed(lgrp_t *lgrp, uint_t flags)
+{
+	lgrp_mnode_cookie_t lgrp_cookie;
+	page_zero_pool_t *pzp;
+	page_t *pp;
+	int mnode;
+
+	if (flags & PG_NORELOC)
+		return (NULL);
+
+	if (!LGRP_EXISTS(lgrp))
+		lgrp = lgrp_home_lgrp();
+
+	LGRP_MNODE_COOKIE_INIT(lgrp_cookie, lgrp, LGRP_SRCH_LOCAL);
+	while ((mnode = lgrp_memnode_choose(&lgrp_cookie)) >= 0) {
+		pzp = &page_zero_pools[mnode];
+		if (pzp->pzp_count == 0)
+			continue;
+		mutex_enter(&pzp->pzp_lock);
+		if ((pp = pzp->pzp_list) != NULL) {
+			page_sub(&pzp->pzp_list, pp);
+			pzp->pzp_count--;
+			mutex_exit(&pzp->pzp_lock);
+			ASSERT(PAGE_EXCL(pp) && PP_ISZEROED(pp));
+			PAGE_ZERO_STAT_ADD(hits, 1);
+			return (pp);
+		}
+		mutex_exit(&pzp->pzp_lock);
+	}
+
+	PAGE_ZERO_STAT_ADD(misses, 1);
+	return (NULL);
+}
+
+/*ARGSUSED*/
+static void
+page_zero_mem_config_post_add(void *arg, pgcnt_t delta_pages)
+{
+}
+
+/*ARGSUSED*/
+static int
+page_zero_mem_config_pre_del(void *arg, pgcnt_t delta_pages)
+{
+	int mnode;
+
+	atomic_inc_uint(&page_zero_deleting);
+	for (mnode = 0; mnode < max_mem_nodes; mnode++)
+		page_zero_drain(mnode, page_zero_pools[mnode].pzp_count);
+	return (0);
+}
+
+/*ARGSUSED*/
+static void
+page_zero_mem_config_post_del(void *arg, pgcnt_t delta_pages, int cancelled)
+{
+	atomic_dec_uint(&page_zero_deleting);
+}
+
+static kphysm_setup_vector_t page_zero_mem_config_vec = {
+	KPHYSM_SETUP_VECTOR_VERSION,
+	page_zero_mem_config_post_add,
+	page_zero_mem_config_pre_del,
+	page_zero_mem_config_post_del,
+};
+
+/*
+ * Start a pre-zeroing thread for each memory node.
+ */
+void
+page_zero_init(void)
+{
+	kstat_t *ksp;
+	int mnode;
+	int ret;
+
+	if (page_zero_pool_max == 0)
+		page_zero_pool_max = MIN(physmem / 1024, btop(32 << 20));
+	if (page_zero_interval == 0)
+		page_zero_interval = MAX(hz / 10, 1);
+
+	ksp = kstat_create("unix", 0, "page_zero", "vm", KSTAT_TYPE_NAMED,
+	    sizeof (page_zero_stat) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp != NULL) {
+		ksp->ks_data = (void *)&page_zero_stat;
+		kstat_install(ksp);
+	}
+
+	if (!page_zero_enable || page_zero_pool_max == 0)
+		return;
+
+	ret = kphysm_setup_func_register(&page_zero_mem_config_vec, NULL);
+	ASSERT(ret == 0);
+
+	for (mnode = 0; mnode < max_mem_nodes; mnode++) {
+		if (mem_node_config[mnode].exists == 0)
+			continue;
+		mutex_init(&page_zero_pools[mnode].pzp_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+		(void) thread_create(NULL, 0, page_zero_thread,
+		    (void *)(uintptr_t)mnode, 0, &p0, TS_RUN, minclsyspri);
+	}
+}
@@ -1382,6 +1382,9 @@ swapdel(
 	lowblk = lowblk ? lowblk : 1; 	/* Skip first page (disk label) */
 	soff = ptob(btopr(lowblk << SCTRSHFT)); /* must be page aligned */
 
+	/* Don't count the per-CPU reservation caches against the delete. */
+	anon_resv_drain();
+
 	mutex_enter(&swapinfo_lock);
 	for (sipp = &swapinfo; (osip = *sipp) != NULL; sipp = &osip->si_next) {
 		if ((osip->si_vp == cvp) &&
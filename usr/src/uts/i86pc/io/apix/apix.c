@@ -83,6 +83,8 @@
 #include <sys/mach_intr.h>
 #include <sys/apix.h>
 #include <sys/apix_irm_impl.h>
+#include <sys/lgrp.h>
+#include <sys/kstat.h>
 
 static int apix_probe();
 static void apix_init();
@@ -103,6 +105,7 @@ static int apix_intr_ops(dev_info_t *, ddi_intr_handle_impl_t *,
  * Helper functions for apix_intr_ops()
  */
 static void apix_redistribute_compute(void);
+static void apix_balance_start(void);
 static int apix_get_pending(apix_vector_t *);
 static apix_vector_t *apix_get_req_vector(ddi_intr_handle_impl_t *, ushort_t);
 static int apix_get_intr_info(ddi_intr_handle_impl_t *, apic_get_intr_t *);
@@ -221,6 +224,26 @@ int apix_nipis = 16;	/* Maximum number of IPIs */
  */
 int apix_cpu_nvectors = APIX_NVECTOR;
 
+/*
+ * Interrupt load balancer tunables; see apix_balance().
+ *
+ *    apix_balance_enable -- run the balancer at all.
+ *    apix_balance_interval -- milliseconds between balancer passes.
+ *    apix_balance_busy -- percentage of a CPU's time spent in interrupt
+ *    handlers above which vectors are moved off it.
+ *    apix_balance_imbalance -- minimum difference, in percent of a CPU,
+ *    between the source and target CPU of a move.
+ *    apix_balance_holdoff -- number of passes a vector stays put after
+ *    having been moved.
+ *    apix_balance_maxmoves -- maximum number of moves per pass.
+ */
+int apix_balance_enable = 1;
+int apix_balance_interval = 1000;
+int apix_balance_busy = 20;
+int apix_balance_imbalance = 10;
+int apix_balance_holdoff = 10;
+int apix_balance_maxmoves = 4;
+
 /* gcpu.h */
 
 extern void apic_do_interrupt(struct regs *rp, trap_trace_rec_t *ttp);
@@ -1072,6 +1095,8 @@ apix_post_cyclic_setup(void *arg)
 	 * In peridoc mode intr redistribution processing is done in
 	 * apic_intr_enter during clk intr processing
 	 */
+	apix_balance_start();
+
 	if (!apic_oneshot)
 		return;
 
@@ -1297,6 +1322,7 @@ apix_intr_ops(dev_info_t *dip, ddi_intr_handle_impl_t *hdlp,
 			return (PSM_FAILURE);
 		}
 		newvecp->v_bound_cpuid = target;
+		newvecp->v_flags |= APIX_VECT_TARGETED;
 		hdlp->ih_vector = APIX_VIRTVECTOR(newvecp->v_cpuid,
 		    newvecp->v_vector);
 		break;
@@ -1436,6 +1462,408 @@ apix_redistribute_compute(void)
 	}
 }
 
+/*
+ * Interrupt load balancer.
+ *
+ * Every apix_balance_interval milliseconds, apix_balance() samples the
+ * time each enabled vector has spent in its handlers (the same per-handler
+ * tick counts intrstat(1M) reports) and smooths it into v_load. Vectors
+ * are then moved from the CPU spending the most time in interrupts to
+ * lightly loaded ones:
+ *
+ *	- A vector whose consumer has targeted it at a CPU with
+ *	  set_intr_affinity(), as mac does for the CPU running the ring's
+ *	  soft ring set, is kept in that CPU's lgroup, and is moved back to
+ *	  that CPU as soon as it has room again.
+ *	- Other vectors are kept in the lgroup of the CPU they are on.
+ *	- Only when no CPU in that lgroup can take the vector is it moved to
+ *	  another lgroup.
+ *
+ * To avoid moving vectors back and forth, a move is made only if it leaves
+ * the target less loaded than the source, the two differ by at least
+ * apix_balance_imbalance percent, and the vector has not been moved in the
+ * last apix_balance_holdoff passes. User bound vectors are never moved.
+ *
+ * The balancer's decisions are counted in the apix:0:balance kstat.
+ */
+typedef struct apix_balance_stats {
+	kstat_named_t	abs_passes;
+	kstat_named_t	abs_moves;
+	kstat_named_t	abs_moves_home;
+	kstat_named_t	abs_moves_lgrp;
+	kstat_named_t	abs_moves_remote;
+	kstat_named_t	abs_failed;
+	kstat_named_t	abs_holdoff;
+	kstat_named_t	abs_max_busy;
+	kstat_named_t	abs_last_from;
+	kstat_named_t	abs_last_to;
+	kstat_named_t	abs_last_vector;
+	kstat_named_t	abs_last_load;
+} apix_balance_stats_t;
+
+static apix_balance_stats_t apix_balance_stats = {
+	{ "passes",		KSTAT_DATA_UINT64 },
+	{ "moves",		KSTAT_DATA_UINT64 },
+	{ "moves_home",		KSTAT_DATA_UINT64 },
+	{ "moves_lgrp",		KSTAT_DATA_UINT64 },
+	{ "moves_remote",	KSTAT_DATA_UINT64 },
+	{ "failed",		KSTAT_DATA_UINT64 },
+	{ "holdoff",		KSTAT_DATA_UINT64 },
+	{ "max_busy_pct",	KSTAT_DATA_UINT32 },
+	{ "last_from_cpu",	KSTAT_DATA_INT32 },
+	{ "last_to_cpu",	KSTAT_DATA_INT32 },
+	{ "last_vector",	KSTAT_DATA_UINT32 },
+	{ "last_load_ns",	KSTAT_DATA_UINT64 },
+};
+
+#define	APIX_BALANCE_BUMP(stat)	(apix_balance_stats.stat.value.ui64++)
+
+static kstat_t *apix_balance_ksp;
+static hrtime_t *apix_balance_load;	/* per-CPU interrupt time */
+static hrtime_t apix_balance_last;	/* time of last pass */
+
+static boolean_t
+apix_balance_cpu_ok(processorid_t cpuid)
+{
+	return (apic_cpu_in_range(cpuid) && cpu[cpuid] != NULL &&
+	    (apic_cpus[cpuid].aci_status & APIC_CPU_INTR_ENABLE) != 0);
+}
+
+static lgrp_id_t
+apix_balance_lgrp(processorid_t cpuid)
+{
+	return (cpu[cpuid]->cpu_lpl->lpl_lgrpid);
+}
+
+/*
+ * Sample the interrupt time of every enabled vector and add it up per CPU.
+ */
+static void
+apix_balance_account(void)
+{
+	apix_vector_t *vecp;
+	struct autovec *avp;
+	uint64_t ticks;
+	hrtime_t delta;
+	int i, v;
+
+	for (i = 0; i < apic_nproc; i++) {
+		apix_balance_load[i] = 0;
+		if (!apic_cpu_in_range(i) || apixs[i] == NULL)
+			continue;
+
+		for (v = APIX_AVINTR_MIN; v <= APIX_AVINTR_MAX; v++) {
+			vecp = xv_vector(i, v);
+			if (!IS_VECT_ENABLED(vecp))
+				continue;
+
+			ticks = 0;
+			for (avp = vecp->v_autovect; avp != NULL;
+			    avp = avp->av_link) {
+				if (avp->av_vector != NULL &&
+				    avp->av_ticksp != NULL)
+					ticks += *avp->av_ticksp;
+			}
+
+			/*
+			 * The count drops when a handler is removed; treat
+			 * that pass as idle.
+			 */
+			delta = (ticks > vecp->v_ticks) ?
+			    (hrtime_t)(ticks - vecp->v_ticks) : 0;
+			vecp->v_ticks = ticks;
+			scalehrtime(&delta);
+			vecp->v_load = (vecp->v_load + delta) / 2;
+
+			if (vecp->v_holdoff > 0)
+				vecp->v_holdoff--;
+
+			apix_balance_load[i] += vecp->v_load;
+		}
+	}
+}
+
+/*
+ * Pick the least loaded CPU in lgroup "lgrp" (or in any lgroup, if lgrp is
+ * LGRP_NONE) that could take "load" from CPU "from" without ending up
+ * busier than it. Returns -1 if there is none.
+ */
+static processorid_t
+apix_balance_pick(processorid_t from, lgrp_id_t lgrp, hrtime_t load,
+    hrtime_t gap)
+{
+	processorid_t best = -1;
+	int i;
+
+	for (i = 0; i < apic_nproc; i++) {
+		if (i == from || !apix_balance_cpu_ok(i))
+			continue;
+		if (lgrp != LGRP_NONE && apix_balance_lgrp(i) != lgrp)
+			continue;
+		if (best == -1 ||
+		    apix_balance_load[i] < apix_balance_load[best])
+			best = i;
+	}
+
+	if (best == -1 ||
+	    apix_balance_load[from] - apix_balance_load[best] < gap ||
+	    apix_balance_load[best] + load >= apix_balance_load[from] - load)
+		return (-1);
+
+	return (best);
+}
+
+/*
+ * Move a vector, and account for it. Called with apix_lock held.
+ */
+static boolean_t
+apix_balance_move(apix_vector_t *vecp, processorid_t to,
+    kstat_named_t *kind)
+{
+	apix_vector_t *newp;
+	processorid_t from = vecp->v_cpuid;
+	hrtime_t load = vecp->v_load;
+	uchar_t vector = vecp->v_vector;
+	int ret;
+
+	if ((newp = apix_set_cpu(vecp, to, &ret)) == NULL) {
+		/*
+		 * Don't try this one again right away.
+		 */
+		vecp->v_holdoff = MAX(apix_balance_holdoff, 1);
+		APIX_BALANCE_BUMP(abs_failed);
+		return (B_FALSE);
+	}
+
+	newp->v_holdoff = apix_balance_holdoff;
+	apix_balance_load[from] -= load;
+	apix_balance_load[to] += load;
+
+	APIX_BALANCE_BUMP(abs_moves);
+	kind->value.ui64++;
+	apix_balance_stats.abs_last_from.value.i32 = from;
+	apix_balance_stats.abs_last_to.value.i32 = to;
+	apix_balance_stats.abs_last_vector.value.ui32 = vector;
+	apix_balance_stats.abs_last_load.value.ui64 = load;
+
+	APIC_VERBOSE(REBIND, (CE_CONT, "apix: balance vector 0x%x/0x%x "
+	    "to cpu 0x%x, load %lld\n", from, vector, to, (longlong_t)load));
+
+	return (B_TRUE);
+}
+
+static boolean_t
+apix_balance_movable(apix_vector_t *vecp)
+{
+	if (!IS_VECT_ENABLED(vecp) || vecp->v_load == 0 ||
+	    (vecp->v_flags & APIX_VECT_USER_BOUND))
+		return (B_FALSE);
+
+	/* MSI groups can only be moved as a whole; leave them be */
+	if (vecp->v_type == APIX_TYPE_MSI &&
+	    i_ddi_intr_get_current_nintrs(APIX_GET_DIP(vecp)) > 1)
+		return (B_FALSE);
+
+	if (vecp->v_holdoff > 0) {
+		APIX_BALANCE_BUMP(abs_holdoff);
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Move targeted vectors that an earlier pass moved away back to the CPU
+ * their consumer asked for, if it has room for them again.
+ */
+static int
+apix_balance_home(int moves, hrtime_t busy)
+{
+	apix_vector_t *vecp;
+	processorid_t home;
+	int i, v;
+
+	for (i = 0; i < apic_nproc && moves < apix_balance_maxmoves; i++) {
+		if (!apic_cpu_in_range(i) || apixs[i] == NULL)
+			continue;
+
+		for (v = APIX_AVINTR_MIN; v <= APIX_AVINTR_MAX &&
+		    moves < apix_balance_maxmoves; v++) {
+			vecp = xv_vector(i, v);
+			if (!IS_VECT_ENABLED(vecp) ||
+			    (vecp->v_flags & APIX_VECT_TARGETED) == 0)
+				continue;
+
+			home = vecp->v_bound_cpuid;
+			if (home == i || !apix_balance_cpu_ok(home) ||
+			    apix_balance_load[home] + vecp->v_load >= busy ||
+			    !apix_balance_movable(vecp))
+				continue;
+
+			if (apix_balance_move(vecp, home,
+			    &apix_balance_stats.abs_moves_home))
+				moves++;
+		}
+	}
+
+	return (moves);
+}
+
+/*
+ * Move one vector off the CPU that spends the most time in interrupts.
+ * Returns B_FALSE if nothing could be moved.
+ */
+static boolean_t
+apix_balance_one(hrtime_t busy, hrtime_t gap)
+{
+	apix_vector_t *vecp;
+	processorid_t from = -1, to;
+	lgrp_id_t lgrp;
+	int i, v;
+
+	for (i = 0; i < apic_nproc; i++) {
+		if (apix_balance_cpu_ok(i) && (from == -1 ||
+		    apix_balance_load[i] > apix_balance_load[from]))
+			from = i;
+	}
+	if (from == -1 || apix_balance_load[from] < busy)
+		return (B_FALSE);
+
+	/*
+	 * Try the vectors on the busiest CPU, biggest first, until one of
+	 * them fits somewhere.
+	 */
+	for (;;) {
+		vecp = NULL;
+		for (v = APIX_AVINTR_MIN; v <= APIX_AVINTR_MAX; v++) {
+			apix_vector_t *vp = xv_vector(from, v);
+
+			if (IS_VECT_ENABLED(vp) && vp->v_holdoff == 0 &&
+			    (vecp == NULL || vp->v_load > vecp->v_load))
+				vecp = vp;
+		}
+		if (vecp == NULL)
+			return (B_FALSE);
+
+		/*
+		 * Vectors that can't be moved get a holdoff of 1, which skips
+		 * them for the rest of this pass; the next
+		 * apix_balance_account() clears it again.
+		 */
+		if (!apix_balance_movable(vecp)) {
+			vecp->v_holdoff = 1;
+			continue;
+		}
+
+		if ((vecp->v_flags & APIX_VECT_TARGETED) &&
+		    apix_balance_cpu_ok(vecp->v_bound_cpuid))
+			lgrp = apix_balance_lgrp(vecp->v_bound_cpuid);
+		else
+			lgrp = apix_balance_lgrp(from);
+
+		if ((to = apix_balance_pick(from, lgrp, vecp->v_load,
+		    gap)) != -1) {
+			if (apix_balance_move(vecp, to,
+			    &apix_balance_stats.abs_moves_lgrp))
+				return (B_TRUE);
+		} else if ((to = apix_balance_pick(from, LGRP_NONE,
+		    vecp->v_load, gap)) != -1) {
+			if (apix_balance_move(vecp, to,
+			    &apix_balance_stats.abs_moves_remote))
+				return (B_TRUE);
+		} else {
+			vecp->v_holdoff = 1;
+		}
+	}
+}
+
+static void apix_balance_tick(void *);
+
+/*
+ * Balancer pass; runs from the system taskq.
+ */
+/*ARGSUSED*/
+static void
+apix_balance(void *arg)
+{
+	hrtime_t now, interval, busy, gap, max;
+	int i, moves;
+
+	if (apix_balance_ksp == NULL) {
+		apix_balance_ksp = kstat_create("apix", 0, "balance", "misc",
+		    KSTAT_TYPE_NAMED, sizeof (apix_balance_stats) /
+		    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+		if (apix_balance_ksp != NULL) {
+			apix_balance_ksp->ks_data = &apix_balance_stats;
+			kstat_install(apix_balance_ksp);
+		}
+	}
+
+	if (!apix_balance_enable)
+		goto out;
+
+	mutex_enter(&cpu_lock);
+	lock_set(&apix_lock);
+
+	now = gethrtime();
+	interval = now - apix_balance_last;
+	apix_balance_last = now;
+	if (interval <= 0)
+		goto done;
+
+	apix_balance_account();
+
+	max = 0;
+	for (i = 0; i < apic_nproc; i++) {
+		if (apix_balance_cpu_ok(i) && apix_balance_load[i] > max)
+			max = apix_balance_load[i];
+	}
+	apix_balance_stats.abs_max_busy.value.ui32 =
+	    (uint32_t)(max * 100 / interval);
+
+	busy = interval * apix_balance_busy / 100;
+	gap = interval * apix_balance_imbalance / 100;
+
+	moves = apix_balance_home(0, busy);
+	for (; moves < apix_balance_maxmoves; moves++) {
+		if (!apix_balance_one(busy, gap))
+			break;
+	}
+
+	APIX_BALANCE_BUMP(abs_passes);
+done:
+	lock_clear(&apix_lock);
+	mutex_exit(&cpu_lock);
+out:
+	(void) timeout(apix_balance_tick, NULL,
+	    drv_usectohz((clock_t)apix_balance_interval * 1000));
+}
+
+/*ARGSUSED*/
+static void
+apix_balance_tick(void *arg)
+{
+	if (taskq_dispatch(system_taskq, apix_balance, NULL,
+	    TQ_NOSLEEP) == NULL) {
+		(void) timeout(apix_balance_tick, NULL,
+		    drv_usectohz((clock_t)apix_balance_interval * 1000));
+	}
+}
+
+/*
+ * Called from apix_post_cyclic_setup() with cpu_lock held.
+ */
+static void
+apix_balance_start(void)
+{
+	apix_balance_load = kmem_zalloc(apic_nproc * sizeof (hrtime_t),
+	    KM_SLEEP);
+	apix_balance_last = gethrtime();
+
+	(void) timeout(apix_balance_tick, NULL,
+	    drv_usectohz((clock_t)apix_balance_interval * 1000));
+}
+
 /*
  * intr_ops() service routines
  */
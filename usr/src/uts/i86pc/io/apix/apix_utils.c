@@ -665,6 +665,9 @@ apix_dup_vectors(apix_vector_t *oldp, apix_vector_t *newp, int count)
 		top->v_inum = fromp->v_inum;
 		top->v_flags = fromp->v_flags;
 		top->v_intrmap_private = fromp->v_intrmap_private;
+		top->v_ticks = fromp->v_ticks;
+		top->v_load = fromp->v_load;
+		top->v_holdoff = fromp->v_holdoff;
 
 		for (avp = fromp->v_autovect; avp != NULL; avp = avp->av_link) {
 			if (avp->av_vector == NULL)
@@ -720,6 +723,9 @@ apix_cleanup_vector(apix_vector_t *vecp)
 	vecp->v_type = 0;
 	vecp->v_flags = 0;
 	vecp->v_busy = 0;
+	vecp->v_holdoff = 0;
+	vecp->v_ticks = 0;
+	vecp->v_load = 0;
 	vecp->v_intrmap_private = NULL;
 }
 
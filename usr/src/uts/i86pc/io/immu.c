@@ -87,6 +87,15 @@ boolean_t immu_dmar_print;
 /* Tunables */
 int64_t immu_flush_gran = 5;
 
+/*
+ * Keep DVMA mappings of contiguous buffers around after unbind, up to
+ * immu_dvcache_maxpages pages per domain, and defer IOTLB invalidation
+ * of freed DVMA so that new mappings need not be flushed.
+ */
+boolean_t immu_dvcache_enable = B_TRUE;
+uint64_t immu_dvcache_maxpages = 16384;
+boolean_t immu_dvma_lazy_flush = B_TRUE;
+
 immu_flags_t immu_global_dvma_flags;
 
 /* ############  END OPTIONS section ################ */
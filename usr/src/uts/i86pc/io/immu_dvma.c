@@ -79,6 +79,9 @@ static void destroy_immu_devi(immu_devi_t *immu_devi);
 static boolean_t dvma_map(domain_t *domain, uint64_t sdvma,
     uint64_t nvpages, immu_dcookie_t *dcookies, int dcount, dev_info_t *rdip,
     immu_flags_t immu_flags);
+static void dvma_free(domain_t *domain, uint64_t dvma, uint64_t npages);
+static int dvcache_compare(const void *a, const void *b);
+static void dvma_reclaim(domain_t *domain);
 
 /* Extern globals */
 extern struct memlist  *phys_install;
@@ -1352,6 +1355,13 @@ domain_create(immu_t *immu, dev_info_t *ddip, dev_info_t *rdip,
 	domain->dom_maptype = IMMU_MAPTYPE_XLATE;
 	domain->dom_dip = ddip;
 
+	mutex_init(&domain->dom_dvcache_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&domain->dom_dvcache, dvcache_compare,
+	    sizeof (immu_dvcache_ent_t), offsetof(immu_dvcache_ent_t, idc_avl));
+	list_create(&domain->dom_dvcache_lru, sizeof (immu_dvcache_ent_t),
+	    offsetof(immu_dvcache_ent_t, idc_lru));
+	immu_init_inv_wait(&domain->dom_inv_wait, "domain", B_TRUE);
+
 	/*
 	 * Create xlate DVMA arena for this domain.
 	 */
@@ -2438,11 +2448,19 @@ dvma_alloc(domain_t *domain, ddi_dma_attr_t *dma_attr, uint_t npages, int kmf)
 	}
 
 	/*
-	 * allocate from vmem arena.
+	 * allocate from vmem arena. If it's exhausted, some of it may
+	 * just be parked in the mapping cache or waiting for an IOTLB
+	 * flush, so get that back before trying (or sleeping) again.
 	 */
 	dvma = (uint64_t)(uintptr_t)vmem_xalloc(domain->dom_dvma_arena,
 	    xsize, align, 0, 0, (void *)(uintptr_t)minaddr,
-	    (void *)(uintptr_t)maxaddr, kmf);
+	    (void *)(uintptr_t)maxaddr, VM_NOSLEEP);
+	if (dvma == 0) {
+		dvma_reclaim(domain);
+		dvma = (uint64_t)(uintptr_t)vmem_xalloc(domain->dom_dvma_arena,
+		    xsize, align, 0, 0, (void *)(uintptr_t)minaddr,
+		    (void *)(uintptr_t)maxaddr, kmf);
+	}
 
 	return (dvma);
 }
@@ -2529,21 +2547,226 @@ dvma_prefree(dev_info_t *rdip, immu_hdl_priv_t *ihp)
 
 	if (ihp->ihp_predvma != 0) {
 		dvma_unmap(domain, ihp->ihp_predvma, IMMU_NPREPTES, rdip);
+		dvma_free(domain, ihp->ihp_predvma, IMMU_NPREPTES);
+	}
+}
+
+/*
+ * Deferred DVMA frees
+ *
+ * Unmapping doesn't invalidate the IOTLB (in non-DEBUG kernels it doesn't
+ * even clear the PTEs), so a DVMA range handed back to the arena may still
+ * have a translation cached by the IOMMU. Rather than always flushing when
+ * such a range is mapped again, freed ranges are held back in dom_dvfree
+ * and returned to the arena in batches, after a single domain-selective
+ * IOTLB invalidation. Every range in the arena is then known not to be in
+ * the IOTLB, and a fresh mapping only needs a flush if the IOMMU caches
+ * non-present entries (caching mode), or if immu_dvma_lazy_flush is off.
+ */
+static void
+dvma_flush_freeq(domain_t *domain)
+{
+	immu_t *immu = domain->dom_immu;
+	uint_t i;
+
+	ASSERT(MUTEX_HELD(&domain->dom_dvcache_lock));
+
+	if (domain->dom_ndvfree == 0)
+		return;
+
+	immu_flush_iotlb_dsi(immu, domain->dom_did, &domain->dom_inv_wait);
+
+	for (i = 0; i < domain->dom_ndvfree; i++) {
 		vmem_free(domain->dom_dvma_arena,
-		    (void *)(uintptr_t)ihp->ihp_predvma,
-		    IMMU_NPREPTES * IMMU_PAGESIZE);
+		    (void *)(uintptr_t)domain->dom_dvfree[i].dvs_start,
+		    domain->dom_dvfree[i].dvs_len);
 	}
+
+	IMMU_DPROBE2(immu__dvma__flush, domain_t *, domain, uint_t,
+	    domain->dom_ndvfree);
+
+	domain->dom_ndvfree = 0;
 }
 
 static void
-dvma_free(domain_t *domain, uint64_t dvma, uint64_t npages)
+dvma_free_locked(domain_t *domain, uint64_t dvma, uint64_t npages)
 {
-	uint64_t size = npages * IMMU_PAGESIZE;
+	ASSERT(MUTEX_HELD(&domain->dom_dvcache_lock));
+
+	if (domain->dom_ndvfree == IMMU_NDVFREE)
+		dvma_flush_freeq(domain);
+
+	domain->dom_dvfree[domain->dom_ndvfree].dvs_start = dvma;
+	domain->dom_dvfree[domain->dom_ndvfree].dvs_len =
+	    npages * IMMU_PAGESIZE;
+	domain->dom_ndvfree++;
+}
 
+static void
+dvma_free(domain_t *domain, uint64_t dvma, uint64_t npages)
+{
 	if (domain->dom_maptype != IMMU_MAPTYPE_XLATE)
 		return;
 
-	vmem_free(domain->dom_dvma_arena, (void *)(uintptr_t)dvma, size);
+	mutex_enter(&domain->dom_dvcache_lock);
+	dvma_free_locked(domain, dvma, npages);
+	mutex_exit(&domain->dom_dvcache_lock);
+}
+
+/*
+ * DVMA mapping cache
+ *
+ * Drivers that bind the same buffers over and over (pre-allocated NIC
+ * buffers, ARC buffers) would otherwise pay for a DVMA allocation, page
+ * table updates and an IOTLB invalidation on every bind. When a bind
+ * covers a single physically contiguous range, its DVMA mapping is
+ * remembered in dom_dvcache, keyed by the physical address of its first
+ * page, and stays in place after unbind. A later bind of the same range,
+ * with compatible permissions, reuses the mapping as it is: no page table
+ * writes and no invalidation.
+ *
+ * Idle mappings are kept on an LRU list, and the least recently used are
+ * torn down once the domain caches more than immu_dvcache_maxpages pages.
+ * Their DVMA goes through the deferred free queue above. Only mappings
+ * that were set up without an IOTLB flush are cached (see the end of
+ * immu_map_dvmaseg()), so on IOMMUs in caching mode, or with
+ * immu_dvma_lazy_flush off, the cache stays empty.
+ */
+static int
+dvcache_compare(const void *a, const void *b)
+{
+	const immu_dvcache_ent_t *ea = a;
+	const immu_dvcache_ent_t *eb = b;
+
+	if (ea->idc_paddr < eb->idc_paddr)
+		return (-1);
+	if (ea->idc_paddr > eb->idc_paddr)
+		return (1);
+	return (0);
+}
+
+static void
+dvcache_evict(domain_t *domain, immu_dvcache_ent_t *ent)
+{
+	ASSERT(MUTEX_HELD(&domain->dom_dvcache_lock));
+	ASSERT(ent->idc_ref == 0);
+
+	avl_remove(&domain->dom_dvcache, ent);
+	list_remove(&domain->dom_dvcache_lru, ent);
+	domain->dom_dvcache_npages -= ent->idc_npages;
+
+#ifdef DEBUG
+	dvma_unmap(domain, ent->idc_dvma, ent->idc_npages, NULL);
+#endif
+	dvma_free_locked(domain, ent->idc_dvma, ent->idc_npages);
+	kmem_free(ent, sizeof (immu_dvcache_ent_t));
+}
+
+static void
+dvcache_trim(domain_t *domain)
+{
+	immu_dvcache_ent_t *ent;
+
+	ASSERT(MUTEX_HELD(&domain->dom_dvcache_lock));
+
+	while (domain->dom_dvcache_npages > immu_dvcache_maxpages &&
+	    (ent = list_head(&domain->dom_dvcache_lru)) != NULL)
+		dvcache_evict(domain, ent);
+}
+
+static immu_dvcache_ent_t *
+dvcache_lookup(domain_t *domain, uint64_t paddr, uint64_t npages,
+    immu_flags_t immu_flags)
+{
+	immu_dvcache_ent_t key, *ent;
+	immu_flags_t rw = immu_flags & (IMMU_FLAGS_READ | IMMU_FLAGS_WRITE);
+
+	if (!immu_dvcache_enable)
+		return (NULL);
+
+	key.idc_paddr = paddr;
+
+	mutex_enter(&domain->dom_dvcache_lock);
+	ent = avl_find(&domain->dom_dvcache, &key, NULL);
+	if (ent == NULL || ent->idc_npages != npages ||
+	    (rw & ~ent->idc_flags) != 0) {
+		mutex_exit(&domain->dom_dvcache_lock);
+		return (NULL);
+	}
+	if (ent->idc_ref++ == 0)
+		list_remove(&domain->dom_dvcache_lru, ent);
+	mutex_exit(&domain->dom_dvcache_lock);
+
+	return (ent);
+}
+
+static immu_dvcache_ent_t *
+dvcache_insert(domain_t *domain, uint64_t paddr, uint64_t npages,
+    immu_flags_t immu_flags, uint64_t dvma)
+{
+	immu_dvcache_ent_t *ent, *old;
+	avl_index_t where;
+
+	if (!immu_dvcache_enable || npages > immu_dvcache_maxpages)
+		return (NULL);
+
+	ent = kmem_alloc(sizeof (immu_dvcache_ent_t), KM_NOSLEEP);
+	if (ent == NULL)
+		return (NULL);
+	ent->idc_paddr = paddr;
+	ent->idc_npages = npages;
+	ent->idc_dvma = dvma;
+	ent->idc_flags = immu_flags & (IMMU_FLAGS_READ | IMMU_FLAGS_WRITE);
+	ent->idc_ref = 1;
+
+	mutex_enter(&domain->dom_dvcache_lock);
+	old = avl_find(&domain->dom_dvcache, ent, &where);
+	if (old != NULL) {
+		/*
+		 * Another mapping of the same start page. Replace it if
+		 * nobody uses it, otherwise leave this one uncached.
+		 */
+		if (old->idc_ref != 0) {
+			mutex_exit(&domain->dom_dvcache_lock);
+			kmem_free(ent, sizeof (immu_dvcache_ent_t));
+			return (NULL);
+		}
+		dvcache_evict(domain, old);
+		(void) avl_find(&domain->dom_dvcache, ent, &where);
+	}
+	avl_insert(&domain->dom_dvcache, ent, where);
+	domain->dom_dvcache_npages += npages;
+	dvcache_trim(domain);
+	mutex_exit(&domain->dom_dvcache_lock);
+
+	return (ent);
+}
+
+static void
+dvcache_rele(domain_t *domain, immu_dvcache_ent_t *ent)
+{
+	mutex_enter(&domain->dom_dvcache_lock);
+	ASSERT(ent->idc_ref > 0);
+	if (--ent->idc_ref == 0) {
+		list_insert_tail(&domain->dom_dvcache_lru, ent);
+		dvcache_trim(domain);
+	}
+	mutex_exit(&domain->dom_dvcache_lock);
+}
+
+/*
+ * Give back all DVMA that's cached but idle, or waiting to be freed.
+ */
+static void
+dvma_reclaim(domain_t *domain)
+{
+	immu_dvcache_ent_t *ent;
+
+	mutex_enter(&domain->dom_dvcache_lock);
+	while ((ent = list_head(&domain->dom_dvcache_lru)) != NULL)
+		dvcache_evict(domain, ent);
+	dvma_flush_freeq(domain);
+	mutex_exit(&domain->dom_dvcache_lock);
 }
 
 static int
@@ -2565,6 +2788,9 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 	page_t *page;
 	struct as *vas;
 	immu_dcookie_t *dcookies;
+	immu_dvcache_ent_t *ent;
+	hw_pdte_t pte;
+	boolean_t flush;
 	int pde_set;
 
 	domain = IMMU_DEVI(rdip)->imd_domain;
@@ -2629,22 +2855,31 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 #endif
 		sdvma = ihp->ihp_predvma;
 		ihp->ihp_npremapped = npgalloc;
-		*ihp->ihp_preptes[0] =
-		    PDTE_PADDR(paddr & ~MMU_PAGEOFFSET) | rwmask;
+
+		/*
+		 * A handle that is bound to the same page(s) again finds
+		 * its PTEs already in place; only flush if one changed.
+		 */
+		flush = B_FALSE;
+		pte = PDTE_PADDR(paddr & ~MMU_PAGEOFFSET) | rwmask;
+		if (*ihp->ihp_preptes[0] != pte) {
+			*ihp->ihp_preptes[0] = pte;
+			flush = B_TRUE;
+		}
 	} else {
+		/*
+		 * The DVMA is allocated once we know whether the buffer
+		 * is physically contiguous and may be in the mapping
+		 * cache, or when we have to map early.
+		 */
 		ihp->ihp_npremapped = 0;
-		sdvma = dvma_alloc(domain, attrp, npgalloc,
-		    dmareq->dmar_fp == DDI_DMA_SLEEP ? VM_SLEEP : VM_NOSLEEP);
-		if (sdvma == 0)
-			return (DDI_DMA_NORESOURCES);
+		sdvma = 0;
+		flush = B_TRUE;
 
 		dcookies[0].dck_paddr = (paddr & ~MMU_PAGEOFFSET);
 		dcookies[0].dck_npages = 1;
 	}
 
-	IMMU_DPROBE3(immu__dvma__alloc, dev_info_t *, rdip, uint64_t, npgalloc,
-	    uint64_t, sdvma);
-
 	dvma = sdvma;
 	pde_set = 0;
 	npages = 1;
@@ -2669,8 +2904,11 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 		npages++;
 
 		if (ihp->ihp_npremapped > 0) {
-			*ihp->ihp_preptes[npages - 1] =
-			    PDTE_PADDR(paddr) | rwmask;
+			pte = PDTE_PADDR(paddr) | rwmask;
+			if (*ihp->ihp_preptes[npages - 1] != pte) {
+				*ihp->ihp_preptes[npages - 1] = pte;
+				flush = B_TRUE;
+			}
 		} else if (IMMU_CONTIG_PADDR(dcookies[dmax], paddr)) {
 			dcookies[dmax].dck_npages++;
 		} else {
@@ -2679,6 +2917,18 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 				/*
 				 * Ran out of dcookies. Map them now.
 				 */
+				if (sdvma == 0) {
+					sdvma = dvma_alloc(domain, attrp,
+					    npgalloc, dmareq->dmar_fp ==
+					    DDI_DMA_SLEEP ? VM_SLEEP :
+					    VM_NOSLEEP);
+					if (sdvma == 0)
+						return (DDI_DMA_NORESOURCES);
+					IMMU_DPROBE3(immu__dvma__alloc,
+					    dev_info_t *, rdip, uint64_t,
+					    npgalloc, uint64_t, sdvma);
+					dvma = sdvma;
+				}
 				if (dvma_map(domain, dvma,
 				    npages, dcookies, dmax + 1, rdip,
 				    immu_flags))
@@ -2699,23 +2949,78 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 		size -= psize;
 	}
 
+	/*
+	 * A physically contiguous buffer that was mapped before may still
+	 * be mapped; if so, use that mapping as is.
+	 */
+	ent = NULL;
+	if (ihp->ihp_npremapped == 0 && sdvma == 0 && dmax == 0) {
+		ent = dvcache_lookup(domain, dcookies[0].dck_paddr, npgalloc,
+		    immu_flags);
+		if (ent != NULL) {
+			IMMU_DPROBE3(immu__dvcache__hit, dev_info_t *, rdip,
+			    uint64_t, npgalloc, uint64_t, ent->idc_dvma);
+			sdvma = ent->idc_dvma;
+			npages = 0;
+			flush = B_FALSE;
+		}
+	}
+
 	/*
 	 * Finish up, mapping all, or all of the remaining,
 	 * physical memory ranges.
 	 */
-	if (ihp->ihp_npremapped == 0 && npages > 0) {
-		IMMU_DPROBE4(immu__dvmamap__late, dev_info_t *, rdip, \
-		    uint64_t, dvma, uint_t, npages, uint_t, dmax+1);
+	if (ihp->ihp_npremapped == 0 && ent == NULL) {
+		if (sdvma == 0) {
+			sdvma = dvma_alloc(domain, attrp, npgalloc,
+			    dmareq->dmar_fp == DDI_DMA_SLEEP ?
+			    VM_SLEEP : VM_NOSLEEP);
+			if (sdvma == 0)
+				return (DDI_DMA_NORESOURCES);
+			IMMU_DPROBE3(immu__dvma__alloc, dev_info_t *, rdip,
+			    uint64_t, npgalloc, uint64_t, sdvma);
+			dvma = sdvma;
+		}
 
-		if (dvma_map(domain, dvma, npages, dcookies,
-		    dmax + 1, rdip, immu_flags))
-			pde_set++;
+		if (npages > 0) {
+			IMMU_DPROBE4(immu__dvmamap__late, dev_info_t *, rdip, \
+			    uint64_t, dvma, uint_t, npages, uint_t, dmax+1);
+
+			if (dvma_map(domain, dvma, npages, dcookies,
+			    dmax + 1, rdip, immu_flags))
+				pde_set++;
+		}
+
+		/*
+		 * DVMA from the arena is never in the IOTLB, see
+		 * dvma_flush_freeq(), so new PTEs only need a flush if
+		 * the IOMMU may cache non-present entries.
+		 */
+		flush = !immu_dvma_lazy_flush ||
+		    IMMU_CAP_GET_CM(immu->immu_regs_cap);
+
+		/*
+		 * Now that it's mapped, remember the mapping if it's
+		 * contiguous (dmax is 0 and nothing was mapped early).
+		 * Only do so if it needs no flush, as another bind could
+		 * otherwise find it before the flush has completed.
+		 */
+		if (!flush && dmax == 0 && dvma == sdvma) {
+			ent = dvcache_insert(domain, dcookies[0].dck_paddr,
+			    npgalloc, immu_flags, sdvma);
+		}
 	}
+	ihp->ihp_dvcache = ent;
 
 	/* Invalidate the IOTLB */
-	immu_flush_iotlb_psi(immu, domain->dom_did, sdvma, npgalloc,
-	    pde_set > 0 ? TLB_IVA_WHOLE : TLB_IVA_LEAF,
-	    &ihp->ihp_inv_wait);
+	if (flush) {
+		immu_flush_iotlb_psi(immu, domain->dom_did, sdvma, npgalloc,
+		    pde_set > 0 ? TLB_IVA_WHOLE : TLB_IVA_LEAF,
+		    &ihp->ihp_inv_wait);
+	} else {
+		immu_regs_wbf_flush(immu);
+		ihp->ihp_inv_wait.iwp_vstatus = IMMU_INV_DATA_DONE;
+	}
 
 	ihp->ihp_ndvseg = 1;
 	ihp->ihp_dvseg[0].dvs_start = sdvma;
@@ -2731,7 +3036,8 @@ immu_map_dvmaseg(dev_info_t *rdip, ddi_dma_handle_t handle,
 }
 
 static int
-immu_unmap_dvmaseg(dev_info_t *rdip, ddi_dma_obj_t *dmao)
+immu_unmap_dvmaseg(dev_info_t *rdip, immu_hdl_priv_t *ihp,
+    ddi_dma_obj_t *dmao)
 {
 	uint64_t dvma, npages;
 	domain_t *domain;
@@ -2740,6 +3046,13 @@ immu_unmap_dvmaseg(dev_info_t *rdip, ddi_dma_obj_t *dmao)
 	domain = IMMU_DEVI(rdip)->imd_domain;
 	dvs = dmao->dmao_obj.dvma_obj.dv_seg;
 
+	/* A cached mapping stays in place for the next bind */
+	if (ihp->ihp_dvcache != NULL) {
+		dvcache_rele(domain, ihp->ihp_dvcache);
+		ihp->ihp_dvcache = NULL;
+		return (DDI_SUCCESS);
+	}
+
 	dvma = dvs[0].dvs_start;
 	npages = IMMU_BTOPR(dvs[0].dvs_len + dmao->dmao_obj.dvma_obj.dv_off);
 
@@ -3001,6 +3314,7 @@ immu_hdl_priv_ctor(void *buf, void *arg, int kmf)
 
 	ihp = buf;
 	immu_init_inv_wait(&ihp->ihp_inv_wait, "dmahandle", B_FALSE);
+	ihp->ihp_dvcache = NULL;
 
 	return (0);
 }
@@ -3175,5 +3489,5 @@ immu_unmapobject(iommulib_handle_t handle, dev_info_t *dip,
 	ihp = iommulib_iommu_dmahdl_getprivate(dip, rdip, dma_handle);
 	if (ihp->ihp_npremapped > 0)
 		return (DDI_SUCCESS);
-	return (immu_unmap_dvmaseg(rdip, dmao));
+	return (immu_unmap_dvmaseg(rdip, ihp, dmao));
 }
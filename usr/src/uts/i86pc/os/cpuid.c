@@ -173,7 +173,8 @@ static char *x86_feature_names[NUM_X86_FEATURES] = {
 	"smep",
 	"smap",
 	"adx",
-	"rdseed"
+	"rdseed",
+	"sha"
 };
 
 boolean_t
@@ -1271,6 +1272,9 @@ cpuid_pass1(cpu_t *cpu, uchar_t *featureset)
 
 		if (ecp->cp_ebx & CPUID_INTC_EBX_7_0_ADX)
 			add_x86_feature(featureset, X86FSET_ADX);
+
+		if (ecp->cp_ebx & CPUID_INTC_EBX_7_0_SHA)
+			add_x86_feature(featureset, X86FSET_SHA);
 	}
 
 	/*
@@ -2750,6 +2754,8 @@ cpuid_pass4(cpu_t *cpu, uint_t *hwcap_out)
 			*ebx &= ~CPUID_INTC_EBX_7_0_RDSEED;
 		if (!is_x86_feature(x86_featureset, X86FSET_ADX))
 			*ebx &= ~CPUID_INTC_EBX_7_0_ADX;
+		if (!is_x86_feature(x86_featureset, X86FSET_SHA))
+			*ebx &= ~CPUID_INTC_EBX_7_0_SHA;
 
 		/*
 		 * [no explicit support required beyond x87 fp context]
@@ -2823,6 +2829,8 @@ cpuid_pass4(cpu_t *cpu, uint_t *hwcap_out)
 			hwcap_flags_2 |= AV_386_2_ADX;
 		if (*ebx & CPUID_INTC_EBX_7_0_RDSEED)
 			hwcap_flags_2 |= AV_386_2_RDSEED;
+		if (*ebx & CPUID_INTC_EBX_7_0_SHA)
+			hwcap_flags_2 |= AV_386_2_SHA;
 
 	}
 
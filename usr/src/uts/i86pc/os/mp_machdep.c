@@ -1433,6 +1433,7 @@ mach_clkinit(int preferred_mode, int *set_mode)
 #ifndef __xpv
 	if (tsc_gethrtime_enable) {
 		tsc_hrtimeinit(cpu_freq_hz);
+		pvclock_hrtimeinit();
 	} else
 #endif
 	{
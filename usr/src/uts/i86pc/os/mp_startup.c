@@ -1753,6 +1753,13 @@ mp_startup_common(boolean_t boot)
 		xsave_setup_msr(cp);
 	}
 
+#ifndef __xpv
+	/*
+	 * Register this CPU's steal time area with the hypervisor.
+	 */
+	pvclock_cpu_init();
+#endif
+
 	cpuid_pass2(cp);
 	cpuid_pass3(cp);
 	cpuid_pass4(cp, NULL);
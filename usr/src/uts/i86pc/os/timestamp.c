@@ -30,6 +30,7 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/systm.h>
+#include <sys/sysmacros.h>
 #include <sys/disp.h>
 #include <sys/var.h>
 #include <sys/cmn_err.h>
@@ -47,6 +48,10 @@
 #include <sys/panic.h>
 #include <sys/cpu.h>
 #include <sys/sdt.h>
+#include <sys/kmem.h>
+#include <vm/as.h>
+#include <vm/hat.h>
+#include <vm/hat_i86.h>
 
 /*
  * Using the Pentium's TSC register for gethrtime()
@@ -707,6 +712,192 @@ get_tsc_ready()
 	return (tsc_ready);
 }
 
+/*
+ * KVM paravirtual clock and steal time
+ * ------------------------------------
+ *
+ * Under KVM, the TSC the guest sees may stop while a vCPU is descheduled or
+ * the guest is migrated, and its rate need not match what we calibrated.
+ * KVM instead publishes, in a structure we register with it through an
+ * MSR, a (system_time, tsc_timestamp, mul, shift) tuple that turns the TSC
+ * into nanoseconds (the "pvclock" or kvmclock).  When KVM also sets
+ * PVCLOCK_TSC_STABLE_BIT, the tuple is the same for every vCPU, so we only
+ * register the boot CPU's and use it from every CPU.  Without the stable
+ * bit we stay on the calibrated TSC; a per-CPU pvclock would need the
+ * global monotonicity fixup that tsc_gethrtime_delta() avoids.
+ *
+ * KVM can also report, per vCPU, how long the vCPU was runnable but not
+ * running because the host ran something else ("steal time").  Each CPU
+ * registers its own structure from pvclock_cpu_init(), and genunix reads
+ * it through cpu_steal_timef.
+ */
+#define	KVM_CPUID_FEATURES		0x40000001
+#define	KVM_FEATURE_CLOCKSOURCE2	(1 << 3)
+#define	KVM_FEATURE_STEAL_TIME		(1 << 5)
+#define	KVM_FEATURE_CLOCKSOURCE_STABLE	(1 << 24)
+
+#define	MSR_KVM_SYSTEM_TIME_NEW		0x4b564d01
+#define	MSR_KVM_STEAL_TIME		0x4b564d03
+#define	KVM_MSR_ENABLED			1
+
+#define	PVCLOCK_TSC_STABLE_BIT		(1 << 0)
+
+typedef struct pvclock_vcpu_time_info {
+	volatile uint32_t	pv_version;
+	uint32_t		pv_pad0;
+	volatile uint64_t	pv_tsc_timestamp;
+	volatile uint64_t	pv_system_time;
+	volatile uint32_t	pv_tsc_to_system_mul;
+	volatile int8_t		pv_tsc_shift;
+	volatile uint8_t	pv_flags;
+	uint8_t			pv_pad[2];
+} pvclock_vcpu_time_info_t;
+
+typedef struct kvm_steal_time {
+	volatile uint64_t	st_steal;
+	volatile uint32_t	st_version;
+	uint32_t		st_flags;
+	uint8_t			st_preempted;
+	uint8_t			st_pad0[3];
+	uint32_t		st_pad1[11];
+} kvm_steal_time_t;
+
+#define	KVM_STEAL_ALIGN		64	/* required by KVM */
+
+int pvclock_enable = 1;		/* gethrtime() from KVM pvclock */
+int pvclock_steal_enable = 1;	/* report KVM steal time */
+
+static pvclock_vcpu_time_info_t *pvclock_time;
+static hrtime_t pvclock_base;
+static kvm_steal_time_t *pvclock_steal;
+
+static uint64_t
+pvclock_pa(void *va)
+{
+	return (pfn_to_pa(hat_getpfnum(kas.a_hat, (caddr_t)va)) +
+	    ((uintptr_t)va & PAGEOFFSET));
+}
+
+/*
+ * Scale a TSC delta to nanoseconds: shift it, then multiply by the 32.32
+ * fixed point mul.
+ */
+static uint64_t
+pvclock_scale(uint64_t delta, uint32_t mul, int8_t shift)
+{
+	if (shift < 0)
+		delta >>= -shift;
+	else
+		delta <<= shift;
+
+	return ((delta >> 32) * mul + (((delta & 0xffffffff) * mul) >> 32));
+}
+
+static hrtime_t
+pvclock_read(void)
+{
+	pvclock_vcpu_time_info_t *pv = pvclock_time;
+	uint32_t version;
+	hrtime_t hrt;
+
+	do {
+		version = pv->pv_version;
+		membar_consumer();
+		hrt = pv->pv_system_time + pvclock_scale(
+		    tsc_read() - pv->pv_tsc_timestamp,
+		    pv->pv_tsc_to_system_mul, pv->pv_tsc_shift);
+		membar_consumer();
+	} while ((version & 1) != 0 || version != pv->pv_version);
+
+	return (hrt);
+}
+
+static hrtime_t
+pvclock_gethrtime(void)
+{
+	return (pvclock_read() - pvclock_base);
+}
+
+static hrtime_t
+pvclock_steal_time(cpu_t *cp)
+{
+	kvm_steal_time_t *st = &pvclock_steal[cp->cpu_id];
+	uint32_t version;
+	uint64_t steal;
+
+	do {
+		version = st->st_version;
+		membar_consumer();
+		steal = st->st_steal;
+		membar_consumer();
+	} while ((version & 1) != 0 || version != st->st_version);
+
+	return ((hrtime_t)steal);
+}
+
+/*
+ * Called on the boot CPU after tsc_hrtimeinit().  If we're a KVM guest and
+ * KVM offers a stable pvclock, switch gethrtime() over to it, carrying on
+ * from the current TSC-based time.  Set up steal time if KVM offers it.
+ */
+void
+pvclock_hrtimeinit(void)
+{
+	struct cpuid_regs cp;
+	uintptr_t buf;
+	ulong_t flags;
+
+	if (get_hwenv() != HW_KVM)
+		return;
+
+	cp.cp_eax = KVM_CPUID_FEATURES;
+	(void) __cpuid_insn(&cp);
+
+	if (pvclock_steal_enable && (cp.cp_eax & KVM_FEATURE_STEAL_TIME)) {
+		buf = (uintptr_t)kmem_zalloc(sizeof (kvm_steal_time_t) * NCPU +
+		    KVM_STEAL_ALIGN, KM_SLEEP);
+		pvclock_steal = (kvm_steal_time_t *)P2ROUNDUP(buf,
+		    KVM_STEAL_ALIGN);
+		pvclock_cpu_init();
+		cpu_steal_timef = pvclock_steal_time;
+	}
+
+	if (!pvclock_enable || !(cp.cp_eax & KVM_FEATURE_CLOCKSOURCE2) ||
+	    !(cp.cp_eax & KVM_FEATURE_CLOCKSOURCE_STABLE))
+		return;
+
+	pvclock_time = kmem_zalloc(sizeof (pvclock_vcpu_time_info_t),
+	    KM_SLEEP);
+	wrmsr(MSR_KVM_SYSTEM_TIME_NEW, pvclock_pa(pvclock_time) |
+	    KVM_MSR_ENABLED);
+
+	if (!(pvclock_time->pv_flags & PVCLOCK_TSC_STABLE_BIT)) {
+		wrmsr(MSR_KVM_SYSTEM_TIME_NEW, 0);
+		kmem_free(pvclock_time, sizeof (pvclock_vcpu_time_info_t));
+		pvclock_time = NULL;
+		return;
+	}
+
+	flags = clear_int_flag();
+	pvclock_base = pvclock_read() - tsc_gethrtime();
+	gethrtimef = pvclock_gethrtime;
+	restore_int_flag(flags);
+}
+
+/*
+ * Register this CPU's steal time structure with KVM.  Called on each CPU
+ * as it starts.
+ */
+void
+pvclock_cpu_init(void)
+{
+	if (pvclock_steal == NULL)
+		return;
+
+	wrmsr(MSR_KVM_STEAL_TIME,
+	    pvclock_pa(&pvclock_steal[CPU->cpu_id]) | KVM_MSR_ENABLED);
+}
+
 /*
  * Adjust all the deltas by adding the passed value to the array.
  * Then use the "delt" versions of the the gethrtime functions.
@@ -72,6 +72,7 @@ enum {
 /* flags */
 #define	APIX_VECT_USER_BOUND	0x1
 #define	APIX_VECT_MASKABLE	0x2
+#define	APIX_VECT_TARGETED	0x4	/* consumer set v_bound_cpuid */
 
 /*
  * Number of interrupt vectors reserved by software on each LOCAL APIC:
@@ -111,6 +112,9 @@ typedef struct apix_vector {
 	processorid_t		v_bound_cpuid;	/* binding cpu */
 	uint_t			v_busy;	/* How frequently did clock */
 					/* find us in this */
+	uint_t			v_holdoff;	/* balancer passes to skip */
+	uint64_t		v_ticks;	/* intr ticks at last pass */
+	hrtime_t		v_load;	/* intr time per balancer pass */
 	uint_t			v_pri;	/* maximum priority */
 	struct autovec		*v_autovect;	/* ISR linked list */
 	void			*v_intrmap_private; /* intr remap data */
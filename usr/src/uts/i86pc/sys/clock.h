@@ -56,6 +56,8 @@ extern void (*hrtime_tick)(void);
 extern void tsc_hrtimeinit(uint64_t cpu_freq_hz);
 extern void tsc_sync_master(processorid_t);
 extern void tsc_sync_slave(void);
+extern void pvclock_hrtimeinit(void);
+extern void pvclock_cpu_init(void);
 #endif
 
 /*
@@ -44,6 +44,7 @@ extern "C" {
 #include <sys/kstat.h>
 #include <sys/kmem.h>
 #include <sys/vmem.h>
+#include <sys/avl.h>
 #include <sys/rootnex.h>
 #include <sys/iommulib.h>
 #include <sys/sdt.h>
@@ -658,6 +659,23 @@ typedef enum immu_maptype {
  * domain_t
  *
  */
+/*
+ * A cached DVMA mapping of a physically contiguous range, see the
+ * "DVMA mapping cache" comment in immu_dvma.c
+ */
+typedef struct immu_dvcache_ent {
+	avl_node_t		idc_avl;	/* on dom_dvcache, by paddr */
+	list_node_t		idc_lru;	/* on dom_dvcache_lru if idle */
+	uint64_t		idc_paddr;	/* first physical page */
+	uint64_t		idc_npages;
+	uint64_t		idc_dvma;
+	immu_flags_t		idc_flags;	/* IMMU_FLAGS_READ/WRITE */
+	uint_t			idc_ref;	/* handles bound to it */
+} immu_dvcache_ent_t;
+
+/* DVMA ranges held back from the arena until the next IOTLB flush */
+#define	IMMU_NDVFREE	64
+
 typedef struct domain {
 	/* the basics */
 	uint_t			dom_did;
@@ -681,6 +699,15 @@ typedef struct domain {
 
 	/* topmost device in domain; usually the device itself (non-shared) */
 	dev_info_t		*dom_dip;
+
+	/* DVMA mapping cache and deferred DVMA frees */
+	kmutex_t		dom_dvcache_lock;
+	avl_tree_t		dom_dvcache;
+	list_t			dom_dvcache_lru;
+	uint64_t		dom_dvcache_npages;
+	uint_t			dom_ndvfree;
+	struct dvmaseg		dom_dvfree[IMMU_NDVFREE];
+	immu_inv_wait_t		dom_inv_wait;
 } domain_t;
 
 typedef enum immu_pcib {
@@ -761,6 +788,8 @@ typedef struct immu_hdl_private {
 	hw_pdte_t *ihp_preptes[IMMU_NPREPTES];
 	uint64_t ihp_predvma;
 	int ihp_npremapped;
+
+	immu_dvcache_ent_t *ihp_dvcache;
 } immu_hdl_priv_t;
 
 /*
@@ -832,6 +861,9 @@ extern boolean_t immu_dmar_print;
 
 /* tunables */
 extern int64_t immu_flush_gran;
+extern boolean_t immu_dvcache_enable;
+extern uint64_t immu_dvcache_maxpages;
+extern boolean_t immu_dvma_lazy_flush;
 
 extern immu_flags_t immu_global_dvma_flags;
 
@@ -68,6 +68,7 @@
 #include <sys/bootsvcs.h>
 #include <sys/bootinfo.h>
 #include <sys/archsystm.h>
+#include <sys/kstat.h>
 
 #include <vm/seg_kmem.h>
 #include <vm/hat_i86.h>
@@ -109,7 +110,8 @@ static x86pte_t *vlp_page;
  * forward declaration of internal utility routines
  */
 static x86pte_t hati_update_pte(htable_t *ht, uint_t entry, x86pte_t expected,
-	x86pte_t new);
+	x86pte_t new, boolean_t tlb);
+static void hati_dup_cow(hat_t *hat, uintptr_t vaddr, uintptr_t eaddr);
 
 /*
  * The kernel address space exists in all HATs. To implement this the
@@ -177,6 +179,26 @@ kmem_cache_t	*vlp_hash_cache;
  */
 struct hatstats hatstat;
 
+/*
+ * TLB shootdown statistics, exported as unix:0:hat_tlb: the number of
+ * batches flushed, the cross calls and interrupts to other CPUs needed to
+ * do them, and the pages invalidated.
+ */
+kstat_named_t hat_tlb_stat[] = {
+	{ "flushes",		KSTAT_DATA_UINT64 },
+	{ "xcalls",		KSTAT_DATA_UINT64 },
+	{ "ipis",		KSTAT_DATA_UINT64 },
+	{ "pages",		KSTAT_DATA_UINT64 },
+};
+
+#define	HAT_TLB_FLUSHES		0
+#define	HAT_TLB_XCALLS		1
+#define	HAT_TLB_IPIS		2
+#define	HAT_TLB_PAGES		3
+
+#define	HAT_TLB_STAT_ADD(stat, n)	\
+	atomic_add_64(&hat_tlb_stat[(stat)].value.ui64, (n))
+
 /*
  * Some earlier hypervisor versions do not emulate cmpxchg of PTEs
  * correctly.  For such hypervisors we must set PT_USER for kernel
@@ -844,7 +866,7 @@ hat_init_finish(void)
 	uint_t		r = 0;
 	uintptr_t	va;
 	hat_kernel_range_t *rp;
-
+	kstat_t		*ksp;
 
 	/*
 	 * We are now effectively running on the kernel hat.
@@ -941,6 +963,14 @@ hat_init_finish(void)
 	size = segmapsize;
 #endif
 	hat_kmap_init((uintptr_t)segmap_start, size);
+
+	ksp = kstat_create("unix", 0, "hat_tlb", "vm", KSTAT_TYPE_NAMED,
+	    sizeof (hat_tlb_stat) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp != NULL) {
+		ksp->ks_data = (void *)hat_tlb_stat;
+		kstat_install(ksp);
+	}
 }
 
 /*
@@ -1112,7 +1142,11 @@ hati_mkpte(pfn_t pfn, uint_t attr, level_t level, uint_t flags)
 
 /*
  * Duplicate address translations of the parent to the child.
- * This function really isn't used anymore.
+ *
+ * Nothing is ever loaded into the child's hat; it faults its translations
+ * in as it touches its pages.  HAT_DUP_COW write protects the parent's
+ * translations for [addr, addr + len), so that its next store to each
+ * page takes a copy-on-write fault.
  */
 /*ARGSUSED*/
 int
@@ -1121,9 +1155,68 @@ hat_dup(hat_t *old, hat_t *new, caddr_t addr, size_t len, uint_t flag)
 	ASSERT((uintptr_t)addr < kernelbase);
 	ASSERT(new != kas.a_hat);
 	ASSERT(old != kas.a_hat);
+
+	if (flag == HAT_DUP_COW) {
+		hati_dup_cow(old, (uintptr_t)addr, (uintptr_t)addr + len);
+	}
 	return (0);
 }
 
+/*
+ * Write protect the translations in [vaddr, eaddr) for HAT_DUP_COW.
+ *
+ * This is hat_clrattr(PROT_WRITE), except that the TLB is invalidated
+ * once for the whole hat at the end rather than once per PTE.  Per-PTE
+ * invalidation made the time a large process spends stopped in fork()
+ * grow with its resident set.
+ *
+ * Deferring the invalidation is safe only because as_dup() runs with the
+ * address space locked and every other lwp of the process held, so there
+ * is nothing to store through a stale writable TLB entry before the flush.
+ * For the same reason x86pte_update() needn't check for a store that
+ * raced the invalidation.
+ */
+static void
+hati_dup_cow(hat_t *hat, uintptr_t vaddr, uintptr_t eaddr)
+{
+	htable_t	*ht = NULL;
+	uint_t		entry;
+	x86pte_t	oldpte;
+	page_t		*pp;
+	boolean_t	changed = B_FALSE;
+
+	XPV_DISALLOW_MIGRATE();
+	ASSERT(IS_PAGEALIGNED(vaddr));
+	ASSERT(IS_PAGEALIGNED(eaddr));
+	ASSERT(AS_LOCK_HELD(hat->hat_as));
+	for (; vaddr < eaddr; vaddr += LEVEL_SIZE(ht->ht_level)) {
+try_again:
+		oldpte = htable_walk(hat, &ht, &vaddr, eaddr);
+		if (ht == NULL)
+			break;
+		if (PTE_GET(oldpte, PT_SOFTWARE) >= PT_NOCONSIST ||
+		    !PTE_GET(oldpte, PT_WRITABLE))
+			continue;
+
+		pp = page_numtopp_nolock(PTE2PFN(oldpte, ht->ht_level));
+		if (pp == NULL)
+			continue;
+		x86_hm_enter(pp);
+		entry = htable_va2entry(vaddr, ht);
+		oldpte = hati_update_pte(ht, entry, oldpte,
+		    oldpte & ~PT_WRITABLE, B_FALSE);
+		x86_hm_exit(pp);
+		if (oldpte != 0)
+			goto try_again;
+		changed = B_TRUE;
+	}
+	if (ht)
+		htable_release(ht);
+	if (changed)
+		hat_tlb_inval(hat, DEMAP_ALL_ADDR);
+	XPV_ALLOW_MIGRATE();
+}
+
 /*
  * Allocate any hat resources required for a process being swapped in.
  */
@@ -1916,31 +2009,26 @@ hat_unlock_region(struct hat *hat, caddr_t addr, size_t len,
 
 #if !defined(__xpv)
 /*
- * Cross call service routine to demap a virtual page on
- * the current CPU or flush all mappings in TLB.
+ * Demap a range of virtual pages on the current CPU, or flush all mappings
+ * in TLB.
  */
-/*ARGSUSED*/
-static int
-hati_demap_func(xc_arg_t a1, xc_arg_t a2, xc_arg_t a3)
+static void
+hati_demap_range(hat_t *hat, uintptr_t va, size_t len)
 {
-	hat_t	*hat = (hat_t *)a1;
-	caddr_t	addr = (caddr_t)a2;
-	size_t len = (size_t)a3;
-
 	/*
 	 * If the target hat isn't the kernel and this CPU isn't operating
-	 * in the target hat, we can ignore the cross call.
+	 * in the target hat, we can ignore it.
 	 */
 	if (hat != kas.a_hat && hat != CPU->cpu_current_hat)
-		return (0);
+		return;
 
 	/*
 	 * For a normal address, we flush a range of contiguous mappings
 	 */
-	if ((uintptr_t)addr != DEMAP_ALL_ADDR) {
+	if (va != DEMAP_ALL_ADDR) {
 		for (size_t i = 0; i < len; i += MMU_PAGESIZE)
-			mmu_tlbflush_entry(addr + i);
-		return (0);
+			mmu_tlbflush_entry((caddr_t)(va + i));
+		return;
 	}
 
 	/*
@@ -1959,6 +2047,20 @@ hati_demap_func(xc_arg_t a1, xc_arg_t a2, xc_arg_t a3)
 #endif
 	}
 	reload_cr3();
+}
+
+/*
+ * Cross call service routine to demap a batch of ranges on the current CPU.
+ */
+/*ARGSUSED*/
+static int
+hati_demap_func(xc_arg_t a1, xc_arg_t a2, xc_arg_t a3)
+{
+	tlb_range_t	*tr = (tlb_range_t *)a1;
+	uint_t		cnt = (uint_t)a2;
+
+	for (; cnt > 0; --cnt, ++tr)
+		hati_demap_range(tr->tr_hat, tr->tr_va, tr->tr_len);
 	return (0);
 }
 
@@ -2030,20 +2132,26 @@ tlb_service(void)
 #endif /* !__xpv */
 
 /*
- * Internal routine to do cross calls to invalidate a range of pages on
- * all CPUs using a given hat.
+ * TLB invalidations are collected in a tlb_batch_t and then done by
+ * tlb_batch_flush() with a single cross call to the union of the CPUs
+ * that need them, rather than one cross call each.  This matters when
+ * unloading many ranges (hat_unload_callback()), or a page that is mapped
+ * by many processes (hat_pageunload()).
+ *
+ * Deferring the invalidation is safe as long as the batch is flushed
+ * before the pages whose translations were removed can be reused.  The set
+ * of CPUs to shoot down for each hat is sampled when the range is added,
+ * which is after its PTEs have been cleared; a CPU that starts using the
+ * hat after that point reloads %cr3, and so can't have stale entries.
+ */
+/*
+ * Add a range to be invalidated on all CPUs using hat.  Must be called
+ * after the range's PTEs are cleared, while the hat is known to exist.
  */
 void
-hat_tlb_inval_range(hat_t *hat, uintptr_t va, size_t len)
+tlb_batch_add(tlb_batch_t *tb, hat_t *hat, uintptr_t va, size_t len)
 {
-	extern int	flushes_require_xcalls;	/* from mp_startup.c */
-	cpuset_t	justme;
-	cpuset_t	cpus_to_shootdown;
-#ifndef __xpv
-	cpuset_t	check_cpus;
-	cpu_t		*cpup;
-	int		c;
-#endif
+	tlb_range_t	*tr;
 
 	/*
 	 * If the hat is being destroyed, there are no more users, so
@@ -2062,35 +2170,90 @@ hat_tlb_inval_range(hat_t *hat, uintptr_t va, size_t len)
 		va = DEMAP_ALL_ADDR;
 	}
 
+	if (tb->tb_cnt == TLB_BATCH_MAX)
+		tlb_batch_flush(tb);
+
 	/*
-	 * if not running with multiple CPUs, don't use cross calls
+	 * Kernel changes always do all CPUs.  Otherwise it's just CPUs
+	 * currently executing in this hat.
 	 */
-	if (panicstr || !flushes_require_xcalls) {
+	if (hat == kas.a_hat) {
+		CPUSET_OR(tb->tb_cpus, khat_cpuset);
+	} else {
+		CPUSET_OR(tb->tb_cpus, hat->hat_cpus);
+	}
+
+	tr = &tb->tb_range[tb->tb_cnt++];
+	tr->tr_hat = hat;
+	tr->tr_va = va;
+	tr->tr_len = len;
+}
+
+/*
+ * Do the invalidations in a batch on the current CPU only.
+ */
+static void
+tlb_batch_local(tlb_batch_t *tb)
+{
 #ifdef __xpv
-		if (va == DEMAP_ALL_ADDR) {
+	tlb_range_t	*tr;
+	uint_t		cnt;
+
+	for (tr = tb->tb_range, cnt = tb->tb_cnt; cnt > 0; --cnt, ++tr) {
+		if (tr->tr_va == DEMAP_ALL_ADDR) {
 			xen_flush_tlb();
 		} else {
-			for (size_t i = 0; i < len; i += MMU_PAGESIZE)
-				xen_flush_va((caddr_t)(va + i));
+			for (size_t i = 0; i < tr->tr_len; i += MMU_PAGESIZE)
+				xen_flush_va((caddr_t)(tr->tr_va + i));
 		}
+	}
 #else
-		(void) hati_demap_func((xc_arg_t)hat,
-		    (xc_arg_t)va, (xc_arg_t)len);
+	(void) hati_demap_func((xc_arg_t)tb->tb_range,
+	    (xc_arg_t)tb->tb_cnt, 0);
+#endif
+}
+
+/*
+ * Do the invalidations in a batch on all the CPUs that need them, and
+ * empty it.
+ */
+void
+tlb_batch_flush(tlb_batch_t *tb)
+{
+	extern int	flushes_require_xcalls;	/* from mp_startup.c */
+	cpuset_t	justme;
+	cpuset_t	cpus_to_shootdown;
+	tlb_range_t	*tr;
+	uint64_t	npages = 0;
+	uint_t		cnt;
+#ifndef __xpv
+	cpuset_t	check_cpus;
+	cpu_t		*cpup;
+	uint64_t	nipis = 0;
+	int		c;
 #endif
+
+	if (tb->tb_cnt == 0)
 		return;
-	}
 
+	for (tr = tb->tb_range, cnt = tb->tb_cnt; cnt > 0; --cnt, ++tr) {
+		npages += (tr->tr_va == DEMAP_ALL_ADDR) ? 1 :
+		    mmu_btop(tr->tr_len);
+	}
+	HAT_TLB_STAT_ADD(HAT_TLB_FLUSHES, 1);
+	HAT_TLB_STAT_ADD(HAT_TLB_PAGES, npages);
 
 	/*
-	 * Determine CPUs to shootdown. Kernel changes always do all CPUs.
-	 * Otherwise it's just CPUs currently executing in this hat.
+	 * if not running with multiple CPUs, don't use cross calls
 	 */
+	if (panicstr || !flushes_require_xcalls) {
+		tlb_batch_local(tb);
+		goto out;
+	}
+
 	kpreempt_disable();
 	CPUSET_ONLY(justme, CPU->cpu_id);
-	if (hat == kas.a_hat)
-		cpus_to_shootdown = khat_cpuset;
-	else
-		cpus_to_shootdown = hat->hat_cpus;
+	cpus_to_shootdown = tb->tb_cpus;
 
 #ifndef __xpv
 	/*
@@ -2118,44 +2281,54 @@ hat_tlb_inval_range(hat_t *hat, uintptr_t va, size_t len)
 		if (tlb_info == (TLB_CPU_HALTED | TLB_INVAL_ALL)) {
 			HATSTAT_INC(hs_tlb_inval_delayed);
 			CPUSET_DEL(cpus_to_shootdown, c);
+		} else if (c != CPU->cpu_id) {
+			nipis++;
 		}
 	}
 #endif
 
 	if (CPUSET_ISNULL(cpus_to_shootdown) ||
 	    CPUSET_ISEQUAL(cpus_to_shootdown, justme)) {
-
-#ifdef __xpv
-		if (va == DEMAP_ALL_ADDR) {
-			xen_flush_tlb();
-		} else {
-			for (size_t i = 0; i < len; i += MMU_PAGESIZE)
-				xen_flush_va((caddr_t)(va + i));
-		}
-#else
-		(void) hati_demap_func((xc_arg_t)hat,
-		    (xc_arg_t)va, (xc_arg_t)len);
-#endif
-
+		tlb_batch_local(tb);
 	} else {
-
 		CPUSET_ADD(cpus_to_shootdown, CPU->cpu_id);
+		HAT_TLB_STAT_ADD(HAT_TLB_XCALLS, 1);
 #ifdef __xpv
-		if (va == DEMAP_ALL_ADDR) {
-			xen_gflush_tlb(cpus_to_shootdown);
-		} else {
-			for (size_t i = 0; i < len; i += MMU_PAGESIZE) {
-				xen_gflush_va((caddr_t)(va + i),
+		for (tr = tb->tb_range, cnt = tb->tb_cnt; cnt > 0;
+		    --cnt, ++tr) {
+			if (tr->tr_va == DEMAP_ALL_ADDR) {
+				xen_gflush_tlb(cpus_to_shootdown);
+				continue;
+			}
+			for (size_t i = 0; i < tr->tr_len; i += MMU_PAGESIZE) {
+				xen_gflush_va((caddr_t)(tr->tr_va + i),
 				    cpus_to_shootdown);
 			}
 		}
 #else
-		xc_call((xc_arg_t)hat, (xc_arg_t)va, (xc_arg_t)len,
+		HAT_TLB_STAT_ADD(HAT_TLB_IPIS, nipis);
+		xc_call((xc_arg_t)tb->tb_range, (xc_arg_t)tb->tb_cnt, 0,
 		    CPUSET2BV(cpus_to_shootdown), hati_demap_func);
 #endif
-
 	}
 	kpreempt_enable();
+
+out:
+	TLB_BATCH_INIT(tb);
+}
+
+/*
+ * Internal routine to do cross calls to invalidate a range of pages on
+ * all CPUs using a given hat.
+ */
+void
+hat_tlb_inval_range(hat_t *hat, uintptr_t va, size_t len)
+{
+	tlb_batch_t	tb;
+
+	TLB_BATCH_INIT(&tb);
+	tlb_batch_add(&tb, hat, va, len);
+	tlb_batch_flush(&tb);
 }
 
 void
@@ -2338,17 +2511,28 @@ typedef struct range_info {
 
 /*
  * Invalidate the TLB, and perform the callback to the upper level VM system,
- * for the specified ranges of contiguous pages.
+ * for the specified ranges of contiguous pages.  The invalidations for all
+ * the ranges are done with a single cross call.
  */
 static void
 handle_ranges(hat_t *hat, hat_callback_t *cb, uint_t cnt, range_info_t *range)
 {
+	tlb_batch_t	tb;
+	uint_t		i;
+
+	ASSERT(cnt <= TLB_BATCH_MAX);
+	TLB_BATCH_INIT(&tb);
+	for (i = 0; i < cnt; i++) {
+		tlb_batch_add(&tb, hat, (uintptr_t)range[i].rng_va,
+		    range[i].rng_cnt << LEVEL_SHIFT(range[i].rng_level));
+	}
+	tlb_batch_flush(&tb);
+
 	while (cnt > 0) {
 		size_t len;
 
 		--cnt;
 		len = range[cnt].rng_cnt << LEVEL_SHIFT(range[cnt].rng_level);
-		hat_tlb_inval_range(hat, (uintptr_t)range[cnt].rng_va, len);
 
 		if (cb != NULL) {
 			cb->hcb_start_addr = (caddr_t)range[cnt].rng_va;
@@ -2369,7 +2553,7 @@ handle_ranges(hat_t *hat, hat_callback_t *cb, uint_t cnt, range_info_t *range)
  * define	HAT_UNLOAD_OTHER	0x08 - not used
  * define	HAT_UNLOAD_UNMAP	0x10 - same as HAT_UNLOAD
  */
-#define	MAX_UNLOAD_CNT (8)
+#define	MAX_UNLOAD_CNT (TLB_BATCH_MAX)
 void
 hat_unload_callback(
 	hat_t		*hat,
@@ -2438,10 +2622,10 @@ hat_unload_callback(
 		 * Unload one mapping (for a single page) from the page tables.
 		 * Note that we do not remove the mapping from the TLB yet,
 		 * as indicated by the tlb=FALSE argument to hat_pte_unmap().
-		 * handle_ranges() will clear the TLB entries with one call to
-		 * hat_tlb_inval_range() per contiguous range.  This is
-		 * safe because the page can not be reused until the
-		 * callback is made (or we return).
+		 * handle_ranges() will clear the TLB entries for all the
+		 * ranges with one cross call.  This is safe because the
+		 * page can not be reused until the callback is made (or we
+		 * return).
 		 */
 		entry = htable_va2entry(vaddr, ht);
 		hat_pte_unmap(ht, entry, flags, old_pte, NULL, B_FALSE);
@@ -2553,7 +2737,7 @@ try_again:
 		if (flags == HAT_SYNC_ZERORM) {
 			new = pte;
 			PTE_CLR(new, PT_REF | PT_MOD);
-			pte = hati_update_pte(ht, entry, pte, new);
+			pte = hati_update_pte(ht, entry, pte, new, B_TRUE);
 			if (pte != 0) {
 				x86_hm_exit(pp);
 				goto try_again;
@@ -2715,7 +2899,8 @@ try_again:
 		 */
 		if (newpte != oldpte) {
 			entry = htable_va2entry(vaddr, ht);
-			oldpte = hati_update_pte(ht, entry, oldpte, newpte);
+			oldpte = hati_update_pte(ht, entry, oldpte, newpte,
+			    B_TRUE);
 			if (oldpte != 0) {
 				x86_hm_exit(pp);
 				goto try_again;
@@ -3215,7 +3400,7 @@ next_size:
 			 */
 			new = old;
 			PTE_CLR(new, PT_REF | PT_MOD | PT_WRITABLE);
-			old = hati_update_pte(ht, entry, old, new);
+			old = hati_update_pte(ht, entry, old, new, B_TRUE);
 			if (old != 0)
 				continue;
 
@@ -3326,7 +3511,7 @@ hat_page_getattr(struct page *pp, uint_t flag)
  * common code used by hat_pageunload() and hment_steal()
  */
 hment_t *
-hati_page_unmap(page_t *pp, htable_t *ht, uint_t entry)
+hati_page_unmap(page_t *pp, htable_t *ht, uint_t entry, tlb_batch_t *tb)
 {
 	x86pte_t old_pte;
 	pfn_t pfn = pp->p_pagenum;
@@ -3341,14 +3526,19 @@ hati_page_unmap(page_t *pp, htable_t *ht, uint_t entry)
 	htable_acquire(ht);
 
 	/*
-	 * Invalidate the PTE and remove the hment.
+	 * Invalidate the PTE and remove the hment.  If we were given a
+	 * batch, the TLB invalidation is left to the caller's
+	 * tlb_batch_flush().
 	 */
-	old_pte = x86pte_inval(ht, entry, 0, NULL, B_TRUE);
+	old_pte = x86pte_inval(ht, entry, 0, NULL, tb == NULL);
 	if (PTE2PFN(old_pte, ht->ht_level) != pfn) {
 		panic("x86pte_inval() failure found PTE = " FMT_PTE
 		    " pfn being unmapped is %lx ht=0x%lx entry=0x%x",
 		    old_pte, pfn, (uintptr_t)ht, entry);
 	}
+	if (tb != NULL && (old_pte & (PT_REF | PT_MOD)))
+		tlb_batch_add(tb, ht->ht_hat, htable_e2va(ht, entry),
+		    MMU_PAGESIZE);
 
 	/*
 	 * Clean up all the htable information for this mapping
@@ -3395,8 +3585,10 @@ hati_pageunload(struct page *pp, uint_t pg_szcd, uint_t forceflag)
 	htable_t	*ht;
 	uint_t		entry;
 	level_t		level;
+	tlb_batch_t	tb;
 
 	XPV_DISALLOW_MIGRATE();
+	TLB_BATCH_INIT(&tb);
 
 	/*
 	 * prevent recursion due to kmem_free()
@@ -3431,6 +3623,7 @@ next_size:
 				 * If not part of a larger page, we're done.
 				 */
 				if (cur_pp->p_szc <= pg_szcd) {
+					tlb_batch_flush(&tb);
 					ASSERT(curthread->t_hatdepth > 0);
 					--curthread->t_hatdepth;
 					XPV_ALLOW_MIGRATE();
@@ -3459,9 +3652,12 @@ next_size:
 
 		/*
 		 * Remove the mapping list entry for this page.
-		 * Note this does the x86_hm_exit() for us.
+		 * Note this does the x86_hm_exit() for us.  The TLB
+		 * invalidations for all the mappings are collected in tb
+		 * and done together before we return, since the page can't
+		 * be reused until then.
 		 */
-		hm = hati_page_unmap(cur_pp, ht, entry);
+		hm = hati_page_unmap(cur_pp, ht, entry, &tb);
 		if (hm != NULL)
 			hment_free(hm);
 	}
@@ -3719,7 +3915,7 @@ try_again:
 			 */
 			new = old;
 			PTE_CLR(new, PT_REF | PT_MOD);
-			old = hati_update_pte(ht, entry, old, new);
+			old = hati_update_pte(ht, entry, old, new, B_TRUE);
 			if (old != 0)
 				goto try_again;
 
@@ -4095,9 +4291,12 @@ clear_boot_mappings(uintptr_t low, uintptr_t high)
  *
  * If activating nosync or NOWRITE and the page was modified we need to sync
  * with the page_t. Also sync with page_t if clearing ref/mod bits.
+ *
+ * If tlb is B_FALSE the caller is responsible for invalidating the TLB.
  */
 static x86pte_t
-hati_update_pte(htable_t *ht, uint_t entry, x86pte_t expected, x86pte_t new)
+hati_update_pte(htable_t *ht, uint_t entry, x86pte_t expected, x86pte_t new,
+    boolean_t tlb)
 {
 	page_t		*pp;
 	uint_t		rm = 0;
@@ -4118,7 +4317,7 @@ hati_update_pte(htable_t *ht, uint_t entry, x86pte_t expected, x86pte_t new)
 		PTE_CLR(new, PT_MOD | PT_REF);
 	}
 
-	replaced = x86pte_update(ht, entry, expected, new);
+	replaced = x86pte_update(ht, entry, expected, new, tlb);
 	if (replaced != expected)
 		return (replaced);
 
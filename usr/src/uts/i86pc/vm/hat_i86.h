@@ -238,7 +238,34 @@ extern page_t *hat_kpm_vaddr2page(caddr_t);
 extern uintptr_t hat_kernelbase(uintptr_t);
 extern void hat_kmap_init(uintptr_t base, size_t len);
 
-extern hment_t *hati_page_unmap(page_t *pp, htable_t *ht, uint_t entry);
+/*
+ * A batch of TLB invalidations, done together by tlb_batch_flush() with a
+ * single cross call.
+ */
+#define	TLB_BATCH_MAX	(8)
+
+typedef struct tlb_range {
+	struct hat	*tr_hat;
+	uintptr_t	tr_va;
+	size_t		tr_len;
+} tlb_range_t;
+
+typedef struct tlb_batch {
+	cpuset_t	tb_cpus;	/* CPUs to shoot down */
+	uint_t		tb_cnt;		/* number of ranges */
+	tlb_range_t	tb_range[TLB_BATCH_MAX];
+} tlb_batch_t;
+
+#define	TLB_BATCH_INIT(tb)	{		\
+	CPUSET_ZERO((tb)->tb_cpus);		\
+	(tb)->tb_cnt = 0;			\
+}
+
+extern void tlb_batch_add(tlb_batch_t *, struct hat *, uintptr_t, size_t);
+extern void tlb_batch_flush(tlb_batch_t *);
+
+extern hment_t *hati_page_unmap(page_t *pp, htable_t *ht, uint_t entry,
+	tlb_batch_t *tb);
 
 #if !defined(__xpv)
 /*
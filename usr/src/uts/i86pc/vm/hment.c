@@ -772,7 +772,7 @@ hment_steal(void)
 	 * Steal the mapping we found.  Note that hati_page_unmap() will
 	 * do the x86_hm_exit().
 	 */
-	hm2 = hati_page_unmap(pp, ht, hm->hm_entry);
+	hm2 = hati_page_unmap(pp, ht, hm->hm_entry, NULL);
 	ASSERT(hm2 == hm);
 	last_page = pp;
 	return (hm);
@@ -2296,13 +2296,16 @@ done:
 
 /*
  * Change a page table entry af it currently matches the value in expect.
+ * If tlb is B_FALSE, the caller will invalidate the TLB itself and must
+ * ensure no store can be made through a stale TLB entry until it does.
  */
 x86pte_t
 x86pte_update(
 	htable_t *ht,
 	uint_t entry,
 	x86pte_t expect,
-	x86pte_t new)
+	x86pte_t new,
+	boolean_t tlb)
 {
 	x86pte_t	*ptep;
 	x86pte_t	found;
@@ -2315,7 +2318,7 @@ x86pte_update(
 	XPV_ALLOW_PAGETABLE_UPDATES();
 	found = CAS_PTE(ptep, expect, new);
 	XPV_DISALLOW_PAGETABLE_UPDATES();
-	if (found == expect) {
+	if (found == expect && tlb) {
 		hat_tlb_inval(ht->ht_hat, htable_e2va(ht, entry));
 
 		/*
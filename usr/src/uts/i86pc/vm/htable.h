@@ -277,7 +277,7 @@ extern x86pte_t x86pte_inval(htable_t *ht, uint_t entry,
 	x86pte_t old, x86pte_t *ptr, boolean_t tlb);
 
 extern x86pte_t x86pte_update(htable_t *ht, uint_t entry,
-	x86pte_t old, x86pte_t new);
+	x86pte_t old, x86pte_t new, boolean_t tlb);
 
 extern void	x86pte_copy(htable_t *src, htable_t *dest, uint_t entry,
 	uint_t cnt);
@@ -0,0 +1,234 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Fletcher-4 checksum inner loops using SSE2.
+ *
+ * These keep the same four lanes as the superscalar4 implementation in
+ * zfs_fletcher.c: lane j sums words j, j + 4, j + 8, ... of the input.
+ * Each accumulator is held as two vectors of two 64-bit lanes, so one
+ * 16-byte block is added to all four lanes with eight paddq, in two
+ * independent chains.  The caller combines the lanes with
+ * fletcher_4_superscalar4_fini() and adds any trailing words.
+ *
+ * SSE2 has no byte shuffle, so the byteswap loop swaps the bytes of each
+ * 16-bit word with shifts and then the 16-bit words of each 32-bit word
+ * with pshuflw and pshufhw.
+ *
+ * The caller is responsible for ensuring kpreempt_disable() has been
+ * called.  Clear and set the CR0.TS bit on entry and exit, respectively,
+ * if TS is set on entry.  Otherwise, if TS is not set, save and restore
+ * %xmm registers on the stack.
+ *
+ * Register usage:
+ * %xmm0, %xmm1		a, lanes 0-1 and 2-3
+ * %xmm2, %xmm3		b, lanes 0-1 and 2-3
+ * %xmm4, %xmm5		c, lanes 0-1 and 2-3
+ * %xmm6, %xmm7		d, lanes 0-1 and 2-3
+ * %xmm8, %xmm9		Input words, zero-extended to 64 bits
+ * %xmm10		Zero
+ *
+ * Interface:
+ * void fletcher_4_sse2_native(uint64_t acc[16], const void *buf,
+ *	size_t nblocks)
+ * void fletcher_4_sse2_byteswap(uint64_t acc[16], const void *buf,
+ *	size_t nblocks)
+ *
+ * acc holds a[4], b[4], c[4] and d[4], and is added to; nblocks is the
+ * number of 16-byte blocks in buf.
+ */
+
+#if defined(lint) || defined(__lint)
+
+#include <sys/types.h>
+
+/* ARGSUSED */
+void
+fletcher_4_sse2_native(uint64_t acc[16], const void *buf, size_t nblocks)
+{
+}
+
+/* ARGSUSED */
+void
+fletcher_4_sse2_byteswap(uint64_t acc[16], const void *buf, size_t nblocks)
+{
+}
+
+#else	/* lint */
+
+#include <sys/asm_linkage.h>
+#include <sys/controlregs.h>
+#ifdef _KERNEL
+#include <sys/machprivregs.h>
+#endif
+
+#ifdef _KERNEL
+	/*
+	 * Note: the CLTS macro clobbers P2 (%rsi) under i86xpv.  That is,
+	 * it calls HYPERVISOR_fpu_taskswitch() which modifies %rsi when it
+	 * uses it to pass P2 to syscall.
+	 */
+#ifdef __xpv
+#define	PROTECTED_CLTS \
+	push	%rsi; \
+	CLTS; \
+	pop	%rsi
+#else
+#define	PROTECTED_CLTS \
+	CLTS
+#endif	/* __xpv */
+
+	/*
+	 * If CR0_TS is not set, align stack (with push %rbp) and push
+	 * %xmm0 - %xmm10 on stack, otherwise clear CR0_TS
+	 */
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(tmpreg) \
+	push	%rbp; \
+	mov	%rsp, %rbp; \
+	movq	%cr0, tmpreg; \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	and	$-XMM_ALIGN, %rsp; \
+	sub	$[XMM_SIZE * 11], %rsp; \
+	movaps	%xmm0, 160(%rsp); \
+	movaps	%xmm1, 144(%rsp); \
+	movaps	%xmm2, 128(%rsp); \
+	movaps	%xmm3, 112(%rsp); \
+	movaps	%xmm4, 96(%rsp); \
+	movaps	%xmm5, 80(%rsp); \
+	movaps	%xmm6, 64(%rsp); \
+	movaps	%xmm7, 48(%rsp); \
+	movaps	%xmm8, 32(%rsp); \
+	movaps	%xmm9, 16(%rsp); \
+	movaps	%xmm10, (%rsp); \
+	jmp	2f; \
+1: \
+	PROTECTED_CLTS; \
+2:
+
+	/*
+	 * If CR0_TS was not set above, pop %xmm0 - %xmm10 off stack,
+	 * otherwise set CR0_TS.
+	 */
+#define	SET_TS_OR_POP_XMM0_TO_XMM10(tmpreg) \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	movaps	(%rsp), %xmm10; \
+	movaps	16(%rsp), %xmm9; \
+	movaps	32(%rsp), %xmm8; \
+	movaps	48(%rsp), %xmm7; \
+	movaps	64(%rsp), %xmm6; \
+	movaps	80(%rsp), %xmm5; \
+	movaps	96(%rsp), %xmm4; \
+	movaps	112(%rsp), %xmm3; \
+	movaps	128(%rsp), %xmm2; \
+	movaps	144(%rsp), %xmm1; \
+	movaps	160(%rsp), %xmm0; \
+	jmp	2f; \
+1: \
+	STTS(tmpreg); \
+2: \
+	mov	%rbp, %rsp; \
+	pop	%rbp
+
+#else
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(tmpreg)
+#define	SET_TS_OR_POP_XMM0_TO_XMM10(tmpreg)
+#endif	/* _KERNEL */
+
+/* Load the accumulators from acc */
+#define	FLETCHER_4_LOAD \
+	movdqu	(%rdi), %xmm0; \
+	movdqu	16(%rdi), %xmm1; \
+	movdqu	32(%rdi), %xmm2; \
+	movdqu	48(%rdi), %xmm3; \
+	movdqu	64(%rdi), %xmm4; \
+	movdqu	80(%rdi), %xmm5; \
+	movdqu	96(%rdi), %xmm6; \
+	movdqu	112(%rdi), %xmm7; \
+	pxor	%xmm10, %xmm10
+
+/* Store the accumulators back to acc */
+#define	FLETCHER_4_STORE \
+	movdqu	%xmm0, (%rdi); \
+	movdqu	%xmm1, 16(%rdi); \
+	movdqu	%xmm2, 32(%rdi); \
+	movdqu	%xmm3, 48(%rdi); \
+	movdqu	%xmm4, 64(%rdi); \
+	movdqu	%xmm5, 80(%rdi); \
+	movdqu	%xmm6, 96(%rdi); \
+	movdqu	%xmm7, 112(%rdi)
+
+/* Add the words in %xmm8 (lanes 0-1) and %xmm9 (lanes 2-3) */
+#define	FLETCHER_4_ADD \
+	paddq	%xmm8, %xmm0; \
+	paddq	%xmm9, %xmm1; \
+	paddq	%xmm0, %xmm2; \
+	paddq	%xmm1, %xmm3; \
+	paddq	%xmm2, %xmm4; \
+	paddq	%xmm3, %xmm5; \
+	paddq	%xmm4, %xmm6; \
+	paddq	%xmm5, %xmm7
+
+ENTRY_NP(fletcher_4_sse2_native)
+	test	%rdx, %rdx
+	jz	.Lfletcher_4_native_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(%r10)
+	FLETCHER_4_LOAD
+
+.align 16
+.Lfletcher_4_native_loop:
+	movdqu	(%rsi), %xmm8
+	movdqa	%xmm8, %xmm9
+	punpckldq %xmm10, %xmm8
+	punpckhdq %xmm10, %xmm9
+	FLETCHER_4_ADD
+	lea	16(%rsi), %rsi
+	dec	%rdx
+	jnz	.Lfletcher_4_native_loop
+
+	FLETCHER_4_STORE
+	SET_TS_OR_POP_XMM0_TO_XMM10(%r10)
+.Lfletcher_4_native_done:
+	ret
+	SET_SIZE(fletcher_4_sse2_native)
+
+ENTRY_NP(fletcher_4_sse2_byteswap)
+	test	%rdx, %rdx
+	jz	.Lfletcher_4_byteswap_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM10(%r10)
+	FLETCHER_4_LOAD
+
+.align 16
+.Lfletcher_4_byteswap_loop:
+	movdqu	(%rsi), %xmm8
+	/ Swap the bytes of each 16-bit word, then the 16-bit words
+	movdqa	%xmm8, %xmm9
+	psllw	$8, %xmm8
+	psrlw	$8, %xmm9
+	por	%xmm9, %xmm8
+	pshuflw	$0xb1, %xmm8, %xmm8
+	pshufhw	$0xb1, %xmm8, %xmm8
+	movdqa	%xmm8, %xmm9
+	punpckldq %xmm10, %xmm8
+	punpckhdq %xmm10, %xmm9
+	FLETCHER_4_ADD
+	lea	16(%rsi), %rsi
+	dec	%rdx
+	jnz	.Lfletcher_4_byteswap_loop
+
+	FLETCHER_4_STORE
+	SET_TS_OR_POP_XMM0_TO_XMM10(%r10)
+.Lfletcher_4_byteswap_done:
+	ret
+	SET_SIZE(fletcher_4_sse2_byteswap)
+
+#endif	/* lint || __lint */
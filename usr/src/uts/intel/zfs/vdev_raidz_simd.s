@@ -0,0 +1,277 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * RAID-Z parity generation and reconstruction loops using SSE2 and SSSE3;
+ * see vdev_raidz.c for the arithmetic.
+ *
+ * vdev_raidz_sse2_pq() and vdev_raidz_sse2_pqr() add one data column into
+ * the P, Q (and R) columns, 16 bytes at a time.  Multiplying each byte by
+ * 2 in GF(2^8) is the same trick as VDEV_RAIDZ_64MUL_2: pcmpgtb against
+ * zero gives a mask of the bytes with their top bit set, paddb shifts
+ * every byte left by one, and the mask selects which bytes get 0x1d.
+ * R is multiplied by 4 as two multiplications by 2.
+ *
+ * vdev_raidz_ssse3_mul_add() multiplies a column by a constant and adds
+ * it into another, for vdev_raidz_matrix_reconstruct().  tab holds the
+ * products of the constant with 0x00 - 0x0f and with 0x00 - 0xf0 in steps
+ * of 0x10; pshufb looks up the low and high nibble of 16 bytes at once,
+ * and the two products are added together.
+ *
+ * The caller is responsible for ensuring kpreempt_disable() has been
+ * called.  Clear and set the CR0.TS bit on entry and exit, respectively,
+ * if TS is set on entry.  Otherwise, if TS is not set, save and restore
+ * %xmm registers on the stack.
+ *
+ * Interface:
+ * void vdev_raidz_sse2_pq(uint64_t *p, uint64_t *q, const uint64_t *src,
+ *	size_t nblocks)
+ * void vdev_raidz_sse2_pqr(uint64_t *p, uint64_t *q, uint64_t *r,
+ *	const uint64_t *src, size_t nblocks)
+ * void vdev_raidz_ssse3_mul_add(uint8_t *dst, const uint8_t *src,
+ *	const uint8_t tab[32], size_t nblocks)
+ *
+ * nblocks is the number of 16-byte blocks to process.
+ */
+
+#if defined(lint) || defined(__lint)
+
+#include <sys/types.h>
+
+/* ARGSUSED */
+void
+vdev_raidz_sse2_pq(uint64_t *p, uint64_t *q, const uint64_t *src,
+    size_t nblocks)
+{
+}
+
+/* ARGSUSED */
+void
+vdev_raidz_sse2_pqr(uint64_t *p, uint64_t *q, uint64_t *r,
+    const uint64_t *src, size_t nblocks)
+{
+}
+
+/* ARGSUSED */
+void
+vdev_raidz_ssse3_mul_add(uint8_t *dst, const uint8_t *src,
+    const uint8_t tab[32], size_t nblocks)
+{
+}
+
+#else	/* lint */
+
+#include <sys/asm_linkage.h>
+#include <sys/controlregs.h>
+#ifdef _KERNEL
+#include <sys/machprivregs.h>
+#endif
+
+#ifdef _KERNEL
+	/*
+	 * Note: the CLTS macro clobbers P2 (%rsi) under i86xpv.  That is,
+	 * it calls HYPERVISOR_fpu_taskswitch() which modifies %rsi when it
+	 * uses it to pass P2 to syscall.
+	 */
+#ifdef __xpv
+#define	PROTECTED_CLTS \
+	push	%rsi; \
+	CLTS; \
+	pop	%rsi
+#else
+#define	PROTECTED_CLTS \
+	CLTS
+#endif	/* __xpv */
+
+	/*
+	 * If CR0_TS is not set, align stack (with push %rbp) and push
+	 * %xmm0 - %xmm6 on stack, otherwise clear CR0_TS
+	 */
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM6(tmpreg) \
+	push	%rbp; \
+	mov	%rsp, %rbp; \
+	movq	%cr0, tmpreg; \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	and	$-XMM_ALIGN, %rsp; \
+	sub	$[XMM_SIZE * 7], %rsp; \
+	movaps	%xmm0, 96(%rsp); \
+	movaps	%xmm1, 80(%rsp); \
+	movaps	%xmm2, 64(%rsp); \
+	movaps	%xmm3, 48(%rsp); \
+	movaps	%xmm4, 32(%rsp); \
+	movaps	%xmm5, 16(%rsp); \
+	movaps	%xmm6, (%rsp); \
+	jmp	2f; \
+1: \
+	PROTECTED_CLTS; \
+2:
+
+	/*
+	 * If CR0_TS was not set above, pop %xmm0 - %xmm6 off stack,
+	 * otherwise set CR0_TS.
+	 */
+#define	SET_TS_OR_POP_XMM0_TO_XMM6(tmpreg) \
+	testq	$CR0_TS, tmpreg; \
+	jnz	1f; \
+	movaps	(%rsp), %xmm6; \
+	movaps	16(%rsp), %xmm5; \
+	movaps	32(%rsp), %xmm4; \
+	movaps	48(%rsp), %xmm3; \
+	movaps	64(%rsp), %xmm2; \
+	movaps	80(%rsp), %xmm1; \
+	movaps	96(%rsp), %xmm0; \
+	jmp	2f; \
+1: \
+	STTS(tmpreg); \
+2: \
+	mov	%rbp, %rsp; \
+	pop	%rbp
+
+#else
+#define	CLEAR_TS_OR_PUSH_XMM0_TO_XMM6(tmpreg)
+#define	SET_TS_OR_POP_XMM0_TO_XMM6(tmpreg)
+#endif	/* _KERNEL */
+
+/* Multiply each byte of x by 2, using t; %xmm5 holds 0x1d in every byte */
+#define	RAIDZ_MUL_2(x, t) \
+	pxor	t, t; \
+	pcmpgtb	x, t; \
+	paddb	x, x; \
+	pand	%xmm5, t; \
+	pxor	t, x
+
+/*
+ * Register usage:
+ * %xmm0	Data column
+ * %xmm1	P
+ * %xmm2	Q
+ * %xmm4	Temporary
+ * %xmm5	0x1d in every byte
+ */
+ENTRY_NP(vdev_raidz_sse2_pq)
+	test	%rcx, %rcx
+	jz	.Lraidz_pq_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM6(%r10)
+	movdqa	.Lraidz_poly(%rip), %xmm5
+
+.align 16
+.Lraidz_pq_loop:
+	movdqu	(%rdx), %xmm0
+	movdqu	(%rdi), %xmm1
+	movdqu	(%rsi), %xmm2
+	pxor	%xmm0, %xmm1
+	RAIDZ_MUL_2(%xmm2, %xmm4)
+	pxor	%xmm0, %xmm2
+	movdqu	%xmm1, (%rdi)
+	movdqu	%xmm2, (%rsi)
+	lea	16(%rdx), %rdx
+	lea	16(%rdi), %rdi
+	lea	16(%rsi), %rsi
+	dec	%rcx
+	jnz	.Lraidz_pq_loop
+
+	SET_TS_OR_POP_XMM0_TO_XMM6(%r10)
+.Lraidz_pq_done:
+	ret
+	SET_SIZE(vdev_raidz_sse2_pq)
+
+/*
+ * Register usage:
+ * %xmm0	Data column
+ * %xmm1	P
+ * %xmm2	Q
+ * %xmm3	R
+ * %xmm4, %xmm6	Temporaries
+ * %xmm5	0x1d in every byte
+ */
+ENTRY_NP(vdev_raidz_sse2_pqr)
+	test	%r8, %r8
+	jz	.Lraidz_pqr_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM6(%r10)
+	movdqa	.Lraidz_poly(%rip), %xmm5
+
+.align 16
+.Lraidz_pqr_loop:
+	movdqu	(%rcx), %xmm0
+	movdqu	(%rdi), %xmm1
+	movdqu	(%rsi), %xmm2
+	movdqu	(%rdx), %xmm3
+	pxor	%xmm0, %xmm1
+	RAIDZ_MUL_2(%xmm2, %xmm4)
+	RAIDZ_MUL_2(%xmm3, %xmm6)
+	pxor	%xmm0, %xmm2
+	RAIDZ_MUL_2(%xmm3, %xmm6)
+	pxor	%xmm0, %xmm3
+	movdqu	%xmm1, (%rdi)
+	movdqu	%xmm2, (%rsi)
+	movdqu	%xmm3, (%rdx)
+	lea	16(%rcx), %rcx
+	lea	16(%rdi), %rdi
+	lea	16(%rsi), %rsi
+	lea	16(%rdx), %rdx
+	dec	%r8
+	jnz	.Lraidz_pqr_loop
+
+	SET_TS_OR_POP_XMM0_TO_XMM6(%r10)
+.Lraidz_pqr_done:
+	ret
+	SET_SIZE(vdev_raidz_sse2_pqr)
+
+/*
+ * Register usage:
+ * %xmm0	Products of the low nibbles
+ * %xmm1	Products of the high nibbles
+ * %xmm2	0x0f in every byte
+ * %xmm3	Source bytes, then their low nibbles and products
+ * %xmm4	High nibbles of the source bytes, then their products
+ */
+ENTRY_NP(vdev_raidz_ssse3_mul_add)
+	test	%rcx, %rcx
+	jz	.Lraidz_mul_add_done
+	CLEAR_TS_OR_PUSH_XMM0_TO_XMM6(%r10)
+	movdqu	(%rdx), %xmm0
+	movdqu	16(%rdx), %xmm1
+	movdqa	.Lraidz_nibble(%rip), %xmm2
+
+.align 16
+.Lraidz_mul_add_loop:
+	movdqu	(%rsi), %xmm3
+	movdqa	%xmm3, %xmm4
+	psrlw	$4, %xmm4
+	pand	%xmm2, %xmm3
+	pand	%xmm2, %xmm4
+	movdqa	%xmm0, %xmm5
+	movdqa	%xmm1, %xmm6
+	pshufb	%xmm3, %xmm5
+	pshufb	%xmm4, %xmm6
+	pxor	%xmm6, %xmm5
+	movdqu	(%rdi), %xmm3
+	pxor	%xmm5, %xmm3
+	movdqu	%xmm3, (%rdi)
+	lea	16(%rsi), %rsi
+	lea	16(%rdi), %rdi
+	dec	%rcx
+	jnz	.Lraidz_mul_add_loop
+
+	SET_TS_OR_POP_XMM0_TO_XMM6(%r10)
+.Lraidz_mul_add_done:
+	ret
+	SET_SIZE(vdev_raidz_ssse3_mul_add)
+
+	.section .rodata
+	.align	16
+.Lraidz_poly:
+	.quad	0x1d1d1d1d1d1d1d1d, 0x1d1d1d1d1d1d1d1d
+.Lraidz_nibble:
+	.quad	0x0f0f0f0f0f0f0f0f, 0x0f0f0f0f0f0f0f0f
+
+#endif	/* lint || __lint */
@@ -2133,7 +2133,8 @@ hat_dup(struct hat *hat, struct hat *newhat, caddr_t addr, size_t len,
 	ASSERT(flag != HAT_DUP_ALL || hat->sfmmu_srdp == newhat->sfmmu_srdp);
 
 	if (flag == HAT_DUP_COW) {
-		panic("hat_dup: HAT_DUP_COW not supported");
+		hat_clrattr(hat, addr, len, PROT_WRITE);
+		return (0);
 	}
 
 	if (flag == HAT_DUP_SRD && ((srdp = hat->sfmmu_srdp) != NULL)) {